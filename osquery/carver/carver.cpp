@@ -30,6 +30,8 @@
 
 #include <boost/algorithm/string.hpp>
 
+#include <thread>
+
 namespace fs = boost::filesystem;
 
 namespace osquery {
@@ -55,6 +57,12 @@ CLI_FLAG(uint32,
          8192,
          "Size of blocks used for POSTing data back to remote endpoints");
 
+/// Number of blocks POSTed concurrently to the continue endpoint.
+CLI_FLAG(uint32,
+         carver_upload_concurrency,
+         1,
+         "Number of carve blocks to POST concurrently (default 1)");
+
 /// Boolean if compression should be used.
 CLI_FLAG(bool,
          carver_compression,
@@ -68,7 +76,9 @@ CLI_FLAG(uint32,
          "Seconds to store successful carve result metadata (in carves table)");
 
 DECLARE_bool(disable_carver);
-DECLARE_uint64(read_max);
+
+/// Number of times a carved block is POSTed before the carve fails.
+const size_t kCarverBlockAttempts{3};
 
 std::atomic<bool> CarverRunnable::running_{false};
 
@@ -182,39 +192,38 @@ Status Carver::carve() {
     return s;
   }
 
-  const auto carvedFiles = carveAll();
-  s = archive(carvedFiles, archivePath_, FLAGS_carver_block_size);
+  const auto& uploadPath =
+      (FLAGS_carver_compression) ? compressPath_ : archivePath_;
+  Hash uploadHash(HashType::HASH_TYPE_SHA256);
+  size_t uploadSize = 0;
+  {
+    PlatformFile uploadFile(uploadPath, PF_CREATE_NEW | PF_WRITE);
+    if (!uploadFile.isValid()) {
+      updateCarveValue(carveGuid_, "status", "ARCHIVE FAILED");
+      return Status::failure("Failed to create carve archive");
+    }
+
+    // Files are read, archived, compressed and hashed in a single pass.
+    s = archive(carveEntries(),
+                FLAGS_carver_compression,
+                FLAGS_carver_block_size,
+                [&](const char* data, size_t size) {
+                  if (uploadFile.write(data, size) < 0) {
+                    return Status::failure("Error writing bytes to tmp fs");
+                  }
+                  uploadHash.update(data, size);
+                  uploadSize += size;
+                  return Status::success();
+                });
+  }
   if (!s.ok()) {
     VLOG(1) << "Failed to create carve archive: " << s.getMessage();
     updateCarveValue(carveGuid_, "status", "ARCHIVE FAILED");
     return s;
   }
 
-  fs::path uploadPath;
-  if (FLAGS_carver_compression) {
-    uploadPath = compressPath_;
-    s = compress(archivePath_, compressPath_);
-    if (!s.ok()) {
-      VLOG(1) << "Failed to compress carve archive: " << s.getMessage();
-      updateCarveValue(carveGuid_, "status", "COMPRESS FAILED");
-      return s;
-    }
-  } else {
-    uploadPath = archivePath_;
-  }
-
-  PlatformFile uploadFile(uploadPath, PF_OPEN_EXISTING | PF_READ);
-  updateCarveValue(carveGuid_, "size", uploadFile.size());
-
-  std::string uploadHash =
-      (uploadFile.size() > FLAGS_read_max)
-          ? "-1"
-          : hashFromFile(HashType::HASH_TYPE_SHA256, uploadPath.string());
-  if (uploadHash == "-1") {
-    VLOG(1)
-        << "Archive file size exceeds read max, skipping integrity computation";
-  }
-  updateCarveValue(carveGuid_, "sha256", uploadHash);
+  updateCarveValue(carveGuid_, "size", uploadSize);
+  updateCarveValue(carveGuid_, "sha256", uploadHash.digest());
 
   s = postCarve(uploadPath);
   if (!s.ok()) {
@@ -225,8 +234,8 @@ Status Carver::carve() {
   return Status::success();
 };
 
-std::set<fs::path> Carver::carveAll() {
-  std::set<fs::path> carvedFiles;
+std::map<std::string, fs::path> Carver::carveEntries() {
+  std::map<std::string, fs::path> entries;
   for (const auto& srcPath : carvePaths_) {
     // Ensure the file is a flat file on disk before carving
     PlatformFile src(srcPath, PF_OPEN_EXISTING | PF_READ);
@@ -235,6 +244,7 @@ std::set<fs::path> Carver::carveAll() {
       continue;
     }
 
+    // Entries are named as the copies within the carve directory used to be.
     fs::path dstPath;
     if (srcPath.has_root_name()) {
       auto temp = srcPath.string();
@@ -243,49 +253,11 @@ std::set<fs::path> Carver::carveAll() {
     } else {
       dstPath = carveDir_ / srcPath;
     }
-    if (!fs::exists(dstPath.parent_path())) {
-      auto ret = fs::create_directories(dstPath.parent_path());
-      if (!ret) {
-        VLOG(1) << "Failed to create directories for: "
-                << dstPath.parent_path();
-        continue;
-      }
-    }
-
-    PlatformFile dst(dstPath, PF_CREATE_NEW | PF_WRITE);
-    if (!dst.isValid()) {
-      VLOG(1) << "Destination temporary file is invalid: " << dstPath;
-      continue;
-    }
-    Status s = blockwiseCopy(src, dst);
-    if (s.ok()) {
-      carvedFiles.insert(dstPath);
-    } else {
-      VLOG(1) << "Failed to copy file from " << srcPath << " to " << dstPath
-              << " " << s.getMessage();
-    }
+    entries.emplace(dstPath.string(), srcPath);
   }
-  return carvedFiles;
+  return entries;
 }
 
-Status Carver::blockwiseCopy(PlatformFile& src, PlatformFile& dst) {
-  auto blkCount = ceil(static_cast<double>(src.size()) /
-                       static_cast<double>(FLAGS_carver_block_size));
-
-  std::vector<char> inBuff(FLAGS_carver_block_size, 0);
-  for (size_t i = 0; i < blkCount; i++) {
-    auto bytesRead = src.read(inBuff.data(), FLAGS_carver_block_size);
-    if (bytesRead > 0) {
-      auto bytesWritten = dst.write(inBuff.data(), bytesRead);
-      if (bytesWritten < 0) {
-        return Status(1, "Error writing bytes to tmp fs");
-      }
-    }
-  }
-
-  return Status::success();
-};
-
 Status Carver::postCarve(const boost::filesystem::path& path) {
   // Construct the uri we post our data back to:
   auto startUri = TLSRequestHelper::makeURI(FLAGS_carver_start_endpoint);
@@ -332,30 +304,62 @@ Status Carver::postCarve(const boost::filesystem::path& path) {
   }
 
   auto contUri = TLSRequestHelper::makeURI(FLAGS_carver_continue_endpoint);
-  Request<TLSTransport, JSONSerializer> contRequest(contUri);
-  contRequest.setOption("hostname", FLAGS_tls_hostname);
-  for (size_t i = 0; i < blkCount; i++) {
+  std::atomic<size_t> nextBlock{0};
+  std::atomic<size_t> failedBlocks{0};
+  auto uploadBlocks = [&]() {
+    Request<TLSTransport, JSONSerializer> contRequest(contUri);
+    contRequest.setOption("hostname", FLAGS_tls_hostname);
+
+    // Each block is read at its own offset, so blocks may be POSTed in any
+    // order and a failed block is retried without resending the others.
+    PlatformFile blockFile(path, PF_OPEN_EXISTING | PF_READ);
     std::vector<char> block(FLAGS_carver_block_size, 0);
-    auto r = pFile.read(block.data(), FLAGS_carver_block_size);
+    for (auto i = nextBlock++; i < blkCount; i = nextBlock++) {
+      blockFile.seek(static_cast<off_t>(i * FLAGS_carver_block_size),
+                     PF_SEEK_BEGIN);
+      auto r = blockFile.read(block.data(), FLAGS_carver_block_size);
+      if (r <= 0) {
+        VLOG(1) << "Failed to read carved block " << i;
+        failedBlocks++;
+        continue;
+      }
 
-    if (r != FLAGS_carver_block_size && r > 0) {
-      // resize the buffer to size we read as last block is likely smaller
-      block.resize(r);
+      JSON params;
+      params.add("block_id", i);
+      params.add("session_id", session_id);
+      params.add("request_id", requestId_);
+      params.add("data", base64::encode(std::string(block.data(), r)));
+
+      Status blockStatus;
+      for (size_t attempt = 0; attempt < kCarverBlockAttempts; attempt++) {
+        blockStatus = contRequest.call(params);
+        if (blockStatus.ok()) {
+          break;
+        }
+        VLOG(1) << "Post of carved block " << i
+                << " failed: " << blockStatus.getMessage();
+      }
+      if (!blockStatus.ok()) {
+        failedBlocks++;
+      }
     }
+  };
 
-    JSON params;
-    params.add("block_id", i);
-    params.add("session_id", session_id);
-    params.add("request_id", requestId_);
-    params.add("data", base64::encode(std::string(block.begin(), block.end())));
-
-    // TODO: Error sending files.
-    status = contRequest.call(params);
-    if (!status.ok()) {
-      VLOG(1) << "Post of carved block " << i
-              << " failed: " << status.getMessage();
-      continue;
-    }
+  auto concurrency = std::min<size_t>(
+      std::max<uint32_t>(FLAGS_carver_upload_concurrency, 1), blkCount);
+  std::vector<std::thread> uploaders;
+  for (size_t i = 1; i < concurrency; i++) {
+    uploaders.emplace_back(uploadBlocks);
+  }
+  uploadBlocks();
+  for (auto& uploader : uploaders) {
+    uploader.join();
+  }
+
+  if (failedBlocks > 0) {
+    return Status::failure("Failed to post " + std::to_string(failedBlocks) +
+                           " of " + std::to_string(blkCount) +
+                           " carved blocks");
   }
 
   updateCarveValue(carveGuid_, "status", kCarverStatusSuccess);
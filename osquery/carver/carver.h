@@ -14,6 +14,7 @@
 #include <osquery/utils/status/status.h>
 
 #include <atomic>
+#include <map>
 #include <set>
 #include <string>
 
@@ -96,9 +97,9 @@ class Carver {
   /**
    * @brief A helper function to perform a start to finish carve.
    *
-   * This function walks through the carve, compress, and post functions
-   * in one fell swoop. Use of this class should largely happen through
-   * this function.
+   * This function reads, archives and optionally compresses the requested
+   * files into a single upload file in one pass, then posts it. Use of this
+   * class should largely happen through this function.
    */
   Status carve();
 
@@ -107,27 +108,19 @@ class Carver {
 
  protected:
   /**
-   * @brief A helper function that 'carves' all files from disk.
+   * @brief A helper function that finds the files to 'carve' from disk.
    *
-   * This function copies all source files to a temporary directory and returns
-   * a list of all destination files.
+   * This function returns a map of archive entry names to the source files
+   * that exist and are not directories.
    */
-  std::set<boost::filesystem::path> carveAll();
-
-  /**
-   * @brief A helper function that does a blockwise copy from src to dst.
-   *
-   * This function copies the source file to the destination file, doing so
-   * by blocks specified with FLAGS_carver_block_size (defaults to 8K).
-   */
-  Status blockwiseCopy(PlatformFile& src, PlatformFile& dst);
+  std::map<std::string, boost::filesystem::path> carveEntries();
 
   /**
    * @brief Helper function to POST a carve to the graph endpoint.
    *
-   * Once all of the files have been carved and the tgz has been
-   * created, we POST the carved file to an endpoint specified by the
-   * carver_start_endpoint and carver_continue_endpoint.
+   * Once the archive has been created, we POST it in blocks to an endpoint
+   * specified by the carver_start_endpoint and carver_continue_endpoint.
+   * Up to carver_upload_concurrency blocks are POSTed at once.
    */
   virtual Status postCarve(const boost::filesystem::path& path);
 
@@ -140,9 +133,8 @@ class Carver {
   /**
    * @brief a variable to keep track of the temp path used in carving.
    *
-   * This variable represents the location in which we store all of our carved
-   * files. When a carve has completed all of the desired files, as well
-   * as the tar archive should reside in this directory.
+   * This variable represents the location in which we store the archive of
+   * the carved files until it has been posted.
    */
   boost::filesystem::path carveDir_;
 
@@ -158,15 +150,15 @@ class Carver {
    * @brief a helper variable for keeping track of the posix tar archive.
    *
    * This variable is the absolute location of the tar archive created from
-   * tar'ing all of the carved files from the carve temp dir.
+   * tar'ing all of the carved files, when compression is disabled.
    */
   boost::filesystem::path archivePath_;
 
   /**
    * @brief a helper variable for keeping track of the compressed tar.
    *
-   * This variable is the absolute location of the tar archive created from
-   * zstd of the archive.
+   * This variable is the absolute location of the zstd compressed tar
+   * archive, when compression is enabled.
    */
   boost::filesystem::path compressPath_;
 
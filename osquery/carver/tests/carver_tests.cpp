@@ -43,6 +43,7 @@ class FakeCarver : public Carver {
  private:
   friend class CarverTests;
   FRIEND_TEST(CarverTests, test_carve_files_locally);
+  FRIEND_TEST(CarverTests, test_carve_stream_compression);
   FRIEND_TEST(CarverTests, test_carve_start);
   FRIEND_TEST(CarverTests, test_carve_files_not_exists);
 };
@@ -115,19 +116,67 @@ TEST_F(CarverTests, test_carve_files_locally) {
   FakeCarver carve(getCarvePaths(), guid, requestId);
 
   ASSERT_TRUE(carve.createPaths());
-  const auto carves = carve.carveAll();
+  const auto carves = carve.carveEntries();
   EXPECT_EQ(carves.size(), 3U);
 
   const auto carveFSPath = carve.getCarveDir();
   const auto tarPath = carveFSPath / (kTestCarveNamePrefix + guid + ".tar");
-  const auto s = archive(carves, tarPath);
-  EXPECT_TRUE(s.ok());
+  {
+    PlatformFile tar(tarPath, PF_CREATE_NEW | PF_WRITE);
+    ASSERT_TRUE(tar.isValid());
+    const auto s =
+        archive(carves, false, 8192, [&tar](const char* data, size_t size) {
+          tar.write(data, size);
+          return Status::success();
+        });
+    EXPECT_TRUE(s.ok());
+  }
 
   PlatformFile tar(tarPath, PF_OPEN_EXISTING | PF_READ);
   EXPECT_TRUE(tar.isValid());
   EXPECT_GT(tar.size(), 0U);
 }
 
+TEST_F(CarverTests, test_carve_stream_compression) {
+  auto guid = createCarveGuid();
+  FakeCarver carve(getCarvePaths(), guid, "");
+  ASSERT_TRUE(carve.createPaths());
+  const auto carves = carve.carveEntries();
+
+  // Use a small block size to stream each file in several reads.
+  std::string tar;
+  auto s = archive(carves, false, 4, [&tar](const char* data, size_t size) {
+    tar.append(data, size);
+    return Status::success();
+  });
+  ASSERT_TRUE(s.ok()) << s.what();
+  EXPECT_NE(tar.find("This is a hidden file"), std::string::npos);
+
+  const auto zstPath = getWorkingDir() / "carve.tar.zst";
+  {
+    PlatformFile zst(zstPath, PF_CREATE_NEW | PF_WRITE);
+    s = archive(carves, true, 4, [&zst](const char* data, size_t size) {
+      zst.write(data, size);
+      return Status::success();
+    });
+    ASSERT_TRUE(s.ok()) << s.what();
+  }
+
+  // The compressed stream holds the same archive.
+  const auto extractPath = getWorkingDir() / "carve.tar";
+  s = osquery::decompress(zstPath, extractPath);
+  ASSERT_TRUE(s.ok()) << s.what();
+  std::string extracted;
+  ASSERT_TRUE(readFile(extractPath, extracted).ok());
+  EXPECT_EQ(extracted, tar);
+
+  // A failing sink stops the stream.
+  s = archive(carves, true, 4, [](const char*, size_t) {
+    return Status::failure("sink failure");
+  });
+  EXPECT_FALSE(s.ok());
+}
+
 TEST_F(CarverTests, test_carve) {
   auto guid = createCarveGuid();
   std::string requestId = createCarveGuid();
@@ -259,7 +308,7 @@ TEST_F(CarverTests, test_carve_files_not_exists) {
   const std::set<std::string> notExistsCarvePaths = {
       (getFilesToCarveDir() / "not_exists").string()};
   FakeCarver carve(notExistsCarvePaths, guid, requestId);
-  const auto carves = carve.carveAll();
+  const auto carves = carve.carveEntries();
   EXPECT_TRUE(carves.empty());
 }
 
@@ -10,8 +10,10 @@
 #include <algorithm>
 #include <chrono>
 #include <functional>
+#include <limits>
 #include <map>
 #include <queue>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -102,10 +104,21 @@ CLI_FLAG(bool,
          false,
          "Backup config and use it when refresh fails");
 
+CLI_FLAG(bool,
+         config_warm_start,
+         false,
+         "Start restarted workers from the backup config, then refresh it");
+
 FLAG_ALIAS(google::uint64,
            config_tls_accelerated_refresh,
            config_accelerated_refresh);
 
+FLAG(uint64,
+     schedule_max_step_cpu_ms,
+     0,
+     "Place scheduled queries so the CPU time they used in each step stays "
+     "below this many milliseconds (0 disables placement)");
+
 DECLARE_string(config_plugin);
 DECLARE_string(pack_delimiter);
 
@@ -124,6 +137,9 @@ Mutex config_hash_mutex_;
 Mutex config_refresh_mutex_;
 Mutex config_backup_mutex_;
 
+/// Steps modeled when placing the scheduled queries.
+const uint64_t kPlacementHorizon{3600};
+
 /// Several config methods require enumeration via predicate lambdas.
 RecursiveMutex config_schedule_mutex_;
 RecursiveMutex config_files_mutex_;
@@ -173,6 +189,13 @@ class Schedule : private boost::noncopyable {
   /// Remove all packs by source.
   void removeAll(const std::string& source);
 
+  /// Remove the packs of a source, except those named in keep.
+  void removeAll(const std::string& source,
+                 const std::set<std::string>& keep);
+
+  /// Check if the schedule has a pack by name and source.
+  bool contains(const std::string& pack, const std::string& source) const;
+
   /// Boost gives us a nice template for maintaining the state of the iterator
   using iterator = boost::filter_iterator<Step, container::iterator>;
 
@@ -261,9 +284,14 @@ Schedule::getSqlQueriesForSource(const std::string& source) {
 }
 
 void Schedule::removeAll(const std::string& source) {
-  auto new_end =
-      std::remove_if(packs_.begin(), packs_.end(), [source](const PackRef& p) {
-        if (p->getSource() == source) {
+  removeAll(source, {});
+}
+
+void Schedule::removeAll(const std::string& source,
+                         const std::set<std::string>& keep) {
+  auto new_end = std::remove_if(
+      packs_.begin(), packs_.end(), [&source, &keep](const PackRef& p) {
+        if (p->getSource() == source && keep.count(p->getName()) == 0) {
           Config::get().removeFiles(source + FLAGS_pack_delimiter +
                                     p->getName());
           return true;
@@ -273,6 +301,14 @@ void Schedule::removeAll(const std::string& source) {
   packs_.erase(new_end, packs_.end());
 }
 
+bool Schedule::contains(const std::string& pack,
+                        const std::string& source) const {
+  return std::any_of(
+      packs_.begin(), packs_.end(), [&pack, &source](const PackRef& p) {
+        return p->getName() == pack && p->getSource() == source;
+      });
+}
+
 Schedule::iterator Schedule::begin() {
   return Schedule::iterator(packs_.begin(), packs_.end());
 }
@@ -293,17 +329,21 @@ PackRef& Schedule::last() {
  * For configurations pulled from the network this assures that configuration
  * is fresh when re-attaching.
  */
-class ConfigRefreshRunner : public InternalRunnable {
+class ConfigRefreshRunner : public PeriodicRunnable {
  public:
-  ConfigRefreshRunner() : InternalRunnable("ConfigRefreshRunner") {}
+  ConfigRefreshRunner() : PeriodicRunnable("ConfigRefreshRunner") {}
 
-  /// A simple wait/interruptible lock.
-  void start() override;
+ protected:
+  /// Refresh, returns the current refresh rate.
+  std::chrono::milliseconds tick() override;
 
  private:
   /// The current refresh rate in seconds.
   std::atomic<uint64_t> refresh_sec_{0};
 
+  /// The config is not refreshed by the first tick.
+  bool ticked_{false};
+
  private:
   friend class Config;
 };
@@ -367,6 +407,51 @@ Config& Config::get() {
   return instance;
 }
 
+/// Hash a parsed JSON value, to find the sections of a config that changed.
+static std::string hashValue(const rj::Value& value) {
+  rj::StringBuffer buffer;
+  rj::Writer<rj::StringBuffer> writer(buffer);
+  value.Accept(writer);
+
+  Hash hash(HASH_TYPE_SHA1);
+  hash.update(buffer.GetString(), buffer.GetSize());
+  return hash.digest();
+}
+
+#ifndef OSQUERY_IS_FUZZING
+/**
+ * @brief Evaluate the discovery queries of every inline pack at once.
+ *
+ * Packs are added one at a time, each checking its discovery queries. Running
+ * them together first lets the shared evaluator deduplicate and parallelize.
+ */
+static void prefetchDiscovery(const rj::Value& packs) {
+  std::vector<std::string> queries;
+  for (const auto& pack : packs.GetObject()) {
+    if (!pack.value.IsObject() || !pack.value.HasMember("discovery") ||
+        !pack.value["discovery"].IsArray()) {
+      continue;
+    }
+
+    // Skip packs that will not be initialized on this platform.
+    if (pack.value.HasMember("platform") && pack.value["platform"].IsString() &&
+        !checkPlatform(pack.value["platform"].GetString())) {
+      continue;
+    }
+
+    for (const auto& item : pack.value["discovery"].GetArray()) {
+      if (item.IsString()) {
+        queries.push_back(item.GetString());
+      }
+    }
+  }
+
+  if (!queries.empty()) {
+    evaluateDiscoveryQueries(queries);
+  }
+}
+#endif
+
 void Config::addPack(const std::string& name,
                      const std::string& source,
                      const rj::Value& obj) {
@@ -375,6 +460,18 @@ void Config::addPack(const std::string& name,
   auto addSinglePack = ([this, &source](const std::string pack_name,
                                         const rj::Value& pack_obj) {
     RecursiveLock wlock(config_schedule_mutex_);
+    updated_packs_.insert(pack_name);
+
+    // An unchanged pack keeps its queries, splay, stats and parsed content.
+    auto hash = hashValue(pack_obj);
+    auto& hashes = pack_hashes_[source];
+    auto previous = hashes.find(pack_name);
+    if (previous != hashes.end() && previous->second == hash &&
+        schedule_->contains(pack_name, source)) {
+      return;
+    }
+    hashes[pack_name] = hash;
+
     try {
       schedule_->add(std::make_unique<Pack>(pack_name, source, pack_obj));
 #ifndef OSQUERY_IS_FUZZING
@@ -501,6 +598,88 @@ void Config::scheduledQueries(
   }
 }
 
+std::vector<uint64_t> placeQueries(
+    const std::vector<std::pair<uint64_t, uint64_t>>& queries,
+    uint64_t budget) {
+  std::vector<uint64_t> offsets(queries.size(), 0);
+
+  // The most expensive queries are placed first, while most steps are free.
+  std::vector<size_t> order(queries.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(), [&queries](size_t l, size_t r) {
+    return queries[l].second > queries[r].second;
+  });
+
+  // The cost of the queries launched at each step of the horizon. The steps
+  // of intervals not dividing the horizon are approximated.
+  std::vector<uint64_t> load(kPlacementHorizon, 0);
+  for (auto index : order) {
+    auto interval = queries[index].first;
+    auto cost = queries[index].second;
+    if (interval == 0) {
+      continue;
+    }
+
+    // Use the first offset keeping every step within the budget, otherwise
+    // the offset with the lowest peak.
+    auto candidates = std::min(interval, kPlacementHorizon);
+    uint64_t best = 0;
+    auto best_peak = std::numeric_limits<uint64_t>::max();
+    for (uint64_t offset = 0; offset < candidates; ++offset) {
+      uint64_t peak = 0;
+      for (auto step = offset; step < kPlacementHorizon; step += interval) {
+        peak = std::max(peak, load[step]);
+      }
+      if (peak + cost <= budget) {
+        best = offset;
+        break;
+      }
+      if (peak < best_peak) {
+        best = offset;
+        best_peak = peak;
+      }
+    }
+
+    for (auto step = best; step < kPlacementHorizon; step += interval) {
+      load[step] += cost;
+    }
+    offsets[index] = best;
+  }
+  return offsets;
+}
+
+void Config::placeScheduledQueries() {
+  if (FLAGS_schedule_max_step_cpu_ms == 0) {
+    return;
+  }
+
+  RecursiveLock lock(config_schedule_mutex_);
+  std::vector<ScheduledQuery*> queries;
+  std::vector<std::pair<uint64_t, uint64_t>> costs;
+  for (PackRef& pack : *schedule_) {
+    for (auto& it : pack->getSchedule()) {
+      // Queries without recorded executions are expected to be cheap.
+      uint64_t cost = 0;
+      getPerformanceStats(getQueryName(pack->getName(), it.first),
+                          [&cost](const QueryPerformance& query) {
+                            if (query.executions > 0) {
+                              cost = (query.user_time + query.system_time) /
+                                     query.executions;
+                            }
+                          });
+      queries.push_back(&it.second);
+      costs.emplace_back(it.second.splayed_interval, cost);
+    }
+  }
+
+  auto offsets = placeQueries(costs, FLAGS_schedule_max_step_cpu_ms);
+  for (size_t i = 0; i < queries.size(); ++i) {
+    queries[i]->splayed_offset = offsets[i];
+  }
+}
+
 void Config::packs(std::function<void(const Pack& pack)> predicate) const {
   RecursiveLock lock(config_schedule_mutex_);
   for (PackRef& pack : schedule_->packs_) {
@@ -567,7 +746,7 @@ uint64_t Config::getRefresh() const {
   return refresh_runner_->refresh_sec_;
 }
 
-Status Config::load() {
+Status Config::load(bool warm_start) {
   valid_ = false;
   auto config_plugin = RegistryFactory::get().getActive("config");
   if (!RegistryFactory::get().exists("config", config_plugin)) {
@@ -582,6 +761,24 @@ Status Config::load() {
    * additional service that sleeps and periodically regenerates the
    * configuration.
    */
+  bool warm = warm_start && FLAGS_config_warm_start && !FLAGS_config_check &&
+              !FLAGS_config_dump && !started_thread_ && getRefresh() > 0;
+  if (warm) {
+    auto backup = restoreConfigBackup();
+    if (backup && !backup->empty()) {
+      LOG(INFO) << "Starting from the backed up config, refreshing it now";
+      // The first tick of the refresh service fetches the config at once.
+      refresh_runner_->ticked_ = true;
+      is_first_time_refresh = false;
+      auto status = update(*backup);
+      valid_ = status.ok();
+      loaded_ = true;
+      Dispatcher::addService(refresh_runner_);
+      started_thread_ = true;
+      return status;
+    }
+  }
+
   if (!FLAGS_config_check && !started_thread_ && getRefresh() > 0) {
     Dispatcher::addService(refresh_runner_);
     started_thread_ = true;
@@ -711,13 +908,6 @@ Status Config::updateSource(const std::string& source,
 
   // Get the queries so that we can check which ones updated the SQL.
   auto queries = schedule_->getSqlQueriesForSource(source);
-  {
-    RecursiveLock lock(config_schedule_mutex_);
-    // Remove all packs from this source.
-    schedule_->removeAll(source);
-    // Remove all files from this source.
-    removeFiles(source);
-  }
 
   // load the config (source.second) into a JSON object.
   auto doc = JSON::newObject();
@@ -726,22 +916,38 @@ Status Config::updateSource(const std::string& source,
 
   // Since we use iterative parsing, we limit the size of the JSON
   // string to a sane value to avoid memory exhaustion.
+  Status status;
   if (clone.size() > kMaxConfigSize) {
-    return Status::failure(
+    status = Status::failure(
         "Error parsing the config JSON: the config size exceeds the limit "
         "of " +
         std::to_string(kMaxConfigSize) + " bytes");
+  } else if (!doc.fromString(clone, JSON::ParseMode::Iterative) ||
+             !doc.doc().IsObject()) {
+    status = Status::failure("Error parsing the config JSON");
+  } else {
+    status = validateConfig(doc);
+    if (!status.ok()) {
+      status = Status::failure("Error validating the config JSON: " +
+                               status.getMessage());
+    }
   }
 
-  if (!doc.fromString(clone, JSON::ParseMode::Iterative) ||
-      !doc.doc().IsObject()) {
-    return Status::failure("Error parsing the config JSON");
-  }
+  {
+    RecursiveLock lock(config_schedule_mutex_);
+    if (!status.ok()) {
+      // Content that cannot be used removes every pack and file of the
+      // source, and the next content is parsed in full.
+      schedule_->removeAll(source);
+      removeFiles(source);
+      pack_hashes_.erase(source);
+      parser_hashes_.erase(source);
+      return status;
+    }
 
-  auto status = validateConfig(doc);
-  if (!status.ok()) {
-    return Status::failure("Error validating the config JSON: " +
-                           status.getMessage());
+    // Packs are replaced as they are added, those missing from the new
+    // content are removed once it is parsed.
+    updated_packs_.clear();
   }
 
   // extract the "schedule" key and store it as the main pack
@@ -761,6 +967,9 @@ Status Config::updateSource(const std::string& source,
   if (doc.doc().HasMember("packs") && !rf.external()) {
     auto& packs = doc.doc()["packs"];
     if (packs.IsObject()) {
+#ifndef OSQUERY_IS_FUZZING
+      prefetchDiscovery(packs);
+#endif
       for (const auto& pack : packs.GetObject()) {
         std::string pack_name = pack.name.GetString();
         if (pack.value.IsObject()) {
@@ -773,6 +982,15 @@ Status Config::updateSource(const std::string& source,
     }
   }
 
+  {
+    RecursiveLock lock(config_schedule_mutex_);
+    schedule_->removeAll(source, updated_packs_);
+    auto& hashes = pack_hashes_[source];
+    for (auto it = hashes.begin(); it != hashes.end();) {
+      it = updated_packs_.count(it->first) ? std::next(it) : hashes.erase(it);
+    }
+  }
+
   applyParsers(source, doc.doc(), false);
 
   // Get the updated queries so that we can compare them to old queries.
@@ -847,8 +1065,25 @@ void Config::applyParsers(const std::string& source,
   assert(obj.IsObject());
 
   auto applyParser = [=](const std::shared_ptr<ConfigParserPlugin>& parser,
+                         const std::string& name,
                          const std::string& source,
                          const rj::Value& obj) {
+    if (!pack) {
+      // A parser is only updated when the content of its keys changed.
+      std::string hash;
+      for (const auto& key : parser->keys()) {
+        if (obj.HasMember(key) && !obj[key].IsNull()) {
+          hash += key + ":" + hashValue(obj[key]) + ";";
+        }
+      }
+      auto& previous = parser_hashes_[source];
+      auto it = previous.find(name);
+      if (it != previous.end() && it->second == hash) {
+        return;
+      }
+      previous[name] = std::move(hash);
+    }
+
     // For each key requested by the parser, add a property tree reference.
     std::map<std::string, JSON> parser_config;
     for (const auto& key : parser->keys()) {
@@ -887,7 +1122,7 @@ void Config::applyParsers(const std::string& source,
   if (options_plugin != plugins.end()) {
     auto parser = getParser(options_plugin->second, options_plugin->first);
     if (parser != nullptr && parser.get() != nullptr) {
-      applyParser(parser, source, obj);
+      applyParser(parser, options_plugin->first, source, obj);
     }
   }
 
@@ -898,7 +1133,7 @@ void Config::applyParsers(const std::string& source,
     }
     auto parser = getParser(plugin.second, plugin.first);
     if (parser != nullptr && parser.get() != nullptr) {
-      applyParser(parser, source, obj);
+      applyParser(parser, plugin.first, source, obj);
     }
   }
 }
@@ -978,7 +1213,11 @@ Status Config::update(const ConfigMap& config) {
     }
   }
 
-  if (FLAGS_config_enable_backup) {
+  if (needs_reconfigure) {
+    placeScheduledQueries();
+  }
+
+  if (FLAGS_config_enable_backup || FLAGS_config_warm_start) {
     backupConfig(config);
   }
 
@@ -1033,6 +1272,10 @@ void Config::purge() {
       // Query has not run in the last week, expire results and interval.
       deleteDatabaseValue(kQueries, saved_query);
       deleteDatabaseValue(kQueries, saved_query + "epoch");
+      deleteDatabaseValue(kQueries, saved_query + "state");
+      deleteDatabaseValue(kQueries, saved_query + "fingerprints");
+      deleteDatabaseValue(kQueries, saved_query + "snapshot");
+      deleteDatabaseValue(kQueries, saved_query + "scan");
       deleteDatabaseValue(kPersistentSettings, "interval." + saved_query);
       deleteDatabaseValue(kPersistentSettings, "timestamp." + saved_query);
       VLOG(1) << "Expiring results for scheduled query: " << saved_query;
@@ -1046,6 +1289,9 @@ void Config::reset() {
   schedule_ = std::make_unique<Schedule>();
   std::map<std::string, FileCategories>().swap(files_);
   std::map<std::string, std::string>().swap(hash_);
+  pack_hashes_.clear();
+  parser_hashes_.clear();
+  updated_packs_.clear();
   valid_ = false;
   loaded_ = false;
   is_first_time_refresh = true;
@@ -1084,8 +1330,10 @@ void ConfigParserPlugin::reset() {
 void Config::recordQueryPerformance(const std::string& name,
                                     uint64_t delay_ms,
                                     uint64_t size,
-                                    const Row& r0,
-                                    const Row& r1) {
+                                    uint64_t rows,
+                                    uint64_t result_bytes,
+                                    const ResourceUsage& r0,
+                                    const ResourceUsage& r1) {
   RecursiveLock lock(config_performance_mutex_);
   std::string csv;
   QueryPerformance query;
@@ -1094,38 +1342,33 @@ void Config::recordQueryPerformance(const std::string& name,
     query = QueryPerformance(csv);
   }
 
-  if (!r1.at("user_time").empty() && !r0.at("user_time").empty()) {
-    auto ut1 = tryTo<long long>(r1.at("user_time"));
-    auto ut0 = tryTo<long long>(r0.at("user_time"));
-    auto diff = (ut1 && ut0) ? ut1.take() - ut0.take() : 0;
-    if (diff > 0) {
-      query.user_time += diff;
-      query.last_user_time = diff;
-    }
+  if (r1.user_time > r0.user_time) {
+    auto diff = r1.user_time - r0.user_time;
+    query.user_time += diff;
+    query.last_user_time = diff;
   }
 
-  if (!r1.at("system_time").empty() && !r0.at("system_time").empty()) {
-    auto st1 = tryTo<long long>(r1.at("system_time"));
-    auto st0 = tryTo<long long>(r0.at("system_time"));
-    auto diff = (st1 && st0) ? st1.take() - st0.take() : 0;
-    if (diff > 0) {
-      query.system_time += diff;
-      query.last_system_time = diff;
-    }
+  if (r1.system_time > r0.system_time) {
+    auto diff = r1.system_time - r0.system_time;
+    query.system_time += diff;
+    query.last_system_time = diff;
   }
 
-  if (!r1.at("resident_size").empty() && !r0.at("resident_size").empty()) {
-    auto rs1 = tryTo<long long>(r1.at("resident_size"));
-    auto rs0 = tryTo<long long>(r0.at("resident_size"));
-    auto diff = (rs1 && rs0) ? rs1.take() - rs0.take() : 0;
-    if (diff > 0) {
-      // Memory is stored as an average of RSS changes between query executions.
-      query.average_memory = (query.average_memory * query.executions) + diff;
-      query.average_memory = (query.average_memory / (query.executions + 1));
-      query.last_memory = diff;
-    }
+  if (r0.resident_size > 0 && r1.resident_size > r0.resident_size) {
+    auto diff = r1.resident_size - r0.resident_size;
+    // Memory is stored as an average of RSS changes between query executions.
+    query.average_memory = (query.average_memory * query.executions) + diff;
+    query.average_memory = (query.average_memory / (query.executions + 1));
+    query.last_memory = diff;
   }
 
+  query.average_result_bytes =
+      (query.average_result_bytes * query.executions + result_bytes) /
+      (query.executions + 1);
+  query.last_result_bytes = result_bytes;
+  query.rows += rows;
+  query.last_rows = rows;
+
   query.last_wall_time_ms = delay_ms;
   query.wall_time_ms += delay_ms;
   query.wall_time += (delay_ms / 1000);
@@ -1158,6 +1401,12 @@ void Config::recordQueryStart(const std::string& name) {
       kPersistentSettings, "timestamp." + name, std::to_string(getUnixTime()));
 }
 
+void Config::denylistQuery(const std::string& name) {
+  RecursiveLock lock(config_schedule_mutex_);
+  schedule_->denylist_[name] = getUnixTime() + 86400;
+  saveScheduleDenylist(schedule_->denylist_);
+}
+
 void Config::getPerformanceStats(
     const std::string& name,
     std::function<void(const QueryPerformance& query)> predicate) {
@@ -1295,19 +1544,14 @@ Status ConfigParserPlugin::setUp() {
   return Status::success();
 }
 
-void ConfigRefreshRunner::start() {
-  while (!interrupted()) {
-    // Cool off and time wait the configured period.
-    // Apply this interruption initially as at t=0 the config was read.
-    pause(std::chrono::seconds(refresh_sec_));
-    // Since the pause occurs before the logic, we need to check for an
-    // interruption request.
-    if (interrupted()) {
-      return;
-    }
-
+std::chrono::milliseconds ConfigRefreshRunner::tick() {
+  // Cool off and time wait the configured period first, as at t=0 the config
+  // was read.
+  if (ticked_) {
     VLOG(1) << "Refreshing configuration state";
     Config::get().refresh();
   }
+  ticked_ = true;
+  return std::chrono::seconds(refresh_sec_);
 }
 } // namespace osquery
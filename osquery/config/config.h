@@ -12,6 +12,7 @@
 #include <functional>
 #include <map>
 #include <memory>
+#include <set>
 #include <vector>
 
 #include <osquery/core/plugins/plugin.h>
@@ -87,14 +88,29 @@ class Config : private boost::noncopyable {
    * @param name The unique name of the scheduled item
    * @param delay_ms Number of milliseconds (wall time) taken by the query
    * @param size Number of characters generated by query
-   * @param r0 the process row before the query
-   * @param r1 the process row after the query
+   * @param rows Number of rows returned by the query
+   * @param result_bytes Bytes of the result rows held by the query
+   * @param r0 the worker's resource usage before the query
+   * @param r1 the worker's resource usage after the query
    */
   static void recordQueryPerformance(const std::string& name,
                                      uint64_t delay_ms,
                                      uint64_t size,
-                                     const Row& r0,
-                                     const Row& r1);
+                                     uint64_t rows,
+                                     uint64_t result_bytes,
+                                     const ResourceUsage& r0,
+                                     const ResourceUsage& r1);
+
+  /**
+   * @brief Spread the scheduled queries across steps by their recorded cost.
+   *
+   * When schedule_max_step_cpu_ms is set, each query is given the offset
+   * within its interval that keeps the average CPU time of the queries
+   * launched in a step below the budget. Intervals are not changed. This is
+   * called after each config update and may be called again as the recorded
+   * performance grows.
+   */
+  void placeScheduledQueries();
 
   /**
    * @brief Record a query 'initialization', meaning the query will run.
@@ -109,6 +125,16 @@ class Config : private boost::noncopyable {
    */
   void recordQueryStart(const std::string& name);
 
+  /**
+   * @brief Denylist a scheduled query that failed within the worker.
+   *
+   * The query is skipped for a day, as if it had caused the worker to fail,
+   * unless its options disable the denylist.
+   *
+   * @param name The unique name of the scheduled item
+   */
+  void denylistQuery(const std::string& name);
+
   /**
    * @brief Calculate the hash of the osquery config
    *
@@ -266,9 +292,13 @@ class Config : private boost::noncopyable {
   /**
    * @brief Check if a config plugin is registered and load configs.
    *
-   * Calls refresh after confirming a config plugin is registered
+   * Calls refresh after confirming a config plugin is registered.
+   *
+   * @param warm_start With config_warm_start, the backed up config is used
+   * at once if there is one, and the refresh service fetches the config
+   * again in the background.
    */
-  Status load();
+  Status load(bool warm_start = false);
 
   /// A step method for Config::update.
   Status updateSource(const std::string& source, const std::string& json);
@@ -338,6 +368,15 @@ class Config : private boost::noncopyable {
   /// A set of hashes for each source of the config.
   std::map<std::string, std::string> hash_;
 
+  /// The content hash of each pack, by source then pack name.
+  std::map<std::string, std::map<std::string, std::string>> pack_hashes_;
+
+  /// The hash of the keys given to each parser, by source then parser name.
+  std::map<std::string, std::map<std::string, std::string>> parser_hashes_;
+
+  /// The packs added while a source is updated.
+  std::set<std::string> updated_packs_;
+
   /// Check if the config received valid/parsable content from a config plugin.
   bool valid_{false};
 
@@ -369,6 +408,7 @@ class Config : private boost::noncopyable {
   friend class WatcherTests;
   FRIEND_TEST(ConfigTests, test_config_backup);
   FRIEND_TEST(ConfigTests, test_config_backup_integrate);
+  FRIEND_TEST(ConfigTests, test_config_warm_start);
   FRIEND_TEST(ConfigTests, test_config_refresh);
   FRIEND_TEST(ConfigTests, test_get_scheduled_queries);
   FRIEND_TEST(ConfigTests, test_nondenylist_query);
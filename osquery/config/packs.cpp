@@ -8,19 +8,24 @@
  */
 
 #include <algorithm>
+#include <atomic>
 #include <mutex>
 #include <random>
+#include <thread>
 
 #include <osquery/config/packs.h>
 #include <osquery/core/system.h>
+#include <osquery/core/tables.h>
 #include <osquery/database/database.h>
 #include <osquery/hashing/hashing.h>
 #include <osquery/logger/logger.h>
+#include <osquery/registry/registry.h>
 #include <osquery/sql/sql.h>
 #include <osquery/utils/conversions/split.h>
 #include <osquery/utils/conversions/tryto.h>
 #include <osquery/utils/info/version.h>
 #include <osquery/utils/json/json.h>
+#include <osquery/utils/mutex.h>
 #include <osquery/utils/system/time.h>
 
 namespace rj = rapidjson;
@@ -32,6 +37,11 @@ FLAG(uint64,
      3600,
      "Cache expiration for a packs discovery queries");
 
+FLAG(uint64,
+     pack_discovery_concurrency,
+     4,
+     "Number of distinct discovery queries to run concurrently");
+
 FLAG(string, pack_delimiter, "_", "Delimiter for pack and query names");
 
 FLAG(uint64, schedule_splay_percent, 10, "Percent to splay config times");
@@ -116,6 +126,175 @@ uint64_t restoreSplayedValue(const std::string& name, uint64_t interval) {
   return splay;
 }
 
+namespace {
+
+/// The time and result of a discovery query execution.
+using DiscoveryResult = std::pair<uint64_t, bool>;
+
+/// Shared discovery results, keyed by the query string.
+struct DiscoveryCache {
+  Mutex mutex;
+  std::map<std::string, DiscoveryResult> results;
+};
+
+DiscoveryCache& getDiscoveryCache() {
+  static DiscoveryCache cache;
+  return cache;
+}
+
+std::string getDiscoveryKey(const std::string& query) {
+  return "discovery." +
+         hashFromBuffer(HASH_TYPE_SHA1, query.data(), query.size());
+}
+
+/// Restore a discovery result persisted by a previous run.
+bool restoreDiscoveryResult(const std::string& query, DiscoveryResult& result) {
+  std::string content;
+  getDatabaseValue(kPersistentSettings, getDiscoveryKey(query), content);
+  auto details = osquery::split(content, ":");
+  if (details.size() != 2) {
+    return false;
+  }
+
+  auto const time = tryTo<uint64_t>(details[0], 10);
+  if (time.isError() || (details[1] != "0" && details[1] != "1")) {
+    return false;
+  }
+  result = std::make_pair(time.get(), details[1] == "1");
+  return true;
+}
+
+/// The INDEX columns of the only table a query reads, empty if unknown.
+std::vector<std::string> getIndexColumns(const std::string& query) {
+  std::vector<std::string> tables;
+  if (!getQueryTables(query, tables).ok() || tables.empty() ||
+      std::any_of(tables.begin(),
+                  tables.end(),
+                  [&tables](const std::string& table) {
+                    return table != tables.front();
+                  })) {
+    return {};
+  }
+
+  if (!Registry::get().exists("table", tables.front())) {
+    return {};
+  }
+  auto table = std::dynamic_pointer_cast<TablePlugin>(
+      Registry::get().plugin("table", tables.front()));
+  if (table == nullptr) {
+    return {};
+  }
+
+  std::vector<std::string> columns;
+  for (const auto& column : table->columns()) {
+    if (std::get<2>(column) & ColumnOptions::INDEX) {
+      columns.push_back(std::get<0>(column));
+    }
+  }
+  return columns;
+}
+
+/// The key columns of a query, a list of columns or true for the INDEX ones.
+std::vector<std::string> getQueryKeys(const rj::Value& key,
+                                      const std::string& query) {
+  std::vector<std::string> keys;
+  if (key.IsArray()) {
+    for (const auto& column : key.GetArray()) {
+      if (column.IsString()) {
+        keys.push_back(column.GetString());
+      }
+    }
+  } else if (key.IsString()) {
+    for (const auto& column : osquery::split(key.GetString(), ",")) {
+      keys.push_back(column);
+    }
+  } else if (JSON::valueToBool(key)) {
+    keys = getIndexColumns(query);
+  }
+  return keys;
+}
+
+} // namespace
+
+std::map<std::string, bool> evaluateDiscoveryQueries(
+    const std::vector<std::string>& queries) {
+  std::map<std::string, bool> evaluated;
+  std::vector<std::string> pending;
+  uint64_t current = osquery::getUnixTime();
+  auto fresh = [current](const DiscoveryResult& result) {
+    return result.first <= current &&
+           (current - result.first) < FLAGS_pack_refresh_interval;
+  };
+
+  auto& cache = getDiscoveryCache();
+  {
+    WriteLock lock(cache.mutex);
+    for (const auto& query : queries) {
+      if (evaluated.count(query) > 0) {
+        continue;
+      }
+
+      auto it = cache.results.find(query);
+      if (it == cache.results.end() || !fresh(it->second)) {
+        DiscoveryResult restored;
+        if (!restoreDiscoveryResult(query, restored) || !fresh(restored)) {
+          evaluated[query] = false;
+          pending.push_back(query);
+          continue;
+        }
+        it = cache.results.insert_or_assign(query, restored).first;
+      }
+      evaluated[query] = it->second.second;
+    }
+  }
+
+  if (pending.empty()) {
+    return evaluated;
+  }
+
+  // Failed queries are only kept in memory: the table may belong to an
+  // extension that has not registered yet when the daemon restarts.
+  std::vector<char> passed(pending.size(), false);
+  std::vector<char> failed(pending.size(), false);
+  std::atomic<size_t> next{0};
+  auto worker = [&pending, &passed, &failed, &next]() {
+    for (auto i = next++; i < pending.size(); i = next++) {
+      SQL results(pending[i]);
+      if (!results.ok()) {
+        LOG(WARNING) << "Discovery query failed (" << pending[i]
+                     << "): " << results.getMessageString();
+        failed[i] = true;
+      } else {
+        passed[i] = !results.rows().empty();
+      }
+    }
+  };
+
+  auto concurrency = std::min<size_t>(
+      std::max<uint64_t>(FLAGS_pack_discovery_concurrency, 1), pending.size());
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < concurrency; i++) {
+    workers.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : workers) {
+    thread.join();
+  }
+
+  WriteLock lock(cache.mutex);
+  for (size_t i = 0; i < pending.size(); i++) {
+    const auto& query = pending[i];
+    evaluated[query] = passed[i];
+    cache.results[query] = std::make_pair(current, passed[i] != 0);
+    if (!failed[i]) {
+      setDatabaseValue(kPersistentSettings,
+                       getDiscoveryKey(query),
+                       std::to_string(current) + ":" + (passed[i] ? "1" : "0"));
+    }
+  }
+  return evaluated;
+}
+
 void Pack::initialize(const std::string& name,
                       const std::string& source,
                       const rj::Value& obj) {
@@ -248,6 +427,32 @@ void Pack::initialize(const std::string& name,
       query.options["denylist"] = JSON::valueToBool(q.value["denylist"]);
     }
 
+    if (q.value.HasMember("max_wall_time_ms")) {
+      query.budget.wall_time_ms =
+          JSON::valueToSize(q.value["max_wall_time_ms"]);
+    }
+    if (q.value.HasMember("max_cpu_time_ms")) {
+      query.budget.cpu_time_ms = JSON::valueToSize(q.value["max_cpu_time_ms"]);
+    }
+    if (q.value.HasMember("max_rows")) {
+      query.budget.rows = JSON::valueToSize(q.value["max_rows"]);
+    }
+    if (q.value.HasMember("max_result_bytes")) {
+      query.budget.result_bytes =
+          JSON::valueToSize(q.value["max_result_bytes"]);
+    }
+
+    if (q.value.HasMember("key")) {
+      query.keys = getQueryKeys(q.value["key"], query.query);
+      if (query.keys.empty()) {
+        VLOG(1) << "No key columns found for query: " << q.name.GetString();
+      }
+    }
+
+    if (q.value.HasMember("scan_slice")) {
+      query.scan_slice = JSON::valueToSize(q.value["scan_slice"]);
+    }
+
     schedule_.emplace(std::make_pair(q.name.GetString(), std::move(query)));
   }
 }
@@ -320,17 +525,12 @@ bool Pack::checkDiscovery() {
   stats_.misses++;
   discovery_cache_.first = current;
   discovery_cache_.second = true;
-  for (const auto& q : discovery_queries_) {
-    SQL results(q);
-    if (!results.ok()) {
-      LOG(WARNING) << "Discovery query failed (" << q
-                   << "): " << results.getMessageString();
-      discovery_cache_.second = false;
-      break;
-    }
-    if (results.rows().size() == 0) {
-      discovery_cache_.second = false;
-      break;
+  if (!discovery_queries_.empty()) {
+    for (const auto& result : evaluateDiscoveryQueries(discovery_queries_)) {
+      if (!result.second) {
+        discovery_cache_.second = false;
+        break;
+      }
     }
   }
   return discovery_cache_.second;
@@ -183,4 +183,19 @@ uint64_t splayValue(uint64_t original, uint64_t splay_percent);
  * @return either the restored previous calculated splay, or a new splay.
  */
 uint64_t restoreSplayedValue(const std::string& name, uint64_t interval);
+
+/**
+ * @brief Evaluate pack discovery queries, sharing results across packs.
+ *
+ * A discovery query passes when it succeeds and returns at least one row.
+ * Identical query strings are executed once per "pack_refresh_interval", no
+ * matter how many packs use them. Passing and empty results are persisted so
+ * a restarted daemon can reuse them. Queries without a cached result are run
+ * concurrently, each on its own database connection.
+ *
+ * @param queries the discovery query strings, duplicates are allowed.
+ * @return a map of each distinct query string to its result.
+ */
+std::map<std::string, bool> evaluateDiscoveryQueries(
+    const std::vector<std::string>& queries);
 } // namespace osquery
@@ -44,6 +44,7 @@ namespace osquery {
 DECLARE_uint64(config_refresh);
 DECLARE_uint64(config_accelerated_refresh);
 DECLARE_bool(config_enable_backup);
+DECLARE_bool(config_warm_start);
 
 namespace fs = boost::filesystem;
 
@@ -52,6 +53,11 @@ extern void restoreScheduleDenylist(std::map<std::string, uint64_t>& denylist);
 extern void saveScheduleDenylist(
     const std::map<std::string, uint64_t>& denylist);
 
+// Cost-aware placement, internal to the config implementation.
+extern std::vector<uint64_t> placeQueries(
+    const std::vector<std::pair<uint64_t, uint64_t>>& queries,
+    uint64_t budget);
+
 class ConfigTests : public testing::Test {
  public:
   ConfigTests() {
@@ -413,17 +419,19 @@ TEST_F(ConfigTests, test_pack_stats) {
 
   // Add performance stats for a query.
   auto fullName = "pack_unrestricted_pack_process_events";
-  Row row;
-  row["user_time"] = "";
-  row["system_time"] = "";
-  row["resident_size"] = "";
-  get().recordQueryPerformance(fullName, 10, 10, row, row);
+  ResourceUsage r0;
+  ResourceUsage r1;
+  r1.user_time = 5;
+  get().recordQueryPerformance(fullName, 10, 10, 2, 100, r0, r1);
   bool statFound = false;
-  Config::get().getPerformanceStats(fullName,
-                                    [&statFound](const QueryPerformance& perf) {
-                                      ASSERT_EQ(perf.executions, 1U);
-                                      statFound = true;
-                                    });
+  Config::get().getPerformanceStats(
+      fullName, [&statFound](const QueryPerformance& perf) {
+        ASSERT_EQ(perf.executions, 1U);
+        ASSERT_EQ(perf.user_time, 5U);
+        ASSERT_EQ(perf.rows, 2U);
+        ASSERT_EQ(perf.last_result_bytes, 100U);
+        statFound = true;
+      });
   ASSERT_TRUE(statFound);
 
   // Update the query SQL and make sure performance stats were cleared.
@@ -559,6 +567,28 @@ TEST_F(ConfigTests, test_nondenylist_query) {
   EXPECT_FALSE(query->second);
 }
 
+TEST_F(ConfigTests, test_place_queries) {
+  // Two expensive queries on the same interval are launched at different
+  // steps, a cheap query fitting the budget keeps its natural step.
+  auto offsets = placeQueries({{60, 50}, {60, 50}, {60, 1}}, 60);
+  ASSERT_EQ(offsets.size(), 3U);
+  EXPECT_EQ(offsets[0], 0U);
+  EXPECT_NE(offsets[1], offsets[0]);
+  EXPECT_LT(offsets[1], 60U);
+  EXPECT_EQ(offsets[2], 0U);
+
+  // A query is only moved within its interval.
+  offsets = placeQueries({{10, 100}, {5, 100}}, 50);
+  EXPECT_LT(offsets[0], 10U);
+  EXPECT_LT(offsets[1], 5U);
+  EXPECT_NE(offsets[0] % 5, offsets[1]);
+
+  // Queries without a cost are not moved.
+  offsets = placeQueries({{60, 0}, {60, 0}}, 1);
+  EXPECT_EQ(offsets[0], 0U);
+  EXPECT_EQ(offsets[1], 0U);
+}
+
 class TestConfigParserPlugin : public ConfigParserPlugin {
  public:
   std::vector<std::string> keys() const override {
@@ -616,6 +646,55 @@ TEST_F(ConfigTests, test_get_parser) {
   rf.registry("config_parser")->remove("test");
 }
 
+TEST_F(ConfigTests, test_structural_update) {
+  auto& rf = RegistryFactory::get();
+  rf.registry("config_parser")
+      ->add("test", std::make_shared<TestConfigParserPlugin>());
+
+  auto packContent = [](size_t interval) {
+    return "{\"queries\": {\"q\": {\"query\": \"select 1\", "
+           "\"interval\": " +
+           std::to_string(interval) + "}}}";
+  };
+
+  std::map<std::string, std::string> config;
+  config["structural"] = "{\"list\": [1], \"packs\": {\"kept\": " +
+                         packContent(60) + ", \"changed\": " +
+                         packContent(60) + ", \"removed\": " +
+                         packContent(60) + "}}";
+  TestConfigParserPlugin::update_called = false;
+  ASSERT_TRUE(get().update(config).ok());
+  EXPECT_TRUE(TestConfigParserPlugin::update_called);
+
+  std::map<std::string, const Pack*> packs;
+  auto collect = [&packs](const Pack& pack) { packs[pack.getName()] = &pack; };
+  get().packs(collect);
+  ASSERT_EQ(packs.size(), 3U);
+  auto kept = packs["kept"];
+
+  // Only the packs and parser keys that changed are parsed again.
+  config["structural"] = "{\"list\": [1], \"packs\": {\"kept\": " +
+                         packContent(60) + ", \"changed\": " +
+                         packContent(120) + "}}";
+  TestConfigParserPlugin::update_called = false;
+  ASSERT_TRUE(get().update(config).ok());
+  EXPECT_FALSE(TestConfigParserPlugin::update_called);
+
+  packs.clear();
+  get().packs(collect);
+  ASSERT_EQ(packs.size(), 2U);
+  EXPECT_EQ(packs["kept"], kept);
+  ASSERT_EQ(packs.count("changed"), 1U);
+  EXPECT_EQ(packs["changed"]->getSchedule().at("q").interval, 120U);
+
+  // A changed key updates its parser.
+  config["structural"] = "{\"list\": [2]}";
+  ASSERT_TRUE(get().update(config).ok());
+  EXPECT_TRUE(TestConfigParserPlugin::update_called);
+
+  rf.registry("config_parser")->remove("test");
+}
+
 class PlaceboConfigParserPlugin : public ConfigParserPlugin {
  public:
   std::vector<std::string> keys() const override {
@@ -831,6 +910,37 @@ TEST_F(ConfigTests, test_config_backup_integrate) {
   FLAGS_config_enable_backup = config_enable_backup_saved;
 }
 
+TEST_F(ConfigTests, test_config_warm_start) {
+  auto& rf = RegistryFactory::get();
+  auto plugin = std::make_shared<TestConfigPlugin>();
+  auto data_parser = std::make_shared<TestDataConfigParserPlugin>();
+  rf.registry("config")->add("test_warm", plugin);
+  rf.registry("config_parser")->add("test_warm", data_parser);
+  EXPECT_TRUE(rf.setActive("config", "test_warm").ok());
+
+  get().reset();
+  resetDispatcher();
+  FLAGS_config_warm_start = true;
+  FLAGS_config_refresh = 60;
+  get().backupConfig({{"backup", "{\"data\":{\"warm\":true}}"}});
+
+  // The backed up config is used without waiting for the plugin.
+  plugin->fail_ = true;
+  ASSERT_TRUE(get().load(true).ok());
+  EXPECT_TRUE(get().started_thread_);
+  EXPECT_EQ(data_parser->source_, "backup");
+
+  // The refresh service fetches the config at once, not after the refresh.
+  waitForConfig(plugin, 0);
+  EXPECT_GT(plugin->gen_config_count_, 0U);
+  EXPECT_EQ(data_parser->source_, "backup");
+
+  resetDispatcher();
+  FLAGS_config_warm_start = false;
+  rf.registry("config")->remove("test_warm");
+  rf.registry("config_parser")->remove("test_warm");
+}
+
 TEST_F(ConfigTests, test_config_cli_flags) {
   get().reset();
 
@@ -16,6 +16,7 @@
 #include <osquery/core/flags.h>
 #include <osquery/core/system.h>
 #include <osquery/database/database.h>
+#include <osquery/hashing/hashing.h>
 #include <osquery/registry/registry.h>
 
 #include <osquery/filesystem/filesystem.h>
@@ -174,6 +175,32 @@ TEST_F(PacksTests, test_schedule) {
   EXPECT_EQ(fpack.getSchedule().size(), 1U);
 }
 
+TEST_F(PacksTests, test_query_budget) {
+  auto doc = JSON::newObject();
+  doc.fromString(
+      "{\"queries\": {"
+      "\"limited\": {\"query\": \"select 1\", \"interval\": 60, "
+      "\"max_wall_time_ms\": 500, \"max_cpu_time_ms\": 250, "
+      "\"max_rows\": 10, \"max_result_bytes\": 1024},"
+      "\"unlimited\": {\"query\": \"select 1\", \"interval\": 60}}}");
+  Pack pack("budget_pack", doc.doc());
+
+  const auto& schedule = pack.getSchedule();
+  ASSERT_EQ(schedule.count("limited"), 1U);
+  const auto& limited = schedule.at("limited").budget;
+  EXPECT_EQ(limited.wall_time_ms, 500U);
+  EXPECT_EQ(limited.cpu_time_ms, 250U);
+  EXPECT_EQ(limited.rows, 10U);
+  EXPECT_EQ(limited.result_bytes, 1024U);
+  EXPECT_TRUE(limited.timed());
+
+  ASSERT_EQ(schedule.count("unlimited"), 1U);
+  const auto& unlimited = schedule.at("unlimited").budget;
+  EXPECT_EQ(unlimited.rows, 0U);
+  EXPECT_EQ(unlimited.result_bytes, 0U);
+  EXPECT_FALSE(unlimited.timed());
+}
+
 TEST_F(PacksTests, test_discovery_cache) {
   Config c;
   // This pack and discovery query are valid, expect the SQL to execute.
@@ -201,6 +228,43 @@ TEST_F(PacksTests, test_discovery_cache) {
   c.reset();
 }
 
+TEST_F(PacksTests, test_evaluate_discovery_queries) {
+  std::vector<std::string> queries = {
+      "select 1;",
+      "select 1 where 0;",
+      "select 1;",
+      "select * from discovery_table_does_not_exist;",
+  };
+
+  auto results = evaluateDiscoveryQueries(queries);
+  ASSERT_EQ(results.size(), 3U);
+  EXPECT_TRUE(results["select 1;"]);
+  EXPECT_FALSE(results["select 1 where 0;"]);
+  EXPECT_FALSE(results["select * from discovery_table_does_not_exist;"]);
+
+  // Results of successful queries are persisted for the next run.
+  auto key = [](const std::string& query) {
+    return "discovery." +
+           hashFromBuffer(HASH_TYPE_SHA1, query.data(), query.size());
+  };
+  std::string content;
+  getDatabaseValue(kPersistentSettings, key("select 1;"), content);
+  ASSERT_GT(content.size(), 2U);
+  EXPECT_EQ(content.substr(content.size() - 2), ":1");
+  content.clear();
+  getDatabaseValue(kPersistentSettings, key("select 1 where 0;"), content);
+  ASSERT_GT(content.size(), 2U);
+  EXPECT_EQ(content.substr(content.size() - 2), ":0");
+  content.clear();
+  getDatabaseValue(kPersistentSettings,
+                   key("select * from discovery_table_does_not_exist;"),
+                   content);
+  EXPECT_TRUE(content.empty());
+
+  // Cached results are reused.
+  EXPECT_EQ(evaluateDiscoveryQueries(queries), results);
+}
+
 TEST_F(PacksTests, test_multi_pack) {
   std::string multi_pack_content = "{\"first\": {}, \"second\": {}}";
   auto multi_pack = JSON::newObject();
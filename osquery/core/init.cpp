@@ -140,6 +140,12 @@ FLAG(uint64,
      200,
      "Memory threshold in MB used to decide when a malloc_trim will be called "
      "to reduce the retained memory (Linux only)")
+
+FLAG(uint64,
+     malloc_trim_interval,
+     10,
+     "Minimum seconds between two checks of the malloc_trim_threshold "
+     "(Linux only)")
 #endif
 
 /// Should the daemon force unload previously-running osqueryd daemons.
@@ -150,6 +156,11 @@ CLI_FLAG(bool,
 
 FLAG(bool, ephemeral, false, "Skip pidfile and database state checks");
 
+CLI_FLAG(bool,
+         init_parallel,
+         false,
+         "Open the database while starting the extension manager");
+
 /// The path to the pidfile for osqueryd
 CLI_FLAG(string,
          pidfile,
@@ -673,6 +684,19 @@ void Initializer::initActivePlugin(const std::string& type,
   }
 }
 
+/// Open the database and ensure its results version is up to date.
+static Status openDatabase() {
+  auto status = initDatabasePlugin();
+  if (!status.ok()) {
+    return status;
+  }
+
+  if (!upgradeDatabase()) {
+    return Status::failure("Failed to upgrade database");
+  }
+  return Status::success();
+}
+
 void Initializer::start() const {
   // Pre-extension manager initialization options checking.
   // If the shell or daemon does not need extensions and it will exit quickly,
@@ -682,21 +706,32 @@ void Initializer::start() const {
     FLAGS_disable_extensions = true;
   }
 
+  // The database may be opened and upgraded while the extension manager
+  // waits for the extensions to register, neither depends on the other.
+  std::future<Status> database;
   if (!isWatcher()) {
     setDatabaseAllowOpen();
-    auto status = initDatabasePlugin();
+    database = std::async(
+        FLAGS_init_parallel ? std::launch::async : std::launch::deferred,
+        openDatabase);
+  }
+
+  auto database_ready = [&database]() {
+    if (!database.valid()) {
+      return true;
+    }
+
+    auto status = database.get();
     if (!status.ok()) {
       auto retcode = (isWorker()) ? EXIT_CATASTROPHIC : EXIT_FAILURE;
       requestShutdown(retcode, status.getMessage());
-      return;
+      return false;
     }
+    return true;
+  };
 
-    // Ensure the database results version is up to date before proceeding
-    if (!upgradeDatabase()) {
-      auto retcode = (isWorker()) ? EXIT_CATASTROPHIC : EXIT_FAILURE;
-      requestShutdown(retcode, "Failed to upgrade database");
-      return;
-    }
+  if (!FLAGS_init_parallel && !database_ready()) {
+    return;
   }
 
   // Bind to an extensions socket and wait for registry additions.
@@ -716,7 +751,8 @@ void Initializer::start() const {
     }
   }
 
-  if (shutdownRequested()) {
+  // The config plugin may use the database, such as for a node key.
+  if (!database_ready() || shutdownRequested()) {
     return;
   }
 
@@ -753,7 +789,8 @@ void Initializer::start() const {
   }
 
   // Load the osquery config using the default/active config plugin.
-  s = Config::get().load();
+  // A worker restarted by the watcher may start from the last config.
+  s = Config::get().load(isWorker());
   if (!s.ok()) {
     auto message = "Error reading config: " + s.toString();
     if (isDaemon()) {
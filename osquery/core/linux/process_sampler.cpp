@@ -0,0 +1,189 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "osquery/core/linux/process_sampler.h"
+
+#ifndef SYS_pidfd_open
+// The system call number is shared by every architecture.
+#define SYS_pidfd_open 434
+#endif
+
+namespace osquery {
+
+namespace {
+
+const uint64_t kMSIn1CLKTCK = (1000 / sysconf(_SC_CLK_TCK));
+
+const uint64_t kPageSize = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+
+/// Read a whole /proc file through an open descriptor.
+bool readProcFile(int fd, char* buffer, size_t size) {
+  auto bytes = ::pread(fd, buffer, size - 1, 0);
+  if (bytes <= 0) {
+    return false;
+  }
+  buffer[bytes] = '\0';
+  return true;
+}
+
+int openProcFile(pid_t pid, const char* name) {
+  auto path = "/proc/" + std::to_string(pid) + "/" + name;
+  return ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+}
+} // namespace
+
+ProcessSampler::~ProcessSampler() {
+  for (auto& handle : handles_) {
+    close(handle.second);
+  }
+}
+
+Status ProcessSampler::sample(pid_t pid, ProcessSample& sample) {
+  WriteLock lock(mutex_);
+  auto it = handles_.find(pid);
+  if (it != handles_.end()) {
+    if (!exited(it->second) && read(it->second, sample)) {
+      return Status::success();
+    }
+
+    // The process exited, the pid may belong to a new process.
+    close(it->second);
+    handles_.erase(it);
+  }
+
+  // New processes are rare, a respawned worker or extension.
+  prune();
+
+  Handle handle;
+  if (!open(pid, handle)) {
+    close(handle);
+    return Status::failure("Cannot open process " + std::to_string(pid));
+  }
+
+  if (!read(handle, sample)) {
+    close(handle);
+    return Status::failure("Cannot read process " + std::to_string(pid));
+  }
+
+  handles_[pid] = handle;
+  return Status::success();
+}
+
+void ProcessSampler::forget(pid_t pid) {
+  WriteLock lock(mutex_);
+  auto it = handles_.find(pid);
+  if (it != handles_.end()) {
+    close(it->second);
+    handles_.erase(it);
+  }
+}
+
+void ProcessSampler::prune() {
+  for (auto it = handles_.begin(); it != handles_.end();) {
+    auto gone = (it->second.pidfd >= 0)
+                    ? exited(it->second)
+                    : (::kill(it->first, 0) != 0 && errno == ESRCH);
+    if (gone) {
+      close(it->second);
+      it = handles_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+bool ProcessSampler::open(pid_t pid, Handle& handle) {
+  // Kernels before 5.3 have no pidfd, a failed read detects the exit.
+  handle.pidfd = static_cast<int>(::syscall(SYS_pidfd_open, pid, 0));
+  handle.stat_fd = openProcFile(pid, "stat");
+  handle.statm_fd = openProcFile(pid, "statm");
+  return handle.stat_fd >= 0 && handle.statm_fd >= 0;
+}
+
+void ProcessSampler::close(Handle& handle) {
+  for (auto fd : {handle.pidfd, handle.stat_fd, handle.statm_fd}) {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+  handle = Handle();
+}
+
+bool ProcessSampler::exited(const Handle& handle) {
+  if (handle.pidfd < 0) {
+    return false;
+  }
+
+  // A pidfd becomes readable when its process exits.
+  struct pollfd fds;
+  fds.fd = handle.pidfd;
+  fds.events = POLLIN;
+  fds.revents = 0;
+  return ::poll(&fds, 1, 0) > 0 && (fds.revents & POLLIN) != 0;
+}
+
+bool ProcessSampler::read(const Handle& handle, ProcessSample& sample) {
+  char buffer[1024];
+  if (!readProcFile(handle.stat_fd, buffer, sizeof(buffer))) {
+    return false;
+  }
+
+  // The command name may contain spaces and parentheses, skip past it.
+  const char* fields = std::strrchr(buffer, ')');
+  if (fields == nullptr) {
+    return false;
+  }
+
+  // The fields following the command name start with the state.
+  char state = 0;
+  long long parent = 0;
+  unsigned long long user_ticks = 0;
+  unsigned long long system_ticks = 0;
+  auto matched = std::sscanf(fields + 1,
+                             " %c %lld %*s %*s %*s %*s %*s %*s %*s %*s %*s "
+                             "%llu %llu",
+                             &state,
+                             &parent,
+                             &user_ticks,
+                             &system_ticks);
+  if (matched != 4) {
+    return false;
+  }
+
+  if (!readProcFile(handle.statm_fd, buffer, sizeof(buffer))) {
+    return false;
+  }
+
+  unsigned long long total_pages = 0;
+  unsigned long long resident_pages = 0;
+  if (std::sscanf(buffer, "%llu %llu", &total_pages, &resident_pages) != 2) {
+    return false;
+  }
+
+  sample.parent = static_cast<pid_t>(parent);
+  sample.user_time = user_ticks * kMSIn1CLKTCK;
+  sample.system_time = system_ticks * kMSIn1CLKTCK;
+  sample.resident_size = resident_pages * kPageSize;
+  sample.total_size = total_pages * kPageSize;
+  return true;
+}
+
+} // namespace osquery
@@ -0,0 +1,89 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <map>
+
+#include <osquery/utils/mutex.h>
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/// The CPU time and memory of a process, as the processes table reports them.
+struct ProcessSample {
+  /// Process ID of the parent process.
+  pid_t parent{0};
+
+  /// User and system CPU time in milliseconds.
+  uint64_t user_time{0};
+  uint64_t system_time{0};
+
+  /// Resident and virtual memory in bytes.
+  uint64_t resident_size{0};
+  uint64_t total_size{0};
+};
+
+/**
+ * @brief Samples the resources of the watched processes.
+ *
+ * The watcher checks the worker and every extension each interval. Instead
+ * of querying the processes table, the sampler keeps /proc/<pid>/stat and
+ * /proc/<pid>/statm open per process and reads them with pread, which costs
+ * two system calls per sample.
+ *
+ * A pidfd is held when the kernel supports it, a process that exited is
+ * detected without reading and its descriptors are reopened, so a reused
+ * pid is never read through the descriptors of the previous process.
+ */
+class ProcessSampler {
+ public:
+  ProcessSampler() = default;
+  ~ProcessSampler();
+
+  ProcessSampler(const ProcessSampler&) = delete;
+  ProcessSampler& operator=(const ProcessSampler&) = delete;
+
+  /// Sample a process, fails if the process does not exist.
+  Status sample(pid_t pid, ProcessSample& sample);
+
+  /// Close the descriptors of a process.
+  void forget(pid_t pid);
+
+ private:
+  struct Handle {
+    int pidfd{-1};
+    int stat_fd{-1};
+    int statm_fd{-1};
+  };
+
+  /// Close the descriptors of processes that exited, the caller holds the lock.
+  void prune();
+
+  /// Open the descriptors of a process.
+  static bool open(pid_t pid, Handle& handle);
+
+  static void close(Handle& handle);
+
+  /// Check if the process of a handle exited, using its pidfd.
+  static bool exited(const Handle& handle);
+
+  /// Read the process of a handle.
+  static bool read(const Handle& handle, ProcessSample& sample);
+
+ private:
+  Mutex mutex_;
+
+  std::map<pid_t, Handle> handles_;
+};
+
+} // namespace osquery
@@ -62,6 +62,8 @@ Status LoggerPlugin::call(const PluginRequest& request,
     return this->logStatus(intermediate_logs);
   } else if (request.count("event") > 0) {
     return this->logEvent(request.at("event"));
+  } else if (request.count("event_batch") > 0) {
+    return this->logEventBatch(request.at("event_batch"));
   } else if (request.count("action") && request.at("action") == "features") {
     size_t features = 0;
     features |= (usesLogStatus()) ? LOGGER_FEATURE_LOGSTATUS : 0;
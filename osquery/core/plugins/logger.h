@@ -197,6 +197,34 @@ class LoggerPlugin : public Plugin {
     return Status(1, "Not enabled");
   }
 
+  /**
+   * @brief Optionally handle a batch of forwarded events.
+   *
+   * The batch is a JSON array of the serialized rows, by default each row is
+   * passed to logEvent. Loggers sending events over the network may send the
+   * batch at once.
+   */
+  virtual Status logEventBatch(const std::string& event_batch) {
+    rapidjson::Document doc;
+    if (doc.Parse(event_batch).HasParseError() || !doc.IsArray()) {
+      return Status::failure("Invalid event batch passed to logEventBatch");
+    }
+
+    std::size_t error_count{};
+    for (auto& event : doc.GetArray()) {
+      if (!event.IsString() || !logEvent(event.GetString()).ok()) {
+        ++error_count;
+      }
+    }
+
+    if (error_count != 0) {
+      return Status::failure("logEventBatch has failed to log " +
+                             std::to_string(error_count) + " events");
+    }
+
+    return Status::success();
+  }
+
   /**
    * @brief Optionally handle a batch of published events via the logger.
    *
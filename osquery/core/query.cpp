@@ -14,9 +14,13 @@
 #include <osquery/core/flagalias.h>
 #include <osquery/core/flags.h>
 #include <osquery/core/query.h>
+#include <osquery/core/sql/columnar_results.h>
+#include <osquery/core/sql/query_state.h>
 #include <osquery/database/database.h>
 #include <osquery/logger/logger.h>
 
+#include <osquery/utils/conversions/split.h>
+#include <osquery/utils/conversions/tryto.h>
 #include <osquery/utils/json/json.h>
 
 namespace rj = rapidjson;
@@ -32,36 +36,116 @@ FLAG(bool,
      "Use numeric JSON syntax for numeric values");
 FLAG_ALIAS(bool, log_numerics_as_numbers, logger_numerics);
 
-uint64_t Query::getPreviousEpoch() const {
-  uint64_t epoch = 0;
+FLAG(bool,
+     fingerprint_differential,
+     false,
+     "Calculate scheduled query differentials using row fingerprints");
+
+/// Suffix of the kQueries key holding the fingerprints of a query's results.
+const std::string kFingerprintsSuffix{"fingerprints"};
+
+/// Suffix of the kQueries key holding the digest of a query's last snapshot.
+const std::string kSnapshotSuffix{"snapshot"};
+
+/// Suffix of the kQueries key holding the progress of a sliced scan.
+const std::string kScanSuffix{"scan"};
+
+/// Suffix of the kQueries key holding the QueryState of a query.
+const std::string kStateSuffix{"state"};
+
+namespace {
+/**
+ * @brief Read the state of a query.
+ *
+ * States stored before the QueryState record are read from the separate
+ * epoch, counter and query text values.
+ *
+ * @return false if no state is stored, this is the first run of the query.
+ */
+bool readQueryState(const std::string& name, QueryState& state) {
   std::string raw;
-  auto status = getDatabaseValue(kQueries, name_ + "epoch", raw);
-  if (status.ok()) {
-    epoch = std::stoull(raw);
+  if (getDatabaseValue(kQueries, name + kStateSuffix, raw).ok()) {
+    auto status = QueryState::decode(raw, state);
+    if (status.ok()) {
+      return true;
+    }
+    LOG(WARNING) << "Ignoring the state of scheduled query " << name << ": "
+                 << status.getMessage();
+    return false;
   }
-  return epoch;
+
+  if (!getDatabaseValue(kQueries, name + "epoch", raw).ok()) {
+    return false;
+  }
+  state.epoch = tryTo<uint64_t>(raw).takeOr(uint64_t{0});
+  if (getDatabaseValue(kQueries, name + "counter", raw).ok()) {
+    state.counter = tryTo<uint64_t>(raw).takeOr(uint64_t{0});
+    state.has_counter = true;
+  }
+  getDatabaseValue(kQueries, "query." + name, state.query);
+
+  // The fingerprints were deleted whenever they were no longer current.
+  state.has_fingerprints = true;
+  return true;
 }
 
-uint64_t Query::getQueryCounter(bool is_reset,
-                                bool reset_has_all_records) const {
-  uint64_t counter = 0;
+/// Write the state of a query in one batch with the values that go with it.
+Status writeQueryState(const std::string& name,
+                       const QueryState& state,
+                       DatabaseStringValueList values = {}) {
+  values.emplace_back(name + kStateSuffix, state.encode());
+  return setDatabaseBatch(kQueries, values);
+}
+
+/// The counter following the state, see Query::getQueryCounter.
+uint64_t nextQueryCounter(const QueryState& state,
+                          bool is_reset,
+                          bool reset_has_all_records) {
   if (is_reset) {
-    if (reset_has_all_records) {
-      return counter;
-    } else {
-      // If it's a reset but not returning all records, start with 1 instead of
-      // 0. This allows consumers to reliably distinguish between differential
-      // results and results with all records.
-      return counter + 1;
+    // If it's a reset but not returning all records, start with 1 instead of
+    // 0. This allows consumers to reliably distinguish between differential
+    // results and results with all records.
+    return reset_has_all_records ? 0 : 1;
+  }
+  return state.has_counter ? state.counter + 1 : 0;
+}
+
+/// Digest the row fingerprints, sorted so the order of the rows is ignored.
+std::string digestQueryData(const QueryDataTyped& qd) {
+  auto fingerprints = fingerprintQueryData(qd);
+  std::sort(fingerprints.begin(), fingerprints.end());
+
+  // FNV-1a over the little-endian bytes of the fingerprints.
+  uint64_t digest = 14695981039346656037ULL;
+  for (auto fingerprint : fingerprints) {
+    for (size_t i = 0; i < sizeof(uint64_t); ++i) {
+      digest ^= (fingerprint >> (i * 8)) & 0xFF;
+      digest *= 1099511628211ULL;
     }
   }
 
-  std::string raw;
-  auto status = getDatabaseValue(kQueries, name_ + "counter", raw);
-  if (status.ok()) {
-    counter = std::stoull(raw) + 1;
+  char hex[17];
+  snprintf(hex,
+           sizeof(hex),
+           "%016llx",
+           static_cast<unsigned long long>(digest));
+  return hex;
+}
+} // namespace
+
+uint64_t Query::getPreviousEpoch() const {
+  QueryState state;
+  readQueryState(name_, state);
+  return state.epoch;
+}
+
+uint64_t Query::getQueryCounter(bool is_reset,
+                                bool reset_has_all_records) const {
+  QueryState state;
+  if (!is_reset) {
+    readQueryState(name_, state);
   }
-  return counter;
+  return nextQueryCounter(state, is_reset, reset_has_all_records);
 }
 
 Status Query::getPreviousQueryResults(QueryDataSet& results) const {
@@ -71,20 +155,195 @@ Status Query::getPreviousQueryResults(QueryDataSet& results) const {
     return status;
   }
 
-  status = deserializeQueryDataJSON(raw, results);
+  status = deserializeStoredQueryData(raw, results);
   if (!status.ok()) {
     return status;
   }
   return Status::success();
 }
 
-Status Query::saveQueryResults(const std::string& json, uint64_t epoch) const {
-  auto status = setDatabaseValue(kQueries, name_, json);
+Status Query::getPreviousFingerprints(RowFingerprints& fingerprints) const {
+  QueryState state;
+  readQueryState(name_, state);
+  return getPreviousFingerprints(state, fingerprints);
+}
+
+Status Query::getPreviousFingerprints(const QueryState& state,
+                                      RowFingerprints& fingerprints) const {
+  std::string raw;
+  Status status;
+  if (state.has_fingerprints) {
+    status = getDatabaseValue(kQueries, name_ + kFingerprintsSuffix, raw);
+    if (status.ok()) {
+      return deserializeRowFingerprints(raw, fingerprints);
+    }
+  }
+
+  // The results were stored by the multiset differential, fingerprint them.
+  status = getDatabaseValue(kQueries, name_, raw);
   if (!status.ok()) {
     return status;
   }
 
-  return setDatabaseValue(kQueries, name_ + "epoch", std::to_string(epoch));
+  if (ColumnarResults::isEncoded(raw)) {
+    ColumnarResults previous;
+    status = ColumnarResults::decode(raw, previous);
+    if (!status.ok()) {
+      return status;
+    }
+
+    fingerprints.clear();
+    fingerprints.reserve(previous.rows());
+    for (size_t i = 0; i < previous.rows(); ++i) {
+      fingerprints.push_back(previous.fingerprint(i));
+    }
+    return Status::success();
+  }
+
+  QueryDataTyped previous_qd;
+  status = deserializeQueryDataJSON(raw, previous_qd);
+  if (!status.ok()) {
+    return status;
+  }
+  fingerprints = fingerprintQueryData(previous_qd);
+  return Status::success();
+}
+
+Status Query::getPreviousRows(const std::vector<size_t>& indexes,
+                              size_t expected_rows,
+                              QueryDataTyped& rows) const {
+  std::string raw;
+  auto status = getDatabaseValue(kQueries, name_, raw);
+  if (!status.ok()) {
+    return status;
+  }
+
+  if (ColumnarResults::isEncoded(raw)) {
+    // Only the requested rows are materialized.
+    ColumnarResults previous;
+    status = ColumnarResults::decode(raw, previous);
+    if (!status.ok()) {
+      return status;
+    }
+
+    if (previous.rows() != expected_rows) {
+      return Status::failure("Stored results do not match their fingerprints");
+    }
+
+    rows.reserve(rows.size() + indexes.size());
+    for (auto index : indexes) {
+      rows.push_back(previous.row(index));
+    }
+    return Status::success();
+  }
+
+  QueryDataTyped previous_qd;
+  status = deserializeQueryDataJSON(raw, previous_qd);
+  if (!status.ok()) {
+    return status;
+  }
+
+  // The stored rows must align with the stored fingerprints.
+  if (previous_qd.size() != expected_rows) {
+    return Status::failure("Stored results do not match their fingerprints");
+  }
+
+  rows.reserve(rows.size() + indexes.size());
+  for (auto index : indexes) {
+    rows.push_back(std::move(previous_qd[index]));
+  }
+  return Status::success();
+}
+
+Status Query::saveQueryResults(const std::string& results,
+                               uint64_t epoch) const {
+  QueryState state;
+  readQueryState(name_, state);
+  state.epoch = epoch;
+  state.has_fingerprints = false;
+  return writeQueryState(name_, state, {{name_, results}});
+}
+
+Status Query::dedupSnapshot(const QueryDataTyped& results,
+                            uint64_t time,
+                            uint64_t full_interval,
+                            std::string& digest,
+                            uint64_t& unchanged_since) const {
+  digest = digestQueryData(results);
+  unchanged_since = 0;
+
+  // The digest is stored as digest:since:time of the last full snapshot.
+  uint64_t since = time;
+  std::string raw;
+  if (getDatabaseValue(kQueries, name_ + kSnapshotSuffix, raw).ok()) {
+    auto fields = split(raw, ":");
+    if (fields.size() == 3 && fields[0] == digest) {
+      since = tryTo<uint64_t>(fields[1]).takeOr(time);
+      auto last_full = tryTo<uint64_t>(fields[2]).takeOr(uint64_t{0});
+      if (full_interval == 0 || time < last_full + full_interval) {
+        unchanged_since = since;
+        return Status::success();
+      }
+    }
+  }
+
+  return setDatabaseValue(kQueries,
+                          name_ + kSnapshotSuffix,
+                          digest + ":" + std::to_string(since) + ":" +
+                              std::to_string(time));
+}
+
+Status Query::getStoredResults(QueryDataTyped& results,
+                               QueryState& state) const {
+  if (!readQueryState(name_, state)) {
+    return Status::failure("No results are stored");
+  }
+  if (state.query != query_) {
+    return Status::failure("The results are stored for a previous query");
+  }
+
+  std::string raw;
+  auto status = getDatabaseValue(kQueries, name_, raw);
+  if (!status.ok()) {
+    return status;
+  }
+  return deserializeStoredQueryData(raw, results);
+}
+
+Status Query::getScanProgress(ScanProgress& progress) const {
+  progress = ScanProgress();
+
+  // The progress is stored as slice:time: followed by the cursor.
+  std::string raw;
+  auto status = getDatabaseValue(kQueries, name_ + kScanSuffix, raw);
+  if (!status.ok()) {
+    return Status::success();
+  }
+
+  auto first = raw.find(':');
+  auto second =
+      first == std::string::npos ? first : raw.find(':', first + 1);
+  if (second == std::string::npos) {
+    return Status::failure("Invalid scan progress");
+  }
+
+  progress.slice = tryTo<uint64_t>(raw.substr(0, first)).takeOr(uint64_t{0});
+  progress.time = tryTo<uint64_t>(raw.substr(first + 1, second - first - 1))
+                      .takeOr(uint64_t{0});
+  progress.cursor = raw.substr(second + 1);
+  return Status::success();
+}
+
+Status Query::setScanProgress(const ScanProgress& progress) const {
+  if (progress.slice == 0) {
+    return deleteDatabaseValue(kQueries, name_ + kScanSuffix);
+  }
+
+  return setDatabaseValue(kQueries,
+                          name_ + kScanSuffix,
+                          std::to_string(progress.slice) + ":" +
+                              std::to_string(progress.time) + ":" +
+                              progress.cursor);
 }
 
 std::vector<std::string> Query::getStoredQueryNames() {
@@ -98,43 +357,48 @@ bool Query::isQueryNameInDatabase() const {
   return std::find(names.begin(), names.end(), name_) != names.end();
 }
 
-static inline void saveQuery(const std::string& name,
-                             const std::string& query) {
-  setDatabaseValue(kQueries, "query." + name, query);
+bool Query::isNewQuerySql() const {
+  QueryState state;
+  readQueryState(name_, state);
+  return (state.query != query_);
 }
 
-bool Query::isNewQuerySql() const {
-  std::string query;
-  getDatabaseValue(kQueries, "query." + name_, query);
-  return (query != query_);
+void Query::getQueryStatus(uint64_t epoch,
+                           bool& new_query_epoch,
+                           bool& new_query_sql) const {
+  QueryState state;
+  getQueryStatus(epoch, state, new_query_epoch, new_query_sql);
 }
 
 void Query::getQueryStatus(uint64_t epoch,
+                           QueryState& state,
                            bool& new_query_epoch,
                            bool& new_query_sql) const {
-  if (!isQueryNameInDatabase()) {
+  if (!readQueryState(name_, state)) {
     // This is the first encounter of the scheduled query.
     new_query_epoch = true;
     new_query_sql = true;
     LOG(INFO) << "Storing initial results for new scheduled query: " << name_;
-    saveQuery(name_, query_);
-  } else if (getPreviousEpoch() != epoch) {
+  } else if (state.epoch != epoch) {
     new_query_epoch = true;
     LOG(INFO) << "New Epoch " << epoch << " for scheduled query " << name_;
-  } else if (isNewQuerySql()) {
+  } else if (state.query != query_) {
     // This query sql is 'new' indicating that the previous results may be
     // invalid.
     new_query_sql = true;
     LOG(INFO) << "Scheduled query has been updated: " + name_;
-    saveQuery(name_, query_);
   }
 }
 
 Status Query::incrementCounter(bool is_reset,
                                bool reset_has_all_records,
                                uint64_t& counter) const {
-  counter = getQueryCounter(is_reset, reset_has_all_records);
-  return setDatabaseValue(kQueries, name_ + "counter", std::to_string(counter));
+  QueryState state;
+  readQueryState(name_, state);
+  counter = nextQueryCounter(state, is_reset, reset_has_all_records);
+  state.counter = counter;
+  state.has_counter = true;
+  return writeQueryState(name_, state);
 }
 
 Status Query::addNewEvents(QueryDataTyped current_qd,
@@ -143,19 +407,28 @@ Status Query::addNewEvents(QueryDataTyped current_qd,
                            DiffResults& dr) const {
   bool new_query_epoch = false;
   bool new_query_sql = false;
-  getQueryStatus(current_epoch, new_query_epoch, new_query_sql);
+  QueryState state;
+  getQueryStatus(current_epoch, state, new_query_epoch, new_query_sql);
+
+  DatabaseStringValueList values;
   if (new_query_epoch) {
-    auto status = saveQueryResults("[]", current_epoch);
-    if (!status.ok()) {
-      return status;
-    }
+    std::string empty;
+    ColumnarResults::encode(QueryDataTyped{}, empty);
+    values.emplace_back(name_, std::move(empty));
+    state.epoch = current_epoch;
+    state.has_fingerprints = false;
   }
+
   dr.added = std::move(current_qd);
   if (!dr.added.empty()) {
-    auto status = incrementCounter(new_query_epoch, false, counter);
-    if (!status.ok()) {
-      return status;
-    }
+    counter = nextQueryCounter(state, new_query_epoch, false);
+    state.counter = counter;
+    state.has_counter = true;
+  }
+
+  if (new_query_epoch || new_query_sql || !dr.added.empty()) {
+    state.query = query_;
+    return writeQueryState(name_, state, std::move(values));
   }
   return Status::success();
 }
@@ -164,9 +437,15 @@ Status Query::addNewResults(QueryDataTyped current_qd,
                             const uint64_t current_epoch,
                             uint64_t& counter,
                             DiffResults& dr) const {
+  if (FLAGS_fingerprint_differential) {
+    return addNewFingerprintResults(
+        std::move(current_qd), current_epoch, counter, dr);
+  }
+
   bool new_query_epoch = false;
   bool new_query_sql = false;
-  getQueryStatus(current_epoch, new_query_epoch, new_query_sql);
+  QueryState state;
+  getQueryStatus(current_epoch, state, new_query_epoch, new_query_sql);
 
   // Use a 'target' avoid copying the query data when serializing and saving.
   // If a differential is requested and needed the target remains the original
@@ -185,32 +464,143 @@ Status Query::addNewResults(QueryDataTyped current_qd,
     dr = diff(previous_qd, current_qd);
 
     update_db = (!dr.added.empty() || !dr.removed.empty());
+    diffChangedRows(keys_, dr);
   } else {
     dr.added = std::move(current_qd);
     target_gd = &dr.added;
   }
 
+  DatabaseStringValueList values;
   if (update_db) {
     // Replace the "previous" query data with the current.
-    std::string json;
-    auto status = serializeQueryDataJSON(*target_gd, json, true);
+    std::string encoded;
+    ColumnarResults::encode(*target_gd, encoded);
+    values.emplace_back(name_, std::move(encoded));
+    state.epoch = current_epoch;
+
+    // Fingerprints from a previous differential mode are no longer current.
+    state.has_fingerprints = false;
+  }
+
+  return saveResultsState(state,
+                          std::move(values),
+                          update_db,
+                          new_query_epoch,
+                          new_query_sql,
+                          counter);
+}
+
+/// Rows of a new epoch are reported as added.
+static void takeAddedRows(QueryDataTyped& current, QueryDataTyped& added) {
+  added = std::move(current);
+}
+
+static void takeAddedRows(FlatQueryData& current, QueryDataTyped& added) {
+  current.moveToQueryData(added);
+}
+
+Status Query::addNewResults(FlatQueryData current_qd,
+                            const uint64_t current_epoch,
+                            uint64_t& counter,
+                            DiffResults& dr) const {
+  if (FLAGS_fingerprint_differential) {
+    return addNewFingerprintResults(
+        std::move(current_qd), current_epoch, counter, dr);
+  }
+
+  // The multiset differential compares complete rows.
+  QueryDataTyped rows;
+  current_qd.moveToQueryData(rows);
+  return addNewResults(std::move(rows), current_epoch, counter, dr);
+}
+
+template <typename Results>
+Status Query::addNewFingerprintResults(Results current_qd,
+                                       const uint64_t current_epoch,
+                                       uint64_t& counter,
+                                       DiffResults& dr) const {
+  bool new_query_epoch = false;
+  bool new_query_sql = false;
+  QueryState state;
+  getQueryStatus(current_epoch, state, new_query_epoch, new_query_sql);
+
+  auto current_fingerprints = fingerprintQueryData(current_qd);
+  bool update_db = true;
+  if (!new_query_epoch) {
+    RowFingerprints previous_fingerprints;
+    auto status = getPreviousFingerprints(state, previous_fingerprints);
     if (!status.ok()) {
       return status;
     }
 
-    status = saveQueryResults(json, current_epoch);
-    if (!status.ok()) {
-      return status;
+    // Only the added rows are materialized from the current results.
+    std::vector<size_t> removed;
+    dr = diff(previous_fingerprints, current_fingerprints, current_qd, removed);
+
+    // Removed rows are only read back from storage if they are reported, or
+    // may be changed rows.
+    if (!removed.empty() && (report_removed_ || !keys_.empty())) {
+      status =
+          getPreviousRows(removed, previous_fingerprints.size(), dr.removed);
+      if (!status.ok()) {
+        VLOG(1) << "Cannot report removed rows for scheduled query " << name_
+                << ": " << status.getMessage();
+      }
     }
+
+    update_db = (!dr.added.empty() || !removed.empty());
+    diffChangedRows(keys_, dr);
   }
 
-  if (update_db || new_query_epoch) {
-    auto status = incrementCounter(new_query_epoch, true, counter);
-    if (!status.ok()) {
-      return status;
+  DatabaseStringValueList values;
+  if (update_db) {
+    // The rows are only needed to reconstruct removed rows, when they are not
+    // reported an empty set keeps the stored value valid for other modes.
+    std::string encoded;
+    if (report_removed_ || !keys_.empty()) {
+      ColumnarResults::encode(current_qd, encoded);
+    } else {
+      ColumnarResults::encode(QueryDataTyped{}, encoded);
     }
+
+    std::string fingerprints;
+    serializeRowFingerprints(current_fingerprints, fingerprints);
+    values.emplace_back(name_ + kFingerprintsSuffix, std::move(fingerprints));
+    values.emplace_back(name_, std::move(encoded));
+    state.epoch = current_epoch;
+    state.has_fingerprints = true;
   }
-  return Status::success();
+
+  if (new_query_epoch) {
+    takeAddedRows(current_qd, dr.added);
+  }
+
+  return saveResultsState(state,
+                          std::move(values),
+                          update_db,
+                          new_query_epoch,
+                          new_query_sql,
+                          counter);
+}
+
+Status Query::saveResultsState(QueryState& state,
+                               DatabaseStringValueList values,
+                               bool update_db,
+                               bool new_query_epoch,
+                               bool new_query_sql,
+                               uint64_t& counter) const {
+  if (update_db || new_query_epoch) {
+    counter = nextQueryCounter(state, new_query_epoch, true);
+    state.counter = counter;
+    state.has_counter = true;
+  } else if (!new_query_sql) {
+    // Nothing changed since the previous execution.
+    return Status::success();
+  }
+
+  // The results, fingerprints and state are written in one batch.
+  state.query = query_;
+  return writeQueryState(name_, state, std::move(values));
 }
 
 Status deserializeDiffResults(const rj::Value& doc, DiffResults& dr) {
@@ -231,6 +621,13 @@ Status deserializeDiffResults(const rj::Value& doc, DiffResults& dr) {
       return status;
     }
   }
+
+  if (doc.HasMember("changed")) {
+    auto status = deserializeQueryData(doc["changed"], dr.changed);
+    if (!status.ok()) {
+      return status;
+    }
+  }
   return Status::success();
 }
 
@@ -279,6 +676,106 @@ inline void getLegacyFieldsAndDecorations(const JSON& doc, QueryLogItem& item) {
   item.time = doc.doc()["unixTime"].GetUint64();
 }
 
+namespace {
+
+/// Top-level decorations replace the fields of the same name.
+bool isDecorated(const QueryLogItem& item, const char* key) {
+  return FLAGS_decorations_top_level && !item.decorations.empty() &&
+         item.decorations.count(key) > 0;
+}
+
+void writeString(JSONWriter& writer, const std::string& str) {
+  writer.String(str.data(), static_cast<rj::SizeType>(str.size()));
+}
+
+/// Stream the digest of a deduplicated snapshot, and when it was unchanged.
+void writeSnapshotDigest(const QueryLogItem& item, JSONWriter& writer) {
+  if (item.unchanged_since != 0 && !isDecorated(item, "unchanged_since")) {
+    writer.Key("unchanged_since");
+    writer.Uint64(item.unchanged_since);
+  }
+  if (!item.snapshot_digest.empty() && !isDecorated(item, "snapshot_digest")) {
+    writer.Key("snapshot_digest");
+    writeString(writer, item.snapshot_digest);
+  }
+}
+
+/// Stream the slice of a sliced scan the snapshot results are from.
+void writeScanSlice(const QueryLogItem& item, JSONWriter& writer) {
+  if (item.scan_slice == 0) {
+    return;
+  }
+  if (!isDecorated(item, "scan_slice")) {
+    writer.Key("scan_slice");
+    writer.Uint64(item.scan_slice);
+  }
+  if (!isDecorated(item, "scan_complete")) {
+    writer.Key("scan_complete");
+    writer.Bool(item.scan_complete);
+  }
+}
+
+/**
+ * @brief Stream the fields of addLegacyFieldsAndDecorations.
+ *
+ * The output matches the document, a replaced field is only written once.
+ * Events replace decorations named like their columns and action members.
+ */
+void writeLegacyFieldsAndDecorations(const QueryLogItem& item,
+                                     JSONWriter& writer,
+                                     bool is_event) {
+  auto field = [&item, &writer](const char* key) {
+    if (isDecorated(item, key)) {
+      return false;
+    }
+    writer.Key(key);
+    return true;
+  };
+
+  if (field("name")) {
+    writeString(writer, item.name);
+  }
+  if (field("hostIdentifier")) {
+    writeString(writer, item.identifier);
+  }
+  if (field("calendarTime")) {
+    writeString(writer, item.calendar_time);
+  }
+  if (field("unixTime")) {
+    writer.Uint64(item.time);
+  }
+  if (field("epoch")) {
+    writer.Uint64(item.epoch);
+  }
+  if (field("counter")) {
+    writer.Uint64(item.counter);
+  }
+  if (field("numerics")) {
+    writer.Bool(FLAGS_logger_numerics);
+  }
+
+  if (item.decorations.empty()) {
+    return;
+  }
+
+  if (!FLAGS_decorations_top_level) {
+    writer.Key("decorations");
+    writer.StartObject();
+  }
+  for (const auto& name : item.decorations) {
+    if (is_event && FLAGS_decorations_top_level &&
+        (name.first == "columns" || name.first == "action")) {
+      continue;
+    }
+    writeString(writer, name.first);
+    writeString(writer, name.second);
+  }
+  if (!FLAGS_decorations_top_level) {
+    writer.EndObject();
+  }
+}
+} // namespace
+
 Status serializeQueryLogItem(const QueryLogItem& item, JSON& doc) {
   if (!item.isSnapshot) {
     auto obj = doc.getObject();
@@ -297,8 +794,20 @@ Status serializeQueryLogItem(const QueryLogItem& item, JSON& doc) {
       return status;
     }
 
-    doc.add("snapshot", arr);
-    doc.addRef("action", "snapshot");
+    if (item.unchanged_since == 0) {
+      doc.add("snapshot", arr);
+      doc.addRef("action", "snapshot");
+    } else {
+      doc.addRef("action", "snapshot_unchanged");
+      doc.add("unchanged_since", static_cast<size_t>(item.unchanged_since));
+    }
+    if (!item.snapshot_digest.empty()) {
+      doc.addRef("snapshot_digest", item.snapshot_digest);
+    }
+    if (item.scan_slice != 0) {
+      doc.add("scan_slice", static_cast<size_t>(item.scan_slice));
+      doc.add("scan_complete", item.scan_complete);
+    }
   }
 
   addLegacyFieldsAndDecorations(item, doc, doc.doc());
@@ -319,30 +828,31 @@ Status serializeEvent(const QueryLogItem& item,
   return Status::success();
 }
 
-Status serializeQueryLogItemAsEvents(const QueryLogItem& item, JSON& doc) {
-  auto temp_doc = JSON::newObject();
+/// Serialize the rows of each action, the object is empty without results.
+static Status serializeEventActions(const QueryLogItem& item,
+                                    JSON& temp_doc) {
   if (!item.isSnapshot) {
     if (!item.results.hasNoResults()) {
-      auto status = serializeDiffResults(
+      return serializeDiffResults(
           item.results, temp_doc, temp_doc.doc(), FLAGS_logger_numerics);
-      if (!status.ok()) {
-        return status;
-      }
-    } else {
-      return Status::success();
     }
-  } else {
-    if (!item.snapshot_results.empty()) {
-      auto arr = doc.getArray();
-      auto status = serializeQueryData(
-          item.snapshot_results, temp_doc, arr, FLAGS_logger_numerics);
-      if (!status.ok()) {
-        return status;
-      }
-      temp_doc.add("snapshot", arr);
-    } else {
-      return Status::success();
+  } else if (!item.snapshot_results.empty()) {
+    auto arr = temp_doc.getArray();
+    auto status = serializeQueryData(
+        item.snapshot_results, temp_doc, arr, FLAGS_logger_numerics);
+    if (!status.ok()) {
+      return status;
     }
+    temp_doc.add("snapshot", arr);
+  }
+  return Status::success();
+}
+
+Status serializeQueryLogItemAsEvents(const QueryLogItem& item, JSON& doc) {
+  auto temp_doc = JSON::newObject();
+  auto status = serializeEventActions(item, temp_doc);
+  if (!status.ok()) {
+    return status;
   }
 
   for (auto& action : temp_doc.doc().GetObject()) {
@@ -356,31 +866,127 @@ Status serializeQueryLogItemAsEvents(const QueryLogItem& item, JSON& doc) {
   return Status::success();
 }
 
-Status serializeQueryLogItemJSON(const QueryLogItem& item, std::string& json) {
-  auto doc = JSON::newObject();
-  auto status = serializeQueryLogItem(item, doc);
-  if (!status.ok()) {
-    return status;
+void writeQueryLogItem(const QueryLogItem& item, JSONWriter& writer) {
+  writer.StartObject();
+  if (!item.isSnapshot) {
+    if (!isDecorated(item, "diffResults")) {
+      writer.Key("diffResults");
+      writeDiffResults(item.results, writer, FLAGS_logger_numerics);
+    }
+  } else {
+    auto unchanged = item.unchanged_since != 0;
+    if (!unchanged && !isDecorated(item, "snapshot")) {
+      writer.Key("snapshot");
+      writeQueryData(item.snapshot_results, writer, FLAGS_logger_numerics);
+    }
+    if (!isDecorated(item, "action")) {
+      writer.Key("action");
+      writer.String(unchanged ? "snapshot_unchanged" : "snapshot");
+    }
+    writeSnapshotDigest(item, writer);
+    writeScanSlice(item, writer);
   }
 
-  return doc.toString(json);
+  writeLegacyFieldsAndDecorations(item, writer, false);
+  writer.EndObject();
+}
+
+Status serializeQueryLogItemJSON(const QueryLogItem& item, std::string& json) {
+  json.clear();
+  JSONStringStream stream(json);
+  JSONWriter writer(stream);
+  writeQueryLogItem(item, writer);
+  return Status::success();
 }
 
 Status serializeQueryLogItemAsEventsJSON(const QueryLogItem& item,
                                          std::vector<std::string>& items) {
-  auto doc = JSON::newArray();
-  auto status = serializeQueryLogItemAsEvents(item, doc);
-  if (!status.ok()) {
-    return status;
+  if (item.isSnapshot && item.unchanged_since != 0) {
+    // An unchanged snapshot is a single event without columns.
+    std::string event;
+    JSONStringStream stream(event);
+    JSONWriter writer(stream);
+    writer.StartObject();
+    writeLegacyFieldsAndDecorations(item, writer, true);
+    writer.Key("action");
+    writer.String("snapshot_unchanged");
+    writeSnapshotDigest(item, writer);
+    writer.EndObject();
+    items.push_back(std::move(event));
+    return Status::success();
+  }
+
+  // The last slice of a scan is marked by an event without columns.
+  auto scan_end = [&item, &items]() {
+    if (!item.isSnapshot || item.scan_slice == 0 || !item.scan_complete) {
+      return;
+    }
+    std::string event;
+    JSONStringStream stream(event);
+    JSONWriter writer(stream);
+    writer.StartObject();
+    writeLegacyFieldsAndDecorations(item, writer, true);
+    writer.Key("action");
+    writer.String("scan_complete");
+    writeScanSlice(item, writer);
+    writer.EndObject();
+    items.push_back(std::move(event));
+  };
+
+  if (item.isSnapshot ? item.snapshot_results.empty()
+                      : item.results.hasNoResults()) {
+    scan_end();
+    return Status::success();
+  }
+
+  // Every event starts with the same fields and decorations, they are
+  // written once and each event only appends its columns and action.
+  std::string prefix;
+  {
+    JSONStringStream stream(prefix);
+    JSONWriter writer(stream);
+    writer.StartObject();
+    writeLegacyFieldsAndDecorations(item, writer, true);
+    writer.EndObject();
   }
+  prefix.pop_back();
+  if (prefix.size() > 1) {
+    prefix += ',';
+  }
+  prefix += "\"columns\":";
+
+  auto add_events = [&item, &items, &prefix](const QueryDataTyped& rows,
+                                             const std::string& action) {
+    auto suffix = ",\"action\":\"" + action + "\"";
+    if (item.isSnapshot && !item.snapshot_digest.empty()) {
+      suffix += ",\"snapshot_digest\":\"" + item.snapshot_digest + "\"";
+    }
+    if (item.isSnapshot && item.scan_slice != 0) {
+      suffix += ",\"scan_slice\":" + std::to_string(item.scan_slice);
+    }
+    suffix += "}";
+    for (const auto& row : rows) {
+      std::string event;
+      event.reserve(prefix.size() + suffix.size() + 16 * row.size());
+      event += prefix;
+      {
+        JSONStringStream stream(event);
+        JSONWriter writer(stream);
+        writeRow(row, writer, FLAGS_logger_numerics);
+      }
+      event += suffix;
+      items.push_back(std::move(event));
+    }
+  };
 
-  // return doc.toString()
-  for (auto& event : doc.doc().GetArray()) {
-    rj::StringBuffer sb;
-    rj::Writer<rj::StringBuffer> writer(sb);
-    event.Accept(writer);
-    items.push_back(sb.GetString());
+  if (!item.isSnapshot) {
+    add_events(item.results.removed, "removed");
+    add_events(item.results.added, "added");
+    add_events(item.results.changed, "changed");
+  } else {
+    add_events(item.snapshot_results, "snapshot");
   }
+  scan_end();
   return Status::success();
 }
 
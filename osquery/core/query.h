@@ -19,6 +19,7 @@
 
 #include <osquery/core/core.h>
 #include <osquery/core/sql/diff_results.h>
+#include <osquery/core/sql/query_state.h>
 #include <osquery/core/sql/scheduled_query.h>
 #include <osquery/utils/json/json.h>
 
@@ -65,6 +66,23 @@ struct QueryLogItem {
   /// A set of additional fields to emit with the log line.
   std::map<std::string, std::string> decorations;
 
+  /// The digest of the snapshot results, set if snapshots are deduplicated.
+  std::string snapshot_digest;
+
+  /**
+   * @brief The time the snapshot results were first logged, if unchanged.
+   *
+   * If set, the results are identical to the snapshot logged before and the
+   * log line only marks the snapshot as unchanged.
+   */
+  uint64_t unchanged_since{0};
+
+  /// The slice of a sliced scan the snapshot results are from, 0 if none.
+  uint64_t scan_slice{0};
+
+  /// Set on the last slice of a sliced scan, the scan is complete.
+  bool scan_complete{false};
+
   /// equals operator
   bool operator==(const QueryLogItem& comp) const {
     return (comp.results == results) && (comp.name == name);
@@ -76,6 +94,18 @@ struct QueryLogItem {
   }
 };
 
+/// The progress of a sliced scan between its slices, see ScanSlice.
+struct ScanProgress {
+  /// The slices of the scan logged so far, 0 if no scan is in progress.
+  uint64_t slice{0};
+
+  /// The time the last slice ran.
+  uint64_t time{0};
+
+  /// The last path scanned, the next slice resumes after it.
+  std::string cursor;
+};
+
 /**
  * @brief Serialize a QueryLogItem object into a JSON document.
  *
@@ -96,6 +126,9 @@ Status serializeQueryLogItem(const QueryLogItem& item, JSON& doc);
  */
 Status serializeQueryLogItemJSON(const QueryLogItem& item, std::string& json);
 
+/// Write a QueryLogItem as a JSON object, see serializeQueryLogItem.
+void writeQueryLogItem(const QueryLogItem& item, JSONWriter& writer);
+
 /**
  * @brief Serialize a QueryLogItem object into a JSON document containing
  * events, a list of actions.
@@ -134,7 +167,10 @@ class Query {
    * @param q a ScheduledQuery struct.
    */
   explicit Query(std::string name, const ScheduledQuery& q)
-      : query_(q.query), name_(std::move(name)) {}
+      : query_(q.query),
+        name_(std::move(name)),
+        report_removed_(q.reportRemovedRows()),
+        keys_(q.keys) {}
 
   /**
    * @brief Deserialize the data in RocksDB into a useful data structure
@@ -149,17 +185,80 @@ class Query {
   Status getPreviousQueryResults(QueryDataSet& results) const;
 
   /**
-   * @brief Save query results json to the database
+   * @brief Retrieve the fingerprints of the previous query results.
+   *
+   * If the results were stored without fingerprints (for example the
+   * differential mode changed) they are computed from the stored results.
    *
-   * This method saves updated query results json to the database and
-   * updates the epoch associated with the results.
+   * @param fingerprints the output RowFingerprints, in stored row order.
    *
-   * @param json  Json serialized results string
+   * @return the success or failure of the operation.
+   */
+  Status getPreviousFingerprints(RowFingerprints& fingerprints) const;
+
+  /**
+   * @brief Save encoded query results to the database
+   *
+   * This method saves updated query results to the database and
+   * updates the epoch associated with the results, in one batch.
+   *
+   * @param results  ColumnarResults encoded results string
    * @param epoch  Epoch the results are from
    *
    * @return the success or failure of the operation.
    */
-  Status saveQueryResults(const std::string& json, uint64_t epoch) const;
+  Status saveQueryResults(const std::string& results, uint64_t epoch) const;
+
+  /**
+   * @brief Check if snapshot results are identical to the previous ones.
+   *
+   * The digest of the results does not depend on the order of the rows. If
+   * it is the digest of the previous snapshot, and a full snapshot was logged
+   * within the interval, the results may be replaced by an unchanged marker.
+   * Otherwise the results must be logged and the digest is stored.
+   *
+   * @param results The snapshot results.
+   * @param time The time of the snapshot.
+   * @param full_interval Seconds after which a full snapshot is logged even
+   * if unchanged, 0 to never force one.
+   * @param digest [output] The digest of the results.
+   * @param unchanged_since [output] The time the results were first logged
+   * if they may be replaced by a marker, otherwise 0.
+   */
+  Status dedupSnapshot(const QueryDataTyped& results,
+                       uint64_t time,
+                       uint64_t full_interval,
+                       std::string& digest,
+                       uint64_t& unchanged_since) const;
+
+  /**
+   * @brief Read the results the differential stored for the last run.
+   *
+   * Event-based queries, and queries not reporting removed rows with the
+   * fingerprint differential, store no rows. Snapshot queries store nothing.
+   *
+   * @param results [output] The stored results.
+   * @param state [output] The state stored with the results.
+   *
+   * @return A failure if no results are stored for the SQL of the query.
+   */
+  Status getStoredResults(QueryDataTyped& results, QueryState& state) const;
+
+  /**
+   * @brief Read the progress of the sliced scan of the query.
+   *
+   * @param progress [output] The progress, a slice of 0 if no scan is in
+   * progress.
+   */
+  Status getScanProgress(ScanProgress& progress) const;
+
+  /**
+   * @brief Store the progress of the sliced scan of the query.
+   *
+   * @param progress The progress after a slice, a slice of 0 removes it once
+   * the scan completed.
+   */
+  Status setScanProgress(const ScanProgress& progress) const;
 
   /**
    * @brief Get the epoch associated with the previous query results.
@@ -202,7 +301,12 @@ class Query {
    */
   bool isNewQuerySql() const;
 
-  /// Determines if this is a first run or new query.
+  /**
+   * @brief Determines if this is a first run or new query.
+   *
+   * The query text is stored with the next results, or the next state of a
+   * query without new results.
+   */
   void getQueryStatus(uint64_t epoch,
                       bool& fresh_results,
                       bool& new_query) const;
@@ -232,6 +336,12 @@ class Query {
                        uint64_t& counter,
                        DiffResults& dr) const;
 
+  /// See addNewResults, consume flat results to avoid per-row maps.
+  Status addNewResults(FlatQueryData qd,
+                       uint64_t epoch,
+                       uint64_t& counter,
+                       DiffResults& dr) const;
+
   /// A version of adding new results for events-based queries.
   Status addNewEvents(QueryDataTyped current_qd,
                       const uint64_t current_epoch,
@@ -247,6 +357,43 @@ class Query {
    */
   Status getCurrentResults(QueryData& qd);
 
+ private:
+  /// See getQueryStatus, the state is read once and returned.
+  void getQueryStatus(uint64_t epoch,
+                      QueryState& state,
+                      bool& fresh_results,
+                      bool& new_query) const;
+
+  /// See getPreviousFingerprints, using the state already read.
+  Status getPreviousFingerprints(const QueryState& state,
+                                 RowFingerprints& fingerprints) const;
+
+  /**
+   * @brief Write the values of an execution and the state in one batch.
+   *
+   * The counter is incremented if the results were updated or the epoch is
+   * new. Nothing is written if neither changed, nor the query text.
+   */
+  Status saveResultsState(
+      QueryState& state,
+      std::vector<std::pair<std::string, std::string>> values,
+      bool update_db,
+      bool new_query_epoch,
+      bool new_query_sql,
+      uint64_t& counter) const;
+
+  /// See addNewResults, the differential is calculated using fingerprints.
+  template <typename Results>
+  Status addNewFingerprintResults(Results current_qd,
+                                  uint64_t current_epoch,
+                                  uint64_t& counter,
+                                  DiffResults& dr) const;
+
+  /// Materialize the previous rows at the given (ascending) indexes.
+  Status getPreviousRows(const std::vector<size_t>& indexes,
+                         size_t expected_rows,
+                         QueryDataTyped& rows) const;
+
  public:
   /**
    * @brief Get the names of all historical queries.
@@ -266,6 +413,12 @@ class Query {
   /// The scheduled query name.
   std::string name_;
 
+  /// True if the scheduled query reports removed rows.
+  bool report_removed_{true};
+
+  /// The key columns of the scheduled query, see diffChangedRows.
+  std::vector<std::string> keys_;
+
  private:
   FRIEND_TEST(QueryTests, test_private_members);
   FRIEND_TEST(QueryTests, test_add_and_get_current_results);
@@ -274,6 +427,7 @@ class Query {
   FRIEND_TEST(QueryTests, test_get_executions);
   FRIEND_TEST(QueryTests, test_get_query_results);
   FRIEND_TEST(QueryTests, test_query_name_not_found_in_db);
+  FRIEND_TEST(QueryTests, test_fingerprint_differential);
 };
 
 } // namespace osquery
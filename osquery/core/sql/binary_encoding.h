@@ -0,0 +1,116 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace osquery {
+
+/// Append an unsigned LEB128 varint.
+inline void putVarint(std::string& out, uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+/// Append a varint length followed by the string bytes.
+inline void putString(std::string& out, const std::string& str) {
+  putVarint(out, str.size());
+  out.append(str);
+}
+
+/// Zig-zag encode so small negative integers remain small.
+inline uint64_t zigzagEncode(long long value) {
+  return (static_cast<uint64_t>(value) << 1) ^
+         static_cast<uint64_t>(value >> 63);
+}
+
+inline long long zigzagDecode(uint64_t value) {
+  return static_cast<long long>((value >> 1) ^ (0 - (value & 1)));
+}
+
+/// A bounds-checked reader over an encoded value.
+class BinaryReader {
+ public:
+  explicit BinaryReader(const std::string& data, size_t offset = 0)
+      : data_(data), offset_(offset) {}
+
+  bool getByte(uint8_t& byte) {
+    if (offset_ >= data_.size()) {
+      return false;
+    }
+    byte = static_cast<uint8_t>(data_[offset_++]);
+    return true;
+  }
+
+  bool getVarint(uint64_t& value) {
+    value = 0;
+    for (size_t shift = 0; shift < 64; shift += 7) {
+      uint8_t byte = 0;
+      if (!getByte(byte)) {
+        return false;
+      }
+      value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+      if ((byte & 0x80) == 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool getString(std::string& str) {
+    uint64_t size = 0;
+    if (!getVarint(size) || size > data_.size() - offset_) {
+      return false;
+    }
+    str.assign(data_, offset_, static_cast<size_t>(size));
+    offset_ += static_cast<size_t>(size);
+    return true;
+  }
+
+  bool skipString() {
+    uint64_t size = 0;
+    if (!getVarint(size) || size > data_.size() - offset_) {
+      return false;
+    }
+    offset_ += static_cast<size_t>(size);
+    return true;
+  }
+
+  bool getFixed64(uint64_t& value) {
+    if (data_.size() - offset_ < sizeof(uint64_t)) {
+      return false;
+    }
+    value = 0;
+    for (size_t i = 0; i < sizeof(uint64_t); ++i) {
+      value |= static_cast<uint64_t>(static_cast<uint8_t>(data_[offset_++]))
+               << (i * 8);
+    }
+    return true;
+  }
+
+  /// The number of bytes not yet read.
+  size_t remaining() const {
+    return data_.size() - offset_;
+  }
+
+  void skip(size_t size) {
+    offset_ += size;
+  }
+
+ private:
+  const std::string& data_;
+  size_t offset_{0};
+};
+
+} // namespace osquery
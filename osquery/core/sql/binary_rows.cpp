@@ -0,0 +1,184 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include "binary_rows.h"
+#include "binary_encoding.h"
+
+namespace osquery {
+
+namespace {
+
+/// Every encoded row starts with this magic, JSON never starts with a NUL.
+const std::string kBinaryRowMagic{"\0OQE", 4};
+
+/// Serialized dictionaries start with this magic.
+const std::string kBinaryRowDictionaryMagic{"\0OQD", 4};
+
+/// The largest number of digits always fitting a long long.
+const size_t kMaxIntegerDigits{18};
+
+/**
+ * @brief Parse a string that is exactly the decimal form of an integer.
+ *
+ * Values with a sign, leading zeros or whitespace that a conversion would
+ * not reproduce are kept as strings.
+ */
+bool canonicalInteger(const std::string& value, long long& integer) {
+  size_t start = (!value.empty() && value[0] == '-') ? 1 : 0;
+  auto digits = value.size() - start;
+  if (digits == 0 || digits > kMaxIntegerDigits) {
+    return false;
+  }
+
+  if (value[start] == '0' && (digits > 1 || start == 1)) {
+    return false;
+  }
+
+  long long magnitude = 0;
+  for (size_t i = start; i < value.size(); ++i) {
+    if (value[i] < '0' || value[i] > '9') {
+      return false;
+    }
+    magnitude = magnitude * 10 + (value[i] - '0');
+  }
+  integer = (start == 1) ? -magnitude : magnitude;
+  return true;
+}
+} // namespace
+
+bool BinaryRowDictionary::isEncoded(const std::string& value) {
+  return value.compare(0, kBinaryRowMagic.size(), kBinaryRowMagic) == 0;
+}
+
+void BinaryRowDictionary::encode(const Row& r, std::string& encoded) {
+  encoded.clear();
+  encoded.append(kBinaryRowMagic);
+  encoded.push_back(static_cast<char>(kBinaryRowVersion));
+  putVarint(encoded, r.size());
+
+  for (const auto& column : r) {
+    auto it = index_.find(column.first);
+    if (it == index_.end()) {
+      it = index_.emplace(column.first, columns_.size()).first;
+      columns_.push_back(column.first);
+      ++grown_;
+    }
+
+    // The lowest bit of the column index tells integers from strings.
+    long long integer = 0;
+    if (canonicalInteger(column.second, integer)) {
+      putVarint(encoded, (it->second << 1) | 1);
+      putVarint(encoded, zigzagEncode(integer));
+    } else {
+      putVarint(encoded, it->second << 1);
+      putString(encoded, column.second);
+    }
+  }
+}
+
+Status BinaryRowDictionary::decode(const std::string& encoded, Row& r) const {
+  return decode(encoded, {}, r);
+}
+
+Status BinaryRowDictionary::decode(const std::string& encoded,
+                                   const std::set<std::string>& columns,
+                                   Row& r) const {
+  if (!isEncoded(encoded)) {
+    return Status::failure("Value is not a binary row");
+  }
+
+  BinaryReader reader(encoded, kBinaryRowMagic.size());
+  uint8_t version = 0;
+  if (!reader.getByte(version) || version != kBinaryRowVersion) {
+    return Status::failure("Unsupported binary row version");
+  }
+
+  uint64_t count = 0;
+  if (!reader.getVarint(count) || count > reader.remaining()) {
+    return Status::failure("Malformed binary row");
+  }
+
+  r.clear();
+  for (uint64_t i = 0; i < count; ++i) {
+    uint64_t key = 0;
+    if (!reader.getVarint(key) || (key >> 1) >= columns_.size()) {
+      return Status::failure("Binary row column is not in the dictionary");
+    }
+
+    // An empty column set decodes every column.
+    const auto& name = columns_[static_cast<size_t>(key >> 1)];
+    if (!columns.empty() && columns.count(name) == 0) {
+      uint64_t value = 0;
+      if ((key & 1) != 0 ? !reader.getVarint(value) : !reader.skipString()) {
+        return Status::failure("Malformed binary row");
+      }
+      continue;
+    }
+
+    if ((key & 1) != 0) {
+      uint64_t value = 0;
+      if (!reader.getVarint(value)) {
+        return Status::failure("Malformed binary row integer");
+      }
+      r[name] = std::to_string(zigzagDecode(value));
+    } else if (!reader.getString(r[name])) {
+      return Status::failure("Malformed binary row string");
+    }
+  }
+
+  return Status::success();
+}
+
+void BinaryRowDictionary::serialize(std::string& serialized) const {
+  serialized.clear();
+  serialized.append(kBinaryRowDictionaryMagic);
+  serialized.push_back(static_cast<char>(kBinaryRowVersion));
+  putVarint(serialized, columns_.size());
+  for (const auto& column : columns_) {
+    putString(serialized, column);
+  }
+}
+
+Status BinaryRowDictionary::deserialize(const std::string& serialized) {
+  if (serialized.compare(
+          0, kBinaryRowDictionaryMagic.size(), kBinaryRowDictionaryMagic) !=
+      0) {
+    return Status::failure("Value is not a binary row dictionary");
+  }
+
+  BinaryReader reader(serialized, kBinaryRowDictionaryMagic.size());
+  uint8_t version = 0;
+  if (!reader.getByte(version) || version != kBinaryRowVersion) {
+    return Status::failure("Unsupported binary row dictionary version");
+  }
+
+  uint64_t count = 0;
+  if (!reader.getVarint(count) || count > reader.remaining()) {
+    return Status::failure("Malformed binary row dictionary");
+  }
+
+  ColumnNames columns;
+  std::unordered_map<std::string, uint64_t> index;
+  columns.reserve(static_cast<size_t>(count));
+  for (uint64_t i = 0; i < count; ++i) {
+    std::string name;
+    if (!reader.getString(name) || index.count(name) > 0) {
+      return Status::failure("Malformed binary row dictionary");
+    }
+    index.emplace(name, i);
+    columns.push_back(std::move(name));
+  }
+
+  columns_ = std::move(columns);
+  index_ = std::move(index);
+  grown_ = 0;
+  return Status::success();
+}
+
+} // namespace osquery
@@ -0,0 +1,86 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+#include <osquery/core/sql/row.h>
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/// The version of the binary row encoding written.
+const uint8_t kBinaryRowVersion = 1;
+
+/**
+ * @brief A column dictionary used to encode single rows compactly.
+ *
+ * Event subscribers store every event row on its own. Serializing each one
+ * as JSON repeats the column names and quotes every value, and reading them
+ * back parses the JSON again. A binary row refers to its columns by their
+ * index in a dictionary shared by every row of a subscriber, and stores
+ * canonical decimal integers as zig-zag varints and everything else as
+ * length-prefixed strings. Decoding yields the exact strings encoded.
+ *
+ * The dictionary is append-only: encoding a row with a new column adds it,
+ * and rows encoded earlier still decode. The owner persists the dictionary
+ * whenever it grows. The dictionary is not thread safe.
+ */
+class BinaryRowDictionary {
+ public:
+  /// Check if a stored value uses the binary row encoding (and not JSON).
+  static bool isEncoded(const std::string& value);
+
+  /// Encode a row, columns not yet in the dictionary are added.
+  void encode(const Row& r, std::string& encoded);
+
+  /// Decode a row encoded with this dictionary.
+  Status decode(const std::string& encoded, Row& r) const;
+
+  /// Decode only the named columns of a row, other values are skipped.
+  Status decode(const std::string& encoded,
+                const std::set<std::string>& columns,
+                Row& r) const;
+
+  /// Serialize the dictionary for storage.
+  void serialize(std::string& serialized) const;
+
+  /// Replace the dictionary with a serialized one.
+  Status deserialize(const std::string& serialized);
+
+  /// The columns in dictionary order.
+  const ColumnNames& columns() const {
+    return columns_;
+  }
+
+  /// The number of columns added since the last call to clearGrown.
+  size_t grown() const {
+    return grown_;
+  }
+
+  void clearGrown() {
+    grown_ = 0;
+  }
+
+ private:
+  /// Column names in dictionary order.
+  ColumnNames columns_;
+
+  /// The dictionary index of each column.
+  std::unordered_map<std::string, uint64_t> index_;
+
+  /// Columns added since the dictionary was last persisted.
+  size_t grown_{0};
+};
+
+} // namespace osquery
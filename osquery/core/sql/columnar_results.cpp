@@ -0,0 +1,375 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include "columnar_results.h"
+#include "binary_encoding.h"
+
+#include <cstring>
+#include <set>
+
+#include <boost/lexical_cast.hpp>
+
+namespace osquery {
+
+const std::string kColumnarRowsKey = "__columnar_rows";
+
+namespace {
+
+/// Every encoding starts with this magic, JSON never starts with a NUL.
+const std::string kColumnarResultsMagic{"\0OQR", 4};
+
+/// Per-row value tags, written before a column's values.
+enum ValueTag : uint8_t {
+  kValueAbsent = 0,
+  kValueInteger = 1,
+  kValueDouble = 2,
+  kValueString = 3,
+};
+
+class ValueEncoderVisitor : public boost::static_visitor<> {
+ public:
+  explicit ValueEncoderVisitor(std::string& out) : out_(out) {}
+
+  void operator()(const long long& i) const {
+    putVarint(out_, zigzagEncode(i));
+  }
+
+  void operator()(const double& d) const {
+    uint64_t bits = 0;
+    std::memcpy(&bits, &d, sizeof(bits));
+    for (size_t i = 0; i < sizeof(uint64_t); ++i) {
+      out_.push_back(static_cast<char>((bits >> (i * 8)) & 0xFF));
+    }
+  }
+
+  void operator()(const std::string& str) const {
+    putString(out_, str);
+  }
+
+ private:
+  std::string& out_;
+};
+
+class ValueTagVisitor : public boost::static_visitor<ValueTag> {
+ public:
+  ValueTag operator()(const long long&) const {
+    return kValueInteger;
+  }
+
+  ValueTag operator()(const double&) const {
+    return kValueDouble;
+  }
+
+  ValueTag operator()(const std::string&) const {
+    return kValueString;
+  }
+};
+} // namespace
+
+bool ColumnarResults::isEncoded(const std::string& value) {
+  const auto& magic = kColumnarResultsMagic;
+  return value.compare(0, magic.size(), magic) == 0;
+}
+
+/// Write the dictionary and row count that start every encoding.
+static void encodeHeader(const std::vector<const std::string*>& names,
+                         size_t rows,
+                         std::string& encoded) {
+  encoded.clear();
+  encoded.append(kColumnarResultsMagic);
+  encoded.push_back(static_cast<char>(kColumnarResultsVersion));
+  putVarint(encoded, names.size());
+  for (const auto* name : names) {
+    putString(encoded, *name);
+  }
+  putVarint(encoded, rows);
+}
+
+/// Write the tag of every row first, then the values of the present rows.
+static void encodeColumn(const std::vector<const RowDataTyped*>& column,
+                         std::string& encoded) {
+  for (const auto* value : column) {
+    auto tag = (value == nullptr)
+                   ? kValueAbsent
+                   : boost::apply_visitor(ValueTagVisitor(), *value);
+    encoded.push_back(static_cast<char>(tag));
+  }
+
+  ValueEncoderVisitor encoder(encoded);
+  for (const auto* value : column) {
+    if (value != nullptr) {
+      boost::apply_visitor(encoder, *value);
+    }
+  }
+}
+
+/// Write a column of string values, see encodeColumn.
+static void encodeStringColumn(const std::vector<const std::string*>& column,
+                               std::string& encoded) {
+  for (const auto* value : column) {
+    auto tag = (value == nullptr) ? kValueAbsent : kValueString;
+    encoded.push_back(static_cast<char>(tag));
+  }
+
+  for (const auto* value : column) {
+    if (value != nullptr) {
+      putString(encoded, *value);
+    }
+  }
+}
+
+void ColumnarResults::encode(const QueryDataTyped& q, std::string& encoded) {
+  // The dictionary is the union of every row's columns, rows may differ.
+  std::set<std::string> names;
+  for (const auto& r : q) {
+    for (const auto& column : r) {
+      names.insert(column.first);
+    }
+  }
+
+  std::vector<const std::string*> dictionary;
+  dictionary.reserve(names.size());
+  for (const auto& name : names) {
+    dictionary.push_back(&name);
+  }
+  encodeHeader(dictionary, q.size(), encoded);
+
+  std::vector<const RowDataTyped*> column;
+  column.reserve(q.size());
+  for (const auto& name : names) {
+    column.clear();
+    for (const auto& r : q) {
+      auto it = r.find(name);
+      column.push_back((it == r.end()) ? nullptr : &it->second);
+    }
+    encodeColumn(column, encoded);
+  }
+}
+
+void ColumnarResults::encode(const FlatQueryData& q, std::string& encoded) {
+  // Flat results share one schema, every row has every column.
+  std::vector<const std::string*> dictionary;
+  std::vector<size_t> order;
+  if (q.schema() != nullptr) {
+    order = q.schema()->order;
+  }
+  dictionary.reserve(order.size());
+  for (auto index : order) {
+    dictionary.push_back(&q.columns()[index]);
+  }
+  encodeHeader(dictionary, q.rows(), encoded);
+
+  std::vector<const RowDataTyped*> column;
+  column.reserve(q.rows());
+  for (auto index : order) {
+    column.clear();
+    for (size_t row = 0; row < q.rows(); ++row) {
+      column.push_back(&q.value(row, index));
+    }
+    encodeColumn(column, encoded);
+  }
+}
+
+void ColumnarResults::encode(const QueryData& q, std::string& encoded) {
+  std::set<std::string> names;
+  for (const auto& r : q) {
+    for (const auto& column : r) {
+      names.insert(column.first);
+    }
+  }
+
+  std::vector<const std::string*> dictionary;
+  dictionary.reserve(names.size());
+  for (const auto& name : names) {
+    dictionary.push_back(&name);
+  }
+  encodeHeader(dictionary, q.size(), encoded);
+
+  std::vector<const std::string*> column;
+  column.reserve(q.size());
+  for (const auto& name : names) {
+    column.clear();
+    for (const auto& r : q) {
+      auto it = r.find(name);
+      column.push_back((it == r.end()) ? nullptr : &it->second);
+    }
+    encodeStringColumn(column, encoded);
+  }
+}
+
+Status ColumnarResults::decode(const std::string& encoded,
+                               ColumnarResults& results) {
+  if (!isEncoded(encoded)) {
+    return Status::failure("Value is not columnar encoded");
+  }
+
+  BinaryReader reader(encoded);
+  reader.skip(kColumnarResultsMagic.size());
+
+  uint8_t version = 0;
+  if (!reader.getByte(version) || version != kColumnarResultsVersion) {
+    return Status::failure("Unsupported columnar encoding version");
+  }
+
+  uint64_t column_count = 0;
+  if (!reader.getVarint(column_count) || column_count > reader.remaining()) {
+    return Status::failure("Malformed columnar dictionary");
+  }
+
+  results.columns_.clear();
+  results.columns_.reserve(static_cast<size_t>(column_count));
+  for (uint64_t i = 0; i < column_count; ++i) {
+    std::string name;
+    if (!reader.getString(name)) {
+      return Status::failure("Malformed columnar dictionary");
+    }
+    results.columns_.push_back(std::move(name));
+  }
+
+  uint64_t rows = 0;
+  if (!reader.getVarint(rows) ||
+      (column_count > 0 && rows > reader.remaining())) {
+    return Status::failure("Malformed columnar row count");
+  }
+  results.rows_ = static_cast<size_t>(rows);
+
+  results.values_.clear();
+  results.values_.resize(results.columns_.size());
+  for (auto& column : results.values_) {
+    std::vector<uint8_t> tags(results.rows_);
+    for (auto& tag : tags) {
+      if (!reader.getByte(tag) || tag > kValueString) {
+        return Status::failure("Malformed columnar value tags");
+      }
+    }
+
+    column.present.resize(results.rows_);
+    column.values.resize(results.rows_);
+    for (size_t row = 0; row < results.rows_; ++row) {
+      column.present[row] = (tags[row] != kValueAbsent);
+      if (tags[row] == kValueInteger) {
+        uint64_t value = 0;
+        if (!reader.getVarint(value)) {
+          return Status::failure("Malformed columnar integer");
+        }
+        column.values[row] = zigzagDecode(value);
+      } else if (tags[row] == kValueDouble) {
+        uint64_t bits = 0;
+        if (!reader.getFixed64(bits)) {
+          return Status::failure("Malformed columnar double");
+        }
+        double value = 0;
+        std::memcpy(&value, &bits, sizeof(value));
+        column.values[row] = value;
+      } else if (tags[row] == kValueString) {
+        std::string value;
+        if (!reader.getString(value)) {
+          return Status::failure("Malformed columnar string");
+        }
+        column.values[row] = std::move(value);
+      }
+    }
+  }
+
+  return Status::success();
+}
+
+const RowDataTyped* ColumnarResults::value(size_t row, size_t column) const {
+  if (column >= values_.size() || row >= rows_ ||
+      !values_[column].present[row]) {
+    return nullptr;
+  }
+  return &values_[column].values[row];
+}
+
+RowTyped ColumnarResults::row(size_t row) const {
+  RowTyped r;
+  for (size_t column = 0; column < columns_.size(); ++column) {
+    const auto* v = value(row, column);
+    if (v != nullptr) {
+      r.emplace_hint(r.end(), columns_[column], *v);
+    }
+  }
+  return r;
+}
+
+uint64_t ColumnarResults::fingerprint(size_t row) const {
+  // The dictionary is ordered like the columns of a RowTyped.
+  RowFingerprinter fingerprinter;
+  for (size_t column = 0; column < columns_.size(); ++column) {
+    const auto* v = value(row, column);
+    if (v != nullptr) {
+      fingerprinter.add(columns_[column], *v);
+    }
+  }
+  return fingerprinter.get();
+}
+
+void ColumnarResults::toQueryData(QueryDataTyped& q) const {
+  q.reserve(q.size() + rows_);
+  for (size_t i = 0; i < rows_; ++i) {
+    q.push_back(row(i));
+  }
+}
+
+void ColumnarResults::toQueryData(QueryData& q) const {
+  q.reserve(q.size() + rows_);
+  for (size_t i = 0; i < rows_; ++i) {
+    Row r;
+    for (size_t column = 0; column < columns_.size(); ++column) {
+      const auto* v = value(i, column);
+      if (v == nullptr) {
+        continue;
+      }
+
+      const auto* str = boost::get<std::string>(v);
+      r.emplace_hint(r.end(),
+                     columns_[column],
+                     (str != nullptr) ? *str
+                                      : boost::lexical_cast<std::string>(*v));
+    }
+    q.push_back(std::move(r));
+  }
+}
+
+void ColumnarResults::toQueryDataSet(QueryDataSet& q) const {
+  for (size_t i = 0; i < rows_; ++i) {
+    q.insert(row(i));
+  }
+}
+
+Status deserializeStoredQueryData(const std::string& value, QueryDataTyped& q) {
+  if (!ColumnarResults::isEncoded(value)) {
+    return deserializeQueryDataJSON(value, q);
+  }
+
+  ColumnarResults results;
+  auto status = ColumnarResults::decode(value, results);
+  if (!status.ok()) {
+    return status;
+  }
+  results.toQueryData(q);
+  return Status::success();
+}
+
+Status deserializeStoredQueryData(const std::string& value, QueryDataSet& q) {
+  if (!ColumnarResults::isEncoded(value)) {
+    return deserializeQueryDataJSON(value, q);
+  }
+
+  ColumnarResults results;
+  auto status = ColumnarResults::decode(value, results);
+  if (!status.ok()) {
+    return status;
+  }
+  results.toQueryDataSet(q);
+  return Status::success();
+}
+
+} // namespace osquery
@@ -0,0 +1,123 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <osquery/core/sql/flat_query_data.h>
+#include <osquery/core/sql/query_data.h>
+#include <osquery/utils/only_movable.h>
+
+namespace osquery {
+
+/// The version of the binary columnar results encoding written.
+const uint8_t kColumnarResultsVersion = 1;
+
+/**
+ * @brief The table request key asking an extension for columnar rows.
+ *
+ * Extensions that understand it answer with a single response row holding
+ * the encoded rows under the same key. Older extensions ignore the request
+ * key and answer with one response row per table row.
+ */
+extern const std::string kColumnarRowsKey;
+
+/**
+ * @brief A decoded, column-oriented view of stored query results.
+ *
+ * Scheduled query results are stored in the "queries" domain using a binary
+ * encoding: a dictionary of the column names used by any row, followed by one
+ * vector of typed values per column. Rows are not expanded into RowTyped maps
+ * when decoded, callers that need the full rows may ask for them.
+ */
+class ColumnarResults : private only_movable {
+ public:
+  ColumnarResults() = default;
+  ColumnarResults(ColumnarResults&&) = default;
+  ColumnarResults& operator=(ColumnarResults&&) = default;
+
+  /// Check if a stored value uses the columnar encoding (and not JSON).
+  static bool isEncoded(const std::string& value);
+
+  /// Encode a set of query results.
+  static void encode(const QueryDataTyped& q, std::string& encoded);
+
+  /// Encode a set of flat query results, decoding yields the same rows.
+  static void encode(const FlatQueryData& q, std::string& encoded);
+
+  /// Encode a set of string rows, every value is decoded as a string.
+  static void encode(const QueryData& q, std::string& encoded);
+
+  /// Decode an encoded set of query results.
+  static Status decode(const std::string& encoded, ColumnarResults& results);
+
+ public:
+  /// The number of rows.
+  size_t rows() const {
+    return rows_;
+  }
+
+  /// The column names used by any of the rows, in ascending order.
+  const ColumnNames& columns() const {
+    return columns_;
+  }
+
+  /// Return a column's value for a row, nullptr if the row does not have it.
+  const RowDataTyped* value(size_t row, size_t column) const;
+
+  /// Materialize a single row.
+  RowTyped row(size_t row) const;
+
+  /// Compute a row's fingerprint without materializing it.
+  uint64_t fingerprint(size_t row) const;
+
+  /// Materialize every row.
+  void toQueryData(QueryDataTyped& q) const;
+
+  /// Materialize every row, typed values are converted to strings.
+  void toQueryData(QueryData& q) const;
+
+  /// Materialize every row into a set.
+  void toQueryDataSet(QueryDataSet& q) const;
+
+ private:
+  /// Typed values of a single column, one per row.
+  struct Column {
+    /// A true value if the row has this column.
+    std::vector<bool> present;
+
+    /// The values, rows without the column hold a default value.
+    std::vector<RowDataTyped> values;
+  };
+
+  /// The shared column name dictionary.
+  ColumnNames columns_;
+
+  /// One Column for each name in columns_.
+  std::vector<Column> values_;
+
+  /// The number of rows.
+  size_t rows_{0};
+};
+
+/**
+ * @brief Decode query results stored in the "queries" domain.
+ *
+ * Results may have been stored using the columnar encoding or as JSON, by
+ * older versions, and both are accepted.
+ */
+Status deserializeStoredQueryData(const std::string& value, QueryDataTyped& q);
+
+/// See deserializeStoredQueryData, decode into a set of rows.
+Status deserializeStoredQueryData(const std::string& value, QueryDataSet& q);
+
+} // namespace osquery
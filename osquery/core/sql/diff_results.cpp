@@ -9,6 +9,11 @@
 
 #include "diff_results.h"
 
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+
 namespace rj = rapidjson;
 
 namespace osquery {
@@ -34,20 +39,42 @@ Status serializeDiffResults(const DiffResults& d,
     return status;
   }
   doc.add("added", added_arr, obj);
+
+  if (!d.changed.empty()) {
+    auto changed_arr = doc.getArray();
+    status = serializeQueryData(d.changed, doc, changed_arr, asNumeric);
+    if (!status.ok()) {
+      return status;
+    }
+    doc.add("changed", changed_arr, obj);
+  }
   return Status::success();
 }
 
+void writeDiffResults(const DiffResults& d,
+                      JSONWriter& writer,
+                      bool asNumeric) {
+  // The same order as serializeDiffResults.
+  writer.StartObject();
+  writer.Key("removed");
+  writeQueryData(d.removed, writer, asNumeric);
+  writer.Key("added");
+  writeQueryData(d.added, writer, asNumeric);
+  if (!d.changed.empty()) {
+    writer.Key("changed");
+    writeQueryData(d.changed, writer, asNumeric);
+  }
+  writer.EndObject();
+}
+
 Status serializeDiffResultsJSON(const DiffResults& d,
                                 std::string& json,
                                 bool asNumeric) {
-  auto doc = JSON::newObject();
-
-  ColumnNames cols;
-  auto status = serializeDiffResults(d, doc, doc.doc(), asNumeric);
-  if (!status.ok()) {
-    return status;
-  }
-  return doc.toString(json);
+  json.clear();
+  JSONStringStream stream(json);
+  JSONWriter writer(stream);
+  writeDiffResults(d, writer, asNumeric);
+  return Status::success();
 }
 
 DiffResults diff(QueryDataSet& old, QueryDataTyped& current) {
@@ -69,4 +96,247 @@ DiffResults diff(QueryDataSet& old, QueryDataTyped& current) {
   return r;
 }
 
+/// Encode the key columns of a row, false if the row is missing one.
+static bool encodeRowKey(const std::vector<std::string>& keys,
+                         const RowTyped& row,
+                         std::string& encoded) {
+  encoded.clear();
+  for (const auto& key : keys) {
+    auto column = row.find(key);
+    if (column == row.end()) {
+      return false;
+    }
+
+    // Each value is prefixed by its type and length, so keys are distinct.
+    std::string value;
+    const auto& data = column->second;
+    if (const auto* integer = boost::get<long long>(&data)) {
+      value = std::to_string(*integer);
+    } else if (const auto* real = boost::get<double>(&data)) {
+      value.resize(sizeof(double));
+      std::memcpy(&value[0], real, sizeof(double));
+    } else {
+      value = boost::get<std::string>(data);
+    }
+    encoded += std::to_string(data.which()) + ":" +
+               std::to_string(value.size()) + ":" + value;
+  }
+  return true;
+}
+
+void diffChangedRows(const std::vector<std::string>& keys, DiffResults& d) {
+  if (keys.empty() || d.added.empty() || d.removed.empty()) {
+    return;
+  }
+
+  // Keys shared by several rows are ambiguous and not matched.
+  const auto kAmbiguous = static_cast<size_t>(-1);
+  auto index_keys = [&keys, kAmbiguous](const QueryDataTyped& rows,
+                                        std::vector<std::string>& row_keys) {
+    std::unordered_map<std::string, size_t> indexes;
+    row_keys.resize(rows.size());
+    for (size_t i = 0; i < rows.size(); ++i) {
+      if (!encodeRowKey(keys, rows[i], row_keys[i])) {
+        row_keys[i].clear();
+        continue;
+      }
+      auto inserted = indexes.emplace(row_keys[i], i);
+      if (!inserted.second) {
+        inserted.first->second = kAmbiguous;
+      }
+    }
+    return indexes;
+  };
+
+  std::vector<std::string> removed_keys;
+  std::vector<std::string> added_keys;
+  auto removed_indexes = index_keys(d.removed, removed_keys);
+  auto added_indexes = index_keys(d.added, added_keys);
+
+  std::vector<bool> removed_matched(d.removed.size(), false);
+  std::vector<bool> added_matched(d.added.size(), false);
+  for (size_t i = 0; i < d.added.size(); ++i) {
+    if (added_keys[i].empty() || added_indexes[added_keys[i]] != i) {
+      continue;
+    }
+
+    auto removed = removed_indexes.find(added_keys[i]);
+    if (removed == removed_indexes.end() || removed->second == kAmbiguous) {
+      continue;
+    }
+
+    const auto& previous = d.removed[removed->second];
+    const auto& current = d.added[i];
+    RowTyped changed;
+    for (const auto& key : keys) {
+      changed[key] = current.at(key);
+    }
+    for (const auto& column : current) {
+      auto before = previous.find(column.first);
+      if (before == previous.end() || !(before->second == column.second)) {
+        changed[column.first] = column.second;
+      }
+    }
+    d.changed.push_back(std::move(changed));
+    removed_matched[removed->second] = true;
+    added_matched[i] = true;
+  }
+
+  if (d.changed.empty()) {
+    return;
+  }
+
+  // The rows left keep their order.
+  auto compact = [](QueryDataTyped& rows, const std::vector<bool>& matched) {
+    size_t kept = 0;
+    for (size_t i = 0; i < rows.size(); ++i) {
+      if (!matched[i]) {
+        if (kept != i) {
+          rows[kept] = std::move(rows[i]);
+        }
+        ++kept;
+      }
+    }
+    rows.resize(kept);
+  };
+  compact(d.removed, removed_matched);
+  compact(d.added, added_matched);
+}
+
+RowFingerprints fingerprintQueryData(const QueryDataTyped& q) {
+  RowFingerprints fingerprints;
+  fingerprints.reserve(q.size());
+  for (const auto& r : q) {
+    fingerprints.push_back(fingerprintRow(r));
+  }
+  return fingerprints;
+}
+
+RowFingerprints fingerprintQueryData(const FlatQueryData& q) {
+  RowFingerprints fingerprints;
+  fingerprints.reserve(q.rows());
+  for (size_t i = 0; i < q.rows(); ++i) {
+    fingerprints.push_back(q.fingerprint(i));
+  }
+  return fingerprints;
+}
+
+void serializeRowFingerprints(const RowFingerprints& fingerprints,
+                              std::string& encoded) {
+  encoded.clear();
+  encoded.reserve(fingerprints.size() * sizeof(uint64_t));
+  for (auto fingerprint : fingerprints) {
+    // Always store little-endian so the encoding is portable.
+    for (size_t i = 0; i < sizeof(uint64_t); ++i) {
+      encoded.push_back(static_cast<char>((fingerprint >> (i * 8)) & 0xFF));
+    }
+  }
+}
+
+Status deserializeRowFingerprints(const std::string& encoded,
+                                  RowFingerprints& fingerprints) {
+  if (encoded.size() % sizeof(uint64_t) != 0) {
+    return Status::failure("Malformed row fingerprints");
+  }
+
+  fingerprints.resize(encoded.size() / sizeof(uint64_t));
+  const auto* bytes = reinterpret_cast<const unsigned char*>(encoded.data());
+  for (auto& fingerprint : fingerprints) {
+    fingerprint = 0;
+    for (size_t i = 0; i < sizeof(uint64_t); ++i) {
+      fingerprint |= static_cast<uint64_t>(bytes[i]) << (i * 8);
+    }
+    bytes += sizeof(uint64_t);
+  }
+  return Status::success();
+}
+
+/// Return the indexes of fingerprints, ordered by fingerprint then position.
+static std::vector<size_t> sortedFingerprintIndexes(
+    const RowFingerprints& fingerprints) {
+  std::vector<size_t> indexes(fingerprints.size());
+  std::iota(indexes.begin(), indexes.end(), 0);
+  std::sort(indexes.begin(),
+            indexes.end(),
+            [&fingerprints](size_t left, size_t right) {
+              if (fingerprints[left] != fingerprints[right]) {
+                return fingerprints[left] < fingerprints[right];
+              }
+              return left < right;
+            });
+  return indexes;
+}
+
+/// Match fingerprints as multisets, output ascending indexes of changed rows.
+static void diffFingerprints(const RowFingerprints& old,
+                             const RowFingerprints& current_fingerprints,
+                             std::vector<size_t>& added,
+                             std::vector<size_t>& removed) {
+  // Unchanged results, such as a cached inventory, are not sorted.
+  if (old == current_fingerprints) {
+    return;
+  }
+
+  auto old_indexes = sortedFingerprintIndexes(old);
+  auto current_indexes = sortedFingerprintIndexes(current_fingerprints);
+
+  // Walk both sorted sequences, each matching pair is an unchanged row.
+  size_t i = 0;
+  size_t j = 0;
+  while (i < old_indexes.size() && j < current_indexes.size()) {
+    auto old_fingerprint = old[old_indexes[i]];
+    auto current_fingerprint = current_fingerprints[current_indexes[j]];
+    if (old_fingerprint == current_fingerprint) {
+      ++i;
+      ++j;
+    } else if (old_fingerprint < current_fingerprint) {
+      removed.push_back(old_indexes[i++]);
+    } else {
+      added.push_back(current_indexes[j++]);
+    }
+  }
+
+  for (; i < old_indexes.size(); ++i) {
+    removed.push_back(old_indexes[i]);
+  }
+
+  for (; j < current_indexes.size(); ++j) {
+    added.push_back(current_indexes[j]);
+  }
+
+  // Report added rows in the order the query returned them.
+  std::sort(added.begin(), added.end());
+  std::sort(removed.begin(), removed.end());
+}
+
+DiffResults diff(const RowFingerprints& old,
+                 const RowFingerprints& current_fingerprints,
+                 const QueryDataTyped& current,
+                 std::vector<size_t>& removed) {
+  std::vector<size_t> added;
+  diffFingerprints(old, current_fingerprints, added, removed);
+
+  DiffResults r;
+  r.added.reserve(added.size());
+  for (auto index : added) {
+    r.added.push_back(current[index]);
+  }
+  return r;
+}
+
+DiffResults diff(const RowFingerprints& old,
+                 const RowFingerprints& current_fingerprints,
+                 const FlatQueryData& current,
+                 std::vector<size_t>& removed) {
+  std::vector<size_t> added;
+  diffFingerprints(old, current_fingerprints, added, removed);
+
+  DiffResults r;
+  r.added.reserve(added.size());
+  for (auto index : added) {
+    r.added.push_back(current.row(index));
+  }
+  return r;
+}
+
 } // namespace osquery
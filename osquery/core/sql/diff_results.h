@@ -9,6 +9,7 @@
 
 #pragma once
 
+#include <osquery/core/sql/flat_query_data.h>
 #include <osquery/core/sql/query_data.h>
 
 namespace osquery {
@@ -19,7 +20,8 @@ namespace osquery {
  *
  * The representation of two diffed QueryData result sets. Given and old and
  * new QueryData, DiffResults indicates the "added" subset of rows and the
- * "removed" subset of rows.
+ * "removed" subset of rows. Queries with key columns also report "changed"
+ * rows, see diffChangedRows.
  */
 struct DiffResults : private only_movable {
  public:
@@ -29,6 +31,9 @@ struct DiffResults : private only_movable {
   /// vector of removed rows
   QueryDataTyped removed;
 
+  /// vector of changed rows, the key columns and the columns that changed
+  QueryDataTyped changed;
+
   DiffResults() {}
   DiffResults(DiffResults&&) = default;
   DiffResults& operator=(DiffResults&&) = default;
@@ -39,12 +44,13 @@ struct DiffResults : private only_movable {
    * @return A bool indicating if this diff has no results.
    */
   inline bool hasNoResults() const {
-    return added.empty() && removed.empty();
+    return added.empty() && removed.empty() && changed.empty();
   }
 
   /// equals operator
   bool operator==(const DiffResults& comp) const {
-    return (comp.added == added) && (comp.removed == removed);
+    return (comp.added == added) && (comp.removed == removed) &&
+           (comp.changed == changed);
   }
 
   /// not equals operator
@@ -56,7 +62,8 @@ struct DiffResults : private only_movable {
 /**
  * @brief Serialize a DiffResults object into a JSON object.
  *
- * The object JSON will contain two new keys: added and removed.
+ * The object JSON will contain two new keys: added and removed. A third key,
+ * changed, is only added if there are changed rows.
  *
  * @param d the DiffResults to serialize.
  * @param doc the managed JSON document.
@@ -70,6 +77,12 @@ Status serializeDiffResults(const DiffResults& d,
                             rapidjson::Document& obj,
                             bool asNumeric);
 
+/// Write a DiffResults as a JSON object, "removed" is written first and
+/// "changed" only if there are changed rows.
+void writeDiffResults(const DiffResults& d,
+                      JSONWriter& writer,
+                      bool asNumeric);
+
 /**
  * @brief Serialize a DiffResults object into a JSON string.
  *
@@ -96,4 +109,63 @@ Status serializeDiffResultsJSON(const DiffResults& d,
  */
 DiffResults diff(QueryDataSet& old_, QueryDataTyped& new_);
 
+/**
+ * @brief Report the rows whose key columns did not change as changed rows.
+ *
+ * A removed and an added row with the same values for the key columns are
+ * replaced by a changed row. It holds the key columns and the columns whose
+ * value changed, so a process whose CPU times changed is not reported as a
+ * removed and an added row. Rows missing a key column, and keys shared by
+ * several removed or added rows, are left as removed and added rows.
+ *
+ * @param keys the columns identifying a row.
+ * @param d the differential, as calculated by either diff.
+ */
+void diffChangedRows(const std::vector<std::string>& keys, DiffResults& d);
+
+/**
+ * @brief The fingerprint of each row in a result set.
+ *
+ * Fingerprints are kept in the same order as the rows they were computed
+ * from, so the index of a fingerprint is the index of its row.
+ */
+using RowFingerprints = std::vector<uint64_t>;
+
+/// Compute the fingerprint of each row using fingerprintRow.
+RowFingerprints fingerprintQueryData(const QueryDataTyped& q);
+
+/// See fingerprintQueryData, rows are fingerprinted without materializing.
+RowFingerprints fingerprintQueryData(const FlatQueryData& q);
+
+/// Encode fingerprints as a compact binary string (8 bytes per row).
+void serializeRowFingerprints(const RowFingerprints& fingerprints,
+                              std::string& encoded);
+
+/// Inverse of serializeRowFingerprints.
+Status deserializeRowFingerprints(const std::string& encoded,
+                                  RowFingerprints& fingerprints);
+
+/**
+ * @brief Calculate a differential using only row fingerprints.
+ *
+ * Rows are matched as a multiset, like the QueryDataSet differential, but
+ * without materializing the previous rows. Only the added rows are copied
+ * out of the current results, in their original order.
+ *
+ * @param old_ the fingerprints of the previous results.
+ * @param new_fingerprints the fingerprints of the current results.
+ * @param new_ the current results.
+ * @param removed [output] ascending indexes into old_ of the removed rows.
+ */
+DiffResults diff(const RowFingerprints& old_,
+                 const RowFingerprints& new_fingerprints,
+                 const QueryDataTyped& new_,
+                 std::vector<size_t>& removed);
+
+/// See the fingerprint diff, added rows are materialized from flat results.
+DiffResults diff(const RowFingerprints& old_,
+                 const RowFingerprints& new_fingerprints,
+                 const FlatQueryData& new_,
+                 std::vector<size_t>& removed);
+
 } // namespace osquery
@@ -0,0 +1,186 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include "flat_query_data.h"
+
+#include <algorithm>
+
+#include <osquery/utils/conversions/castvariant.h>
+
+namespace rj = rapidjson;
+
+namespace osquery {
+
+FlatRowSchema::FlatRowSchema(ColumnNames names) : columns(std::move(names)) {
+  order.reserve(columns.size());
+  for (size_t i = 0; i < columns.size(); ++i) {
+    order.push_back(i);
+  }
+
+  // A stable sort keeps duplicate names in query order, keep the last one.
+  std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+    return columns[a] < columns[b];
+  });
+  auto last = std::unique(order.rbegin(),
+                          order.rend(),
+                          [this](size_t a, size_t b) {
+                            return columns[a] == columns[b];
+                          })
+                  .base();
+  order.erase(order.begin(), last);
+}
+
+FlatQueryData::FlatQueryData(ColumnNames columns)
+    : FlatQueryData(std::make_shared<FlatRowSchema>(std::move(columns))) {}
+
+FlatQueryData::FlatQueryData(FlatRowSchemaRef schema)
+    : schema_(std::move(schema)),
+      width_((schema_ == nullptr) ? 0 : schema_->columns.size()) {}
+
+const ColumnNames& FlatQueryData::columns() const {
+  static const ColumnNames kNoColumns;
+  return (schema_ == nullptr) ? kNoColumns : schema_->columns;
+}
+
+void FlatQueryData::reserve(size_t rows) {
+  values_.reserve(rows * width_);
+}
+
+RowDataTyped* FlatQueryData::addRow() {
+  values_.resize(values_.size() + width_);
+  ++rows_;
+  return values_.data() + (rows_ - 1) * width_;
+}
+
+RowTyped FlatQueryData::row(size_t row) const {
+  RowTyped r;
+  if (schema_ == nullptr) {
+    return r;
+  }
+
+  for (auto column : schema_->order) {
+    r.emplace_hint(r.end(), schema_->columns[column], value(row, column));
+  }
+  return r;
+}
+
+uint64_t FlatQueryData::fingerprint(size_t row) const {
+  RowFingerprinter fingerprinter;
+  if (schema_ != nullptr) {
+    for (auto column : schema_->order) {
+      fingerprinter.add(schema_->columns[column], value(row, column));
+    }
+  }
+  return fingerprinter.get();
+}
+
+void FlatQueryData::toQueryData(QueryDataTyped& q) const {
+  q.reserve(q.size() + rows_);
+  for (size_t i = 0; i < rows_; ++i) {
+    q.push_back(row(i));
+  }
+}
+
+void FlatQueryData::moveToQueryData(QueryDataTyped& q) {
+  q.reserve(q.size() + rows_);
+  for (size_t i = 0; i < rows_; ++i) {
+    RowTyped r;
+    for (auto column : schema_->order) {
+      r.emplace_hint(
+          r.end(), schema_->columns[column], std::move(value(i, column)));
+    }
+    q.push_back(std::move(r));
+  }
+  clear();
+}
+
+void FlatQueryData::clear() {
+  values_.clear();
+  rows_ = 0;
+}
+
+FlatQueryData FlatQueryData::copy() const {
+  FlatQueryData results(schema_);
+  results.rows_ = rows_;
+  results.values_ = values_;
+  return results;
+}
+
+Status serializeQueryData(const FlatQueryData& q,
+                          JSON& doc,
+                          rj::Document& arr,
+                          bool asNumeric) {
+  if (q.schema() == nullptr) {
+    return Status::success();
+  }
+
+  const auto& schema = *q.schema();
+  for (size_t row = 0; row < q.rows(); ++row) {
+    auto row_obj = doc.getObject();
+    for (auto column : schema.order) {
+      const auto& key = schema.columns[column];
+      const auto& value = q.value(row, column);
+      if (value.which() == 2) {
+        // Strings are owned by the results and may be referenced.
+        doc.addRef(key, boost::get<std::string>(value), row_obj);
+      } else if (asNumeric) {
+        boost::apply_visitor(
+            [&doc, &row_obj, &key](auto v) { doc.add(key, v, row_obj); },
+            value);
+      } else {
+        doc.addCopy(key, castVariant(value), row_obj);
+      }
+    }
+    doc.push(row_obj, arr);
+  }
+  return Status::success();
+}
+
+void writeQueryData(const FlatQueryData& q,
+                    JSONWriter& writer,
+                    bool asNumeric) {
+  writer.StartArray();
+  if (q.schema() != nullptr) {
+    const auto& schema = *q.schema();
+    for (size_t row = 0; row < q.rows(); ++row) {
+      writer.StartObject();
+      for (auto column : schema.order) {
+        const auto& key = schema.columns[column];
+        writer.Key(key.data(), static_cast<rj::SizeType>(key.size()));
+
+        const auto& value = q.value(row, column);
+        if (value.which() == 2) {
+          const auto& str = boost::get<std::string>(value);
+          writer.String(str.data(), static_cast<rj::SizeType>(str.size()));
+        } else if (!asNumeric) {
+          auto str = castVariant(value);
+          writer.String(str.data(), static_cast<rj::SizeType>(str.size()));
+        } else if (value.which() == 0) {
+          writer.Int64(boost::get<long long>(value));
+        } else {
+          writer.Double(boost::get<double>(value));
+        }
+      }
+      writer.EndObject();
+    }
+  }
+  writer.EndArray();
+}
+
+Status serializeQueryDataJSON(const FlatQueryData& q,
+                              std::string& json,
+                              bool asNumeric) {
+  json.clear();
+  JSONStringStream stream(json);
+  JSONWriter writer(stream);
+  writeQueryData(q, writer, asNumeric);
+  return Status::success();
+}
+
+} // namespace osquery
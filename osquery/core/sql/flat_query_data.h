@@ -0,0 +1,178 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <osquery/core/sql/query_data.h>
+#include <osquery/utils/only_movable.h>
+
+namespace osquery {
+
+/**
+ * @brief The column layout shared by every row of a FlatQueryData.
+ *
+ * A schema is immutable once created and is shared by reference, rows do not
+ * hold copies of their column names.
+ */
+struct FlatRowSchema {
+  explicit FlatRowSchema(ColumnNames names);
+
+  /// Column names in the order the query returned them.
+  ColumnNames columns;
+
+  /**
+   * @brief Indexes into columns, ordered by column name.
+   *
+   * This is the iteration order of a RowTyped. When a query returns the same
+   * column name twice the last occurrence is kept, like RowTyped assignment.
+   */
+  std::vector<size_t> order;
+};
+
+using FlatRowSchemaRef = std::shared_ptr<const FlatRowSchema>;
+
+/**
+ * @brief Query results stored as one contiguous vector of typed values.
+ *
+ * The results of a single SQL statement share a column layout. Instead of a
+ * RowTyped map per row, with a tree node and a column name copy per value,
+ * values are stored row-major in a single vector and located by index.
+ *
+ * Consumers expecting RowTyped or QueryDataTyped may materialize rows.
+ */
+class FlatQueryData : private only_movable {
+ public:
+  FlatQueryData() = default;
+  FlatQueryData(FlatQueryData&&) = default;
+  FlatQueryData& operator=(FlatQueryData&&) = default;
+
+  /// Create an empty set of results using a new schema.
+  explicit FlatQueryData(ColumnNames columns);
+
+  /// Create an empty set of results sharing an existing schema.
+  explicit FlatQueryData(FlatRowSchemaRef schema);
+
+ public:
+  /// The shared schema, nullptr if no columns were set.
+  const FlatRowSchemaRef& schema() const {
+    return schema_;
+  }
+
+  /// The column names in query order.
+  const ColumnNames& columns() const;
+
+  /// The number of columns in each row.
+  size_t width() const {
+    return width_;
+  }
+
+  /// The number of rows.
+  size_t rows() const {
+    return rows_;
+  }
+
+  bool empty() const {
+    return rows_ == 0;
+  }
+
+  /// Reserve value storage for a number of rows.
+  void reserve(size_t rows);
+
+  /// Append a row and return its width() default-initialized values.
+  RowDataTyped* addRow();
+
+  const RowDataTyped& value(size_t row, size_t column) const {
+    return values_[row * width_ + column];
+  }
+
+  RowDataTyped& value(size_t row, size_t column) {
+    return values_[row * width_ + column];
+  }
+
+  /// Every value, row-major.
+  std::vector<RowDataTyped>& values() {
+    return values_;
+  }
+
+  const std::vector<RowDataTyped>& values() const {
+    return values_;
+  }
+
+  /// Materialize a single row.
+  RowTyped row(size_t row) const;
+
+  /// Compute a row's fingerprint without materializing it.
+  uint64_t fingerprint(size_t row) const;
+
+  /// Copy every row into a QueryDataTyped.
+  void toQueryData(QueryDataTyped& q) const;
+
+  /// Move every row into a QueryDataTyped, leaving these results empty.
+  void moveToQueryData(QueryDataTyped& q);
+
+  /// Remove every row, the schema is kept.
+  void clear();
+
+  /// Copy every row, the copy shares the schema.
+  FlatQueryData copy() const;
+
+ private:
+  /// The shared column layout.
+  FlatRowSchemaRef schema_;
+
+  /// The number of columns per row, cached from the schema.
+  size_t width_{0};
+
+  /// The number of rows, tracked separately to allow zero-width rows.
+  size_t rows_{0};
+
+  /// Row-major values.
+  std::vector<RowDataTyped> values_;
+};
+
+/**
+ * @brief Serialize a FlatQueryData object into a JSON array.
+ *
+ * Each row is serialized like the equivalent RowTyped.
+ *
+ * @param q the FlatQueryData to serialize.
+ * @param doc the managed JSON document.
+ * @param arr [output] the output JSON array.
+ * @param asNumeric true iff numeric values are serialized as such
+ *
+ * @return Status indicating the success or failure of the operation.
+ */
+Status serializeQueryData(const FlatQueryData& q,
+                          JSON& doc,
+                          rapidjson::Document& arr,
+                          bool asNumeric);
+
+/// Write a FlatQueryData as a JSON array, rows are written in column order.
+void writeQueryData(const FlatQueryData& q,
+                    JSONWriter& writer,
+                    bool asNumeric);
+
+/**
+ * @brief Serialize a FlatQueryData object into a JSON string.
+ *
+ * @param q the FlatQueryData to serialize.
+ * @param json [output] the output JSON string.
+ * @param asNumeric true iff numeric values are serialized as such
+ *
+ * @return Status indicating the success or failure of the operation.
+ */
+Status serializeQueryDataJSON(const FlatQueryData& q,
+                              std::string& json,
+                              bool asNumeric);
+
+} // namespace osquery
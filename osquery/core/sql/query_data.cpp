@@ -43,6 +43,26 @@ Status serializeQueryData(const QueryDataTyped& q,
   return Status::success();
 }
 
+void writeQueryData(const QueryData& q,
+                    const ColumnNames& cols,
+                    JSONWriter& writer) {
+  writer.StartArray();
+  for (const auto& r : q) {
+    writeRow(r, cols, writer);
+  }
+  writer.EndArray();
+}
+
+void writeQueryData(const QueryDataTyped& q,
+                    JSONWriter& writer,
+                    bool asNumeric) {
+  writer.StartArray();
+  for (const auto& r : q) {
+    writeRow(r, writer, asNumeric);
+  }
+  writer.EndArray();
+}
+
 Status serializeQueryDataJSON(const QueryData& q, JSON& doc) {
   doc = JSON::newArray();
   ColumnNames cols;
@@ -51,26 +71,21 @@ Status serializeQueryDataJSON(const QueryData& q, JSON& doc) {
 }
 
 Status serializeQueryDataJSON(const QueryData& q, std::string& json) {
-  JSON doc;
-  auto status = serializeQueryDataJSON(q, doc);
-
-  if (!status.ok()) {
-    return status;
-  }
-
-  return doc.toString(json);
+  json.clear();
+  JSONStringStream stream(json);
+  JSONWriter writer(stream);
+  writeQueryData(q, ColumnNames{}, writer);
+  return Status::success();
 }
 
 Status serializeQueryDataJSON(const QueryDataTyped& q,
                               std::string& json,
                               bool asNumeric) {
-  auto doc = JSON::newArray();
-
-  auto status = serializeQueryData(q, doc, doc.doc(), asNumeric);
-  if (!status.ok()) {
-    return status;
-  }
-  return doc.toString(json);
+  json.clear();
+  JSONStringStream stream(json);
+  JSONWriter writer(stream);
+  writeQueryData(q, writer, asNumeric);
+  return Status::success();
 }
 
 Status deserializeQueryData(const rj::Value& arr, QueryData& qd) {
@@ -130,20 +145,30 @@ Status deserializeQueryDataJSON(const JSON& doc, QueryData& qd) {
 }
 
 Status deserializeQueryDataJSON(const std::string& json, QueryData& qd) {
-  auto doc = JSON::newArray();
-  if (!doc.fromString(json)) {
+  auto status =
+      deserializeRowsJSON(json, [&qd](Row& r) { qd.push_back(std::move(r)); });
+  if (!status.ok()) {
     return Status(1, "Cannot deserializing JSON");
   }
+  return Status::success();
+}
 
-  return deserializeQueryDataJSON(doc, qd);
+Status deserializeQueryDataJSON(const std::string& json, QueryDataTyped& qd) {
+  auto status = deserializeRowsJSON(
+      json, [&qd](RowTyped& r) { qd.push_back(std::move(r)); });
+  if (!status.ok()) {
+    return Status(1, "Error serializing JSON");
+  }
+  return Status::success();
 }
 
 Status deserializeQueryDataJSON(const std::string& json, QueryDataSet& qd) {
-  rj::Document doc;
-  if (doc.Parse(json.c_str()).HasParseError()) {
+  auto status = deserializeRowsJSON(
+      json, [&qd](RowTyped& r) { qd.insert(std::move(r)); });
+  if (!status.ok()) {
     return Status(1, "Error serializing JSON");
   }
-  return deserializeQueryData(doc, qd);
+  return Status::success();
 }
 
 bool addUniqueRowToQueryData(QueryDataTyped& q, const RowTyped& r) {
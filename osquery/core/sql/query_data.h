@@ -70,6 +70,16 @@ Status serializeQueryData(const QueryDataTyped& q,
                           rapidjson::Document& arr,
                           bool asNumeric);
 
+/// Write a QueryData as a JSON array, see writeRow.
+void writeQueryData(const QueryData& q,
+                    const ColumnNames& cols,
+                    JSONWriter& writer);
+
+/// Write a QueryDataTyped as a JSON array, see writeRow.
+void writeQueryData(const QueryDataTyped& q,
+                    JSONWriter& writer,
+                    bool asNumeric);
+
 /**
  * @brief Serialize a QueryData object into a JSON document.
  *
@@ -117,6 +127,9 @@ Status deserializeQueryDataJSON(const JSON& doc, QueryData& qd);
 /// Inverse of serializeQueryDataJSON, convert a JSON string to QueryData.
 Status deserializeQueryDataJSON(const std::string& json, QueryData& qd);
 
+/// Inverse of serializeQueryDataJSON, convert a JSON string to QueryDataTyped.
+Status deserializeQueryDataJSON(const std::string& json, QueryDataTyped& qd);
+
 /// Inverse of serializeQueryDataJSON, convert a JSON string to QueryDataSet.
 Status deserializeQueryDataJSON(const std::string& json, QueryDataSet& qd);
 
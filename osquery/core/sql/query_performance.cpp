@@ -45,6 +45,16 @@ QueryPerformance::QueryPerformance(const std::string& csv) {
   average_memory = convert<std::uint64_t>(parts[9]);
   last_memory = convert<std::uint64_t>(parts[10]);
   output_size = convert<std::uint64_t>(parts[11]);
+
+  // Statistics stored before the row and result counters were added.
+  if (parts.size() < 16) {
+    return;
+  }
+
+  rows = convert<std::uint64_t>(parts[12]);
+  last_rows = convert<std::uint64_t>(parts[13]);
+  average_result_bytes = convert<std::uint64_t>(parts[14]);
+  last_result_bytes = convert<std::uint64_t>(parts[15]);
 }
 
 std::string QueryPerformance::toCSV() const {
@@ -55,7 +65,10 @@ std::string QueryPerformance::toCSV() const {
          "," + std::to_string(system_time) + "," +
          std::to_string(last_system_time) + "," +
          std::to_string(average_memory) + "," + std::to_string(last_memory) +
-         "," + std::to_string(output_size);
+         "," + std::to_string(output_size) + "," + std::to_string(rows) + "," +
+         std::to_string(last_rows) + "," +
+         std::to_string(average_result_bytes) + "," +
+         std::to_string(last_result_bytes);
 }
 
 bool operator==(const QueryPerformance& l, const QueryPerformance& r) {
@@ -70,18 +83,26 @@ bool operator==(const QueryPerformance& l, const QueryPerformance& r) {
                   l.last_system_time,
                   l.average_memory,
                   l.last_memory,
-                  l.output_size) == std::tie(r.executions,
-                                             r.last_executed,
-                                             r.wall_time,
-                                             r.wall_time_ms,
-                                             r.last_wall_time_ms,
-                                             r.user_time,
-                                             r.last_user_time,
-                                             r.system_time,
-                                             r.last_system_time,
-                                             r.average_memory,
-                                             r.last_memory,
-                                             r.output_size);
+                  l.output_size,
+                  l.rows,
+                  l.last_rows,
+                  l.average_result_bytes,
+                  l.last_result_bytes) == std::tie(r.executions,
+                                                   r.last_executed,
+                                                   r.wall_time,
+                                                   r.wall_time_ms,
+                                                   r.last_wall_time_ms,
+                                                   r.user_time,
+                                                   r.last_user_time,
+                                                   r.system_time,
+                                                   r.last_system_time,
+                                                   r.average_memory,
+                                                   r.last_memory,
+                                                   r.output_size,
+                                                   r.rows,
+                                                   r.last_rows,
+                                                   r.average_result_bytes,
+                                                   r.last_result_bytes);
 }
 
 } // namespace osquery
@@ -15,6 +15,20 @@
 
 namespace osquery {
 
+/**
+ * @brief A sample of the resources used by the worker.
+ */
+struct ResourceUsage {
+  /// User time in milliseconds
+  std::uint64_t user_time{0};
+
+  /// System time in milliseconds
+  std::uint64_t system_time{0};
+
+  /// Resident memory in bytes of the process, 0 if unknown
+  std::uint64_t resident_size{0};
+};
+
 /**
  * @brief performance statistics about a query
  */
@@ -57,6 +71,19 @@ struct QueryPerformance {
   /// Total bytes for the query
   std::uint64_t output_size{0};
 
+  /// Total rows returned
+  std::uint64_t rows{0};
+
+  /// Rows returned by the latest execution
+  std::uint64_t last_rows{0};
+
+  /// Average of the bytes of result rows held after collecting results
+  std::uint64_t average_result_bytes{0};
+
+  /// Bytes of result rows held after collecting results of the latest
+  /// execution
+  std::uint64_t last_result_bytes{0};
+
   // Default constructor
   QueryPerformance() = default;
 
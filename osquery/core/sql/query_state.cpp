@@ -0,0 +1,57 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include "query_state.h"
+
+#include <boost/lexical_cast.hpp>
+
+namespace osquery {
+
+namespace {
+
+const std::uint64_t kHasCounterFlag{1};
+const std::uint64_t kHasFingerprintsFlag{2};
+
+} // namespace
+
+std::string QueryState::encode() const {
+  std::uint64_t flags = (has_counter ? kHasCounterFlag : 0) |
+                        (has_fingerprints ? kHasFingerprintsFlag : 0);
+  return std::to_string(epoch) + "," + std::to_string(counter) + "," +
+         std::to_string(flags) + "," + query;
+}
+
+Status QueryState::decode(const std::string& encoded, QueryState& state) {
+  // The query text is last, it may contain commas.
+  auto first = encoded.find(',');
+  auto second = (first != std::string::npos) ? encoded.find(',', first + 1)
+                                             : std::string::npos;
+  auto third = (second != std::string::npos) ? encoded.find(',', second + 1)
+                                             : std::string::npos;
+  if (third == std::string::npos) {
+    return Status::failure("Malformed query state");
+  }
+
+  std::uint64_t flags = 0;
+  if (!boost::conversion::try_lexical_convert(encoded.substr(0, first),
+                                              state.epoch) ||
+      !boost::conversion::try_lexical_convert(
+          encoded.substr(first + 1, second - first - 1), state.counter) ||
+      !boost::conversion::try_lexical_convert(
+          encoded.substr(second + 1, third - second - 1), flags)) {
+    return Status::failure("Malformed query state");
+  }
+
+  state.has_counter = (flags & kHasCounterFlag) != 0;
+  state.has_fingerprints = (flags & kHasFingerprintsFlag) != 0;
+  state.query = encoded.substr(third + 1);
+  return Status::success();
+}
+
+} // namespace osquery
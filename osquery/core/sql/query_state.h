@@ -0,0 +1,49 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/**
+ * @brief The state of a scheduled query's differential.
+ *
+ * It is stored in one value next to the stored results. It replaces the
+ * separate epoch, counter and query text values so it is read with one get
+ * and written in the same batch as the results.
+ */
+struct QueryState {
+  /// The epoch of the stored results.
+  std::uint64_t epoch{0};
+
+  /// The execution counter within the epoch.
+  std::uint64_t counter{0};
+
+  /// True if a counter was stored, the first counter of an epoch may be 0.
+  bool has_counter{false};
+
+  /// True if the stored row fingerprints match the stored results.
+  bool has_fingerprints{false};
+
+  /// The query text the results were stored for.
+  std::string query;
+
+  /// Serialize the state as epoch,counter,flags,query.
+  [[nodiscard]] std::string encode() const;
+
+  /// Parse a state serialized with encode.
+  static Status decode(const std::string& encoded, QueryState& state);
+};
+
+} // namespace osquery
@@ -8,12 +8,59 @@
  */
 
 #include "row.h"
+
+#include <limits>
+
 #include <osquery/utils/conversions/castvariant.h>
 
 namespace rj = rapidjson;
 
 namespace osquery {
 
+namespace {
+
+/// FNV-1a 64-bit prime, used for the persisted row fingerprints.
+const uint64_t kFingerprintPrime = 1099511628211ULL;
+
+inline void fingerprintBytes(uint64_t& hash, const void* data, size_t size) {
+  auto bytes = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= bytes[i];
+    hash *= kFingerprintPrime;
+  }
+}
+
+inline void fingerprintString(uint64_t& hash, const std::string& str) {
+  // Include the length so adjacent strings cannot shift into each other.
+  uint64_t size = str.size();
+  fingerprintBytes(hash, &size, sizeof(size));
+  fingerprintBytes(hash, str.data(), str.size());
+}
+
+class FingerprintVisitor : public boost::static_visitor<> {
+ public:
+  explicit FingerprintVisitor(uint64_t& hash) : hash_(hash) {}
+
+  void operator()(const long long& i) const {
+    fingerprintBytes(hash_, "i", 1);
+    fingerprintBytes(hash_, &i, sizeof(i));
+  }
+
+  void operator()(const double& d) const {
+    fingerprintBytes(hash_, "d", 1);
+    fingerprintBytes(hash_, &d, sizeof(d));
+  }
+
+  void operator()(const std::string& str) const {
+    fingerprintBytes(hash_, "s", 1);
+    fingerprintString(hash_, str);
+  }
+
+ private:
+  uint64_t& hash_;
+};
+} // namespace
+
 Status serializeRow(const Row& r,
                     const ColumnNames& cols,
                     JSON& doc,
@@ -64,32 +111,88 @@ Status serializeRow(const RowTyped& r,
       boost::apply_visitor([&doc, &obj, &key = i.first](
                                auto value) { doc.add(key, value, obj); },
                            i.second);
+    } else if (i.second.which() == 2) {
+      doc.addRef(i.first, boost::get<std::string>(i.second), obj);
     } else {
-      doc.addRef(i.first, castVariant(i.second), obj);
+      // The converted value is a temporary, it must be copied.
+      doc.addCopy(i.first, castVariant(i.second), obj);
     }
   }
   return Status::success();
 }
 
-Status serializeRowJSON(const RowTyped& r, std::string& json, bool asNumeric) {
-  auto doc = JSON::newObject();
-  auto status = serializeRow(r, doc, doc.doc(), asNumeric);
-  if (!status.ok()) {
-    return status;
+void writeRow(const Row& r, const ColumnNames& cols, JSONWriter& writer) {
+  writer.StartObject();
+  if (cols.empty()) {
+    for (const auto& i : r) {
+      writer.Key(i.first.data(), static_cast<rj::SizeType>(i.first.size()));
+      writer.String(i.second.data(),
+                    static_cast<rj::SizeType>(i.second.size()));
+    }
+  } else {
+    for (const auto& c : cols) {
+      auto i = r.find(c);
+      if (i != r.end()) {
+        writer.Key(c.data(), static_cast<rj::SizeType>(c.size()));
+        writer.String(i->second.data(),
+                      static_cast<rj::SizeType>(i->second.size()));
+      }
+    }
   }
-  return doc.toString(json);
+  writer.EndObject();
+}
+
+class WriterVisitor : public boost::static_visitor<> {
+ public:
+  explicit WriterVisitor(JSONWriter& writer) : writer_(writer) {}
+
+  void operator()(const long long& i) const {
+    writer_.Int64(i);
+  }
+
+  void operator()(const double& d) const {
+    writer_.Double(d);
+  }
+
+  void operator()(const std::string& str) const {
+    writer_.String(str.data(), static_cast<rj::SizeType>(str.size()));
+  }
+
+ private:
+  JSONWriter& writer_;
+};
+
+void writeRow(const RowTyped& r, JSONWriter& writer, bool asNumeric) {
+  WriterVisitor visitor(writer);
+  writer.StartObject();
+  for (const auto& i : r) {
+    writer.Key(i.first.data(), static_cast<rj::SizeType>(i.first.size()));
+    if (asNumeric || i.second.which() == 2) {
+      boost::apply_visitor(visitor, i.second);
+    } else {
+      auto value = castVariant(i.second);
+      writer.String(value.data(), static_cast<rj::SizeType>(value.size()));
+    }
+  }
+  writer.EndObject();
+}
+
+Status serializeRowJSON(const RowTyped& r, std::string& json, bool asNumeric) {
+  json.clear();
+  JSONStringStream stream(json);
+  JSONWriter writer(stream);
+  writeRow(r, writer, asNumeric);
+  return Status::success();
 }
 
 Status serializeRowJSON(const Row& r, std::string& json) {
-  auto doc = JSON::newObject();
+  json.clear();
+  JSONStringStream stream(json);
+  JSONWriter writer(stream);
 
   // An empty column list will traverse the row map.
-  ColumnNames cols;
-  auto status = serializeRow(r, cols, doc, doc.doc());
-  if (!status.ok()) {
-    return status;
-  }
-  return doc.toString(json);
+  writeRow(r, ColumnNames{}, writer);
+  return Status::success();
 }
 
 Status deserializeRow(const rj::Value& doc, Row& r) {
@@ -127,20 +230,188 @@ Status deserializeRow(const rj::Value& doc, RowTyped& r) {
   return Status::success();
 }
 
+namespace {
+
+/// Rows of strings only keep string values.
+template <typename T>
+void setNumber(Row&, const std::string&, T) {}
+
+template <typename T>
+void setNumber(RowTyped& r, const std::string& key, T value) {
+  r[key] = value;
+}
+
+/**
+ * @brief A SAX handler decoding rows, the equivalent of deserializeRow.
+ *
+ * The input is a row object, or an array of row objects. Values that
+ * deserializeRow skips, such as nested objects, are skipped.
+ */
+template <typename RowType>
+class RowsHandler
+    : public rj::BaseReaderHandler<rj::UTF8<>, RowsHandler<RowType>> {
+ public:
+  RowsHandler(bool is_array, const std::function<void(RowType&)>& callback)
+      : row_depth_(is_array ? 2 : 1), callback_(callback) {}
+
+  bool StartObject() {
+    if (++depth_ < row_depth_) {
+      // A row is expected.
+      return false;
+    }
+    if (depth_ == row_depth_) {
+      row_.clear();
+      key_.clear();
+    }
+    return true;
+  }
+
+  bool EndObject(rj::SizeType) {
+    if (depth_-- == row_depth_) {
+      callback_(row_);
+    }
+    return true;
+  }
+
+  bool StartArray() {
+    ++depth_;
+    return depth_ > row_depth_ || (depth_ == 1 && row_depth_ == 2);
+  }
+
+  bool EndArray(rj::SizeType) {
+    --depth_;
+    return true;
+  }
+
+  bool Key(const char* str, rj::SizeType length, bool) {
+    if (depth_ == row_depth_) {
+      key_.assign(str, length);
+    }
+    return true;
+  }
+
+  bool String(const char* str, rj::SizeType length, bool) {
+    if (isColumn()) {
+      row_[key_] = std::string(str, length);
+    }
+    return depth_ >= row_depth_;
+  }
+
+  bool Int(int i) {
+    return Int64(i);
+  }
+
+  bool Uint(unsigned u) {
+    return Int64(u);
+  }
+
+  bool Int64(int64_t i) {
+    if (isColumn()) {
+      setNumber(row_, key_, static_cast<long long>(i));
+    }
+    return depth_ >= row_depth_;
+  }
+
+  bool Uint64(uint64_t u) {
+    // Values beyond the signed range are skipped, as by deserializeRow.
+    if (u <= static_cast<uint64_t>(std::numeric_limits<int64_t>::max())) {
+      return Int64(static_cast<int64_t>(u));
+    }
+    return depth_ >= row_depth_;
+  }
+
+  bool Double(double d) {
+    if (isColumn()) {
+      setNumber(row_, key_, d);
+    }
+    return depth_ >= row_depth_;
+  }
+
+  /// Booleans and nulls are skipped.
+  bool Default() {
+    return depth_ >= row_depth_;
+  }
+
+ private:
+  bool isColumn() const {
+    return depth_ == row_depth_ && !key_.empty();
+  }
+
+ private:
+  /// The nesting depth of the current value, rows are at row_depth_.
+  size_t depth_{0};
+
+  const size_t row_depth_;
+
+  std::string key_;
+
+  RowType row_;
+
+  const std::function<void(RowType&)>& callback_;
+};
+
+/// Columns are added to the output row, like deserializeRow.
+template <typename RowType>
+void mergeRow(RowType& r, RowType& row) {
+  if (r.empty()) {
+    r = std::move(row);
+    return;
+  }
+  for (auto& column : row) {
+    r[column.first] = std::move(column.second);
+  }
+}
+
+template <typename RowType>
+Status parseRows(const std::string& json,
+                 bool is_array,
+                 const std::function<void(RowType&)>& callback) {
+  RowsHandler<RowType> handler(is_array, callback);
+  return parseJSON(json, handler);
+}
+} // namespace
+
 Status deserializeRowJSON(const std::string& json, Row& r) {
-  auto doc = JSON::newObject();
-  if (!doc.fromString(json) || !doc.doc().IsObject()) {
+  std::function<void(Row&)> callback = [&r](Row& row) { mergeRow(r, row); };
+  if (!parseRows(json, false, callback).ok()) {
     return Status(1, "Cannot deserializing JSON");
   }
-  return deserializeRow(doc.doc(), r);
+  return Status::success();
 }
 
 Status deserializeRowJSON(const std::string& json, RowTyped& r) {
-  auto doc = JSON::newObject();
-  if (!doc.fromString(json) || !doc.doc().IsObject()) {
+  std::function<void(RowTyped&)> callback = [&r](RowTyped& row) {
+    mergeRow(r, row);
+  };
+  if (!parseRows(json, false, callback).ok()) {
     return Status(1, "Cannot deserializing JSON");
   }
-  return deserializeRow(doc.doc(), r);
+  return Status::success();
+}
+
+Status deserializeRowsJSON(const std::string& json,
+                           const std::function<void(Row&)>& callback) {
+  return parseRows(json, true, callback);
+}
+
+Status deserializeRowsJSON(const std::string& json,
+                           const std::function<void(RowTyped&)>& callback) {
+  return parseRows(json, true, callback);
+}
+
+void RowFingerprinter::add(const std::string& column,
+                           const RowDataTyped& value) {
+  fingerprintString(hash_, column);
+  boost::apply_visitor(FingerprintVisitor(hash_), value);
+}
+
+uint64_t fingerprintRow(const RowTyped& r) {
+  // The row is an ordered map, columns are always visited in the same order.
+  RowFingerprinter fingerprinter;
+  for (const auto& column : r) {
+    fingerprinter.add(column.first, column.second);
+  }
+  return fingerprinter.get();
 }
 
 } // namespace osquery
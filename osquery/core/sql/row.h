@@ -9,6 +9,7 @@
 
 #pragma once
 
+#include <functional>
 #include <map>
 #include <string>
 #include <vector>
@@ -84,6 +85,24 @@ Status serializeRow(const RowTyped& r,
                     rapidjson::Value& obj,
                     bool asNumeric);
 
+/**
+ * @brief Write a Row as a JSON object.
+ *
+ * @param r the Row to write.
+ * @param cols the column order, an empty list writes every column.
+ * @param writer [output] the JSON writer.
+ */
+void writeRow(const Row& r, const ColumnNames& cols, JSONWriter& writer);
+
+/**
+ * @brief Write a RowTyped as a JSON object.
+ *
+ * @param r the RowTyped to write.
+ * @param writer [output] the JSON writer.
+ * @param asNumeric true iff numeric values are serialized as such
+ */
+void writeRow(const RowTyped& r, JSONWriter& writer, bool asNumeric);
+
 /**
  * @brief Serialize a Row object into a JSON string.
  *
@@ -145,4 +164,52 @@ Status deserializeRowJSON(const std::string& json, Row& r);
  */
 Status deserializeRowJSON(const std::string& json, RowTyped& r);
 
+/**
+ * @brief Decode a JSON array of Row objects without building a document.
+ *
+ * The rows equal those of deserializeQueryData. Each row is passed to the
+ * callback as it is decoded, it may be moved from.
+ *
+ * @param json the input JSON string.
+ * @param callback receives each row.
+ *
+ * @return Status indicating the success or failure of the operation
+ */
+Status deserializeRowsJSON(const std::string& json,
+                           const std::function<void(Row&)>& callback);
+
+/// Decode a JSON array of RowTyped objects, see deserializeRowsJSON.
+Status deserializeRowsJSON(const std::string& json,
+                           const std::function<void(RowTyped&)>& callback);
+
+/**
+ * @brief Incrementally compute the fingerprint of a typed row.
+ *
+ * Columns must be added in ascending name order, the order of a RowTyped, for
+ * the result to match fingerprintRow.
+ */
+class RowFingerprinter {
+ public:
+  /// Add a column and its value to the fingerprint.
+  void add(const std::string& column, const RowDataTyped& value);
+
+  /// The fingerprint of the columns added so far.
+  uint64_t get() const {
+    return hash_;
+  }
+
+ private:
+  /// FNV-1a 64-bit offset basis.
+  uint64_t hash_{14695981039346656037ULL};
+};
+
+/**
+ * @brief Compute a 64-bit fingerprint of a typed row.
+ *
+ * Two rows that compare equal have the same fingerprint. The type of each
+ * value is included, so the integer 1 and the string "1" are distinct.
+ * The fingerprint is stable across runs and may be persisted.
+ */
+uint64_t fingerprintRow(const RowTyped& r);
+
 } // namespace osquery
@@ -0,0 +1,38 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <utility>
+
+#include "scan_slice.h"
+
+namespace osquery {
+
+namespace {
+
+/// The slice of the thread, if a scheduled scan is sliced on it.
+thread_local ScanSlice* current_slice{nullptr};
+
+} // namespace
+
+ScanSlice::ScanSlice(size_t max_paths, std::string cursor)
+    : cursor_(std::move(cursor)),
+      remaining_(max_paths),
+      previous_(current_slice) {
+  current_slice = this;
+}
+
+ScanSlice::~ScanSlice() {
+  current_slice = previous_;
+}
+
+ScanSlice* ScanSlice::current() {
+  return current_slice;
+}
+
+} // namespace osquery
@@ -0,0 +1,114 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace osquery {
+
+/**
+ * @brief A bounded part of a scan over many paths, such as a hash sweep.
+ *
+ * While a slice exists, the traversal tables of the calling thread only scan
+ * the paths sorting after the cursor, and at most the remaining paths of the
+ * slice. The cursor then names the last path scanned, the next slice of the
+ * same scan resumes after it.
+ *
+ * Tables call select with the list of their targets before scanning them,
+ * the list is not changed if no slice is used.
+ */
+class ScanSlice {
+ public:
+  /**
+   * @brief Limit the scans of the calling thread to a slice.
+   *
+   * @param max_paths The paths the slice may scan.
+   * @param cursor The last path scanned by the previous slice, empty for the
+   * first slice.
+   */
+  ScanSlice(size_t max_paths, std::string cursor);
+
+  /// Restore the slice used before this one, if any.
+  ~ScanSlice();
+
+  ScanSlice(const ScanSlice&) = delete;
+  ScanSlice& operator=(const ScanSlice&) = delete;
+
+  /// The slice of the calling thread, nullptr if scans are not sliced.
+  static ScanSlice* current();
+
+  /**
+   * @brief Keep the targets of a scan within the slice of the calling thread.
+   *
+   * The targets are sorted by path, those scanned by previous slices and
+   * those beyond the slice are removed.
+   *
+   * @param targets The targets a table would scan.
+   * @param path Returns the path of a target.
+   */
+  template <typename Target, typename Path>
+  static void select(std::vector<Target>& targets, Path path) {
+    auto* slice = current();
+    if (slice == nullptr) {
+      return;
+    }
+
+    std::stable_sort(targets.begin(),
+                     targets.end(),
+                     [&path](const Target& left, const Target& right) {
+                       return path(left) < path(right);
+                     });
+    const auto& cursor = slice->cursor_;
+    auto first = std::find_if(
+        targets.begin(), targets.end(), [&path, &cursor](const Target& t) {
+          return cursor.empty() || cursor < path(t);
+        });
+    targets.erase(targets.begin(), first);
+
+    if (targets.size() > slice->remaining_) {
+      targets.erase(targets.begin() + slice->remaining_, targets.end());
+      slice->complete_ = false;
+    }
+    slice->remaining_ -= targets.size();
+    if (!targets.empty() && slice->last_ < path(targets.back())) {
+      slice->last_ = path(targets.back());
+    }
+  }
+
+  /// The last path scanned so far, the cursor of the next slice.
+  const std::string& cursor() const {
+    return last_.empty() ? cursor_ : last_;
+  }
+
+  /// Check if the scan has no paths left beyond this slice.
+  bool complete() const {
+    return complete_;
+  }
+
+ private:
+  /// The last path scanned by the previous slices.
+  std::string cursor_;
+
+  /// The last path selected by this slice.
+  std::string last_;
+
+  /// The paths this slice may still select.
+  size_t remaining_{0};
+
+  bool complete_{true};
+
+  /// The slice of the thread when this slice was created.
+  ScanSlice* previous_{nullptr};
+};
+
+} // namespace osquery
@@ -9,13 +9,39 @@
 
 #pragma once
 
+#include <cstdint>
 #include <map>
 #include <string>
+#include <vector>
 
 #include <osquery/utils/only_movable.h>
 
 namespace osquery {
 
+/**
+ * @brief The resources a single run of a scheduled query may use.
+ *
+ * A run exceeding any of these fails alone, 0 is unlimited.
+ */
+struct QueryBudget {
+  /// Milliseconds the query may run for.
+  uint64_t wall_time_ms{0};
+
+  /// Milliseconds of CPU time the query may use on its thread.
+  uint64_t cpu_time_ms{0};
+
+  /// Rows the query may return.
+  uint64_t rows{0};
+
+  /// Bytes of results the query may hold.
+  uint64_t result_bytes{0};
+
+  /// Check if the run is limited in time, and must be checked while running.
+  bool timed() const {
+    return wall_time_ms > 0 || cpu_time_ms > 0;
+  }
+};
+
 /**
  * @brief Represents the relevant parameters of a scheduled query.
  *
@@ -41,6 +67,9 @@ struct ScheduledQuery : private only_movable {
   /// A temporary splayed internal.
   uint64_t splayed_interval{0};
 
+  /// The step within each splayed interval the query is launched at.
+  uint64_t splayed_offset{0};
+
   /**
    * @brief Queries are denylisted based on logic in the configuration.
    *
@@ -53,6 +82,15 @@ struct ScheduledQuery : private only_movable {
   /// Set of query options.
   std::map<std::string, bool> options;
 
+  /// Limits on the resources of each run.
+  QueryBudget budget;
+
+  /// Columns identifying a row, the differential then reports changed rows.
+  std::vector<std::string> keys;
+
+  /// Paths each run of a sliced scan may scan, 0 if scans are not sliced.
+  uint64_t scan_slice{0};
+
   ScheduledQuery(const std::string& pack_name,
                  const std::string& name,
                  const std::string& query)
@@ -87,6 +125,16 @@ struct ScheduledQuery : private only_movable {
     return it->second;
   }
 
+  /**
+   * @brief Returns true if the query may be denylisted, otherwise false.
+   *
+   * @return A bool indicating if this query may be denylisted.
+   */
+  inline bool isDenylistable() const {
+    auto it = options.find("denylist");
+    return it == options.end() || it->second;
+  }
+
   /// equals operator
   bool operator==(const ScheduledQuery& comp) const {
     return (comp.query == query) && (comp.interval == interval);
@@ -28,6 +28,10 @@ class TableRow {
   TableRow() = default;
   virtual ~TableRow() {}
 
+  /// Rows are carved from the TableRowPool of a scan, see table_row_pool.h.
+  static void* operator new(size_t size);
+  static void operator delete(void* ptr) noexcept;
+
   /**
    * Output the rowid of the current row into pRowid, returning SQLITE_OK if
    * successful or SQLITE_ERROR if not.
@@ -0,0 +1,137 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <new>
+
+#include "table_row.h"
+#include "table_row_pool.h"
+
+namespace osquery {
+
+namespace {
+
+constexpr size_t kAlignment = alignof(std::max_align_t);
+
+/// The slab bytes expected for a row, a DynamicTableRow and its header.
+constexpr size_t kExpectedRowSize = 96;
+
+constexpr size_t kMinSlabCapacity = 16 * 1024;
+constexpr size_t kMaxSlabCapacity = 1024 * 1024;
+
+/// Larger rows are allocated from the heap.
+constexpr size_t kMaxPooledSize = 1024;
+
+/// The pool of the thread, if a scan is generating rows on it.
+thread_local TableRowPool* current_pool{nullptr};
+
+inline size_t alignUp(size_t size) {
+  return (size + kAlignment - 1) & ~(kAlignment - 1);
+}
+
+} // namespace
+
+struct alignas(kAlignment) TableRowPool::Slab {
+  /// The live rows of the slab, and one for the pool while it is current.
+  std::atomic<size_t> references{1};
+
+  size_t capacity{0};
+  size_t used{0};
+
+  char* data() {
+    return reinterpret_cast<char*>(this + 1);
+  }
+};
+
+/// Precedes every row, the slab is nullptr for rows from the heap.
+struct alignas(kAlignment) TableRowPool::BlockHeader {
+  Slab* slab{nullptr};
+};
+
+void TableRowPool::unref(Slab* slab) noexcept {
+  if (slab->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    slab->~Slab();
+    ::operator delete(slab);
+  }
+}
+
+TableRowPool::TableRowPool(size_t expected_rows) : previous_(current_pool) {
+  auto capacity = expected_rows * kExpectedRowSize;
+  next_capacity_ = std::min(std::max(capacity, kMinSlabCapacity),
+                            kMaxSlabCapacity);
+  current_pool = this;
+}
+
+TableRowPool::~TableRowPool() {
+  retire();
+  current_pool = previous_;
+}
+
+void TableRowPool::retire() noexcept {
+  if (current_ != nullptr) {
+    unref(current_);
+    current_ = nullptr;
+  }
+}
+
+void* TableRowPool::carve(size_t size) {
+  if (current_ == nullptr || current_->used + size > current_->capacity) {
+    retire();
+
+    auto* memory = ::operator new(sizeof(Slab) + next_capacity_);
+    current_ = new (memory) Slab();
+    current_->capacity = next_capacity_;
+    next_capacity_ = std::min(next_capacity_ * 2, kMaxSlabCapacity);
+    ++slabs_;
+  }
+
+  auto* block = current_->data() + current_->used;
+  current_->used += size;
+  current_->references.fetch_add(1, std::memory_order_relaxed);
+  new (block) BlockHeader{current_};
+  return block;
+}
+
+void* TableRowPool::allocate(size_t size) {
+  auto block_size = sizeof(BlockHeader) + alignUp(size);
+
+  void* block = nullptr;
+  if (current_pool != nullptr && block_size <= kMaxPooledSize) {
+    block = current_pool->carve(block_size);
+  } else {
+    block = ::operator new(block_size);
+    new (block) BlockHeader();
+  }
+  return static_cast<char*>(block) + sizeof(BlockHeader);
+}
+
+void TableRowPool::release(void* ptr) noexcept {
+  if (ptr == nullptr) {
+    return;
+  }
+
+  auto* header = reinterpret_cast<BlockHeader*>(static_cast<char*>(ptr) -
+                                                sizeof(BlockHeader));
+  if (header->slab == nullptr) {
+    ::operator delete(header);
+  } else {
+    unref(header->slab);
+  }
+}
+
+void* TableRow::operator new(size_t size) {
+  return TableRowPool::allocate(size);
+}
+
+void TableRow::operator delete(void* ptr) noexcept {
+  TableRowPool::release(ptr);
+}
+
+} // namespace osquery
@@ -0,0 +1,83 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace osquery {
+
+/**
+ * @brief Slab allocation of the table rows generated by one table scan.
+ *
+ * A table returning 100k rows otherwise allocates each TableRow on its own.
+ * While a pool exists, the TableRow objects created by the same thread are
+ * carved from shared slabs, both the DynamicTableRow made by make_table_row
+ * and the strongly typed rows of generated tables. The string maps and
+ * strings within the rows still use the default allocator.
+ *
+ * A slab is released once the pool is gone and every row carved from it was
+ * deleted, rows may outlive the pool and be deleted by any thread. Rows
+ * created by other threads, or larger than a slab block, use the heap.
+ */
+class TableRowPool {
+ public:
+  /**
+   * @brief Use a pool for the rows created by the calling thread.
+   *
+   * @param expected_rows The rows the scan is expected to return, such as
+   * the average of the table statistics, 0 if unknown. It sizes the first
+   * slab.
+   */
+  explicit TableRowPool(size_t expected_rows);
+
+  /// Restore the pool used before this one, if any.
+  ~TableRowPool();
+
+  TableRowPool(const TableRowPool&) = delete;
+  TableRowPool& operator=(const TableRowPool&) = delete;
+
+  /// Allocate a row from the pool of the calling thread, or from the heap.
+  static void* allocate(size_t size);
+
+  /// Release a row allocated with allocate.
+  static void release(void* ptr) noexcept;
+
+  /// The number of slabs this pool allocated.
+  size_t slabs() const {
+    return slabs_;
+  }
+
+ private:
+  struct Slab;
+  struct BlockHeader;
+
+  /// Carve a block, including its header, from the current slab.
+  void* carve(size_t size);
+
+  /// Drop the reference the pool holds on the current slab.
+  void retire() noexcept;
+
+  /// Release a slab once it is not current and its rows are deleted.
+  static void unref(Slab* slab) noexcept;
+
+ private:
+  /// The slab rows are currently carved from.
+  Slab* current_{nullptr};
+
+  /// The capacity of the next slab.
+  size_t next_capacity_{0};
+
+  size_t slabs_{0};
+
+  /// The pool of the thread when this pool was created.
+  TableRowPool* previous_{nullptr};
+};
+
+} // namespace osquery
@@ -8,6 +8,8 @@
  */
 
 #include "table_rows.h"
+#include "binary_encoding.h"
+#include "binary_rows.h"
 
 namespace rj = rapidjson;
 
@@ -35,4 +37,22 @@ Status serializeTableRowsJSON(const TableRows& rows, std::string& json) {
   return doc.toString(json);
 }
 
+void serializeTableRowsBinary(const TableRows& rows, std::string& encoded) {
+  BinaryRowDictionary dictionary;
+  std::string body;
+  std::string row;
+  putVarint(body, rows.size());
+  for (const auto& r : rows) {
+    dictionary.encode(static_cast<Row>(*r), row);
+    putString(body, row);
+  }
+
+  // The dictionary is complete once every row is encoded.
+  std::string serialized;
+  dictionary.serialize(serialized);
+  encoded.clear();
+  putString(encoded, serialized);
+  encoded.append(body);
+}
+
 } // namespace osquery
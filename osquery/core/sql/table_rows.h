@@ -47,4 +47,15 @@ Status deserializeTableRows(const rapidjson::Value& arr, TableRows& rows);
 /// Inverse of serializeTableRowsJSON, convert a JSON string to TableRows.
 Status deserializeTableRowsJSON(const std::string& json, TableRows& rows);
 
+/**
+ * @brief Serialize a TableRows object with the binary row encoding.
+ *
+ * The rows share a BinaryRowDictionary stored with them, this is more
+ * compact and faster to read back than JSON.
+ */
+void serializeTableRowsBinary(const TableRows& rows, std::string& encoded);
+
+/// Inverse of serializeTableRowsBinary.
+Status deserializeTableRowsBinary(const std::string& encoded, TableRows& rows);
+
 } // namespace osquery
@@ -10,18 +10,41 @@
 #include <osquery/utils/json/json.h>
 
 #include <osquery/core/flags.h>
+#include <osquery/core/sql/columnar_results.h>
 #include <osquery/core/tables.h>
 #include <osquery/database/database.h>
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry_factory.h>
 #include <osquery/utils/conversions/tryto.h>
+#include <osquery/utils/system/uptime.h>
 
+#include <algorithm>
+#include <atomic>
 #include <climits>
+#include <exception>
+#include <map>
+#include <memory>
+#include <thread>
 
 namespace osquery {
 
 FLAG(bool, disable_caching, false, "Disable scheduled query caching");
 
+FLAG(uint64,
+     table_cache_max_bytes,
+     64 * 1024 * 1024,
+     "Memory budget in bytes for the cached results of cacheable tables");
+
+FLAG(bool,
+     table_cache_persist,
+     false,
+     "Also save the cached results of cacheable tables to the database");
+
+FLAG(uint32,
+     table_io_concurrency,
+     1,
+     "Concurrent remote requests of one table scan, 1 runs them serially");
+
 CREATE_LAZY_REGISTRY(TablePlugin, "table");
 
 uint64_t TablePlugin::kCacheInterval = 0;
@@ -140,8 +163,35 @@ Status TablePlugin::call(const PluginRequest& request,
 
   if (action == "generate") {
     auto context = getContextFromRequest(request);
-    TableRows result = generate(context);
+    TableRows result;
+    if (usesGenerator()) {
+      // Registry and extension callers receive every row in one response.
+      RowGenerator::pull_type rows(
+          [this, &context](RowYield& yield) { generator(yield, context); });
+      for (auto& row : rows) {
+        result.push_back(std::move(row));
+      }
+    } else {
+      result = generate(context);
+    }
     response = tableRowsToPluginResponse(result);
+
+    // Columns the caller does not read are not returned, extensions may
+    // also skip computing them using QueryContext::isColumnUsed.
+    if (context.colsUsed) {
+      for (auto& r : response) {
+        for (auto it = r.begin(); it != r.end();) {
+          it = context.isColumnUsed(it->first) ? std::next(it) : r.erase(it);
+        }
+      }
+    }
+
+    // The caller accepts every row as one encoded value.
+    if (request.count(kColumnarRowsKey) > 0) {
+      std::string encoded;
+      ColumnarResults::encode(response, encoded);
+      response = {{{kColumnarRowsKey, std::move(encoded)}}};
+    }
   } else if (action == "delete") {
     auto context = getContextFromRequest(request);
     response = delete_(context, request);
@@ -195,12 +245,9 @@ PluginResponse TablePlugin::routeInfo() const {
   return response;
 }
 
-static bool cacheAllowed(const TableColumns& cols, const QueryContext& ctx) {
-  if (!ctx.useCache() || !ctx.defaultColumnsUsed()) {
-    // The query execution did not request use of the warm cache.
-    return false;
-  }
-
+/// Check that no constraint changes the rows the table generates.
+static bool constraintsCacheable(const TableColumns& cols,
+                                 const QueryContext& ctx) {
   auto uncachable = ColumnOptions::INDEX | ColumnOptions::REQUIRED |
                     ColumnOptions::ADDITIONAL | ColumnOptions::OPTIMIZED;
   for (const auto& column : cols) {
@@ -212,22 +259,154 @@ static bool cacheAllowed(const TableColumns& cols, const QueryContext& ctx) {
   return true;
 }
 
+static bool cacheAllowed(const TableColumns& cols, const QueryContext& ctx) {
+  if (!ctx.useCache() || !ctx.defaultColumnsUsed()) {
+    // The query execution did not request use of the warm cache.
+    return false;
+  }
+
+  return constraintsCacheable(cols, ctx);
+}
+
+/// The identifier of this boot, a process does not outlive a boot.
+static const std::string& bootIdentifier() {
+  static const std::string identifier = getBootIdentifier();
+  return identifier;
+}
+
+static TableRows copyTableRows(const TableRows& rows) {
+  TableRows copy;
+  copy.reserve(rows.size());
+  for (const auto& row : rows) {
+    copy.push_back(row->clone());
+  }
+  return copy;
+}
+
+namespace {
+
+/// The bytes accounted for each column of a cached row, besides its strings.
+const size_t kCachedColumnOverhead = 64;
+
+/**
+ * @brief The results of the cacheable tables, shared by the queries.
+ *
+ * Each table keeps an immutable batch of the rows it generated. A query
+ * using the cache copies the rows from the batch, a batch replaced or
+ * evicted meanwhile remains valid for the queries still copying it. The
+ * batches least recently used are evicted to keep within the memory budget.
+ */
+class TableResultsCache {
+ public:
+  using Batch = std::shared_ptr<const TableRows>;
+
+  /// The batch of a table, nullptr if none is cached.
+  Batch get(const std::string& table) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(table);
+    if (it == entries_.end()) {
+      return nullptr;
+    }
+    it->second.used = ++uses_;
+    return it->second.rows;
+  }
+
+  /// Replace the batch of a table, it is dropped if exceeding the budget.
+  void set(const std::string& table, Batch rows, size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    erase(table);
+    if (bytes > FLAGS_table_cache_max_bytes) {
+      return;
+    }
+
+    while (bytes_ + bytes > FLAGS_table_cache_max_bytes) {
+      auto oldest = entries_.begin();
+      for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+        if (it->second.used < oldest->second.used) {
+          oldest = it;
+        }
+      }
+      erase(oldest->first);
+    }
+
+    bytes_ += bytes;
+    entries_[table] = {std::move(rows), bytes, ++uses_};
+  }
+
+ private:
+  void erase(const std::string& table) {
+    auto it = entries_.find(table);
+    if (it != entries_.end()) {
+      bytes_ -= it->second.bytes;
+      entries_.erase(it);
+    }
+  }
+
+ private:
+  struct Entry {
+    Batch rows;
+    size_t bytes{0};
+
+    /// The use count of the cache when the batch was last used.
+    uint64_t used{0};
+  };
+
+  std::mutex mutex_;
+  std::map<std::string, Entry> entries_;
+  size_t bytes_{0};
+  uint64_t uses_{0};
+};
+
+TableResultsCache& getTableResultsCache() {
+  static TableResultsCache cache;
+  return cache;
+}
+
+/// An estimate of the memory used by rows, accounted against the budget.
+size_t tableRowsBytes(const TableRows& rows) {
+  size_t bytes = 0;
+  for (const auto& row : rows) {
+    for (const auto& column : static_cast<Row>(*row)) {
+      bytes += column.first.size() + column.second.size() +
+               kCachedColumnOverhead;
+    }
+  }
+  return bytes;
+}
+
+} // namespace
+
 bool TablePlugin::isCached(uint64_t step, const QueryContext& ctx) const {
   if (FLAGS_disable_caching) {
     return false;
   }
 
   // Perform the step comparison first, because it's easy.
-  return (step < last_cached_ + last_interval_ && cacheAllowed(columns(), ctx));
+  if (step >= last_cached_ + last_interval_ || !cacheAllowed(columns(), ctx)) {
+    return false;
+  }
+
+  // Results evicted from memory may still be read from the database.
+  return FLAGS_table_cache_persist ||
+         getTableResultsCache().get(getName()) != nullptr;
 }
 
 TableRows TablePlugin::getCache() const {
   VLOG(1) << "Retrieving results from cache for table: " << getName();
-  // Lookup results from database and deserialize.
-  std::string content;
-  getDatabaseValue(kQueries, "cache." + getName(), content);
+  auto batch = getTableResultsCache().get(getName());
+  if (batch != nullptr) {
+    return copyTableRows(*batch);
+  }
+
+  // Lookup results from database and decode.
   TableRows results;
-  deserializeTableRowsJSON(content, results);
+  if (FLAGS_table_cache_persist) {
+    std::string content;
+    getDatabaseValue(kQueries, "cache." + getName(), content);
+    if (!deserializeTableRowsBinary(content, results).ok()) {
+      results.clear();
+    }
+  }
   return results;
 }
 
@@ -235,19 +414,76 @@ void TablePlugin::setCache(uint64_t step,
                            uint64_t interval,
                            const QueryContext& ctx,
                            const TableRows& results) {
-  if (FLAGS_disable_caching || !cacheAllowed(columns(), ctx)) {
+  // A scan stopped at the limit of its query does not hold every row.
+  if (FLAGS_disable_caching || !cacheAllowed(columns(), ctx) || ctx.limit) {
     return;
   }
 
-  // Serialize QueryData and save to database.
-  std::string content;
-  if (serializeTableRowsJSON(results, content)) {
-    last_cached_ = step;
-    last_interval_ = interval;
+  auto batch = std::make_shared<const TableRows>(copyTableRows(results));
+  getTableResultsCache().set(getName(), batch, tableRowsBytes(*batch));
+  last_cached_ = step;
+  last_interval_ = interval;
+
+  if (FLAGS_table_cache_persist) {
+    std::string content;
+    serializeTableRowsBinary(*batch, content);
     setDatabaseValue(kQueries, "cache." + getName(), content);
   }
 }
 
+bool TablePlugin::getBootCache(QueryContext& ctx, TableRows& results) {
+  if (FLAGS_disable_caching || bootIdentifier().empty() ||
+      !constraintsCacheable(columns(), ctx)) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(boot_cache_mutex_);
+  if (!boot_cache_ && !boot_cache_read_) {
+    // The results may have been saved by a previous process this boot.
+    boot_cache_read_ = true;
+    std::string content;
+    getDatabaseValue(kQueries, "cache.boot." + getName(), content);
+    auto newline = content.find('\n');
+    if (newline != std::string::npos &&
+        content.compare(0, newline, bootIdentifier()) == 0) {
+      TableRows rows;
+      if (deserializeTableRowsJSON(content.substr(newline + 1), rows)) {
+        boot_cache_ = std::move(rows);
+      }
+    }
+  }
+
+  if (boot_cache_) {
+    results = copyTableRows(*boot_cache_);
+    return true;
+  }
+
+  // Generate the complete results, only those are saved.
+  ctx.colsUsed.reset();
+  ctx.colsUsedBitset.reset();
+  ctx.limit.reset();
+  return false;
+}
+
+void TablePlugin::setBootCache(const QueryContext& ctx,
+                               const TableRows& results) {
+  if (FLAGS_disable_caching || bootIdentifier().empty() ||
+      !ctx.defaultColumnsUsed() || ctx.limit ||
+      !constraintsCacheable(columns(), ctx)) {
+    return;
+  }
+
+  std::string content;
+  if (!serializeTableRowsJSON(results, content)) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(boot_cache_mutex_);
+  boot_cache_ = copyTableRows(results);
+  setDatabaseValue(
+      kQueries, "cache.boot." + getName(), bootIdentifier() + "\n" + content);
+}
+
 std::string columnDefinition(const TableColumns& columns, bool is_extension) {
   std::map<std::string, bool> epilog;
   bool indexed = false;
@@ -420,6 +656,9 @@ bool ConstraintList::matches(const std::string& expr) const {
 template <typename T>
 bool ConstraintList::literal_matches(const T& base_expr) const {
   bool aggregate = true;
+  // Several EQUALS constraints are the values of an IN list.
+  bool has_equals = false;
+  bool equals = false;
   for (size_t i = 0; i < constraints_.size(); ++i) {
     auto constraint_expr = tryTo<T>(constraints_[i].expr);
     if (!constraint_expr) {
@@ -427,7 +666,8 @@ bool ConstraintList::literal_matches(const T& base_expr) const {
       return false;
     }
     if (constraints_[i].op == EQUALS) {
-      aggregate = aggregate && (base_expr == constraint_expr.take());
+      has_equals = true;
+      equals = equals || (base_expr == constraint_expr.take());
     } else if (constraints_[i].op == GREATER_THAN) {
       aggregate = aggregate && (base_expr > constraint_expr.take());
     } else if (constraints_[i].op == LESS_THAN) {
@@ -445,7 +685,7 @@ bool ConstraintList::literal_matches(const T& base_expr) const {
       return false;
     }
   }
-  return true;
+  return !has_equals || equals;
 }
 
 std::set<std::string> ConstraintList::getAll(ConstraintOperator op) const {
@@ -488,6 +728,246 @@ template std::set<long long> ConstraintList::getAll<long long>(
 template std::set<unsigned long long>
     ConstraintList::getAll<unsigned long long>(ConstraintOperator) const;
 
+namespace {
+
+inline char lowerAscii(char c) {
+  return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+inline bool isContinuationByte(char c) {
+  return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+}
+
+std::string toLowerAscii(std::string text) {
+  for (auto& c : text) {
+    c = lowerAscii(c);
+  }
+  return text;
+}
+
+} // namespace
+
+LikePattern::LikePattern(const std::string& pattern) {
+  std::vector<std::string> segments{""};
+  for (auto c : pattern) {
+    if (c == '%') {
+      segments.emplace_back();
+    } else {
+      segments.back() += lowerAscii(c);
+    }
+  }
+
+  first_ = segments.front();
+  prefix_ = first_.substr(0, first_.find('_'));
+  any_ = segments.size() > 1;
+  if (any_) {
+    last_ = segments.back();
+    for (size_t i = 1; i + 1 < segments.size(); ++i) {
+      if (!segments[i].empty()) {
+        middle_.push_back(std::move(segments[i]));
+      }
+    }
+  }
+}
+
+size_t LikePattern::matchSegment(const std::string& value,
+                                 size_t position,
+                                 const std::string& segment) const {
+  for (auto c : segment) {
+    if (position >= value.size()) {
+      return std::string::npos;
+    }
+    if (c == '_') {
+      // Skip one UTF-8 character.
+      ++position;
+      while (position < value.size() && isContinuationByte(value[position])) {
+        ++position;
+      }
+    } else if (lowerAscii(value[position]) == c) {
+      ++position;
+    } else {
+      return std::string::npos;
+    }
+  }
+  return position;
+}
+
+bool LikePattern::matches(const std::string& value) const {
+  auto position = matchSegment(value, 0, first_);
+  if (position == std::string::npos) {
+    return false;
+  }
+  if (!any_) {
+    return position == value.size();
+  }
+
+  // Each segment between wildcards matches at its first position.
+  for (const auto& segment : middle_) {
+    auto end = std::string::npos;
+    for (; position < value.size(); ++position) {
+      if (isContinuationByte(value[position])) {
+        continue;
+      }
+      end = matchSegment(value, position, segment);
+      if (end != std::string::npos) {
+        break;
+      }
+    }
+    if (end == std::string::npos) {
+      return false;
+    }
+    position = end;
+  }
+
+  // The last segment ends the value.
+  for (; position <= value.size(); ++position) {
+    if (position < value.size() && isContinuationByte(value[position])) {
+      continue;
+    }
+    if (matchSegment(value, position, last_) == value.size()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool LikePattern::mayMatchPrefix(const std::string& text) const {
+  // A shorter text may still be followed by the rest of the prefix.
+  auto length = std::min(text.size(), prefix_.size());
+  return prefix_.compare(0, length, toLowerAscii(text.substr(0, length))) ==
+         0;
+}
+
+ConstraintMatcher::ConstraintMatcher(const ConstraintList& list)
+    : affinity_(list.affinity) {
+  if (affinity_ != TEXT_TYPE && affinity_ != INTEGER_TYPE &&
+      affinity_ != BIGINT_TYPE) {
+    list_ = &list;
+    return;
+  }
+
+  for (const auto& constraint : list.getAll()) {
+    if (affinity_ == TEXT_TYPE) {
+      if (constraint.op == EQUALS) {
+        has_equals_ = true;
+        equals_.insert(constraint.expr);
+      } else if (constraint.op == LIKE) {
+        likes_.emplace_back(constraint.expr);
+      } else if (constraint.op == GREATER_THAN ||
+                 constraint.op == GREATER_THAN_OR_EQUALS ||
+                 constraint.op == LESS_THAN ||
+                 constraint.op == LESS_THAN_OR_EQUALS) {
+        comparisons_.emplace_back(constraint.op, constraint.expr);
+      }
+      continue;
+    }
+
+    if (constraint.op != EQUALS && constraint.op != GREATER_THAN &&
+        constraint.op != GREATER_THAN_OR_EQUALS &&
+        constraint.op != LESS_THAN && constraint.op != LESS_THAN_OR_EQUALS) {
+      continue;
+    }
+
+    auto parsed = tryTo<long long>(constraint.expr);
+    if (!parsed) {
+      // As ConstraintList::matches, an unparsable constraint matches nothing.
+      never_ = true;
+      return;
+    }
+
+    auto expr = parsed.take();
+    if (constraint.op == EQUALS) {
+      has_equals_ = true;
+      integer_equals_.insert(expr);
+    } else if (constraint.op == GREATER_THAN &&
+               expr == std::numeric_limits<long long>::max()) {
+      never_ = true;
+    } else if (constraint.op == GREATER_THAN) {
+      min_ = std::max(min_, expr + 1);
+    } else if (constraint.op == GREATER_THAN_OR_EQUALS) {
+      min_ = std::max(min_, expr);
+    } else if (constraint.op == LESS_THAN &&
+               expr == std::numeric_limits<long long>::min()) {
+      never_ = true;
+    } else if (constraint.op == LESS_THAN) {
+      max_ = std::min(max_, expr - 1);
+    } else {
+      max_ = std::min(max_, expr);
+    }
+  }
+}
+
+bool ConstraintMatcher::matchesText(const std::string& value) const {
+  if (has_equals_ && equals_.count(value) == 0) {
+    return false;
+  }
+
+  for (const auto& comparison : comparisons_) {
+    auto order = value.compare(comparison.second);
+    if ((comparison.first == GREATER_THAN && order <= 0) ||
+        (comparison.first == GREATER_THAN_OR_EQUALS && order < 0) ||
+        (comparison.first == LESS_THAN && order >= 0) ||
+        (comparison.first == LESS_THAN_OR_EQUALS && order > 0)) {
+      return false;
+    }
+  }
+
+  for (const auto& like : likes_) {
+    if (!like.matches(value)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ConstraintMatcher::matches(const std::string& value) const {
+  if (never_) {
+    return false;
+  }
+  if (list_ != nullptr) {
+    return list_->matches(value);
+  }
+  if (affinity_ == TEXT_TYPE) {
+    return matchesText(value);
+  }
+
+  auto parsed = tryTo<long long>(value);
+  if (!parsed) {
+    return false;
+  }
+  auto integer = parsed.take();
+  if (integer < min_ || integer > max_) {
+    return false;
+  }
+  return !has_equals_ || integer_equals_.count(integer) > 0;
+}
+
+bool ConstraintMatcher::mayMatchPrefix(const std::string& text) const {
+  if (never_) {
+    return false;
+  }
+  if (affinity_ != TEXT_TYPE || list_ != nullptr) {
+    return true;
+  }
+
+  if (has_equals_) {
+    auto starts = std::any_of(
+        equals_.begin(), equals_.end(), [&text](const std::string& value) {
+          return value.compare(0, text.size(), text) == 0;
+        });
+    if (!starts) {
+      return false;
+    }
+  }
+
+  for (const auto& like : likes_) {
+    if (!like.mayMatchPrefix(text)) {
+      return false;
+    }
+  }
+  return true;
+}
+
 void ConstraintList::serialize(JSON& doc, rapidjson::Value& obj) const {
   auto expressions = doc.getArray();
   for (const auto& constraint : constraints_) {
@@ -651,4 +1131,52 @@ void serializeQueryContextJSON(const QueryContext& context, JSON& json_helper) {
   }
 }
 
+void runTableRequests(size_t count,
+                      const std::function<void(size_t)>& request) {
+  runTableRequests(count, FLAGS_table_io_concurrency, request);
+}
+
+void runTableRequests(size_t count,
+                      size_t concurrency,
+                      const std::function<void(size_t)>& request) {
+  size_t workers = std::min(concurrency, count);
+  if (workers <= 1) {
+    for (size_t i = 0; i < count; ++i) {
+      request(i);
+    }
+    return;
+  }
+
+  std::atomic<size_t> next{0};
+  std::mutex error_mutex;
+  std::exception_ptr error;
+  auto work = [&]() {
+    for (auto i = next++; i < count; i = next++) {
+      try {
+        request(i);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (error == nullptr) {
+          error = std::current_exception();
+        }
+      }
+    }
+  };
+
+  // The calling thread is one of the workers.
+  std::vector<std::thread> threads;
+  threads.reserve(workers - 1);
+  for (size_t i = 1; i < workers; ++i) {
+    threads.emplace_back(work);
+  }
+  work();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  if (error != nullptr) {
+    std::rethrow_exception(error);
+  }
+}
+
 } // namespace osquery
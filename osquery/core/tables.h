@@ -10,7 +10,10 @@
 #pragma once
 
 #include <bitset>
+#include <functional>
+#include <limits>
 #include <map>
+#include <mutex>
 #include <set>
 #include <unordered_map>
 #include <unordered_set>
@@ -192,6 +195,12 @@ enum class TableAttributes {
 
   /// (Deprecated) This table's data requires an osquery kernel module.
   KERNEL_REQUIRED = 16,
+
+  /// Generating this table has side effects, results are never shared.
+  NO_SHARED_CACHE = 32,
+
+  /// The results do not change until the system reboots.
+  BOOT_CONSTANT = 64,
 };
 
 /// Treat table attributes as a set of flags.
@@ -242,6 +251,9 @@ struct ConstraintList : private boost::noncopyable {
    * If there are no predicate constraints in this list, all expression will
    * match. Constraints are limitations.
    *
+   * The EQUALS constraints are the values of an IN list, the expression
+   * matches if it is equal to any of them.
+   *
    * @param expr a SQL type expression of the column literal type to check.
    * @return If the expression matched all constraints.
    */
@@ -365,6 +377,104 @@ struct ConstraintList : private boost::noncopyable {
   FRIEND_TEST(TablesTests, test_constraint_list);
 };
 
+/**
+ * @brief A SQL LIKE pattern compiled to match many values.
+ *
+ * Values are matched as SQLite does by default, ignoring the case of ASCII
+ * letters, '%' matches any text and '_' one UTF-8 character.
+ */
+class LikePattern {
+ public:
+  explicit LikePattern(const std::string& pattern);
+
+  /// Check if a value matches the pattern.
+  bool matches(const std::string& value) const;
+
+  /// Check if a value starting with the text may match the pattern.
+  bool mayMatchPrefix(const std::string& text) const;
+
+  /// The literal text before the first wildcard, in lowercase.
+  const std::string& prefix() const {
+    return prefix_;
+  }
+
+ private:
+  /// The end of a segment matched at a position, npos if it does not match.
+  size_t matchSegment(const std::string& value,
+                      size_t position,
+                      const std::string& segment) const;
+
+ private:
+  /// The text before the first '%', the last one, and those in between.
+  std::string first_;
+  std::string last_;
+  std::vector<std::string> middle_;
+
+  /// The pattern has a '%', otherwise only the first segment is matched.
+  bool any_{false};
+
+  std::string prefix_;
+};
+
+/**
+ * @brief The constraints of a column, compiled to check many values.
+ *
+ * ConstraintList::matches parses every constraint expression for each value
+ * it checks, and matches any value if the list holds a LIKE. A matcher
+ * parses them once: integer comparisons become one range, EQUALS values a
+ * set and LIKE patterns are compiled. Constraints it cannot evaluate, such
+ * as GLOB or REGEXP, do not restrict the values.
+ *
+ * Tables use it to discard candidate rows, or whole subtrees of paths,
+ * before the work of generating them. Every value that SQLite would keep is
+ * matched.
+ */
+class ConstraintMatcher {
+ public:
+  /// A matcher without constraints, matching every value.
+  ConstraintMatcher() = default;
+
+  /// Compile a list, which must outlive the matcher for unsigned columns.
+  explicit ConstraintMatcher(const ConstraintList& list);
+
+  /// Check a value, an integer column parses it first.
+  bool matches(const std::string& value) const;
+
+  /// Check if a value starting with the text may match, for TEXT columns.
+  bool mayMatchPrefix(const std::string& text) const;
+
+  /// The compiled LIKE patterns.
+  const std::vector<LikePattern>& likes() const {
+    return likes_;
+  }
+
+ private:
+  bool matchesText(const std::string& value) const;
+
+ private:
+  ColumnType affinity_{TEXT_TYPE};
+
+  /// A constraint expression cannot be parsed as the column type.
+  bool never_{false};
+
+  /// Unsigned columns are checked by the list.
+  const ConstraintList* list_{nullptr};
+
+  /// The EQUALS values, a value matches one of them if there are any.
+  bool has_equals_{false};
+  std::set<std::string> equals_;
+
+  /// The inclusive bounds of an integer column.
+  long long min_{std::numeric_limits<long long>::min()};
+  long long max_{std::numeric_limits<long long>::max()};
+  std::set<long long> integer_equals_;
+
+  /// The comparisons of a TEXT column.
+  std::vector<std::pair<unsigned char, std::string>> comparisons_;
+
+  std::vector<LikePattern> likes_;
+};
+
 /// Pass a constraint map to the query request.
 using ConstraintMap = std::map<std::string, struct ConstraintList>;
 
@@ -421,6 +531,12 @@ struct VirtualTableContent {
   /// Transient set of virtual table used columns (as bitmasks)
   std::unordered_map<size_t, UsedColumnsBitset> colsUsedBitsets;
 
+  /// Transient set of constraints whose IN list values are filtered at once
+  std::unordered_map<size_t, std::set<size_t>> inLists;
+
+  /// Transient set of the rows read from a scan, see QueryContext::limit
+  std::unordered_map<size_t, uint64_t> limits;
+
   /*
    * @brief A table implementation specific query result cache.
    *
@@ -469,6 +585,7 @@ struct QueryContext {
   QueryContext(QueryContext&& other)
       : constraints(std::move(other.constraints)),
         colsUsed(std::move(other.colsUsed)),
+        limit(other.limit),
         enable_cache_(other.enable_cache_),
         use_cache_(other.use_cache_),
         table_(other.table_) {
@@ -480,6 +597,7 @@ struct QueryContext {
   QueryContext& operator=(QueryContext&& other) {
     std::swap(constraints, other.constraints);
     std::swap(colsUsed, other.colsUsed);
+    std::swap(limit, other.limit);
     std::swap(enable_cache_, other.enable_cache_);
     std::swap(use_cache_, other.use_cache_);
     std::swap(table_, other.table_);
@@ -638,6 +756,15 @@ struct QueryContext {
   boost::optional<UsedColumns> colsUsed;
   boost::optional<UsedColumnsBitset> colsUsedBitset;
 
+  /**
+   * @brief The most rows the query reads from the scan, if known.
+   *
+   * SQLite stops reading a scan once the LIMIT of the query is reached. The
+   * limit, including the OFFSET, is only set when nothing else constrains or
+   * orders the rows of the table, a table may then stop generating early.
+   */
+  boost::optional<uint64_t> limit;
+
  private:
   /// If false then the context is maintaining an ephemeral cache.
   bool enable_cache_{false};
@@ -817,28 +944,50 @@ class TablePlugin : public Plugin {
   bool isCached(uint64_t interval, const QueryContext& ctx) const;
 
   /**
-   * @brief Perform a database lookup of cached results and deserialize.
+   * @brief Copy the cached results of the table.
    *
    * If a query determined the table's cached results are fresh, it may ask the
-   * table to retrieve results from the database and deserialized them into
-   * table row data.
+   * table for a copy of the rows kept in memory. Results evicted from memory
+   * are read from the database when table_cache_persist is set.
    *
-   * @return The deserialized row data of cached results.
+   * @return The row data of cached results.
    */
   TableRows getCache() const;
 
   /**
    * @brief Similar to getCache, stores the results from generate.
    *
-   * Set will serialize and save the results as JSON to be retrieved later.
-   * It will inspect the query context, if any required/indexed/optimized or
-   * additional columns are used then the cache will not be saved.
+   * Set will keep a copy of the results in memory, within the
+   * table_cache_max_bytes budget shared by the tables, and save them in the
+   * binary row encoding if table_cache_persist is set. It will inspect the
+   * query context, if any required/indexed/optimized or additional columns
+   * are used then the cache will not be saved.
    */
   void setCache(uint64_t step,
                 uint64_t interval,
                 const QueryContext& ctx,
                 const TableRows& results);
 
+  /**
+   * @brief Retrieve the results a BOOT_CONSTANT table generated this boot.
+   *
+   * The results are kept in memory and in the database with the identifier
+   * of the boot, they are reused by later queries and osquery processes until
+   * the system reboots. They are not used if a constraint on the table may
+   * change the rows generated, as for isCached.
+   *
+   * Without results, the context is changed to generate every column and
+   * every row, such that the results of the generation can be saved.
+   *
+   * @param ctx The query context.
+   * @param results Set to a copy of the results, if found.
+   * @return True if the results generated this boot were found.
+   */
+  bool getBootCache(QueryContext& ctx, TableRows& results);
+
+  /// Similar to setCache, saves the results of a BOOT_CONSTANT table.
+  void setBootCache(const QueryContext& ctx, const TableRows& results);
+
  private:
   /// The last time in seconds the table data results were saved to cache.
   uint64_t last_cached_{0};
@@ -846,6 +995,15 @@ class TablePlugin : public Plugin {
   /// The last interval in seconds when the table data was cached.
   uint64_t last_interval_{0};
 
+  /// Protects the results of a BOOT_CONSTANT table.
+  std::mutex boot_cache_mutex_;
+
+  /// The results generated this boot, if generated or read.
+  boost::optional<TableRows> boot_cache_;
+
+  /// If the results of a previous process were read from the database.
+  bool boot_cache_read_{false};
+
  public:
   /**
    * @brief The scheduled interval for the executing query.
@@ -928,6 +1086,26 @@ inline const std::string& columnTypeName(ColumnType type) {
 /// Get the column type from the string representation.
 ColumnType columnTypeName(const std::string& type);
 
+/**
+ * @brief Run the independent requests of a table scan concurrently.
+ *
+ * Tables waiting on remote hosts for each value of a constraint, such as the
+ * urls of an IN list, would otherwise wait for one request after the other.
+ * The requests run on up to table_io_concurrency threads and are called with
+ * their index, each request must only write its own result. This returns
+ * once every request completed, keeping the table generator synchronous.
+ *
+ * @param count The number of requests.
+ * @param request Called once with each index in [0, count).
+ */
+void runTableRequests(size_t count,
+                      const std::function<void(size_t)>& request);
+
+/// Run the independent requests of a table scan on up to concurrency threads.
+void runTableRequests(size_t count,
+                      size_t concurrency,
+                      const std::function<void(size_t)>& request);
+
 Status deserializeQueryContextJSON(const JSON& json_helper,
                                    QueryContext& context);
 void serializeQueryContextJSON(const QueryContext& context, JSON& json_helper);
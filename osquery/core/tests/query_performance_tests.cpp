@@ -19,7 +19,7 @@ TEST_F(QueryPerformanceTests, test_query_performance) {
   QueryPerformance defaultStats;
   auto emptyStats = QueryPerformance("");
   ASSERT_EQ(defaultStats, emptyStats);
-  ASSERT_EQ("0,0,0,0,0,0,0,0,0,0,0,0", defaultStats.toCSV());
+  ASSERT_EQ("0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0", defaultStats.toCSV());
 
   // Normal case
   {
@@ -36,20 +36,32 @@ TEST_F(QueryPerformanceTests, test_query_performance) {
     expected.average_memory = 10;
     expected.last_memory = 11;
     expected.output_size = 12;
-    std::string csv = "1,2,3,4,5,6,7,8,9,10,11,12";
+    expected.rows = 13;
+    expected.last_rows = 14;
+    expected.average_result_bytes = 15;
+    expected.last_result_bytes = 16;
+    std::string csv = "1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16";
     auto filledStats = QueryPerformance(csv);
     ASSERT_EQ(expected, filledStats);
     ASSERT_EQ(csv, expected.toCSV());
     ASSERT_EQ(csv, filledStats.toCSV());
   }
 
+  // Statistics stored without the row and result counters
+  {
+    auto filledStats = QueryPerformance("1,2,3,4,5,6,7,8,9,10,11,12");
+    ASSERT_EQ(12U, filledStats.output_size);
+    ASSERT_EQ(0U, filledStats.rows);
+    ASSERT_EQ("1,2,3,4,5,6,7,8,9,10,11,12,0,0,0,0", filledStats.toCSV());
+  }
+
   // Invalid case
   {
-    std::string csv = "1,,bozo,4,5,6,7,8,9,10,11,12";
+    std::string csv = "1,,bozo,4,5,6,7,8,9,10,11,12,13,14,15,16";
     auto filledStats = QueryPerformance(csv);
     ASSERT_EQ(0, filledStats.last_executed);
     ASSERT_EQ(0, filledStats.wall_time);
-    ASSERT_EQ("1,0,0,4,5,6,7,8,9,10,11,12", filledStats.toCSV());
+    ASSERT_EQ("1,0,0,4,5,6,7,8,9,10,11,12,13,14,15,16", filledStats.toCSV());
   }
 }
 
@@ -16,6 +16,7 @@
 #include <gtest/gtest.h>
 
 #include <osquery/core/query.h>
+#include <osquery/core/sql/scan_slice.h>
 #include <osquery/core/sql/scheduled_query.h>
 #include <osquery/core/system.h>
 #include <osquery/sql/tests/sql_test_utils.h>
@@ -25,6 +26,7 @@ namespace osquery {
 
 DECLARE_bool(disable_database);
 DECLARE_bool(logger_numerics);
+DECLARE_bool(fingerprint_differential);
 
 class QueryTests : public testing::Test {
  public:
@@ -111,6 +113,44 @@ TEST_F(QueryTests, test_get_query_status) {
   EXPECT_TRUE(new_query_sql);
 }
 
+TEST_F(QueryTests, test_query_state) {
+  auto query = getOsqueryScheduledQuery();
+  auto cf = Query("query_state", query);
+  uint64_t counter = 128;
+  DiffResults dr;
+  auto status = cf.addNewResults(getTestDBExpectedResults(), 7, counter, dr);
+  ASSERT_TRUE(status.ok());
+  EXPECT_EQ(counter, 0U);
+
+  // The epoch, counter and query text are stored in one value.
+  std::string value;
+  ASSERT_TRUE(getDatabaseValue(kQueries, "query_statestate", value).ok());
+  QueryState state;
+  ASSERT_TRUE(QueryState::decode(value, state).ok());
+  EXPECT_EQ(state.epoch, 7U);
+  EXPECT_EQ(state.counter, 0U);
+  EXPECT_TRUE(state.has_counter);
+  EXPECT_EQ(state.query, query.query);
+  EXPECT_FALSE(getDatabaseValue(kQueries, "query_stateepoch", value).ok());
+  EXPECT_FALSE(getDatabaseValue(kQueries, "query_statecounter", value).ok());
+
+  // A query text containing commas is read back.
+  state.query = "SELECT a, b FROM t";
+  QueryState decoded;
+  ASSERT_TRUE(QueryState::decode(state.encode(), decoded).ok());
+  EXPECT_EQ(decoded.query, state.query);
+  EXPECT_FALSE(QueryState::decode("1,2", decoded).ok());
+
+  // The legacy values are read if no state is stored.
+  auto legacy = Query("query_legacy", query);
+  setDatabaseValue(kQueries, "query_legacyepoch", "5");
+  setDatabaseValue(kQueries, "query_legacycounter", "2");
+  setDatabaseValue(kQueries, "query.query_legacy", query.query);
+  EXPECT_EQ(legacy.getPreviousEpoch(), 5U);
+  EXPECT_EQ(legacy.getQueryCounter(false, false), 3U);
+  EXPECT_FALSE(legacy.isNewQuerySql());
+}
+
 TEST_F(QueryTests, test_add_and_get_current_results) {
   FLAGS_logger_numerics = true;
   // Test adding a "current" set of results to a scheduled query instance.
@@ -156,6 +196,151 @@ TEST_F(QueryTests, test_add_and_get_current_results) {
   }
 }
 
+TEST_F(QueryTests, test_fingerprint_differential) {
+  FLAGS_logger_numerics = true;
+  auto query = getOsqueryScheduledQuery();
+  auto cf = Query("fingerprints", query);
+  uint64_t counter = 0;
+  DiffResults dr;
+
+  // The first results are stored by the multiset differential.
+  auto status = cf.addNewResults(getTestDBExpectedResults(), 0, counter, dr);
+  ASSERT_TRUE(status.ok());
+
+  FLAGS_fingerprint_differential = true;
+  for (auto result : getTestDBResultStream()) {
+    // The differential must match the multiset differential.
+    QueryDataSet previous_qd;
+    status = cf.getPreviousQueryResults(previous_qd);
+    ASSERT_TRUE(status.ok());
+    auto current_qd = result.second;
+    DiffResults expected = diff(previous_qd, current_qd);
+
+    DiffResults dr;
+    status = cf.addNewResults(result.second, 0, counter, dr);
+    ASSERT_TRUE(status.ok());
+    EXPECT_EQ(dr.added, expected.added);
+    EXPECT_EQ(QueryDataSet(dr.removed.begin(), dr.removed.end()),
+              QueryDataSet(expected.removed.begin(), expected.removed.end()));
+
+    // The stored fingerprints match the current results.
+    RowFingerprints fingerprints;
+    status = cf.getPreviousFingerprints(fingerprints);
+    ASSERT_TRUE(status.ok());
+    EXPECT_EQ(fingerprints, fingerprintQueryData(result.second));
+  }
+  FLAGS_fingerprint_differential = false;
+}
+
+TEST_F(QueryTests, test_row_fingerprints) {
+  RowTyped r1 = {{"a", 1LL}, {"b", std::string("1")}};
+  RowTyped r2 = {{"a", std::string("1")}, {"b", std::string("1")}};
+  RowTyped r3 = {{"a", 1LL}, {"b", std::string("1")}};
+  EXPECT_NE(fingerprintRow(r1), fingerprintRow(r2));
+  EXPECT_EQ(fingerprintRow(r1), fingerprintRow(r3));
+
+  RowFingerprints fingerprints = {fingerprintRow(r1), fingerprintRow(r2), 0};
+  std::string encoded;
+  serializeRowFingerprints(fingerprints, encoded);
+  EXPECT_EQ(encoded.size(), 3 * sizeof(uint64_t));
+
+  RowFingerprints decoded;
+  ASSERT_TRUE(deserializeRowFingerprints(encoded, decoded).ok());
+  EXPECT_EQ(decoded, fingerprints);
+  EXPECT_FALSE(deserializeRowFingerprints("abc", decoded).ok());
+}
+
+TEST_F(QueryTests, test_keyed_differential) {
+  auto query = getOsqueryScheduledQuery();
+  query.keys = {"pid"};
+  auto cf = Query("keyed", query);
+  uint64_t counter = 0;
+
+  QueryDataTyped first = {
+      {{"pid", 1LL}, {"name", std::string("init")}, {"time", 10LL}},
+      {{"pid", 2LL}, {"name", std::string("sh")}, {"time", 20LL}},
+      {{"pid", 3LL}, {"name", std::string("ls")}, {"time", 30LL}}};
+  DiffResults dr;
+  ASSERT_TRUE(cf.addNewResults(first, 0, counter, dr).ok());
+  EXPECT_EQ(dr.added.size(), 3U);
+
+  // The pid identifies a row, only the changed columns are reported.
+  QueryDataTyped second = {
+      {{"pid", 1LL}, {"name", std::string("init")}, {"time", 11LL}},
+      {{"pid", 2LL}, {"name", std::string("sh")}, {"time", 20LL}},
+      {{"pid", 4LL}, {"name", std::string("cat")}, {"time", 40LL}}};
+  for (auto fingerprints : {false, true}) {
+    FLAGS_fingerprint_differential = fingerprints;
+    auto current = fingerprints ? first : second;
+    DiffResults keyed;
+    ASSERT_TRUE(cf.addNewResults(current, 0, counter, keyed).ok());
+
+    ASSERT_EQ(keyed.changed.size(), 1U);
+    EXPECT_EQ(keyed.changed[0].size(), 2U);
+    EXPECT_EQ(keyed.changed[0]["pid"], RowDataTyped(1LL));
+    EXPECT_EQ(keyed.changed[0]["time"],
+              RowDataTyped(fingerprints ? 10LL : 11LL));
+    ASSERT_EQ(keyed.added.size(), 1U);
+    EXPECT_EQ(keyed.added[0]["pid"], RowDataTyped(fingerprints ? 3LL : 4LL));
+    ASSERT_EQ(keyed.removed.size(), 1U);
+    EXPECT_EQ(keyed.removed[0]["pid"],
+              RowDataTyped(fingerprints ? 4LL : 3LL));
+  }
+  FLAGS_fingerprint_differential = false;
+
+  // Rows sharing a key are reported as removed and added rows.
+  DiffResults shared;
+  shared.removed = {{{"pid", 5LL}, {"time", 1LL}},
+                    {{"pid", 5LL}, {"time", 2LL}}};
+  shared.added = {{{"pid", 5LL}, {"time", 3LL}}};
+  diffChangedRows({"pid"}, shared);
+  EXPECT_TRUE(shared.changed.empty());
+  EXPECT_EQ(shared.removed.size(), 2U);
+
+  std::string json;
+  DiffResults changed;
+  changed.changed = {{{"pid", 1LL}, {"time", 11LL}}};
+  ASSERT_TRUE(serializeDiffResultsJSON(changed, json, true).ok());
+  EXPECT_EQ(json,
+            "{\"removed\":[],\"added\":[],\"changed\":"
+            "[{\"pid\":1,\"time\":11}]}");
+}
+
+TEST_F(QueryTests, test_dedup_snapshot) {
+  auto query = getOsqueryScheduledQuery();
+  auto cf = Query("dedup_snapshot", query);
+  auto results = getTestDBExpectedResults();
+  std::string digest;
+  uint64_t since = 0;
+
+  // The first snapshot is logged in full.
+  ASSERT_TRUE(cf.dedupSnapshot(results, 100, 1000, digest, since).ok());
+  EXPECT_EQ(digest.size(), 16U);
+  EXPECT_EQ(since, 0U);
+
+  // The same rows, in any order, are unchanged since the first snapshot.
+  std::reverse(results.begin(), results.end());
+  std::string reversed_digest;
+  ASSERT_TRUE(
+      cf.dedupSnapshot(results, 200, 1000, reversed_digest, since).ok());
+  EXPECT_EQ(reversed_digest, digest);
+  EXPECT_EQ(since, 100U);
+
+  // A full snapshot is forced after the interval, it is still unchanged.
+  ASSERT_TRUE(cf.dedupSnapshot(results, 1100, 1000, digest, since).ok());
+  EXPECT_EQ(since, 0U);
+  ASSERT_TRUE(cf.dedupSnapshot(results, 1200, 1000, digest, since).ok());
+  EXPECT_EQ(since, 100U);
+
+  // Changed results are logged in full.
+  results.pop_back();
+  std::string changed_digest;
+  ASSERT_TRUE(
+      cf.dedupSnapshot(results, 1300, 1000, changed_digest, since).ok());
+  EXPECT_NE(changed_digest, digest);
+  EXPECT_EQ(since, 0U);
+}
+
 TEST_F(QueryTests, test_get_query_results) {
   // Grab an expected set of query data and add it as the previous result.
   auto encoded_qd = getSerializedQueryDataJSON();
@@ -262,4 +447,98 @@ TEST_F(QueryTests, test_report_removed_rows) {
   sq.options["removed"] = false;
   EXPECT_FALSE(sq.reportRemovedRows());
 }
+
+TEST_F(QueryTests, test_get_stored_results) {
+  auto query = getOsqueryScheduledQuery();
+  auto cf = Query("stored_results", query);
+
+  QueryDataTyped results;
+  QueryState state;
+  EXPECT_FALSE(cf.getStoredResults(results, state).ok());
+
+  // The differential stores the latest results and their state.
+  uint64_t counter = 0;
+  DiffResults dr;
+  auto rows = getTestDBExpectedResults();
+  ASSERT_TRUE(cf.addNewResults(rows, 2, counter, dr).ok());
+  ASSERT_TRUE(cf.getStoredResults(results, state).ok());
+  EXPECT_EQ(results.size(), rows.size());
+  EXPECT_EQ(state.epoch, 2U);
+  EXPECT_EQ(state.counter, counter);
+
+  // Results of a previous SQL are not the results of the query.
+  query.query += " limit 1";
+  auto updated = Query("stored_results", query);
+  EXPECT_FALSE(updated.getStoredResults(results, state).ok());
+}
+
+TEST_F(QueryTests, test_scan_progress) {
+  auto query = getOsqueryScheduledQuery();
+  auto cf = Query("scan_progress", query);
+
+  ScanProgress progress;
+  ASSERT_TRUE(cf.getScanProgress(progress).ok());
+  EXPECT_EQ(progress.slice, 0U);
+
+  // Cursors are paths, and may include the separator.
+  progress.slice = 2;
+  progress.time = 1000;
+  progress.cursor = "C:\\Windows\\a:b";
+  ASSERT_TRUE(cf.setScanProgress(progress).ok());
+
+  ScanProgress stored;
+  ASSERT_TRUE(cf.getScanProgress(stored).ok());
+  EXPECT_EQ(stored.slice, 2U);
+  EXPECT_EQ(stored.time, 1000U);
+  EXPECT_EQ(stored.cursor, progress.cursor);
+
+  // A complete scan removes the progress.
+  ASSERT_TRUE(cf.setScanProgress(ScanProgress()).ok());
+  ASSERT_TRUE(cf.getScanProgress(stored).ok());
+  EXPECT_EQ(stored.slice, 0U);
+  EXPECT_TRUE(stored.cursor.empty());
+}
+
+TEST_F(QueryTests, test_scan_slice) {
+  auto path = [](const std::string& p) -> const auto& { return p; };
+
+  // Without a slice the targets are not changed.
+  std::vector<std::string> targets = {"/c", "/a", "/b"};
+  ScanSlice::select(targets, path);
+  EXPECT_EQ(targets, std::vector<std::string>({"/c", "/a", "/b"}));
+
+  std::string cursor;
+  {
+    ScanSlice slice(2, "");
+    ScanSlice::select(targets, path);
+    EXPECT_EQ(targets, std::vector<std::string>({"/a", "/b"}));
+    EXPECT_FALSE(slice.complete());
+    cursor = slice.cursor();
+  }
+  EXPECT_EQ(cursor, "/b");
+  EXPECT_EQ(ScanSlice::current(), nullptr);
+
+  // The next slice resumes after the cursor, and completes the scan.
+  targets = {"/c", "/a", "/b", "/d"};
+  {
+    ScanSlice slice(2, cursor);
+    ScanSlice::select(targets, path);
+    EXPECT_EQ(targets, std::vector<std::string>({"/c", "/d"}));
+    EXPECT_TRUE(slice.complete());
+    EXPECT_EQ(slice.cursor(), "/d");
+  }
+
+  // Several scans of a query share the paths of the slice.
+  {
+    ScanSlice slice(3, "");
+    std::vector<std::string> first = {"/a", "/b"};
+    std::vector<std::string> second = {"/c", "/d"};
+    ScanSlice::select(first, path);
+    ScanSlice::select(second, path);
+    EXPECT_EQ(first.size(), 2U);
+    EXPECT_EQ(second, std::vector<std::string>({"/c"}));
+    EXPECT_FALSE(slice.complete());
+    EXPECT_EQ(slice.cursor(), "/c");
+  }
+}
 }
@@ -7,6 +7,9 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <atomic>
+#include <stdexcept>
+
 #include <gtest/gtest.h>
 #include <gflags/gflags.h>
 
@@ -14,9 +17,13 @@
 #include <osquery/core/tables.h>
 #include <osquery/database/database.h>
 #include <osquery/registry/registry.h>
+#include <osquery/sql/dynamic_table_row.h>
 
 namespace osquery {
 
+DECLARE_uint64(table_cache_max_bytes);
+DECLARE_uint32(table_io_concurrency);
+
 class TablesTests : public testing::Test {
 protected:
  void SetUp() {
@@ -116,6 +123,79 @@ TEST_F(TablesTests, test_constraint_matching) {
   EXPECT_TRUE(cl3.matches(1));
 }
 
+TEST_F(TablesTests, test_like_pattern) {
+  LikePattern pattern("/ETC/%.conf");
+  EXPECT_EQ(pattern.prefix(), "/etc/");
+  EXPECT_TRUE(pattern.matches("/etc/a.conf"));
+  EXPECT_TRUE(pattern.matches("/etc/ssh/b.CONF"));
+  EXPECT_FALSE(pattern.matches("/etc/a.confs"));
+  EXPECT_FALSE(pattern.matches("/tmp/a.conf"));
+
+  // A prefix may match if it is a prefix of the pattern's literal text.
+  EXPECT_TRUE(pattern.mayMatchPrefix("/et"));
+  EXPECT_TRUE(pattern.mayMatchPrefix("/etc/ssh/"));
+  EXPECT_FALSE(pattern.mayMatchPrefix("/tmp/"));
+
+  // '_' matches one character, even when it is not a single byte.
+  LikePattern single("a_c%d");
+  EXPECT_TRUE(single.matches("abcd"));
+  EXPECT_TRUE(single.matches("a\xc3\xa9"
+                             "cxxd"));
+  EXPECT_FALSE(single.matches("acd"));
+  EXPECT_FALSE(single.matches("abbcd"));
+
+  LikePattern literal("exact");
+  EXPECT_TRUE(literal.matches("EXACT"));
+  EXPECT_FALSE(literal.matches("exactly"));
+}
+
+TEST_F(TablesTests, test_constraint_matcher) {
+  // A default matcher matches every value.
+  ConstraintMatcher any;
+  EXPECT_TRUE(any.matches("anything"));
+  EXPECT_TRUE(any.mayMatchPrefix("/"));
+
+  struct ConstraintList paths;
+  paths.add(Constraint(EQUALS, "/etc/hosts"));
+  paths.add(Constraint(EQUALS, "/tmp/hosts"));
+  paths.add(Constraint(LIKE, "/etc/%"));
+  ConstraintMatcher path_matcher(paths);
+  EXPECT_TRUE(path_matcher.matches("/etc/hosts"));
+  EXPECT_FALSE(path_matcher.matches("/tmp/hosts"));
+  EXPECT_FALSE(path_matcher.matches("/etc/passwd"));
+  EXPECT_TRUE(path_matcher.mayMatchPrefix("/etc/"));
+  EXPECT_FALSE(path_matcher.mayMatchPrefix("/tmp/"));
+
+  // Comparisons of TEXT columns are not case-insensitive.
+  struct ConstraintList names;
+  names.add(Constraint(GREATER_THAN_OR_EQUALS, "b"));
+  names.add(Constraint(LESS_THAN, "d"));
+  ConstraintMatcher name_matcher(names);
+  EXPECT_TRUE(name_matcher.matches("b"));
+  EXPECT_TRUE(name_matcher.matches("cat"));
+  EXPECT_FALSE(name_matcher.matches("d"));
+  EXPECT_FALSE(name_matcher.matches("B"));
+
+  struct ConstraintList numbers;
+  numbers.affinity = INTEGER_TYPE;
+  numbers.add(Constraint(GREATER_THAN, "1"));
+  numbers.add(Constraint(LESS_THAN_OR_EQUALS, "10"));
+  ConstraintMatcher number_matcher(numbers);
+  EXPECT_FALSE(number_matcher.matches("1"));
+  EXPECT_TRUE(number_matcher.matches("2"));
+  EXPECT_TRUE(number_matcher.matches("10"));
+  EXPECT_FALSE(number_matcher.matches("11"));
+
+  // An expression that is not an integer matches no value.
+  numbers.add(Constraint(EQUALS, "ten"));
+  EXPECT_FALSE(ConstraintMatcher(numbers).matches("5"));
+
+  // Constraints without a compiled form do not restrict the values.
+  struct ConstraintList globs;
+  globs.add(Constraint(GLOB, "*.so"));
+  EXPECT_TRUE(ConstraintMatcher(globs).matches("library.dll"));
+}
+
 TEST_F(TablesTests, test_constraint_map) {
   ConstraintMap cm;
 
@@ -137,6 +217,12 @@ TEST_F(TablesTests, test_constraint_map) {
   EXPECT_FALSE(cm["path"].notExistsOrMatches("not_some"));
   EXPECT_TRUE(cm["path"].exists());
   EXPECT_TRUE(cm["path"].existsAndMatches("some"));
+
+  // Several equality constraints are the values of an IN list.
+  cm["path"].add(Constraint(EQUALS, "other"));
+  EXPECT_TRUE(cm["path"].matches("some"));
+  EXPECT_TRUE(cm["path"].matches("other"));
+  EXPECT_FALSE(cm["path"].matches("not_some"));
 }
 
 TEST_F(TablesTests, test_constraint_map_cast) {
@@ -157,6 +243,18 @@ class TestTablePlugin : public TablePlugin {
     setCache(step, interval, ctx, r);
   }
 
+  void testSetCache(uint64_t step, uint64_t interval, const Row& row) {
+    TableRows r;
+    r.push_back(TableRowHolder(new DynamicTableRow(Row(row))));
+    QueryContext ctx;
+    ctx.useCache(true);
+    setCache(step, interval, ctx, r);
+  }
+
+  TableRows testGetCache() const {
+    return getCache();
+  }
+
   bool testIsCached(size_t interval) {
     QueryContext ctx;
     ctx.useCache(true);
@@ -189,4 +287,61 @@ TEST_F(TablesTests, test_caching) {
   EXPECT_TRUE(test.testIsCached(6));
   EXPECT_FALSE(test.testIsCached(7));
 }
+
+TEST_F(TablesTests, test_caching_budget) {
+  auto budget = FLAGS_table_cache_max_bytes;
+  TablePlugin::kCacheInterval = 5;
+  TablePlugin::kCacheStep = 1;
+
+  // The budget holds the results of one of the tables.
+  FLAGS_table_cache_max_bytes = 200;
+  TestTablePlugin first;
+  first.setName("cache_budget_first");
+  first.testSetCache(1, 5, {{"value", std::string(50, 'a')}});
+  EXPECT_TRUE(first.testIsCached(5));
+
+  auto rows = first.testGetCache();
+  ASSERT_EQ(rows.size(), 1U);
+  EXPECT_EQ(static_cast<Row>(*rows[0]).at("value"), std::string(50, 'a'));
+
+  // Caching the second table evicts the results used least recently.
+  TestTablePlugin second;
+  second.setName("cache_budget_second");
+  second.testSetCache(1, 5, {{"value", std::string(50, 'b')}});
+  EXPECT_TRUE(second.testIsCached(5));
+  EXPECT_FALSE(first.testIsCached(5));
+  EXPECT_TRUE(first.testGetCache().empty());
+
+  FLAGS_table_cache_max_bytes = budget;
+}
+
+TEST_F(TablesTests, test_run_table_requests) {
+  auto concurrency = FLAGS_table_io_concurrency;
+
+  for (uint32_t workers : {1U, 4U, 64U}) {
+    FLAGS_table_io_concurrency = workers;
+    std::vector<size_t> results(20, 0);
+    runTableRequests(results.size(), [&results](size_t i) {
+      results[i] = i * 2;
+    });
+    for (size_t i = 0; i < results.size(); ++i) {
+      EXPECT_EQ(results[i], i * 2);
+    }
+  }
+
+  // An exception of a request is rethrown once every request completed.
+  FLAGS_table_io_concurrency = 4;
+  std::atomic<size_t> completed{0};
+  EXPECT_THROW(runTableRequests(8,
+                                [&completed](size_t i) {
+                                  ++completed;
+                                  if (i == 3) {
+                                    throw std::runtime_error("request");
+                                  }
+                                }),
+               std::runtime_error);
+  EXPECT_EQ(completed, 8U);
+
+  FLAGS_table_io_concurrency = concurrency;
+}
 }
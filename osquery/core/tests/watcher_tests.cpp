@@ -21,6 +21,12 @@
 #include "osquery/core/watcher.h"
 #include "osquery/tests/test_util.h"
 
+#ifdef __linux__
+#include <unistd.h>
+
+#include "osquery/core/linux/process_sampler.h"
+#endif
+
 using namespace testing;
 
 namespace osquery {
@@ -428,4 +434,25 @@ TEST_F(WatcherTests, test_watcherrunner_unhealthy) {
 
   FLAGS_watchdog_delay = org_delay;
 }
+
+#ifdef __linux__
+TEST_F(WatcherTests, test_process_sampler) {
+  ProcessSampler sampler;
+
+  ProcessSample sample;
+  ASSERT_TRUE(sampler.sample(getpid(), sample).ok());
+  EXPECT_EQ(getppid(), sample.parent);
+  EXPECT_GT(sample.resident_size, 0U);
+  EXPECT_GE(sample.total_size, sample.resident_size);
+
+  // The second sample reads the descriptors held since the first.
+  ProcessSample next;
+  ASSERT_TRUE(sampler.sample(getpid(), next).ok());
+  EXPECT_GE(next.user_time + next.system_time,
+            sample.user_time + sample.system_time);
+
+  // A process that does not exist cannot be sampled.
+  EXPECT_FALSE(sampler.sample(-1, sample).ok());
+}
+#endif
 } // namespace osquery
@@ -20,6 +20,10 @@
 
 #include <boost/filesystem.hpp>
 
+#ifdef __linux__
+#include "osquery/core/linux/process_sampler.h"
+#endif
+
 #include <osquery/config/config.h>
 #include <osquery/core/shutdown.h>
 #include <osquery/core/sql/query_data.h>
@@ -52,8 +56,8 @@ struct PerformanceChange {
   size_t sustained_latency{0};
   /// Memory footprint.
   uint64_t footprint{0};
-  /// Watcher check interval in seconds.
-  uint64_t check_interval{0};
+  /// Watcher check interval in milliseconds.
+  uint64_t check_interval_ms{0};
   /// Process ID of the parent process.
   pid_t parent{0};
 
@@ -138,6 +142,12 @@ CLI_FLAG(uint64,
 
 CLI_FLAG(bool, disable_watchdog, false, "Disable userland watchdog process");
 
+CLI_FLAG(uint64,
+         watchdog_interval_ms,
+         0,
+         "Milliseconds between watchdog checks (default 0 uses the watchdog "
+         "level's interval)");
+
 CLI_FLAG(bool,
          enable_watchdog_debug,
          false,
@@ -145,14 +155,26 @@ CLI_FLAG(bool,
 
 DECLARE_uint64(alarm_timeout);
 
+namespace {
+
+/// Checks more frequent than this would cost more than they save.
+const uint64_t kMinCheckIntervalMs = 100;
+
+/// The time between two checks of the watched processes.
+uint64_t getCheckIntervalMs() {
+  if (FLAGS_watchdog_interval_ms > 0) {
+    return std::max(FLAGS_watchdog_interval_ms, kMinCheckIntervalMs);
+  }
+  return std::max(getWorkerLimit(WatchdogLimitType::INTERVAL), 1_sz) * 1000;
+}
+} // namespace
+
 UNSIGNED_BIGINT_LITERAL PerformanceChange::cpuUtilizationTimeLimit() {
   auto percent_ul = getWorkerLimit(WatchdogLimitType::UTILIZATION_LIMIT);
   percent_ul = (percent_ul > 100) ? 100 : percent_ul;
 
-  const UNSIGNED_BIGINT_LITERAL check_interval_milliseconds =
-      check_interval * 1000;
   const UNSIGNED_BIGINT_LITERAL cpu_ul =
-      (percent_ul * check_interval_milliseconds * kNumOfCPUs) / 100;
+      (percent_ul * check_interval_ms * kNumOfCPUs) / 100;
 
   return cpu_ul;
 }
@@ -320,7 +342,7 @@ void WatcherRunner::start() {
       // A test harness can end the thread immediately.
       break;
     }
-    pause(std::chrono::seconds(getWorkerLimit(WatchdogLimitType::INTERVAL)));
+    pause(std::chrono::milliseconds(getCheckIntervalMs()));
   } while (!interrupted() && ok());
 }
 
@@ -483,8 +505,7 @@ PerformanceChange getChange(const int pid,
                             PerformanceState& state) {
   PerformanceChange change;
 
-  change.check_interval =
-      std::max(getWorkerLimit(WatchdogLimitType::INTERVAL), 1_sz);
+  change.check_interval_ms = getCheckIntervalMs();
   long long user_time = 0, system_time = 0;
   try {
     change.parent =
@@ -558,8 +579,9 @@ static bool exceededCyclesLimit(const PerformanceChange& change) {
     return false;
   }
 
-  auto latency = change.sustained_latency * change.check_interval;
-  return (latency >= getWorkerLimit(WatchdogLimitType::LATENCY_LIMIT));
+  auto latency_ms = change.sustained_latency * change.check_interval_ms;
+  return (latency_ms >=
+          getWorkerLimit(WatchdogLimitType::LATENCY_LIMIT) * 1000);
 }
 
 Status WatcherRunner::isWatcherHealthy(const PlatformProcess& watcher,
@@ -585,6 +607,22 @@ Status WatcherRunner::isWatcherHealthy(const PlatformProcess& watcher,
 }
 
 QueryData WatcherRunner::getProcessRow(pid_t pid) const {
+#ifdef __linux__
+  // The processes are sampled every interval, avoid the SQL and table stack.
+  static ProcessSampler sampler;
+  ProcessSample sample;
+  if (!sampler.sample(pid, sample).ok()) {
+    return {};
+  }
+
+  Row r;
+  r["parent"] = BIGINT(sample.parent);
+  r["user_time"] = BIGINT(sample.user_time);
+  r["system_time"] = BIGINT(sample.system_time);
+  r["resident_size"] = BIGINT(sample.resident_size);
+  r["total_size"] = BIGINT(sample.total_size);
+  return {r};
+#else
   // On Windows, pid_t = DWORD, which is unsigned. However invalidity
   // of processes is denoted by a pid_t of -1. We check for this
   // by comparing the max value of DWORD, or ULONG_MAX, and then casting
@@ -600,6 +638,7 @@ QueryData WatcherRunner::getProcessRow(pid_t pid) const {
       "pid",
       EQUALS,
       INTEGER(p));
+#endif
 }
 
 Status WatcherRunner::isChildSane(const PlatformProcess& child) const {
@@ -630,7 +669,8 @@ Status WatcherRunner::isChildSane(const PlatformProcess& child) const {
         "Maximum sustainable CPU utilization limit " +
             std::to_string(change.cpuUtilizationTimeLimit()) +
             "ms exceeded for " +
-            std::to_string(change.sustained_latency * change.check_interval) +
+            std::to_string(change.sustained_latency *
+                           change.check_interval_ms / 1000) +
             " seconds");
   }
 
@@ -773,18 +813,16 @@ void WatcherRunner::createExtension(const std::string& extension) {
           << "): " << extension;
 }
 
-void WatcherWatcherRunner::start() {
-  while (!interrupted()) {
-    if (isLauncherProcessDead(*watcher_)) {
-      // Watcher died, the worker must follow.
-      VLOG(1) << "osqueryd worker (" << PlatformProcess::getCurrentPid()
-              << ") detected killed watcher (" << watcher_->pid() << ")";
-      // The watcher watcher is a thread. Do not join services after removing.
-      requestShutdown();
-      break;
-    }
-    pause(std::chrono::seconds(getWorkerLimit(WatchdogLimitType::INTERVAL)));
+std::chrono::milliseconds WatcherWatcherRunner::tick() {
+  if (isLauncherProcessDead(*watcher_)) {
+    // Watcher died, the worker must follow.
+    VLOG(1) << "osqueryd worker (" << PlatformProcess::getCurrentPid()
+            << ") detected killed watcher (" << watcher_->pid() << ")";
+    // The watcher watcher is a service. Do not join services after removing.
+    requestShutdown();
+    interrupt();
   }
+  return std::chrono::seconds(getWorkerLimit(WatchdogLimitType::INTERVAL));
 }
 
 uint64_t getWorkerLimit(WatchdogLimitType name) {
@@ -330,13 +330,14 @@ class WatcherRunner : public InternalRunnable {
 };
 
 /// The WatcherWatcher is spawned within the worker and watches the watcher.
-class WatcherWatcherRunner : public InternalRunnable {
+class WatcherWatcherRunner : public PeriodicRunnable {
  public:
   explicit WatcherWatcherRunner(const std::shared_ptr<PlatformProcess>& watcher)
-      : InternalRunnable("WatcherWatcherRunner"), watcher_(watcher) {}
+      : PeriodicRunnable("WatcherWatcherRunner"), watcher_(watcher) {}
 
-  /// Runnable thread's entry point.
-  void start() override;
+ protected:
+  /// Check the watcher, returns the watchdog interval.
+  std::chrono::milliseconds tick() override;
 
  private:
   /// Parent, or watchdog, process ID.
@@ -8,7 +8,9 @@
  */
 
 #include <locale>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 
 #include <osquery/core/windows/wmi.h>
 #include <osquery/logger/logger.h>
@@ -360,47 +362,44 @@ Status WmiResultItem::GetVectorOfLongs(const std::string& name,
   return Status::success();
 }
 
-Expected<WmiRequest, WmiError> WmiRequest::CreateWmiRequest(
-    const std::string& query, std::wstring nspace) {
-  std::wstring wql = stringToWstring(query);
-
-  HRESULT hr = E_FAIL;
+namespace {
 
-  IWbemLocator* locator = nullptr;
+/// Number of objects fetched from an enumerator per call.
+const ULONG kWmiEnumBatchSize = 64;
 
-  hr = ::CoCreateInstance(CLSID_WbemLocator,
-                          0,
-                          CLSCTX_INPROC_SERVER,
-                          IID_IWbemLocator,
-                          (LPVOID*)&locator);
-  if (hr != S_OK) {
-    return createError(WmiError::ConstructionError)
-           << "WmiRequest creation failed after CoCreateInstance";
-  }
-  WmiRequest wmi_request;
-  wmi_request.locator_.reset(locator);
+/// The errors of a namespace connection that is no longer usable.
+bool isDisconnected(HRESULT hr) {
+  return hr == RPC_E_DISCONNECTED || hr == RPC_E_SERVER_DIED ||
+         hr == RPC_E_SERVER_DIED_DNE || hr == WBEM_E_TRANSPORT_FAILURE ||
+         hr == HRESULT_FROM_WIN32(RPC_S_SERVER_UNAVAILABLE) ||
+         hr == HRESULT_FROM_WIN32(RPC_S_CALL_FAILED);
+}
 
+Status connectNamespace(IWbemLocator* locator,
+                        const std::wstring& nspace,
+                        std::shared_ptr<IWbemServices>& connection) {
   IWbemServices* services = nullptr;
   BSTR nspace_str = SysAllocString(nspace.c_str());
   if (nullptr == nspace_str) {
-    return createError(WmiError::ConstructionError)
-           << "WmiRequest creation failed in nspace_str allocation";
-  }
-
-  hr = wmi_request.locator_->ConnectServer(nspace_str,
-                                           nullptr,
-                                           nullptr,
-                                           nullptr,
-                                           WBEM_FLAG_CONNECT_USE_MAX_WAIT,
-                                           nullptr,
-                                           nullptr,
-                                           &services);
+    return Status::failure(
+        "WmiRequest creation failed in nspace_str allocation");
+  }
+
+  HRESULT hr = locator->ConnectServer(nspace_str,
+                                      nullptr,
+                                      nullptr,
+                                      nullptr,
+                                      WBEM_FLAG_CONNECT_USE_MAX_WAIT,
+                                      nullptr,
+                                      nullptr,
+                                      &services);
   SysFreeString(nspace_str);
 
   if (hr != S_OK) {
-    return createError(WmiError::ConstructionError)
-           << "WmiRequest creation failed to connect to server";
+    return Status::failure("WmiRequest creation failed to connect to server");
   }
+  std::shared_ptr<IWbemServices> services_ptr(services,
+                                              impl::WmiObjectDeleter());
 
   // We need to set specific authentication information on the IWbemServices
   // interface proxy prior making a call on one of this interface. This can
@@ -409,8 +408,8 @@ Expected<WmiRequest, WmiError> WmiRequest::CreateWmiRequest(
   IClientSecurity* pSecurity = NULL;
   hr = services->QueryInterface(IID_IClientSecurity, (LPVOID*)&pSecurity);
   if (FAILED(hr) || !pSecurity) {
-    return createError(WmiError::ConstructionError)
-           << "WmiRequest creation failed in IClientSecurity interface query";
+    return Status::failure(
+        "WmiRequest creation failed in IClientSecurity interface query");
   }
 
   // Querying the current authentication information
@@ -434,8 +433,7 @@ Expected<WmiRequest, WmiError> WmiRequest::CreateWmiRequest(
     CoTaskMemFree(serverPrincName);
     pSecurity->Release();
 
-    return createError(WmiError::ConstructionError)
-           << "WmiRequest creation failed in QueryBlanket call";
+    return Status::failure("WmiRequest creation failed in QueryBlanket call");
   }
 
   // Setting authentication information on proxy interface
@@ -451,13 +449,103 @@ Expected<WmiRequest, WmiError> WmiRequest::CreateWmiRequest(
   pSecurity->Release();
 
   if (FAILED(hr)) {
-    return createError(WmiError::ConstructionError)
-           << "WmiRequest creation failed in SetBlanket call";
+    return Status::failure("WmiRequest creation failed in SetBlanket call");
   }
 
-  wmi_request.services_.reset(services);
+  connection = std::move(services_ptr);
+  return Status::success();
+}
 
-  IEnumWbemClassObject* wbem_enum = nullptr;
+/**
+ * @brief The namespace connections shared by the WMI requests.
+ *
+ * The process joins the multithreaded apartment at startup, so the locator
+ * and the configured IWbemServices proxies can be used from any thread. A
+ * connection is made once per namespace and dropped when a call reports
+ * that the server went away.
+ */
+class WmiConnectionCache final {
+ public:
+  static WmiConnectionCache& instance() {
+    // Never destroyed: the proxies cannot be released after COM shutdown.
+    static auto* cache = new WmiConnectionCache();
+    return *cache;
+  }
+
+  Status get(const std::wstring& nspace,
+             std::shared_ptr<IWbemLocator>& locator,
+             std::shared_ptr<IWbemServices>& services) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto status = createLocator();
+      if (!status.ok()) {
+        return status;
+      }
+      locator = locator_;
+
+      auto it = connections_.find(nspace);
+      if (it != connections_.end()) {
+        services = it->second;
+        return Status::success();
+      }
+    }
+
+    // Connect without the lock, the other namespaces stay available.
+    std::shared_ptr<IWbemServices> connection;
+    auto status = connectNamespace(locator.get(), nspace, connection);
+    if (!status.ok()) {
+      return status;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    services = connections_.emplace(nspace, connection).first->second;
+    return Status::success();
+  }
+
+  /// Drop the connection, unless it was already replaced.
+  void invalidate(const std::wstring& nspace,
+                  const std::shared_ptr<IWbemServices>& services) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = connections_.find(nspace);
+    if (it != connections_.end() && it->second == services) {
+      connections_.erase(it);
+    }
+  }
+
+ private:
+  WmiConnectionCache() = default;
+
+  Status createLocator() {
+    if (locator_ != nullptr) {
+      return Status::success();
+    }
+
+    IWbemLocator* locator = nullptr;
+    HRESULT hr = ::CoCreateInstance(CLSID_WbemLocator,
+                                    0,
+                                    CLSCTX_INPROC_SERVER,
+                                    IID_IWbemLocator,
+                                    (LPVOID*)&locator);
+    if (hr != S_OK) {
+      return Status::failure(
+          "WmiRequest creation failed after CoCreateInstance");
+    }
+
+    locator_.reset(locator, impl::WmiObjectDeleter());
+    return Status::success();
+  }
+
+  std::mutex mutex_;
+  std::shared_ptr<IWbemLocator> locator_;
+  std::unordered_map<std::wstring, std::shared_ptr<IWbemServices>>
+      connections_;
+};
+
+} // namespace
+
+Expected<WmiRequest, WmiError> WmiRequest::CreateWmiRequest(
+    const std::string& query, std::wstring nspace) {
+  std::wstring wql = stringToWstring(query);
 
   BSTR language_str = SysAllocString(L"WQL");
   if (nullptr == language_str) {
@@ -472,8 +560,35 @@ Expected<WmiRequest, WmiError> WmiRequest::CreateWmiRequest(
            << "WmiRequest creation failed in wql_str allocation";
   }
 
-  hr = wmi_request.services_->ExecQuery(
-      language_str, wql_str, WBEM_FLAG_FORWARD_ONLY, nullptr, &wbem_enum);
+  auto& connections = WmiConnectionCache::instance();
+  WmiRequest wmi_request;
+  IEnumWbemClassObject* wbem_enum = nullptr;
+  HRESULT hr = E_FAIL;
+
+  // A cached connection may be stale, it is replaced once.
+  for (int attempt = 0; attempt < 2; ++attempt) {
+    auto status = connections.get(
+        nspace, wmi_request.locator_, wmi_request.services_);
+    if (!status.ok()) {
+      SysFreeString(wql_str);
+      SysFreeString(language_str);
+      return createError(WmiError::ConstructionError) << status.getMessage();
+    }
+
+    // Semisynchronous: the call returns at once and the objects are
+    // fetched in batches, instead of waiting for the whole result set.
+    hr = wmi_request.services_->ExecQuery(
+        language_str,
+        wql_str,
+        WBEM_FLAG_FORWARD_ONLY | WBEM_FLAG_RETURN_IMMEDIATELY,
+        nullptr,
+        &wbem_enum);
+    if (!isDisconnected(hr)) {
+      break;
+    }
+
+    connections.invalidate(nspace, wmi_request.services_);
+  }
 
   SysFreeString(wql_str);
   SysFreeString(language_str);
@@ -484,15 +599,25 @@ Expected<WmiRequest, WmiError> WmiRequest::CreateWmiRequest(
 
   wmi_request.enum_.reset(wbem_enum);
 
+  std::vector<IWbemClassObject*> batch(kWmiEnumBatchSize, nullptr);
   hr = WBEM_S_NO_ERROR;
   while (hr == WBEM_S_NO_ERROR) {
-    IWbemClassObject* result = nullptr;
     ULONG result_count = 0;
 
-    hr = wmi_request.enum_->Next(WBEM_INFINITE, 1, &result, &result_count);
-    if (SUCCEEDED(hr) && result_count > 0) {
-      wmi_request.results_.emplace_back(result);
+    // WBEM_S_FALSE is returned with the last, partial, batch.
+    hr = wmi_request.enum_->Next(
+        WBEM_INFINITE, kWmiEnumBatchSize, batch.data(), &result_count);
+    if (!SUCCEEDED(hr)) {
+      break;
     }
+
+    for (ULONG i = 0; i < result_count; ++i) {
+      wmi_request.results_.emplace_back(batch[i]);
+    }
+  }
+
+  if (isDisconnected(hr)) {
+    connections.invalidate(nspace, wmi_request.services_);
   }
 
   wmi_request.status_ = Status(0);
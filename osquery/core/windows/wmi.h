@@ -264,7 +264,9 @@ class WmiRequest {
   std::vector<WmiResultItem> results_;
 
   std::unique_ptr<IEnumWbemClassObject, impl::WmiObjectDeleter> enum_{nullptr};
-  std::unique_ptr<IWbemLocator, impl::WmiObjectDeleter> locator_{nullptr};
-  std::unique_ptr<IWbemServices, impl::WmiObjectDeleter> services_{nullptr};
+
+  /// The namespace connection, shared with the other requests.
+  std::shared_ptr<IWbemLocator> locator_;
+  std::shared_ptr<IWbemServices> services_;
 };
 } // namespace osquery
@@ -7,17 +7,25 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <chrono>
+#include <set>
+
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/io/quoted.hpp>
 #include <boost/property_tree/json_parser.hpp>
 
 #include <osquery/core/flagalias.h>
 #include <osquery/core/flags.h>
+#include <osquery/core/sql/binary_rows.h>
+#include <osquery/core/sql/columnar_results.h>
+#include <osquery/core/sql/query_state.h>
 #include <osquery/database/database.h>
+#include <osquery/database/database_compression.h>
 #include <osquery/logger/logger.h>
 #include <osquery/process/process.h>
 #include <osquery/registry/registry.h>
 #include <osquery/utils/config/default_paths.h>
+#include <osquery/utils/conversions/split.h>
 #include <osquery/utils/conversions/tryto.h>
 #include <osquery/utils/json/json.h>
 
@@ -39,6 +47,31 @@ FLAG_ALIAS(std::string, db_path, database_path);
 
 FLAG(bool, disable_database, false, "Disable the persistent RocksDB storage");
 
+FLAG(bool,
+     database_write_behind,
+     false,
+     "Queue the writes of loss-tolerant domains and commit them in batches");
+
+FLAG(uint64,
+     database_write_behind_batch,
+     256,
+     "Max number of queued writes before they are committed");
+
+FLAG(uint64,
+     database_write_behind_ms,
+     1000,
+     "Max age in milliseconds of queued writes before they are committed");
+
+FLAG(string,
+     database_compressed_domains,
+     "",
+     "Comma-separated database domains whose values are compressed");
+
+FLAG(int32,
+     database_compression_level,
+     3,
+     "The zstd level of the compressed database values");
+
 const std::string kInternalDatabase = "rocksdb";
 const std::string kPersistentSettings = "configurations";
 const std::string kQueries = "queries";
@@ -48,12 +81,21 @@ const std::string kLogs = "logs";
 const std::string kDistributedQueries = "distributed";
 const std::string kDistributedRunningQueries = "distributed_running";
 const std::string kQueryPerformance = "query_performance";
+const std::string kFileHashes = "file_hashes";
+const std::string kCodeSignatures = "code_signatures";
 
 const std::string kDbEpochSuffix = "epoch";
 const std::string kDbCounterSuffix = "counter";
+const std::string kDbFingerprintsSuffix = "fingerprints";
+const std::string kDbStateSuffix = "state";
 
 const std::string kDbVersionKey = "results_version";
 
+const std::string kEventsDictionaryPrefix = "dictionary.";
+
+/// The kPersistentSettings key prefix of the compression dictionaries.
+const std::string kCompressionDictionaryPrefix = "compression_dictionary.";
+
 const std::vector<std::string> kDomains = {kPersistentSettings,
                                            kQueries,
                                            kEvents,
@@ -61,7 +103,9 @@ const std::vector<std::string> kDomains = {kPersistentSettings,
                                            kCarves,
                                            kDistributedQueries,
                                            kDistributedRunningQueries,
-                                           kQueryPerformance};
+                                           kQueryPerformance,
+                                           kFileHashes,
+                                           kCodeSignatures};
 
 std::atomic<bool> kDBAllowOpen(false);
 std::atomic<bool> kDBInitialized(false);
@@ -86,6 +130,146 @@ const size_t kDatabaseMaxRetryCount{25};
 /// Number of milliseconds to pause between database initialize retries.
 const size_t kDatabaseRetryDelay{200};
 
+namespace {
+/// Shorter values are not compressed, such as the epochs and counters.
+const size_t kMinCompressedValueSize{64};
+
+/// Protects the compressors, created when a domain is first used.
+Mutex kDatabaseCompressorsMutex;
+
+std::map<std::string, std::shared_ptr<DatabaseValueCompressor>>
+    kDatabaseCompressors;
+
+/// Check if the values written to a domain are compressed.
+bool isCompressedDomain(const std::string& domain) {
+  if (FLAGS_database_compressed_domains.empty() ||
+      domain == kPersistentSettings) {
+    return false;
+  }
+
+  for (const auto& compressed : split(FLAGS_database_compressed_domains, ",")) {
+    if (compressed == domain) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief Get the compressor of a domain, loading its persisted dictionary.
+ *
+ * The caller holds the kDatabaseReset read lock.
+ */
+std::shared_ptr<DatabaseValueCompressor> getDatabaseCompressor(
+    DatabasePlugin& plugin, const std::string& domain) {
+  {
+    ReadLock lock(kDatabaseCompressorsMutex);
+    auto it = kDatabaseCompressors.find(domain);
+    if (it != kDatabaseCompressors.end()) {
+      return it->second;
+    }
+  }
+
+  WriteLock lock(kDatabaseCompressorsMutex);
+  auto& compressor = kDatabaseCompressors[domain];
+  if (compressor == nullptr) {
+    compressor = std::make_shared<DatabaseValueCompressor>(
+        domain, FLAGS_database_compression_level);
+
+    std::string dictionary;
+    if (plugin.get(kPersistentSettings,
+                   kCompressionDictionaryPrefix + domain,
+                   dictionary)
+            .ok() &&
+        !dictionary.empty()) {
+      auto status = compressor->loadDictionary(dictionary);
+      if (!status.ok()) {
+        LOG(WARNING) << "Cannot load the compression dictionary of domain "
+                     << domain << ": " << status.getMessage();
+      }
+    }
+  }
+  return compressor;
+}
+
+/**
+ * @brief Compress a value written to a compressed domain.
+ *
+ * @return false if the value is written as it is.
+ */
+bool compressDatabaseValue(DatabasePlugin& plugin,
+                           const std::string& domain,
+                           const std::string& value,
+                           std::string& compressed) {
+  if (value.size() < kMinCompressedValueSize || !isCompressedDomain(domain)) {
+    return false;
+  }
+
+  auto compressor = getDatabaseCompressor(plugin, domain);
+  std::string dictionary;
+  auto status = compressor->compress(value, compressed, dictionary);
+  if (!status.ok()) {
+    VLOG(1) << status.getMessage();
+    return false;
+  }
+
+  // The dictionary is persisted before any value compressed with it.
+  if (!dictionary.empty()) {
+    status = plugin.put(
+        kPersistentSettings, kCompressionDictionaryPrefix + domain, dictionary);
+    if (!status.ok()) {
+      LOG(WARNING) << "Cannot persist the compression dictionary of domain "
+                   << domain << ": " << status.getMessage();
+    }
+  }
+  return true;
+}
+
+/// Compress the values of a batch, false if they are written as they are.
+bool compressDatabaseBatch(DatabasePlugin& plugin,
+                           const std::string& domain,
+                           const DatabaseStringValueList& data,
+                           DatabaseStringValueList& compressed) {
+  if (!isCompressedDomain(domain)) {
+    return false;
+  }
+
+  compressed.reserve(data.size());
+  for (const auto& item : data) {
+    std::string value;
+    if (compressDatabaseValue(plugin, domain, item.second, value)) {
+      compressed.emplace_back(item.first, std::move(value));
+    } else {
+      compressed.push_back(item);
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Decompress a value read from a domain, if it was compressed.
+ *
+ * Values stay readable once the domain is no longer configured as compressed.
+ */
+Status decompressDatabaseValue(DatabasePlugin& plugin,
+                               const std::string& domain,
+                               std::string& value) {
+  if (!DatabaseValueCompressor::isCompressed(value)) {
+    return Status::success();
+  }
+
+  std::string decompressed;
+  auto status = getDatabaseCompressor(plugin, domain)
+                    ->decompress(value, decompressed);
+  if (!status.ok()) {
+    return Status::failure("Cannot read the value in domain " + domain +
+                           ": " + status.getMessage());
+  }
+  value = std::move(decompressed);
+  return Status::success();
+}
+} // namespace
+
 Status DatabasePlugin::reset() {
   // Keep this simple, scope the critical section to the broader methods.
   tearDown();
@@ -122,10 +306,50 @@ Status DatabasePlugin::scan(const std::string& domain,
   return Status::success();
 }
 
+Status DatabasePlugin::scanValues(const std::string& domain,
+                                  const std::string& prefix,
+                                  uint64_t max,
+                                  const DatabaseScanCallback& callback) const {
+  std::vector<std::string> keys;
+  auto status = scan(domain, keys, prefix, max);
+  if (!status.ok()) {
+    return status;
+  }
+
+  for (const auto& key : keys) {
+    std::string value;
+    if (get(domain, key, value).ok() && !callback(key, value)) {
+      break;
+    }
+  }
+  return Status::success();
+}
+
+Status IDatabaseInterface::scanDatabaseValues(
+    const std::string& domain,
+    const std::string& prefix,
+    size_t max,
+    const DatabaseScanCallback& callback) const {
+  std::vector<std::string> keys;
+  auto status = scanDatabaseKeys(domain, keys, prefix, max);
+  if (!status.ok()) {
+    return status;
+  }
+
+  for (const auto& key : keys) {
+    std::string value;
+    if (getDatabaseValue(domain, key, value).ok() && !callback(key, value)) {
+      break;
+    }
+  }
+  return Status::success();
+}
+
 Status DatabasePlugin::call(const PluginRequest& request,
                             PluginResponse& response) {
   if (request.count("action") == 0) {
-    return Status(1, "Database plugin must include a request action");
+    return Status::staticFailure(
+        "Database plugin must include a request action");
   }
 
   // Get a domain/key, which are used for most database plugin actions.
@@ -138,6 +362,11 @@ Status DatabasePlugin::call(const PluginRequest& request,
     // Prevent RocksDB reentrancy by logger plugins during plugin setup.
     VLOG(1) << "Resetting the database plugin: " << getName();
     auto status = this->reset();
+    {
+      // The dictionaries are loaded again from the reset database.
+      WriteLock compressors_lock(kDatabaseCompressorsMutex);
+      kDatabaseCompressors.clear();
+    }
     if (!status.ok()) {
       // The active database could not be reset, fallback to an ephemeral.
       Registry::get().setActive("database", "ephemeral");
@@ -152,11 +381,20 @@ Status DatabasePlugin::call(const PluginRequest& request,
   if (request.at("action") == "get") {
     std::string value;
     auto status = this->get(domain, key, value);
+    if (status.ok()) {
+      status = decompressDatabaseValue(*this, domain, value);
+    }
     response.push_back({{"v", value}});
     return status;
   } else if (request.at("action") == "put") {
     if (request.count("value") == 0) {
-      return Status(1, "Database plugin put action requires a value");
+      return Status::staticFailure(
+          "Database plugin put action requires a value");
+    }
+
+    std::string compressed;
+    if (compressDatabaseValue(*this, domain, request.at("value"), compressed)) {
+      return this->put(domain, key, compressed);
     }
     return this->put(domain, key, request.at("value"));
   } else if (request.at("action") == "putBatch") {
@@ -190,7 +428,13 @@ Status DatabasePlugin::call(const PluginRequest& request,
           std::make_pair(item.name.GetString(), item.value.GetString()));
     }
 
+    DatabaseStringValueList compressed;
+    if (compressDatabaseBatch(*this, domain, data, compressed)) {
+      return this->putBatch(domain, compressed);
+    }
     return this->putBatch(domain, data);
+  } else if (request.at("action") == "reclaim") {
+    return this->reclaim();
   } else if (request.at("action") == "remove") {
     return this->remove(domain, key);
   } else if (request.at("action") == "remove_range") {
@@ -199,7 +443,7 @@ Status DatabasePlugin::call(const PluginRequest& request,
     if (!key_high.empty() && !key.empty()) {
       return this->removeRange(domain, key, key_high);
     }
-    return Status(1, "Missing range");
+    return Status::staticFailure("Missing range");
   } else if (request.at("action") == "scan") {
     // Accumulate scanned keys into a vector.
     std::vector<std::string> keys;
@@ -215,20 +459,128 @@ Status DatabasePlugin::call(const PluginRequest& request,
     return status;
   }
 
-  return Status(1, "Unknown database plugin action");
+  return Status::staticFailure("Unknown database plugin action");
 }
 
 static inline std::shared_ptr<DatabasePlugin> getDatabasePlugin() {
   auto& rf = RegistryFactory::get();
-  if (!rf.exists("database", rf.getActive("database"), true)) {
+  auto active = rf.getActive("database");
+  if (!rf.exists("database", active, true)) {
     return nullptr;
   }
 
-  auto plugin = rf.plugin("database", rf.getActive("database"));
+  auto plugin = rf.plugin("database", active);
   return std::dynamic_pointer_cast<DatabasePlugin>(plugin);
 }
 
 namespace {
+/**
+ * @brief Coalesce the writes of deferred domains into batches.
+ *
+ * Writers append to the pending batches. The writer that fills the batch, or
+ * finds the oldest write expired, commits every pending batch on behalf of
+ * the others. Commits are serialized so the writes reach the plugin in order.
+ */
+class DatabaseWriteBehind {
+ public:
+  /// Queue values, commit the pending batches once full or expired.
+  void put(const std::string& domain, const DatabaseStringValueList& data);
+
+  /// Commit the pending batches, or nothing if none holds the domain.
+  Status flush(const std::string& domain = "");
+
+ private:
+  /// Serializes commits, held while the pending batches are written.
+  Mutex commit_mutex_;
+
+  /// Protects the pending batches.
+  Mutex pending_mutex_;
+
+  std::map<std::string, DatabaseStringValueList> pending_;
+
+  /// The number of pending writes.
+  size_t count_{0};
+
+  /// The time of the oldest pending write.
+  std::chrono::steady_clock::time_point oldest_;
+};
+
+DatabaseWriteBehind kDatabaseWriteBehind;
+
+void DatabaseWriteBehind::put(const std::string& domain,
+                              const DatabaseStringValueList& data) {
+  bool commit = false;
+  {
+    WriteLock lock(pending_mutex_);
+    auto now = std::chrono::steady_clock::now();
+    if (count_ == 0) {
+      oldest_ = now;
+    }
+
+    auto& batch = pending_[domain];
+    batch.insert(batch.end(), data.begin(), data.end());
+    count_ += data.size();
+    commit = count_ >= FLAGS_database_write_behind_batch ||
+             now - oldest_ >= std::chrono::milliseconds(
+                                  FLAGS_database_write_behind_ms);
+  }
+
+  if (commit) {
+    flush();
+  }
+}
+
+Status DatabaseWriteBehind::flush(const std::string& domain) {
+  WriteLock commit_lock(commit_mutex_);
+  std::map<std::string, DatabaseStringValueList> batches;
+  {
+    WriteLock lock(pending_mutex_);
+    if (!domain.empty() && pending_.count(domain) == 0) {
+      return Status::success();
+    }
+    batches.swap(pending_);
+    count_ = 0;
+  }
+
+  if (batches.empty()) {
+    return Status::success();
+  }
+
+  ReadLock lock(kDatabaseReset);
+  if (!kDBInitialized) {
+    return Status::staticFailure("Cannot commit queued database values");
+  }
+
+  auto plugin = getDatabasePlugin();
+  Status status;
+  for (const auto& batch : batches) {
+    DatabaseStringValueList compressed;
+    auto s =
+        compressDatabaseBatch(*plugin, batch.first, batch.second, compressed)
+            ? plugin->putBatch(batch.first, compressed)
+            : plugin->putBatch(batch.first, batch.second);
+    if (!s.ok()) {
+      VLOG(1) << "Cannot commit queued values in domain " << batch.first
+              << ": " << s.getMessage();
+      status = s;
+    }
+  }
+  return status;
+}
+
+/// Check if writes to a domain are queued by the write-behind layer.
+inline bool isWriteBehind(const std::string& domain) {
+  return FLAGS_database_write_behind &&
+         getDatabaseDurability(domain) == DatabaseDurability::Deferred;
+}
+
+/// A barrier before reading or deleting values of a domain.
+inline void flushWriteBehind(const std::string& domain) {
+  if (isWriteBehind(domain)) {
+    kDatabaseWriteBehind.flush(domain);
+  }
+}
+
 Status sendPutBatchDatabaseRequest(const std::string& domain,
                                    const DatabaseStringValueList& data) {
   auto json_object = JSON::newObject();
@@ -259,10 +611,8 @@ Status sendPutBatchDatabaseRequest(const std::string& domain,
 }
 
 Status sendPutDatabaseRequest(const std::string& domain,
-                              const DatabaseStringValueList& data) {
-  const auto& key = data[0].first;
-  const auto& value = data[0].second;
-
+                              const std::string& key,
+                              const std::string& value) {
   PluginRequest request = {
       {"action", "put"}, {"domain", domain}, {"key", key}, {"value", value}};
 
@@ -275,11 +625,21 @@ Status sendPutDatabaseRequest(const std::string& domain,
 }
 } // namespace
 
+DatabaseDurability getDatabaseDurability(const std::string& domain) {
+  // Events expire and query performance is statistics, both tolerate loss.
+  // File hashes and signatures are caches, lost values are calculated again.
+  if (domain == kEvents || domain == kQueryPerformance ||
+      domain == kFileHashes || domain == kCodeSignatures) {
+    return DatabaseDurability::Deferred;
+  }
+  return DatabaseDurability::Sync;
+}
+
 Status getDatabaseValue(const std::string& domain,
                         const std::string& key,
                         std::string& value) {
   if (domain.empty()) {
-    return Status(1, "Missing domain");
+    return Status::staticFailure("Missing domain");
   }
 
   if (RegistryFactory::get().external()) {
@@ -298,12 +658,17 @@ Status getDatabaseValue(const std::string& domain,
     return status;
   }
 
+  flushWriteBehind(domain);
   ReadLock lock(kDatabaseReset);
   if (!kDBInitialized) {
     throw std::runtime_error("Cannot get database value: " + key);
   } else {
     auto plugin = getDatabasePlugin();
-    return plugin->get(domain, key, value);
+    auto status = plugin->get(domain, key, value);
+    if (status.ok()) {
+      status = decompressDatabaseValue(*plugin, domain, value);
+    }
+    return status;
   }
 }
 
@@ -321,13 +686,37 @@ Status getDatabaseValue(const std::string& domain,
 Status setDatabaseValue(const std::string& domain,
                         const std::string& key,
                         const std::string& value) {
-  return setDatabaseBatch(domain, {std::make_pair(key, value)});
+  if (domain.empty()) {
+    return Status::staticFailure("Missing domain");
+  }
+
+  // A single value is written without copying it into a batch.
+  if (RegistryFactory::get().external()) {
+    return sendPutDatabaseRequest(domain, key, value);
+  }
+
+  if (isWriteBehind(domain) && kDBInitialized) {
+    kDatabaseWriteBehind.put(domain, {{key, value}});
+    return Status::success();
+  }
+
+  ReadLock lock(kDatabaseReset);
+  if (!kDBInitialized) {
+    throw std::runtime_error("Cannot set database value: " + key);
+  }
+
+  auto plugin = getDatabasePlugin();
+  std::string compressed;
+  if (compressDatabaseValue(*plugin, domain, value, compressed)) {
+    return plugin->put(domain, key, compressed);
+  }
+  return plugin->put(domain, key, value);
 }
 
 Status setDatabaseBatch(const std::string& domain,
                         const DatabaseStringValueList& data) {
   if (domain.empty()) {
-    return Status(1, "Missing domain");
+    return Status::staticFailure("Missing domain");
   }
 
   // External registries (extensions) do not have databases active.
@@ -335,9 +724,15 @@ Status setDatabaseBatch(const std::string& domain,
   if (RegistryFactory::get().external()) {
     if (data.size() > 1) {
       return sendPutBatchDatabaseRequest(domain, data);
-    } else {
-      return sendPutDatabaseRequest(domain, data);
+    } else if (data.size() == 1) {
+      return sendPutDatabaseRequest(domain, data[0].first, data[0].second);
     }
+    return Status::success();
+  }
+
+  if (isWriteBehind(domain) && kDBInitialized) {
+    kDatabaseWriteBehind.put(domain, data);
+    return Status::success();
   }
 
   ReadLock lock(kDatabaseReset);
@@ -346,18 +741,22 @@ Status setDatabaseBatch(const std::string& domain,
   }
 
   auto plugin = getDatabasePlugin();
+  DatabaseStringValueList compressed;
+  if (compressDatabaseBatch(*plugin, domain, data, compressed)) {
+    return plugin->putBatch(domain, compressed);
+  }
   return plugin->putBatch(domain, data);
 }
 
 Status setDatabaseValue(const std::string& domain,
                         const std::string& key,
                         int value) {
-  return setDatabaseBatch(domain, {std::make_pair(key, std::to_string(value))});
+  return setDatabaseValue(domain, key, std::to_string(value));
 }
 
 Status deleteDatabaseValue(const std::string& domain, const std::string& key) {
   if (domain.empty()) {
-    return Status(1, "Missing domain");
+    return Status::staticFailure("Missing domain");
   }
 
   if (RegistryFactory::get().external()) {
@@ -368,6 +767,7 @@ Status deleteDatabaseValue(const std::string& domain, const std::string& key) {
     return Registry::call("database", request);
   }
 
+  flushWriteBehind(domain);
   ReadLock lock(kDatabaseReset);
   if (!kDBInitialized) {
     throw std::runtime_error("Cannot delete database value: " + key);
@@ -381,7 +781,7 @@ Status deleteDatabaseRange(const std::string& domain,
                            const std::string& low,
                            const std::string& high) {
   if (domain.empty()) {
-    return Status(1, "Missing domain");
+    return Status::staticFailure("Missing domain");
   }
 
   if (RegistryFactory::get().external()) {
@@ -394,6 +794,7 @@ Status deleteDatabaseRange(const std::string& domain,
     return Registry::call("database", request);
   }
 
+  flushWriteBehind(domain);
   ReadLock lock(kDatabaseReset);
   if (!kDBInitialized) {
     throw std::runtime_error("Cannot delete database values: " + low + " - " +
@@ -416,7 +817,7 @@ Status scanDatabaseKeys(const std::string& domain,
                         const std::string& prefix,
                         uint64_t max) {
   if (domain.empty()) {
-    return Status(1, "Missing domain");
+    return Status::staticFailure("Missing domain");
   }
 
   if (RegistryFactory::get().external()) {
@@ -437,6 +838,7 @@ Status scanDatabaseKeys(const std::string& domain,
     return status;
   }
 
+  flushWriteBehind(domain);
   ReadLock lock(kDatabaseReset);
   if (!kDBInitialized) {
     throw std::runtime_error("Cannot scan database values: " + prefix);
@@ -446,11 +848,77 @@ Status scanDatabaseKeys(const std::string& domain,
   }
 }
 
+Status scanDatabaseValues(const std::string& domain,
+                          const std::string& prefix,
+                          uint64_t max,
+                          const DatabaseScanCallback& callback) {
+  if (domain.empty()) {
+    return Status::staticFailure("Missing domain");
+  }
+
+  if (RegistryFactory::get().external()) {
+    // Extensions read the values of the scanned keys one by one.
+    std::vector<std::string> keys;
+    auto status = scanDatabaseKeys(domain, keys, prefix, max);
+    for (const auto& key : keys) {
+      std::string value;
+      if (getDatabaseValue(domain, key, value).ok() && !callback(key, value)) {
+        break;
+      }
+    }
+    return status;
+  }
+
+  flushWriteBehind(domain);
+  ReadLock lock(kDatabaseReset);
+  if (!kDBInitialized) {
+    throw std::runtime_error("Cannot scan database values: " + prefix);
+  } else {
+    auto plugin = getDatabasePlugin();
+    return plugin->scanValues(
+        domain,
+        prefix,
+        max,
+        [&plugin, &domain, &callback](const std::string& key,
+                                      std::string& value) {
+          auto status = decompressDatabaseValue(*plugin, domain, value);
+          if (!status.ok()) {
+            VLOG(1) << status.getMessage();
+            return true;
+          }
+          return callback(key, value);
+        });
+  }
+}
+
+Status flushDatabase() {
+  return kDatabaseWriteBehind.flush();
+}
+
 void resetDatabase() {
+  // Queued writes are committed to the plugin before it is reset.
+  flushDatabase();
   PluginRequest request = {{"action", "reset"}};
   Registry::call("database", request);
 }
 
+Status reclaimDatabase() {
+  if (RegistryFactory::get().external()) {
+    PluginRequest request = {{"action", "reclaim"}};
+    return Registry::call("database", request);
+  }
+
+  // Queued writes are committed so their memory is released too.
+  flushDatabase();
+  ReadLock lock(kDatabaseReset);
+  if (!kDBInitialized) {
+    return Status::staticFailure("Cannot reclaim database memory");
+  }
+
+  auto plugin = getDatabasePlugin();
+  return plugin->reclaim();
+}
+
 void dumpDatabase() {
   for (const auto& domain : kDomains) {
     std::vector<std::string> keys;
@@ -512,6 +980,7 @@ bool databaseInitialized() {
 }
 
 void shutdownDatabase() {
+  flushDatabase();
   auto database_registry = RegistryFactory::get().registry("database");
   for (auto& plugin : RegistryFactory::get().names("database")) {
     database_registry->remove(plugin);
@@ -525,7 +994,7 @@ Status ptreeToRapidJSON(const std::string& in, std::string& out) {
     ss << in;
     pt::read_json(ss, tree);
   } catch (const pt::json_parser::json_parser_error& /* e */) {
-    return Status(1, "Failed to parse JSON");
+    return Status::staticFailure("Failed to parse JSON");
   }
 
   auto json = JSON::newArray();
@@ -535,7 +1004,7 @@ Status ptreeToRapidJSON(const std::string& in, std::string& out) {
 
     rj::Document row;
     if (row.Parse(ss.str()).HasParseError()) {
-      return Status(1, "Failed to serialize JSON");
+      return Status::staticFailure("Failed to serialize JSON");
     }
     json.push(row);
   }
@@ -549,7 +1018,8 @@ static Status migrateV0V1(void) {
   std::vector<std::string> keys;
   auto s = scanDatabaseKeys(kQueries, keys);
   if (!s.ok()) {
-    return Status(1, "Failed to lookup legacy query data from database");
+    return Status::staticFailure(
+        "Failed to lookup legacy query data from database");
   }
 
   for (const auto& key : keys) {
@@ -627,6 +1097,176 @@ static Status migrateV1V2(void) {
   return Status::success();
 }
 
+static Status migrateV2V3(void) {
+  std::vector<std::string> keys;
+  auto s = scanDatabaseKeys(kQueries, keys);
+  if (!s.ok()) {
+    return Status::staticFailure("Failed to lookup query data from database");
+  }
+
+  for (const auto& key : keys) {
+    // Only scheduled query results are re-encoded, the table cache, views
+    // and query text stay as they are.
+    if (boost::algorithm::ends_with(key, kDbEpochSuffix) ||
+        boost::algorithm::ends_with(key, kDbCounterSuffix) ||
+        boost::algorithm::ends_with(key, kDbFingerprintsSuffix) ||
+        boost::algorithm::starts_with(key, "query.") ||
+        boost::algorithm::starts_with(key, "cache.") ||
+        boost::algorithm::starts_with(key, "config_views.")) {
+      continue;
+    }
+
+    std::string value;
+    if (!getDatabaseValue(kQueries, key, value)) {
+      LOG(WARNING) << "Failed to get value from database " << key;
+      continue;
+    }
+
+    if (value.empty() || value[0] != '[') {
+      continue;
+    }
+
+    QueryDataTyped results;
+    s = deserializeQueryDataJSON(value, results);
+    if (!s.ok()) {
+      // Readers accept JSON, the value is left as-is.
+      LOG(WARNING) << "Failed to parse results for '" << key
+                   << "'. Key will be kept but won't be migrated!";
+      continue;
+    }
+
+    std::string encoded;
+    ColumnarResults::encode(results, encoded);
+    if (!setDatabaseValue(kQueries, key, encoded)) {
+      LOG(WARNING) << "Failed to update value in database " << key;
+    }
+  }
+
+  return Status::success();
+}
+
+static Status migrateV3V4(void) {
+  std::vector<std::string> keys;
+  auto s = scanDatabaseKeys(kEvents, keys, "data.", 0);
+  if (!s.ok()) {
+    return Status::staticFailure("Failed to scan event keys from database");
+  }
+
+  // Event data keys are "data.<publisher>.<subscriber>.<eid>".
+  std::map<std::string, BinaryRowDictionary> dictionaries;
+  for (const auto& key : keys) {
+    auto eid = key.rfind('.');
+    if (eid == std::string::npos || eid <= 5) {
+      continue;
+    }
+
+    std::string value;
+    if (!getDatabaseValue(kEvents, key, value) || value.empty() ||
+        BinaryRowDictionary::isEncoded(value)) {
+      continue;
+    }
+
+    Row row;
+    if (!deserializeRowJSON(value, row)) {
+      // Readers accept JSON, the value is left as-is.
+      LOG(WARNING) << "Failed to parse event '" << key
+                   << "'. Key will be kept but won't be migrated!";
+      continue;
+    }
+
+    auto name = key.substr(5, eid - 5);
+    auto it = dictionaries.find(name);
+    if (it == dictionaries.end()) {
+      // Resume with the dictionary of a partially completed migration.
+      it = dictionaries.emplace(name, BinaryRowDictionary()).first;
+      std::string serialized;
+      if (getDatabaseValue(
+              kEvents, kEventsDictionaryPrefix + name, serialized)) {
+        it->second.deserialize(serialized);
+      }
+    }
+
+    auto& dictionary = it->second;
+    std::string encoded;
+    dictionary.encode(row, encoded);
+
+    // Rows are only written once the columns they use are persisted.
+    if (dictionary.grown() > 0) {
+      std::string serialized;
+      dictionary.serialize(serialized);
+      s = setDatabaseValue(kEvents, kEventsDictionaryPrefix + name, serialized);
+      if (!s.ok()) {
+        return Status::failure("Failed to store the event dictionary for " +
+                               name);
+      }
+      dictionary.clearGrown();
+    }
+
+    if (!setDatabaseValue(kEvents, key, encoded)) {
+      LOG(WARNING) << "Failed to update value in database " << key;
+    }
+  }
+
+  return Status::success();
+}
+
+static Status migrateV4V5(void) {
+  std::vector<std::string> keys;
+  auto s = scanDatabaseKeys(kQueries, keys);
+  if (!s.ok()) {
+    return Status::staticFailure("Failed to lookup query data from database");
+  }
+
+  std::set<std::string> stored(keys.begin(), keys.end());
+  for (const auto& key : keys) {
+    // Each scheduled query with stored results has an epoch.
+    if (!boost::algorithm::ends_with(key, kDbEpochSuffix) ||
+        boost::algorithm::starts_with(key, "query.") ||
+        boost::algorithm::starts_with(key, "cache.") ||
+        boost::algorithm::starts_with(key, "config_views.")) {
+      continue;
+    }
+
+    auto name = key.substr(0, key.size() - kDbEpochSuffix.size());
+    if (name.empty() || stored.count(name) == 0) {
+      continue;
+    }
+
+    std::string value;
+    getDatabaseValue(kQueries, key, value);
+    auto epoch = tryTo<uint64_t>(value);
+    if (epoch.isError()) {
+      LOG(WARNING) << "Failed to read the epoch of '" << name
+                   << "'. Keys will be kept but won't be migrated!";
+      continue;
+    }
+
+    QueryState state;
+    state.epoch = epoch.get();
+
+    if (getDatabaseValue(kQueries, name + kDbCounterSuffix, value)) {
+      state.counter = tryTo<uint64_t>(value).takeOr(uint64_t{0});
+      state.has_counter = true;
+    }
+    getDatabaseValue(kQueries, "query." + name, state.query);
+    state.has_fingerprints = stored.count(name + kDbFingerprintsSuffix) > 0;
+
+    s = setDatabaseValue(kQueries, name + kDbStateSuffix, state.encode());
+    if (!s.ok()) {
+      LOG(WARNING) << "Failed to store the state of '" << name
+                   << "'. Keys will be kept but won't be migrated!";
+      continue;
+    }
+
+    // The state replaces the separate values, readers fall back to them.
+    deleteDatabaseValue(kQueries, key);
+    deleteDatabaseValue(kQueries, name + kDbCounterSuffix);
+    deleteDatabaseValue(kQueries, "query." + name);
+  }
+
+  return Status::success();
+}
+
 Status upgradeDatabase(int to_version) {
   std::string value;
   Status st = getDatabaseValue(kPersistentSettings, kDbVersionKey, value);
@@ -641,7 +1281,7 @@ Status upgradeDatabase(int to_version) {
     if (ret.isError()) {
       LOG(ERROR) << "Invalid value '" << value << "'for " << kDbVersionKey
                  << " key. Database is corrupted.";
-      return Status::failure("Invalid value for database version.");
+      return Status::staticFailure("Invalid value for database version.");
     } else {
       db_version = ret.get();
     }
@@ -658,16 +1298,28 @@ Status upgradeDatabase(int to_version) {
       migrate_status = migrateV1V2();
       break;
 
+    case 2:
+      migrate_status = migrateV2V3();
+      break;
+
+    case 3:
+      migrate_status = migrateV3V4();
+      break;
+
+    case 4:
+      migrate_status = migrateV4V5();
+      break;
+
     default:
       LOG(ERROR) << "Logic error: the migration code is broken!";
-      migrate_status = Status::failure("Migration code broken.");
+      migrate_status = Status::staticFailure("Migration code broken.");
       break;
     }
 
     if (!migrate_status.ok()) {
       LOG(ERROR) << "Failed to migrate the database to version '" << db_version
                  << "': " << migrate_status.getMessage();
-      return Status::failure("Database migration failed.");
+      return Status::staticFailure("Database migration failed.");
     }
 
     st = setDatabaseValue(
@@ -677,7 +1329,7 @@ Status upgradeDatabase(int to_version) {
                  << "The DB was correctly migrated from version " << db_version
                  << " to version " << (db_version + 1)
                  << " but persisting the new version failed.";
-      return Status::failure("Database version commit failed.");
+      return Status::staticFailure("Database version commit failed.");
     }
 
     db_version++;
@@ -744,6 +1396,14 @@ class OsqueryDatabase final : public IDatabaseInterface {
                                   size_t max) const override {
     return osquery::scanDatabaseKeys(domain, keys, prefix, max);
   }
+
+  virtual Status scanDatabaseValues(
+      const std::string& domain,
+      const std::string& prefix,
+      size_t max,
+      const DatabaseScanCallback& callback) const override {
+    return osquery::scanDatabaseValues(domain, prefix, max, callback);
+  }
 };
 
 IDatabaseInterface& getOsqueryDatabase() {
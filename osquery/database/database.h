@@ -46,6 +46,9 @@ extern const std::string kQueries;
 /// The "domain" where event results are stored, queued for querytime retrieval.
 extern const std::string kEvents;
 
+/// The key prefix of each event subscriber's binary row dictionary.
+extern const std::string kEventsDictionaryPrefix;
+
 /// The "domain" where the results of carve queries are stored.
 extern const std::string kCarves;
 
@@ -61,8 +64,14 @@ extern const std::string kDistributedRunningQueries;
 /// The "domain" where query performance stats are stored.
 extern const std::string kQueryPerformance;
 
+/// The "domain" where the hashes of files are cached, keyed by inode.
+extern const std::string kFileHashes;
+
+/// The "domain" where code signature results are cached, keyed by file.
+extern const std::string kCodeSignatures;
+
 /// The running version of our database schema
-const int kDbCurrentVersion = 2;
+const int kDbCurrentVersion = 5;
 
 /**
  * @brief The "domain" where buffered log results are stored.
@@ -148,6 +157,32 @@ class DatabasePlugin : public Plugin {
                       const std::string& prefix,
                       uint64_t max) const;
 
+  /**
+   * @brief Read the keys matching a prefix and their values, in key order.
+   *
+   * Plugins should read both in a single pass, the default scans the keys
+   * then gets each value. The callback must not use the database APIs.
+   *
+   * @param domain A string value representing abstract storage indexing.
+   * @param prefix The keys to read start with this prefix.
+   * @param max The maximum number of keys to read, 0 means no limit.
+   * @param callback Receives each key and value, return false to stop.
+   */
+  virtual Status scanValues(const std::string& domain,
+                            const std::string& prefix,
+                            uint64_t max,
+                            const DatabaseScanCallback& callback) const;
+
+  /**
+   * @brief Release cached and buffered memory without closing the database.
+   *
+   * Unlike #reset this runs while other threads use the database, the work
+   * should be started in the background where the plugin supports it.
+   */
+  virtual Status reclaim() {
+    return Status::success();
+  }
+
   /**
    * @brief Shutdown the database and release initialization resources.
    *
@@ -186,6 +221,18 @@ class DatabasePlugin : public Plugin {
   std::string path_;
 };
 
+/// How soon a write to a domain must reach the backing store.
+enum class DatabaseDurability {
+  /// The write is stored before the call returns.
+  Sync,
+
+  /// The write may be queued and lost on a crash, see database_write_behind.
+  Deferred,
+};
+
+/// The durability of the writes to a domain.
+DatabaseDurability getDatabaseDurability(const std::string& domain);
+
 /**
  * @brief Lookup a value from the active osquery DatabasePlugin storage.
  *
@@ -248,9 +295,31 @@ Status scanDatabaseKeys(const std::string& domain,
                         const std::string& prefix,
                         uint64_t max = 0);
 
+/**
+ * @brief Read the keys matching a prefix and their values, in key order.
+ *
+ * The values are read in a single pass, instead of a get for each scanned
+ * key. The callback must not use the database APIs.
+ */
+Status scanDatabaseValues(const std::string& domain,
+                          const std::string& prefix,
+                          uint64_t max,
+                          const DatabaseScanCallback& callback);
+
+/**
+ * @brief Commit the writes queued by the write-behind layer.
+ *
+ * Reads, scans, and deletes of a domain commit its queued writes first. This
+ * barrier is used before resetting or shutting down the database.
+ */
+Status flushDatabase();
+
 /// Allow callers to reload or reset the database plugin.
 void resetDatabase();
 
+/// Release database memory without the exclusive lock taken by a reset.
+Status reclaimDatabase();
+
 /// Allow callers to scan each column family and print each value.
 void dumpDatabase();
 
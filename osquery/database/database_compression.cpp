@@ -0,0 +1,214 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+
+#include <osquery/database/database_compression.h>
+
+#include <zdict.h>
+#include <zstd.h>
+
+namespace osquery {
+
+namespace {
+
+const std::string kCompressedValueMagic{"\0OQZ", 4};
+
+/// The values kept to train a dictionary, and the bytes kept of each.
+const size_t kDictionarySamples{128};
+const size_t kMaxSampleBytes{16 * 1024};
+
+const size_t kDictionaryBytes{16 * 1024};
+
+/// Larger values are corrupted, they are not decompressed.
+const unsigned long long kMaxDecompressedBytes{1024ULL * 1024 * 1024};
+
+} // namespace
+
+struct DatabaseValueCompressor::PrivateData {
+  int level{3};
+
+  mutable Mutex mutex;
+  ZSTD_CCtx* cctx{nullptr};
+  ZSTD_DCtx* dctx{nullptr};
+
+  ZSTD_CDict* cdict{nullptr};
+  ZSTD_DDict* ddict{nullptr};
+  unsigned dictionary_id{0};
+
+  /// A dictionary was loaded or trained, or training it failed.
+  bool has_dictionary{false};
+
+  std::string samples;
+  std::vector<size_t> sample_sizes;
+};
+
+DatabaseValueCompressor::DatabaseValueCompressor(const std::string& domain,
+                                                 int level)
+    : d_(std::make_unique<PrivateData>()),
+      raw_bytes_("database.compression." + domain + ".raw_bytes",
+                 monitoring::PreAggregationType::Sum),
+      compressed_bytes_("database.compression." + domain + ".compressed_bytes",
+                        monitoring::PreAggregationType::Sum),
+      ratio_path_("database.compression." + domain + ".ratio") {
+  d_->level = level;
+  d_->cctx = ZSTD_createCCtx();
+  d_->dctx = ZSTD_createDCtx();
+}
+
+DatabaseValueCompressor::~DatabaseValueCompressor() {
+  ZSTD_freeCDict(d_->cdict);
+  ZSTD_freeDDict(d_->ddict);
+  ZSTD_freeCCtx(d_->cctx);
+  ZSTD_freeDCtx(d_->dctx);
+}
+
+bool DatabaseValueCompressor::isCompressed(const std::string& value) {
+  return value.compare(
+             0, kCompressedValueMagic.size(), kCompressedValueMagic) == 0;
+}
+
+Status DatabaseValueCompressor::loadDictionary(const std::string& dictionary) {
+  WriteLock lock(d_->mutex);
+  auto id = ZDICT_getDictID(dictionary.data(), dictionary.size());
+  if (id == 0) {
+    return Status::staticFailure("Invalid compression dictionary");
+  }
+
+  ZSTD_freeCDict(d_->cdict);
+  ZSTD_freeDDict(d_->ddict);
+  d_->cdict =
+      ZSTD_createCDict(dictionary.data(), dictionary.size(), d_->level);
+  d_->ddict = ZSTD_createDDict(dictionary.data(), dictionary.size());
+  d_->dictionary_id = id;
+  d_->has_dictionary = true;
+  d_->samples.clear();
+  d_->sample_sizes.clear();
+  return Status::success();
+}
+
+bool DatabaseValueCompressor::train(std::string& dictionary) {
+  std::string trained(kDictionaryBytes, '\0');
+  auto size = ZDICT_trainFromBuffer(&trained[0],
+                                    trained.size(),
+                                    d_->samples.data(),
+                                    d_->sample_sizes.data(),
+                                    static_cast<unsigned>(
+                                        d_->sample_sizes.size()));
+  d_->samples.clear();
+  d_->sample_sizes.clear();
+
+  // The values are compressed without a dictionary if none can be trained.
+  d_->has_dictionary = true;
+  if (ZDICT_isError(size)) {
+    return false;
+  }
+
+  trained.resize(size);
+  d_->cdict = ZSTD_createCDict(trained.data(), trained.size(), d_->level);
+  d_->ddict = ZSTD_createDDict(trained.data(), trained.size());
+  d_->dictionary_id = ZDICT_getDictID(trained.data(), trained.size());
+  dictionary = std::move(trained);
+  return true;
+}
+
+Status DatabaseValueCompressor::compress(const std::string& value,
+                                         std::string& compressed,
+                                         std::string& dictionary) {
+  WriteLock lock(d_->mutex);
+  if (!d_->has_dictionary) {
+    auto sample_size = std::min(value.size(), kMaxSampleBytes);
+    d_->samples.append(value, 0, sample_size);
+    d_->sample_sizes.push_back(sample_size);
+    if (d_->sample_sizes.size() >= kDictionarySamples) {
+      train(dictionary);
+    }
+  }
+
+  compressed.resize(kCompressedValueMagic.size() +
+                    ZSTD_compressBound(value.size()));
+  compressed.replace(
+      0, kCompressedValueMagic.size(), kCompressedValueMagic);
+
+  auto* output = &compressed[kCompressedValueMagic.size()];
+  auto capacity = compressed.size() - kCompressedValueMagic.size();
+  auto size = (d_->cdict != nullptr)
+                  ? ZSTD_compress_usingCDict(d_->cctx,
+                                             output,
+                                             capacity,
+                                             value.data(),
+                                             value.size(),
+                                             d_->cdict)
+                  : ZSTD_compressCCtx(d_->cctx,
+                                      output,
+                                      capacity,
+                                      value.data(),
+                                      value.size(),
+                                      d_->level);
+  if (ZSTD_isError(size)) {
+    return Status::failure(std::string("Cannot compress the value: ") +
+                           ZSTD_getErrorName(size));
+  }
+
+  compressed.resize(kCompressedValueMagic.size() + size);
+  raw_bytes_.record(static_cast<monitoring::ValueType>(value.size()));
+  compressed_bytes_.record(
+      static_cast<monitoring::ValueType>(compressed.size()));
+  if (!compressed.empty()) {
+    monitoring::record(ratio_path_,
+                       static_cast<double>(value.size()) /
+                           static_cast<double>(compressed.size()),
+                       monitoring::PreAggregationType::Avg);
+  }
+  return Status::success();
+}
+
+Status DatabaseValueCompressor::decompress(const std::string& compressed,
+                                           std::string& value) const {
+  if (!isCompressed(compressed)) {
+    return Status::staticFailure("The value is not compressed");
+  }
+
+  const auto* input = compressed.data() + kCompressedValueMagic.size();
+  auto input_size = compressed.size() - kCompressedValueMagic.size();
+  auto content_size = ZSTD_getFrameContentSize(input, input_size);
+  if (content_size == ZSTD_CONTENTSIZE_ERROR ||
+      content_size == ZSTD_CONTENTSIZE_UNKNOWN ||
+      content_size > kMaxDecompressedBytes) {
+    return Status::staticFailure("Invalid compressed value");
+  }
+
+  WriteLock lock(d_->mutex);
+  auto id = ZSTD_getDictID_fromFrame(input, input_size);
+  if (id != 0 && (d_->ddict == nullptr || id != d_->dictionary_id)) {
+    return Status::failure("The value was compressed with a missing "
+                           "dictionary");
+  }
+
+  std::string output(static_cast<size_t>(content_size), '\0');
+  auto size = (id != 0) ? ZSTD_decompress_usingDDict(d_->dctx,
+                                                     &output[0],
+                                                     output.size(),
+                                                     input,
+                                                     input_size,
+                                                     d_->ddict)
+                        : ZSTD_decompressDCtx(d_->dctx,
+                                              &output[0],
+                                              output.size(),
+                                              input,
+                                              input_size);
+  if (ZSTD_isError(size) || size != output.size()) {
+    return Status::staticFailure("Cannot decompress the value");
+  }
+
+  value = std::move(output);
+  return Status::success();
+}
+
+} // namespace osquery
@@ -0,0 +1,78 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/numeric_monitoring/numeric_monitoring.h>
+#include <osquery/utils/mutex.h>
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/**
+ * @brief The zstd compression of the values written to a database domain.
+ *
+ * Values are compressed on their own, a value written before the domain was
+ * configured to be compressed is read as it is. Once enough values were
+ * written a dictionary is trained from them, the result lines and query
+ * results are repetitive and short values compress much better with it. The
+ * dictionary must be persisted, the values compressed with it cannot be read
+ * without it.
+ *
+ * The raw and compressed bytes written are recorded as the
+ * database.compression.<domain>.raw_bytes and .compressed_bytes metrics, and
+ * the ratio of each value as database.compression.<domain>.ratio.
+ */
+class DatabaseValueCompressor : private boost::noncopyable {
+ public:
+  DatabaseValueCompressor(const std::string& domain, int level);
+  ~DatabaseValueCompressor();
+
+  /// Check if a value read from a domain is compressed.
+  static bool isCompressed(const std::string& value);
+
+  /// Use a dictionary trained before, as it was persisted.
+  Status loadDictionary(const std::string& dictionary);
+
+  /**
+   * @brief Compress a value with the dictionary, if there is one yet.
+   *
+   * While there is no dictionary the values are also kept as samples. Once
+   * enough are kept a dictionary is trained.
+   *
+   * @param dictionary Set to a dictionary trained with this value, to persist
+   * before the compressed value is written.
+   */
+  Status compress(const std::string& value,
+                  std::string& compressed,
+                  std::string& dictionary);
+
+  /// Decompress a value, with the dictionary it was compressed with.
+  Status decompress(const std::string& compressed, std::string& value) const;
+
+ private:
+  struct PrivateData;
+  std::unique_ptr<PrivateData> d_;
+
+  /// Train a dictionary from the samples, false if it failed.
+  bool train(std::string& dictionary);
+
+ private:
+  monitoring::Metric raw_bytes_;
+  monitoring::Metric compressed_bytes_;
+  std::string ratio_path_;
+};
+
+} // namespace osquery
@@ -7,19 +7,60 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <osquery/core/flags.h>
 #include <osquery/database/database.h>
+#include <osquery/logger/logger.h>
 #include <osquery/registry/registry_factory.h>
+#include <osquery/utils/mutex.h>
 
 #include <boost/variant.hpp>
 
+#include <deque>
 #include <iostream>
 
 namespace osquery {
 
+FLAG(uint64,
+     ephemeral_database_max_bytes,
+     0,
+     "Max bytes of the in-memory database, 0 is unlimited");
+
+namespace {
+
+/// How values are removed when the database exceeds its budget.
+enum class EvictionPolicy {
+  /// Values are never removed.
+  None,
+
+  /// The oldest written values are removed first.
+  Oldest,
+};
+
+/// The domains that may be evicted, in the order they are evicted.
+const std::vector<std::string> kEvictedDomains = {kEvents, kQueryPerformance};
+
+EvictionPolicy getEvictionPolicy(const std::string& domain) {
+  // Events expire and query performance is statistics, both tolerate loss.
+  if (domain == kEvents || domain == kQueryPerformance) {
+    return EvictionPolicy::Oldest;
+  }
+  return EvictionPolicy::None;
+}
+} // namespace
+
 class EphemeralDatabasePlugin : public DatabasePlugin {
-  using DBType =
-      std::map<std::string,
-               std::map<std::string, boost::variant<int, std::string>>>;
+  /// A stored value and the sequence of the write that stored it.
+  struct Entry {
+    boost::variant<int, std::string> value;
+    uint64_t sequence{0};
+  };
+
+  using KeyMap = std::map<std::string, Entry>;
+  using DBType = std::map<std::string, KeyMap>;
+
+  /// The keys of a domain in write order, stale when the sequence differs.
+  using WriteOrder = std::deque<std::pair<std::string, uint64_t>>;
+
   template <typename T>
   Status getAny(const std::string& domain,
                 const std::string& key,
@@ -28,9 +69,16 @@ class EphemeralDatabasePlugin : public DatabasePlugin {
  private:
   void setValue(const std::string& domain,
                 const std::string& key,
-                const std::string& value);
+                boost::variant<int, std::string> value);
 
-  void setValue(const std::string& domain, const std::string& key, int value);
+  /// Remove a value, the caller holds the lock.
+  void erase(KeyMap& keys, KeyMap::iterator it);
+
+  /// Evict the oldest values of the evicted domains until within budget.
+  void evict();
+
+  /// Drop the stale keys of a domain's write order.
+  void compactOrder(const std::string& domain);
 
  public:
   /// Data retrieval method.
@@ -65,24 +113,57 @@ class EphemeralDatabasePlugin : public DatabasePlugin {
               const std::string& prefix,
               uint64_t max) const override;
 
+  /// Key and value lookup method.
+  Status scanValues(const std::string& domain,
+                    const std::string& prefix,
+                    uint64_t max,
+                    const DatabaseScanCallback& callback) const override;
+
  public:
   /// Database workflow: open and setup.
   Status setUp() override {
+    WriteLock lock(mutex_);
     DBType().swap(db_);
+    order_.clear();
+    bytes_ = 0;
     return Status(0);
   }
 
  private:
+  /// Protects the stored values, the plugin is used by many threads.
+  mutable Mutex mutex_;
+
   DBType db_;
+
+  /// The write order of the domains that may be evicted.
+  std::map<std::string, WriteOrder> order_;
+
+  /// The bytes of every stored key and value.
+  size_t bytes_{0};
+
+  /// The sequence of the last write.
+  uint64_t sequence_{0};
 };
 
 /// Backing-storage provider for osquery internal/core.
 REGISTER_INTERNAL(EphemeralDatabasePlugin, "database", "ephemeral");
 
+namespace {
+
+inline size_t entrySize(const std::string& key,
+                        const boost::variant<int, std::string>& value) {
+  if (const auto* string_value = boost::get<std::string>(&value)) {
+    return key.size() + string_value->size();
+  }
+  return key.size() + sizeof(int);
+}
+} // namespace
+
 template <typename T>
 Status EphemeralDatabasePlugin::getAny(const std::string& domain,
                                        const std::string& key,
                                        T& value) const {
+  ReadLock lock(mutex_);
   auto domainIterator = db_.find(domain);
   if (domainIterator == db_.end()) {
     return Status(1, "Domain " + domain + " does not exist");
@@ -94,7 +175,7 @@ Status EphemeralDatabasePlugin::getAny(const std::string& domain,
   }
 
   try {
-    value = boost::get<T>(keyIterator->second);
+    value = boost::get<T>(keyIterator->second.value);
   } catch (const boost::bad_get& e) {
     return Status(1,
                   "Type error getting string value for " + key + " in domain " +
@@ -114,34 +195,95 @@ Status EphemeralDatabasePlugin::get(const std::string& domain,
   return this->getAny(domain, key, value);
 }
 
-void EphemeralDatabasePlugin::setValue(const std::string& domain,
-                                       const std::string& key,
-                                       const std::string& value) {
-  db_[domain][key] = value;
+void EphemeralDatabasePlugin::setValue(
+    const std::string& domain,
+    const std::string& key,
+    boost::variant<int, std::string> value) {
+  auto size = entrySize(key, value);
+  auto& entry = db_[domain][key];
+  if (entry.sequence != 0) {
+    bytes_ -= entrySize(key, entry.value);
+  }
+
+  entry.value = std::move(value);
+  entry.sequence = ++sequence_;
+  bytes_ += size;
+
+  if (FLAGS_ephemeral_database_max_bytes > 0 &&
+      getEvictionPolicy(domain) == EvictionPolicy::Oldest) {
+    auto& order = order_[domain];
+    order.emplace_back(key, entry.sequence);
+    if (order.size() > 2 * db_[domain].size() + 1024) {
+      compactOrder(domain);
+    }
+  }
 }
 
-void EphemeralDatabasePlugin::setValue(const std::string& domain,
-                                       const std::string& key,
-                                       int value) {
-  db_[domain][key] = value;
+void EphemeralDatabasePlugin::erase(KeyMap& keys, KeyMap::iterator it) {
+  bytes_ -= entrySize(it->first, it->second.value);
+  keys.erase(it);
+}
+
+void EphemeralDatabasePlugin::evict() {
+  auto budget = static_cast<size_t>(FLAGS_ephemeral_database_max_bytes);
+  if (budget == 0 || bytes_ <= budget) {
+    return;
+  }
+
+  size_t evicted = 0;
+  for (const auto& domain : kEvictedDomains) {
+    auto& order = order_[domain];
+    auto& keys = db_[domain];
+    while (bytes_ > budget && !order.empty()) {
+      auto it = keys.find(order.front().first);
+      if (it != keys.end() && it->second.sequence == order.front().second) {
+        erase(keys, it);
+        evicted++;
+      }
+      order.pop_front();
+    }
+  }
+
+  if (evicted > 0) {
+    VLOG(1) << "Evicted " << evicted << " values from the in-memory database";
+  }
+}
+
+void EphemeralDatabasePlugin::compactOrder(const std::string& domain) {
+  auto& order = order_[domain];
+  const auto& keys = db_[domain];
+
+  WriteOrder compacted;
+  for (auto& write : order) {
+    auto it = keys.find(write.first);
+    if (it != keys.end() && it->second.sequence == write.second) {
+      compacted.push_back(std::move(write));
+    }
+  }
+  order.swap(compacted);
 }
 
 Status EphemeralDatabasePlugin::put(const std::string& domain,
                                     const std::string& key,
                                     const std::string& value) {
+  WriteLock lock(mutex_);
   setValue(domain, key, value);
+  evict();
   return Status(0);
 }
 
 Status EphemeralDatabasePlugin::put(const std::string& domain,
                                     const std::string& key,
                                     int value) {
+  WriteLock lock(mutex_);
   setValue(domain, key, value);
+  evict();
   return Status(0);
 }
 
 Status EphemeralDatabasePlugin::putBatch(const std::string& domain,
                                          const DatabaseStringValueList& data) {
+  WriteLock lock(mutex_);
   for (const auto& p : data) {
     const auto& key = p.first;
     const auto& value = p.second;
@@ -149,12 +291,18 @@ Status EphemeralDatabasePlugin::putBatch(const std::string& domain,
     setValue(domain, key, value);
   }
 
+  evict();
   return Status::success();
 }
 
 Status EphemeralDatabasePlugin::remove(const std::string& domain,
                                        const std::string& k) {
-  db_[domain].erase(k);
+  WriteLock lock(mutex_);
+  auto& keys = db_[domain];
+  auto it = keys.find(k);
+  if (it != keys.end()) {
+    erase(keys, it);
+  }
   return Status(0);
 }
 
@@ -162,18 +310,14 @@ Status EphemeralDatabasePlugin::removeRange(const std::string& domain,
                                             const std::string& low,
                                             const std::string& high) {
   if (low > high) {
-    return Status::failure("Invalid range: low > high");
-  }
-
-  std::vector<std::string> keys;
-  for (const auto& it : db_[domain]) {
-    if (it.first >= low && it.first <= high) {
-      keys.push_back(it.first);
-    }
+    return Status::staticFailure("Invalid range: low > high");
   }
 
-  for (const auto& key : keys) {
-    db_[domain].erase(key);
+  WriteLock lock(mutex_);
+  auto& keys = db_[domain];
+  auto it = keys.lower_bound(low);
+  while (it != keys.end() && it->first <= high) {
+    erase(keys, it++);
   }
   return Status(0);
 }
@@ -182,6 +326,7 @@ Status EphemeralDatabasePlugin::scan(const std::string& domain,
                                      std::vector<std::string>& results,
                                      const std::string& prefix,
                                      uint64_t max) const {
+  ReadLock lock(mutex_);
   if (db_.count(domain) == 0) {
     return Status(0);
   }
@@ -199,4 +344,36 @@ Status EphemeralDatabasePlugin::scan(const std::string& domain,
   }
   return Status(0);
 }
+
+Status EphemeralDatabasePlugin::scanValues(
+    const std::string& domain,
+    const std::string& prefix,
+    uint64_t max,
+    const DatabaseScanCallback& callback) const {
+  ReadLock lock(mutex_);
+  auto domain_it = db_.find(domain);
+  if (domain_it == db_.end()) {
+    return Status(0);
+  }
+
+  uint64_t count = 0;
+  const auto& keys = domain_it->second;
+  for (auto it = keys.lower_bound(prefix); it != keys.end(); ++it) {
+    if (it->first.compare(0, prefix.size(), prefix) != 0) {
+      break;
+    }
+
+    std::string value;
+    const auto& stored = it->second.value;
+    if (const auto* string_value = boost::get<std::string>(&stored)) {
+      value = *string_value;
+    } else {
+      value = std::to_string(boost::get<int>(stored));
+    }
+    if (!callback(it->first, value) || (max > 0 && ++count >= max)) {
+      break;
+    }
+  }
+  return Status(0);
+}
 } // namespace osquery
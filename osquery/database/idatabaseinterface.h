@@ -10,6 +10,7 @@
 
 #pragma once
 
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
@@ -20,6 +21,11 @@ namespace osquery {
 using DatabaseStringValueList =
     std::vector<std::pair<std::string, std::string>>;
 
+/// Receives each scanned key and value, the value may be moved from.
+/// Returning false stops the scan.
+using DatabaseScanCallback =
+    std::function<bool(const std::string& key, std::string& value)>;
+
 class IDatabaseInterface {
  public:
   IDatabaseInterface() = default;
@@ -60,6 +66,17 @@ class IDatabaseInterface {
                                   const std::string& prefix,
                                   size_t max) const = 0;
 
+  /**
+   * @brief Read the keys matching a prefix and their values, in key order.
+   *
+   * At most max keys are read, 0 means no limit. The default scans the keys
+   * then gets each value.
+   */
+  virtual Status scanDatabaseValues(const std::string& domain,
+                                    const std::string& prefix,
+                                    size_t max,
+                                    const DatabaseScanCallback& callback) const;
+
   IDatabaseInterface(const IDatabaseInterface&) = delete;
   IDatabaseInterface& operator=(const IDatabaseInterface&) = delete;
 };
@@ -8,9 +8,14 @@
  */
 
 #include <osquery/core/flags.h>
+#include <osquery/core/sql/binary_rows.h>
+#include <osquery/core/sql/columnar_results.h>
+#include <osquery/core/sql/query_state.h>
 #include <osquery/core/system.h>
 #include <osquery/database/database.h>
+#include <osquery/database/database_compression.h>
 #include <osquery/registry/registry.h>
+#include <osquery/registry/registry_factory.h>
 
 #include <osquery/utils/json/json.h>
 
@@ -22,6 +27,12 @@ namespace rj = rapidjson;
 
 namespace osquery {
 
+DECLARE_bool(database_write_behind);
+DECLARE_uint64(database_write_behind_batch);
+DECLARE_uint64(database_write_behind_ms);
+DECLARE_string(database_compressed_domains);
+DECLARE_uint64(ephemeral_database_max_bytes);
+
 class DatabaseTests : public testing::Test {
  public:
   void SetUp() override {
@@ -161,6 +172,169 @@ TEST_F(DatabaseTests, test_scan_values) {
   EXPECT_EQ(keys.size(), 3U);
 }
 
+TEST_F(DatabaseTests, test_scan_values_prefix) {
+  setDatabaseValue(kLogs, "scan_a", "1");
+  setDatabaseValue(kLogs, "scan_b", "2");
+  setDatabaseValue(kLogs, "scan_c", "3");
+  setDatabaseValue(kLogs, "scanz", "4");
+
+  std::vector<std::pair<std::string, std::string>> values;
+  auto collect = [&values](const std::string& key, std::string& value) {
+    values.emplace_back(key, std::move(value));
+    return true;
+  };
+
+  auto s = scanDatabaseValues(kLogs, "scan_", 0, collect);
+  EXPECT_TRUE(s.ok());
+  ASSERT_EQ(values.size(), 3U);
+  EXPECT_EQ(values[0].first, "scan_a");
+  EXPECT_EQ(values[0].second, "1");
+  EXPECT_EQ(values[2].first, "scan_c");
+  EXPECT_EQ(values[2].second, "3");
+
+  // The max limits the number of keys read.
+  values.clear();
+  s = scanDatabaseValues(kLogs, "scan_", 2, collect);
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(values.size(), 2U);
+
+  // Returning false stops the scan.
+  size_t calls = 0;
+  s = scanDatabaseValues(
+      kLogs, "scan_", 0, [&calls](const std::string&, std::string&) {
+        return ++calls < 2;
+      });
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(calls, 2U);
+}
+
+TEST_F(DatabaseTests, test_write_behind) {
+  EXPECT_EQ(getDatabaseDurability(kEvents), DatabaseDurability::Deferred);
+  EXPECT_EQ(getDatabaseDurability(kFileHashes), DatabaseDurability::Deferred);
+  EXPECT_EQ(getDatabaseDurability(kCodeSignatures),
+            DatabaseDurability::Deferred);
+  EXPECT_EQ(getDatabaseDurability(kPersistentSettings),
+            DatabaseDurability::Sync);
+
+  auto plugin = std::dynamic_pointer_cast<DatabasePlugin>(
+      RegistryFactory::get().plugin("database", "ephemeral"));
+  ASSERT_NE(plugin, nullptr);
+
+  FLAGS_database_write_behind = true;
+  FLAGS_database_write_behind_batch = 3;
+  FLAGS_database_write_behind_ms = 60 * 1000;
+
+  // Deferred writes are queued, the other domains are written immediately.
+  setDatabaseValue(kEvents, "write_behind_1", "1");
+  setDatabaseValue(kPersistentSettings, "write_behind", "1");
+  std::string value;
+  EXPECT_FALSE(plugin->get(kEvents, "write_behind_1", value).ok());
+  EXPECT_TRUE(plugin->get(kPersistentSettings, "write_behind", value).ok());
+
+  // Reading a domain commits its queued writes first.
+  EXPECT_TRUE(getDatabaseValue(kEvents, "write_behind_1", value).ok());
+  EXPECT_EQ(value, "1");
+
+  // A full batch is committed by the writer that filled it.
+  setDatabaseValue(kEvents, "write_behind_2", "2");
+  setDatabaseBatch(kEvents, {{"write_behind_3", "3"}, {"write_behind_4", "4"}});
+  EXPECT_TRUE(plugin->get(kEvents, "write_behind_4", value).ok());
+
+  setDatabaseValue(kEvents, "write_behind_5", "5");
+  EXPECT_FALSE(plugin->get(kEvents, "write_behind_5", value).ok());
+  EXPECT_TRUE(flushDatabase().ok());
+  EXPECT_TRUE(plugin->get(kEvents, "write_behind_5", value).ok());
+
+  FLAGS_database_write_behind = false;
+}
+
+TEST_F(DatabaseTests, test_compressed_domains) {
+  auto plugin = std::dynamic_pointer_cast<DatabasePlugin>(
+      RegistryFactory::get().plugin("database", "ephemeral"));
+  ASSERT_NE(plugin, nullptr);
+
+  FLAGS_database_compressed_domains = "carves,logs";
+
+  // Enough values are written to train a dictionary.
+  DatabaseStringValueList batch;
+  for (size_t i = 0; i < 200; i++) {
+    batch.emplace_back("compressed_" + std::to_string(i),
+                       "{\"name\":\"pack_compressed_query\",\"hostIdentifier\":"
+                       "\"host\",\"columns\":{\"pid\":\"" +
+                           std::to_string(i) + "\"}}");
+  }
+  EXPECT_TRUE(setDatabaseBatch(kLogs, batch).ok());
+  EXPECT_TRUE(setDatabaseValue(kLogs, "compressed_last", batch[0].second).ok());
+  EXPECT_TRUE(setDatabaseValue(kLogs, "compressed_short", "1").ok());
+
+  // The values are compressed in the backing store, except the short ones.
+  std::string value;
+  EXPECT_TRUE(plugin->get(kLogs, "compressed_last", value).ok());
+  EXPECT_TRUE(DatabaseValueCompressor::isCompressed(value));
+  EXPECT_TRUE(plugin->get(kLogs, "compressed_short", value).ok());
+  EXPECT_EQ(value, "1");
+
+  EXPECT_TRUE(getDatabaseValue(kLogs, "compressed_last", value).ok());
+  EXPECT_EQ(value, batch[0].second);
+
+  size_t scanned = 0;
+  auto s = scanDatabaseValues(
+      kLogs,
+      "compressed_",
+      0,
+      [&batch, &scanned](const std::string& key, std::string& scanned_value) {
+        auto index = key.substr(std::string("compressed_").size());
+        if (index != "last" && index != "short") {
+          EXPECT_EQ(scanned_value, batch[std::stoul(index)].second);
+          scanned++;
+        }
+        return true;
+      });
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(scanned, batch.size());
+
+  // The values stay readable once the domain is not compressed.
+  FLAGS_database_compressed_domains = "";
+  EXPECT_TRUE(getDatabaseValue(kLogs, "compressed_199", value).ok());
+  EXPECT_EQ(value, batch[199].second);
+  EXPECT_TRUE(setDatabaseValue(kLogs, "compressed_last", batch[1].second).ok());
+  EXPECT_TRUE(plugin->get(kLogs, "compressed_last", value).ok());
+  EXPECT_EQ(value, batch[1].second);
+}
+
+TEST_F(DatabaseTests, test_ephemeral_eviction) {
+  auto plugin = std::dynamic_pointer_cast<DatabasePlugin>(
+      RegistryFactory::get().plugin("database", "ephemeral"));
+  ASSERT_NE(plugin, nullptr);
+
+  FLAGS_ephemeral_database_max_bytes = 64;
+  plugin->setUp();
+
+  // The settings are never evicted, they use 8 bytes of the budget.
+  plugin->put(kPersistentSettings, "setting", "1");
+
+  // Each event uses 16 bytes, the oldest are evicted first.
+  for (size_t i = 0; i < 5; i++) {
+    plugin->put(kEvents, "event_" + std::to_string(i), "abcdefghi");
+  }
+
+  std::string value;
+  EXPECT_FALSE(plugin->get(kEvents, "event_0", value).ok());
+  EXPECT_FALSE(plugin->get(kEvents, "event_1", value).ok());
+  EXPECT_TRUE(plugin->get(kEvents, "event_2", value).ok());
+  EXPECT_TRUE(plugin->get(kEvents, "event_4", value).ok());
+  EXPECT_TRUE(plugin->get(kPersistentSettings, "setting", value).ok());
+
+  // An overwritten event is as new as its last write.
+  plugin->put(kEvents, "event_2", "abcdefghi");
+  plugin->put(kEvents, "event_5", "abcdefghi");
+  EXPECT_FALSE(plugin->get(kEvents, "event_3", value).ok());
+  EXPECT_TRUE(plugin->get(kEvents, "event_2", value).ok());
+
+  FLAGS_ephemeral_database_max_bytes = 0;
+  plugin->setUp();
+}
+
 TEST_F(DatabaseTests, test_delete_values_str) {
   setDatabaseValue(kLogs, "k", "0");
 
@@ -294,4 +468,122 @@ TEST_F(DatabaseTests, test_migration_v1v2) {
   EXPECT_EQ(value, "event_data");
 }
 
+TEST_F(DatabaseTests, test_migration_v2v3) {
+  /* Testing migration from 2 to 3 */
+  Status status = setDatabaseValue(kPersistentSettings, kDbVersionKey, "2");
+  ASSERT_TRUE(status.ok());
+
+  std::string json = R"([{"name":"osquery","pid":1}])";
+  status = setDatabaseValue(kQueries, "pack_test_results", json);
+  ASSERT_TRUE(status.ok());
+  status = setDatabaseValue(kQueries, "pack_test_resultsepoch", "10");
+  ASSERT_TRUE(status.ok());
+  status = setDatabaseValue(kQueries, "cache.processes", json);
+  ASSERT_TRUE(status.ok());
+
+  status = upgradeDatabase(3);
+  ASSERT_TRUE(status.ok());
+
+  std::string value;
+  status = getDatabaseValue(kPersistentSettings, kDbVersionKey, value);
+  EXPECT_EQ(value, "3");
+
+  // Scheduled query results are now columnar encoded.
+  getDatabaseValue(kQueries, "pack_test_results", value);
+  ASSERT_TRUE(ColumnarResults::isEncoded(value));
+  ColumnarResults results;
+  ASSERT_TRUE(ColumnarResults::decode(value, results).ok());
+  ASSERT_EQ(results.rows(), 1U);
+  EXPECT_EQ(results.row(0).at("name"), RowDataTyped(std::string("osquery")));
+  EXPECT_EQ(results.row(0).at("pid"), RowDataTyped(1LL));
+
+  // Other values are not changed.
+  getDatabaseValue(kQueries, "pack_test_resultsepoch", value);
+  EXPECT_EQ(value, "10");
+  getDatabaseValue(kQueries, "cache.processes", value);
+  EXPECT_EQ(value, json);
+}
+
+TEST_F(DatabaseTests, test_migration_v3v4) {
+  /* Testing migration from 3 to 4 */
+  Status status = setDatabaseValue(kPersistentSettings, kDbVersionKey, "3");
+  ASSERT_TRUE(status.ok());
+
+  std::string json = R"({"eid":"0000000001","pid":"5","time":"10"})";
+  const std::string key = "data.auditeventpublisher.process_events.0000000001";
+  status = setDatabaseValue(kEvents, key, json);
+  ASSERT_TRUE(status.ok());
+  status = setDatabaseValue(kEvents, "optimize.pack_test", "10");
+  ASSERT_TRUE(status.ok());
+
+  status = upgradeDatabase(4);
+  ASSERT_TRUE(status.ok());
+
+  std::string value;
+  status = getDatabaseValue(kPersistentSettings, kDbVersionKey, value);
+  EXPECT_EQ(value, "4");
+
+  // Event rows are now binary encoded using the subscriber's dictionary.
+  std::string serialized;
+  status = getDatabaseValue(
+      kEvents,
+      kEventsDictionaryPrefix + "auditeventpublisher.process_events",
+      serialized);
+  ASSERT_TRUE(status.ok());
+  BinaryRowDictionary dictionary;
+  ASSERT_TRUE(dictionary.deserialize(serialized).ok());
+
+  getDatabaseValue(kEvents, key, value);
+  ASSERT_TRUE(BinaryRowDictionary::isEncoded(value));
+  Row row;
+  ASSERT_TRUE(dictionary.decode(value, row).ok());
+  EXPECT_EQ(row.at("eid"), "0000000001");
+  EXPECT_EQ(row.at("pid"), "5");
+
+  // Other values are not changed.
+  getDatabaseValue(kEvents, "optimize.pack_test", value);
+  EXPECT_EQ(value, "10");
+}
+
+TEST_F(DatabaseTests, test_migration_v4v5) {
+  /* Testing migration from 4 to 5 */
+  Status status = setDatabaseValue(kPersistentSettings, kDbVersionKey, "4");
+  ASSERT_TRUE(status.ok());
+
+  std::string results;
+  ColumnarResults::encode(QueryDataTyped{}, results);
+  setDatabaseValue(kQueries, "pack_test_state", results);
+  setDatabaseValue(kQueries, "pack_test_stateepoch", "10");
+  setDatabaseValue(kQueries, "pack_test_statecounter", "3");
+  setDatabaseValue(kQueries, "query.pack_test_state", "SELECT 1, 2");
+  setDatabaseValue(kQueries, "cache.processes", results);
+
+  status = upgradeDatabase(5);
+  ASSERT_TRUE(status.ok());
+
+  std::string value;
+  status = getDatabaseValue(kPersistentSettings, kDbVersionKey, value);
+  EXPECT_EQ(value, "5");
+
+  // The epoch, counter and query text are now stored in one state.
+  ASSERT_TRUE(getDatabaseValue(kQueries, "pack_test_statestate", value).ok());
+  QueryState state;
+  ASSERT_TRUE(QueryState::decode(value, state).ok());
+  EXPECT_EQ(state.epoch, 10U);
+  EXPECT_EQ(state.counter, 3U);
+  EXPECT_TRUE(state.has_counter);
+  EXPECT_FALSE(state.has_fingerprints);
+  EXPECT_EQ(state.query, "SELECT 1, 2");
+
+  EXPECT_FALSE(getDatabaseValue(kQueries, "pack_test_stateepoch", value).ok());
+  EXPECT_FALSE(
+      getDatabaseValue(kQueries, "pack_test_statecounter", value).ok());
+  EXPECT_FALSE(
+      getDatabaseValue(kQueries, "query.pack_test_state", value).ok());
+
+  // Other values are not changed.
+  getDatabaseValue(kQueries, "pack_test_state", value);
+  EXPECT_EQ(value, results);
+}
+
 } // namespace osquery
@@ -9,9 +9,14 @@
 
 #include <osquery/database/database.h>
 
+#include <osquery/core/flags.h>
 #include <osquery/core/query.h>
+#include <osquery/core/sql/binary_rows.h>
+#include <osquery/core/sql/columnar_results.h>
 #include <osquery/core/sql/diff_results.h>
+#include <osquery/core/sql/flat_query_data.h>
 #include <osquery/core/sql/query_data.h>
+#include <osquery/sql/dynamic_table_row.h>
 #include <osquery/sql/tests/sql_test_utils.h>
 
 #include <gtest/gtest.h>
@@ -20,6 +25,9 @@
 
 namespace osquery {
 
+DECLARE_bool(decorations_top_level);
+DECLARE_bool(logger_numerics);
+
 class ResultsTests : public testing::Test {};
 
 TEST_F(ResultsTests, test_simple_diff) {
@@ -90,6 +98,186 @@ TEST_F(ResultsTests, test_deserialize_query_data_json) {
   EXPECT_EQ(output, resultSet);
 }
 
+TEST_F(ResultsTests, test_columnar_results) {
+  QueryDataTyped q;
+  RowTyped r1;
+  r1["name"] = "osquery";
+  r1["pid"] = -128LL;
+  r1["load"] = 0.25;
+  q.push_back(r1);
+
+  // Rows may not share every column.
+  RowTyped r2;
+  r2["name"] = std::string("");
+  r2["uid"] = 9223372036854775807LL;
+  q.push_back(r2);
+  q.push_back(RowTyped());
+
+  std::string encoded;
+  ColumnarResults::encode(q, encoded);
+  EXPECT_TRUE(ColumnarResults::isEncoded(encoded));
+  EXPECT_FALSE(ColumnarResults::isEncoded("[]"));
+
+  ColumnarResults results;
+  auto s = ColumnarResults::decode(encoded, results);
+  ASSERT_TRUE(s.ok());
+  EXPECT_EQ(results.rows(), 3U);
+  EXPECT_EQ(results.columns(), ColumnNames({"load", "name", "pid", "uid"}));
+  EXPECT_EQ(results.value(1, 0), nullptr);
+  ASSERT_NE(results.value(0, 2), nullptr);
+  EXPECT_EQ(*results.value(0, 2), RowDataTyped(-128LL));
+
+  for (size_t i = 0; i < q.size(); ++i) {
+    EXPECT_EQ(results.row(i), q[i]);
+    EXPECT_EQ(results.fingerprint(i), fingerprintRow(q[i]));
+  }
+
+  // Stored results may be columnar or legacy JSON.
+  QueryDataTyped output;
+  EXPECT_TRUE(deserializeStoredQueryData(encoded, output).ok());
+  EXPECT_EQ(output, q);
+
+  auto json = getSerializedQueryDataJSON();
+  output.clear();
+  EXPECT_TRUE(deserializeStoredQueryData(json.first, output).ok());
+  EXPECT_EQ(output, json.second);
+
+  // A truncated value must not decode.
+  encoded.resize(encoded.size() - 1);
+  EXPECT_FALSE(ColumnarResults::decode(encoded, results).ok());
+}
+
+TEST_F(ResultsTests, test_binary_rows) {
+  BinaryRowDictionary dictionary;
+  Row r1 = {{"pid", "-42"}, {"path", "/bin/sh"}, {"eid", "0000000001"}};
+  Row r2 = {{"pid", "0"}, {"uid", "-0"}, {"size", "9223372036854775807"}};
+
+  std::string encoded1;
+  dictionary.encode(r1, encoded1);
+  EXPECT_TRUE(BinaryRowDictionary::isEncoded(encoded1));
+  EXPECT_FALSE(BinaryRowDictionary::isEncoded(R"({"pid":"1"})"));
+  EXPECT_EQ(dictionary.grown(), 3U);
+
+  // Only new columns grow the dictionary.
+  std::string encoded2;
+  dictionary.encode(r2, encoded2);
+  EXPECT_EQ(dictionary.grown(), 5U);
+  EXPECT_EQ(dictionary.columns().size(), 5U);
+
+  // Values that are not canonical integers decode to the same strings.
+  Row output;
+  ASSERT_TRUE(dictionary.decode(encoded1, output).ok());
+  EXPECT_EQ(output, r1);
+  ASSERT_TRUE(dictionary.decode(encoded2, output).ok());
+  EXPECT_EQ(output, r2);
+
+  // Values of other columns may be skipped.
+  ASSERT_TRUE(dictionary.decode(encoded1, {"pid", "uid"}, output).ok());
+  EXPECT_EQ(output, Row({{"pid", "-42"}}));
+
+  // A persisted dictionary decodes rows encoded earlier.
+  std::string serialized;
+  dictionary.serialize(serialized);
+  BinaryRowDictionary restored;
+  ASSERT_TRUE(restored.deserialize(serialized).ok());
+  EXPECT_EQ(restored.grown(), 0U);
+  ASSERT_TRUE(restored.decode(encoded2, output).ok());
+  EXPECT_EQ(output, r2);
+
+  // Rows referring to unknown columns or truncated rows must not decode.
+  EXPECT_FALSE(BinaryRowDictionary().decode(encoded1, output).ok());
+  encoded1.resize(encoded1.size() - 1);
+  EXPECT_FALSE(dictionary.decode(encoded1, output).ok());
+}
+
+TEST_F(ResultsTests, test_table_rows_binary) {
+  TableRows rows;
+  rows.push_back(make_table_row({{"pid", "1"}, {"path", "/bin/sh"}}));
+  rows.push_back(make_table_row({{"pid", "-2"}, {"name", ""}}));
+
+  std::string encoded;
+  serializeTableRowsBinary(rows, encoded);
+
+  TableRows output;
+  ASSERT_TRUE(deserializeTableRowsBinary(encoded, output).ok());
+  ASSERT_EQ(output.size(), 2U);
+  EXPECT_EQ(static_cast<Row>(*output[0]), static_cast<Row>(*rows[0]));
+  EXPECT_EQ(static_cast<Row>(*output[1]), static_cast<Row>(*rows[1]));
+
+  // Truncated or JSON values must not decode.
+  output.clear();
+  encoded.resize(encoded.size() - 1);
+  EXPECT_FALSE(deserializeTableRowsBinary(encoded, output).ok());
+  output.clear();
+  EXPECT_FALSE(deserializeTableRowsBinary(R"([{"pid":"1"}])", output).ok());
+}
+
+TEST_F(ResultsTests, test_flat_query_data) {
+  // A query may return the same column name twice, the last value is used.
+  FlatQueryData flat(ColumnNames({"pid", "name", "load", "name"}));
+  EXPECT_EQ(flat.width(), 4U);
+  EXPECT_EQ(flat.schema()->order, std::vector<size_t>({2, 3, 0}));
+
+  auto* row = flat.addRow();
+  row[0] = 1LL;
+  row[1] = "ignored";
+  row[2] = 0.5;
+  row[3] = "osquery";
+  row = flat.addRow();
+  row[0] = -2LL;
+  row[1] = "ignored";
+  row[2] = 1.5;
+  row[3] = "";
+  EXPECT_EQ(flat.rows(), 2U);
+
+  QueryDataTyped expected;
+  RowTyped r1;
+  r1["pid"] = 1LL;
+  r1["name"] = "osquery";
+  r1["load"] = 0.5;
+  expected.push_back(r1);
+  RowTyped r2;
+  r2["pid"] = -2LL;
+  r2["name"] = std::string("");
+  r2["load"] = 1.5;
+  expected.push_back(r2);
+
+  for (size_t i = 0; i < flat.rows(); ++i) {
+    EXPECT_EQ(flat.row(i), expected[i]);
+    EXPECT_EQ(flat.fingerprint(i), fingerprintRow(expected[i]));
+  }
+  EXPECT_EQ(fingerprintQueryData(flat), fingerprintQueryData(expected));
+
+  // Serializers produce the same output as for the equivalent rows.
+  for (bool numeric : {true, false}) {
+    std::string flat_json;
+    std::string typed_json;
+    EXPECT_TRUE(serializeQueryDataJSON(flat, flat_json, numeric).ok());
+    EXPECT_TRUE(serializeQueryDataJSON(expected, typed_json, numeric).ok());
+    EXPECT_EQ(flat_json, typed_json);
+  }
+
+  std::string flat_encoded;
+  std::string typed_encoded;
+  ColumnarResults::encode(flat, flat_encoded);
+  ColumnarResults::encode(expected, typed_encoded);
+  EXPECT_EQ(flat_encoded, typed_encoded);
+
+  // Only the added rows are materialized by the fingerprint differential.
+  std::vector<size_t> removed;
+  auto dr = diff(RowFingerprints({fingerprintRow(r2), 7}),
+                 fingerprintQueryData(flat),
+                 flat,
+                 removed);
+  EXPECT_EQ(dr.added, QueryDataTyped({r1}));
+  EXPECT_EQ(removed, std::vector<size_t>({1}));
+
+  QueryDataTyped output;
+  flat.moveToQueryData(output);
+  EXPECT_EQ(output, expected);
+  EXPECT_TRUE(flat.empty());
+}
+
 TEST_F(ResultsTests, test_serialize_diff_results) {
   auto results = getSerializedDiffResults();
   auto doc = JSON::newObject();
@@ -126,6 +314,102 @@ TEST_F(ResultsTests, test_serialize_query_log_item_json) {
   EXPECT_EQ(results.first, json);
 }
 
+TEST_F(ResultsTests, test_serialize_query_log_item_as_events_json) {
+  auto item = getSerializedQueryLogItem().second;
+  item.decorations["host_uuid"] = "uuid";
+
+  // The event strings share their fields, they must match each event.
+  auto doc = JSON::newArray();
+  ASSERT_TRUE(serializeQueryLogItemAsEvents(item, doc).ok());
+  std::vector<std::string> events;
+  ASSERT_TRUE(serializeQueryLogItemAsEventsJSON(item, events).ok());
+  ASSERT_EQ(events.size(), doc.doc().Size());
+  ASSERT_EQ(events.size(), 4U);
+
+  for (size_t i = 0; i < events.size(); ++i) {
+    rapidjson::StringBuffer sb;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(sb);
+    doc.doc()[static_cast<rapidjson::SizeType>(i)].Accept(writer);
+    EXPECT_EQ(events[i], sb.GetString());
+  }
+
+  item.results = DiffResults();
+  events.clear();
+  ASSERT_TRUE(serializeQueryLogItemAsEventsJSON(item, events).ok());
+  EXPECT_TRUE(events.empty());
+}
+
+TEST_F(ResultsTests, test_query_log_item_writer_matches_document) {
+  auto item = getSerializedQueryLogItem().second;
+  item.results.added.push_back({{"int", 3LL}, {"real", 1.5}, {"text", "a"}});
+  item.decorations["name"] = "decorated";
+  item.decorations["host_uuid"] = "uuid";
+
+  auto numerics = FLAGS_logger_numerics;
+  auto top_level = FLAGS_decorations_top_level;
+  for (auto snapshot : {false, true}) {
+    for (auto flags : {0, 1, 2, 3}) {
+      FLAGS_logger_numerics = (flags & 1) != 0;
+      FLAGS_decorations_top_level = (flags & 2) != 0;
+      item.isSnapshot = snapshot;
+      item.snapshot_results = item.results.added;
+
+      // The streamed string must equal the document serialization.
+      auto doc = JSON::newObject();
+      ASSERT_TRUE(serializeQueryLogItem(item, doc).ok());
+      std::string expected;
+      doc.toString(expected);
+
+      std::string json;
+      ASSERT_TRUE(serializeQueryLogItemJSON(item, json).ok());
+      EXPECT_EQ(expected, json);
+    }
+  }
+  FLAGS_logger_numerics = numerics;
+  FLAGS_decorations_top_level = top_level;
+}
+
+TEST_F(ResultsTests, test_deserialize_rows_json_matches_document) {
+  std::string json =
+      "[{\"a\":\"1\",\"b\":2,\"c\":2.5,\"d\":true,\"e\":null,"
+      "\"f\":{\"g\":\"h\"},\"i\":[1,{\"j\":2}],\"k\":18446744073709551615,"
+      "\"\":\"empty\",\"a\":\"last\"},{}]";
+
+  // The decoded rows must equal those decoded from a document.
+  rapidjson::Document doc;
+  ASSERT_FALSE(doc.Parse(json.c_str()).HasParseError());
+  QueryDataTyped expected_typed;
+  ASSERT_TRUE(deserializeQueryData(doc, expected_typed).ok());
+  QueryData expected;
+  ASSERT_TRUE(deserializeQueryData(doc, expected).ok());
+
+  QueryDataTyped typed;
+  ASSERT_TRUE(deserializeQueryDataJSON(json, typed).ok());
+  EXPECT_EQ(expected_typed, typed);
+  ASSERT_EQ(typed.size(), 2U);
+  EXPECT_EQ(typed[0].size(), 3U);
+
+  QueryData rows;
+  ASSERT_TRUE(deserializeQueryDataJSON(json, rows).ok());
+  EXPECT_EQ(expected, rows);
+
+  QueryDataSet set;
+  ASSERT_TRUE(deserializeQueryDataJSON(json, set).ok());
+  EXPECT_EQ(set.size(), 2U);
+
+  RowTyped row;
+  ASSERT_TRUE(deserializeRowJSON("{\"a\":1,\"b\":{\"c\":2}}", row).ok());
+  EXPECT_EQ(row, RowTyped({{"a", 1LL}}));
+
+  // Inputs that are not rows fail.
+  for (const auto& input : {"{}", "[1]", "[[]]", "[{}", "\"a\""}) {
+    QueryDataTyped results;
+    EXPECT_FALSE(deserializeQueryDataJSON(input, results).ok()) << input;
+  }
+  EXPECT_FALSE(deserializeRowJSON("[]", row).ok());
+  EXPECT_FALSE(deserializeRowJSON("1", row).ok());
+}
+
 TEST_F(ResultsTests, test_adding_duplicate_rows_to_query_data) {
   RowTyped r1, r2, r3;
   r1["foo"] = "bar";
@@ -269,4 +269,19 @@ void DatabasePluginTests::testScanLimit() {
   EXPECT_EQ(s.getMessage(), "OK");
   EXPECT_EQ(keys.size(), 2U);
 }
+
+void DatabasePluginTests::testReclaim() {
+  getPlugin()->put(kQueries, "test_reclaim", "bar");
+  getPlugin()->put(kLogs, "test_reclaim", "baz");
+
+  // The database stays open and its values readable.
+  auto s = getPlugin()->reclaim();
+  EXPECT_TRUE(s.ok()) << s.getMessage();
+
+  std::string value;
+  EXPECT_TRUE(getPlugin()->get(kQueries, "test_reclaim", value).ok());
+  EXPECT_EQ(value, "bar");
+  EXPECT_TRUE(getPlugin()->get(kLogs, "test_reclaim", value).ok());
+  EXPECT_EQ(value, "baz");
+}
 } // namespace osquery
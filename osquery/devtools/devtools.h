@@ -9,6 +9,7 @@
 
 #pragma once
 
+#include <cstdio>
 #include <map>
 #include <string>
 #include <vector>
@@ -89,6 +90,46 @@ void jsonPrint(const QueryData& q);
  */
 void jsonPrettyPrint(const QueryData& q);
 
+/**
+ * @brief Print query results as they are stepped, in constant memory.
+ *
+ * JSON rows are written as they are added. A pretty table buffers a window
+ * of rows to size its columns and writes every later row immediately, a
+ * later value wider than its column overflows it. A window of 0 buffers
+ * every row, like prettyPrint.
+ */
+class ResultPrinter {
+ public:
+  enum class Format {
+    Pretty,
+    JSON,
+    JSONPretty,
+  };
+
+  ResultPrinter(Format format, size_t window, FILE* out = stdout);
+
+  /// Print a row, the columns of the first row order every table column.
+  void addRow(const Row& r, const std::vector<std::string>& columns);
+
+  /// Complete the results of the rows added so far.
+  void finish();
+
+ private:
+  /// Size the table columns and print the header and buffered rows.
+  void printWindow();
+
+ private:
+  Format format_;
+  size_t window_{0};
+  FILE* out_{nullptr};
+
+  size_t rows_{0};
+  bool header_{false};
+  std::vector<std::string> columns_;
+  std::map<std::string, size_t> lengths_;
+  QueryData buffered_;
+};
+
 /**
  * @brief Compute a map of metadata about the supplied QueryData object
  *
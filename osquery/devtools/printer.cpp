@@ -10,6 +10,8 @@
 #include <iostream>
 #include <sstream>
 
+#include <boost/algorithm/string/replace.hpp>
+
 #include <osquery/core/core.h>
 #include <osquery/core/flags.h>
 #include <osquery/devtools/devtools.h>
@@ -91,12 +93,13 @@ std::string generateRow(const Row& r,
       size = column.size() - utf8StringSize(FLAGS_nullvalue);
       out += FLAGS_nullvalue;
     } else {
+      // A value wider than its column, when streaming, overflows it.
       int buffer_size =
           static_cast<int>(lengths.at(column) - utf8StringSize(r.at(column)));
       if (buffer_size >= 0) {
         size = static_cast<size_t>(buffer_size);
-        out += r.at(column);
       }
+      out += r.at(column);
     }
     out += std::string(size + 1, ' ');
   }
@@ -159,6 +162,85 @@ void jsonPrettyPrint(const QueryData& q) {
   printf("%s\n", doc_string.c_str());
 }
 
+ResultPrinter::ResultPrinter(Format format, size_t window, FILE* out)
+    : format_(format), window_(window), out_(out) {}
+
+void ResultPrinter::addRow(const Row& r,
+                           const std::vector<std::string>& columns) {
+  if (format_ == Format::JSON || format_ == Format::JSONPretty) {
+    std::string row_string;
+    if (format_ == Format::JSON) {
+      if (!serializeRowJSON(r, row_string).ok()) {
+        return;
+      }
+    } else {
+      auto doc = JSON::newObject();
+      if (!serializeRow(r, ColumnNames{}, doc, doc.doc()).ok()) {
+        return;
+      }
+      doc.toPrettyString(row_string);
+
+      // Indent the object as an element of the results array.
+      boost::replace_all(row_string, "\n", "\n  ");
+    }
+
+    fprintf(out_, (rows_++ == 0) ? "[\n  %s" : ",\n  %s", row_string.c_str());
+    return;
+  }
+
+  if (columns_.empty()) {
+    columns_ = columns;
+  }
+
+  ++rows_;
+  if (header_) {
+    fprintf(out_, "%s", generateRow(r, lengths_, columns_).c_str());
+    return;
+  }
+
+  computeRowLengths(r, lengths_);
+  buffered_.push_back(r);
+  if (window_ > 0 && buffered_.size() >= window_) {
+    printWindow();
+  }
+}
+
+void ResultPrinter::printWindow() {
+  // Call a final compute using the column names as minimum lengths.
+  computeRowLengths(buffered_.front(), lengths_, true);
+
+  // Output a nice header wrapping the column names.
+  auto separator = generateToken(lengths_, columns_);
+  auto header = separator + generateHeader(lengths_, columns_) + separator;
+  fprintf(out_, "%s", header.c_str());
+  for (const auto& row : buffered_) {
+    fprintf(out_, "%s", generateRow(row, lengths_, columns_).c_str());
+  }
+
+  buffered_.clear();
+  buffered_.shrink_to_fit();
+  header_ = true;
+}
+
+void ResultPrinter::finish() {
+  if (format_ == Format::JSON) {
+    fprintf(out_, "%s\n]\n", (rows_ == 0) ? "[\n" : "");
+  } else if (format_ == Format::JSONPretty) {
+    fprintf(out_, "%s", (rows_ == 0) ? "[]\n" : "\n]\n");
+  } else if (rows_ > 0) {
+    if (!header_) {
+      printWindow();
+    }
+    fprintf(out_, "%s", generateToken(lengths_, columns_).c_str());
+  }
+  fflush(out_);
+
+  rows_ = 0;
+  header_ = false;
+  columns_.clear();
+  lengths_.clear();
+}
+
 void computeRowLengths(const Row& r,
                        std::map<std::string, size_t>& lengths,
                        bool use_columns) {
@@ -15,6 +15,7 @@
 
 #include <csignal>
 #include <cstdio>
+#include <memory>
 #include <sstream>
 
 #ifdef WIN32
@@ -66,6 +67,10 @@ SHELL_FLAG(bool, list, false, "Set output mode to 'list'");
 SHELL_FLAG(string, separator, "|", "Set output field separator, default '|'");
 SHELL_FLAG(bool, header, true, "Toggle column headers true/false");
 SHELL_FLAG(string, pack, "", "Run all queries in a pack");
+SHELL_FLAG(uint64,
+           pretty_window,
+           1000,
+           "Rows buffered to size the pretty columns, 0 buffers every row");
 
 /// Define short-hand shell switches.
 SHELL_FLAG(bool, L, false, "List all table names");
@@ -384,9 +389,10 @@ static char* one_input_line(FILE* in, char* zPrior, int isContinuation) {
 ** Pretty print structure
 */
 struct prettyprint_data {
-  osquery::QueryData results;
   std::vector<std::string> columns;
-  std::map<std::string, size_t> lengths;
+
+  /* Results are printed as they are stepped, see pretty_print_if_needed */
+  std::unique_ptr<osquery::ResultPrinter> printer;
 };
 
 /*
@@ -571,8 +577,17 @@ static int shell_callback(void* pArg,
                                        : std::string(azArg[i]);
       }
     }
-    osquery::computeRowLengths(r, p->prettyPrint->lengths);
-    p->prettyPrint->results.push_back(r);
+    if (p->prettyPrint->printer == nullptr) {
+      auto format = osquery::ResultPrinter::Format::Pretty;
+      if (osquery::FLAGS_json_pretty) {
+        format = osquery::ResultPrinter::Format::JSONPretty;
+      } else if (osquery::FLAGS_json) {
+        format = osquery::ResultPrinter::Format::JSON;
+      }
+      p->prettyPrint->printer = std::make_unique<osquery::ResultPrinter>(
+          format, static_cast<size_t>(osquery::FLAGS_pretty_window));
+    }
+    p->prettyPrint->printer->addRow(r, p->prettyPrint->columns);
     break;
   }
   case MODE_Line: {
@@ -799,18 +814,16 @@ static void set_table_name(struct callback_data* p, const char* zName) {
 
 static void pretty_print_if_needed(struct callback_data* pArg) {
   if ((pArg != nullptr) && pArg->mode == MODE_Pretty) {
-    if (osquery::FLAGS_json_pretty) {
-      osquery::jsonPrettyPrint(pArg->prettyPrint->results);
+    if (pArg->prettyPrint->printer != nullptr) {
+      pArg->prettyPrint->printer->finish();
+    } else if (osquery::FLAGS_json_pretty) {
+      osquery::ResultPrinter(osquery::ResultPrinter::Format::JSONPretty, 0)
+          .finish();
     } else if (osquery::FLAGS_json) {
-      osquery::jsonPrint(pArg->prettyPrint->results);
-    } else {
-      osquery::prettyPrint(pArg->prettyPrint->results,
-                           pArg->prettyPrint->columns,
-                           pArg->prettyPrint->lengths);
+      osquery::ResultPrinter(osquery::ResultPrinter::Format::JSON, 0).finish();
     }
-    pArg->prettyPrint->results.clear();
+    pArg->prettyPrint->printer.reset();
     pArg->prettyPrint->columns.clear();
-    pArg->prettyPrint->lengths.clear();
   }
 }
 
@@ -7,6 +7,8 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <cstdio>
+
 #include <gtest/gtest.h>
 
 #include <osquery/devtools/devtools.h>
@@ -93,6 +95,65 @@ TEST_F(PrinterTests, test_generate_row) {
   EXPECT_EQ(results, expected);
 }
 
+TEST_F(PrinterTests, test_result_printer_window) {
+  std::map<std::string, size_t> lengths;
+  for (const auto& row : q) {
+    computeRowLengths(row, lengths);
+  }
+  computeRowLengths(q.front(), lengths, true);
+  auto separator = generateToken(lengths, order);
+  auto expected = separator + generateHeader(lengths, order) + separator;
+  for (const auto& row : q) {
+    expected += generateRow(row, lengths, order);
+  }
+  expected += separator;
+
+  // A window holding every row prints the same table as prettyPrint.
+  auto print = [this](ResultPrinter::Format format, size_t window) {
+    auto out = std::tmpfile();
+    ResultPrinter printer(format, window, out);
+    for (const auto& row : q) {
+      printer.addRow(row, order);
+    }
+    printer.finish();
+
+    std::string output;
+    std::rewind(out);
+    char buffer[1024];
+    size_t size = 0;
+    while ((size = std::fread(buffer, 1, sizeof(buffer), out)) > 0) {
+      output.append(buffer, size);
+    }
+    std::fclose(out);
+    return output;
+  };
+  EXPECT_EQ(print(ResultPrinter::Format::Pretty, 0), expected);
+  EXPECT_EQ(print(ResultPrinter::Format::Pretty, 3), expected);
+
+  // Rows after the window keep, or overflow, the columns of the window.
+  auto streamed = print(ResultPrinter::Format::Pretty, 1);
+  EXPECT_NE(streamed.find("| John Smith | 44  | peanut butter and jelly |"),
+            std::string::npos);
+
+  auto json = print(ResultPrinter::Format::JSON, 1);
+  EXPECT_EQ(json.substr(0, 4), "[\n  ");
+  EXPECT_EQ(json.substr(json.size() - 3), "\n]\n");
+  auto doc = JSON::newArray();
+  ASSERT_TRUE(doc.fromString(json).ok());
+  EXPECT_EQ(doc.doc().Size(), 3U);
+
+  auto pretty_json = print(ResultPrinter::Format::JSONPretty, 1);
+  auto expected_doc = JSON::newArray();
+  for (const auto& row : q) {
+    auto obj = expected_doc.getObject();
+    serializeRow(row, ColumnNames{}, expected_doc, obj);
+    expected_doc.push(obj);
+  }
+  std::string expected_json;
+  expected_doc.toPrettyString(expected_json);
+  EXPECT_EQ(pretty_json, expected_json + "\n");
+}
+
 TEST_F(PrinterTests, test_unicode) {
   Row r = {{"name", "Àlex Smith"}};
   std::map<std::string, size_t> lengths;
@@ -0,0 +1,368 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+
+#include <osquery/core/flags.h>
+#include <osquery/core/query.h>
+#include <osquery/core/tables.h>
+#include <osquery/database/database.h>
+#include <osquery/dispatcher/scheduler.h>
+#include <osquery/logger/logger.h>
+#include <osquery/profiler/resource_usage.h>
+#include <osquery/registry/registry_factory.h>
+#include <osquery/sql/dynamic_table_row.h>
+#include <osquery/sql/sqlite_util.h>
+#include <osquery/sql/virtual_table.h>
+
+#include <plugins/logger/buffered.h>
+
+namespace osquery {
+
+DECLARE_bool(disable_logging);
+
+namespace {
+
+const std::string kPipelineTable = "benchmark_pipeline";
+const std::string kPipelineQuery = "benchmark_pipeline_query";
+
+/**
+ * @brief The shape of the synthetic results.
+ *
+ * Each benchmark is given the number of rows, the number of columns and the
+ * percentage of rows changing between executions: ->Args({rows, width, churn})
+ */
+struct PipelineShape {
+  size_t rows{0};
+  size_t width{0};
+  size_t churn{0};
+
+  explicit PipelineShape(const benchmark::State& state)
+      : rows(static_cast<size_t>(state.range(0))),
+        width(std::max<size_t>(1, static_cast<size_t>(state.range(1)))),
+        churn(std::min<size_t>(100, static_cast<size_t>(state.range(2)))) {}
+
+  PipelineShape() = default;
+};
+
+/// The shape and execution count of the synthetic table.
+PipelineShape gPipelineShape;
+std::atomic<size_t> gPipelineGeneration{0};
+
+/// The value of a column, churning rows change with each generation.
+std::string pipelineValue(const PipelineShape& shape,
+                          size_t row,
+                          size_t column,
+                          size_t generation) {
+  auto value = std::to_string(row) + "-" + std::to_string(column);
+  if (row % 100 < shape.churn) {
+    value += "-" + std::to_string(generation);
+  }
+  return value;
+}
+
+/// The synthetic results of one execution, see PipelineTablePlugin.
+QueryDataTyped pipelineRows(const PipelineShape& shape, size_t generation) {
+  QueryDataTyped results;
+  results.reserve(shape.rows);
+  for (size_t row = 0; row < shape.rows; ++row) {
+    RowTyped r;
+    r["id"] = static_cast<long long>(row);
+    for (size_t column = 1; column < shape.width; ++column) {
+      r["c" + std::to_string(column)] =
+          pipelineValue(shape, row, column, generation);
+    }
+    results.push_back(std::move(r));
+  }
+  return results;
+}
+
+/// A table generating the synthetic results of the current generation.
+class PipelineTablePlugin : public TablePlugin {
+ private:
+  TableColumns columns() const override {
+    TableColumns columns;
+    columns.emplace_back("id", INTEGER_TYPE, ColumnOptions::DEFAULT);
+    for (size_t column = 1; column < gPipelineShape.width; ++column) {
+      columns.emplace_back(
+          "c" + std::to_string(column), TEXT_TYPE, ColumnOptions::DEFAULT);
+    }
+    return columns;
+  }
+
+  TableRows generate(QueryContext&) override {
+    const auto& shape = gPipelineShape;
+    size_t generation = gPipelineGeneration;
+
+    TableRows results;
+    results.reserve(shape.rows);
+    for (size_t row = 0; row < shape.rows; ++row) {
+      auto r = make_table_row();
+      r["id"] = INTEGER(row);
+      for (size_t column = 1; column < shape.width; ++column) {
+        r["c" + std::to_string(column)] =
+            pipelineValue(shape, row, column, generation);
+      }
+      results.push_back(std::move(r));
+    }
+    return results;
+  }
+};
+
+/// Buffers the logged results in the database and discards them on flush.
+class PipelineLogForwarder : public BufferedLogForwarder {
+ public:
+  PipelineLogForwarder()
+      : BufferedLogForwarder("PipelineLogForwarder",
+                             "benchmark_pipeline",
+                             std::chrono::seconds(1),
+                             1000000) {}
+
+  /// Send every buffered log, as the forwarder's service would.
+  void flush() {
+    check();
+  }
+
+  size_t sent_bytes{0};
+
+ protected:
+  Status send(std::vector<std::string>& log_data,
+              const std::string& log_type) override {
+    for (const auto& line : log_data) {
+      sent_bytes += line.size();
+    }
+    return Status::success();
+  }
+};
+
+class PipelineLoggerPlugin : public LoggerPlugin {
+ public:
+  explicit PipelineLoggerPlugin(std::shared_ptr<PipelineLogForwarder> f)
+      : forwarder(std::move(f)) {}
+
+  Status logString(const std::string& s) override {
+    return forwarder->logString(s);
+  }
+
+  void init(const std::string& name,
+            const std::vector<StatusLogLine>& log) override {}
+
+  std::shared_ptr<PipelineLogForwarder> forwarder;
+};
+
+/**
+ * @brief Report the memory high-water mark of a benchmark.
+ *
+ * The resident memory is sampled after each stage, the largest sample and
+ * its growth from the start of the benchmark are reported as counters.
+ */
+class MemoryHighWater {
+ public:
+  MemoryHighWater() {
+    sample();
+    start_ = max_;
+  }
+
+  void sample() {
+    ResourceUsage usage;
+    if (getResourceUsage(usage, false).ok()) {
+      max_ = std::max(max_, usage.resident_size);
+    }
+  }
+
+  void report(benchmark::State& state) const {
+    state.counters["rss_max_mb"] =
+        static_cast<double>(max_) / (1024 * 1024);
+    state.counters["rss_growth_mb"] =
+        static_cast<double>(max_ - start_) / (1024 * 1024);
+  }
+
+ private:
+  std::uint64_t start_{0};
+  std::uint64_t max_{0};
+};
+
+/// Remove the stored results of the benchmark query.
+void clearPipelineResults() {
+  std::vector<std::string> keys;
+  scanDatabaseKeys(kQueries, keys, kPipelineQuery);
+  for (const auto& key : keys) {
+    deleteDatabaseValue(kQueries, key);
+  }
+}
+
+std::shared_ptr<PipelineLogForwarder> setUpPipeline(
+    const PipelineShape& shape) {
+  static std::shared_ptr<PipelineLogForwarder> forwarder;
+  gPipelineShape = shape;
+  gPipelineGeneration = 0;
+
+  if (forwarder == nullptr) {
+    forwarder = std::make_shared<PipelineLogForwarder>();
+    forwarder->setUp();
+
+    auto& rf = RegistryFactory::get();
+    rf.registry("logger")->add(
+        "benchmark_pipeline",
+        std::make_shared<PipelineLoggerPlugin>(forwarder));
+    rf.registry("table")->add(kPipelineTable,
+                              std::make_shared<PipelineTablePlugin>());
+  }
+
+  // The columns depend on the shape, the table is attached again.
+  auto dbc = SQLiteDBManager::get();
+  detachTableInternal(kPipelineTable, dbc);
+  attachTableInternal(kPipelineTable, dbc, false);
+
+  clearPipelineResults();
+  forwarder->sent_bytes = 0;
+  return forwarder;
+}
+
+const std::vector<std::vector<int64_t>> kPipelineShapes = {
+    {10000, 10, 1},
+    {10000, 10, 10},
+    {100000, 10, 1},
+    {100000, 10, 100},
+    {1000000, 4, 1},
+};
+
+void applyPipelineShapes(benchmark::internal::Benchmark* b) {
+  for (const auto& shape : kPipelineShapes) {
+    b->Args(shape);
+  }
+  b->ArgNames({"rows", "width", "churn"});
+  b->Unit(benchmark::kMillisecond);
+}
+} // namespace
+
+/**
+ * @brief Run a scheduled query end to end.
+ *
+ * Each iteration executes the query against the synthetic table, diffs and
+ * stores the results, logs the differential and flushes the buffered logs.
+ */
+static void SCHEDULER_pipeline(benchmark::State& state) {
+  PipelineShape shape(state);
+  auto forwarder = setUpPipeline(shape);
+
+  auto& rf = RegistryFactory::get();
+  auto active = rf.getActive("logger");
+  rf.setActive("logger", "benchmark_pipeline");
+  FLAGS_disable_logging = false;
+
+  ScheduledQuery query(
+      "benchmark", kPipelineQuery, "SELECT * FROM " + kPipelineTable + ";");
+  query.interval = 10;
+
+  // The first execution stores the initial results.
+  launchQuery(kPipelineQuery, query);
+  forwarder->flush();
+
+  MemoryHighWater memory;
+  while (state.KeepRunning()) {
+    ++gPipelineGeneration;
+    launchQuery(kPipelineQuery, query);
+    memory.sample();
+    forwarder->flush();
+    memory.sample();
+  }
+
+  memory.report(state);
+  state.SetItemsProcessed(state.iterations() * shape.rows);
+  state.SetBytesProcessed(forwarder->sent_bytes);
+
+  FLAGS_disable_logging = true;
+  rf.setActive("logger", active);
+  clearPipelineResults();
+}
+
+BENCHMARK(SCHEDULER_pipeline)->Apply(applyPipelineShapes);
+
+/// Diff and store the synthetic results, without executing or logging.
+static void SCHEDULER_pipeline_diff(benchmark::State& state) {
+  PipelineShape shape(state);
+  setUpPipeline(shape);
+
+  ScheduledQuery query(
+      "benchmark", kPipelineQuery, "SELECT * FROM " + kPipelineTable + ";");
+  Query dbQuery(kPipelineQuery, query);
+  uint64_t counter = 0;
+  {
+    DiffResults initial;
+    dbQuery.addNewResults(pipelineRows(shape, 0), 0, counter, initial);
+  }
+
+  MemoryHighWater memory;
+  size_t changes = 0;
+  size_t generation = 0;
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    auto results = pipelineRows(shape, ++generation);
+    state.ResumeTiming();
+
+    DiffResults diff_results;
+    dbQuery.addNewResults(std::move(results), 0, counter, diff_results);
+    changes += diff_results.added.size() + diff_results.removed.size();
+    memory.sample();
+  }
+
+  memory.report(state);
+  state.counters["changes"] = static_cast<double>(changes);
+  state.SetItemsProcessed(state.iterations() * shape.rows);
+  clearPipelineResults();
+}
+
+BENCHMARK(SCHEDULER_pipeline_diff)->Apply(applyPipelineShapes);
+
+/// Serialize a differential of the synthetic results as a log line.
+static void SCHEDULER_pipeline_serialize(benchmark::State& state) {
+  PipelineShape shape(state);
+
+  QueryLogItem item;
+  item.name = kPipelineQuery;
+  item.identifier = "benchmark";
+  item.calendar_time = "Mon Jan  1 00:00:00 2024 UTC";
+  item.isSnapshot = false;
+  item.results.added = pipelineRows(shape, 1);
+  item.results.removed = pipelineRows(shape, 0);
+
+  // Only the churning rows are part of a differential.
+  auto churning = [&shape](const RowTyped& r) {
+    return boost::get<long long>(r.at("id")) % 100 >=
+           static_cast<long long>(shape.churn);
+  };
+  auto& added = item.results.added;
+  auto& removed = item.results.removed;
+  added.erase(std::remove_if(added.begin(), added.end(), churning),
+              added.end());
+  removed.erase(std::remove_if(removed.begin(), removed.end(), churning),
+                removed.end());
+
+  MemoryHighWater memory;
+  size_t bytes = 0;
+  while (state.KeepRunning()) {
+    std::string json;
+    serializeQueryLogItemJSON(item, json);
+    bytes += json.size();
+    memory.sample();
+  }
+
+  memory.report(state);
+  state.SetItemsProcessed(state.iterations() * (added.size() + removed.size()));
+  state.SetBytesProcessed(bytes);
+}
+
+BENCHMARK(SCHEDULER_pipeline_serialize)->Apply(applyPipelineShapes);
+
+} // namespace osquery
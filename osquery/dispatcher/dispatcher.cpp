@@ -7,6 +7,8 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+
 #include <osquery/core/flags.h>
 #include <osquery/dispatcher/dispatcher.h>
 #include <osquery/logger/logger.h>
@@ -17,6 +19,11 @@ namespace osquery {
 /// deprecated in https://github.com/osquery/osquery/pull/1924
 HIDDEN_FLAG(int32, worker_threads, 4, "Deprecate");
 
+FLAG(uint64,
+     dispatcher_periodic_threads,
+     2,
+     "Threads shared by the periodic services (0 gives each its own thread)");
+
 void InterruptibleRunnable::interrupt() {
   // Set the service as interrupted.
   if (!interrupted_.exchange(true)) {
@@ -27,6 +34,9 @@ void InterruptibleRunnable::interrupt() {
     // Cancel the run loop's pause request.
     condition_.notify_one();
   }
+
+  // A periodic service on the shared threads is not pausing on condition_.
+  Dispatcher::wakePeriodicService(this);
 }
 
 bool InterruptibleRunnable::interrupted() {
@@ -43,12 +53,25 @@ void InterruptibleRunnable::pause(std::chrono::milliseconds milli) {
 void InternalRunnable::run() {
   run_ = true;
   setThreadName(name());
-  start();
+  {
+    ThreadClassScope thread_class(thread_class_);
+    start();
+  }
 
   // The service is complete.
   Dispatcher::removeService(this);
 }
 
+void PeriodicRunnable::start() {
+  while (!interrupted()) {
+    auto delay = tick();
+    if (interrupted()) {
+      break;
+    }
+    pause(delay);
+  }
+}
+
 Dispatcher& Dispatcher::instance() {
   static Dispatcher instance;
   return instance;
@@ -73,6 +96,16 @@ Status Dispatcher::addService(InternalRunnableRef service) {
       return Status(1, "Cannot add service, dispatcher is stopping");
     }
 
+    auto periodic = std::dynamic_pointer_cast<PeriodicRunnable>(service);
+    if (periodic != nullptr && FLAGS_dispatcher_periodic_threads > 0) {
+      VLOG(1) << "Adding new periodic service: " << service->name() << " ("
+              << service.get() << ") in process " << platformGetPid();
+      service->run_ = true;
+      self.services_.push_back(std::move(service));
+      self.addPeriodicService(std::move(periodic));
+      return Status::success();
+    }
+
     auto thread = std::make_unique<std::thread>(
         std::bind(&InternalRunnable::run, &*service));
     VLOG(1) << "Adding new service: " << service->name() << " ("
@@ -85,6 +118,91 @@ Status Dispatcher::addService(InternalRunnableRef service) {
   return Status::success();
 }
 
+void Dispatcher::addPeriodicService(std::shared_ptr<PeriodicRunnable> service) {
+  std::lock_guard<std::mutex> lock(periodic_mutex_);
+  PeriodicService periodic;
+  periodic.service = std::move(service);
+  periodic.due = std::chrono::steady_clock::now();
+  periodic_services_.push_back(std::move(periodic));
+
+  // The shared threads are started again once they ended.
+  while (periodic_threads_ < FLAGS_dispatcher_periodic_threads) {
+    ++periodic_threads_;
+    service_threads_.push_back(std::make_unique<std::thread>(
+        std::bind(&Dispatcher::runPeriodicServices, this)));
+  }
+  periodic_changed_.notify_all();
+}
+
+void Dispatcher::runPeriodicServices() {
+  setThreadName("PeriodicServices");
+  ThreadClassScope thread_class(ThreadClass::Default);
+
+  std::unique_lock<std::mutex> lock(periodic_mutex_);
+  while (!periodic_services_.empty()) {
+    // The service due first, of those not running on another thread.
+    auto next = periodic_services_.end();
+    for (auto it = periodic_services_.begin(); it != periodic_services_.end();
+         ++it) {
+      if (!it->running && (next == periodic_services_.end() ||
+                           it->due < next->due)) {
+        next = it;
+      }
+    }
+
+    if (next == periodic_services_.end()) {
+      periodic_changed_.wait(lock);
+      continue;
+    }
+    if (next->due > std::chrono::steady_clock::now()) {
+      periodic_changed_.wait_until(lock, next->due);
+      continue;
+    }
+
+    next->running = true;
+    auto service = next->service;
+    lock.unlock();
+
+    std::chrono::milliseconds delay{0};
+    bool done = service->interrupted();
+    if (!done) {
+      delay = service->tick();
+      done = service->interrupted();
+    }
+
+    lock.lock();
+    auto it = std::find_if(
+        periodic_services_.begin(),
+        periodic_services_.end(),
+        [&service](const PeriodicService& p) { return p.service == service; });
+    if (done) {
+      periodic_services_.erase(it);
+      lock.unlock();
+      removeService(service.get());
+      lock.lock();
+    } else {
+      it->running = false;
+      it->due = std::chrono::steady_clock::now() + delay;
+    }
+    periodic_changed_.notify_all();
+  }
+
+  // Without services the thread ends, the next service starts it again.
+  --periodic_threads_;
+}
+
+void Dispatcher::wakePeriodicService(const InterruptibleRunnable* service) {
+  auto& self = instance();
+  std::lock_guard<std::mutex> lock(self.periodic_mutex_);
+  for (auto& periodic : self.periodic_services_) {
+    if (static_cast<const InterruptibleRunnable*>(periodic.service.get()) ==
+        service) {
+      periodic.due = std::chrono::steady_clock::now();
+      self.periodic_changed_.notify_all();
+    }
+  }
+}
+
 void Dispatcher::resetStopping() {
   WriteLock lock(mutex_);
   stopping_ = false;
@@ -13,6 +13,7 @@
 #include <chrono>
 #include <condition_variable>
 #include <memory>
+#include <mutex>
 #include <thread>
 #include <vector>
 
@@ -21,6 +22,7 @@
 #include <boost/noncopyable.hpp>
 
 #include <osquery/core/core.h>
+#include <osquery/dispatcher/thread_placement.h>
 #include <osquery/utils/mutex.h>
 
 namespace osquery {
@@ -77,7 +79,10 @@ class InterruptibleRunnable {
 class InternalRunnable : private boost::noncopyable,
                          public InterruptibleRunnable {
  public:
-  InternalRunnable(const std::string& name) : run_(false) {
+  /// The thread of the runnable uses the placement of its thread class.
+  InternalRunnable(const std::string& name,
+                   ThreadClass thread_class = ThreadClass::Default)
+      : run_(false), thread_class_(thread_class) {
     runnable_name_ = name;
   }
   virtual ~InternalRunnable() override = default;
@@ -110,6 +115,40 @@ class InternalRunnable : private boost::noncopyable,
 
  private:
   std::atomic<bool> run_{false};
+
+  /// The class of the threads running this service.
+  ThreadClass thread_class_{ThreadClass::Default};
+
+ private:
+  friend class Dispatcher;
+};
+
+/**
+ * @brief A service doing periodic work, such as flushing or polling.
+ *
+ * Rather than each service sleeping on a thread of its own between
+ * iterations, the iterations of the periodic services run on a few threads
+ * they share, see the dispatcher_periodic_threads flag. An iteration should
+ * not block for long, services reading from blocking sources, such as event
+ * publishers, remain an InternalRunnable with a thread each.
+ *
+ * The service ends when it is interrupted, and may interrupt itself.
+ */
+class PeriodicRunnable : public InternalRunnable {
+ public:
+  PeriodicRunnable(const std::string& name,
+                   ThreadClass thread_class = ThreadClass::Default)
+      : InternalRunnable(name, thread_class) {}
+
+ protected:
+  /// Run one iteration, return the delay before the next one.
+  virtual std::chrono::milliseconds tick() = 0;
+
+  /// Run the iterations on a thread of the service.
+  void start() override final;
+
+ private:
+  friend class Dispatcher;
 };
 
 /// An internal runnable used throughout osquery as dispatcher services.
@@ -159,6 +198,15 @@ class Dispatcher : private boost::noncopyable {
   /// When a service ends, it will remove itself from the dispatcher.
   static void removeService(const InternalRunnable* service);
 
+  /// Schedule a periodic service on the shared threads, mutex_ is held.
+  void addPeriodicService(std::shared_ptr<PeriodicRunnable> service);
+
+  /// The entrypoint of the threads shared by the periodic services.
+  void runPeriodicServices();
+
+  /// Run the next iteration of an interrupted periodic service now.
+  static void wakePeriodicService(const InterruptibleRunnable* service);
+
  public:
   /// For testing only, reset the stopping status for unittests.
   void resetStopping();
@@ -186,8 +234,31 @@ class Dispatcher : private boost::noncopyable {
    */
   bool stopping_{false};
 
+  /// A periodic service scheduled on the shared threads.
+  struct PeriodicService {
+    std::shared_ptr<PeriodicRunnable> service;
+
+    /// When the next iteration is due.
+    std::chrono::steady_clock::time_point due;
+
+    /// If a shared thread is running an iteration.
+    bool running{false};
+  };
+
+  /// Protects the periodic services and shared threads.
+  std::mutex periodic_mutex_;
+
+  /// Changes of the periodic services wake the shared threads.
+  std::condition_variable periodic_changed_;
+
+  std::vector<PeriodicService> periodic_services_;
+
+  /// The number of shared threads running, they end without services.
+  size_t periodic_threads_{0};
+
  private:
   friend class InternalRunnable;
+  friend class InterruptibleRunnable;
 
   // Tests
   friend class ConfigTests;
@@ -25,6 +25,12 @@ FLAG(uint64,
      60,
      "Seconds between polling for new queries (default 60)")
 
+FLAG(uint64,
+     distributed_long_poll,
+     0,
+     "Seconds the server may hold a distributed read until queries exist "
+     "(default 0, disabled)");
+
 DECLARE_bool(disable_distributed);
 DECLARE_string(distributed_plugin);
 
@@ -33,10 +39,22 @@ const size_t kDistributedAccelerationInterval = 5;
 void DistributedRunner::start() {
   auto dist = Distributed();
   while (!interrupted()) {
+    auto pull_time = getUnixTime();
     dist.pullUpdates();
+    pull_time = getUnixTime() - pull_time;
+
+    auto received_queries = !dist.getPendingQueries().empty();
     dist.runQueries();
     dist.cleanupExpiredRunningQueries();
 
+    // A long-polling server paces the reads, read again at once if it sent
+    // queries or held the read. A server answering immediately without
+    // queries does not support long polling and is polled on the interval.
+    if (FLAGS_distributed_long_poll > 0 &&
+        (received_queries || pull_time + 1 >= FLAGS_distributed_long_poll)) {
+      continue;
+    }
+
     std::string accelerate_checkins_expire_str = "-1";
     Status status = getDatabaseValue(kPersistentSettings,
                                      "distributed_accelerate_checkins_expire",
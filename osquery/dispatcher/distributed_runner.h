@@ -17,7 +17,8 @@ namespace osquery {
 class DistributedRunner : public InternalRunnable {
  public:
   virtual ~DistributedRunner() {}
-  DistributedRunner() : InternalRunnable("DistributedRunner") {}
+  DistributedRunner()
+      : InternalRunnable("DistributedRunner", ThreadClass::Scheduler) {}
 
  public:
   /// The Dispatcher thread entry point.
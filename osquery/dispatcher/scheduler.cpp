@@ -10,7 +10,16 @@
 #include "osquery/dispatcher/scheduler.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cctype>
 #include <ctime>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include <boost/format.hpp>
 #include <boost/io/quoted.hpp>
@@ -21,12 +30,19 @@
 #include <osquery/core/flags.h>
 #include <osquery/core/query.h>
 #include <osquery/core/shutdown.h>
+#include <osquery/core/sql/scan_slice.h>
 #include <osquery/database/database.h>
 #include <osquery/logger/data_logger.h>
 #include <osquery/numeric_monitoring/numeric_monitoring.h>
 #include <osquery/process/process.h>
 #include <osquery/profiler/code_profiler.h>
+#include <osquery/profiler/resource_usage.h>
+#include <osquery/profiler/sampling_profiler.h>
+#include <osquery/sql/result_memory.h>
 #include <osquery/sql/sqlite_util.h>
+#include <osquery/sql/table_generation_cache.h>
+#include <osquery/sql/table_execution.h>
+#include <osquery/sql/table_statistics.h>
 #include <osquery/utils/expected/expected.h>
 #include <osquery/utils/system/time.h>
 #include <osquery/worker/system/memory.h>
@@ -46,6 +62,11 @@ FLAG(uint64,
      3600,
      "Interval in seconds to reload database arenas");
 
+FLAG(bool,
+     schedule_reload_reclaim,
+     false,
+     "Reclaim database memory online instead of resetting the database");
+
 FLAG(uint64, schedule_epoch, 0, "Epoch for scheduled queries");
 
 FLAG(bool,
@@ -53,6 +74,44 @@ FLAG(bool,
      false,
      "Log the running scheduled query name at INFO level");
 
+FLAG(uint64,
+     schedule_workers,
+     0,
+     "Number of threads running queries that share a schedule step (0 or 1 "
+     "runs them serially)");
+
+FLAG(uint64,
+     profiler_sampling_hz,
+     0,
+     "Sample the stacks of running queries this many times per CPU second "
+     "for the osquery_profile table (0 disables)");
+
+FLAG(bool,
+     schedule_dedup_sql,
+     false,
+     "Execute the identical SQL of scheduled queries due in a step once");
+
+FLAG(bool,
+     snapshot_dedup,
+     false,
+     "Log a marker instead of snapshot results identical to the previous ones");
+
+FLAG(uint64,
+     snapshot_dedup_full_interval,
+     86400,
+     "Seconds after which an unchanged snapshot is logged in full (0 never)");
+
+FLAG(uint64,
+     scan_slice_interval,
+     10,
+     "Seconds between the slices of a scheduled query with a scan_slice");
+
+FLAG(uint64,
+     schedule_prefetch,
+     0,
+     "Seconds ahead of their step to generate the tables of scheduled queries "
+     "(0 disables, requires schedule_table_cache_size)");
+
 HIDDEN_FLAG(bool,
             schedule_reload_sql,
             false,
@@ -62,8 +121,46 @@ HIDDEN_FLAG(bool,
 DECLARE_bool(events_optimize);
 DECLARE_bool(enable_numeric_monitoring);
 DECLARE_bool(verbose);
+DECLARE_uint64(schedule_table_cache_size);
+
+/// The time the prefetch runner waits for a step to prefetch.
+const std::chrono::milliseconds kSchedulePrefetchInterval{250};
+
+std::string normalizeQuerySql(const std::string& sql) {
+  std::string normalized;
+  normalized.reserve(sql.size());
+
+  // A run of whitespace is one space, or a newline which ends a comment.
+  char quote = 0;
+  char space = 0;
+  for (auto c : sql) {
+    if (quote == 0 && std::isspace(static_cast<unsigned char>(c))) {
+      space = (c == '\n' || space == '\n') ? '\n' : ' ';
+      continue;
+    }
+    if (space != 0 && !normalized.empty()) {
+      normalized += space;
+    }
+    space = 0;
 
-SQLInternal monitor(const std::string& name, const ScheduledQuery& query) {
+    if (quote == 0 && (c == '\'' || c == '"' || c == '`')) {
+      quote = c;
+    } else if (c == quote) {
+      quote = 0;
+    }
+    normalized += c;
+  }
+
+  // Trailing statement separators do not change the query.
+  normalized.erase(normalized.find_last_not_of("; \n") + 1);
+  return normalized;
+}
+
+SQLInternal monitor(const std::string& name,
+                    const ScheduledQuery& query,
+                    const ResultMemory::Scope& results_memory) {
+  // The scans of the query's tables are recorded once it completes.
+  TableExecution::Scope table_execution(name);
   if (FLAGS_enable_numeric_monitoring) {
     CodeProfiler profiler(
         {(boost::format("scheduler.pack.%s") % query.pack_name).str(),
@@ -81,12 +178,10 @@ SQLInternal monitor(const std::string& name, const ScheduledQuery& query) {
     return SQLInternal(query.query, true);
   } else {
     // Snapshot the performance and times for the worker before running.
-    auto pid = std::to_string(PlatformProcess::getCurrentPid());
-    auto r0 = SQL::selectFrom({"resident_size", "user_time", "system_time"},
-                              "processes",
-                              "pid",
-                              EQUALS,
-                              pid);
+    // Queries sharing a schedule step are measured on their own thread.
+    auto thread = FLAGS_schedule_workers > 1;
+    ResourceUsage r0;
+    auto s0 = getResourceUsage(r0, thread);
 
     using namespace std::chrono;
     auto t0 = steady_clock::now();
@@ -95,38 +190,87 @@ SQLInternal monitor(const std::string& name, const ScheduledQuery& query) {
 
     // Snapshot the performance after, and compare.
     auto t1 = steady_clock::now();
-    auto r1 = SQL::selectFrom({"resident_size", "user_time", "system_time"},
-                              "processes",
-                              "pid",
-                              EQUALS,
-                              pid);
-    if (r0.size() > 0 && r1.size() > 0) {
-      // Always called while processes table is working.
+    ResourceUsage r1;
+    auto s1 = getResourceUsage(r1, thread);
+    if (s0.ok() && s1.ok()) {
       uint64_t size = sql.getSize();
       Config::get().recordQueryPerformance(
           name,
           duration_cast<milliseconds>(t1 - t0).count(),
           size,
-          r0[0],
-          r1[0]);
+          sql.getRowCount(),
+          results_memory.bytes(),
+          r0,
+          r1);
     }
     return sql;
   }
 }
 
-Status launchQuery(const std::string& name, const ScheduledQuery& query) {
-  // Execute the scheduled query and create a named query object.
-  if (FLAGS_verbose) {
-    VLOG(1) << "Executing scheduled query " << name << ": " << query.query;
-  } else if (FLAGS_schedule_lognames) {
-    LOG(INFO) << "Executing scheduled query " << name;
+/**
+ * @brief Log the results of a slice of a sliced scan, and store its progress.
+ *
+ * Each slice is logged as a snapshot, the last one completes the scan.
+ */
+static Status logScanSlice(const std::string& name,
+                           const ScheduledQuery& query,
+                           const ScanSlice& slice,
+                           const ScanProgress& progress,
+                           QueryLogItem& item) {
+  item.isSnapshot = true;
+  item.scan_slice = progress.slice + 1;
+  item.scan_complete = slice.complete();
+
+  ProfileScope log_scope(ProfileStage::Log);
+  auto status = logSnapshotQuery(item);
+  if (!status.ok()) {
+    // If log directory is not available, then the daemon shouldn't continue.
+    std::string message = "Error logging the results of query: " + name +
+                          ": " + status.toString();
+    requestShutdown(EXIT_CATASTROPHIC, message);
+    return status;
   }
-  runDecorators(DECORATE_ALWAYS);
 
-  auto sql = monitor(name, query);
+  ScanProgress next;
+  if (!slice.complete()) {
+    next.slice = item.scan_slice;
+    next.time = item.time;
+    next.cursor = slice.cursor();
+  }
+  auto stored = Query(name, query).setScanProgress(next);
+  if (!stored.ok()) {
+    // The slice is scanned and logged again by the next run.
+    VLOG(1) << "Cannot store the scan progress of query " << name << ": "
+            << stored.toString();
+  }
+  return status;
+}
+
+/// The time scheduled queries take, from execution to logging the results.
+static const monitoring::LatencyMetric& queryLatency() {
+  static const monitoring::LatencyMetric metric("scheduler.query");
+  return metric;
+}
+
+/**
+ * @brief Diff, store and log the results of a run of a scheduled query.
+ *
+ * @param slice The slice the run scanned, nullptr if the scan is not sliced.
+ * @param progress The progress of the sliced scan before the run.
+ */
+static Status logQueryResults(const std::string& name,
+                              const ScheduledQuery& query,
+                              SQLInternal& sql,
+                              const ResultMemory::Scope& results_memory,
+                              const ScanSlice* slice,
+                              const ScanProgress& progress) {
   if (!sql.getStatus().ok()) {
     LOG(ERROR) << "Error executing scheduled query " << name << ": "
                << sql.getStatus().toString();
+    if (results_memory.exceeded() && query.isDenylistable()) {
+      // The query would fail again, and may cause the watchdog to stop us.
+      Config::get().denylistQuery(name);
+    }
     return Status::failure("Error executing scheduled query");
   }
 
@@ -144,10 +288,33 @@ Status launchQuery(const std::string& name, const ScheduledQuery& query) {
   item.isSnapshot = false;
   getDecorations(item.decorations);
 
+  if (slice != nullptr) {
+    item.snapshot_results = std::move(sql.rowsTyped());
+    return logScanSlice(name, query, *slice, progress, item);
+  }
+
   if (query.isSnapshotQuery()) {
     // This is a snapshot query, emit results without a differential or state.
     item.isSnapshot = true;
     item.snapshot_results = std::move(sql.rowsTyped());
+    if (FLAGS_snapshot_dedup) {
+      auto status =
+          Query(name, query)
+              .dedupSnapshot(item.snapshot_results,
+                             item.time,
+                             FLAGS_snapshot_dedup_full_interval,
+                             item.snapshot_digest,
+                             item.unchanged_since);
+      if (!status.ok()) {
+        // The snapshot is logged in full, and compared again next time.
+        VLOG(1) << "Cannot store the snapshot digest of query " << name
+                << ": " << status.toString();
+      } else if (item.unchanged_since != 0) {
+        VLOG(1) << "Snapshot results of query " << name << " are unchanged";
+        item.snapshot_results.clear();
+      }
+    }
+    ProfileScope log_scope(ProfileStage::Log);
     auto status = logSnapshotQuery(item);
     if (!status.ok()) {
       // If log directory is not available, then the daemon shouldn't continue.
@@ -170,15 +337,18 @@ Status launchQuery(const std::string& name, const ScheduledQuery& query) {
   sql.escapeResults();
   Status status;
   DiffResults& diff_results = item.results;
-  // Add this execution's set of results to the database-tracked named query.
-  // We can then ask for a differential from the last time this named query
-  // was executed by exact matching each row.
-  if (!FLAGS_events_optimize || !sql.eventBased()) {
-    status = dbQuery.addNewResults(
-        std::move(sql.rowsTyped()), item.epoch, item.counter, diff_results);
-  } else {
-    status = dbQuery.addNewEvents(
-        std::move(sql.rowsTyped()), item.epoch, item.counter, diff_results);
+  {
+    // Add this execution's set of results to the database-tracked named
+    // query. We can then ask for a differential from the last time this
+    // named query was executed by exact matching each row.
+    ProfileScope diff_scope(ProfileStage::Diff);
+    if (!FLAGS_events_optimize || !sql.eventBased()) {
+      status = dbQuery.addNewResults(
+          std::move(sql.rowsFlat()), item.epoch, item.counter, diff_results);
+    } else {
+      status = dbQuery.addNewEvents(
+          std::move(sql.rowsTyped()), item.epoch, item.counter, diff_results);
+    }
   }
 
   if (!status.ok()) {
@@ -200,6 +370,7 @@ Status launchQuery(const std::string& name, const ScheduledQuery& query) {
 
   VLOG(1) << "Found results for query: " << name;
 
+  ProfileScope log_scope(ProfileStage::Log);
   status = logQueryLogItem(item);
   if (!status.ok()) {
     // If log directory is not available, then the daemon shouldn't continue.
@@ -210,6 +381,299 @@ Status launchQuery(const std::string& name, const ScheduledQuery& query) {
   return status;
 }
 
+/// Log the execution of a scheduled query, and run the step decorators.
+static void startQuery(const std::string& name, const ScheduledQuery& query) {
+  if (FLAGS_verbose) {
+    VLOG(1) << "Executing scheduled query " << name << ": " << query.query;
+  } else if (FLAGS_schedule_lognames) {
+    LOG(INFO) << "Executing scheduled query " << name;
+  }
+  // The queries launched within a schedule step share the decorations.
+  runDecorators(DECORATE_ALWAYS, TablePlugin::kCacheStep);
+}
+
+Status launchQuery(const std::string& name, const ScheduledQuery& query) {
+  monitoring::LatencyTimer timer(queryLatency());
+  ProfileScope profile_scope(name, ProfileStage::Query);
+  // Execute the scheduled query and create a named query object.
+  startQuery(name, query);
+
+  // The results are accounted until they are stored and logged.
+  ResultMemory::Scope results_memory(query.budget);
+
+  // A sliced scan resumes after the last path of the previous slice.
+  ScanProgress progress;
+  std::unique_ptr<ScanSlice> slice;
+  if (query.scan_slice > 0) {
+    auto status = Query(name, query).getScanProgress(progress);
+    if (!status.ok()) {
+      VLOG(1) << "Restarting the scan of query " << name << ": "
+              << status.toString();
+    }
+    slice = std::make_unique<ScanSlice>(static_cast<size_t>(query.scan_slice),
+                                        progress.cursor);
+  }
+  auto sql = monitor(name, query, results_memory);
+  return logQueryResults(
+      name, query, sql, results_memory, slice.get(), progress);
+}
+
+/// Record the success or failure of a scheduled query execution.
+static inline void recordQueryStatus(const ScheduledQuery& query,
+                                     const Status& status) {
+  if (!FLAGS_enable_numeric_monitoring) {
+    return;
+  }
+  monitoring::record((boost::format("scheduler.query.%s.%s.status.%s") %
+                      query.pack_name % query.name %
+                      (status.ok() ? "success" : "failure"))
+                         .str(),
+                     1,
+                     monitoring::PreAggregationType::Sum,
+                     true);
+}
+
+/// Execute the SQL of several scheduled queries once, each logs the results.
+static void launchSharedQuery(
+    const std::vector<std::pair<std::string, ScheduledQuery>>& queries,
+    const std::vector<size_t>& run) {
+  const auto& first = queries[run.front()];
+  monitoring::LatencyTimer timer(queryLatency());
+  ProfileScope profile_scope(first.first, ProfileStage::Query);
+  startQuery(first.first, first.second);
+  VLOG(1) << "Sharing the results of scheduled query " << first.first
+          << " with " << run.size() - 1 << " other queries";
+
+  ResultMemory::Scope results_memory(first.second.budget);
+  auto sql = monitor(first.first, first.second, results_memory);
+  for (size_t i = 0; i < run.size(); ++i) {
+    const auto& query = queries[run[i]];
+    Status status;
+    if (i + 1 < run.size()) {
+      // Each query diffs and escapes a copy, the last one the results.
+      auto copy = sql.copy();
+      status = logQueryResults(
+          query.first, query.second, copy, results_memory, nullptr, {});
+    } else {
+      status = logQueryResults(
+          query.first, query.second, sql, results_memory, nullptr, {});
+    }
+    recordQueryStatus(query.second, status);
+  }
+}
+
+/**
+ * @brief Group the queries of a step that may share an execution.
+ *
+ * Queries share a run if their normalized SQL and budget are identical, a
+ * sliced scan runs alone. Runs keep the order of their first query.
+ */
+static std::vector<std::vector<size_t>> groupQueryRuns(
+    const std::vector<std::pair<std::string, ScheduledQuery>>& queries) {
+  std::vector<std::vector<size_t>> runs;
+  std::map<std::string, size_t> shared;
+  for (size_t i = 0; i < queries.size(); ++i) {
+    const auto& query = queries[i].second;
+    if (!FLAGS_schedule_dedup_sql || query.scan_slice > 0) {
+      runs.push_back({i});
+      continue;
+    }
+
+    const auto& budget = query.budget;
+    auto key = normalizeQuerySql(query.query) + '\0' +
+               std::to_string(budget.wall_time_ms) + ":" +
+               std::to_string(budget.cpu_time_ms) + ":" +
+               std::to_string(budget.rows) + ":" +
+               std::to_string(budget.result_bytes);
+    auto it = shared.find(key);
+    if (it == shared.end()) {
+      shared.emplace(std::move(key), runs.size());
+      runs.push_back({i});
+    } else {
+      runs[it->second].push_back(i);
+    }
+  }
+  return runs;
+}
+
+/// Check if a scheduled query is launched at a step.
+static inline bool isQueryDue(const ScheduledQuery& query, uint64_t step) {
+  return query.splayed_interval > 0 &&
+         step % query.splayed_interval ==
+             query.splayed_offset % query.splayed_interval;
+}
+
+/// Check if a query is launched at a step, or the next slice of its scan.
+static bool isLaunchDue(const std::string& name,
+                        const ScheduledQuery& query,
+                        uint64_t step) {
+  if (isQueryDue(query, step)) {
+    return true;
+  }
+  if (query.scan_slice == 0) {
+    return false;
+  }
+
+  ScanProgress progress;
+  Query(name, query).getScanProgress(progress);
+  return progress.slice > 0 &&
+         step >= progress.time + FLAGS_scan_slice_interval;
+}
+
+/// A ScheduledQuery is only movable, copy the fields needed to launch it.
+static ScheduledQuery copyScheduledQuery(const ScheduledQuery& query) {
+  ScheduledQuery copy(query.pack_name, query.name, query.query);
+  copy.oncall = query.oncall;
+  copy.interval = query.interval;
+  copy.splayed_interval = query.splayed_interval;
+  copy.splayed_offset = query.splayed_offset;
+  copy.denylisted = query.denylisted;
+  copy.options = query.options;
+  copy.budget = query.budget;
+  copy.keys = query.keys;
+  copy.scan_slice = query.scan_slice;
+  return copy;
+}
+
+/**
+ * @brief Generates the table rows of scheduled queries ahead of their step.
+ *
+ * The queries due within the next schedule_prefetch seconds are executed
+ * within a TableGenerationCache::Prefetch scope and their results discarded.
+ * Once the step starts its queries share the kept rows, moving the cost of
+ * generating them off the step. The runner is a worker thread, the
+ * thread_priorities flag may move it to the idle scheduling class.
+ */
+class SchedulePrefetchRunner : public InternalRunnable {
+ public:
+  SchedulePrefetchRunner()
+      : InternalRunnable("SchedulePrefetchRunner", ThreadClass::Worker) {}
+
+  /// Prefetch the steps after the current step, up to the last step.
+  void request(uint64_t current, uint64_t last) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    current_ = current;
+    last_ = last;
+  }
+
+  void start() override {
+    while (!interrupted()) {
+      uint64_t step = 0;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // Steps that started are not prefetched.
+        next_ = std::max(next_, current_ + 1);
+        if (next_ <= last_) {
+          step = next_++;
+        }
+      }
+
+      if (step == 0) {
+        pause(kSchedulePrefetchInterval);
+      } else {
+        prefetchStep(step);
+      }
+    }
+  }
+
+ private:
+  /// Execute the queries due at a step.
+  void prefetchStep(uint64_t step) {
+    std::vector<std::pair<std::string, ScheduledQuery>> queries;
+    Config::get().scheduledQueries(
+        ([this, step, &queries](const std::string& name,
+                                const ScheduledQuery& query) {
+          // A slice depends on the progress of the previous one.
+          if (query.scan_slice == 0 && isQueryDue(query, step) &&
+              event_queries_.count(name) == 0) {
+            queries.emplace_back(name, copyScheduledQuery(query));
+          }
+        }));
+
+    TableGenerationCache::Prefetch prefetch(step);
+    for (const auto& query : queries) {
+      if (interrupted()) {
+        break;
+      }
+
+      // A query stopping the worker is denylisted like its scheduled runs.
+      Config::get().recordQueryStart(query.first);
+      ResultMemory::Scope results_memory(query.second.budget);
+      SQLInternal sql(query.second.query, true);
+      if (sql.eventBased()) {
+        // Event-based tables are never kept, the scan is not repeated.
+        event_queries_.insert(query.first);
+      }
+      if (!sql.getStatus().ok()) {
+        VLOG(1) << "Cannot prefetch the tables of scheduled query "
+                << query.first << ": " << sql.getStatus().toString();
+      }
+    }
+  }
+
+ private:
+  /// Protects the requested steps.
+  std::mutex mutex_;
+
+  /// The step the scheduler last ran.
+  uint64_t current_{0};
+
+  /// The last step to prefetch.
+  uint64_t last_{0};
+
+  /// The next step to prefetch.
+  uint64_t next_{0};
+
+  /// The queries reading event-based tables, they are not prefetched.
+  std::set<std::string> event_queries_;
+};
+
+void launchQueries(std::vector<std::pair<std::string, ScheduledQuery>>& queries,
+                   size_t workers) {
+  if (queries.empty()) {
+    return;
+  }
+
+  // Each query name appears at most once per step and all workers are joined
+  // before the step completes. The storage of results and logging for a given
+  // query name are therefore still ordered across steps.
+  auto runs = groupQueryRuns(queries);
+  std::atomic<size_t> next{0};
+  auto worker = [&queries, &runs, &next]() {
+    for (auto index = next++; index < runs.size(); index = next++) {
+      const auto& run = runs[index];
+      // Each worker's SQLInternal acquires its own SQLiteDBInstance. Only one
+      // may use the primary connection, the others are given transient ones.
+      if (run.size() == 1) {
+        const auto& query = queries[run.front()];
+        recordQueryStatus(query.second,
+                          launchQuery(query.first, query.second));
+      } else {
+        launchSharedQuery(queries, run);
+      }
+      if (shutdownRequested()) {
+        break;
+      }
+    }
+  };
+
+  workers = std::min(workers, runs.size());
+  if (workers <= 1) {
+    worker();
+    return;
+  }
+
+  std::vector<std::thread> threads;
+  threads.reserve(workers);
+  for (size_t i = 0; i < workers; ++i) {
+    threads.emplace_back(worker);
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
 void SchedulerRunner::calculateTimeDriftAndMaybePause(
     std::chrono::milliseconds loop_step_duration) {
   if (loop_step_duration + time_drift_ < interval_) {
@@ -237,17 +701,50 @@ void SchedulerRunner::maybeScheduleCarves(uint64_t time_step) {
   }
 }
 
+void SchedulerRunner::maybeSaveTableStatistics(uint64_t time_step) {
+  if (TableStatistics::enabled() && (time_step % 300) == 0) {
+    auto status = TableStatistics::get().save();
+    if (!status.ok()) {
+      VLOG(1) << "Cannot save table statistics: " << status.getMessage();
+    }
+  }
+}
+
+void SchedulerRunner::maybePlaceQueries(uint64_t time_step) {
+  // Placement is revised as the performance of new queries is recorded.
+  if ((time_step % 3600) == 0) {
+    Config::get().placeScheduledQueries();
+  }
+}
+
+void SchedulerRunner::maybeUpdateProfiler() {
+  // The rate may be changed by a configuration update, samples are
+  // collected every step so the pending buffer does not fill.
+  auto status = updateSamplingProfiler(FLAGS_profiler_sampling_hz);
+  if (!status.ok() && !profiler_error_) {
+    LOG(WARNING) << "Cannot start the sampling profiler: "
+                 << status.getMessage();
+  }
+  profiler_error_ = !status.ok();
+}
+
 void SchedulerRunner::maybeReloadSchedule(uint64_t time_step) {
   if (FLAGS_schedule_reload > 0 && (time_step % FLAGS_schedule_reload) == 0) {
-    /* Before resetting the database we want to ensure that there's no pending
-       log relay thread started by the scheduler thread in a previous loop,
-       to avoid deadlocks.
-       This is because resetDatabase logs and also holds an exclusive lock
-       to the database, so when a log relay thread started via relayStatusLog
-       is pending, log calls done on the same thread that started it
-       (in this case the scheduler thread), will wait until the log relaying
-       thread finishes serializing the logs to the database; but this can't
-       happen due to the exclusive lock. */
+    if (FLAGS_schedule_reload_reclaim) {
+      // Handles stay open and no exclusive lock is taken, queries, events
+      // and log relays continue while the plugin releases memory.
+      if (FLAGS_schedule_reload_sql) {
+        SQLiteDBManager::resetPrimary();
+      }
+      auto status = reclaimDatabase();
+      if (!status.ok()) {
+        VLOG(1) << "Cannot reclaim database memory: " << status.getMessage();
+      }
+      return;
+    }
+
+    // Send the status logs requested so far before the database is reset,
+    // the logs of the reset wait in the status log buffer.
     waitLogRelay();
 
     if (FLAGS_schedule_reload_sql) {
@@ -258,20 +755,86 @@ void SchedulerRunner::maybeReloadSchedule(uint64_t time_step) {
 }
 
 void SchedulerRunner::maybeFlushLogs(uint64_t time_step) {
-  /* In daemon mode we start a log relay thread to flush the logs from the
-     BufferedLogSink to the database.
-     The thread is started from the scheduler thread,
-     since if we did it in the send() function of BufferedLogSink,
-     inline to the log call itself, we would cause deadlocks
-     if there's recursive logging caused by the logger plugins.
-     We do the flush itself also in a new thread so we don't slow down
-     the scheduler thread too much */
+  // In daemon mode the status log relay sends the buffered status logs when
+  // the scheduler requests it, the logging threads only buffer them.
   if ((time_step % 3) == 0) {
     relayStatusLogs(LoggerRelayMode::Async);
   }
 }
 
+void SchedulerRunner::maybePrefetch(uint64_t time_step) {
+  if (prefetch_ != nullptr) {
+    prefetch_->request(time_step, time_step + FLAGS_schedule_prefetch);
+  }
+}
+
+void SchedulerRunner::runStep(uint64_t time_step) {
+  TableGenerationCache::get().startStep(time_step);
+  Config::get().scheduledQueries(([&time_step](const std::string& name,
+                                               const ScheduledQuery& query) {
+    if (isLaunchDue(name, query, time_step)) {
+      TablePlugin::kCacheInterval = query.splayed_interval;
+      TablePlugin::kCacheStep = time_step;
+      const auto status = launchQuery(name, query);
+      recordQueryStatus(query, status);
+
+#ifdef OSQUERY_LINUX
+      // Attempt to release some unused memory kept by malloc internal caching
+      releaseRetainedMemory();
+#endif
+    }
+  }));
+  TableGenerationCache::get().endStep();
+}
+
+void SchedulerRunner::runConcurrentStep(uint64_t time_step) {
+  // Copy the queries due this step, the config lock is not held while the
+  // workers execute so a config update is not blocked by a slow query.
+  std::vector<std::pair<std::string, ScheduledQuery>> queries;
+  Config::get().scheduledQueries(
+      ([&time_step, &queries](const std::string& name,
+                              const ScheduledQuery& query) {
+        if (isLaunchDue(name, query, time_step)) {
+          queries.emplace_back(name, copyScheduledQuery(query));
+        }
+      }));
+
+  if (queries.empty()) {
+    return;
+  }
+
+  // The cache interval is only meaningful to a single executing query, the
+  // step is shared by every query launched concurrently.
+  TablePlugin::kCacheStep = time_step;
+  TableGenerationCache::get().startStep(time_step);
+  launchQueries(queries, static_cast<size_t>(FLAGS_schedule_workers));
+  TableGenerationCache::get().endStep();
+
+#ifdef OSQUERY_LINUX
+  // Attempt to release some unused memory kept by malloc internal caching
+  releaseRetainedMemory();
+#endif
+}
+
 void SchedulerRunner::start() {
+  if (TableStatistics::enabled()) {
+    // Plans made before the first scans benefit from earlier observations.
+    auto status = TableStatistics::get().load();
+    if (!status.ok()) {
+      VLOG(1) << "Cannot load table statistics: " << status.getMessage();
+    }
+  }
+
+  if (FLAGS_schedule_prefetch > 0 && FLAGS_schedule_table_cache_size > 0) {
+    prefetch_ = std::make_shared<SchedulePrefetchRunner>();
+    auto status = Dispatcher::addService(prefetch_);
+    if (!status.ok()) {
+      LOG(WARNING) << "Cannot start the schedule prefetch: "
+                   << status.getMessage();
+      prefetch_ = nullptr;
+    }
+  }
+
   // Start the counter at the second.
   auto i = osquery::getUnixTime();
   // Timeout is the number of seconds from starting.
@@ -279,31 +842,21 @@ void SchedulerRunner::start() {
 
   for (; (end == 0) || (i <= end); ++i) {
     auto start_time_point = std::chrono::steady_clock::now();
-    Config::get().scheduledQueries(([&i](const std::string& name,
-                                         const ScheduledQuery& query) {
-      if (query.splayed_interval > 0 && i % query.splayed_interval == 0) {
-        TablePlugin::kCacheInterval = query.splayed_interval;
-        TablePlugin::kCacheStep = i;
-        const auto status = launchQuery(name, query);
-        monitoring::record((boost::format("scheduler.query.%s.%s.status.%s") %
-                            query.pack_name % query.name %
-                            (status.ok() ? "success" : "failure"))
-                               .str(),
-                           1,
-                           monitoring::PreAggregationType::Sum,
-                           true);
-
-#ifdef OSQUERY_LINUX
-        // Attempt to release some unused memory kept by malloc internal caching
-        releaseRetainedMemory();
-#endif
-      }
-    }));
+    // Queries sharing their SQL are grouped from the copies of a step.
+    if (FLAGS_schedule_workers > 1 || FLAGS_schedule_dedup_sql) {
+      runConcurrentStep(i);
+    } else {
+      runStep(i);
+    }
 
     maybeRunDecorators(i);
     maybeReloadSchedule(i);
     maybeFlushLogs(i);
     maybeScheduleCarves(i);
+    maybeSaveTableStatistics(i);
+    maybePlaceQueries(i);
+    maybeUpdateProfiler();
+    maybePrefetch(i);
 
     auto loop_step_duration =
         std::chrono::duration_cast<std::chrono::milliseconds>(
@@ -314,10 +867,17 @@ void SchedulerRunner::start() {
     }
   }
 
-  /* Wait for the thread relaying/flushing the logs,
-     to prevent race conditions on shutdown */
+  // Send the status logs buffered before the shutdown.
   waitLogRelay();
 
+  if (prefetch_ != nullptr) {
+    prefetch_->interrupt();
+  }
+
+  if (TableStatistics::enabled()) {
+    TableStatistics::get().save();
+  }
+
   // Scheduler ended.
   if (!interrupted() && request_shutdown_on_expiration) {
     LOG(INFO) << "The scheduler ended after " << timeout_ << " seconds";
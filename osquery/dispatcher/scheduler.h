@@ -11,6 +11,10 @@
 
 #include <chrono>
 #include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include <osquery/dispatcher/dispatcher.h>
 
@@ -18,6 +22,8 @@
 
 namespace osquery {
 
+class SchedulePrefetchRunner;
+
 /// A Dispatcher service thread that watches an ExtensionManagerHandler.
 class SchedulerRunner : public InternalRunnable {
  public:
@@ -25,7 +31,7 @@ class SchedulerRunner : public InternalRunnable {
       unsigned long int timeout,
       size_t interval,
       std::chrono::milliseconds max_time_drift = std::chrono::seconds::zero())
-      : InternalRunnable("SchedulerRunner"),
+      : InternalRunnable("SchedulerRunner", ThreadClass::Scheduler),
         interval_{std::chrono::seconds{interval}},
         timeout_(timeout),
         time_drift_{std::chrono::milliseconds::zero()},
@@ -45,6 +51,12 @@ class SchedulerRunner : public InternalRunnable {
   void calculateTimeDriftAndMaybePause(
       std::chrono::milliseconds loop_step_duration);
 
+  /// Launch the queries due at a schedule step, one after another.
+  void runStep(uint64_t time_step);
+
+  /// Launch the queries due at a schedule step using schedule_workers threads.
+  void runConcurrentStep(uint64_t time_step);
+
   /// Check interval-based decorators.
   void maybeRunDecorators(uint64_t time_step);
 
@@ -57,6 +69,18 @@ class SchedulerRunner : public InternalRunnable {
   /// Check if carve requests should be scheduled.
   void maybeScheduleCarves(uint64_t time_step);
 
+  /// Check if observed table statistics should be persisted.
+  void maybeSaveTableStatistics(uint64_t time_step);
+
+  /// Check if the scheduled queries should be placed by their cost.
+  void maybePlaceQueries(uint64_t time_step);
+
+  /// Apply the sampling profiler rate and collect its samples.
+  void maybeUpdateProfiler();
+
+  /// Request the prefetch of the steps due within schedule_prefetch seconds.
+  void maybePrefetch(uint64_t time_step);
+
  private:
   /// Interval in seconds between schedule steps.
   const std::chrono::milliseconds interval_;
@@ -71,6 +95,12 @@ class SchedulerRunner : public InternalRunnable {
 
   const std::chrono::milliseconds max_time_drift_;
 
+  /// The last profiler update failed, the failure was logged.
+  bool profiler_error_{false};
+
+  /// Generates the tables of the next steps, if schedule_prefetch is set.
+  std::shared_ptr<SchedulePrefetchRunner> prefetch_;
+
   /// Tests should not always trigger a shutdown when the scheduler expires,
   /// so let tests decide when this should happen.
   FRIEND_TEST(TLSConfigTests, test_runner_and_scheduler);
@@ -79,6 +109,27 @@ class SchedulerRunner : public InternalRunnable {
 
 SQLInternal monitor(const std::string& name, const ScheduledQuery& query);
 
+/**
+ * @brief The SQL of a scheduled query without insignificant whitespace.
+ *
+ * Queries of the same normalized SQL may share an execution, whitespace
+ * within quotes and the case of the SQL are kept.
+ */
+std::string normalizeQuerySql(const std::string& sql);
+
+/// Execute, diff, and log the results of a single scheduled query.
+Status launchQuery(const std::string& name, const ScheduledQuery& query);
+
+/**
+ * @brief Launch a set of independent scheduled queries concurrently.
+ *
+ * At most `workers` threads are used, and all are joined before returning.
+ * Each query's storage and logging happens on the thread that executed it.
+ * With --schedule_dedup_sql the queries of identical SQL share a run.
+ */
+void launchQueries(std::vector<std::pair<std::string, ScheduledQuery>>& queries,
+                   size_t workers);
+
 /// Start querying according to the config's schedule
 void startScheduler();
 
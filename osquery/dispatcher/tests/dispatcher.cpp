@@ -8,6 +8,7 @@
  */
 
 #include <chrono>
+#include <thread>
 
 #include <gtest/gtest.h>
 
@@ -137,6 +138,84 @@ TEST_F(DispatcherTests, test_interruption) {
   EXPECT_TRUE(r1->hasRun());
 }
 
+class WorkerTestRunnable : public InternalRunnable {
+ public:
+  WorkerTestRunnable()
+      : InternalRunnable("WorkerTestRunnable", ThreadClass::Worker) {}
+
+  void start() override {}
+};
+
+TEST_F(DispatcherTests, test_thread_classes) {
+  EXPECT_EQ(threadClassName(ThreadClass::EventReader), "event_reader");
+  EXPECT_EQ(getThreadClassSetting("worker=0-3,8; scheduler = idle",
+                                  ThreadClass::Scheduler),
+            "idle");
+  EXPECT_EQ(getThreadClassSetting("worker=0-3,8", ThreadClass::Worker),
+            "0-3,8");
+  EXPECT_EQ(getThreadClassSetting("worker=0-3,8", ThreadClass::Logger), "");
+
+  auto index = static_cast<size_t>(ThreadClass::Worker);
+  auto started = getThreadClassUsage().at(index).started;
+  Dispatcher::addService(std::make_shared<WorkerTestRunnable>());
+  Dispatcher::joinServices();
+
+  // The exited thread is still accounted to its class.
+  auto usage = getThreadClassUsage().at(index);
+  EXPECT_EQ(usage.thread_class, ThreadClass::Worker);
+  EXPECT_EQ(usage.started, started + 1);
+  EXPECT_EQ(usage.threads, 0U);
+}
+
+class PeriodicTestRunnable : public PeriodicRunnable {
+ public:
+  explicit PeriodicTestRunnable(std::chrono::milliseconds delay)
+      : PeriodicRunnable("PeriodicTestRunnable"), delay_(delay) {}
+
+  std::chrono::milliseconds tick() override {
+    // The service ends itself after three iterations.
+    if (++ticks == 3) {
+      interrupt();
+    }
+    return delay_;
+  }
+
+  std::atomic<size_t> ticks{0};
+
+ private:
+  std::chrono::milliseconds delay_;
+};
+
+TEST_F(DispatcherTests, test_periodic) {
+  auto service_count = Dispatcher::instance().serviceCount();
+  auto r1 =
+      std::make_shared<PeriodicTestRunnable>(std::chrono::milliseconds(1));
+  auto r2 =
+      std::make_shared<PeriodicTestRunnable>(std::chrono::milliseconds(1));
+  Dispatcher::addService(r1);
+  Dispatcher::addService(r2);
+  EXPECT_TRUE(r1->hasRun());
+
+  // Both services share the periodic threads.
+  Dispatcher::joinServices();
+  EXPECT_EQ(r1->ticks, 3U);
+  EXPECT_EQ(r2->ticks, 3U);
+  EXPECT_EQ(service_count, Dispatcher::instance().serviceCount());
+}
+
+TEST_F(DispatcherTests, test_periodic_interruption) {
+  auto r1 = std::make_shared<PeriodicTestRunnable>(std::chrono::seconds(100));
+  Dispatcher::addService(r1);
+  while (r1->ticks == 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  // The next iteration would normally run in 100 seconds.
+  r1->interrupt();
+  Dispatcher::joinServices();
+  EXPECT_EQ(r1->ticks, 1U);
+}
+
 TEST_F(DispatcherTests, test_stop_dispatcher) {
   Dispatcher::stopServices();
 
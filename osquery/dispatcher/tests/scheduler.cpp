@@ -11,6 +11,7 @@
 
 #include <osquery/config/config.h>
 #include <osquery/core/shutdown.h>
+#include <osquery/core/sql/columnar_results.h>
 #include <osquery/core/system.h>
 #include <osquery/database/database.h>
 #include <osquery/dispatcher/scheduler.h>
@@ -23,6 +24,7 @@ namespace osquery {
 
 DECLARE_bool(disable_logging);
 DECLARE_uint64(schedule_reload);
+DECLARE_bool(schedule_dedup_sql);
 
 class SchedulerTests : public testing::Test {
   void SetUp() override {
@@ -210,6 +212,74 @@ TEST_F(SchedulerTests, test_scheduler) {
   TablePlugin::kCacheInterval = backup_interval;
 }
 
+TEST_F(SchedulerTests, test_launch_queries_concurrently) {
+  std::vector<std::pair<std::string, ScheduledQuery>> queries;
+  for (size_t i = 0; i < 6; ++i) {
+    auto number = std::to_string(i);
+    ScheduledQuery query(
+        "workers", number, "select " + number + " as number");
+    query.interval = 1;
+    query.splayed_interval = 1;
+    queries.emplace_back("pack_workers_" + number, std::move(query));
+  }
+
+  launchQueries(queries, 4);
+
+  // Every query's results must have been stored independently.
+  for (const auto& query : queries) {
+    std::string content;
+    getDatabaseValue(kQueries, query.first, content);
+    QueryDataTyped results;
+    ASSERT_TRUE(deserializeStoredQueryData(content, results).ok());
+    ASSERT_EQ(results.size(), 1U);
+    EXPECT_EQ(results[0].at("number"),
+              RowDataTyped(std::stoll(query.second.name)));
+  }
+}
+
+TEST_F(SchedulerTests, test_normalize_query_sql) {
+  EXPECT_EQ(normalizeQuerySql("  SELECT *\tFROM  time;  "),
+            "SELECT * FROM time");
+  EXPECT_EQ(normalizeQuerySql("SELECT 1 -- a\n  , 2;;"),
+            "SELECT 1 -- a\n, 2");
+
+  // Whitespace within quotes is significant.
+  EXPECT_EQ(normalizeQuerySql("SELECT 'a  b'"), "SELECT 'a  b'");
+  EXPECT_NE(normalizeQuerySql("SELECT 'a  b'"),
+            normalizeQuerySql("SELECT 'a b'"));
+}
+
+TEST_F(SchedulerTests, test_launch_shared_queries) {
+  auto backup = FLAGS_schedule_dedup_sql;
+  FLAGS_schedule_dedup_sql = true;
+
+  std::vector<std::pair<std::string, ScheduledQuery>> queries;
+  for (const auto& sql : {"select random() as r",
+                          "select random()  as r;",
+                          "select  random()\nas r"}) {
+    auto number = std::to_string(queries.size());
+    ScheduledQuery query("shared", number, sql);
+    query.interval = 1;
+    query.splayed_interval = 1;
+    queries.emplace_back("pack_shared_" + number, std::move(query));
+  }
+  launchQueries(queries, 1);
+  FLAGS_schedule_dedup_sql = backup;
+
+  // The first two queries share a run, each stored the results.
+  std::vector<RowDataTyped> values;
+  for (const auto& query : queries) {
+    std::string content;
+    getDatabaseValue(kQueries, query.first, content);
+    QueryDataTyped results;
+    ASSERT_TRUE(deserializeStoredQueryData(content, results).ok());
+    ASSERT_EQ(results.size(), 1U);
+    values.push_back(results[0].at("r"));
+  }
+  EXPECT_EQ(values[0], values[1]);
+  EXPECT_NE(values[0], values[2]);
+}
+
 TEST_F(SchedulerTests, test_scheduler_zero_drift) {
   const auto backup_step = TablePlugin::kCacheStep;
   const auto backup_interval = TablePlugin::kCacheInterval;
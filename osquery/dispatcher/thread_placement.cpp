@@ -0,0 +1,339 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <array>
+#include <fstream>
+#include <map>
+#include <mutex>
+
+#ifdef OSQUERY_LINUX
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#include <pthread.h>
+#elif defined(OSQUERY_WINDOWS)
+#include <osquery/utils/system/system.h>
+#endif
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/algorithm/string/trim.hpp>
+
+#include <osquery/core/flags.h>
+#include <osquery/dispatcher/thread_placement.h>
+#include <osquery/logger/logger.h>
+#include <osquery/utils/conversions/split.h>
+#include <osquery/utils/conversions/tryto.h>
+
+namespace osquery {
+
+FLAG(string,
+     thread_cpus,
+     "",
+     "Semicolon-separated class=CPUs pinning osquery thread classes (Linux)");
+
+FLAG(string,
+     thread_priorities,
+     "",
+     "Semicolon-separated class=nice or class=idle for thread classes (Linux)");
+
+namespace {
+
+const std::array<std::string, 5> kThreadClassNames = {
+    "default", "event_reader", "scheduler", "logger", "worker"};
+
+/// A running thread, its CPU clock is read by getThreadClassUsage.
+struct ThreadRecord {
+  ThreadClass thread_class{ThreadClass::Default};
+
+#ifdef OSQUERY_LINUX
+  clockid_t clock{};
+  bool has_clock{false};
+#elif defined(__APPLE__)
+  mach_port_t port{MACH_PORT_NULL};
+#elif defined(OSQUERY_WINDOWS)
+  HANDLE handle{nullptr};
+#endif
+};
+
+struct ThreadClassState {
+  std::mutex mutex;
+  std::map<std::size_t, ThreadRecord> threads;
+  std::size_t next_id{1};
+
+  std::array<std::size_t, kThreadClassNames.size()> started{};
+
+  /// Nanoseconds of CPU time used by the exited threads.
+  std::array<std::uint64_t, kThreadClassNames.size()> exited_cpu_time{};
+};
+
+/// Threads may exit after static destructors ran, the state is not released.
+ThreadClassState& getThreadClassState() {
+  static auto* state = new ThreadClassState();
+  return *state;
+}
+
+inline std::size_t classIndex(ThreadClass thread_class) {
+  return static_cast<std::size_t>(thread_class);
+}
+
+/// Nanoseconds of CPU time used by a running thread.
+std::uint64_t readThreadCpuTime(const ThreadRecord& record) {
+#ifdef OSQUERY_LINUX
+  struct timespec ts {};
+  if (!record.has_clock || clock_gettime(record.clock, &ts) != 0) {
+    return 0;
+  }
+  return static_cast<std::uint64_t>(ts.tv_sec) * 1000000000ULL +
+         static_cast<std::uint64_t>(ts.tv_nsec);
+#elif defined(__APPLE__)
+  thread_basic_info_data_t info{};
+  mach_msg_type_number_t count = THREAD_BASIC_INFO_COUNT;
+  if (thread_info(record.port,
+                  THREAD_BASIC_INFO,
+                  reinterpret_cast<thread_info_t>(&info),
+                  &count) != KERN_SUCCESS) {
+    return 0;
+  }
+  auto micros = [](const time_value_t& value) {
+    return static_cast<std::uint64_t>(value.seconds) * 1000000ULL +
+           static_cast<std::uint64_t>(value.microseconds);
+  };
+  return (micros(info.user_time) + micros(info.system_time)) * 1000ULL;
+#elif defined(OSQUERY_WINDOWS)
+  FILETIME creation, exit, kernel, user;
+  if (record.handle == nullptr ||
+      !GetThreadTimes(record.handle, &creation, &exit, &kernel, &user)) {
+    return 0;
+  }
+  auto ticks = [](const FILETIME& value) {
+    return (static_cast<std::uint64_t>(value.dwHighDateTime) << 32) |
+           value.dwLowDateTime;
+  };
+  // Thread times are counted in 100 nanosecond intervals.
+  return (ticks(kernel) + ticks(user)) * 100ULL;
+#else
+  return 0;
+#endif
+}
+
+#ifdef OSQUERY_LINUX
+/// Parse a CPU list such as "0-3,8", false if it selects no CPU.
+bool parseCpuList(const std::string& list, cpu_set_t& cpus) {
+  CPU_ZERO(&cpus);
+  bool any = false;
+  for (const auto& range : split(list, ",")) {
+    auto dash = range.find('-');
+    auto first = tryTo<int>(range.substr(0, dash), 10);
+    auto last = dash == std::string::npos
+                    ? tryTo<int>(range, 10)
+                    : tryTo<int>(range.substr(dash + 1), 10);
+    if (first.isError() || last.isError() || first.get() < 0 ||
+        last.get() < first.get() || last.get() >= CPU_SETSIZE) {
+      return false;
+    }
+
+    for (auto cpu = first.get(); cpu <= last.get(); ++cpu) {
+      CPU_SET(cpu, &cpus);
+      any = true;
+    }
+  }
+  return any;
+}
+
+/**
+ * @brief Pin the calling thread to CPUs, or to the CPUs of a NUMA node.
+ *
+ * A "nodeN" value also prefers the memory of the node for the allocations
+ * of the thread.
+ */
+void applyThreadCpus(const std::string& name, const std::string& value) {
+  auto list = value;
+  long node = -1;
+  if (boost::starts_with(value, "node")) {
+    auto number = tryTo<long>(value.substr(4), 10);
+    std::ifstream cpulist("/sys/devices/system/node/node" +
+                          value.substr(4) + "/cpulist");
+    if (number.isError() || number.get() >= 64 ||
+        !std::getline(cpulist, list)) {
+      LOG(WARNING) << "Unknown NUMA node for the " << name
+                   << " threads: " << value;
+      return;
+    }
+    node = number.get();
+  }
+
+  cpu_set_t cpus;
+  if (!parseCpuList(list, cpus)) {
+    LOG(WARNING) << "Invalid CPU list for the " << name
+                 << " threads: " << value;
+    return;
+  }
+
+  auto error = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+  if (error != 0) {
+    VLOG(1) << "Cannot pin a " << name << " thread to CPUs " << value
+            << ": error " << error;
+  }
+
+  if (node >= 0) {
+    // The kernel reads one bit less than the maximum node passed.
+    unsigned long nodes = 1UL << node;
+    if (syscall(SYS_set_mempolicy,
+                MPOL_PREFERRED,
+                &nodes,
+                sizeof(nodes) * 8 + 1) != 0) {
+      VLOG(1) << "Cannot prefer the memory of NUMA node " << node
+              << " for a " << name << " thread: errno " << errno;
+    }
+  }
+}
+
+/// Set the nice value of the calling thread, or its idle scheduling class.
+void applyThreadPriority(const std::string& name, const std::string& value) {
+  if (value == "idle") {
+    struct sched_param param {};
+    auto error = pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+    if (error != 0) {
+      VLOG(1) << "Cannot move a " << name
+              << " thread to the idle scheduling class: error " << error;
+    }
+    return;
+  }
+
+  auto nice = tryTo<int>(value, 10);
+  if (nice.isError() || nice.get() < -20 || nice.get() > 19) {
+    LOG(WARNING) << "Invalid priority for the " << name
+                 << " threads: " << value;
+    return;
+  }
+
+  // The nice value applies to the thread, not the process.
+  auto tid = static_cast<id_t>(syscall(SYS_gettid));
+  if (setpriority(PRIO_PROCESS, tid, nice.get()) != 0) {
+    VLOG(1) << "Cannot set the nice value of a " << name
+            << " thread to " << value << ": errno " << errno;
+  }
+}
+#endif
+
+/// Apply the placement configured for a class to the calling thread.
+void applyThreadPlacement(ThreadClass thread_class) {
+  auto cpus = getThreadClassSetting(FLAGS_thread_cpus, thread_class);
+  auto priority = getThreadClassSetting(FLAGS_thread_priorities, thread_class);
+  if (cpus.empty() && priority.empty()) {
+    return;
+  }
+
+  const auto& name = threadClassName(thread_class);
+#ifdef OSQUERY_LINUX
+  if (!cpus.empty()) {
+    applyThreadCpus(name, cpus);
+  }
+  if (!priority.empty()) {
+    applyThreadPriority(name, priority);
+  }
+#else
+  VLOG(1) << "The placement of the " << name
+          << " threads is only applied on Linux";
+#endif
+}
+
+} // namespace
+
+const std::string& threadClassName(ThreadClass thread_class) {
+  auto index = classIndex(thread_class);
+  return kThreadClassNames[index < kThreadClassNames.size() ? index : 0];
+}
+
+std::string getThreadClassSetting(const std::string& setting,
+                                  ThreadClass thread_class) {
+  const auto& name = threadClassName(thread_class);
+  for (const auto& entry : split(setting, ";")) {
+    auto equals = entry.find('=');
+    if (equals != std::string::npos &&
+        boost::trim_copy(entry.substr(0, equals)) == name) {
+      return boost::trim_copy(entry.substr(equals + 1));
+    }
+  }
+  return "";
+}
+
+ThreadClassScope::ThreadClassScope(ThreadClass thread_class) {
+  applyThreadPlacement(thread_class);
+
+  ThreadRecord record;
+  record.thread_class = thread_class;
+#ifdef OSQUERY_LINUX
+  record.has_clock = pthread_getcpuclockid(pthread_self(), &record.clock) == 0;
+#elif defined(__APPLE__)
+  record.port = pthread_mach_thread_np(pthread_self());
+#elif defined(OSQUERY_WINDOWS)
+  record.handle = OpenThread(
+      THREAD_QUERY_LIMITED_INFORMATION, FALSE, GetCurrentThreadId());
+#endif
+
+  auto& state = getThreadClassState();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  id_ = state.next_id++;
+  state.threads.emplace(id_, record);
+  ++state.started[classIndex(thread_class)];
+}
+
+ThreadClassScope::~ThreadClassScope() {
+  auto& state = getThreadClassState();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  auto it = state.threads.find(id_);
+  if (it == state.threads.end()) {
+    return;
+  }
+
+  const auto& record = it->second;
+  state.exited_cpu_time[classIndex(record.thread_class)] +=
+      readThreadCpuTime(record);
+#ifdef OSQUERY_WINDOWS
+  if (record.handle != nullptr) {
+    CloseHandle(record.handle);
+  }
+#endif
+  state.threads.erase(it);
+}
+
+std::vector<ThreadClassUsage> getThreadClassUsage() {
+  std::vector<ThreadClassUsage> usage(kThreadClassNames.size());
+  std::array<std::uint64_t, kThreadClassNames.size()> cpu_time{};
+
+  auto& state = getThreadClassState();
+  {
+    std::lock_guard<std::mutex> lock(state.mutex);
+    for (const auto& thread : state.threads) {
+      auto index = classIndex(thread.second.thread_class);
+      ++usage[index].threads;
+      cpu_time[index] += readThreadCpuTime(thread.second);
+    }
+
+    for (std::size_t i = 0; i < usage.size(); ++i) {
+      usage[i].started = state.started[i];
+      cpu_time[i] += state.exited_cpu_time[i];
+    }
+  }
+
+  for (std::size_t i = 0; i < usage.size(); ++i) {
+    usage[i].thread_class = static_cast<ThreadClass>(i);
+    usage[i].cpu_time = cpu_time[i] / 1000000ULL;
+  }
+  return usage;
+}
+
+} // namespace osquery
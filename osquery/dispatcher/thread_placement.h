@@ -0,0 +1,85 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+namespace osquery {
+
+/// The classes of osquery threads sharing a placement policy.
+enum class ThreadClass {
+  /// Services without a class.
+  Default = 0,
+
+  /// Event publisher run loops and the readers of their sources.
+  EventReader,
+
+  /// The schedule and distributed query runners.
+  Scheduler,
+
+  /// Threads sending logs, results and events to the logger plugins.
+  Logger,
+
+  /// Pools of threads sharing work, such as hashing file events.
+  Worker,
+};
+
+/// The name of a thread class used by the flags and tables.
+const std::string& threadClassName(ThreadClass thread_class);
+
+/**
+ * @brief The value configured for a class in a "class=value;..." setting.
+ *
+ * @return The value, empty if the class is not configured.
+ */
+std::string getThreadClassSetting(const std::string& setting,
+                                  ThreadClass thread_class);
+
+/**
+ * @brief The calling thread is a thread of the class while this exists.
+ *
+ * The placement configured for the class with thread_cpus and
+ * thread_priorities is applied to the thread, on Linux only. The CPU time of
+ * the thread is accounted to its class, including once the thread exited.
+ */
+class ThreadClassScope : private boost::noncopyable {
+ public:
+  explicit ThreadClassScope(ThreadClass thread_class);
+
+  ~ThreadClassScope();
+
+ private:
+  /// The identifier of the thread within the running threads.
+  std::size_t id_{0};
+};
+
+/// The threads and CPU time of a thread class since osquery started.
+struct ThreadClassUsage {
+  ThreadClass thread_class{ThreadClass::Default};
+
+  /// The number of threads running.
+  std::size_t threads{0};
+
+  /// The number of threads started.
+  std::size_t started{0};
+
+  /// Milliseconds of CPU time used by the running and exited threads.
+  std::uint64_t cpu_time{0};
+};
+
+/// The usage of each thread class.
+std::vector<ThreadClassUsage> getThreadClassUsage();
+
+} // namespace osquery
@@ -7,7 +7,10 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+#include <atomic>
 #include <sstream>
+#include <thread>
 #include <utility>
 
 #include <osquery/core/flags.h>
@@ -18,6 +21,8 @@
 #include <osquery/hashing/hashing.h>
 #include <osquery/logger/logger.h>
 #include <osquery/process/process.h>
+#include <osquery/profiler/resource_usage.h>
+#include <osquery/profiler/sampling_profiler.h>
 #include <osquery/registry/registry_factory.h>
 #include <osquery/sql/sql.h>
 #include <osquery/utils/conversions/tryto.h>
@@ -48,8 +53,67 @@ FLAG(uint64,
      86400,
      "Seconds to denylist distributed queries (default 1 day)");
 
+FLAG(uint64,
+     distributed_concurrency,
+     1,
+     "Number of distributed queries of a batch to execute at the same time");
+
+FLAG(bool,
+     distributed_columnar_results,
+     false,
+     "Send the distributed query rows as lists of values after their columns");
+
 DECLARE_bool(verbose);
 
+namespace {
+
+/**
+ * @brief Serialize rows as a list of column names and lists of values
+ *
+ * Each row is a list of values in the order of the columns, a value missing
+ * from a row is null. The column names are not repeated in every row.
+ */
+void serializeColumnarQueryData(const QueryData& q,
+                                const ColumnNames& cols,
+                                JSON& doc,
+                                rj::Value& obj) {
+  auto& allocator = doc.doc().GetAllocator();
+
+  // Rows of queries without column names, e.g. denylisted, use the columns
+  // of their first row.
+  ColumnNames columns = cols;
+  if (columns.empty() && !q.empty()) {
+    for (const auto& column : q.front()) {
+      columns.push_back(column.first);
+    }
+  }
+
+  rj::Value column_list(rj::kArrayType);
+  for (const auto& column : columns) {
+    column_list.PushBack(rj::Value(column, allocator).Move(), allocator);
+  }
+
+  rj::Value row_list(rj::kArrayType);
+  for (const auto& r : q) {
+    rj::Value value_list(rj::kArrayType);
+    for (const auto& column : columns) {
+      auto it = r.find(column);
+      if (it == r.end()) {
+        value_list.PushBack(rj::Value().Move(), allocator);
+      } else {
+        // The rows outlive the document, values are referenced.
+        value_list.PushBack(rj::Value(rj::StringRef(it->second)).Move(),
+                            allocator);
+      }
+    }
+    row_list.PushBack(value_list, allocator);
+  }
+
+  obj.AddMember("columns", column_list, allocator);
+  obj.AddMember("rows", row_list, allocator);
+}
+} // namespace
+
 std::string Distributed::currentRequestId_{""};
 
 Status DistributedPlugin::call(const PluginRequest& request,
@@ -105,18 +169,43 @@ size_t Distributed::getCompletedCount() {
 }
 
 Status Distributed::serializeResults(std::string& json) {
+  // The rows of each query are serialized on their own and appended to the
+  // 'queries' object, only one query's rows are held in a document at once.
+  std::string queries = "{\"queries\":{";
+  for (const auto& result : results_) {
+    auto rows = JSON::newObject();
+    if (FLAGS_distributed_columnar_results) {
+      auto obj = rows.getObject();
+      serializeColumnarQueryData(result.results, result.columns, rows, obj);
+      rows.add(result.request.id, obj);
+    } else {
+      auto arr = rows.getArray();
+      auto s = serializeQueryData(result.results, result.columns, rows, arr);
+      if (!s.ok()) {
+        return s;
+      }
+      rows.add(result.request.id, arr);
+    }
+
+    std::string serialized;
+    auto s = rows.toString(serialized);
+    if (!s.ok()) {
+      return s;
+    }
+
+    // Append the members of the object, without its braces.
+    if (queries.back() != '{') {
+      queries += ',';
+    }
+    queries.append(serialized, 1, serialized.size() - 2);
+  }
+  queries += "},";
+
   auto doc = JSON::newObject();
-  auto queries_obj = doc.getObject();
   auto statuses_obj = doc.getObject();
   auto messages_obj = doc.getObject();
   auto stats_obj = doc.getObject();
   for (const auto& result : results_) {
-    auto arr = doc.getArray();
-    auto s = serializeQueryData(result.results, result.columns, doc, arr);
-    if (!s.ok()) {
-      return s;
-    }
-    doc.add(result.request.id, arr, queries_obj);
     doc.add(result.request.id, result.status.getCode(), statuses_obj);
     doc.add(result.request.id, result.message, messages_obj);
 
@@ -140,20 +229,31 @@ Status Distributed::serializeResults(std::string& json) {
     doc.add(result.request.id, obj, stats_obj);
   }
 
-  doc.add("queries", queries_obj);
   doc.add("statuses", statuses_obj);
   doc.add("messages", messages_obj);
   doc.add("stats", stats_obj);
-  return doc.toString(json);
+
+  std::string status_json;
+  auto s = doc.toString(status_json);
+  if (!s.ok()) {
+    return s;
+  }
+
+  // Replace the opening brace of the statuses with the queries.
+  json = std::move(queries);
+  json.append(status_json, 1, std::string::npos);
+  return Status::success();
 }
 
 void Distributed::addResult(const DistributedQueryResult& result) {
+  WriteLock lock(results_mutex_);
   results_.push_back(result);
 }
 
 Status Distributed::runQueries() {
   auto queries = getPendingQueries();
 
+  std::vector<DistributedQueryRequest> requests;
   for (const auto& query : queries) {
     auto request = popRequest(query);
 
@@ -169,34 +269,64 @@ Status Distributed::runQueries() {
       continue;
     }
 
-    if (FLAGS_verbose) {
-      VLOG(1) << "Executing distributed query: " << request.id << ": "
-              << request.query;
-    } else if (FLAGS_distributed_loginfo) {
-      LOG(INFO) << "Executing distributed query: " << request.id << ": "
-                << request.query;
-    }
-
-    // Keep track of the currently executing request
-    Distributed::setCurrentRequestId(request.id);
+    requests.push_back(std::move(request));
+  }
 
-    auto sql = monitorNonnumeric(request.id, request.query);
-    const auto ok = sql.getStatus().ok();
-    const auto& msg = ok ? "" : sql.getMessageString();
-    if (!ok) {
-      LOG(ERROR) << "Error executing distributed query: " << request.id << ": "
-                 << msg;
+  auto workers =
+      std::min<size_t>(FLAGS_distributed_concurrency, requests.size());
+  if (workers <= 1) {
+    for (const auto& request : requests) {
+      // Keep track of the currently executing request
+      Distributed::setCurrentRequestId(request.id);
+      runRequest(request);
     }
+    return flushCompleted();
+  }
 
-    setAsNotRunning(request.query);
+  // Each worker takes the next request until none are left. The current
+  // request id is not tracked, several requests are executing.
+  std::atomic<size_t> next_request{0};
+  auto L_runRequests = [this, &requests, &next_request]() {
+    for (auto i = next_request++; i < requests.size(); i = next_request++) {
+      runRequest(requests[i]);
+    }
+  };
 
-    DistributedQueryResult result(
-        request, sql.rows(), sql.columns(), sql.getStatus(), msg);
-    addResult(result);
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < workers; ++i) {
+    threads.emplace_back(L_runRequests);
+  }
+  for (auto& thread : threads) {
+    thread.join();
   }
   return flushCompleted();
 }
 
+void Distributed::runRequest(const DistributedQueryRequest& request) {
+  if (FLAGS_verbose) {
+    VLOG(1) << "Executing distributed query: " << request.id << ": "
+            << request.query;
+  } else if (FLAGS_distributed_loginfo) {
+    LOG(INFO) << "Executing distributed query: " << request.id << ": "
+              << request.query;
+  }
+
+  ProfileScope profile_scope(request.id, ProfileStage::Query);
+  auto sql = monitorNonnumeric(request.id, request.query);
+  const auto ok = sql.getStatus().ok();
+  const auto& msg = ok ? "" : sql.getMessageString();
+  if (!ok) {
+    LOG(ERROR) << "Error executing distributed query: " << request.id << ": "
+               << msg;
+  }
+
+  setAsNotRunning(request.query);
+
+  DistributedQueryResult result(
+      request, sql.rows(), sql.columns(), sql.getStatus(), msg);
+  addResult(result);
+}
+
 bool Distributed::checkAndSetAsRunning(const std::string& query) {
   std::string ts;
   const auto queryKey = hashQuery(query);
@@ -262,16 +392,14 @@ Status Distributed::flushCompleted() {
     return Status(1, "Missing distributed plugin " + distributed_plugin);
   }
 
-  std::string results;
-  auto s = serializeResults(results);
+  PluginRequest request = {{"action", "writeResults"}};
+  auto s = serializeResults(request["results"]);
   if (!s.ok()) {
     return s;
   }
 
   PluginResponse response;
-  s = Registry::call("distributed",
-                     {{"action", "writeResults"}, {"results", results}},
-                     response);
+  s = Registry::call("distributed", request, response);
   if (s.ok()) {
     results_.clear();
     performance_.clear();
@@ -381,12 +509,10 @@ void Distributed::setCurrentRequestId(const std::string& cReqId) {
 SQL Distributed::monitorNonnumeric(const std::string& name,
                                    const std::string& query) {
   // Snapshot the performance and times for the worker before running.
-  auto pid = std::to_string(PlatformProcess::getCurrentPid());
-  auto r0 = SQL::selectFrom({"resident_size", "user_time", "system_time"},
-                            "processes",
-                            "pid",
-                            EQUALS,
-                            pid);
+  // Concurrent requests are measured on their own thread.
+  auto thread = FLAGS_distributed_concurrency > 1;
+  ResourceUsage r0;
+  auto s0 = getResourceUsage(r0, thread);
 
   using namespace std::chrono;
   auto t0 = steady_clock::now();
@@ -394,16 +520,12 @@ SQL Distributed::monitorNonnumeric(const std::string& name,
 
   // Snapshot the performance after, and compare.
   auto t1 = steady_clock::now();
-  auto r1 = SQL::selectFrom({"resident_size", "user_time", "system_time"},
-                            "processes",
-                            "pid",
-                            EQUALS,
-                            pid);
-  if (r0.size() > 0 && r1.size() > 0) {
-    // Always called while processes table is working.
+  ResourceUsage r1;
+  auto s1 = getResourceUsage(r1, thread);
+  if (s0.ok() && s1.ok()) {
     uint64_t size = sql.rows().size();
     recordQueryPerformance(
-        name, duration_cast<milliseconds>(t1 - t0).count(), size, r0[0], r1[0]);
+        name, duration_cast<milliseconds>(t1 - t0).count(), size, r0, r1);
   }
   return sql;
 }
@@ -411,36 +533,22 @@ SQL Distributed::monitorNonnumeric(const std::string& name,
 void Distributed::recordQueryPerformance(const std::string& name,
                                          uint64_t delay_ms,
                                          uint64_t size,
-                                         const Row& r0,
-                                         const Row& r1) {
+                                         const ResourceUsage& r0,
+                                         const ResourceUsage& r1) {
+  WriteLock lock(results_mutex_);
   performance_[name] = QueryPerformance();
 
   auto& query = performance_.at(name);
-  if (!r1.at("user_time").empty() && !r0.at("user_time").empty()) {
-    auto ut1 = tryTo<long long>(r1.at("user_time"));
-    auto ut0 = tryTo<long long>(r0.at("user_time"));
-    auto diff = (ut1 && ut0) ? ut1.take() - ut0.take() : 0;
-    if (diff > 0) {
-      query.user_time = diff;
-    }
+  if (r1.user_time > r0.user_time) {
+    query.user_time = r1.user_time - r0.user_time;
   }
 
-  if (!r1.at("system_time").empty() && !r0.at("system_time").empty()) {
-    auto st1 = tryTo<long long>(r1.at("system_time"));
-    auto st0 = tryTo<long long>(r0.at("system_time"));
-    auto diff = (st1 && st0) ? st1.take() - st0.take() : 0;
-    if (diff > 0) {
-      query.system_time = diff;
-    }
+  if (r1.system_time > r0.system_time) {
+    query.system_time = r1.system_time - r0.system_time;
   }
 
-  if (!r1.at("resident_size").empty() && !r0.at("resident_size").empty()) {
-    auto rs1 = tryTo<long long>(r1.at("resident_size"));
-    auto rs0 = tryTo<long long>(r0.at("resident_size"));
-    auto diff = (rs1 && rs0) ? rs1.take() - rs0.take() : 0;
-    if (diff > 0) {
-      query.last_memory = diff;
-    }
+  if (r0.resident_size > 0 && r1.resident_size > r0.resident_size) {
+    query.last_memory = r1.resident_size - r0.resident_size;
   }
 
   query.wall_time_ms = delay_ms;
@@ -16,6 +16,7 @@
 #include <osquery/core/query.h>
 #include <osquery/core/sql/query_performance.h>
 #include <osquery/sql/sql.h>
+#include <osquery/utils/mutex.h>
 #include <osquery/utils/status/status.h>
 
 namespace osquery {
@@ -303,6 +304,16 @@ class Distributed {
    */
   void addResult(const DistributedQueryResult& result);
 
+  /**
+   * @brief Execute a request and queue its result
+   *
+   * Requests of a batch may execute at the same time, see the
+   * distributed_concurrency flag.
+   *
+   * @param request is a request that is not denylisted
+   */
+  void runRequest(const DistributedQueryRequest& request);
+
   /**
    * @brief Checks and sets whether the given query is marked as running.
    *
@@ -350,17 +361,20 @@ class Distributed {
    * @param name Query name, as sent by the server
    * @param delay_ms Time taken for query to run
    * @param size number of rows output
-   * @param r0 Row generated from first call to the processes table
-   * @param r1 Row generated from second call to the processes table
+   * @param r0 the worker's resource usage before the query
+   * @param r1 the worker's resource usage after the query
    */
   void recordQueryPerformance(const std::string& name,
                               uint64_t delay_ms,
                               uint64_t size,
-                              const Row& r0,
-                              const Row& r1);
+                              const ResourceUsage& r0,
+                              const ResourceUsage& r1);
 
   std::vector<DistributedQueryResult> results_;
 
+  /// Protects the results and performance of concurrently executed requests.
+  Mutex results_mutex_;
+
   // ID of the currently executing query
   static std::string currentRequestId_;
 
@@ -371,6 +385,8 @@ class Distributed {
   friend class DistributedTests;
   FRIEND_TEST(DistributedTests, test_workflow);
   FRIEND_TEST(DistributedTests, test_run_queries_with_denylisted_query);
+  FRIEND_TEST(DistributedTests, test_run_queries_concurrently);
+  FRIEND_TEST(DistributedTests, test_serialize_results);
   FRIEND_TEST(DistributedTests, test_check_and_set_as_running);
   FRIEND_TEST(DistributedTests, test_accept_work_basic);
   FRIEND_TEST(DistributedTests, test_accept_work_with_discovery);
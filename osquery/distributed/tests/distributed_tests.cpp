@@ -192,6 +192,50 @@ TEST_F(DistributedTests, test_deserialize_distributed_query_result_json) {
   EXPECT_EQ(r.results[0]["foo"], "bar");
 }
 
+TEST_F(DistributedTests, test_serialize_results) {
+  auto dist = Distributed();
+
+  DistributedQueryRequest request;
+  request.id = "q\"1";
+  request.query = "SELECT 1;";
+  dist.addResult(DistributedQueryResult(
+      request, {{{"a", "1"}}, {{"a", "2"}}}, {}, Status::success(), ""));
+
+  request.id = "q2";
+  dist.addResult(
+      DistributedQueryResult(request, {}, {}, Status(1, "Failed"), "error"));
+
+  std::string json;
+  ASSERT_TRUE(dist.serializeResults(json).ok());
+
+  auto doc = JSON::newObject();
+  ASSERT_TRUE(doc.fromString(json).ok()) << json;
+  const auto& results = doc.doc();
+  ASSERT_TRUE(results["queries"].IsObject());
+  ASSERT_EQ(results["queries"]["q\"1"].Size(), 2U);
+  EXPECT_EQ(std::string(results["queries"]["q\"1"][1]["a"].GetString()), "2");
+  EXPECT_EQ(results["queries"]["q2"].Size(), 0U);
+  EXPECT_EQ(results["statuses"]["q\"1"].GetInt(), 0);
+  EXPECT_EQ(results["statuses"]["q2"].GetInt(), 1);
+  EXPECT_EQ(std::string(results["messages"]["q2"].GetString()), "error");
+  EXPECT_TRUE(results["stats"].IsObject());
+
+  // The columnar form lists the columns once.
+  Flag::updateValue("distributed_columnar_results", "true");
+  auto status = dist.serializeResults(json);
+  Flag::updateValue("distributed_columnar_results", "false");
+  ASSERT_TRUE(status.ok());
+
+  doc = JSON::newObject();
+  ASSERT_TRUE(doc.fromString(json).ok()) << json;
+  const auto& columnar = doc.doc()["queries"]["q\"1"];
+  ASSERT_EQ(columnar["columns"].Size(), 1U);
+  EXPECT_EQ(std::string(columnar["columns"][0].GetString()), "a");
+  ASSERT_EQ(columnar["rows"].Size(), 2U);
+  EXPECT_EQ(std::string(columnar["rows"][1][0].GetString()), "2");
+  EXPECT_EQ(doc.doc()["queries"]["q2"]["rows"].Size(), 0U);
+}
+
 TEST_F(DistributedTests, test_workflow) {
   ASSERT_TRUE(startServer());
 
@@ -343,6 +387,43 @@ TEST_F(DistributedTests, test_run_queries_with_denylisted_query) {
   ASSERT_TRUE(ts2.empty());
 }
 
+TEST_F(DistributedTests, test_run_queries_concurrently) {
+  auto dist = DistributedMock();
+  EXPECT_CALL(dist, flushCompleted).Times(1);
+
+  const std::string work = R"json(
+{
+  "queries": {
+    "q1": "SELECT 1 AS value;",
+    "q2": "SELECT 2 AS value;",
+    "q3": "SELECT * FROM no_such_table;"
+  }
+}
+)json";
+  auto status = dist.acceptWork(work);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+
+  auto concurrency = Flag::getValue("distributed_concurrency");
+  Flag::updateValue("distributed_concurrency", "4");
+  status = dist.runQueries();
+  Flag::updateValue("distributed_concurrency", concurrency);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+
+  ASSERT_EQ(dist.results_.size(), 3U);
+  for (const auto& result : dist.results_) {
+    if (result.request.id == "q3") {
+      EXPECT_FALSE(result.status.ok());
+      continue;
+    }
+
+    EXPECT_TRUE(result.status.ok());
+    ASSERT_EQ(result.results.size(), 1U);
+    EXPECT_EQ(result.results[0].at("value"),
+              result.request.id == "q1" ? "1" : "2");
+  }
+  EXPECT_TRUE(dist.getPendingQueries().empty());
+}
+
 TEST_F(DistributedTests, test_accept_work_basic) {
   auto dist = Distributed();
 
@@ -0,0 +1,273 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <thread>
+
+#include <osquery/core/flags.h>
+#include <osquery/events/linux/audit_capture.h>
+#include <osquery/events/linux/auditdnetlink.h>
+#include <osquery/events/linux/auditeventpublisher.h>
+#include <osquery/tables/events/linux/process_events.h>
+
+namespace osquery {
+
+DECLARE_int32(audit_backlog_limit);
+
+namespace {
+
+/// The records the parser receives at once, as read from the netlink.
+const std::size_t kReplayReadBatch{1024U};
+
+/// The audit events of the generated capture, and their spacing.
+const std::size_t kGeneratedEvents{20000U};
+const std::uint64_t kGeneratedEventSpacingUs{50U};
+
+/**
+ * @brief Generate a capture of execve events, as a busy build host sends.
+ *
+ * Each event is a SYSCALL, EXECVE, CWD, two PATH and an EOE record, 20000
+ * events per second.
+ */
+std::vector<AuditCaptureRecord> generateExecveCapture() {
+  std::vector<AuditCaptureRecord> records;
+  records.reserve(kGeneratedEvents * 6U);
+
+  const std::uint64_t base_time = 1502125323U;
+  for (std::size_t i = 0U; i < kGeneratedEvents; ++i) {
+    auto offset = i * kGeneratedEventSpacingUs;
+    auto seconds = base_time + offset / 1000000U;
+    auto preamble = "audit(" + std::to_string(seconds) + "." +
+                    std::to_string(offset / 1000U % 1000U + 1000U).substr(1) +
+                    ":" + std::to_string(i + 1U) + "): ";
+    auto pid = std::to_string(1000U + i % 30000U);
+
+    records.push_back(
+        {offset,
+         1300,
+         preamble + "arch=c000003e syscall=59 success=yes exit=0 "
+                    "a0=23eb8e0 a1=23ebbc0 a2=23c9860 a3=7ffe18d32ed0 "
+                    "items=2 ppid=6882 pid=" +
+             pid +
+             " auid=1000 uid=1000 gid=1000 euid=1000 suid=1000 fsuid=1000 "
+             "egid=1000 sgid=1000 fsgid=1000 tty=pts1 ses=2 comm=\"cc\" "
+             "exe=\"/usr/bin/cc\" key=(null)"});
+    records.push_back(
+        {offset, 1309, preamble + "argc=3 a0=\"cc\" a1=\"-c\" a2=\"main.c\""});
+    records.push_back({offset, 1307, preamble + "cwd=\"/home/build/src\""});
+    records.push_back({offset,
+                       1302,
+                       preamble + "item=0 name=\"/usr/bin/cc\" inode=18867 "
+                                  "dev=fd:00 mode=0100755 ouid=0 ogid=0 "
+                                  "rdev=00:00 nametype=NORMAL"});
+    records.push_back({offset,
+                       1302,
+                       preamble + "item=1 name=\"/lib64/ld-linux-x86-64.so.2\" "
+                                  "inode=33604032 dev=fd:00 mode=0100755 "
+                                  "ouid=0 ogid=0 rdev=00:00 nametype=NORMAL"});
+    records.push_back({offset, 1320, preamble});
+  }
+  return records;
+}
+
+/**
+ * @brief The capture replayed by the benchmarks.
+ *
+ * Set OSQUERY_AUDIT_CAPTURE to a file recorded with --audit_capture_path to
+ * replay a production host, a generated capture is used otherwise.
+ */
+const std::vector<AuditCaptureRecord>& replayCapture() {
+  static const auto records = []() {
+    std::vector<AuditCaptureRecord> records;
+    const char* path = std::getenv("OSQUERY_AUDIT_CAPTURE");
+    if (path != nullptr) {
+      auto status = readAuditCapture(path, records);
+      if (!status.ok()) {
+        std::cerr << status.getMessage() << "\n";
+        records.clear();
+      }
+    }
+    return records.empty() ? generateExecveCapture() : records;
+  }();
+  return records;
+}
+
+/// The counters of one replay.
+struct ReplayStats final {
+  std::uint64_t records{0U};
+  std::uint64_t events{0U};
+  std::uint64_t rows{0U};
+
+  /// Records lost to a full backlog, and records that did not parse.
+  std::uint64_t dropped{0U};
+  std::uint64_t malformed{0U};
+
+  /// Incomplete events expired by the trace context.
+  std::uint64_t expired{0U};
+
+  /// The time spent in each stage.
+  std::chrono::nanoseconds parse{0};
+  std::chrono::nanoseconds aggregate{0};
+  std::chrono::nanoseconds subscribe{0};
+
+  /// The largest delay between a record's arrival and its parsing.
+  std::chrono::microseconds lag_max{0};
+};
+
+/**
+ * @brief Replay a capture through the audit parser, publisher and the
+ * process events subscriber.
+ *
+ * Records arrive at their recorded offsets divided by the speed, a speed of
+ * 0 delivers them all at once. Arrived records wait in a backlog of
+ * --audit_backlog_limit records, as they do in the kernel, records arriving
+ * while it is full are dropped.
+ */
+void replay(const std::vector<AuditCaptureRecord>& capture,
+            std::int64_t speed,
+            ReplayStats& stats) {
+  using Clock = std::chrono::steady_clock;
+
+  static const std::set<int> kSyscallsAllowedToFail{};
+  auto backlog_limit =
+      static_cast<std::size_t>(std::max(FLAGS_audit_backlog_limit, 1));
+
+  AuditTraceContext trace_context;
+  std::deque<std::size_t> backlog;
+  std::vector<AuditEventRecord> records;
+  std::vector<Row> rows;
+  audit_reply reply{};
+
+  auto start = Clock::now();
+  std::size_t arrived = 0U;
+  while (arrived < capture.size() || !backlog.empty()) {
+    auto due = capture.size();
+    std::chrono::microseconds elapsed{0};
+    if (speed > 0) {
+      elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                    Clock::now() - start) *
+                speed;
+      due = static_cast<std::size_t>(
+          std::upper_bound(capture.begin() + arrived,
+                           capture.end(),
+                           static_cast<std::uint64_t>(elapsed.count()),
+                           [](std::uint64_t offset,
+                              const AuditCaptureRecord& record) {
+                             return offset < record.offset_us;
+                           }) -
+          capture.begin());
+
+      if (due == arrived && backlog.empty()) {
+        auto next = std::chrono::microseconds(capture[arrived].offset_us);
+        std::this_thread::sleep_for((next - elapsed) / speed);
+        continue;
+      }
+    }
+
+    for (; arrived < due; ++arrived) {
+      if (speed > 0 && backlog.size() >= backlog_limit) {
+        ++stats.dropped;
+      } else {
+        backlog.push_back(arrived);
+      }
+    }
+
+    if (speed > 0 && !backlog.empty()) {
+      auto waiting = elapsed - std::chrono::microseconds(
+                                   capture[backlog.front()].offset_us);
+      stats.lag_max = std::max(stats.lag_max, waiting / speed);
+    }
+
+    auto parse_start = Clock::now();
+    records.clear();
+    for (std::size_t i = 0U; i < kReplayReadBatch && !backlog.empty(); ++i) {
+      makeAuditReply(capture[backlog.front()], reply);
+      backlog.pop_front();
+      ++stats.records;
+
+      AuditEventRecord record;
+      if (AuditdNetlinkParser::ParseAuditReply(reply, record)) {
+        records.push_back(std::move(record));
+      } else {
+        ++stats.malformed;
+      }
+    }
+
+    auto aggregate_start = Clock::now();
+    auto event_context = std::make_shared<AuditEventContext>();
+    AuditEventPublisher::ProcessEvents(
+        event_context, records, trace_context, kSyscallsAllowedToFail);
+    if (!records.empty()) {
+      trace_context.expire(static_cast<std::time_t>(records.back().time));
+    }
+
+    auto subscribe_start = Clock::now();
+    rows.clear();
+    AuditProcessEventSubscriber::ProcessEvents(rows,
+                                               event_context->audit_events);
+    auto subscribe_end = Clock::now();
+
+    stats.events += event_context->audit_events.size();
+    stats.rows += rows.size();
+    stats.parse += aggregate_start - parse_start;
+    stats.aggregate += subscribe_start - aggregate_start;
+    stats.subscribe += subscribe_end - subscribe_start;
+  }
+
+  stats.expired += trace_context.expiredEventCount();
+}
+
+} // namespace
+
+/// Replay the capture at a multiple of its recorded rate, 0 for unpaced.
+static void EVENTS_audit_replay(benchmark::State& state) {
+  const auto& capture = replayCapture();
+  auto speed = static_cast<std::int64_t>(state.range(0));
+
+  ReplayStats stats;
+  while (state.KeepRunning()) {
+    replay(capture, speed, stats);
+  }
+
+  auto per_record = [&stats](std::chrono::nanoseconds stage) {
+    return stats.records == 0U ? 0.0
+                               : static_cast<double>(stage.count()) /
+                                     static_cast<double>(stats.records);
+  };
+
+  state.counters["events_per_s"] = benchmark::Counter(
+      static_cast<double>(stats.events), benchmark::Counter::kIsRate);
+  state.counters["records_per_s"] = benchmark::Counter(
+      static_cast<double>(stats.records), benchmark::Counter::kIsRate);
+  state.counters["rows"] = static_cast<double>(stats.rows);
+  state.counters["dropped"] = static_cast<double>(stats.dropped);
+  state.counters["malformed"] = static_cast<double>(stats.malformed);
+  state.counters["expired"] = static_cast<double>(stats.expired);
+  state.counters["parse_ns"] = per_record(stats.parse);
+  state.counters["aggregate_ns"] = per_record(stats.aggregate);
+  state.counters["subscribe_ns"] = per_record(stats.subscribe);
+  state.counters["lag_max_ms"] =
+      static_cast<double>(stats.lag_max.count()) / 1000.0;
+}
+
+BENCHMARK(EVENTS_audit_replay)
+    ->Arg(0)
+    ->Arg(1)
+    ->Arg(10)
+    ->Arg(100)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+} // namespace osquery
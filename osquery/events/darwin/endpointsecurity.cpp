@@ -9,6 +9,8 @@
 
 #include <iomanip>
 
+#include <boost/algorithm/string/classification.hpp>
+#include <boost/algorithm/string/split.hpp>
 #include <osquery/core/flags.h>
 #include <osquery/events/darwin/endpointsecurity.h>
 #include <osquery/events/darwin/es_utils.h>
@@ -18,9 +20,48 @@
 namespace osquery {
 
 DECLARE_bool(disable_endpointsecurity);
+DECLARE_string(es_process_mute_path_literal);
+DECLARE_string(es_process_mute_path_prefix);
+DECLARE_uint32(es_process_mute_suggestion_rate);
+DECLARE_bool(es_process_auto_mute);
+DECLARE_uint32(es_process_event_queue_max);
 
 REGISTER(EndpointSecurityPublisher, "event_publisher", "endpointsecurity")
 
+namespace {
+
+/// Events are counted per process path over this window.
+const auto kMuteSuggestionWindow = std::chrono::minutes(1);
+
+/// How long the run loop waits for messages before returning.
+const auto kMessageQueueWait = std::chrono::seconds(1);
+
+const es_message_t* retainMessage(const es_message_t* message)
+    API_AVAILABLE(macos(10.15)) {
+  if (__builtin_available(macos 11.0, *)) {
+    es_retain_message(message);
+    return message;
+  }
+  return es_copy_message(message);
+}
+
+void releaseMessage(const es_message_t* message) API_AVAILABLE(macos(10.15)) {
+  if (__builtin_available(macos 11.0, *)) {
+    es_release_message(message);
+  } else {
+    es_free_message(const_cast<es_message_t*>(message));
+  }
+}
+
+std::vector<std::string> splitPaths(const std::string& paths) {
+  std::vector<std::string> list;
+  if (!paths.empty()) {
+    boost::split(list, paths, boost::is_any_of(","));
+  }
+  return list;
+}
+} // namespace
+
 Status EndpointSecurityPublisher::setUp() {
   if (__builtin_available(macos 10.15, *)) {
     if (FLAGS_disable_endpointsecurity) {
@@ -29,13 +70,14 @@ Status EndpointSecurityPublisher::setUp() {
     }
 
     auto handler = ^(es_client_t* client, const es_message_t* message) {
-      handleMessage(message);
+      enqueueMessage(message);
     };
 
     auto result = es_new_client(&es_client_, handler);
 
     if (result == ES_NEW_CLIENT_RESULT_SUCCESS) {
       es_client_success_ = true;
+      rate_window_start_ = std::chrono::steady_clock::now();
       return Status::success();
     } else {
       return Status::failure(1, getEsNewClientErrorMessage(result));
@@ -57,6 +99,30 @@ void EndpointSecurityPublisher::configure() {
     return;
   }
 
+  for (const auto& p : splitPaths(FLAGS_es_process_mute_path_literal)) {
+    es_return_t rc;
+    if (__builtin_available(macos 13.0, *)) {
+      rc = es_mute_path(es_client_, p.c_str(), ES_MUTE_PATH_TYPE_LITERAL);
+    } else {
+      rc = es_mute_path_literal(es_client_, p.c_str());
+    }
+    if (rc == ES_RETURN_ERROR) {
+      VLOG(1) << "Unable to mute process path literal: " << p;
+    }
+  }
+
+  for (const auto& p : splitPaths(FLAGS_es_process_mute_path_prefix)) {
+    es_return_t rc;
+    if (__builtin_available(macos 13.0, *)) {
+      rc = es_mute_path(es_client_, p.c_str(), ES_MUTE_PATH_TYPE_PREFIX);
+    } else {
+      rc = es_mute_path_prefix(es_client_, p.c_str());
+    }
+    if (rc == ES_RETURN_ERROR) {
+      VLOG(1) << "Unable to mute process path with prefix: " << p;
+    }
+  }
+
   for (auto& sub : subscriptions_) {
     auto sc = getSubscriptionContext(sub->context);
     auto events = sc->es_event_subscriptions_;
@@ -80,6 +146,104 @@ void EndpointSecurityPublisher::tearDown() {
     }
     es_client_ = nullptr;
   }
+
+  // No callback runs once the client is deleted
+  clearMessageQueue();
+}
+
+void EndpointSecurityPublisher::enqueueMessage(const es_message_t* message) {
+  if (message == nullptr || message->action_type == ES_ACTION_TYPE_AUTH) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(message_queue_mutex_);
+    if (message_queue_.size() >= FLAGS_es_process_event_queue_max) {
+      dropped_messages_++;
+      return;
+    }
+    message_queue_.push_back(retainMessage(message));
+  }
+  message_queue_cv_.notify_one();
+}
+
+void EndpointSecurityPublisher::clearMessageQueue() {
+  std::lock_guard<std::mutex> lock(message_queue_mutex_);
+  for (auto message : message_queue_) {
+    releaseMessage(message);
+  }
+  message_queue_.clear();
+}
+
+Status EndpointSecurityPublisher::run() {
+  std::vector<const es_message_t*> messages;
+  size_t dropped = 0;
+  {
+    std::unique_lock<std::mutex> lock(message_queue_mutex_);
+    message_queue_cv_.wait_for(lock, kMessageQueueWait, [this] {
+      return !message_queue_.empty();
+    });
+    messages.swap(message_queue_);
+    std::swap(dropped, dropped_messages_);
+  }
+
+  if (dropped > 0) {
+    VLOG(1) << "EndpointSecurity message queue was full, dropped " << dropped
+            << " events";
+    recordDroppedEvents(dropped);
+  }
+
+  for (auto message : messages) {
+    countMessage(message);
+    handleMessage(message);
+    releaseMessage(message);
+  }
+
+  checkMuteSuggestions();
+  return Status::success();
+}
+
+void EndpointSecurityPublisher::countMessage(const es_message_t* message) {
+  if (FLAGS_es_process_mute_suggestion_rate == 0) {
+    return;
+  }
+
+  auto& rate = process_rates_[getPath(message->process)];
+  rate.events++;
+  rate.audit_token = message->process->audit_token;
+}
+
+void EndpointSecurityPublisher::checkMuteSuggestions() {
+  auto now = std::chrono::steady_clock::now();
+  if (now - rate_window_start_ < kMuteSuggestionWindow) {
+    return;
+  }
+  rate_window_start_ = now;
+
+  for (const auto& rate : process_rates_) {
+    const auto& path = rate.first;
+    if (rate.second.events <= FLAGS_es_process_mute_suggestion_rate ||
+        path.empty()) {
+      continue;
+    }
+
+    if (FLAGS_es_process_auto_mute && es_client_ != nullptr) {
+      // Only this process is muted, a restarted one is measured again
+      if (es_mute_process(es_client_, &rate.second.audit_token) ==
+          ES_RETURN_SUCCESS) {
+        VLOG(1) << "Muted EndpointSecurity events of " << path << " after "
+                << rate.second.events << " events in a minute";
+      }
+    }
+
+    if (suggested_mutes_.insert(path).second) {
+      LOG(INFO) << "EndpointSecurity process " << path << " generated "
+                << rate.second.events
+                << " events in a minute, consider adding it to "
+                   "--es_process_mute_path_literal";
+    }
+  }
+  process_rates_.clear();
 }
 
 void EndpointSecurityPublisher::handleMessage(const es_message_t* message) {
@@ -150,7 +314,7 @@ void EndpointSecurityPublisher::handleMessage(const es_message_t* message) {
     break;
   }
 
-  EventFactory::fire<EndpointSecurityPublisher>(ec);
+  fire(ec);
 }
 
 bool EndpointSecurityPublisher::shouldFire(
@@ -14,6 +14,13 @@
 #include <libproc.h>
 #include <os/availability.h>
 
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
 #include <osquery/core/flags.h>
 #include <osquery/core/plugins/plugin.h>
 #include <osquery/events/eventpublisher.h>
@@ -121,9 +128,8 @@ class EndpointSecurityPublisher
 
   void tearDown() override API_AVAILABLE(macos(10.15));
 
-  Status run() override API_AVAILABLE(macos(10.15)) {
-    return Status::success();
-  }
+  /// Process the messages queued by the EndpointSecurity callback.
+  Status run() override API_AVAILABLE(macos(10.15));
 
   bool shouldFire(const EndpointSecuritySubscriptionContextRef& sc,
                   const EndpointSecurityEventContextRef& ec) const override
@@ -134,12 +140,40 @@ class EndpointSecurityPublisher
   }
 
  public:
-  static void handleMessage(const es_message_t* message)
-      API_AVAILABLE(macos(10.15));
+  /// Build and fire the event context of a message.
+  void handleMessage(const es_message_t* message) API_AVAILABLE(macos(10.15));
+
+ private:
+  /// Keep a message for the run loop, the callback must return quickly.
+  void enqueueMessage(const es_message_t* message) API_AVAILABLE(macos(10.15));
+
+  /// Count events per process path, suggest or apply mutes for noisy ones.
+  void countMessage(const es_message_t* message) API_AVAILABLE(macos(10.15));
+  void checkMuteSuggestions() API_AVAILABLE(macos(10.15));
+
+  /// Release the queued messages that were not processed.
+  void clearMessageQueue() API_AVAILABLE(macos(10.15));
 
  private:
   es_client_s* es_client_{nullptr};
   bool es_client_success_{false};
+
+  /// Messages retained by the EndpointSecurity callback.
+  std::vector<const es_message_t*> message_queue_;
+  size_t dropped_messages_{0};
+  std::mutex message_queue_mutex_;
+  std::condition_variable message_queue_cv_;
+
+  /// Events of a process path, and its last process, in the rate window.
+  struct ProcessRate {
+    size_t events{0};
+    audit_token_t audit_token;
+  };
+  std::unordered_map<std::string, ProcessRate> process_rates_;
+  std::chrono::steady_clock::time_point rate_window_start_;
+
+  /// Paths already suggested for muting, each is only reported once.
+  std::set<std::string> suggested_mutes_;
 };
 
 class EndpointSecurityFileEventPublisher
@@ -40,6 +40,31 @@ FLAG(string,
 // document performance issues
 FLAG(bool, es_fim_enable_open_events, false, "Enable open events");
 
+FLAG(string,
+     es_process_mute_path_literal,
+     "",
+     "Comma delimited list of process paths muted for process events");
+
+FLAG(string,
+     es_process_mute_path_prefix,
+     "",
+     "Comma delimited list of process path prefixes muted for process events");
+
+FLAG(uint32,
+     es_process_mute_suggestion_rate,
+     0,
+     "Suggest muting processes generating more events per minute (0 disables)");
+
+FLAG(bool,
+     es_process_auto_mute,
+     false,
+     "Mute processes exceeding es_process_mute_suggestion_rate");
+
+FLAG(uint32,
+     es_process_event_queue_max,
+     16384,
+     "Most EndpointSecurity messages queued for processing");
+
 std::string getEsNewClientErrorMessage(const es_new_client_result_t r) {
   switch (r) {
   case ES_NEW_CLIENT_RESULT_ERR_INTERNAL:
@@ -7,7 +7,9 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
-#include <fnmatch.h>
+#include <algorithm>
+#include <atomic>
+#include <unordered_map>
 
 #include <boost/filesystem.hpp>
 
@@ -36,6 +38,21 @@ namespace osquery {
 
 DECLARE_bool(enable_file_events);
 
+FLAG(uint32,
+     fsevents_latency,
+     1000,
+     "Milliseconds FSEvents collects file events before delivering them");
+
+FLAG(bool,
+     fsevents_coalesce,
+     false,
+     "Merge the FSEvents events of a path delivered together");
+
+FLAG(uint32,
+     fsevents_burst_limit,
+     0,
+     "Maximum FSEvents events fired per category for a delivery (0 = none)");
+
 std::map<FSEventStreamEventFlags, std::string> kMaskActions = {
     {kFSEventStreamEventFlagItemChangeOwner, "ATTRIBUTES_MODIFIED"},
     {kFSEventStreamEventFlagItemXattrMod, "ATTRIBUTES_MODIFIED"},
@@ -98,13 +115,14 @@ void FSEventsEventPublisher::restart() {
     flags |= kFSEventStreamCreateFlagIgnoreSelf;
   }
 
-  // Create the FSEvent stream.
+  // Create the FSEvent stream, events are delivered after the latency.
+  // With coalescing, the latency is the window events of a path merge within.
   stream_ = FSEventStreamCreate(nullptr,
                                 &FSEventsEventPublisher::Callback,
                                 nullptr,
                                 watch_list,
                                 kFSEventStreamEventIdSinceNow,
-                                1,
+                                FLAGS_fsevents_latency / 1000.0,
                                 flags);
   if (stream_ != nullptr) {
     // Schedule the stream on the run loop.
@@ -200,7 +218,8 @@ void FSEventsEventPublisher::buildExcludePathsSet() {
   auto parser = Config::getParser("file_paths");
 
   WriteLock lock(subscription_lock_);
-  exclude_paths_.clear();
+  // This also drops the subscription paths, a configure adds them again.
+  path_matcher_.clear();
 
   const auto& doc = parser->getData();
   if (!doc.doc().HasMember("exclude_paths")) {
@@ -213,7 +232,7 @@ void FSEventsEventPublisher::buildExcludePathsSet() {
       if (pattern.empty()) {
         continue;
       }
-      exclude_paths_.insert(pattern);
+      path_matcher_.exclude(pattern);
     }
   }
 }
@@ -233,11 +252,19 @@ void FSEventsEventPublisher::configure() {
     paths_.clear();
     for (auto& sub : subscriptions_) {
       auto sc = getSubscriptionContext(sub->context);
-      if (sc->discovered_.size() > 0) {
-        continue;
+      if (sc->discovered_.empty()) {
+        auto paths = transformSubscription(sc);
+        paths_.insert(paths.begin(), paths.end());
       }
-      auto paths = transformSubscription(sc);
-      paths_.insert(paths.begin(), paths.end());
+
+      // A transformed path matches events as the glob "path*", recursive
+      // subscriptions also match everything below.
+      path_matcher_.insert(
+          sc->path + "*",
+          (sc->recursive)
+              ? PathMatcher<FSEventsSubscriptionContextRef>::kRecursive
+              : 0,
+          sc);
     }
   }
 
@@ -276,13 +303,12 @@ void FSEventsEventPublisher::Callback(
     void* event_paths,
     const FSEventStreamEventFlags fsevent_flags[],
     const FSEventStreamEventId fsevent_ids[]) {
-  for (size_t i = 0; i < num_events; ++i) {
-    auto ec = createEventContext();
-    ec->fsevent_stream = stream;
-    ec->fsevent_flags = fsevent_flags[i];
-    ec->transaction_id = fsevent_ids[i];
-    ec->path = std::string(((char**)event_paths)[i]);
+  static std::atomic<size_t> batches{0};
+  auto paths = static_cast<const char* const*>(event_paths);
+  auto contexts = createEventContexts(
+      stream, ++batches, num_events, paths, fsevent_flags, fsevent_ids);
 
+  for (auto& ec : contexts) {
     if (ec->fsevent_flags & kFSEventStreamEventFlagMustScanSubDirs) {
       // The FSEvents thread coalesced events within and will report a root.
       TLOG << "FSEvents collision, root: " << ec->path;
@@ -307,8 +333,15 @@ void FSEventsEventPublisher::Callback(
 
     // Record the string-version of the first matched mask bit.
     bool has_action = false;
+    std::set<std::string> fired_actions;
     for (const auto& action : kMaskActions) {
       if (ec->fsevent_flags & action.first) {
+        // A coalesced event fires each of its merged actions once.
+        if (FLAGS_fsevents_coalesce &&
+            !fired_actions.insert(action.second).second) {
+          continue;
+        }
+
         // Actions may be multiplexed. Fire and event for each.
         ec->action = action.second;
         EventFactory::fire<FSEventsEventPublisher>(ec);
@@ -324,37 +357,89 @@ void FSEventsEventPublisher::Callback(
   }
 }
 
-bool FSEventsEventPublisher::shouldFire(
+std::vector<FSEventsEventContextRef>
+FSEventsEventPublisher::createEventContexts(
+    ConstFSEventStreamRef stream,
+    size_t batch,
+    size_t num_events,
+    const char* const* event_paths,
+    const FSEventStreamEventFlags fsevent_flags[],
+    const FSEventStreamEventId fsevent_ids[]) {
+  std::vector<FSEventsEventContextRef> contexts;
+  std::unordered_map<std::string, size_t> positions;
+  for (size_t i = 0; i < num_events; ++i) {
+    std::string path(event_paths[i]);
+    if (FLAGS_fsevents_coalesce) {
+      auto position = positions.find(path);
+      if (position != positions.end()) {
+        auto& ec = contexts[position->second];
+        ec->fsevent_flags |= fsevent_flags[i];
+        ec->transaction_id = std::max(ec->transaction_id, fsevent_ids[i]);
+        continue;
+      }
+      positions[path] = contexts.size();
+    }
+
+    auto ec = createEventContext();
+    ec->fsevent_stream = stream;
+    ec->fsevent_flags = fsevent_flags[i];
+    ec->transaction_id = fsevent_ids[i];
+    ec->path = std::move(path);
+    ec->batch_ = batch;
+    contexts.push_back(std::move(ec));
+  }
+  return contexts;
+}
+
+bool FSEventsEventPublisher::withinBurstLimit(
     const FSEventsSubscriptionContextRef& sc,
     const FSEventsEventContextRef& ec) const {
-  if (sc->recursive && !sc->recursive_match) {
-    ssize_t found = ec->path.find(sc->path);
-    if (found != 0) {
-      return false;
+  if (FLAGS_fsevents_burst_limit == 0) {
+    return true;
+  }
+
+  // Subscribers are fired on the run loop thread, one batch at a time.
+  if (ec->batch_ != burst_batch_) {
+    if (burst_dropped_ > 0) {
+      LOG(WARNING) << "Dropped " << burst_dropped_
+                   << " FSEvents events over the burst limit of "
+                   << FLAGS_fsevents_burst_limit;
     }
-  } else if (fnmatch((sc->path + "*").c_str(),
-                     ec->path.c_str(),
-                     FNM_PATHNAME | FNM_CASEFOLD |
-                         ((sc->recursive_match) ? FNM_LEADING_DIR : 0)) != 0) {
-    // Only apply a leading-dir match if this is a recursive watch with a
-    // match requirement (an inline wildcard with ending recursive wildcard).
-    return false;
+    burst_batch_ = ec->batch_;
+    burst_fired_.clear();
+    burst_dropped_ = 0;
   }
 
-  if (sc->mask != 0 && !(ec->fsevent_flags & sc->mask)) {
-    // Compare the event context mask to the subscription context.
+  auto& fired = burst_fired_[sc->category];
+  if (fired >= FLAGS_fsevents_burst_limit) {
+    burst_dropped_++;
     return false;
   }
+  fired++;
+  return true;
+}
+
+bool FSEventsEventPublisher::shouldFire(
+    const FSEventsSubscriptionContextRef& sc,
+    const FSEventsEventContextRef& ec) const {
+  // The path is matched against all subscriptions, and the excluded paths,
+  // once when the event is fired to the first subscription.
+  if (!ec->matched_ || ec->matched_path_ != ec->path) {
+    ec->subscriptions_ = path_matcher_.match(ec->path);
+    ec->matched_path_ = ec->path;
+    ec->matched_ = true;
+  }
 
-  auto path = ec->path.substr(0, ec->path.rfind('/'));
-  // Need to have two finds,
-  // what if somebody excluded an individual file inside a directory
-  if (!exclude_paths_.empty() &&
-      (exclude_paths_.find(path) || exclude_paths_.find(ec->path))) {
+  if (std::find(ec->subscriptions_.begin(), ec->subscriptions_.end(), sc) ==
+      ec->subscriptions_.end()) {
     return false;
   }
 
-  return true;
+  if (sc->mask != 0 && !(ec->fsevent_flags & sc->mask)) {
+    // Compare the event context mask to the subscription context.
+    return false;
+  }
+  return withinBurstLimit(sc, ec);
 }
 
 void FSEventsEventPublisher::flush(bool async) {
@@ -64,6 +64,9 @@ struct FSEventsSubscriptionContext : public SubscriptionContext {
   friend class FSEventsEventPublisher;
 };
 
+using FSEventsSubscriptionContextRef =
+    std::shared_ptr<FSEventsSubscriptionContext>;
+
 struct FSEventsEventContext : public EventContext {
  public:
   ConstFSEventStreamRef fsevent_stream{nullptr};
@@ -72,13 +75,25 @@ struct FSEventsEventContext : public EventContext {
 
   std::string path;
   std::string action;
+
+ private:
+  /// Subscriptions matching the path, matched once for every subscription.
+  std::vector<FSEventsSubscriptionContextRef> subscriptions_;
+
+  /// The path the subscriptions were matched for.
+  std::string matched_path_;
+
+  /// The subscriptions were matched.
+  bool matched_{false};
+
+  /// The stream callback, the batch, this event was delivered in.
+  size_t batch_{0};
+
+ private:
+  friend class FSEventsEventPublisher;
 };
 
 using FSEventsEventContextRef = std::shared_ptr<FSEventsEventContext>;
-using FSEventsSubscriptionContextRef =
-    std::shared_ptr<FSEventsSubscriptionContext>;
-
-using ExcludePathSet = PathSet<patternedPath>;
 
 /**
  * @brief An osquery EventPublisher for the Apple FSEvents notification API.
@@ -110,6 +125,21 @@ class FSEventsEventPublisher
                        const FSEventStreamEventFlags fsevent_flags[],
                        const FSEventStreamEventId fsevent_ids[]);
 
+  /**
+   * @brief Create the event contexts of a batch delivered to the callback.
+   *
+   * With fsevents_coalesce, the events of a path within the batch are merged
+   * into one context, ordered by the first event of the path. The flags of
+   * the events are merged, and the latest transaction is kept.
+   */
+  static std::vector<FSEventsEventContextRef> createEventContexts(
+      ConstFSEventStreamRef fsevent_stream,
+      size_t batch,
+      size_t num_events,
+      const char* const* event_paths,
+      const FSEventStreamEventFlags fsevent_flags[],
+      const FSEventStreamEventId fsevent_ids[]);
+
   FSEventsEventPublisher(const std::string& name = "FSEventsEventPublisher")
       : EventPublisher() {
     runnable_name_ = name;
@@ -153,6 +183,10 @@ class FSEventsEventPublisher
   /// Count the number of subscriptioned paths.
   size_t numSubscriptionedPaths() const;
 
+  /// Apply fsevents_burst_limit to the events a batch fires for a category.
+  bool withinBurstLimit(const FSEventsSubscriptionContextRef& sc,
+                        const FSEventsEventContextRef& ec) const;
+
  private:
   /// Local reference to the start, stop, restart event stream.
   FSEventStreamRef stream_{nullptr};
@@ -163,8 +197,13 @@ class FSEventsEventPublisher
   /// Set of paths to monitor, determined by a configure step.
   std::set<std::string> paths_;
 
-  /// Events pertaining to these paths not to be propagated.
-  ExcludePathSet exclude_paths_;
+  /**
+   * @brief The subscription paths, and paths not to be propagated.
+   *
+   * Every subscription and exclude pattern is merged into one case-insensitive
+   * matcher, so an event path is matched once instead of for each subscription.
+   */
+  PathMatcher<FSEventsSubscriptionContextRef> path_matcher_{true};
 
   /// Reference to the run loop for this thread.
   CFRunLoopRef run_loop_{nullptr};
@@ -179,6 +218,15 @@ class FSEventsEventPublisher
   /// Access to watched path set.
   mutable Mutex mutex_;
 
+  /// The batch the burst counts are for.
+  mutable size_t burst_batch_{0};
+
+  /// The events fired for each category within the batch.
+  mutable std::map<std::string, size_t> burst_fired_;
+
+  /// The events not fired within the batch, over the burst limit.
+  mutable size_t burst_dropped_{0};
+
  private:
   friend class FSEventsTests;
   FRIEND_TEST(FSEventsTests, test_register_event_pub);
@@ -189,5 +237,7 @@ class FSEventsEventPublisher
   FRIEND_TEST(FSEventsTests, test_fsevents_event_action);
   FRIEND_TEST(FSEventsTests, test_fsevents_embedded_wildcards);
   FRIEND_TEST(FSEventsTests, test_fsevents_match_subscription);
+  FRIEND_TEST(FSEventsTests, test_fsevents_coalesce);
+  FRIEND_TEST(FSEventsTests, test_fsevents_burst_limit);
 };
 }
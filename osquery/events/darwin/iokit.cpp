@@ -19,6 +19,18 @@ namespace osquery {
 
 REGISTER(IOKitEventPublisher, "event_publisher", "iokit");
 
+/// The device classes the publisher is notified of.
+static const std::vector<const std::string*> kWatchedDeviceClasses = {
+    &kIOUSBDeviceClassName_,
+    &kIOPCIDeviceClassName_,
+    &kIOPlatformExpertDeviceClassName_,
+    &kIOACPIPlatformDeviceClassName_,
+    &kIOPlatformDeviceClassName_,
+};
+
+std::atomic<uint64_t> IOKitEventPublisher::device_generation_{0};
+std::atomic<bool> IOKitEventPublisher::watching_{false};
+
 struct DeviceTracker : private boost::noncopyable {
  public:
   explicit DeviceTracker(IOKitEventPublisher* p) : publisher(p) {}
@@ -29,14 +41,6 @@ struct DeviceTracker : private boost::noncopyable {
 };
 
 void IOKitEventPublisher::restart() {
-  static std::vector<const std::string*> device_classes = {
-      &kIOUSBDeviceClassName_,
-      &kIOPCIDeviceClassName_,
-      &kIOPlatformExpertDeviceClassName_,
-      &kIOACPIPlatformDeviceClassName_,
-      &kIOPlatformDeviceClassName_,
-  };
-
   if (run_loop_ == nullptr) {
     return;
   }
@@ -53,7 +57,7 @@ void IOKitEventPublisher::restart() {
   }
 
   publisher_started_ = false;
-  for (const auto& class_name : device_classes) {
+  for (const auto& class_name : kWatchedDeviceClasses) {
     // Service matching is USB for now, must find a way to get more!
     // Can provide a "IOPCIDevice" here too.
     auto matches = IOServiceMatching(class_name->c_str());
@@ -79,10 +83,31 @@ void IOKitEventPublisher::restart() {
     }
   }
   publisher_started_ = true;
+  watching_ = true;
+  device_generation_++;
+}
+
+uint64_t IOKitEventPublisher::getDeviceGeneration() {
+  return device_generation_;
+}
+
+bool IOKitEventPublisher::isWatchingClass(const std::string& class_name) {
+  if (!watching_) {
+    return false;
+  }
+
+  for (const auto& watched : kWatchedDeviceClasses) {
+    if (*watched == class_name) {
+      return true;
+    }
+  }
+  return false;
 }
 
 void IOKitEventPublisher::newEvent(const io_service_t& device,
                                    IOKitEventContext::Action action) {
+  device_generation_++;
+
   auto ec = createEventContext();
   ec->action = action;
 
@@ -238,6 +263,10 @@ void IOKitEventPublisher::stop() {
   WriteLock lock(mutex_);
   CFRunLoopStop(run_loop_);
 
+  // Devices are no longer watched, their changes are not notified.
+  watching_ = false;
+  device_generation_++;
+
   // Stop the run loop before operating on containers.
   // Destroy the IOPort.
   if (port_ != nullptr) {
@@ -78,6 +78,19 @@ class IOKitEventPublisher
 
   void newEvent(const io_service_t& device, IOKitEventContext::Action action);
 
+ public:
+  /**
+   * @brief The generation of the devices the publisher is notified of.
+   *
+   * The generation changes when a device is attached or detached, and when
+   * the publisher starts or stops watching. Tables keeping IOKit services
+   * across queries compare it to know the services are unchanged.
+   */
+  static uint64_t getDeviceGeneration();
+
+  /// Check if attaches and detaches of the devices of a class are notified.
+  static bool isWatchingClass(const std::string& class_name);
+
  private:
   void restart();
   void stop() override;
@@ -106,5 +119,11 @@ class IOKitEventPublisher
    * The publisher started boolean is set after a successful restart.
    */
   std::atomic<bool> publisher_started_{false};
+
+  /// The device generation, changed for each notification.
+  static std::atomic<uint64_t> device_generation_;
+
+  /// A publisher is watching devices.
+  static std::atomic<bool> watching_;
 };
 }
@@ -7,14 +7,23 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+#include <set>
+
+#include <boost/algorithm/string/case_conv.hpp>
+
 #include <osquery/config/config.h>
 #include <osquery/core/flags.h>
 #include <osquery/core/system.h>
+#include <osquery/dispatcher/dispatcher.h>
 #include <osquery/events/eventfactory.h>
+#include <osquery/events/eventingestfilter.h>
 #include <osquery/events/eventsubscriber.h>
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry.h>
+#include <osquery/numeric_monitoring/numeric_monitoring.h>
 #include <osquery/sql/sql.h>
+#include <osquery/utils/json/json.h>
 
 namespace osquery {
 
@@ -34,10 +43,195 @@ struct SubscriberExpirationDetails {
   size_t query_count{0};
 };
 
+/// The time between writes of queued event batches.
+const std::chrono::milliseconds kEventIngestInterval{250};
+
+/// Stores the batches subscribers queued while publishers fire events.
+class EventIngestWriter : public InternalRunnable {
+ public:
+  EventIngestWriter()
+      : InternalRunnable("EventIngestWriter", ThreadClass::Worker) {}
+
+  void start() override {
+    while (!interrupted()) {
+      EventFactory::flushIngestQueues();
+      pause(kEventIngestInterval);
+    }
+
+    // Batches queued before the interruption are not lost.
+    EventFactory::flushIngestQueues();
+  }
+};
+
+/// The batches a subscriber removes in one pass of the maintenance service.
+const size_t kEventMaintenanceBatches{1024};
+
+/// The time between passes while batches remain to be removed.
+const std::chrono::milliseconds kEventMaintenancePace{100};
+
+/**
+ * @brief Removes the overflowing and expired event batches of subscribers.
+ *
+ * Subscribers adding batches leave their removal to this service, large
+ * removals are spread over passes so the database deletes are paced.
+ */
+class EventMaintenanceRunner : public InternalRunnable {
+ public:
+  explicit EventMaintenanceRunner(std::chrono::milliseconds interval)
+      : InternalRunnable("EventMaintenanceRunner", ThreadClass::Worker),
+        interval_(interval) {}
+
+  void start() override {
+    while (!interrupted()) {
+      auto removed =
+          EventFactory::maintainEventBatches(kEventMaintenanceBatches);
+      pause(removed > 0 ? kEventMaintenancePace : interval_);
+    }
+  }
+
+ private:
+  std::chrono::milliseconds interval_;
+};
+
+/// The time the stream forwarder waits for rows between interrupt checks.
+const std::chrono::milliseconds kEventStreamInterval{250};
+
+/// The time subscribers wait for room in a full stream queue.
+const std::chrono::milliseconds kEventStreamWait{1000};
+
+/// Sends the event rows queued by subscribers to the loggers.
+class EventStreamForwarder : public InternalRunnable {
+ public:
+  EventStreamForwarder()
+      : InternalRunnable("EventStreamForwarder", ThreadClass::Logger) {}
+
+  void start() override {
+    while (!interrupted()) {
+      EventFactory::flushEventStream(kEventStreamInterval);
+    }
+
+    // Rows queued before the interruption are not lost.
+    EventFactory::stopEventStream();
+  }
+};
+
+/// Call a logger with a batch of rows, older extensions only accept one row.
+void logEventBatch(const std::string& logger,
+                   const std::vector<std::string>& events,
+                   const std::string& serialized_batch) {
+  auto status =
+      Registry::call("logger", logger, {{"event_batch", serialized_batch}});
+  if (status.ok() ||
+      status.getMessage() != "Unsupported call to logger plugin") {
+    return;
+  }
+
+  for (const auto& event : events) {
+    Registry::call("logger", logger, {{"event", event}});
+  }
+}
+
+/// The columns of a subscriber's table, false if the table is not known.
+bool getSubscriberColumns(const std::string& name, TableColumns& columns) {
+  if (!Registry::get().exists("table", name)) {
+    return false;
+  }
+
+  auto table = std::dynamic_pointer_cast<TablePlugin>(
+      Registry::get().plugin("table", name));
+  if (table == nullptr) {
+    return false;
+  }
+  columns = table->columns();
+  return true;
+}
+
+using IngestFilters =
+    std::map<std::string, std::shared_ptr<EventIngestFilter>>;
+
+/**
+ * @brief Describe the events the schedule may return from each subscriber.
+ *
+ * A subscriber is only filtered if every scheduled query using it can be
+ * described, denylisted queries included as they run again once they expire.
+ */
+IngestFilters getIngestFilters() {
+  IngestFilters filters;
+  std::set<std::string> unfiltered;
+  auto subscriber_names = Registry::get().names("event_subscriber");
+
+  Config::get().scheduledQueries(
+      [&](std::string name, const ScheduledQuery& query) {
+        std::vector<std::string> tables;
+        if (!getQueryTables(query.query, tables)) {
+          return;
+        }
+
+        std::set<std::string> subscribers;
+        bool unknown = false;
+        for (const auto& table : tables) {
+          if (Registry::get().exists("event_subscriber", table)) {
+            subscribers.insert(table);
+          } else if (!Registry::get().exists("table", table)) {
+            unknown = true;
+          }
+        }
+
+        // Aliases and common table expressions are scanned by their name.
+        if (unknown) {
+          auto lower_query = boost::algorithm::to_lower_copy(query.query);
+          for (const auto& subscriber : subscriber_names) {
+            if (lower_query.find(subscriber) != std::string::npos) {
+              subscribers.insert(subscriber);
+            }
+          }
+        }
+
+        for (const auto& subscriber : subscribers) {
+          if (unfiltered.count(subscriber) > 0) {
+            continue;
+          }
+
+          auto& filter = filters[subscriber];
+          if (filter == nullptr) {
+            filter = std::make_shared<EventIngestFilter>();
+          }
+
+          TableColumns columns;
+          if (tables.size() != 1 ||
+              !getSubscriberColumns(subscriber, columns) ||
+              !filter->addQuery(query.query, subscriber, columns)) {
+            unfiltered.insert(subscriber);
+            filters.erase(subscriber);
+          }
+        }
+      },
+      true);
+  return filters;
+}
+
 } // namespace
 
 FLAG(bool, disable_events, false, "Disable osquery publish/subscribe system");
 
+FLAG(uint64,
+     events_stream_queue_max,
+     16384,
+     "Maximum number of event rows queued for loggers receiving events");
+
+FLAG(uint64,
+     events_stream_batch_max,
+     1024,
+     "Maximum number of event rows sent to a logger at once");
+
+FLAG(bool,
+     events_ingest_filters,
+     false,
+     "Drop events the scheduled queries cannot return before storing them");
+
+DECLARE_uint64(events_ingest_queue);
+DECLARE_uint64(events_maintenance_interval);
+
 // There's no reason for the event factory to keep multiple instances.
 EventFactory& EventFactory::getInstance() {
   static EventFactory ef;
@@ -298,11 +492,100 @@ void EventFactory::addForwarder(const std::string& logger) {
 }
 
 void EventFactory::forwardEvent(const std::string& event) {
-  for (const auto& logger : getInstance().loggers_) {
-    Registry::call("logger", logger, {{"event", event}});
+  std::vector<std::string> events{event};
+  forwardEvents(events);
+}
+
+void EventFactory::forwardEvents(std::vector<std::string>& events) {
+  auto& ef = getInstance();
+  if (events.empty() || ef.loggers_.empty()) {
+    return;
+  }
+
+  if (!ef.streaming_) {
+    for (const auto& logger : ef.loggers_) {
+      for (const auto& event : events) {
+        Registry::call("logger", logger, {{"event", event}});
+      }
+    }
+    events.clear();
+    return;
+  }
+
+  // Subscribers slow down while the loggers catch up, up to a limit.
+  auto dropped = ef.stream_queue_->push(events, kEventStreamWait);
+  if (dropped > 0) {
+    VLOG(1) << "Event stream queue is full, dropped " << dropped << " rows";
+    monitoring::record("events.stream.dropped",
+                       static_cast<monitoring::ValueType>(dropped),
+                       monitoring::PreAggregationType::Sum);
+  }
+}
+
+bool EventFactory::flushEventStream(std::chrono::milliseconds wait) {
+  auto& ef = getInstance();
+  if (ef.stream_queue_ == nullptr) {
+    return false;
+  }
+
+  std::vector<std::string> events;
+  auto batch_max = static_cast<size_t>(
+      std::max<std::uint64_t>(FLAGS_events_stream_batch_max, 1));
+  if (!ef.stream_queue_->pop(events, batch_max, wait)) {
+    return false;
+  }
+
+  // Loggers receive the batch as a JSON array of serialized rows.
+  auto batch = JSON::newArray();
+  for (const auto& event : events) {
+    batch.pushCopy(event);
+  }
+
+  std::string serialized_batch;
+  batch.toString(serialized_batch);
+  for (const auto& logger : ef.loggers_) {
+    logEventBatch(logger, events, serialized_batch);
+  }
+  return true;
+}
+
+void EventFactory::stopEventStream() {
+  auto& ef = getInstance();
+  ef.streaming_ = false;
+  while (flushEventStream(std::chrono::milliseconds(0))) {
   }
 }
 
+bool EventFactory::forwardsEvents() {
+  return !getInstance().loggers_.empty();
+}
+
+void EventFactory::flushIngestQueues() {
+  auto& ef = EventFactory::getInstance();
+  RecursiveLock lock(ef.factory_lock_);
+  for (const auto& subscriber : ef.event_subs_) {
+    subscriber.second->flushIngestQueue();
+  }
+}
+
+size_t EventFactory::maintainEventBatches(size_t max_removed) {
+  // Subscribers are not held under the factory lock while batches are removed.
+  std::vector<EventSubscriberRef> subscribers;
+  {
+    auto& ef = EventFactory::getInstance();
+    RecursiveLock lock(ef.factory_lock_);
+    for (const auto& subscriber : ef.event_subs_) {
+      subscribers.push_back(subscriber.second);
+    }
+  }
+
+  size_t removed = 0;
+  for (const auto& subscriber : subscribers) {
+    removed += subscriber->maintainEventBatches(max_removed);
+  }
+  return removed;
+}
+
 void EventFactory::configUpdate() {
   // Scan the schedule for queries that touch "_events" tables.
   // We will count the queries
@@ -356,6 +639,28 @@ void EventFactory::configUpdate() {
     subscriber->resetQueryCount(details.second.query_count);
   }
 
+  // Ad-hoc and distributed queries only see the events the schedule keeps.
+  IngestFilters ingest_filters;
+  if (FLAGS_events_ingest_filters) {
+    ingest_filters = getIngestFilters();
+  }
+
+  {
+    RecursiveLock lock(ef.factory_lock_);
+    for (const auto& subscriber : ef.event_subs_) {
+      auto it = ingest_filters.find(subscriber.first);
+      if (it == ingest_filters.end()) {
+        subscriber.second->setIngestFilter(nullptr);
+        continue;
+      }
+
+      VLOG(1) << "Storing the " << subscriber.first
+              << " events matching " << it->second->size()
+              << " scheduled queries";
+      subscriber.second->setIngestFilter(it->second);
+    }
+  }
+
   // If events are enabled configure the subscribers before publishers.
   if (!FLAGS_disable_events) {
     RegistryFactory::get().registry("event_subscriber")->configure();
@@ -432,11 +737,30 @@ void EventFactory::delay() {
   for (const auto& publisher : EventFactory::getInstance().event_pubs_) {
     // Publishers that did not set up correctly are put into an ending state.
     if (!publisher.second->isEnding()) {
-      auto thread_ = std::make_shared<std::thread>(
-          std::bind(&EventFactory::run, publisher.first));
+      auto thread_ = std::make_shared<std::thread>([type_id = publisher.first] {
+        ThreadClassScope thread_class(ThreadClass::EventReader);
+        EventFactory::run(type_id);
+      });
       ef.threads_.push_back(thread_);
     }
   }
+
+  if (FLAGS_events_ingest_queue > 0) {
+    Dispatcher::addService(std::make_shared<EventIngestWriter>());
+  }
+
+  if (FLAGS_events_maintenance_interval > 0) {
+    Dispatcher::addService(std::make_shared<EventMaintenanceRunner>(
+        std::chrono::seconds(FLAGS_events_maintenance_interval)));
+  }
+
+  // Loggers receiving events are called from a separate thread.
+  if (!ef.loggers_.empty() && ef.stream_queue_ == nullptr) {
+    ef.stream_queue_ = std::make_unique<EventStreamQueue>(static_cast<size_t>(
+        std::max<std::uint64_t>(FLAGS_events_stream_queue_max, 1)));
+    ef.streaming_ = true;
+    Dispatcher::addService(std::make_shared<EventStreamForwarder>());
+  }
 }
 
 void EventFactory::end(bool join) {
@@ -456,6 +780,9 @@ void EventFactory::end(bool join) {
     }
   }
 
+  // Store any batches still queued before the subscribers are released.
+  flushIngestQueues();
+
   {
     RecursiveLock lock(ef.factory_lock_);
     // A small cool off helps OS API event publisher flushing.
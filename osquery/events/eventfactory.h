@@ -9,12 +9,15 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <map>
 #include <memory>
 #include <vector>
 
 #include <osquery/events/eventer.h>
 #include <osquery/events/eventpublisherplugin.h>
+#include <osquery/events/eventstream.h>
 #include <osquery/events/eventsubscriberplugin.h>
 #include <osquery/events/subscription.h>
 #include <osquery/events/types.h>
@@ -149,6 +152,40 @@ class EventFactory : private boost::noncopyable {
   /// Optionally forward events to loggers.
   static void forwardEvent(const std::string& event);
 
+  /**
+   * @brief Forward serialized event rows to the loggers receiving events.
+   *
+   * Once the stream forwarder runs the rows are queued, see
+   * events_stream_queue_max, and the loggers receive them in batches.
+   * Before that, or after it stops, the loggers are called directly.
+   */
+  static void forwardEvents(std::vector<std::string>& events);
+
+  /**
+   * @brief Send a batch of queued event rows to the loggers.
+   *
+   * @param wait how long to wait for rows when none are queued.
+   * @return false if no rows were queued.
+   */
+  static bool flushEventStream(std::chrono::milliseconds wait);
+
+  /// Call loggers directly again, after sending the queued event rows.
+  static void stopEventStream();
+
+  /// Check if any logger receives forwarded events.
+  static bool forwardsEvents();
+
+  /// Store the event batches each subscriber queued, see events_ingest_queue.
+  static void flushIngestQueues();
+
+  /**
+   * @brief Remove the overflowing and expired batches of each subscriber.
+   *
+   * @param max_removed The batches each subscriber removes at most.
+   * @return The number of batches removed.
+   */
+  static size_t maintainEventBatches(size_t max_removed);
+
   /**
    * @brief The event factory, subscribers, and publishers respond to updates.
    *
@@ -224,6 +261,12 @@ class EventFactory : private boost::noncopyable {
   /// Set of logger plugins to forward events.
   std::vector<std::string> loggers_;
 
+  /// Rows waiting for the stream forwarder, created when it starts.
+  std::unique_ptr<EventStreamQueue> stream_queue_;
+
+  /// Set while the stream forwarder drains the stream queue.
+  std::atomic<bool> streaming_{false};
+
   /// Factory publisher state manipulation.
   RecursiveMutex factory_lock_;
 };
@@ -0,0 +1,95 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+#include <iterator>
+
+#include <osquery/events/eventindex.h>
+
+namespace osquery {
+
+namespace {
+
+bool timeBefore(const EventIndex::Entry& entry, EventTime time) {
+  return entry.time < time;
+}
+
+bool timeAfter(EventTime time, const EventIndex::Entry& entry) {
+  return time < entry.time;
+}
+
+} // namespace
+
+void EventIndex::add(EventTime time, const EventSegment& segment) {
+  // Batches are mostly added in time order.
+  if (entries_.empty() || entries_.back().time <= time) {
+    if (entries_.empty() || entries_.back().time != time) {
+      ++times_;
+    }
+    entries_.push_back(Entry{time, segment});
+    return;
+  }
+
+  auto position = std::upper_bound(
+      entries_.begin(), entries_.end(), time, timeAfter);
+  if (position == entries_.begin() || std::prev(position)->time != time) {
+    ++times_;
+  }
+  entries_.insert(position, Entry{time, segment});
+}
+
+EventIndex::const_iterator EventIndex::lowerBound(EventTime time) const {
+  return std::lower_bound(entries_.begin(), entries_.end(), time, timeBefore);
+}
+
+EventIndex::const_iterator EventIndex::upperBound(EventTime time) const {
+  return std::upper_bound(entries_.begin(), entries_.end(), time, timeAfter);
+}
+
+EventIndex EventIndex::takeOldest(size_t max_times) {
+  auto end = entries_.begin();
+  size_t times{0U};
+  while (end != entries_.end() && times < max_times) {
+    auto time = end->time;
+    while (end != entries_.end() && end->time == time) {
+      ++end;
+    }
+    ++times;
+  }
+  return take(end, times);
+}
+
+EventIndex EventIndex::takeUntil(EventTime time, size_t max_times) {
+  auto last = std::upper_bound(
+      entries_.begin(), entries_.end(), time, timeAfter);
+
+  auto end = entries_.begin();
+  size_t times{0U};
+  while (end != last && (max_times == 0U || times < max_times)) {
+    auto batch_time = end->time;
+    while (end != last && end->time == batch_time) {
+      ++end;
+    }
+    ++times;
+  }
+  return take(end, times);
+}
+
+EventIndex EventIndex::take(std::deque<Entry>::iterator end, size_t times) {
+  EventIndex taken;
+  taken.entries_.assign(std::make_move_iterator(entries_.begin()),
+                        std::make_move_iterator(end));
+  taken.times_ = times;
+
+  entries_.erase(entries_.begin(), end);
+  times_ -= times;
+  return taken;
+}
+
+} // namespace osquery
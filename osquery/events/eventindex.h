@@ -0,0 +1,107 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <deque>
+
+#include <osquery/events/types.h>
+
+namespace osquery {
+
+/**
+ * @brief The in-memory index of the stored events of a subscriber.
+ *
+ * Each addBatch stores its rows as one segment, a contiguous range of
+ * EventIDs sharing an event time. The index keeps one (time, segment) entry
+ * per stored segment in a contiguous sequence ordered by time, instead of a
+ * tree node and a vector of segments per time. Lookups by time are binary
+ * searches, and expiry removes entries from the front.
+ *
+ * The events of a time are a batch, size() counts the batches.
+ */
+class EventIndex final {
+ public:
+  struct Entry final {
+    EventTime time{0};
+    EventSegment segment;
+  };
+
+  using const_iterator = std::deque<Entry>::const_iterator;
+
+  /// Add a segment, segments of an equal time keep the order they are added.
+  void add(EventTime time, const EventSegment& segment);
+
+  /// The number of distinct event times.
+  size_t size() const {
+    return times_;
+  }
+
+  /// The number of segments.
+  size_t segments() const {
+    return entries_.size();
+  }
+
+  bool empty() const {
+    return entries_.empty();
+  }
+
+  /// The time of the oldest events, the index must not be empty.
+  EventTime oldestTime() const {
+    return entries_.front().time;
+  }
+
+  /// The time of the newest events, the index must not be empty.
+  EventTime newestTime() const {
+    return entries_.back().time;
+  }
+
+  const_iterator begin() const {
+    return entries_.begin();
+  }
+
+  const_iterator end() const {
+    return entries_.end();
+  }
+
+  /// The first entry at or after a time.
+  const_iterator lowerBound(EventTime time) const;
+
+  /// The first entry after a time.
+  const_iterator upperBound(EventTime time) const;
+
+  /**
+   * @brief Remove the segments of the oldest batches.
+   *
+   * @param max_times Remove at most this many batches.
+   * @return The removed segments.
+   */
+  EventIndex takeOldest(size_t max_times);
+
+  /**
+   * @brief Remove the segments at or before a time.
+   *
+   * @param max_times Remove at most this many batches, 0 for no limit.
+   * @return The removed segments.
+   */
+  EventIndex takeUntil(EventTime time, size_t max_times = 0U);
+
+ private:
+  /// Move the entries before an end position into a new index.
+  EventIndex take(std::deque<Entry>::iterator end, size_t times);
+
+ private:
+  std::deque<Entry> entries_;
+
+  /// The number of distinct times within the entries.
+  size_t times_{0U};
+};
+
+} // namespace osquery
@@ -0,0 +1,522 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <set>
+
+#include <osquery/events/eventingestfilter.h>
+#include <osquery/events/eventrowfilter.h>
+#include <osquery/utils/conversions/tryto.h>
+
+namespace osquery {
+
+namespace {
+
+struct Token {
+  enum class Kind { Word, QuotedWord, String, Number, Symbol };
+
+  Kind kind;
+
+  /// Words are lowercase, strings and quoted words are unescaped.
+  std::string text;
+};
+
+using Tokens = std::vector<Token>;
+
+/// Collations comparing text other than byte by byte.
+const ColumnOptions kColumnCollations =
+    ColumnOptions::COLLATENOCASE | ColumnOptions::COLLATERTRIM |
+    ColumnOptions::COLLATEVERSION | ColumnOptions::COLLATEVERSION_ARCH |
+    ColumnOptions::COLLATEVERSION_DPKG | ColumnOptions::COLLATEVERSION_RHEL;
+
+/// Keywords following a table that cannot be its alias.
+const std::set<std::string> kJoinKeywords = {"cross",
+                                             "full",
+                                             "indexed",
+                                             "inner",
+                                             "join",
+                                             "left",
+                                             "natural",
+                                             "not",
+                                             "on",
+                                             "outer",
+                                             "right",
+                                             "using"};
+
+/// Operators of two characters, others are read as single symbols.
+const std::set<std::string> kTwoCharSymbols = {
+    "!=", "->", "<<", "<=", "<>", "==", ">=", ">>", "||"};
+
+/// Keywords ending a WHERE clause.
+const std::set<std::string> kClauseKeywords = {
+    "group", "limit", "order", "window"};
+
+inline bool isAscii(const std::string& value) {
+  for (auto c : value) {
+    if ((static_cast<unsigned char>(c) & 0x80) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+inline bool isWordChar(char c) {
+  return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '$' ||
+         (static_cast<unsigned char>(c) & 0x80) != 0;
+}
+
+inline std::string toLower(std::string value) {
+  for (auto& c : value) {
+    c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  }
+  return value;
+}
+
+/// Read a quoted string or identifier, a doubled quote is kept once.
+bool readQuoted(const std::string& sql, size_t& i, char close, Token& token) {
+  for (++i; i < sql.size(); ++i) {
+    if (sql[i] != close) {
+      token.text += sql[i];
+    } else if (close != ']' && i + 1 < sql.size() && sql[i + 1] == close) {
+      token.text += sql[++i];
+    } else {
+      ++i;
+      return true;
+    }
+  }
+  return false;
+}
+
+/// Split a statement into tokens, false if a string or comment is open.
+bool tokenize(const std::string& sql, Tokens& tokens) {
+  size_t i = 0;
+  while (i < sql.size()) {
+    auto c = sql[i];
+    if (std::isspace(static_cast<unsigned char>(c))) {
+      ++i;
+    } else if (sql.compare(i, 2, "--") == 0) {
+      i = sql.find('\n', i);
+    } else if (sql.compare(i, 2, "/*") == 0) {
+      i = sql.find("*/", i + 2);
+      if (i == std::string::npos) {
+        return false;
+      }
+      i += 2;
+    } else if (c == '\'' || c == '"' || c == '`' || c == '[') {
+      Token token{c == '\'' ? Token::Kind::String : Token::Kind::QuotedWord,
+                  ""};
+      if (!readQuoted(sql, i, c == '[' ? ']' : c, token)) {
+        return false;
+      }
+      if (token.kind == Token::Kind::QuotedWord) {
+        token.text = toLower(std::move(token.text));
+      }
+      tokens.push_back(std::move(token));
+    } else if (std::isdigit(static_cast<unsigned char>(c)) ||
+               (c == '.' && i + 1 < sql.size() &&
+                std::isdigit(static_cast<unsigned char>(sql[i + 1])))) {
+      auto start = i;
+      while (i < sql.size() &&
+             (isWordChar(sql[i]) || sql[i] == '.' ||
+              ((sql[i] == '+' || sql[i] == '-') &&
+               (sql[i - 1] == 'e' || sql[i - 1] == 'E')))) {
+        ++i;
+      }
+      tokens.push_back({Token::Kind::Number, sql.substr(start, i - start)});
+    } else if (isWordChar(c)) {
+      auto start = i;
+      while (i < sql.size() && isWordChar(sql[i])) {
+        ++i;
+      }
+      tokens.push_back(
+          {Token::Kind::Word, toLower(sql.substr(start, i - start))});
+    } else {
+      size_t length = 1;
+      if (sql.compare(i, 3, "->>") == 0) {
+        length = 3;
+      } else if (kTwoCharSymbols.count(sql.substr(i, 2)) > 0) {
+        length = 2;
+      }
+      tokens.push_back({Token::Kind::Symbol, sql.substr(i, length)});
+      i += length;
+    }
+  }
+  return true;
+}
+
+inline bool isWord(const Tokens& tokens, size_t i, const char* word) {
+  return i < tokens.size() && tokens[i].kind == Token::Kind::Word &&
+         tokens[i].text == word;
+}
+
+inline bool isSymbol(const Tokens& tokens, size_t i, const char* symbol) {
+  return i < tokens.size() && tokens[i].kind == Token::Kind::Symbol &&
+         tokens[i].text == symbol;
+}
+
+inline bool isName(const Tokens& tokens, size_t i) {
+  return i < tokens.size() && (tokens[i].kind == Token::Kind::Word ||
+                               tokens[i].kind == Token::Kind::QuotedWord);
+}
+
+/// The nesting change of a token: parentheses and CASE expressions.
+inline int nesting(const Tokens& tokens, size_t i) {
+  if (isSymbol(tokens, i, "(") || isWord(tokens, i, "case")) {
+    return 1;
+  }
+  if (isSymbol(tokens, i, ")") || isWord(tokens, i, "end")) {
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Find the WHERE clause of a SELECT scanning only the table.
+ *
+ * The tokens following FROM must be the table, an optional alias and the
+ * WHERE clause. Joins, compound selects and statements without a WHERE
+ * clause are not described.
+ */
+bool findWhereClause(const Tokens& tokens,
+                     const std::string& table,
+                     std::string& alias,
+                     size_t& begin,
+                     size_t& end) {
+  auto count = tokens.size();
+  while (count > 0 && isSymbol(tokens, count - 1, ";")) {
+    --count;
+  }
+  if (!isWord(tokens, 0, "select")) {
+    return false;
+  }
+
+  size_t from = 0;
+  int depth = 0;
+  for (size_t i = 0; i < count; ++i) {
+    depth += nesting(tokens, i);
+    if (depth != 0) {
+      continue;
+    }
+
+    if (isSymbol(tokens, i, ";") || isWord(tokens, i, "union") ||
+        isWord(tokens, i, "except") || isWord(tokens, i, "intersect")) {
+      return false;
+    }
+
+    // Skip the FROM of an IS [NOT] DISTINCT FROM comparison.
+    if (from == 0 && isWord(tokens, i, "from") &&
+        !isWord(tokens, i - 1, "distinct")) {
+      from = i;
+    }
+  }
+
+  auto i = from + 1;
+  if (from == 0 || !isName(tokens, i) || tokens[i].text != table ||
+      isSymbol(tokens, i + 1, ".") || isSymbol(tokens, i + 1, "(")) {
+    return false;
+  }
+
+  ++i;
+  if (isWord(tokens, i, "as")) {
+    ++i;
+    if (!isName(tokens, i)) {
+      return false;
+    }
+    alias = tokens[i++].text;
+  } else if (isName(tokens, i) && !isWord(tokens, i, "where") &&
+             kClauseKeywords.count(tokens[i].text) == 0) {
+    if (kJoinKeywords.count(tokens[i].text) > 0) {
+      return false;
+    }
+    alias = tokens[i++].text;
+  }
+
+  if (!isWord(tokens, i, "where")) {
+    return false;
+  }
+
+  begin = ++i;
+  for (depth = 0; i < count; ++i) {
+    depth += nesting(tokens, i);
+    if (depth == 0 && tokens[i].kind == Token::Kind::Word &&
+        kClauseKeywords.count(tokens[i].text) > 0) {
+      break;
+    }
+  }
+  end = i;
+  return begin < end;
+}
+
+/**
+ * @brief Parse a literal compared with a column.
+ *
+ * An integer column compares the integers equal to their decimal text, other
+ * literals are converted or compared by SQLite in ways not described here.
+ *
+ * @return The index following the literal, 0 if it is not usable.
+ */
+size_t parseLiteral(const Tokens& tokens,
+                    size_t i,
+                    size_t end,
+                    bool integral,
+                    EventIngestFilter::Predicate& predicate) {
+  if (i >= end) {
+    return 0;
+  }
+
+  if (!integral) {
+    if (tokens[i].kind != Token::Kind::String) {
+      return 0;
+    }
+    predicate.texts.push_back(tokens[i].text);
+    return i + 1;
+  }
+
+  std::string text;
+  if (tokens[i].kind == Token::Kind::String) {
+    text = tokens[i].text;
+  } else {
+    auto negative = isSymbol(tokens, i, "-");
+    if (negative || isSymbol(tokens, i, "+")) {
+      ++i;
+    }
+    if (i >= end || tokens[i].kind != Token::Kind::Number) {
+      return 0;
+    }
+    text = (negative ? "-" : "") + tokens[i].text;
+  }
+
+  auto integer = tryTo<long long>(text, 10);
+  if (integer.isError() || std::to_string(integer.get()) != text) {
+    return 0;
+  }
+  predicate.integers.push_back(integer.take());
+  return i + 1;
+}
+
+/// Parse a term of the WHERE clause comparing a column with literals.
+bool parseTerm(const Tokens& tokens,
+               size_t i,
+               size_t end,
+               const std::string& table,
+               const std::string& alias,
+               const TableColumns& columns,
+               EventIngestFilter::Predicate& predicate) {
+  if (i + 1 < end && isSymbol(tokens, i + 1, ".")) {
+    if (!isName(tokens, i) ||
+        (tokens[i].text != table && tokens[i].text != alias)) {
+      return false;
+    }
+    i += 2;
+  }
+  if (i >= end || !isName(tokens, i)) {
+    return false;
+  }
+
+  const TableColumns::value_type* column = nullptr;
+  for (const auto& candidate : columns) {
+    if (toLower(std::get<0>(candidate)) == tokens[i].text) {
+      column = &candidate;
+      break;
+    }
+  }
+  if (column == nullptr) {
+    return false;
+  }
+
+  auto type = std::get<1>(*column);
+  predicate.column = std::get<0>(*column);
+  predicate.integral = type == INTEGER_TYPE || type == BIGINT_TYPE ||
+                       type == UNSIGNED_BIGINT_TYPE;
+  if (!predicate.integral && type != TEXT_TYPE) {
+    return false;
+  }
+  auto binary = (std::get<2>(*column) & kColumnCollations) == 0;
+
+  ++i;
+  if (isWord(tokens, i, "not")) {
+    predicate.negate = true;
+    ++i;
+    if (!isWord(tokens, i, "like") && !isWord(tokens, i, "in")) {
+      return false;
+    }
+  }
+
+  if (isWord(tokens, i, "like")) {
+    // LIKE compares ASCII ignoring the case, whatever the collation.
+    predicate.op = EventIngestFilter::Predicate::Op::Like;
+    return !predicate.integral && parseLiteral(tokens, i + 1, end, false,
+                                               predicate) == end &&
+           isAscii(predicate.texts[0]);
+  }
+
+  if (!predicate.integral && !binary) {
+    return false;
+  }
+
+  if (isWord(tokens, i, "in")) {
+    if (!isSymbol(tokens, ++i, "(")) {
+      return false;
+    }
+    do {
+      i = parseLiteral(tokens, i + 1, end, predicate.integral, predicate);
+    } while (i != 0 && isSymbol(tokens, i, ","));
+    return i != 0 && isSymbol(tokens, i, ")") && i + 1 == end;
+  }
+
+  using Op = EventIngestFilter::Predicate::Op;
+  if (i >= end || tokens[i].kind != Token::Kind::Symbol) {
+    return false;
+  }
+  const auto& symbol = tokens[i].text;
+  if (symbol == "=" || symbol == "==") {
+    predicate.op = Op::Equals;
+  } else if (symbol == "!=" || symbol == "<>") {
+    predicate.op = Op::Equals;
+    predicate.negate = true;
+  } else if (!predicate.integral) {
+    // Text ranges are not described.
+    return false;
+  } else if (symbol == ">") {
+    predicate.op = Op::Greater;
+  } else if (symbol == ">=") {
+    predicate.op = Op::GreaterEquals;
+  } else if (symbol == "<") {
+    predicate.op = Op::Less;
+  } else if (symbol == "<=") {
+    predicate.op = Op::LessEquals;
+  } else {
+    return false;
+  }
+  return parseLiteral(tokens, i + 1, end, predicate.integral, predicate) ==
+         end;
+}
+} // namespace
+
+bool EventIngestFilter::addQuery(const std::string& query,
+                                 const std::string& table,
+                                 const TableColumns& columns) {
+  Tokens tokens;
+  std::string alias;
+  size_t begin = 0;
+  size_t end = 0;
+  auto name = toLower(table);
+  if (!tokenize(query, tokens) ||
+      !findWhereClause(tokens, name, alias, begin, end)) {
+    return false;
+  }
+
+  // Split the clause at the top level AND, a BETWEEN owns the next one.
+  std::vector<Predicate> predicates;
+  auto add_term = [&](size_t term_begin, size_t term_end) {
+    Predicate predicate;
+    if (parseTerm(
+            tokens, term_begin, term_end, name, alias, columns, predicate)) {
+      predicates.push_back(std::move(predicate));
+    }
+  };
+
+  int depth = 0;
+  size_t betweens = 0;
+  auto term_begin = begin;
+  for (auto i = begin; i < end; ++i) {
+    depth += nesting(tokens, i);
+    if (depth != 0) {
+      continue;
+    }
+
+    if (isWord(tokens, i, "or")) {
+      return false;
+    } else if (isWord(tokens, i, "between")) {
+      ++betweens;
+    } else if (isWord(tokens, i, "and")) {
+      if (betweens > 0) {
+        --betweens;
+        continue;
+      }
+      add_term(term_begin, i);
+      term_begin = i + 1;
+    }
+  }
+  add_term(term_begin, end);
+
+  if (predicates.empty()) {
+    return false;
+  }
+  queries_.push_back(std::move(predicates));
+  return true;
+}
+
+bool EventIngestFilter::matches(const Row& r) const {
+  if (queries_.empty()) {
+    return true;
+  }
+
+  for (const auto& predicates : queries_) {
+    bool matched = true;
+    for (const auto& predicate : predicates) {
+      auto it = r.find(predicate.column);
+      if (it != r.end() && !matches(predicate, it->second)) {
+        matched = false;
+        break;
+      }
+    }
+
+    if (matched) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool EventIngestFilter::matches(const Predicate& predicate,
+                                const std::string& value) {
+  bool result = false;
+  if (predicate.integral) {
+    // The value is left for SQLite if it is not a plain integer.
+    auto integer = tryTo<long long>(value, 10);
+    if (integer.isError()) {
+      return true;
+    }
+
+    auto lhs = integer.take();
+    const auto& rhs = predicate.integers;
+    switch (predicate.op) {
+    case Predicate::Op::Equals:
+      result = std::find(rhs.begin(), rhs.end(), lhs) != rhs.end();
+      break;
+    case Predicate::Op::Greater:
+      result = lhs > rhs[0];
+      break;
+    case Predicate::Op::GreaterEquals:
+      result = lhs >= rhs[0];
+      break;
+    case Predicate::Op::Less:
+      result = lhs < rhs[0];
+      break;
+    case Predicate::Op::LessEquals:
+      result = lhs <= rhs[0];
+      break;
+    default:
+      return true;
+    }
+  } else if (predicate.op == Predicate::Op::Like) {
+    if (!isAscii(value)) {
+      return true;
+    }
+    result = EventRowFilter::like(value, predicate.texts[0]);
+  } else {
+    const auto& rhs = predicate.texts;
+    result = std::find(rhs.begin(), rhs.end(), value) != rhs.end();
+  }
+  return result != predicate.negate;
+}
+
+} // namespace osquery
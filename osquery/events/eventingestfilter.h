@@ -0,0 +1,82 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <osquery/core/sql/column.h>
+#include <osquery/core/sql/row.h>
+
+namespace osquery {
+
+/**
+ * @brief The events the scheduled queries of a subscriber table may return.
+ *
+ * Each query adds the predicates of its WHERE clause that the filter can
+ * evaluate on its own: comparisons of a column with a literal, [NOT] LIKE
+ * and [NOT] IN lists of literals, joined by AND. Other terms of the clause
+ * are ignored, which only keeps more events. A row is kept if it may match
+ * the predicates of any query.
+ *
+ * A query returning events the filter cannot describe, a query without a
+ * WHERE clause, using OR at its top level, reading other tables or more than
+ * one SELECT, makes the filter keep every row.
+ */
+class EventIngestFilter {
+ public:
+  /// A predicate of a WHERE clause, comparing one column.
+  struct Predicate {
+    enum class Op { Equals, Like, Greater, GreaterEquals, Less, LessEquals };
+
+    std::string column;
+    Op op{Op::Equals};
+
+    /// NOT LIKE, NOT IN and the != comparison.
+    bool negate{false};
+
+    /// The column is compared as an integer.
+    bool integral{false};
+
+    /// Any value of an IN list matches Equals.
+    std::vector<std::string> texts;
+    std::vector<long long> integers;
+  };
+
+  /**
+   * @brief Add the predicates of a query on a subscriber table.
+   *
+   * @param query The SQL of the query.
+   * @param table The subscriber table, the only table the query scans.
+   * @param columns The columns of the table.
+   * @return false if the query may return any row of the table.
+   */
+  bool addQuery(const std::string& query,
+                const std::string& table,
+                const TableColumns& columns);
+
+  /// Check if a row may be returned by one of the queries.
+  bool matches(const Row& r) const;
+
+  /// The number of queries added.
+  size_t size() const {
+    return queries_.size();
+  }
+
+ private:
+  /// Check if a present value may match one predicate.
+  static bool matches(const Predicate& predicate, const std::string& value);
+
+ private:
+  /// The predicates of each query, all of them must match.
+  std::vector<std::vector<Predicate>> queries_;
+};
+
+} // namespace osquery
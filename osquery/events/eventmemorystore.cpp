@@ -0,0 +1,183 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <osquery/events/eventmemorystore.h>
+#include <osquery/utils/conversions/tryto.h>
+
+namespace osquery {
+
+size_t EventMemoryStore::bytes() const {
+  ReadLock lock(mutex_);
+  return bytes_;
+}
+
+Status EventMemoryStore::getDatabaseValue(const std::string& domain,
+                                          const std::string& key,
+                                          std::string& value) const {
+  ReadLock lock(mutex_);
+  auto domain_it = domains_.find(domain);
+  if (domain_it == domains_.end()) {
+    return Status(1, "Domain " + domain + " does not exist");
+  }
+
+  auto it = domain_it->second.find(key);
+  if (it == domain_it->second.end()) {
+    return Status(1, "Key " + key + " in domain " + domain + " does not exist");
+  }
+
+  value = it->second;
+  return Status::success();
+}
+
+Status EventMemoryStore::getDatabaseValue(const std::string& domain,
+                                          const std::string& key,
+                                          int& value) const {
+  std::string result;
+  auto status = getDatabaseValue(domain, key, result);
+  if (!status.ok()) {
+    return status;
+  }
+
+  auto integer = tryTo<int>(result, 10);
+  if (integer.isError()) {
+    return Status(1, "Could not deserialize str to int");
+  }
+  value = integer.take();
+  return Status::success();
+}
+
+Status EventMemoryStore::setDatabaseValue(const std::string& domain,
+                                          const std::string& key,
+                                          const std::string& value) const {
+  WriteLock lock(mutex_);
+  set(domains_[domain], key, value);
+  return Status::success();
+}
+
+Status EventMemoryStore::setDatabaseValue(const std::string& domain,
+                                          const std::string& key,
+                                          int value) const {
+  return setDatabaseValue(domain, key, std::to_string(value));
+}
+
+Status EventMemoryStore::setDatabaseBatch(
+    const std::string& domain, const DatabaseStringValueList& data) const {
+  WriteLock lock(mutex_);
+  auto& keys = domains_[domain];
+  for (const auto& entry : data) {
+    set(keys, entry.first, entry.second);
+  }
+  return Status::success();
+}
+
+Status EventMemoryStore::deleteDatabaseValue(const std::string& domain,
+                                             const std::string& key) const {
+  WriteLock lock(mutex_);
+  auto domain_it = domains_.find(domain);
+  if (domain_it != domains_.end()) {
+    auto it = domain_it->second.find(key);
+    if (it != domain_it->second.end()) {
+      erase(domain_it->second, it);
+    }
+  }
+  return Status::success();
+}
+
+Status EventMemoryStore::deleteDatabaseRange(const std::string& domain,
+                                             const std::string& low,
+                                             const std::string& high) const {
+  WriteLock lock(mutex_);
+  auto domain_it = domains_.find(domain);
+  if (domain_it == domains_.end() || low > high) {
+    return Status::success();
+  }
+
+  // Like the database plugins, the range includes both keys.
+  auto& keys = domain_it->second;
+  auto it = keys.lower_bound(low);
+  while (it != keys.end() && it->first <= high) {
+    erase(keys, it++);
+  }
+  return Status::success();
+}
+
+Status EventMemoryStore::scanDatabaseKeys(const std::string& domain,
+                                          std::vector<std::string>& keys,
+                                          size_t max) const {
+  return scanDatabaseKeys(domain, keys, "", max);
+}
+
+Status EventMemoryStore::scanDatabaseKeys(const std::string& domain,
+                                          std::vector<std::string>& keys,
+                                          const std::string& prefix,
+                                          size_t max) const {
+  ReadLock lock(mutex_);
+  auto domain_it = domains_.find(domain);
+  if (domain_it == domains_.end()) {
+    return Status::success();
+  }
+
+  const auto& stored = domain_it->second;
+  for (auto it = stored.lower_bound(prefix); it != stored.end(); ++it) {
+    if (it->first.compare(0, prefix.size(), prefix) != 0 ||
+        (max > 0 && keys.size() >= max)) {
+      break;
+    }
+    keys.push_back(it->first);
+  }
+  return Status::success();
+}
+
+Status EventMemoryStore::scanDatabaseValues(
+    const std::string& domain,
+    const std::string& prefix,
+    size_t max,
+    const DatabaseScanCallback& callback) const {
+  ReadLock lock(mutex_);
+  auto domain_it = domains_.find(domain);
+  if (domain_it == domains_.end()) {
+    return Status::success();
+  }
+
+  const auto& stored = domain_it->second;
+  size_t count = 0;
+  for (auto it = stored.lower_bound(prefix); it != stored.end(); ++it) {
+    if (it->first.compare(0, prefix.size(), prefix) != 0 ||
+        (max > 0 && count++ >= max)) {
+      break;
+    }
+
+    // The callback may move the value, it receives a copy.
+    auto value = it->second;
+    if (!callback(it->first, value)) {
+      break;
+    }
+  }
+  return Status::success();
+}
+
+void EventMemoryStore::set(KeyMap& domain,
+                           const std::string& key,
+                           std::string value) const {
+  auto it = domain.find(key);
+  if (it == domain.end()) {
+    bytes_ += key.size() + value.size();
+    domain.emplace(key, std::move(value));
+  } else {
+    bytes_ = bytes_ - it->second.size() + value.size();
+    it->second = std::move(value);
+  }
+}
+
+void EventMemoryStore::erase(KeyMap& domain, KeyMap::iterator it) const {
+  bytes_ -= it->first.size() + it->second.size();
+  domain.erase(it);
+}
+
+} // namespace osquery
@@ -0,0 +1,102 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <osquery/database/idatabaseinterface.h>
+#include <osquery/utils/mutex.h>
+
+namespace osquery {
+
+/**
+ * @brief A process-local store for the events of one subscriber.
+ *
+ * Subscribers listed in events_memory_subscribers keep their event segments,
+ * dictionary and optimize markers here instead of the database. Every write
+ * and read behaves like the database plugins, range deletes include both
+ * keys, so the subscriber's indexing, expiry and optimization are unchanged.
+ *
+ * The store tracks the bytes of its keys and values, the subscriber evicts
+ * its oldest events when the store exceeds events_memory_max_bytes. Nothing
+ * is persisted, the events are lost when the process exits.
+ */
+class EventMemoryStore : public IDatabaseInterface {
+ public:
+  EventMemoryStore() = default;
+  virtual ~EventMemoryStore() override = default;
+
+  /// The bytes of every stored key and value.
+  size_t bytes() const;
+
+  Status getDatabaseValue(const std::string& domain,
+                          const std::string& key,
+                          std::string& value) const override;
+
+  Status getDatabaseValue(const std::string& domain,
+                          const std::string& key,
+                          int& value) const override;
+
+  Status setDatabaseValue(const std::string& domain,
+                          const std::string& key,
+                          const std::string& value) const override;
+
+  Status setDatabaseValue(const std::string& domain,
+                          const std::string& key,
+                          int value) const override;
+
+  Status setDatabaseBatch(const std::string& domain,
+                          const DatabaseStringValueList& data) const override;
+
+  Status deleteDatabaseValue(const std::string& domain,
+                             const std::string& key) const override;
+
+  Status deleteDatabaseRange(const std::string& domain,
+                             const std::string& low,
+                             const std::string& high) const override;
+
+  Status scanDatabaseKeys(const std::string& domain,
+                          std::vector<std::string>& keys,
+                          size_t max) const override;
+
+  Status scanDatabaseKeys(const std::string& domain,
+                          std::vector<std::string>& keys,
+                          const std::string& prefix,
+                          size_t max) const override;
+
+  Status scanDatabaseValues(
+      const std::string& domain,
+      const std::string& prefix,
+      size_t max,
+      const DatabaseScanCallback& callback) const override;
+
+ private:
+  using KeyMap = std::map<std::string, std::string>;
+
+  /// Store a value, the caller holds the lock.
+  void set(KeyMap& domain, const std::string& key, std::string value) const;
+
+  /// Remove a value, the caller holds the lock.
+  void erase(KeyMap& domain, KeyMap::iterator it) const;
+
+ private:
+  /// Protects the stored values, publishers and queries use the store.
+  mutable Mutex mutex_;
+
+  /// Keys and values of each domain.
+  mutable std::map<std::string, KeyMap> domains_;
+
+  /// The bytes of every stored key and value.
+  mutable size_t bytes_{0};
+};
+
+} // namespace osquery
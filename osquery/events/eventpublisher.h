@@ -104,11 +104,54 @@ class EventPublisher : public EventPublisherPlugin {
     auto pub_sc = getSubscriptionContext(sub->context);
     auto pub_ec = getEventContext(ec);
 
-    if (shouldFire(pub_sc, pub_ec) && sub->callback != nullptr) {
+    if (!shouldFire(pub_sc, pub_ec)) {
+      return;
+    }
+
+    if (sub->batch_callback != nullptr) {
+      sub->batch_callback({ec}, pub_sc);
+    } else if (sub->callback != nullptr) {
       sub->callback(pub_ec, pub_sc);
     }
   }
 
+  /**
+   * @brief The internal `fireBatch` phase of publishing.
+   *
+   * The SubscriptionContext is up-cast once and `shouldFire` is called for
+   * every event. A batch callback receives every matching event at once,
+   * otherwise the callback is called for each.
+   *
+   * @param sub The SubscriptionContext and optional callbacks.
+   * @param ecs The events that were fired.
+   */
+  void fireBatchCallback(const SubscriptionRef& sub,
+                         const EventContextList& ecs) const override {
+    auto pub_sc = getSubscriptionContext(sub->context);
+
+    EventContextList matched;
+    if (sub->batch_callback != nullptr) {
+      matched.reserve(ecs.size());
+    }
+
+    for (const auto& ec : ecs) {
+      auto pub_ec = getEventContext(ec);
+      if (!shouldFire(pub_sc, pub_ec)) {
+        continue;
+      }
+
+      if (sub->batch_callback != nullptr) {
+        matched.push_back(ec);
+      } else if (sub->callback != nullptr) {
+        sub->callback(pub_ec, pub_sc);
+      }
+    }
+
+    if (!matched.empty()) {
+      sub->batch_callback(matched, pub_sc);
+    }
+  }
+
  protected:
   /**
    * @brief The generic `fire` will call `shouldFire` for each Subscription.
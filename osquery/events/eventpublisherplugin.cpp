@@ -10,6 +10,7 @@
 #include <osquery/events/eventfactory.h>
 #include <osquery/events/eventpublisherplugin.h>
 #include <osquery/events/eventsubscriber.h>
+#include <osquery/numeric_monitoring/numeric_monitoring.h>
 #include <osquery/registry/registry_factory.h>
 #include <osquery/utils/system/time.h>
 
@@ -17,6 +18,15 @@ namespace osquery {
 
 CREATE_REGISTRY(EventPublisherPlugin, "event_publisher");
 
+namespace {
+
+/// The time subscribers take to process the events fired by publishers.
+const monitoring::LatencyMetric& fireLatency() {
+  static const monitoring::LatencyMetric metric("events.publisher.fire");
+  return metric;
+}
+} // namespace
+
 const std::string EventPublisherPlugin::type() const {
   return getName();
 }
@@ -50,6 +60,21 @@ EventContextID EventPublisherPlugin::numEvents() const {
   return next_ec_id_.load();
 }
 
+void EventPublisherPlugin::recordDroppedEvents(size_t count) {
+  if (count == 0) {
+    return;
+  }
+
+  dropped_events_ += count;
+  monitoring::record("events.publisher." + type() + ".dropped",
+                     static_cast<monitoring::ValueType>(count),
+                     monitoring::PreAggregationType::Sum);
+}
+
+size_t EventPublisherPlugin::numDroppedEvents() const {
+  return dropped_events_;
+}
+
 size_t EventPublisherPlugin::numSubscriptions() {
   ReadLock lock(subscription_lock_);
   return subscriptions_.size();
@@ -61,6 +86,8 @@ void EventPublisherPlugin::fire(const EventContextRef& ec, EventTime time) {
     return;
   }
 
+  monitoring::LatencyTimer timer(fireLatency());
+
   EventContextID ec_id = 0;
   ec_id = next_ec_id_.fetch_add(1);
 
@@ -84,6 +111,41 @@ void EventPublisherPlugin::fire(const EventContextRef& ec, EventTime time) {
   }
 }
 
+void EventPublisherPlugin::fireBatch(const EventContextList& ecs,
+                                     EventTime time) {
+  if (isEnding() || ecs.empty()) {
+    // Cannot emit/fire while ending
+    return;
+  }
+
+  monitoring::LatencyTimer timer(fireLatency());
+
+  // Reserve one EventContext ID for each event.
+  EventContextID ec_id = next_ec_id_.fetch_add(ecs.size());
+  for (const auto& ec : ecs) {
+    if (ec == nullptr) {
+      ++ec_id;
+      continue;
+    }
+
+    ec->id = ec_id++;
+    if (ec->time == 0) {
+      if (time == 0) {
+        time = getTime();
+      }
+      ec->time = time;
+    }
+  }
+
+  ReadLock lock(subscription_lock_);
+  for (const auto& subscription : subscriptions_) {
+    auto es = EventFactory::getEventSubscriber(subscription->subscriber_name);
+    if (es != nullptr && es->state() == EventState::EVENT_RUNNING) {
+      fireBatchCallback(subscription, ecs);
+    }
+  }
+}
+
 uint64_t EventPublisherPlugin::getTime() const {
   return getUnixTime();
 }
@@ -108,6 +108,17 @@ class EventPublisherPlugin : public Plugin,
    */
   EventContextID numEvents() const;
 
+  /**
+   * @brief Count events lost before this EventPublisher received them.
+   *
+   * Publishers call this when their source reports losses, such as a full
+   * kernel buffer. When only an overflow is reported, it counts as one.
+   */
+  void recordDroppedEvents(size_t count);
+
+  /// The number of events lost at the source, see recordDroppedEvents.
+  size_t numDroppedEvents() const;
+
   /// Check if the EventFactory is ending all publisher threads.
   bool isEnding() const;
 
@@ -138,10 +149,27 @@ class EventPublisherPlugin : public Plugin,
    */
   void fire(const EventContextRef& ec, EventTime time = 0);
 
+  /**
+   * @brief Fire several events, each Subscription is visited once.
+   *
+   * Publishers reading many events at once should prefer this to calling
+   * `fire` per event. Subscriptions using a batch callback receive all the
+   * matching events in one call, so their EventSubscriber stores the whole
+   * batch with a single `addBatch`.
+   *
+   * @param ecs The EventContext%s created by the EventPublisher, in order.
+   * @param time The most accurate time for events without one.
+   */
+  void fireBatch(const EventContextList& ecs, EventTime time = 0);
+
   /// The internal fire method used by the typed EventPublisher.
   virtual void fireCallback(const SubscriptionRef& sub,
                             const EventContextRef& ec) const = 0;
 
+  /// The internal batch fire method used by the typed EventPublisher.
+  virtual void fireBatchCallback(const SubscriptionRef& sub,
+                                 const EventContextList& ecs) const = 0;
+
   /// Return the current time (included to assist testing).
   virtual uint64_t getTime() const;
 
@@ -165,6 +193,9 @@ class EventPublisherPlugin : public Plugin,
   /// A helper count of event publisher runloop iterations.
   std::atomic<size_t> restart_count_{0};
 
+  /// Events lost at the source.
+  std::atomic<size_t> dropped_events_{0};
+
   // clang-format off
   [[deprecated("Do not check for interrupted, instead use isEnding.")]]
   // clang-format on
@@ -176,5 +207,6 @@ class EventPublisherPlugin : public Plugin,
 
   FRIEND_TEST(EventsTests, test_event_publisher);
   FRIEND_TEST(EventsTests, test_fire_event);
+  FRIEND_TEST(EventsTests, test_fire_batch);
 };
 } // namespace osquery
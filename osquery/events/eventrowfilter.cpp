@@ -0,0 +1,150 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <osquery/events/eventrowfilter.h>
+#include <osquery/utils/conversions/tryto.h>
+
+namespace osquery {
+
+namespace {
+
+inline bool isAscii(const std::string& value) {
+  for (auto c : value) {
+    if ((static_cast<unsigned char>(c) & 0x80) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+inline char lowerAscii(char c) {
+  return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+inline bool isRange(unsigned char op) {
+  return op == GREATER_THAN || op == GREATER_THAN_OR_EQUALS ||
+         op == LESS_THAN || op == LESS_THAN_OR_EQUALS;
+}
+} // namespace
+
+EventRowFilter::EventRowFilter(const QueryContext& context) {
+  for (const auto& list : context.constraints) {
+    // The time constraint selects the stored batches that are scanned.
+    if (list.first == "time") {
+      continue;
+    }
+
+    auto affinity = list.second.affinity;
+    auto integral = affinity == INTEGER_TYPE || affinity == BIGINT_TYPE ||
+                    affinity == UNSIGNED_BIGINT_TYPE;
+    auto text = affinity == TEXT_TYPE || affinity == BLOB_TYPE;
+
+    for (const auto& constraint : list.second.getAll()) {
+      Predicate predicate;
+      predicate.column = list.first;
+      predicate.affinity = affinity;
+      predicate.op = constraint.op;
+      predicate.expr = constraint.expr;
+
+      bool usable = false;
+      if (integral && (constraint.op == EQUALS || isRange(constraint.op))) {
+        // Other expressions are compared as real numbers by SQLite.
+        auto integer = tryTo<long long>(constraint.expr, 10);
+        usable = integer.isValue();
+        predicate.integer = integer.takeOr(0LL);
+      } else if (text) {
+        usable = constraint.op == EQUALS ||
+                 (constraint.op == LIKE && isAscii(constraint.expr));
+      }
+
+      if (!usable) {
+        continue;
+      }
+
+      columns_.insert(predicate.column);
+      predicates_.push_back(std::move(predicate));
+    }
+  }
+}
+
+bool EventRowFilter::matches(const Row& r) const {
+  for (const auto& predicate : predicates_) {
+    auto it = r.find(predicate.column);
+    if (it != r.end() && !matches(predicate, it->second)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool EventRowFilter::matches(const Predicate& predicate,
+                             const std::string& value) {
+  if (predicate.affinity == TEXT_TYPE || predicate.affinity == BLOB_TYPE) {
+    if (predicate.op == EQUALS) {
+      return value == predicate.expr;
+    }
+    return !isAscii(value) || like(value, predicate.expr);
+  }
+
+  // Values that are not integers are NULL to SQLite and never compare.
+  auto integer = tryTo<long long>(value, 0);
+  if (integer.isError()) {
+    return false;
+  }
+
+  auto lhs = integer.take();
+  switch (predicate.op) {
+  case EQUALS:
+    return lhs == predicate.integer;
+  case GREATER_THAN:
+    return lhs > predicate.integer;
+  case GREATER_THAN_OR_EQUALS:
+    return lhs >= predicate.integer;
+  case LESS_THAN:
+    return lhs < predicate.integer;
+  case LESS_THAN_OR_EQUALS:
+    return lhs <= predicate.integer;
+  default:
+    return true;
+  }
+}
+
+bool EventRowFilter::like(const std::string& value,
+                          const std::string& pattern) {
+  size_t v = 0;
+  size_t p = 0;
+
+  // The positions following the last '%', to retry with a longer match.
+  size_t retry_v = std::string::npos;
+  size_t retry_p = 0;
+
+  while (v < value.size()) {
+    if (p < pattern.size() && pattern[p] == '%') {
+      retry_p = ++p;
+      retry_v = v;
+    } else if (p < pattern.size() &&
+               (pattern[p] == '_' ||
+                lowerAscii(pattern[p]) == lowerAscii(value[v]))) {
+      ++p;
+      ++v;
+    } else if (retry_v != std::string::npos) {
+      p = retry_p;
+      v = ++retry_v;
+    } else {
+      return false;
+    }
+  }
+
+  while (p < pattern.size() && pattern[p] == '%') {
+    ++p;
+  }
+  return p == pattern.size();
+}
+
+} // namespace osquery
@@ -0,0 +1,83 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include <osquery/core/sql/row.h>
+#include <osquery/core/tables.h>
+
+namespace osquery {
+
+/**
+ * @brief Query constraints evaluated on stored events before they are emitted.
+ *
+ * Event tables return every stored event matching the 'time' constraint and
+ * SQLite applies the remaining predicates to each emitted row. The filter
+ * evaluates the simple constraints passed to the table, EQUALS on any column,
+ * LIKE on TEXT columns and ranges on integer columns, while stored events are
+ * scanned. Rows that cannot match are neither fully decoded nor emitted.
+ *
+ * SQLite still checks every constraint, so the filter only removes rows it is
+ * certain do not match. A row missing a constrained column, or a constraint
+ * it cannot interpret, is kept.
+ */
+class EventRowFilter {
+ public:
+  /// An empty filter matching every row.
+  EventRowFilter() = default;
+
+  /// Collect the usable constraints of a query, 'time' is not included.
+  explicit EventRowFilter(const QueryContext& context);
+
+  /// Check if the filter has no predicates.
+  bool empty() const {
+    return predicates_.empty();
+  }
+
+  /// The constrained columns, the only values needed to call matches.
+  const std::set<std::string>& columns() const {
+    return columns_;
+  }
+
+  /// Check if a row may match every predicate.
+  bool matches(const Row& r) const;
+
+  /**
+   * @brief Evaluate a SQLite LIKE pattern, ASCII case is ignored.
+   *
+   * The value and pattern must be ASCII, LIKE compares other characters
+   * differently.
+   */
+  static bool like(const std::string& value, const std::string& pattern);
+
+ private:
+  struct Predicate {
+    std::string column;
+    ColumnType affinity{TEXT_TYPE};
+    unsigned char op{EQUALS};
+    std::string expr;
+
+    /// The expression of a comparison on an integer column.
+    long long integer{0};
+  };
+
+  /// Check if a present value may match one predicate.
+  static bool matches(const Predicate& predicate, const std::string& value);
+
+ private:
+  std::vector<Predicate> predicates_;
+
+  std::set<std::string> columns_;
+};
+
+} // namespace osquery
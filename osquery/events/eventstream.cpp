@@ -0,0 +1,66 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <osquery/events/eventstream.h>
+
+namespace osquery {
+
+size_t EventStreamQueue::push(std::vector<std::string>& rows,
+                              std::chrono::milliseconds wait) {
+  auto deadline = std::chrono::steady_clock::now() + wait;
+  size_t queued{0};
+
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (queued < rows.size()) {
+      if (rows_.size() >= capacity_ &&
+          !not_full_.wait_until(lock, deadline, [this] {
+            return rows_.size() < capacity_;
+          })) {
+        break;
+      }
+
+      while (queued < rows.size() && rows_.size() < capacity_) {
+        rows_.push_back(std::move(rows[queued++]));
+      }
+      not_empty_.notify_one();
+    }
+  }
+
+  auto dropped = rows.size() - queued;
+  rows.clear();
+  return dropped;
+}
+
+bool EventStreamQueue::pop(std::vector<std::string>& batch,
+                           size_t max_rows,
+                           std::chrono::milliseconds wait) {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (rows_.empty() &&
+        !not_empty_.wait_for(lock, wait, [this] { return !rows_.empty(); })) {
+      return false;
+    }
+
+    while (!rows_.empty() && batch.size() < max_rows) {
+      batch.push_back(std::move(rows_.front()));
+      rows_.pop_front();
+    }
+  }
+
+  not_full_.notify_all();
+  return true;
+}
+
+size_t EventStreamQueue::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return rows_.size();
+}
+
+} // namespace osquery
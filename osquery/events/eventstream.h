@@ -0,0 +1,73 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace osquery {
+
+/**
+ * @brief The bounded queue of serialized event rows streamed to loggers.
+ *
+ * Subscribers push the rows they add, the EventFactory's stream forwarder
+ * pops them in batches and calls each logger receiving events. When the
+ * loggers fall behind the queue fills up and pushing waits for room, which
+ * slows the subscriber (and its ingest queue) down. Rows that still do not
+ * fit after the wait are dropped.
+ */
+class EventStreamQueue {
+ public:
+  explicit EventStreamQueue(size_t capacity) : capacity_(capacity) {}
+
+  /**
+   * @brief Queue rows, waiting up to `wait` for room.
+   *
+   * The rows are moved out of the input list.
+   *
+   * @return the number of rows dropped because the queue stayed full.
+   */
+  size_t push(std::vector<std::string>& rows, std::chrono::milliseconds wait);
+
+  /**
+   * @brief Move up to `max_rows` queued rows into a batch.
+   *
+   * Waits up to `wait` when the queue is empty.
+   *
+   * @return false if no rows were queued.
+   */
+  bool pop(std::vector<std::string>& batch,
+           size_t max_rows,
+           std::chrono::milliseconds wait);
+
+  /// The number of queued rows.
+  size_t size() const;
+
+ private:
+  /// The queued rows, oldest first.
+  std::deque<std::string> rows_;
+
+  /// The maximum number of queued rows.
+  size_t capacity_{0};
+
+  mutable std::mutex mutex_;
+
+  /// Signaled when rows are queued.
+  std::condition_variable not_empty_;
+
+  /// Signaled when rows are popped.
+  std::condition_variable not_full_;
+};
+
+} // namespace osquery
@@ -10,6 +10,7 @@
 #pragma once
 #include <functional>
 #include <memory>
+#include <vector>
 
 #include <osquery/events/eventfactory.h>
 #include <osquery/events/eventpublisher.h>
@@ -91,6 +92,46 @@ class EventSubscriber : public EventSubscriberPlugin {
     }
   }
 
+  /**
+   * @brief Bind a member function receiving batches of events.
+   *
+   * The function is called once for the matching events of each batch the
+   * publisher fires, see EventPublisherPlugin::fireBatch. It can store all
+   * of the rows with a single `addBatch`.
+   *
+   * @param entry A templated EventSubscriber member function.
+   * @param sc The subscription context.
+   */
+  template <typename T>
+  void subscribeBatch(Status (T::*entry)(const std::vector<ECRef>&,
+                                         const SCRef&),
+                      const SCRef& sc) {
+    auto sub = dynamic_cast<T*>(this);
+    if (sub != nullptr) {
+      auto subscription = Subscription::create(sub->getName(), sc);
+      subscription->batch_callback =
+          [sub, entry](const EventContextList& ecs,
+                       const SubscriptionContextRef& sc) -> Status {
+        std::vector<ECRef> pub_ecs;
+        pub_ecs.reserve(ecs.size());
+        for (const auto& ec : ecs) {
+          pub_ecs.push_back(
+              std::dynamic_pointer_cast<typename ECRef::element_type>(ec));
+        }
+        return std::invoke(
+            entry,
+            *sub,
+            pub_ecs,
+            std::dynamic_pointer_cast<typename SCRef::element_type>(sc));
+      };
+
+      Status stat = EventFactory::addSubscription(sub->getType(), subscription);
+      if (stat.ok()) {
+        subscription_count_++;
+      }
+    }
+  }
+
  public:
   explicit EventSubscriber(bool enabled = true)
       : EventSubscriberPlugin(enabled) {}
@@ -7,14 +7,20 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+#include <iterator>
+
 #include <osquery/config/config.h>
 #include <osquery/core/flags.h>
+#include <osquery/core/sql/binary_encoding.h>
 #include <osquery/database/database.h>
 #include <osquery/events/eventfactory.h>
 #include <osquery/events/eventsubscriberplugin.h>
 #include <osquery/logger/logger.h>
+#include <osquery/numeric_monitoring/numeric_monitoring.h>
 #include <osquery/registry/registry_factory.h>
 #include <osquery/sql/dynamic_table_row.h>
+#include <osquery/utils/conversions/split.h>
 #include <osquery/utils/conversions/tryto.h>
 #include <osquery/utils/info/tool_type.h>
 #include <osquery/utils/system/time.h>
@@ -26,6 +32,32 @@ namespace {
 /// Checkpoint interval to inspect max event buffering.
 const EventContextID kEventsCheckpoint{256U};
 
+/// The time subscribers take to queue or store a batch of rows.
+const monitoring::LatencyMetric& addBatchLatency() {
+  static const monitoring::LatencyMetric metric("events.subscriber.add_batch");
+  return metric;
+}
+
+/// Count the events of removed segments, and report them as dropped.
+void recordDroppedEvents(EventSubscriberPlugin::Context& context,
+                         const EventIndex& removed) {
+  std::size_t count{0U};
+  for (const auto& entry : removed) {
+    count += entry.segment.last - entry.segment.first + 1U;
+  }
+
+  context.dropped_events += count;
+  monitoring::record("events." + context.database_namespace + ".dropped",
+                     static_cast<monitoring::ValueType>(count),
+                     monitoring::PreAggregationType::Sum);
+}
+
+/// Every segment starts with this magic, stored rows never start with it.
+const std::string kEventSegmentMagic{"\0OQS", 4};
+
+/// The version of the event segment encoding written.
+const uint8_t kEventSegmentVersion{1U};
+
 void removeDeprecatedEventKeysOnceHelper() {
   std::vector<std::string> key_list;
   auto status = scanDatabaseKeys(kEvents, key_list);
@@ -70,6 +102,11 @@ void removeDeprecatedEventKeysOnce() {
 
 } // namespace
 
+FLAG(bool,
+     events_binary_rows,
+     true,
+     "Store event rows using a compact binary encoding instead of JSON");
+
 FLAG(bool,
      events_optimize,
      true,
@@ -86,6 +123,31 @@ FLAG(uint64,
      50000,
      "Maximum number of event batches per type to buffer");
 
+FLAG(uint64,
+     events_maintenance_interval,
+     0,
+     "Seconds between background expiry of stored events (0 = when added)");
+
+FLAG(uint64,
+     events_ingest_queue,
+     0,
+     "Queue up to this many event batches per subscriber (0 = disabled)");
+
+FLAG(string,
+     events_memory_subscribers,
+     "",
+     "Comma-separated subscribers keeping events in memory, not the database");
+
+FLAG(string,
+     events_stream_subscribers,
+     "",
+     "Comma-separated subscribers only forwarding events to loggers");
+
+FLAG(uint64,
+     events_memory_max_bytes,
+     64 * 1024 * 1024,
+     "Maximum bytes of events kept in memory per subscriber");
+
 CREATE_REGISTRY(EventSubscriberPlugin, "event_subscriber");
 
 EventSubscriberPlugin::EventSubscriberPlugin(bool enabled)
@@ -110,47 +172,145 @@ Status EventSubscriberPlugin::addBatch(std::vector<Row>& row_list) {
 
 Status EventSubscriberPlugin::addBatch(std::vector<Row>& row_list,
                                        EventTime custom_event_time) {
+  monitoring::LatencyTimer timer(addBatchLatency());
   removeDeprecatedEventKeysOnce();
 
+  if (row_list.empty()) {
+    return Status(1, "Failed to process the rows");
+  }
+
+  std::shared_ptr<const EventIngestFilter> ingest_filter;
+  {
+    ReadLock lock(ingest_filter_mutex_);
+    ingest_filter = ingest_filter_;
+  }
+
+  // Events no scheduled query can return are not stored.
+  if (ingest_filter != nullptr) {
+    row_list.erase(std::remove_if(row_list.begin(),
+                                  row_list.end(),
+                                  [&ingest_filter](const Row& r) {
+                                    return !ingest_filter->matches(r);
+                                  }),
+                   row_list.end());
+    if (row_list.empty()) {
+      return Status::success();
+    }
+  }
+
+  std::vector<PendingBatch> batches(1);
+  batches[0].time = custom_event_time != 0 ? custom_event_time : getTime();
+  batches[0].rows = std::move(row_list);
+
+  // A full queue is written by the publisher, events are never dropped.
+  if (ingest_queue_ != nullptr && ingest_queue_->tryPush(batches[0])) {
+    return Status::success();
+  }
+
+  return writeBatches(batches);
+}
+
+Status EventSubscriberPlugin::writeBatches(
+    std::vector<PendingBatch>& batches) {
   DatabaseStringValueList database_data;
-  database_data.reserve(row_list.size());
+  database_data.reserve(batches.size() + 1);
 
-  EventIDList event_id_list;
-  event_id_list.reserve(row_list.size());
+  std::vector<std::pair<EventTime, EventSegment>> segment_list;
+  segment_list.reserve(batches.size());
 
-  auto event_time = custom_event_time != 0 ? custom_event_time : getTime();
-  auto string_event_time = std::to_string(event_time);
+  // JSON is only needed for storage or when loggers receive the events.
+  auto forward_events = EventFactory::forwardsEvents();
+  auto stream_only = stream_only_ && forward_events;
+  auto binary_rows = useBinaryRows() && !stream_only;
+
+  std::vector<std::string> forwarded_rows;
+  if (forward_events) {
+    forwarded_rows.reserve(batches.size());
+  }
 
-  for (auto& row : row_list) {
-    auto event_identifier = getEventID();
-    event_id_list.push_back(event_identifier);
+  WriteLock encoding_lock(context.dictionary_mutex, boost::defer_lock);
+  if (binary_rows) {
+    encoding_lock.lock();
+  }
 
-    auto string_event_identifier = toIndex(event_identifier);
+  std::size_t row_count{0U};
+  for (auto& batch : batches) {
+    auto string_event_time = std::to_string(batch.time);
+    row_count += batch.rows.size();
 
-    row["time"] = string_event_time;
-    row["eid"] = string_event_identifier;
+    // The rows of a batch are stored together as one segment.
+    SegmentRows segment_rows;
+    segment_rows.reserve(batch.rows.size());
 
-    // Serialize and store the row data, for query-time retrieval.
-    std::string serialized_row;
-    auto status = serializeRowJSON(row, serialized_row);
-    if (!status.ok()) {
-      VLOG(1) << status.getMessage();
-      continue;
-    }
+    for (auto& row : batch.rows) {
+      auto event_identifier = getEventID();
+      auto string_event_identifier = toIndex(event_identifier);
+
+      row["time"] = string_event_time;
+      row["eid"] = string_event_identifier;
+
+      // Serialize and store the row data, for query-time retrieval.
+      std::string serialized_row;
+      if (!binary_rows || forward_events) {
+        auto status = serializeRowJSON(row, serialized_row);
+        if (!status.ok()) {
+          VLOG(1) << status.getMessage();
+          continue;
+        }
+
+        // Then remove the newline.
+        if (serialized_row.size() > 0 && serialized_row.back() == '\n') {
+          serialized_row.pop_back();
+        }
+
+        // Logger plugins may request events to be forwarded directly.
+        // If no active logger is marked 'usesLogEvent' then this is a no-op.
+        if (stream_only) {
+          forwarded_rows.push_back(std::move(serialized_row));
+          continue;
+        }
+        forwarded_rows.push_back(serialized_row);
+      }
+
+      if (binary_rows) {
+        context.dictionary.encode(row, serialized_row);
+      }
 
-    // Then remove the newline.
-    if (serialized_row.size() > 0 && serialized_row.back() == '\n') {
-      serialized_row.pop_back();
+      // Store the event data in the segment
+      segment_rows.push_back(
+          std::make_pair(event_identifier, std::move(serialized_row)));
     }
 
-    // Logger plugins may request events to be forwarded directly.
-    // If no active logger is marked 'usesLogEvent' then this is a no-op.
-    EventFactory::forwardEvent(serialized_row);
+    if (segment_rows.empty()) {
+      continue;
+    }
 
-    // Store the event data in the batch
+    EventSegment segment{segment_rows.front().first,
+                         segment_rows.back().first};
+    std::string serialized_segment;
+    serializeSegment(batch.time, segment_rows, serialized_segment);
     database_data.push_back(
-        std::make_pair("data." + dbNamespace() + "." + string_event_identifier,
-                       serialized_row));
+        std::make_pair(databaseKeyForEventId(context, segment.first),
+                       std::move(serialized_segment)));
+    segment_list.push_back(std::make_pair(batch.time, segment));
+  }
+
+  if (encoding_lock.owns_lock()) {
+    encoding_lock.unlock();
+  }
+
+  auto forwarded_count = forwarded_rows.size();
+  EventFactory::forwardEvents(forwarded_rows);
+
+  // Stream-only subscribers hand their rows to the loggers and store nothing.
+  if (stream_only) {
+    if (forwarded_count == 0) {
+      return Status(1, "Failed to process the rows");
+    }
+
+    WriteLock lock(event_id_lock_);
+    event_count_ += forwarded_count;
+    return Status::success();
   }
 
   if (database_data.empty()) {
@@ -163,33 +323,59 @@ Status EventSubscriberPlugin::addBatch(std::vector<Row>& row_list,
   {
     WriteLock lock(event_id_lock_);
 
-    auto status = setDatabaseBatch(kEvents, database_data);
+    // Rows are stored together with the columns they added to the dictionary.
+    WriteLock dictionary_lock(context.dictionary_mutex, boost::defer_lock);
+    if (binary_rows) {
+      dictionary_lock.lock();
+      if (context.dictionary.grown() > 0) {
+        std::string serialized_dictionary;
+        context.dictionary.serialize(serialized_dictionary);
+        database_data.push_back(std::make_pair(
+            databaseKeyForDictionary(context), serialized_dictionary));
+      }
+    }
+
+    auto status = getDatabase().setDatabaseBatch(kEvents, database_data);
     if (!status.ok()) {
       return status;
     }
 
+    if (binary_rows) {
+      context.dictionary.clearGrown();
+      dictionary_lock.unlock();
+    }
+
     {
       WriteLock lock(context.event_index_mutex);
-
-      auto it = context.event_index.find(event_time);
-      if (it == context.event_index.end()) {
-        context.event_index.insert({event_time, event_id_list});
-
-      } else {
-        auto& index_entry = it->second;
-        index_entry.insert(
-            index_entry.end(), event_id_list.begin(), event_id_list.end());
+      for (const auto& segment : segment_list) {
+        context.event_index.add(segment.first, segment.second);
       }
     }
 
-    cleanup_events = (((event_count_ % kEventsCheckpoint) + row_list.size()) >=
+    cleanup_events = (((event_count_ % kEventsCheckpoint) + row_count) >=
                       kEventsCheckpoint);
-    event_count_ += row_list.size();
+    event_count_ += row_count;
+  }
+
+  // The lag of the newest batch, events timed by their source include the
+  // time they spent in the publisher and the ingest queue.
+  auto now = getTime();
+  auto newest_time = segment_list.back().first;
+  event_lag_ = now > newest_time ? now - newest_time : 0U;
+  monitoring::record("events." + context.database_namespace + ".lag",
+                     static_cast<monitoring::ValueType>(event_lag_),
+                     monitoring::PreAggregationType::Max);
+
+  // Events kept in memory are evicted as soon as they exceed the byte limit.
+  if (memory_store_ != nullptr) {
+    removeEventBatchesOverBytes(
+        context, *memory_store_, FLAGS_events_memory_max_bytes);
   }
 
   // Use the last EventID and a checkpoint bucket size to periodically apply
   // buffer eviction. Eviction occurs if the total count exceeds events_max.
-  if (cleanup_events) {
+  // The event maintenance service applies it instead when it is enabled.
+  if (cleanup_events && FLAGS_events_maintenance_interval == 0) {
     removeOverflowingEventBatches(context, getDatabase(), getEventBatchesMax());
 
     expireEventBatches(context, getDatabase(), getMinExpiry(), getTime());
@@ -198,6 +384,55 @@ Status EventSubscriberPlugin::addBatch(std::vector<Row>& row_list,
   return Status::success();
 }
 
+size_t EventSubscriberPlugin::maintainEventBatches(size_t max_removed) {
+  if (stream_only_) {
+    return 0;
+  }
+
+  auto removed = removeOverflowingEventBatches(
+      context, getDatabase(), getEventBatchesMax(), max_removed);
+  if (max_removed > 0) {
+    if (removed >= max_removed) {
+      return removed;
+    }
+    max_removed -= removed;
+  }
+
+  return removed + expireEventBatches(context,
+                                      getDatabase(),
+                                      getMinExpiry(),
+                                      getTime(),
+                                      max_removed);
+}
+
+size_t EventSubscriberPlugin::flushIngestQueue() {
+  if (ingest_queue_ == nullptr) {
+    return 0;
+  }
+
+  WriteLock lock(ingest_mutex_);
+
+  // Publishers may keep adding, at most one queue's worth is written.
+  std::vector<PendingBatch> batches;
+  PendingBatch batch;
+  while (batches.size() < ingest_queue_->capacity() &&
+         ingest_queue_->tryPop(batch)) {
+    batches.push_back(std::move(batch));
+  }
+
+  if (batches.empty()) {
+    return 0;
+  }
+
+  auto status = writeBatches(batches);
+  if (!status.ok()) {
+    LOG(ERROR) << "Failed to store " << batches.size()
+               << " queued event batches for subscriber " << getName() << ": "
+               << status.getMessage();
+  }
+  return batches.size();
+}
+
 Status EventSubscriberPlugin::generateEventDataIndex() {
   return generateEventDataIndex(context, getDatabase());
 }
@@ -218,12 +453,22 @@ bool EventSubscriberPlugin::shouldOptimize() const {
   return isDaemon() && FLAGS_events_optimize;
 }
 
+bool EventSubscriberPlugin::useBinaryRows() const {
+  return FLAGS_events_binary_rows;
+}
+
 void EventSubscriberPlugin::resetQueryCount(size_t count) {
   WriteLock subscriber_lock(event_query_record_);
   queries_.clear();
   query_count_ = count;
 }
 
+void EventSubscriberPlugin::setIngestFilter(
+    std::shared_ptr<const EventIngestFilter> filter) {
+  WriteLock lock(ingest_filter_mutex_);
+  ingest_filter_ = std::move(filter);
+}
+
 void EventSubscriberPlugin::setExecutedQuery(const std::string& query_name,
                                              uint64_t query_time) {
   WriteLock lock(event_query_record_);
@@ -258,7 +503,8 @@ uint64_t EventSubscriberPlugin::getExpireTime() {
 void EventSubscriberPlugin::generateRows(std::function<void(Row)> callback,
                                          bool can_optimize,
                                          EventTime start_time,
-                                         EventTime stop_time) {
+                                         EventTime stop_time,
+                                         const EventRowFilter& filter) {
   EventTime optimize_time{0U};
   EventID optimize_eid{0U};
   if (can_optimize && shouldOptimize()) {
@@ -278,7 +524,8 @@ void EventSubscriberPlugin::generateRows(std::function<void(Row)> callback,
                                callback,
                                start_time,
                                stop_time,
-                               optimize_eid);
+                               optimize_eid,
+                               filter);
 
     if (can_optimize && shouldOptimize() && !result.isEnd) {
       setOptimizeData(getDatabase(), result.last_time, result.last_id);
@@ -319,7 +566,12 @@ void EventSubscriberPlugin::genTable(RowYield& yield, QueryContext& context) {
     yield(TableRowHolder(new DynamicTableRow(std::move(row))));
   };
 
-  generateRows(generateRowsCallback, can_optimize, start, stop);
+  // The other simple constraints are evaluated while events are scanned.
+  generateRows(generateRowsCallback,
+               can_optimize,
+               start,
+               stop,
+               EventRowFilter(context));
 }
 
 size_t EventSubscriberPlugin::numSubscriptions() const {
@@ -330,6 +582,14 @@ EventContextID EventSubscriberPlugin::numEvents() const {
   return event_count_;
 }
 
+size_t EventSubscriberPlugin::numDroppedEvents() const {
+  return context.dropped_events;
+}
+
+EventTime EventSubscriberPlugin::eventLag() const {
+  return event_lag_;
+}
+
 bool EventSubscriberPlugin::executedAllQueries() const {
   ReadLock lock(event_query_record_);
   return queries_.size() >= query_count_;
@@ -343,6 +603,63 @@ std::string EventSubscriberPlugin::toIndex(std::uint64_t i) {
   return str_index;
 }
 
+bool EventSubscriberPlugin::isSegment(const std::string& value) {
+  return value.compare(0, kEventSegmentMagic.size(), kEventSegmentMagic) == 0;
+}
+
+void EventSubscriberPlugin::serializeSegment(EventTime time,
+                                             const SegmentRows& rows,
+                                             std::string& segment) {
+  segment.clear();
+  segment.append(kEventSegmentMagic);
+  segment.push_back(static_cast<char>(kEventSegmentVersion));
+  putVarint(segment, time);
+  putVarint(segment, rows.size());
+
+  // EventIDs are stored as the difference to the previous one.
+  EventID previous{0U};
+  for (const auto& row : rows) {
+    putVarint(segment, row.first - previous);
+    putString(segment, row.second);
+    previous = row.first;
+  }
+}
+
+Status EventSubscriberPlugin::deserializeSegment(const std::string& segment,
+                                                 EventTime& time,
+                                                 SegmentRows& rows) {
+  if (!isSegment(segment)) {
+    return Status::failure("Value is not an event segment");
+  }
+
+  BinaryReader reader(segment, kEventSegmentMagic.size());
+  uint8_t version = 0;
+  if (!reader.getByte(version) || version != kEventSegmentVersion) {
+    return Status::failure("Unsupported event segment version");
+  }
+
+  uint64_t count = 0;
+  if (!reader.getVarint(time) || !reader.getVarint(count) ||
+      count > reader.remaining()) {
+    return Status::failure("Malformed event segment");
+  }
+
+  rows.clear();
+  rows.reserve(static_cast<size_t>(count));
+  EventID previous{0U};
+  for (uint64_t i = 0; i < count; ++i) {
+    uint64_t delta = 0;
+    std::string row;
+    if (!reader.getVarint(delta) || !reader.getString(row)) {
+      return Status::failure("Malformed event segment row");
+    }
+    previous += delta;
+    rows.push_back(std::make_pair(previous, std::move(row)));
+  }
+
+  return Status::success();
+}
+
 void EventSubscriberPlugin::setOptimizeData(IDatabaseInterface& db_interface,
                                             EventTime time,
                                             EventID eid) {
@@ -407,21 +724,22 @@ void EventSubscriberPlugin::setDatabaseNamespace(Context& context,
 
 Status EventSubscriberPlugin::generateEventDataIndex(
     Context& context, IDatabaseInterface& db_interface) {
-  std::vector<std::string> key_list;
-
-  std::string prefix = "data." + context.database_namespace + ".";
-  auto status = db_interface.scanDatabaseKeys(kEvents, key_list, prefix, 0);
+  auto status = loadRowDictionary(context, db_interface);
   if (!status.ok()) {
-    return status;
+    // Binary rows cannot be decoded and are removed as invalid events.
+    LOG(WARNING) << "Failed to load the event dictionary for subscriber "
+                 << context.database_namespace << ": " << status.getMessage();
   }
 
+  std::string prefix = "data." + context.database_namespace + ".";
+
   std::vector<std::string> invalid_data_key_list;
   std::size_t event_count{0U};
 
   EventID last_event_id{1U};
   EventIndex event_index;
 
-  for (const auto& key : key_list) {
+  auto index_event = [&](const std::string& key, std::string& value) {
     auto string_event_id = &key[prefix.size()];
 
     EventID event_identifier = {};
@@ -432,48 +750,54 @@ Status EventSubscriberPlugin::generateEventDataIndex(
       if (int_value == 0U || null_terminator == nullptr ||
           *null_terminator != '\0') {
         invalid_data_key_list.push_back(key);
-        continue;
+        return true;
       }
 
       event_identifier = static_cast<EventID>(int_value);
     }
 
-    last_event_id = std::max(last_event_id, event_identifier);
-
     EventTime event_time = {};
+    EventSegment segment{event_identifier, event_identifier};
 
     {
-      std::string serialized_row;
-      status = db_interface.getDatabaseValue(kEvents, key, serialized_row);
-      if (!status.ok()) {
-        invalid_data_key_list.push_back(key);
-        continue;
-      }
+      if (isSegment(value)) {
+        SegmentRows rows;
+        if (!deserializeSegment(value, event_time, rows) || rows.empty() ||
+            rows.front().first != event_identifier) {
+          invalid_data_key_list.push_back(key);
+          return true;
+        }
 
-      Row row;
-      if (!deserializeRowJSON(serialized_row, row)) {
-        invalid_data_key_list.push_back(key);
-        continue;
-      }
+        segment.last = rows.back().first;
+        event_count += rows.size();
 
-      if (row.count("time") == 0) {
-        invalid_data_key_list.push_back(key);
-        continue;
-      }
+      } else {
+        // Older versions stored every event using its own key.
+        Row row;
+        if (!deserializeRow(context, value, row)) {
+          invalid_data_key_list.push_back(key);
+          return true;
+        }
 
-      event_time = boost::lexical_cast<EventTime>(row.at("time"));
-    }
+        if (row.count("time") == 0) {
+          invalid_data_key_list.push_back(key);
+          return true;
+        }
 
-    auto it = event_index.find(event_time);
-    if (it == event_index.end()) {
-      auto insert_status = event_index.insert({event_time, {}});
-      it = insert_status.first;
+        event_time = boost::lexical_cast<EventTime>(row.at("time"));
+        ++event_count;
+      }
     }
 
-    auto& event_id_list = it->second;
-    event_id_list.push_back(event_identifier);
+    last_event_id = std::max(last_event_id, segment.last);
+    event_index.add(event_time, segment);
+    return true;
+  };
 
-    ++event_count;
+  // Each key and value is read in one scan of the subscriber's prefix.
+  status = db_interface.scanDatabaseValues(kEvents, prefix, 0, index_event);
+  if (!status.ok()) {
+    return status;
   }
 
   if (!invalid_data_key_list.empty()) {
@@ -508,12 +832,43 @@ std::string EventSubscriberPlugin::databaseKeyForEventId(Context& context,
          string_event_id;
 }
 
-void EventSubscriberPlugin::removeOverflowingEventBatches(
+std::string EventSubscriberPlugin::databaseKeyForDictionary(Context& context) {
+  return kEventsDictionaryPrefix + context.database_namespace;
+}
+
+Status EventSubscriberPlugin::loadRowDictionary(
+    Context& context, IDatabaseInterface& db_interface) {
+  WriteLock lock(context.dictionary_mutex);
+  context.dictionary = BinaryRowDictionary();
+
+  std::string serialized;
+  auto status = db_interface.getDatabaseValue(
+      kEvents, databaseKeyForDictionary(context), serialized);
+  if (!status.ok() || serialized.empty()) {
+    // Subscribers that have not stored binary rows have no dictionary.
+    return Status::success();
+  }
+  return context.dictionary.deserialize(serialized);
+}
+
+Status EventSubscriberPlugin::deserializeRow(Context& context,
+                                             const std::string& serialized_row,
+                                             Row& row) {
+  if (!BinaryRowDictionary::isEncoded(serialized_row)) {
+    return deserializeRowJSON(serialized_row, row);
+  }
+
+  ReadLock lock(context.dictionary_mutex);
+  return context.dictionary.decode(serialized_row, row);
+}
+
+std::size_t EventSubscriberPlugin::removeOverflowingEventBatches(
     Context& context,
     IDatabaseInterface& db_interface,
-    std::size_t max_event_batches) {
+    std::size_t max_event_batches,
+    std::size_t max_removed) {
   if (max_event_batches == 0U) {
-    return;
+    return 0U;
   }
 
   EventIndex excess_event_batch_list;
@@ -521,21 +876,18 @@ void EventSubscriberPlugin::removeOverflowingEventBatches(
   {
     WriteLock lock(context.event_index_mutex);
     if (context.event_index.size() <= max_event_batches) {
-      return;
+      return 0U;
     }
 
     auto batches_to_remove = context.event_index.size() - max_event_batches;
-    auto range_start = context.event_index.begin();
-    auto range_end = std::next(range_start, batches_to_remove);
-
-    excess_event_batch_list.insert(std::make_move_iterator(range_start),
-                                   std::make_move_iterator(range_end));
-
-    context.event_index.erase(range_start, range_end);
+    if (max_removed > 0U) {
+      batches_to_remove = std::min(batches_to_remove, max_removed);
+    }
+    excess_event_batch_list = context.event_index.takeOldest(batches_to_remove);
   }
 
   if (excess_event_batch_list.empty()) {
-    return;
+    return 0U;
   }
 
   std::string string_last_query_time;
@@ -554,20 +906,50 @@ void EventSubscriberPlugin::removeOverflowingEventBatches(
     string_last_query_time = buffer.data();
   }
 
-  std::size_t batches_removed{};
-  for (const auto& p : excess_event_batch_list) {
-    const auto& event_identifier_list = p.second;
+  auto failed_delete_count =
+      deleteEventSegments(context, db_interface, excess_event_batch_list);
+  auto batches_removed = excess_event_batch_list.size();
+  recordDroppedEvents(context, excess_event_batch_list);
 
-    for (auto event_id : event_identifier_list) {
-      auto key = databaseKeyForEventId(context, event_id);
-      auto status = db_interface.deleteDatabaseValue(kEvents, key);
-      if (status.ok()) {
-        ++batches_removed;
+  std::stringstream message;
+  message << "Removed " << batches_removed << " event batches ";
+
+  if (failed_delete_count > 0U) {
+    message << "(with " << failed_delete_count << " delete errors)  ";
+  }
+
+  message << "for subscriber: " << context.database_namespace
+          << " (limit: " << max_event_batches
+          << ", last query: " << string_last_query_time << ")";
+
+  LOG(WARNING) << message.str();
+  return batches_removed;
+}
+
+void EventSubscriberPlugin::removeEventBatchesOverBytes(
+    Context& context, EventMemoryStore& store, std::size_t max_bytes) {
+  if (max_bytes == 0U || store.bytes() <= max_bytes) {
+    return;
+  }
+
+  std::size_t batches_removed{0U};
+  std::size_t failed_delete_count{0U};
+  while (store.bytes() > max_bytes) {
+    EventIndex oldest_event_batch;
+    {
+      WriteLock lock(context.event_index_mutex);
+      if (context.event_index.empty()) {
+        break;
       }
+
+      oldest_event_batch = context.event_index.takeOldest(1U);
     }
-  }
 
-  auto failed_delete_count = (excess_event_batch_list.size() - batches_removed);
+    failed_delete_count +=
+        deleteEventSegments(context, store, oldest_event_batch);
+    recordDroppedEvents(context, oldest_event_batch);
+    ++batches_removed;
+  }
 
   std::stringstream message;
   message << "Removed " << batches_removed << " event batches ";
@@ -577,18 +959,19 @@ void EventSubscriberPlugin::removeOverflowingEventBatches(
   }
 
   message << "for subscriber: " << context.database_namespace
-          << " (limit: " << max_event_batches
-          << ", last query: " << string_last_query_time << ")";
+          << " (memory limit: " << max_bytes << " bytes)";
 
   LOG(WARNING) << message.str();
 }
 
-void EventSubscriberPlugin::expireEventBatches(Context& context,
-                                               IDatabaseInterface& db_interface,
-                                               std::size_t events_expiry,
-                                               std::size_t current_time) {
+std::size_t EventSubscriberPlugin::expireEventBatches(
+    Context& context,
+    IDatabaseInterface& db_interface,
+    std::size_t events_expiry,
+    std::size_t current_time,
+    std::size_t max_removed) {
   if (events_expiry == 0 || current_time == 0) {
-    return;
+    return 0U;
   }
 
   EventIndex expired_event_batch_list;
@@ -596,44 +979,76 @@ void EventSubscriberPlugin::expireEventBatches(Context& context,
   {
     WriteLock lock(context.event_index_mutex);
     if (context.event_index.empty()) {
-      return;
+      return 0U;
     }
 
     auto oldest_valid_time = current_time - events_expiry;
 
-    auto oldest_event_time = context.event_index.begin()->first;
+    auto oldest_event_time = context.event_index.oldestTime();
     if (oldest_event_time >= oldest_valid_time) {
-      return;
+      return 0U;
     }
 
-    auto range_start = context.event_index.begin();
-    auto range_end = context.event_index.upper_bound(oldest_valid_time);
+    expired_event_batch_list =
+        context.event_index.takeUntil(oldest_valid_time, max_removed);
+  }
 
-    expired_event_batch_list.insert(std::make_move_iterator(range_start),
-                                    std::make_move_iterator(range_end));
+  auto error_count =
+      deleteEventSegments(context, db_interface, expired_event_batch_list);
+  if (error_count > 0U) {
+    LOG(ERROR) << "Failed to expire " << error_count
+               << " events due to database errors";
+  }
+  return expired_event_batch_list.size();
+}
 
-    context.event_index.erase(range_start, range_end);
+std::size_t EventSubscriberPlugin::deleteEventSegments(
+    Context& context,
+    IDatabaseInterface& db_interface,
+    const EventIndex& removed) {
+  EventSegmentList segment_list;
+  segment_list.reserve(removed.segments());
+  for (const auto& entry : removed) {
+    segment_list.push_back(entry.segment);
   }
 
-  // TODO(alessandro): Implement deleteDatabaseBatch
-  std::size_t error_count{};
+  std::sort(segment_list.begin(),
+            segment_list.end(),
+            [](const EventSegment& l, const EventSegment& r) {
+              return l.first < r.first;
+            });
+
+  std::size_t error_count{0U};
+  for (auto it = segment_list.begin(); it != segment_list.end();) {
+    // No other segment can be stored between consecutive EventIDs, a run of
+    // them is deleted as a single range of keys.
+    auto range_end = std::next(it);
+    auto last_event_id = it->last;
+    while (range_end != segment_list.end() &&
+           range_end->first == last_event_id + 1 &&
+           toIndex(range_end->first).size() == toIndex(it->first).size()) {
+      last_event_id = range_end->last;
+      ++range_end;
+    }
 
-  for (const auto& p : expired_event_batch_list) {
-    const auto& event_identifier_list = p.second;
+    auto segment_count = static_cast<std::size_t>(std::distance(it, range_end));
+    auto low = databaseKeyForEventId(context, it->first);
 
-    for (const auto& event_identifier : event_identifier_list) {
-      auto key = databaseKeyForEventId(context, event_identifier);
-      auto status = db_interface.deleteDatabaseValue(kEvents, key);
-      if (!status.ok()) {
-        ++error_count;
-      }
+    Status status;
+    if (segment_count == 1U) {
+      status = db_interface.deleteDatabaseValue(kEvents, low);
+    } else {
+      auto high = databaseKeyForEventId(context, std::prev(range_end)->first);
+      status = db_interface.deleteDatabaseRange(kEvents, low, high);
     }
-  }
 
-  if (error_count > 0U) {
-    LOG(ERROR) << "Failed to expire " << error_count
-               << " events due to database errors";
+    if (!status.ok()) {
+      error_count += segment_count;
+    }
+    it = range_end;
   }
+
+  return error_count;
 }
 
 EventSubscriberPlugin::GenerateRowsResult EventSubscriberPlugin::generateRows(
@@ -642,69 +1057,91 @@ EventSubscriberPlugin::GenerateRowsResult EventSubscriberPlugin::generateRows(
     std::function<void(Row)> callback,
     EventTime start_time,
     EventTime end_time,
-    EventID last_eid) {
+    EventID last_eid,
+    const EventRowFilter& filter) {
   EventSubscriberPlugin::GenerateRowsResult ret{true, 0, 0};
-  std::vector<EventID> collected_event_id_list;
+  EventSegmentList collected_segment_list;
   {
     ReadLock lock(context.event_index_mutex);
-    auto last = context.event_index.end();
     if (end_time != 0 && start_time > end_time) {
       return ret;
     }
 
-    EventIndex::iterator lower_bound_it;
-    if (start_time == 0U) {
-      lower_bound_it = context.event_index.begin();
-
-    } else {
-      lower_bound_it = context.event_index.lower_bound(start_time);
-      if (lower_bound_it == context.event_index.end()) {
-        return ret;
-      }
-    }
-
+    auto lower_bound_it = (start_time == 0U)
+                              ? context.event_index.begin()
+                              : context.event_index.lowerBound(start_time);
     auto upper_bound_it = (end_time == 0U)
                               ? context.event_index.end()
-                              : context.event_index.upper_bound(end_time);
+                              : context.event_index.upperBound(end_time);
+    if (lower_bound_it == upper_bound_it) {
+      return ret;
+    }
 
     for (auto it = lower_bound_it; it != upper_bound_it; ++it) {
-      const auto& event_id_list = it->second;
-
-      for (const auto& event_identifier : event_id_list) {
-        if (last_eid >= event_identifier) {
-          // A previous optimized query has already visited this event.
-          continue;
-        }
-        collected_event_id_list.push_back(event_identifier);
+      if (last_eid >= it->segment.last) {
+        // A previous optimized query has already visited these events.
+        continue;
       }
-      last = it;
+      collected_segment_list.push_back(it->segment);
     }
 
-    if (last != context.event_index.end()) {
-      ret = EventSubscriberPlugin::GenerateRowsResult{
-          false, last->first, last->second.empty() ? 0 : last->second.back()};
-    }
+    auto last = std::prev(upper_bound_it);
+    ret = EventSubscriberPlugin::GenerateRowsResult{
+        false, last->time, last->segment.last};
   }
 
   std::vector<std::string> invalid_key_list;
-  for (const auto& event_identifier : collected_event_id_list) {
-    auto key = databaseKeyForEventId(context, event_identifier);
+  for (const auto& segment : collected_segment_list) {
+    auto key = databaseKeyForEventId(context, segment.first);
 
-    std::string serialized_row;
-    auto status = db_interface.getDatabaseValue(kEvents, key, serialized_row);
-    if (serialized_row.empty()) {
+    std::string value;
+    auto status = db_interface.getDatabaseValue(kEvents, key, value);
+    if (value.empty()) {
       invalid_key_list.push_back(key);
       continue;
     }
 
-    Row row = {};
-    status = deserializeRowJSON(serialized_row, row);
-    if (!status.ok()) {
-      invalid_key_list.push_back(key);
-      continue;
+    SegmentRows rows;
+    if (isSegment(value)) {
+      EventTime segment_time{0U};
+      status = deserializeSegment(value, segment_time, rows);
+      if (!status.ok()) {
+        invalid_key_list.push_back(key);
+        continue;
+      }
+    } else {
+      rows.push_back(std::make_pair(segment.first, std::move(value)));
     }
 
-    callback(std::move(row));
+    for (const auto& stored_row : rows) {
+      if (last_eid >= stored_row.first) {
+        continue;
+      }
+
+      // Binary rows are checked using only the constrained columns.
+      auto binary_row = BinaryRowDictionary::isEncoded(stored_row.second);
+      Row row = {};
+      if (!filter.empty() && binary_row) {
+        ReadLock lock(context.dictionary_mutex);
+        const auto& columns = filter.columns();
+        if (context.dictionary.decode(stored_row.second, columns, row).ok() &&
+            !filter.matches(row)) {
+          continue;
+        }
+      }
+
+      status = deserializeRow(context, stored_row.second, row);
+      if (!status.ok()) {
+        // A segment is removed as a whole, some rows may have been emitted.
+        invalid_key_list.push_back(key);
+        break;
+      }
+
+      if (!binary_row && !filter.matches(row)) {
+        continue;
+      }
+      callback(std::move(row));
+    }
   }
 
   if (!invalid_key_list.empty()) {
@@ -733,6 +1170,9 @@ uint64_t EventSubscriberPlugin::getTime() const {
 }
 
 IDatabaseInterface& EventSubscriberPlugin::getDatabase() const {
+  if (memory_store_ != nullptr) {
+    return *memory_store_;
+  }
   return getOsqueryDatabase();
 }
 
@@ -756,6 +1196,22 @@ void EventSubscriberPlugin::setDatabaseNamespace() {
 }
 
 Status EventSubscriberPlugin::setUp() {
+  if (memory_store_ == nullptr) {
+    for (const auto& name : split(FLAGS_events_memory_subscribers, ",")) {
+      if (name == getName()) {
+        memory_store_ = std::make_unique<EventMemoryStore>();
+        break;
+      }
+    }
+  }
+
+  for (const auto& name : split(FLAGS_events_stream_subscribers, ",")) {
+    if (name == getName()) {
+      stream_only_ = true;
+      break;
+    }
+  }
+
   setDatabaseNamespace();
   generateEventDataIndex();
 
@@ -763,6 +1219,11 @@ Status EventSubscriberPlugin::setUp() {
 
   removeOverflowingEventBatches(context, getDatabase(), getEventBatchesMax());
 
+  if (ingest_queue_ == nullptr && FLAGS_events_ingest_queue > 0) {
+    ingest_queue_ = std::make_unique<MpscRingBuffer<PendingBatch>>(
+        static_cast<size_t>(FLAGS_events_ingest_queue));
+  }
+
   return Status::success();
 }
 
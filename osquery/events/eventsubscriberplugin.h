@@ -12,9 +12,15 @@
 #include <gtest/gtest_prod.h>
 
 #include <osquery/core/plugins/plugin.h>
+#include <osquery/core/sql/binary_rows.h>
 #include <osquery/core/tables.h>
 #include <osquery/database/database.h>
 #include <osquery/events/eventer.h>
+#include <osquery/events/eventindex.h>
+#include <osquery/events/eventingestfilter.h>
+#include <osquery/events/eventmemorystore.h>
+#include <osquery/events/eventrowfilter.h>
+#include <osquery/events/mpsc_ring_buffer.h>
 #include <osquery/events/types.h>
 #include <osquery/utils/mutex.h>
 
@@ -60,7 +66,11 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
    * The backing store data retrieval is optimized by time-based indexes. It
    * is important to added EventTime as it relates to "when the event occurred".
    *
-   * @param row_list A (writable) vector of osquery Row elements.
+   * When events_ingest_queue is set the rows are placed in a queue and
+   * stored by a background writer, publishers do not wait for the database.
+   *
+   * @param row_list A (writable) vector of osquery Row elements, the rows are
+   * moved out of the vector.
    *
    * @return Was the element added to the backing store.
    */
@@ -72,6 +82,27 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
                           EventTime custom_event_time) final;
 
  private:
+  /// Rows of an addBatch call, all sharing an event time.
+  struct PendingBatch {
+    EventTime time{0};
+    std::vector<Row> rows;
+  };
+
+  /// Store batches, each as one segment, using a single database write.
+  Status writeBatches(std::vector<PendingBatch>& batches);
+
+  /// Store the batches waiting in the ingest queue, returns the count.
+  size_t flushIngestQueue();
+
+  /**
+   * @brief Remove the overflowing and expired batches of the database.
+   *
+   * Used by the event maintenance service, see events_maintenance_interval.
+   *
+   * @return The number of batches removed, at most max_removed.
+   */
+  size_t maintainEventBatches(size_t max_removed);
+
   /// Scans the database to enumerate all the data keys and build a new index
   Status generateEventDataIndex();
 
@@ -115,6 +146,14 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
   /// Determine if the subscriber should attempt optmization.
   virtual bool shouldOptimize() const;
 
+  /**
+   * @brief Check if event rows are stored using the binary row encoding.
+   *
+   * The default implementation retrieves this value from
+   * FLAGS_events_binary_rows. Stored rows are decoded using either encoding.
+   */
+  virtual bool useBinaryRows() const;
+
   /**
    * @brief Return all events added by this EventSubscriber within start, stop.
    *
@@ -124,12 +163,14 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
    * @param can_optimize If true then optimization can be considered.
    * @param start_time Inclusive lower bound time limit.
    * @param end_time Inclusive upper bound time limit.
+   * @param filter (optional) Constraints rows must match to be emitted.
    * @return Set of event rows matching time limits.
    */
   void generateRows(std::function<void(Row)> callback,
                     bool can_optimize,
                     EventTime start_time,
-                    EventTime stop_stop);
+                    EventTime stop_stop,
+                    const EventRowFilter& filter = EventRowFilter());
 
   /// Track a query execution.
   virtual void setExecutedQuery(const std::string& query_name,
@@ -138,6 +179,14 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
   /// Set the number of queries in the schedule using this subscriber.
   void resetQueryCount(size_t count);
 
+  /**
+   * @brief Set the events the schedule may return, see events_ingest_filters.
+   *
+   * Rows the filter does not match are dropped by addBatch, a nullptr filter
+   * keeps every row.
+   */
+  void setIngestFilter(std::shared_ptr<const EventIngestFilter> filter);
+
   /// Return the smallest expiry window based on the query schedule.
   size_t getMinExpiry();
 
@@ -179,6 +228,17 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
   /// The number of events this EventSubscriber has received.
   EventContextID numEvents() const;
 
+  /// The number of events evicted from storage before they expired.
+  size_t numDroppedEvents() const;
+
+  /**
+   * @brief Seconds between the time of the latest stored events and storing
+   * them.
+   *
+   * Events timed by their source include the time spent in the publisher.
+   */
+  EventTime eventLag() const;
+
   /// Compare the number of queries run against the queries configured.
   virtual bool executedAllQueries() const;
 
@@ -189,10 +249,32 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
 
     std::size_t last_query_time{0U};
     std::atomic<EventID> last_event_id{0U};
+
+    /// The column dictionary of rows stored using the binary encoding.
+    BinaryRowDictionary dictionary;
+    Mutex dictionary_mutex;
+
+    /// Events evicted by events_max or the memory limit.
+    std::atomic<std::size_t> dropped_events{0U};
   };
 
   static std::string toIndex(std::uint64_t i);
 
+  /// The stored rows of a segment and their EventIDs, in EventID order.
+  using SegmentRows = std::vector<std::pair<EventID, std::string>>;
+
+  /// Check if a stored value is a segment (and not a single row).
+  static bool isSegment(const std::string& value);
+
+  /// Serialize the rows of an addBatch, all sharing an event time.
+  static void serializeSegment(EventTime time,
+                               const SegmentRows& rows,
+                               std::string& segment);
+
+  static Status deserializeSegment(const std::string& segment,
+                                   EventTime& time,
+                                   SegmentRows& rows);
+
   static void setOptimizeData(IDatabaseInterface& db_interface,
                               EventTime time,
                               EventID eid);
@@ -215,14 +297,56 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
 
   static std::string databaseKeyForEventId(Context& context, EventID event_id);
 
-  static void removeOverflowingEventBatches(Context& context,
-                                            IDatabaseInterface& db_interface,
-                                            std::size_t max_event_batches);
+  static std::string databaseKeyForDictionary(Context& context);
+
+  /// Load the binary row dictionary, a missing dictionary is empty.
+  static Status loadRowDictionary(Context& context,
+                                  IDatabaseInterface& db_interface);
 
-  static void expireEventBatches(Context& context,
-                                 IDatabaseInterface& db_interface,
-                                 std::size_t events_expiry,
-                                 std::size_t current_time);
+  /// Decode a stored row using the subscriber's dictionary.
+  static Status deserializeRow(Context& context,
+                               const std::string& serialized_row,
+                               Row& row);
+
+  /**
+   * @brief Remove the oldest event batches over max_event_batches.
+   *
+   * @param max_removed Remove at most this many batches, 0 for no limit.
+   * @return The number of batches removed.
+   */
+  static std::size_t removeOverflowingEventBatches(
+      Context& context,
+      IDatabaseInterface& db_interface,
+      std::size_t max_event_batches,
+      std::size_t max_removed = 0U);
+
+  /// Remove the oldest event batches until a memory store fits max_bytes.
+  static void removeEventBatchesOverBytes(Context& context,
+                                          EventMemoryStore& store,
+                                          std::size_t max_bytes);
+
+  /**
+   * @brief Remove the event batches older than events_expiry seconds.
+   *
+   * @param max_removed Remove at most this many batches, 0 for no limit.
+   * @return The number of batches removed.
+   */
+  static std::size_t expireEventBatches(Context& context,
+                                        IDatabaseInterface& db_interface,
+                                        std::size_t events_expiry,
+                                        std::size_t current_time,
+                                        std::size_t max_removed = 0U);
+
+  /**
+   * @brief Delete the stored segments of index entries.
+   *
+   * Segments with consecutive EventIDs are deleted using a single range.
+   *
+   * @return The number of segments that could not be deleted.
+   */
+  static std::size_t deleteEventSegments(Context& context,
+                                         IDatabaseInterface& db_interface,
+                                         const EventIndex& removed);
 
   struct GenerateRowsResult {
     bool isEnd;
@@ -241,14 +365,17 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
    * @param start_time Inclusive lower bound time limit.
    * @param end_time Inclusive upper bound time limit.
    * @param last_eid (optional) The last visited event id.
+   * @param filter (optional) Constraints rows must match to be emitted.
    * @return The upper bound time or 0 if there were no events in the range.
    */
-  static GenerateRowsResult generateRows(Context& context,
-                                         IDatabaseInterface& db_interface,
-                                         std::function<void(Row)> callback,
-                                         EventTime start_time,
-                                         EventTime end_time,
-                                         EventID last_eid = 0);
+  static GenerateRowsResult generateRows(
+      Context& context,
+      IDatabaseInterface& db_interface,
+      std::function<void(Row)> callback,
+      EventTime start_time,
+      EventTime end_time,
+      EventID last_eid = 0,
+      const EventRowFilter& filter = EventRowFilter());
 
   explicit EventSubscriberPlugin(EventSubscriberPlugin const&) = delete;
   EventSubscriberPlugin& operator=(EventSubscriberPlugin const&) = delete;
@@ -271,7 +398,11 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
   /// Return the current time (included to assist testing).
   virtual uint64_t getTime() const;
 
-  /// Return the backing storage (included to assist testing).
+  /**
+   * @brief Return the backing storage (included to assist testing).
+   *
+   * Subscribers listed in events_memory_subscribers use an in-memory store.
+   */
   virtual IDatabaseInterface& getDatabase() const;
 
   /// Get a handle to the EventPublisher.
@@ -286,6 +417,9 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
   /// A helper value counting the number of fired events tracked by publishers.
   EventContextID event_count_{0};
 
+  /// The lag of the latest stored events, see eventLag.
+  std::atomic<EventTime> event_lag_{0};
+
   /// A helper value counting the number of subscriptions created.
   size_t subscription_count_{0};
 
@@ -313,6 +447,29 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
   /// Lock used when recording queries executing against this subscriber.
   mutable Mutex event_query_record_;
 
+  /// Batches added by publishers and not yet stored, see events_ingest_queue.
+  std::unique_ptr<MpscRingBuffer<PendingBatch>> ingest_queue_;
+
+  /// Lock held by the single thread draining the ingest queue.
+  Mutex ingest_mutex_;
+
+  /// The events of a subscriber not using the database.
+  std::unique_ptr<EventMemoryStore> memory_store_;
+
+  /// The events the scheduled queries may return, nullptr for any event.
+  std::shared_ptr<const EventIngestFilter> ingest_filter_;
+
+  /// Lock used when replacing the ingest filter with a configuration update.
+  mutable Mutex ingest_filter_mutex_;
+
+  /**
+   * @brief Set for subscribers listed in events_stream_subscribers.
+   *
+   * Their rows are only forwarded to the loggers receiving events. While no
+   * logger receives events the rows are stored as usual.
+   */
+  bool stream_only_{false};
+
   Context context;
 
   /**
@@ -337,6 +494,7 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
   FRIEND_TEST(EventSubscriberPluginTests, getEventsExpiry);
   FRIEND_TEST(EventSubscriberPluginTests, generateRowsWithExpiry);
   FRIEND_TEST(EventSubscriberPluginTests, generateRowsWithOptimize);
+  FRIEND_TEST(EventSubscriberPluginTests, ingestQueue);
 
   friend class DBFakeEventSubscriber;
   friend class BenchmarkEventSubscriber;
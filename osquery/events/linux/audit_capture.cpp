@@ -0,0 +1,136 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <osquery/events/linux/audit_capture.h>
+#include <osquery/utils/conversions/tryto.h>
+
+namespace osquery {
+
+const std::string kAuditCaptureHeader{"# osquery audit capture 1"};
+
+namespace {
+
+std::string escapeRecord(const char* message, std::size_t size) {
+  std::string escaped;
+  escaped.reserve(size);
+  for (std::size_t i = 0; i < size && message[i] != '\0'; ++i) {
+    if (message[i] == '\\') {
+      escaped += "\\\\";
+    } else if (message[i] == '\n') {
+      escaped += "\\n";
+    } else {
+      escaped += message[i];
+    }
+  }
+  return escaped;
+}
+
+std::string unescapeRecord(const std::string& text, std::size_t position) {
+  std::string message;
+  message.reserve(text.size() - position);
+  for (auto i = position; i < text.size(); ++i) {
+    if (text[i] == '\\' && i + 1 < text.size()) {
+      ++i;
+      message += text[i] == 'n' ? '\n' : text[i];
+    } else {
+      message += text[i];
+    }
+  }
+  return message;
+}
+
+} // namespace
+
+Status AuditCaptureWriter::open(const std::string& path) {
+  output_.open(path, std::ios::out | std::ios::trunc);
+  if (!output_.is_open()) {
+    return Status::failure("Cannot open the audit capture: " + path);
+  }
+
+  output_ << kAuditCaptureHeader << '\n';
+  started_ = false;
+  return Status::success();
+}
+
+bool AuditCaptureWriter::isOpen() const {
+  return output_.is_open();
+}
+
+void AuditCaptureWriter::write(const audit_reply& reply) {
+  if (!output_.is_open() || reply.message == nullptr || reply.len <= 0) {
+    return;
+  }
+
+  auto now = std::chrono::steady_clock::now();
+  if (!started_) {
+    start_ = now;
+    started_ = true;
+  }
+
+  auto offset =
+      std::chrono::duration_cast<std::chrono::microseconds>(now - start_);
+  output_ << offset.count() << ' ' << reply.type << ' '
+          << escapeRecord(reply.message, static_cast<std::size_t>(reply.len))
+          << '\n';
+}
+
+Status readAuditCapture(const std::string& path,
+                        std::vector<AuditCaptureRecord>& records) {
+  std::ifstream input(path);
+  if (!input.is_open()) {
+    return Status::failure("Cannot open the audit capture: " + path);
+  }
+
+  std::string line;
+  if (!std::getline(input, line) || line != kAuditCaptureHeader) {
+    return Status::failure("Not an audit capture: " + path);
+  }
+
+  std::size_t line_number = 1;
+  while (std::getline(input, line)) {
+    ++line_number;
+    if (line.empty()) {
+      continue;
+    }
+
+    auto type_start = line.find(' ');
+    auto message_start = type_start == std::string::npos
+                             ? std::string::npos
+                             : line.find(' ', type_start + 1);
+    if (message_start == std::string::npos) {
+      return Status::failure("Malformed audit capture record at line " +
+                             std::to_string(line_number));
+    }
+
+    auto offset = tryTo<std::uint64_t>(line.substr(0, type_start));
+    auto type = tryTo<int>(
+        line.substr(type_start + 1, message_start - type_start - 1));
+    if (offset.isError() || type.isError()) {
+      return Status::failure("Malformed audit capture record at line " +
+                             std::to_string(line_number));
+    }
+
+    AuditCaptureRecord record;
+    record.offset_us = offset.take();
+    record.type = type.take();
+    record.message = unescapeRecord(line, message_start + 1);
+    records.push_back(std::move(record));
+  }
+
+  return Status::success();
+}
+
+void makeAuditReply(const AuditCaptureRecord& record, audit_reply& reply) {
+  // Only what the parser reads is set, the message buffer is not cleared.
+  reply.type = record.type;
+  reply.len = static_cast<int>(record.message.size());
+  reply.message = record.message.c_str();
+}
+
+} // namespace osquery
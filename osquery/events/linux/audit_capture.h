@@ -0,0 +1,80 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <libaudit.h>
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/// The first line of an audit capture file.
+extern const std::string kAuditCaptureHeader;
+
+/// A raw audit record, as received from the audit netlink.
+struct AuditCaptureRecord final {
+  /// Microseconds since the first record of the capture.
+  std::uint64_t offset_us{0U};
+
+  /// The netlink message type, such as AUDIT_SYSCALL.
+  int type{0};
+
+  /// The record text, starting with its "audit(time:serial): " preamble.
+  std::string message;
+};
+
+/**
+ * @brief Appends the audit records received to a capture file.
+ *
+ * A capture starts with kAuditCaptureHeader, followed by a line per record:
+ * its offset in microseconds, its type and its text separated by spaces.
+ * Newlines and backslashes of the text are escaped. Captures are replayed
+ * at their recorded rate by the audit benchmarks.
+ */
+class AuditCaptureWriter final : private boost::noncopyable {
+ public:
+  /// Open a capture file, truncating it.
+  Status open(const std::string& path);
+
+  /// Check if a capture file is open.
+  bool isOpen() const;
+
+  /// Append a record that AdjustAuditReply prepared.
+  void write(const audit_reply& reply);
+
+ private:
+  std::ofstream output_;
+
+  /// The time the first record was written.
+  std::chrono::steady_clock::time_point start_;
+  bool started_{false};
+};
+
+/// Read the records of a capture file.
+Status readAuditCapture(const std::string& path,
+                        std::vector<AuditCaptureRecord>& records);
+
+/**
+ * @brief Prepare a reply for AuditdNetlinkParser::ParseAuditReply.
+ *
+ * The reply refers to the message of the record, which must outlive it.
+ * Only the type, length and message of the reply are set.
+ */
+void makeAuditReply(const AuditCaptureRecord& record, audit_reply& reply);
+
+} // namespace osquery
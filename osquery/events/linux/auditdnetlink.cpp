@@ -20,12 +20,14 @@
 
 #include <osquery/core/flags.h>
 #include <osquery/events/linux/apparmor_events.h>
+#include <osquery/events/linux/audit_capture.h>
 #include <osquery/events/linux/auditdnetlink.h>
 #include <osquery/events/linux/process_events.h>
 #include <osquery/events/linux/process_file_events.h>
 #include <osquery/events/linux/selinux_events.h>
 #include <osquery/events/linux/socket_events.h>
 #include <osquery/logger/logger.h>
+#include <osquery/utils/conversions/split.h>
 #include <osquery/utils/conversions/tryto.h>
 #include <osquery/utils/expected/expected.h>
 #include <osquery/utils/system/time.h>
@@ -37,6 +39,12 @@ FLAG(bool, audit_persist, true, "Attempt to retain control of audit");
 /// Audit debugger helper
 HIDDEN_FLAG(bool, audit_debug, false, "Debug Linux audit messages");
 
+/// Record the raw audit records to replay them in the audit benchmarks.
+HIDDEN_FLAG(string,
+            audit_capture_path,
+            "",
+            "Write the audit records received to a capture file");
+
 /// Always uninstall all the audit rules that osquery uses when exiting
 FLAG(bool,
      audit_force_unconfigure,
@@ -56,6 +64,22 @@ FLAG(int32, audit_backlog_wait_time, 0, "The audit backlog wait time");
 /// This value is passed directly to the audit API.
 FLAG(int32, audit_backlog_limit, 4096, "The audit backlog limit");
 
+FLAG(string,
+     audit_exclude_exes,
+     "",
+     "Comma-separated executables whose syscalls are not audited");
+
+FLAG(string,
+     audit_exclude_paths,
+     "",
+     "Comma-separated directories, syscalls on paths within them are not "
+     "audited");
+
+FLAG(bool,
+     audit_exclude_unset_auid,
+     false,
+     "Do not audit the syscalls of processes without a login session");
+
 // External flags; they are used to determine which rules need to be installed
 DECLARE_bool(audit_allow_config);
 DECLARE_bool(audit_allow_fim_events);
@@ -174,8 +198,12 @@ std::vector<AuditEventRecord> AuditdNetlink::getEvents() noexcept {
   return record_list;
 }
 
+std::size_t AuditdNetlink::takeLostRecords() noexcept {
+  return auditd_context_->lost_records.exchange(0);
+}
+
 AuditdNetlinkReader::AuditdNetlinkReader(AuditdContextRef context)
-    : InternalRunnable("AuditdNetlinkReader"),
+    : InternalRunnable("AuditdNetlinkReader", ThreadClass::EventReader),
       auditd_context_(std::move(context)),
       read_buffer_(1024U) {}
 
@@ -278,7 +306,8 @@ bool AuditdNetlinkReader::acquireMessages() noexcept {
       break;
     }
 
-    audit_reply reply = {};
+    // Receive in place, the slot is only kept if the message is valid
+    auto& reply = read_buffer_[events_received];
     ssize_t len = recvfrom(audit_netlink_handle_,
                            &reply.msg,
                            sizeof(reply.msg),
@@ -315,7 +344,11 @@ bool AuditdNetlinkReader::acquireMessages() noexcept {
       break;
     }
 
-    read_buffer_[events_received] = reply;
+    // The slot is reused, terminate the message since records are also
+    // handled as C strings
+    if (static_cast<std::size_t>(len) < sizeof(reply.msg)) {
+      reinterpret_cast<char*>(&reply.msg)[len] = '\0';
+    }
   }
 
   if (events_received != 0) {
@@ -368,6 +401,83 @@ bool AuditdNetlinkReader::acquireMessages() noexcept {
   return true;
 } // namespace osquery
 
+namespace {
+/// The login uid of a process without a login session, (uid_t)-1.
+const std::string kUnsetAuid{"4294967295"};
+
+/// Build a rule for the syscalls, with an optional field.
+Status makeAuditRule(const std::set<int>& syscalls,
+                     int action,
+                     const std::string& field,
+                     std::vector<AuditRule>& rules) {
+  auto* rule = audit_rule_create_data();
+  if (rule == nullptr) {
+    return Status::failure("Cannot allocate an audit rule");
+  }
+
+  for (int syscall_number : syscalls) {
+    audit_rule_syscall_data(rule, syscall_number);
+  }
+
+  if (!field.empty()) {
+    // The field may grow the rule to hold its string.
+    auto error =
+        audit_rule_fieldpair_data(&rule, field.c_str(), AUDIT_FILTER_EXIT);
+    if (error < 0) {
+      audit_rule_free_data(rule);
+      return Status::failure("Invalid audit rule field " + field);
+    }
+  }
+
+  AuditRule compiled;
+  const auto* bytes = reinterpret_cast<const std::uint8_t*>(rule);
+  compiled.data.assign(bytes, bytes + sizeof(audit_rule_data) + rule->buflen);
+  compiled.action = action;
+  compiled.field = field;
+  audit_rule_free_data(rule);
+
+  rules.push_back(std::move(compiled));
+  return Status::success();
+}
+
+/// The exclusions set with the audit_exclude flags.
+AuditRuleExclusions getAuditRuleExclusions() {
+  AuditRuleExclusions exclusions;
+  exclusions.exes = split(FLAGS_audit_exclude_exes, ",");
+  exclusions.paths = split(FLAGS_audit_exclude_paths, ",");
+  exclusions.unset_auid = FLAGS_audit_exclude_unset_auid;
+  return exclusions;
+}
+} // namespace
+
+Status compileAuditRules(const std::set<int>& syscalls,
+                         const AuditRuleExclusions& exclusions,
+                         std::vector<AuditRule>& rules) {
+  rules.clear();
+  if (syscalls.empty()) {
+    return Status::success();
+  }
+
+  std::vector<std::string> fields;
+  for (const auto& exe : exclusions.exes) {
+    fields.push_back("exe=" + exe);
+  }
+  for (const auto& path : exclusions.paths) {
+    fields.push_back("dir=" + path);
+  }
+  if (exclusions.unset_auid) {
+    fields.push_back("auid=" + kUnsetAuid);
+  }
+
+  for (const auto& field : fields) {
+    auto status = makeAuditRule(syscalls, AUDIT_NEVER, field, rules);
+    if (!status.ok()) {
+      LOG(WARNING) << "Ignoring an audit exclusion: " << status.getMessage();
+    }
+  }
+  return makeAuditRule(syscalls, AUDIT_ALWAYS, "", rules);
+}
+
 bool AuditdNetlinkReader::configureAuditService() noexcept {
   VLOG(1) << "Attempting to configure the audit service";
 
@@ -431,41 +541,52 @@ bool AuditdNetlinkReader::configureAuditService() noexcept {
     }
   }
 
-  audit_rule_data rule = {};
-
-  // Attempt to add each one of the rules we collected
-  for (int syscall_number : monitored_syscall_list_) {
-    audit_rule_syscall_data(&rule, syscall_number);
-    if (FLAGS_audit_debug) {
+  if (FLAGS_audit_debug) {
+    for (int syscall_number : monitored_syscall_list_) {
       VLOG(1) << "Audit rule queued for syscall " << syscall_number;
     }
   }
 
-  // clang-format off
-  int rule_add_error = audit_add_rule_data(audit_netlink_handle_, &rule,
-    // We want to be notified when we exit from the syscall
-    AUDIT_FILTER_EXIT,
-
-    // Always audit this syscall event
-    AUDIT_ALWAYS
-  );
-  // clang-format on
-
-  if (rule_add_error < 0) {
-    const char* errno_message = audit_errno_to_name(-rule_add_error);
-    LOG(ERROR) << "Failed to install the audit rule due to one or more "
-               << "syscalls with error "
-               << (errno_message ? errno_message : "NULL")
+  // The syscalls share one rule, preceded by the exclusions.
+  std::vector<AuditRule> rules;
+  auto status = compileAuditRules(
+      monitored_syscall_list_, getAuditRuleExclusions(), rules);
+  if (!status.ok()) {
+    LOG(ERROR) << "Failed to compile the audit rules: " << status.getMessage()
                << ", Audit-based tables may not function as expected";
-
-  } else if (FLAGS_audit_debug) {
-    VLOG(1) << "Audit rule installed for all queued syscalls";
   }
 
-  if (FLAGS_audit_force_unconfigure || rule_add_error >= 0) {
-    // keep a track of the rule even if installing it failed when asked to
-    // forcefully unconfigure.
-    installed_rule_list_.push_back(rule);
+  for (auto& rule : rules) {
+    auto* data = reinterpret_cast<audit_rule_data*>(rule.data.data());
+
+    // We want to be notified when we exit from the syscall
+    int rule_add_error = audit_add_rule_data(
+        audit_netlink_handle_, data, AUDIT_FILTER_EXIT, rule.action);
+
+    if (rule_add_error < 0) {
+      const char* errno_message = audit_errno_to_name(-rule_add_error);
+      if (rule.action == AUDIT_NEVER) {
+        LOG(WARNING) << "Failed to install the audit exclusion " << rule.field
+                     << " with error "
+                     << (errno_message ? errno_message : "NULL");
+      } else {
+        LOG(ERROR) << "Failed to install the audit rule due to one or more "
+                   << "syscalls with error "
+                   << (errno_message ? errno_message : "NULL")
+                   << ", Audit-based tables may not function as expected";
+      }
+
+    } else if (FLAGS_audit_debug) {
+      VLOG(1) << "Audit rule installed for all queued syscalls"
+              << (rule.field.empty() ? "" : ", never audited with ")
+              << rule.field;
+    }
+
+    if (FLAGS_audit_force_unconfigure || rule_add_error >= 0) {
+      // keep a track of the rule even if installing it failed when asked to
+      // forcefully unconfigure.
+      installed_rule_list_.push_back(std::move(rule));
+    }
   }
 
   return true;
@@ -621,8 +742,9 @@ void AuditdNetlinkReader::restoreAuditServiceConfiguration() noexcept {
   VLOG(1) << "Uninstalling the audit rules we have installed";
 
   for (auto& rule : installed_rule_list_) {
+    auto* data = reinterpret_cast<audit_rule_data*>(rule.data.data());
     int rule_delete_error = audit_delete_rule_data(
-        audit_netlink_handle_, &rule, AUDIT_FILTER_EXIT, AUDIT_ALWAYS);
+        audit_netlink_handle_, data, AUDIT_FILTER_EXIT, rule.action);
     if (FLAGS_audit_debug && rule_delete_error < 0) {
       const char* errno_message = audit_errno_to_name(-rule_delete_error);
       VLOG(1) << "Error code returned by delete rule "
@@ -723,13 +845,24 @@ NetlinkStatus AuditdNetlinkReader::acquireHandle() noexcept {
 }
 
 AuditdNetlinkParser::AuditdNetlinkParser(AuditdContextRef context)
-    : InternalRunnable("AuditdNetlinkParser"),
+    : InternalRunnable("AuditdNetlinkParser", ThreadClass::EventReader),
       auditd_context_(std::move(context)) {}
 
 void AuditdNetlinkParser::start() {
-  while (!interrupted()) {
-    std::vector<audit_reply> queue;
+  // The processed buffer is handed back to the reader, so both threads keep
+  // reusing the same two allocations
+  std::vector<audit_reply> queue;
+  std::vector<AuditEventRecord> audit_event_record_queue;
+
+  AuditCaptureWriter capture;
+  if (!FLAGS_audit_capture_path.empty()) {
+    auto status = capture.open(FLAGS_audit_capture_path);
+    if (!status.ok()) {
+      LOG(WARNING) << status.getMessage();
+    }
+  }
 
+  while (!interrupted()) {
     {
       std::unique_lock<std::mutex> lock(
           auditd_context_->unprocessed_records_mutex);
@@ -743,11 +876,10 @@ void AuditdNetlinkParser::start() {
             lock, std::chrono::seconds(1));
       }
 
-      queue = std::move(auditd_context_->unprocessed_records);
-      auditd_context_->unprocessed_records.clear();
+      queue.clear();
+      std::swap(queue, auditd_context_->unprocessed_records);
     }
 
-    std::vector<AuditEventRecord> audit_event_record_queue;
     audit_event_record_queue.reserve(queue.size());
 
     for (auto& reply : queue) {
@@ -764,6 +896,17 @@ void AuditdNetlinkParser::start() {
         reply.status = static_cast<struct audit_status*>(NLMSG_DATA(reply.nlh));
         auto new_pid = static_cast<pid_t>(reply.status->pid);
 
+        // The kernel counts the records it could not queue (backlog limit,
+        // rate limit or allocation failures) since the audit service started
+        auto lost = reply.status->lost;
+        if (auditd_context_->has_status_lost &&
+            lost >= auditd_context_->last_status_lost) {
+          auditd_context_->lost_records +=
+              lost - auditd_context_->last_status_lost;
+        }
+        auditd_context_->last_status_lost = lost;
+        auditd_context_->has_status_lost = true;
+
         if (new_pid != getpid()) {
           VLOG(1) << "Audit control lost to pid: " << new_pid;
 
@@ -782,13 +925,17 @@ void AuditdNetlinkParser::start() {
         continue;
       }
 
+      if (capture.isOpen()) {
+        capture.write(reply);
+      }
+
       AuditEventRecord audit_event_record = {};
       if (!ParseAuditReply(reply, audit_event_record)) {
         VLOG(1) << "Malformed audit record received";
         continue;
       }
 
-      audit_event_record_queue.push_back(audit_event_record);
+      audit_event_record_queue.push_back(std::move(audit_event_record));
     }
 
     // Save the new records and notify the reader
@@ -802,8 +949,8 @@ void AuditdNetlinkParser::start() {
 
       auditd_context_->processed_events.insert(
           auditd_context_->processed_events.end(),
-          audit_event_record_queue.begin(),
-          audit_event_record_queue.end());
+          std::make_move_iterator(audit_event_record_queue.begin()),
+          std::make_move_iterator(audit_event_record_queue.end()));
 
       auditd_context_->processed_records_backlog =
           auditd_context_->processed_events.size();
@@ -812,7 +959,6 @@ void AuditdNetlinkParser::start() {
     }
 
     auditd_context_->unprocessed_records_amount -= queue.size();
-    queue.clear();
     audit_event_record_queue.clear();
 
     /* Throttling the record processing if the consumer (the publisher)
@@ -865,8 +1011,10 @@ bool AuditdNetlinkParser::ParseAuditReply(
     return false;
   }
 
+  auto time_view = message_view.substr(6, 10);
   event_record.time =
-      tryTo<unsigned long int>(message_view.substr(6, 10).to_string(), 10)
+      tryTo<unsigned long int>(
+          std::string_view(time_view.data(), time_view.size()), 10)
           .takeOr(event_record.time);
   event_record.audit_id = message_view.substr(6, preamble_end - 6).to_string();
 
@@ -884,62 +1032,59 @@ bool AuditdNetlinkParser::ParseAuditReply(
   // Tokenize the message
   boost::string_ref field_view(message_view.substr(preamble_end + 3));
 
-  // The linear search will construct series of key value pairs.
-  std::string key, value;
-  key.reserve(20);
-  value.reserve(256);
+  // The linear search will construct series of key value pairs. Keys and
+  // values are contiguous in the message, only their bounds are tracked and
+  // each string is created once.
+  std::size_t key_begin{0U};
+  auto value_begin = boost::string_ref::npos;
+
+  auto L_addField = [&](std::size_t end) {
+    auto key_end = value_begin == boost::string_ref::npos ? end
+                                                          : value_begin - 1U;
+    if (key_end <= key_begin) {
+      return;
+    }
+
+    std::string value;
+    if (value_begin != boost::string_ref::npos) {
+      value = field_view.substr(value_begin, end - value_begin).to_string();
+    }
+
+    event_record.fields.emplace(
+        field_view.substr(key_begin, key_end - key_begin).to_string(),
+        std::move(value));
+  };
 
   // There are several ways of representing value data (enclosed strings,
   // etc).
-  bool found_assignment{false};
   bool found_enclose{false};
 
-  for (const auto& c : field_view) {
+  for (std::size_t i = 0U; i < field_view.size(); ++i) {
     // Iterate over each character in the audit message.
+    auto c = field_view[i];
     if ((found_enclose && c == '"') || (!found_enclose && c == ' ')) {
-      if (c == '"') {
-        value += c;
-      }
-
       // This is a terminating sequence, the end of an enclosure or space
-      // tok.
-      if (!key.empty()) {
-        // Multiple space tokens are supported.
-        event_record.fields.emplace(
-            std::make_pair(std::move(key), std::move(value)));
-      }
+      // tok. The closing quote is part of the value. Multiple space tokens
+      // are supported.
+      L_addField(c == '"' ? i + 1U : i);
 
       found_enclose = false;
-      found_assignment = false;
+      key_begin = i + 1U;
+      value_begin = boost::string_ref::npos;
 
-      key.clear();
-      value.clear();
-
-    } else if (!found_assignment && c == ' ') {
-      // A field tokenizer.
-
-    } else if (found_assignment) {
+    } else if (value_begin != boost::string_ref::npos) {
       // Enclosure sequences appear immediately following assignment.
       if (c == '"') {
         found_enclose = true;
       }
 
-      value += c;
-
     } else if (c == '=') {
-      found_assignment = true;
-
-    } else {
-      key += c;
+      value_begin = i + 1U;
     }
   }
 
   // Last step, if there was no trailing tokenizer.
-  if (!key.empty()) {
-    event_record.fields.emplace(
-        std::make_pair(std::move(key), std::move(value)));
-  }
-
+  L_addField(field_view.size());
   return true;
 }
 
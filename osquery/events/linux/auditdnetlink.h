@@ -17,12 +17,14 @@
 #include <map>
 #include <memory>
 #include <set>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
 #include <boost/algorithm/hex.hpp>
 
 #include <osquery/dispatcher/dispatcher.h>
+#include <osquery/utils/status/status.h>
 
 namespace osquery {
 
@@ -32,6 +34,42 @@ enum class NetlinkStatus { ActiveMutable, ActiveImmutable, Disabled, Error };
 /// Contains an audit_rule_data structure
 using AuditRuleDataObject = std::vector<std::uint8_t>;
 
+/// An audit rule of the syscall exit filter, and its action.
+struct AuditRule final {
+  /// The audit_rule_data, followed by the strings of its fields.
+  AuditRuleDataObject data;
+
+  /// AUDIT_ALWAYS, or AUDIT_NEVER for an exclusion.
+  int action{AUDIT_ALWAYS};
+
+  /// The field of the rule, such as exe=/usr/bin/foo, empty if none.
+  std::string field;
+};
+
+/// The syscalls excluded from the audit rules, see the audit_exclude flags.
+struct AuditRuleExclusions final {
+  /// Executables whose syscalls are not audited.
+  std::vector<std::string> exes;
+
+  /// Directories, syscalls on the paths within them are not audited.
+  std::vector<std::string> paths;
+
+  /// Do not audit the syscalls of processes without a login session.
+  bool unset_auid{false};
+};
+
+/**
+ * @brief Compile the monitored syscalls and exclusions into audit rules.
+ *
+ * The syscalls share one rule. Each exclusion is a rule with the "never"
+ * action for the same syscalls, the kernel applies the first matching rule
+ * so exclusions come first. An exclusion the kernel rules cannot express is
+ * logged and skipped.
+ */
+Status compileAuditRules(const std::set<int>& syscalls,
+                         const AuditRuleExclusions& exclusions,
+                         std::vector<AuditRule>& rules);
+
 /// A single, prepared audit event record.
 struct AuditEventRecord final {
   /// Record type (i.e.: AUDIT_SYSCALL, AUDIT_PATH, ...)
@@ -91,6 +129,15 @@ struct AuditdContext final {
   /// publisher cannot empty the backlog fast enough
   std::atomic<std::size_t> processed_records_backlog{};
 
+  /// Records the kernel reported as lost since the publisher last asked
+  std::atomic<std::size_t> lost_records{};
+
+  /// The kernel's lost counter at the last status reply, used as the baseline
+  std::uint32_t last_status_lost{};
+
+  /// Set once the first status reply has provided a baseline
+  bool has_status_lost{false};
+
   /// Timestamp of the last Netlink records reading throttling message
   std::uint64_t last_netlink_throttling_message_time{};
 
@@ -142,7 +189,7 @@ class AuditdNetlinkReader final : public InternalRunnable {
   std::vector<audit_reply> read_buffer_;
 
   /// The set of rules we applied (and that we'll uninstall when exiting)
-  std::vector<audit_rule_data> installed_rule_list_;
+  std::vector<AuditRule> installed_rule_list_;
 
   /// The syscalls we are listening for
   std::set<int> monitored_syscall_list_;
@@ -178,6 +225,9 @@ class AuditdNetlink final : private boost::noncopyable {
   /// Prepares the raw audit event records stored in the given context.
   std::vector<AuditEventRecord> getEvents() noexcept;
 
+  /// Returns and resets the count of records the kernel failed to deliver.
+  std::size_t takeLostRecords() noexcept;
+
  private:
   /// Shared data
   AuditdContextRef auditd_context_;
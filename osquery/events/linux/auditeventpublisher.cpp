@@ -7,7 +7,9 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
 #include <array>
+#include <string_view>
 
 #include <osquery/core/flags.h>
 #include <osquery/events/linux/apparmor_events.h>
@@ -15,6 +17,7 @@
 #include <osquery/events/linux/selinux_events.h>
 #include <osquery/events/linux/socket_events.h>
 #include <osquery/logger/logger.h>
+#include <osquery/numeric_monitoring/numeric_monitoring.h>
 #include <osquery/registry/registry_factory.h>
 #include <osquery/utils/conversions/tryto.h>
 
@@ -99,6 +102,7 @@ Status AuditEventPublisher::run() {
   }
 
   auto audit_event_record_queue = audit_netlink_->getEvents();
+  recordDroppedEvents(audit_netlink_->takeLostRecords());
 
   auto event_context = createEventContext();
 
@@ -115,6 +119,17 @@ Status AuditEventPublisher::run() {
     fire(event_context);
   }
 
+  auto expired_event_count = audit_trace_context_.expiredEventCount();
+  if (expired_event_count != expired_event_count_) {
+    auto count = expired_event_count - expired_event_count_;
+    expired_event_count_ = expired_event_count;
+
+    VLOG(1) << count << " incomplete audit events have expired";
+    monitoring::record("events.publisher." + type() + ".expired_partial",
+                       static_cast<monitoring::ValueType>(count),
+                       monitoring::PreAggregationType::Sum);
+  }
+
   return Status::success();
 }
 
@@ -128,7 +143,7 @@ void AuditEventPublisher::ProcessEvents(
   // Assemble each record into a AuditEvent object; multi-record events
   // are complete when we receive the terminator (AUDIT_EOE)
   for (const auto& audit_event_record : record_list) {
-    auto audit_event_it = trace_context.find(audit_event_record.audit_id);
+    AuditTraceContext::Key audit_event_key;
 
     // We have two entry points here; the first one is for user messages, while
     // the second one is for syscalls
@@ -208,10 +223,14 @@ void AuditEventPublisher::ProcessEvents(
       audit_event.record_list.push_back(audit_event_record);
       event_context->audit_events.push_back(audit_event);
 
+    } else if (!AuditTraceContext::parseKey(audit_event_key,
+                                            audit_event_record.audit_id)) {
+      VLOG(1) << "Malformed audit id received: " << audit_event_record.audit_id;
+
     } else if (audit_event_record.type == AUDIT_SYSCALL) {
-      if (audit_event_it != trace_context.end()) {
+      AuditEvent duplicated_event;
+      if (trace_context.take(audit_event_key, duplicated_event)) {
         VLOG(1) << "Received a duplicated event.";
-        trace_context.erase(audit_event_it);
       }
 
       AuditEvent audit_event;
@@ -362,60 +381,154 @@ void AuditEventPublisher::ProcessEvents(
       data.process_sgid = static_cast<gid_t>(process_sgid);
 
       audit_event.record_list.push_back(audit_event_record);
-      trace_context[audit_event_record.audit_id] = std::move(audit_event);
+      trace_context.insert(audit_event_key, std::move(audit_event));
 
       // This is the terminator for multi-record audit events
     } else if (audit_event_record.type == AUDIT_EOE) {
-      if (audit_event_it == trace_context.end()) {
+      AuditEvent completed_audit_event;
+      if (!trace_context.take(audit_event_key, completed_audit_event)) {
         continue;
       }
 
-      auto completed_audit_event = audit_event_it->second;
-      trace_context.erase(audit_event_it);
-
       event_context->audit_events.push_back(std::move(completed_audit_event));
 
     } else {
-      if (audit_event_it == trace_context.end()) {
+      auto audit_event = trace_context.find(audit_event_key);
+      if (audit_event == nullptr) {
         continue;
       }
 
-      audit_event_it->second.record_list.push_back(audit_event_record);
+      audit_event->record_list.push_back(audit_event_record);
     }
   }
 
   // Drop events that are older than 5 minutes; it means that we have failed to
   // receive the end of record and will never complete them correctly
+  trace_context.expire(std::time(nullptr));
+}
 
-  std::time_t current_time;
-  std::time(&current_time);
+const std::time_t AuditTraceContext::kExpirationTime{300};
 
-  std::unordered_map<std::string, std::time_t> timestamp_cache;
+namespace {
 
-  // The first part of the audit id is a timestamp: 1501323932.710:7670542
-  for (auto event_it = trace_context.begin();
-       event_it != trace_context.end();) {
-    const auto& audit_event_id = event_it->first;
-    std::time_t event_timestamp;
+/// One slot for each second an event may wait, plus the current one
+const std::size_t kTraceWheelSize{301U};
 
-    auto timestamp_it = timestamp_cache.find(audit_event_id);
-    if (timestamp_it == timestamp_cache.end()) {
-      std::string string_timestamp = audit_event_id.substr(0, 10);
+std::size_t getWheelSlot(std::time_t second) {
+  return static_cast<std::size_t>(second) % kTraceWheelSize;
+}
 
-      event_timestamp = tryTo<long long>(string_timestamp).takeOr(0ll);
+} // namespace
 
-      timestamp_cache[audit_event_id] = event_timestamp;
+bool AuditTraceContext::parseKey(Key& key,
+                                 const std::string& audit_id) noexcept {
+  // The audit id is made of a timestamp and a serial: 1501323932.710:7670542
+  auto dot = audit_id.find('.');
+  auto colon = audit_id.find(':', dot == std::string::npos ? 0 : dot);
+  if (dot == std::string::npos || colon == std::string::npos) {
+    return false;
+  }
 
-    } else {
-      event_timestamp = timestamp_it->second;
+  auto view = std::string_view(audit_id);
+  auto seconds = tryTo<std::uint64_t>(view.substr(0, dot));
+  auto millis = tryTo<std::uint64_t>(view.substr(dot + 1, colon - dot - 1));
+  auto serial = tryTo<std::uint64_t>(view.substr(colon + 1));
+  if (seconds.isError() || millis.isError() || serial.isError()) {
+    return false;
+  }
+
+  key.timestamp_ms = seconds.get() * 1000U + millis.get();
+  key.serial = serial.get();
+  return true;
+}
+
+AuditTraceContext::AuditTraceContext() : wheel_(kTraceWheelSize) {}
+
+AuditEvent* AuditTraceContext::find(const Key& key) {
+  auto it = events_.find(key);
+  return it != events_.end() ? &it->second.event : nullptr;
+}
+
+void AuditTraceContext::insert(const Key& key, AuditEvent event) {
+  // An event already past the expiration time goes in the next slot to
+  // expire, the slots behind expired_until_ are not visited again
+  auto wheel_second = static_cast<std::time_t>(key.timestamp_ms / 1000U);
+  if (expired_until_ != 0 && wheel_second <= expired_until_) {
+    wheel_second = expired_until_ + 1;
+  }
+
+  auto& entry = events_[key];
+  entry.event = std::move(event);
+  entry.wheel_second = wheel_second;
+
+  wheel_[getWheelSlot(wheel_second)].push_back(key);
+}
+
+bool AuditTraceContext::take(const Key& key, AuditEvent& event) {
+  auto it = events_.find(key);
+  if (it == events_.end()) {
+    return false;
+  }
+
+  event = std::move(it->second.event);
+  events_.erase(it);
+  return true;
+}
+
+std::size_t AuditTraceContext::expire(std::time_t current_time) {
+  auto expire_until = current_time - kExpirationTime;
+  if (expired_until_ == 0) {
+    expired_until_ = expire_until - static_cast<std::time_t>(kTraceWheelSize);
+  }
+
+  if (expire_until <= expired_until_) {
+    return 0U;
+  }
+
+  // Each slot is visited once per lap of the wheel
+  auto first_second = std::max(
+      expired_until_ + 1,
+      expire_until - static_cast<std::time_t>(kTraceWheelSize) + 1);
+
+  std::size_t expired_count = 0U;
+  for (auto second = first_second; second <= expire_until; ++second) {
+    auto& slot = wheel_[getWheelSlot(second)];
+
+    auto kept_it = slot.begin();
+    for (const auto& key : slot) {
+      auto event_it = events_.find(key);
+      if (event_it == events_.end()) {
+        // Completed, or replaced and placed in another slot
+        continue;
+      }
+
+      if (event_it->second.wheel_second > expire_until) {
+        *kept_it++ = key;
+
+      } else if (getWheelSlot(event_it->second.wheel_second) ==
+                 getWheelSlot(second)) {
+        events_.erase(event_it);
+        ++expired_count;
+      }
     }
 
-    if (current_time - event_timestamp >= 300) {
-      event_it = trace_context.erase(event_it);
-    } else {
-      event_it++;
+    slot.erase(kept_it, slot.end());
+    if (slot.empty()) {
+      std::vector<Key>().swap(slot);
     }
   }
+
+  expired_until_ = expire_until;
+  expired_event_count_ += expired_count;
+  return expired_count;
+}
+
+std::size_t AuditTraceContext::size() const {
+  return events_.size();
+}
+
+std::size_t AuditTraceContext::expiredEventCount() const {
+  return expired_event_count_;
 }
 
 const AuditEventRecord* GetEventRecord(const AuditEvent& event,
@@ -452,12 +565,12 @@ bool GetIntegerFieldFromMap(std::uint64_t& value,
                             const std::string& field_name,
                             std::size_t base,
                             std::uint64_t default_value) noexcept {
-  std::string string_value;
-  if (!GetStringFieldFromMap(string_value, field_map, field_name, "")) {
+  auto it = field_map.find(field_name);
+  if (it == field_map.end()) {
     value = default_value;
     return false;
   }
-  auto exp = tryTo<std::uint64_t>(string_value, base);
+  auto exp = tryTo<std::uint64_t>(it->second, static_cast<int>(base));
   value = exp.takeOr(std::move(default_value));
   return exp.isValue();
 }
@@ -10,13 +10,18 @@
 #pragma once
 
 #include <cstdint>
+#include <ctime>
+#include <functional>
 #include <limits>
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
 #include <boost/variant.hpp>
 
 #include <osquery/events/eventpublisher.h>
 #include <osquery/events/linux/auditdnetlink.h>
+#include <osquery/utils/string_pool.h>
 
 namespace osquery {
 
@@ -42,7 +47,7 @@ struct SyscallAuditEventData final {
   gid_t process_fsgid;
   gid_t process_sgid;
 
-  std::string executable_path;
+  InternedString executable_path;
 };
 
 struct AppArmorAuditEventData final {
@@ -130,8 +135,77 @@ struct AuditEventContext final : public EventContext {
 using AuditEventContextRef = std::shared_ptr<AuditEventContext>;
 using AuditSubscriptionContextRef = std::shared_ptr<AuditSubscriptionContext>;
 
-/// This type maps audit event id with the corresponding audit event object
-using AuditTraceContext = std::map<std::string, AuditEvent>;
+/**
+ * @brief The multi-record audit events still waiting for their AUDIT_EOE.
+ *
+ * Events are keyed by the numeric (timestamp, serial) pair of the audit id.
+ * Each one is also placed in the slot of a timing wheel for its timestamp
+ * second; expiring the events older than kExpirationTime only visits the
+ * slots that elapsed since the previous call.
+ */
+class AuditTraceContext final {
+ public:
+  /// The audit id 1501323932.710:7670542, as numbers
+  struct Key final {
+    std::uint64_t timestamp_ms{0U};
+    std::uint64_t serial{0U};
+
+    bool operator==(const Key& other) const {
+      return timestamp_ms == other.timestamp_ms && serial == other.serial;
+    }
+  };
+
+  /// Incomplete events are dropped after this many seconds
+  static const std::time_t kExpirationTime;
+
+  /// Parses the audit id of a record
+  static bool parseKey(Key& key, const std::string& audit_id) noexcept;
+
+  AuditTraceContext();
+
+  /// Returns the incomplete event with the given key, or nullptr
+  AuditEvent* find(const Key& key);
+
+  /// Starts a new event, replacing an incomplete one with the same key
+  void insert(const Key& key, AuditEvent event);
+
+  /// Removes and returns the event with the given key
+  bool take(const Key& key, AuditEvent& event);
+
+  /// Drops the incomplete events older than kExpirationTime
+  std::size_t expire(std::time_t current_time);
+
+  /// The number of incomplete events
+  std::size_t size() const;
+
+  /// The number of incomplete events dropped by expire()
+  std::size_t expiredEventCount() const;
+
+ private:
+  struct KeyHash final {
+    std::size_t operator()(const Key& key) const {
+      return std::hash<std::uint64_t>()(key.serial) ^
+             (std::hash<std::uint64_t>()(key.timestamp_ms) << 1U);
+    }
+  };
+
+  struct Entry final {
+    AuditEvent event;
+
+    /// The wheel second this event expires from
+    std::time_t wheel_second;
+  };
+
+  std::unordered_map<Key, Entry, KeyHash> events_;
+
+  /// The keys placed in each second of the wheel
+  std::vector<std::vector<Key>> wheel_;
+
+  /// The last wheel second visited by expire()
+  std::time_t expired_until_{0};
+
+  std::size_t expired_event_count_{0U};
+};
 
 class AuditEventPublisher final
     : public EventPublisher<AuditSubscriptionContext, AuditEventContext> {
@@ -166,6 +240,9 @@ class AuditEventPublisher final
 
   /// Syscalls allowed to fail (captured even if success=no)
   std::set<int> syscalls_allowed_to_fail_;
+
+  /// Incomplete events expired, as of the previous run
+  std::size_t expired_event_count_{0U};
 };
 
 /// Extracts the specified audit event record from the given audit event
@@ -9,6 +9,7 @@
 
 #include <osquery/events/linux/bpf/bpferrorstate.h>
 #include <osquery/logger/logger.h>
+#include <osquery/numeric_monitoring/numeric_monitoring.h>
 
 namespace osquery {
 
@@ -46,9 +47,16 @@ void reportAndClearBpfErrorState(BPFErrorState& bpf_error_state) {
             << bpf_error_state.perf_error_counters.invalid_event_data;
   }
 
+  // Lost events cannot be recovered, they are always reported.
   if (bpf_error_state.perf_error_counters.lost_events != 0U) {
-    VLOG(1) << "Lost BPF event count: "
-            << bpf_error_state.perf_error_counters.lost_events;
+    LOG(WARNING) << "Lost BPF event count: "
+                 << bpf_error_state.perf_error_counters.lost_events;
+
+    monitoring::record(
+        "events.bpf.lost_events",
+        static_cast<monitoring::ValueType>(
+            bpf_error_state.perf_error_counters.lost_events),
+        monitoring::PreAggregationType::Sum);
   }
 
   if (bpf_error_state.probe_error_counter != 0U) {
@@ -17,6 +17,9 @@
 #include <osquery/registry/registry_factory.h>
 #include <osquery/utils/system/time.h>
 
+#include <algorithm>
+#include <iterator>
+
 #include <fcntl.h>
 #include <sys/sysinfo.h>
 
@@ -25,7 +28,8 @@ namespace osquery {
 HIDDEN_FLAG(uint32,
             bpf_state_tracker_reset_time,
             10,
-            "Number of minutes between BPF system state tracker resets");
+            "Number of minutes over which the BPF system state tracker "
+            "refreshes every tracked process from procfs");
 
 namespace ebpfpub = tob::ebpfpub;
 namespace ebpf = tob::ebpf;
@@ -48,8 +52,13 @@ struct FunctionTracerAllocator final {
   EventHandler event_handler;
   std::uint8_t buffer_storage_pool{0U};
   bool kprobe{false};
+
+  /// Only the bpf_socket_events table uses these events.
+  bool socket_only{false};
 };
 
+const std::string kSocketEventsSubscriber{"bpf_socket_events"};
+
 std::unordered_set<std::string> kOptionalSyscallList{"openat2",
 
 #ifdef __aarch64__
@@ -81,11 +90,11 @@ const FunctionTracerAllocatorList kFunctionTracerAllocators = {
     {"openat2", &BPFEventPublisher::processOpenat2Event, 1U, false},
     {"socket", &BPFEventPublisher::processSocketEvent, 4U, false},
     {"fcntl", &BPFEventPublisher::processFcntlEvent, 4U, false},
-    {"connect", &BPFEventPublisher::processConnectEvent, 4U, false},
+    {"connect", &BPFEventPublisher::processConnectEvent, 4U, false, true},
     {"accept", &BPFEventPublisher::processAcceptEvent, 4U, false},
     {"accept4", &BPFEventPublisher::processAccept4Event, 4U, false},
-    {"bind", &BPFEventPublisher::processBindEvent, 4U, false},
-    {"listen", &BPFEventPublisher::processListenEvent, 4U, false},
+    {"bind", &BPFEventPublisher::processBindEvent, 4U, false, true},
+    {"listen", &BPFEventPublisher::processListenEvent, 4U, false, true},
     {"chdir", &BPFEventPublisher::processChdirEvent, 5U, false},
     {"fchdir", &BPFEventPublisher::processFchdirEvent, 5U, false},
     {"name_to_handle_at",
@@ -125,7 +134,10 @@ struct BPFEventPublisher::PrivateData final {
   BufferStorageMap buffer_storage_map;
   EventHandlerMap event_handler_map;
 
-  std::map<std::uint64_t, ebpfpub::IFunctionTracer::Event> event_queue;
+  /// Identifiers of the events only used by the bpf_socket_events table.
+  std::unordered_set<std::uint64_t> socket_only_event_id_set;
+
+  BPFEventPublisher::EventQueue event_queue;
   ISystemStateTracker::Ref system_state_tracker;
 };
 
@@ -268,6 +280,10 @@ Status BPFEventPublisher::setUp() {
             << tracer_allocator.syscall_name << " (" << event_id << ")";
 
     d->event_handler_map[event_id] = tracer_allocator.event_handler;
+    if (tracer_allocator.socket_only) {
+      d->socket_only_event_id_set.insert(event_id);
+    }
+
     d->perf_event_reader->insert(std::move(function_tracer));
   }
 
@@ -297,6 +313,7 @@ void BPFEventPublisher::tearDown() {
 
   d->buffer_storage_map.clear();
   d->event_handler_map.clear();
+  d->socket_only_event_id_set.clear();
   d->event_queue.clear();
 
   d->initialized = false;
@@ -315,25 +332,29 @@ Status BPFEventPublisher::run() {
   BPFErrorState bpf_error_state;
 
   auto last_error_report = getUnixTime();
-  auto last_tracker_restart = getUnixTime();
+  auto last_tracker_reconcile = getUnixTime();
 
   while (!isEnding()) {
+    // A slice of the tracked processes is refreshed each second, instead of
+    // scanning the whole procfs folder at once
     auto current_time = getUnixTime();
-    if (last_tracker_restart + (FLAGS_bpf_state_tracker_reset_time * 60) <
-        current_time) {
-      auto status = d->system_state_tracker->restart();
+    if (last_tracker_reconcile != current_time) {
+      auto step_count = std::max<std::uint64_t>(
+          FLAGS_bpf_state_tracker_reset_time * 60ULL, 1ULL);
+
+      auto status = d->system_state_tracker->reconcile(step_count);
       if (!status.ok()) {
-        LOG(ERROR) << "The BPF system state tracker could not be successfully "
-                      "restarted: "
+        LOG(ERROR) << "The BPF system state tracker could not be reconciled: "
                    << status.getMessage();
-      } else {
-        VLOG(1)
-            << "The BPF system state tracker has been successfully restarted";
       }
 
-      last_tracker_restart = current_time;
+      last_tracker_reconcile = current_time;
     }
 
+    // Socket events nobody subscribed to are dropped before processing.
+    auto socket_events = hasSocketEventsSubscriber();
+
+    std::vector<ebpfpub::IFunctionTracer::Event> received_event_list;
     d->perf_event_reader->exec(
         std::chrono::seconds(1U),
 
@@ -341,17 +362,24 @@ Status BPFEventPublisher::run() {
             const ebpfpub::IPerfEventReader::ErrorCounters&
                 perf_error_counters) {
           updateBpfErrorState(bpf_error_state, perf_error_counters);
+          recordDroppedEvents(perf_error_counters.lost_events);
 
           for (auto& event : event_list) {
             if (event.header.probe_error) {
               ++bpf_error_state.probe_error_counter;
             }
 
-            auto rel_timestamp = event.header.timestamp;
-            d->event_queue.insert({rel_timestamp, std::move(event)});
+            if (!socket_events &&
+                d->socket_only_event_id_set.count(event.identifier) != 0) {
+              continue;
+            }
+
+            received_event_list.push_back(event);
           }
         });
 
+    enqueueEvents(d->event_queue, std::move(received_event_list));
+
     current_time = getUnixTime();
     if (last_error_report + 5U < current_time) {
       reportAndClearBpfErrorState(bpf_error_state);
@@ -363,16 +391,16 @@ Status BPFEventPublisher::run() {
     struct sysinfo system_info {};
     sysinfo(&system_info);
 
-    for (auto event_it = d->event_queue.begin();
-         event_it != d->event_queue.end();) {
-      const auto& rel_timestamp = event_it->first / 1000000000ULL;
+    // The queue is ordered, the events after a recent one are recent too.
+    while (!d->event_queue.empty()) {
+      const auto& rel_timestamp =
+          d->event_queue.front().header.timestamp / 1000000000ULL;
       if (system_info.uptime - rel_timestamp < 5ULL) {
-        ++event_it;
-        continue;
+        break;
       }
 
-      auto event = std::move(event_it->second);
-      event_it = d->event_queue.erase(event_it);
+      auto event = std::move(d->event_queue.front());
+      d->event_queue.pop_front();
 
       auto event_handler_it = d->event_handler_map.find(event.identifier);
       if (event_handler_it == d->event_handler_map.end()) {
@@ -401,6 +429,49 @@ Status BPFEventPublisher::run() {
 
 BPFEventPublisher::BPFEventPublisher() : d(new PrivateData) {}
 
+bool BPFEventPublisher::hasSocketEventsSubscriber() const {
+  ReadLock lock(subscription_lock_);
+  return std::any_of(subscriptions_.begin(),
+                     subscriptions_.end(),
+                     [](const SubscriptionRef& subscription) {
+                       return subscription->subscriber_name ==
+                              kSocketEventsSubscriber;
+                     });
+}
+
+void BPFEventPublisher::enqueueEvents(
+    EventQueue& queue,
+    std::vector<ebpfpub::IFunctionTracer::Event> event_list) {
+  if (event_list.empty()) {
+    return;
+  }
+
+  auto L_byTimestamp = [](const ebpfpub::IFunctionTracer::Event& lhs,
+                          const ebpfpub::IFunctionTracer::Event& rhs) -> bool {
+    return lhs.header.timestamp < rhs.header.timestamp;
+  };
+
+  std::stable_sort(event_list.begin(), event_list.end(), L_byTimestamp);
+
+  // Events are usually newer than every queued one.
+  if (queue.empty() || !L_byTimestamp(event_list.front(), queue.back())) {
+    queue.insert(queue.end(),
+                 std::make_move_iterator(event_list.begin()),
+                 std::make_move_iterator(event_list.end()));
+    return;
+  }
+
+  EventQueue merged_queue;
+  std::merge(std::make_move_iterator(queue.begin()),
+             std::make_move_iterator(queue.end()),
+             std::make_move_iterator(event_list.begin()),
+             std::make_move_iterator(event_list.end()),
+             std::back_inserter(merged_queue),
+             L_byTimestamp);
+
+  queue = std::move(merged_queue);
+}
+
 BPFEventPublisher::~BPFEventPublisher() {
   tearDown();
 }
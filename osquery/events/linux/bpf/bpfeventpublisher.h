@@ -15,6 +15,7 @@
 #include <ebpfpub/ifunctiontracer.h>
 #include <ebpfpub/iperfeventreader.h>
 
+#include <deque>
 #include <vector>
 
 namespace osquery {
@@ -41,10 +42,27 @@ class BPFEventPublisher final : public EventPublisher<BPFEventSC, BPFEventEC> {
  private:
   DECLARE_PUBLISHER("BPFEventPublisher");
 
+  /// Check if the bpf_socket_events table is subscribed to this publisher.
+  bool hasSocketEventsSubscriber() const;
+
   struct PrivateData;
   std::unique_ptr<PrivateData> d;
 
  public:
+  /// Received events waiting to be processed, in timestamp order.
+  using EventQueue = std::deque<tob::ebpfpub::IFunctionTracer::Event>;
+
+  /**
+   * @brief Add received events to the queue, keeping timestamp order.
+   *
+   * The events are sorted first, events with equal timestamps keep the order
+   * they were received in. Events newer than the queue are appended, others
+   * are merged into it.
+   */
+  static void enqueueEvents(
+      EventQueue& queue,
+      std::vector<tob::ebpfpub::IFunctionTracer::Event> event_list);
+
   template <typename T>
   static bool getEventMapValue(
       T& value,
@@ -9,6 +9,7 @@
 
 #pragma once
 
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -58,7 +59,99 @@ struct ProcessContext final {
     bool close_on_exec{false};
   };
 
-  using FileDescriptorMap = std::unordered_map<int, FileDescriptor>;
+  /// \brief A file descriptor table, shared by forked processes
+  /// The table is shared until one of the processes changes it, forking
+  /// does not copy the file descriptors. Only the const methods read a
+  /// shared table without copying it
+  class FileDescriptorMap final {
+   public:
+    using Map = std::unordered_map<int, FileDescriptor>;
+    using value_type = Map::value_type;
+    using iterator = Map::iterator;
+    using const_iterator = Map::const_iterator;
+
+    const_iterator find(int fd) const {
+      return map().find(fd);
+    }
+
+    const_iterator begin() const {
+      return map().begin();
+    }
+
+    const_iterator end() const {
+      return map().end();
+    }
+
+    const FileDescriptor& at(int fd) const {
+      return map().at(fd);
+    }
+
+    std::size_t count(int fd) const {
+      return map().count(fd);
+    }
+
+    std::size_t size() const {
+      return map().size();
+    }
+
+    bool empty() const {
+      return map().empty();
+    }
+
+    /// True if the table is shared with another process
+    bool shared() const {
+      return table_ != nullptr && table_.use_count() > 1;
+    }
+
+    iterator find(int fd) {
+      return mutableMap().find(fd);
+    }
+
+    iterator begin() {
+      return mutableMap().begin();
+    }
+
+    iterator end() {
+      return mutableMap().end();
+    }
+
+    FileDescriptor& at(int fd) {
+      return mutableMap().at(fd);
+    }
+
+    std::pair<iterator, bool> insert(value_type value) {
+      return mutableMap().insert(std::move(value));
+    }
+
+    std::size_t erase(int fd) {
+      return mutableMap().erase(fd);
+    }
+
+    iterator erase(iterator it) {
+      return mutableMap().erase(it);
+    }
+
+    void clear() {
+      table_.reset();
+    }
+
+   private:
+    const Map& map() const {
+      static const Map kEmptyMap;
+      return table_ != nullptr ? *table_ : kEmptyMap;
+    }
+
+    Map& mutableMap() {
+      if (table_ == nullptr) {
+        table_ = std::make_shared<Map>();
+      } else if (table_.use_count() > 1) {
+        table_ = std::make_shared<Map>(*table_);
+      }
+      return *table_;
+    }
+
+    std::shared_ptr<Map> table_;
+  };
 
   /// Parent process id
   pid_t parent_process_id{};
@@ -12,6 +12,8 @@
 #include <ebpfpub/ifunctiontracer.h>
 #include <ebpfpub/iperfeventreader.h>
 
+#include <osquery/utils/string_pool.h>
+
 #include <cstdint>
 #include <string>
 #include <variant>
@@ -74,11 +76,11 @@ class ISystemStateTracker {
     /// Parent process id
     pid_t parent_process_id{-1};
 
-    /// Binary path
-    std::string binary_path;
+    /// Binary path, interned since forked processes repeat it
+    InternedString binary_path;
 
-    /// Current working directory
-    std::string cwd;
+    /// Current working directory, interned as well
+    InternedString cwd;
 
     /// The BPF event header, as received from ebpfpub
     BPFHeader bpf_header;
@@ -98,6 +100,11 @@ class ISystemStateTracker {
   /// \brief Resets the internal state, taking a new /proc snapshot
   virtual Status restart() = 0;
 
+  /// \brief Refreshes a slice of the tracked processes from /proc
+  /// Each round snapshots the tracked process ids and refreshes them over
+  /// step_count calls, replacing the periodic full restart()
+  virtual Status reconcile(std::size_t step_count) = 0;
+
   /// \brief Creates a new process, in response to an fork, vfork or clone
   /// syscall Once the method has updated the internal state, it will also emit
   /// a new event
@@ -7,9 +7,11 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
+#include <utility>
 
 #include <osquery/events/linux/bpf/systemstatetracker.h>
 #include <osquery/logger/logger.h>
@@ -36,6 +38,12 @@ struct SystemStateTracker::PrivateData final {
   IProcessContextFactory::Ref process_context_factory;
   std::uint64_t last_expiration{};
   std::size_t event_count_since_expiration{};
+
+  /// Process ids left in the current reconciliation round
+  std::vector<pid_t> pending_reconciliation;
+
+  /// Process ids refreshed by each reconcile() call of the round
+  std::size_t reconciliation_batch_size{};
 };
 
 SystemStateTracker::Ref SystemStateTracker::create() {
@@ -74,6 +82,43 @@ Status SystemStateTracker::restart() {
   return Status::success();
 }
 
+Status SystemStateTracker::reconcile(std::size_t step_count) {
+  auto& pending = d->pending_reconciliation;
+  if (pending.empty()) {
+    pending.reserve(d->context.process_map.size());
+    for (const auto& process_entry : d->context.process_map) {
+      pending.push_back(process_entry.first);
+    }
+
+    step_count = std::max<std::size_t>(step_count, 1U);
+    d->reconciliation_batch_size =
+        (pending.size() + step_count - 1U) / step_count;
+  }
+
+  for (std::size_t i = 0U;
+       i < d->reconciliation_batch_size && !pending.empty();
+       ++i) {
+    auto process_id = pending.back();
+    pending.pop_back();
+
+    // Processes that have been expired in the meantime are not captured again
+    auto process_it = d->context.process_map.find(process_id);
+    if (process_it == d->context.process_map.end()) {
+      continue;
+    }
+
+    ProcessContext process_context;
+    if (d->process_context_factory->captureSingleProcess(process_context,
+                                                         process_id)) {
+      process_it->second = std::move(process_context);
+    } else {
+      d->context.process_map.erase(process_it);
+    }
+  }
+
+  return Status::success();
+}
+
 bool SystemStateTracker::createProcess(
     const tob::ebpfpub::IFunctionTracer::Event::Header& event_header,
     pid_t process_id,
@@ -389,8 +434,9 @@ bool SystemStateTracker::executeBinary(
   if (binary_path.empty()) {
     std::string root_path;
 
-    auto fd_info_it = process_context.fd_map.find(dirfd);
-    if (fd_info_it == process_context.fd_map.end()) {
+    const auto& fd_map = std::as_const(process_context.fd_map);
+    auto fd_info_it = fd_map.find(dirfd);
+    if (fd_info_it == fd_map.end()) {
       return false;
     }
 
@@ -414,8 +460,9 @@ bool SystemStateTracker::executeBinary(
   } else {
     std::string root_path;
 
-    auto fd_info_it = process_context.fd_map.find(dirfd);
-    if (fd_info_it == process_context.fd_map.end()) {
+    const auto& fd_map = std::as_const(process_context.fd_map);
+    auto fd_info_it = fd_map.find(dirfd);
+    if (fd_info_it == fd_map.end()) {
       return false;
     }
 
@@ -434,13 +481,23 @@ bool SystemStateTracker::executeBinary(
 
   process_context.argv = argv;
 
-  for (auto fd_it = process_context.fd_map.begin();
-       fd_it != process_context.fd_map.end();) {
-    const auto& fd_info = fd_it->second;
-    if (fd_info.close_on_exec) {
-      fd_it = process_context.fd_map.erase(fd_it);
-    } else {
-      ++fd_it;
+  // A table still shared with the parent is only copied when a descriptor
+  // is actually closed by the exec
+  const auto& fd_map = std::as_const(process_context.fd_map);
+  auto close_on_exec = std::any_of(
+      fd_map.begin(), fd_map.end(), [](const auto& fd_entry) {
+        return fd_entry.second.close_on_exec;
+      });
+
+  if (close_on_exec) {
+    for (auto fd_it = process_context.fd_map.begin();
+         fd_it != process_context.fd_map.end();) {
+      const auto& fd_info = fd_it->second;
+      if (fd_info.close_on_exec) {
+        fd_it = process_context.fd_map.erase(fd_it);
+      } else {
+        ++fd_it;
+      }
     }
   }
 
@@ -467,8 +524,9 @@ bool SystemStateTracker::setWorkingDirectory(
   auto& process_context =
       getProcessContext(context, process_context_factory, process_id);
 
-  auto fd_info_it = process_context.fd_map.find(dirfd);
-  if (fd_info_it == process_context.fd_map.end()) {
+  const auto& fd_map = std::as_const(process_context.fd_map);
+  auto fd_info_it = fd_map.find(dirfd);
+  if (fd_info_it == fd_map.end()) {
     return false;
   }
 
@@ -536,8 +594,9 @@ bool SystemStateTracker::openFile(
     absolute_path += path;
 
   } else {
-    auto fd_info_it = process_context.fd_map.find(dirfd);
-    if (fd_info_it == process_context.fd_map.end()) {
+    const auto& fd_map = std::as_const(process_context.fd_map);
+    auto fd_info_it = fd_map.find(dirfd);
+    if (fd_info_it == fd_map.end()) {
       return false;
     }
 
@@ -583,8 +642,9 @@ bool SystemStateTracker::duplicateHandle(Context& context,
   }
 
   auto& process_context = process_context_it->second;
-  auto fd_info_it = process_context.fd_map.find(oldfd);
-  if (fd_info_it == process_context.fd_map.end()) {
+  const auto& fd_map = std::as_const(process_context.fd_map);
+  auto fd_info_it = fd_map.find(oldfd);
+  if (fd_info_it == fd_map.end()) {
     return false;
   }
 
@@ -607,12 +667,11 @@ bool SystemStateTracker::closeHandle(
   auto& process_context =
       getProcessContext(context, process_context_factory, process_id);
 
-  auto fd_info_it = process_context.fd_map.find(fd);
-  if (fd_info_it == process_context.fd_map.end()) {
+  if (std::as_const(process_context.fd_map).count(fd) == 0U) {
     return false;
   }
 
-  process_context.fd_map.erase(fd_info_it);
+  process_context.fd_map.erase(fd);
   return true;
 }
 
@@ -733,13 +792,14 @@ bool SystemStateTracker::listen(
   auto& process_context =
       getProcessContext(context, process_context_factory, process_id);
 
-  auto fd_info_it = process_context.fd_map.find(fd);
-  if (fd_info_it != process_context.fd_map.end()) {
-    auto& fd_info = fd_info_it->second;
+  const auto& fd_map = std::as_const(process_context.fd_map);
+  auto fd_info_it = fd_map.find(fd);
+  if (fd_info_it != fd_map.end()) {
+    const auto& fd_info = fd_info_it->second;
 
     if (std::holds_alternative<ProcessContext::FileDescriptor::SocketData>(
             fd_info.data)) {
-      auto& socket_address =
+      const auto& socket_address =
           std::get<ProcessContext::FileDescriptor::SocketData>(fd_info.data);
 
       if (socket_address.opt_domain.has_value()) {
@@ -992,8 +1052,9 @@ bool SystemStateTracker::openByHandleAt(
         base_path = process_context.cwd;
 
       } else {
-        auto fd_info_it = process_context.fd_map.find(file_handle.dfd);
-        if (fd_info_it == process_context.fd_map.end()) {
+        const auto& fd_map = std::as_const(process_context.fd_map);
+        auto fd_info_it = fd_map.find(file_handle.dfd);
+        if (fd_info_it == fd_map.end()) {
           return false;
         }
 
@@ -1013,8 +1074,9 @@ bool SystemStateTracker::openByHandleAt(
     }
 
   } else if ((file_handle.flags & AT_EMPTY_PATH) != 0) {
-    auto fd_info_it = process_context.fd_map.find(file_handle.dfd);
-    if (fd_info_it == process_context.fd_map.end()) {
+    const auto& fd_map = std::as_const(process_context.fd_map);
+    auto fd_info_it = fd_map.find(file_handle.dfd);
+    if (fd_info_it == fd_map.end()) {
       return false;
     }
 
@@ -29,6 +29,8 @@ class SystemStateTracker final : public ISystemStateTracker {
 
   virtual Status restart() override;
 
+  virtual Status reconcile(std::size_t step_count) override;
+
   virtual bool createProcess(
       const tob::ebpfpub::IFunctionTracer::Event::Header& event_header,
       pid_t process_id,
@@ -0,0 +1,278 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <cstring>
+
+#include <fcntl.h>
+#include <linux/limits.h>
+#include <sys/fanotify.h>
+#include <sys/inotify.h>
+#include <sys/statfs.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <osquery/logger/logger.h>
+
+#include "osquery/events/linux/fanotify.h"
+
+// Older headers may miss the file identifier reporting interfaces.
+#ifndef FAN_REPORT_FID
+#define FAN_REPORT_FID 0x00000200
+#endif
+#ifndef FAN_REPORT_DIR_FID
+#define FAN_REPORT_DIR_FID 0x00000400
+#endif
+#ifndef FAN_REPORT_NAME
+#define FAN_REPORT_NAME 0x00000800
+#endif
+#ifndef FAN_MARK_FILESYSTEM
+#define FAN_MARK_FILESYSTEM 0x00000100
+#endif
+#ifndef FAN_ONDIR
+#define FAN_ONDIR 0x40000000
+#endif
+#ifndef FAN_NOFD
+#define FAN_NOFD -1
+#endif
+#ifndef O_PATH
+#define O_PATH 010000000
+#endif
+
+namespace osquery {
+
+namespace {
+
+const size_t kFanotifyBufferSize = 64 * 1024;
+
+/// The `fanotify` event bits, these equal the matching `inotify` bits.
+const uint32_t kFanotifyMasks = IN_ACCESS | IN_MODIFY | IN_ATTRIB |
+                                IN_CLOSE_WRITE | IN_OPEN | IN_MOVED_FROM |
+                                IN_MOVED_TO | IN_CREATE | IN_DELETE;
+
+/// Information record types following an event's metadata.
+const uint8_t kInfoTypeFid = 1;
+const uint8_t kInfoTypeDfidName = 2;
+const uint8_t kInfoTypeDfid = 3;
+
+/// Layout of a file identifier information record, the handle follows.
+struct FanotifyInfoFid {
+  uint8_t info_type;
+  uint8_t pad;
+  uint16_t len;
+  int32_t fsid[2];
+};
+
+/// Layout of the start of a file handle, the handle bytes follow.
+struct FanotifyFileHandle {
+  uint32_t handle_bytes;
+  int32_t handle_type;
+};
+
+uint64_t getFsid(const int32_t fsid[2]) {
+  return (static_cast<uint64_t>(static_cast<uint32_t>(fsid[0])) << 32) |
+         static_cast<uint32_t>(fsid[1]);
+}
+
+int fanotifyInit(unsigned int flags) {
+#ifdef __NR_fanotify_init
+  return static_cast<int>(syscall(__NR_fanotify_init, flags, O_RDONLY));
+#else
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+int fanotifyMark(int handle,
+                 unsigned int flags,
+                 uint64_t mask,
+                 const char* path) {
+#ifdef __NR_fanotify_mark
+  return static_cast<int>(
+      syscall(__NR_fanotify_mark, handle, flags, mask, AT_FDCWD, path));
+#else
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+} // namespace
+
+Status FanotifyWatch::open() {
+  if (isOpen()) {
+    return Status::success();
+  }
+
+  // Entry names need Linux 5.9, file identifiers alone need Linux 5.1.
+  handle_ = fanotifyInit(FAN_CLASS_NOTIF | FAN_CLOEXEC | FAN_NONBLOCK |
+                         FAN_REPORT_DIR_FID | FAN_REPORT_NAME);
+  if (handle_ < 0 && errno == EINVAL) {
+    VLOG(1) << "fanotify does not report entry names, events of directory "
+               "entries report the directory";
+    handle_ = fanotifyInit(FAN_CLASS_NOTIF | FAN_CLOEXEC | FAN_NONBLOCK |
+                           FAN_REPORT_FID);
+  }
+
+  if (handle_ < 0) {
+    return Status::failure("fanotify_init failed: " +
+                           std::string(strerror(errno)));
+  }
+  buffer_.resize(kFanotifyBufferSize);
+  return Status::success();
+}
+
+void FanotifyWatch::close() {
+  clearMarks();
+  if (handle_ >= 0) {
+    ::close(handle_);
+  }
+  handle_ = -1;
+  buffer_.clear();
+}
+
+Status FanotifyWatch::mark(const std::string& path, uint32_t mask) {
+  if (!isOpen()) {
+    return Status::failure("fanotify is not open");
+  }
+
+  struct statfs fs;
+  if (::statfs(path.c_str(), &fs) != 0) {
+    return Status::failure("Cannot stat filesystem of " + path);
+  }
+
+  auto fsid = getFsid(reinterpret_cast<const int32_t*>(&fs.f_fsid));
+  if (filesystems_.count(fsid) == 0) {
+    // Any descriptor on the filesystem can open its file handles.
+    int fd = ::open(path.c_str(), O_PATH | O_CLOEXEC);
+    if (fd < 0) {
+      return Status::failure("Cannot open " + path);
+    }
+    filesystems_[fsid] = fd;
+  }
+
+  // Directory entry events are reported for subdirectories too.
+  uint64_t events = (mask & kFanotifyMasks) | FAN_ONDIR;
+  if (fanotifyMark(handle_,
+                   FAN_MARK_ADD | FAN_MARK_FILESYSTEM,
+                   events,
+                   path.c_str()) != 0) {
+    return Status::failure("fanotify_mark failed: " +
+                           std::string(strerror(errno)));
+  }
+  return Status::success();
+}
+
+void FanotifyWatch::clearMarks() {
+  if (isOpen() && !filesystems_.empty()) {
+    fanotifyMark(handle_, FAN_MARK_FLUSH | FAN_MARK_FILESYSTEM, 0, nullptr);
+  }
+
+  for (const auto& filesystem : filesystems_) {
+    ::close(filesystem.second);
+  }
+  filesystems_.clear();
+}
+
+std::string FanotifyWatch::resolve(uint64_t fsid, const void* handle) const {
+#ifdef __NR_open_by_handle_at
+  auto filesystem = filesystems_.find(fsid);
+  if (filesystem == filesystems_.end()) {
+    return "";
+  }
+
+  // Deleted files may no longer be opened, their events carry no path.
+  int fd = static_cast<int>(syscall(__NR_open_by_handle_at,
+                                    filesystem->second,
+                                    handle,
+                                    O_PATH | O_CLOEXEC));
+  if (fd < 0) {
+    return "";
+  }
+
+  char path[PATH_MAX];
+  auto link = "/proc/self/fd/" + std::to_string(fd);
+  auto size = ::readlink(link.c_str(), path, sizeof(path) - 1);
+  ::close(fd);
+  if (size <= 0) {
+    return "";
+  }
+  return std::string(path, static_cast<size_t>(size));
+#else
+  return "";
+#endif
+}
+
+Status FanotifyWatch::read(const Callback& callback) {
+  if (!isOpen()) {
+    return Status::failure("fanotify is not open");
+  }
+
+  auto length = ::read(handle_, buffer_.data(), buffer_.size());
+  if (length < 0) {
+    if (errno == EAGAIN || errno == EINTR) {
+      return Status::success();
+    }
+    return Status::failure("fanotify read failed");
+  }
+
+  auto pid = ::getpid();
+  auto remaining = static_cast<size_t>(length);
+  const char* p = buffer_.data();
+  while (remaining >= sizeof(struct fanotify_event_metadata)) {
+    auto metadata = reinterpret_cast<const struct fanotify_event_metadata*>(p);
+    if (metadata->event_len < sizeof(struct fanotify_event_metadata) ||
+        metadata->event_len > remaining) {
+      break;
+    }
+
+    if (metadata->fd != FAN_NOFD) {
+      ::close(metadata->fd);
+    }
+
+    if (metadata->vers != FANOTIFY_METADATA_VERSION) {
+      return Status::failure("Unsupported fanotify metadata version");
+    }
+
+    if (metadata->mask & FAN_Q_OVERFLOW) {
+      VLOG(1) << "fanotify was overflown";
+    } else if (metadata->pid != pid) {
+      // File handles are reported by the first information record.
+      auto info = reinterpret_cast<const FanotifyInfoFid*>(
+          p + metadata->metadata_len);
+      auto end = p + metadata->event_len;
+      if (reinterpret_cast<const char*>(info) + sizeof(FanotifyInfoFid) <=
+          end) {
+        auto handle = reinterpret_cast<const char*>(info) + sizeof(*info);
+        auto path = resolve(getFsid(info->fsid), handle);
+        if (!path.empty() && info->info_type == kInfoTypeDfidName) {
+          auto file_handle =
+              reinterpret_cast<const FanotifyFileHandle*>(handle);
+          const char* name =
+              handle + sizeof(*file_handle) + file_handle->handle_bytes;
+          if (name < end && std::strcmp(name, ".") != 0) {
+            path += '/';
+            path += std::string(name, strnlen(name, end - name));
+          }
+        }
+
+        if (!path.empty() && (info->info_type == kInfoTypeFid ||
+                              info->info_type == kInfoTypeDfid ||
+                              info->info_type == kInfoTypeDfidName)) {
+          auto mask = static_cast<uint32_t>(metadata->mask) &
+                      (kFanotifyMasks | IN_ISDIR);
+          callback(path, mask);
+        }
+      }
+    }
+
+    remaining -= metadata->event_len;
+    p += metadata->event_len;
+  }
+  return Status::success();
+}
+} // namespace osquery
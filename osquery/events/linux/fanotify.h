@@ -0,0 +1,85 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/**
+ * @brief A Linux `fanotify` handle using one mark per filesystem.
+ *
+ * Filesystem marks (Linux 5.1 with file identifiers, 5.9 with entry names)
+ * report every change on a filesystem. Setting them up does not depend on the
+ * size of the monitored trees, and new subdirectories are covered as soon as
+ * they exist. Callers filter the reported paths, see PathMatcher.
+ *
+ * The event masks reported are the `inotify` masks of the same events.
+ */
+class FanotifyWatch : private boost::noncopyable {
+ public:
+  /// Receives the path and the `inotify` mask of each event.
+  using Callback = std::function<void(const std::string& path, uint32_t mask)>;
+
+  ~FanotifyWatch() {
+    close();
+  }
+
+  /// Create the `fanotify` handle, this requires CAP_SYS_ADMIN.
+  Status open();
+
+  /// Remove all marks and release the `fanotify` handle.
+  void close();
+
+  bool isOpen() const {
+    return handle_ >= 0;
+  }
+
+  int getHandle() const {
+    return handle_;
+  }
+
+  /**
+   * @brief Mark the filesystem containing a path.
+   *
+   * A filesystem is only opened once, marking it again adds the mask bits.
+   *
+   * @param path an existing path on the filesystem.
+   * @param mask the `inotify` mask of the events to report.
+   */
+  Status mark(const std::string& path, uint32_t mask);
+
+  /// Remove the marks of every filesystem.
+  void clearMarks();
+
+  /// Read the pending events, events of this process are skipped.
+  Status read(const Callback& callback);
+
+ private:
+  /// Resolve the path of a file handle reported by an event.
+  std::string resolve(uint64_t fsid, const void* handle) const;
+
+  /// The `fanotify` file descriptor handle.
+  int handle_{-1};
+
+  /// Descriptors of the marked filesystems, used to open file handles.
+  std::map<uint64_t, int> filesystems_;
+
+  /// Scratch space for reading events.
+  std::vector<char> buffer_;
+};
+} // namespace osquery
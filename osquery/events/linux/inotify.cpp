@@ -30,6 +30,11 @@ namespace osquery {
 
 DECLARE_bool(enable_file_events);
 
+FLAG(bool,
+     file_events_fanotify,
+     false,
+     "Use fanotify filesystem marks for file_events (Linux 5.1+)");
+
 static const size_t kINotifyMaxEvents = 512;
 static const size_t kINotifyEventSize =
     sizeof(struct inotify_event) + (NAME_MAX + 1);
@@ -66,6 +71,14 @@ Status INotifyEventPublisher::setUp() {
     return Status(1, "Could not start inotify: inotify_init failed");
   }
 
+  if (FLAGS_file_events_fanotify) {
+    auto status = fanotify_.open();
+    if (!status.ok()) {
+      LOG(WARNING) << "Cannot use fanotify, falling back to inotify: "
+                   << status.getMessage();
+    }
+  }
+
   WriteLock lock(scratch_mutex_);
   scratch_ = (char*)malloc(kINotifyBufferSize);
   if (scratch_ == nullptr) {
@@ -138,7 +151,8 @@ void INotifyEventPublisher::buildExcludePathsSet() {
   auto parser = Config::getParser("file_paths");
 
   WriteLock lock(subscription_lock_);
-  exclude_paths_.clear();
+  // This also drops the fanotify paths, a configure adds them again.
+  path_matcher_.clear();
 
   const auto& doc = parser->getData();
   if (!doc.doc().HasMember("exclude_paths")) {
@@ -151,7 +165,7 @@ void INotifyEventPublisher::buildExcludePathsSet() {
       if (pattern.empty()) {
         continue;
       }
-      exclude_paths_.insert(pattern);
+      path_matcher_.exclude(pattern);
     }
   }
 }
@@ -194,6 +208,17 @@ void INotifyEventPublisher::configure() {
 
   buildExcludePathsSet();
 
+  if (fanotify_.isOpen()) {
+    // Filesystem marks and paths are cheap to recreate from every
+    // subscription, this also drops those of removed subscriptions.
+    fanotify_.clearMarks();
+    WriteLock lock(path_mutex_);
+    path_descriptors_.clear();
+    for (auto& sub : subscriptions_) {
+      getSubscriptionContext(sub->context)->path_sc_time_.clear();
+    }
+  }
+
   for (auto& sub : subscriptions_) {
     // Anytime a configure is called, try to monitor all subscriptions.
     // Configure is called as a response to removing/adding subscriptions.
@@ -212,6 +237,7 @@ void INotifyEventPublisher::tearDown() {
     ::close(inotify_handle_);
   }
   inotify_handle_ = -1;
+  fanotify_.close();
 
   WriteLock lock(scratch_mutex_);
   if (scratch_ != nullptr) {
@@ -221,6 +247,9 @@ void INotifyEventPublisher::tearDown() {
 }
 
 void INotifyEventPublisher::handleOverflow() {
+  // The kernel does not report how many events were discarded.
+  recordDroppedEvents(1);
+
   if (inotify_events_ < kINotifyMaxEvents) {
     VLOG(1) << "inotify was overflown: increasing scratch buffer";
     // Exponential increment.
@@ -238,6 +267,10 @@ Status INotifyEventPublisher::run() {
     return Status(1, "Publisher disabled via configuration");
   }
 
+  if (fanotify_.isOpen()) {
+    return runFanotify();
+  }
+
   struct pollfd fds[1];
   fds[0].fd = getHandle();
   fds[0].events = POLLIN;
@@ -266,6 +299,8 @@ Status INotifyEventPublisher::run() {
     return Status(1, "INotify read failed");
   }
 
+  // The events of one read are fired together.
+  EventContextList event_list;
   for (char* p = scratch_; p < scratch_ + record_num;) {
     // Cast the inotify struct, make shared pointer, and append to contexts.
     auto event = reinterpret_cast<struct inotify_event*>(p);
@@ -284,16 +319,73 @@ Status INotifyEventPublisher::run() {
     } else {
       auto ec = createEventContextFrom(event);
       if (!ec->action.empty()) {
-        fire(ec);
+        event_list.push_back(std::move(ec));
       }
     }
     // Continue to iterate
     p += (sizeof(struct inotify_event)) + event->len;
   }
 
+  fireBatch(event_list);
   return Status::success();
 }
 
+Status INotifyEventPublisher::runFanotify() {
+  struct pollfd fds[1];
+  fds[0].fd = fanotify_.getHandle();
+  fds[0].events = POLLIN;
+  int selector = ::poll(fds, 1, 1000);
+  if (selector == -1) {
+    if (errno == EINTR) {
+      return Status::success();
+    }
+    LOG(WARNING) << "Could not read fanotify handle";
+    return Status(1, "fanotify poll failed");
+  }
+
+  if (selector == 0 || !(fds[0].revents & POLLIN)) {
+    return Status::success();
+  }
+
+  // Each event is published once for every subscription matching its path.
+  EventContextList event_list;
+  auto status = fanotify_.read([this, &event_list](const std::string& path,
+                                                   uint32_t mask) {
+    std::string action;
+    for (const auto& bit : kMaskActions) {
+      if (mask & bit.first) {
+        action = bit.second;
+        break;
+      }
+    }
+    if (action.empty()) {
+      return;
+    }
+
+    std::set<INotifySubscriptionContext*> matched;
+    WriteLock lock(path_mutex_);
+    for (const auto& isc : path_matcher_.match(path)) {
+      if (!matched.insert(isc.get()).second) {
+        continue;
+      }
+
+      auto ec = createEventContext();
+      ec->event = std::make_unique<struct inotify_event>();
+      ec->event->wd = -1;
+      ec->event->mask = mask;
+      ec->event->cookie = 0;
+      ec->event->len = 0;
+      ec->path = path;
+      ec->action = action;
+      ec->isub_ctx = isc;
+      event_list.push_back(std::move(ec));
+    }
+  });
+
+  fireBatch(event_list);
+  return status;
+}
+
 INotifyEventContextRef INotifyEventPublisher::createEventContextFrom(
     struct inotify_event* event) const {
   auto ec = createEventContext();
@@ -338,7 +430,8 @@ bool INotifyEventPublisher::shouldFire(const INotifySubscriptionContextRef& sc,
   }
 
   // inotify will not monitor recursively, new directories need watches.
-  if (sc->recursive && ec->action == "CREATED" && isDirectory(ec->path)) {
+  if (sc->recursive && !fanotify_.isOpen() && ec->action == "CREATED" &&
+      isDirectory(ec->path)) {
     const_cast<INotifyEventPublisher*>(this)->addMonitor(
         ec->path + '/',
         const_cast<INotifySubscriptionContextRef&>(sc),
@@ -346,12 +439,9 @@ bool INotifyEventPublisher::shouldFire(const INotifySubscriptionContextRef& sc,
         true);
   }
 
-  // exclude paths should be applied at last
-  auto path = ec->path.substr(0, ec->path.rfind('/'));
-  // Need to have two finds,
-  // what if somebody excluded an individual file inside a directory
-  if (!exclude_paths_.empty() &&
-      (exclude_paths_.find(path) || exclude_paths_.find(ec->path))) {
+  // exclude paths should be applied at last, this covers files excluded
+  // individually and the entries of excluded directories.
+  if (path_matcher_.isExcluded(ec->path)) {
     return false;
   }
 
@@ -363,6 +453,10 @@ bool INotifyEventPublisher::addMonitor(const std::string& path,
                                        uint32_t mask,
                                        bool recursive,
                                        bool add_watch) {
+  if (fanotify_.isOpen()) {
+    return addFanotifyMonitor(path, isc, mask, recursive);
+  }
+
   {
     WriteLock lock(path_mutex_);
     int watch = ::inotify_add_watch(
@@ -406,6 +500,35 @@ bool INotifyEventPublisher::addMonitor(const std::string& path,
   return true;
 }
 
+bool INotifyEventPublisher::addFanotifyMonitor(
+    const std::string& path,
+    INotifySubscriptionContextRef& isc,
+    uint32_t mask,
+    bool recursive) {
+  auto status =
+      fanotify_.mark(path, ((mask == 0) ? kFileDefaultMasks : mask));
+  if (!status.ok()) {
+    LOG(WARNING) << "Could not add fanotify mark for: " << path << ": "
+                 << status.getMessage();
+    return false;
+  }
+
+  // A directory matches its entries, like its inotify watch, or its tree.
+  size_t depth = 0;
+  if (!path.empty() && path.back() == '/') {
+    depth = (recursive)
+                ? PathMatcher<INotifySubscriptionContextRef>::kRecursive
+                : 1;
+  }
+
+  WriteLock lock(path_mutex_);
+  path_matcher_.insert(path, depth, isc);
+  if (inotify_sanity_check) {
+    path_descriptors_[path] = -1;
+  }
+  return true;
+}
+
 bool INotifyEventPublisher::removeMonitor(int watch,
                                           bool force,
                                           bool batch_del) {
@@ -16,6 +16,7 @@
 #include <sys/stat.h>
 
 #include <osquery/events/eventpublisher.h>
+#include <osquery/events/linux/fanotify.h>
 #include <osquery/events/pathset.h>
 #include <osquery/events/subscription.h>
 
@@ -124,8 +125,6 @@ using INotifyEventContextRef = std::shared_ptr<INotifyEventContext>;
 // Publisher container
 using DescriptorINotifySubCtxMap = std::map<int, INotifySubscriptionContextRef>;
 
-using ExcludePathSet = PathSet<patternedPath>;
-
 /**
  * @brief A Linux `inotify` EventPublisher.
  *
@@ -137,6 +136,11 @@ using ExcludePathSet = PathSet<patternedPath>;
  *
  * Uses INotifySubscriptionContext and INotifyEventContext for subscriptioning,
  *eventing.
+ *
+ * With --file_events_fanotify the publisher marks each filesystem of the
+ * subscribed paths once with `fanotify` instead of watching every directory.
+ * Events are matched against a trie of the subscribed paths and published as
+ * the same INotifyEventContext%s.
  */
 class INotifyEventPublisher
     : public EventPublisher<INotifySubscriptionContext, INotifyEventContext> {
@@ -174,6 +178,15 @@ class INotifyEventPublisher
   INotifyEventContextRef createEventContextFrom(
       struct inotify_event* event) const;
 
+  /// Read and fire the events of the `fanotify` filesystem marks.
+  Status runFanotify();
+
+  /// Mark the filesystem of a subscribed path and track the path.
+  bool addFanotifyMonitor(const std::string& path,
+                          INotifySubscriptionContextRef& isc,
+                          uint32_t mask,
+                          bool recursive);
+
   /// Check if the application-global `inotify` handle is alive.
   bool isHandleOpen() const {
     return inotify_handle_ > 0;
@@ -252,8 +265,16 @@ class INotifyEventPublisher
   /// Map of inotify watch file descriptor to subscription context.
   DescriptorINotifySubCtxMap descriptor_inosubctx_;
 
-  /// Events pertaining to these paths not to be propagated.
-  ExcludePathSet exclude_paths_;
+  /**
+   * @brief Excluded paths, and the subscribed paths of `fanotify` events.
+   *
+   * Events pertaining to excluded paths are not to be propagated. With
+   * `fanotify` the subscriptions of an event are found by matching its path.
+   */
+  PathMatcher<INotifySubscriptionContextRef> path_matcher_;
+
+  /// Filesystem marks used instead of `inotify` watches, if enabled.
+  FanotifyWatch fanotify_;
 
   /// The inotify file descriptor handle.
   std::atomic<int> inotify_handle_{-1};
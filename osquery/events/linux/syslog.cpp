@@ -18,11 +18,9 @@
 #include <istream>
 #include <string>
 
-#include <boost/algorithm/string/trim.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/property_tree/json_parser.hpp>
-#include <boost/tokenizer.hpp>
 #include <osquery/registry/registry_factory.h>
 
 #include <osquery/core/flags.h>
@@ -57,6 +55,16 @@ const std::vector<std::string> kCsvFields = {
     "time", "host", "severity", "facility", "tag", "message"};
 const size_t kErrorThreshold = 10;
 
+std::string_view trimToken(std::string_view token) {
+  const char* kWhitespace = " \t\n\v\f\r";
+  auto start = token.find_first_not_of(kWhitespace);
+  if (start == std::string_view::npos) {
+    return std::string_view();
+  }
+  auto end = token.find_last_not_of(kWhitespace);
+  return token.substr(start, end - start + 1);
+}
+
 Status NonBlockingFStream::openReadOnly(const std::string& path) {
   WriteLock lock(fd_mutex_);
 
@@ -71,8 +79,19 @@ Status NonBlockingFStream::openReadOnly(const std::string& path) {
   return Status::success();
 }
 
+void NonBlockingFStream::compact() {
+  if (consumed_ > 0) {
+    offset_ -= consumed_;
+    if (offset_ > 0) {
+      memmove(buffer_.data(), buffer_.data() + consumed_, offset_);
+    }
+    consumed_ = 0;
+  }
+}
+
 Status NonBlockingFStream::getline(std::string& output) {
   output.clear();
+  compact();
 
   char* buffer_end = nullptr;
   if (offset_ > 0) {
@@ -128,6 +147,50 @@ Status NonBlockingFStream::getline(std::string& output) {
   return Status::success();
 }
 
+Status NonBlockingFStream::readLines(std::vector<std::string_view>& lines,
+                                     size_t max_lines) {
+  lines.clear();
+  compact();
+
+  if (offset_ < buffer_.capacity()) {
+    WriteLock lock(fd_mutex_);
+
+    // Poll for available data with a near-instant delay.
+    fd_set set;
+    struct timeval timeout = {0, 200};
+    FD_ZERO(&set);
+    FD_SET(fd_, &set);
+    int rv = ::select(FD_SETSIZE, &set, nullptr, nullptr, &timeout);
+    if (rv > 0) {
+      // Fill as much of the buffer as the pipe holds.
+      auto bytes_read = ::read(
+          fd_, buffer_.data() + offset_, buffer_.capacity() - offset_);
+      if (bytes_read > 0) {
+        offset_ += bytes_read;
+      }
+    }
+  }
+
+  const char* start = buffer_.data();
+  const char* end = buffer_.data() + offset_;
+  while (lines.size() < max_lines && start < end) {
+    auto line_end = static_cast<const char*>(memchr(start, '\n', end - start));
+    if (line_end == nullptr) {
+      break;
+    }
+    lines.emplace_back(start, line_end - start);
+    start = line_end + 1;
+  }
+  consumed_ = start - buffer_.data();
+
+  if (lines.empty() && offset_ == buffer_.capacity()) {
+    // This is a problem we cannot handle.
+    offset_ = 0;
+    return Status::failure("Too much data");
+  }
+  return Status::success();
+}
+
 Status NonBlockingFStream::close() {
   WriteLock lock(fd_mutex_);
 
@@ -233,28 +296,43 @@ Status SyslogEventPublisher::run() {
   // weird and there is a huge amount of input, we limit how many logs we
   // take in per run to avoid pegging the CPU.
 
-  std::string line;
-  for (size_t i = 0; i < FLAGS_syslog_rate_limit; ++i) {
-    if (!readStream_.getline(line) || line.empty()) {
+  // Lines are read in batches, and all of the events of a run are fired
+  // together, so subscribers can store them at once.
+  EventContextList event_list;
+  size_t remaining = FLAGS_syslog_rate_limit;
+  while (remaining > 0) {
+    if (!readStream_.readLines(lines_, remaining) || lines_.empty()) {
       // Not enough data was available, fall through an wait.
       break;
     }
+    remaining -= lines_.size();
 
-    auto ec = createEventContext();
-    Status status = populateEventContext(line, ec);
-    if (status.ok()) {
-      fire(ec);
-      if (errorCount_ > 0) {
-        --errorCount_;
+    for (const auto& line : lines_) {
+      if (line.empty()) {
+        continue;
       }
-    } else {
-      LOG(ERROR) << status.getMessage() << " in line: " << line;
-      ++errorCount_;
-      if (errorCount_ >= kErrorThreshold) {
-        return Status(1, "Too many errors in syslog parsing.");
+
+      auto ec = createEventContext();
+      Status status = populateEventContext(line, ec, tokenizer_);
+      if (status.ok()) {
+        event_list.push_back(std::move(ec));
+        if (errorCount_ > 0) {
+          --errorCount_;
+        }
+      } else {
+        LOG(ERROR) << status.getMessage() << " in line: " << line;
+        ++errorCount_;
+        if (errorCount_ >= kErrorThreshold) {
+          fireBatch(event_list);
+          return Status(1, "Too many errors in syslog parsing.");
+        }
       }
     }
   }
+
+  if (!event_list.empty()) {
+    fireBatch(event_list);
+  }
   return Status::success();
 }
 
@@ -265,16 +343,26 @@ void SyslogEventPublisher::tearDown() {
 
 Status SyslogEventPublisher::populateEventContext(const std::string& line,
                                                   SyslogEventContextRef& ec) {
-  boost::tokenizer<RsyslogCsvSeparator> tokenizer(line);
-  auto key = kCsvFields.begin();
-  for (std::string value : tokenizer) {
-    if (key == kCsvFields.end()) {
-      return Status(1, "Received more fields than expected");
-    }
+  RsyslogCsvTokenizer tokenizer;
+  return populateEventContext(line, ec, tokenizer);
+}
+
+Status SyslogEventPublisher::populateEventContext(
+    std::string_view line,
+    SyslogEventContextRef& ec,
+    RsyslogCsvTokenizer& tokenizer) {
+  const auto& tokens = tokenizer.tokenize(line);
+  if (tokens.size() > kCsvFields.size()) {
+    return Status(1, "Received more fields than expected");
+  } else if (tokens.size() < kCsvFields.size()) {
+    return Status(1, "Received fewer fields than expected");
+  }
 
-    boost::trim(value);
+  auto key = kCsvFields.begin();
+  for (auto value : tokens) {
+    value = trimToken(value);
     if (*key == "time") {
-      ec->fields["datetime"] = value;
+      ec->fields.emplace("datetime", value);
     } else if (*key == "tag" && !value.empty() && value.back() == ':') {
       // rsyslog sends "tag" with a trailing colon that we don't need
       ec->fields.emplace(*key, value.substr(0, value.size() - 1));
@@ -283,12 +371,51 @@ Status SyslogEventPublisher::populateEventContext(const std::string& line,
     }
     ++key;
   }
+  return Status::success();
+}
 
-  if (key == kCsvFields.end()) {
-    return Status::success();
-  } else {
-    return Status(1, "Received fewer fields than expected");
+const std::vector<std::string_view>& RsyslogCsvTokenizer::tokenize(
+    std::string_view line) {
+  buffer_.clear();
+  offsets_.clear();
+  tokens_.clear();
+  if (line.empty()) {
+    return tokens_;
+  }
+
+  // Unescaped tokens are never longer than the line.
+  buffer_.reserve(line.size());
+
+  bool in_quote = false;
+  size_t token_start = 0;
+  for (size_t i = 0; i < line.size(); ++i) {
+    auto c = line[i];
+    if (c == ',' && !in_quote) {
+      offsets_.emplace_back(token_start, buffer_.size());
+      token_start = buffer_.size();
+    } else if (c == '"') {
+      if (!in_quote) {
+        in_quote = true;
+      } else if (i + 1 < line.size() && line[i + 1] == '"') {
+        // rsyslog escapes " with "", so reverse this by inserting "
+        buffer_.push_back('"');
+        ++i;
+      } else {
+        in_quote = false;
+      }
+    } else {
+      buffer_.push_back(c);
+    }
+  }
+
+  // A trailing comma is followed by an empty field.
+  offsets_.emplace_back(token_start, buffer_.size());
+
+  for (const auto& offset : offsets_) {
+    tokens_.emplace_back(buffer_.data() + offset.first,
+                         offset.second - offset.first);
   }
+  return tokens_;
 }
 
 bool SyslogEventPublisher::shouldFire(const SyslogSubscriptionContextRef& sc,
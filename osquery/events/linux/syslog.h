@@ -16,6 +16,7 @@
 #include <boost/noncopyable.hpp>
 
 #include <map>
+#include <string_view>
 #include <vector>
 
 #include <stdio.h>
@@ -92,6 +93,15 @@ class NonBlockingFStream : public boost::noncopyable {
    */
   Status getline(std::string& output);
 
+  /**
+   * @brief Read the available data and output up to max_lines complete lines.
+   *
+   * The lines are views into the internal buffer and are valid until the next
+   * read. Lines that were not output remain buffered. A line overflowing the
+   * internal buffer is dropped like in getline.
+   */
+  Status readLines(std::vector<std::string_view>& lines, size_t max_lines);
+
   /// Inspect the internal offset.
   size_t offset() {
     return offset_;
@@ -115,10 +125,39 @@ class NonBlockingFStream : public boost::noncopyable {
    */
   size_t offset_{0};
 
+  /// Bytes of the lines output by readLines, dropped by the next read.
+  size_t consumed_{0};
+
+ private:
+  /// Drop the lines consumed by the previous readLines.
+  void compact();
+
  private:
   FRIEND_TEST(SyslogTests, test_nonblockingfstream);
 };
 
+/**
+ * @brief Tokenizer for rsyslog CSV lines
+ *
+ * Applies the rules of RsyslogCsvSeparator to a whole line. The tokens are
+ * views into a buffer reused by every line, so tokenizing does not allocate
+ * once the buffers have grown to the longest line.
+ */
+class RsyslogCsvTokenizer {
+ public:
+  /// Tokenize a line, the tokens are valid until the next call.
+  const std::vector<std::string_view>& tokenize(std::string_view line);
+
+ private:
+  /// Unescaped characters of every token.
+  std::string buffer_;
+
+  /// Start and end offsets of each token in the buffer.
+  std::vector<std::pair<size_t, size_t>> offsets_;
+
+  std::vector<std::string_view> tokens_;
+};
+
 /**
  * @brief Event publisher for syslog lines forwarded through rsyslog
  *
@@ -184,11 +223,22 @@ class SyslogEventPublisher
    */
   static Status populateEventContext(const std::string& line,
                                      SyslogEventContextRef& ec);
+  static Status populateEventContext(std::string_view line,
+                                     SyslogEventContextRef& ec,
+                                     RsyslogCsvTokenizer& tokenizer);
 
   /**
    * @brief Input stream for reading from the pipe.
+   *
+   * The buffer holds the lines read by a run until they are parsed.
    */
-  NonBlockingFStream readStream_;
+  NonBlockingFStream readStream_{64 * 1024};
+
+  /// Lines of the current read, views into the stream buffer.
+  std::vector<std::string_view> lines_;
+
+  /// Tokenizer reused for every line.
+  RsyslogCsvTokenizer tokenizer_;
 
   /**
    * @brief Counter used to shut down thread when too many errors occur.
@@ -0,0 +1,109 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+#include <boost/noncopyable.hpp>
+
+namespace osquery {
+
+/**
+ * @brief A bounded, lock-free, multi-producer single-consumer ring buffer.
+ *
+ * Every slot carries a sequence number telling producers and the consumer
+ * whose turn it is to use it. Producers claim a slot with a single
+ * compare-and-swap on the enqueue position and never wait for each other or
+ * for the consumer; a full buffer is reported to the producer instead.
+ *
+ * Only one thread may pop at a time.
+ */
+template <typename T>
+class MpscRingBuffer : private boost::noncopyable {
+ public:
+  /// Create a buffer, the capacity is rounded up to a power of two.
+  explicit MpscRingBuffer(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) {
+      size <<= 1;
+    }
+    mask_ = size - 1;
+    slots_.reset(new Slot[size]);
+    for (size_t i = 0; i < size; ++i) {
+      slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  size_t capacity() const {
+    return mask_ + 1;
+  }
+
+  /// Append a value, returns false and leaves the value intact if full.
+  bool tryPush(T& value) {
+    auto position = enqueue_.load(std::memory_order_relaxed);
+    for (;;) {
+      auto& slot = slots_[position & mask_];
+      auto sequence = slot.sequence.load(std::memory_order_acquire);
+      auto difference =
+          static_cast<std::ptrdiff_t>(sequence) -
+          static_cast<std::ptrdiff_t>(position);
+      if (difference == 0) {
+        if (enqueue_.compare_exchange_weak(
+                position, position + 1, std::memory_order_relaxed)) {
+          slot.value = std::move(value);
+          slot.sequence.store(position + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (difference < 0) {
+        // The consumer has not yet released this slot.
+        return false;
+      } else {
+        position = enqueue_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /// Remove the oldest value, returns false if the buffer is empty.
+  bool tryPop(T& value) {
+    auto& slot = slots_[dequeue_ & mask_];
+    auto sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence != dequeue_ + 1) {
+      return false;
+    }
+
+    value = std::move(slot.value);
+    slot.value = T();
+    slot.sequence.store(dequeue_ + mask_ + 1, std::memory_order_release);
+    ++dequeue_;
+    return true;
+  }
+
+ private:
+  struct Slot {
+    std::atomic<size_t> sequence{0};
+    T value;
+  };
+
+  /// Slots, the values are moved in and out.
+  std::unique_ptr<Slot[]> slots_;
+
+  /// The slot index mask, the capacity minus one.
+  size_t mask_{0};
+
+  /// The next position claimed by a producer.
+  alignas(64) std::atomic<size_t> enqueue_{0};
+
+  /// The next position read by the consumer.
+  alignas(64) size_t dequeue_{0};
+};
+
+} // namespace osquery
@@ -9,150 +9,262 @@
 
 #pragma once
 
-#include <set>
+#include <algorithm>
+#include <cctype>
+#include <map>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <boost/noncopyable.hpp>
-#include <boost/tokenizer.hpp>
 
-#include <osquery/core/core.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/utils/mutex.h>
 
 namespace osquery {
 
 /**
- * @brief multiset based implementation for path search.
+ * @brief A compiled matcher of path patterns, used to filter file events.
  *
- * 'multiset' is used because with patterns we can search for equivalent keys.
- * Since  '/This/Path/is' ~= '/This/Path/%' ~= '/This/Path/%%' (equivalent).
+ * The include patterns of every subscription, and the exclude patterns, are
+ * merged into one trie of path components. Literal components are looked up
+ * by name and components with '*' or '?' are matched as globs, a "**"
+ * component matches the rest of a path. Matching walks the components of a
+ * path once and returns the values of all matching include patterns, or
+ * nothing if the path is excluded.
  *
- * multiset is protected by lock. It is threadsafe.
- *
- * PathSet can take any of the two policies -
- * 1. patternedPath - Path can contain pattern '%' and '%%'.
- *                    Path components containing only '%' and '%%' are supported
- *                    e.g. '/This/Path/%'.
- *                    Path components containing partial patterns are not
- *                    supported e.g. '/This/Path/xyz%' ('xyz%' will not be
- *                    treated as pattern).
+ * The matcher is protected by a lock. It is threadsafe.
  */
-template <typename PathType>
-class PathSet : private boost::noncopyable {
+template <typename T>
+class PathMatcher : private boost::noncopyable {
  public:
-  void insert(const std::string& str) {
+  /// Depth of a pattern matching everything below it.
+  static constexpr size_t kRecursive = static_cast<size_t>(-1);
+
+  explicit PathMatcher(bool case_insensitive = false)
+      : case_insensitive_(case_insensitive) {}
+
+  /**
+   * @brief Add an include pattern.
+   *
+   * @param pattern a path, with optional glob components.
+   * @param depth the number of components below the pattern it also matches,
+   * 0 for the pattern only, 1 for directory entries or kRecursive.
+   * @param value returned when a path matches.
+   */
+  void insert(const std::string& pattern, size_t depth, const T& value) {
+    WriteLock lock(mutex_);
+    auto node = &root_;
+    for (const auto& component : components(pattern)) {
+      if (component == "**") {
+        depth = kRecursive;
+        break;
+      }
+      node = child(node, component);
+    }
+
+    for (const auto& entry : node->values) {
+      if (entry.first == depth && entry.second == value) {
+        return;
+      }
+    }
+    node->values.emplace_back(depth, value);
+  }
+
+  /**
+   * @brief Add an exclude pattern, SQL wildcards are accepted.
+   *
+   * Paths matching the pattern and the entries of matching directories are
+   * excluded, a trailing '*' or "**" component excludes the whole tree.
+   */
+  void exclude(const std::string& str) {
     auto pattern = str;
     replaceGlobWildcards(pattern);
-    auto vpath = PathType::createVPath(pattern);
 
-    WriteLock lock(mset_lock_);
-    for (auto& path : vpath) {
-      paths_.insert(std::move(path));
+    WriteLock lock(mutex_);
+    auto node = &root_;
+    size_t depth = 1;
+    for (const auto& component : components(pattern)) {
+      if (component == "**") {
+        depth = kRecursive;
+        break;
+      }
+      node = child(node, component);
+      depth = (component == "*") ? kRecursive : 1;
     }
+    node->exclude = std::max(node->exclude, depth);
   }
 
-  bool find(const std::string& str) const {
-    auto path = PathType::createPath(str);
+  /// Return the values of the include patterns matching a non-excluded path.
+  std::vector<T> match(const std::string& path) const {
+    std::vector<T> matches;
+    ReadLock lock(mutex_);
+    walk(path, &matches);
+    return matches;
+  }
 
-    ReadLock lock(mset_lock_);
-    if (paths_.find(path) != paths_.end()) {
-      return true;
-    }
-    return false;
+  /// Check if a path matches an exclude pattern.
+  bool isExcluded(const std::string& path) const {
+    ReadLock lock(mutex_);
+    return walk(path, nullptr);
   }
 
   void clear() {
-    WriteLock lock(mset_lock_);
-    paths_.clear();
+    WriteLock lock(mutex_);
+    root_ = Node();
   }
 
   bool empty() const {
-    ReadLock lock(mset_lock_);
-    return paths_.empty();
+    ReadLock lock(mutex_);
+    return root_.children.empty() && root_.globs.empty() &&
+           root_.values.empty() && root_.exclude == 0;
   }
 
  private:
-  typedef typename PathType::Path Path;
-  typedef typename PathType::Compare Compare;
-  std::multiset<Path, Compare> paths_;
-  mutable Mutex mset_lock_;
-};
+  struct Node {
+    /// Literal components.
+    std::map<std::string, std::unique_ptr<Node>> children;
 
-class patternedPath {
- public:
-  typedef boost::tokenizer<boost::char_separator<char>> tokenizer;
-  typedef std::vector<std::string> Path;
-  typedef std::vector<Path> VPath;
-  struct Compare {
-    bool operator()(const Path& lhs, const Path& rhs) const {
-      size_t psize = (lhs.size() < rhs.size()) ? lhs.size() : rhs.size();
-      unsigned ndx;
-      for (ndx = 0; ndx < psize; ++ndx) {
-        if (lhs[ndx] == "**" || rhs[ndx] == "**") {
-          return false;
-        }
+    /// Glob components, matched in order of insertion.
+    std::vector<std::pair<std::string, std::unique_ptr<Node>>> globs;
 
-        if (lhs[ndx] == "*" || rhs[ndx] == "*") {
-          continue;
-        }
+    /// Include patterns ending at this node and their depths.
+    std::vector<std::pair<size_t, T>> values;
 
-        int rc = lhs[ndx].compare(rhs[ndx]);
+    /// Depth of an exclude pattern ending at this node, 0 if none.
+    size_t exclude{0};
+  };
 
-        if (rc > 0) {
-          return false;
+  Node* child(Node* node, const std::string& component) {
+    std::unique_ptr<Node>* next = nullptr;
+    if (component.find_first_of("*?") == std::string::npos) {
+      next = &node->children[component];
+    } else {
+      for (auto& glob : node->globs) {
+        if (glob.first == component) {
+          next = &glob.second;
+          break;
         }
+      }
+      if (next == nullptr) {
+        node->globs.emplace_back(component, nullptr);
+        next = &node->globs.back().second;
+      }
+    }
+
+    if (*next == nullptr) {
+      *next = std::make_unique<Node>();
+    }
+    return next->get();
+  }
 
-        if (rc < 0) {
+  /// Match a path, collecting values if requested, true if it is excluded.
+  bool walk(const std::string& path, std::vector<T>* matches) const {
+    auto parts = components(path);
+    std::vector<const Node*> nodes = {&root_};
+    std::vector<const Node*> next;
+    for (size_t i = 0; !nodes.empty(); i++) {
+      auto remaining = parts.size() - i;
+      for (const auto* node : nodes) {
+        if (node->exclude > 0 && node->exclude >= remaining) {
+          if (matches != nullptr) {
+            matches->clear();
+          }
           return true;
         }
+
+        if (matches == nullptr) {
+          continue;
+        }
+        for (const auto& entry : node->values) {
+          if (entry.first >= remaining &&
+              std::find(matches->begin(), matches->end(), entry.second) ==
+                  matches->end()) {
+            matches->push_back(entry.second);
+          }
+        }
       }
 
-      if ((ndx == rhs.size() && rhs[ndx - 1] == "*") ||
-          (ndx == lhs.size() && lhs[ndx - 1] == "*")) {
-        return false;
+      if (remaining == 0) {
+        break;
       }
 
-      return (lhs.size() < rhs.size());
+      next.clear();
+      const auto& part = parts[i];
+      for (const auto* node : nodes) {
+        auto literal = node->children.find(part);
+        if (literal != node->children.end()) {
+          next.push_back(literal->second.get());
+        }
+        for (const auto& glob : node->globs) {
+          if (globMatch(glob.first, part)) {
+            next.push_back(glob.second.get());
+          }
+        }
+      }
+      nodes.swap(next);
     }
-  };
+    return false;
+  }
 
-  static Path createPath(const std::string& str) {
-    boost::char_separator<char> sep{"/"};
-    tokenizer tokens(str, sep);
-    Path path;
+  std::vector<std::string> components(const std::string& path) const {
+    std::vector<std::string> parts;
+    size_t start = 0;
+    while (start < path.size()) {
+      auto end = path.find('/', start);
+      if (end == std::string::npos) {
+        end = path.size();
+      }
+      if (end > start) {
+        parts.push_back(path.substr(start, end - start));
+        if (case_insensitive_) {
+          auto& part = parts.back();
+          std::transform(part.begin(), part.end(), part.begin(), [](char c) {
+            return static_cast<char>(
+                std::tolower(static_cast<unsigned char>(c)));
+          });
+        }
+      }
+      start = end + 1;
+    }
+    return parts;
+  }
 
-    if (str == "/") {
-      path.push_back("");
+  /// Match a single component against a glob of '*' and '?' wildcards.
+  static bool globMatch(const std::string& glob, const std::string& text) {
+    size_t g = 0;
+    size_t t = 0;
+    size_t star = std::string::npos;
+    size_t resume = 0;
+    while (t < text.size()) {
+      if (g < glob.size() && (glob[g] == '?' || glob[g] == text[t])) {
+        g++;
+        t++;
+      } else if (g < glob.size() && glob[g] == '*') {
+        star = g++;
+        resume = t;
+      } else if (star != std::string::npos) {
+        g = star + 1;
+        t = ++resume;
+      } else {
+        return false;
+      }
     }
 
-    for (std::string component : tokens) {
-      path.push_back(std::move(component));
+    while (g < glob.size() && glob[g] == '*') {
+      g++;
     }
-    return path;
+    return g == glob.size();
   }
 
-  static VPath createVPath(const std::string& str) {
-    boost::char_separator<char> sep{"/"};
-    tokenizer tokens(str, sep);
-    VPath vpath;
-    Path path;
+ private:
+  /// Compare components ignoring ASCII case, for case-insensitive filesystems.
+  const bool case_insensitive_;
 
-    if (str == "/") {
-      path.push_back("");
-    }
+  Node root_;
 
-    for (std::string component : tokens) {
-      if (component == "**") {
-        vpath.push_back(path);
-        path.push_back(std::move(component));
-        break;
-      }
-      path.push_back(std::move(component));
-    }
-    vpath.push_back(std::move(path));
-    return vpath;
-  }
+  mutable Mutex mutex_;
 };
 
 } // namespace osquery
@@ -23,6 +23,13 @@ namespace osquery {
 using EventCallback = std::function<Status(const EventContextRef&,
                                            const SubscriptionContextRef&)>;
 
+/// Events fired together by an EventPublisher.
+using EventContextList = std::vector<EventContextRef>;
+
+/// Receives the events of a fired batch matching the SubscriptionContext.
+using EventBatchCallback = std::function<Status(
+    const EventContextList&, const SubscriptionContextRef&)>;
+
 struct Subscription;
 using SubscriptionRef = std::shared_ptr<Subscription>;
 
@@ -63,6 +70,9 @@ struct Subscription : private boost::noncopyable {
   /// An EventSubscription member EventCallback method.
   EventCallback callback;
 
+  /// If set, called once with all matching events instead of callback.
+  EventBatchCallback batch_callback;
+
   explicit Subscription(std::string name);
 
   static SubscriptionRef create(const std::string& name);
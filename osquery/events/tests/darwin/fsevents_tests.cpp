@@ -30,6 +30,8 @@ int kMaxEventLatency = 3000;
 
 DECLARE_bool(verbose);
 DECLARE_bool(enable_file_events);
+DECLARE_bool(fsevents_coalesce);
+DECLARE_uint32(fsevents_burst_limit);
 
 class FSEventsTests : public testing::Test {
  public:
@@ -217,7 +219,7 @@ TEST_F(FSEventsTests, test_fsevents_match_subscription) {
   std::vector<std::string> exclude_paths = {
       "/etc/ssh/%%", "/etc/", "/etc/ssl/openssl.cnf", "/"};
   for (const auto& path : exclude_paths) {
-    event_pub->exclude_paths_.insert(path);
+    event_pub->path_matcher_.exclude(path);
   }
 
   {
@@ -238,6 +240,60 @@ TEST_F(FSEventsTests, test_fsevents_match_subscription) {
   ASSERT_TRUE(s.ok());
 }
 
+TEST_F(FSEventsTests, test_fsevents_coalesce) {
+  const char* paths[] = {"/tmp/a", "/tmp/b", "/tmp/a", "/tmp/a"};
+  FSEventStreamEventFlags flags[] = {kFSEventStreamEventFlagItemCreated,
+                                     kFSEventStreamEventFlagItemModified,
+                                     kFSEventStreamEventFlagItemModified,
+                                     kFSEventStreamEventFlagItemXattrMod};
+  FSEventStreamEventId ids[] = {10, 11, 13, 12};
+
+  auto contexts = FSEventsEventPublisher::createEventContexts(
+      nullptr, 1, 4, paths, flags, ids);
+  EXPECT_EQ(contexts.size(), 4U);
+
+  FLAGS_fsevents_coalesce = true;
+  contexts = FSEventsEventPublisher::createEventContexts(
+      nullptr, 1, 4, paths, flags, ids);
+  FLAGS_fsevents_coalesce = false;
+
+  ASSERT_EQ(contexts.size(), 2U);
+  EXPECT_EQ(contexts[0]->path, "/tmp/a");
+  EXPECT_EQ(contexts[0]->fsevent_flags,
+            kFSEventStreamEventFlagItemCreated |
+                kFSEventStreamEventFlagItemModified |
+                kFSEventStreamEventFlagItemXattrMod);
+  EXPECT_EQ(contexts[0]->transaction_id, 13U);
+  EXPECT_EQ(contexts[1]->path, "/tmp/b");
+  EXPECT_EQ(contexts[1]->transaction_id, 11U);
+}
+
+TEST_F(FSEventsTests, test_fsevents_burst_limit) {
+  auto event_pub = std::make_shared<FSEventsEventPublisher>();
+  auto sc = event_pub->createSubscriptionContext();
+  sc->category = "etc";
+
+  FLAGS_fsevents_burst_limit = 2;
+  auto first = event_pub->createEventContext();
+  first->batch_ = 1;
+  EXPECT_TRUE(event_pub->withinBurstLimit(sc, first));
+  EXPECT_TRUE(event_pub->withinBurstLimit(sc, first));
+  EXPECT_FALSE(event_pub->withinBurstLimit(sc, first));
+
+  // Each category has its own limit.
+  auto other = event_pub->createSubscriptionContext();
+  other->category = "tmp";
+  EXPECT_TRUE(event_pub->withinBurstLimit(other, first));
+
+  // The limit applies to each batch.
+  auto second = event_pub->createEventContext();
+  second->batch_ = 2;
+  EXPECT_TRUE(event_pub->withinBurstLimit(sc, second));
+
+  FLAGS_fsevents_burst_limit = 0;
+  EXPECT_TRUE(event_pub->withinBurstLimit(sc, first));
+}
+
 class TestFSEventsEventSubscriber
     : public EventSubscriber<FSEventsEventPublisher> {
  public:
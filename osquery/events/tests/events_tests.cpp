@@ -18,6 +18,7 @@
 #include <osquery/database/database.h>
 #include <osquery/events/eventpublisher.h>
 #include <osquery/events/events.h>
+#include <osquery/events/eventstream.h>
 #include <osquery/events/eventsubscriber.h>
 #include <osquery/registry/registry_factory.h>
 #include <osquery/utils/info/tool_type.h>
@@ -553,6 +554,62 @@ TEST_F(EventsTests, test_fire_event) {
   EXPECT_TRUE(status.ok());
 }
 
+TEST_F(EventsTests, test_fire_batch) {
+  auto pub = std::make_shared<BasicEventPublisher>();
+  pub->setName("BasicPublisher");
+  auto status = EventFactory::registerEventPublisher(pub);
+  ASSERT_TRUE(status.ok());
+
+  auto sub = std::make_shared<FakeEventSubscriber>();
+  status = EventFactory::registerEventSubscriber(sub);
+  ASSERT_TRUE(status.ok());
+
+  size_t batches = 0;
+  size_t batch_events = 0;
+  auto batch_subscription = Subscription::create("fake_events");
+  batch_subscription->batch_callback =
+      [&batches, &batch_events](const EventContextList& ecs,
+                                const SubscriptionContextRef& sc) {
+        ++batches;
+        batch_events += ecs.size();
+        return Status::success();
+      };
+  status = EventFactory::addSubscription("BasicPublisher", batch_subscription);
+  ASSERT_TRUE(status.ok());
+
+  auto subscription = Subscription::create("fake_events");
+  subscription->callback = TestTheeCallback;
+  status = EventFactory::addSubscription("BasicPublisher", subscription);
+  ASSERT_TRUE(status.ok());
+
+  pub->configure();
+
+  // A batch callback is called once, other callbacks once per event.
+  kBellHathTolled = 0;
+  EventContextList ecs = {pub->createEventContext(),
+                          pub->createEventContext(),
+                          pub->createEventContext()};
+  pub->fireBatch(ecs, 10);
+  EXPECT_EQ(batches, 1U);
+  EXPECT_EQ(batch_events, 3U);
+  EXPECT_EQ(kBellHathTolled, 3);
+
+  // Every event has an ID and time.
+  EXPECT_EQ(ecs[0]->id + 2, ecs[2]->id);
+  EXPECT_EQ(ecs[1]->time, 10U);
+
+  // A single fired event reaches the batch callback.
+  pub->fire(pub->createEventContext(), 0);
+  EXPECT_EQ(batches, 2U);
+  EXPECT_EQ(batch_events, 4U);
+
+  status = EventFactory::deregisterEventSubscriber(sub->getName());
+  EXPECT_TRUE(status.ok());
+
+  status = EventFactory::deregisterEventPublisher(pub->type());
+  EXPECT_TRUE(status.ok());
+}
+
 class SubFakeEventSubscriber : public FakeEventSubscriber {
  public:
   SubFakeEventSubscriber() : FakeEventSubscriber(true) {
@@ -598,4 +655,30 @@ TEST_F(EventsTests, test_event_toggle_subscribers) {
   status = EventFactory::deregisterEventSubscriber(sub->getName());
   EXPECT_TRUE(status.ok());
 }
+
+TEST_F(EventsTests, test_event_stream_queue) {
+  EventStreamQueue queue(4);
+
+  std::vector<std::string> rows = {"a", "b", "c"};
+  EXPECT_EQ(queue.push(rows, std::chrono::milliseconds(0)), 0U);
+  EXPECT_TRUE(rows.empty());
+  EXPECT_EQ(queue.size(), 3U);
+
+  // Rows that do not fit after the wait are dropped.
+  rows = {"d", "e", "f"};
+  EXPECT_EQ(queue.push(rows, std::chrono::milliseconds(10)), 2U);
+  EXPECT_EQ(queue.size(), 4U);
+
+  std::vector<std::string> batch;
+  EXPECT_TRUE(queue.pop(batch, 3, std::chrono::milliseconds(0)));
+  EXPECT_EQ(batch, std::vector<std::string>({"a", "b", "c"}));
+
+  batch.clear();
+  EXPECT_TRUE(queue.pop(batch, 3, std::chrono::milliseconds(0)));
+  EXPECT_EQ(batch, std::vector<std::string>({"d"}));
+
+  batch.clear();
+  EXPECT_FALSE(queue.pop(batch, 3, std::chrono::milliseconds(10)));
+  EXPECT_TRUE(batch.empty());
+}
 } // namespace osquery
@@ -129,6 +129,40 @@ TEST_F(EventSubscriberPluginTests, databaseKeyForEventId) {
   EXPECT_EQ(key, expected_key.str());
 }
 
+TEST_F(EventSubscriberPluginTests, eventIndex) {
+  EventIndex index;
+  index.add(10U, EventSegment{1U, 4U});
+  index.add(10U, EventSegment{5U, 5U});
+  index.add(12U, EventSegment{6U, 9U});
+
+  // Late batches are ordered by their time.
+  index.add(11U, EventSegment{10U, 10U});
+  index.add(9U, EventSegment{11U, 12U});
+  EXPECT_EQ(index.size(), 4U);
+  EXPECT_EQ(index.segments(), 5U);
+  EXPECT_EQ(index.oldestTime(), 9U);
+  EXPECT_EQ(index.newestTime(), 12U);
+
+  auto it = index.lowerBound(10U);
+  ASSERT_NE(it, index.end());
+  EXPECT_EQ(it->segment.first, 1U);
+  EXPECT_EQ(std::next(it)->segment.first, 5U);
+  EXPECT_EQ(index.upperBound(11U)->time, 12U);
+  EXPECT_EQ(index.upperBound(12U), index.end());
+
+  // A batch is removed with all of its segments.
+  auto taken = index.takeUntil(11U, 2U);
+  EXPECT_EQ(taken.size(), 2U);
+  EXPECT_EQ(taken.segments(), 3U);
+  EXPECT_EQ(index.size(), 2U);
+  EXPECT_EQ(index.oldestTime(), 11U);
+
+  taken = index.takeOldest(5U);
+  EXPECT_EQ(taken.size(), 2U);
+  EXPECT_TRUE(index.empty());
+  EXPECT_EQ(index.size(), 0U);
+}
+
 TEST_F(EventSubscriberPluginTests, removeOverflowingEventBatches) {
   MockedOsqueryDatabase mocked_database;
   mocked_database.generateEvents("type", "name");
@@ -155,12 +189,14 @@ TEST_F(EventSubscriberPluginTests, removeOverflowingEventBatches) {
       context, mocked_database, 6U);
 
   EXPECT_EQ(context.event_index.size(), 6U);
+  EXPECT_EQ(context.dropped_events, 4U);
 
   // Try again with a limit of 4; this should remove an additional 2
   EventSubscriberPlugin::removeOverflowingEventBatches(
       context, mocked_database, 4U);
 
   EXPECT_EQ(context.event_index.size(), 4U);
+  EXPECT_EQ(context.dropped_events, 6U);
 
   // Going higher than 4 will have no effect
   EventSubscriberPlugin::removeOverflowingEventBatches(
@@ -193,6 +229,41 @@ TEST_F(EventSubscriberPluginTests, expireEventBatches) {
   EXPECT_EQ(context.event_index.size(), 5U);
 }
 
+TEST_F(EventSubscriberPluginTests, removeEventBatchesLimited) {
+  MockedOsqueryDatabase mocked_database;
+  mocked_database.generateEvents("type", "name");
+
+  EventSubscriberPlugin::Context context;
+  EventSubscriberPlugin::setDatabaseNamespace(context, "type", "name");
+
+  auto status =
+      EventSubscriberPlugin::generateEventDataIndex(context, mocked_database);
+
+  ASSERT_TRUE(status.ok());
+  EXPECT_EQ(context.event_index.size(), 10U);
+
+  // The maintenance service removes a limited number of batches per pass.
+  auto removed = EventSubscriberPlugin::removeOverflowingEventBatches(
+      context, mocked_database, 4U, 2U);
+  EXPECT_EQ(removed, 2U);
+  EXPECT_EQ(context.event_index.size(), 8U);
+
+  removed = EventSubscriberPlugin::removeOverflowingEventBatches(
+      context, mocked_database, 4U);
+  EXPECT_EQ(removed, 4U);
+  EXPECT_EQ(context.event_index.size(), 4U);
+
+  removed = EventSubscriberPlugin::expireEventBatches(
+      context, mocked_database, 1, 10, 1U);
+  EXPECT_EQ(removed, 1U);
+  EXPECT_EQ(context.event_index.size(), 3U);
+
+  removed = EventSubscriberPlugin::expireEventBatches(
+      context, mocked_database, 1, 10);
+  EXPECT_EQ(removed, 3U);
+  EXPECT_TRUE(context.event_index.empty());
+}
+
 TEST_F(EventSubscriberPluginTests, generateRows) {
   MockedOsqueryDatabase mocked_database;
   mocked_database.generateEvents("type", "name");
@@ -239,6 +310,242 @@ TEST_F(EventSubscriberPluginTests, generateRows) {
   EXPECT_EQ(result.isEnd, true);
 }
 
+TEST_F(EventSubscriberPluginTests, eventSegments) {
+  MockedOsqueryDatabase mocked_database;
+  EventSubscriberPlugin::Context context;
+  EventSubscriberPlugin::setDatabaseNamespace(context, "type", "name");
+
+  // Three batches of two events, each stored as a single segment.
+  for (EventID eid = 1; eid <= 6; eid += 2) {
+    EventSubscriberPlugin::SegmentRows rows;
+    for (auto id : {eid, eid + 1}) {
+      std::string serialized_row;
+      serializeRowJSON({{"eid", EventSubscriberPlugin::toIndex(id)}},
+                       serialized_row);
+      rows.push_back(std::make_pair(id, serialized_row));
+    }
+
+    std::string segment;
+    EventSubscriberPlugin::serializeSegment((eid + 1) / 2, rows, segment);
+    EXPECT_TRUE(EventSubscriberPlugin::isSegment(segment));
+    mocked_database.key_map.insert(
+        {EventSubscriberPlugin::databaseKeyForEventId(context, eid), segment});
+  }
+  mocked_database.key_map.insert({"data.type.name2.0000000002", "{}"});
+
+  auto status =
+      EventSubscriberPlugin::generateEventDataIndex(context, mocked_database);
+  ASSERT_TRUE(status.ok());
+  EXPECT_EQ(context.event_index.size(), 3U);
+  EXPECT_EQ(context.last_event_id, 6U);
+
+  std::vector<Row> rows;
+  auto callback = [&rows](Row row) { rows.push_back(std::move(row)); };
+  auto result = EventSubscriberPlugin::generateRows(
+      context, mocked_database, callback, 0, 0);
+  EXPECT_EQ(rows.size(), 6U);
+  EXPECT_EQ(result.last_id, 6U);
+
+  // Events already visited within a segment are skipped.
+  rows.clear();
+  EventSubscriberPlugin::generateRows(
+      context, mocked_database, callback, 0, 0, 4);
+  ASSERT_EQ(rows.size(), 2U);
+  EXPECT_EQ(rows[0].at("eid"), "5");
+
+  // Consecutive segments expire using a range of keys, other keys remain.
+  EventSubscriberPlugin::expireEventBatches(context, mocked_database, 1, 3);
+  EXPECT_EQ(context.event_index.size(), 1U);
+  EXPECT_EQ(mocked_database.key_map.size(), 2U);
+  EXPECT_EQ(mocked_database.key_map.count(
+                EventSubscriberPlugin::databaseKeyForEventId(context, 5)),
+            1U);
+}
+
+TEST_F(EventSubscriberPluginTests, generateRowsBinary) {
+  MockedOsqueryDatabase mocked_database;
+  mocked_database.generateEvents("type", "name", true);
+  EXPECT_EQ(mocked_database.key_map.size(), 21U);
+
+  EventSubscriberPlugin::Context context;
+  EventSubscriberPlugin::setDatabaseNamespace(context, "type", "name");
+
+  auto status =
+      EventSubscriberPlugin::generateEventDataIndex(context, mocked_database);
+  ASSERT_TRUE(status.ok());
+  EXPECT_EQ(context.event_index.size(), 10U);
+  EXPECT_EQ(context.dictionary.columns().size(), 6U);
+
+  std::vector<Row> rows;
+  auto callback = [&rows](Row row) { rows.push_back(std::move(row)); };
+  EventSubscriberPlugin::generateRows(context, mocked_database, callback, 3, 3);
+  ASSERT_EQ(rows.size(), 1U);
+
+  // Decoding yields the strings that were encoded.
+  EXPECT_EQ(rows[0].at("time"), "3");
+  EXPECT_EQ(rows[0].at("key1"), "value1");
+  EXPECT_EQ(rows[0].size(), 6U);
+
+  // Without the dictionary the binary rows are invalid and removed.
+  mocked_database.key_map.erase(
+      EventSubscriberPlugin::databaseKeyForDictionary(context));
+  status =
+      EventSubscriberPlugin::generateEventDataIndex(context, mocked_database);
+  EXPECT_TRUE(status.ok());
+  EXPECT_TRUE(context.event_index.empty());
+  EXPECT_TRUE(mocked_database.key_map.empty());
+}
+
+TEST_F(EventSubscriberPluginTests, eventRowFilter) {
+  EXPECT_TRUE(EventRowFilter::like("/etc/passwd", "/etc/%"));
+  EXPECT_TRUE(EventRowFilter::like("/ETC/passwd", "/etc/_asswd"));
+  EXPECT_TRUE(EventRowFilter::like("/etc/passwd", "%pass%"));
+  EXPECT_TRUE(EventRowFilter::like("", "%"));
+  EXPECT_FALSE(EventRowFilter::like("/etc/passwd", "/etc/"));
+  EXPECT_FALSE(EventRowFilter::like("/etc", "/etc/%"));
+
+  QueryContext context;
+  context.constraints["path"].affinity = TEXT_TYPE;
+  context.constraints["path"].add(Constraint(LIKE, "/usr/%"));
+  context.constraints["pid"].affinity = BIGINT_TYPE;
+  context.constraints["pid"].add(Constraint(GREATER_THAN, "10"));
+  context.constraints["pid"].add(Constraint(LESS_THAN, "20.5"));
+  context.constraints["time"].affinity = BIGINT_TYPE;
+  context.constraints["time"].add(Constraint(EQUALS, "1"));
+
+  // The time constraint and real number comparisons are not filtered.
+  EventRowFilter filter(context);
+  EXPECT_EQ(filter.columns(), std::set<std::string>({"path", "pid"}));
+
+  EXPECT_TRUE(filter.matches({{"path", "/usr/bin/id"}, {"pid", "11"}}));
+  EXPECT_TRUE(filter.matches({{"path", "/usr/bin/id"}, {"pid", "30"}}));
+  EXPECT_FALSE(filter.matches({{"path", "/bin/id"}, {"pid", "11"}}));
+  EXPECT_FALSE(filter.matches({{"path", "/usr/bin/id"}, {"pid", "10"}}));
+  EXPECT_FALSE(filter.matches({{"path", "/usr/bin/id"}, {"pid", ""}}));
+
+  // Missing columns are left for SQLite to compare.
+  EXPECT_TRUE(filter.matches({{"pid", "11"}}));
+  EXPECT_TRUE(EventRowFilter().matches({}));
+}
+
+TEST_F(EventSubscriberPluginTests, eventIngestFilter) {
+  TableColumns columns = {
+      std::make_tuple("path", TEXT_TYPE, ColumnOptions::DEFAULT),
+      std::make_tuple("pid", BIGINT_TYPE, ColumnOptions::DEFAULT),
+      std::make_tuple("name", TEXT_TYPE, ColumnOptions::COLLATENOCASE),
+  };
+
+  // Queries that may return any event are not described.
+  for (const auto& query : {
+           "SELECT * FROM process_events",
+           "SELECT * FROM process_events WHERE pid = 1 OR path = '/bin/id'",
+           "SELECT * FROM process_events JOIN users USING (uid) WHERE pid = 1",
+           "SELECT * FROM process_events WHERE pid = 1 UNION SELECT 1",
+           "SELECT * FROM (SELECT * FROM process_events) WHERE pid = 1",
+           "SELECT * FROM process_events WHERE name = 'id'",
+           "SELECT * FROM process_events WHERE pid = 01",
+       }) {
+    EventIngestFilter filter;
+    EXPECT_FALSE(filter.addQuery(query, "process_events", columns)) << query;
+  }
+
+  EventIngestFilter filter;
+  ASSERT_TRUE(filter.addQuery(
+      "SELECT * FROM process_events WHERE path NOT LIKE '/usr/bin/%' AND "
+      "pid BETWEEN 1 AND 9 AND pid > 10",
+      "process_events",
+      columns));
+  ASSERT_TRUE(filter.addQuery("select e.pid from process_events as e where "
+                              "e.pid IN (1, '2') AND path = 'it''s';",
+                              "process_events",
+                              columns));
+  EXPECT_EQ(filter.size(), 2U);
+
+  EXPECT_TRUE(filter.matches({{"path", "/bin/id"}, {"pid", "11"}}));
+  EXPECT_FALSE(filter.matches({{"path", "/usr/bin/id"}, {"pid", "11"}}));
+  EXPECT_FALSE(filter.matches({{"path", "/bin/id"}, {"pid", "3"}}));
+  EXPECT_TRUE(filter.matches({{"path", "it's"}, {"pid", "2"}}));
+
+  // Missing and non-integer values are left for SQLite to compare.
+  EXPECT_TRUE(filter.matches({{"path", "/bin/id"}}));
+  EXPECT_TRUE(filter.matches({{"path", "it's"}, {"pid", ""}}));
+}
+
+TEST_F(EventSubscriberPluginTests, generateRowsWithFilter) {
+  QueryContext query_context;
+  query_context.constraints["eid"].affinity = TEXT_TYPE;
+  query_context.constraints["eid"].add(Constraint(EQUALS, "5"));
+  query_context.constraints["key1"].affinity = TEXT_TYPE;
+  query_context.constraints["key1"].add(Constraint(LIKE, "VALUE%"));
+  EventRowFilter filter(query_context);
+
+  for (auto binary_rows : {false, true}) {
+    MockedOsqueryDatabase mocked_database;
+    mocked_database.generateEvents("type", "name", binary_rows);
+
+    EventSubscriberPlugin::Context context;
+    EventSubscriberPlugin::setDatabaseNamespace(context, "type", "name");
+    auto status =
+        EventSubscriberPlugin::generateEventDataIndex(context, mocked_database);
+    ASSERT_TRUE(status.ok());
+
+    std::vector<Row> rows;
+    auto callback = [&rows](Row row) { rows.push_back(std::move(row)); };
+    EventSubscriberPlugin::generateRows(
+        context, mocked_database, callback, 0, 0, 0, filter);
+    ASSERT_EQ(rows.size(), 1U);
+    EXPECT_EQ(rows[0].at("eid"), "5");
+    EXPECT_EQ(rows[0].size(), 6U);
+  }
+}
+
+TEST_F(EventSubscriberPluginTests, memoryStore) {
+  EventMemoryStore store;
+  ASSERT_TRUE(store.setDatabaseValue(kEvents, "a", "123").ok());
+  ASSERT_TRUE(store.setDatabaseBatch(kEvents, {{"b", "4"}, {"c", "56"}}).ok());
+  EXPECT_EQ(store.bytes(), 9U);
+
+  int value = 0;
+  ASSERT_TRUE(store.getDatabaseValue(kEvents, "a", value).ok());
+  EXPECT_EQ(value, 123);
+  std::string content;
+  EXPECT_FALSE(store.getDatabaseValue(kPersistentSettings, "a", content).ok());
+
+  std::vector<std::string> keys;
+  ASSERT_TRUE(store.scanDatabaseKeys(kEvents, keys, "b", 0).ok());
+  EXPECT_EQ(keys, std::vector<std::string>({"b"}));
+
+  // Like the database plugins, the range includes both keys.
+  ASSERT_TRUE(store.deleteDatabaseRange(kEvents, "a", "b").ok());
+  keys.clear();
+  ASSERT_TRUE(store.scanDatabaseKeys(kEvents, keys, 0).ok());
+  EXPECT_EQ(keys, std::vector<std::string>({"c"}));
+  EXPECT_EQ(store.bytes(), 3U);
+
+  // Subscribers evict their oldest events to fit the memory limit.
+  MockedOsqueryDatabase mocked_database;
+  mocked_database.generateEvents("type", "name", true);
+  DatabaseStringValueList events(mocked_database.key_map.begin(),
+                                 mocked_database.key_map.end());
+  EventMemoryStore event_store;
+  ASSERT_TRUE(event_store.setDatabaseBatch(kEvents, events).ok());
+
+  EventSubscriberPlugin::Context context;
+  EventSubscriberPlugin::setDatabaseNamespace(context, "type", "name");
+  auto status =
+      EventSubscriberPlugin::generateEventDataIndex(context, event_store);
+  ASSERT_TRUE(status.ok());
+  ASSERT_EQ(context.event_index.size(), 10U);
+
+  auto max_bytes = event_store.bytes() / 2;
+  EventSubscriberPlugin::removeEventBatchesOverBytes(
+      context, event_store, max_bytes);
+  EXPECT_LE(event_store.bytes(), max_bytes);
+  EXPECT_GT(context.event_index.size(), 0U);
+  EXPECT_LT(context.event_index.size(), 10U);
+  EXPECT_EQ(context.event_index.newestTime(), 9U);
+}
+
 class FakeEventSubscriberPlugin : public EventSubscriberPlugin {
  public:
   FakeEventSubscriberPlugin(IDatabaseInterface& db)
@@ -329,6 +636,44 @@ TEST_F(EventSubscriberPluginTests, getEventsExpiry) {
   EXPECT_EQ(10U, expiry);
 }
 
+TEST_F(EventSubscriberPluginTests, ingestQueue) {
+  // The capacity is rounded up to a power of two.
+  MpscRingBuffer<int> buffer(3);
+  ASSERT_EQ(4U, buffer.capacity());
+
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_TRUE(buffer.tryPush(i));
+  }
+
+  // A full buffer does not take the value.
+  int value = 4;
+  EXPECT_FALSE(buffer.tryPush(value));
+  EXPECT_EQ(4, value);
+
+  for (int i = 0; i < 4; ++i) {
+    ASSERT_TRUE(buffer.tryPop(value));
+    EXPECT_EQ(i, value);
+  }
+  EXPECT_FALSE(buffer.tryPop(value));
+
+  // Batches added to a subscriber with a queue wait for the writer.
+  MockedOsqueryDatabase mocked_database;
+  FakeEventSubscriberPlugin subscriber(mocked_database);
+  subscriber.ingest_queue_ =
+      std::make_unique<MpscRingBuffer<EventSubscriberPlugin::PendingBatch>>(2);
+
+  std::vector<Row> row_list = {{{"path", "/tmp/1"}}, {{"path", "/tmp/2"}}};
+  ASSERT_TRUE(subscriber.addBatch(row_list, 100).ok());
+  EXPECT_TRUE(row_list.empty());
+
+  EventSubscriberPlugin::PendingBatch batch;
+  ASSERT_TRUE(subscriber.ingest_queue_->tryPop(batch));
+  EXPECT_EQ(100U, batch.time);
+  ASSERT_EQ(2U, batch.rows.size());
+  EXPECT_EQ("/tmp/2", batch.rows[1].at("path"));
+  EXPECT_FALSE(subscriber.ingest_queue_->tryPop(batch));
+}
+
 TEST_F(EventSubscriberPluginTests, generateRowsWithExpiry) {
   MockedOsqueryDatabase mocked_database;
   FakeEventSubscriberPlugin subscriber(mocked_database);
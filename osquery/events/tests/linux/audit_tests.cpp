@@ -16,16 +16,22 @@
 
 #include <sstream>
 
+#include <boost/filesystem.hpp>
+
 #include <osquery/core/flags.h>
 #include <osquery/core/tables.h>
 
+#include "osquery/events/linux/audit_capture.h"
 #include "osquery/events/linux/auditdnetlink.h"
+#include "osquery/events/linux/auditeventpublisher.h"
 #include "osquery/tests/test_util.h"
 
 namespace osquery {
 
 DECLARE_bool(audit_allow_unix);
 
+namespace fs = boost::filesystem;
+
 using StringMap = std::map<std::string, std::string>;
 
 /// Generates a fake audit id
@@ -76,6 +82,31 @@ TEST_F(AuditTests, test_handle_reply) {
   EXPECT_EQ(audit_event_record.fields["a2"], "c");
 }
 
+TEST_F(AuditTests, test_handle_reply_tokens) {
+  std::string message =
+      "audit(1440542781.644:403031): flag  a0=x\"y z\" a1=\"q\"a2=1 a0=2 "
+      "a3=\"open";
+
+  std::vector<char> buffer(message.begin(), message.end());
+  buffer.push_back('\0');
+
+  struct audit_reply reply {};
+  reply.type = 1;
+  reply.len = message.size();
+  reply.message = buffer.data();
+
+  AuditEventRecord audit_event_record = {};
+  EXPECT_TRUE(AuditdNetlinkParser::ParseAuditReply(reply, audit_event_record));
+
+  // Keys without a value are kept, the first of duplicate keys is used.
+  EXPECT_EQ(audit_event_record.fields.size(), 5U);
+  EXPECT_EQ(audit_event_record.fields["flag"], "");
+  EXPECT_EQ(audit_event_record.fields["a0"], "x\"y z\"");
+  EXPECT_EQ(audit_event_record.fields["a1"], "\"q\"");
+  EXPECT_EQ(audit_event_record.fields["a2"], "1");
+  EXPECT_EQ(audit_event_record.fields["a3"], "\"open");
+}
+
 TEST_F(AuditTests, test_audit_value_decode) {
   // In the normal case the decoding only removes '"' characters from the ends.
   auto decoded_normal = DecodeAuditPathValues("\"/bin/ls\"");
@@ -90,6 +121,136 @@ TEST_F(AuditTests, test_audit_value_decode) {
   EXPECT_EQ(decoded_fail, "7");
 }
 
+TEST_F(AuditTests, test_trace_context_key) {
+  AuditTraceContext::Key key;
+  ASSERT_TRUE(AuditTraceContext::parseKey(key, "1501323932.710:7670542"));
+  EXPECT_EQ(key.timestamp_ms, 1501323932710U);
+  EXPECT_EQ(key.serial, 7670542U);
+
+  EXPECT_FALSE(AuditTraceContext::parseKey(key, "1501323932:7670542"));
+  EXPECT_FALSE(AuditTraceContext::parseKey(key, "1501323932.710"));
+  EXPECT_FALSE(AuditTraceContext::parseKey(key, "abc.710:7670542"));
+}
+
+TEST_F(AuditTests, test_trace_context_expiration) {
+  const std::time_t now = 1600000000;
+  auto makeKey = [](std::time_t timestamp, std::uint64_t serial) {
+    AuditTraceContext::Key key;
+    key.timestamp_ms = static_cast<std::uint64_t>(timestamp) * 1000U;
+    key.serial = serial;
+    return key;
+  };
+
+  AuditTraceContext trace_context;
+  trace_context.insert(makeKey(now - 10, 1U), AuditEvent{});
+  trace_context.insert(makeKey(now - 400, 2U), AuditEvent{});
+  trace_context.insert(makeKey(now - 20, 3U), AuditEvent{});
+  EXPECT_EQ(trace_context.size(), 3U);
+
+  // A completed event is removed before it expires
+  AuditEvent event;
+  EXPECT_TRUE(trace_context.take(makeKey(now - 20, 3U), event));
+  EXPECT_FALSE(trace_context.take(makeKey(now - 20, 3U), event));
+
+  EXPECT_EQ(trace_context.expire(now), 1U);
+  EXPECT_EQ(trace_context.size(), 1U);
+  EXPECT_EQ(trace_context.find(makeKey(now - 400, 2U)), nullptr);
+  EXPECT_NE(trace_context.find(makeKey(now - 10, 1U)), nullptr);
+
+  // A late event is expired with the next slot of the wheel
+  trace_context.insert(makeKey(now - 500, 4U), AuditEvent{});
+  EXPECT_EQ(trace_context.expire(now + 1), 1U);
+  EXPECT_NE(trace_context.find(makeKey(now - 10, 1U)), nullptr);
+
+  EXPECT_EQ(trace_context.expire(now + 290), 1U);
+  EXPECT_EQ(trace_context.size(), 0U);
+  EXPECT_EQ(trace_context.expiredEventCount(), 3U);
+}
+
+TEST_F(AuditTests, test_audit_capture) {
+  auto path = (fs::temp_directory_path() /
+               fs::unique_path("osquery.audit.capture.%%%%.%%%%"))
+                  .string();
+
+  std::vector<std::string> messages = {
+      "audit(1453855819.429:1234): arch=c000003e syscall=59 success=yes",
+      "audit(1453855819.429:1234): argc=2 a0=\"ls\" a1=\"C:\\\ndir\"",
+  };
+
+  {
+    AuditCaptureWriter writer;
+    ASSERT_TRUE(writer.open(path).ok());
+    for (const auto& message : messages) {
+      audit_reply reply{};
+      reply.type = AUDIT_SYSCALL;
+      reply.len = static_cast<int>(message.size());
+      reply.message = message.c_str();
+      writer.write(reply);
+    }
+  }
+
+  std::vector<AuditCaptureRecord> records;
+  ASSERT_TRUE(readAuditCapture(path, records).ok());
+  fs::remove(path);
+  ASSERT_EQ(records.size(), messages.size());
+  for (size_t i = 0; i < records.size(); ++i) {
+    EXPECT_EQ(records[i].type, AUDIT_SYSCALL);
+    EXPECT_EQ(records[i].message, messages[i]);
+  }
+  EXPECT_LE(records[0].offset_us, records[1].offset_us);
+
+  // A replayed record parses as the received one.
+  audit_reply reply{};
+  makeAuditReply(records[0], reply);
+  AuditEventRecord audit_event_record;
+  ASSERT_TRUE(
+      AuditdNetlinkParser::ParseAuditReply(reply, audit_event_record));
+  EXPECT_EQ(audit_event_record.audit_id, "1453855819.429:1234");
+  EXPECT_EQ(audit_event_record.fields["syscall"], "59");
+}
+
+TEST_F(AuditTests, test_compile_audit_rules) {
+  std::vector<AuditRule> rules;
+  ASSERT_TRUE(compileAuditRules({}, AuditRuleExclusions{}, rules).ok());
+  EXPECT_TRUE(rules.empty());
+
+  // The syscalls share one rule.
+  std::set<int> syscalls = {59, 322, 42};
+  ASSERT_TRUE(compileAuditRules(syscalls, AuditRuleExclusions{}, rules).ok());
+  ASSERT_EQ(rules.size(), 1U);
+  EXPECT_EQ(rules[0].action, AUDIT_ALWAYS);
+  EXPECT_TRUE(rules[0].field.empty());
+
+  const auto* rule =
+      reinterpret_cast<const audit_rule_data*>(rules[0].data.data());
+  ASSERT_GE(rules[0].data.size(), sizeof(audit_rule_data));
+  for (int syscall_number : syscalls) {
+    EXPECT_NE(rule->mask[AUDIT_WORD(syscall_number)] &
+                  AUDIT_BIT(syscall_number),
+              0U);
+  }
+
+  // The exclusions are installed first, the kernel applies the first match.
+  AuditRuleExclusions exclusions;
+  exclusions.exes = {"/usr/sbin/cron"};
+  exclusions.paths = {"/var/lib/docker"};
+  exclusions.unset_auid = true;
+  ASSERT_TRUE(compileAuditRules(syscalls, exclusions, rules).ok());
+  ASSERT_EQ(rules.size(), 4U);
+  EXPECT_EQ(rules[0].field, "exe=/usr/sbin/cron");
+  EXPECT_EQ(rules[1].field, "dir=/var/lib/docker");
+  EXPECT_EQ(rules[2].field, "auid=4294967295");
+  for (size_t i = 0; i < 3; ++i) {
+    EXPECT_EQ(rules[i].action, AUDIT_NEVER);
+
+    rule = reinterpret_cast<const audit_rule_data*>(rules[i].data.data());
+    EXPECT_EQ(rule->field_count, 1U);
+    EXPECT_EQ(rules[i].data.size(), sizeof(audit_rule_data) + rule->buflen);
+  }
+  EXPECT_EQ(rules[3].action, AUDIT_ALWAYS);
+  EXPECT_TRUE(rules[3].field.empty());
+}
+
 size_t kAuditCounter{0};
 
 bool SimpleUpdate(size_t t, const StringMap& f, StringMap& m) {
@@ -1699,4 +1699,29 @@ TEST_F(BPFEventPublisherTests, processListenEvent) {
   EXPECT_TRUE(succeeded);
 }
 
+TEST_F(BPFEventPublisherTests, enqueueEvents) {
+  auto L_createEvent = [](std::uint64_t timestamp, std::uint64_t identifier) {
+    auto bpf_event = kBaseBPFEvent;
+    bpf_event.identifier = identifier;
+    bpf_event.header.timestamp = timestamp;
+    return bpf_event;
+  };
+
+  BPFEventPublisher::EventQueue queue;
+  BPFEventPublisher::enqueueEvents(
+      queue, {L_createEvent(30, 1), L_createEvent(10, 2)});
+
+  // Older events are merged, events with equal timestamps are all kept.
+  BPFEventPublisher::enqueueEvents(
+      queue, {L_createEvent(20, 3), L_createEvent(30, 4)});
+  BPFEventPublisher::enqueueEvents(queue, {L_createEvent(40, 5)});
+
+  std::vector<std::uint64_t> identifier_list;
+  for (const auto& bpf_event : queue) {
+    identifier_list.push_back(bpf_event.identifier);
+  }
+
+  EXPECT_EQ(identifier_list, std::vector<std::uint64_t>({2, 3, 1, 4, 5}));
+}
+
 } // namespace osquery
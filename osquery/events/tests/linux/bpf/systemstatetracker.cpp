@@ -217,6 +217,48 @@ TEST_F(SystemStateTrackerTests, create_process) {
   EXPECT_TRUE(std::holds_alternative<std::monostate>(fork_event2.data));
 }
 
+TEST_F(SystemStateTrackerTests, create_process_shares_fd_map) {
+  auto process_context_factory =
+      std::make_unique<MockedProcessContextFactory>();
+
+  auto bpf_event_header = kBaseBPFEventHeader;
+  bpf_event_header.process_id = 1001;
+  bpf_event_header.exit_code = 0;
+
+  SystemStateTracker::Context context;
+  auto succeeded = SystemStateTracker::createProcess(
+      context,
+      *process_context_factory.get(),
+      bpf_event_header,
+      1000, // parent pid
+      bpf_event_header.process_id); // child pid
+
+  ASSERT_TRUE(succeeded);
+
+  // The child process shares the file descriptors of the parent
+  const auto& parent_process = context.process_map.at(1000);
+  const auto& child_process = context.process_map.at(1001);
+  EXPECT_TRUE(parent_process.fd_map.shared());
+  EXPECT_TRUE(child_process.fd_map.shared());
+
+  auto expected_fd_count = parent_process.fd_map.size();
+  EXPECT_EQ(child_process.fd_map.size(), expected_fd_count);
+
+  // Closing a file descriptor in the child copies the table first
+  succeeded = SystemStateTracker::closeHandle(
+      context, *process_context_factory.get(), 1001, 11);
+
+  ASSERT_TRUE(succeeded);
+  EXPECT_FALSE(parent_process.fd_map.shared());
+  EXPECT_FALSE(child_process.fd_map.shared());
+
+  EXPECT_EQ(parent_process.fd_map.size(), expected_fd_count);
+  EXPECT_EQ(parent_process.fd_map.count(11), 1U);
+
+  EXPECT_EQ(child_process.fd_map.size(), expected_fd_count - 1U);
+  EXPECT_EQ(child_process.fd_map.count(11), 0U);
+}
+
 TEST_F(SystemStateTrackerTests, execute_binary_with_absolute_path) {
   auto bpf_event_header = kBaseBPFEventHeader;
   bpf_event_header.process_id = 1001;
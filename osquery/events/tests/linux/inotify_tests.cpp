@@ -259,7 +259,7 @@ TEST_F(INotifyTests, test_inotify_match_subscription) {
   std::vector<std::string> exclude_paths = {
       "/etc/ssh/%%", "/etc/", "/etc/ssl/openssl.cnf", "/"};
   for (const auto& path : exclude_paths) {
-    event_pub_->exclude_paths_.insert(path);
+    event_pub_->path_matcher_.exclude(path);
   }
 
   {
@@ -553,4 +553,42 @@ TEST_F(INotifyTests, test_inotify_embedded_wildcards) {
 
   EventFactory::deregisterEventPublisher("inotify");
 }
+
+TEST_F(INotifyTests, test_path_matcher) {
+  PathMatcher<int> paths;
+  EXPECT_TRUE(paths.empty());
+
+  paths.insert("/etc/passwd", 0, 1);
+  paths.insert("/etc/", 1, 2);
+  paths.insert("/var/", PathMatcher<int>::kRecursive, 3);
+  paths.insert("/home/*/.ssh/authorized_keys", 0, 4);
+  paths.insert("/opt/**", 0, 5);
+  EXPECT_FALSE(paths.empty());
+
+  EXPECT_EQ(paths.match("/etc/passwd"), std::vector<int>({2, 1}));
+  EXPECT_EQ(paths.match("/etc"), std::vector<int>({2}));
+  EXPECT_EQ(paths.match("/etc/ssh/sshd_config"), std::vector<int>());
+  EXPECT_EQ(paths.match("/var/log/syslog"), std::vector<int>({3}));
+  EXPECT_EQ(paths.match("/home/a/.ssh/authorized_keys"), std::vector<int>({4}));
+  EXPECT_EQ(paths.match("/home/a/b/.ssh/authorized_keys"), std::vector<int>());
+  EXPECT_EQ(paths.match("/opt/a/b/c"), std::vector<int>({5}));
+  EXPECT_EQ(paths.match("/usr/bin"), std::vector<int>());
+
+  // Excluded paths, and the entries of excluded directories, never match.
+  paths.exclude("/var/log/");
+  paths.exclude("/home/%/.ssh/%%");
+  EXPECT_EQ(paths.match("/var/log/syslog"), std::vector<int>());
+  EXPECT_EQ(paths.match("/var/log/apt/history.log"), std::vector<int>({3}));
+  EXPECT_EQ(paths.match("/home/a/.ssh/authorized_keys"), std::vector<int>());
+  EXPECT_TRUE(paths.isExcluded("/var/log"));
+  EXPECT_FALSE(paths.isExcluded("/var"));
+
+  paths.clear();
+  EXPECT_TRUE(paths.empty());
+  EXPECT_EQ(paths.match("/etc/passwd"), std::vector<int>());
+
+  PathMatcher<int> insensitive(true);
+  insensitive.insert("/Users/*/Library/", 1, 1);
+  EXPECT_EQ(insensitive.match("/users/a/library/x"), std::vector<int>({1}));
+}
 } // namespace osquery
@@ -204,4 +204,65 @@ TEST_F(SyslogTests, test_csv_separator) {
   ASSERT_EQ(std::vector<std::string>({"\",f\\ø\"o,", "\",bá\\'r", "baz\\,\""}),
             splitCsv("\"\"\",f\\ø\"\"o,\",\"\"\",bá\\'r\",\"baz\\,\"\"\""));
 }
+
+TEST_F(SyslogTests, test_csv_tokenizer) {
+  // The tokenizer splits lines like the separator.
+  std::vector<std::string> lines = {
+      "",
+      ",,,,",
+      " , , , , ",
+      "foo,bar,baz",
+      "\"foo\",\"bar\",\"baz\"",
+      "\",foo,\",\",bar\",\"baz,\"",
+      "\"\"\",f\\o\"\"o,\",\"\"\",ba\\'r\",\"baz\\,\"\"\"",
+      "\"\"\",f\\ø\"\"o,\",\"\"\",bá\\'r\",\"baz\\,\"\"\"",
+  };
+
+  RsyslogCsvTokenizer tokenizer;
+  for (const auto& line : lines) {
+    const auto& tokens = tokenizer.tokenize(line);
+    std::vector<std::string> result(tokens.begin(), tokens.end());
+    EXPECT_EQ(splitCsv(line), result) << line;
+  }
+}
+
+TEST_F(SyslogTests, test_nonblockingfstream_read_lines) {
+  auto pipe_path = test_working_dir_ / "pipe";
+  ASSERT_EQ(mkfifo(pipe_path.string().c_str(), 0660), 0);
+  ASSERT_EQ(chmod(pipe_path.string().c_str(), 0660), 0);
+
+  NonBlockingFStream nbfs(20);
+  ASSERT_TRUE(nbfs.openReadOnly(pipe_path.string()).ok());
+
+  auto fd = open(pipe_path.string().c_str(), O_WRONLY | O_NONBLOCK);
+  ASSERT_GT(fd, 0);
+
+  std::string fill = "AAA\nBBB\nCCC\nDD";
+  ASSERT_EQ(write(fd, fill.data(), fill.size()), fill.size());
+
+  // Only the requested number of lines is output, the rest are kept.
+  std::vector<std::string_view> lines;
+  EXPECT_TRUE(nbfs.readLines(lines, 2).ok());
+  EXPECT_EQ(std::vector<std::string_view>({"AAA", "BBB"}), lines);
+
+  EXPECT_TRUE(nbfs.readLines(lines, 2).ok());
+  EXPECT_EQ(std::vector<std::string_view>({"CCC"}), lines);
+
+  // The incomplete line is completed by the next write.
+  fill = "D\n";
+  ASSERT_EQ(write(fd, fill.data(), fill.size()), fill.size());
+  EXPECT_TRUE(nbfs.readLines(lines, 2).ok());
+  EXPECT_EQ(std::vector<std::string_view>({"DDD"}), lines);
+
+  EXPECT_TRUE(nbfs.readLines(lines, 2).ok());
+  EXPECT_TRUE(lines.empty());
+  EXPECT_EQ(0, nbfs.offset());
+
+  // A line longer than the buffer is dropped.
+  fill = std::string(20, 'A');
+  ASSERT_EQ(write(fd, fill.data(), fill.size()), fill.size());
+  EXPECT_FALSE(nbfs.readLines(lines, 2).ok());
+  EXPECT_EQ(0, nbfs.offset());
+  close(fd);
+}
 }
@@ -29,7 +29,8 @@ extern const std::string kEvents;
 extern const std::string kExecutingQuery;
 
 void MockedOsqueryDatabase::generateEvents(const std::string& publisher,
-                                           const std::string& name) {
+                                           const std::string& name,
+                                           bool binary_rows) {
   EventSubscriberPlugin::Context context;
   EventSubscriberPlugin::setDatabaseNamespace(context, publisher, name);
 
@@ -43,10 +44,14 @@ void MockedOsqueryDatabase::generateEvents(const std::string& publisher,
     row.insert({"eid", std::to_string(event_id)});
 
     std::string serialized_row;
-    auto status = serializeRowJSON(row, serialized_row);
-    if (!status.ok()) {
-      throw std::runtime_error(
-          "MockedOsqueryDatabase: Failed to serialize the row");
+    if (binary_rows) {
+      context.dictionary.encode(row, serialized_row);
+    } else {
+      auto status = serializeRowJSON(row, serialized_row);
+      if (!status.ok()) {
+        throw std::runtime_error(
+            "MockedOsqueryDatabase: Failed to serialize the row");
+      }
     }
 
     auto key = EventSubscriberPlugin::databaseKeyForEventId(context, event_id);
@@ -57,6 +62,14 @@ void MockedOsqueryDatabase::generateEvents(const std::string& publisher,
     key = EventSubscriberPlugin::databaseKeyForEventId(context, event_id);
     key_map.insert({key, "broken_serialized_value"});
   }
+
+  if (binary_rows) {
+    std::string serialized_dictionary;
+    context.dictionary.serialize(serialized_dictionary);
+    key_map.insert(
+        {EventSubscriberPlugin::databaseKeyForDictionary(context),
+         std::move(serialized_dictionary)});
+  }
 }
 
 Status MockedOsqueryDatabase::getDatabaseValue(const std::string& domain,
@@ -155,8 +168,15 @@ Status MockedOsqueryDatabase::deleteDatabaseRange(
     const std::string& domain,
     const std::string& low,
     const std::string& high) const {
-  return Status::failure(
-      "MockedOsqueryDatabase: Unsupported deleteDatabaseRange call");
+  if (domain != kEvents || low > high) {
+    throw std::logic_error(
+        "MockedOsqueryDatabase: Invalid parameter passed to "
+        "deleteDatabaseRange");
+  }
+
+  // Like the database plugins, the range includes both keys.
+  key_map.erase(key_map.lower_bound(low), key_map.upper_bound(high));
+  return Status::success();
 }
 
 Status MockedOsqueryDatabase::scanDatabaseKeys(const std::string& domain,
@@ -20,7 +20,9 @@ class MockedOsqueryDatabase final : public IDatabaseInterface {
   MockedOsqueryDatabase() = default;
   virtual ~MockedOsqueryDatabase() override = default;
 
-  void generateEvents(const std::string& publisher, const std::string& name);
+  void generateEvents(const std::string& publisher,
+                      const std::string& name,
+                      bool binary_rows = false);
 
   virtual Status getDatabaseValue(const std::string& domain,
                                   const std::string& key,
@@ -9,6 +9,7 @@
 
 #include <gtest/gtest.h>
 
+#include "osquery/events/windows/ntfs_event_publisher.h"
 #include "osquery/events/windows/usn_journal_reader.h"
 #include "osquery/tests/test_util.h"
 
@@ -215,4 +216,48 @@ TEST_F(UsnJournalReaderTests, test_get_event_string) {
   EXPECT_FALSE(USNParsers::GetEventString(buffer, (USN_RECORD*)usn_v3))
       << "GetEventString should refuse to parse V4 records";
 }
+
+TEST_F(UsnJournalReaderTests, test_frn_path_cache) {
+  USNFileReferenceNumber first{1U};
+  USNFileReferenceNumber second{2U};
+  USNFileReferenceNumber third{3U};
+
+  FRNPathCache cache(2U);
+  cache.put('C', first, "C:\\first");
+  cache.put('C', second, "C:\\first\\second");
+
+  // The same FRN on another volume is a different directory.
+  std::string path;
+  EXPECT_FALSE(cache.get(path, 'D', first));
+  EXPECT_TRUE(cache.get(path, 'C', first));
+  EXPECT_EQ(path, "C:\\first");
+
+  // The least recently used path is evicted.
+  cache.put('C', third, "C:\\third");
+  EXPECT_EQ(cache.size(), 2U);
+  EXPECT_FALSE(cache.get(path, 'C', second));
+  EXPECT_TRUE(cache.get(path, 'C', third));
+
+  auto stats = cache.takeStats();
+  EXPECT_EQ(stats.first, 2U);
+  EXPECT_EQ(stats.second, 2U);
+  stats = cache.takeStats();
+  EXPECT_EQ(stats.first, 0U);
+  EXPECT_EQ(stats.second, 0U);
+
+  // Renaming a directory updates the paths below it.
+  cache.setCapacity(3U);
+  cache.put('C', second, "C:\\first\\second");
+  cache.rename('C', first, "C:\\first", "C:\\renamed");
+  EXPECT_TRUE(cache.get(path, 'C', first));
+  EXPECT_EQ(path, "C:\\renamed");
+  EXPECT_TRUE(cache.get(path, 'C', second));
+  EXPECT_EQ(path, "C:\\renamed\\second");
+
+  cache.erase('C', second);
+  EXPECT_FALSE(cache.get(path, 'C', second));
+
+  cache.setCapacity(0U);
+  EXPECT_EQ(cache.size(), 0U);
+}
 } // namespace osquery
@@ -23,7 +23,17 @@ using EventTime = uint64_t;
 using EventRecord = std::pair<std::string, EventTime>;
 using EventID = std::uint64_t;
 using EventIDList = std::vector<EventID>;
-using EventIndex = std::map<EventTime, EventIDList>;
+
+/// Events stored together in one value, written by a single addBatch.
+struct EventSegment {
+  /// The first EventID, the value is stored using its key.
+  EventID first{0};
+
+  /// The last EventID within the segment.
+  EventID last{0};
+};
+
+using EventSegmentList = std::vector<EventSegment>;
 
 /**
  * @brief An EventSubscriber EventCallback method will receive an EventContext.
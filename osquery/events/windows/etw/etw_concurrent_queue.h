@@ -9,8 +9,11 @@
 
 #pragma once
 
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
+#include <cstddef>
+#include <memory>
 #include <mutex>
 #include <queue>
 
@@ -102,10 +105,171 @@ class ConcurrentQueue : public boost::noncopyable {
   std::condition_variable condition_;
 };
 
+/**
+ * @brief Bounded, lock-free, multi-producer multi-consumer queue
+ *
+ * Elements are stored in a ring of sequenced cells. Producers never block:
+ * an element pushed to a full queue is dropped and counted. Consumers only
+ * take the mutex to sleep when the queue is empty.
+ */
+template <typename T>
+class BoundedConcurrentQueue : public boost::noncopyable {
+ public:
+  /**
+   * @brief The capacity is rounded up to a power of two.
+   */
+  explicit BoundedConcurrentQueue(size_t capacity) {
+    size_t size = 2U;
+    while (size < capacity) {
+      size <<= 1U;
+    }
+
+    cells_ = std::make_unique<Cell[]>(size);
+    mask_ = size - 1U;
+    for (size_t i = 0U; i < size; ++i) {
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  size_t capacity() const {
+    return mask_ + 1U;
+  }
+
+  /**
+   * @brief Returns the approximate number of elements in the queue.
+   */
+  size_t size() const {
+    auto enqueued = enqueue_pos_.load(std::memory_order_relaxed);
+    auto dequeued = dequeue_pos_.load(std::memory_order_relaxed);
+    return enqueued > dequeued ? enqueued - dequeued : 0U;
+  }
+
+  bool empty() const {
+    return size() == 0U;
+  }
+
+  /**
+   * @brief Stores a new element, returns false if the queue was full and the
+   * element was dropped.
+   */
+  bool push(const T& item) {
+    Cell* cell = nullptr;
+    auto pos = enqueue_pos_.load(std::memory_order_relaxed);
+    for (;;) {
+      cell = &cells_[pos & mask_];
+      auto sequence = cell->sequence.load(std::memory_order_acquire);
+      auto diff = static_cast<std::ptrdiff_t>(sequence) -
+                  static_cast<std::ptrdiff_t>(pos);
+      if (diff == 0) {
+        if (enqueue_pos_.compare_exchange_weak(
+                pos, pos + 1U, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        dropped_.fetch_add(1U, std::memory_order_relaxed);
+        return false;
+      } else {
+        pos = enqueue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+
+    cell->data = item;
+    cell->sequence.store(pos + 1U, std::memory_order_release);
+
+    // Pairs with the fence in popWait, a sleeping consumer is always woken.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters_.load(std::memory_order_relaxed) > 0U) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      condition_.notify_all();
+    }
+    return true;
+  }
+
+  /**
+   * @brief Removes the front element without waiting, returns false if the
+   * queue is empty.
+   */
+  bool tryPop(T& element) {
+    Cell* cell = nullptr;
+    auto pos = dequeue_pos_.load(std::memory_order_relaxed);
+    for (;;) {
+      cell = &cells_[pos & mask_];
+      auto sequence = cell->sequence.load(std::memory_order_acquire);
+      auto diff = static_cast<std::ptrdiff_t>(sequence) -
+                  static_cast<std::ptrdiff_t>(pos + 1U);
+      if (diff == 0) {
+        if (dequeue_pos_.compare_exchange_weak(
+                pos, pos + 1U, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = dequeue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+
+    element = std::move(cell->data);
+    cell->data = T();
+    cell->sequence.store(pos + mask_ + 1U, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Removes the front element, waiting up to the timeout when the
+   * queue is empty. Returns false if no element was obtained.
+   */
+  bool popWait(T& element, const unsigned int timeoutMS = 300) {
+    if (tryPop(element)) {
+      return true;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    waiters_.fetch_add(1U);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    bool obtained =
+        condition_.wait_for(lock, std::chrono::milliseconds(timeoutMS), [&] {
+          return tryPop(element);
+        });
+    waiters_.fetch_sub(1U);
+    return obtained;
+  }
+
+  /**
+   * @brief Returns the number of elements dropped since the last call.
+   */
+  size_t takeDropped() {
+    return dropped_.exchange(0U, std::memory_order_relaxed);
+  }
+
+ private:
+  struct Cell {
+    std::atomic<size_t> sequence{0U};
+    T data;
+  };
+
+  std::unique_ptr<Cell[]> cells_;
+  size_t mask_{0U};
+
+  alignas(64) std::atomic<size_t> enqueue_pos_{0U};
+  alignas(64) std::atomic<size_t> dequeue_pos_{0U};
+  alignas(64) std::atomic<size_t> dropped_{0U};
+
+  std::atomic<size_t> waiters_{0U};
+  std::mutex mutex_;
+  std::condition_variable condition_;
+};
+
 /**
  * @brief Concurrent Queue for ETW events
  */
 using ConcurrentEventQueue = ConcurrentQueue<EtwEventDataRef>;
 using ConcurrentEventQueueRef = std::shared_ptr<ConcurrentEventQueue>;
 
+/**
+ * @brief Bounded queue of a post-processing worker
+ */
+using BoundedEventQueue = BoundedConcurrentQueue<EtwEventDataRef>;
+using BoundedEventQueueRef = std::shared_ptr<BoundedEventQueue>;
+
 } // namespace osquery
\ No newline at end of file
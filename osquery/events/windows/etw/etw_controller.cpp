@@ -7,6 +7,9 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+
+#include <osquery/core/flags.h>
 #include <osquery/events/windows/etw/etw_controller.h>
 #include <osquery/events/windows/etw/etw_kernel_session.h>
 #include <osquery/events/windows/etw/etw_post_processing_pipeline.h>
@@ -17,6 +20,35 @@
 
 namespace osquery {
 
+HIDDEN_FLAG(uint32,
+            etw_post_processing_workers,
+            1,
+            "Threads post-processing ETW events, in order for each process");
+
+HIDDEN_FLAG(uint32,
+            etw_event_queue_size,
+            65536,
+            "Most ETW events queued for each post-processing thread");
+
+namespace {
+
+// Events of a process always go to the same worker, keeping their order
+std::uint32_t getPartitionKey(const EtwEventDataRef& data) {
+  if (auto procStartData = std::get_if<EtwProcStartDataRef>(&data->Payload)) {
+    if (*procStartData != nullptr) {
+      return (*procStartData)->ProcessId;
+    }
+  } else if (auto procStopData =
+                 std::get_if<EtwProcStopDataRef>(&data->Payload)) {
+    if (*procStopData != nullptr) {
+      return (*procStopData)->ProcessId;
+    }
+  }
+
+  return static_cast<std::uint32_t>(data->Header.RawHeader.ProcessId);
+}
+} // namespace
+
 // Returns a reference to the single global EtwController instance
 EtwController& EtwController::instance() {
   static EtwController instance;
@@ -25,9 +57,11 @@ EtwController& EtwController::instance() {
 
 //  New events get stored in the post-processing queue
 void EtwController::dispatchETWEvents(const EtwEventDataRef& data) {
-  // storing the event in the thread-safe concurrent event queue
-  if (concurrentQueue_) {
-    concurrentQueue_->push(data);
+  // storing the event in the lock-free queue of the process' worker, events
+  // are dropped, and counted by the queue, when it is full
+  if (data && !eventQueues_.empty()) {
+    auto& queue = eventQueues_[getPartitionKey(data) % eventQueues_.size()];
+    queue->push(data);
   }
 }
 
@@ -49,11 +83,13 @@ Status EtwController::addProvider(const EtwProviderConfig& configData) {
   }
 
   // Adding post-processors callbacks to handle
-  Status postProcessingStatus =
-      etwPostProcessingEngine_->addProvider(configData);
+  for (auto& etwPostProcessingEngine : etwPostProcessingEngines_) {
+    Status postProcessingStatus =
+        etwPostProcessingEngine->addProvider(configData);
 
-  if (!postProcessingStatus.ok()) {
-    return Status::failure(postProcessingStatus.getMessage());
+    if (!postProcessingStatus.ok()) {
+      return Status::failure(postProcessingStatus.getMessage());
+    }
   }
 
   // ETW configuration data contains information to determine if an userspace or
@@ -80,7 +116,7 @@ Status EtwController::addProvider(const EtwProviderConfig& configData) {
 // post-processing pipeline is started here.
 Status EtwController::startProcessing() {
   // sanity checks on processing engines
-  if (!etwPostProcessingEngine_) {
+  if (etwPostProcessingEngines_.empty()) {
     return Status::failure("ETW Post processing engine not ready");
   }
 
@@ -93,10 +129,13 @@ Status EtwController::startProcessing() {
   }
 
   // Spinning up runnable osquery services
-  Status pipelineStatus = Dispatcher::addService(etwPostProcessingEngine_);
-  if (!pipelineStatus.ok()) {
-    return Status::failure("ETW Post processing engine couldn't be started: " +
-                           pipelineStatus.getMessage());
+  for (auto& etwPostProcessingEngine : etwPostProcessingEngines_) {
+    Status pipelineStatus = Dispatcher::addService(etwPostProcessingEngine);
+    if (!pipelineStatus.ok()) {
+      return Status::failure(
+          "ETW Post processing engine couldn't be started: " +
+          pipelineStatus.getMessage());
+    }
   }
 
   Status userStatus = Dispatcher::addService(etwUserSession_);
@@ -123,12 +162,6 @@ Status EtwController::initialize() {
     return Status::success();
   }
 
-  // Initializing concurrent ETW event queue
-  concurrentQueue_ = std::make_shared<ConcurrentEventQueue>();
-  if (!concurrentQueue_) {
-    return Status::failure("There was a problem allocating concurrent queue");
-  }
-
   // Initializing ETW userspace trace session
   etwUserSession_ =
       std::make_shared<UserEtwSessionRunnable>(runNameUserETWSession);
@@ -143,12 +176,20 @@ Status EtwController::initialize() {
     return Status::failure("There was a problem allocating ETW Kernel Session");
   }
 
-  // Initializing ETW post processing engine
-  etwPostProcessingEngine_ = std::make_shared<EtwPostProcessorsRunnable>(
-      runNamePostProcessingEngine, concurrentQueue_);
-  if (!etwPostProcessingEngine_) {
-    return Status::failure(
-        "There was a problem allocating ETW Post Processing Engine");
+  // Initializing ETW post processing workers and their event queues
+  auto workers = std::max<std::uint32_t>(FLAGS_etw_post_processing_workers, 1U);
+  for (std::uint32_t i = 0; i < workers; ++i) {
+    auto queue = std::make_shared<BoundedEventQueue>(
+        std::max<std::uint32_t>(FLAGS_etw_event_queue_size, 1U));
+
+    auto runName = runNamePostProcessingEngine;
+    if (i > 0) {
+      runName += std::to_string(i);
+    }
+
+    eventQueues_.push_back(queue);
+    etwPostProcessingEngines_.push_back(
+        std::make_shared<EtwPostProcessorsRunnable>(runName, queue));
   }
 
   // Launching processing threads
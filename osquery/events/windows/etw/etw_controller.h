@@ -9,6 +9,8 @@
 
 #pragma once
 
+#include <vector>
+
 #include <boost/noncopyable.hpp>
 
 #include <osquery/events/windows/etw/etw_concurrent_queue.h>
@@ -81,8 +83,9 @@ class EtwController : public boost::noncopyable {
   std::atomic<bool> initialized_{false};
   std::shared_ptr<UserEtwSessionRunnable> etwUserSession_{nullptr};
   std::shared_ptr<KernelEtwSessionRunnable> etwKernelSession_{nullptr};
-  std::shared_ptr<EtwPostProcessorsRunnable> etwPostProcessingEngine_{nullptr};
-  std::shared_ptr<ConcurrentEventQueue> concurrentQueue_{nullptr};
+  std::vector<std::shared_ptr<EtwPostProcessorsRunnable>>
+      etwPostProcessingEngines_;
+  std::vector<BoundedEventQueueRef> eventQueues_;
   mutable std::mutex mutex_;
 };
 
@@ -8,6 +8,8 @@
  */
 
 #include <osquery/events/windows/etw/etw_post_processing_pipeline.h>
+#include <osquery/logger/logger.h>
+#include <osquery/numeric_monitoring/numeric_monitoring.h>
 #include <osquery/utils/conversions/windows/windows_time.h>
 #include <osquery/utils/map_take.h>
 #include <osquery/utils/status/status.h>
@@ -15,8 +17,8 @@
 namespace osquery {
 
 EtwPostProcessorsRunnable::EtwPostProcessorsRunnable(
-    const std::string& sessionName, ConcurrentEventQueueRef& sharedQueue)
-    : InternalRunnable(sessionName), concurrentQueue_(sharedQueue) {}
+    const std::string& sessionName, BoundedEventQueueRef queue)
+    : InternalRunnable(sessionName), concurrentQueue_(std::move(queue)) {}
 
 EtwPostProcessorsRunnable::~EtwPostProcessorsRunnable() {
   stop();
@@ -57,11 +59,22 @@ bool EtwPostProcessorsRunnable::CommonPostProcessing(EtwEventDataRef& data) {
 }
 
 void EtwPostProcessorsRunnable::start() {
+  static const monitoring::Metric kDroppedEvents(
+      "etw.events.dropped", monitoring::PreAggregationType::Sum);
+
   while (concurrentQueue_ && shouldRun_) {
     // Worker will blockwait until a new element is retrieved from the queue
     EtwEventDataRef data;
     bool elementReady = concurrentQueue_->popWait(data);
 
+    // Events were dropped by the producers while this queue was full
+    auto dropped = concurrentQueue_->takeDropped();
+    if (dropped > 0U) {
+      VLOG(1) << "ETW post-processing queue was full, dropped " << dropped
+              << " events";
+      kDroppedEvents.record(static_cast<monitoring::ValueType>(dropped));
+    }
+
     // Check if thread should return after stop request
     if (!shouldRun_) {
       break;
@@ -20,12 +20,12 @@ class Status;
 /**
  * @brief Manages the collection of post-processing
  * callbacks in-charge of processing and dispatching events to event
- * subscribers.
+ * subscribers. Each worker drains its own bounded event queue.
  */
 class EtwPostProcessorsRunnable final : public InternalRunnable {
  public:
   EtwPostProcessorsRunnable(const std::string& runnableName,
-                            ConcurrentEventQueueRef& sharedQueue);
+                            BoundedEventQueueRef queue);
   virtual ~EtwPostProcessorsRunnable();
 
   /**
@@ -65,9 +65,9 @@ class EtwPostProcessorsRunnable final : public InternalRunnable {
   std::atomic<bool> shouldRun_{true};
 
   /**
-   * @brief Concurrent event queue reference
+   * @brief Events of the processes assigned to this worker
    */
-  ConcurrentEventQueueRef& concurrentQueue_;
+  BoundedEventQueueRef concurrentQueue_;
 };
 
 } // namespace osquery
@@ -291,16 +291,23 @@ void EtwPublisherProcesses::providerPostProcessor(
     std::uint64_t searchKey = getComposedKey(procStartData->ProcessId,
                                              procStartData->ParentProcessId);
 
-    // Access to the map iterator is required, tryTakeCopy cannot be used here.
-    auto processCacheIt = processStartAggregationCache_.find(searchKey);
-    if (processCacheIt == processStartAggregationCache_.end()) {
-      // this event needs to be agreggated, so cache it for the time being
-      if (procStartData->CreateTime.dwHighDateTime == 0 &&
-          procStartData->CreateTime.dwLowDateTime == 0) {
-        GetSystemTimeAsFileTime(&procStartData->CreateTime);
+    bool shouldDispatch = false;
+    {
+      WriteLock lock(processCacheMutex_);
+
+      // Access to the map iterator is required, tryTakeCopy cannot be used
+      // here.
+      auto processCacheIt = processStartAggregationCache_.find(searchKey);
+      if (processCacheIt == processStartAggregationCache_.end()) {
+        // this event needs to be agreggated, so cache it for the time being
+        if (procStartData->CreateTime.dwHighDateTime == 0 &&
+            procStartData->CreateTime.dwLowDateTime == 0) {
+          GetSystemTimeAsFileTime(&procStartData->CreateTime);
+        }
+        processStartAggregationCache_.insert({searchKey, procStartData});
+        return;
       }
-      processStartAggregationCache_.insert({searchKey, procStartData});
-    } else {
+
       // A previous event was found on the cache, aggregate and dispatch it
       auto procStartCacheData = processCacheIt->second;
       if (procStartCacheData == nullptr) {
@@ -308,7 +315,6 @@ void EtwPublisherProcesses::providerPostProcessor(
       }
 
       // Event Agreggation stage
-      bool shouldDispatch = false;
       if (procStartCacheData->KernelDataReady && procStartData->UserDataReady) {
         procStartData->Cmdline.assign(procStartCacheData->Cmdline);
         procStartData->Flags = procStartCacheData->Flags;
@@ -336,27 +342,32 @@ void EtwPublisherProcesses::providerPostProcessor(
       }
 
       if (shouldDispatch) {
-        // Event is ready to be dispatched
-
-        // Event enrichment phase
-        updateHardVolumeWithLogicalDrive(procStartData->ImageName);
-        updateUserInfo(procStartData->UserSid, procStartData->UserName);
-        updateTokenInfo(procStartData->TokenElevationType,
-                        procStartData->TokenElevationTypeInfo);
-
-        // Event dispatch
-        event_context->data = std::move(eventData);
-        fire(event_context);
-
         // Remove it from the process start aggregation cache
         processStartAggregationCache_.erase(processCacheIt);
 
         // Houskeeping of expired aggregation cache entries
         cleanOldAggregationCacheEntries();
+      }
+    }
+
+    if (shouldDispatch) {
+      // Event is ready to be dispatched
+
+      // Event enrichment phase
+      updateHardVolumeWithLogicalDrive(procStartData->ImageName);
+      updateUserInfo(procStartData->UserSid, procStartData->UserName);
+      updateTokenInfo(procStartData->TokenElevationType,
+                      procStartData->TokenElevationTypeInfo);
 
-        // Caching image full path
+      // Caching image full path
+      {
+        WriteLock lock(processCacheMutex_);
         processImageCache_.insert({searchKey, procStartData->ImageName});
       }
+
+      // Event dispatch
+      event_context->data = std::move(eventData);
+      fire(event_context);
     }
   }
 }
@@ -402,10 +413,10 @@ void EtwPublisherProcesses::cleanOldAggregationCacheEntries() {
     if ((eventTimestamp.QuadPart + expiredTime10secs) <
         currentTimestamp.QuadPart) {
       // event expire and should be deleted
-      processStartAggregationCache_.erase(it);
+      it = processStartAggregationCache_.erase(it);
+    } else {
+      ++it;
     }
-
-    ++it;
   }
 }
 
@@ -424,51 +435,60 @@ void EtwPublisherProcesses::updateHardVolumeWithLogicalDrive(
 void EtwPublisherProcesses::updateUserInfo(const std::string& userSid,
                                            std::string& username) {
   // Updating user information using gathered user SIDs as input
-  auto usernameIt = usernamesBySIDs_.find(userSid);
-  if (usernameIt != usernamesBySIDs_.end()) {
-    auto cachedUsername = usernameIt->second;
-    username.assign(cachedUsername);
-  } else {
-    PSID pSid = nullptr;
-
-    if (!ConvertStringSidToSidA(userSid.c_str(), &pSid) || pSid == nullptr) {
-      // Inserting empty username to avoid the lookup logic to be called again
-      usernamesBySIDs_.insert({userSid, ""});
+  {
+    ReadLock lock(usernamesMutex_);
+    auto usernameIt = usernamesBySIDs_.find(userSid);
+    if (usernameIt != usernamesBySIDs_.end()) {
+      username.assign(usernameIt->second);
       return;
     }
+  }
 
-    std::vector<char> domainNameStr(MAX_PATH - 1, 0x0);
-    std::vector<char> userNameStr(MAX_PATH - 1, 0x0);
-    DWORD domainNameSize = MAX_PATH;
-    DWORD userNameSize = MAX_PATH;
-    SID_NAME_USE sidType = SID_NAME_USE::SidTypeInvalid;
-
-    if (!LookupAccountSidA(NULL,
-                           pSid,
-                           userNameStr.data(),
-                           &userNameSize,
-                           domainNameStr.data(),
-                           &domainNameSize,
-                           &sidType) ||
-        strlen(domainNameStr.data()) == 0 ||
-        strlen(domainNameStr.data()) >= MAX_PATH ||
-        strlen(userNameStr.data()) == 0 ||
-        strlen(userNameStr.data()) >= MAX_PATH ||
-        sidType == SID_NAME_USE::SidTypeInvalid) {
-      // Inserting empty username to avoid the lookup logic to be called again
-      usernamesBySIDs_.insert({userSid, ""});
-      LocalFree(pSid);
-      return;
-    }
+  // The account lookup is done without holding the lock
+  auto cacheUsername = [this, &userSid](const std::string& value) {
+    WriteLock lock(usernamesMutex_);
+    usernamesBySIDs_.insert({userSid, value});
+  };
 
-    LocalFree(pSid);
+  PSID pSid = nullptr;
 
-    username.append(domainNameStr.data());
-    username.append("\\");
-    username.append(userNameStr.data());
+  if (!ConvertStringSidToSidA(userSid.c_str(), &pSid) || pSid == nullptr) {
+    // Inserting empty username to avoid the lookup logic to be called again
+    cacheUsername("");
+    return;
+  }
 
-    usernamesBySIDs_.insert({userSid, username});
+  std::vector<char> domainNameStr(MAX_PATH - 1, 0x0);
+  std::vector<char> userNameStr(MAX_PATH - 1, 0x0);
+  DWORD domainNameSize = MAX_PATH;
+  DWORD userNameSize = MAX_PATH;
+  SID_NAME_USE sidType = SID_NAME_USE::SidTypeInvalid;
+
+  if (!LookupAccountSidA(NULL,
+                         pSid,
+                         userNameStr.data(),
+                         &userNameSize,
+                         domainNameStr.data(),
+                         &domainNameSize,
+                         &sidType) ||
+      strlen(domainNameStr.data()) == 0 ||
+      strlen(domainNameStr.data()) >= MAX_PATH ||
+      strlen(userNameStr.data()) == 0 ||
+      strlen(userNameStr.data()) >= MAX_PATH ||
+      sidType == SID_NAME_USE::SidTypeInvalid) {
+    // Inserting empty username to avoid the lookup logic to be called again
+    cacheUsername("");
+    LocalFree(pSid);
+    return;
   }
+
+  LocalFree(pSid);
+
+  username.append(domainNameStr.data());
+  username.append("\\");
+  username.append(userNameStr.data());
+
+  cacheUsername(username);
 }
 
 void EtwPublisherProcesses::updateImagePath(const std::uint64_t& key1,
@@ -478,6 +498,7 @@ void EtwPublisherProcesses::updateImagePath(const std::uint64_t& key1,
   std::uint64_t searchKey = getComposedKey(key1, key2);
 
   // Event specific post processing callback logic
+  WriteLock lock(processCacheMutex_);
   imagePath = tryTake(processImageCache_, searchKey).takeOr(imagePath);
 }
 
@@ -10,6 +10,7 @@
 #pragma once
 
 #include <osquery/events/windows/etw/etw_publisher.h>
+#include <osquery/utils/mutex.h>
 
 namespace osquery {
 
@@ -144,6 +145,10 @@ class EtwPublisherProcesses
   ProcessImageCacheCollection processImageCache_;
   HardVolumeDriveCollection hardVolumeDrives_;
   UsernameBySIDCollection usernamesBySIDs_;
+
+  /// Post-processing may run on several threads, these protect the caches
+  Mutex processCacheMutex_;
+  Mutex usernamesMutex_;
 };
 
 } // namespace osquery
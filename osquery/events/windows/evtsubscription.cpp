@@ -7,54 +7,41 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
-#include <chrono>
-#include <condition_variable>
-#include <mutex>
+#include <array>
 
 #include <osquery/events/windows/evtsubscription.h>
+#include <osquery/events/windows/windowseventlogparser.h>
 #include <osquery/logger/logger.h>
 #include <osquery/utils/conversions/windows/strings.h>
 
 namespace osquery {
-// Note: Windows ignores the exit code of this function
-DWORD WINAPI EvtSubscriptionCallbackDispatcher(
-    EVT_SUBSCRIBE_NOTIFY_ACTION action, PVOID context, EVT_HANDLE event) {
-  auto& subscription = *static_cast<EvtSubscription*>(context);
-
-  if (action == EvtSubscribeActionError) {
-    LOG(ERROR)
-        << "Windows event callback error 'EvtSubscribeActionError' for channel "
-        << subscription.channel();
-
-    return 0;
-
-  } else if (action != EvtSubscribeActionDeliver) {
-    LOG(ERROR) << "Windows event callback invoked with invalid action value "
-                  "for channel "
-               << subscription.channel();
-
-    return 0;
-  }
-
-  subscription.processEvent(event);
-  return 0U;
-}
+namespace {
+/// The most events read with one EvtNext call.
+const DWORD kEventBatchSize{256U};
+} // namespace
 
 struct EvtSubscription::PrivateData final {
   EVT_HANDLE handle{nullptr};
   std::string channel;
 
-  EventList event_list;
-  std::mutex event_list_mutex;
-  std::condition_variable event_list_cv;
+  /// Set by the event log service when new events can be read.
+  HANDLE signal{nullptr};
+
+  /// The render contexts of the system and user values, if rendering values.
+  EVT_HANDLE system_context{nullptr};
+  EVT_HANDLE user_context{nullptr};
+
+  /// Reused by every rendering, it grows to fit the largest event.
+  std::vector<BYTE> render_buffer;
 };
 
 Status EvtSubscription::create(EvtSubscription::Ref& obj,
-                               const std::string& channel) {
+                               const std::string& channel,
+                               bool render_values) {
   obj.reset();
 
   try {
-    obj.reset(new EvtSubscription(channel));
+    obj.reset(new EvtSubscription(channel, render_values));
     return Status::success();
 
   } catch (const std::bad_alloc&) {
@@ -66,7 +53,21 @@ Status EvtSubscription::create(EvtSubscription::Ref& obj,
 }
 
 EvtSubscription::~EvtSubscription() {
-  EvtClose(d_->handle);
+  if (d_->handle != nullptr) {
+    EvtClose(d_->handle);
+  }
+
+  if (d_->system_context != nullptr) {
+    EvtClose(d_->system_context);
+  }
+
+  if (d_->user_context != nullptr) {
+    EvtClose(d_->user_context);
+  }
+
+  if (d_->signal != nullptr) {
+    CloseHandle(d_->signal);
+  }
 }
 
 const std::string EvtSubscription::channel() const {
@@ -76,35 +77,79 @@ const std::string EvtSubscription::channel() const {
 EvtSubscription::EventList EvtSubscription::getEvents() {
   EventList event_list;
 
-  {
-    std::unique_lock<std::mutex> lock(d_->event_list_mutex);
+  if (WaitForSingleObject(d_->signal, 1000U) != WAIT_OBJECT_0) {
+    return event_list;
+  }
 
-    auto ready = d_->event_list_cv.wait_for(
-        lock, std::chrono::seconds(1U), [=]() -> bool {
-          return !d_->event_list.empty();
-        });
+  // Reset the signal before reading, so that events arriving while the
+  // batches are read signal it again
+  ResetEvent(d_->signal);
 
-    if (ready) {
-      event_list = std::move(d_->event_list);
-      d_->event_list = {};
+  std::array<EVT_HANDLE, kEventBatchSize> events{};
+  while (true) {
+    DWORD returned{0U};
+    if (!EvtNext(d_->handle,
+                 static_cast<DWORD>(events.size()),
+                 events.data(),
+                 0U,
+                 0U,
+                 &returned)) {
+      auto error = GetLastError();
+      if (error == ERROR_EVT_QUERY_RESULT_STALE) {
+        LOG(WARNING) << "Windows events were dropped for channel "
+                     << d_->channel;
+
+      } else if (error != ERROR_NO_MORE_ITEMS) {
+        LOG(ERROR) << "Failed to read the events of channel " << d_->channel
+                   << ". Error: " << error;
+      }
+
+      break;
+    }
+
+    for (DWORD i = 0U; i < returned; ++i) {
+      processEvent(event_list, events[i]);
+      EvtClose(events[i]);
     }
   }
 
   return event_list;
 }
 
-EvtSubscription::EvtSubscription(const std::string& channel)
+EvtSubscription::EvtSubscription(const std::string& channel,
+                                 bool render_values)
     : d_(new PrivateData) {
   d_->channel = channel;
   auto channel_utf16 = stringToWstring(channel);
 
+  if (render_values) {
+    d_->system_context =
+        EvtCreateRenderContext(0U, nullptr, EvtRenderContextSystem);
+    d_->user_context =
+        EvtCreateRenderContext(0U, nullptr, EvtRenderContextUser);
+
+    if (d_->system_context == nullptr || d_->user_context == nullptr) {
+      auto error = GetLastError();
+      throw Status::failure("Failed to create the render contexts for the "
+                            "channel named " +
+                            channel + ". Error " + std::to_string(error));
+    }
+  }
+
+  d_->signal = CreateEvent(nullptr, TRUE, TRUE, nullptr);
+  if (d_->signal == nullptr) {
+    auto error = GetLastError();
+    throw Status::failure("Failed to create the signal for the channel named " +
+                          channel + ". Error " + std::to_string(error));
+  }
+
   auto subscription = EvtSubscribe(nullptr,
-                                   nullptr,
+                                   d_->signal,
                                    channel_utf16.c_str(),
                                    L"*",
                                    nullptr,
-                                   this,
-                                   EvtSubscriptionCallbackDispatcher,
+                                   nullptr,
+                                   nullptr,
                                    EvtSubscribeToFutureEvents);
 
   if (subscription == nullptr) {
@@ -116,49 +161,78 @@ EvtSubscription::EvtSubscription(const std::string& channel)
   d_->handle = subscription;
 }
 
-void EvtSubscription::processEvent(EVT_HANDLE event) {
-  DWORD buffer_size{0U};
-  DWORD property_count{0U};
+bool EvtSubscription::render(EVT_HANDLE context,
+                             EVT_HANDLE event,
+                             DWORD flags,
+                             DWORD& property_count) {
+  auto& buffer = d_->render_buffer;
+
+  DWORD buffer_used{0U};
+  if (EvtRender(context,
+                event,
+                flags,
+                static_cast<DWORD>(buffer.size()),
+                buffer.data(),
+                &buffer_used,
+                &property_count)) {
+    return true;
+  }
 
-  if (!EvtRender(nullptr,
-                 event,
-                 EvtRenderEventXml,
-                 0U,
-                 nullptr,
-                 &buffer_size,
-                 &property_count)) {
-    auto error = GetLastError();
+  if (GetLastError() != ERROR_INSUFFICIENT_BUFFER) {
+    return false;
+  }
+
+  buffer.resize(buffer_used);
+  return EvtRender(context,
+                   event,
+                   flags,
+                   static_cast<DWORD>(buffer.size()),
+                   buffer.data(),
+                   &buffer_used,
+                   &property_count) != FALSE;
+}
 
-    if (error != ERROR_INSUFFICIENT_BUFFER) {
-      LOG(ERROR) << "Failed to allocated the necessary memory to handle an "
-                    "event for channel "
-                 << d_->channel;
+void EvtSubscription::processEvent(EventList& event_list, EVT_HANDLE event) {
+  Event output;
+  DWORD property_count{0U};
 
+  if (d_->system_context == nullptr) {
+    if (!render(nullptr, event, EvtRenderEventXml, property_count)) {
+      LOG(ERROR) << "Failed to process an event for channel " << d_->channel
+                 << ". Error: " << GetLastError();
       return;
     }
+
+    output.xml = reinterpret_cast<const wchar_t*>(d_->render_buffer.data());
+    event_list.push_back(std::move(output));
+    return;
   }
 
-  std::wstring buffer(buffer_size / 2U, L'\0');
-  if (!EvtRender(nullptr,
-                 event,
-                 EvtRenderEventXml,
-                 buffer_size,
-                 &buffer[0],
-                 &buffer_size,
-                 &property_count)) {
-    auto error = GetLastError();
+  // The values point within the render buffer, the system values are
+  // converted before the buffer is reused for the user values
+  if (!render(
+          d_->system_context, event, EvtRenderEventValues, property_count)) {
+    LOG(ERROR) << "Failed to render the system values of an event for channel "
+               << d_->channel << ". Error: " << GetLastError();
+    return;
+  }
 
-    LOG(ERROR) << "Failed to process an event for channel " << d_->channel
-               << ". Error: " << error;
+  parseWindowsEventLogSystemValues(
+      output.object,
+      reinterpret_cast<const EVT_VARIANT*>(d_->render_buffer.data()),
+      property_count);
 
+  if (!render(d_->user_context, event, EvtRenderEventValues, property_count)) {
+    LOG(ERROR) << "Failed to render the user values of an event for channel "
+               << d_->channel << ". Error: " << GetLastError();
     return;
   }
 
-  {
-    std::lock_guard<std::mutex> lock(d_->event_list_mutex);
-    d_->event_list.push_back(std::move(buffer));
-  }
+  parseWindowsEventLogUserValues(
+      output.object,
+      reinterpret_cast<const EVT_VARIANT*>(d_->render_buffer.data()),
+      property_count);
 
-  d_->event_list_cv.notify_one();
+  event_list.push_back(std::move(output));
 }
 } // namespace osquery
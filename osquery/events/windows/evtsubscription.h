@@ -13,25 +13,44 @@
 #include <string>
 #include <vector>
 
+#include <boost/property_tree/ptree.hpp>
+
 #include <osquery/utils/status/status.h>
 
 #include <windows.h>
 #include <winevt.h>
 
 namespace osquery {
-DWORD WINAPI EvtSubscriptionCallbackDispatcher(
-    EVT_SUBSCRIBE_NOTIFY_ACTION action, PVOID context, EVT_HANDLE event);
-
 class EvtSubscription final {
  public:
   using Ref = std::unique_ptr<EvtSubscription>;
-  using Event = std::wstring;
+
+  /// An event rendered as XML, or as values already in its property tree.
+  struct Event final {
+    /// The XML rendering, empty when the event was rendered as values.
+    std::wstring xml;
+
+    /// The property tree of an event rendered as values.
+    boost::property_tree::ptree object;
+  };
+
   using EventList = std::vector<Event>;
 
-  static Status create(Ref& obj, const std::string& channel);
+  /**
+   * @brief Subscribe to the future events of a channel.
+   *
+   * @param render_values Render the system properties and the event data as
+   * values rather than XML. The event data is then an array without the
+   * names of the values.
+   */
+  static Status create(Ref& obj,
+                       const std::string& channel,
+                       bool render_values = false);
   ~EvtSubscription();
 
   const std::string channel() const;
+
+  /// Read the available events in batches, waiting up to a second for one.
   EventList getEvents();
 
   EvtSubscription(const EvtSubscription&) = delete;
@@ -41,10 +60,13 @@ class EvtSubscription final {
   struct PrivateData;
   std::unique_ptr<PrivateData> d_;
 
-  EvtSubscription(const std::string& channel);
-  void processEvent(EVT_HANDLE event);
+  EvtSubscription(const std::string& channel, bool render_values);
+  void processEvent(EventList& event_list, EVT_HANDLE event);
 
-  friend DWORD WINAPI EvtSubscriptionCallbackDispatcher(
-      EVT_SUBSCRIBE_NOTIFY_ACTION action, PVOID context, EVT_HANDLE event);
+  /// Render an event into the render buffer, growing it as needed.
+  bool render(EVT_HANDLE context,
+              EVT_HANDLE event,
+              DWORD flags,
+              DWORD& property_count);
 };
 } // namespace osquery
@@ -18,6 +18,7 @@
 #include <osquery/core/flags.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
+#include <osquery/numeric_monitoring/numeric_monitoring.h>
 #include <osquery/registry/registry_factory.h>
 #include <osquery/utils/conversions/windows/strings.h>
 #include <osquery/utils/system/errno.h>
@@ -37,6 +38,16 @@ HIDDEN_FLAG(bool,
             false,
             "Debug the NTFS event publisher");
 
+FLAG(uint64,
+     ntfs_event_publisher_frn_cache_max,
+     20000,
+     "Most directory paths cached to resolve NTFS journal records");
+
+FLAG(bool,
+     ntfs_event_publisher_frn_prefetch,
+     false,
+     "Cache the directory paths of monitored volumes when they are added");
+
 REGISTER(NTFSEventPublisher, "event_publisher", "ntfs_event_publisher");
 
 namespace {
@@ -61,8 +72,279 @@ std::ostream& operator<<(std::ostream& stream, const NTFSEventRecord& event) {
   stream.flags(original_stream_settings);
   return stream;
 };
+
+/// Size of the buffer receiving master file table records.
+const size_t kMFTEnumBufferSize = 64U * 1024U;
+
+/// Parent FRNs followed to build a path, protects against cycles.
+const size_t kMaxDirectoryDepth = 256U;
+
+/// Pre-warms the path cache with the directories of a volume.
+class FRNPathCachePrefetcher final : public InternalRunnable {
+ public:
+  FRNPathCachePrefetcher(FRNPathCacheRef cache,
+                         char drive_letter,
+                         USNFileReferenceNumber root_ref)
+      : InternalRunnable("FRNPathCachePrefetcher"),
+        cache_(std::move(cache)),
+        drive_letter_(drive_letter),
+        root_ref_(std::move(root_ref)) {}
+
+  void start() override {
+    auto status = prefetchDirectoryPaths(*cache_, drive_letter_, root_ref_);
+    if (!status.ok()) {
+      VLOG(1) << "Failed to prefetch the directory paths of volume "
+              << drive_letter_ << ": " << status.getMessage();
+    }
+  }
+
+ private:
+  FRNPathCacheRef cache_;
+  char drive_letter_{0U};
+  USNFileReferenceNumber root_ref_;
+};
 } // namespace
 
+std::size_t FRNPathCache::KeyHash::operator()(const Key& key) const {
+  auto hash = std::hash<USNFileReferenceNumber>()(key.second);
+  boost::hash_combine(hash, key.first);
+  return hash;
+}
+
+bool FRNPathCache::get(std::string& path,
+                       char drive_letter,
+                       const USNFileReferenceNumber& ref) {
+  WriteLock lock(mutex_);
+  auto it = entries_.find(Key(drive_letter, ref));
+  if (it == entries_.end()) {
+    misses_++;
+    return false;
+  }
+
+  lru_.splice(lru_.begin(), lru_, it->second);
+  path = it->second->second;
+  hits_++;
+  return true;
+}
+
+void FRNPathCache::put(char drive_letter,
+                       const USNFileReferenceNumber& ref,
+                       const std::string& path) {
+  WriteLock lock(mutex_);
+  Key key(drive_letter, ref);
+  auto it = entries_.find(key);
+  if (it != entries_.end()) {
+    it->second->second = path;
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return;
+  }
+
+  lru_.emplace_front(key, path);
+  entries_.emplace(std::move(key), lru_.begin());
+  evict();
+}
+
+void FRNPathCache::rename(char drive_letter,
+                          const USNFileReferenceNumber& ref,
+                          const std::string& old_path,
+                          const std::string& new_path) {
+  {
+    WriteLock lock(mutex_);
+    auto prefix = old_path + "\\";
+    for (auto& entry : lru_) {
+      if (entry.first.first == drive_letter &&
+          entry.second.compare(0, prefix.size(), prefix) == 0) {
+        entry.second = new_path + "\\" + entry.second.substr(prefix.size());
+      }
+    }
+  }
+  put(drive_letter, ref, new_path);
+}
+
+void FRNPathCache::erase(char drive_letter, const USNFileReferenceNumber& ref) {
+  WriteLock lock(mutex_);
+  auto it = entries_.find(Key(drive_letter, ref));
+  if (it != entries_.end()) {
+    lru_.erase(it->second);
+    entries_.erase(it);
+  }
+}
+
+void FRNPathCache::setCapacity(size_t capacity) {
+  WriteLock lock(mutex_);
+  capacity_ = capacity;
+  evict();
+}
+
+size_t FRNPathCache::capacity() const {
+  ReadLock lock(mutex_);
+  return capacity_;
+}
+
+size_t FRNPathCache::size() const {
+  ReadLock lock(mutex_);
+  return entries_.size();
+}
+
+std::pair<size_t, size_t> FRNPathCache::takeStats() {
+  return {hits_.exchange(0), misses_.exchange(0)};
+}
+
+void FRNPathCache::evict() {
+  while (entries_.size() > capacity_) {
+    entries_.erase(lru_.back().first);
+    lru_.pop_back();
+  }
+}
+
+Status prefetchDirectoryPaths(FRNPathCache& cache,
+                              char drive_letter,
+                              const USNFileReferenceNumber& root_ref) {
+  auto volume_path = std::string("\\\\.\\") + drive_letter + ":";
+  auto volume_handle =
+      ::CreateFileW(stringToWstring(volume_path).c_str(),
+                    GENERIC_READ,
+                    FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                    nullptr,
+                    OPEN_EXISTING,
+                    FILE_FLAG_BACKUP_SEMANTICS,
+                    nullptr);
+
+  if (volume_handle == INVALID_HANDLE_VALUE) {
+    return Status::failure("Failed to open the following drive: " +
+                           volume_path);
+  }
+
+  // Collect the name and parent of every directory in the volume.
+  struct Directory {
+    USNFileReferenceNumber parent;
+    std::string name;
+  };
+  std::unordered_map<USNFileReferenceNumber, Directory> directories;
+
+  // Request the same record versions as the journal reader, so the FRNs
+  // have the same format.
+  MFT_ENUM_DATA_V1 enum_data = {};
+  enum_data.StartFileReferenceNumber = 0U;
+  enum_data.LowUsn = 0;
+  enum_data.HighUsn = MAXLONGLONG;
+  enum_data.MinMajorVersion = 2U;
+  enum_data.MaxMajorVersion = 3U;
+
+  std::vector<std::uint8_t> buffer(kMFTEnumBufferSize);
+  for (;;) {
+    DWORD bytes_read = 0U;
+    if (!::DeviceIoControl(volume_handle,
+                           FSCTL_ENUM_USN_DATA,
+                           &enum_data,
+                           sizeof(enum_data),
+                           buffer.data(),
+                           static_cast<DWORD>(buffer.size()),
+                           &bytes_read,
+                           nullptr)) {
+      auto error_code = ::GetLastError();
+      if (error_code == ERROR_HANDLE_EOF) {
+        break;
+      }
+
+      ::CloseHandle(volume_handle);
+
+      std::wstring description;
+      if (!getWindowsErrorDescription(description, error_code)) {
+        description = L"Unknown error";
+      }
+      return Status::failure("Failed to enumerate the master file table: " +
+                             wstringToString(description));
+    }
+
+    if (bytes_read <= sizeof(DWORDLONG)) {
+      break;
+    }
+
+    // The output starts with the FRN the next enumeration starts from.
+    enum_data.StartFileReferenceNumber =
+        *reinterpret_cast<const DWORDLONG*>(buffer.data());
+
+    size_t offset = sizeof(DWORDLONG);
+    while (offset + sizeof(USN_RECORD_COMMON_HEADER) <= bytes_read) {
+      auto record = reinterpret_cast<const USN_RECORD*>(buffer.data() + offset);
+      if (record->RecordLength == 0U ||
+          offset + record->RecordLength > bytes_read) {
+        break;
+      }
+      offset += record->RecordLength;
+
+      DWORD attributes = 0U;
+      if (!USNParsers::GetAttributes(attributes, record) ||
+          (attributes & FILE_ATTRIBUTE_DIRECTORY) == 0U) {
+        continue;
+      }
+
+      USNFileReferenceNumber ref;
+      Directory directory;
+      if (!USNParsers::GetFileReferenceNumber(ref, record) ||
+          !USNParsers::GetParentFileReferenceNumber(directory.parent,
+                                                    record) ||
+          !USNParsers::GetEventString(directory.name, record)) {
+        continue;
+      }
+      directories.emplace(std::move(ref), std::move(directory));
+    }
+  }
+
+  ::CloseHandle(volume_handle);
+
+  // Build each path from the closest known parent, parents are added first.
+  std::unordered_map<USNFileReferenceNumber, std::string> paths;
+  paths[root_ref] = std::string(1, drive_letter) + ":\\";
+
+  auto capacity = cache.capacity();
+  size_t added = 0U;
+  for (const auto& directory : directories) {
+    if (added >= capacity) {
+      break;
+    }
+
+    std::vector<const USNFileReferenceNumber*> chain;
+    const USNFileReferenceNumber* current = &directory.first;
+    const std::string* base = nullptr;
+    while (chain.size() < kMaxDirectoryDepth) {
+      auto known = paths.find(*current);
+      if (known != paths.end()) {
+        base = &known->second;
+        break;
+      }
+
+      auto parent = directories.find(*current);
+      if (parent == directories.end()) {
+        break;
+      }
+      chain.push_back(current);
+      current = &parent->second.parent;
+    }
+
+    // Directories not below the root folder, such as orphans, are skipped.
+    if (base == nullptr) {
+      continue;
+    }
+
+    auto path = *base;
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+      if (path.back() != '\\') {
+        path.push_back('\\');
+      }
+      path.append(directories.at(**it).name);
+      paths[**it] = path;
+      cache.put(drive_letter, **it, path);
+      added++;
+    }
+  }
+
+  VLOG(1) << "Prefetched " << added << " directory paths of volume "
+          << drive_letter << ":";
+  return Status::success();
+}
+
 /// Private class data
 struct NTFSEventPublisher::PrivateData final {
   /// Each reader service instance is mapped to the drive letter it is
@@ -77,6 +359,9 @@ struct NTFSEventPublisher::PrivateData final {
 
   /// This mutex protects the volume data map
   Mutex volume_data_map_mutex;
+
+  /// Directory paths of every volume, used to resolve parent FRNs
+  FRNPathCacheRef path_cache{std::make_shared<FRNPathCache>(0U)};
 };
 
 void NTFSEventPublisher::restartJournalReaderServices(
@@ -104,6 +389,14 @@ void NTFSEventPublisher::restartJournalReaderServices(
     d_->reader_service_map.insert({drive_letter, instance});
 
     Dispatcher::addService(service);
+
+    if (FLAGS_ntfs_event_publisher_frn_prefetch) {
+      VolumeData volume_data = {};
+      if (getVolumeData(volume_data, drive_letter).ok()) {
+        Dispatcher::addService(std::make_shared<FRNPathCachePrefetcher>(
+            d_->path_cache, drive_letter, volume_data.root_ref));
+      }
+    }
   }
 
   // Terminate the ones we no longer need
@@ -286,25 +579,24 @@ Status NTFSEventPublisher::getPathFromReferenceNumber(
 
 Status NTFSEventPublisher::getPathFromParentFRN(
     std::string& path,
-    ParentFRNCache& parent_frn_cache,
     char drive_letter,
     const std::string& basename,
     const USNFileReferenceNumber& ref) {
-  auto& it = parent_frn_cache.find(ref);
-
-  if (it == parent_frn_cache.end()) {
+  if (!d_->path_cache->get(path, drive_letter, ref)) {
     Status status = getPathFromReferenceNumber(path, drive_letter, ref);
 
     if (!status.ok()) {
       return status;
     }
 
-    parent_frn_cache[ref] = path;
-  } else {
-    path = it->second;
+    d_->path_cache->put(drive_letter, ref, path);
   }
 
-  path.append("\\" + basename);
+  // The root folder path already ends with a separator
+  if (path.empty() || path.back() != '\\') {
+    path.push_back('\\');
+  }
+  path.append(basename);
 
   return Status::success();
 }
@@ -446,6 +738,7 @@ Status NTFSEventPublisher::setUp() {
     return Status::failure("NTFS event publisher disabled via configuration");
   }
 
+  d_->path_cache->setCapacity(FLAGS_ntfs_event_publisher_frn_cache_max);
   return Status::success();
 }
 
@@ -482,7 +775,6 @@ Status NTFSEventPublisher::run() {
 
     auto& service_instance = service_it->second;
 
-    auto& parent_frn_cache = service_instance.parent_frn_cache;
     auto& rename_path_mapper = service_instance.rename_path_mapper;
 
     // Track rename records so that we can merge them into a single event
@@ -499,19 +791,7 @@ Status NTFSEventPublisher::run() {
       break;
     }
 
-    case USNJournalEventRecord::Type::DirectoryRename_NewName: {
-      // If we're renaming a directory, update the parent FRN cache.
-      std::string dir;
-      auto status = getPathFromReferenceNumber(
-          dir, journal_record.drive_letter, journal_record.node_ref_number);
-
-      if (!status.ok()) {
-        TLOG << "Failed to get directory for parent FRN cache update";
-      } else {
-        parent_frn_cache[journal_record.node_ref_number] = dir;
-      }
-      // Intentional fallthrough.
-    }
+    case USNJournalEventRecord::Type::DirectoryRename_NewName:
     case USNJournalEventRecord::Type::FileRename_NewName: {
       auto it = rename_path_mapper.find(journal_record.node_ref_number);
       if (it == rename_path_mapper.end()) {
@@ -532,26 +812,24 @@ Status NTFSEventPublisher::run() {
     // Generate the new event
     NTFSEventRecord event(journal_record);
 
-    // TODO(woodruffw): This is failing occasionally for files that do exist
-    // on disk, but only on the first call to look them up. I'm not
-    // sure why yet, but falling back on the parent FRN cache and
-    // building the path from it works for now.
+    // The parent folder path is usually cached, which avoids opening the
+    // file. Opening the file by its FRN is the fallback, it also fails
+    // occasionally for files that do exist on disk.
     // See https://github.com/osquery/osquery/issues/5848
-    auto status = getPathFromReferenceNumber(event.path,
-                                             journal_record.drive_letter,
-                                             journal_record.node_ref_number);
+    auto status = getPathFromParentFRN(event.path,
+                                       journal_record.drive_letter,
+                                       journal_record.name,
+                                       journal_record.parent_ref_number);
     if (!status.ok()) {
-      TLOG << "FRN pathname lookup failed, trying parent: "
-           << status.getMessage();
+      VLOG(1) << "Parent FRN lookup failed, trying the FRN: "
+              << status.getMessage();
 
-      status = getPathFromParentFRN(event.path,
-                                    parent_frn_cache,
-                                    journal_record.drive_letter,
-                                    journal_record.name,
-                                    journal_record.parent_ref_number);
+      status = getPathFromReferenceNumber(event.path,
+                                          journal_record.drive_letter,
+                                          journal_record.node_ref_number);
 
       if (!status.ok()) {
-        VLOG(1) << "Parent FRN lookup failed: " << status.getMessage();
+        VLOG(1) << "FRN pathname lookup failed: " << status.getMessage();
 
         event.path = journal_record.name;
         event.partial = true;
@@ -560,7 +838,6 @@ Status NTFSEventPublisher::run() {
 
     if (old_name_record.drive_letter != 0U) {
       status = getPathFromParentFRN(event.old_path,
-                                    parent_frn_cache,
                                     old_name_record.drive_letter,
                                     old_name_record.name,
                                     old_name_record.parent_ref_number);
@@ -570,6 +847,20 @@ Status NTFSEventPublisher::run() {
       }
     }
 
+    // Keep the cached paths of directories, and their subdirectories, current
+    if (journal_record.type ==
+            USNJournalEventRecord::Type::DirectoryRename_NewName &&
+        !event.partial) {
+      d_->path_cache->rename(journal_record.drive_letter,
+                             journal_record.node_ref_number,
+                             event.old_path,
+                             event.path);
+    } else if (journal_record.type ==
+               USNJournalEventRecord::Type::DirectoryDeletion) {
+      d_->path_cache->erase(journal_record.drive_letter,
+                            journal_record.node_ref_number);
+    }
+
     if (FLAGS_ntfs_event_publisher_debug) {
       TLOG << "NTFSEventPublisher event: " << event;
     }
@@ -577,13 +868,10 @@ Status NTFSEventPublisher::run() {
     event_context->event_list.push_back(std::move(event));
   }
 
-  // Put a limit on the size of the caches we are using
-  // NOTE(woodruffw): We could also try to incrementally free up
-  // the parent FRN cache by tracking DirectoryDeletions.
+  // Put a limit on the size of the rename map, the path cache is bounded
   for (auto& p : d_->reader_service_map) {
     auto& service_instance = p.second;
 
-    auto& parent_frn_cache = service_instance.parent_frn_cache;
     auto& rename_path_mapper = service_instance.rename_path_mapper;
 
     if (rename_path_mapper.size() >= 2000U) {
@@ -592,15 +880,24 @@ Status NTFSEventPublisher::run() {
 
       rename_path_mapper.erase(range_start, range_end);
     }
-
-    if (parent_frn_cache.size() >= 2000U) {
-      auto range_start = parent_frn_cache.begin();
-      auto range_end = std::next(range_start, 1000U);
-
-      parent_frn_cache.erase(range_start, range_end);
-    }
   }
 
+  static const monitoring::Metric kPathCacheHits(
+      "ntfs_event_publisher.frn_cache.hits",
+      monitoring::PreAggregationType::Sum);
+  static const monitoring::Metric kPathCacheMisses(
+      "ntfs_event_publisher.frn_cache.misses",
+      monitoring::PreAggregationType::Sum);
+  static const monitoring::Metric kPathCacheSize(
+      "ntfs_event_publisher.frn_cache.size",
+      monitoring::PreAggregationType::Max);
+
+  auto stats = d_->path_cache->takeStats();
+  kPathCacheHits.record(static_cast<monitoring::ValueType>(stats.first));
+  kPathCacheMisses.record(static_cast<monitoring::ValueType>(stats.second));
+  kPathCacheSize.record(
+      static_cast<monitoring::ValueType>(d_->path_cache->size()));
+
   fire(event_context);
 
   return Status::success();
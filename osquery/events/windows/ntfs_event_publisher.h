@@ -12,12 +12,15 @@
 #include <atomic>
 #include <cstdint>
 #include <limits>
+#include <list>
 #include <map>
 #include <memory>
+#include <unordered_map>
 #include <unordered_set>
 
 #include "osquery/events/windows/usn_journal_reader.h"
 #include <osquery/events/eventpublisher.h>
+#include <osquery/utils/mutex.h>
 
 namespace osquery {
 /// The subscription context contains the list of paths the subscriber is
@@ -116,8 +119,86 @@ struct NTFSEventContext final : public EventContext {
 
 using NTFSEventContextRef = std::shared_ptr<NTFSEventContext>;
 
-/// The ParentFRNCache maps parent FRNs to directory names
-using ParentFRNCache = std::unordered_map<USNFileReferenceNumber, std::string>;
+/**
+ * @brief A bounded cache of directory paths, by volume and FRN.
+ *
+ * The cache is shared by every volume. Once full the least recently used
+ * path is evicted. Lookup hits and misses are counted for monitoring.
+ */
+class FRNPathCache final {
+ public:
+  explicit FRNPathCache(size_t capacity) : capacity_(capacity) {}
+
+  /// Find the path of a directory, marking it as recently used.
+  bool get(std::string& path,
+           char drive_letter,
+           const USNFileReferenceNumber& ref);
+
+  /// Add or replace the path of a directory.
+  void put(char drive_letter,
+           const USNFileReferenceNumber& ref,
+           const std::string& path);
+
+  /// Replace the path of a renamed directory and of the directories below it.
+  void rename(char drive_letter,
+              const USNFileReferenceNumber& ref,
+              const std::string& old_path,
+              const std::string& new_path);
+
+  /// Remove the path of a deleted directory.
+  void erase(char drive_letter, const USNFileReferenceNumber& ref);
+
+  /// Change the capacity, evicting paths if needed.
+  void setCapacity(size_t capacity);
+
+  size_t capacity() const;
+
+  size_t size() const;
+
+  /// Return and reset the hits and misses counted since the last call.
+  std::pair<size_t, size_t> takeStats();
+
+ private:
+  using Key = std::pair<char, USNFileReferenceNumber>;
+
+  struct KeyHash {
+    std::size_t operator()(const Key& key) const;
+  };
+
+  using Entry = std::pair<Key, std::string>;
+
+  /// Evict the least recently used paths above the capacity.
+  void evict();
+
+  /// Paths, the most recently used first.
+  std::list<Entry> lru_;
+
+  std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> entries_;
+
+  size_t capacity_{0};
+
+  std::atomic<size_t> hits_{0};
+
+  std::atomic<size_t> misses_{0};
+
+  mutable Mutex mutex_;
+};
+
+using FRNPathCacheRef = std::shared_ptr<FRNPathCache>;
+
+/**
+ * @brief Pre-warm a path cache with the directories of a volume.
+ *
+ * The master file table is enumerated with FSCTL_ENUM_USN_DATA, and the
+ * paths of directories are built from their names and parent FRNs.
+ *
+ * @param cache receives up to its capacity of directory paths.
+ * @param drive_letter the volume to enumerate.
+ * @param root_ref the FRN of the volume's root folder.
+ */
+Status prefetchDirectoryPaths(FRNPathCache& cache,
+                              char drive_letter,
+                              const USNFileReferenceNumber& root_ref);
 
 /// This structure describes a running USNJournalReader instance
 struct USNJournalReaderInstance final {
@@ -127,9 +208,6 @@ struct USNJournalReaderInstance final {
   /// The shared context
   USNJournalReaderContextRef context;
 
-  /// This cache contains a mapping from parent FRN to directory name.
-  ParentFRNCache parent_frn_cache;
-
   /// This map is used to merge the rename records (old name and new name) into
   /// a single event. It is ordered so that we can delete data starting from the
   /// oldest entries
@@ -170,7 +248,6 @@ class NTFSEventPublisher final
 
   /// Attempts to get the full path for `basename` via its parent FRN.
   Status getPathFromParentFRN(std::string& path,
-                              ParentFRNCache& parent_frn_cache,
                               char drive_letter,
                               const std::string& basename,
                               const USNFileReferenceNumber& ref);
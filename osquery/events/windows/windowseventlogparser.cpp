@@ -7,6 +7,8 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <cstdio>
+#include <iomanip>
 #include <sstream>
 
 #include <boost/algorithm/string.hpp>
@@ -18,10 +20,140 @@
 #include <osquery/logger/logger.h>
 #include <osquery/utils/conversions/windows/strings.h>
 
+#include <sddl.h>
+
 namespace pt = boost::property_tree;
 
 namespace osquery {
 
+// Formatted as the XML rendering of the events formats them
+static std::string formatEventGuid(const GUID& guid) {
+  char buffer[39]{};
+  std::snprintf(buffer,
+                sizeof(buffer),
+                "{%08lx-%04x-%04x-%02x%02x-%02x%02x%02x%02x%02x%02x}",
+                static_cast<unsigned long>(guid.Data1),
+                static_cast<unsigned>(guid.Data2),
+                static_cast<unsigned>(guid.Data3),
+                static_cast<unsigned>(guid.Data4[0]),
+                static_cast<unsigned>(guid.Data4[1]),
+                static_cast<unsigned>(guid.Data4[2]),
+                static_cast<unsigned>(guid.Data4[3]),
+                static_cast<unsigned>(guid.Data4[4]),
+                static_cast<unsigned>(guid.Data4[5]),
+                static_cast<unsigned>(guid.Data4[6]),
+                static_cast<unsigned>(guid.Data4[7]));
+  return buffer;
+}
+
+static std::string formatEventTime(const SYSTEMTIME& time,
+                                   ULONGLONG fraction) {
+  char buffer[32]{};
+  std::snprintf(buffer,
+                sizeof(buffer),
+                "%04u-%02u-%02uT%02u:%02u:%02u.%07lluZ",
+                static_cast<unsigned>(time.wYear),
+                static_cast<unsigned>(time.wMonth),
+                static_cast<unsigned>(time.wDay),
+                static_cast<unsigned>(time.wHour),
+                static_cast<unsigned>(time.wMinute),
+                static_cast<unsigned>(time.wSecond),
+                fraction);
+  return buffer;
+}
+
+static std::string formatEventFileTime(ULONGLONG file_time) {
+  FILETIME ft;
+  ft.dwLowDateTime = static_cast<DWORD>(file_time);
+  ft.dwHighDateTime = static_cast<DWORD>(file_time >> 32);
+
+  SYSTEMTIME time;
+  if (!FileTimeToSystemTime(&ft, &time)) {
+    return "";
+  }
+
+  // FILETIME counts 100 nanosecond intervals
+  return formatEventTime(time, file_time % 10000000ULL);
+}
+
+template <typename T>
+static std::string formatEventHex(T value) {
+  std::stringstream stream;
+  stream << "0x" << std::hex << value;
+  return stream.str();
+}
+
+static std::string formatEventValue(const EVT_VARIANT& value) {
+  if ((value.Type & EVT_VARIANT_TYPE_ARRAY) != 0) {
+    return "";
+  }
+
+  switch (value.Type & EVT_VARIANT_TYPE_MASK) {
+  case EvtVarTypeString:
+    return value.StringVal != nullptr ? wstringToString(value.StringVal) : "";
+  case EvtVarTypeAnsiString:
+    return value.AnsiStringVal != nullptr ? value.AnsiStringVal : "";
+  case EvtVarTypeSByte:
+    return std::to_string(value.SByteVal);
+  case EvtVarTypeByte:
+    return std::to_string(value.ByteVal);
+  case EvtVarTypeInt16:
+    return std::to_string(value.Int16Val);
+  case EvtVarTypeUInt16:
+    return std::to_string(value.UInt16Val);
+  case EvtVarTypeInt32:
+    return std::to_string(value.Int32Val);
+  case EvtVarTypeUInt32:
+    return std::to_string(value.UInt32Val);
+  case EvtVarTypeInt64:
+    return std::to_string(value.Int64Val);
+  case EvtVarTypeUInt64:
+    return std::to_string(value.UInt64Val);
+  case EvtVarTypeSingle:
+    return std::to_string(value.SingleVal);
+  case EvtVarTypeDouble:
+    return std::to_string(value.DoubleVal);
+  case EvtVarTypeBoolean:
+    return value.BooleanVal ? "true" : "false";
+  case EvtVarTypeSizeT:
+    return std::to_string(value.SizeTVal);
+  case EvtVarTypeHexInt32:
+    return formatEventHex(value.UInt32Val);
+  case EvtVarTypeHexInt64:
+    return formatEventHex(value.UInt64Val);
+  case EvtVarTypeGuid:
+    return value.GuidVal != nullptr ? formatEventGuid(*value.GuidVal) : "";
+  case EvtVarTypeFileTime:
+    return formatEventFileTime(value.FileTimeVal);
+  case EvtVarTypeSysTime:
+    return value.SysTimeVal != nullptr
+               ? formatEventTime(*value.SysTimeVal,
+                                 value.SysTimeVal->wMilliseconds * 10000ULL)
+               : "";
+  case EvtVarTypeSid: {
+    LPSTR sid = nullptr;
+    if (value.SidVal == nullptr ||
+        !ConvertSidToStringSidA(value.SidVal, &sid)) {
+      return "";
+    }
+
+    std::string output = sid;
+    LocalFree(sid);
+    return output;
+  }
+  case EvtVarTypeBinary: {
+    std::stringstream stream;
+    stream << std::hex << std::uppercase << std::setfill('0');
+    for (DWORD i = 0U; i < value.Count; ++i) {
+      stream << std::setw(2) << static_cast<unsigned>(value.BinaryVal[i]);
+    }
+    return stream.str();
+  }
+  default:
+    return "";
+  }
+}
+
 static inline pt::ptree parseChildNodeToJSONPtree(
     const pt::ptree& event_data_node) {
   pt::ptree event_data;
@@ -93,6 +225,44 @@ Status parseWindowsEventLogXML(pt::ptree& event_object,
   return Status::success();
 }
 
+void parseWindowsEventLogSystemValues(pt::ptree& event_object,
+                                      const EVT_VARIANT* values,
+                                      DWORD value_count) {
+  auto putValue = [&](EVT_SYSTEM_PROPERTY_ID id, const char* path) -> void {
+    if (static_cast<DWORD>(id) >= value_count ||
+        values[id].Type == EvtVarTypeNull) {
+      return;
+    }
+
+    event_object.put(path, formatEventValue(values[id]));
+  };
+
+  putValue(EvtSystemProviderName, "Event.System.Provider.<xmlattr>.Name");
+  putValue(EvtSystemProviderGuid, "Event.System.Provider.<xmlattr>.Guid");
+  putValue(EvtSystemEventID, "Event.System.EventID");
+  putValue(EvtSystemLevel, "Event.System.Level");
+  putValue(EvtSystemTask, "Event.System.Task");
+  putValue(EvtSystemKeywords, "Event.System.Keywords");
+  putValue(EvtSystemTimeCreated,
+           "Event.System.TimeCreated.<xmlattr>.SystemTime");
+  putValue(EvtSystemProcessID, "Event.System.Execution.<xmlattr>.ProcessID");
+  putValue(EvtSystemThreadID, "Event.System.Execution.<xmlattr>.ThreadID");
+  putValue(EvtSystemChannel, "Event.System.Channel");
+  putValue(EvtSystemComputer, "Event.System.Computer");
+}
+
+void parseWindowsEventLogUserValues(pt::ptree& event_object,
+                                    const EVT_VARIANT* values,
+                                    DWORD value_count) {
+  // Data tags without a Name attribute are output as an array
+  pt::ptree event_data;
+  for (DWORD i = 0U; i < value_count; ++i) {
+    event_data.add("Data", formatEventValue(values[i]));
+  }
+
+  event_object.put_child("Event.EventData", event_data);
+}
+
 Status parseWindowsEventLogPTree(WELEvent& windows_event,
                                  const pt::ptree& event_object) {
   windows_event = {};
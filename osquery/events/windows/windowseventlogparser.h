@@ -15,6 +15,9 @@
 #include <boost/property_tree/json_parser.hpp>
 
 #include <osquery/utils/status/status.h>
+#include <osquery/utils/system/system.h>
+
+#include <winevt.h>
 
 namespace osquery {
 
@@ -41,6 +44,27 @@ struct WELEvent final {
 Status parseWindowsEventLogXML(boost::property_tree::ptree& event_object,
                                const std::wstring& xml_event);
 
+/**
+ * @brief Add the system values rendered for an event to its property tree.
+ *
+ * The values are those of an EvtRenderContextSystem context, they are added
+ * as parseWindowsEventLogXML would add them from the XML of the event.
+ */
+void parseWindowsEventLogSystemValues(
+    boost::property_tree::ptree& event_object,
+    const EVT_VARIANT* values,
+    DWORD value_count);
+
+/**
+ * @brief Add the user values rendered for an event to its property tree.
+ *
+ * The values of an EvtRenderContextUser context have no names, they are
+ * added as the EventData array of the event.
+ */
+void parseWindowsEventLogUserValues(boost::property_tree::ptree& event_object,
+                                    const EVT_VARIANT* values,
+                                    DWORD value_count);
+
 // Utility function to parse the windows event property tree
 Status parseWindowsEventLogPTree(
     WELEvent& windows_event, const boost::property_tree::ptree& event_object);
@@ -63,9 +63,9 @@ void WindowsEventLogParserService::start() {
 
     ChannelEventObjects channel_event_objects = {};
 
-    for (const auto& p : channel_queue) {
+    for (auto& p : channel_queue) {
       const auto& channel = p.first;
-      const auto& raw_event_list = p.second;
+      auto& raw_event_list = p.second;
 
       auto channel_output_it = channel_event_objects.find(channel);
       if (channel_output_it == channel_event_objects.end()) {
@@ -75,9 +75,15 @@ void WindowsEventLogParserService::start() {
 
       auto& channel_output = channel_output_it->second;
 
-      for (const auto& raw_event : raw_event_list) {
+      for (auto& raw_event : raw_event_list) {
+        // Events rendered as values are already converted
+        if (raw_event.xml.empty()) {
+          channel_output.push_back(std::move(raw_event.object));
+          continue;
+        }
+
         boost::property_tree::ptree event_object;
-        auto status = parseWindowsEventLogXML(event_object, raw_event);
+        auto status = parseWindowsEventLogXML(event_object, raw_event.xml);
         if (!status.ok()) {
           LOG(ERROR) << status.getMessage();
           continue;
@@ -7,11 +7,16 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <set>
+
+#include <boost/algorithm/string/case_conv.hpp>
+
 #include <osquery/config/config.h>
 #include <osquery/core/flags.h>
 #include <osquery/events/windows/windowseventlogpublisher.h>
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry_factory.h>
+#include <osquery/utils/conversions/split.h>
 
 #include <plugins/config/parsers/feature_vectors.h>
 
@@ -89,6 +94,11 @@ FLAG(bool,
      false,
      "Enables the Windows events publisher");
 
+FLAG(string,
+     windows_event_render_values,
+     "",
+     "Comma-separated Windows event log channels rendered as values");
+
 REGISTER(WindowsEventLogPublisher,
          "event_publisher",
          "WindowsEventLogPublisher");
@@ -109,6 +119,11 @@ void WindowsEventLogPublisher::configure() {
 
   tearDown();
 
+  std::set<std::string> render_values_channels;
+  for (const auto& channel : split(FLAGS_windows_event_render_values, ",")) {
+    render_values_channels.insert(boost::algorithm::to_lower_copy(channel));
+  }
+
   std::vector<double> character_frequency_map;
   auto status = loadCharacterFrequencyMap(character_frequency_map);
   if (!status.ok()) {
@@ -123,7 +138,10 @@ void WindowsEventLogPublisher::configure() {
     for (const auto& channel : channel_list) {
       EvtSubscription::Ref subscription = {};
 
-      status = EvtSubscription::create(subscription, channel);
+      auto render_values = render_values_channels.count(
+                               boost::algorithm::to_lower_copy(channel)) > 0;
+
+      status = EvtSubscription::create(subscription, channel, render_values);
       if (!status.ok()) {
         auto error = GetLastError();
         LOG(WARNING) << "Failed to subscribe to " << channel << ": " << error;
@@ -153,7 +171,8 @@ Status WindowsEventLogPublisher::run() {
       auto event_list = subscription->getEvents();
 
       if (!event_list.empty()) {
-        d_->parser_service->addEventList(subscription->channel(), event_list);
+        d_->parser_service->addEventList(subscription->channel(),
+                                         std::move(event_list));
       }
     }
 
@@ -7,12 +7,27 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
 #include <map>
+#include <mutex>
 #include <set>
 #include <string>
 #include <tuple>
 #include <vector>
 
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstring>
+#endif
+
 #include <boost/algorithm/string/trim.hpp>
 #include <boost/optional.hpp>
 
@@ -24,6 +39,7 @@
 #include <osquery/filesystem/fileops.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
+#include <osquery/numeric_monitoring/numeric_monitoring.h>
 #include <osquery/process/process.h>
 #include <osquery/registry/registry.h>
 #include <osquery/sql/sql.h>
@@ -44,6 +60,8 @@ enum class ExtendableType {
 
 using ExtendableTypeSet = std::map<ExtendableType, std::set<std::string>>;
 
+DECLARE_string(extensions_timeout);
+
 namespace {
 
 /// Map of acceptable file extensions for extension binaries.
@@ -57,6 +75,251 @@ const std::map<PlatformType, ExtendableTypeSet> kFileExtensions{
 /// Millisecond latency between initializing manager pings.
 const size_t kExtensionInitializeLatency{20};
 
+/// Intervals between the pings of a process whose exit is notified.
+const size_t kExtensionNotifiedPingIntervals{10};
+
+/// Milliseconds to wait for autoloaded extensions, at least 10 latencies.
+std::chrono::milliseconds getExtensionTimeout() {
+  size_t timeout = atoi(FLAGS_extensions_timeout.c_str()) * 1000;
+  if (timeout < kExtensionInitializeLatency * 10) {
+    timeout = kExtensionInitializeLatency * 10;
+  }
+  return std::chrono::milliseconds(timeout);
+}
+
+/// Signals the extensions registering with the manager of this process.
+class ExtensionRegistrations : private boost::noncopyable {
+ public:
+  void notify() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      generation_++;
+    }
+    cv_.notify_all();
+  }
+
+  /// The count of registrations, to wait for the next one.
+  size_t generation() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return generation_;
+  }
+
+  /// Wait up to a timeout for a registration after generation.
+  void waitFor(size_t generation, std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait_for(lock, timeout, [&] { return generation_ != generation; });
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  size_t generation_{0};
+};
+
+ExtensionRegistrations& getExtensionRegistrations() {
+  static ExtensionRegistrations registrations;
+  return registrations;
+}
+
+/**
+ * @brief Notifies the exit of the processes serving extension sockets.
+ *
+ * A Linux pidfd becomes readable when its process exits, so a watcher polls
+ * the pidfds of the processes instead of pinging each one on every interval.
+ * The process is the peer of a connection to its socket. Other platforms,
+ * kernels without pidfd_open, and peers in another pid namespace cannot be
+ * watched and are pinged.
+ */
+class ExtensionExitNotifier : private boost::noncopyable {
+ public:
+  ExtensionExitNotifier() {
+#ifdef __linux__
+    wake_fd_ = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+#endif
+  }
+
+  ~ExtensionExitNotifier() {
+#ifdef __linux__
+    for (const auto& pidfd : pidfds_) {
+      ::close(pidfd.second);
+    }
+    if (wake_fd_ >= 0) {
+      ::close(wake_fd_);
+    }
+#endif
+  }
+
+  /// Watch the process serving a socket, false if it cannot be watched.
+  bool watch(RouteUUID uuid, const std::string& path) {
+#if defined(__linux__) && defined(SYS_pidfd_open)
+    if (wake_fd_ < 0 || watching(uuid)) {
+      return watching(uuid);
+    }
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+      return false;
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size());
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+      return false;
+    }
+
+    // The credentials of a connected peer are those of its listen call.
+    struct ucred cred {};
+    socklen_t length = sizeof(cred);
+    auto connected =
+        ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0 &&
+        ::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &length) == 0;
+    ::close(fd);
+    if (!connected || cred.pid <= 0) {
+      return false;
+    }
+
+    int pidfd = static_cast<int>(::syscall(SYS_pidfd_open, cred.pid, 0));
+    if (pidfd < 0) {
+      return false;
+    }
+    pidfds_[uuid] = pidfd;
+    return true;
+#else
+    static_cast<void>(uuid);
+    static_cast<void>(path);
+    return false;
+#endif
+  }
+
+  bool watching(RouteUUID uuid) const {
+    return pidfds_.count(uuid) > 0;
+  }
+
+  /// No process is watched, a watcher pauses instead of waiting.
+  bool empty() const {
+    return pidfds_.empty();
+  }
+
+  void forget(RouteUUID uuid) {
+    auto pidfd = pidfds_.find(uuid);
+    if (pidfd == pidfds_.end()) {
+      return;
+    }
+#ifdef __linux__
+    ::close(pidfd->second);
+#endif
+    pidfds_.erase(pidfd);
+  }
+
+  /**
+   * @brief Wait up to a timeout for watched processes to exit.
+   *
+   * @return the watched uuids whose process exited, empty after the timeout
+   * or a wake.
+   */
+  std::vector<RouteUUID> wait(std::chrono::milliseconds timeout) {
+    std::vector<RouteUUID> exited;
+#ifdef __linux__
+    std::vector<pollfd> fds;
+    std::vector<RouteUUID> uuids;
+    fds.push_back({wake_fd_, POLLIN, 0});
+    for (const auto& pidfd : pidfds_) {
+      fds.push_back({pidfd.second, POLLIN, 0});
+      uuids.push_back(pidfd.first);
+    }
+
+    if (::poll(fds.data(), fds.size(), static_cast<int>(timeout.count())) <=
+        0) {
+      return exited;
+    }
+
+    if (fds[0].revents != 0) {
+      uint64_t wakes = 0;
+      auto bytes = ::read(wake_fd_, &wakes, sizeof(wakes));
+      static_cast<void>(bytes);
+    }
+    for (size_t i = 1; i < fds.size(); i++) {
+      if (fds[i].revents != 0) {
+        exited.push_back(uuids[i - 1]);
+      }
+    }
+#else
+    static_cast<void>(timeout);
+#endif
+    return exited;
+  }
+
+  /// Wake a waiting thread, it is safe to call from any thread.
+  void wake() {
+#ifdef __linux__
+    if (wake_fd_ >= 0) {
+      uint64_t wakes = 1;
+      auto bytes = ::write(wake_fd_, &wakes, sizeof(wakes));
+      static_cast<void>(bytes);
+    }
+#endif
+  }
+
+ private:
+  /// The pidfds of the watched processes, by the uuid of their socket.
+  std::map<RouteUUID, int> pidfds_;
+
+  /// An eventfd written to wake a waiting thread.
+  int wake_fd_{-1};
+};
+
+/// Ping the process serving an extension or extension manager socket.
+Status pingExtensionSocket(const std::string& path) {
+  if (!socketExists(path).ok()) {
+    return Status::failure("Extension socket not available: " + path);
+  }
+
+  try {
+    ExtensionClient client(path);
+    auto status = client.ping();
+    if (status.getCode() != (int)ExtensionCode::EXT_SUCCESS) {
+      return Status::failure("Extension ping failed: " + status.getMessage());
+    }
+  } catch (const std::exception& e) {
+    return Status::failure("Extension call failed: " + std::string(e.what()));
+  }
+  return Status::success();
+}
+
+/// Bounds the calls in flight to each extension.
+class ExtensionCallLimiter : private boost::noncopyable {
+ public:
+  /// Wait until the extension has fewer than the max calls in flight.
+  void acquire(RouteUUID uuid, size_t max) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [&] { return calls_[uuid] < max; });
+    calls_[uuid]++;
+  }
+
+  void release(RouteUUID uuid) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (--calls_[uuid] == 0) {
+        calls_.erase(uuid);
+      }
+    }
+    cv_.notify_all();
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+
+  /// The calls in flight to each extension.
+  std::map<RouteUUID, size_t> calls_;
+};
+
+ExtensionCallLimiter& getExtensionCallLimiter() {
+  static ExtensionCallLimiter limiter;
+  return limiter;
+}
+
 } // namespace
 
 CLI_FLAG(bool, disable_extensions, false, "Disable extension API");
@@ -88,6 +351,13 @@ CLI_FLAG(string,
          "",
          "Comma-separated list of required extensions");
 
+FLAG(uint32,
+     extensions_max_concurrent_calls,
+     0,
+     "Max concurrent calls to each extension, 0 is unlimited");
+
+DECLARE_bool(enable_numeric_monitoring);
+
 /**
  * @brief Alias the extensions_socket (used by core) to a simple 'socket'.
  *
@@ -115,6 +385,9 @@ class ExtensionWatcher : public InternalRunnable {
   /// The Dispatcher thread entry point.
   void start() override;
 
+  /// Wake the watcher from a wait for the exit of the core.
+  void stop() override;
+
   /// Perform health checks.
   virtual void watch();
 
@@ -135,6 +408,9 @@ class ExtensionWatcher : public InternalRunnable {
   /// Optional uuid used to monitor if socket is registered on with extension
   /// core
   boost::optional<RouteUUID> uuid_;
+
+  /// Notifies the exit of the watched processes.
+  ExtensionExitNotifier notifier_;
 };
 
 class ExtensionManagerWatcher : public ExtensionWatcher {
@@ -151,29 +427,38 @@ class ExtensionManagerWatcher : public ExtensionWatcher {
  private:
   /// Allow extensions to fail for several intervals.
   std::map<RouteUUID, size_t> failures_;
+
+  /// When each extension was first watched, latent ones are not pinged.
+  std::map<RouteUUID, std::chrono::steady_clock::time_point> registered_;
+
+  /// The extensions whose exit was notified since the last health check.
+  std::vector<RouteUUID> exited_;
+
+  /// Health checks since the watcher started.
+  size_t checks_{0};
 };
 
+void notifyExtensionRegistered() {
+  getExtensionRegistrations().notify();
+}
+
 Status applyExtensionDelay(std::function<Status(bool& stop)> predicate) {
-  // Make sure the extension manager path exists, and is writable.
-  size_t delay = 0;
-  // The timeout is given in seconds, but checked interval is microseconds.
-  size_t timeout = atoi(FLAGS_extensions_timeout.c_str()) * 1000;
-  if (timeout < kExtensionInitializeLatency * 10) {
-    timeout = kExtensionInitializeLatency * 10;
-  }
+  auto& registrations = getExtensionRegistrations();
+  auto deadline = std::chrono::steady_clock::now() + getExtensionTimeout();
 
   Status status;
   do {
+    // A registration during the predicate ends the next wait immediately.
+    auto generation = registrations.generation();
     bool stop = false;
     status = predicate(stop);
     if (stop || status.ok() || shutdownRequested()) {
       break;
     }
 
-    // Increase the total wait detail.
-    delay += kExtensionInitializeLatency;
-    sleepFor(kExtensionInitializeLatency);
-  } while (delay < timeout);
+    registrations.waitFor(
+        generation, std::chrono::milliseconds(kExtensionInitializeLatency));
+  } while (std::chrono::steady_clock::now() < deadline);
   return status;
 }
 
@@ -220,17 +505,41 @@ void ExtensionWatcher::start() {
   // Watch the manager, if the socket is removed then the extension will die.
   // A check for sane paths and activity is applied before the watcher
   // service is added and started.
+  if (fatal_) {
+    notifier_.watch(0, path_);
+  }
+
+  // The exit of a watched core is notified, the core is pinged on fewer
+  // intervals to check that the extension is still registered.
+  size_t checks = 0;
   while (!interrupted()) {
-    watch();
-    pause(std::chrono::milliseconds(interval_));
+    if (notifier_.empty() || checks++ % kExtensionNotifiedPingIntervals == 0) {
+      watch();
+    }
+
+    if (notifier_.empty()) {
+      pause(std::chrono::milliseconds(interval_));
+    } else if (!notifier_.wait(std::chrono::milliseconds(interval_)).empty()) {
+      notifier_.forget(0);
+      LOG(INFO) << "Extension watcher ending: osquery core has exited";
+      exitFatal(0);
+    }
   }
 }
 
+void ExtensionWatcher::stop() {
+  notifier_.wake();
+}
+
 void ExtensionManagerWatcher::start() {
-  // Watch each extension.
+  // Watch each extension, a notified exit is checked without delay.
   while (!interrupted()) {
     watch();
-    pause(std::chrono::milliseconds(interval_));
+    if (notifier_.empty()) {
+      pause(std::chrono::milliseconds(interval_));
+    } else {
+      exited_ = notifier_.wait(std::chrono::milliseconds(interval_));
+    }
   }
 
   // When interrupted, request each extension tear down.
@@ -303,51 +612,63 @@ void ExtensionWatcher::watch() {
 void ExtensionManagerWatcher::watch() {
   // Watch the set of extensions, if the socket is removed then the extension
   // will be deregistered.
-  const auto uuids = RegistryFactory::get().routeUUIDs();
+  auto& rf = RegistryFactory::get();
+  for (const auto& uuid : exited_) {
+    LOG(INFO) << "Extension UUID " << uuid << " has exited";
+    notifier_.forget(uuid);
+    rf.removeBroadcast(uuid);
+  }
+  exited_.clear();
+
+  const auto uuids = rf.routeUUIDs();
+  for (auto it = registered_.begin(); it != registered_.end();) {
+    if (std::find(uuids.begin(), uuids.end(), it->first) == uuids.end()) {
+      notifier_.forget(it->first);
+      failures_.erase(it->first);
+      it = registered_.erase(it);
+    } else {
+      ++it;
+    }
+  }
 
-  Status status;
+  // Extensions whose exit is notified are pinged on fewer intervals, to
+  // find the processes that no longer answer.
+  auto now = std::chrono::steady_clock::now();
+  auto ping_watched = checks_++ % kExtensionNotifiedPingIntervals == 0;
   for (const auto& uuid : uuids) {
-    auto path = getExtensionSocket(uuid);
-    auto exists = socketExists(path);
+    if (notifier_.watching(uuid) && !ping_watched) {
+      continue;
+    }
 
-    if (!exists.ok() && failures_[uuid] == 0) {
-      // If there was never a failure then this is the first attempt.
-      // Allow the extension to be latent and respect the autoload timeout.
+    auto registered = registered_.emplace(uuid, now).first->second;
+    auto path = getExtensionSocket(uuid);
+    auto status = pingExtensionSocket(path);
+    if (!status.ok() && failures_.count(uuid) == 0 &&
+        now - registered < getExtensionTimeout()) {
+      // Allow a new extension to be latent and respect the autoload timeout.
+      // Each extension is given the timeout from its registration, so many
+      // extensions starting at once are not waited on one after another.
       VLOG(1) << "Extension UUID " << uuid << " initial check failed";
-      exists = extensionPathActive(path, true);
+      continue;
     }
 
     // All extensions will have a single failure (and odd use of the counting).
     // If failures get to 2 then the extension will be removed.
     failures_[uuid] = 1;
-    if (exists.ok()) {
-      try {
-        ExtensionClient client(path);
-        // Ping the extension until it goes down.
-        status = client.ping();
-      } catch (const std::exception& /* e */) {
-        failures_[uuid] += 1;
-        continue;
-      }
-    } else {
-      // Immediate fail non-writable paths.
-      failures_[uuid] += 1;
-      continue;
-    }
-
-    if (status.getCode() != (int)ExtensionCode::EXT_SUCCESS) {
+    if (!status.ok()) {
       LOG(INFO) << "Extension UUID " << uuid << " ping failed";
       failures_[uuid] += 1;
-    } else {
-      failures_[uuid] = 1;
+    } else if (!notifier_.watching(uuid) && notifier_.watch(uuid, path)) {
+      VLOG(1) << "Extension UUID " << uuid << " exit is notified";
     }
   }
 
-  for (const auto& uuid : failures_) {
+  for (auto& uuid : failures_) {
     if (uuid.second > 1) {
       LOG(INFO) << "Extension UUID " << uuid.first << " has gone away";
-      RegistryFactory::get().removeBroadcast(uuid.first);
-      failures_[uuid.first] = 1;
+      notifier_.forget(uuid.first);
+      rf.removeBroadcast(uuid.first);
+      uuid.second = 1;
     }
   }
 }
@@ -678,8 +999,29 @@ Status callExtension(const RouteUUID uuid,
   if (FLAGS_disable_extensions) {
     return Status(1, "Extensions disabled");
   }
-  return callExtension(
+
+  // A slow extension must not occupy every thread calling into extensions.
+  size_t max = FLAGS_extensions_max_concurrent_calls;
+  if (max > 0) {
+    getExtensionCallLimiter().acquire(uuid, max);
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  auto status = callExtension(
       getExtensionSocket(uuid), registry, item, request, response);
+  if (max > 0) {
+    getExtensionCallLimiter().release(uuid);
+  }
+
+  if (FLAGS_enable_numeric_monitoring) {
+    auto latency = std::chrono::duration_cast<std::chrono::milliseconds>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+    monitoring::record("extensions.call." + registry + "." + item + ".latency",
+                       latency,
+                       monitoring::PreAggregationType::P95);
+  }
+  return status;
 }
 
 Status callExtension(const std::string& extension_path,
@@ -753,34 +1095,32 @@ Status startExtensionManager(const std::string& manager_path) {
   }
 
   // The shell or daemon flag configuration may require an extension.
+  // Required extensions are waited on together within the timeout.
   if (!FLAGS_extensions_require.empty()) {
-    bool waited = false;
     auto extensions = osquery::split(FLAGS_extensions_require, ",");
-    for (const auto& extension : extensions) {
-      status = applyExtensionDelay(([extension, &waited](bool& stop) {
-        ExtensionList registered_extensions;
-        if (getExtensions(registered_extensions).ok()) {
-          for (const auto& existing : registered_extensions) {
-            if (existing.second.name == extension) {
-              return pingExtension(getExtensionSocket(existing.first));
-            }
+    status = applyExtensionDelay(([&extensions](bool& stop) {
+      ExtensionList registered_extensions;
+      getExtensions(registered_extensions);
+      for (const auto& extension : extensions) {
+        auto status = Status::failure(
+            "Required extension not found or not loaded: " + extension);
+        for (const auto& existing : registered_extensions) {
+          if (existing.second.name == extension) {
+            status = pingExtension(getExtensionSocket(existing.first));
+            break;
           }
         }
-
-        if (waited) {
-          // If we have already waited for the timeout period, stop early.
-          stop = true;
+        if (!status.ok()) {
+          return status;
         }
-        return Status(
-            1, "Required extension not found or not loaded: " + extension);
-      }));
-
-      // A required extension was not loaded.
-      waited = true;
-      if (!status.ok()) {
-        LOG(WARNING) << status.getMessage();
-        return status;
       }
+      return Status::success();
+    }));
+
+    // A required extension was not loaded.
+    if (!status.ok()) {
+      LOG(WARNING) << status.getMessage();
+      return status;
     }
   }
 
@@ -80,6 +80,9 @@ Status pingExtension(const std::string& path);
  */
 Status applyExtensionDelay(std::function<Status(bool& stop)> predicate);
 
+/// Wake the callers of applyExtensionDelay, an extension has registered.
+void notifyExtensionRegistered();
+
 /**
  * @brief Read the autoload flags and return a set of autoload paths.
  *
@@ -12,8 +12,10 @@
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
 
+#include <thrift/concurrency/ThreadFactory.h>
 #include <thrift/concurrency/ThreadManager.h>
 #include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/server/TThreadPoolServer.h>
 #include <thrift/server/TThreadedServer.h>
 #include <thrift/transport/TBufferTransports.h>
 
@@ -47,6 +49,10 @@ FLAG(int32,
      0,
      "Sets the maximum string size allowed in a thrift message, use 0 for "
      "unlimited");
+FLAG(uint32,
+     extensions_server_threads,
+     0,
+     "Threads serving each extension socket, 0 uses a thread per connection");
 
 using namespace apache::thrift;
 using namespace apache::thrift::protocol;
@@ -174,7 +180,7 @@ class ExtensionManagerHandler : virtual public extensions::ExtensionManagerIf,
 
 struct ImplExtensionRunner {
   std::shared_ptr<TServerTransport> transport;
-  std::shared_ptr<TThreadedServer> server;
+  std::shared_ptr<TServerFramework> server;
   std::shared_ptr<TProcessor> processor;
   std::shared_ptr<ThriftServerEventHandler> server_event_handler;
 };
@@ -356,8 +362,22 @@ void ExtensionRunnerInterface::connect() {
   auto protocol_fac = std::make_shared<TBinaryProtocolFactory>();
   protocol_fac->setStringSizeLimit(FLAGS_thrift_string_size_limit);
 
-  server_->server = std::make_shared<TThreadedServer>(
-      server_->processor, server_->transport, transport_fac, protocol_fac);
+  if (FLAGS_extensions_server_threads > 0) {
+    // A bounded pool, connections beyond the pool size wait for a thread.
+    auto thread_manager =
+        ThreadManager::newSimpleThreadManager(FLAGS_extensions_server_threads);
+    thread_manager->threadFactory(std::make_shared<ThreadFactory>());
+    thread_manager->start();
+
+    server_->server = std::make_shared<TThreadPoolServer>(server_->processor,
+                                                          server_->transport,
+                                                          transport_fac,
+                                                          protocol_fac,
+                                                          thread_manager);
+  } else {
+    server_->server = std::make_shared<TThreadedServer>(
+        server_->processor, server_->transport, transport_fac, protocol_fac);
+  }
 
   server_->server_event_handler = std::make_shared<ThriftServerEventHandler>();
   server_->server->setServerEventHandler(server_->server_event_handler);
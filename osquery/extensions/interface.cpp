@@ -147,8 +147,11 @@ Status ExtensionManagerInterface::registerExtension(
                   "Failed adding registry: " + status.getMessage());
   }
 
-  WriteLock lock(extensions_mutex_);
-  extensions_[uuid] = info;
+  {
+    WriteLock lock(extensions_mutex_);
+    extensions_[uuid] = info;
+  }
+  notifyExtensionRegistered();
   return Status::success();
 }
 
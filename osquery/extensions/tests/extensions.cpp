@@ -12,7 +12,10 @@
 #define GTEST_HAS_TR1_TUPLE 0
 #endif
 
+#include <atomic>
+#include <chrono>
 #include <stdexcept>
+#include <thread>
 
 #include <gtest/gtest.h>
 
@@ -159,6 +162,25 @@ TEST_F(ExtensionsTest, test_manager_bad_require_extension) {
   FLAGS_extensions_require = "";
 }
 
+TEST_F(ExtensionsTest, test_extension_delay_ends_on_registration) {
+  std::atomic<bool> registered{false};
+  std::thread registration([&registered]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    registered = true;
+    notifyExtensionRegistered();
+  });
+
+  auto start = std::chrono::steady_clock::now();
+  auto status = applyExtensionDelay(([&registered](bool& stop) {
+    return registered ? Status::success() : Status::failure("Not registered");
+  }));
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  registration.join();
+
+  EXPECT_TRUE(status.ok());
+  EXPECT_LT(elapsed, std::chrono::milliseconds(kTimeout));
+}
+
 TEST_F(ExtensionsTest, test_extension_runnable) {
   auto status = startExtensionManager(socket_path);
   EXPECT_TRUE(status.ok()) << " error " << status.what();
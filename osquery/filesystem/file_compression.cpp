@@ -9,6 +9,13 @@
 
 #include <osquery/utils/system/system.h>
 
+#include <algorithm>
+#include <thread>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
 // This define is required for Windows static linking of libarchive
 #define LIBARCHIVE_STATIC
 #include <archive.h>
@@ -18,11 +25,191 @@
 #include <osquery/core/flags.h>
 #include <osquery/core/system.h>
 #include <osquery/filesystem/filesystem.h>
+#include <osquery/logger/logger.h>
+#include <osquery/utils/conversions/split.h>
+#include <osquery/utils/conversions/trim.h>
+#include <osquery/utils/conversions/tryto.h>
 
 namespace osquery {
 
+FLAG(int32,
+     file_compression_level,
+     1,
+     "The zstd level of carve and rotated log compression");
+
+FLAG(uint32,
+     file_compression_workers,
+     0,
+     "Threads compressing carves and rotated logs (0 = the calling thread)");
+
+namespace {
+
+/// The CPUs the process may run on, at least 1.
+std::size_t getAvailableCPUs() {
+  std::size_t cpus = std::max(1U, std::thread::hardware_concurrency());
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == 0 && CPU_COUNT(&set) > 0) {
+    cpus = std::min(cpus, static_cast<std::size_t>(CPU_COUNT(&set)));
+  }
+
+  // The quota of a cgroup v2, then v1, as "quota period" in microseconds.
+  std::string quota;
+  std::string period;
+  std::string content;
+  if (readFile("/sys/fs/cgroup/cpu.max", content, 0, false, false, false)
+          .ok()) {
+    auto fields = split(content);
+    if (fields.size() == 2) {
+      quota = fields[0];
+      period = fields[1];
+    }
+  } else if (readFile("/sys/fs/cgroup/cpu/cpu.cfs_quota_us",
+                      quota,
+                      0,
+                      false,
+                      false,
+                      false)
+                 .ok()) {
+    readFile("/sys/fs/cgroup/cpu/cpu.cfs_period_us",
+             period,
+             0,
+             false,
+             false,
+             false);
+  }
+
+  auto quota_us = tryTo<std::int64_t>(std::string(trim(quota)));
+  auto period_us = tryTo<std::int64_t>(std::string(trim(period)));
+  if (quota_us.isValue() && period_us.isValue() && *quota_us > 0 &&
+      *period_us > 0) {
+    auto quota_cpus = static_cast<std::size_t>(
+        (*quota_us + *period_us - 1) / *period_us);
+    cpus = std::min(cpus, std::max<std::size_t>(quota_cpus, 1));
+  }
+#endif
+  return cpus;
+}
+
+std::string zstdError(const std::string& call, size_t code) {
+  return call + " error : " + std::string(ZSTD_getErrorName(code));
+}
+
+} // namespace
+
+CompressionOptions getFileCompressionOptions() {
+  CompressionOptions options;
+  options.level = FLAGS_file_compression_level;
+  options.workers = FLAGS_file_compression_workers;
+  return options;
+}
+
+std::size_t getCompressionWorkers(std::size_t requested) {
+  if (requested == 0) {
+    return 0;
+  }
+
+  static const auto kAvailableCPUs = getAvailableCPUs();
+  return std::min(requested, kAvailableCPUs);
+}
+
+ZstdCompressor::~ZstdCompressor() {
+  ZSTD_freeCCtx(cctx_);
+}
+
+Status ZstdCompressor::init(const CompressionOptions& options) {
+  ZSTD_freeCCtx(cctx_);
+  cctx_ = ZSTD_createCCtx();
+  if (cctx_ == nullptr) {
+    return Status::failure("Couldn't create compression stream");
+  }
+
+  auto ret =
+      ZSTD_CCtx_setParameter(cctx_, ZSTD_c_compressionLevel, options.level);
+  if (ZSTD_isError(ret)) {
+    return Status::failure(zstdError("ZSTD_c_compressionLevel", ret));
+  }
+
+  auto workers = getCompressionWorkers(options.workers);
+  if (workers > 0) {
+    // A library built without threads compresses on the caller.
+    ret = ZSTD_CCtx_setParameter(
+        cctx_, ZSTD_c_nbWorkers, static_cast<int>(workers));
+    if (ZSTD_isError(ret)) {
+      VLOG(1) << "Compressing without workers: " << ZSTD_getErrorName(ret);
+    }
+  }
+
+  if (!options.dictionary.empty()) {
+    ret = ZSTD_CCtx_loadDictionary(
+        cctx_, options.dictionary.data(), options.dictionary.size());
+    if (ZSTD_isError(ret)) {
+      return Status::failure(zstdError("ZSTD_CCtx_loadDictionary", ret));
+    }
+  }
+
+  buffer_.resize(ZSTD_CStreamOutSize());
+  return Status::success();
+}
+
+Status ZstdCompressor::write(const char* data,
+                             std::size_t size,
+                             const CompressionSink& sink) {
+  if (cctx_ == nullptr) {
+    return Status::failure("The compression stream is not initialized");
+  }
+
+  ZSTD_inBuffer input = {data, size, 0};
+  while (input.pos < input.size) {
+    ZSTD_outBuffer output = {buffer_.data(), buffer_.size(), 0};
+    auto ret = ZSTD_compressStream2(cctx_, &output, &input, ZSTD_e_continue);
+    if (ZSTD_isError(ret)) {
+      return Status::failure(zstdError("ZSTD_compressStream2()", ret));
+    }
+
+    if (output.pos > 0) {
+      auto s = sink(buffer_.data(), output.pos);
+      if (!s.ok()) {
+        return s;
+      }
+    }
+  }
+  return Status::success();
+}
+
+Status ZstdCompressor::finish(const CompressionSink& sink) {
+  if (cctx_ == nullptr) {
+    return Status::failure("The compression stream is not initialized");
+  }
+
+  ZSTD_inBuffer input = {nullptr, 0, 0};
+  size_t remaining = 0;
+  do {
+    ZSTD_outBuffer output = {buffer_.data(), buffer_.size(), 0};
+    remaining = ZSTD_compressStream2(cctx_, &output, &input, ZSTD_e_end);
+    if (ZSTD_isError(remaining)) {
+      return Status::failure(zstdError("ZSTD_compressStream2()", remaining));
+    }
+
+    if (output.pos > 0) {
+      auto s = sink(buffer_.data(), output.pos);
+      if (!s.ok()) {
+        return s;
+      }
+    }
+  } while (remaining > 0);
+  return Status::success();
+}
+
 Status compress(const boost::filesystem::path& in,
                 const boost::filesystem::path& out) {
+  return compress(in, out, getFileCompressionOptions());
+}
+
+Status compress(const boost::filesystem::path& in,
+                const boost::filesystem::path& out,
+                const CompressionOptions& options) {
   PlatformFile inFile(in, PF_OPEN_EXISTING | PF_READ);
   if (!inFile.isValid()) {
     return Status::failure("Could not open in file: " + in.string() +
@@ -35,66 +222,40 @@ Status compress(const boost::filesystem::path& in,
                            " for compression");
   }
 
-  auto inFileSize = inFile.size();
-  ZSTD_CStream* const cstream = ZSTD_createCStream();
-  if (cstream == nullptr) {
-    return Status(1, "Couldn't create compression stream");
+  ZstdCompressor compressor;
+  auto s = compressor.init(options);
+  if (!s.ok()) {
+    return s;
   }
 
-  size_t const initResult = ZSTD_initCStream(cstream, 1);
-  if (ZSTD_isError(initResult)) {
-    return Status(1, "Couldn't initialize compression stream");
-  }
+  auto sink = [&outFile](const char* data, size_t size) {
+    auto written = outFile.write(data, size);
+    if (written < 0 || static_cast<size_t>(written) != size) {
+      return Status::failure("Couldn't write the compressed file");
+    }
+    return Status::success();
+  };
 
-  size_t const buffInSize = ZSTD_CStreamInSize();
-  size_t const buffOutSize = ZSTD_CStreamOutSize();
-  std::vector<void*> buffIn(buffInSize);
-  std::vector<void*> buffOut(buffOutSize);
-  auto read = buffInSize;
-  auto toRead = buffInSize;
+  auto inFileSize = inFile.size();
+  std::vector<char> buffIn(ZSTD_CStreamInSize());
   size_t readSoFar = 0;
   while (true) {
-    read = inFile.read(buffIn.data(), toRead);
+    auto read = inFile.read(buffIn.data(), buffIn.size());
     if (read < 1) {
       break;
     }
     readSoFar += read;
     if (readSoFar > inFileSize) {
-      ZSTD_freeCStream(cstream);
       return Status(1, "File changed during compression");
     }
 
-    ZSTD_inBuffer input = {buffIn.data(), read, 0};
-    while (input.pos < input.size) {
-      ZSTD_outBuffer output = {buffOut.data(), buffOutSize, 0};
-      toRead = ZSTD_compressStream(cstream, &output, &input);
-      if (ZSTD_isError(toRead)) {
-        ZSTD_freeCStream(cstream);
-        return Status(1,
-                      "ZSTD_compressStream() error : " +
-                          std::string(ZSTD_getErrorName(toRead)));
-      }
-      if (toRead > buffInSize) {
-        toRead = buffInSize;
-      }
-      outFile.seek(0, PF_SEEK_END);
-      outFile.write(buffOut.data(), output.pos);
+    s = compressor.write(buffIn.data(), static_cast<size_t>(read), sink);
+    if (!s.ok()) {
+      return s;
     }
   }
 
-  ZSTD_outBuffer output = {buffOut.data(), buffOutSize, 0};
-  size_t const remainingToFlush = ZSTD_endStream(cstream, &output);
-
-  if (remainingToFlush) {
-    ZSTD_freeCStream(cstream);
-    return Status(1, "Couldn't fully flush compressed file");
-  }
-
-  outFile.seek(0, PF_SEEK_END);
-  outFile.write(buffOut.data(), output.pos);
-  ZSTD_freeCStream(cstream);
-
-  return Status(0);
+  return compressor.finish(sink);
 }
 
 Status decompress(const boost::filesystem::path& in,
@@ -200,4 +361,121 @@ Status archive(const std::set<boost::filesystem::path>& paths,
   archive_write_free(arch);
   return Status::success();
 };
+
+namespace {
+
+/// State shared with the libarchive write callback of a streamed archive.
+struct ArchiveStream {
+  explicit ArchiveStream(const ArchiveSink& s) : sink(s) {}
+
+  /// Pass the archive content to the sink, compressing it when requested.
+  Status write(const char* data, size_t size) {
+    if (!compress) {
+      return sink(data, size);
+    }
+    return compressor.write(data, size, sink);
+  }
+
+  /// Flush the remaining compressed content.
+  Status finish() {
+    if (!compress) {
+      return Status::success();
+    }
+    return compressor.finish(sink);
+  }
+
+  const ArchiveSink& sink;
+  bool compress{false};
+  ZstdCompressor compressor;
+
+  /// The first failure seen by the write callback.
+  Status status;
+};
+
+la_ssize_t writeArchiveStream(struct archive*,
+                              void* data,
+                              const void* buffer,
+                              size_t length) {
+  auto stream = static_cast<ArchiveStream*>(data);
+  stream->status = stream->write(static_cast<const char*>(buffer), length);
+  return stream->status.ok() ? static_cast<la_ssize_t>(length) : -1;
+}
+
+} // namespace
+
+Status archive(const std::map<std::string, boost::filesystem::path>& entries,
+               bool compress,
+               std::size_t block_size,
+               const ArchiveSink& sink) {
+  ArchiveStream stream(sink);
+  if (compress) {
+    auto s = stream.compressor.init(getFileCompressionOptions());
+    if (!s.ok()) {
+      return s;
+    }
+    stream.compress = true;
+  }
+
+  auto arch = archive_write_new();
+  if (arch == nullptr) {
+    return Status::failure("Failed to create tar archive");
+  }
+  archive_write_set_format_pax_restricted(arch);
+  // Do not pad the end of the stream beyond the tar end-of-archive blocks.
+  archive_write_set_bytes_in_last_block(arch, 1);
+  auto ret = archive_write_open(
+      arch, &stream, nullptr, writeArchiveStream, nullptr);
+  if (ret == ARCHIVE_FATAL) {
+    archive_write_free(arch);
+    return Status::failure("Failed to open tar archive for writing");
+  }
+
+  std::vector<char> block(block_size, 0);
+  for (const auto& entry : entries) {
+    PlatformFile pFile(entry.second, PF_OPEN_EXISTING | PF_READ);
+    if (!pFile.isValid()) {
+      continue;
+    }
+
+    auto header = archive_entry_new();
+    archive_entry_set_pathname(header, entry.first.c_str());
+    archive_entry_set_size(header, pFile.size());
+    archive_entry_set_filetype(header, AE_IFREG);
+    archive_entry_set_perm(header, 0644);
+    ret = archive_write_header(arch, header);
+    archive_entry_free(header);
+    if (ret == ARCHIVE_FATAL) {
+      break;
+    }
+
+    // A file that grows is truncated to the size in its header, and a file
+    // that shrinks is padded by libarchive.
+    ssize_t r = 0;
+    while ((r = pFile.read(block.data(), block_size)) > 0) {
+      auto written = archive_write_data(arch, block.data(), r);
+      if (written < 0) {
+        ret = ARCHIVE_FATAL;
+        break;
+      } else if (written < r) {
+        break;
+      }
+    }
+    if (ret == ARCHIVE_FATAL) {
+      break;
+    }
+  }
+
+  if (ret != ARCHIVE_FATAL && archive_write_close(arch) != ARCHIVE_OK) {
+    ret = ARCHIVE_FATAL;
+  }
+  archive_write_free(arch);
+
+  if (!stream.status.ok()) {
+    return stream.status;
+  }
+  if (ret == ARCHIVE_FATAL) {
+    return Status::failure("Failed to write tar archive");
+  }
+  return stream.finish();
+}
 } // namespace osquery
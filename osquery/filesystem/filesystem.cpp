@@ -7,8 +7,10 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <atomic>
 #include <codecvt>
 #include <sstream>
+#include <thread>
 
 #include <fcntl.h>
 #include <sys/stat.h>
@@ -27,6 +29,7 @@
 
 #include <osquery/core/flags.h>
 #include <osquery/core/system.h>
+#include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
 #include <osquery/sql/sql.h>
@@ -48,6 +51,17 @@ FLAG(uint64, read_max, 50 * 1024 * 1024, "Maximum file read size");
 /// See reference #1382 for reasons why someone would allow unsafe.
 HIDDEN_FLAG(bool, allow_unsafe, false, "Allow unsafe executable permissions");
 
+FLAG(uint32,
+     read_batch_workers,
+     4,
+     "Threads reading a batch of small files, 0 or 1 reads on the caller");
+
+/// Files a batch must have for each of its read threads.
+const size_t kReadBatchWorkerFiles{64};
+
+/// The read size when the file's size is unknown.
+const size_t kReadBatchChunkSize{4096};
+
 static const size_t kMaxRecursiveGlobs = 64;
 
 Status writeTextFile(const fs::path& path,
@@ -140,7 +154,7 @@ Status readFile(const fs::path& path,
       }
       return s;
     }
-    return Status::failure("File exceeds read limits");
+    return Status::staticFailure("File exceeds read limits");
   }
 
   if (dry_run) {
@@ -159,13 +173,15 @@ Status readFile(const fs::path& path,
     block_size = (block_size < 4096) ? 4096 : block_size;
     ssize_t part_bytes = 0;
     bool overflow = false;
+    // The buffer is reused, the predicate may have moved or resized it.
+    std::string part;
     do {
-      std::string part(block_size, '\0');
+      part.resize(block_size, '\0');
       part_bytes = handle.fd->read(&part[0], block_size);
       if (part_bytes > 0) {
         total_bytes += static_cast<off_t>(part_bytes);
         if (total_bytes >= read_max) {
-          return Status::failure("File exceeds read limits");
+          return Status::staticFailure("File exceeds read limits");
         }
         if (file_size > 0 && total_bytes > file_size) {
           overflow = true;
@@ -210,6 +226,67 @@ Status readFile(const fs::path& path,
                   log);
 }
 
+namespace {
+
+void readBatchFile(BatchFileRead& file) {
+  file.content.clear();
+  PlatformFile fd(file.path, PF_OPEN_EXISTING | PF_READ | PF_NONBLOCK);
+  if (!fd.isValid()) {
+    file.status = Status::failure("Cannot open file for reading: " + file.path);
+    return;
+  }
+
+  auto read_max = static_cast<size_t>(FLAGS_read_max);
+  size_t total_bytes = 0;
+  while (true) {
+    file.content.resize(total_bytes + kReadBatchChunkSize);
+    auto part_bytes = fd.read(&file.content[total_bytes], kReadBatchChunkSize);
+    if (part_bytes <= 0) {
+      break;
+    }
+
+    total_bytes += static_cast<size_t>(part_bytes);
+    if (total_bytes > read_max) {
+      file.content.clear();
+      file.status = Status::failure("File exceeds read limits: " + file.path);
+      return;
+    }
+  }
+
+  file.content.resize(total_bytes);
+  file.status = Status::success();
+}
+} // namespace
+
+void readFileBatch(std::vector<BatchFileRead>& files) {
+  auto workers = std::min(static_cast<size_t>(FLAGS_read_batch_workers),
+                          files.size() / kReadBatchWorkerFiles);
+  if (workers <= 1) {
+    for (auto& file : files) {
+      readBatchFile(file);
+    }
+    return;
+  }
+
+  // Each thread reads the next unread file, so slow reads do not stall it.
+  std::atomic<size_t> next{0};
+  auto worker = [&files, &next]() {
+    for (auto i = next++; i < files.size(); i = next++) {
+      readBatchFile(files[i]);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < workers; i++) {
+    threads.emplace_back(worker);
+  }
+  worker();
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
 Status readFile(const fs::path& path, bool blocking) {
   std::string blank;
   return readFile(path, blank, 0, true, false, blocking);
@@ -250,7 +327,7 @@ Status isReadable(const fs::path& path, bool effective) {
 Status pathExists(const fs::path& path) {
   boost::system::error_code ec;
   if (path.empty()) {
-    return Status(1, "-1");
+    return Status::staticFailure("-1");
   }
 
   // A tri-state determination of presence
@@ -263,7 +340,7 @@ Status pathExists(const fs::path& path) {
 Status movePath(const fs::path& from, const fs::path& to) {
   boost::system::error_code ec;
   if (from.empty() || to.empty()) {
-    return Status(1, "Cannot copy empty paths");
+    return Status::staticFailure("Cannot copy empty paths");
   }
 
   fs::rename(from, to, ec);
@@ -363,6 +440,44 @@ Status resolveFilePattern(const fs::path& fs_path,
   return Status::success();
 }
 
+std::set<std::string> resolveConstraintPaths(const QueryContext& context,
+                                             const std::string& column,
+                                             GlobLimits limits) {
+  auto constraint = context.constraints.find(column);
+  if (constraint == context.constraints.end()) {
+    return {};
+  }
+
+  const auto& list = constraint->second;
+  ConstraintMatcher matcher(list);
+  auto paths = list.getAll(EQUALS);
+  if (paths.empty()) {
+    for (const auto& pattern : list.getAll(LIKE)) {
+      // Every path globbed by an absolute pattern starts with its literal
+      // directory, skip the pattern if no such path can match.
+      auto literal = pattern.substr(0, pattern.find_first_of("%_"));
+      auto base = literal.substr(0, literal.find_last_of("/\\") + 1);
+      if (!base.empty() && base[0] == '/' && !matcher.mayMatchPrefix(base)) {
+        continue;
+      }
+
+      std::vector<std::string> resolved;
+      resolveFilePattern(pattern, resolved, limits);
+      paths.insert(resolved.begin(), resolved.end());
+    }
+  }
+
+  // Discard the paths SQLite would filter from the results.
+  for (auto it = paths.begin(); it != paths.end();) {
+    if (matcher.matches(*it)) {
+      ++it;
+    } else {
+      it = paths.erase(it);
+    }
+  }
+  return paths;
+}
+
 inline void replaceGlobWildcards(std::string& pattern, GlobLimits limits) {
   // Replace SQL-wildcard '%' with globbing wildcard '*'.
   if (pattern.find('%') != std::string::npos) {
@@ -432,7 +547,7 @@ Status listDirectoriesInDirectory(const fs::path& path,
                                   std::vector<std::string>& results,
                                   bool recursive) {
   if (path.empty() || !pathExists(path)) {
-    return Status(1, "Target directory is invalid");
+    return Status::staticFailure("Target directory is invalid");
   }
 
   if (recursive) {
@@ -11,17 +11,22 @@
 
 #include <osquery/filesystem/fileops.h>
 
+#include <functional>
 #include <map>
 #include <set>
 #include <string>
 #include <vector>
 
 #include <boost/filesystem/path.hpp>
+#include <boost/noncopyable.hpp>
 #include <boost/property_tree/ptree.hpp>
 
+struct ZSTD_CCtx_s;
+
 namespace osquery {
 
 class Status;
+struct QueryContext;
 
 /// Globbing directory traversal function recursive limit.
 enum GlobLimits : size_t {
@@ -86,6 +91,30 @@ Status readFile(const boost::filesystem::path& path,
                 bool blocking = false,
                 bool log = true);
 
+/// A file read by readFileBatch and the outcome of its read.
+struct BatchFileRead {
+  /// The path to read.
+  std::string path;
+
+  /// The content of the file, empty if the read failed.
+  std::string content;
+
+  /// The result of the read.
+  Status status;
+};
+
+/**
+ * @brief Read the content of many small files.
+ *
+ * Each file is opened and read until its end, its size is not checked first,
+ * so the pseudo-files of /proc and /sys that report no size are read with the
+ * fewest calls. A file is read up to read_max bytes. Batches with many files
+ * are split between read_batch_workers threads.
+ *
+ * @param files the paths to read, each entry receives the content and status.
+ */
+void readFileBatch(std::vector<BatchFileRead>& files);
+
 /**
  * @brief Write text to disk.
  *
@@ -200,6 +229,22 @@ Status resolveFilePattern(const boost::filesystem::path& pattern,
                           std::vector<std::string>& results,
                           GlobLimits setting);
 
+/**
+ * @brief Resolve the paths selected by the constraints of a path column.
+ *
+ * The EQUALS values of the column are its candidates if there are any,
+ * otherwise the paths matching its LIKE patterns are globbed. A pattern is
+ * not globbed if none of its paths can match every constraint of the column,
+ * and the candidates that do not match them are discarded.
+ *
+ * @param context the query context of the scan.
+ * @param column the path column, such as path or directory.
+ * @param limits the kinds of paths a LIKE pattern resolves.
+ */
+std::set<std::string> resolveConstraintPaths(const QueryContext& context,
+                                             const std::string& column,
+                                             GlobLimits limits);
+
 /**
  * @brief Transform a path with SQL wildcards to globbing wildcard.
  *
@@ -360,6 +405,81 @@ Status archive(const std::set<boost::filesystem::path>& path,
                const boost::filesystem::path& out,
                std::size_t block_size = 8192);
 
+/// Receives the consecutive chunks of a streamed archive.
+using ArchiveSink = std::function<Status(const char* data, std::size_t size)>;
+
+/*
+ * @brief Stream a tar archive of files, optionally compressed with zstd.
+ *
+ * The files are read, archived and compressed in a single pass. Memory use is
+ * bounded by the block size and the compression buffers, and nothing is
+ * written to disk: each chunk of output is handed to the sink.
+ *
+ * @param entries a map of archive entry names to the files to read.
+ * @param compress true to compress the archive with zstd.
+ * @param block_size the size of the blocks read from each file.
+ * @param sink the receiver of the archive content, a failure stops the stream.
+ * @return A status containing the success or failure of the operation
+ */
+Status archive(const std::map<std::string, boost::filesystem::path>& entries,
+               bool compress,
+               std::size_t block_size,
+               const ArchiveSink& sink);
+
+/// The settings of a zstd compression.
+struct CompressionOptions {
+  /// The zstd compression level.
+  int level{1};
+
+  /// The threads compressing besides the caller, 0 compresses on the caller.
+  std::size_t workers{0};
+
+  /// Content trained on data alike, the same is needed to decompress.
+  std::string dictionary;
+};
+
+/// The compression options of carves and rotated logs, from their flags.
+CompressionOptions getFileCompressionOptions();
+
+/**
+ * @brief The compression workers to use for a requested number.
+ *
+ * At most one worker runs per CPU the process may use, as limited by its
+ * CPU affinity and, on Linux, the CPU quota of its cgroup.
+ */
+std::size_t getCompressionWorkers(std::size_t requested);
+
+/// Receives the consecutive chunks of a compressed stream.
+using CompressionSink =
+    std::function<Status(const char* data, std::size_t size)>;
+
+/**
+ * @brief A zstd compression of content written in chunks.
+ *
+ * Compressed chunks are handed to a sink as they are produced, so memory use
+ * is bounded by the compression buffers whatever the size of the content.
+ * With workers the content is compressed by zstd threads, the chunks are
+ * still received by the sink on the writing thread, in order.
+ */
+class ZstdCompressor : private boost::noncopyable {
+ public:
+  ZstdCompressor() = default;
+  ~ZstdCompressor();
+
+  /// Start a compression, workers beyond the available CPUs are not used.
+  Status init(const CompressionOptions& options);
+
+  /// Compress the next chunk of content.
+  Status write(const char* data, std::size_t size, const CompressionSink& sink);
+
+  /// Flush the compressed content that remains, ending the frame.
+  Status finish(const CompressionSink& sink);
+
+ private:
+  ZSTD_CCtx_s* cctx_{nullptr};
+  std::vector<char> buffer_;
+};
+
 /*
  * @brief Given a path, compress it with zstd and save to out.
  *
@@ -370,6 +490,11 @@ Status archive(const std::set<boost::filesystem::path>& path,
 Status compress(const boost::filesystem::path& in,
                 const boost::filesystem::path& out);
 
+/// Compress a file with zstd using the given options.
+Status compress(const boost::filesystem::path& in,
+                const boost::filesystem::path& out,
+                const CompressionOptions& options);
+
 /*
  * @brief Given a path, decompress it with zstd and save to out.
  *
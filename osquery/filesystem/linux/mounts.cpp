@@ -7,17 +7,45 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include <fcntl.h>
 #include <mntent.h>
+#include <poll.h>
 #include <sys/vfs.h>
+#include <unistd.h>
 
+#include <osquery/core/flags.h>
 #include <osquery/filesystem/linux/mounts.h>
 #include <osquery/logger/logger.h>
 #include <osquery/utils/system/filepath.h>
 
 namespace osquery {
+
+FLAG(uint32,
+     mounts_statfs_workers,
+     4,
+     "Threads calling statfs on the mounted filesystems");
+
+FLAG(uint32,
+     mounts_statfs_timeout,
+     1000,
+     "Milliseconds to wait for the statfs of a mounted filesystem");
+
 namespace {
 const std::string kMountsPseudoFile{"/proc/mounts"};
 
+/// Polled for changes of the mount table of the process namespace.
+const std::string kMountInfoPseudoFile{"/proc/self/mountinfo"};
+
+/// How often the statfs calls in progress are checked for a timeout.
+const std::chrono::milliseconds kStatfsCheckInterval{50};
+
 struct MountDataDeleter final {
   void operator()(FILE* ptr) {
     if (ptr == nullptr) {
@@ -42,9 +70,8 @@ Status getMountData(MountData& obj) {
   obj.reset(mount_data);
   return Status::success();
 }
-} // namespace
 
-Status getMountedFilesystems(MountedFilesystems& mounted_fs_info) {
+Status parseMountedFilesystems(MountedFilesystems& mounted_fs_info) {
   mounted_fs_info = {};
 
   MountData mount_data;
@@ -75,40 +102,245 @@ Status getMountedFilesystems(MountedFilesystems& mounted_fs_info) {
     mount_info.path = ent.mnt_dir;
     mount_info.flags = ent.mnt_opts;
 
-    if (mount_info.type == "autofs") {
-      VLOG(1) << "Skipping statfs information for autofs mount: "
-              << mount_info.path;
+    mounted_fs_info.emplace_back(std::move(mount_info));
+  }
+
+  return Status::success();
+}
+
+/**
+ * @brief The parsed mount table, parsed again when the kernel reports a change.
+ *
+ * The mountinfo pseudo file reports POLLPRI once after each change of the
+ * mount namespace. It is opened before the table is parsed, a change while
+ * parsing is seen by the next call.
+ */
+class MountTableCache final {
+ public:
+  Status get(MountedFilesystems& mounted_fs_info) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (watch_fd_ < 0) {
+      watch_fd_ = ::open(kMountInfoPseudoFile.c_str(), O_RDONLY | O_CLOEXEC);
+    }
+
+    if (!valid_ || changed()) {
+      valid_ = false;
+      auto status = parseMountedFilesystems(mounts_);
+      if (!status.ok()) {
+        return status;
+      }
+      valid_ = watch_fd_ >= 0;
+    }
+
+    mounted_fs_info = mounts_;
+    return Status::success();
+  }
+
+ private:
+  bool changed() {
+    pollfd fds[] = {{watch_fd_, POLLPRI, 0}};
+    int result;
+    do {
+      result = ::poll(fds, 1, 0);
+    } while (result < 0 && errno == EINTR);
+    return result != 0;
+  }
+
+  std::mutex mutex_;
+  int watch_fd_{-1};
+  bool valid_{false};
+  MountedFilesystems mounts_;
+};
+
+using StatFsInfo = MountInformation::StatFsInfo;
+
+boost::optional<StatFsInfo> statfsMount(const std::string& path) {
+  struct statfs stats = {};
+  if (statfs(path.c_str(), &stats) != 0) {
+    LOG(ERROR) << "statfs failed with errno " << std::to_string(errno)
+               << " on path " << path;
+    return boost::none;
+  }
+
+  StatFsInfo statfs_info = {};
+  statfs_info.block_size = static_cast<std::uint32_t>(stats.f_bsize);
+  statfs_info.block_count = static_cast<std::uint32_t>(stats.f_blocks);
+  statfs_info.free_block_count = static_cast<std::uint32_t>(stats.f_bfree);
+  statfs_info.unprivileged_free_block_count =
+      static_cast<std::uint32_t>(stats.f_bavail);
+  statfs_info.inode_count = static_cast<std::uint32_t>(stats.f_files);
+  statfs_info.free_inode_count = static_cast<std::uint32_t>(stats.f_ffree);
+  return statfs_info;
+}
+
+/// Paths with an abandoned statfs still blocked in the kernel.
+struct BlockedMounts {
+  std::mutex mutex;
+  std::set<std::string> paths;
+};
+
+BlockedMounts& getBlockedMounts() {
+  static BlockedMounts blocked;
+  return blocked;
+}
+
+/**
+ * @brief The statfs calls of one query, shared with the workers.
+ *
+ * A call that does not return in time is abandoned, its worker is replaced
+ * and exits once the call returns. The path is skipped by later queries
+ * until then, a hung mount holds a single thread.
+ */
+struct StatfsBatch {
+  enum class State { Pending, Running, Done, Abandoned };
+
+  std::mutex mutex;
+  std::condition_variable finished_cv;
 
-    } else {
-      struct statfs stats = {};
-      if (statfs(mount_info.path.c_str(), &stats) == 0) {
-        MountInformation::StatFsInfo statfs_info = {};
+  std::vector<std::string> paths;
+  std::vector<boost::optional<StatFsInfo>> results;
+  std::vector<State> states;
+  std::vector<std::chrono::steady_clock::time_point> started;
 
-        statfs_info.block_size = static_cast<std::uint32_t>(stats.f_bsize);
-        statfs_info.block_count = static_cast<std::uint32_t>(stats.f_blocks);
+  size_t next{0};
+  size_t finished{0};
 
-        statfs_info.free_block_count =
-            static_cast<std::uint32_t>(stats.f_bfree);
+  /// Workers not abandoned, the batch cannot finish without one.
+  size_t active{0};
+};
 
-        statfs_info.unprivileged_free_block_count =
-            static_cast<std::uint32_t>(stats.f_bavail);
+void runStatfsWorker(std::shared_ptr<StatfsBatch> batch) {
+  std::unique_lock<std::mutex> lock(batch->mutex);
+  while (batch->next < batch->paths.size()) {
+    auto index = batch->next++;
+    batch->states[index] = StatfsBatch::State::Running;
+    batch->started[index] = std::chrono::steady_clock::now();
+    const auto& path = batch->paths[index];
 
-        statfs_info.inode_count = static_cast<std::uint32_t>(stats.f_files);
+    lock.unlock();
+    auto result = statfsMount(path);
+    lock.lock();
 
-        statfs_info.free_inode_count =
-            static_cast<std::uint32_t>(stats.f_ffree);
+    if (batch->states[index] == StatfsBatch::State::Abandoned) {
+      // A replacement worker continues the batch.
+      auto& blocked = getBlockedMounts();
+      std::lock_guard<std::mutex> blocked_lock(blocked.mutex);
+      blocked.paths.erase(path);
+      return;
+    }
 
-        mount_info.optional_statfs_info = std::move(statfs_info);
+    batch->results[index] = std::move(result);
+    batch->states[index] = StatfsBatch::State::Done;
+    if (++batch->finished == batch->paths.size()) {
+      batch->finished_cv.notify_all();
+    }
+  }
+  --batch->active;
+}
 
+/// Start a worker of the batch, the batch mutex is held.
+bool startStatfsWorker(const std::shared_ptr<StatfsBatch>& batch) {
+  try {
+    std::thread(runStatfsWorker, batch).detach();
+  } catch (const std::system_error& e) {
+    LOG(ERROR) << "Cannot start a statfs worker: " << e.what();
+    return false;
+  }
+  ++batch->active;
+  return true;
+}
+
+void statfsMounts(MountedFilesystems& mounted_fs_info) {
+  auto batch = std::make_shared<StatfsBatch>();
+  std::vector<size_t> indexes;
+  {
+    auto& blocked = getBlockedMounts();
+    std::lock_guard<std::mutex> blocked_lock(blocked.mutex);
+    for (size_t i = 0; i < mounted_fs_info.size(); ++i) {
+      const auto& mount_info = mounted_fs_info[i];
+      if (mount_info.type == "autofs") {
+        VLOG(1) << "Skipping statfs information for autofs mount: "
+                << mount_info.path;
+      } else if (blocked.paths.count(mount_info.path) > 0) {
+        VLOG(1) << "Skipping statfs information for blocked mount: "
+                << mount_info.path;
       } else {
-        LOG(ERROR) << "statfs failed with errno " << std::to_string(errno)
-                   << " on path " << mount_info.path;
+        batch->paths.push_back(mount_info.path);
+        indexes.push_back(i);
       }
     }
+  }
 
-    mounted_fs_info.emplace_back(std::move(mount_info));
+  auto count = batch->paths.size();
+  if (count == 0) {
+    return;
+  }
+  batch->results.resize(count);
+  batch->states.resize(count, StatfsBatch::State::Pending);
+  batch->started.resize(count);
+
+  std::unique_lock<std::mutex> lock(batch->mutex);
+  auto workers = std::min<size_t>(
+      std::max<std::uint32_t>(FLAGS_mounts_statfs_workers, 1), count);
+  for (size_t i = 0; i < workers; ++i) {
+    startStatfsWorker(batch);
+  }
+
+  auto timeout = std::chrono::milliseconds(FLAGS_mounts_statfs_timeout);
+  while (batch->finished < count) {
+    if (batch->active == 0 &&
+        (batch->next >= count || !startStatfsWorker(batch))) {
+      // The remaining mounts are reported without statfs information.
+      break;
+    }
+
+    if (batch->finished_cv.wait_for(lock, kStatfsCheckInterval, [&batch] {
+          return batch->finished == batch->paths.size();
+        })) {
+      break;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; ++i) {
+      if (batch->states[i] != StatfsBatch::State::Running ||
+          now - batch->started[i] < timeout) {
+        continue;
+      }
+
+      LOG(WARNING) << "statfs timed out on path " << batch->paths[i];
+      batch->states[i] = StatfsBatch::State::Abandoned;
+      ++batch->finished;
+      --batch->active;
+      {
+        auto& blocked = getBlockedMounts();
+        std::lock_guard<std::mutex> blocked_lock(blocked.mutex);
+        blocked.paths.insert(batch->paths[i]);
+      }
+
+      if (batch->next < count) {
+        startStatfsWorker(batch);
+      }
+    }
   }
 
+  for (size_t i = 0; i < count; ++i) {
+    mounted_fs_info[indexes[i]].optional_statfs_info =
+        std::move(batch->results[i]);
+  }
+}
+} // namespace
+
+Status getMountedFilesystems(MountedFilesystems& mounted_fs_info,
+                             bool with_statfs) {
+  static MountTableCache cache;
+  auto status = cache.get(mounted_fs_info);
+  if (!status.ok()) {
+    return status;
+  }
+
+  if (with_statfs) {
+    statfsMounts(mounted_fs_info);
+  }
   return Status::success();
 }
 } // namespace osquery
@@ -7,6 +7,8 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#pragma once
+
 #include <boost/optional.hpp>
 #include <unordered_map>
 
@@ -59,5 +61,17 @@ struct MountInformation final {
 // Information about all mounted filesystems
 using MountedFilesystems = std::vector<MountInformation>;
 
-Status getMountedFilesystems(MountedFilesystems& mounted_fs_info);
+/**
+ * @brief List the mounted filesystems.
+ *
+ * The mount table is kept between calls and parsed again after the kernel
+ * reports a change of the mount namespace. The statfs information is read
+ * on each call by a pool of threads, mounts whose statfs does not return
+ * within mounts_statfs_timeout milliseconds are reported without it.
+ *
+ * @param mounted_fs_info the mounted filesystems.
+ * @param with_statfs set to false when the statfs information is not used.
+ */
+Status getMountedFilesystems(MountedFilesystems& mounted_fs_info,
+                             bool with_statfs = true);
 } // namespace osquery
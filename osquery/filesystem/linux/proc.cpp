@@ -7,6 +7,9 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <array>
+#include <cstring>
+
 #include <linux/limits.h>
 #include <unistd.h>
 
@@ -16,6 +19,7 @@
 #include <osquery/filesystem/linux/proc.h>
 #include <osquery/logger/logger.h>
 #include <osquery/utils/conversions/split.h>
+#include <osquery/utils/conversions/trim.h>
 
 namespace osquery {
 const std::vector<std::string> kUserNamespaceList = {
@@ -85,25 +89,26 @@ Status procGetProcessNamespaces(const std::string& process_id,
   return Status::success();
 }
 
-std::string procDecodeAddressFromHex(const std::string& encoded_address,
+std::string procDecodeAddressFromHex(std::string_view encoded_address,
                                      int family) {
+  // The address is printed as 32-bit words in host byte order.
   char addr_buffer[INET6_ADDRSTRLEN] = {0};
   if (family == AF_INET) {
-    struct in_addr decoded;
+    struct in_addr decoded = {};
     if (encoded_address.length() == 8) {
-      sscanf(encoded_address.c_str(), "%X", &(decoded.s_addr));
+      auto word = tryTo<std::uint32_t>(encoded_address, 16).takeOr(0U);
+      std::memcpy(&decoded.s_addr, &word, sizeof(word));
       inet_ntop(AF_INET, &decoded, addr_buffer, INET_ADDRSTRLEN);
     }
 
   } else if (family == AF_INET6) {
-    struct in6_addr decoded;
+    struct in6_addr decoded = {};
     if (encoded_address.length() == 32) {
-      sscanf(encoded_address.c_str(),
-             "%8x%8x%8x%8x",
-             (unsigned int*)&(decoded.s6_addr[0]),
-             (unsigned int*)&(decoded.s6_addr[4]),
-             (unsigned int*)&(decoded.s6_addr[8]),
-             (unsigned int*)&(decoded.s6_addr[12]));
+      for (size_t i = 0; i < 4; ++i) {
+        auto word = tryTo<std::uint32_t>(encoded_address.substr(i * 8, 8), 16)
+                        .takeOr(0U);
+        std::memcpy(&decoded.s6_addr[i * 4], &word, sizeof(word));
+      }
       inet_ntop(AF_INET6, &decoded, addr_buffer, INET6_ADDRSTRLEN);
     }
   }
@@ -112,14 +117,25 @@ std::string procDecodeAddressFromHex(const std::string& encoded_address,
 }
 
 unsigned short procDecodeUnsignedShortFromHex(
-    const std::string& hex_encoded_short) {
+    std::string_view hex_encoded_short) {
   unsigned short decoded = 0;
   if (hex_encoded_short.length() == 4) {
-    sscanf(hex_encoded_short.c_str(), "%hX", &decoded);
+    decoded = tryTo<unsigned short>(hex_encoded_short, 16).takeOr(decoded);
   }
   return decoded;
 }
 
+namespace {
+
+/// Split a hex encoded "address:port" pair of a /proc/net line.
+bool splitAddressPort(std::string_view field,
+                      std::array<std::string_view, 2>& pair) {
+  Tokenizer tokenizer(field, ":");
+  std::string_view extra;
+  return tokenizer.next(pair) == pair.size() && !tokenizer.next(extra);
+}
+} // namespace
+
 // Retrieve AF_PACKET sockets out of /proc/net/packet
 // if protocol is set to non 0, return only sockets for this protocol;
 // else, all.
@@ -132,7 +148,10 @@ Status procGetSocketListPacket(int family,
   bool header = true;
   int decoded_protocol;
 
-  for (const auto& line : osquery::split(content, "\n")) {
+  Tokenizer lines(content, "\n");
+  std::string_view line;
+  while (lines.next(line)) {
+    line = trim(line);
     if (header) {
       if (line.find("sl") != 0 && line.find("sk") != 0) {
         return Status::failure(
@@ -142,8 +161,9 @@ Status procGetSocketListPacket(int family,
       continue;
     }
 
-    auto fields = osquery::split(line, " ");
-    if (fields.size() < 9) {
+    std::array<std::string_view, 9> fields;
+    Tokenizer tokenizer(line, " ");
+    if (tokenizer.next(fields) < fields.size()) {
       VLOG(1) << "Invalid socket descriptor found: '" << line
               << "'. Skipping this entry";
       continue;
@@ -177,7 +197,10 @@ static Status procGetSocketListInet(int family,
                                     SocketInfoList& result) {
   // The system's socket information is tokenized by line.
   bool header = true;
-  for (const auto& line : osquery::split(content, "\n")) {
+  Tokenizer lines(content, "\n");
+  std::string_view line;
+  while (lines.next(line)) {
+    line = trim(line);
     if (header) {
       if (line.find("sl") != 0 && line.find("sk") != 0) {
         return Status(1, std::string("Invalid file header for ") + path);
@@ -187,18 +210,19 @@ static Status procGetSocketListInet(int family,
     }
 
     // The socket information is tokenized by spaces, each a field.
-    auto fields = osquery::split(line, " ");
-    if (fields.size() < 10) {
+    std::array<std::string_view, 10> fields;
+    Tokenizer tokenizer(line, " ");
+    if (tokenizer.next(fields) < fields.size()) {
       VLOG(1) << "Invalid socket descriptor found: '" << line
               << "'. Skipping this entry";
       continue;
     }
 
     // Two of the fields are the local/remote address/port pairs.
-    auto locals = osquery::split(fields[1], ":");
-    auto remotes = osquery::split(fields[2], ":");
-
-    if (locals.size() != 2 || remotes.size() != 2) {
+    std::array<std::string_view, 2> locals;
+    std::array<std::string_view, 2> remotes;
+    if (!splitAddressPort(fields[1], locals) ||
+        !splitAddressPort(fields[2], remotes)) {
       VLOG(1) << "Invalid socket descriptor found: '" << line
               << "'. Skipping this entry";
       continue;
@@ -215,12 +239,10 @@ static Status procGetSocketListInet(int family,
     socket_info.remote_port = procDecodeUnsignedShortFromHex(remotes[1]);
 
     if (protocol == IPPROTO_TCP) {
-      char* null_terminator_ptr = nullptr;
       auto integer_socket_state =
-          std::strtoull(fields[3].data(), &null_terminator_ptr, 16);
+          tryTo<std::uint64_t>(fields[3], 16).takeOr(std::uint64_t{0});
       if (integer_socket_state == 0 ||
-          integer_socket_state >= tcp_states.size() ||
-          null_terminator_ptr == nullptr || *null_terminator_ptr != 0) {
+          integer_socket_state >= tcp_states.size()) {
         socket_info.state = "UNKNOWN";
       } else {
         socket_info.state = tcp_states[integer_socket_state];
@@ -239,7 +261,10 @@ static Status procGetSocketListUnix(ino_t net_ns,
                                     SocketInfoList& result) {
   // The system's socket information is tokenized by line.
   bool header = true;
-  for (const auto& line : osquery::split(content, "\n")) {
+  Tokenizer lines(content, "\n");
+  std::string_view line;
+  while (lines.next(line)) {
+    line = trim(line);
     if (header) {
       if (line.find("Num") != 0) {
         return Status(1, std::string("Invalid file header for ") + path);
@@ -249,8 +274,9 @@ static Status procGetSocketListUnix(ino_t net_ns,
     }
 
     // The socket information is tokenized by spaces, each a field.
-    auto fields = osquery::split(line, " ");
-    if (fields.size() < 7) {
+    std::array<std::string_view, 8> fields;
+    Tokenizer tokenizer(line, " ");
+    if (tokenizer.next(fields) < 7) {
       VLOG(1) << "Invalid UNIX socket descriptor found: '" << line
               << "'. Skipping this entry";
       continue;
@@ -260,8 +286,8 @@ static Status procGetSocketListUnix(ino_t net_ns,
     socket_info.socket = fields[6];
     socket_info.net_ns = net_ns;
     socket_info.family = AF_UNIX;
-    socket_info.protocol = std::atoll(fields[2].data());
-    socket_info.unix_socket_path = (fields.size() >= 8) ? fields[7] : "";
+    socket_info.protocol = tryTo<int>(fields[2]).takeOr(0);
+    socket_info.unix_socket_path = fields[7];
 
     result.push_back(std::move(socket_info));
   }
@@ -412,9 +438,9 @@ Expected<std::uint64_t, ProcError> getProcRSS(const std::string& process) {
         "Failed to read statm: " + status.getMessage());
   }
 
-  auto statm_elements = osquery::split(statm_content, " ");
-
-  if (statm_elements.size() != kStatmElementsCount) {
+  std::array<std::string_view, kStatmElementsCount + 1> statm_elements;
+  Tokenizer tokenizer(trim(statm_content), " ");
+  if (tokenizer.next(statm_elements) != kStatmElementsCount) {
     return ProcExpected::failure(ProcError::GenericError,
                                  "statm has an unexpected format");
   }
@@ -9,6 +9,7 @@
 
 #pragma once
 
+#include <string_view>
 #include <unordered_map>
 
 #include <arpa/inet.h>
@@ -98,14 +99,14 @@ Status procReadDescriptor(const std::string& process,
 ///
 /// @param encoded_address The encoded address as a string.
 /// @param int The family to use to decode address (AF_INET, AF_INET6).
-std::string procDecodeAddressFromHex(const std::string& encoded_address,
+std::string procDecodeAddressFromHex(std::string_view encoded_address,
                                      int family);
 
 /// From an encoded unsigned short (host port, protocol), decode it and
 /// return it as an unsigned short
 ///
 /// @param encoded_port The encoded port as a string.
-unsigned short procDecodeUnsignedShortFromHex(const std::string& encoded_port);
+unsigned short procDecodeUnsignedShortFromHex(std::string_view encoded_port);
 
 /// Parse the contents issued from a /proc/net/packet file and fill the socket
 /// info list structure.
@@ -127,7 +128,7 @@ Status procGetNamespaceInode(ino_t& inode,
                              const std::string& namespace_name,
                              const std::string& process_namespace_root);
 
-std::string procDecodeAddressFromHex(const std::string& encoded_address,
+std::string procDecodeAddressFromHex(std::string_view encoded_address,
                                      int family);
 
 unsigned short procDecodePortFromHex(const std::string& encoded_port);
@@ -0,0 +1,205 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <osquery/filesystem/linux/sysfs.h>
+
+namespace osquery {
+namespace {
+
+/// Cached attributes are read again after this long.
+const std::chrono::milliseconds kSysfsAttributeTTL{1000};
+
+/// Attributes kept, the expired ones are dropped first.
+const size_t kMaxCachedAttributes = 4096;
+
+/// Sysfs attributes are at most one page.
+const size_t kMaxAttributeSize = 4096;
+
+/// The read size of pseudo files, which may be larger than a page.
+const size_t kPseudoFileChunk = 16384;
+
+using Clock = std::chrono::steady_clock;
+
+struct AttributeCache {
+  struct Entry {
+    std::string value;
+    Clock::time_point expires;
+  };
+
+  std::mutex mutex;
+  std::unordered_map<std::string, Entry> entries;
+
+  bool find(const std::string& path, std::string& value) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(path);
+    if (it == entries.end()) {
+      return false;
+    }
+
+    if (it->second.expires <= Clock::now()) {
+      entries.erase(it);
+      return false;
+    }
+    value = it->second.value;
+    return true;
+  }
+
+  void store(const std::string& path, const std::string& value) {
+    auto now = Clock::now();
+    std::lock_guard<std::mutex> lock(mutex);
+    if (entries.size() >= kMaxCachedAttributes) {
+      for (auto it = entries.begin(); it != entries.end();) {
+        it = (it->second.expires <= now) ? entries.erase(it) : std::next(it);
+      }
+      if (entries.size() >= kMaxCachedAttributes) {
+        entries.clear();
+      }
+    }
+    entries[path] = {value, now + kSysfsAttributeTTL};
+  }
+};
+
+AttributeCache& getAttributeCache() {
+  static AttributeCache cache;
+  return cache;
+}
+
+ssize_t readRetry(int fd, char* buffer, size_t size) {
+  ssize_t n;
+  do {
+    n = ::read(fd, buffer, size);
+  } while (n < 0 && errno == EINTR);
+  return n;
+}
+
+/// Read an attribute relative to a directory, or AT_FDCWD for a full path.
+Status readAttributeAt(int dirfd, const std::string& name, std::string& value) {
+  int fd = ::openat(dirfd, name.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return Status::failure("Cannot open " + name + ": " +
+                           std::string(std::strerror(errno)));
+  }
+
+  char buffer[kMaxAttributeSize];
+  size_t length = 0;
+  while (length < sizeof(buffer)) {
+    auto n = readRetry(fd, buffer + length, sizeof(buffer) - length);
+    if (n < 0) {
+      auto error = errno;
+      ::close(fd);
+      return Status::failure("Cannot read " + name + ": " +
+                             std::string(std::strerror(error)));
+    }
+    if (n == 0) {
+      break;
+    }
+    length += static_cast<size_t>(n);
+  }
+  ::close(fd);
+
+  if (length > 0 && buffer[length - 1] == '\n') {
+    --length;
+  }
+  value.assign(buffer, length);
+  return Status::success();
+}
+
+} // namespace
+
+SysfsDirectory::SysfsDirectory(const std::string& path) : path_(path) {
+  fd_ = ::open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+}
+
+SysfsDirectory::~SysfsDirectory() {
+  if (fd_ >= 0) {
+    ::close(fd_);
+  }
+}
+
+Status SysfsDirectory::read(const std::string& name, std::string& value) const {
+  if (fd_ < 0) {
+    return Status::failure("Cannot open " + path_);
+  }
+
+  auto& cache = getAttributeCache();
+  auto key = path_ + '/' + name;
+  if (cache.find(key, value)) {
+    return Status::success();
+  }
+
+  auto status = readAttributeAt(fd_, name, value);
+  if (status.ok()) {
+    cache.store(key, value);
+  }
+  return status;
+}
+
+std::string SysfsDirectory::get(const std::string& name) const {
+  std::string value;
+  if (!read(name, value).ok()) {
+    value.clear();
+  }
+  return value;
+}
+
+Status readSysfsAttribute(const std::string& path, std::string& value) {
+  auto& cache = getAttributeCache();
+  if (cache.find(path, value)) {
+    return Status::success();
+  }
+
+  auto status = readAttributeAt(AT_FDCWD, path, value);
+  if (status.ok()) {
+    cache.store(path, value);
+  }
+  return status;
+}
+
+Status readPseudoFile(const std::string& path, std::string& content) {
+  content.clear();
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return Status::failure("Cannot open " + path + ": " +
+                           std::string(std::strerror(errno)));
+  }
+
+  char buffer[kPseudoFileChunk];
+  while (true) {
+    auto n = readRetry(fd, buffer, sizeof(buffer));
+    if (n < 0) {
+      auto error = errno;
+      ::close(fd);
+      return Status::failure("Cannot read " + path + ": " +
+                             std::string(std::strerror(error)));
+    }
+    if (n == 0) {
+      break;
+    }
+    content.append(buffer, static_cast<size_t>(n));
+  }
+  ::close(fd);
+  return Status::success();
+}
+
+void clearSysfsAttributeCache() {
+  auto& cache = getAttributeCache();
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  cache.entries.clear();
+}
+
+} // namespace osquery
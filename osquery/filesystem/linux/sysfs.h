@@ -0,0 +1,74 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <string>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/**
+ * @brief A directory of sysfs attributes, such as the directory of a device.
+ *
+ * The directory is opened once and each attribute is opened relative to it,
+ * without walking the full path again. Attributes are small, they are read
+ * into a stack buffer without a stat and their values are shared through a
+ * short-lived cache, tables joined in a query or scheduled together read
+ * each attribute once.
+ */
+class SysfsDirectory : private boost::noncopyable {
+ public:
+  explicit SysfsDirectory(const std::string& path);
+
+  ~SysfsDirectory();
+
+  /// The directory could be opened.
+  bool isOpen() const {
+    return fd_ >= 0;
+  }
+
+  const std::string& path() const {
+    return path_;
+  }
+
+  /**
+   * @brief Read an attribute of the directory.
+   *
+   * @param name the attribute relative to the directory, e.g. "queue/size".
+   * @param value the attribute content without the trailing newline.
+   */
+  Status read(const std::string& name, std::string& value) const;
+
+  /// Read an attribute, an empty string if it cannot be read.
+  std::string get(const std::string& name) const;
+
+ private:
+  std::string path_;
+  int fd_{-1};
+};
+
+/// Read a single sysfs attribute through the attribute cache.
+Status readSysfsAttribute(const std::string& path, std::string& value);
+
+/**
+ * @brief Read a complete procfs or sysfs file.
+ *
+ * These files report a size of 0 or of a page, they are read until the end
+ * through a stack buffer instead of being sized first.
+ */
+Status readPseudoFile(const std::string& path, std::string& content);
+
+/// Forget every cached attribute.
+void clearSysfsAttributeCache();
+
+} // namespace osquery
@@ -101,4 +101,47 @@ TEST_F(PlistTests, test_parse_plist_content_with_blobs) {
   // Verify we parsed the binary blob correctly
   EXPECT_NE(alias.find("Applications/Flux.app"), std::string::npos);
 }
+
+TEST_F(PlistTests, test_parse_plist_cached) {
+  auto directory = fs::temp_directory_path() /
+                   fs::unique_path("osquery.tests.plist.%%%%.%%%%");
+  fs::create_directories(directory);
+  auto path = directory / "test.plist";
+  fs::copy_file(getTestConfigDirectory() / "test.plist", path);
+
+  size_t projections = 0;
+  auto projection = [&projections](const pt::ptree& tree,
+                                   pt::ptree& projected) {
+    projections++;
+    projected.put("Label", tree.get<std::string>("Label", ""));
+  };
+
+  PlistTreeRef first;
+  ASSERT_TRUE(parsePlistCached("test", path, projection, first).ok());
+  ASSERT_NE(first, nullptr);
+  EXPECT_EQ(first->get<std::string>("Label"), "com.apple.FileSyncAgent.sshd");
+  EXPECT_EQ(first->count("Disabled"), 0U);
+
+  // The unchanged property list is not parsed again.
+  PlistTreeRef second;
+  ASSERT_TRUE(parsePlistCached("test", path, projection, second).ok());
+  EXPECT_EQ(projections, 1U);
+  EXPECT_EQ(first, second);
+
+  // A property list rewritten through a rename has a new inode.
+  fs::copy_file(getTestConfigDirectory() / "test.plist", directory / "new");
+  fs::rename(directory / "new", path);
+
+  std::vector<std::string> paths = {path.string(),
+                                    (directory / "missing").string()};
+  std::vector<PlistTreeRef> trees;
+  parsePlistsCached("test", paths, projection, trees);
+  ASSERT_EQ(trees.size(), 2U);
+  EXPECT_EQ(projections, 2U);
+  ASSERT_NE(trees[0], nullptr);
+  EXPECT_NE(trees[0], first);
+  EXPECT_EQ(trees[1], nullptr);
+
+  fs::remove_all(directory);
+}
 }
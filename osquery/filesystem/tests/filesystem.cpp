@@ -300,6 +300,44 @@ TEST_F(FilesystemTests, test_read_size) {
   EXPECT_EQ(content.size(), s);
 }
 
+TEST_F(FilesystemTests, test_read_file_batch) {
+  // Enough files for the batch to be read by several threads.
+  std::vector<BatchFileRead> files;
+  for (size_t i = 0; i < 300; i++) {
+    auto file_path = test_working_dir_ / ("batch" + std::to_string(i));
+    writeTextFile(file_path, std::to_string(i));
+
+    BatchFileRead file;
+    file.path = file_path.string();
+    files.push_back(std::move(file));
+  }
+
+  BatchFileRead missing;
+  missing.path = (test_working_dir_ / "batch_missing").string();
+  files.push_back(std::move(missing));
+
+  readFileBatch(files);
+  for (size_t i = 0; i < 300; i++) {
+    EXPECT_TRUE(files[i].status.ok());
+    EXPECT_EQ(files[i].content, std::to_string(i));
+  }
+  EXPECT_FALSE(files.back().status.ok());
+  EXPECT_TRUE(files.back().content.empty());
+
+  // Pseudo-files report no size and are read to their end.
+  std::vector<BatchFileRead> proc(1);
+  proc[0].path = "/proc/self/status";
+  readFileBatch(proc);
+  if (isPlatform(PlatformType::TYPE_LINUX)) {
+    EXPECT_TRUE(proc[0].status.ok());
+    EXPECT_NE(proc[0].content.find("Name:"), std::string::npos);
+  }
+
+  for (size_t i = 0; i < 300; i++) {
+    removePath(files[i].path);
+  }
+}
+
 TEST_F(FilesystemTests, test_list_files_missing_directory) {
   std::vector<std::string> results;
   auto status = listFilesInDirectory("/foo/bar", results);
@@ -951,4 +989,56 @@ TEST_F(FilesystemTests, test_directory_listing_with_legacy_logic) {
   deleteDirectoryContent(test_root_work_dirs);
 }
 
+TEST_F(FilesystemTests, test_compression_options) {
+  std::string content;
+  for (size_t i = 0; i < 50000; ++i) {
+    content += "line " + std::to_string(i % 97) + " of a rotated log\n";
+  }
+
+  auto source = test_working_dir_ / "source.log";
+  ASSERT_TRUE(writeTextFile(source, content).ok());
+
+  for (size_t workers : {0, 2}) {
+    CompressionOptions options;
+    options.level = 3;
+    options.workers = workers;
+
+    auto compressed = test_working_dir_ / "source.log.zst";
+    auto restored = test_working_dir_ / "restored.log";
+    ASSERT_TRUE(compress(source, compressed, options).ok());
+    EXPECT_LT(fs::file_size(compressed), content.size());
+    ASSERT_TRUE(decompress(compressed, restored).ok());
+
+    std::string restored_content;
+    ASSERT_TRUE(readFile(restored, restored_content).ok());
+    EXPECT_EQ(restored_content, content);
+  }
+
+  // Chunks are received in order, whatever the chunking of the content.
+  ZstdCompressor compressor;
+  ASSERT_TRUE(compressor.init(CompressionOptions()).ok());
+  std::string streamed;
+  auto sink = [&streamed](const char* data, size_t size) {
+    streamed.append(data, size);
+    return Status::success();
+  };
+  for (size_t offset = 0; offset < content.size(); offset += 7000) {
+    auto size = std::min<size_t>(7000, content.size() - offset);
+    ASSERT_TRUE(compressor.write(content.data() + offset, size, sink).ok());
+  }
+  ASSERT_TRUE(compressor.finish(sink).ok());
+
+  auto compressed = test_working_dir_ / "streamed.zst";
+  auto restored = test_working_dir_ / "streamed.log";
+  ASSERT_TRUE(writeTextFile(compressed, streamed).ok());
+  ASSERT_TRUE(decompress(compressed, restored).ok());
+  std::string restored_content;
+  ASSERT_TRUE(readFile(restored, restored_content).ok());
+  EXPECT_EQ(restored_content, content);
+
+  EXPECT_EQ(getCompressionWorkers(0), 0U);
+  EXPECT_GE(getCompressionWorkers(1024), 1U);
+  EXPECT_LE(getCompressionWorkers(1024), 1024U);
+}
+
 } // namespace osquery
@@ -0,0 +1,49 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+
+#include <gtest/gtest.h>
+
+#include <osquery/filesystem/linux/mounts.h>
+
+namespace osquery {
+namespace {
+
+class MountsTests : public testing::Test {};
+
+bool hasRootMount(const MountedFilesystems& mounted_fs) {
+  return std::any_of(mounted_fs.begin(),
+                     mounted_fs.end(),
+                     [](const MountInformation& mount_info) {
+                       return mount_info.path == "/";
+                     });
+}
+
+TEST_F(MountsTests, test_get_mounted_filesystems) {
+  MountedFilesystems mounted_fs;
+  ASSERT_TRUE(getMountedFilesystems(mounted_fs, false).ok());
+  ASSERT_TRUE(hasRootMount(mounted_fs));
+  for (const auto& mount_info : mounted_fs) {
+    EXPECT_FALSE(mount_info.optional_statfs_info.is_initialized());
+  }
+
+  // The cached table is returned until a mount changes.
+  MountedFilesystems cached_fs;
+  ASSERT_TRUE(getMountedFilesystems(cached_fs).ok());
+  ASSERT_EQ(cached_fs.size(), mounted_fs.size());
+  for (const auto& mount_info : cached_fs) {
+    if (mount_info.path == "/") {
+      EXPECT_TRUE(mount_info.optional_statfs_info.is_initialized());
+    }
+  }
+}
+
+} // namespace
+} // namespace osquery
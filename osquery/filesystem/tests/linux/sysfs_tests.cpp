@@ -0,0 +1,95 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <gtest/gtest.h>
+
+#include <boost/filesystem.hpp>
+
+#include <osquery/filesystem/filesystem.h>
+#include <osquery/filesystem/linux/sysfs.h>
+
+namespace fs = boost::filesystem;
+
+namespace osquery {
+namespace {
+
+class SysfsTests : public testing::Test {
+ protected:
+  void SetUp() override {
+    directory_ =
+        fs::temp_directory_path() / fs::unique_path("osquery.sysfs.%%%%.%%%%");
+    fs::create_directories(directory_ / "queue");
+    clearSysfsAttributeCache();
+  }
+
+  void TearDown() override {
+    fs::remove_all(directory_);
+    clearSysfsAttributeCache();
+  }
+
+  void writeAttribute(const std::string& name, const std::string& content) {
+    ASSERT_TRUE(writeTextFile((directory_ / name).string(), content).ok());
+  }
+
+  fs::path directory_;
+};
+
+TEST_F(SysfsTests, test_read_relative) {
+  writeAttribute("size", "2048\n");
+  writeAttribute("queue/logical_block_size", "512\n");
+
+  SysfsDirectory device(directory_.string());
+  ASSERT_TRUE(device.isOpen());
+
+  std::string value;
+  ASSERT_TRUE(device.read("size", value).ok());
+  EXPECT_EQ(value, "2048");
+  EXPECT_EQ(device.get("queue/logical_block_size"), "512");
+
+  EXPECT_FALSE(device.read("missing", value).ok());
+  EXPECT_EQ(device.get("missing"), "");
+
+  SysfsDirectory missing((directory_ / "missing").string());
+  EXPECT_FALSE(missing.isOpen());
+  EXPECT_FALSE(missing.read("size", value).ok());
+}
+
+TEST_F(SysfsTests, test_read_cached) {
+  writeAttribute("size", "1\n");
+  auto path = (directory_ / "size").string();
+
+  std::string value;
+  ASSERT_TRUE(readSysfsAttribute(path, value).ok());
+  EXPECT_EQ(value, "1");
+
+  // A change is seen once the cached value expires or is cleared.
+  writeAttribute("size", "2\n");
+  ASSERT_TRUE(readSysfsAttribute(path, value).ok());
+  EXPECT_EQ(value, "1");
+
+  clearSysfsAttributeCache();
+  ASSERT_TRUE(readSysfsAttribute(path, value).ok());
+  EXPECT_EQ(value, "2");
+}
+
+TEST_F(SysfsTests, test_read_pseudo_file) {
+  // Larger than a single read.
+  std::string content(40000, 'a');
+  content += "\nlast\n";
+  writeAttribute("stat", content);
+
+  std::string read;
+  ASSERT_TRUE(readPseudoFile((directory_ / "stat").string(), read).ok());
+  EXPECT_EQ(read, content);
+
+  EXPECT_FALSE(readPseudoFile((directory_ / "missing").string(), read).ok());
+}
+
+} // namespace
+} // namespace osquery
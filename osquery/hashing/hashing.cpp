@@ -16,6 +16,8 @@
 #include <openssl/md5.h>
 #include <openssl/sha.h>
 
+#include <boost/filesystem.hpp>
+
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/hashing/hashing.h>
 #include <osquery/utils/base64.h>
@@ -25,7 +27,7 @@
 namespace osquery {
 
 /// The buffer read size from file IO to hashing structures.
-const size_t kHashChunkSize{4096};
+const size_t kHashChunkSize{256 * 1024};
 
 Hash::~Hash() {
   if (ctx_ != nullptr) {
@@ -103,22 +105,25 @@ std::string hashFromBuffer(HashType hash_type,
 }
 
 MultiHashes hashMultiFromFile(int mask, const std::string& path) {
-  std::map<HashType, std::shared_ptr<Hash>> hashes = {
-      {HASH_TYPE_MD5, std::make_shared<Hash>(HASH_TYPE_MD5)},
-      {HASH_TYPE_SHA1, std::make_shared<Hash>(HASH_TYPE_SHA1)},
-      {HASH_TYPE_SHA256, std::make_shared<Hash>(HASH_TYPE_SHA256)},
-  };
+  // Only the requested digests are computed, each chunk is read once.
+  std::map<HashType, std::shared_ptr<Hash>> hashes;
+  for (auto type : {HASH_TYPE_MD5, HASH_TYPE_SHA1, HASH_TYPE_SHA256}) {
+    if (mask & type) {
+      hashes[type] = std::make_shared<Hash>(type);
+    }
+  }
 
-  auto blocking = isPlatform(PlatformType::TYPE_WINDOWS);
+  // Regular files are read in chunks, instead of at once, with blocking IO.
+  boost::system::error_code ec;
+  auto blocking = isPlatform(PlatformType::TYPE_WINDOWS) ||
+                  boost::filesystem::is_regular_file(path, ec);
   auto s = readFile(path,
                     0,
                     kHashChunkSize,
                     false,
-                    ([&hashes, &mask](std::string& buffer, size_t size) {
+                    ([&hashes](std::string& buffer, size_t size) {
                       for (auto& hash : hashes) {
-                        if (mask & hash.first) {
-                          hash.second->update(&buffer[0], size);
-                        }
+                        hash.second->update(&buffer[0], size);
                       }
                     }),
                     blocking);
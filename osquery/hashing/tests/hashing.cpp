@@ -66,6 +66,35 @@ TEST_F(HashingFilesystemTests, test_multi_hashing_file) {
             kHelloSHA256Digest);
 }
 
+TEST_F(HashingFilesystemTests, test_multi_hashing_mask) {
+  auto file_path = test_working_dir_ / "hashing_chunks.bin";
+
+  // The content spans several read chunks.
+  std::string content;
+  for (size_t i = 0; i < 1024 * 1024 + 7; i++) {
+    content.push_back(static_cast<char>(i % 251));
+  }
+
+  std::ofstream test_file(file_path.string(), std::ios::binary);
+  test_file.write(content.c_str(), content.length());
+  test_file.close();
+
+  auto hashes = hashMultiFromFile(HASH_TYPE_SHA256, file_path.string());
+  EXPECT_EQ(hashes.mask, HASH_TYPE_SHA256);
+  EXPECT_TRUE(hashes.md5.empty());
+  EXPECT_TRUE(hashes.sha1.empty());
+  EXPECT_EQ(hashes.sha256,
+            hashFromBuffer(HASH_TYPE_SHA256, content.data(), content.size()));
+
+  hashes = hashMultiFromFile(HASH_TYPE_MD5 | HASH_TYPE_SHA1,
+                             file_path.string());
+  EXPECT_EQ(hashes.md5,
+            hashFromBuffer(HASH_TYPE_MD5, content.data(), content.size()));
+  EXPECT_EQ(hashes.sha1,
+            hashFromBuffer(HASH_TYPE_SHA1, content.data(), content.size()));
+  EXPECT_TRUE(hashes.sha256.empty());
+}
+
 TEST(HashingTests, test_hashing_md5) {
   Hash hash(HASH_TYPE_MD5);
   hash.update(kHelloString.c_str(), kHelloString.length());
@@ -125,10 +125,10 @@ Status logSnapshotQuery(const QueryLogItem& item);
 void relayStatusLogs(LoggerRelayMode relay_mode = LoggerRelayMode::Sync);
 
 /**
- * @brief Waits for the relay thread to finish
+ * @brief Waits for the status log relay to finish
  *
- * Waits for the new relay thread launched by the relayStatusLogs function,
- * called previously on the current thread, to finish.
+ * An asynchronous relayStatusLogs requests a relay from the status log relay
+ * service. This waits for the relays requested so far to complete.
  * Must not be called in a path that can be called by Google Log.
  */
 void waitLogRelay();
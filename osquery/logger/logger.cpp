@@ -12,8 +12,9 @@
 #endif
 
 #include <algorithm>
-#include <future>
-#include <optional>
+#include <condition_variable>
+#include <deque>
+#include <map>
 #include <queue>
 #include <thread>
 
@@ -23,7 +24,9 @@
 #include <osquery/core/plugins/logger.h>
 #include <osquery/core/system.h>
 #include <osquery/database/database.h>
+#include <osquery/dispatcher/dispatcher.h>
 #include <osquery/events/eventfactory.h>
+#include <osquery/events/mpsc_ring_buffer.h>
 #include <osquery/extensions/extensions.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/data_logger.h>
@@ -82,7 +85,26 @@ HIDDEN_FLAG(bool,
             false,
             "Always send status logs synchronously");
 
-DECLARE_bool(enable_numeric_monitoring);
+FLAG(uint32,
+     logger_status_buffer_size,
+     8192,
+     "Status log lines buffered until they are relayed, more are dropped");
+
+FLAG(uint64,
+     logger_queue_size,
+     0,
+     "Queue up to this many logs for each logger plugin and send them from a "
+     "thread per plugin (0 = send from the logging thread)");
+
+FLAG(string,
+     logger_queue_drop,
+     "",
+     "Comma-separated logger plugins that drop logs when their queue is full");
+
+FLAG(string,
+     logger_event_stream,
+     "",
+     "Comma-separated logger plugins receiving each event row as it is added");
 
 /**
  * @brief Logger plugin registry.
@@ -108,6 +130,11 @@ CREATE_REGISTRY(LoggerPlugin, "logger");
  * throughout the life of the process for two reasons: (1) It makes sense when
  * the active logger plugin is handling Glog status logs and (2) it must remove
  * itself as a Glog target.
+ *
+ * The status logs are buffered in a bounded lock-free ring, a logging thread
+ * never waits on another logging thread or on the relay. When the ring is
+ * full the status log is dropped and counted, and the relay reports the
+ * count with the next status logs.
  */
 class BufferedLogSink : public google::LogSink, private boost::noncopyable {
  public:
@@ -123,12 +150,21 @@ class BufferedLogSink : public google::LogSink, private boost::noncopyable {
             const char* message,
             size_t message_len) override;
 
-  /// Pop from the async sender queue and wait for one send to complete.
+  /// Wait for the relay requested by this thread's last send to complete.
   void WaitTillSent() override;
 
  public:
-  /// Accessor/mutator to dump all of the buffered logs.
-  std::vector<StatusLogLine>& dump();
+  /**
+   * @brief Move the buffered logs, and a line counting dropped logs, to logs.
+   *
+   * Only one thread at a time pops from the ring. A caller relaying the logs
+   * must not hold the pop lock while calling into logger plugins, since they
+   * may log.
+   */
+  void dump(std::vector<StatusLogLine>& logs);
+
+  /// Count the buffered logs.
+  size_t queued() const;
 
   /// Add the buffered log sink to Glog.
   void enable();
@@ -160,14 +196,23 @@ class BufferedLogSink : public google::LogSink, private boost::noncopyable {
 
  private:
   /// Create the log sink as buffering or forwarding.
-  BufferedLogSink() = default;
+  BufferedLogSink();
 
   /// Stop the log sink.
   ~BufferedLogSink();
 
  private:
-  /// Intermediate log storage until an osquery logger is initialized.
-  std::vector<StatusLogLine> logs_;
+  /// Intermediate log storage until the logs are relayed.
+  MpscRingBuffer<StatusLogLine> logs_;
+
+  /// Serializes the consumers of the ring.
+  std::mutex dump_mutex_;
+
+  /// The number of buffered logs.
+  std::atomic<size_t> queued_{0};
+
+  /// The number of logs dropped since the last dump.
+  std::atomic<size_t> dropped_{0};
 
   /**
    * @Brief Is the logger temporarily disabled.
@@ -181,11 +226,92 @@ class BufferedLogSink : public google::LogSink, private boost::noncopyable {
   std::vector<std::string> sinks_;
 };
 
-/// Mutex protecting accesses to buffered status logs.
-Mutex kBufferedLogSinkLogs;
+/**
+ * @brief A service relaying the buffered status logs to the logger plugins.
+ *
+ * Relays are requested by the scheduler, and by each status log outside of
+ * the daemon. A relay sends the buffered logs until the ring is empty, so the
+ * status logs of the logger plugins themselves are sent by the same relay.
+ */
+class StatusLogRelayRunner : public InternalRunnable {
+ public:
+  StatusLogRelayRunner()
+      : InternalRunnable("StatusLogRelayRunner", ThreadClass::Logger) {}
+
+  /// Request a relay, returns 0 if the runner stopped.
+  uint64_t request();
+
+  /// Wait until the relay of a request completed, or the runner ended.
+  void wait(uint64_t request);
 
-/// Used to wait on the thread that defers relaying the buffered status logs
-thread_local std::optional<std::future<void>> kOptBufferedLogSinkSender;
+  /// Wait for at most a duration, see the Windows note in WaitTillSent.
+  void waitFor(uint64_t request, std::chrono::microseconds duration);
+
+  /// The last relay requested, 0 if none was.
+  uint64_t lastRequest();
+
+  /// Check if the runner accepts requests.
+  bool running();
+
+ protected:
+  void start() override;
+
+  void stop() override;
+
+ private:
+  /// Protects the request counters and the runner state.
+  std::mutex mutex_;
+
+  /// Notified when a relay is requested or completed, or the runner stops.
+  std::condition_variable changed_;
+
+  uint64_t requested_{0};
+
+  uint64_t completed_{0};
+
+  bool stopped_{false};
+
+  bool ended_{false};
+};
+
+/// Protects the status log relay runner.
+Mutex kStatusLogRelayMutex;
+
+/// The status log relay runner, started when status logs are forwarded.
+std::shared_ptr<StatusLogRelayRunner> kStatusLogRelay;
+
+/// Set on the relay thread, which must not wait on itself.
+thread_local bool kIsStatusLogRelay{false};
+
+/// The relay requested by this thread's last status log.
+thread_local uint64_t kStatusLogRelayRequest{0};
+
+std::shared_ptr<StatusLogRelayRunner> getStatusLogRelay() {
+  ReadLock lock(kStatusLogRelayMutex);
+  return kStatusLogRelay;
+}
+
+/// Start the relay runner, unless it is running.
+void startStatusLogRelay() {
+  WriteLock lock(kStatusLogRelayMutex);
+  if (kStatusLogRelay != nullptr && kStatusLogRelay->running()) {
+    return;
+  }
+
+  auto runner = std::make_shared<StatusLogRelayRunner>();
+  if (Dispatcher::addService(runner).ok()) {
+    kStatusLogRelay = runner;
+  }
+}
+
+/// Request a relay from the runner, returns 0 if it is not running.
+uint64_t requestStatusLogRelay() {
+  auto runner = getStatusLogRelay();
+  return (runner != nullptr) ? runner->request() : 0;
+}
+
+/// Send the buffered status logs to the logger plugins forwarding them.
+void sendStatusLogs();
 
 static void serializeIntermediateLog(const std::vector<StatusLogLine>& log,
                                      PluginRequest& request) {
@@ -265,6 +391,7 @@ void initLogger(const std::string& name) {
   PluginRequest init_request = {{"init", name}};
   PluginRequest features_request = {{"action", "features"}};
   auto logger_plugin = RegistryFactory::get().getActive("logger");
+  auto event_stream = osquery::split(FLAGS_logger_event_stream, ",");
   // Allow multiple loggers, make sure each is accessible.
   for (const auto& logger : osquery::split(logger_plugin, ",")) {
     if (!RegistryFactory::get().exists("logger", logger)) {
@@ -281,7 +408,9 @@ void initLogger(const std::string& name) {
       BufferedLogSink::get().addPlugin(logger);
     }
 
-    if ((status.getCode() & LOGGER_FEATURE_LOGEVENT) > 0) {
+    if ((status.getCode() & LOGGER_FEATURE_LOGEVENT) > 0 ||
+        std::find(event_stream.begin(), event_stream.end(), logger) !=
+            event_stream.end()) {
       EventFactory::addForwarder(logger);
     }
   }
@@ -289,10 +418,14 @@ void initLogger(const std::string& name) {
   if (forward) {
     // Begin forwarding after all plugins have been set up.
     BufferedLogSink::get().enable();
+    startStatusLogRelay();
     relayStatusLogs(LoggerRelayMode::Sync);
   }
 }
 
+BufferedLogSink::BufferedLogSink()
+    : logs_(std::max<uint32_t>(FLAGS_logger_status_buffer_size, 1)) {}
+
 BufferedLogSink& BufferedLogSink::get() {
   static BufferedLogSink sink;
   return sink;
@@ -315,28 +448,42 @@ void BufferedLogSink::send(google::LogSeverity severity,
                            size_t message_len) {
   // WARNING, be extremely careful when accessing data here.
   // This should not cause any persistent storage or logging actions.
-  {
-    WriteLock lock(kBufferedLogSinkLogs);
-    logs_.push_back({(StatusLogSeverity)severity,
-                     std::string(base_filename),
-                     static_cast<size_t>(line),
-                     std::string(message, message_len),
-                     toAsciiTimeUTC(tm_time),
-                     toUnixTime(tm_time),
-                     std::string()});
+  StatusLogLine log{(StatusLogSeverity)severity,
+                    std::string(base_filename),
+                    static_cast<size_t>(line),
+                    std::string(message, message_len),
+                    toAsciiTimeUTC(tm_time),
+                    toUnixTime(tm_time),
+                    std::string()};
+  if (logs_.tryPush(log)) {
+    ++queued_;
+  } else {
+    ++dropped_;
   }
 
   // This is for testing only, the daemon will relay according to the schedule.
   if (enabled_ && !isDaemon()) {
-    relayStatusLogs(FLAGS_logger_status_sync ? LoggerRelayMode::Sync
-                                             : LoggerRelayMode::Async);
+    if (FLAGS_logger_status_sync) {
+      relayStatusLogs(LoggerRelayMode::Sync);
+    } else if (databaseInitialized()) {
+      // The runner is not started from here, the dispatcher may log.
+      auto request = requestStatusLogRelay();
+      if (!kIsStatusLogRelay) {
+        kStatusLogRelayRequest = request;
+      }
+    }
   }
 }
 
 void BufferedLogSink::WaitTillSent() {
-  if (kOptBufferedLogSinkSender.has_value()) {
+  if (kStatusLogRelayRequest == 0) {
+    return;
+  }
+
+  auto runner = getStatusLogRelay();
+  if (runner != nullptr) {
     if (!isPlatform(PlatformType::TYPE_WINDOWS)) {
-      kOptBufferedLogSinkSender->wait();
+      runner->wait(kStatusLogRelayRequest);
     } else {
       /* We cannot wait indefinitely because glog doesn't use read/write locks
         on Windows. When we are in a recursive logging situation, there's a
@@ -345,14 +492,36 @@ void BufferedLogSink::WaitTillSent() {
         (sink_mutex_), instead of in read mode only. The new thread needs to be
         able to acquire the same lock to log the message though,
         so unless this thread yields, we end up in a deadlock. */
-      kOptBufferedLogSinkSender->wait_for(std::chrono::microseconds(100));
+      runner->waitFor(kStatusLogRelayRequest, std::chrono::microseconds(100));
     }
-    kOptBufferedLogSinkSender.reset();
   }
+  kStatusLogRelayRequest = 0;
 }
 
-std::vector<StatusLogLine>& BufferedLogSink::dump() {
-  return logs_;
+void BufferedLogSink::dump(std::vector<StatusLogLine>& logs) {
+  std::lock_guard<std::mutex> lock(dump_mutex_);
+  StatusLogLine log;
+  while (logs_.tryPop(log)) {
+    --queued_;
+    logs.push_back(std::move(log));
+  }
+
+  auto dropped = dropped_.exchange(0);
+  if (dropped > 0) {
+    logs.push_back({O_WARNING,
+                    "logger.cpp",
+                    static_cast<size_t>(__LINE__),
+                    "Dropped " + std::to_string(dropped) +
+                        " status logs, the logger_status_buffer_size of " +
+                        std::to_string(logs_.capacity()) + " lines was full",
+                    getAsciiTime(),
+                    getUnixTime(),
+                    std::string()});
+  }
+}
+
+size_t BufferedLogSink::queued() const {
+  return queued_;
 }
 
 void BufferedLogSink::addPlugin(const std::string& name) {
@@ -371,6 +540,201 @@ BufferedLogSink::~BufferedLogSink() {
   enabled_ = false;
 }
 
+namespace {
+
+Status sendString(const std::string& logger,
+                  const std::string& message,
+                  const std::string& category) {
+  if (Registry::get().exists("logger", logger, true)) {
+    auto plugin = Registry::get().plugin("logger", logger);
+    auto logger_plugin = std::dynamic_pointer_cast<LoggerPlugin>(plugin);
+    return logger_plugin->logString(message);
+  }
+  return Registry::call(
+      "logger", logger, {{"string", message}, {"category", category}});
+}
+
+Status sendSnapshot(const std::string& logger, const std::string& json) {
+  if (Registry::get().exists("logger", logger, true)) {
+    auto plugin = Registry::get().plugin("logger", logger);
+    auto logger_plugin = std::dynamic_pointer_cast<LoggerPlugin>(plugin);
+    return logger_plugin->logSnapshot(json);
+  }
+  return Registry::call("logger", logger, {{"snapshot", json}});
+}
+
+/// A result or snapshot log waiting to be sent to one logger plugin.
+struct QueuedLog {
+  /// The serialized log, shared by the queues of every logger plugin.
+  std::shared_ptr<const std::string> message;
+
+  std::string category;
+  bool snapshot{false};
+};
+
+/**
+ * @brief A service sending the queued logs of one logger plugin.
+ *
+ * Each logger plugin has its own queue and thread, a slow plugin only delays
+ * its own logs and the logging threads pay an enqueue. When the queue is full
+ * the logging thread waits, unless the plugin is listed in logger_queue_drop.
+ * Logs still queued when the service is interrupted are sent before it ends.
+ */
+class LoggerQueueRunner : public InternalRunnable {
+ public:
+  explicit LoggerQueueRunner(const std::string& logger)
+      : InternalRunnable("LoggerQueueRunner." + logger, ThreadClass::Logger),
+        logger_(logger),
+        depth_metric_("logger." + logger + ".queue.depth",
+                      monitoring::PreAggregationType::Max),
+        dropped_metric_("logger." + logger + ".queue.dropped",
+                        monitoring::PreAggregationType::Sum) {}
+
+  /// Queue a log, returns false if the runner stopped and did not take it.
+  bool push(QueuedLog log, bool drop);
+
+  /// Check if the runner stopped accepting logs.
+  bool stopped() {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    return stopped_;
+  }
+
+ protected:
+  void start() override;
+
+  void stop() override;
+
+ private:
+  const std::string logger_;
+
+  const monitoring::Metric depth_metric_;
+
+  const monitoring::Metric dropped_metric_;
+
+  /// Protects the queue and stopped state.
+  std::mutex queue_mutex_;
+
+  /// Notified when logs are queued or sent, or the runner stops.
+  std::condition_variable queue_changed_;
+
+  std::deque<QueuedLog> queue_;
+
+  bool stopped_{false};
+};
+
+bool LoggerQueueRunner::push(QueuedLog log, bool drop) {
+  auto capacity = std::max<uint64_t>(FLAGS_logger_queue_size, 1);
+  size_t depth = 0;
+  bool dropped = false;
+  {
+    std::unique_lock<std::mutex> lock(queue_mutex_);
+    if (!drop) {
+      queue_changed_.wait(
+          lock, [&] { return stopped_ || queue_.size() < capacity; });
+    }
+    if (stopped_) {
+      return false;
+    }
+
+    dropped = queue_.size() >= capacity;
+    if (!dropped) {
+      queue_.push_back(std::move(log));
+    }
+    depth = queue_.size();
+  }
+  queue_changed_.notify_all();
+
+  depth_metric_.record(static_cast<monitoring::ValueType>(depth));
+  if (dropped) {
+    dropped_metric_.record(1);
+  }
+  return true;
+}
+
+void LoggerQueueRunner::start() {
+  std::deque<QueuedLog> logs;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(queue_mutex_);
+      queue_changed_.wait(lock, [this] { return stopped_ || !queue_.empty(); });
+      if (queue_.empty()) {
+        break;
+      }
+      logs.swap(queue_);
+    }
+    // Waiting logging threads may queue while these are sent.
+    queue_changed_.notify_all();
+
+    for (const auto& log : logs) {
+      auto status = log.snapshot
+                        ? sendSnapshot(logger_, *log.message)
+                        : sendString(logger_, *log.message, log.category);
+      if (!status.ok()) {
+        VLOG(1) << "Error sending queued log to " << logger_ << ": "
+                << status.getMessage();
+      }
+    }
+    logs.clear();
+  }
+}
+
+void LoggerQueueRunner::stop() {
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    stopped_ = true;
+  }
+  queue_changed_.notify_all();
+}
+
+/// Protects the queue runner of each logger plugin.
+Mutex kLoggerQueuesMutex;
+
+/// The queue runner of each logger plugin, started by its first log.
+std::map<std::string, std::shared_ptr<LoggerQueueRunner>> kLoggerQueues;
+
+/**
+ * @brief Queue a log for a logger plugin when logger_queue_size is set.
+ *
+ * Returns false if the log was not queued and must be sent by the caller, for
+ * example when the dispatcher is stopping.
+ */
+bool queueLog(const std::string& logger, QueuedLog log) {
+  if (FLAGS_logger_queue_size == 0 ||
+      !Registry::get().exists("logger", logger)) {
+    return false;
+  }
+
+  std::shared_ptr<LoggerQueueRunner> runner;
+  {
+    ReadLock lock(kLoggerQueuesMutex);
+    auto it = kLoggerQueues.find(logger);
+    if (it != kLoggerQueues.end() && !it->second->stopped()) {
+      runner = it->second;
+    }
+  }
+
+  if (runner == nullptr) {
+    WriteLock lock(kLoggerQueuesMutex);
+    auto& queue = kLoggerQueues[logger];
+    if (queue == nullptr || queue->stopped()) {
+      queue = std::make_shared<LoggerQueueRunner>(logger);
+      if (!Dispatcher::addService(queue).ok()) {
+        kLoggerQueues.erase(logger);
+        return false;
+      }
+    }
+    runner = queue;
+  }
+
+  bool drop = false;
+  if (!FLAGS_logger_queue_drop.empty()) {
+    auto loggers = osquery::split(FLAGS_logger_queue_drop, ",");
+    drop = std::find(loggers.begin(), loggers.end(), logger) != loggers.end();
+  }
+  return runner->push(std::move(log), drop);
+}
+} // namespace
+
 Status logString(const std::string& message, const std::string& category) {
   return logString(
       message, category, RegistryFactory::get().getActive("logger"));
@@ -384,21 +748,27 @@ Status logString(const std::string& message,
   }
 
   Status status;
+  std::shared_ptr<const std::string> queued;
   for (const auto& logger : osquery::split(receiver, ",")) {
-    if (Registry::get().exists("logger", logger, true)) {
-      auto plugin = Registry::get().plugin("logger", logger);
-      auto logger_plugin = std::dynamic_pointer_cast<LoggerPlugin>(plugin);
-      status = logger_plugin->logString(message);
+    if (FLAGS_logger_queue_size > 0 && queued == nullptr) {
+      queued = std::make_shared<const std::string>(message);
+    }
+    if (queueLog(logger, {queued, category, false})) {
+      status = Status::success();
     } else {
-      status = Registry::call(
-          "logger", logger, {{"string", message}, {"category", category}});
+      status = sendString(logger, message, category);
     }
   }
   return status;
 }
 
 namespace {
-const std::string kTotalQueryCounterMonitorPath("query.total.count");
+/// Counts the query results logged.
+const monitoring::Metric& totalQueryCounter() {
+  static const monitoring::Metric metric("query.total.count",
+                                         monitoring::PreAggregationType::Sum);
+  return metric;
+}
 }
 
 Status logQueryLogItem(const QueryLogItem& results) {
@@ -411,10 +781,7 @@ Status logQueryLogItem(const QueryLogItem& results,
     return Status::success();
   }
 
-  if (FLAGS_enable_numeric_monitoring) {
-    monitoring::record(
-        kTotalQueryCounterMonitorPath, 1, monitoring::PreAggregationType::Sum);
-  }
+  totalQueryCounter().record(1);
 
   std::vector<std::string> json_items;
   Status status;
@@ -423,7 +790,7 @@ Status logQueryLogItem(const QueryLogItem& results,
   } else {
     std::string json;
     status = serializeQueryLogItemJSON(results, json);
-    json_items.emplace_back(json);
+    json_items.emplace_back(std::move(json));
   }
   if (!status.ok()) {
     return status;
@@ -440,10 +807,7 @@ Status logSnapshotQuery(const QueryLogItem& item) {
     return Status::success();
   }
 
-  if (FLAGS_enable_numeric_monitoring) {
-    monitoring::record(
-        kTotalQueryCounterMonitorPath, 1, monitoring::PreAggregationType::Sum);
-  }
+  totalQueryCounter().record(1);
 
   std::vector<std::string> json_items;
   Status status;
@@ -452,21 +816,24 @@ Status logSnapshotQuery(const QueryLogItem& item) {
   } else {
     std::string json;
     status = serializeQueryLogItemJSON(item, json);
-    json_items.emplace_back(json);
+    json_items.emplace_back(std::move(json));
   }
   if (!status.ok()) {
     return status;
   }
 
-  for (const auto& json : json_items) {
-    auto receiver = RegistryFactory::get().getActive("logger");
+  auto receiver = RegistryFactory::get().getActive("logger");
+  for (auto& json : json_items) {
+    std::shared_ptr<const std::string> queued;
+    if (FLAGS_logger_queue_size > 0) {
+      queued = std::make_shared<const std::string>(std::move(json));
+    }
+    const auto& snapshot = (queued != nullptr) ? *queued : json;
     for (const auto& logger : osquery::split(receiver, ",")) {
-      if (Registry::get().exists("logger", logger, true)) {
-        auto plugin = Registry::get().plugin("logger", logger);
-        auto logger_plugin = std::dynamic_pointer_cast<LoggerPlugin>(plugin);
-        status = logger_plugin->logSnapshot(json);
+      if (queueLog(logger, {queued, "", true})) {
+        status = Status::success();
       } else {
-        status = Registry::call("logger", logger, {{"snapshot", json}});
+        status = sendSnapshot(logger, snapshot);
       }
     }
   }
@@ -475,23 +842,99 @@ Status logSnapshotQuery(const QueryLogItem& item) {
 }
 
 size_t queuedStatuses() {
-  ReadLock lock(kBufferedLogSinkLogs);
-  return BufferedLogSink::get().dump().size();
+  return BufferedLogSink::get().queued();
+}
+
+uint64_t StatusLogRelayRunner::request() {
+  uint64_t request = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopped_) {
+      return 0;
+    }
+    request = ++requested_;
+  }
+  changed_.notify_all();
+  return request;
+}
+
+void StatusLogRelayRunner::wait(uint64_t request) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  changed_.wait(lock, [&] { return ended_ || completed_ >= request; });
+}
+
+void StatusLogRelayRunner::waitFor(uint64_t request,
+                                   std::chrono::microseconds duration) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  changed_.wait_for(
+      lock, duration, [&] { return ended_ || completed_ >= request; });
+}
+
+uint64_t StatusLogRelayRunner::lastRequest() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return requested_;
+}
+
+bool StatusLogRelayRunner::running() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return !stopped_;
+}
+
+void StatusLogRelayRunner::start() {
+  kIsStatusLogRelay = true;
+  while (true) {
+    bool stopped = false;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      changed_.wait(lock,
+                    [this] { return stopped_ || requested_ > completed_; });
+      stopped = stopped_;
+    }
+
+    // Logger plugins logging while the logs are sent add to the ring, those
+    // logs are sent by this relay too. A request follows the push of its log,
+    // so the logs of the requests seen before a send are sent by it.
+    uint64_t request = 0;
+    do {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        request = requested_;
+      }
+      sendStatusLogs();
+    } while (queuedStatuses() > 0 && databaseInitialized() &&
+             !FLAGS_disable_logging);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      completed_ = request;
+      ended_ = stopped;
+    }
+    changed_.notify_all();
+    if (stopped) {
+      break;
+    }
+  }
+}
+
+void StatusLogRelayRunner::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopped_ = true;
+  }
+  changed_.notify_all();
 }
 
 void waitLogRelay() {
-  if (kOptBufferedLogSinkSender.has_value()) {
-    /* NOTE: We are not doing a workaround for Windows
-       as in BufferedLogSink::WaitTillSent because we are not and we must not be
-       in a path called by Google Log, and failing to properly wait
-       for the thread to finish will either cause a race condition or a deadlock
-     */
-    kOptBufferedLogSinkSender->wait();
-    kOptBufferedLogSinkSender.reset();
+  /* NOTE: We are not doing a workaround for Windows
+     as in BufferedLogSink::WaitTillSent because we are not and we must not be
+     in a path called by Google Log. */
+  auto runner = getStatusLogRelay();
+  if (runner != nullptr && !kIsStatusLogRelay) {
+    runner->wait(runner->lastRequest());
   }
 }
 
-void relayStatusLogs(LoggerRelayMode relay_mode) {
+void sendStatusLogs() {
   if (FLAGS_disable_logging || !databaseInitialized()) {
     // The logger plugins may not be setUp if logging is disabled.
     // If the database is not setUp, or is in a reset, status logs continue
@@ -499,58 +942,44 @@ void relayStatusLogs(LoggerRelayMode relay_mode) {
     return;
   }
 
-  {
-    ReadLock lock(kBufferedLogSinkLogs);
-    if (BufferedLogSink::get().dump().size() == 0) {
-      return;
-    }
-  }
-
-  auto sender = ([]() {
-    auto identifier = getHostIdentifier();
-
-    // Construct a status log plugin request.
-    PluginRequest request = {{"status", "true"}};
-    {
-      WriteLock lock(kBufferedLogSinkLogs);
-      auto& status_logs = BufferedLogSink::get().dump();
+  std::vector<StatusLogLine> status_logs;
+  BufferedLogSink::get().dump(status_logs);
 
-      // Prevent serializing and broadcasting an empty response
-      if (status_logs.empty()) {
-        return;
-      }
+  // Prevent serializing and broadcasting an empty response
+  if (status_logs.empty()) {
+    return;
+  }
 
-      for (auto& log : status_logs) {
-        // Copy the host identifier into each status log.
-        log.identifier = identifier;
-      }
+  auto identifier = getHostIdentifier();
+  for (auto& log : status_logs) {
+    // Copy the host identifier into each status log.
+    log.identifier = identifier;
+  }
 
-      serializeIntermediateLog(status_logs, request);
+  // Construct a status log plugin request.
+  PluginRequest request = {{"status", "true"}};
+  serializeIntermediateLog(status_logs, request);
 
-      // Flush the buffered status logs.
-      status_logs.clear();
-    }
-
-    auto logger_plugin = RegistryFactory::get().getActive("logger");
-    for (const auto& logger : osquery::split(logger_plugin, ",")) {
-      auto& enabled = BufferedLogSink::get().enabledPlugins();
-      if (std::find(enabled.begin(), enabled.end(), logger) != enabled.end()) {
-        // Skip the registry's logic, and send directly to the core's logger.
-        PluginResponse response;
-        Registry::call("logger", logger, request, response);
-      }
+  auto logger_plugin = RegistryFactory::get().getActive("logger");
+  for (const auto& logger : osquery::split(logger_plugin, ",")) {
+    auto& enabled = BufferedLogSink::get().enabledPlugins();
+    if (std::find(enabled.begin(), enabled.end(), logger) != enabled.end()) {
+      // Skip the registry's logic, and send directly to the core's logger.
+      PluginResponse response;
+      Registry::call("logger", logger, request, response);
     }
-  });
+  }
+}
 
-  if (relay_mode == LoggerRelayMode::Sync) {
-    sender();
-  } else {
-    // Wait on a previous relaying thread, if present
-    waitLogRelay();
+void relayStatusLogs(LoggerRelayMode relay_mode) {
+  if (FLAGS_disable_logging || !databaseInitialized()) {
+    return;
+  }
 
-    std::packaged_task<void()> task(std::move(sender));
-    kOptBufferedLogSinkSender = task.get_future();
-    std::thread(std::move(task)).detach();
+  // The relay runner sends asynchronous relays, the caller sends them if the
+  // runner is not running.
+  if (relay_mode == LoggerRelayMode::Sync || requestStatusLogRelay() == 0) {
+    sendStatusLogs();
   }
 }
 
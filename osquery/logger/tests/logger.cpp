@@ -14,6 +14,7 @@
 #include <osquery/core/plugins/logger.h>
 #include <osquery/core/system.h>
 #include <osquery/database/database.h>
+#include <osquery/dispatcher/dispatcher.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/data_logger.h>
 #include <osquery/registry/registry_factory.h>
@@ -30,6 +31,7 @@ DECLARE_bool(logger_event_type);
 DECLARE_bool(logger_snapshot_event_type);
 DECLARE_bool(disable_logging);
 DECLARE_bool(logger_numerics);
+DECLARE_uint64(logger_queue_size);
 
 class LoggerTests : public testing::Test {
  public:
@@ -315,6 +317,29 @@ class SecondTestLoggerPlugin : public LoggerPlugin {
   }
 };
 
+TEST_F(LoggerTests, test_logger_queue) {
+  // The logging thread waits while the queue is full.
+  FLAGS_logger_queue_size = 2;
+  for (size_t i = 0; i < 10; ++i) {
+    EXPECT_TRUE(logString("queued " + std::to_string(i), "event", "test"));
+  }
+
+  // Queued logs are sent before the queue service ends.
+  Dispatcher::stopServices();
+  Dispatcher::joinServices();
+  ASSERT_EQ(10U, LoggerTests::log_lines.size());
+  EXPECT_EQ("queued 0", LoggerTests::log_lines.front());
+  EXPECT_EQ("queued 9", LoggerTests::log_lines.back());
+
+  // While the dispatcher is stopping logs are sent from the logging thread.
+  EXPECT_TRUE(logString("direct", "event", "test"));
+  ASSERT_EQ(11U, LoggerTests::log_lines.size());
+  EXPECT_EQ("direct", LoggerTests::log_lines.back());
+
+  Dispatcher::instance().resetStopping();
+  FLAGS_logger_queue_size = 0;
+}
+
 TEST_F(LoggerTests, test_multiple_loggers) {
   auto& rf = RegistryFactory::get();
   auto second = std::make_shared<SecondTestLoggerPlugin>();
@@ -0,0 +1,101 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include <osquery/numeric_monitoring/histogram.h>
+
+namespace osquery {
+
+namespace monitoring {
+
+namespace {
+
+/// Each power of two is split into 2^kSubBucketBits buckets.
+const std::uint64_t kSubBucketBits{4};
+const std::uint64_t kSubBuckets{1ULL << kSubBucketBits};
+
+/// Values below this are counted in their own bucket.
+const std::uint64_t kExactValues{kSubBuckets * 2};
+
+/// The buckets needed to count any 64-bit value.
+const std::size_t kBuckets{(64 - kSubBucketBits + 1) * kSubBuckets};
+
+std::size_t bucketOf(std::uint64_t value) {
+  if (value < kExactValues) {
+    return static_cast<std::size_t>(value);
+  }
+
+  std::uint64_t msb = 63;
+  while ((value >> msb) == 0) {
+    --msb;
+  }
+  auto shift = msb - kSubBucketBits;
+  return static_cast<std::size_t>((shift + 1) * kSubBuckets +
+                                  (value >> shift) - kSubBuckets);
+}
+
+/// The middle of the values counted by a bucket.
+std::uint64_t valueOf(std::size_t bucket) {
+  if (bucket < kExactValues) {
+    return bucket;
+  }
+
+  auto shift = bucket / kSubBuckets - 1;
+  auto lower = (kSubBuckets + bucket % kSubBuckets) << shift;
+  return lower + ((1ULL << shift) >> 1);
+}
+
+} // namespace
+
+Histogram::Histogram() : buckets_(kBuckets, 0) {}
+
+void Histogram::add(std::uint64_t value) {
+  buckets_[bucketOf(value)]++;
+  count_++;
+  max_ = std::max(max_, value);
+}
+
+void Histogram::merge(const Histogram& other) {
+  for (std::size_t i = 0; i < kBuckets; ++i) {
+    buckets_[i] += other.buckets_[i];
+  }
+  count_ += other.count_;
+  max_ = std::max(max_, other.max_);
+}
+
+std::uint64_t Histogram::percentile(double percent) const {
+  if (count_ == 0) {
+    return 0;
+  }
+
+  auto rank = static_cast<std::uint64_t>(
+      std::ceil(std::min(std::max(percent, 0.0), 100.0) / 100 * count_));
+  rank = std::max<std::uint64_t>(rank, 1);
+
+  std::uint64_t seen = 0;
+  for (std::size_t i = 0; i < kBuckets; ++i) {
+    seen += buckets_[i];
+    if (seen >= rank) {
+      // The estimate never exceeds the largest value recorded.
+      return std::min(valueOf(i), max_);
+    }
+  }
+  return max_;
+}
+
+void Histogram::clear() {
+  std::fill(buckets_.begin(), buckets_.end(), 0);
+  count_ = 0;
+  max_ = 0;
+}
+
+} // namespace monitoring
+} // namespace osquery
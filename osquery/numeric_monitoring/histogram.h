@@ -0,0 +1,58 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace osquery {
+
+namespace monitoring {
+
+/**
+ * @brief A log-linear histogram of non-negative values.
+ *
+ * Each power of two is split into 16 linear buckets, values below 32 are
+ * exact. A percentile is estimated within about 6% of the value while the
+ * histogram uses a fixed amount of memory, and histograms of the same values
+ * recorded by different threads may be merged.
+ */
+class Histogram {
+ public:
+  Histogram();
+
+  void add(std::uint64_t value);
+
+  /// Add the values of another histogram.
+  void merge(const Histogram& other);
+
+  /// Estimate the value below which percent of the values fall.
+  std::uint64_t percentile(double percent) const;
+
+  void clear();
+
+  std::uint64_t count() const {
+    return count_;
+  }
+
+  std::uint64_t max() const {
+    return max_;
+  }
+
+ private:
+  std::vector<std::uint64_t> buckets_;
+
+  std::uint64_t count_{0};
+
+  std::uint64_t max_{0};
+};
+
+} // namespace monitoring
+} // namespace osquery
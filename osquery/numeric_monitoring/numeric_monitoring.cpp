@@ -7,17 +7,23 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <map>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
+#include <vector>
 
 #include <boost/io/quoted.hpp>
 
 #include <osquery/core/flags.h>
 #include <osquery/dispatcher/dispatcher.h>
 #include <osquery/logger/logger.h>
+#include <osquery/numeric_monitoring/histogram.h>
 #include <osquery/numeric_monitoring/numeric_monitoring.h>
 #include <osquery/numeric_monitoring/plugin_interface.h>
 #include <osquery/numeric_monitoring/pre_aggregation_cache.h>
 #include <osquery/registry/registry_factory.h>
+#include <osquery/utils/caches/sharded.h>
 
 #include <osquery/utils/enum_class_hash.h>
 
@@ -104,6 +110,161 @@ namespace {
 class FlusherIsScheduled {};
 FlusherIsScheduled schedule();
 
+/// The point a thread aggregated for a registered metric.
+struct MetricSlot {
+  ValueType value{0};
+  TimePoint time_point;
+  bool recorded{false};
+
+  /// The latencies of a LatencyMetric, in microseconds.
+  std::unique_ptr<Histogram> histogram;
+};
+
+/// The points of registered metrics aggregated by one thread.
+struct ThreadMetrics {
+  /// Only contended while the buffer is flushed.
+  std::mutex mutex;
+
+  /// Indexed by the metric id.
+  std::vector<MetricSlot> slots;
+
+  /// Set when the thread exits, its slots are dropped after the next flush.
+  bool exited{false};
+};
+
+/// Interns registered metrics and tracks the slots of every thread.
+class MetricRegistry final {
+ public:
+  static MetricRegistry& get() {
+    static MetricRegistry instance;
+    return instance;
+  }
+
+  std::size_t add(const std::string& path, PreAggregationType type) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto key = std::make_pair(path, type);
+    auto it = ids_.find(key);
+    if (it != ids_.end()) {
+      return it->second;
+    }
+    auto id = metrics_.size();
+    metrics_.push_back(key);
+    ids_.emplace(std::move(key), id);
+    return id;
+  }
+
+  void addThread(std::shared_ptr<ThreadMetrics> metrics) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    threads_.push_back(std::move(metrics));
+  }
+
+  /// Move the points aggregated by every thread out of their slots.
+  std::vector<Point> takePoints() {
+    std::vector<Point> points;
+    std::map<std::size_t, Histogram> latencies;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = threads_.begin(); it != threads_.end();) {
+      bool exited = false;
+      {
+        auto& thread = **it;
+        std::lock_guard<std::mutex> thread_lock(thread.mutex);
+        for (std::size_t id = 0; id < thread.slots.size(); ++id) {
+          auto& slot = thread.slots[id];
+          if (slot.histogram != nullptr && slot.histogram->count() > 0) {
+            latencies[id].merge(*slot.histogram);
+            slot.histogram->clear();
+          } else if (slot.recorded) {
+            points.emplace_back(metrics_[id].first,
+                                slot.value,
+                                metrics_[id].second,
+                                slot.time_point);
+            slot.recorded = false;
+          }
+        }
+        exited = thread.exited;
+      }
+      it = exited ? threads_.erase(it) : std::next(it);
+    }
+
+    auto now = Clock::now();
+    for (const auto& latency : latencies) {
+      const auto& path = metrics_[latency.first].first;
+      const auto& histogram = latency.second;
+      auto p50 = histogram.percentile(50);
+      auto p95 = histogram.percentile(95);
+      auto p99 = histogram.percentile(99);
+      points.emplace_back(path + ".p50",
+                          static_cast<ValueType>(p50),
+                          PreAggregationType::P50,
+                          now);
+      points.emplace_back(path + ".p95",
+                          static_cast<ValueType>(p95),
+                          PreAggregationType::P95,
+                          now);
+      points.emplace_back(path + ".p99",
+                          static_cast<ValueType>(p99),
+                          PreAggregationType::P99,
+                          now);
+      points.emplace_back(path + ".max",
+                          static_cast<ValueType>(histogram.max()),
+                          PreAggregationType::Max,
+                          now);
+      points.emplace_back(path + ".count",
+                          static_cast<ValueType>(histogram.count()),
+                          PreAggregationType::Sum,
+                          now);
+      VLOG(1) << "Latency of " << path << " in microseconds: p50 " << p50
+              << " p95 " << p95 << " p99 " << p99 << " max "
+              << histogram.max() << " count " << histogram.count();
+    }
+    return points;
+  }
+
+ private:
+  std::mutex mutex_;
+
+  std::map<std::pair<std::string, PreAggregationType>, std::size_t> ids_;
+
+  /// The path and type of each metric, by id.
+  std::vector<std::pair<std::string, PreAggregationType>> metrics_;
+
+  std::vector<std::shared_ptr<ThreadMetrics>> threads_;
+};
+
+/// The slots of the calling thread, registered on first use.
+ThreadMetrics& threadMetrics() {
+  struct Holder {
+    Holder() : metrics(std::make_shared<ThreadMetrics>()) {
+      MetricRegistry::get().addThread(metrics);
+    }
+
+    ~Holder() {
+      std::lock_guard<std::mutex> lock(metrics->mutex);
+      metrics->exited = true;
+    }
+
+    std::shared_ptr<ThreadMetrics> metrics;
+  };
+
+  thread_local Holder holder;
+  return *holder.metrics;
+}
+
+/// Aggregate a point into a slot, as Point::tryToAggregate.
+void aggregate(MetricSlot& slot, PreAggregationType type, ValueType value) {
+  if (!slot.recorded) {
+    slot.value = value;
+  } else if (type == PreAggregationType::Sum) {
+    slot.value += value;
+  } else if (type == PreAggregationType::Min) {
+    slot.value = std::min(slot.value, value);
+  } else {
+    slot.value = std::max(slot.value, value);
+  }
+  slot.time_point = Clock::now();
+  slot.recorded = true;
+}
+
 class PreAggregationBuffer final {
  public:
   static PreAggregationBuffer& get() {
@@ -127,6 +288,14 @@ class PreAggregationBuffer final {
   }
 
   void flush() {
+    auto metrics = MetricRegistry::get().takePoints();
+    if (!metrics.empty()) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (auto& point : metrics) {
+        cache_.addPoint(std::move(point));
+      }
+    }
+
     auto points = takeCachedPoints();
     for (const auto& pt : points) {
       dispatchOne(
@@ -168,19 +337,45 @@ class PreAggregationBuffer final {
   std::mutex mutex_;
 };
 
-class PreAggregationFlusher : public InternalRunnable {
+/// Count a latency in the calling thread's histogram of a metric.
+void recordLatencyPoint(std::size_t id, std::chrono::microseconds latency) {
+  // The buffer and its flusher are started by the first point.
+  PreAggregationBuffer::get();
+  auto& metrics = threadMetrics();
+  std::lock_guard<std::mutex> lock(metrics.mutex);
+  if (metrics.slots.size() <= id) {
+    metrics.slots.resize(id + 1);
+  }
+  auto& slot = metrics.slots[id];
+  if (slot.histogram == nullptr) {
+    slot.histogram = std::make_unique<Histogram>();
+  }
+  slot.histogram->add(static_cast<std::uint64_t>(
+      std::max<std::chrono::microseconds::rep>(latency.count(), 0)));
+}
+
+class PreAggregationFlusher : public PeriodicRunnable {
  public:
   explicit PreAggregationFlusher()
-      : InternalRunnable("numeric_monitoring_pre_aggregation_buffer_flusher") {}
+      : PeriodicRunnable("numeric_monitoring_pre_aggregation_buffer_flusher") {}
+
+ protected:
+  std::chrono::milliseconds tick() override {
+    if (0 == FLAGS_numeric_monitoring_pre_aggregation_time) {
+      interrupt();
+      return std::chrono::milliseconds::zero();
+    }
 
-  void start() override {
-    while (!interrupted() &&
-           0 != FLAGS_numeric_monitoring_pre_aggregation_time) {
-      pause(
-          std::chrono::seconds(FLAGS_numeric_monitoring_pre_aggregation_time));
+    // The first tick waits for the pre-aggregation time.
+    if (ticked_) {
       PreAggregationBuffer::get().flush();
     }
+    ticked_ = true;
+    return std::chrono::seconds(FLAGS_numeric_monitoring_pre_aggregation_time);
   }
+
+ private:
+  bool ticked_{false};
 };
 
 FlusherIsScheduled schedule() {
@@ -206,5 +401,104 @@ void record(const std::string& path,
       path, value, pre_aggregation, sync, std::move(time_point));
 }
 
+Metric::Metric(std::string path, PreAggregationType pre_aggregation)
+    : path_(std::move(path)),
+      pre_aggregation_(pre_aggregation),
+      id_(MetricRegistry::get().add(path_, pre_aggregation)) {}
+
+void Metric::record(ValueType value) const {
+  if (!FLAGS_enable_numeric_monitoring) {
+    return;
+  }
+
+  if (FLAGS_numeric_monitoring_pre_aggregation_time == 0 ||
+      (pre_aggregation_ != PreAggregationType::Sum &&
+       pre_aggregation_ != PreAggregationType::Min &&
+       pre_aggregation_ != PreAggregationType::Max)) {
+    monitoring::record(path_, value, pre_aggregation_);
+    return;
+  }
+
+  // The buffer and its flusher are started by the first point.
+  PreAggregationBuffer::get();
+  auto& metrics = threadMetrics();
+  std::lock_guard<std::mutex> lock(metrics.mutex);
+  if (metrics.slots.size() <= id_) {
+    metrics.slots.resize(id_ + 1);
+  }
+  aggregate(metrics.slots[id_], pre_aggregation_, value);
+}
+
+LatencyMetric::LatencyMetric(std::string path)
+    : path_(std::move(path)),
+      id_(MetricRegistry::get().add(path_, PreAggregationType::P99)) {}
+
+void LatencyMetric::record(std::chrono::microseconds latency) const {
+  if (!FLAGS_enable_numeric_monitoring) {
+    return;
+  }
+
+  if (FLAGS_numeric_monitoring_pre_aggregation_time == 0) {
+    monitoring::record(path_, latency.count(), PreAggregationType::None);
+    return;
+  }
+  recordLatencyPoint(id_, latency);
+}
+
+void recordLatency(const std::string& path, std::chrono::microseconds latency) {
+  if (!FLAGS_enable_numeric_monitoring) {
+    return;
+  }
+
+  if (FLAGS_numeric_monitoring_pre_aggregation_time == 0) {
+    monitoring::record(path, latency.count(), PreAggregationType::None);
+    return;
+  }
+  recordLatencyPoint(MetricRegistry::get().add(path, PreAggregationType::P99),
+                     latency);
+}
+
+LatencyTimer::LatencyTimer(const LatencyMetric& metric) {
+  if (FLAGS_enable_numeric_monitoring) {
+    metric_ = &metric;
+    start_ = std::chrono::steady_clock::now();
+  }
+}
+
+LatencyTimer::~LatencyTimer() {
+  if (metric_ != nullptr) {
+    metric_->record(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start_));
+  }
+}
+
+void recordCacheStats(const std::string& name,
+                      const caches::CacheStats& stats) {
+  if (!FLAGS_enable_numeric_monitoring) {
+    return;
+  }
+
+  auto prefix = "cache." + name + ".";
+  auto sum = [&prefix](const char* statistic, std::uint64_t value) {
+    record(prefix + statistic,
+           static_cast<ValueType>(value),
+           PreAggregationType::Sum);
+  };
+  sum("hits", stats.hits);
+  sum("misses", stats.misses);
+  sum("loads", stats.loads);
+  sum("load_failures", stats.load_failures);
+  sum("evictions", stats.evictions);
+  sum("expirations", stats.expirations);
+
+  // The size is the latest taken, not a sum over the aggregation period.
+  record(prefix + "entries",
+         static_cast<ValueType>(stats.entries),
+         PreAggregationType::Max);
+  record(prefix + "bytes",
+         static_cast<ValueType>(stats.bytes),
+         PreAggregationType::Max);
+}
+
 } // namespace monitoring
 } // namespace osquery
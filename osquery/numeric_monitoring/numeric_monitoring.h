@@ -17,6 +17,10 @@
 
 namespace osquery {
 
+namespace caches {
+struct CacheStats;
+} // namespace caches
+
 namespace monitoring {
 
 struct RecordKeys {
@@ -89,6 +93,102 @@ void record(const std::string& path,
             const bool sync = false,
             TimePoint time_point = Clock::now());
 
+/**
+ * @brief A registered metric, recorded without building its path.
+ *
+ * The path and pre-aggregation type are interned once when the metric is
+ * created, keep the metric for as long as it is recorded. Points of the Sum,
+ * Min and Max types are aggregated in the recording thread's slots, without a
+ * global lock or an allocation, and merged into the pre-aggregation buffer
+ * when it is flushed. Points of other types, or recorded while pre-aggregation
+ * is disabled, are recorded as with monitoring::record.
+ *
+ * @code{.cpp}
+ * static const monitoring::Metric kQueueDepth(
+ *     "logger.queue.depth", monitoring::PreAggregationType::Max);
+ * kQueueDepth.record(depth);
+ * @endcode
+ */
+class Metric {
+ public:
+  Metric(std::string path, PreAggregationType pre_aggregation);
+
+  /// Record a point of the metric, now.
+  void record(ValueType value) const;
+
+  const std::string& path() const {
+    return path_;
+  }
+
+ private:
+  std::string path_;
+
+  PreAggregationType pre_aggregation_;
+
+  /// The index of the metric's slot in each thread.
+  std::size_t id_;
+};
+
+/**
+ * @brief A registered latency, exported as percentiles.
+ *
+ * Latencies are counted in a histogram owned by the recording thread, the
+ * histograms of every thread are merged when the pre-aggregation buffer is
+ * flushed. Each flush records the p50, p95, p99 and max latency in
+ * microseconds, and the number of latencies, as the metric's path followed by
+ * ".p50", ".p95", ".p99", ".max" and ".count". While pre-aggregation is
+ * disabled each latency is recorded as a point of the path.
+ */
+class LatencyMetric {
+ public:
+  explicit LatencyMetric(std::string path);
+
+  void record(std::chrono::microseconds latency) const;
+
+  const std::string& path() const {
+    return path_;
+  }
+
+ private:
+  std::string path_;
+
+  /// The index of the metric's slot in each thread.
+  std::size_t id_;
+};
+
+/**
+ * @brief Record the latency of a path that is not registered in advance.
+ *
+ * This interns the path on each call, prefer a LatencyMetric.
+ */
+void recordLatency(const std::string& path, std::chrono::microseconds latency);
+
+/// Record the time from construction to destruction as a latency.
+class LatencyTimer {
+ public:
+  explicit LatencyTimer(const LatencyMetric& metric);
+  ~LatencyTimer();
+
+  LatencyTimer(const LatencyTimer&) = delete;
+  LatencyTimer& operator=(const LatencyTimer&) = delete;
+
+ private:
+  /// Not set while numeric monitoring is disabled.
+  const LatencyMetric* metric_{nullptr};
+
+  std::chrono::steady_clock::time_point start_;
+};
+
+/**
+ * @brief Record the statistics taken from a cache.
+ *
+ * The points are recorded as cache.<name>.<statistic>. The hits, misses,
+ * loads and removals since the statistics were last taken are summed, the
+ * entries and bytes are the size of the cache when they were taken.
+ */
+void recordCacheStats(const std::string& name,
+                      const caches::CacheStats& stats);
+
 /**
  * Force flush the pre-aggregation buffer.
  * Please use it, only when it's totally necessary.
@@ -0,0 +1,74 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <limits>
+
+#include <gtest/gtest.h>
+
+#include <osquery/numeric_monitoring/histogram.h>
+
+namespace osquery {
+
+GTEST_TEST(Histogram, empty) {
+  monitoring::Histogram histogram;
+  EXPECT_EQ(histogram.count(), 0U);
+  EXPECT_EQ(histogram.percentile(99), 0U);
+}
+
+GTEST_TEST(Histogram, small_values_are_exact) {
+  monitoring::Histogram histogram;
+  for (std::uint64_t value = 1; value <= 20; ++value) {
+    histogram.add(value);
+  }
+  EXPECT_EQ(histogram.count(), 20U);
+  EXPECT_EQ(histogram.max(), 20U);
+  EXPECT_EQ(histogram.percentile(50), 10U);
+  EXPECT_EQ(histogram.percentile(95), 19U);
+  EXPECT_EQ(histogram.percentile(100), 20U);
+}
+
+GTEST_TEST(Histogram, large_values_are_estimated) {
+  monitoring::Histogram histogram;
+  for (std::uint64_t value = 1; value <= 100000; ++value) {
+    histogram.add(value);
+  }
+
+  auto p99 = histogram.percentile(99);
+  EXPECT_GE(p99, 99000U * 94 / 100);
+  EXPECT_LE(p99, 99000U * 106 / 100);
+  EXPECT_EQ(histogram.max(), 100000U);
+
+  // Any value may be counted.
+  histogram.add(std::numeric_limits<std::uint64_t>::max());
+  EXPECT_EQ(histogram.max(), std::numeric_limits<std::uint64_t>::max());
+  EXPECT_GT(histogram.percentile(100),
+            std::numeric_limits<std::uint64_t>::max() / 100 * 94);
+}
+
+GTEST_TEST(Histogram, merge) {
+  monitoring::Histogram low;
+  monitoring::Histogram high;
+  for (int i = 0; i < 90; ++i) {
+    low.add(1);
+  }
+  for (int i = 0; i < 10; ++i) {
+    high.add(1000);
+  }
+
+  low.merge(high);
+  EXPECT_EQ(low.count(), 100U);
+  EXPECT_EQ(low.percentile(50), 1U);
+  EXPECT_GE(low.percentile(95), 940U);
+
+  low.clear();
+  EXPECT_EQ(low.count(), 0U);
+  EXPECT_EQ(low.max(), 0U);
+}
+
+} // namespace osquery
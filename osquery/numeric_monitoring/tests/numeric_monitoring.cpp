@@ -9,6 +9,9 @@
 
 #include <gtest/gtest.h>
 
+#include <map>
+#include <thread>
+
 #include <boost/filesystem.hpp>
 
 #include <osquery/core/flags.h>
@@ -138,6 +141,108 @@ TEST_F(NumericMonitoringTests, record_with_buffer) {
   Dispatcher::joinServices();
 }
 
+TEST_F(NumericMonitoringTests, record_metric) {
+  const auto isEnabled = FLAGS_enable_numeric_monitoring;
+  const auto plugins = FLAGS_numeric_monitoring_plugins;
+  const auto pre_aggregation_time =
+      FLAGS_numeric_monitoring_pre_aggregation_time;
+
+  FLAGS_enable_numeric_monitoring = true;
+  FLAGS_numeric_monitoring_plugins = kNameForTestPlugin;
+  FLAGS_numeric_monitoring_pre_aggregation_time = 1;
+
+  auto status = RegistryFactory::get().setActive(
+      monitoring::registryName(), FLAGS_numeric_monitoring_plugins);
+  ASSERT_TRUE(status.ok());
+
+  monitoring::flush();
+  NumericMonitoringInMemoryTestPlugin::points.clear();
+
+  const monitoring::Metric sum("some.metric.sum",
+                               monitoring::PreAggregationType::Sum);
+  const monitoring::Metric max("some.metric.max",
+                               monitoring::PreAggregationType::Max);
+  sum.record(3);
+  max.record(3);
+
+  // Points aggregated by other threads are merged when flushed.
+  std::thread thread([&sum, &max]() {
+    sum.record(5);
+    max.record(7);
+  });
+  thread.join();
+  sum.record(11);
+  max.record(2);
+  monitoring::flush();
+
+  std::map<std::string, long long> values;
+  for (const auto& point : NumericMonitoringInMemoryTestPlugin::points) {
+    values[point.at(monitoring::recordKeys().path)] =
+        std::stoll(point.at(monitoring::recordKeys().value));
+  }
+  EXPECT_EQ(values.size(), 2U);
+  EXPECT_EQ(values["some.metric.sum"], 3 + 5 + 11);
+  EXPECT_EQ(values["some.metric.max"], 7);
+
+  // Nothing is left in the slots after a flush.
+  NumericMonitoringInMemoryTestPlugin::points.clear();
+  monitoring::flush();
+  EXPECT_TRUE(NumericMonitoringInMemoryTestPlugin::points.empty());
+
+  FLAGS_enable_numeric_monitoring = isEnabled;
+  FLAGS_numeric_monitoring_plugins = plugins;
+  FLAGS_numeric_monitoring_pre_aggregation_time = pre_aggregation_time;
+
+  Dispatcher::stopServices();
+  Dispatcher::joinServices();
+}
+
+TEST_F(NumericMonitoringTests, record_latency) {
+  const auto isEnabled = FLAGS_enable_numeric_monitoring;
+  const auto plugins = FLAGS_numeric_monitoring_plugins;
+  const auto pre_aggregation_time =
+      FLAGS_numeric_monitoring_pre_aggregation_time;
+
+  FLAGS_enable_numeric_monitoring = true;
+  FLAGS_numeric_monitoring_plugins = kNameForTestPlugin;
+  FLAGS_numeric_monitoring_pre_aggregation_time = 1;
+
+  auto status = RegistryFactory::get().setActive(
+      monitoring::registryName(), FLAGS_numeric_monitoring_plugins);
+  ASSERT_TRUE(status.ok());
+
+  monitoring::flush();
+  NumericMonitoringInMemoryTestPlugin::points.clear();
+
+  const monitoring::LatencyMetric latency("some.latency");
+  for (int i = 1; i <= 20; ++i) {
+    latency.record(std::chrono::microseconds(i));
+  }
+  std::thread thread([]() {
+    monitoring::recordLatency("some.latency", std::chrono::microseconds(100));
+  });
+  thread.join();
+  monitoring::flush();
+
+  std::map<std::string, long long> values;
+  for (const auto& point : NumericMonitoringInMemoryTestPlugin::points) {
+    values[point.at(monitoring::recordKeys().path)] =
+        std::stoll(point.at(monitoring::recordKeys().value));
+  }
+  EXPECT_EQ(values.size(), 5U);
+  EXPECT_EQ(values["some.latency.count"], 21);
+  EXPECT_EQ(values["some.latency.max"], 100);
+  EXPECT_EQ(values["some.latency.p50"], 11);
+  EXPECT_EQ(values["some.latency.p99"], 100);
+
+  FLAGS_enable_numeric_monitoring = isEnabled;
+  FLAGS_numeric_monitoring_plugins = plugins;
+  FLAGS_numeric_monitoring_pre_aggregation_time = pre_aggregation_time;
+
+  Dispatcher::stopServices();
+  Dispatcher::joinServices();
+}
+
 TEST_F(NumericMonitoringTests, record_without_buffer) {
   const auto isEnabled = FLAGS_enable_numeric_monitoring;
   const auto plugins = FLAGS_numeric_monitoring_plugins;
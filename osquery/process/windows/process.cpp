@@ -233,7 +233,7 @@ std::shared_ptr<PlatformProcess> PlatformProcess::launchWorker(
   // For the worker case, we also set another environment variable,
   // OSQUERY_LAUNCHER. OSQUERY_LAUNCHER stores the string form of a HANDLE to
   // the current process. This is mostly used for detecting the death of the
-  // launcher process in WatcherWatcherRunner::start
+  // launcher process in WatcherWatcherRunner::tick
   childEnvironment << L"OSQUERY_WORKER=1" << L'\0';
   childEnvironment << L"OSQUERY_LAUNCHER=" << handle << L'\0' << L'\0';
 
@@ -0,0 +1,113 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#ifdef __linux__
+// Needed for linux specific RUSAGE_THREAD, before including anything else
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#endif
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#ifdef __APPLE__
+#include <mach/mach.h>
+#endif
+
+#include <osquery/profiler/resource_usage.h>
+#include <osquery/utils/mutex.h>
+
+namespace osquery {
+namespace {
+
+std::uint64_t toMilliseconds(const struct timeval& tv) {
+  return static_cast<std::uint64_t>(tv.tv_sec) * 1000 +
+         static_cast<std::uint64_t>(tv.tv_usec) / 1000;
+}
+
+#ifdef __linux__
+std::uint64_t getResidentSize() {
+  // The file is kept open, it is read before and after each query.
+  static Mutex statm_mutex;
+  static int statm_fd{-1};
+  static pid_t statm_pid{0};
+
+  WriteLock lock(statm_mutex);
+  if (statm_fd < 0 || statm_pid != ::getpid()) {
+    // A forked process must not read the statistics of its parent.
+    if (statm_fd >= 0) {
+      ::close(statm_fd);
+    }
+    statm_fd = ::open("/proc/self/statm", O_RDONLY | O_CLOEXEC);
+    statm_pid = ::getpid();
+    if (statm_fd < 0) {
+      return 0;
+    }
+  }
+
+  char buffer[128];
+  auto bytes = ::pread(statm_fd, buffer, sizeof(buffer) - 1, 0);
+  if (bytes <= 0) {
+    return 0;
+  }
+  buffer[bytes] = '\0';
+
+  unsigned long long pages = 0;
+  if (std::sscanf(buffer, "%*s %llu", &pages) != 1) {
+    return 0;
+  }
+  return pages * static_cast<std::uint64_t>(::sysconf(_SC_PAGESIZE));
+}
+#elif defined(__APPLE__)
+std::uint64_t getResidentSize() {
+  mach_task_basic_info_data_t info;
+  mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+  if (task_info(mach_task_self(),
+                MACH_TASK_BASIC_INFO,
+                reinterpret_cast<task_info_t>(&info),
+                &count) != KERN_SUCCESS) {
+    return 0;
+  }
+  return info.resident_size;
+}
+#else
+std::uint64_t getResidentSize() {
+  return 0;
+}
+#endif
+} // namespace
+
+Status getResourceUsage(ResourceUsage& usage, bool thread) {
+  int who = RUSAGE_SELF;
+#ifdef __linux__
+  if (thread) {
+    who = RUSAGE_THREAD;
+  }
+#endif
+
+  struct rusage stats;
+  if (::getrusage(who, &stats) != 0) {
+    return Status::failure(std::string("getrusage failed: ") +
+                           std::strerror(errno));
+  }
+
+  usage.user_time = toMilliseconds(stats.ru_utime);
+  usage.system_time = toMilliseconds(stats.ru_stime);
+  usage.resident_size = getResidentSize();
+  return Status::success();
+}
+
+} // namespace osquery
@@ -0,0 +1,352 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <tuple>
+#include <unordered_map>
+
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <signal.h>
+#include <sys/time.h>
+
+#include <boost/core/demangle.hpp>
+
+#include <osquery/profiler/sampling_profiler.h>
+#include <osquery/utils/mutex.h>
+
+namespace osquery {
+namespace {
+
+/// Frames kept of each sample, the outermost frames are dropped.
+const size_t kMaxFrames = 48;
+
+/// Frames of the signal handler and trampoline at the top of each sample.
+const int kSkipFrames = 2;
+
+/// Samples buffered between two collections.
+const size_t kMaxPendingSamples = 4096;
+
+/// Distinct stacks kept, further samples are counted without a stack.
+const size_t kMaxStacks = 16384;
+
+/// Distinct query names, further queries are not attributed.
+const size_t kMaxQueries = 4096;
+
+const std::uint64_t kMaxFrequency = 1000;
+
+enum SlotState : std::uint32_t {
+  kSlotEmpty = 0,
+  kSlotWriting,
+  kSlotReady,
+};
+
+/// A sample written by the signal handler, without allocating or locking.
+struct PendingSample {
+  std::atomic<std::uint32_t> state{kSlotEmpty};
+  std::uint32_t query{0};
+  ProfileStage stage{ProfileStage::None};
+  int depth{0};
+  void* frames[kMaxFrames];
+};
+
+/// The attribution of the current thread, read by the signal handler.
+thread_local std::uint32_t tQuery{0};
+thread_local ProfileStage tStage{ProfileStage::None};
+
+std::atomic<bool> gRunning{false};
+std::atomic<size_t> gNextSlot{0};
+std::atomic<std::uint64_t> gDropped{0};
+
+/// Allocated on the first start and kept, a late signal may still write.
+std::atomic<PendingSample*> gPending{nullptr};
+
+using StackKey = std::tuple<std::uint32_t, ProfileStage, std::vector<void*>>;
+
+struct Profile {
+  Mutex mutex;
+
+  /// Query names, id 0 is a thread without a query.
+  std::vector<std::string> queries{""};
+  std::unordered_map<std::string, std::uint32_t> query_ids;
+
+  std::map<StackKey, std::uint64_t> stacks;
+
+  /// Symbols of the sampled addresses.
+  std::unordered_map<void*, std::string> symbols;
+
+  std::uint64_t frequency{0};
+  bool handler_installed{false};
+};
+
+Profile& getProfile() {
+  static Profile profile;
+  return profile;
+}
+
+void onSample(int, siginfo_t*, void*) {
+  auto pending = gPending.load(std::memory_order_acquire);
+  if (!gRunning.load(std::memory_order_relaxed) || pending == nullptr) {
+    return;
+  }
+
+  auto& slot = pending[gNextSlot.fetch_add(1, std::memory_order_relaxed) %
+                       kMaxPendingSamples];
+  std::uint32_t empty = kSlotEmpty;
+  if (!slot.state.compare_exchange_strong(
+          empty, kSlotWriting, std::memory_order_acquire)) {
+    gDropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  auto saved_errno = errno;
+  void* frames[kMaxFrames + kSkipFrames];
+  auto depth = ::backtrace(frames, static_cast<int>(kMaxFrames + kSkipFrames));
+  errno = saved_errno;
+
+  depth = std::max(0, depth - kSkipFrames);
+  std::memcpy(slot.frames, frames + kSkipFrames, depth * sizeof(void*));
+  slot.depth = depth;
+  slot.query = tQuery;
+  slot.stage = tStage;
+  slot.state.store(kSlotReady, std::memory_order_release);
+}
+
+/// Move the pending samples into the profile, the mutex is held.
+void collect(Profile& profile) {
+  auto pending = gPending.load(std::memory_order_acquire);
+  if (pending == nullptr) {
+    return;
+  }
+
+  for (size_t i = 0; i < kMaxPendingSamples; ++i) {
+    auto& slot = pending[i];
+    if (slot.state.load(std::memory_order_acquire) != kSlotReady) {
+      continue;
+    }
+
+    StackKey key(slot.query, slot.stage, {});
+    if (profile.stacks.size() < kMaxStacks) {
+      std::get<2>(key).assign(slot.frames, slot.frames + slot.depth);
+    }
+    slot.state.store(kSlotEmpty, std::memory_order_release);
+    profile.stacks[std::move(key)]++;
+  }
+}
+
+const std::string& getSymbol(Profile& profile, void* address) {
+  auto it = profile.symbols.find(address);
+  if (it != profile.symbols.end()) {
+    return it->second;
+  }
+
+  // Without a symbol the module offset may be resolved offline.
+  std::string symbol;
+  Dl_info info;
+  if (::dladdr(address, &info) != 0) {
+    if (info.dli_sname != nullptr) {
+      symbol = boost::core::demangle(info.dli_sname);
+    } else if (info.dli_fname != nullptr) {
+      char offset[32];
+      std::snprintf(offset,
+                    sizeof(offset),
+                    "+0x%zx",
+                    static_cast<size_t>(static_cast<char*>(address) -
+                                        static_cast<char*>(info.dli_fbase)));
+      symbol = std::string(info.dli_fname) + offset;
+    }
+  }
+
+  if (symbol.empty()) {
+    char raw[32];
+    std::snprintf(raw, sizeof(raw), "%p", address);
+    symbol = raw;
+  }
+
+  // Semicolons separate the frames of a folded stack.
+  std::replace(symbol.begin(), symbol.end(), ';', ':');
+  return profile.symbols.emplace(address, std::move(symbol)).first->second;
+}
+
+Status startTimer(std::uint64_t frequency) {
+  struct itimerval timer;
+  std::memset(&timer, 0, sizeof(timer));
+  if (frequency > 0) {
+    auto interval = 1000000 / frequency;
+    timer.it_interval.tv_sec = static_cast<time_t>(interval / 1000000);
+    timer.it_interval.tv_usec = static_cast<suseconds_t>(interval % 1000000);
+    timer.it_value = timer.it_interval;
+  }
+
+  if (::setitimer(ITIMER_PROF, &timer, nullptr) != 0) {
+    return Status::failure("Cannot set the profiling timer: " +
+                           std::string(std::strerror(errno)));
+  }
+  return Status::success();
+}
+
+Status installHandler(Profile& profile) {
+  if (profile.handler_installed) {
+    return Status::success();
+  }
+
+  // The first backtrace may allocate while loading the unwinder.
+  void* frames[1];
+  ::backtrace(frames, 1);
+
+  if (gPending.load() == nullptr) {
+    gPending.store(new PendingSample[kMaxPendingSamples],
+                   std::memory_order_release);
+  }
+
+  // The handler stays installed, a pending signal must not end the process.
+  struct sigaction action;
+  std::memset(&action, 0, sizeof(action));
+  action.sa_sigaction = onSample;
+  action.sa_flags = SA_SIGINFO | SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  if (::sigaction(SIGPROF, &action, nullptr) != 0) {
+    return Status::failure("Cannot install the profiling signal handler");
+  }
+
+  profile.handler_installed = true;
+  return Status::success();
+}
+
+} // namespace
+
+const char* getProfileStageName(ProfileStage stage) {
+  switch (stage) {
+  case ProfileStage::Query:
+    return "query";
+  case ProfileStage::Generate:
+    return "generate";
+  case ProfileStage::Diff:
+    return "diff";
+  case ProfileStage::Log:
+    return "log";
+  case ProfileStage::None:
+    break;
+  }
+  return "";
+}
+
+ProfileScope::ProfileScope(const std::string& query, ProfileStage stage)
+    : query_(tQuery), stage_(tStage) {
+  std::uint32_t id = 0;
+  if (gRunning) {
+    auto& profile = getProfile();
+    WriteLock lock(profile.mutex);
+    auto it = profile.query_ids.find(query);
+    if (it != profile.query_ids.end()) {
+      id = it->second;
+    } else if (profile.queries.size() < kMaxQueries) {
+      id = static_cast<std::uint32_t>(profile.queries.size());
+      profile.queries.push_back(query);
+      profile.query_ids.emplace(query, id);
+    }
+  }
+
+  tQuery = id;
+  tStage = stage;
+}
+
+ProfileScope::ProfileScope(ProfileStage stage)
+    : query_(tQuery), stage_(tStage) {
+  tStage = stage;
+}
+
+ProfileScope::~ProfileScope() {
+  tQuery = query_;
+  tStage = stage_;
+}
+
+Status updateSamplingProfiler(std::uint64_t frequency) {
+  frequency = std::min(frequency, kMaxFrequency);
+
+  auto& profile = getProfile();
+  WriteLock lock(profile.mutex);
+  collect(profile);
+  if (frequency == profile.frequency) {
+    return Status::success();
+  }
+
+  if (frequency > 0) {
+    auto status = installHandler(profile);
+    if (!status.ok()) {
+      return status;
+    }
+
+    if (profile.frequency == 0) {
+      profile.stacks.clear();
+      gDropped = 0;
+    }
+  }
+
+  gRunning = frequency > 0;
+  auto status = startTimer(frequency);
+  if (!status.ok()) {
+    gRunning = false;
+    frequency = 0;
+  }
+  profile.frequency = frequency;
+  return status;
+}
+
+std::vector<ProfileSample> getProfileSamples() {
+  auto& profile = getProfile();
+  WriteLock lock(profile.mutex);
+  collect(profile);
+
+  std::vector<ProfileSample> samples;
+  samples.reserve(profile.stacks.size() + 1);
+  for (const auto& stack : profile.stacks) {
+    ProfileSample sample;
+    auto query = std::get<0>(stack.first);
+    if (query < profile.queries.size()) {
+      sample.query = profile.queries[query];
+    }
+    sample.stage = std::get<1>(stack.first);
+
+    // Samples are unwound from the sampled function outwards.
+    const auto& frames = std::get<2>(stack.first);
+    for (auto frame = frames.rbegin(); frame != frames.rend(); ++frame) {
+      if (!sample.stack.empty()) {
+        sample.stack += ';';
+      }
+      sample.stack += getSymbol(profile, *frame);
+    }
+    if (frames.empty()) {
+      sample.stack = "[truncated]";
+    }
+
+    sample.samples = stack.second;
+    samples.push_back(std::move(sample));
+  }
+
+  if (gDropped > 0) {
+    ProfileSample dropped;
+    dropped.stack = "[dropped]";
+    dropped.samples = gDropped;
+    samples.push_back(std::move(dropped));
+  }
+  return samples;
+}
+
+} // namespace osquery
@@ -0,0 +1,31 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <osquery/core/sql/query_performance.h>
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/**
+ * @brief Sample the CPU time and resident memory of the worker.
+ *
+ * This reads the worker's own accounting, getrusage and the process memory
+ * counters, instead of querying the processes table. It is cheap enough to
+ * call before and after every scheduled query.
+ *
+ * @param usage The sampled resources.
+ * @param thread Only count the CPU time of the calling thread, for queries
+ * running concurrently. Platforms without per-thread accounting count the
+ * process. Resident memory is always that of the process.
+ */
+Status getResourceUsage(ResourceUsage& usage, bool thread);
+
+} // namespace osquery
@@ -0,0 +1,78 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/// The part of the query pipeline a thread is executing.
+enum class ProfileStage : std::uint8_t {
+  None = 0,
+  Query,
+  Generate,
+  Diff,
+  Log,
+};
+
+/// The name of a stage reported by the osquery_profile table.
+const char* getProfileStageName(ProfileStage stage);
+
+/**
+ * @brief Attribute the CPU samples of this thread, until destroyed.
+ *
+ * Scopes nest, a stage scope keeps the query of the enclosing scope and the
+ * previous query and stage are restored when a scope ends. Queries are only
+ * recorded while the profiler is running.
+ */
+class ProfileScope : private boost::noncopyable {
+ public:
+  ProfileScope(const std::string& query, ProfileStage stage);
+
+  explicit ProfileScope(ProfileStage stage);
+
+  ~ProfileScope();
+
+ private:
+  std::uint32_t query_{0};
+  ProfileStage stage_{ProfileStage::None};
+};
+
+/// The number of samples sharing a query, stage and stack.
+struct ProfileSample {
+  std::string query;
+  ProfileStage stage{ProfileStage::None};
+
+  /// Frames from the outermost to the sampled function, separated by ';'.
+  std::string stack;
+
+  std::uint64_t samples{0};
+};
+
+/**
+ * @brief Start, stop or change the rate of the sampling CPU profiler.
+ *
+ * The profiler samples the stack of the thread consuming CPU time, at most
+ * frequency times in every second of CPU time, 0 stops it. Samples pending
+ * since the last call are collected. Starting the profiler again discards
+ * the collected samples.
+ */
+Status updateSamplingProfiler(std::uint64_t frequency);
+
+/// Collect the pending samples and report every sample since the start.
+std::vector<ProfileSample> getProfileSamples();
+
+} // namespace osquery
@@ -0,0 +1,58 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+// clang-format off
+#include <osquery/utils/system/system.h>
+#include <psapi.h>
+// clang-format on
+
+#include <osquery/profiler/resource_usage.h>
+
+namespace osquery {
+namespace {
+
+/// FILETIME durations are in 100 nanosecond units.
+std::uint64_t toMilliseconds(const FILETIME& ft) {
+  ULARGE_INTEGER value;
+  value.LowPart = ft.dwLowDateTime;
+  value.HighPart = ft.dwHighDateTime;
+  return value.QuadPart / 10000;
+}
+} // namespace
+
+Status getResourceUsage(ResourceUsage& usage, bool thread) {
+  FILETIME created;
+  FILETIME exited;
+  FILETIME kernel;
+  FILETIME user;
+  BOOL ok = FALSE;
+  if (thread) {
+    ok = GetThreadTimes(GetCurrentThread(), &created, &exited, &kernel, &user);
+  } else {
+    ok = GetProcessTimes(
+        GetCurrentProcess(), &created, &exited, &kernel, &user);
+  }
+  if (!ok) {
+    return Status::failure("Cannot get the CPU times: " +
+                           std::to_string(GetLastError()));
+  }
+
+  usage.user_time = toMilliseconds(user);
+  usage.system_time = toMilliseconds(kernel);
+
+  PROCESS_MEMORY_COUNTERS counters;
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+    usage.resident_size = counters.WorkingSetSize;
+  } else {
+    usage.resident_size = 0;
+  }
+  return Status::success();
+}
+
+} // namespace osquery
@@ -0,0 +1,47 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <osquery/profiler/sampling_profiler.h>
+
+namespace osquery {
+
+const char* getProfileStageName(ProfileStage stage) {
+  switch (stage) {
+  case ProfileStage::Query:
+    return "query";
+  case ProfileStage::Generate:
+    return "generate";
+  case ProfileStage::Diff:
+    return "diff";
+  case ProfileStage::Log:
+    return "log";
+  case ProfileStage::None:
+    break;
+  }
+  return "";
+}
+
+ProfileScope::ProfileScope(const std::string& query, ProfileStage stage) {}
+
+ProfileScope::ProfileScope(ProfileStage stage) {}
+
+ProfileScope::~ProfileScope() {}
+
+Status updateSamplingProfiler(std::uint64_t frequency) {
+  if (frequency > 0) {
+    return Status::failure("The sampling profiler is not supported");
+  }
+  return Status::success();
+}
+
+std::vector<ProfileSample> getProfileSamples() {
+  return {};
+}
+
+} // namespace osquery
@@ -13,6 +13,14 @@
 #include <osquery/utils/conversions/split.h>
 
 namespace osquery {
+void RegistryInterface::publishUnsafe() {
+  auto current = std::make_shared<Lookup>();
+  current->items = items_;
+  current->external = external_;
+  current->routes = routes_;
+  std::atomic_store(&lookup_, std::shared_ptr<const Lookup>(current));
+}
+
 void RegistryInterface::removeUnsafe(const std::string& item_name) {
   if (items_.count(item_name) > 0) {
     items_[item_name]->tearDown();
@@ -30,6 +38,8 @@ void RegistryInterface::removeUnsafe(const std::string& item_name) {
   for (const auto& alias : removed_aliases) {
     aliases_.erase(alias);
   }
+
+  publishUnsafe();
 }
 
 void RegistryInterface::remove(const std::string& item_name) {
@@ -133,37 +143,31 @@ RegistryRoutes RegistryInterface::getRoutes() const {
 Status RegistryInterface::call(const std::string& item_name,
                                const PluginRequest& request,
                                PluginResponse& response) {
-  PluginRef plugin;
-  {
-    ReadLock lock(mutex_);
+  auto current = lookup();
 
-    // Search local plugins (items) for the plugin.
-    if (items_.count(item_name) > 0) {
-      plugin = items_.at(item_name);
-    }
-  }
-  if (plugin) {
-    return plugin->call(request, response);
+  // Search local plugins (items) for the plugin.
+  auto item = current->items.find(item_name);
+  if (item != current->items.end()) {
+    return item->second->call(request, response);
   }
 
   RouteUUID uuid;
-  {
-    ReadLock lock(mutex_);
 
-    // Check if the item was broadcasted as a plugin within an extension.
-    if (external_.count(item_name) > 0) {
-      // The item is a registered extension, call the extension by UUID.
-      uuid = external_.at(item_name);
-    } else if (routes_.count(item_name) > 0) {
-      // The item has a route, but no extension, pass in the route info.
-      response = routes_.at(item_name);
-      return Status::success();
-    } else if (RegistryFactory::get().external()) {
-      // If this is an extension's registry forward unknown calls to the core.
-      uuid = 0;
-    } else {
-      return Status::failure("Cannot call registry item: " + item_name);
-    }
+  // Check if the item was broadcasted as a plugin within an extension.
+  auto external = current->external.find(item_name);
+  auto route = current->routes.find(item_name);
+  if (external != current->external.end()) {
+    // The item is a registered extension, call the extension by UUID.
+    uuid = external->second;
+  } else if (route != current->routes.end()) {
+    // The item has a route, but no extension, pass in the route info.
+    response = route->second;
+    return Status::success();
+  } else if (RegistryFactory::get().external()) {
+    // If this is an extension's registry forward unknown calls to the core.
+    uuid = 0;
+  } else {
+    return Status::failure("Cannot call registry item: " + item_name);
   }
 
   return callExtension(uuid, name_, item_name, request, response);
@@ -206,6 +210,7 @@ Status RegistryInterface::addPlugin(const std::string& plugin_name,
     internal_.push_back(plugin_name);
   }
 
+  publishUnsafe();
   return Status::success();
 }
 
@@ -261,6 +266,7 @@ Status RegistryInterface::addExternal(const RouteUUID& uuid,
     {
       WriteLock wlock(mutex_);
       routes_[route.first] = route.second;
+      publishUnsafe();
     }
 
     auto status = addExternalPlugin(route.first, route.second);
@@ -268,6 +274,7 @@ Status RegistryInterface::addExternal(const RouteUUID& uuid,
     if (status.ok()) {
       WriteLock wlock(mutex_);
       external_[route.first] = uuid;
+      publishUnsafe();
     } else {
       return status;
     }
@@ -301,14 +308,18 @@ void RegistryInterface::removeExternal(const RouteUUID& uuid) {
       external_.erase(item);
       routes_.erase(item);
     }
+    publishUnsafe();
   }
 }
 
 /// Facility method to check if a registry item exists.
 bool RegistryInterface::exists(const std::string& item_name, bool local) const {
-  ReadLock lock(mutex_);
+  auto current = lookup();
 
-  return existsUnsafe(item_name, local);
+  bool has_local = (current->items.count(item_name) > 0);
+  bool has_external = (current->external.count(item_name) > 0);
+  bool has_route = (current->routes.count(item_name) > 0);
+  return (local) ? has_local : has_local || has_external || has_route;
 }
 
 /// Facility method to list the registry item identifiers.
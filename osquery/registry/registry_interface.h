@@ -11,6 +11,7 @@
 
 #include <functional>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <string>
 
@@ -233,14 +234,33 @@ class RegistryInterface : private boost::noncopyable {
   /// Protect concurrent accesses to object's data
   mutable Mutex mutex_;
 
+ protected:
+  /// The plugin, exists and call lookups, copied when the registry changes.
+  struct Lookup {
+    std::map<std::string, PluginRef> items;
+    std::map<std::string, RouteUUID> external;
+    std::map<std::string, PluginResponse> routes;
+  };
+
+  /// Load the current lookup, this does not take mutex_.
+  std::shared_ptr<const Lookup> lookup() const {
+    return std::atomic_load(&lookup_);
+  }
+
  private:
   friend class RegistryFactory;
 
+  /// Publish the lookup of the current items, mutex_ must be held.
+  void publishUnsafe();
+
   void removeUnsafe(const std::string& item_name);
 
   bool isInternalUnsafe(const std::string& item_name) const;
 
   bool existsUnsafe(const std::string& item_name, bool local) const;
+
+  /// Replaced as a whole, readers keep the lookup they loaded.
+  std::shared_ptr<const Lookup> lookup_{std::make_shared<Lookup>()};
 };
 
 /**
@@ -282,12 +302,13 @@ class RegistryType : public RegistryInterface {
    * @return A std::shared_ptr of type RegistryType.
    */
   PluginRef plugin(const std::string& plugin_name) const override {
-    ReadLock lock(mutex_);
+    auto current = lookup();
 
-    if (items_.count(plugin_name) == 0) {
+    auto it = current->items.find(plugin_name);
+    if (it == current->items.end()) {
       return nullptr;
     }
-    return items_.at(plugin_name);
+    return it->second;
   }
 
   /// Trampoline function for calling the PluginType's addExternal.
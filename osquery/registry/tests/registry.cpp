@@ -7,6 +7,9 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <atomic>
+#include <thread>
+
 #include <gtest/gtest.h>
 
 #include <osquery/logger/logger.h>
@@ -98,6 +101,36 @@ TEST_F(RegistryTests, test_registry) {
   EXPECT_EQ(cats.plugins().size(), 2U);
 }
 
+TEST_F(RegistryTests, test_registry_concurrent_lookups) {
+  CatRegistry cats("cats");
+  cats.add("house", std::make_shared<HouseCat>());
+
+  // Lookups keep working while other items are added and removed.
+  std::atomic<bool> done{false};
+  std::atomic<size_t> missing{0};
+  std::thread reader([&cats, &done, &missing]() {
+    while (!done) {
+      if (cats.plugin("house") == nullptr || !cats.exists("house")) {
+        missing++;
+      }
+    }
+  });
+
+  for (size_t i = 0; i < 100; ++i) {
+    auto name = "stray" + std::to_string(i);
+    cats.add(name, std::make_shared<HouseCat>());
+    EXPECT_TRUE(cats.exists(name));
+    cats.remove(name);
+    EXPECT_FALSE(cats.exists(name));
+    EXPECT_EQ(cats.plugin(name), nullptr);
+  }
+
+  done = true;
+  reader.join();
+  EXPECT_EQ(missing, 0U);
+  EXPECT_EQ(cats.count(), 1U);
+}
+
 TEST_F(RegistryTests, test_auto_factory) {
   /// Using the registry, and a registry type by name, we can register a
   /// plugin HouseCat called "house" like above.
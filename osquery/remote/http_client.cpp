@@ -12,9 +12,227 @@
 
 #include <boost/asio/connect.hpp>
 
+#include <openssl/x509.h>
+
+#include <chrono>
+#include <map>
+#include <mutex>
+
 namespace osquery {
 namespace http {
 
+namespace {
+
+/**
+ * @brief TLS sessions of previous connections, shared by every client.
+ *
+ * Each plugin thread keeps its own client, and a client reconnects when the
+ * server closes the connection or the session timeout expires. Resuming a
+ * cached session replaces the full handshake with an abbreviated one.
+ */
+class SessionCache final {
+ public:
+  ~SessionCache() {
+    for (auto& session : sessions_) {
+      ::SSL_SESSION_free(session.second);
+    }
+  }
+
+  /// Set the cached session on a new connection, true if there was one.
+  bool restore(const std::string& key, SSL* ssl) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = sessions_.find(key);
+    return it != sessions_.end() && ::SSL_set_session(ssl, it->second) == 1;
+  }
+
+  /// Replace the cached session, the cache takes the reference.
+  void save(const std::string& key, SSL_SESSION* session) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& cached = sessions_[key];
+    if (cached != nullptr) {
+      ::SSL_SESSION_free(cached);
+    }
+    cached = session;
+  }
+
+  void remove(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = sessions_.find(key);
+    if (it != sessions_.end()) {
+      ::SSL_SESSION_free(it->second);
+      sessions_.erase(it);
+    }
+  }
+
+ private:
+  std::mutex mutex_;
+  std::map<std::string, SSL_SESSION*> sessions_;
+};
+
+SessionCache& getSessionCache() {
+  static SessionCache cache;
+  return cache;
+}
+
+/**
+ * @brief Server certificate chains verified by the clients.
+ *
+ * A reconnection without a resumed session presents the same chain again,
+ * it is not verified until the entry expires.
+ */
+class VerifiedChainCache final {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  bool verified(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = chains_.find(key);
+    if (it == chains_.end()) {
+      return false;
+    }
+    if (it->second <= Clock::now()) {
+      chains_.erase(it);
+      return false;
+    }
+    return true;
+  }
+
+  void save(const std::string& key, std::chrono::seconds timeout) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto now = Clock::now();
+    if (chains_.size() >= kMaxChains) {
+      for (auto it = chains_.begin(); it != chains_.end();) {
+        it = (it->second <= now) ? chains_.erase(it) : std::next(it);
+      }
+      if (chains_.size() >= kMaxChains) {
+        chains_.clear();
+      }
+    }
+    chains_[key] = now + timeout;
+  }
+
+ private:
+  /// Clients connect to few servers, this bounds a changing chain.
+  static const size_t kMaxChains{64};
+
+  std::mutex mutex_;
+  std::map<std::string, Clock::time_point> chains_;
+};
+
+VerifiedChainCache& getVerifiedChainCache() {
+  static VerifiedChainCache cache;
+  return cache;
+}
+
+/**
+ * @brief The addresses of the hosts resolved by the clients.
+ *
+ * A client resolves its host again on every connection, after the server
+ * closed the socket or a request failed. The system resolver does not report
+ * the TTL of its answers, the addresses are reused for the time to live of
+ * the client options instead. An address that cannot be connected to is
+ * resolved again.
+ */
+class ResolverCache final {
+ public:
+  using Clock = std::chrono::steady_clock;
+  using Results = boost::asio::ip::tcp::resolver::results_type;
+
+  bool get(const std::string& key, Results& results) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = hosts_.find(key);
+    if (it == hosts_.end()) {
+      return false;
+    }
+    if (it->second.expires <= Clock::now()) {
+      hosts_.erase(it);
+      return false;
+    }
+    results = it->second.results;
+    return true;
+  }
+
+  void save(const std::string& key,
+            const Results& results,
+            std::chrono::seconds ttl) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto now = Clock::now();
+    if (hosts_.size() >= kMaxHosts) {
+      for (auto it = hosts_.begin(); it != hosts_.end();) {
+        it = (it->second.expires <= now) ? hosts_.erase(it) : std::next(it);
+      }
+      if (hosts_.size() >= kMaxHosts) {
+        hosts_.clear();
+      }
+    }
+    hosts_[key] = {results, now + ttl};
+  }
+
+  void remove(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    hosts_.erase(key);
+  }
+
+ private:
+  struct Host {
+    Results results;
+    Clock::time_point expires;
+  };
+
+  /// The curl table may resolve many hosts, this bounds the addresses kept.
+  static const size_t kMaxHosts{256};
+
+  std::mutex mutex_;
+  std::map<std::string, Host> hosts_;
+};
+
+ResolverCache& getResolverCache() {
+  static ResolverCache cache;
+  return cache;
+}
+
+/// Append the hex SHA-256 fingerprint of a certificate, false on failure.
+bool appendFingerprint(X509* cert, std::string& key) {
+  unsigned char digest[EVP_MAX_MD_SIZE];
+  unsigned int length = 0;
+  if (::X509_digest(cert, ::EVP_sha256(), digest, &length) != 1) {
+    return false;
+  }
+
+  static const char kHex[] = "0123456789abcdef";
+  key += '\n';
+  for (unsigned int i = 0; i < length; ++i) {
+    key += kHex[digest[i] >> 4];
+    key += kHex[digest[i] & 0xf];
+  }
+  return true;
+}
+
+/// The cache key of a presented chain, empty if it cannot be cached.
+std::string chainCacheKey(X509_STORE_CTX* store, const std::string& client) {
+  auto* leaf = ::X509_STORE_CTX_get0_cert(store);
+  if (leaf == nullptr ||
+      ::X509_cmp_current_time(::X509_get0_notBefore(leaf)) >= 0 ||
+      ::X509_cmp_current_time(::X509_get0_notAfter(leaf)) <= 0) {
+    return "";
+  }
+
+  auto key = client;
+  if (!appendFingerprint(leaf, key)) {
+    return "";
+  }
+
+  auto* untrusted = ::X509_STORE_CTX_get0_untrusted(store);
+  auto count = untrusted != nullptr ? sk_X509_num(untrusted) : 0;
+  for (int i = 0; i < count; ++i) {
+    if (!appendFingerprint(sk_X509_value(untrusted, i), key)) {
+      return "";
+    }
+  }
+  return key;
+}
+} // namespace
+
 const std::string kHTTPSDefaultPort{"443"};
 const std::string kHTTPDefaultPort{"80"};
 const std::string kProxyDefaultPort{"3128"};
@@ -116,8 +334,21 @@ void Client::createConnection() {
     connect_host = connect_host.substr(0, pos);
   }
 
-  // We can resolve async, but there is a handle leak in Windows.
-  auto results = r_.resolve(connect_host, port, ec_);
+  auto& resolver_cache = getResolverCache();
+  auto resolver_key = connect_host + ":" + port;
+  auto dns_cache_ttl = std::chrono::seconds(client_options_.dns_cache_ttl_);
+
+  boost::asio::ip::tcp::resolver::results_type results;
+  bool resolved_cached = dns_cache_ttl.count() > 0 &&
+                         resolver_cache.get(resolver_key, results);
+  if (!resolved_cached) {
+    // We can resolve async, but there is a handle leak in Windows.
+    results = r_.resolve(connect_host, port, ec_);
+    if (!ec_ && dns_cache_ttl.count() > 0) {
+      resolver_cache.save(resolver_key, results, dns_cache_ttl);
+    }
+  }
+
   if (!ec_) {
     callNetworkOperation([&]() {
       boost::asio::async_connect(sock_,
@@ -130,6 +361,9 @@ void Client::createConnection() {
   }
 
   if (ec_) {
+    // The host may have moved, the next connection resolves it again.
+    resolver_cache.remove(resolver_key);
+
     std::string error("Failed to connect to ");
     if (client_options_.proxy_hostname_) {
       error += "proxy host ";
@@ -235,6 +469,21 @@ void Client::encryptConnection() {
   ssl_sock_->set_verify_callback(boost::asio::ssl::rfc2818_verification(
       *client_options_.remote_hostname_));
 
+  // The host name is checked while verifying, the chain cache key has it.
+  auto verifies = client_options_.always_verify_peer_ ||
+                  client_options_.server_certificate_ ||
+                  client_options_.verify_path_;
+  if (verifies && client_options_.verify_cache_timeout_ > 0) {
+    ::SSL_CTX_set_cert_verify_callback(
+        ctx.native_handle(), &Client::verifyChain, this);
+  }
+
+  bool resumed = false;
+  if (client_options_.session_resumption_) {
+    resumed = getSessionCache().restore(sessionCacheKey(),
+                                        ssl_sock_->native_handle());
+  }
+
   callNetworkOperation([&]() {
     ssl_sock_->async_handshake(
         boost::asio::ssl::stream_base::client,
@@ -242,10 +491,63 @@ void Client::encryptConnection() {
   });
 
   if (ec_) {
+    // Do not offer the same session again, it may be the cause.
+    if (resumed) {
+      getSessionCache().remove(sessionCacheKey());
+    }
     throw std::system_error(ec_);
   }
 }
 
+std::string Client::sessionCacheKey() const {
+  const auto& opts = client_options_;
+
+  std::string key = opts.remote_hostname_.value_or("") + ':' +
+                    opts.remote_port_.value_or("");
+  for (const auto& option : {opts.server_certificate_,
+                             opts.verify_path_,
+                             opts.client_certificate_file_,
+                             opts.client_private_key_file_,
+                             opts.ciphers_,
+                             opts.proxy_hostname_}) {
+    key += '\n' + option.value_or("");
+  }
+  key += '\n' + std::to_string(opts.ssl_options_) +
+         (opts.always_verify_peer_ ? "v" : "");
+  return key;
+}
+
+void Client::saveSession() {
+  // TLS 1.3 sessions are sent after the handshake, with the response.
+  auto session = ::SSL_get1_session(ssl_sock_->native_handle());
+  if (session == nullptr) {
+    return;
+  }
+
+  if (::SSL_SESSION_is_resumable(session) != 1) {
+    ::SSL_SESSION_free(session);
+    return;
+  }
+
+  getSessionCache().save(sessionCacheKey(), session);
+}
+
+int Client::verifyChain(X509_STORE_CTX* store, void* client) {
+  auto* self = static_cast<Client*>(client);
+  auto key = chainCacheKey(store, self->sessionCacheKey());
+  if (!key.empty() && getVerifiedChainCache().verified(key)) {
+    return 1;
+  }
+
+  auto verified = ::X509_verify_cert(store);
+  if (verified == 1 && !key.empty()) {
+    getVerifiedChainCache().save(
+        key,
+        std::chrono::seconds(self->client_options_.verify_cache_timeout_));
+  }
+  return verified;
+}
+
 template <typename STREAM_TYPE>
 void Client::sendRequest(STREAM_TYPE& stream,
                          Request& req,
@@ -304,6 +606,11 @@ void Client::sendRequest(STREAM_TYPE& stream,
     throw std::system_error(ec_);
   }
 
+  if (client_options_.ssl_connection_ &&
+      client_options_.session_resumption_ && ssl_sock_ != nullptr) {
+    saveSession();
+  }
+
   if (resp.get()["Connection"] == "close") {
     closeSocket();
   }
@@ -94,7 +94,10 @@ class Client {
           always_verify_peer_(false),
           follow_redirects_(false),
           keep_alive_(false),
-          ssl_connection_(false) {}
+          ssl_connection_(false),
+          session_resumption_(false),
+          verify_cache_timeout_(0),
+          dns_cache_ttl_(0) {}
 
     Options& ssl_connection(bool ct) {
       ssl_connection_ = ct;
@@ -106,6 +109,21 @@ class Client {
       return *this;
     }
 
+    Options& session_resumption(bool sr) {
+      session_resumption_ = sr;
+      return *this;
+    }
+
+    Options& verify_cache_timeout(uint64_t vct) {
+      verify_cache_timeout_ = vct;
+      return *this;
+    }
+
+    Options& dns_cache_ttl(uint32_t dct) {
+      dns_cache_ttl_ = dct;
+      return *this;
+    }
+
     Options& follow_redirects(bool fr) {
       follow_redirects_ = fr;
       return *this;
@@ -180,7 +198,10 @@ class Client {
              (always_verify_peer_ == ropts.always_verify_peer_) &&
              (follow_redirects_ == ropts.follow_redirects_) &&
              (keep_alive_ == ropts.keep_alive_) &&
-             (ssl_connection_ == ropts.ssl_connection_);
+             (ssl_connection_ == ropts.ssl_connection_) &&
+             (session_resumption_ == ropts.session_resumption_) &&
+             (verify_cache_timeout_ == ropts.verify_cache_timeout_) &&
+             (dns_cache_ttl_ == ropts.dns_cache_ttl_);
     }
 
    private:
@@ -198,6 +219,9 @@ class Client {
     bool follow_redirects_;
     bool keep_alive_;
     bool ssl_connection_;
+    bool session_resumption_;
+    uint64_t verify_cache_timeout_;
+    uint32_t dns_cache_ttl_;
     friend class Client;
   };
 
@@ -262,6 +286,31 @@ class Client {
   /// Convert plain socket to TLS socket.
   void encryptConnection();
 
+  /**
+   * @brief The TLS session cache key of the current options.
+   *
+   * Sessions are only resumed by clients connecting to the same server with
+   * the same verification and client authentication settings.
+   */
+  std::string sessionCacheKey() const;
+
+  /// Keep the TLS session of the connection for the next connections.
+  void saveSession();
+
+  /**
+   * @brief Verify a server certificate chain, or find it verified.
+   *
+   * The chains verified by any client are kept for verify_cache_timeout_
+   * seconds, while the leaf certificate is valid. A chain is only found by
+   * clients with the same session cache key, so the same server name and
+   * trust settings.
+   *
+   * @param store The chain presented by the server, in OpenSSL's context.
+   * @param client The client connecting.
+   * @return 1 if the chain is trusted, otherwise 0.
+   */
+  static int verifyChain(X509_STORE_CTX* store, void* client);
+
   template <typename STREAM_TYPE>
   void sendRequest(STREAM_TYPE& stream,
                    Request& req,
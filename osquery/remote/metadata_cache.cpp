@@ -0,0 +1,94 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <osquery/core/flags.h>
+#include <osquery/remote/metadata_cache.h>
+
+namespace osquery {
+
+FLAG(uint64,
+     cloud_metadata_ttl,
+     60,
+     "Seconds cloud instance metadata responses are reused, 0 disables");
+
+MetadataCache& MetadataCache::get() {
+  static MetadataCache cache;
+  return cache;
+}
+
+Status MetadataCache::lookup(const std::string& key,
+                             std::chrono::seconds ttl,
+                             const Fetch& fetch,
+                             std::string& body) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto& entry = entries_[key];
+  if (entry.valid && std::chrono::steady_clock::now() < entry.expires) {
+    body = entry.body;
+    return Status::success();
+  }
+
+  if (entry.fetching) {
+    // Another lookup is requesting the endpoint, share its result.
+    auto generation = entry.generation;
+    fetched_.wait(lock, [&entry, generation]() {
+      return entry.generation != generation;
+    });
+    if (entry.status.ok()) {
+      body = entry.body;
+    }
+    return entry.status;
+  }
+
+  entry.fetching = true;
+  lock.unlock();
+
+  std::string response;
+  Status status;
+  try {
+    status = fetch(response);
+  } catch (const std::exception& e) {
+    status = Status::failure(e.what());
+  }
+
+  lock.lock();
+  entry.fetching = false;
+  entry.generation++;
+  entry.status = status;
+  entry.body = status.ok() ? response : std::string();
+  entry.expires = std::chrono::steady_clock::now() + ttl;
+  entry.valid = status.ok() && ttl.count() > 0;
+  lock.unlock();
+  fetched_.notify_all();
+
+  if (status.ok()) {
+    body = std::move(response);
+  }
+  return status;
+}
+
+void MetadataCache::invalidate(const std::string& key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto entry = entries_.find(key);
+  if (entry != entries_.end()) {
+    entry->second.valid = false;
+  }
+}
+
+void MetadataCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& entry : entries_) {
+    entry.second.valid = false;
+  }
+}
+
+std::chrono::seconds getMetadataCacheTTL() {
+  return std::chrono::seconds(FLAGS_cloud_metadata_ttl);
+}
+
+} // namespace osquery
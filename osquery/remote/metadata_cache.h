@@ -0,0 +1,89 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/**
+ * @brief Instance metadata responses shared by the cloud tables.
+ *
+ * The cloud metadata services (EC2 IMDS, Azure IMDS, Yandex Cloud) answer
+ * the same requests for every query of their tables. Responses are kept
+ * for a TTL chosen for each endpoint, and concurrent lookups of a missing
+ * or expired response wait for a single request. Failures are not kept
+ * for later lookups.
+ */
+class MetadataCache : private boost::noncopyable {
+ public:
+  /// Request the response body of an endpoint.
+  using Fetch = std::function<Status(std::string& body)>;
+
+  static MetadataCache& get();
+
+  /**
+   * @brief Get the cached response of an endpoint, or fetch it.
+   *
+   * Lookups waiting for a request share its result, a failure included.
+   *
+   * @param key the endpoint and any parameters changing its response.
+   * @param ttl how long a response is kept, 0 requests every lookup.
+   * @param fetch requests the response, called by one lookup at a time.
+   * @param body the response body.
+   */
+  Status lookup(const std::string& key,
+                std::chrono::seconds ttl,
+                const Fetch& fetch,
+                std::string& body);
+
+  /// Forget a response, for example a rejected token.
+  void invalidate(const std::string& key);
+
+  /// Forget every response.
+  void clear();
+
+ private:
+  MetadataCache() = default;
+
+  struct Entry {
+    std::string body;
+    std::chrono::steady_clock::time_point expires;
+    bool valid{false};
+
+    /// A lookup is requesting the endpoint.
+    bool fetching{false};
+
+    /// The result of the latest request, shared with waiting lookups.
+    Status status;
+    size_t generation{0};
+  };
+
+  std::mutex mutex_;
+
+  /// Notified when a request completes.
+  std::condition_variable fetched_;
+
+  std::map<std::string, Entry> entries_;
+};
+
+/// The default TTL of cached instance metadata responses.
+std::chrono::seconds getMetadataCacheTTL();
+
+} // namespace osquery
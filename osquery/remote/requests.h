@@ -9,6 +9,7 @@
 
 #pragma once
 
+#include <chrono>
 #include <memory>
 #include <utility>
 #include <string>
@@ -89,6 +90,15 @@ class Transport {
    */
   Status getResponseStatus() const { return response_status_; }
 
+  /**
+   * @brief Get the time the server asked to wait before the next request
+   *
+   * @return The time, zero if the server did not ask to wait
+   */
+  std::chrono::seconds getRetryAfter() const {
+    return retry_after_;
+  }
+
   /**
    * @brief Get the parameters of the response
    *
@@ -121,6 +131,9 @@ class Transport {
   /// storage for response parameters
   JSON response_params_;
 
+  /// storage for the time the server asked to wait before the next request
+  std::chrono::seconds retry_after_{std::chrono::seconds::zero()};
+
   /// options from request call (use defined by specific transport)
   JSON options_;
 };
@@ -231,6 +244,17 @@ class Request {
       return s;
     }
 
+    return call(serialized);
+  }
+
+  /**
+   * @brief Send a request to the destination with serialized parameters
+   *
+   * @param serialized the parameters, already in the serializer's format
+   *
+   * @return success or failure of the operation
+   */
+  Status call(const std::string& serialized) {
     bool compress = false;
     auto it = options_.doc().FindMember("compress");
     if (it != options_.doc().MemberEnd() && it->value.IsBool()) {
@@ -250,6 +274,11 @@ class Request {
     return transport_->getResponseStatus();
   }
 
+  /// Get the time the server asked to wait before the next request.
+  std::chrono::seconds getRetryAfter() const {
+    return transport_->getRetryAfter();
+  }
+
   template <typename T>
   void setOption(const std::string& name, const T& value) {
     options_.add(name, value);
@@ -0,0 +1,105 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <osquery/remote/metadata_cache.h>
+
+namespace osquery {
+
+class MetadataCacheTests : public testing::Test {
+ public:
+  void SetUp() override {
+    MetadataCache::get().clear();
+  }
+};
+
+TEST_F(MetadataCacheTests, test_lookup_ttl) {
+  auto& cache = MetadataCache::get();
+  size_t requests = 0;
+  auto fetch = [&requests](std::string& body) {
+    body = "response" + std::to_string(++requests);
+    return Status::success();
+  };
+
+  std::string body;
+  ASSERT_TRUE(cache.lookup("kept", std::chrono::seconds(60), fetch, body).ok());
+  EXPECT_EQ(body, "response1");
+  ASSERT_TRUE(cache.lookup("kept", std::chrono::seconds(60), fetch, body).ok());
+  EXPECT_EQ(body, "response1");
+
+  cache.invalidate("kept");
+  ASSERT_TRUE(cache.lookup("kept", std::chrono::seconds(60), fetch, body).ok());
+  EXPECT_EQ(body, "response2");
+
+  // A TTL of 0 requests every lookup.
+  ASSERT_TRUE(cache.lookup("uncached", std::chrono::seconds(0), fetch, body)
+                  .ok());
+  ASSERT_TRUE(cache.lookup("uncached", std::chrono::seconds(0), fetch, body)
+                  .ok());
+  EXPECT_EQ(body, "response4");
+}
+
+TEST_F(MetadataCacheTests, test_lookup_failures) {
+  auto& cache = MetadataCache::get();
+  size_t requests = 0;
+  auto fetch = [&requests](std::string& body) {
+    if (++requests == 1) {
+      return Status::failure("unavailable");
+    }
+    body = "response";
+    return Status::success();
+  };
+
+  std::string body;
+  EXPECT_FALSE(
+      cache.lookup("failing", std::chrono::seconds(60), fetch, body).ok());
+  EXPECT_TRUE(body.empty());
+
+  // Failures are not kept, the next lookup requests the endpoint again.
+  ASSERT_TRUE(
+      cache.lookup("failing", std::chrono::seconds(60), fetch, body).ok());
+  EXPECT_EQ(body, "response");
+  EXPECT_EQ(requests, 2U);
+}
+
+TEST_F(MetadataCacheTests, test_lookup_concurrent) {
+  auto& cache = MetadataCache::get();
+  std::atomic<size_t> requests{0};
+  auto fetch = [&requests](std::string& body) {
+    requests++;
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    body = "response";
+    return Status::success();
+  };
+
+  std::atomic<size_t> responses{0};
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < 8; ++i) {
+    threads.emplace_back([&cache, &fetch, &responses]() {
+      std::string body;
+      if (cache.lookup("shared", std::chrono::seconds(60), fetch, body).ok() &&
+          body == "response") {
+        responses++;
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(responses, 8U);
+  EXPECT_EQ(requests, 1U);
+}
+
+} // namespace osquery
@@ -12,7 +12,9 @@
 #include <chrono>
 #include <osquery/core/core.h>
 #include <osquery/filesystem/filesystem.h>
+#include <osquery/numeric_monitoring/numeric_monitoring.h>
 #include <osquery/utils/config/default_paths.h>
+#include <osquery/utils/conversions/tryto.h>
 #include <osquery/utils/info/platform_type.h>
 #include <osquery/utils/info/version.h>
 
@@ -54,6 +56,26 @@ CLI_FLAG(string,
 /// Reuse TLS session sockets.
 CLI_FLAG(bool, tls_session_reuse, true, "Reuse TLS session sockets");
 
+/// Resume the TLS sessions of previous connections.
+CLI_FLAG(bool,
+         tls_session_resumption,
+         true,
+         "Resume TLS sessions when reconnecting to a TLS server");
+
+/// Trust verified server certificate chains for a while.
+CLI_FLAG(uint64,
+         tls_verify_cache_timeout,
+         3600,
+         "Seconds a verified TLS server certificate chain is trusted again "
+         "without verification (0 = disabled)");
+
+/// Reuse the addresses of resolved hosts.
+CLI_FLAG(uint32,
+         tls_dns_cache_ttl,
+         60,
+         "Seconds the resolved addresses of a remote host are reused "
+         "(0 = disabled)");
+
 /// Tear down TLS sessions after a custom timeout.
 CLI_FLAG(uint32,
          tls_session_timeout,
@@ -97,7 +119,16 @@ void TLSTransport::decorateRequest(http::Request& r) {
 http::Client::Options TLSTransport::getOptions() {
   http::Client::Options options;
 
-  options.follow_redirects(true).always_verify_peer(verify_peer_).timeout(16);
+  // Requests may extend the timeout, e.g. when the server holds them.
+  int timeout = 16;
+  auto it = options_.doc().FindMember("timeout");
+  if (it != options_.doc().MemberEnd() && it->value.IsInt()) {
+    timeout = it->value.GetInt();
+  }
+
+  options.follow_redirects(true).always_verify_peer(verify_peer_).timeout(
+      timeout);
+  options.dns_cache_ttl(FLAGS_tls_dns_cache_ttl);
 
   if (server_certificate_file_.size() > 0) {
     if (!osquery::isReadable(server_certificate_file_).ok()) {
@@ -150,6 +181,8 @@ http::Client::Options TLSTransport::getInternalOptions() {
   auto options = getOptions();
 
   options.keep_alive(FLAGS_tls_session_reuse);
+  options.session_resumption(FLAGS_tls_session_resumption);
+  options.verify_cache_timeout(FLAGS_tls_verify_cache_timeout);
 
   if (FLAGS_proxy_hostname.size() > 0) {
     options.proxy_hostname(FLAGS_proxy_hostname);
@@ -210,12 +243,35 @@ void printRawStderr(const std::string& s) {
   fprintf(stderr, "%s\n", s.c_str());
 }
 
+void TLSTransport::checkRetryAfter() {
+  retry_after_ = std::chrono::seconds::zero();
+  auto code = response_.status();
+  if (code != 429 && code != 503) {
+    return;
+  }
+
+  // Only the delay in seconds form of the header is used.
+  auto seconds = tryTo<uint64_t>(response_.headers()["Retry-After"], 10);
+  if (seconds.isValue()) {
+    retry_after_ = std::chrono::seconds(seconds.get());
+  }
+  response_status_ = Status::failure("Request rejected with HTTP status " +
+                                     std::to_string(code));
+}
+
+/// The time TLS requests take, including reading and parsing the response.
+static const monitoring::LatencyMetric& requestLatency() {
+  static const monitoring::LatencyMetric metric("remote.tls.request");
+  return metric;
+}
+
 Status TLSTransport::sendRequest() {
   if (destination_.find("https://") == std::string::npos) {
     return Status::failure(
         "Cannot create TLS request for non-HTTPS protocol URI");
   }
 
+  monitoring::LatencyTimer timer(requestLatency());
   http::Request r(destination_);
   decorateRequest(r);
 
@@ -233,6 +289,7 @@ Status TLSTransport::sendRequest() {
     }
     response_status_ =
         serializer_->deserialize(response_body, response_params_);
+    checkRetryAfter();
   } catch (const std::exception& e) {
     return Status::failure(std::string("Request error: ") + e.what());
   }
@@ -245,6 +302,7 @@ Status TLSTransport::sendRequest(const std::string& params, bool compress) {
         "Cannot create TLS request for non-HTTPS protocol URI");
   }
 
+  monitoring::LatencyTimer timer(requestLatency());
   http::Request r(destination_);
   decorateRequest(r);
   if (compress) {
@@ -284,6 +342,7 @@ Status TLSTransport::sendRequest(const std::string& params, bool compress) {
     }
     response_status_ =
         serializer_->deserialize(response_body, response_params_);
+    checkRetryAfter();
   } catch (const std::exception& e) {
     return Status::failure(std::string("Request error: ") + e.what());
   }
@@ -134,6 +134,14 @@ class TLSTransport : public Transport {
    */
   void decorateRequest(http::Request& r);
 
+  /**
+   * @brief Fail a response asking the client to slow down
+   *
+   * A HTTP 429 or 503 response fails the request, the seconds of its
+   * Retry-After header are kept for the caller.
+   */
+  void checkRetryAfter();
+
  protected:
   /// Storage for the HTTP response object
   http::Response response_;
@@ -84,7 +84,6 @@ class TLSRequestHelper : private boost::noncopyable {
   template <class TSerializer>
   static Status go(const std::string& uri, JSON& params, JSON& output) {
     auto& params_doc = params.doc();
-    auto& output_doc = output.doc();
 
     auto node_key = getNodeKey("tls");
 
@@ -108,6 +107,17 @@ class TLSRequestHelper : private boost::noncopyable {
       params_doc.RemoveMember("_compress");
     }
 
+    // The caller-supplied parameters may extend the request timeout.
+    int timeout = 0;
+    it = params_doc.FindMember("_timeout");
+    if (it != params_doc.MemberEnd()) {
+      assert(it->value.IsInt());
+
+      timeout = it->value.GetInt();
+      request.setOption("timeout", timeout);
+      params_doc.RemoveMember("_timeout");
+    }
+
     // The caller-supplied parameters may force a POST request.
     bool force_post = false;
     it = params_doc.FindMember("_verb");
@@ -136,6 +146,10 @@ class TLSRequestHelper : private boost::noncopyable {
       params.add("_compress", true);
     }
 
+    if (timeout != 0) {
+      params.add("_timeout", timeout);
+    }
+
     if (!status.ok()) {
       return status;
     }
@@ -146,40 +160,77 @@ class TLSRequestHelper : private boost::noncopyable {
       return status;
     }
 
-    // Receive config or key rejection
-    it = output_doc.FindMember("node_invalid");
-    if (it != output_doc.MemberEnd()) {
-      assert(it->value.IsBool());
-
-      if (it->value.GetBool()) {
-        if (!FLAGS_disable_reenrollment) {
-          clearNodeKey();
-        }
+    return checkResponse(output);
+  }
 
-        std::string message = "Request failed: Invalid node key";
+  /**
+   * @brief Send a TLS request with a body that was already serialized
+   *
+   * The body is sent in a POST request as-is, it must include the node_key
+   * since it cannot be added.
+   *
+   * @param uri is the URI to send the request to
+   * @param body is the serialized params to send to the server
+   * @param compress whether the body is compressed before sending
+   * @param output is the JSON which will be populated with the deserialized
+   * results
+   *
+   * @return a Status object indicating the success or failure of the operation
+   */
+  template <class TSerializer>
+  static Status go(const std::string& uri,
+                   const std::string& body,
+                   bool compress,
+                   JSON& output) {
+    std::chrono::seconds retry_after;
+    return TLSRequestHelper::go<TSerializer>(
+        uri, body, compress, output, retry_after);
+  }
 
-        it = output_doc.FindMember("error");
-        if (it != output_doc.MemberEnd()) {
-          message +=
-              ": " + std::string(it->value.IsString() ? it->value.GetString()
-                                                      : "<unknown>");
-        }
+  /**
+   * @brief Send a TLS request with a body that was already serialized
+   *
+   * @param uri is the URI to send the request to
+   * @param body is the serialized params to send to the server, including
+   * the node_key
+   * @param compress whether the body is compressed before sending
+   * @param output is the JSON which will be populated with the deserialized
+   * results
+   * @param retry_after is set to the time the server asked to wait before the
+   * next request, zero if it did not
+   *
+   * @return a Status object indicating the success or failure of the operation
+   */
+  template <class TSerializer>
+  static Status go(const std::string& uri,
+                   const std::string& body,
+                   bool compress,
+                   JSON& output,
+                   std::chrono::seconds& retry_after) {
+    retry_after = std::chrono::seconds::zero();
+    std::string uri_suffix;
+    if (FLAGS_tls_node_api) {
+      uri_suffix = "&node_key=" + getNodeKey("tls");
+    }
 
-        return Status(1, message);
-      }
+    Request<TLSTransport, TSerializer> request(uri + uri_suffix);
+    request.setOption("hostname", FLAGS_tls_hostname);
+    if (compress) {
+      request.setOption("compress", compress);
     }
 
-    it = output_doc.FindMember("error");
-    if (it != output_doc.MemberEnd()) {
-      std::string message =
-          "Request failed: " + std::string(it->value.IsString()
-                                               ? it->value.GetString()
-                                               : "<unknown>");
+    auto status = request.call(body);
+    if (!status.ok()) {
+      retry_after = request.getRetryAfter();
+      return status;
+    }
 
-      return Status(1, message);
+    status = request.getResponse(output);
+    if (!status.ok()) {
+      return status;
     }
 
-    return Status::success();
+    return checkResponse(output);
   }
 
   /**
@@ -252,6 +303,32 @@ class TLSRequestHelper : private boost::noncopyable {
                    JSON& params,
                    std::string& output,
                    const uint64_t attempts) {
+    JSON recv;
+    auto s = TLSRequestHelper::go<TSerializer>(uri, params, recv, attempts);
+    if (s.ok()) {
+      auto serializer = TSerializer();
+      return serializer.serialize(recv, output);
+    }
+    return s;
+  }
+
+  /**
+   * @brief Send a TLS request
+   *
+   * @param uri is the URI to send the request to
+   * @param params is a JSON object containing the params to send to the server.
+   * This isn't const because it will be modified to include node_key.
+   * @param output is the JSON which will be populated with the deserialized
+   * results
+   * @param attempts is the number of attempts to make if the request fails
+   *
+   * @return a Status object indicating the success or failure of the operation
+   */
+  template <class TSerializer>
+  static Status go(const std::string& uri,
+                   JSON& params,
+                   JSON& output,
+                   const uint64_t attempts) {
     Status s;
     JSON override_params;
     const auto& params_doc = params.doc();
@@ -292,6 +369,50 @@ class TLSRequestHelper : private boost::noncopyable {
     return s;
   }
 
+  /**
+   * @brief Send a TLS request with a body that was already serialized
+   *
+   * @param uri is the URI to send the request to
+   * @param body is the serialized params to send to the server, including
+   * the node_key
+   * @param compress whether the body is compressed before sending
+   * @param output is the JSON which will be populated with the deserialized
+   * results
+   * @param attempts is the number of attempts to make if the request fails
+   *
+   * @return a Status object indicating the success or failure of the operation
+   */
+  template <class TSerializer>
+  static Status go(const std::string& uri,
+                   const std::string& body,
+                   bool compress,
+                   JSON& output,
+                   const uint64_t attempts) {
+    Status s;
+    bool should_shutdown = false;
+    for (size_t i = 1; i <= attempts && !should_shutdown; i++) {
+      s = TLSRequestHelper::go<TSerializer>(uri, body, compress, output);
+      if (s.ok()) {
+        return s;
+      }
+
+      const auto& sleep_time_seconds = i * i;
+      const auto& errMessage = "HTTP(S) request failed: " + s.getMessage();
+
+      if (i == attempts) {
+        VLOG(1) << errMessage << ", done retrying after " << i << " times";
+        break;
+      } else {
+        VLOG(1) << errMessage << ", retrying in " << sleep_time_seconds
+                << " seconds...";
+      }
+
+      should_shutdown = waitTimeoutOrShutdown(
+          std::chrono::milliseconds(sleep_time_seconds * 1000));
+    }
+    return s;
+  }
+
   /**
    * @brief Send a TLS request
    *
@@ -310,5 +431,46 @@ class TLSRequestHelper : private boost::noncopyable {
     params.add("_get", true);
     return TLSRequestHelper::go<TSerializer>(uri, params, output, attempts);
   }
+
+ private:
+  /// Check a response for a node key rejection or an error.
+  static Status checkResponse(JSON& output) {
+    auto& output_doc = output.doc();
+
+    // Receive config or key rejection
+    auto it = output_doc.FindMember("node_invalid");
+    if (it != output_doc.MemberEnd()) {
+      assert(it->value.IsBool());
+
+      if (it->value.GetBool()) {
+        if (!FLAGS_disable_reenrollment) {
+          clearNodeKey();
+        }
+
+        std::string message = "Request failed: Invalid node key";
+
+        it = output_doc.FindMember("error");
+        if (it != output_doc.MemberEnd()) {
+          message +=
+              ": " + std::string(it->value.IsString() ? it->value.GetString()
+                                                      : "<unknown>");
+        }
+
+        return Status(1, message);
+      }
+    }
+
+    it = output_doc.FindMember("error");
+    if (it != output_doc.MemberEnd()) {
+      std::string message =
+          "Request failed: " + std::string(it->value.IsString()
+                                               ? it->value.GetString()
+                                               : "<unknown>");
+
+      return Status(1, message);
+    }
+
+    return Status::success();
+  }
 };
 } // namespace osquery
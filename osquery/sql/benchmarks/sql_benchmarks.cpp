@@ -295,6 +295,17 @@ static void SQL_select_metadata(benchmark::State& state) {
 
 BENCHMARK(SQL_select_metadata);
 
+static void SQL_new_connection(benchmark::State& state) {
+  // Profile opening a connection and using one of its tables.
+  while (state.KeepRunning()) {
+    auto dbc = SQLiteDBManager::getUnique();
+    QueryData results;
+    queryInternal("select * from osquery_info;", results, dbc);
+  }
+}
+
+BENCHMARK(SQL_new_connection);
+
 static void SQL_select_basic(benchmark::State& state) {
   // Profile executing a query against an internal, already attached table.
   while (state.KeepRunning()) {
@@ -303,4 +314,52 @@ static void SQL_select_basic(benchmark::State& state) {
 }
 
 BENCHMARK(SQL_select_basic);
+
+/// Evaluate a SQL function over 1000 rows of a recursive CTE.
+static void runFunctionBenchmark(benchmark::State& state,
+                                 const std::string& expression) {
+  auto dbc = SQLiteDBManager::getUnique();
+  auto sql =
+      "with recursive r(i) as (select 1 union all select i + 1 from r where "
+      "i < 1000) select " +
+      expression + " from r;";
+  while (state.KeepRunning()) {
+    QueryData results;
+    queryInternal(sql, results, dbc);
+  }
+}
+
+static void SQL_function_split(benchmark::State& state) {
+  runFunctionBenchmark(state, "split('192.168.0.' || i, '.', 3)");
+}
+
+BENCHMARK(SQL_function_split);
+
+static void SQL_function_regex_match(benchmark::State& state) {
+  runFunctionBenchmark(state,
+                       "regex_match('/usr/bin/p' || i, '.+/([^./]+)', 1)");
+}
+
+BENCHMARK(SQL_function_regex_match);
+
+static void SQL_function_base64(benchmark::State& state) {
+  runFunctionBenchmark(
+      state, "from_base64(to_base64(hex(randomblob(64)) || i))");
+}
+
+BENCHMARK(SQL_function_base64);
+
+static void SQL_function_in_cidr_block(benchmark::State& state) {
+  runFunctionBenchmark(
+      state, "in_cidr_block('10.0.0.0/16', '10.0.' || (i % 256) || '.1')");
+}
+
+BENCHMARK(SQL_function_in_cidr_block);
+
+static void SQL_function_community_id(benchmark::State& state) {
+  runFunctionBenchmark(state,
+                       "community_id_v1('10.0.0.1', '10.0.0.2', i, 443, 6)");
+}
+
+BENCHMARK(SQL_function_community_id);
 } // namespace osquery
@@ -0,0 +1,213 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include "columnar_table_row.h"
+#include "virtual_table.h"
+
+#include <cstdlib>
+
+#include <osquery/logger/logger.h>
+#include <osquery/utils/conversions/castvariant.h>
+#include <osquery/utils/conversions/tryto.h>
+
+namespace rj = rapidjson;
+
+namespace osquery {
+
+std::shared_ptr<TableRowBatch> TableRowBatch::create(ColumnNames columns) {
+  return std::shared_ptr<TableRowBatch>(new TableRowBatch(std::move(columns)));
+}
+
+TableRowBatch::TableRowBatch(ColumnNames columns)
+    : columns_(std::move(columns)), values_(columns_.size()) {}
+
+size_t TableRowBatch::column(const std::string& name) const {
+  for (size_t i = 0; i < columns_.size(); ++i) {
+    if (columns_[i] == name) {
+      return i;
+    }
+  }
+  return columns_.size();
+}
+
+size_t TableRowBatch::addRow() {
+  for (auto& column : values_) {
+    column.values.emplace_back();
+    column.present.push_back(false);
+  }
+  return rows_++;
+}
+
+void TableRowBatch::set(size_t row, size_t column, RowDataTyped value) {
+  if (column >= values_.size() || row >= rows_) {
+    return;
+  }
+  values_[column].values[row] = std::move(value);
+  values_[column].present[row] = true;
+}
+
+void TableRowBatch::set(size_t row, size_t column, long long value) {
+  set(row, column, RowDataTyped(value));
+}
+
+void TableRowBatch::set(size_t row, size_t column, double value) {
+  set(row, column, RowDataTyped(value));
+}
+
+void TableRowBatch::set(size_t row, size_t column, std::string value) {
+  set(row, column, RowDataTyped(std::move(value)));
+}
+
+const RowDataTyped* TableRowBatch::value(size_t row, size_t column) const {
+  if (column >= values_.size() || row >= rows_ ||
+      !values_[column].present[row]) {
+    return nullptr;
+  }
+  return &values_[column].values[row];
+}
+
+TableRowHolder TableRowBatch::row(size_t row) {
+  return TableRowHolder(new ColumnarTableRow(shared_from_this(), row));
+}
+
+size_t TableRowBatch::resolve(const VirtualTableContent& content, int column) {
+  if (resolved_table_ != &content) {
+    resolved_.clear();
+    resolved_.reserve(content.columns.size());
+    for (const auto& table_column : content.columns) {
+      auto name = std::get<0>(table_column);
+      auto alias = content.aliases.find(name);
+      if (alias != content.aliases.end()) {
+        // Aliased columns read the values of the column they alias.
+        name = std::get<0>(content.columns[alias->second]);
+      }
+      resolved_.push_back(this->column(name));
+    }
+    resolved_table_ = &content;
+  }
+
+  if (column < 0 || static_cast<size_t>(column) >= resolved_.size()) {
+    return columns_.size();
+  }
+  return resolved_[column];
+}
+
+/// Return a text value for a numeric column, like DynamicTableRow.
+static void resultFromText(sqlite3_context* ctx,
+                           ColumnType type,
+                           const std::string& value) {
+  if (value.empty()) {
+    sqlite3_result_null(ctx);
+  } else if (type == INTEGER_TYPE || type == BIGINT_TYPE ||
+             type == UNSIGNED_BIGINT_TYPE) {
+    auto integer = tryTo<long long>(value, 0);
+    if (integer.isError()) {
+      sqlite3_result_null(ctx);
+    } else {
+      sqlite3_result_int64(ctx, integer.take());
+    }
+  } else {
+    char* end = nullptr;
+    double number = strtod(value.c_str(), &end);
+    if (end == nullptr || end == value.c_str() || *end != '\0') {
+      sqlite3_result_null(ctx);
+    } else {
+      sqlite3_result_double(ctx, number);
+    }
+  }
+}
+
+int ColumnarTableRow::get_column(sqlite3_context* ctx,
+                                 sqlite3_vtab* vtab,
+                                 int col) {
+  auto* pVtab = (VirtualTable*)vtab;
+  const auto& content = *pVtab->content;
+  const auto* value = batch_->value(row_, batch_->resolve(content, col));
+  if (value == nullptr) {
+    sqlite3_result_null(ctx);
+    return SQLITE_OK;
+  }
+
+  auto type = std::get<1>(content.columns[col]);
+  const auto* text = boost::get<std::string>(value);
+  if (type == TEXT_TYPE || type == BLOB_TYPE) {
+    if (text != nullptr) {
+      sqlite3_result_text(
+          ctx, text->c_str(), static_cast<int>(text->size()), SQLITE_STATIC);
+    } else {
+      auto cast = castVariant(*value);
+      sqlite3_result_text(
+          ctx, cast.c_str(), static_cast<int>(cast.size()), SQLITE_TRANSIENT);
+    }
+  } else if (const auto* integer = boost::get<long long>(value)) {
+    if (type == DOUBLE_TYPE) {
+      sqlite3_result_double(ctx, static_cast<double>(*integer));
+    } else {
+      sqlite3_result_int64(ctx, *integer);
+    }
+  } else if (const auto* number = boost::get<double>(value)) {
+    sqlite3_result_double(ctx, *number);
+  } else {
+    resultFromText(ctx, type, *text);
+  }
+  return SQLITE_OK;
+}
+
+int ColumnarTableRow::get_rowid(sqlite_int64 default_value,
+                                sqlite_int64* pRowid) const {
+  const auto* value = batch_->value(row_, batch_->column("rowid"));
+  if (value == nullptr) {
+    *pRowid = default_value;
+  } else if (const auto* integer = boost::get<long long>(value)) {
+    *pRowid = *integer;
+  } else {
+    auto rowid = tryTo<long long>(castVariant(*value), 10);
+    if (rowid.isError()) {
+      VLOG(1) << "Invalid rowid value returned " << rowid.getError();
+      return SQLITE_ERROR;
+    }
+    *pRowid = rowid.take();
+  }
+  return SQLITE_OK;
+}
+
+ColumnarTableRow::operator Row() const {
+  Row r;
+  const auto& columns = batch_->columns();
+  for (size_t i = 0; i < columns.size(); ++i) {
+    const auto* value = batch_->value(row_, i);
+    if (value != nullptr) {
+      r[columns[i]] = castVariant(*value);
+    }
+  }
+  return r;
+}
+
+Status ColumnarTableRow::serialize(JSON& doc, rj::Value& obj) const {
+  const auto& columns = batch_->columns();
+  for (size_t i = 0; i < columns.size(); ++i) {
+    const auto* value = batch_->value(row_, i);
+    if (value == nullptr) {
+      continue;
+    }
+    if (const auto* text = boost::get<std::string>(value)) {
+      doc.addRef(columns[i], *text, obj);
+    } else {
+      doc.addCopy(columns[i], castVariant(*value), obj);
+    }
+  }
+  return Status::success();
+}
+
+TableRowHolder ColumnarTableRow::clone() const {
+  // Values are not changed once set, a clone shares the batch.
+  return TableRowHolder(new ColumnarTableRow(batch_, row_));
+}
+
+} // namespace osquery
@@ -0,0 +1,127 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <osquery/core/sql/query_data.h>
+#include <osquery/core/sql/table_row.h>
+#include <osquery/core/sql/table_rows.h>
+#include <osquery/core/tables.h>
+
+namespace osquery {
+
+/**
+ * @brief Typed column values shared by a batch of table rows.
+ *
+ * A DynamicTableRow keeps every value as a string in a map, and xColumn looks
+ * up the column name and parses INTEGER, BIGINT and DOUBLE values each time
+ * SQLite reads them. A batch instead stores native integer, double and text
+ * values column-major, and its rows answer xColumn with an indexed load.
+ *
+ * Tables create a batch with their column names, fill one row per result and
+ * emit the rows with TableRowBatch::row. Columns that are not set are NULL.
+ * The rows of a batch are meant for a single scan.
+ */
+class TableRowBatch : public std::enable_shared_from_this<TableRowBatch> {
+ public:
+  /// Create a batch, the names are usually the table's columns in order.
+  static std::shared_ptr<TableRowBatch> create(ColumnNames columns);
+
+  /// The column index of a name, or width() if the name is not a column.
+  size_t column(const std::string& name) const;
+
+  size_t width() const {
+    return columns_.size();
+  }
+
+  size_t rows() const {
+    return rows_;
+  }
+
+  /// Append a row, every value is NULL until set.
+  size_t addRow();
+
+  void set(size_t row, size_t column, long long value);
+  void set(size_t row, size_t column, double value);
+  void set(size_t row, size_t column, std::string value);
+
+  /// A value, or nullptr if the value was not set.
+  const RowDataTyped* value(size_t row, size_t column) const;
+
+  /// A TableRow reading one row of this batch.
+  TableRowHolder row(size_t row);
+
+  /**
+   * @brief Find the batch column for a virtual table column.
+   *
+   * Virtual table columns, including aliases, are matched by name once per
+   * table and located by index afterwards.
+   *
+   * @return the batch column, or width() if the batch has no such column.
+   */
+  size_t resolve(const VirtualTableContent& content, int column);
+
+  const ColumnNames& columns() const {
+    return columns_;
+  }
+
+ private:
+  explicit TableRowBatch(ColumnNames columns);
+
+  /// Values and presence of a single column.
+  struct Column {
+    std::vector<RowDataTyped> values;
+    std::vector<bool> present;
+  };
+
+  void set(size_t row, size_t column, RowDataTyped value);
+
+ private:
+  /// Column names in batch order.
+  ColumnNames columns_;
+
+  /// Column-major values.
+  std::vector<Column> values_;
+
+  /// The number of rows.
+  size_t rows_{0};
+
+  /// The virtual table the resolved columns belong to.
+  const VirtualTableContent* resolved_table_{nullptr};
+
+  /// Batch columns of each virtual table column.
+  std::vector<size_t> resolved_;
+};
+
+/// A TableRow backed by one row of a TableRowBatch.
+class ColumnarTableRow : public TableRow {
+ public:
+  ColumnarTableRow(std::shared_ptr<TableRowBatch> batch, size_t row)
+      : batch_(std::move(batch)), row_(row) {}
+
+  explicit operator Row() const override;
+  int get_rowid(sqlite_int64 default_value,
+                sqlite_int64* pRowid) const override;
+  int get_column(sqlite3_context* ctx, sqlite3_vtab* pVtab, int col) override;
+  Status serialize(JSON& doc, rapidjson::Value& obj) const override;
+  TableRowHolder clone() const override;
+
+ private:
+  /// The batch holding the values.
+  std::shared_ptr<TableRowBatch> batch_;
+
+  /// The row within the batch.
+  size_t row_{0};
+};
+
+} // namespace osquery
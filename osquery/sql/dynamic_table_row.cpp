@@ -10,6 +10,8 @@
 #include "dynamic_table_row.h"
 #include "virtual_table.h"
 
+#include <osquery/core/sql/binary_encoding.h>
+#include <osquery/core/sql/binary_rows.h>
 #include <osquery/logger/logger.h>
 #include <osquery/utils/conversions/tryto.h>
 
@@ -19,6 +21,7 @@ namespace osquery {
 
 TableRows tableRowsFromQueryData(QueryData&& rows) {
   TableRows result;
+  result.reserve(rows.size());
 
   for (auto&& row : rows) {
     result.push_back(TableRowHolder(new DynamicTableRow(std::move(row))));
@@ -46,12 +49,47 @@ Status deserializeTableRows(const rj::Value& arr, TableRows& rows) {
 Status deserializeTableRowsJSON(const std::string& json, TableRows& rows) {
   auto doc = JSON::newArray();
   if (!doc.fromString(json) || !doc.doc().IsArray()) {
-    return Status(1, "Cannot deserializing JSON");
+    return Status::staticFailure("Cannot deserializing JSON");
   }
 
   return deserializeTableRows(doc.doc(), rows);
 }
 
+Status deserializeTableRowsBinary(const std::string& encoded, TableRows& rows) {
+  BinaryReader reader(encoded);
+  std::string serialized;
+  uint64_t count = 0;
+  if (!reader.getString(serialized) || !reader.getVarint(count)) {
+    return Status::staticFailure("Cannot read the encoded rows");
+  }
+
+  BinaryRowDictionary dictionary;
+  auto status = dictionary.deserialize(serialized);
+  if (!status.ok()) {
+    return status;
+  }
+
+  // Each row takes at least a byte, a larger count is corrupt.
+  if (count > reader.remaining()) {
+    return Status::staticFailure("Cannot read the encoded rows");
+  }
+
+  rows.reserve(rows.size() + static_cast<size_t>(count));
+  std::string row;
+  for (uint64_t i = 0; i < count; ++i) {
+    Row r;
+    if (!reader.getString(row)) {
+      return Status::staticFailure("Cannot read the encoded rows");
+    }
+    status = dictionary.decode(row, r);
+    if (!status.ok()) {
+      return status;
+    }
+    rows.push_back(TableRowHolder(new DynamicTableRow(std::move(r))));
+  }
+  return Status::success();
+}
+
 Status deserializeRow(const rj::Value& doc, DynamicTableRowHolder& r) {
   if (!doc.IsObject()) {
     return Status(1);
@@ -0,0 +1,138 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <osquery/core/flags.h>
+#include <osquery/profiler/resource_usage.h>
+#include <osquery/sql/result_memory.h>
+
+namespace osquery {
+
+FLAG(uint64,
+     query_max_result_bytes,
+     0,
+     "Max bytes of results a query may hold, 0 is unlimited");
+
+FLAG(uint64,
+     results_max_bytes,
+     0,
+     "Max bytes of results held by all running queries, 0 is unlimited");
+
+namespace {
+
+/// The innermost scope of each thread.
+thread_local ResultMemory::Scope* current_scope{nullptr};
+} // namespace
+
+std::atomic<size_t> ResultMemory::total_{0};
+
+ResultMemory::Scope::Scope() : previous_(current_scope) {
+  current_scope = this;
+}
+
+ResultMemory::Scope::Scope(const QueryBudget& budget) : Scope() {
+  budget_ = budget;
+  start_ = std::chrono::steady_clock::now();
+  if (budget_.cpu_time_ms > 0) {
+    ResourceUsage usage;
+    if (getResourceUsage(usage, true).ok()) {
+      start_cpu_ms_ = usage.user_time + usage.system_time;
+    } else {
+      // The CPU time cannot be sampled, only the other budgets apply.
+      budget_.cpu_time_ms = 0;
+    }
+  }
+}
+
+ResultMemory::Scope::~Scope() {
+  current_scope = previous_;
+  total_ -= bytes_;
+}
+
+Status ResultMemory::Scope::exceed(std::string error) {
+  if (error_.empty()) {
+    error_ = std::move(error);
+  }
+  return Status::failure(error_);
+}
+
+Status ResultMemory::Scope::checkTime() {
+  if (budget_.wall_time_ms > 0) {
+    using namespace std::chrono;
+    auto elapsed = duration_cast<milliseconds>(steady_clock::now() - start_);
+    if (static_cast<uint64_t>(elapsed.count()) > budget_.wall_time_ms) {
+      return exceed("Query exceeded its budget of " +
+                    std::to_string(budget_.wall_time_ms) + "ms of wall time");
+    }
+  }
+
+  if (budget_.cpu_time_ms > 0) {
+    ResourceUsage usage;
+    if (getResourceUsage(usage, true).ok() &&
+        usage.user_time + usage.system_time - start_cpu_ms_ >
+            budget_.cpu_time_ms) {
+      return exceed("Query exceeded its budget of " +
+                    std::to_string(budget_.cpu_time_ms) + "ms of CPU time");
+    }
+  }
+  return Status::success();
+}
+
+Status ResultMemory::add(size_t bytes) {
+  auto* scope = current_scope;
+  if (scope == nullptr) {
+    return Status::success();
+  }
+
+  auto total = total_ += bytes;
+  scope->bytes_ += bytes;
+  scope->rows_++;
+  if ((FLAGS_query_max_result_bytes > 0 &&
+       scope->bytes_ > FLAGS_query_max_result_bytes) ||
+      (FLAGS_results_max_bytes > 0 && total > FLAGS_results_max_bytes)) {
+    return scope->exceed("Query results exceed the memory budget");
+  }
+
+  const auto& budget = scope->budget_;
+  if (budget.rows > 0 && scope->rows_ > budget.rows) {
+    return scope->exceed("Query exceeded its budget of " +
+                         std::to_string(budget.rows) + " rows");
+  }
+  if (budget.result_bytes > 0 && scope->bytes_ > budget.result_bytes) {
+    return scope->exceed("Query exceeded its budget of " +
+                         std::to_string(budget.result_bytes) +
+                         " bytes of results");
+  }
+  return Status::success();
+}
+
+Status ResultMemory::check() {
+  auto* scope = current_scope;
+  if (scope == nullptr) {
+    return Status::success();
+  }
+
+  if (scope->exceeded()) {
+    return Status::failure(scope->error_);
+  }
+  if (!scope->budget_.timed()) {
+    return Status::success();
+  }
+  return scope->checkTime();
+}
+
+bool ResultMemory::timed() {
+  auto* scope = current_scope;
+  return scope != nullptr && scope->budget_.timed();
+}
+
+size_t ResultMemory::bytes() {
+  return total_;
+}
+
+} // namespace osquery
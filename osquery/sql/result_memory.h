@@ -0,0 +1,126 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/core/sql/scheduled_query.h>
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/**
+ * @brief Accounts the bytes held by the results of running queries.
+ *
+ * The watchdog only observes the worker's memory after the fact and stops the
+ * worker, and every query it runs, once a limit is exceeded. Queries run
+ * within a ResultMemory::Scope account each row they read. A query holding
+ * more than query_max_result_bytes, or a row that brings the results held by
+ * every running query above results_max_bytes, fails alone before the worker
+ * reaches its limit.
+ *
+ * A scope may also enforce the QueryBudget of a scheduled query. Rows and
+ * bytes are checked as each row is read, time is checked cooperatively while
+ * SQLite runs the query's statements. A table generating its rows is not
+ * interrupted, the query stops once the table returns.
+ *
+ * The bytes are those of the values and column names of each row, the
+ * allocator's overhead is not included.
+ */
+class ResultMemory : private boost::noncopyable {
+ public:
+  /// Account the results read on the calling thread until destroyed.
+  class Scope : private boost::noncopyable {
+   public:
+    Scope();
+    explicit Scope(const QueryBudget& budget);
+    ~Scope();
+
+    /// The bytes read within the scope.
+    size_t bytes() const {
+      return bytes_;
+    }
+
+    /// The rows read within the scope.
+    size_t rows() const {
+      return rows_;
+    }
+
+    /// Check if the query was stopped because a budget was exceeded.
+    bool exceeded() const {
+      return !error_.empty();
+    }
+
+   private:
+    /// Check the time budget, only used when the budget is timed.
+    Status checkTime();
+
+    /// Record the first budget exceeded.
+    Status exceed(std::string error);
+
+   private:
+    /// The scope of the calling thread when this scope was created.
+    Scope* previous_{nullptr};
+
+    QueryBudget budget_;
+
+    size_t bytes_{0};
+
+    size_t rows_{0};
+
+    /// The first budget exceeded, empty while within every budget.
+    std::string error_;
+
+    /// When the scope was created.
+    std::chrono::steady_clock::time_point start_;
+
+    /// The thread's CPU time, in milliseconds, when the scope was created.
+    uint64_t start_cpu_ms_{0};
+
+   private:
+    friend class ResultMemory;
+  };
+
+  /**
+   * @brief Account a row read on the calling thread.
+   *
+   * Does nothing outside of a scope.
+   *
+   * @return failure if the row exceeds a budget, the query should stop.
+   */
+  static Status add(size_t bytes);
+
+  /**
+   * @brief Check the time budget of the calling thread's scope.
+   *
+   * Does nothing outside of a scope, or within a scope without a time budget.
+   * This also reports a budget already exceeded.
+   *
+   * @return failure if a budget is exceeded, the query should stop.
+   */
+  static Status check();
+
+  /// Check if the calling thread's scope has a time budget.
+  static bool timed();
+
+  /// The bytes held by the results of every scope.
+  static size_t bytes();
+
+ private:
+  /// The bytes held by the results of every scope.
+  static std::atomic<size_t> total_;
+};
+
+} // namespace osquery
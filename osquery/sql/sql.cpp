@@ -7,6 +7,8 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <cstdint>
+#include <cstring>
 #include <sstream>
 
 #include <osquery/core/core.h>
@@ -60,8 +62,50 @@ std::string SQL::getMessageString() const {
   return status_.toString();
 }
 
+/// The high bit of each byte of a word.
+constexpr std::uint64_t kHighBits = 0x8080808080808080ULL;
+
+/// The lowest printable byte, 0x20, in each byte of a word.
+constexpr std::uint64_t kPrintableBytes = 0x2020202020202020ULL;
+
+/**
+ * @brief The length of the prefix of a string without bytes to escape.
+ *
+ * Values are checked 16 bytes at a time. A word has a byte to escape if a
+ * byte has its high bit set, or is below 0x20 and borrows into its high bit
+ * when 0x20 is subtracted from each byte.
+ */
+static inline size_t printablePrefix(const std::string& data) {
+  const auto* bytes = data.data();
+  size_t i = 0;
+  for (; i + 16 <= data.size(); i += 16) {
+    std::uint64_t first;
+    std::uint64_t second;
+    std::memcpy(&first, bytes + i, sizeof(first));
+    std::memcpy(&second, bytes + i + 8, sizeof(second));
+    auto flags = (first - kPrintableBytes) | first |
+                 (second - kPrintableBytes) | second;
+    if ((flags & kHighBits) != 0) {
+      break;
+    }
+  }
+
+  for (; i < data.size(); i++) {
+    auto c = static_cast<unsigned char>(bytes[i]);
+    if (c < 0x20 || c >= 0x80) {
+      break;
+    }
+  }
+  return i;
+}
+
 static inline void escapeNonPrintableBytes(std::string& data) {
-  std::string escaped;
+  // Most values are printable ASCII and are not copied.
+  auto printable = printablePrefix(data);
+  if (printable == data.size()) {
+    return;
+  }
+
   // clang-format off
   char const hex_chars[16] = {
     '0', '1', '2', '3', '4', '5', '6', '7',
@@ -69,10 +113,11 @@ static inline void escapeNonPrintableBytes(std::string& data) {
   };
   // clang-format on
 
-  bool needs_replacement = false;
-  for (size_t i = 0; i < data.length(); i++) {
+  std::string escaped;
+  escaped.reserve(data.size() + 3 * (data.size() - printable));
+  escaped.append(data, 0, printable);
+  for (size_t i = printable; i < data.length(); i++) {
     if (((unsigned char)data[i]) < 0x20 || ((unsigned char)data[i]) >= 0x80) {
-      needs_replacement = true;
       escaped += "\\x";
       escaped += hex_chars[(((unsigned char)data[i])) >> 4];
       escaped += hex_chars[((unsigned char)data[i] & 0x0F) >> 0];
@@ -80,11 +125,7 @@ static inline void escapeNonPrintableBytes(std::string& data) {
       escaped += data[i];
     }
   }
-
-  // Only replace if any escapes were made.
-  if (needs_replacement) {
-    data = std::move(escaped);
-  }
+  data = std::move(escaped);
 }
 
 void escapeNonPrintableBytesEx(std::string& data) {
@@ -138,7 +179,7 @@ QueryData SQL::selectFrom(const std::initializer_list<std::string>& columns,
 Status SQLPlugin::call(const PluginRequest& request, PluginResponse& response) {
   response.clear();
   if (request.count("action") == 0) {
-    return Status(1, "SQL plugin must include a request action");
+    return Status::staticFailure("SQL plugin must include a request action");
   }
 
   if (request.at("action") == "query") {
@@ -170,7 +211,7 @@ Status SQLPlugin::call(const PluginRequest& request, PluginResponse& response) {
     }
     return status;
   }
-  return Status(1, "Unknown action");
+  return Status::staticFailure("Unknown action");
 }
 
 Status query(const std::string& q, QueryData& results, bool use_cache) {
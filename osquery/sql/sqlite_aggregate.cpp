@@ -0,0 +1,480 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <osquery/utils/json/json.h>
+
+#include <sqlite3.h>
+
+namespace osquery {
+
+namespace {
+
+/// The HyperLogLog registers are indexed by the top bits of the hashes.
+const int kHyperLogLogPrecision{12};
+const size_t kHyperLogLogRegisters{size_t{1} << kHyperLogLogPrecision};
+
+/// Distinct hashes kept exactly before a group switches to registers.
+const size_t kMaxExactHashes{512};
+
+/// The values counted exactly by top_k, per value requested.
+const size_t kTopKCapacityFactor{8};
+const size_t kMinTopKCapacity{64};
+const long long kDefaultTopK{10};
+const long long kMaxTopK{1000};
+
+/// The t-digest compression, it bounds the centroids kept to about twice it.
+const double kTDigestCompression{100.0};
+const size_t kTDigestBufferSize{512};
+
+/**
+ * @brief The state of an aggregate for the group being computed.
+ *
+ * SQLite zeroes the aggregate context of a group when allocating it, it
+ * holds a pointer to the state, which is released by the final function.
+ */
+template <typename T>
+T* getAggregateState(sqlite3_context* ctx) {
+  auto** state = static_cast<T**>(sqlite3_aggregate_context(ctx, sizeof(T*)));
+  if (state == nullptr) {
+    sqlite3_result_error_nomem(ctx);
+    return nullptr;
+  }
+
+  if (*state == nullptr) {
+    *state = new T();
+  }
+  return *state;
+}
+
+/// Take the state of the group, nullptr if no row was aggregated.
+template <typename T>
+std::unique_ptr<T> takeAggregateState(sqlite3_context* ctx) {
+  auto** state = static_cast<T**>(sqlite3_aggregate_context(ctx, 0));
+  if (state == nullptr || *state == nullptr) {
+    return nullptr;
+  }
+
+  std::unique_ptr<T> output(*state);
+  *state = nullptr;
+  return output;
+}
+
+inline std::uint64_t mixHash(std::uint64_t hash) {
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb93fe53485ebULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+/**
+ * @brief Hash a value as SQL DISTINCT compares them.
+ *
+ * Integral reals hash as integers, texts and blobs are not equal to numbers.
+ */
+std::uint64_t hashValue(sqlite3_value* value) {
+  auto fnv = [](std::uint64_t hash, const void* data, size_t size) {
+    auto* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+      hash ^= bytes[i];
+      hash *= 0x100000001b3ULL;
+    }
+    return hash;
+  };
+
+  std::uint64_t hash = 0xcbf29ce484222325ULL;
+  auto type = sqlite3_value_type(value);
+  if (type == SQLITE_FLOAT) {
+    auto real = sqlite3_value_double(value);
+    if (std::floor(real) == real && std::fabs(real) < 9.0e18) {
+      type = SQLITE_INTEGER;
+    }
+  }
+
+  char tag = static_cast<char>(type);
+  hash = fnv(hash, &tag, sizeof(tag));
+  if (type == SQLITE_INTEGER) {
+    auto integer = sqlite3_value_int64(value);
+    hash = fnv(hash, &integer, sizeof(integer));
+  } else if (type == SQLITE_FLOAT) {
+    auto real = sqlite3_value_double(value);
+    hash = fnv(hash, &real, sizeof(real));
+  } else {
+    auto* data = sqlite3_value_blob(value);
+    auto size = static_cast<size_t>(sqlite3_value_bytes(value));
+    if (data != nullptr) {
+      hash = fnv(hash, data, size);
+    }
+  }
+  return mixHash(hash);
+}
+
+/// Distinct values counted exactly, then within about 1.6% once many.
+class HyperLogLog final {
+ public:
+  void add(std::uint64_t hash) {
+    if (registers_.empty()) {
+      exact_.insert(hash);
+      if (exact_.size() <= kMaxExactHashes) {
+        return;
+      }
+
+      registers_.resize(kHyperLogLogRegisters, 0);
+      for (auto exact_hash : exact_) {
+        addToRegisters(exact_hash);
+      }
+      exact_.clear();
+      return;
+    }
+
+    addToRegisters(hash);
+  }
+
+  std::int64_t estimate() const {
+    if (registers_.empty()) {
+      return static_cast<std::int64_t>(exact_.size());
+    }
+
+    auto m = static_cast<double>(kHyperLogLogRegisters);
+    double sum = 0.0;
+    size_t zeros = 0;
+    for (auto rank : registers_) {
+      sum += std::ldexp(1.0, -rank);
+      zeros += (rank == 0) ? 1 : 0;
+    }
+
+    auto estimate = (0.7213 / (1.0 + 1.079 / m)) * m * m / sum;
+    if (estimate <= 2.5 * m && zeros > 0) {
+      // Linear counting is more accurate for the small cardinalities.
+      estimate = m * std::log(m / static_cast<double>(zeros));
+    }
+    return static_cast<std::int64_t>(std::llround(estimate));
+  }
+
+ private:
+  void addToRegisters(std::uint64_t hash) {
+    auto index = static_cast<size_t>(hash >> (64 - kHyperLogLogPrecision));
+    auto rest = hash << kHyperLogLogPrecision;
+
+    // The rank is the position of the first set bit of the remaining bits.
+    std::uint8_t rank = 1;
+    while (rank <= 64 - kHyperLogLogPrecision &&
+           (rest & 0x8000000000000000ULL) == 0) {
+      rest <<= 1;
+      ++rank;
+    }
+
+    registers_[index] = std::max(registers_[index], rank);
+  }
+
+ private:
+  std::unordered_set<std::uint64_t> exact_;
+  std::vector<std::uint8_t> registers_;
+};
+
+/**
+ * @brief The most frequent values, with the Space-Saving algorithm.
+ *
+ * The counts are exact while the distinct values fit the capacity. Then the
+ * least frequent value is replaced, a new value inherits its count, so the
+ * counts of the values output may be overestimated.
+ */
+class TopK final {
+ public:
+  void add(std::string value) {
+    auto it = values_.find(value);
+    if (it != values_.end()) {
+      increment(it->second, 1);
+      return;
+    }
+
+    if (values_.size() < capacity_) {
+      auto entry = counts_.emplace(1, value);
+      values_.emplace(std::move(value), entry);
+      return;
+    }
+
+    // Replace the least frequent value.
+    auto entry = counts_.begin();
+    auto count = entry->first;
+    values_.erase(entry->second);
+    counts_.erase(entry);
+
+    auto replaced = counts_.emplace(count + 1, value);
+    values_.emplace(std::move(value), replaced);
+  }
+
+  void setK(long long k) {
+    k_ = static_cast<size_t>(std::min(std::max(k, 1LL), kMaxTopK));
+    capacity_ = std::max(k_ * kTopKCapacityFactor, kMinTopKCapacity);
+  }
+
+  bool hasK() const {
+    return k_ != 0;
+  }
+
+  /// The values as a JSON array of value and count objects.
+  std::string toJSON() const {
+    auto doc = JSON::newArray();
+    size_t output = 0;
+    for (auto it = counts_.rbegin(); it != counts_.rend() && output < k_;
+         ++it, ++output) {
+      auto obj = doc.getObject();
+      doc.addCopy("value", it->second, obj);
+      doc.add("count", static_cast<std::uint64_t>(it->first), obj);
+      doc.push(obj);
+    }
+
+    std::string json;
+    doc.toString(json);
+    return json;
+  }
+
+ private:
+  using Counts = std::multimap<std::uint64_t, std::string>;
+
+  void increment(Counts::iterator& entry, std::uint64_t count) {
+    auto value = std::move(entry->second);
+    auto next = entry->first + count;
+    counts_.erase(entry);
+    entry = counts_.emplace(next, std::move(value));
+  }
+
+ private:
+  size_t k_{0};
+  size_t capacity_{0};
+
+  Counts counts_;
+  std::unordered_map<std::string, Counts::iterator> values_;
+};
+
+/**
+ * @brief Approximate quantiles of a stream of values, with a t-digest.
+ *
+ * Values are buffered and merged into centroids, the centroids near the
+ * extremes are kept small so the tail quantiles stay accurate.
+ */
+class TDigest final {
+ public:
+  void add(double value) {
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+    buffer_.push_back({value, 1.0});
+    if (buffer_.size() >= kTDigestBufferSize) {
+      compress();
+    }
+  }
+
+  bool empty() const {
+    return centroids_.empty() && buffer_.empty();
+  }
+
+  double quantile(double q) {
+    compress();
+
+    q = std::min(std::max(q, 0.0), 1.0);
+    if (centroids_.size() == 1) {
+      return centroids_[0].mean;
+    }
+
+    // Interpolate between the centers of the centroids around the target.
+    auto target = q * total_;
+    double before = 0.0;
+    double previous_center = 0.0;
+    double previous_mean = min_;
+    for (const auto& centroid : centroids_) {
+      auto center = before + centroid.weight / 2.0;
+      if (target < center) {
+        auto span = center - previous_center;
+        auto ratio = span > 0.0 ? (target - previous_center) / span : 0.0;
+        return previous_mean + (centroid.mean - previous_mean) * ratio;
+      }
+
+      before += centroid.weight;
+      previous_center = center;
+      previous_mean = centroid.mean;
+    }
+
+    auto span = total_ - previous_center;
+    auto ratio = span > 0.0 ? (target - previous_center) / span : 1.0;
+    return previous_mean + (max_ - previous_mean) * ratio;
+  }
+
+ private:
+  struct Centroid {
+    double mean;
+    double weight;
+  };
+
+  void compress() {
+    if (buffer_.empty()) {
+      return;
+    }
+
+    buffer_.insert(buffer_.end(), centroids_.begin(), centroids_.end());
+    std::sort(buffer_.begin(),
+              buffer_.end(),
+              [](const Centroid& left, const Centroid& right) {
+                return left.mean < right.mean;
+              });
+
+    total_ = 0.0;
+    for (const auto& centroid : buffer_) {
+      total_ += centroid.weight;
+    }
+
+    centroids_.clear();
+    auto current = buffer_[0];
+    double before = 0.0;
+    for (size_t i = 1; i < buffer_.size(); ++i) {
+      const auto& next = buffer_[i];
+      auto weight = current.weight + next.weight;
+      auto q = (before + weight / 2.0) / total_;
+      if (weight <= 4.0 * total_ * q * (1.0 - q) / kTDigestCompression) {
+        current.mean += (next.mean - current.mean) * next.weight / weight;
+        current.weight = weight;
+      } else {
+        before += current.weight;
+        centroids_.push_back(current);
+        current = next;
+      }
+    }
+    centroids_.push_back(current);
+    buffer_.clear();
+  }
+
+ private:
+  std::vector<Centroid> centroids_;
+  std::vector<Centroid> buffer_;
+  double total_{0.0};
+  double min_{INFINITY};
+  double max_{-INFINITY};
+};
+
+/// The quantile requested and the digest of a group.
+struct QuantileState {
+  TDigest digest;
+  double q{0.5};
+};
+
+void approxCountDistinctStep(sqlite3_context* ctx,
+                             int argc,
+                             sqlite3_value** argv) {
+  if (argc != 1 || sqlite3_value_type(argv[0]) == SQLITE_NULL) {
+    return;
+  }
+
+  auto* state = getAggregateState<HyperLogLog>(ctx);
+  if (state != nullptr) {
+    state->add(hashValue(argv[0]));
+  }
+}
+
+void approxCountDistinctFinal(sqlite3_context* ctx) {
+  auto state = takeAggregateState<HyperLogLog>(ctx);
+  sqlite3_result_int64(ctx, state == nullptr ? 0 : state->estimate());
+}
+
+void topKStep(sqlite3_context* ctx, int argc, sqlite3_value** argv) {
+  if (argc < 1 || sqlite3_value_type(argv[0]) == SQLITE_NULL) {
+    return;
+  }
+
+  auto* state = getAggregateState<TopK>(ctx);
+  if (state == nullptr) {
+    return;
+  }
+
+  if (!state->hasK()) {
+    state->setK(argc > 1 ? sqlite3_value_int64(argv[1]) : kDefaultTopK);
+  }
+
+  auto* text = reinterpret_cast<const char*>(sqlite3_value_text(argv[0]));
+  auto size = static_cast<size_t>(sqlite3_value_bytes(argv[0]));
+  state->add(std::string(text != nullptr ? text : "", size));
+}
+
+void topKFinal(sqlite3_context* ctx) {
+  auto state = takeAggregateState<TopK>(ctx);
+  auto json = state == nullptr ? std::string("[]") : state->toJSON();
+  sqlite3_result_text(
+      ctx, json.c_str(), static_cast<int>(json.size()), SQLITE_TRANSIENT);
+}
+
+void quantileStep(sqlite3_context* ctx, int argc, sqlite3_value** argv) {
+  if (argc != 2) {
+    return;
+  }
+
+  // Values which are not numbers are ignored, as NULL values are.
+  auto type = sqlite3_value_numeric_type(argv[0]);
+  if (type != SQLITE_INTEGER && type != SQLITE_FLOAT) {
+    return;
+  }
+
+  auto* state = getAggregateState<QuantileState>(ctx);
+  if (state == nullptr) {
+    return;
+  }
+
+  if (state->digest.empty()) {
+    state->q = sqlite3_value_double(argv[1]);
+  }
+  state->digest.add(sqlite3_value_double(argv[0]));
+}
+
+void quantileFinal(sqlite3_context* ctx) {
+  auto state = takeAggregateState<QuantileState>(ctx);
+  if (state == nullptr || state->digest.empty()) {
+    sqlite3_result_null(ctx);
+    return;
+  }
+
+  sqlite3_result_double(ctx, state->digest.quantile(state->q));
+}
+
+} // namespace
+
+void registerAggregateExtensions(sqlite3* db) {
+  sqlite3_create_function(db,
+                          "approx_count_distinct",
+                          1,
+                          SQLITE_UTF8,
+                          nullptr,
+                          nullptr,
+                          approxCountDistinctStep,
+                          approxCountDistinctFinal);
+
+  sqlite3_create_function(
+      db, "top_k", 1, SQLITE_UTF8, nullptr, nullptr, topKStep, topKFinal);
+  sqlite3_create_function(
+      db, "top_k", 2, SQLITE_UTF8, nullptr, nullptr, topKStep, topKFinal);
+
+  sqlite3_create_function(db,
+                          "quantile",
+                          2,
+                          SQLITE_UTF8,
+                          nullptr,
+                          nullptr,
+                          quantileStep,
+                          quantileFinal);
+}
+} // namespace osquery
@@ -7,6 +7,7 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <array>
 #include <cstring>
 #include <functional>
 #include <string>
@@ -150,39 +151,32 @@ static void sqliteCommunityIDv1(sqlite3_context* context,
     std::swap(sport, dport);
   }
 
-  // seed . saddr . daddr . proto . 0 . sport . dport
-  std::array<char, 2> buffer;
-  std::memcpy(buffer.data(), seed.data(), buffer.size());
+  // seed . saddr . daddr . proto . 0 . sport . dport, built in place
+  std::array<char, 2 + 16 + 16 + 1 + 1 + 2 + 2> bytes;
+  size_t size = 0;
+  auto append = [&bytes, &size](const void* data, size_t length) {
+    std::memcpy(bytes.data() + size, data, length);
+    size += length;
+  };
 
-  std::stringstream bytes;
-  bytes.write(buffer.data(), buffer.size());
+  append(seed.data(), 2);
   if (saddr.is_v4()) {
-    bytes.write(reinterpret_cast<const char*>(saddr.to_v4().to_bytes().data()),
-                4);
+    append(saddr.to_v4().to_bytes().data(), 4);
   } else {
-    bytes.write(reinterpret_cast<const char*>(saddr.to_v6().to_bytes().data()),
-                16);
+    append(saddr.to_v6().to_bytes().data(), 16);
   }
   if (daddr.is_v4()) {
-    bytes.write(reinterpret_cast<const char*>(daddr.to_v4().to_bytes().data()),
-                4);
+    append(daddr.to_v4().to_bytes().data(), 4);
   } else {
-    bytes.write(reinterpret_cast<const char*>(daddr.to_v6().to_bytes().data()),
-                16);
+    append(daddr.to_v6().to_bytes().data(), 16);
   }
-  bytes.write(reinterpret_cast<const char*>(&proto), 1);
-  bytes.put(0);
-
-  std::memcpy(buffer.data(), sport.data(), buffer.size());
-  bytes.write(buffer.data(), buffer.size());
-
-  std::memcpy(buffer.data(), dport.data(), buffer.size());
-  bytes.write(buffer.data(), buffer.size());
-
-  std::string res = bytes.str();
+  append(&proto, 1);
+  bytes[size++] = 0;
+  append(sport.data(), 2);
+  append(dport.data(), 2);
 
   Hash hash(HASH_TYPE_SHA1, HASH_ENCODING_TYPE_BASE64);
-  hash.update(res.c_str(), res.size());
+  hash.update(bytes.data(), size);
   auto result = "1:" + hash.digest();
 
   sqlite3_result_text(context,
@@ -14,11 +14,43 @@
 #include <boost/asio/ip/network_v6.hpp>
 #include <sqlite3.h>
 
+#include "osquery/sql/sqlite_util.h"
+
 namespace errc = boost::system::errc;
 namespace ip = boost::asio::ip;
 
 namespace osquery {
 
+namespace {
+
+/// The hosts of a CIDR, parsed for both families as the address decides.
+struct CidrBlock {
+  bool is_v4{false};
+  ip::address_v4_range v4_hosts;
+  bool is_v6{false};
+  ip::address_v6_range v6_hosts;
+};
+
+CidrBlock parseCidrBlock(const char* cidr_str) {
+  CidrBlock block;
+  boost::system::error_code ec;
+
+  auto network_v4 = ip::make_network_v4(cidr_str, ec);
+  if (ec.value() == errc::success) {
+    block.is_v4 = true;
+    block.v4_hosts = network_v4.hosts();
+  }
+
+  auto network_v6 = ip::make_network_v6(cidr_str, ec);
+  if (ec.value() == errc::success) {
+    block.is_v6 = true;
+    block.v6_hosts = network_v6.hosts();
+  }
+
+  return block;
+}
+} // namespace
+
 static void sqliteCidrBlockFunc(sqlite3_context* context,
                                 int argc,
                                 sqlite3_value** argv) {
@@ -45,27 +77,31 @@ static void sqliteCidrBlockFunc(sqlite3_context* context,
     return;
   }
 
+  // A constant CIDR is parsed once for all rows.
+  SQLiteAuxData<CidrBlock> block(
+      context, static_cast<int>(cidr_idx), [cidr_str]() {
+        return parseCidrBlock(cidr_str);
+      });
+
   if (ipaddr.is_v4()) {
-    ip::network_v4 network = ip::make_network_v4(cidr_str, ec);
-    if (ec.value() != errc::success) {
+    if (!block.get().is_v4) {
       sqlite3_result_error(
           context, "CIDR for IP address v4 cannot be parsed", -1);
       return;
     }
 
-    ip::address_v4_range all_network_hosts = network.hosts();
+    const auto& all_network_hosts = block.get().v4_hosts;
     bool is_in_range =
         all_network_hosts.find(ipaddr.to_v4()) != all_network_hosts.end();
     sqlite3_result_int(context, is_in_range);
   } else if (ipaddr.is_v6()) {
-    ip::network_v6 network = ip::make_network_v6(cidr_str, ec);
-    if (ec.value() != errc::success) {
+    if (!block.get().is_v6) {
       sqlite3_result_error(
           context, "CIDR for IP address v6 cannot be parsed", -1);
       return;
     }
 
-    ip::address_v6_range all_network_hosts = network.hosts();
+    const auto& all_network_hosts = block.get().v6_hosts;
     bool is_in_range =
         all_network_hosts.find(ipaddr.to_v6()) != all_network_hosts.end();
     sqlite3_result_int(context, is_in_range);
@@ -15,17 +15,21 @@
 #include <arpa/inet.h>
 #endif
 
+#include <cctype>
 #include <functional>
+#include <memory>
 #include <regex>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include <osquery/core/flags.h>
 #include <osquery/logger/logger.h>
-#include <osquery/utils/conversions/split.h>
 
 #include <sqlite3.h>
 
+#include "osquery/sql/sqlite_util.h"
+
 namespace osquery {
 
 HIDDEN_FLAG(
@@ -35,6 +39,18 @@ HIDDEN_FLAG(
     "Defines the maximum size in bytes of a regex that can be used with the "
     "regex_match and regex_split functions");
 
+namespace {
+
+/// Compile the regex of a function argument once per statement.
+SQLiteAuxData<std::regex> getRegex(sqlite3_context* context,
+                                   int argument,
+                                   const char* pattern) {
+  return SQLiteAuxData<std::regex>(context, argument, [pattern]() {
+    return std::regex(pattern, std::regex::ECMAScript | std::regex::optimize);
+  });
+}
+} // namespace
+
 using SplitResult = std::vector<std::string>;
 using StringSplitFunction = std::function<SplitResult(
     const std::string& input, const std::string& tokens)>;
@@ -54,9 +70,34 @@ using StringSplitFunction = std::function<SplitResult(
  *   3. SELECT SPLIT(ip_address, ".0", 0) from addresses;
  *      192
  */
-static SplitResult tokenSplit(const std::string& input,
-                              const std::string& tokens) {
-  return osquery::split(input, tokens);
+static bool tokenSplit(std::string_view input,
+                       std::string_view tokens,
+                       size_t index,
+                       std::string_view& selected) {
+  // Scan in place for the selected token, the others are not built.
+  size_t count = 0;
+  for (size_t start = 0; start <= input.size();) {
+    auto end = input.find_first_of(tokens, start);
+    if (end == std::string_view::npos) {
+      end = input.size();
+    }
+
+    // Empty tokens are skipped, whitespace is trimmed from the others.
+    if (end > start && count++ == index) {
+      selected = input.substr(start, end - start);
+      while (!selected.empty() &&
+             std::isspace(static_cast<unsigned char>(selected.front()))) {
+        selected.remove_prefix(1);
+      }
+      while (!selected.empty() &&
+             std::isspace(static_cast<unsigned char>(selected.back()))) {
+        selected.remove_suffix(1);
+      }
+      return true;
+    }
+    start = end + 1;
+  }
+  return false;
 }
 
 /**
@@ -73,7 +114,8 @@ static SplitResult tokenSplit(const std::string& input,
  *   3. SELECT SPLIT(ip_address, "\.0", 0) from addresses;
  *      192.168
  */
-static SplitResult regexSplit(const std::string& input,
+static SplitResult regexSplit(sqlite3_context* context,
+                              const std::string& input,
                               const std::string& token) {
   // Split using the token as a regex to support multi-character tokens.
   // Exceptions are caught by the caller, as that's where the sql context is
@@ -83,9 +125,9 @@ static SplitResult regexSplit(const std::string& input,
     throw std::regex_error(std::regex_constants::error_complexity);
   }
 
-  std::regex pattern = std::regex(token);
+  auto pattern = getRegex(context, 1, token.c_str());
   std::sregex_token_iterator iter_begin(
-      input.begin(), input.end(), pattern, -1);
+      input.begin(), input.end(), pattern.get(), -1);
   std::sregex_token_iterator iter_end;
   std::copy(iter_begin, iter_end, std::back_inserter(result));
 
@@ -133,14 +175,52 @@ static void callStringSplitFunc(sqlite3_context* context,
 static void tokenStringSplitFunc(sqlite3_context* context,
                                  int argc,
                                  sqlite3_value** argv) {
-  callStringSplitFunc(context, argc, argv, tokenSplit);
+  assert(argc == 3);
+  if (SQLITE_NULL == sqlite3_value_type(argv[0]) ||
+      SQLITE_NULL == sqlite3_value_type(argv[1]) ||
+      SQLITE_NULL == sqlite3_value_type(argv[2])) {
+    sqlite3_result_null(context);
+    return;
+  }
+
+  // The inputs are used in place, without copies.
+  std::string_view input(
+      reinterpret_cast<const char*>(sqlite3_value_text(argv[0])),
+      static_cast<size_t>(sqlite3_value_bytes(argv[0])));
+  std::string_view tokens(
+      reinterpret_cast<const char*>(sqlite3_value_text(argv[1])),
+      static_cast<size_t>(sqlite3_value_bytes(argv[1])));
+  auto index = static_cast<size_t>(sqlite3_value_int(argv[2]));
+
+  if (tokens.empty()) {
+    // Empty input string is an error
+    sqlite3_result_error(context, "Invalid input to split function", -1);
+    return;
+  }
+
+  std::string_view selected;
+  if (!tokenSplit(input, tokens, index, selected)) {
+    sqlite3_result_null(context);
+    return;
+  }
+
+  sqlite3_result_text(context,
+                      selected.data(),
+                      static_cast<int>(selected.size()),
+                      SQLITE_TRANSIENT);
 }
 
 static void regexStringSplitFunc(sqlite3_context* context,
                                  int argc,
                                  sqlite3_value** argv) {
   try {
-    callStringSplitFunc(context, argc, argv, regexSplit);
+    callStringSplitFunc(
+        context,
+        argc,
+        argv,
+        [context](const std::string& input, const std::string& token) {
+          return regexSplit(context, input, token);
+        });
   } catch (const std::regex_error& e) {
     LOG(INFO) << "Invalid regex: " << e.what();
     sqlite3_result_error(context, "Invalid regex", -1);
@@ -187,7 +267,8 @@ static void regexStringMatchFunc(sqlite3_context* context,
   }
 
   try {
-    isMatchFound = std::regex_search(input, results, std::regex(regex));
+    auto pattern = getRegex(context, 1, regex);
+    isMatchFound = std::regex_search(input, results, pattern.get());
   } catch (const std::regex_error& e) {
     LOG(INFO) << "Invalid regex: " << e.what();
     sqlite3_result_error(context, "Invalid regex", -1);
@@ -19,11 +19,13 @@
 #include <osquery/core/shutdown.h>
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry_factory.h>
+#include <osquery/sql/result_memory.h>
 #include <osquery/sql/sql.h>
 
 #include <osquery/utils/conversions/split.h>
 
 #include <boost/lexical_cast.hpp>
+#include <boost/noncopyable.hpp>
 
 namespace osquery {
 
@@ -39,10 +41,29 @@ CLI_FLAG(string,
 
 FLAG(string, nullvalue, "", "Set string for NULL values, default ''");
 
+FLAG(uint64,
+     connection_pool_size,
+     4,
+     "Idle transient SQLite connections kept for reuse (default 4)");
+
+FLAG(uint64,
+     statement_cache_size,
+     128,
+     "Prepared statements kept per SQLite connection (default 128)");
+
 using OpReg = QueryPlanner::Opcode::Register;
 
 using SQLiteDBInstanceRef = std::shared_ptr<SQLiteDBInstance>;
 
+/// Pooled connections idle for longer are closed to return their memory.
+const std::chrono::seconds kConnectionPoolIdleTimeout{300};
+
+/// SQLite instructions run between checks of a query's time budget.
+const int kQueryBudgetInstructions{10000};
+
+/// Set when the manager is destroyed, late releases close their connection.
+static std::atomic<bool> kConnectionPoolClosed{false};
+
 /**
  * @brief A map of SQLite status codes to their corresponding message string
  *
@@ -184,7 +205,7 @@ Status SQLiteSQLPlugin::getQueryTables(const std::string& query,
 SQLInternal::SQLInternal(const std::string& query, bool use_cache) {
   auto dbc = SQLiteDBManager::get();
   dbc->useCache(use_cache);
-  status_ = queryInternal(query, resultsTyped_, dbc);
+  status_ = queryInternal(query, results_, dbc);
 
   // One of the advantages of using SQLInternal (aside from the Registry-bypass)
   // is the ability to "deep-inspect" the table attributes and actions.
@@ -194,9 +215,16 @@ SQLInternal::SQLInternal(const std::string& query, bool use_cache) {
 }
 
 QueryDataTyped& SQLInternal::rowsTyped() {
+  if (!results_.empty()) {
+    results_.moveToQueryData(resultsTyped_);
+  }
   return resultsTyped_;
 }
 
+FlatQueryData& SQLInternal::rowsFlat() {
+  return results_;
+}
+
 const Status& SQLInternal::getStatus() const {
   return status_;
 }
@@ -247,6 +275,9 @@ class SizeVisitor : public boost::static_visitor<> {
 
 void SQLInternal::escapeResults() {
   StringEscaperVisitor visitor;
+  for (auto& value : results_.values()) {
+    boost::apply_visitor(visitor, value);
+  }
   for (auto& rowTyped : resultsTyped_) {
     for (auto& column : rowTyped) {
       boost::apply_visitor(visitor, column.second);
@@ -257,7 +288,22 @@ void SQLInternal::escapeResults() {
 uint64_t SQLInternal::getSize() {
   SizeVisitor visitor;
   uint64_t size = 0;
-  for (const auto& row : rowsTyped()) {
+  if (results_.schema() != nullptr) {
+    // Account for column names as if each row held a copy, like a RowTyped.
+    uint64_t names_size = 0;
+    for (auto column : results_.schema()->order) {
+      names_size += results_.columns()[column].size();
+    }
+    for (size_t row = 0; row < results_.rows(); ++row) {
+      size += names_size;
+      for (auto column : results_.schema()->order) {
+        boost::apply_visitor(visitor, results_.value(row, column));
+        size += visitor.get_size();
+      }
+    }
+  }
+
+  for (const auto& row : resultsTyped_) {
     for (const auto& column : row) {
       size += column.first.size();
       boost::apply_visitor(visitor, column.second);
@@ -267,6 +313,19 @@ uint64_t SQLInternal::getSize() {
   return size;
 }
 
+size_t SQLInternal::getRowCount() const {
+  return results_.rows() + resultsTyped_.size();
+}
+
+SQLInternal SQLInternal::copy() const {
+  SQLInternal sql;
+  sql.results_ = results_.copy();
+  sql.resultsTyped_ = resultsTyped_;
+  sql.status_ = status_;
+  sql.event_based_ = event_based_;
+  return sql;
+}
+
 Status SQLiteSQLPlugin::attach(const std::string& name) {
   PluginResponse response;
   auto status =
@@ -283,7 +342,11 @@ Status SQLiteSQLPlugin::attach(const std::string& name) {
   auto dbc = SQLiteDBManager::getConnection(true);
 
   // Attach as an extension, allowing read/write tables
-  return attachTableInternal(name, dbc, is_extension);
+  status = attachTableInternal(name, dbc, is_extension);
+
+  // Pooled connections were attached without the new table.
+  SQLiteDBManager::invalidatePool();
+  return status;
 }
 
 Status SQLiteSQLPlugin::detach(const std::string& name) {
@@ -291,7 +354,9 @@ Status SQLiteSQLPlugin::detach(const std::string& name) {
   // primary database. To allow this, getConnection can explicitly request the
   // primary instance and avoid the contention decisions.
   auto dbc = SQLiteDBManager::getConnection(true);
-  return detachTableInternal(name, dbc);
+  auto status = detachTableInternal(name, dbc);
+  SQLiteDBManager::invalidatePool();
+  return status;
 }
 
 SQLiteDBInstance::SQLiteDBInstance(sqlite3*& db, Mutex& mtx)
@@ -356,6 +421,7 @@ static inline void openOptimized(sqlite3*& db) {
   registerHashingExtensions(db);
   registerEncodingExtensions(db);
   registerNetworkExtensions(db);
+  registerAggregateExtensions(db);
 
   auto rc = sqlite3_set_authorizer(db, &sqliteAuthorizer, nullptr);
   if (rc != SQLITE_OK) {
@@ -364,6 +430,22 @@ static inline void openOptimized(sqlite3*& db) {
   }
 }
 
+/// Read the schema version, which changes when tables or views are created.
+static int getSchemaVersion(sqlite3* db) {
+  // The authorizer denies this pragma to queries, lift it for the check.
+  sqlite3_set_authorizer(db, nullptr, nullptr);
+  int version = -1;
+  sqlite3_stmt* stmt = nullptr;
+  if (sqlite3_prepare_v2(db, "PRAGMA schema_version", -1, &stmt, nullptr) ==
+          SQLITE_OK &&
+      sqlite3_step(stmt) == SQLITE_ROW) {
+    version = sqlite3_column_int(stmt, 0);
+  }
+  sqlite3_finalize(stmt);
+  sqlite3_set_authorizer(db, &sqliteAuthorizer, nullptr);
+  return version;
+}
+
 void SQLiteDBInstance::init() {
   primary_ = false;
   openOptimized(db_);
@@ -384,6 +466,50 @@ RecursiveLock SQLiteDBInstance::attachLock() const {
   return RecursiveLock(attach_mutex_);
 }
 
+SQLiteStatementRef SQLiteDBInstance::getStatement(const std::string& sql) {
+  if (isPrimary() && !managed_) {
+    // The primary database's statements are kept by the managed instance.
+    return SQLiteDBManager::getConnection(true)->getStatement(sql);
+  }
+
+  WriteLock lock(statements_mutex_);
+  if (statements_ == nullptr) {
+    return nullptr;
+  }
+  auto statement = statements_->get(sql);
+  return (statement == nullptr) ? nullptr : *statement;
+}
+
+void SQLiteDBInstance::addStatement(const std::string& sql,
+                                    SQLiteStatementRef statement) {
+  if (isPrimary() && !managed_) {
+    SQLiteDBManager::getConnection(true)->addStatement(sql,
+                                                       std::move(statement));
+    return;
+  }
+
+  if (FLAGS_statement_cache_size == 0) {
+    return;
+  }
+
+  WriteLock lock(statements_mutex_);
+  if (statements_ == nullptr) {
+    statements_ =
+        std::make_unique<SQLiteStatementCache>(FLAGS_statement_cache_size);
+  }
+  statements_->insert(sql, std::move(statement));
+}
+
+void SQLiteDBInstance::clearStatements() {
+  if (isPrimary() && !managed_) {
+    SQLiteDBManager::getConnection(true)->clearStatements();
+    return;
+  }
+
+  WriteLock lock(statements_mutex_);
+  statements_.reset();
+}
+
 void SQLiteDBInstance::addAffectedTable(
     std::shared_ptr<VirtualTableContent> table) {
   // An xFilter/scan was requested for this virtual table.
@@ -421,6 +547,8 @@ void SQLiteDBInstance::clearAffectedTables() {
     table.second->cache.clear();
     table.second->colsUsed.clear();
     table.second->colsUsedBitsets.clear();
+    table.second->inLists.clear();
+    table.second->limits.clear();
   }
   // Since the affected tables are cleared, there are no more affected tables.
   // There is no concept of compounding tables between queries.
@@ -429,6 +557,8 @@ void SQLiteDBInstance::clearAffectedTables() {
 }
 
 SQLiteDBInstance::~SQLiteDBInstance() {
+  // Statements must be finalized before their database is closed.
+  statements_.reset();
   if (!isPrimary() && db_ != nullptr) {
     sqlite3_close(db_);
   } else {
@@ -482,6 +612,9 @@ void SQLiteDBManager::resetPrimary() {
   auto& self = instance();
 
   WriteLock connection_lock(self.mutex_);
+  if (self.connection_ != nullptr) {
+    self.connection_->clearStatements();
+  }
   self.connection_.reset();
 
   {
@@ -489,6 +622,8 @@ void SQLiteDBManager::resetPrimary() {
     sqlite3_close(self.db_);
     self.db_ = nullptr;
   }
+
+  invalidatePool();
 }
 
 void SQLiteDBManager::setDisabledTables(const std::string& list) {
@@ -526,15 +661,87 @@ SQLiteDBInstanceRef SQLiteDBManager::getConnection(bool primary) {
   }
 
   // Create a 'database connection' for the managed database instance.
-  auto instance = std::make_shared<SQLiteDBInstance>(self.db_, self.mutex_);
-  if (!instance->isPrimary()) {
-    attachVirtualTables(instance);
+  WriteLock primary_lock(self.mutex_, boost::try_to_lock);
+  if (primary_lock.owns_lock()) {
+    return SQLiteDBInstanceRef(
+        new SQLiteDBInstance(self.db_, std::move(primary_lock)));
+  }
+
+  // There is contention, prefer a transient connection already attached.
+  auto instance = getPooled();
+  if (instance != nullptr) {
+    return instance;
   }
 
+  VLOG(1) << "DBManager contention: opening transient SQLite database";
+  instance = SQLiteDBInstanceRef(new SQLiteDBInstance(), &release);
+  instance->pool_generation_ = self.pool_generation_;
+  attachVirtualTables(instance);
+  instance->schema_version_ = getSchemaVersion(instance->db());
   return instance;
 }
 
+SQLiteDBInstanceRef SQLiteDBManager::getPooled() {
+  auto& self = instance();
+  WriteLock lock(self.pool_mutex_);
+  self.expirePool();
+  if (self.pool_.empty()) {
+    return nullptr;
+  }
+
+  auto connection = std::move(self.pool_.back().instance);
+  self.pool_.pop_back();
+  return SQLiteDBInstanceRef(connection.release(), &release);
+}
+
+void SQLiteDBManager::release(SQLiteDBInstance* instance) {
+  std::unique_ptr<SQLiteDBInstance> connection(instance);
+  if (kConnectionPoolClosed) {
+    return;
+  }
+  auto& self = SQLiteDBManager::instance();
+
+  // Connections with an open transaction or user-created tables and views
+  // would leak that state into the next query, close them instead.
+  auto db = connection->db();
+  if (db == nullptr || sqlite3_get_autocommit(db) == 0 ||
+      getSchemaVersion(db) != connection->schema_version_) {
+    return;
+  }
+
+  connection->clearAffectedTables();
+  sqlite3_db_release_memory(db);
+
+  WriteLock lock(self.pool_mutex_);
+  self.expirePool();
+  if (connection->pool_generation_ != self.pool_generation_ ||
+      self.pool_.size() >= FLAGS_connection_pool_size) {
+    return;
+  }
+  self.pool_.push_back(
+      {std::move(connection), std::chrono::steady_clock::now()});
+}
+
+void SQLiteDBManager::invalidatePool() {
+  auto& self = instance();
+  WriteLock lock(self.pool_mutex_);
+  self.pool_generation_++;
+  self.pool_.clear();
+}
+
+void SQLiteDBManager::expirePool() {
+  auto expired = std::chrono::steady_clock::now() - kConnectionPoolIdleTimeout;
+  pool_.erase(std::remove_if(pool_.begin(),
+                             pool_.end(),
+                             [&expired](const PooledConnection& connection) {
+                               return connection.released < expired;
+                             }),
+              pool_.end());
+}
+
 SQLiteDBManager::~SQLiteDBManager() {
+  kConnectionPoolClosed = true;
+  pool_.clear();
   connection_ = nullptr;
   if (db_ != nullptr) {
     sqlite3_close(db_);
@@ -653,52 +860,178 @@ Status readRows(sqlite3_stmt* prepared_statement,
     int num_columns = sqlite3_column_count(prepared_statement);
     std::vector<std::string> colNames;
     colNames.reserve(num_columns);
+    size_t names_size = 0;
     for (int i = 0; i < num_columns; i++) {
       colNames.push_back(sqlite3_column_name(prepared_statement, i));
+      names_size += colNames.back().size();
     }
 
     do {
       RowTyped row;
+      size_t row_size = names_size;
       for (int i = 0; i < num_columns; i++) {
         switch (sqlite3_column_type(prepared_statement, i)) {
         case SQLITE_INTEGER:
           row[colNames[i]] = static_cast<long long>(
               sqlite3_column_int64(prepared_statement, i));
+          row_size += sizeof(long long);
           break;
         case SQLITE_FLOAT:
           row[colNames[i]] = sqlite3_column_double(prepared_statement, i);
+          row_size += sizeof(double);
           break;
         case SQLITE_NULL:
           row[colNames[i]] = FLAGS_nullvalue;
+          row_size += FLAGS_nullvalue.size();
           break;
         default:
           // Everything else (SQLITE_TEXT, SQLITE3_TEXT, SQLITE_BLOB) is
           // obtained/conveyed as text/string
           row[colNames[i]] = std::string(reinterpret_cast<const char*>(
               sqlite3_column_text(prepared_statement, i)));
+          row_size += sqlite3_column_bytes(prepared_statement, i);
         }
       }
       results.push_back(std::move(row));
+
+      auto status = ResultMemory::add(row_size);
+      if (!status.ok()) {
+        return status;
+      }
       rc = sqlite3_step(prepared_statement);
     } while (SQLITE_ROW == rc);
   }
+  if (rc == SQLITE_INTERRUPT) {
+    // Report the budget that stopped the query rather than the interruption.
+    auto status = ResultMemory::check();
+    if (!status.ok()) {
+      return status;
+    }
+  }
   if (rc != SQLITE_DONE) {
-    auto s = Status::failure(sqlite3_errmsg(instance->db()));
-    sqlite3_finalize(prepared_statement);
-    return s;
+    return Status::failure(sqlite3_errmsg(instance->db()));
   }
 
-  rc = sqlite3_finalize(prepared_statement);
-  if (rc != SQLITE_OK) {
+  return Status::success();
+}
+
+Status readRows(sqlite3_stmt* prepared_statement,
+                FlatQueryData& results,
+                const SQLiteDBInstanceRef& instance) {
+  if (prepared_statement == nullptr) {
+    return Status::success();
+  }
+  int rc = sqlite3_step(prepared_statement);
+  if (SQLITE_ROW == rc) {
+    int num_columns = sqlite3_column_count(prepared_statement);
+    ColumnNames colNames;
+    colNames.reserve(num_columns);
+    size_t names_size = 0;
+    for (int i = 0; i < num_columns; i++) {
+      colNames.push_back(sqlite3_column_name(prepared_statement, i));
+      names_size += colNames.back().size();
+    }
+
+    // Rows of every statement share one schema, a statement returning other
+    // columns may only follow statements that did not return rows.
+    if (results.schema() == nullptr || results.columns() != colNames) {
+      if (!results.empty()) {
+        return Status::failure(
+            "Statements returning different columns cannot be combined");
+      }
+      results = FlatQueryData(std::move(colNames));
+    }
+
+    do {
+      auto* row = results.addRow();
+      // Accounted like getSize, as if each row held a copy of the names.
+      size_t row_size = names_size;
+      for (int i = 0; i < num_columns; i++) {
+        switch (sqlite3_column_type(prepared_statement, i)) {
+        case SQLITE_INTEGER:
+          row[i] = static_cast<long long>(
+              sqlite3_column_int64(prepared_statement, i));
+          row_size += sizeof(long long);
+          break;
+        case SQLITE_FLOAT:
+          row[i] = sqlite3_column_double(prepared_statement, i);
+          row_size += sizeof(double);
+          break;
+        case SQLITE_NULL:
+          row[i] = FLAGS_nullvalue;
+          row_size += FLAGS_nullvalue.size();
+          break;
+        default:
+          // Everything else (SQLITE_TEXT, SQLITE3_TEXT, SQLITE_BLOB) is
+          // obtained/conveyed as text/string
+          row[i] = std::string(reinterpret_cast<const char*>(
+              sqlite3_column_text(prepared_statement, i)));
+          row_size += sqlite3_column_bytes(prepared_statement, i);
+        }
+      }
+
+      auto status = ResultMemory::add(row_size);
+      if (!status.ok()) {
+        return status;
+      }
+      rc = sqlite3_step(prepared_statement);
+    } while (SQLITE_ROW == rc);
+  }
+  if (rc == SQLITE_INTERRUPT) {
+    // Report the budget that stopped the query rather than the interruption.
+    auto status = ResultMemory::check();
+    if (!status.ok()) {
+      return status;
+    }
+  }
+  if (rc != SQLITE_DONE) {
     return Status::failure(sqlite3_errmsg(instance->db()));
   }
 
   return Status::success();
 }
 
-Status queryInternal(const std::string& query,
-                     QueryDataTyped& results,
-                     const SQLiteDBInstanceRef& instance) {
+/// Check if only whitespace remains after a statement.
+static inline bool isTrailingSpace(const char* sql) {
+  while (isspace(sql[0])) {
+    sql++;
+  }
+  return sql[0] == '\0';
+}
+
+/// Interrupt the statement once the time budget of its query is exceeded.
+static int checkQueryBudget(void*) {
+  return ResultMemory::check().ok() ? 0 : 1;
+}
+
+/// Check the time budget of the calling thread's query while it runs.
+class QueryBudgetHandler : private boost::noncopyable {
+ public:
+  explicit QueryBudgetHandler(sqlite3* db) : db_(db) {
+    if (ResultMemory::timed()) {
+      sqlite3_progress_handler(
+          db_, kQueryBudgetInstructions, checkQueryBudget, nullptr);
+    } else {
+      db_ = nullptr;
+    }
+  }
+
+  ~QueryBudgetHandler() {
+    if (db_ != nullptr) {
+      sqlite3_progress_handler(db_, 0, nullptr, nullptr);
+    }
+  }
+
+ private:
+  sqlite3* db_{nullptr};
+};
+
+/// Prepare and read the rows of each statement in a query.
+template <typename Results>
+static Status queryStatements(const std::string& query,
+                              Results& results,
+                              const SQLiteDBInstanceRef& instance) {
+  QueryBudgetHandler budget_handler(instance->db());
   sqlite3_stmt* prepared_statement{nullptr}; /* Statement to execute. */
 
   int rc = SQLITE_OK; /* Return Code */
@@ -713,6 +1046,22 @@ Status queryInternal(const std::string& query,
     while (isspace(sql[0])) {
       sql++;
     }
+
+    // Scheduled and distributed queries repeat, reuse their parsed plan.
+    // Only a query's last statement is cached, keyed by its remaining text.
+    if (FLAGS_statement_cache_size > 0 && sql[0] != '\0') {
+      auto statement = instance->getStatement(sql);
+      if (statement != nullptr) {
+        sqlite3_clear_bindings(statement.get());
+        Status s = readRows(statement.get(), results, instance);
+        sqlite3_reset(statement.get());
+        if (!s.ok()) {
+          return s;
+        }
+        break;
+      }
+    }
+
     rc = sqlite3_prepare_v2(
         instance->db(), sql, -1, &prepared_statement, &leftover_sql);
     if (rc != SQLITE_OK) {
@@ -722,6 +1071,17 @@ Status queryInternal(const std::string& query,
     }
 
     Status s = readRows(prepared_statement, results, instance);
+    if (s.ok() && prepared_statement != nullptr &&
+        FLAGS_statement_cache_size > 0 && isTrailingSpace(leftover_sql)) {
+      sqlite3_reset(prepared_statement);
+      instance->addStatement(
+          sql, SQLiteStatementRef(prepared_statement, sqlite3_finalize));
+    } else {
+      rc = sqlite3_finalize(prepared_statement);
+      if (s.ok() && rc != SQLITE_OK) {
+        s = Status::failure(sqlite3_errmsg(instance->db()));
+      }
+    }
     if (!s.ok()) {
       return s;
     }
@@ -732,6 +1092,18 @@ Status queryInternal(const std::string& query,
   return Status::success();
 }
 
+Status queryInternal(const std::string& query,
+                     QueryDataTyped& results,
+                     const SQLiteDBInstanceRef& instance) {
+  return queryStatements(query, results, instance);
+}
+
+Status queryInternal(const std::string& query,
+                     FlatQueryData& results,
+                     const SQLiteDBInstanceRef& instance) {
+  return queryStatements(query, results, instance);
+}
+
 Status getQueryColumnsInternal(const std::string& q,
                                TableColumns& columns,
                                const SQLiteDBInstanceRef& instance) {
@@ -766,7 +1138,7 @@ Status getQueryColumnsInternal(const std::string& q,
       auto col_type = sqlite3_column_decltype(stmt, i);
 
       if (col_name == nullptr) {
-        status = Status(1, "Could not get column type");
+        status = Status::staticFailure("Could not get column type");
         break;
       }
 
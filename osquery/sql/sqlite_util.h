@@ -10,17 +10,22 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <unordered_set>
+#include <vector>
 
 #include <sqlite3.h>
 
 #include <boost/filesystem.hpp>
 #include <boost/noncopyable.hpp>
 
+#include <osquery/core/sql/flat_query_data.h>
 #include <osquery/sql/sql.h>
 
+#include <osquery/utils/caches/lru.h>
 #include <osquery/utils/mutex.h>
 
 #include <gtest/gtest_prod.h>
@@ -86,6 +91,12 @@ const std::unordered_set<std::string> kAllowedSQLitePragmas = {
 
 class SQLiteDBManager;
 
+/// A prepared statement, finalized when the last reference is released.
+using SQLiteStatementRef = std::shared_ptr<sqlite3_stmt>;
+
+/// Prepared statements by SQL text, the least recently used are finalized.
+using SQLiteStatementCache = caches::LRU<std::string, SQLiteStatementRef>;
+
 /**
  * @brief An RAII wrapper around an `sqlite3` object.
  *
@@ -95,7 +106,8 @@ class SQLiteDBManager;
  *
  * If there is resource contention (multiple threads want access to the SQLite
  * abstraction layer), then the SQLiteDBManager will provide a transient
- * SQLiteDBInstance.
+ * SQLiteDBInstance. Transient instances are kept in a pool when released and
+ * reused by later requests, see SQLiteDBManager::getConnection.
  */
 class SQLiteDBInstance : private boost::noncopyable {
  public:
@@ -139,6 +151,22 @@ class SQLiteDBInstance : private boost::noncopyable {
   /// Lock the database for attaching virtual tables.
   RecursiveLock attachLock() const;
 
+  /**
+   * @brief Find a prepared statement cached for the SQL text.
+   *
+   * The statement is reset, it may be stepped again without re-parsing or
+   * re-planning the query.
+   *
+   * @return the statement, or nullptr if the text is not cached.
+   */
+  SQLiteStatementRef getStatement(const std::string& sql);
+
+  /// Cache a reset prepared statement for the SQL text.
+  void addStatement(const std::string& sql, SQLiteStatementRef statement);
+
+  /// Finalize every cached statement, for example when tables re-attach.
+  void clearStatements();
+
  private:
   /// Handle the primary/forwarding requests for table attribute accesses.
   TableAttributes getAttributes() const;
@@ -148,6 +176,10 @@ class SQLiteDBInstance : private boost::noncopyable {
   explicit SQLiteDBInstance(sqlite3* db)
       : primary_(true), managed_(true), db_(db) {}
 
+  /// Wrap the primary database, the lock on the primary mutex is held.
+  SQLiteDBInstance(sqlite3* db, WriteLock lock)
+      : primary_(true), db_(db), lock_(std::move(lock)) {}
+
  private:
   /// Introspection into the database pointer, primary means managed.
   bool primary_{false};
@@ -184,6 +216,18 @@ class SQLiteDBInstance : private boost::noncopyable {
   /// Vector of tables that need their constraints cleared after execution.
   std::map<std::string, std::shared_ptr<VirtualTableContent>> affected_tables_;
 
+  /// The connection pool generation this transient's tables were attached in.
+  uint64_t pool_generation_{0};
+
+  /// The schema version after attaching, user changes prevent pooling.
+  int schema_version_{0};
+
+  /// Prepared statements by SQL text, created on first use.
+  std::unique_ptr<SQLiteStatementCache> statements_;
+
+  /// Protects the prepared statement cache.
+  Mutex statements_mutex_;
+
  private:
   friend class SQLiteDBManager;
   friend class SQLInternal;
@@ -220,6 +264,8 @@ class SQLiteDBManager : private boost::noncopyable {
    * scope. Using the SQLiteDBManager will also try to optimize the number of
    * `sqlite3` databases in use by managing a single global instance and
    * returning resource-safe transient databases if there's access contention.
+   * Released transient databases are pooled, up to connection_pool_size, so
+   * that contention does not pay to attach every virtual table again.
    *
    * Note: osquery::initOsquery must be called before calling `get` in order
    * for virtual tables to be registered.
@@ -238,6 +284,7 @@ class SQLiteDBManager : private boost::noncopyable {
    *
    * Over time it may be helpful to remove SQLite's arena.
    * We can periodically close and re-initialize and connect virtual tables.
+   * Pooled transient connections are closed as well.
    */
   static void resetPrimary();
 
@@ -289,6 +336,34 @@ class SQLiteDBManager : private boost::noncopyable {
   /// Request a connection, optionally request the primary connection.
   static SQLiteDBInstanceRef getConnection(bool primary = false);
 
+  /// Take an idle transient connection from the pool, if one is available.
+  static SQLiteDBInstanceRef getPooled();
+
+  /// Return a released transient connection to the pool, or close it.
+  static void release(SQLiteDBInstance* instance);
+
+  /// Close every pooled connection, their attached tables are outdated.
+  static void invalidatePool();
+
+  /// Close pooled connections idle for too long, requires the pool lock.
+  void expirePool();
+
+ private:
+  /// An idle transient connection with its virtual tables attached.
+  struct PooledConnection {
+    std::unique_ptr<SQLiteDBInstance> instance;
+    std::chrono::steady_clock::time_point released;
+  };
+
+  /// Idle transient connections, the most recently released last.
+  std::vector<PooledConnection> pool_;
+
+  /// Protects the connection pool.
+  Mutex pool_mutex_;
+
+  /// Incremented whenever pooled connections become invalid.
+  std::atomic<uint64_t> pool_generation_{0};
+
  private:
   friend class SQLiteDBInstance;
   friend class SQLiteSQLPlugin;
@@ -399,6 +474,22 @@ Status queryInternal(const std::string& q,
                      QueryData& results,
                      const SQLiteDBInstanceRef& instance);
 
+/**
+ * @brief SQLite Internal: Execute a query, collecting flat results
+ *
+ * Rows are read into a single FlatQueryData without building a RowTyped per
+ * row. All statements returning rows must return the same columns.
+ *
+ * @param q the query to execute
+ * @param results The FlatQueryData to emit rows on query success.
+ * @param db the SQLite3 database to execute query q against
+ *
+ * @return A status indicating SQL query results.
+ */
+Status queryInternal(const std::string& q,
+                     FlatQueryData& results,
+                     const SQLiteDBInstanceRef& instance);
+
 /**
  * @brief SQLite Intern: Analyze a query, providing information about the
  * result columns
@@ -434,12 +525,18 @@ class SQLInternal : private only_movable {
 
  public:
   /**
-   * @brief Const accessor for the rows returned by the query.
+   * @brief Accessor for the rows returned by the query.
+   *
+   * The flat results are materialized into RowTyped rows on first use, after
+   * which rowsFlat() is empty.
    *
    * @return A QueryDataTyped object of the query results.
    */
   QueryDataTyped& rowsTyped();
 
+  /// Accessor for the flat rows returned by the query.
+  FlatQueryData& rowsFlat();
+
   const Status& getStatus() const;
 
   /**
@@ -461,8 +558,20 @@ class SQLInternal : private only_movable {
   /// Returns the size
   uint64_t getSize();
 
+  /// Returns the number of rows, without materializing typed rows.
+  size_t getRowCount() const;
+
+  /// Copy the results and status, for scheduled queries sharing a run.
+  SQLInternal copy() const;
+
+ private:
+  SQLInternal() = default;
+
  private:
-  /// The internal member which holds the typed results of the query.
+  /// The internal member which holds the results of the query.
+  FlatQueryData results_;
+
+  /// The typed results, materialized from results_ when requested.
   QueryDataTyped resultsTyped_;
 
   /// The internal member which holds the status of the query.
@@ -524,6 +633,52 @@ void registerFilesystemExtensions(sqlite3* db);
  */
 void registerNetworkExtensions(sqlite3* db);
 
+/**
+ * @brief Register approximate aggregate 'custom' functions.
+ */
+void registerAggregateExtensions(sqlite3* db);
+
+/**
+ * @brief A value parsed from a 'custom' function argument, cached per
+ * statement.
+ *
+ * SQLite keeps the value as the argument's auxiliary data while the argument
+ * is unchanged, so a constant argument is parsed once for all rows. A newly
+ * parsed value is only handed to SQLite at destruction, as SQLite may free
+ * auxiliary data as soon as it is set.
+ */
+template <typename T>
+class SQLiteAuxData : private boost::noncopyable {
+ public:
+  template <typename Parse>
+  SQLiteAuxData(sqlite3_context* context, int argument, Parse parse)
+      : context_(context), argument_(argument) {
+    value_ = static_cast<T*>(sqlite3_get_auxdata(context, argument));
+    if (value_ == nullptr) {
+      parsed_ = std::make_unique<T>(parse());
+      value_ = parsed_.get();
+    }
+  }
+
+  ~SQLiteAuxData() {
+    if (parsed_ != nullptr) {
+      sqlite3_set_auxdata(context_, argument_, parsed_.release(), [](void* v) {
+        delete static_cast<T*>(v);
+      });
+    }
+  }
+
+  const T& get() const {
+    return *value_;
+  }
+
+ private:
+  sqlite3_context* context_{nullptr};
+  int argument_{0};
+  const T* value_{nullptr};
+  std::unique_ptr<T> parsed_;
+};
+
 /**
  * @brief Generate the data for auto-constructed sqlite tables
  *
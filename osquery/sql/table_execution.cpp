@@ -0,0 +1,122 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <utility>
+
+#include <osquery/core/flags.h>
+#include <osquery/sql/table_execution.h>
+
+namespace osquery {
+
+FLAG(bool,
+     schedule_table_stats,
+     false,
+     "Record the execution statistics of the tables used by scheduled queries");
+
+namespace {
+
+/// The scope of the calling thread, if a scheduled query is running on it.
+thread_local TableExecution::Scope* current_scope{nullptr};
+
+/// The distinct constraint shapes kept per table.
+const size_t kMaxTableShapes{16};
+
+} // namespace
+
+void TableExecutionStats::add(const TableExecutionStats& other) {
+  filters += other.filters;
+  rows_generated += other.rows_generated;
+  rows_returned += other.rows_returned;
+  generate_time_us += other.generate_time_us;
+  for (const auto& shape : other.shapes) {
+    if (shapes.size() >= kMaxTableShapes) {
+      break;
+    }
+    shapes.insert(shape);
+  }
+}
+
+TableExecution::Scope::Scope(std::string query) {
+  if (!enabled() || query.empty()) {
+    return;
+  }
+
+  query_ = std::move(query);
+  previous_ = current_scope;
+  current_scope = this;
+}
+
+TableExecution::Scope::~Scope() {
+  if (query_.empty()) {
+    return;
+  }
+
+  current_scope = previous_;
+  get().record(*this);
+}
+
+TableExecution& TableExecution::get() {
+  static TableExecution execution;
+  return execution;
+}
+
+bool TableExecution::enabled() {
+  return FLAGS_schedule_table_stats;
+}
+
+bool TableExecution::active() {
+  return current_scope != nullptr;
+}
+
+void TableExecution::recordScan(const std::string& table,
+                                const std::string& shape,
+                                uint64_t rows_generated,
+                                uint64_t rows_returned,
+                                std::chrono::microseconds generate_time) {
+  if (current_scope == nullptr) {
+    return;
+  }
+
+  auto& stats = current_scope->tables_[table];
+  ++stats.filters;
+  stats.rows_generated += rows_generated;
+  stats.rows_returned += rows_returned;
+  stats.generate_time_us += static_cast<uint64_t>(generate_time.count());
+  if (!shape.empty() && stats.shapes.size() < kMaxTableShapes) {
+    stats.shapes.insert(shape);
+  }
+}
+
+void TableExecution::record(const Scope& scope) {
+  WriteLock lock(mutex_);
+  auto& stats = queries_[scope.query_];
+  ++stats.executions;
+  stats.last = scope.tables();
+  for (const auto& table : scope.tables()) {
+    stats.total[table.first].add(table.second);
+  }
+}
+
+bool TableExecution::getQuery(const std::string& query,
+                              QueryTableExecution& stats) const {
+  ReadLock lock(mutex_);
+  auto it = queries_.find(query);
+  if (it == queries_.end()) {
+    return false;
+  }
+  stats = it->second;
+  return true;
+}
+
+void TableExecution::reset() {
+  WriteLock lock(mutex_);
+  queries_.clear();
+}
+
+} // namespace osquery
@@ -0,0 +1,145 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/utils/mutex.h>
+
+namespace osquery {
+
+/// The execution statistics of a table within a scheduled query.
+struct TableExecutionStats {
+  /// The scans of the table, SQLite filters a cursor once per scan.
+  uint64_t filters{0};
+
+  /// The rows generated by the table.
+  uint64_t rows_generated{0};
+
+  /// The rows SQLite read, fewer than generated if a scan stopped early.
+  uint64_t rows_returned{0};
+
+  /// The time spent generating rows in microseconds.
+  uint64_t generate_time_us{0};
+
+  /// The shapes of the constrained scans, see TableStatistics::shape.
+  std::set<std::string> shapes;
+
+  /// Accumulate the statistics of other executions.
+  void add(const TableExecutionStats& other);
+};
+
+/// Statistics by table name.
+using TableExecutionMap = std::map<std::string, TableExecutionStats>;
+
+/// The statistics of the tables used by a scheduled query.
+struct QueryTableExecution {
+  /// The recorded executions of the query.
+  uint64_t executions{0};
+
+  /// The statistics of every recorded execution.
+  TableExecutionMap total;
+
+  /// The statistics of the latest execution.
+  TableExecutionMap last;
+};
+
+/**
+ * @brief Per query and per table execution statistics.
+ *
+ * The query performance of the schedule covers a query as a whole. When
+ * schedule_table_stats is enabled a scheduled query runs within a
+ * TableExecution::Scope, and each scan of a table records the rows it
+ * generated, the rows SQLite read from it, the time spent generating them
+ * and its constraint shape. A join scanning a table once per outer row, or a
+ * table generating rows the query never reads, is visible per table.
+ */
+class TableExecution : private boost::noncopyable {
+ public:
+  /**
+   * @brief Record the scans made on the calling thread until destroyed.
+   *
+   * The scans are added to the statistics of the query when the scope is
+   * destroyed. Nothing is recorded unless schedule_table_stats is enabled.
+   */
+  class Scope : private boost::noncopyable {
+   public:
+    explicit Scope(std::string query);
+    ~Scope();
+
+    /// The tables scanned within the scope.
+    const TableExecutionMap& tables() const {
+      return tables_;
+    }
+
+   private:
+    /// The scope of the calling thread when this scope was created.
+    Scope* previous_{nullptr};
+
+    /// The scheduled query, empty if the scope is not recording.
+    std::string query_;
+
+    TableExecutionMap tables_;
+
+   private:
+    friend class TableExecution;
+  };
+
+  /// The process-wide statistics.
+  static TableExecution& get();
+
+  /// Check if scheduled queries record their table statistics.
+  static bool enabled();
+
+  /// Check if the calling thread is within a scope.
+  static bool active();
+
+  /**
+   * @brief Record a completed scan of a table on the calling thread.
+   *
+   * Does nothing outside of a scope.
+   */
+  static void recordScan(const std::string& table,
+                         const std::string& shape,
+                         uint64_t rows_generated,
+                         uint64_t rows_returned,
+                         std::chrono::microseconds generate_time);
+
+  /**
+   * @brief Retrieve the statistics of a query.
+   *
+   * @return false if no execution of the query was recorded.
+   */
+  bool getQuery(const std::string& query, QueryTableExecution& stats) const;
+
+  /// Remove every statistic, used by tests.
+  void reset();
+
+ private:
+  TableExecution() = default;
+
+  /// Add the scans of a scope to the statistics of its query.
+  void record(const Scope& scope);
+
+ private:
+  /// Protects the statistics, queries may run concurrently.
+  mutable Mutex mutex_;
+
+  /// Statistics by scheduled query name.
+  std::map<std::string, QueryTableExecution> queries_;
+};
+
+} // namespace osquery
@@ -0,0 +1,230 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+#include <vector>
+
+#include <osquery/core/flags.h>
+#include <osquery/logger/logger.h>
+#include <osquery/sql/table_generation_cache.h>
+
+namespace osquery {
+
+FLAG(uint64,
+     schedule_table_cache_size,
+     0,
+     "Bytes of table rows scheduled queries in the same step may share "
+     "(default 0, disabled)");
+
+namespace {
+
+/// The prefetch of the thread, if it generates the rows of a later step.
+thread_local TableGenerationCache::Prefetch* current_prefetch{nullptr};
+
+/// Append a length-prefixed field so that adjacent fields cannot collide.
+inline void appendKeyField(std::string& key, const std::string& field) {
+  key += std::to_string(field.size());
+  key += ':';
+  key += field;
+}
+
+/// Estimate the memory used by a row from its column names and values.
+size_t estimateRowSize(const TableRow& row) {
+  size_t size = 0;
+  for (const auto& column : static_cast<Row>(row)) {
+    size += column.first.size() + column.second.size();
+  }
+  return size;
+}
+} // namespace
+
+TableGenerationCache::Prefetch::Prefetch(uint64_t step)
+    : step_(step), previous_(current_prefetch) {
+  current_prefetch = this;
+}
+
+TableGenerationCache::Prefetch::~Prefetch() {
+  current_prefetch = previous_;
+}
+
+TableGenerationCache& TableGenerationCache::get() {
+  static TableGenerationCache cache;
+  return cache;
+}
+
+void TableGenerationCache::startStep(uint64_t step) {
+  WriteLock lock(mutex_);
+  if (step_ != step) {
+    entries_ = Entries();
+  }
+  step_ = step;
+  active_ = (FLAGS_schedule_table_cache_size > 0);
+
+  // Rows prefetched for the step are shared, unless it already kept rows.
+  auto it = prefetched_.begin();
+  while (it != prefetched_.end() && it->first <= step) {
+    prefetched_size_ -= it->second.size;
+    if (it->first == step && active_ && entries_.rows.empty()) {
+      entries_ = std::move(it->second);
+    }
+    it = prefetched_.erase(it);
+  }
+}
+
+void TableGenerationCache::endStep() {
+  WriteLock lock(mutex_);
+  active_ = false;
+  entries_ = Entries();
+}
+
+TableGenerationCache::Entries* TableGenerationCache::entries() {
+  if (current_prefetch == nullptr) {
+    return active_ ? &entries_ : nullptr;
+  }
+
+  auto step = current_prefetch->step();
+  if (step == step_) {
+    // The step started while its rows were prefetched.
+    return active_ ? &entries_ : nullptr;
+  }
+  if (step < step_ || FLAGS_schedule_table_cache_size == 0) {
+    return nullptr;
+  }
+  return &prefetched_[step];
+}
+
+bool TableGenerationCache::allowed(const VirtualTableContent& content,
+                                   const QueryContext& context) const {
+  if (!context.useCache()) {
+    // Only scans performed by scheduled queries are shared.
+    return false;
+  }
+
+  auto unshared =
+      TableAttributes::EVENT_BASED | TableAttributes::NO_SHARED_CACHE;
+  if ((content.attributes & unshared) != 0) {
+    return false;
+  }
+
+  if (current_prefetch != nullptr) {
+    return FLAGS_schedule_table_cache_size > 0;
+  }
+
+  ReadLock lock(mutex_);
+  return active_;
+}
+
+bool TableGenerationCache::lookup(const std::string& key, TableRows& rows) {
+  WriteLock lock(mutex_);
+  auto* entries = this->entries();
+  if (entries == nullptr) {
+    return false;
+  }
+
+  auto entry = entries->rows.find(key);
+  if (entry == entries->rows.end()) {
+    return false;
+  }
+
+  rows.clear();
+  rows.reserve(entry->second.size());
+  for (const auto& row : entry->second) {
+    rows.push_back(row->clone());
+  }
+  ++hits_;
+  return true;
+}
+
+void TableGenerationCache::store(const std::string& key,
+                                 const TableRows& rows) {
+  size_t size = key.size();
+  for (const auto& row : rows) {
+    size += estimateRowSize(*row);
+  }
+
+  WriteLock lock(mutex_);
+  auto* entries = this->entries();
+  if (entries == nullptr || entries->rows.count(key) > 0) {
+    return;
+  }
+
+  if (entries_.size + prefetched_size_ + size >
+      FLAGS_schedule_table_cache_size) {
+    VLOG(1) << "Not sharing " << rows.size()
+            << " rows within the schedule step, the table cache is full";
+    return;
+  }
+
+  TableRows copy;
+  copy.reserve(rows.size());
+  for (const auto& row : rows) {
+    copy.push_back(row->clone());
+  }
+  entries->rows.emplace(key, std::move(copy));
+  entries->size += size;
+  if (entries != &entries_) {
+    prefetched_size_ += size;
+  }
+}
+
+std::string TableGenerationCache::key(const std::string& table,
+                                      const QueryContext& context) {
+  std::string key;
+  appendKeyField(key, table);
+
+  // The constraint map is ordered by column, sort each column's constraints
+  // so that equivalent predicates written in another order share a key.
+  for (const auto& column : context.constraints) {
+    if (!column.second.exists()) {
+      continue;
+    }
+
+    std::vector<std::pair<unsigned char, std::string>> constraints;
+    for (const auto& constraint : column.second.getAll()) {
+      constraints.emplace_back(constraint.op, constraint.expr);
+    }
+    std::sort(constraints.begin(), constraints.end());
+
+    appendKeyField(key, column.first);
+    key += std::to_string(static_cast<int>(column.second.affinity));
+    for (const auto& constraint : constraints) {
+      key += ',';
+      key += std::to_string(static_cast<int>(constraint.first));
+      appendKeyField(key, constraint.second);
+    }
+    key += ';';
+  }
+
+  if (context.colsUsedBitset) {
+    key += context.colsUsedBitset->to_string();
+  }
+
+  // A scan stopped at a limit only holds the rows of the same limit.
+  if (context.limit) {
+    key += 'L' + std::to_string(*context.limit);
+  }
+  return key;
+}
+
+size_t TableGenerationCache::size() const {
+  ReadLock lock(mutex_);
+  return entries_.size + prefetched_size_;
+}
+
+size_t TableGenerationCache::prefetchedSize() const {
+  ReadLock lock(mutex_);
+  return prefetched_size_;
+}
+
+size_t TableGenerationCache::hits() const {
+  ReadLock lock(mutex_);
+  return hits_;
+}
+
+} // namespace osquery
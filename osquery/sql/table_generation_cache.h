@@ -0,0 +1,145 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/core/tables.h>
+#include <osquery/utils/mutex.h>
+
+namespace osquery {
+
+/**
+ * @brief Share generated table rows between the queries of a schedule step.
+ *
+ * Queries scheduled within the same step commonly scan the same tables, for
+ * example several packs inspecting processes or listening_ports. While a step
+ * is active the rows generated for a table are kept, and a later scan of the
+ * same table with the same constraints and used columns receives a copy
+ * instead of calling generate again.
+ *
+ * Only scans from scheduled queries, which request the warm cache, take part.
+ * Event-based tables, generator tables and tables with the NO_SHARED_CACHE
+ * attribute are never shared. The total size of the kept rows is bounded by
+ * the schedule_table_cache_size flag, a value of 0 disables the cache.
+ *
+ * Rows may also be generated ahead of the step by a Prefetch scope, they are
+ * kept for the step and shared once it starts.
+ */
+class TableGenerationCache : private boost::noncopyable {
+ public:
+  /**
+   * @brief Generate the rows of a later schedule step on the calling thread.
+   *
+   * Scans within the scope share and keep their rows for the step instead of
+   * the active one. Rows stored once the step started are not kept.
+   */
+  class Prefetch : private boost::noncopyable {
+   public:
+    explicit Prefetch(uint64_t step);
+    ~Prefetch();
+
+    /// The step rows are generated for.
+    uint64_t step() const {
+      return step_;
+    }
+
+   private:
+    uint64_t step_{0};
+
+    /// The prefetch of the thread when this scope was created.
+    Prefetch* previous_{nullptr};
+  };
+
+ public:
+  /// The process-wide cache used by the scheduler.
+  static TableGenerationCache& get();
+
+  /**
+   * @brief Begin a schedule step, rows kept for an older step are released.
+   *
+   * Rows prefetched for the step are shared by its queries.
+   */
+  void startStep(uint64_t step);
+
+  /// End the current step and release the rows kept for it.
+  void endStep();
+
+  /// Check if rows generated for a table with this context may be shared.
+  bool allowed(const VirtualTableContent& content,
+               const QueryContext& context) const;
+
+  /**
+   * @brief Copy the rows kept for a table scan.
+   *
+   * @param key the scan key, see TableGenerationCache::key.
+   * @param rows [output] a copy of the kept rows.
+   * @return true if rows were kept for the key during the current step.
+   */
+  bool lookup(const std::string& key, TableRows& rows);
+
+  /// Keep a copy of generated rows, if the size limit allows.
+  void store(const std::string& key, const TableRows& rows);
+
+  /// Build a key from the table name, sorted constraints and used columns.
+  static std::string key(const std::string& table, const QueryContext& context);
+
+  /// The estimated size in bytes of the kept rows, including prefetched rows.
+  size_t size() const;
+
+  /// The estimated size in bytes of the rows prefetched for later steps.
+  size_t prefetchedSize() const;
+
+  /// The number of lookups that returned kept rows.
+  size_t hits() const;
+
+ private:
+  /// Rows kept for a step, by scan key.
+  struct Entries {
+    std::map<std::string, TableRows> rows;
+
+    /// The estimated size in bytes of the rows.
+    size_t size{0};
+  };
+
+ private:
+  TableGenerationCache() = default;
+
+  /// The rows the calling thread shares, nullptr if none are kept for it.
+  Entries* entries();
+
+ private:
+  /// Protects every member, queries within a step may run concurrently.
+  mutable Mutex mutex_;
+
+  /// True while a schedule step is active.
+  bool active_{false};
+
+  /// The active schedule step.
+  uint64_t step_{0};
+
+  /// Rows kept for the active step.
+  Entries entries_;
+
+  /// Rows prefetched for later steps, by step.
+  std::map<uint64_t, Entries> prefetched_;
+
+  /// The estimated size in bytes of the prefetched rows.
+  size_t prefetched_size_{0};
+
+  /// The number of lookups that returned kept rows.
+  size_t hits_{0};
+};
+
+} // namespace osquery
@@ -0,0 +1,220 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+#include <vector>
+
+#include <osquery/core/flags.h>
+#include <osquery/database/database.h>
+#include <osquery/sql/table_statistics.h>
+#include <osquery/utils/json/json.h>
+
+namespace osquery {
+
+FLAG(bool,
+     table_statistics,
+     false,
+     "Plan table scans using observed row counts and latency");
+
+namespace {
+
+/// The persistent settings key holding the serialized observations.
+const std::string kTableStatisticsKey{"table_statistics"};
+
+/// The weight of a new observation within the moving averages.
+const double kTableStatisticsWeight{0.25};
+
+/// The number of distinct table and shape pairs kept.
+const size_t kMaxTableStatistics{4096};
+
+/// The scans required before a shape is considered unique.
+const uint64_t kUniqueScans{8};
+
+/// The lowest and highest costs, the maximum is reserved for unusable plans.
+const double kMinStatisticsCost{1};
+const double kMaxStatisticsCost{999999};
+
+inline std::string statisticsKey(const std::string& table,
+                                 const std::string& shape) {
+  return table + "|" + shape;
+}
+} // namespace
+
+TableStatistics& TableStatistics::get() {
+  static TableStatistics statistics;
+  return statistics;
+}
+
+bool TableStatistics::enabled() {
+  return FLAGS_table_statistics;
+}
+
+std::string TableStatistics::shape(const ConstraintSet& constraints) {
+  std::vector<std::string> terms;
+  terms.reserve(constraints.size());
+  for (const auto& constraint : constraints) {
+    terms.push_back(constraint.first + ":" +
+                    std::to_string(static_cast<int>(constraint.second.op)));
+  }
+  std::sort(terms.begin(), terms.end());
+  terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+
+  std::string shape;
+  for (const auto& term : terms) {
+    if (!shape.empty()) {
+      shape += ',';
+    }
+    shape += term;
+  }
+  return shape;
+}
+
+double TableStatistics::cost(const TableScanStatistics& stats) {
+  auto cost = kMinStatisticsCost + stats.rows + stats.latency / 100;
+  return std::min(cost, kMaxStatisticsCost);
+}
+
+bool TableStatistics::unique(const ConstraintSet& constraints,
+                             const TableScanStatistics& stats) {
+  if (constraints.empty() || stats.scans < kUniqueScans ||
+      stats.max_rows > 1) {
+    return false;
+  }
+
+  return std::all_of(
+      constraints.begin(), constraints.end(), [](const auto& constraint) {
+        return constraint.second.op == EQUALS;
+      });
+}
+
+void TableStatistics::record(const std::string& table,
+                             const std::string& shape,
+                             uint64_t rows,
+                             std::chrono::microseconds latency) {
+  auto key = statisticsKey(table, shape);
+  auto observed = static_cast<double>(latency.count());
+
+  WriteLock lock(mutex_);
+  auto it = stats_.find(key);
+  if (it == stats_.end()) {
+    if (stats_.size() >= kMaxTableStatistics) {
+      return;
+    }
+    it = stats_.emplace(std::move(key), TableScanStatistics()).first;
+  }
+
+  auto& stats = it->second;
+  if (stats.scans == 0) {
+    stats.rows = static_cast<double>(rows);
+    stats.latency = observed;
+  } else {
+    stats.rows += kTableStatisticsWeight * (rows - stats.rows);
+    stats.latency += kTableStatisticsWeight * (observed - stats.latency);
+  }
+  stats.max_rows = std::max(stats.max_rows, rows);
+  ++stats.scans;
+  dirty_ = true;
+}
+
+bool TableStatistics::estimate(const std::string& table,
+                               const std::string& shape,
+                               TableScanStatistics& stats) const {
+  ReadLock lock(mutex_);
+  auto it = stats_.find(statisticsKey(table, shape));
+  if (it == stats_.end() || it->second.scans == 0) {
+    return false;
+  }
+  stats = it->second;
+  return true;
+}
+
+Status TableStatistics::load() {
+  std::string content;
+  auto status =
+      getDatabaseValue(kPersistentSettings, kTableStatisticsKey, content);
+  if (!status.ok() || content.empty()) {
+    return status;
+  }
+
+  auto doc = JSON::newObject();
+  status = doc.fromString(content);
+  if (!status.ok() || !doc.doc().IsObject()) {
+    return Status::failure("Cannot parse persisted table statistics");
+  }
+
+  WriteLock lock(mutex_);
+  for (const auto& entry : doc.doc().GetObject()) {
+    if (!entry.value.IsObject() || stats_.size() >= kMaxTableStatistics) {
+      continue;
+    }
+
+    // Scans observed since this process started are more relevant.
+    std::string key = entry.name.GetString();
+    if (stats_.count(key) > 0) {
+      continue;
+    }
+
+    const auto& value = entry.value;
+    TableScanStatistics stats;
+    if (value.HasMember("scans") && value["scans"].IsUint64()) {
+      stats.scans = value["scans"].GetUint64();
+    }
+    if (value.HasMember("rows") && value["rows"].IsNumber()) {
+      stats.rows = value["rows"].GetDouble();
+    }
+    if (value.HasMember("max_rows") && value["max_rows"].IsUint64()) {
+      stats.max_rows = value["max_rows"].GetUint64();
+    }
+    if (value.HasMember("latency") && value["latency"].IsNumber()) {
+      stats.latency = value["latency"].GetDouble();
+    }
+    if (stats.scans > 0) {
+      stats_.emplace(std::move(key), stats);
+    }
+  }
+  return Status::success();
+}
+
+Status TableStatistics::save() {
+  auto doc = JSON::newObject();
+  {
+    WriteLock lock(mutex_);
+    if (!dirty_) {
+      return Status::success();
+    }
+
+    for (const auto& entry : stats_) {
+      auto obj = doc.getObject();
+      doc.add(
+          "scans", static_cast<unsigned long long>(entry.second.scans), obj);
+      doc.add("rows", entry.second.rows, obj);
+      doc.add("max_rows",
+              static_cast<unsigned long long>(entry.second.max_rows),
+              obj);
+      doc.add("latency", entry.second.latency, obj);
+      doc.add(entry.first, obj);
+    }
+    dirty_ = false;
+  }
+
+  std::string content;
+  auto status = doc.toString(content);
+  if (!status.ok()) {
+    return status;
+  }
+  return setDatabaseValue(kPersistentSettings, kTableStatisticsKey, content);
+}
+
+void TableStatistics::reset() {
+  WriteLock lock(mutex_);
+  stats_.clear();
+  dirty_ = false;
+}
+
+} // namespace osquery
@@ -0,0 +1,118 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/core/tables.h>
+#include <osquery/utils/mutex.h>
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/// The statistics observed for a table scanned with a constraint shape.
+struct TableScanStatistics {
+  /// The number of recorded scans.
+  uint64_t scans{0};
+
+  /// A moving average of the rows returned per scan.
+  double rows{0};
+
+  /// The most rows any recorded scan returned.
+  uint64_t max_rows{0};
+
+  /// A moving average of the generation latency in microseconds.
+  double latency{0};
+};
+
+/**
+ * @brief Observed table cardinality and latency used for query planning.
+ *
+ * SQLite asks each virtual table for the cost of a scan given a set of usable
+ * constraints. Without knowledge of a table's size every scan looks alike and
+ * SQLite may choose a poor join order, such as an expensive table as the
+ * outer loop. When table_statistics is enabled the rows returned and the time
+ * spent generating them are recorded per table and constraint shape, the
+ * constrained columns and operators but not their values. Later plans use
+ * the observations for estimatedRows and estimatedCost.
+ *
+ * Observations are persisted in the database by the scheduler so planning
+ * benefits from them after a restart.
+ */
+class TableStatistics : private boost::noncopyable {
+ public:
+  /// The process-wide statistics.
+  static TableStatistics& get();
+
+  /// Check if statistics are recorded and used for planning.
+  static bool enabled();
+
+  /// Build a shape from the constrained columns and operators.
+  static std::string shape(const ConstraintSet& constraints);
+
+  /// The planning cost of a scan, one unit per row and per 100 microseconds.
+  static double cost(const TableScanStatistics& stats);
+
+  /**
+   * @brief Check if a scan is known to return at most one row.
+   *
+   * Every constraint must be an equality and many scans must have been
+   * recorded without ever returning more than one row.
+   */
+  static bool unique(const ConstraintSet& constraints,
+                     const TableScanStatistics& stats);
+
+  /// Record a completed scan.
+  void record(const std::string& table,
+              const std::string& shape,
+              uint64_t rows,
+              std::chrono::microseconds latency);
+
+  /**
+   * @brief Retrieve the observations for a table scan.
+   *
+   * @param table the table name.
+   * @param shape the constraint shape, see TableStatistics::shape.
+   * @param stats [output] the recorded observations.
+   * @return true if enough scans were recorded to estimate from.
+   */
+  bool estimate(const std::string& table,
+                const std::string& shape,
+                TableScanStatistics& stats) const;
+
+  /// Load persisted observations, observations made since start are kept.
+  Status load();
+
+  /// Persist the observations if they changed.
+  Status save();
+
+  /// Remove every observation, used by tests.
+  void reset();
+
+ private:
+  TableStatistics() = default;
+
+ private:
+  /// Protects the observations, queries may run concurrently.
+  mutable Mutex mutex_;
+
+  /// Observations by table and shape.
+  std::map<std::string, TableScanStatistics> stats_;
+
+  /// True if observations were recorded since the last save.
+  bool dirty_{false};
+};
+
+} // namespace osquery
@@ -116,6 +116,30 @@ TEST_F(SQLTests, test_sql_escape) {
   input = "The quick brown fox jumps over the lazy dog.";
   escapeNonPrintableBytesEx(input);
   EXPECT_EQ(input, "The quick brown fox jumps over the lazy dog.");
+
+  // Bytes to escape are found at any position of the words scanned.
+  std::string printable(40, 'a');
+  for (size_t i = 0; i < printable.size(); ++i) {
+    for (auto c : {'\x01', '\x1F', '\x7F', '\x80', '\xFF'}) {
+      input = printable;
+      input[i] = c;
+      escapeNonPrintableBytesEx(input);
+
+      auto expected = printable;
+      if (c != '\x7F') {
+        char hex[5];
+        snprintf(hex, sizeof(hex), "\\x%02X", static_cast<unsigned char>(c));
+        expected.replace(i, 1, hex);
+      } else {
+        expected[i] = c;
+      }
+      EXPECT_EQ(input, expected);
+    }
+  }
+
+  input = " ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~";
+  escapeNonPrintableBytesEx(input);
+  EXPECT_EQ(input, " ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~");
 }
 
 TEST_F(SQLTests, test_sql_base64_encode) {
@@ -212,6 +236,28 @@ TEST_F(SQLTests, test_regex_match_complex) {
   EXPECT_EQ(d[0]["t3"], "");
 }
 
+TEST_F(SQLTests, test_regex_match_rows) {
+  QueryData d;
+
+  // Constant patterns are compiled once, others change between rows.
+  query(
+      "with t(s, p) as (values ('hello world', '(l)(o)'), "
+      "('foo bar', '(o)(o)'), ('foo bar', '(b)(a)')) "
+      "select regex_match(s, '(\\w+) ', 1) as c, "
+      "regex_match(s, p, 2) as v, regex_split(s, p, 0) as sp from t",
+      d);
+  ASSERT_EQ(d.size(), 3U);
+  EXPECT_EQ(d[0]["c"], "hello");
+  EXPECT_EQ(d[0]["v"], "o");
+  EXPECT_EQ(d[0]["sp"], "hel");
+  EXPECT_EQ(d[1]["c"], "foo");
+  EXPECT_EQ(d[1]["v"], "o");
+  EXPECT_EQ(d[1]["sp"], "f");
+  EXPECT_EQ(d[2]["c"], "foo");
+  EXPECT_EQ(d[2]["v"], "a");
+  EXPECT_EQ(d[2]["sp"], "foo ");
+}
+
 TEST_F(SQLTests, test_regex_match_fileextract) {
   QueryData d;
 
@@ -297,6 +343,38 @@ TEST_F(SQLTests, test_split_double_semicolon) {
   EXPECT_EQ(d[0]["t2"], "");
 }
 
+TEST_F(SQLTests, test_split_trimmed) {
+  QueryData d;
+
+  query(
+      "select split(' a , b ,, c ', ',', 0) as t0, \
+                split(' a , b ,, c ', ',', 2) as t2, \
+                split(' a , b ,, c ', ', ', 1) as t1",
+      d);
+  ASSERT_EQ(d.size(), 1U);
+  EXPECT_EQ(d[0]["t0"], "a");
+  EXPECT_EQ(d[0]["t2"], "c");
+  EXPECT_EQ(d[0]["t1"], "b");
+}
+
+TEST_F(SQLTests, test_in_cidr_block_rows) {
+  QueryData d;
+
+  query(
+      "with t(a) as (values ('10.0.1.1'), ('10.1.0.1'), ('10.0.2.1')) "
+      "select in_cidr_block('10.0.0.0/16', a) as v4 from t",
+      d);
+  ASSERT_EQ(d.size(), 3U);
+  EXPECT_EQ(d[0]["v4"], "1");
+  EXPECT_EQ(d[1]["v4"], "0");
+  EXPECT_EQ(d[2]["v4"], "1");
+
+  QueryData d2;
+  query("select in_cidr_block('::/64', '::1') as v6", d2);
+  ASSERT_EQ(d2.size(), 1U);
+  EXPECT_EQ(d2[0]["v6"], "1");
+}
+
 TEST_F(SQLTests, test_split_empty) {
   QueryData d;
 
@@ -0,0 +1,104 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <osquery/core/system.h>
+#include <osquery/registry/registry_interface.h>
+#include <osquery/sql/sql.h>
+#include <osquery/utils/conversions/tryto.h>
+
+#include <gtest/gtest.h>
+
+namespace osquery {
+class SQLiteAggregateTests : public testing::Test {
+ public:
+  void SetUp() override {
+    platformSetup();
+    registryAndPluginInit();
+  }
+};
+
+namespace {
+std::string numbers(size_t count) {
+  return "WITH RECURSIVE n(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM n "
+         "WHERE x < " +
+         std::to_string(count) + ") ";
+}
+
+double getDouble(const SQL& sql, const std::string& column) {
+  return tryTo<double>(sql.rows()[0].at(column)).takeOr(-1.0);
+}
+} // namespace
+
+TEST_F(SQLiteAggregateTests, test_approx_count_distinct) {
+  SQL sql(numbers(100) +
+          "SELECT approx_count_distinct(x % 10) AS c, "
+          "approx_count_distinct(NULL) AS n FROM n");
+  ASSERT_TRUE(sql.ok());
+  ASSERT_EQ(sql.rows().size(), 1U);
+  EXPECT_EQ(sql.rows()[0].at("c"), "10");
+  EXPECT_EQ(sql.rows()[0].at("n"), "0");
+
+  // Integral reals are the same values as integers, texts are not.
+  sql = SQL("SELECT approx_count_distinct(v) AS c FROM (SELECT 1 AS v UNION "
+            "ALL SELECT 1.0 UNION ALL SELECT '1' UNION ALL SELECT 1.5)");
+  ASSERT_TRUE(sql.ok());
+  EXPECT_EQ(sql.rows()[0].at("c"), "3");
+
+  // Many values are estimated within a few percent.
+  sql = SQL(numbers(100000) + "SELECT approx_count_distinct(x) AS c FROM n");
+  ASSERT_TRUE(sql.ok());
+  EXPECT_NEAR(getDouble(sql, "c"), 100000.0, 5000.0);
+}
+
+TEST_F(SQLiteAggregateTests, test_approx_count_distinct_group_by) {
+  SQL sql(numbers(1000) +
+          "SELECT x % 2 AS g, approx_count_distinct(x % 7) AS c FROM n "
+          "GROUP BY g ORDER BY g");
+  ASSERT_TRUE(sql.ok());
+  ASSERT_EQ(sql.rows().size(), 2U);
+  EXPECT_EQ(sql.rows()[0].at("c"), "7");
+  EXPECT_EQ(sql.rows()[1].at("c"), "7");
+}
+
+TEST_F(SQLiteAggregateTests, test_top_k) {
+  SQL sql(numbers(10) + "SELECT top_k(CASE WHEN x <= 6 THEN 'a' WHEN x <= 9 "
+                        "THEN 'b' ELSE 'c' END, 2) AS t FROM n");
+  ASSERT_TRUE(sql.ok());
+  ASSERT_EQ(sql.rows().size(), 1U);
+  EXPECT_EQ(sql.rows()[0].at("t"),
+            "[{\"value\":\"a\",\"count\":6},{\"value\":\"b\",\"count\":3}]");
+
+  sql = SQL("SELECT top_k(NULL) AS t");
+  ASSERT_TRUE(sql.ok());
+  EXPECT_EQ(sql.rows()[0].at("t"), "[]");
+}
+
+TEST_F(SQLiteAggregateTests, test_quantile) {
+  SQL sql(numbers(100) +
+          "SELECT quantile(x, 0.5) AS median, quantile(x, 0) AS min, "
+          "quantile(x, 1) AS max FROM n");
+  ASSERT_TRUE(sql.ok());
+  ASSERT_EQ(sql.rows().size(), 1U);
+  EXPECT_DOUBLE_EQ(getDouble(sql, "median"), 50.5);
+  EXPECT_DOUBLE_EQ(getDouble(sql, "min"), 1.0);
+  EXPECT_DOUBLE_EQ(getDouble(sql, "max"), 100.0);
+
+  // Many values are merged into centroids, the tails stay accurate.
+  sql = SQL(numbers(100000) +
+            "SELECT quantile(x, 0.5) AS median, quantile(x, 0.99) AS p99 "
+            "FROM n");
+  ASSERT_TRUE(sql.ok());
+  EXPECT_NEAR(getDouble(sql, "median"), 50000.0, 1000.0);
+  EXPECT_NEAR(getDouble(sql, "p99"), 99000.0, 200.0);
+
+  sql = SQL("SELECT quantile(NULL, 0.5) AS q");
+  ASSERT_TRUE(sql.ok());
+  EXPECT_EQ(sql.rows()[0].at("q"), "");
+}
+} // namespace osquery
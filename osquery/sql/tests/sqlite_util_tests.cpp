@@ -10,7 +10,9 @@
 #include <osquery/core/core.h>
 #include <osquery/core/flags.h>
 #include <osquery/core/system.h>
+#include <osquery/filesystem/filesystem.h>
 #include <osquery/registry/registry_interface.h>
+#include <osquery/sql/result_memory.h>
 #include <osquery/sql/sql.h>
 #include <osquery/sql/sqlite_util.h>
 #include <osquery/sql/tests/sql_test_utils.h>
@@ -22,6 +24,9 @@
 #include <boost/variant.hpp>
 
 namespace osquery {
+
+DECLARE_uint64(query_max_result_bytes);
+
 class SQLiteUtilTests : public testing::Test {
  public:
   void SetUp() override {
@@ -96,6 +101,46 @@ TEST_F(SQLiteUtilTests, test_sqlite_instance) {
   EXPECT_EQ(internal_db, SQLiteDBManager::get()->db());
 }
 
+TEST_F(SQLiteUtilTests, test_connection_pool) {
+  SQLiteDBManager::resetPrimary();
+
+  // Hold the primary so that further requests are contended.
+  auto primary = SQLiteDBManager::get();
+  ASSERT_TRUE(primary->isPrimary());
+
+  sqlite3* transient_db = nullptr;
+  {
+    auto transient = SQLiteDBManager::get();
+    ASSERT_FALSE(transient->isPrimary());
+    transient_db = transient->db();
+  }
+
+  // The released transient connection is reused with its tables attached.
+  auto reused = SQLiteDBManager::get();
+  EXPECT_EQ(reused->db(), transient_db);
+
+  QueryDataTyped results;
+  EXPECT_TRUE(queryInternal("select * from time", results, reused).ok());
+  EXPECT_EQ(results.size(), 1U);
+
+  // A connection with user-created views is not reused.
+  queryInternal("create view pool_view as select 1", results, reused);
+  reused.reset();
+
+  auto fresh = SQLiteDBManager::get();
+  ASSERT_FALSE(fresh->isPrimary());
+  results.clear();
+  EXPECT_FALSE(queryInternal("select * from pool_view", results, fresh).ok());
+
+  // Resetting the primary closes pooled connections.
+  fresh.reset();
+  primary.reset();
+  SQLiteDBManager::resetPrimary();
+  primary = SQLiteDBManager::get();
+  auto contended = SQLiteDBManager::get();
+  EXPECT_TRUE(queryInternal("select * from time", results, contended).ok());
+}
+
 TEST_F(SQLiteUtilTests, test_reset) {
   auto internal_db = SQLiteDBManager::get()->db();
   ASSERT_NE(nullptr, internal_db);
@@ -124,6 +169,136 @@ TEST_F(SQLiteUtilTests, test_direct_query_execution) {
   EXPECT_EQ(results, getTestDBExpectedResults());
 }
 
+TEST_F(SQLiteUtilTests, test_flat_query_execution) {
+  auto dbc = getTestDBC();
+  FlatQueryData results;
+  auto status = queryInternal(kTestQuery, results, dbc);
+  EXPECT_TRUE(status.ok());
+
+  QueryDataTyped rows;
+  results.moveToQueryData(rows);
+  EXPECT_EQ(rows, getTestDBExpectedResults());
+
+  // Statements may only be combined if they return the same columns.
+  status = queryInternal("select 1 as a; select 2 as a", results, dbc);
+  EXPECT_TRUE(status.ok());
+  EXPECT_EQ(results.rows(), 2U);
+
+  results.clear();
+  status = queryInternal("select 1 as a; select 2 as b", results, dbc);
+  EXPECT_FALSE(status.ok());
+}
+
+TEST_F(SQLiteUtilTests, test_statement_cache) {
+  auto dbc = getTestDBC();
+  QueryDataTyped results;
+  ASSERT_TRUE(queryInternal(kTestQuery, results, dbc).ok());
+  EXPECT_NE(dbc->getStatement(kTestQuery), nullptr);
+
+  // The cached statement is reset and returns the same rows again.
+  results.clear();
+  ASSERT_TRUE(queryInternal(kTestQuery, results, dbc).ok());
+  EXPECT_EQ(results, getTestDBExpectedResults());
+
+  // Virtual table constraints are restored when a cached plan is reused.
+  auto path = (boost::filesystem::temp_directory_path() /
+               "osquery-statement-cache-test")
+                  .string();
+  ASSERT_TRUE(writeTextFile(path, "test").ok());
+  auto query = "select path from file where path = '" + path + "'";
+  for (size_t i = 0; i < 2; i++) {
+    results.clear();
+    auto status = queryInternal(query, results, dbc);
+    dbc->clearAffectedTables();
+    ASSERT_TRUE(status.ok()) << status.getMessage();
+    ASSERT_EQ(results.size(), 1U);
+    EXPECT_EQ(results[0]["path"], RowDataTyped(path));
+  }
+  EXPECT_NE(dbc->getStatement(query), nullptr);
+
+  dbc->clearStatements();
+  EXPECT_EQ(dbc->getStatement(kTestQuery), nullptr);
+  removePath(path);
+}
+
+TEST_F(SQLiteUtilTests, test_result_memory_budget) {
+  auto dbc = getTestDBC();
+  auto query_max_result_bytes = FLAGS_query_max_result_bytes;
+
+  // Rows read outside of a scope are not accounted.
+  FLAGS_query_max_result_bytes = 1;
+  QueryDataTyped results;
+  ASSERT_TRUE(queryInternal(kTestQuery, results, dbc).ok());
+
+  {
+    ResultMemory::Scope scope;
+    results.clear();
+    auto status = queryInternal(kTestQuery, results, dbc);
+    EXPECT_FALSE(status.ok());
+    EXPECT_TRUE(scope.exceeded());
+    EXPECT_EQ(ResultMemory::bytes(), scope.bytes());
+  }
+  EXPECT_EQ(ResultMemory::bytes(), 0U);
+
+  // Each row holds its column names and values.
+  FLAGS_query_max_result_bytes = 0;
+  {
+    ResultMemory::Scope scope;
+    FlatQueryData flat;
+    ASSERT_TRUE(queryInternal("select 'ab' as a, 1 as b", flat, dbc).ok());
+    EXPECT_FALSE(scope.exceeded());
+    EXPECT_EQ(scope.bytes(), 4 + sizeof(long long));
+  }
+
+  FLAGS_query_max_result_bytes = query_max_result_bytes;
+}
+
+TEST_F(SQLiteUtilTests, test_query_budget) {
+  auto dbc = getTestDBC();
+
+  QueryBudget rows_budget;
+  rows_budget.rows = 1;
+  {
+    ResultMemory::Scope scope(rows_budget);
+    QueryDataTyped results;
+    auto status = queryInternal(kTestQuery, results, dbc);
+    EXPECT_FALSE(status.ok());
+    EXPECT_NE(status.getMessage().find("rows"), std::string::npos);
+    EXPECT_TRUE(scope.exceeded());
+    EXPECT_EQ(scope.rows(), 2U);
+  }
+
+  QueryBudget bytes_budget;
+  bytes_budget.result_bytes = 1;
+  {
+    ResultMemory::Scope scope(bytes_budget);
+    FlatQueryData results;
+    EXPECT_FALSE(queryInternal("select 'ab' as a", results, dbc).ok());
+    EXPECT_TRUE(scope.exceeded());
+  }
+
+  // A statement that never returns a row is stopped while it runs.
+  QueryBudget time_budget;
+  time_budget.wall_time_ms = 1;
+  {
+    ResultMemory::Scope scope(time_budget);
+    QueryDataTyped results;
+    auto status = queryInternal(
+        "with recursive c(x) as (select 1 union all select x + 1 from c) "
+        "select count(*) from c",
+        results,
+        dbc);
+    EXPECT_FALSE(status.ok());
+    EXPECT_NE(status.getMessage().find("wall time"), std::string::npos);
+    EXPECT_TRUE(scope.exceeded());
+  }
+
+  // The connection is usable, and unlimited, once the scope ends.
+  QueryDataTyped results;
+  EXPECT_TRUE(queryInternal(kTestQuery, results, dbc).ok());
+  EXPECT_EQ(results, getTestDBExpectedResults());
+}
+
 TEST_F(SQLiteUtilTests, test_aggregate_query) {
   auto dbc = getTestDBC();
   QueryDataTyped results;
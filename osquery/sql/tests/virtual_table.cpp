@@ -7,21 +7,35 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <atomic>
+#include <thread>
+
 #include <gtest/gtest.h>
 
 #include <osquery/core/core.h>
+#include <osquery/core/sql/columnar_results.h>
+#include <osquery/core/sql/table_row_pool.h>
 #include <osquery/core/system.h>
 #include <osquery/database/database.h>
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry.h>
+#include <osquery/sql/columnar_table_row.h>
 #include <osquery/sql/dynamic_table_row.h>
 #include <osquery/sql/sql.h>
+#include <osquery/sql/table_execution.h>
+#include <osquery/sql/table_generation_cache.h>
+#include <osquery/sql/table_statistics.h>
 
 #include <osquery/sql/virtual_table.h>
+#include <osquery/utils/system/uptime.h>
 
 namespace osquery {
 
 DECLARE_bool(ignore_table_exceptions);
+DECLARE_uint64(schedule_table_cache_size);
+DECLARE_bool(table_statistics);
+DECLARE_bool(schedule_table_stats);
+DECLARE_bool(table_batch_in_lists);
 
 class VirtualTableTests : public testing::Test {
  public:
@@ -53,6 +67,61 @@ TEST_F(VirtualTableTests, test_extension_tableplugin_columndefinition) {
   EXPECT_EQ("(`foo` INTEGER, `bar` TEXT)", table->columnDefinition(true));
 }
 
+class columnarRowsTablePlugin : public TablePlugin {
+ private:
+  TableColumns columns() const override {
+    return {
+        std::make_tuple("x", INTEGER_TYPE, ColumnOptions::DEFAULT),
+        std::make_tuple("y", TEXT_TYPE, ColumnOptions::DEFAULT),
+    };
+  }
+
+  TableRows generate(QueryContext&) override {
+    TableRows tr;
+    tr.push_back(make_table_row({{"x", "1"}, {"y", "a"}}));
+    tr.push_back(make_table_row({{"x", "2"}}));
+    return tr;
+  }
+};
+
+TEST_F(VirtualTableTests, test_tableplugin_columnar_rows) {
+  auto table = std::make_shared<columnarRowsTablePlugin>();
+
+  PluginResponse rows;
+  ASSERT_TRUE(table->call({{"action", "generate"}}, rows).ok());
+  ASSERT_EQ(rows.size(), 2U);
+
+  // Callers asking for columnar rows receive a single encoded value.
+  PluginResponse response;
+  PluginRequest request = {{"action", "generate"}, {kColumnarRowsKey, "1"}};
+  ASSERT_TRUE(table->call(request, response).ok());
+  ASSERT_EQ(response.size(), 1U);
+  ASSERT_EQ(response[0].count(kColumnarRowsKey), 1U);
+
+  ColumnarResults results;
+  auto& encoded = response[0].at(kColumnarRowsKey);
+  ASSERT_TRUE(ColumnarResults::decode(encoded, results).ok());
+  QueryData decoded;
+  results.toQueryData(decoded);
+  EXPECT_EQ(decoded, rows);
+}
+
+TEST_F(VirtualTableTests, test_tableplugin_used_columns_response) {
+  auto table = std::make_shared<columnarRowsTablePlugin>();
+
+  QueryContext context;
+  context.colsUsed = UsedColumns({"x"});
+  PluginRequest request = {{"action", "generate"}};
+  TablePlugin::setRequestFromContext(context, request);
+
+  // Only the used columns are returned.
+  PluginResponse response;
+  ASSERT_TRUE(table->call(request, response).ok());
+  ASSERT_EQ(response.size(), 2U);
+  EXPECT_EQ(response[0], PluginRequest({{"x", "1"}}));
+  EXPECT_EQ(response[1], PluginRequest({{"x", "2"}}));
+}
+
 class optionsTablePlugin : public TablePlugin {
  private:
   TableColumns columns() const override {
@@ -236,6 +305,74 @@ TEST_F(VirtualTableTests, test_sqlite3_attach_vtable) {
   EXPECT_EQ("CREATE VIRTUAL TABLE sample USING sample", results[0]["sql"]);
 }
 
+/// Count the column detail requests made for the lazily attached table.
+static std::atomic<size_t> kLazyColumnsCalls{0};
+
+class lazyTablePlugin : public TablePlugin {
+ private:
+  TableColumns columns() const override {
+    kLazyColumnsCalls++;
+    return {
+        std::make_tuple("x", INTEGER_TYPE, ColumnOptions::DEFAULT),
+    };
+  }
+
+  std::vector<std::string> aliases() const override {
+    return {"lazy_alias"};
+  }
+
+ public:
+  TableRows generate(QueryContext&) override {
+    TableRows tr;
+    tr.push_back(make_table_row({{"x", "1"}}));
+    return tr;
+  }
+};
+
+TEST_F(VirtualTableTests, test_sqlite3_lazy_attach) {
+  auto tables = RegistryFactory::get().registry("table");
+  tables->add("lazy", std::make_shared<lazyTablePlugin>());
+  kLazyColumnsCalls = 0;
+
+  // Tables of a new connection are created the first time they are used.
+  auto dbc = SQLiteDBManager::getUnique();
+  QueryData results;
+  auto status = queryInternal(
+      "SELECT sql FROM sqlite_temp_master WHERE tbl_name = 'lazy';",
+      results,
+      dbc);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  EXPECT_TRUE(results.empty());
+  EXPECT_EQ(kLazyColumnsCalls, 0U);
+
+  status = queryInternal("SELECT x FROM lazy;", results, dbc);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  ASSERT_EQ(results.size(), 1U);
+  EXPECT_EQ(results[0]["x"], "1");
+  EXPECT_GT(kLazyColumnsCalls, 0U);
+
+  // A table alias is resolved to the table it names.
+  results.clear();
+  status = queryInternal("SELECT x FROM lazy_alias;", results, dbc);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  ASSERT_EQ(results.size(), 1U);
+
+  // Other connections reuse the generated schema.
+  size_t calls = kLazyColumnsCalls;
+  auto other = SQLiteDBManager::getUnique();
+  results.clear();
+  status = queryInternal("SELECT x FROM lazy;", results, other);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  ASSERT_EQ(results.size(), 1U);
+  EXPECT_EQ(kLazyColumnsCalls, calls);
+
+  // Detaching removes the table from the connection.
+  detachTableInternal("lazy", other);
+  status = queryInternal("SELECT x FROM lazy;", results, other);
+  EXPECT_FALSE(status.ok());
+  tables->remove("lazy");
+}
+
 TEST_F(VirtualTableTests, test_sqlite3_table_joins) {
   // Get a database connection.
   auto dbc = SQLiteDBManager::getUnique();
@@ -630,6 +767,374 @@ TEST_F(VirtualTableTests, test_table_results_cache_colcheck) {
   EXPECT_EQ(cache->generates_, 2U);
 }
 
+class bootCacheTablePlugin : public TablePlugin {
+ public:
+  TableColumns columns() const override {
+    return {
+        std::make_tuple("i", TEXT_TYPE, ColumnOptions::INDEX),
+        std::make_tuple("d", TEXT_TYPE, ColumnOptions::DEFAULT),
+    };
+  }
+
+  TableAttributes attributes() const override {
+    return TableAttributes::BOOT_CONSTANT;
+  }
+
+  TableRows generate(QueryContext& ctx) override {
+    TableRows result;
+    if (getBootCache(ctx, result)) {
+      return result;
+    }
+
+    generates_++;
+    for (const auto& i : {"1", "2"}) {
+      if (ctx.constraints["i"].notExistsOrMatches(i)) {
+        auto r = make_table_row();
+        r["i"] = i;
+        if (ctx.isColumnUsed("d")) {
+          r["d"] = "boot";
+        }
+        result.push_back(std::move(r));
+      }
+    }
+    setBootCache(ctx, result);
+    return result;
+  }
+
+  size_t generates_{0};
+};
+
+TEST_F(VirtualTableTests, test_table_boot_cache) {
+  if (getBootIdentifier().empty()) {
+    GTEST_SKIP() << "The boot identifier is not available";
+  }
+
+  auto tables = RegistryFactory::get().registry("table");
+  auto cache = std::make_shared<bootCacheTablePlugin>();
+  tables->add("table_boot_cache", cache);
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal("table_boot_cache", dbc, false);
+
+  // The first scan generates every column, even if a column is not used.
+  QueryData results;
+  auto status = queryInternal("SELECT i FROM table_boot_cache;", results, dbc);
+  ASSERT_TRUE(status.ok());
+  EXPECT_EQ(results.size(), 2U);
+  EXPECT_EQ(cache->generates_, 1U);
+
+  // The results are used without the schedule requesting the cache.
+  results.clear();
+  queryInternal("SELECT d FROM table_boot_cache;", results, dbc);
+  ASSERT_EQ(results.size(), 2U);
+  EXPECT_EQ(results[0]["d"], "boot");
+  EXPECT_EQ(cache->generates_, 1U);
+
+  // An index constraint changes the rows generated.
+  results.clear();
+  queryInternal("SELECT * FROM table_boot_cache WHERE i = '1';", results, dbc);
+  EXPECT_EQ(results.size(), 1U);
+  EXPECT_EQ(cache->generates_, 2U);
+
+  // Another process this boot reads the results from the database.
+  auto restarted = std::make_shared<bootCacheTablePlugin>();
+  tables->remove("table_boot_cache");
+  tables->add("table_boot_cache", restarted);
+  dbc = SQLiteDBManager::getUnique();
+  attachTableInternal("table_boot_cache", dbc, false);
+
+  results.clear();
+  queryInternal("SELECT * FROM table_boot_cache;", results, dbc);
+  EXPECT_EQ(results.size(), 2U);
+  EXPECT_EQ(restarted->generates_, 0U);
+
+  tables->remove("table_boot_cache");
+}
+
+class sharedCacheTablePlugin : public TablePlugin {
+ public:
+  explicit sharedCacheTablePlugin(
+      TableAttributes attributes = TableAttributes::NONE)
+      : attributes_(attributes) {}
+
+  TableColumns columns() const override {
+    return {
+        std::make_tuple("i", TEXT_TYPE, ColumnOptions::INDEX),
+        std::make_tuple("d", TEXT_TYPE, ColumnOptions::DEFAULT),
+    };
+  }
+
+  TableAttributes attributes() const override {
+    return attributes_;
+  }
+
+  TableRows generate(QueryContext& ctx) override {
+    generates_++;
+    TableRows result;
+    for (const auto& i : {"1", "2"}) {
+      if (ctx.constraints["i"].notExistsOrMatches(i)) {
+        auto r = make_table_row();
+        r["i"] = i;
+        r["d"] = "data";
+        result.push_back(std::move(r));
+      }
+    }
+    return result;
+  }
+
+  size_t generates_{0};
+
+ private:
+  TableAttributes attributes_;
+};
+
+TEST_F(VirtualTableTests, test_table_generation_cache) {
+  auto tables = RegistryFactory::get().registry("table");
+  auto shared = std::make_shared<sharedCacheTablePlugin>();
+  tables->add("shared_cache", shared);
+  auto unshared = std::make_shared<sharedCacheTablePlugin>(
+      TableAttributes::NO_SHARED_CACHE);
+  tables->add("unshared_cache", unshared);
+
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal("shared_cache", dbc, false);
+  attachTableInternal("unshared_cache", dbc, false);
+  dbc->useCache(true);
+
+  auto& cache = TableGenerationCache::get();
+  auto size = FLAGS_schedule_table_cache_size;
+  FLAGS_schedule_table_cache_size = 1024 * 1024;
+  cache.startStep(1);
+
+  QueryData results;
+  auto status = queryInternal("SELECT * FROM shared_cache", results, dbc);
+  ASSERT_TRUE(status.ok());
+  EXPECT_EQ(results.size(), 2U);
+  EXPECT_EQ(shared->generates_, 1U);
+  EXPECT_GT(cache.size(), 0U);
+
+  // Another query in the same step receives a copy of the rows.
+  results.clear();
+  queryInternal("SELECT i, d FROM shared_cache", results, dbc);
+  EXPECT_EQ(results.size(), 2U);
+  EXPECT_EQ(shared->generates_, 1U);
+
+  // Different constraints are a different scan.
+  results.clear();
+  queryInternal("SELECT * FROM shared_cache WHERE i = '2'", results, dbc);
+  EXPECT_EQ(results.size(), 1U);
+  EXPECT_EQ(shared->generates_, 2U);
+
+  results.clear();
+  queryInternal("SELECT * FROM shared_cache WHERE i = '2'", results, dbc);
+  EXPECT_EQ(results.size(), 1U);
+  EXPECT_EQ(shared->generates_, 2U);
+
+  // Tables with side effects are never shared.
+  queryInternal("SELECT * FROM unshared_cache", results, dbc);
+  queryInternal("SELECT * FROM unshared_cache", results, dbc);
+  EXPECT_EQ(unshared->generates_, 2U);
+
+  // Rows are released at the end of a step.
+  cache.endStep();
+  EXPECT_EQ(cache.size(), 0U);
+  results.clear();
+  queryInternal("SELECT * FROM shared_cache", results, dbc);
+  EXPECT_EQ(results.size(), 2U);
+  EXPECT_EQ(shared->generates_, 3U);
+
+  // A step without room for the rows generates every time.
+  FLAGS_schedule_table_cache_size = 1;
+  cache.startStep(2);
+  queryInternal("SELECT * FROM shared_cache", results, dbc);
+  queryInternal("SELECT * FROM shared_cache", results, dbc);
+  EXPECT_EQ(shared->generates_, 5U);
+  cache.endStep();
+
+  FLAGS_schedule_table_cache_size = size;
+}
+
+TEST_F(VirtualTableTests, test_table_generation_cache_prefetch) {
+  auto tables = RegistryFactory::get().registry("table");
+  auto shared = std::make_shared<sharedCacheTablePlugin>();
+  tables->add("prefetch_cache", shared);
+
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal("prefetch_cache", dbc, false);
+  dbc->useCache(true);
+
+  auto& cache = TableGenerationCache::get();
+  auto size = FLAGS_schedule_table_cache_size;
+  FLAGS_schedule_table_cache_size = 1024 * 1024;
+  cache.startStep(10);
+  cache.endStep();
+
+  QueryData results;
+  {
+    // Rows generated for a later step are kept until it starts.
+    TableGenerationCache::Prefetch prefetch(12);
+    queryInternal("SELECT * FROM prefetch_cache", results, dbc);
+    EXPECT_EQ(shared->generates_, 1U);
+  }
+  EXPECT_GT(cache.prefetchedSize(), 0U);
+
+  // An earlier step does not share them.
+  cache.startStep(11);
+  results.clear();
+  queryInternal("SELECT * FROM prefetch_cache", results, dbc);
+  EXPECT_EQ(shared->generates_, 2U);
+  cache.endStep();
+
+  cache.startStep(12);
+  EXPECT_EQ(cache.prefetchedSize(), 0U);
+  results.clear();
+  queryInternal("SELECT * FROM prefetch_cache", results, dbc);
+  EXPECT_EQ(results.size(), 2U);
+  EXPECT_EQ(shared->generates_, 2U);
+  cache.endStep();
+
+  {
+    // The rows of a step that already started are not kept.
+    TableGenerationCache::Prefetch prefetch(12);
+    queryInternal("SELECT * FROM prefetch_cache", results, dbc);
+    EXPECT_EQ(shared->generates_, 3U);
+  }
+  EXPECT_EQ(cache.size(), 0U);
+
+  FLAGS_schedule_table_cache_size = size;
+}
+
+TEST_F(VirtualTableTests, test_table_statistics) {
+  auto tables = RegistryFactory::get().registry("table");
+  auto table = std::make_shared<sharedCacheTablePlugin>();
+  tables->add("statistics", table);
+
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal("statistics", dbc, false);
+
+  auto& statistics = TableStatistics::get();
+  statistics.reset();
+  auto enabled = FLAGS_table_statistics;
+  FLAGS_table_statistics = true;
+
+  QueryData results;
+  queryInternal("SELECT * FROM statistics", results, dbc);
+  dbc->clearAffectedTables();
+  EXPECT_EQ(results.size(), 2U);
+
+  TableScanStatistics stats;
+  ASSERT_TRUE(statistics.estimate("statistics", "", stats));
+  EXPECT_EQ(stats.scans, 1U);
+  EXPECT_EQ(stats.rows, 2);
+  EXPECT_EQ(stats.max_rows, 2U);
+
+  // Each constraint shape is recorded separately, without the values.
+  for (size_t i = 0; i < 8; i++) {
+    results.clear();
+    queryInternal("SELECT * FROM statistics WHERE i = '1'", results, dbc);
+    dbc->clearAffectedTables();
+    EXPECT_EQ(results.size(), 1U);
+  }
+
+  ConstraintSet constraints = {{"i", Constraint(EQUALS)}};
+  auto shape = TableStatistics::shape(constraints);
+  ASSERT_TRUE(statistics.estimate("statistics", shape, stats));
+  EXPECT_EQ(stats.scans, 8U);
+  EXPECT_EQ(stats.max_rows, 1U);
+  EXPECT_TRUE(TableStatistics::unique(constraints, stats));
+  EXPECT_LT(TableStatistics::cost(stats), 1000000);
+
+  // Planning with statistics returns the same rows.
+  results.clear();
+  queryInternal("SELECT * FROM statistics WHERE i = '2'", results, dbc);
+  dbc->clearAffectedTables();
+  ASSERT_EQ(results.size(), 1U);
+  EXPECT_EQ(results[0]["i"], "2");
+
+  // Observations are persisted and restored.
+  ASSERT_TRUE(statistics.save().ok());
+  statistics.reset();
+  EXPECT_FALSE(statistics.estimate("statistics", shape, stats));
+  ASSERT_TRUE(statistics.load().ok());
+  ASSERT_TRUE(statistics.estimate("statistics", shape, stats));
+  EXPECT_EQ(stats.scans, 9U);
+
+  statistics.reset();
+  FLAGS_table_statistics = enabled;
+}
+
+TEST_F(VirtualTableTests, test_table_execution) {
+  auto tables = RegistryFactory::get().registry("table");
+  auto table = std::make_shared<sharedCacheTablePlugin>();
+  tables->add("execution", table);
+
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal("execution", dbc, false);
+
+  auto& execution = TableExecution::get();
+  execution.reset();
+  auto enabled = FLAGS_schedule_table_stats;
+
+  // Nothing is recorded unless enabled.
+  QueryData results;
+  {
+    TableExecution::Scope scope("query");
+    EXPECT_FALSE(TableExecution::active());
+    queryInternal("SELECT * FROM execution", results, dbc);
+    dbc->clearAffectedTables();
+  }
+  QueryTableExecution stats;
+  EXPECT_FALSE(execution.getQuery("query", stats));
+
+  FLAGS_schedule_table_stats = true;
+  {
+    TableExecution::Scope scope("query");
+    EXPECT_TRUE(TableExecution::active());
+    results.clear();
+    queryInternal("SELECT * FROM execution", results, dbc);
+    dbc->clearAffectedTables();
+    EXPECT_EQ(results.size(), 2U);
+
+    // A scan stopped by a LIMIT generated more rows than were read.
+    results.clear();
+    queryInternal("SELECT * FROM execution LIMIT 1", results, dbc);
+    dbc->clearAffectedTables();
+    EXPECT_EQ(results.size(), 1U);
+
+    results.clear();
+    queryInternal("SELECT * FROM execution WHERE i = '1'", results, dbc);
+    dbc->clearAffectedTables();
+    EXPECT_EQ(results.size(), 1U);
+  }
+  EXPECT_FALSE(TableExecution::active());
+
+  ASSERT_TRUE(execution.getQuery("query", stats));
+  EXPECT_EQ(stats.executions, 1U);
+  ASSERT_EQ(stats.last.count("execution"), 1U);
+  const auto& last = stats.last.at("execution");
+  EXPECT_EQ(last.filters, 3U);
+  EXPECT_EQ(last.rows_generated, 5U);
+  EXPECT_EQ(last.rows_returned, 4U);
+
+  ConstraintSet constraints = {{"i", Constraint(EQUALS)}};
+  EXPECT_EQ(last.shapes.count(TableStatistics::shape(constraints)), 1U);
+
+  // The totals accumulate, the last execution is replaced.
+  {
+    TableExecution::Scope scope("query");
+    results.clear();
+    queryInternal("SELECT * FROM execution", results, dbc);
+    dbc->clearAffectedTables();
+  }
+  ASSERT_TRUE(execution.getQuery("query", stats));
+  EXPECT_EQ(stats.executions, 2U);
+  EXPECT_EQ(stats.total.at("execution").filters, 4U);
+  EXPECT_EQ(stats.last.at("execution").filters, 1U);
+  EXPECT_EQ(stats.last.at("execution").rows_returned, 2U);
+
+  execution.reset();
+  FLAGS_schedule_table_stats = enabled;
+}
+
 class yieldTablePlugin : public TablePlugin {
  private:
   TableColumns columns() const override {
@@ -675,6 +1180,94 @@ TEST_F(VirtualTableTests, test_yield_generator) {
   EXPECT_EQ(results[0]["index"], "10");
 }
 
+TEST_F(VirtualTableTests, test_yield_generator_limit) {
+  auto table = std::make_shared<yieldTablePlugin>();
+  auto table_registry = RegistryFactory::get().registry("table");
+  table_registry->add("yield_limit", table);
+
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal("yield_limit", dbc, false);
+
+  // The generator is resumed lazily, a LIMIT stops it early.
+  QueryData results;
+  queryInternal("SELECT * from yield_limit LIMIT 3", results, dbc);
+  dbc->clearAffectedTables();
+  ASSERT_EQ(results.size(), 3U);
+  EXPECT_EQ(results[2]["index"], "2");
+
+  // Generator tables called through the registry are drained into rows.
+  PluginResponse response;
+  auto status = Registry::call(
+      "table", "yield_limit", {{"action", "generate"}}, response);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  ASSERT_EQ(response.size(), 10U);
+  EXPECT_EQ(response[0]["index"], "3");
+}
+
+class columnarTablePlugin : public TablePlugin {
+ private:
+  TableColumns columns() const override {
+    return {
+        std::make_tuple("id", INTEGER_TYPE, ColumnOptions::DEFAULT),
+        std::make_tuple("ratio", DOUBLE_TYPE, ColumnOptions::DEFAULT),
+        std::make_tuple("name", TEXT_TYPE, ColumnOptions::DEFAULT),
+        std::make_tuple("size", BIGINT_TYPE, ColumnOptions::DEFAULT),
+    };
+  }
+
+ public:
+  bool usesGenerator() const override {
+    return true;
+  }
+
+  void generator(RowYield& yield, QueryContext& qc) override {
+    // The batch columns are not in the table order and size is never set.
+    auto batch = TableRowBatch::create({"name", "id", "ratio"});
+    for (long long i = 0; i < 5; i++) {
+      auto row = batch->addRow();
+      batch->set(row, 1, i);
+      batch->set(row, 2, i / 2.0);
+      batch->set(row, 0, "row" + std::to_string(i));
+    }
+
+    for (size_t row = 0; row < batch->rows(); ++row) {
+      yield(batch->row(row));
+    }
+  }
+};
+
+TEST_F(VirtualTableTests, test_columnar_table_row) {
+  auto table = std::make_shared<columnarTablePlugin>();
+  auto table_registry = RegistryFactory::get().registry("table");
+  table_registry->add("columnar", table);
+
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal("columnar", dbc, false);
+
+  QueryDataTyped results;
+  auto status = queryInternal(
+      "SELECT id, ratio, name, size FROM columnar WHERE id > 2 ORDER BY id",
+      results,
+      dbc);
+  dbc->clearAffectedTables();
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  ASSERT_EQ(results.size(), 2U);
+  EXPECT_EQ(boost::get<long long>(results[0]["id"]), 3LL);
+  EXPECT_EQ(boost::get<double>(results[0]["ratio"]), 1.5);
+  EXPECT_EQ(boost::get<std::string>(results[0]["name"]), "row3");
+  EXPECT_EQ(boost::get<std::string>(results[0]["size"]), "");
+
+  // Rows drained through the registry are converted to strings.
+  PluginResponse response;
+  status = Registry::call("table", "columnar", {{"action", "generate"}},
+                          response);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  ASSERT_EQ(response.size(), 5U);
+  EXPECT_EQ(response[4]["id"], "4");
+  EXPECT_EQ(response[4]["ratio"], "2.0");
+  EXPECT_EQ(response[4].count("size"), 0U);
+}
+
 class likeTablePlugin : public TablePlugin {
  private:
   TableColumns columns() const override {
@@ -923,6 +1516,101 @@ TEST_F(VirtualTableTests, test_indexing_costs) {
   EXPECT_EQ(10U, j->scans);
 }
 
+TEST_F(VirtualTableTests, test_in_list_constraints) {
+  auto dbc = SQLiteDBManager::getUnique();
+  auto table_registry = RegistryFactory::get().registry("table");
+
+  auto i = std::make_shared<indexIOptimizedTablePlugin>();
+  table_registry->add("index_in", i);
+  attachTableInternal("index_in", dbc, false);
+
+  auto default_scan = std::make_shared<defaultScanTablePlugin>();
+  table_registry->add("default_in_scan", default_scan);
+  attachTableInternal("default_in_scan", dbc, false);
+
+  // The values of an IN list are passed to a single scan.
+  QueryData results;
+  queryInternal(
+      "SELECT * FROM index_in WHERE i IN (1, 2, 3) ORDER BY i", results, dbc);
+  dbc->clearAffectedTables();
+  EXPECT_EQ(1U, i->scans);
+  ASSERT_EQ(3U, results.size());
+  EXPECT_EQ("1", results[0]["i"]);
+  EXPECT_EQ("30", results[2]["j"]);
+
+  i->scans = 0;
+  results.clear();
+  queryInternal(
+      "SELECT * FROM index_in WHERE i IN (SELECT i FROM default_in_scan)",
+      results,
+      dbc);
+  dbc->clearAffectedTables();
+  EXPECT_EQ(1U, i->scans);
+  EXPECT_EQ(10U, results.size());
+
+  // Otherwise each value of the list is a scan.
+  auto batch_in_lists = FLAGS_table_batch_in_lists;
+  FLAGS_table_batch_in_lists = false;
+  i->scans = 0;
+  results.clear();
+  queryInternal("SELECT * FROM index_in WHERE i IN (1, 2, 3)", results, dbc);
+  dbc->clearAffectedTables();
+  FLAGS_table_batch_in_lists = batch_in_lists;
+  EXPECT_EQ(3U, i->scans);
+  EXPECT_EQ(3U, results.size());
+}
+
+class limitTablePlugin : public TablePlugin {
+ private:
+  TableColumns columns() const override {
+    return {
+        std::make_tuple("i", INTEGER_TYPE, ColumnOptions::INDEX),
+    };
+  }
+
+ public:
+  TableRows generate(QueryContext& context) override {
+    limit = context.limit;
+
+    TableRows results;
+    for (size_t i = 0; i < 10; i++) {
+      results.push_back(make_table_row({{"i", INTEGER(i)}}));
+    }
+    return results;
+  }
+
+  boost::optional<uint64_t> limit;
+};
+
+TEST_F(VirtualTableTests, test_scan_limit) {
+  auto dbc = SQLiteDBManager::getUnique();
+  auto table_registry = RegistryFactory::get().registry("table");
+
+  auto table = std::make_shared<limitTablePlugin>();
+  table_registry->add("limited", table);
+  attachTableInternal("limited", dbc, false);
+
+  // The scan is read up to the limit and offset.
+  QueryData results;
+  queryInternal("SELECT * FROM limited LIMIT 3 OFFSET 2", results, dbc);
+  dbc->clearAffectedTables();
+  ASSERT_TRUE(table->limit.is_initialized());
+  EXPECT_EQ(5U, *table->limit);
+  ASSERT_EQ(3U, results.size());
+  EXPECT_EQ("2", results[0]["i"]);
+
+  // Rows filtered or sorted by SQLite may all be read.
+  for (const auto& query : {"SELECT * FROM limited WHERE i > 4 LIMIT 3",
+                            "SELECT * FROM limited ORDER BY i DESC LIMIT 3"}) {
+    results.clear();
+    queryInternal(query, results, dbc);
+    dbc->clearAffectedTables();
+    EXPECT_FALSE(table->limit.is_initialized()) << query;
+    ASSERT_EQ(3U, results.size()) << query;
+  }
+  EXPECT_EQ("9", results[0]["i"]);
+}
+
 class colsUsedTablePlugin : public TablePlugin {
  private:
   TableColumns columns() const override {
@@ -1226,4 +1914,33 @@ TEST_F(VirtualTableTests, test_table_exceptions) {
   FLAGS_ignore_table_exceptions = backup_flag;
 }
 
+TEST_F(VirtualTableTests, test_table_row_pool) {
+  TableRows rows;
+  {
+    TableRowPool pool(0);
+    for (size_t i = 0; i < 1000; ++i) {
+      auto r = make_table_row();
+      r["foo"] = std::to_string(i);
+      rows.push_back(std::move(r));
+    }
+
+    // Nested pools, such as a table scanned by another table's generator,
+    // do not share slabs.
+    {
+      TableRowPool inner(0);
+      auto r = make_table_row();
+      EXPECT_EQ(1U, inner.slabs());
+    }
+    EXPECT_GE(pool.slabs(), 2U);
+  }
+
+  // The rows outlive the pool and may be released by another thread.
+  Row first(*rows.front());
+  EXPECT_EQ("0", first["foo"]);
+  std::thread([&rows]() { rows.resize(rows.size() / 2); }).join();
+  auto last = rows.back()->clone();
+  rows.clear();
+  EXPECT_EQ("499", static_cast<Row>(*last)["foo"]);
+}
+
 } // namespace osquery
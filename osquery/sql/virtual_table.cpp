@@ -7,17 +7,25 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
 #include <atomic>
+#include <cmath>
 #include <unordered_set>
 
 #include <osquery/core/core.h>
 #include <osquery/core/flagalias.h>
 #include <osquery/core/flags.h>
+#include <osquery/core/sql/columnar_results.h>
+#include <osquery/core/sql/table_row_pool.h>
 #include <osquery/core/system.h>
 #include <osquery/logger/logger.h>
 #include <osquery/process/process.h>
+#include <osquery/profiler/sampling_profiler.h>
 #include <osquery/registry/registry_factory.h>
 #include <osquery/sql/dynamic_table_row.h>
+#include <osquery/sql/table_execution.h>
+#include <osquery/sql/table_generation_cache.h>
+#include <osquery/sql/table_statistics.h>
 #include <osquery/sql/virtual_table.h>
 #include <osquery/utils/conversions/tryto.h>
 
@@ -35,6 +43,16 @@ FLAG(bool,
      true,
      "Enable INDEX on all extension table columns (default true)");
 
+FLAG(bool,
+     table_batch_in_lists,
+     true,
+     "Pass every value of an IN list to a single table scan");
+
+FLAG(bool,
+     extensions_columnar_rows,
+     false,
+     "Request extension table rows as a single columnar-encoded value");
+
 /* NOTE: the default is false, because it's easier to enable it in one place
    when starting osquery, instead of having each test enable them,
    so that they are seen and fixed. */
@@ -92,6 +110,86 @@ static inline std::string opString(unsigned char op) {
   return "?";
 }
 
+/// Record the rows returned by a cursor's scan for query planning.
+static void recordScan(const BaseCursor* pCur,
+                       const std::string& table,
+                       size_t rows) {
+  if (!TableStatistics::enabled()) {
+    return;
+  }
+
+  auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - pCur->started);
+  TableStatistics::get().record(table, pCur->shape, rows, latency);
+}
+
+/// Record the scan of a cursor within the scheduled query running it.
+static void recordExecution(BaseCursor* pCur, const std::string& table) {
+  if (!pCur->tracked) {
+    return;
+  }
+
+  // SQLite read the row at the cursor unless the scan reached its end.
+  pCur->tracked = false;
+  TableExecution::recordScan(table,
+                             pCur->shape,
+                             pCur->generated,
+                             std::min(pCur->row + 1, pCur->generated),
+                             pCur->generate_time);
+}
+
+/// Add the time spent generating rows to a tracked scan.
+class GenerateTimer : private boost::noncopyable {
+ public:
+  explicit GenerateTimer(BaseCursor* pCur)
+      : cursor_(pCur->tracked ? pCur : nullptr) {
+    if (cursor_ != nullptr) {
+      start_ = std::chrono::steady_clock::now();
+    }
+  }
+
+  ~GenerateTimer() {
+    if (cursor_ != nullptr) {
+      cursor_->generate_time +=
+          std::chrono::duration_cast<std::chrono::microseconds>(
+              std::chrono::steady_clock::now() - start_);
+    }
+  }
+
+ private:
+  BaseCursor* cursor_{nullptr};
+  std::chrono::steady_clock::time_point start_;
+};
+
+/// The rows a cursor's scan is expected to return, 0 if unknown.
+static size_t expectedRows(const BaseCursor* pCur, const std::string& table) {
+  TableScanStatistics stats;
+  if (!TableStatistics::enabled() ||
+      !TableStatistics::get().estimate(table, pCur->shape, stats)) {
+    return 0;
+  }
+  return static_cast<size_t>(stats.rows);
+}
+
+/// Expand the rows of an extension that answered with one columnar value.
+static Status decodeColumnarRows(QueryData& qd) {
+  if (qd.size() != 1 || qd[0].size() != 1 ||
+      qd[0].count(kColumnarRowsKey) == 0) {
+    return Status::success();
+  }
+
+  ColumnarResults results;
+  auto status = ColumnarResults::decode(qd[0].at(kColumnarRowsKey), results);
+  if (!status.ok()) {
+    return status;
+  }
+
+  QueryData rows;
+  results.toQueryData(rows);
+  qd = std::move(rows);
+  return Status::success();
+}
+
 namespace {
 /// A list of tables that come from extensions; it is used to determine which
 /// table can be read/write
@@ -289,6 +387,197 @@ void setTableErrorMessage(sqlite3_vtab* vtable,
     memcpy(vtable->zErrMsg, error_message.c_str(), buffer_size);
   }
 }
+
+/// The schema of a table, generated from its column details.
+struct TableSchema {
+  /// The plugin that provided the schema, a re-registered table is stale.
+  std::weak_ptr<Plugin> plugin;
+
+  /// The statement declaring the virtual table to SQLite.
+  std::string statement;
+
+  /// Table columns, column aliases and attributes for VirtualTableContent.
+  TableColumns columns;
+  std::map<std::string, size_t> aliases;
+  TableAttributes attributes{TableAttributes::NONE};
+
+  /// Table name aliases.
+  std::set<std::string> views;
+};
+
+using TableSchemaRef = std::shared_ptr<const TableSchema>;
+
+/// Table schemas shared by every connection, and the tables aliases name.
+struct TableSchemaCache {
+  Mutex mutex;
+  std::unordered_map<std::string, TableSchemaRef> schemas;
+  std::unordered_map<std::string, std::string> aliases;
+};
+
+TableSchemaCache& getTableSchemaCache() {
+  static TableSchemaCache cache;
+  return cache;
+}
+
+TableSchemaRef generateTableSchema(const std::string& name,
+                                   const PluginRef& plugin) {
+  // Create a TablePlugin Registry call, expect column details as the response.
+  PluginResponse response;
+  auto status =
+      Registry::call("table", name, {{"action", "columns"}}, response);
+  if (!status.ok() || response.size() == 0) {
+    return nullptr;
+  }
+
+  auto schema = std::make_shared<TableSchema>();
+  schema->plugin = plugin;
+
+  // Tables implemented from extensions can be made read/write if they implement
+  // the correct methods
+  bool is_extension = extension_table_list.contains(name);
+
+  // Generate an SQL create table statement from the retrieved column details.
+  // This call to columnDefinition requests column aliases (as HIDDEN columns).
+  schema->statement =
+      "CREATE TABLE " + name + columnDefinition(response, true, is_extension);
+
+  // Keep a local copy of the column details, copied into each connection's
+  // VirtualTableContent. This allows introspection into the column type
+  // without additional calls.
+  for (const auto& column : response) {
+    auto cid = column.find("id");
+    if (cid == column.end()) {
+      // This does not define a column type.
+      continue;
+    }
+
+    auto cname = column.find("name");
+    auto ctype = column.find("type");
+    if (cid->second == "column" && cname != column.end() &&
+        ctype != column.end()) {
+      // This is a malformed column definition.
+      // Populate the virtual table specific persistent column information.
+      auto options = ColumnOptions::DEFAULT;
+      auto cop = column.find("op");
+      if (cop != column.end()) {
+        auto op = tryTo<long>(cop->second);
+        if (op) {
+          options = static_cast<ColumnOptions>(op.take());
+        }
+      }
+
+      if (is_extension && FLAGS_extensions_default_index) {
+        if (ColumnOptions::DEFAULT == options) {
+          options = ColumnOptions::INDEX;
+        } else {
+          // The extension is effected by extensions_default_index.
+          // Consider adding a deprecation warning (#6035).
+        }
+      }
+
+      schema->columns.push_back(std::make_tuple(
+          cname->second, columnTypeName(ctype->second), options));
+    } else if (cid->second == "alias") {
+      // Create associated views for table aliases.
+      auto calias = column.find("alias");
+      if (calias != column.end()) {
+        schema->views.insert(calias->second);
+      }
+    } else if (cid->second == "columnAlias" && cname != column.end()) {
+      auto ctarget = column.find("target");
+      if (ctarget == column.end()) {
+        continue;
+      }
+
+      // Record the column in the set of columns.
+      // This is required because SQLITE uses indexes to identify columns.
+      // Use an UNKNOWN_TYPE as a pseudo-mask, since the type does not matter.
+      schema->columns.push_back(
+          std::make_tuple(cname->second, UNKNOWN_TYPE, ColumnOptions::HIDDEN));
+      // Record a mapping of the requested column alias name.
+      size_t target_index = 0;
+      for (size_t i = 0; i < schema->columns.size(); i++) {
+        const auto& target_column = schema->columns[i];
+        if (std::get<0>(target_column) == ctarget->second) {
+          target_index = i;
+          break;
+        }
+      }
+      schema->aliases[cname->second] = target_index;
+    } else if (cid->second == "attributes") {
+      auto cattr = column.find("attributes");
+      // Store the attributes locally so they may be passed to the SQL object.
+      if (cattr != column.end()) {
+        auto attr = tryTo<long>(cattr->second);
+        if (attr) {
+          schema->attributes = static_cast<TableAttributes>(attr.take());
+        }
+      }
+    }
+  }
+
+  return schema;
+}
+
+/// Get the schema of a table, generating it on first use or once stale.
+TableSchemaRef getTableSchema(const std::string& name) {
+  auto& cache = getTableSchemaCache();
+  auto plugin = RegistryFactory::get().plugin("table", name);
+  {
+    ReadLock lock(cache.mutex);
+    auto it = cache.schemas.find(name);
+    if (it != cache.schemas.end() && it->second->plugin.lock() == plugin) {
+      return it->second;
+    }
+  }
+
+  auto schema = generateTableSchema(name, plugin);
+  if (schema != nullptr) {
+    WriteLock lock(cache.mutex);
+    cache.schemas[name] = schema;
+    for (const auto& view : schema->views) {
+      cache.aliases[view] = name;
+    }
+  }
+  return schema;
+}
+
+/// Drop the schema of a table that is attached again or detached.
+void forgetTableSchema(const std::string& name) {
+  auto& cache = getTableSchemaCache();
+  WriteLock lock(cache.mutex);
+  cache.schemas.erase(name);
+}
+
+/// Get the table names aliasing a table, without generating its schema.
+std::set<std::string> getTableAliases(const std::string& name) {
+  std::set<std::string> aliases;
+  auto table = std::dynamic_pointer_cast<TablePlugin>(
+      RegistryFactory::get().plugin("table", name));
+  if (table != nullptr) {
+    for (const auto& alias : table->aliases()) {
+      aliases.insert(alias);
+    }
+  }
+
+  auto& cache = getTableSchemaCache();
+  WriteLock lock(cache.mutex);
+  auto it = cache.schemas.find(name);
+  if (it != cache.schemas.end()) {
+    aliases.insert(it->second->views.begin(), it->second->views.end());
+  }
+  for (const auto& alias : aliases) {
+    cache.aliases[alias] = name;
+  }
+  return aliases;
+}
+
+std::string resolveTableAlias(const std::string& name) {
+  auto& cache = getTableSchemaCache();
+  ReadLock lock(cache.mutex);
+  auto it = cache.aliases.find(name);
+  return (it == cache.aliases.end()) ? name : it->second;
+}
 } // namespace
 
 inline std::string table_doc(const std::string& name) {
@@ -318,6 +607,7 @@ int xOpen(sqlite3_vtab* tab, sqlite3_vtab_cursor** ppCursor) {
 int xClose(sqlite3_vtab_cursor* cur) {
   BaseCursor* pCur = (BaseCursor*)cur;
   plan("Closing cursor (" + std::to_string(pCur->id) + ")");
+  recordExecution(pCur, ((VirtualTable*)cur->pVtab)->content->name);
   delete pCur;
   return SQLITE_OK;
 }
@@ -349,9 +639,30 @@ int xDestroy(sqlite3_vtab* p) {
 int xNext(sqlite3_vtab_cursor* cur) {
   BaseCursor* pCur = (BaseCursor*)cur;
   if (pCur->uses_generator) {
-    pCur->generator->operator()();
+    // Resume the table's generator until it yields the next row. Rows are
+    // only produced as SQLite requests them, and if SQLite stops early (e.g.
+    // LIMIT) the cursor is closed and the generator is unwound.
+    try {
+      ProfileScope profile_scope(ProfileStage::Generate);
+      GenerateTimer timer(pCur);
+      pCur->generator->operator()();
+    } catch (const std::exception& e) {
+      auto* pVtab = (VirtualTable*)cur->pVtab;
+      LOG(ERROR) << "Exception while executing table "
+                 << pVtab->content->name << ": " << e.what();
+      setTableErrorMessage(cur->pVtab, e.what());
+      if (!FLAGS_ignore_table_exceptions) {
+        throw;
+      }
+      return SQLITE_ERROR;
+    }
     if (*pCur->generator) {
       pCur->current = pCur->generator->get();
+      ++pCur->generated;
+    } else {
+      // Only scans that ran to completion are recorded.
+      auto* pVtab = (VirtualTable*)cur->pVtab;
+      recordScan(pCur, pVtab->content->name, pCur->row + 1);
     }
   }
   pCur->row++;
@@ -362,6 +673,13 @@ int xRowid(sqlite3_vtab_cursor* cur, sqlite_int64* pRowid) {
   *pRowid = 0;
 
   const BaseCursor* pCur = (BaseCursor*)cur;
+  if (pCur->uses_generator) {
+    if (pCur->current == nullptr) {
+      return SQLITE_ERROR;
+    }
+    return pCur->current->get_rowid(pCur->row, pRowid);
+  }
+
   auto data_it = std::next(pCur->rows.begin(), pCur->row);
   if (data_it >= pCur->rows.end()) {
     return SQLITE_ERROR;
@@ -560,127 +878,41 @@ int xCreate(sqlite3* db,
     return SQLITE_NOMEM;
   }
 
-  auto* pVtab = new VirtualTable;
-  pVtab->base = {};
-  pVtab->content = std::make_shared<VirtualTableContent>();
-  pVtab->instance = (SQLiteDBInstance*)pAux;
-
-  // Create a TablePlugin Registry call, expect column details as the response.
-  PluginResponse response;
-  pVtab->content->name = std::string(argv[0]);
-  const auto& name = pVtab->content->name;
-
-  // Get the table column information.
-  auto status =
-      Registry::call("table", name, {{"action", "columns"}}, response);
-  if (!status.ok() || response.size() == 0) {
-    delete pVtab;
+  // A table alias is connected as the table it names.
+  auto name = resolveTableAlias(argv[0]);
+  auto schema = getTableSchema(name);
+  if (schema == nullptr) {
     return SQLITE_ERROR;
   }
 
-  // Tables implemented from extensions can be made read/write if they implement
-  // the correct methods
-  bool is_extension = extension_table_list.contains(name);
-
-  // Generate an SQL create table statement from the retrieved column details.
-  // This call to columnDefinition requests column aliases (as HIDDEN columns).
-  auto statement =
-      "CREATE TABLE " + name + columnDefinition(response, true, is_extension);
-
-  int rc = sqlite3_declare_vtab(db, statement.c_str());
-  if (rc != SQLITE_OK || !status.ok() || response.size() == 0) {
+  int rc = sqlite3_declare_vtab(db, schema->statement.c_str());
+  if (rc != SQLITE_OK) {
     LOG(ERROR) << "Error creating virtual table: " << name << " (" << rc
                << "): " << getStringForSQLiteReturnCode(rc);
 
-    VLOG(1) << "Cannot create virtual table using: " << statement;
-    delete pVtab;
-    return (rc != SQLITE_OK) ? rc : SQLITE_ERROR;
+    VLOG(1) << "Cannot create virtual table using: " << schema->statement;
+    return rc;
   }
 
-  // Tables may request aliases as views.
-  std::set<std::string> views;
-
-  // Keep a local copy of the column details in the VirtualTableContent struct.
-  // This allows introspection into the column type without additional calls.
-  for (const auto& column : response) {
-    auto cid = column.find("id");
-    if (cid == column.end()) {
-      // This does not define a column type.
-      continue;
-    }
-
-    auto cname = column.find("name");
-    auto ctype = column.find("type");
-    if (cid->second == "column" && cname != column.end() &&
-        ctype != column.end()) {
-      // This is a malformed column definition.
-      // Populate the virtual table specific persistent column information.
-      auto options = ColumnOptions::DEFAULT;
-      auto cop = column.find("op");
-      if (cop != column.end()) {
-        auto op = tryTo<long>(cop->second);
-        if (op) {
-          options = static_cast<ColumnOptions>(op.take());
-        }
-      }
-
-      if (is_extension && FLAGS_extensions_default_index) {
-        if (ColumnOptions::DEFAULT == options) {
-          options = ColumnOptions::INDEX;
-        } else {
-          // The extension is effected by extensions_default_index.
-          // Consider adding a deprecation warning (#6035).
-        }
-      }
-
-      pVtab->content->columns.push_back(std::make_tuple(
-          cname->second, columnTypeName(ctype->second), options));
-    } else if (cid->second == "alias") {
-      // Create associated views for table aliases.
-      auto calias = column.find("alias");
-      if (calias != column.end()) {
-        views.insert(calias->second);
-      }
-    } else if (cid->second == "columnAlias" && cname != column.end()) {
-      auto ctarget = column.find("target");
-      if (ctarget == column.end()) {
-        continue;
-      }
-
-      // Record the column in the set of columns.
-      // This is required because SQLITE uses indexes to identify columns.
-      // Use an UNKNOWN_TYPE as a pseudo-mask, since the type does not matter.
-      pVtab->content->columns.push_back(
-          std::make_tuple(cname->second, UNKNOWN_TYPE, ColumnOptions::HIDDEN));
-      // Record a mapping of the requested column alias name.
-      size_t target_index = 0;
-      for (size_t i = 0; i < pVtab->content->columns.size(); i++) {
-        const auto& target_column = pVtab->content->columns[i];
-        if (std::get<0>(target_column) == ctarget->second) {
-          target_index = i;
-          break;
-        }
-      }
-      pVtab->content->aliases[cname->second] = target_index;
-    } else if (cid->second == "attributes") {
-      auto cattr = column.find("attributes");
-      // Store the attributes locally so they may be passed to the SQL object.
-      if (cattr != column.end()) {
-        auto attr = tryTo<long>(cattr->second);
-        if (attr) {
-          pVtab->content->attributes =
-              static_cast<TableAttributes>(attr.take());
-        }
-      }
+  auto* pVtab = new VirtualTable;
+  pVtab->base = {};
+  pVtab->content = std::make_shared<VirtualTableContent>();
+  pVtab->instance = (SQLiteDBInstance*)pAux;
+  pVtab->content->name = name;
+  pVtab->content->columns = schema->columns;
+  pVtab->content->aliases = schema->aliases;
+  pVtab->content->attributes = schema->attributes;
+
+  // Create the requested 'aliases' for tables created in the temp schema.
+  // Connections attaching lazily connect eponymous tables of the main schema
+  // while a statement is prepared, their aliases are modules of their own.
+  if (argc < 2 || argv[1] == nullptr || std::string(argv[1]) != "main") {
+    for (const auto& view : schema->views) {
+      auto statement = "CREATE VIEW " + view + " AS SELECT * FROM " + name;
+      sqlite3_exec(db, statement.c_str(), nullptr, nullptr, nullptr);
     }
   }
 
-  // Create the requested 'aliases'.
-  for (const auto& view : views) {
-    statement = "CREATE VIEW " + view + " AS SELECT * FROM " + name;
-    sqlite3_exec(db, statement.c_str(), nullptr, nullptr, nullptr);
-  }
-
   *ppVtab = (sqlite3_vtab*)pVtab;
   return rc;
 }
@@ -712,6 +944,132 @@ static inline bool sensibleComparison(ColumnType type, unsigned char op) {
   return true;
 }
 
+/**
+ * @brief Serialize the constraints and used columns chosen by xBestIndex.
+ *
+ * The first line is the used columns bitset, followed by one line for each
+ * constraint, "C<op> <column>", one for each used column, "U<column>", one
+ * for each constraint filtering an IN list at once, "I<constraint>", and the
+ * rows read from the scan if known, "L<rows>".
+ */
+static std::string encodePlan(const ConstraintSet& constraints,
+                              const UsedColumns& colsUsed,
+                              const UsedColumnsBitset& colsUsedBitset,
+                              const std::set<size_t>& inLists,
+                              const boost::optional<uint64_t>& limit) {
+  std::string plan = colsUsedBitset.to_string();
+  for (const auto& constraint : constraints) {
+    plan += "\nC" + std::to_string(static_cast<int>(constraint.second.op)) +
+            " " + constraint.first;
+  }
+  for (const auto& column : colsUsed) {
+    plan += "\nU" + column;
+  }
+  for (const auto& index : inLists) {
+    plan += "\nI" + std::to_string(index);
+  }
+  if (limit) {
+    plan += "\nL" + std::to_string(*limit);
+  }
+  return plan;
+}
+
+/// Restore the tracked constraints and used columns of an encoded plan.
+static void restorePlan(VirtualTableContent& content,
+                        size_t idx,
+                        const std::string& plan) {
+  auto& constraints = content.constraints[idx];
+  auto& colsUsed = content.colsUsed[idx];
+  auto& colsUsedBitset = content.colsUsedBitsets[idx];
+  auto& inLists = content.inLists[idx];
+
+  size_t start = 0;
+  while (start <= plan.size()) {
+    auto end = plan.find('\n', start);
+    if (end == std::string::npos) {
+      end = plan.size();
+    }
+    auto line = plan.substr(start, end - start);
+    start = end + 1;
+
+    if (line.empty()) {
+      continue;
+    } else if (line[0] == 'C') {
+      auto space = line.find(' ');
+      auto op = tryTo<int>(line.substr(1, space - 1));
+      if (space != std::string::npos && op.isValue()) {
+        constraints.push_back(std::make_pair(
+            line.substr(space + 1),
+            Constraint(static_cast<unsigned char>(op.get()))));
+      }
+    } else if (line[0] == 'U') {
+      colsUsed.insert(line.substr(1));
+    } else if (line[0] == 'I') {
+      auto index = tryTo<size_t>(line.substr(1));
+      if (index.isValue()) {
+        inLists.insert(index.get());
+      }
+    } else if (line[0] == 'L') {
+      auto limit = tryTo<uint64_t>(line.substr(1));
+      if (limit.isValue()) {
+        content.limits[idx] = limit.get();
+      }
+    } else if (line.size() == colsUsedBitset.size()) {
+      colsUsedBitset = UsedColumnsBitset(line);
+    }
+  }
+}
+
+static inline bool isLimitConstraint(unsigned char op) {
+  return op == SQLITE_INDEX_CONSTRAINT_LIMIT ||
+         op == SQLITE_INDEX_CONSTRAINT_OFFSET;
+}
+
+/**
+ * @brief The rows a query reads from a table scan, if SQLite knows them.
+ *
+ * SQLite passes the LIMIT and OFFSET of a query on a single table, even when
+ * it still filters or sorts the rows of the scan afterwards. The rows read
+ * are only known when the query has no other constraint and no ORDER BY.
+ */
+static boost::optional<uint64_t> scanLimit(sqlite3_index_info* pIdxInfo) {
+  if (pIdxInfo->nOrderBy > 0) {
+    return boost::none;
+  }
+
+  boost::optional<uint64_t> limit;
+  uint64_t offset = 0;
+  for (int i = 0; i < pIdxInfo->nConstraint; ++i) {
+    const auto& constraint_info = pIdxInfo->aConstraint[i];
+    if (!isLimitConstraint(constraint_info.op)) {
+      return boost::none;
+    }
+
+    // Only literal values are known when planning.
+    sqlite3_value* value = nullptr;
+    if (!constraint_info.usable ||
+        sqlite3_vtab_rhs_value(pIdxInfo, i, &value) != SQLITE_OK ||
+        sqlite3_value_type(value) != SQLITE_INTEGER) {
+      return boost::none;
+    }
+
+    auto rows = sqlite3_value_int64(value);
+    if (constraint_info.op == SQLITE_INDEX_CONSTRAINT_OFFSET) {
+      offset = rows > 0 ? static_cast<uint64_t>(rows) : 0;
+    } else if (rows >= 0) {
+      limit = static_cast<uint64_t>(rows);
+    } else {
+      // A negative LIMIT reads every row.
+      return boost::none;
+    }
+  }
+
+  if (limit) {
+    *limit += offset;
+  }
+  return limit;
+}
+
 static int xBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
   auto* pVtab = (VirtualTable*)tab;
   const auto& columns = pVtab->content->columns;
@@ -719,6 +1077,7 @@ static int xBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
   pVtab->instance->addAffectedTable(pVtab->content);
 
   ConstraintSet constraints;
+  std::set<size_t> inLists;
   // Keep track of the index used for each valid constraint.
   // Expect this index to correspond with argv within xFilter.
   size_t expr_index = 0;
@@ -744,7 +1103,8 @@ static int xBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
              " term=" + std::to_string((int)constraint_info.iTermOffset) +
              " usable=" + std::to_string((int)constraint_info.usable) + "]");
       }
-      if (!constraint_info.usable) {
+      if (!constraint_info.usable || isLimitConstraint(constraint_info.op)) {
+        // The LIMIT and OFFSET are not column constraints, see scanLimit.
         continue;
       }
 
@@ -780,12 +1140,18 @@ static int xBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
           std::make_pair(name, Constraint(constraint_info.op)));
 
       // important: if we specify an index, it means xFilter will be called
-      // once for every row.  So if you have an IN() list with 50 items,
-      // xFilter will get called 50 times, once for each item.  If you have
-      // a JOIN with 500 rows, xFilter is called 500 times.  Therefore,
-      // when a spec file specifies a column to be required or index, the
-      // table implementation must be able to quickly find and return a
-      // single row. See issue 5379.
+      // once for every row.  If you have a JOIN with 500 rows, xFilter is
+      // called 500 times.  Therefore, when a spec file specifies a column to
+      // be required or index, the table implementation must be able to
+      // quickly find and return a single row. See issue 5379.
+      //
+      // An IN() list is instead passed at once, the table is called a single
+      // time with one EQUALS constraint for each item of the list.
+      if (FLAGS_table_batch_in_lists &&
+          constraint_info.op == SQLITE_INDEX_CONSTRAINT_EQ &&
+          sqlite3_vtab_in(pIdxInfo, static_cast<int>(i), 1)) {
+        inLists.insert(constraints.size() - 1);
+      }
 
       pIdxInfo->aConstraintUsage[i].argvIndex = static_cast<int>(++expr_index);
 
@@ -833,6 +1199,18 @@ static int xBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
   // For example, you can't do a hash of a file if path not provided.
   if (hasRequiredColumns && !hasRequiredConstraints) {
     cost = kMaxIndexCost;
+  } else if (TableStatistics::enabled()) {
+    // Prefer observed cardinality and latency over the static index costs.
+    TableScanStatistics stats;
+    auto shape = TableStatistics::shape(constraints);
+    if (TableStatistics::get().estimate(pVtab->content->name, shape, stats)) {
+      cost = TableStatistics::cost(stats);
+      pIdxInfo->estimatedRows =
+          std::max<sqlite3_int64>(1, std::llround(stats.rows));
+      if (TableStatistics::unique(constraints, stats)) {
+        pIdxInfo->idxFlags |= SQLITE_INDEX_SCAN_UNIQUE;
+      }
+    }
   }
 
   pIdxInfo->idxNum = static_cast<int>(kConstraintIndexID++);
@@ -842,15 +1220,55 @@ static int xBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
          " size=" + std::to_string(constraints.size()) +
          " idx=" + std::to_string(pIdxInfo->idxNum) + "]");
   }
+  // The plan is also kept by SQLite with the prepared statement. A cached
+  // statement reuses it after the tracked constraints below were cleared.
+  auto limit = scanLimit(pIdxInfo);
+  auto plan =
+      encodePlan(constraints, colsUsed, colsUsedBitset, inLists, limit);
+  pIdxInfo->idxStr = sqlite3_mprintf("%s", plan.c_str());
+  pIdxInfo->needToFreeIdxStr = 1;
+
   // Add the constraint set to the table's tracked constraints.
   pVtab->content->constraints[pIdxInfo->idxNum] = std::move(constraints);
   pVtab->content->colsUsed[pIdxInfo->idxNum] = std::move(colsUsed);
   pVtab->content->colsUsedBitsets[pIdxInfo->idxNum] = colsUsedBitset;
+  pVtab->content->inLists[pIdxInfo->idxNum] = std::move(inLists);
+  if (limit) {
+    pVtab->content->limits[pIdxInfo->idxNum] = *limit;
+  }
   pIdxInfo->estimatedCost = cost;
 
   return SQLITE_OK;
 }
 
+/// Add one EQUALS constraint for each value of an IN list argument.
+static void addInListConstraints(const BaseCursor* pCur,
+                                 sqlite3_value* list,
+                                 const std::pair<std::string, Constraint>& in,
+                                 QueryContext& context) {
+  sqlite3_value* value = nullptr;
+  auto rc = sqlite3_vtab_in_first(list, &value);
+  for (; rc == SQLITE_OK && value != nullptr;
+       rc = sqlite3_vtab_in_next(list, &value)) {
+    auto expr = (const char*)sqlite3_value_text(value);
+    if (expr == nullptr || expr[0] == 0) {
+      continue;
+    }
+
+    if (FLAGS_planner) {
+      plan("xFilter Adding IN list constraint to cursor (" +
+           std::to_string(pCur->id) + "): " + in.first + " " +
+           opString(in.second.op) + " " + expr);
+    }
+    context.constraints[in.first].add(Constraint(in.second.op, expr));
+  }
+
+  if (rc != SQLITE_OK && rc != SQLITE_DONE) {
+    VLOG(1) << "Cannot read the IN list of " << in.first << ": "
+            << sqlite3_errstr(rc);
+  }
+}
+
 static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
                    int idxNum,
                    const char* idxStr,
@@ -865,8 +1283,16 @@ static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
   }
   pVtab->instance->addAffectedTable(content);
 
+  // A cursor is filtered again for each scan, such as the inner loop of a join.
+  recordExecution(pCur, content->name);
   pCur->row = 0;
   pCur->n = 0;
+
+  if (idxStr != nullptr && content->constraints.count(idxNum) == 0) {
+    // This plan was made for an earlier execution of a cached statement.
+    restorePlan(*content, idxNum, idxStr);
+  }
+
   QueryContext context(content);
 
   // The SQLite instance communicates to the TablePlugin via the context.
@@ -915,8 +1341,14 @@ static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
   // Iterate over every argument to xFilter, filling in constraint values.
   if (content->constraints.size() > 0) {
     auto& constraints = content->constraints[idxNum];
+    const auto& inLists = content->inLists[idxNum];
     if (argc > 0) {
       for (size_t i = 0; i < static_cast<size_t>(argc); ++i) {
+        if (inLists.count(i) > 0 && i < constraints.size()) {
+          addInListConstraints(pCur, argv[i], constraints[i], context);
+          continue;
+        }
+
         auto expr = (const char*)sqlite3_value_text(argv[i]);
         if (expr == nullptr || expr[0] == 0) {
           // SQLite did not expose the expression value.
@@ -963,6 +1395,15 @@ static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
     context.colsUsed = content->colsUsed[idxNum];
   }
 
+  auto limit = content->limits.find(idxNum);
+  if (limit != content->limits.end()) {
+    context.limit = limit->second;
+    if (FLAGS_planner) {
+      plan("xFilter Limiting cursor (" + std::to_string(pCur->id) +
+           ") to rows: " + std::to_string(limit->second));
+    }
+  }
+
   // Reset the virtual table contents.
   pCur->rows.clear();
   options.clear();
@@ -993,12 +1434,27 @@ static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
     }
   }
 
-  // Generate the row data set.
+  pCur->tracked = TableExecution::active();
+  pCur->generated = 0;
+  pCur->generate_time = std::chrono::microseconds(0);
+  if (TableStatistics::enabled() || pCur->tracked) {
+    auto it = content->constraints.find(idxNum);
+    pCur->shape = (it == content->constraints.end())
+                      ? std::string()
+                      : TableStatistics::shape(it->second);
+    pCur->started = std::chrono::steady_clock::now();
+  }
+
+  // Generate the row data set, the rows created by this thread are carved from
+  // slabs sized for the rows the scan is expected to return.
   plan("Scanning rows for cursor (" + std::to_string(pCur->id) + ")");
+  TableRowPool pool(expectedRows(pCur, pVtab->content->name));
+  GenerateTimer timer(pCur);
   if (Registry::get().exists("table", pVtab->content->name, true)) {
     auto plugin = Registry::get().plugin("table", pVtab->content->name);
     auto table = std::dynamic_pointer_cast<TablePlugin>(plugin);
     try {
+      ProfileScope profile_scope(ProfileStage::Generate);
       if (table->usesGenerator()) {
         pCur->uses_generator = true;
         pCur->generator = std::make_unique<RowGenerator::pull_type>(
@@ -1008,10 +1464,26 @@ static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
                       std::move(context)));
         if (*pCur->generator) {
           pCur->current = pCur->generator->get();
+          pCur->generated = 1;
+        } else {
+          recordScan(pCur, pVtab->content->name, 0);
         }
         return SQLITE_OK;
       }
-      pCur->rows = table->generate(context);
+
+      // Queries within a schedule step may share the generated rows.
+      auto& shared = TableGenerationCache::get();
+      if (shared.allowed(*content, context)) {
+        auto key = TableGenerationCache::key(pVtab->content->name, context);
+        if (!shared.lookup(key, pCur->rows)) {
+          pCur->rows = table->generate(context);
+          shared.store(key, pCur->rows);
+          recordScan(pCur, pVtab->content->name, pCur->rows.size());
+        }
+      } else {
+        pCur->rows = table->generate(context);
+        recordScan(pCur, pVtab->content->name, pCur->rows.size());
+      }
     } catch (const std::exception& e) {
       LOG(ERROR) << "Exception while executing table " << pVtab->content->name
                  << ": " << e.what();
@@ -1024,8 +1496,15 @@ static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
   } else {
     PluginRequest request = {{"action", "generate"}};
     TablePlugin::setRequestFromContext(context, request);
+    if (FLAGS_extensions_columnar_rows) {
+      request[kColumnarRowsKey] = "1";
+    }
+
     QueryData qd;
     auto status = Registry::call("table", pVtab->content->name, request, qd);
+    if (status.ok()) {
+      status = decodeColumnarRows(qd);
+    }
     if (!status.ok()) {
       VLOG(1) << "Invalid response from the extension table. Error "
               << status.getCode() << ": " << status.getMessage();
@@ -1033,10 +1512,12 @@ static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
       return SQLITE_ERROR;
     }
     pCur->rows = tableRowsFromQueryData(std::move(qd));
+    recordScan(pCur, pVtab->content->name, pCur->rows.size());
   }
 
   // Set the number of rows.
   pCur->n = pCur->rows.size();
+  pCur->generated = pCur->n;
 
   if (FLAGS_planner) {
     plan("xFilter " + pVtab->content->name +
@@ -1099,6 +1580,9 @@ Status attachTableInternal(const std::string& name,
     return Status(1);
   }
 
+  // An explicit attach may follow a table registration, with a new schema.
+  tables::sqlite::forgetTableSchema(name);
+
   // Note, if the clientData API is used then this will save a registry call
   // within xCreate.
   auto lock(instance->attachLock());
@@ -1119,6 +1603,8 @@ Status attachTableInternal(const std::string& name,
     LOG(ERROR) << "Error attaching table: " << name << " (" << rc << ")";
   }
 
+  // Statements prepared before the table existed are planned without it.
+  instance->clearStatements();
   return Status(rc, getStringForSQLiteReturnCode(rc));
 }
 
@@ -1131,6 +1617,10 @@ Status detachTableInternal(const std::string& name,
     LOG(ERROR) << "Error detaching table: " << name << " (" << rc << ")";
   }
 
+  // Drop the module too, it would otherwise remain as an eponymous table.
+  instance->clearStatements();
+  sqlite3_create_module(instance->db(), name.c_str(), nullptr, nullptr);
+  tables::sqlite::forgetTableSchema(name);
   return Status(rc, getStringForSQLiteReturnCode(rc));
 }
 
@@ -1162,15 +1652,36 @@ void attachVirtualTables(const SQLiteDBInstanceRef& instance) {
 #endif
   }
 
-  PluginResponse response;
-  bool is_extension = false;
+  // Tables are only created as modules. SQLite connects a module as an
+  // eponymous virtual table the first time a statement references it, using
+  // the schema shared by all connections.
+  auto& registry = RegistryFactory::get();
+  auto lock(instance->attachLock());
+  for (const auto& name : registry.names("table")) {
+    if (SQLiteDBManager::isDisabled(name)) {
+      continue;
+    }
 
-  for (const auto& name : RegistryFactory::get().names("table")) {
-    auto status =
-        Registry::call("table", name, {{"action", "columns"}}, response);
-    if (status.ok()) {
-      attachTableInternal(name, instance, is_extension);
+    std::vector<std::string> names = {name};
+    for (const auto& alias : tables::sqlite::getTableAliases(name)) {
+      if (!registry.exists("table", alias)) {
+        names.push_back(alias);
+      }
+    }
+
+    bool is_extension = tables::sqlite::extension_table_list.contains(name);
+    for (const auto& module_name : names) {
+      int rc = sqlite3_create_module(
+          instance->db(),
+          module_name.c_str(),
+          tables::sqlite::getVirtualTableModule(module_name, is_extension),
+          (void*)&(*instance));
+      if (rc != SQLITE_OK && rc != SQLITE_MISUSE) {
+        LOG(ERROR) << "Error attaching table: " << module_name << " (" << rc
+                   << ")";
+      }
     }
   }
+  instance->clearStatements();
 }
 } // namespace osquery
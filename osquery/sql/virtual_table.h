@@ -9,7 +9,9 @@
 
 #pragma once
 
+#include <chrono>
 #include <memory>
+#include <string>
 
 #include <boost/noncopyable.hpp>
 
@@ -58,6 +60,22 @@ struct BaseCursor : private boost::noncopyable {
 
   /// Total number of rows.
   size_t n{0};
+
+  /// The constraint shape of the scan, if table statistics are enabled or
+  /// the scan is tracked.
+  std::string shape;
+
+  /// When the scan started, if table statistics are enabled.
+  std::chrono::steady_clock::time_point started;
+
+  /// Check if the scan is recorded within a TableExecution::Scope.
+  bool tracked{false};
+
+  /// The rows generated by a tracked scan.
+  size_t generated{0};
+
+  /// The time spent generating the rows of a tracked scan.
+  std::chrono::microseconds generate_time{0};
 };
 
 /**
@@ -0,0 +1,162 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <grp.h>
+#include <pwd.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <memory>
+
+#include <osquery/system/usersgroups/posix/names_cache.h>
+
+namespace osquery {
+
+namespace {
+
+/// How often the source database is checked for changes.
+const std::chrono::seconds kNamesCheckInterval{1};
+
+/// How long names are kept when the source database does not change.
+const std::chrono::seconds kNamesMaxAge{300};
+
+/// The cache is cleared if the IDs resolved grow beyond this count.
+const size_t kNamesMaxEntries = 65536;
+
+std::string fingerprintSource(const std::string& source) {
+  struct stat st;
+  if (::stat(source.c_str(), &st) != 0) {
+    return "";
+  }
+
+#ifdef __APPLE__
+  const auto& mtime = st.st_mtimespec;
+#else
+  const auto& mtime = st.st_mtim;
+#endif
+  return std::to_string(st.st_ino) + ":" + std::to_string(st.st_size) + ":" +
+         std::to_string(mtime.tv_sec) + "." + std::to_string(mtime.tv_nsec);
+}
+
+size_t getBufferSize(int name) {
+  auto bufsize = sysconf(name);
+  if (bufsize <= 0 || bufsize > 16384) { /* Value was indeterminate */
+    bufsize = 16384; /* Should be more than enough */
+  }
+  return static_cast<size_t>(bufsize);
+}
+
+bool resolveUsername(std::uint32_t uid, std::string& name) {
+  struct passwd pwd;
+  struct passwd* pwd_result{nullptr};
+  auto bufsize = getBufferSize(_SC_GETPW_R_SIZE_MAX);
+  auto buf = std::make_unique<char[]>(bufsize);
+
+  getpwuid_r(uid, &pwd, buf.get(), bufsize, &pwd_result);
+  if (pwd_result == nullptr || pwd_result->pw_name == nullptr) {
+    return false;
+  }
+  name = pwd_result->pw_name;
+  return true;
+}
+
+bool resolveGroupname(std::uint32_t gid, std::string& name) {
+  struct group grp;
+  struct group* grp_result{nullptr};
+  auto bufsize = getBufferSize(_SC_GETGR_R_SIZE_MAX);
+  auto buf = std::make_unique<char[]>(bufsize);
+
+  getgrgid_r(gid, &grp, buf.get(), bufsize, &grp_result);
+  if (grp_result == nullptr || grp_result->gr_name == nullptr) {
+    return false;
+  }
+  name = grp_result->gr_name;
+  return true;
+}
+
+NamesCache& getUsernames() {
+  static NamesCache cache("/etc/passwd", resolveUsername);
+  return cache;
+}
+
+NamesCache& getGroupnames() {
+  static NamesCache cache("/etc/group", resolveGroupname);
+  return cache;
+}
+} // namespace
+
+NamesCache::NamesCache(std::string source, Resolver resolver)
+    : source_(std::move(source)), resolver_(std::move(resolver)) {}
+
+bool NamesCache::get(std::uint32_t id, std::string& name) {
+  auto now = Clock::now();
+  {
+    ReadLock lock(mutex_);
+    if (now < next_check_) {
+      auto it = names_.find(id);
+      if (it != names_.end()) {
+        name = it->second;
+        return !name.empty();
+      }
+    }
+  }
+
+  WriteLock lock(mutex_);
+  if (now >= next_check_) {
+    validate(now);
+  }
+
+  auto it = names_.find(id);
+  if (it == names_.end()) {
+    if (names_.size() >= kNamesMaxEntries) {
+      names_.clear();
+    }
+
+    std::string resolved;
+    if (!resolver_(id, resolved)) {
+      resolved.clear();
+    }
+    it = names_.emplace(id, std::move(resolved)).first;
+  }
+
+  name = it->second;
+  return !name.empty();
+}
+
+void NamesCache::clear() {
+  WriteLock lock(mutex_);
+  names_.clear();
+  fingerprint_.clear();
+  next_check_ = Clock::time_point();
+}
+
+void NamesCache::validate(Clock::time_point now) {
+  auto fingerprint = fingerprintSource(source_);
+  if (fingerprint != fingerprint_ || now >= expires_) {
+    names_.clear();
+    fingerprint_ = std::move(fingerprint);
+    expires_ = now + kNamesMaxAge;
+  }
+  next_check_ = now + kNamesCheckInterval;
+}
+
+bool getCachedUsername(uid_t uid, std::string& name) {
+  return getUsernames().get(uid, name);
+}
+
+bool getCachedGroupname(gid_t gid, std::string& name) {
+  return getGroupnames().get(gid, name);
+}
+
+void clearCachedNames() {
+  getUsernames().clear();
+  getGroupnames().clear();
+}
+
+} // namespace osquery
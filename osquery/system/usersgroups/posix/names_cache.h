@@ -0,0 +1,82 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <sys/types.h>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+#include <osquery/utils/mutex.h>
+
+namespace osquery {
+
+/**
+ * @brief Process-wide uid or gid to name resolution.
+ *
+ * Tables resolving the owner of many files or IPC objects call NSS once per
+ * row. The cache resolves each ID once and keeps the name, or its absence,
+ * until the source database changes. The source's inode, size and mtime are
+ * checked at most once per second; names are also dropped after a few
+ * minutes, NSS may resolve IDs from sources other than the file.
+ */
+class NamesCache {
+ public:
+  /// Resolve one ID using NSS, false if the ID has no name.
+  using Resolver = std::function<bool(std::uint32_t, std::string&)>;
+
+  NamesCache(std::string source, Resolver resolver);
+
+  /// Get the name of an ID, false if the ID has no name.
+  bool get(std::uint32_t id, std::string& name);
+
+  /// Drop every cached name.
+  void clear();
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  /// Drop the names if the source changed, the caller holds the write lock.
+  void validate(Clock::time_point now);
+
+ private:
+  mutable Mutex mutex_;
+
+  /// The database file, such as /etc/passwd.
+  const std::string source_;
+
+  const Resolver resolver_;
+
+  /// Names by ID, an empty name is an ID without a name.
+  std::unordered_map<std::uint32_t, std::string> names_;
+
+  /// The inode, size and mtime of the source when the names were cached.
+  std::string fingerprint_;
+
+  /// When the source is checked again.
+  Clock::time_point next_check_;
+
+  /// When the names are dropped regardless of the source.
+  Clock::time_point expires_;
+};
+
+/// The cached name of a uid, false if the uid has no user.
+bool getCachedUsername(uid_t uid, std::string& name);
+
+/// The cached name of a gid, false if the gid has no group.
+bool getCachedGroupname(gid_t gid, std::string& name);
+
+/// Drop the cached user and group names.
+void clearCachedNames();
+
+} // namespace osquery
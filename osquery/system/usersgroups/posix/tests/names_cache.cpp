@@ -0,0 +1,58 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <osquery/system/usersgroups/posix/names_cache.h>
+
+#include <gtest/gtest.h>
+
+namespace osquery {
+
+class NamesCacheTests : public testing::Test {};
+
+TEST_F(NamesCacheTests, test_resolves_once) {
+  size_t calls = 0;
+  auto resolver = [&calls](std::uint32_t id, std::string& name) {
+    calls++;
+    if (id != 1000) {
+      return false;
+    }
+    name = "test1";
+    return true;
+  };
+  NamesCache cache("/etc/passwd", resolver);
+
+  std::string name;
+  EXPECT_TRUE(cache.get(1000, name));
+  EXPECT_EQ(name, "test1");
+  EXPECT_TRUE(cache.get(1000, name));
+  EXPECT_EQ(name, "test1");
+
+  // IDs without a name are cached too.
+  EXPECT_FALSE(cache.get(1001, name));
+  EXPECT_FALSE(cache.get(1001, name));
+  EXPECT_EQ(calls, 2U);
+
+  cache.clear();
+  EXPECT_TRUE(cache.get(1000, name));
+  EXPECT_EQ(calls, 3U);
+}
+
+TEST_F(NamesCacheTests, test_root_names) {
+  clearCachedNames();
+
+  std::string name;
+  ASSERT_TRUE(getCachedUsername(0, name));
+  EXPECT_EQ(name, "root");
+
+  // The root group is "wheel" on some systems.
+  EXPECT_TRUE(getCachedGroupname(0, name));
+  EXPECT_FALSE(name.empty());
+}
+
+} // namespace osquery
@@ -14,6 +14,7 @@
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
+#include <osquery/tables/applications/parsed_file_cache.h>
 #include <osquery/tables/system/system_utils.h>
 #include <osquery/utils/conversions/split.h>
 #include <osquery/utils/conversions/tryto.h>
@@ -37,6 +38,9 @@ namespace {
 
 #define kFirefoxExtensionsFile "/extensions.json"
 
+/// Extensions files kept parsed, one for each profile.
+const size_t kMaxCachedExtensionFiles = 1024;
+
 /// Not parsed, but may be helpful later.
 #define kFirefoxAddonsFile "/addons.json"
 #define kFirefoxWebappsFile "/webapps/webapps.json"
@@ -86,54 +90,40 @@ std::optional<rapidjson::Value::ConstMemberIterator> findNestedMember(
 
   return member_it;
 }
-} // namespace
 
-void genFirefoxAddonsFromExtensions(const std::string& uid,
-                                    const std::string& path,
-                                    QueryData& results) {
+/// Parse the addons of an extensions file, the rows have no uid
+Status parseFirefoxAddons(const std::string& extensions_path,
+                          const std::string& content,
+                          QueryData& addon_rows) {
   JSON extensions;
-  Status status;
-  std::string extensions_path = path + kFirefoxExtensionsFile;
-  {
-    std::string content;
-
-    status = readFile(extensions_path, content);
-    if (!status.ok()) {
-      TLOG << "Failed to read the extensions file at: " << extensions_path
-           << ", error: " << status.getMessage();
-      return;
-    }
-
-    status = extensions.fromString(content);
+  auto status = extensions.fromString(content);
 
-    if (!status.ok()) {
-      TLOG << "Failed to parse to JSON the extensions file at: "
-           << extensions_path << ", error: " << status.getMessage();
-      return;
-    }
+  if (!status.ok()) {
+    return Status::failure("Failed to parse to JSON the extensions file at: " +
+                           extensions_path + ", error: " + status.getMessage());
   }
 
   if (!extensions.doc().IsObject()) {
-    TLOG << "Failed to parse the JSON extensions file at: " << extensions_path
-         << ", the document root is not an object";
-    return;
+    return Status::failure("Failed to parse the JSON extensions file at: " +
+                           extensions_path +
+                           ", the document root is not an object");
   }
 
   const auto addons_it = extensions.doc().FindMember("addons");
 
   if (addons_it == extensions.doc().MemberEnd()) {
-    TLOG << "Failed to parse the JSON extensions file at: " << extensions_path
-         << ", could not find the 'addons' JSON member";
-    return;
+    return Status::failure("Failed to parse the JSON extensions file at: " +
+                           extensions_path +
+                           ", could not find the 'addons' JSON member");
   }
 
   const auto& addons = addons_it->value;
 
   if (!addons.IsArray()) {
-    TLOG << "Unrecognized format for the 'addons' member in the extensions "
-            "file at: "
-         << extensions_path << ", it's not an array";
-    return;
+    return Status::failure(
+        "Unrecognized format for the 'addons' member in the extensions "
+        "file at: " +
+        extensions_path + ", it's not an array");
   }
 
   for (const auto& addon : addons.GetArray()) {
@@ -142,7 +132,6 @@ void genFirefoxAddonsFromExtensions(const std::string& uid,
     }
 
     Row r;
-    r["uid"] = uid;
     // Most of the keys are in the top-level JSON dictionary.
     for (const auto& it : kFirefoxAddonKeys) {
       const auto opt_member_it = findNestedMember(it.first, addon);
@@ -172,7 +161,42 @@ void genFirefoxAddonsFromExtensions(const std::string& uid,
     } else {
       r["disabled"] = INTEGER(0);
     }
-    results.push_back(r);
+    addon_rows.push_back(std::move(r));
+  }
+
+  return Status::success();
+}
+
+/// Addons of the extensions files, unchanged files are parsed once.
+ParsedFileCache<QueryData>& getFirefoxAddonsCache() {
+  static ParsedFileCache<QueryData> cache(kMaxCachedExtensionFiles);
+  return cache;
+}
+} // namespace
+
+void genFirefoxAddonsFromExtensions(const std::string& uid,
+                                    const std::string& path,
+                                    QueryData& results) {
+  std::string extensions_path = path + kFirefoxExtensionsFile;
+
+  ParsedFileCache<QueryData>::Value addon_rows;
+  auto status = getFirefoxAddonsCache().get(
+      extensions_path,
+      [&extensions_path](const std::string& content, QueryData& rows) {
+        return parseFirefoxAddons(extensions_path, content, rows);
+      },
+      addon_rows);
+
+  if (!status.ok()) {
+    TLOG << "Failed to load the extensions file at: " << extensions_path
+         << ", error: " << status.getMessage();
+    return;
+  }
+
+  for (const auto& addon_row : *addon_rows) {
+    Row r = addon_row;
+    r["uid"] = uid;
+    results.push_back(std::move(r));
   }
 }
 
@@ -14,6 +14,7 @@
 #include <osquery/hashing/hashing.h>
 #include <osquery/logger/logger.h>
 #include <osquery/tables/applications/chrome/utils.h>
+#include <osquery/tables/applications/parsed_file_cache.h>
 #include <osquery/tables/system/system_utils.h>
 #include <osquery/utils/base64.h>
 #include <osquery/utils/conversions/tryto.h>
@@ -168,6 +169,9 @@ const ExtensionPropertyMap kExtensionPropertyList = {
 const std::vector<std::string> kExtensionProfileSettingsList = {
     "from_webstore", "state", "install_time"};
 
+/// Parsed files kept for each cache, see ParsedFileCache
+const size_t kMaxCachedFiles = 4096;
+
 /// A single profile and browser type
 struct ChromeProfilePath final {
   ChromeBrowserType type{ChromeBrowserType::GoogleChrome};
@@ -207,6 +211,18 @@ bool parseJsonString(pt::iptree& tree, const std::string& json) {
   }
 }
 
+/// Extensions parsed from their manifest files, before localization
+ParsedFileCache<ChromeProfile::Extension>& getManifestCache() {
+  static ParsedFileCache<ChromeProfile::Extension> cache(kMaxCachedFiles);
+  return cache;
+}
+
+/// Parsed preferences and localization files
+ParsedFileCache<pt::iptree>& getJsonFileCache() {
+  static ParsedFileCache<pt::iptree> cache(kMaxCachedFiles);
+  return cache;
+}
+
 /// A user id/user home path pair
 struct UserInformation final {
   std::int64_t uid{};
@@ -324,20 +340,15 @@ ChromeProfilePathList getChromeProfilePathList(const QueryContext& context) {
 
 /// Retrieves the list of referenced extensions from the
 /// given profile preferences
-bool getExtensionPathListFromPreferences(std::vector<std::string>& path_list,
+void getExtensionPathListFromPreferences(std::vector<std::string>& path_list,
                                          const std::string& profile_path,
-                                         const std::string& preferences) {
+                                         const pt::iptree& tree) {
   path_list = {};
 
-  pt::iptree tree;
-  if (!parseJsonString(tree, preferences)) {
-    return false;
-  }
-
   const auto& opt_extensions_node = tree.get_child_optional("extensions");
 
   if (!opt_extensions_node) {
-    return true;
+    return;
   }
 
   const auto& extensions_node = opt_extensions_node.get();
@@ -348,7 +359,7 @@ bool getExtensionPathListFromPreferences(std::vector<std::string>& path_list,
   }
 
   if (!opt_settings_node) {
-    return true;
+    return;
   }
 
   const auto& settings_node = opt_settings_node.get();
@@ -376,8 +387,6 @@ bool getExtensionPathListFromPreferences(std::vector<std::string>& path_list,
     canonical_path.make_preferred();
     path_list.push_back(canonical_path.string());
   }
-
-  return true;
 }
 
 /// Captures a Chrome profile from the given path
@@ -389,32 +398,37 @@ bool captureProfileSnapshotSettingsFromPath(
   snapshot.path = profile_path.value;
   snapshot.uid = profile_path.uid;
 
-  // Save the contents of the configuration files
+  // Parse the configuration files, unchanged files are parsed once
   auto preferences_file_path =
       fs::path(profile_path.value) / kProfilePreferencesFile;
 
   auto secure_prefs_file_path =
       fs::path(profile_path.value) / kSecureProfilePreferencesFile;
 
-  auto status =
-      readFile(preferences_file_path.string(), snapshot.preferences, 0);
+  auto parse = [&profile_path](const std::string& content, pt::iptree& tree) {
+    if (!parseJsonString(tree, content)) {
+      LOG(ERROR) << "Failed to parse the following profile: "
+                 << profile_path.value;
 
-  if (!status.ok()) {
-    return false;
-  }
+      return Status::failure("Failed to parse the profile preferences");
+    }
+
+    return Status::success();
+  };
 
-  status =
-      readFile(secure_prefs_file_path.string(), snapshot.secure_preferences, 0);
+  auto& cache = getJsonFileCache();
+  auto status = cache.get(
+      preferences_file_path.string(), parse, snapshot.parsed_preferences);
 
   if (!status.ok()) {
     return false;
   }
 
-  if (snapshot.preferences.empty() && snapshot.secure_preferences.empty()) {
-    LOG(ERROR) << "Failed to read the Preferences file for the following "
-                  "profile snapshot " +
-                      preferences_file_path.string();
+  status = cache.get(secure_prefs_file_path.string(),
+                     parse,
+                     snapshot.parsed_secure_preferences);
 
+  if (!status.ok()) {
     return false;
   }
 
@@ -451,6 +465,65 @@ bool isBuiltInChromeExtension(const fs::path& absolute_ext_path) {
   return base_path_it != kBuiltInExtPathList.end();
 }
 
+/// Parses an extension manifest, without localizing its properties
+Status parseExtensionManifest(ChromeProfile::Extension& extension,
+                              const std::string& extension_path,
+                              const std::string& manifest) {
+  extension = {};
+
+  ChromeProfile::Extension output;
+  output.path = extension_path;
+
+  output.manifest_hash =
+      hashFromBuffer(HASH_TYPE_SHA256, manifest.c_str(), manifest.size());
+
+  pt::iptree parsed_manifest;
+  if (!parseJsonString(parsed_manifest, manifest)) {
+    return Status::failure(
+        "Failed to parse the Manifest file for the following extension: " +
+        extension_path);
+  }
+
+  auto status = getExtensionProperties(output.properties, parsed_manifest);
+  if (!status.ok()) {
+    return status;
+  }
+
+  output.content_scripts_matches =
+      getExtensionContentScriptsMatches(parsed_manifest);
+
+  // Re-render the manifest file to json, this time without
+  // unnecessary whitespace
+  std::stringstream stream;
+  pt::write_json(stream, parsed_manifest, false);
+  output.manifest_json = stream.str();
+
+  // Attempt to compute the real extension identifier
+  auto identifier_exp = computeExtensionIdentifier(output);
+  if (identifier_exp.isError()) {
+    LOG(ERROR) << identifier_exp.getError().getMessage();
+
+  } else {
+    output.opt_computed_identifier = identifier_exp.take();
+  }
+
+  extension = std::move(output);
+  return Status::success();
+}
+
+/// Parses the manifest of an extension, unchanged manifests are parsed once
+Status captureExtensionManifest(ChromeProfileSnapshot::Extension& extension) {
+  auto manifest_path = fs::path(extension.path) / kExtensionManifestName;
+
+  return getManifestCache().get(
+      manifest_path.string(),
+      [&extension](const std::string& manifest,
+                   ChromeProfile::Extension& parsed) {
+        return parseExtensionManifest(parsed, extension.path, manifest);
+      },
+      extension.parsed);
+}
+
 /// Captures a Chrome profile from the given path
 bool captureProfileSnapshotExtensionsFromPath(
     ChromeProfileSnapshot& snapshot, const ChromeProfilePath& profile_path) {
@@ -495,13 +568,14 @@ bool captureProfileSnapshotExtensionsFromPath(
     ChromeProfileSnapshot::Extension extension = {};
     extension.path = extension_path;
 
-    auto manifest_path = fs::path(extension_path) / kExtensionManifestName;
-    auto status = readFile(manifest_path.string(), extension.manifest, 0);
+    auto status = captureExtensionManifest(extension);
 
     if (!status.ok()) {
       if (!isBuiltInChromeExtension(extension_path)) {
+        auto manifest_path = fs::path(extension_path) / kExtensionManifestName;
         LOG(INFO) << "Failed to read the following manifest.json file: "
-                  << manifest_path.string()
+                  << manifest_path.string() << " (" << status.getMessage()
+                  << ")"
                   << ". The extension was referenced by the following profile: "
                   << profile_path.value;
       }
@@ -515,27 +589,15 @@ bool captureProfileSnapshotExtensionsFromPath(
 
   // Now get a list of all the extensions referenced by the Preferences file.
   std::vector<std::string> referenced_ext_path_list;
-
-  if (!getExtensionPathListFromPreferences(
-          referenced_ext_path_list, profile_path.value, snapshot.preferences)) {
-    // Assume this profile is broken and skip it
-    LOG(ERROR) << "Failed to parse the following profile: "
-               << profile_path.value;
-
-    return false;
-  }
+  getExtensionPathListFromPreferences(referenced_ext_path_list,
+                                      profile_path.value,
+                                      *snapshot.parsed_preferences);
 
   {
     std::vector<std::string> additional_ref_ext_path_list;
-    if (!getExtensionPathListFromPreferences(additional_ref_ext_path_list,
-                                             profile_path.value,
-                                             snapshot.secure_preferences)) {
-      // Assume this profile is broken and skip it
-      LOG(ERROR) << "Failed to parse the following profile: "
-                 << profile_path.value;
-
-      return false;
-    }
+    getExtensionPathListFromPreferences(additional_ref_ext_path_list,
+                                        profile_path.value,
+                                        *snapshot.parsed_secure_preferences);
 
     referenced_ext_path_list.insert(
         referenced_ext_path_list.end(),
@@ -562,16 +624,16 @@ bool captureProfileSnapshotExtensionsFromPath(
       ChromeProfileSnapshot::Extension extension = {};
       extension.path = referenced_ext_path;
 
-      auto manifest_path =
-          fs::path(referenced_ext_path) / kExtensionManifestName;
-
-      auto status = readFile(manifest_path.string(), extension.manifest, 0);
+      auto status = captureExtensionManifest(extension);
 
       if (!status.ok()) {
         if (!isBuiltInChromeExtension(referenced_ext_path)) {
+          auto manifest_path =
+              fs::path(referenced_ext_path) / kExtensionManifestName;
+
           LOG(ERROR)
               << "Failed to read the following manifest.json file: "
-              << manifest_path.string()
+              << manifest_path.string() << " (" << status.getMessage() << ")"
               << ". The extension was referenced by the following profile: "
               << profile_path.value;
         }
@@ -612,31 +674,33 @@ ChromeProfileSnapshotList getChromeProfileSnapshotList(
   return output;
 }
 
-Status getLocalizationData(pt::iptree& parsed_localization,
-                           const std::string& extension_path,
-                           const std::string& locale) {
-  parsed_localization = {};
-
+Status getLocalizationData(
+    std::shared_ptr<const pt::iptree>& parsed_localization,
+    const std::string& extension_path,
+    const std::string& locale) {
   auto messages_file_path =
       fs::path(extension_path) / "_locales" / locale / "messages.json";
 
-  std::string messages_json;
-  auto status = readFile(messages_file_path.string(), messages_json, 0);
+  auto status = getJsonFileCache().get(
+      messages_file_path.string(),
+      [&locale](const std::string& messages_json, pt::iptree& output) {
+        if (!parseJsonString(output, messages_json)) {
+          return Status::failure(
+              "Failed to parse the localization data for the following "
+              "locale: " +
+              locale);
+        }
+
+        return Status::success();
+      },
+      parsed_localization);
 
   if (!status.ok()) {
     return Status::failure(
         "Failed to read the localization data for the following locale: " +
-        locale);
-  }
-
-  pt::iptree output;
-  if (!parseJsonString(output, messages_json)) {
-    return Status::failure(
-        "Failed to parse the localization data for the following locale: " +
-        locale);
+        locale + " (" + status.getMessage() + ")");
   }
 
-  parsed_localization = std::move(output);
   return Status::success();
 }
 
@@ -673,7 +737,7 @@ Status localizeExtensionProperties(ChromeProfile::Extension& extension) {
     return Status::success();
   }
 
-  pt::iptree parsed_localization;
+  std::shared_ptr<const pt::iptree> parsed_localization;
   auto status =
       getLocalizationData(parsed_localization, extension.path, locale);
   if (!status.ok()) {
@@ -689,7 +753,7 @@ Status localizeExtensionProperties(ChromeProfile::Extension& extension) {
 
     std::string localized_property_value;
     status = getStringLocalization(
-        localized_property_value, parsed_localization, property_value);
+        localized_property_value, *parsed_localization, property_value);
 
     if (!status.ok()) {
       LOG(ERROR) << "Failed to localize string '" << property_value
@@ -740,10 +804,11 @@ ChromeProfileList getChromeProfilesFromSnapshotList(
     profile.path = snapshot.path;
     profile.uid = snapshot.uid;
 
-    // Parse both configuration files
-    pt::iptree parsed_preferences;
-    if (!snapshot.preferences.empty() &&
-        !parseJsonString(parsed_preferences, snapshot.preferences)) {
+    // Parse both configuration files, unless they were parsed on capture
+    pt::iptree preferences_tree;
+    if (snapshot.parsed_preferences == nullptr &&
+        !snapshot.preferences.empty() &&
+        !parseJsonString(preferences_tree, snapshot.preferences)) {
       LOG(ERROR)
           << "Failed to parse the Preferences file of the following profile: "
           << profile.path;
@@ -751,9 +816,10 @@ ChromeProfileList getChromeProfilesFromSnapshotList(
       continue;
     }
 
-    pt::iptree parsed_secure_preferences;
-    if (!snapshot.secure_preferences.empty() &&
-        !parseJsonString(parsed_secure_preferences,
+    pt::iptree secure_preferences_tree;
+    if (snapshot.parsed_secure_preferences == nullptr &&
+        !snapshot.secure_preferences.empty() &&
+        !parseJsonString(secure_preferences_tree,
                          snapshot.secure_preferences)) {
       LOG(ERROR) << "Failed to parse the Secure Preferences file of the "
                     "following profile: "
@@ -762,6 +828,15 @@ ChromeProfileList getChromeProfilesFromSnapshotList(
       continue;
     }
 
+    const auto& parsed_preferences = snapshot.parsed_preferences != nullptr
+                                         ? *snapshot.parsed_preferences
+                                         : preferences_tree;
+
+    const auto& parsed_secure_preferences =
+        snapshot.parsed_secure_preferences != nullptr
+            ? *snapshot.parsed_secure_preferences
+            : secure_preferences_tree;
+
     // Try to get the profile name; the Opera browser does not have it
     auto status =
         getProfileNameFromPreferences(profile.name, parsed_preferences);
@@ -939,48 +1014,24 @@ Status getExtensionFromSnapshot(
   extension = {};
 
   ChromeProfile::Extension output;
-  output.path = snapshot.path;
-
-  output.manifest_hash = hashFromBuffer(
-      HASH_TYPE_SHA256, snapshot.manifest.c_str(), snapshot.manifest.size());
-
-  pt::iptree parsed_manifest;
-  if (!parseJsonString(parsed_manifest, snapshot.manifest)) {
-    return Status::failure(
-        "Failed to parse the Manifest file for the following extension: " +
-        snapshot.path);
-  }
+  if (snapshot.parsed != nullptr) {
+    output = *snapshot.parsed;
 
-  auto status = getExtensionProperties(output.properties, parsed_manifest);
-  if (!status.ok()) {
-    return status;
+  } else {
+    auto status =
+        parseExtensionManifest(output, snapshot.path, snapshot.manifest);
+    if (!status.ok()) {
+      return status;
+    }
   }
 
-  status = localizeExtensionProperties(output);
+  auto status = localizeExtensionProperties(output);
   if (!status.ok()) {
     LOG(ERROR) << "Failed to process the localization settngs for the "
                   "following extension: "
                << output.path;
   }
 
-  output.content_scripts_matches =
-      getExtensionContentScriptsMatches(parsed_manifest);
-
-  // Re-render the manifest file to json, this time without
-  // unnecessary whitespace
-  std::stringstream stream;
-  pt::write_json(stream, parsed_manifest, false);
-  output.manifest_json = stream.str();
-
-  // Attempt to compute the real extension identifier
-  auto identifier_exp = computeExtensionIdentifier(output);
-  if (identifier_exp.isError()) {
-    LOG(ERROR) << identifier_exp.getError().getMessage();
-
-  } else {
-    output.opt_computed_identifier = identifier_exp.take();
-  }
-
   extension = std::move(output);
   return Status::success();
 }
@@ -17,6 +17,7 @@
 #include <osquery/utils/conversions/tryto.h>
 #include <osquery/utils/expected/expected.h>
 
+#include <memory>
 #include <unordered_map>
 
 namespace fs = boost::filesystem;
@@ -44,45 +45,6 @@ enum class ChromeBrowserType {
 /// Converts the browser type to a printable string
 const std::string& getChromeBrowserName(const ChromeBrowserType& type);
 
-/// A snapshot of all the important files inside a chrome profile
-struct ChromeProfileSnapshot final {
-  /// A single extension found inside the profile
-  struct Extension final {
-    /// The absolute path to the extension folder
-    std::string path;
-
-    /// The contents of the manifest file
-    std::string manifest;
-  };
-
-  /// A map of extensions where the key identifies the (relative) path
-  using ExtensionMap = std::unordered_map<std::string, Extension>;
-
-  /// Profile type
-  ChromeBrowserType type{ChromeBrowserType::GoogleChrome};
-
-  /// Absolute path to this profile
-  std::string path;
-
-  /// The contents of the 'Preferences' file
-  std::string preferences;
-
-  /// The contents of the 'Secure Preferences' file
-  std::string secure_preferences;
-
-  /// The user id
-  std::int64_t uid{};
-
-  /// A map of all the extensions discovered in the preferences
-  ExtensionMap referenced_extensions;
-
-  /// A map of all the extensions that are not present in the preferences
-  ExtensionMap unreferenced_extensions;
-};
-
-/// A list of chrome profile snapshots
-using ChromeProfileSnapshotList = std::vector<ChromeProfileSnapshot>;
-
 /// A js -> match pair from the content_scripts manifest entry
 struct ContentScriptsEntry final {
   /// The target script
@@ -150,6 +112,54 @@ struct ChromeProfile final {
 /// A list of Chrome profiles
 using ChromeProfileList = std::vector<ChromeProfile>;
 
+/// A snapshot of all the important files inside a chrome profile
+struct ChromeProfileSnapshot final {
+  /// A single extension found inside the profile
+  struct Extension final {
+    /// The absolute path to the extension folder
+    std::string path;
+
+    /// The contents of the manifest file, when not parsed
+    std::string manifest;
+
+    /// The extension parsed from the manifest file, before localization
+    std::shared_ptr<const ChromeProfile::Extension> parsed;
+  };
+
+  /// A map of extensions where the key identifies the (relative) path
+  using ExtensionMap = std::unordered_map<std::string, Extension>;
+
+  /// Profile type
+  ChromeBrowserType type{ChromeBrowserType::GoogleChrome};
+
+  /// Absolute path to this profile
+  std::string path;
+
+  /// The contents of the 'Preferences' file
+  std::string preferences;
+
+  /// The contents of the 'Secure Preferences' file
+  std::string secure_preferences;
+
+  /// The parsed 'Preferences' file, used instead of its contents
+  std::shared_ptr<const pt::iptree> parsed_preferences;
+
+  /// The parsed 'Secure Preferences' file, used instead of its contents
+  std::shared_ptr<const pt::iptree> parsed_secure_preferences;
+
+  /// The user id
+  std::int64_t uid{};
+
+  /// A map of all the extensions discovered in the preferences
+  ExtensionMap referenced_extensions;
+
+  /// A map of all the extensions that are not present in the preferences
+  ExtensionMap unreferenced_extensions;
+};
+
+/// A list of chrome profile snapshots
+using ChromeProfileSnapshotList = std::vector<ChromeProfileSnapshot>;
+
 /// Returns the list of 'matches' entries inside the 'content_scripts' array
 ContentScriptsEntryList getExtensionContentScriptsMatches(
     const pt::iptree& parsed_manifest);
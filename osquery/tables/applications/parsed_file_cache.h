@@ -0,0 +1,156 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/filesystem/filesystem.h>
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+namespace tables {
+
+/**
+ * @brief Values parsed from files, reused while the files are unchanged.
+ *
+ * The browser and editor extension tables parse the same manifests and
+ * preferences on every query. A value is kept for each path and reused while
+ * the modification time and size of the file are the ones it was parsed
+ * from, so unchanged files are neither read nor parsed again. Files that
+ * cannot be read or parsed are not kept.
+ */
+template <typename T>
+class ParsedFileCache : private boost::noncopyable {
+ public:
+  using Value = std::shared_ptr<const T>;
+
+  /// Parse the content of a file into a value.
+  using Parse = std::function<Status(const std::string& content, T& value)>;
+
+  /// At most max_entries files are kept, the least recently used first go.
+  explicit ParsedFileCache(size_t max_entries) : max_entries_(max_entries) {}
+
+  /**
+   * @brief Return the value parsed from a file, reading it if it changed.
+   *
+   * @param path the file to read.
+   * @param parse called with the file content when there is no valid value.
+   * @param value the value parsed from the current content of the file.
+   */
+  Status get(const std::string& path, const Parse& parse, Value& value) {
+    value = nullptr;
+
+    std::error_code ec;
+    Stamp stamp;
+    stamp.mtime = std::filesystem::last_write_time(path, ec);
+    if (!ec) {
+      stamp.size = std::filesystem::file_size(path, ec);
+    }
+    if (ec) {
+      return Status::failure("Cannot stat " + path + ": " + ec.message());
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = entries_.find(path);
+      if (it != entries_.end() && it->second.stamp == stamp) {
+        it->second.last_used = ++uses_;
+        value = it->second.value;
+        return Status::success();
+      }
+    }
+
+    std::string content;
+    auto status = readFile(path, content);
+    if (!status.ok()) {
+      return status;
+    }
+
+    auto parsed = std::make_shared<T>();
+    status = parse(content, *parsed);
+    if (!status.ok()) {
+      return status;
+    }
+
+    // The stamp was taken before the read, a later change is parsed again.
+    value = std::move(parsed);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (entries_.count(path) == 0 && entries_.size() >= max_entries_) {
+      evict();
+    }
+
+    auto& entry = entries_[path];
+    entry.stamp = stamp;
+    entry.value = value;
+    entry.last_used = ++uses_;
+    return Status::success();
+  }
+
+  /// Forget every value.
+  void clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+  }
+
+  size_t size() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+  }
+
+ private:
+  struct Stamp {
+    std::filesystem::file_time_type mtime;
+    std::uintmax_t size{0};
+
+    bool operator==(const Stamp& other) const {
+      return mtime == other.mtime && size == other.size;
+    }
+  };
+
+  struct Entry {
+    Stamp stamp;
+    Value value;
+    std::uint64_t last_used{0};
+  };
+
+  /// Remove the least recently used entry, the mutex is held.
+  void evict() {
+    auto oldest = entries_.end();
+    for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+      if (oldest == entries_.end() ||
+          it->second.last_used < oldest->second.last_used) {
+        oldest = it;
+      }
+    }
+
+    if (oldest != entries_.end()) {
+      entries_.erase(oldest);
+    }
+  }
+
+  const size_t max_entries_;
+
+  std::mutex mutex_;
+  std::unordered_map<std::string, Entry> entries_;
+  std::uint64_t uses_{0};
+};
+
+} // namespace tables
+
+} // namespace osquery
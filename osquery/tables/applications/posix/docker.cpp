@@ -7,14 +7,23 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <atomic>
+#include <chrono>
 #include <cstdlib>
 #include <cstring>
+#include <functional>
 #include <iostream>
+#include <memory>
 #include <regex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
 
+#include <boost/algorithm/string/case_conv.hpp>
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/trim.hpp>
 #include <boost/asio.hpp>
 #include <boost/foreach.hpp>
 #include <boost/property_tree/json_parser.hpp>
@@ -29,6 +38,7 @@
 #include <osquery/utils/conversions/join.h>
 #include <osquery/utils/info/platform_type.h>
 #include <osquery/utils/json/json.h>
+#include <osquery/utils/mutex.h>
 
 // When building on linux, the extended schema of docker_containers will
 // add some additional columns to support user namespaces
@@ -52,67 +62,323 @@ FLAG(string,
      "/var/run/docker.sock",
      "Docker UNIX domain socket path");
 
+/// Per-container requests made concurrently by one table.
+FLAG(uint32,
+     docker_api_workers,
+     4,
+     "Concurrent docker API requests of a table, 1 is sequential");
+
+FLAG(uint32,
+     docker_api_connections,
+     4,
+     "Idle docker socket connections kept alive, 0 closes each connection");
+
+FLAG(uint32,
+     docker_api_cache_ms,
+     1000,
+     "Milliseconds docker API responses are shared by the docker tables");
+
 namespace tables {
 
+namespace {
+
+using DockerStream = local::stream_protocol::iostream;
+
+/// The responses cached are bounded, expired responses are removed first.
+const size_t kDockerCacheMaxResponses = 4096;
+
+/// Idle keep-alive connections to the docker socket.
+class DockerConnectionPool {
+ public:
+  /// Take an idle connection, nullptr if there are none.
+  std::unique_ptr<DockerStream> take() {
+    WriteLock lock(mutex_);
+    if (socket_ != FLAGS_docker_socket) {
+      // Connections to a previously configured socket are not reused.
+      idle_.clear();
+      socket_ = FLAGS_docker_socket;
+    }
+
+    if (idle_.empty()) {
+      return nullptr;
+    }
+    auto stream = std::move(idle_.back());
+    idle_.pop_back();
+    return stream;
+  }
+
+  /// Return a connection that read its last response completely.
+  void give(std::unique_ptr<DockerStream> stream) {
+    WriteLock lock(mutex_);
+    if (socket_ == FLAGS_docker_socket &&
+        idle_.size() < FLAGS_docker_api_connections) {
+      idle_.push_back(std::move(stream));
+    }
+  }
+
+ private:
+  Mutex mutex_;
+
+  /// The socket path of the idle connections.
+  std::string socket_;
+
+  std::vector<std::unique_ptr<DockerStream>> idle_;
+};
+
 /**
- * @brief Makes API calls to the docker UNIX socket.
+ * @brief Responses shared by the docker tables for docker_api_cache_ms.
  *
- * @param uri Relative URI to invoke GET HTTP method.
- * @param tree Property tree where JSON result is stored.
- * @return Status with 0 code on success. Non-negative status with error
- *         message.
+ * The tables of one query, and the per-row calls of a JOIN, often request
+ * the same containers and images within a few milliseconds.
  */
-Status dockerApi(const std::string& uri, pt::ptree& tree) {
-  static const std::regex httpOkRegex("HTTP/1\\.(0|1) 200 OK\\\r");
+class DockerResponseCache {
+ public:
+  bool get(const std::string& key, pt::ptree& tree) {
+    ReadLock lock(mutex_);
+    auto it = responses_.find(key);
+    if (it == responses_.end() ||
+        it->second.expires <= std::chrono::steady_clock::now()) {
+      return false;
+    }
+    tree = *it->second.tree;
+    return true;
+  }
 
-  try {
-    local::stream_protocol::endpoint ep(FLAGS_docker_socket);
-    local::stream_protocol::iostream stream(ep);
-    if (!stream) {
-      return Status(
-          1, "Error connecting to docker sock: " + stream.error().message());
+  void set(const std::string& key, const pt::ptree& tree) {
+    auto now = std::chrono::steady_clock::now();
+    WriteLock lock(mutex_);
+    if (responses_.size() >= kDockerCacheMaxResponses) {
+      for (auto it = responses_.begin(); it != responses_.end();) {
+        if (it->second.expires <= now) {
+          it = responses_.erase(it);
+        } else {
+          ++it;
+        }
+      }
+      if (responses_.size() >= kDockerCacheMaxResponses) {
+        responses_.clear();
+      }
     }
 
-    // Since keep-alive connections are not used, use HTTP/1.0
-    stream << "GET " << uri
-           << " HTTP/1.0\r\nAccept: */*\r\nConnection: close\r\n\r\n"
-           << std::flush;
-    if (stream.eof()) {
-      stream.close();
-      return Status(1, "Empty docker API response for: " + uri);
+    auto& response = responses_[key];
+    response.tree = std::make_shared<const pt::ptree>(tree);
+    response.expires =
+        now + std::chrono::milliseconds(FLAGS_docker_api_cache_ms);
+  }
+
+ private:
+  struct Response {
+    std::shared_ptr<const pt::ptree> tree;
+    std::chrono::steady_clock::time_point expires;
+  };
+
+  Mutex mutex_;
+
+  std::unordered_map<std::string, Response> responses_;
+};
+
+DockerConnectionPool& getConnectionPool() {
+  static DockerConnectionPool pool;
+  return pool;
+}
+
+DockerResponseCache& getResponseCache() {
+  static DockerResponseCache cache;
+  return cache;
+}
+
+/**
+ * @brief Read the headers and body following a response status line.
+ *
+ * @param reusable Set to false if the connection cannot be used again.
+ */
+Status readDockerBody(DockerStream& stream,
+                      const std::string& uri,
+                      std::string& body,
+                      bool& reusable) {
+  bool chunked = false;
+  bool has_length = false;
+  size_t length = 0;
+
+  std::string line;
+  while (std::getline(stream, line) && line != "\r") {
+    auto colon = line.find(':');
+    if (colon == std::string::npos) {
+      continue;
+    }
+
+    auto name = boost::algorithm::to_lower_copy(line.substr(0, colon));
+    auto value = boost::algorithm::to_lower_copy(
+        boost::algorithm::trim_copy(line.substr(colon + 1)));
+    if (name == "content-length") {
+      has_length = true;
+      length = static_cast<size_t>(std::stoull(value));
+    } else if (name == "transfer-encoding") {
+      chunked = (value == "chunked");
+    } else if (name == "connection" && value == "close") {
+      reusable = false;
+    }
+  }
+
+  body.clear();
+  if (chunked) {
+    while (std::getline(stream, line)) {
+      auto size = static_cast<size_t>(std::stoull(line, nullptr, 16));
+      if (size == 0) {
+        // Skip the trailer.
+        while (std::getline(stream, line) && line != "\r") {
+        }
+        break;
+      }
+
+      auto offset = body.size();
+      body.resize(offset + size);
+      stream.read(&body[offset], size);
+      std::getline(stream, line);
+    }
+  } else if (has_length) {
+    body.resize(length);
+    stream.read(&body[0], length);
+  } else {
+    // Without a length the body ends when the daemon closes the connection.
+    body.assign(std::istreambuf_iterator<char>(stream),
+                std::istreambuf_iterator<char>());
+    reusable = false;
+    return Status::success();
+  }
+
+  if (!stream) {
+    reusable = false;
+    return Status(1, "Incomplete docker API response for: " + uri);
+  }
+  return Status::success();
+}
+
+/// Make one GET request, reusing an idle connection when there is one.
+Status dockerRequest(const std::string& uri, std::string& body) {
+  static const std::regex httpOkRegex("HTTP/1\\.(0|1) 200 OK\\\r");
+
+  auto& pool = getConnectionPool();
+  auto keep_alive = FLAGS_docker_api_connections > 0;
+  auto stream = keep_alive ? pool.take() : nullptr;
+  auto pooled = stream != nullptr;
+
+  while (true) {
+    if (stream == nullptr) {
+      local::stream_protocol::endpoint ep(FLAGS_docker_socket);
+      stream = std::make_unique<DockerStream>(ep);
+      if (!*stream) {
+        return Status(
+            1, "Error connecting to docker sock: " + stream->error().message());
+      }
     }
 
+    *stream << "GET " << uri
+            << " HTTP/1.1\r\nHost: localhost\r\nAccept: */*\r\n"
+            << (keep_alive ? "" : "Connection: close\r\n") << "\r\n"
+            << std::flush;
+
     // All status responses are expected to be 200
     std::string str;
-    getline(stream, str);
+    if (!std::getline(*stream, str)) {
+      if (pooled) {
+        // The daemon closed the idle connection, retry on a new one.
+        pooled = false;
+        stream.reset();
+        continue;
+      }
+      return Status(1, "Empty docker API response for: " + uri);
+    }
 
     std::smatch match;
     if (!std::regex_match(str, match, httpOkRegex)) {
-      stream.close();
       return Status(1, "Invalid docker API response for " + uri + ": " + str);
     }
 
-    // Skip empty line between header and body
-    while (!stream.eof() && str != "\r") {
-      getline(stream, str);
+    auto reusable = keep_alive && boost::starts_with(str, "HTTP/1.1");
+    auto s = readDockerBody(*stream, uri, body, reusable);
+    if (s.ok() && reusable) {
+      pool.give(std::move(stream));
+    }
+    return s;
+  }
+}
+} // namespace
+
+/**
+ * @brief Makes API calls to the docker UNIX socket.
+ *
+ * Responses are shared with other callers for docker_api_cache_ms and
+ * connections are kept alive for the following calls.
+ *
+ * @param uri Relative URI to invoke GET HTTP method.
+ * @param tree Property tree where JSON result is stored.
+ * @return Status with 0 code on success. Non-negative status with error
+ *         message.
+ */
+Status dockerApi(const std::string& uri, pt::ptree& tree) {
+  auto key = FLAGS_docker_socket + " " + uri;
+  auto caching = FLAGS_docker_api_cache_ms > 0;
+  if (caching && getResponseCache().get(key, tree)) {
+    return Status(0);
+  }
+
+  try {
+    std::string body;
+    auto s = dockerRequest(uri, body);
+    if (!s.ok()) {
+      return s;
     }
 
     try {
+      std::istringstream stream(body);
       pt::read_json(stream, tree);
     } catch (const pt::ptree_error& e) {
-      stream.close();
       return Status(
           1, "Error reading docker API response for " + uri + ": " + e.what());
     }
-
-    stream.close();
   } catch (const std::exception& e) {
     return Status(1, std::string("Error calling docker API: ") + e.what());
   }
 
+  if (caching) {
+    getResponseCache().set(key, tree);
+  }
   return Status(0);
 }
 
+/**
+ * @brief Makes many API calls, up to docker_api_workers at a time.
+ *
+ * @param uris Relative URIs to invoke GET HTTP method.
+ * @param trees Property trees of the results, in the order of the URIs.
+ * @param statuses Status of each call, in the order of the URIs.
+ */
+void dockerApiBatch(const std::vector<std::string>& uris,
+                    std::vector<pt::ptree>& trees,
+                    std::vector<Status>& statuses) {
+  trees.assign(uris.size(), pt::ptree());
+  statuses.assign(uris.size(), Status(0));
+
+  std::atomic<size_t> next{0};
+  auto worker = [&]() {
+    for (auto i = next++; i < uris.size(); i = next++) {
+      statuses[i] = dockerApi(uris[i], trees[i]);
+    }
+  };
+
+  auto workers = std::min(
+      static_cast<size_t>(std::max(FLAGS_docker_api_workers, 1U)), uris.size());
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < workers; ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
 /**
  * @brief Entry point for docker_version table.
  */
@@ -368,6 +634,31 @@ Status getContainers(QueryContext& context,
   return Status(0);
 }
 
+/**
+ * @brief Utility method to call a container API for each "id" constraint.
+ *
+ * @param context Query context which contains SQL constraint.
+ * @param suffix URI following the container ID (eg: "/top").
+ * @param ids Placeholder for returning the valid constraint values.
+ * @param trees Property trees of the results, in the order of the IDs.
+ * @param statuses Status of each call, in the order of the IDs.
+ */
+void getContainerDetails(QueryContext& context,
+                         const std::string& suffix,
+                         std::vector<std::string>& ids,
+                         std::vector<pt::ptree>& trees,
+                         std::vector<Status>& statuses) {
+  std::vector<std::string> uris;
+  for (const auto& id : context.constraints["id"].getAll(EQUALS)) {
+    if (!checkConstraintValue(id)) {
+      continue;
+    }
+    ids.push_back(id);
+    uris.push_back("/containers/" + id + suffix);
+  }
+  dockerApiBatch(uris, trees, statuses);
+}
+
 /**
  * @brief Entry point for docker_containers table.
  */
@@ -380,6 +671,8 @@ QueryData genContainers(QueryContext& context) {
     return results;
   }
 
+  std::vector<Row> rows;
+  std::vector<std::string> uris;
   for (const auto& entry : containers) {
     const pt::ptree& container = entry.second;
     Row r;
@@ -400,11 +693,18 @@ QueryData genContainers(QueryContext& context) {
     r["created"] = BIGINT(container.get<uint64_t>("Created", 0));
     r["state"] = container.get<std::string>("State", "");
     r["status"] = container.get<std::string>("Status", "");
+    uris.push_back("/containers/" + r["id"] + "/json?stream=false");
+    rows.push_back(std::move(r));
+  }
+
+  std::vector<pt::ptree> details;
+  std::vector<Status> statuses;
+  dockerApiBatch(uris, details, statuses);
 
-    pt::ptree container_details;
-    s = dockerApi("/containers/" + r["id"] + "/json?stream=false",
-                  container_details);
-    if (s.ok()) {
+  for (size_t i = 0; i < rows.size(); ++i) {
+    auto& r = rows[i];
+    const auto& container_details = details[i];
+    if (statuses[i].ok()) {
       r["pid"] =
           BIGINT(container_details.get_child("State").get<pid_t>("Pid", -1));
       r["started_at"] = container_details.get_child("State").get<std::string>(
@@ -468,7 +768,7 @@ QueryData genContainers(QueryContext& context) {
     }
 #endif
 
-    results.push_back(r);
+    results.push_back(std::move(r));
   }
 
   return results;
@@ -486,14 +786,22 @@ QueryData genContainerEnvs(QueryContext& context) {
     return results;
   }
 
+  std::vector<std::string> container_ids;
+  std::vector<std::string> uris;
   for (const auto& entry : containers) {
-    const pt::ptree& container = entry.second;
-    auto id = getValue(container, ids, "Id");
+    container_ids.push_back(getValue(entry.second, ids, "Id"));
+    uris.push_back("/containers/" + container_ids.back() +
+                   "/json?stream=false");
+  }
+
+  std::vector<pt::ptree> details;
+  std::vector<Status> statuses;
+  dockerApiBatch(uris, details, statuses);
 
-    pt::ptree container_details;
-    s = dockerApi("/containers/" + id + "/json?stream=false",
-                  container_details);
-    if (s.ok()) {
+  for (size_t i = 0; i < container_ids.size(); ++i) {
+    const auto& id = container_ids[i];
+    const auto& container_details = details[i];
+    if (statuses[i].ok()) {
       for (const auto& env_var : container_details.get_child("Config.Env")) {
         Row r;
         r["id"] = id;
@@ -640,18 +948,19 @@ QueryData genContainerPorts(QueryContext& context) {
 QueryData genContainerProcesses(QueryContext& context) {
   QueryData results;
 
-  for (const auto& id : context.constraints["id"].getAll(EQUALS)) {
-    if (!checkConstraintValue(id)) {
-      continue;
-    }
-
-    pt::ptree container;
-    std::string ps_args =
-        "pid,state,uid,gid,euid,egid,suid,sgid,rss,vsz,etime,ppid,pgrp,nlwp,"
-        "nice,user,time,pcpu,pmem,comm,cmd";
-    auto s = dockerApi("/containers/" + id + "/top?ps_args=axwwo%20" + ps_args,
-                       container);
-
+  std::string ps_args =
+      "pid,state,uid,gid,euid,egid,suid,sgid,rss,vsz,etime,ppid,pgrp,nlwp,"
+      "nice,user,time,pcpu,pmem,comm,cmd";
+  std::vector<std::string> ids;
+  std::vector<pt::ptree> trees;
+  std::vector<Status> statuses;
+  getContainerDetails(
+      context, "/top?ps_args=axwwo%20" + ps_args, ids, trees, statuses);
+
+  for (size_t i = 0; i < ids.size(); ++i) {
+    const auto& id = ids[i];
+    const auto& container = trees[i];
+    const auto& s = statuses[i];
     if (!s.ok()) {
       VLOG(1) << "Error getting docker container " << id << ": " << s.what();
       continue;
@@ -727,13 +1036,15 @@ char getFsChangeType(int type_id) {
 QueryData genContainerFsChanges(QueryContext& context) {
   QueryData results;
 
-  for (const auto& id : context.constraints["id"].getAll(EQUALS)) {
-    if (!checkConstraintValue(id)) {
-      continue;
-    }
+  std::vector<std::string> ids;
+  std::vector<pt::ptree> trees;
+  std::vector<Status> statuses;
+  getContainerDetails(context, "/changes", ids, trees, statuses);
 
-    pt::ptree tree;
-    auto s = dockerApi("/containers/" + id + "/changes", tree);
+  for (size_t i = 0; i < ids.size(); ++i) {
+    const auto& id = ids[i];
+    const auto& tree = trees[i];
+    const auto& s = statuses[i];
     if (!s.ok()) {
       VLOG(1) << "Error getting docker container fs changes" << id << ": "
               << s.what();
@@ -860,14 +1171,17 @@ std::string getNetworkBytes(const pt::ptree& tree, const std::string& key) {
  */
 QueryData genContainerStats(QueryContext& context) {
   QueryData results;
-  for (const auto& id : context.constraints["id"].getAll(EQUALS)) {
-    if (!checkConstraintValue(id)) {
-      continue;
-    }
 
-    pt::ptree container;
-    Status s =
-        dockerApi("/containers/" + id + "/stats?stream=false", container);
+  // Each stats call waits for two samples, they are made concurrently.
+  std::vector<std::string> ids;
+  std::vector<pt::ptree> trees;
+  std::vector<Status> statuses;
+  getContainerDetails(context, "/stats?stream=false", ids, trees, statuses);
+
+  for (size_t i = 0; i < ids.size(); ++i) {
+    const auto& id = ids[i];
+    const auto& container = trees[i];
+    const auto& s = statuses[i];
     if (!s.ok()) {
       VLOG(1) << "Error getting docker container " << id << ": " << s.what();
       continue;
@@ -1040,18 +1354,37 @@ QueryData genVolumeLabels(QueryContext& context) {
 }
 
 /**
- * @brief Image layer extractor for docker_image_layers table
+ * @brief Utility method to get the IDs of all images.
  */
-void getImageLayers(const std::string& image_id, QueryData& results) {
+Status getImageIds(std::vector<std::string>& ids) {
   pt::ptree tree;
-  std::vector<std::string> layers;
-
-  Status s = dockerApi("/images/" + image_id + "/json", tree);
+  Status s = dockerApi("/images/json", tree);
   if (!s.ok()) {
-    VLOG(1) << "Error getting docker images layers: " << s.what();
-    return;
+    VLOG(1) << "Error getting docker images: " << s.what();
+    return s;
   }
+  for (const auto& entry : tree) {
+    try {
+      const pt::ptree& node = entry.second;
+      std::string id = node.get<std::string>("Id", "");
+      if (boost::starts_with(id, "sha256:")) {
+        id.erase(0, 7);
+      }
+      ids.push_back(id);
+    } catch (const pt::ptree_error& e) {
+      VLOG(1) << "Error getting docker image details: " << e.what();
+    }
+  }
+  return Status(0);
+}
 
+/**
+ * @brief Image layer extractor for docker_image_layers table
+ */
+void getImageLayers(const std::string& image_id,
+                    const pt::ptree& tree,
+                    QueryData& results) {
+  std::vector<std::string> layers;
   try {
     for (const auto& layer : tree.get_child("RootFS.Layers")) {
       std::string layer_hash = layer.second.data();
@@ -1075,62 +1408,61 @@ void getImageLayers(const std::string& image_id, QueryData& results) {
 }
 
 /**
- * @brief Calls layer extractor for all images for docker_image_layers table
+ * @brief Utility method to call an image API for each requested image.
+ *
+ * @param context Query context, all images are used without "id" constraint.
+ * @param suffix URI following the image ID (eg: "/history").
+ * @param extractor Adds the rows of one image.
  */
-void getImageLayersAll(QueryData& results) {
-  pt::ptree tree;
-  Status s = dockerApi("/images/json", tree);
-  if (!s.ok()) {
-    VLOG(1) << "Error getting docker images: " << s.what();
-    return;
-  }
-  for (const auto& entry : tree) {
-    try {
-      const pt::ptree& node = entry.second;
-      std::string id = node.get<std::string>("Id", "");
-      if (boost::starts_with(id, "sha256:")) {
-        id.erase(0, 7);
+QueryData getImagesDetails(
+    QueryContext& context,
+    const std::string& suffix,
+    const std::function<void(const std::string&, const pt::ptree&, QueryData&)>&
+        extractor) {
+  QueryData results;
+  std::vector<std::string> ids;
+  if (context.constraints["id"].exists(EQUALS)) {
+    for (const auto& id : context.constraints["id"].getAll(EQUALS)) {
+      if (checkConstraintValue(id)) {
+        ids.push_back(id);
       }
-      getImageLayers(id, results);
-    } catch (const pt::ptree_error& e) {
-      VLOG(1) << "Error getting docker image details: " << e.what();
     }
+  } else if (!getImageIds(ids).ok()) {
+    return results;
+  }
+
+  std::vector<std::string> uris;
+  for (const auto& id : ids) {
+    uris.push_back("/images/" + id + suffix);
   }
+
+  std::vector<pt::ptree> trees;
+  std::vector<Status> statuses;
+  dockerApiBatch(uris, trees, statuses);
+  for (size_t i = 0; i < ids.size(); ++i) {
+    if (!statuses[i].ok()) {
+      VLOG(1) << "Error getting docker image " << ids[i] << ": "
+              << statuses[i].what();
+      continue;
+    }
+    extractor(ids[i], trees[i], results);
+  }
+  return results;
 }
 
 /**
  * @brief Entry point for docker_image_layers table.
  */
 QueryData genImageLayers(QueryContext& context) {
-  QueryData results;
-  pt::ptree tree;
-  std::vector<std::string> layers;
-
-  if (context.constraints["id"].exists(
-          EQUALS)) { // get layers for specific image
-    for (const auto& id : context.constraints["id"].getAll(EQUALS)) {
-      if (!checkConstraintValue(id)) {
-        continue;
-      }
-      getImageLayers(id, results);
-    }
-  } else { // get layers for all images
-    getImageLayersAll(results);
-  }
-  return results;
+  return getImagesDetails(context, "/json", getImageLayers);
 }
 
 /**
  * @brief Image history extractor for docker_image_history table
  */
-void getImageHistory(const std::string& image_id, QueryData& results) {
-  pt::ptree tree;
-  Status s = dockerApi("/images/" + image_id + "/history", tree);
-  if (!s.ok()) {
-    VLOG(1) << "Error getting docker images history: " << s.what();
-    return;
-  }
-
+void getImageHistory(const std::string& image_id,
+                     const pt::ptree& tree,
+                     QueryData& results) {
   for (const auto& entry : tree) {
     try {
       const pt::ptree& node = entry.second;
@@ -1156,46 +1488,11 @@ void getImageHistory(const std::string& image_id, QueryData& results) {
   }
 }
 
-/**
- * @brief Calls history for all images for docker_image_history table
- */
-void getImageHistoryAll(QueryData& results) {
-  pt::ptree tree;
-  Status s = dockerApi("/images/json", tree);
-  if (!s.ok()) {
-    VLOG(1) << "Error getting docker images: " << s.what();
-    return;
-  }
-  for (const auto& entry : tree) {
-    try {
-      const pt::ptree& node = entry.second;
-      std::string id = node.get<std::string>("Id", "");
-      if (boost::starts_with(id, "sha256:")) {
-        id.erase(0, 7);
-      }
-      getImageHistory(id, results);
-    } catch (const pt::ptree_error& e) {
-      VLOG(1) << "Error getting docker image history: " << e.what();
-    }
-  }
-}
-
 /**
  * @brief Entry point for docker_image_history table.
  */
 QueryData genImageHistory(QueryContext& context) {
-  QueryData results;
-  if (context.constraints["id"].exists(EQUALS)) {
-    for (const auto& id : context.constraints["id"].getAll(EQUALS)) {
-      if (!checkConstraintValue(id)) {
-        continue;
-      }
-      getImageHistory(id, results);
-    }
-  } else {
-    getImageHistoryAll(results);
-  }
-  return results;
+  return getImagesDetails(context, "/history", getImageHistory);
 }
 
 /**
@@ -13,63 +13,172 @@
 #include <osquery/remote/http_client.h>
 // clang-format on
 
-#include <sstream>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <string_view>
+#include <thread>
 
 #include <osquery/config/config.h>
 #include <plugins/config/parsers/prometheus_targets.h>
+#include <osquery/core/flags.h>
 #include <osquery/logger/logger.h>
 #include <osquery/core/tables.h>
 #include <osquery/tables/applications/posix/prometheus_metrics.h>
 #include <osquery/utils/conversions/split.h>
+#include <osquery/utils/mutex.h>
 
 namespace osquery {
+
+FLAG(uint32,
+     prometheus_scrape_workers,
+     8,
+     "Prometheus targets scraped concurrently, 1 is sequential");
+
 namespace tables {
 
+namespace {
+
+/// Connections kept alive between scrapes, one per target.
+struct ScrapeClients {
+  Mutex mutex;
+  size_t timeout{0};
+  std::map<std::string, std::unique_ptr<http::Client>> idle;
+};
+
+ScrapeClients& getScrapeClients() {
+  static ScrapeClients clients;
+  return clients;
+}
+
+std::unique_ptr<http::Client> takeClient(const std::string& target,
+                                         size_t timeoutS) {
+  auto& clients = getScrapeClients();
+  {
+    WriteLock lock(clients.mutex);
+    if (clients.timeout != timeoutS) {
+      // Connections were opened with the previous options.
+      clients.idle.clear();
+      clients.timeout = timeoutS;
+    }
+
+    auto client = clients.idle.find(target);
+    if (client != clients.idle.end()) {
+      auto reused = std::move(client->second);
+      clients.idle.erase(client);
+      return reused;
+    }
+  }
+
+  return std::make_unique<http::Client>(http::Client::Options()
+                                            .follow_redirects(true)
+                                            .keep_alive(true)
+                                            .timeout(timeoutS));
+}
+
+void returnClient(const std::string& target,
+                  std::unique_ptr<http::Client> client,
+                  size_t timeoutS) {
+  auto& clients = getScrapeClients();
+  WriteLock lock(clients.mutex);
+  if (clients.timeout == timeoutS) {
+    clients.idle[target] = std::move(client);
+  }
+}
+
+/// Close the connections of targets that are no longer configured.
+void pruneClients(
+    const std::map<std::string, PrometheusResponseData>& scrapeResults) {
+  auto& clients = getScrapeClients();
+  WriteLock lock(clients.mutex);
+  for (auto client = clients.idle.begin(); client != clients.idle.end();) {
+    if (scrapeResults.count(client->first) == 0) {
+      client = clients.idle.erase(client);
+    } else {
+      ++client;
+    }
+  }
+}
+
+} // namespace
+
+void parseScrapeResult(const std::string& target,
+                       const PrometheusResponseData& result,
+                       QueryData& rows) {
+  auto timestamp = BIGINT(result.timestampMS.count());
+  std::string_view content(result.content);
+  while (!content.empty()) {
+    auto end = content.find('\n');
+    auto line = content.substr(0, end);
+    content = (end == std::string_view::npos) ? std::string_view()
+                                              : content.substr(end + 1);
+
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+
+    std::array<std::string_view, 2> metric;
+    Tokenizer fields(line, " \t\r");
+    if (fields.next(metric) == metric.size()) {
+      Row r;
+      r[kColTargetName] = target;
+      r[kColTimeStamp] = timestamp;
+      r[kColMetric] = std::string(metric[0]);
+      r[kColValue] = std::string(metric[1]);
+      rows.push_back(std::move(r));
+    }
+  }
+}
+
 void parseScrapeResults(
     const std::map<std::string, PrometheusResponseData>& scrapeResults,
     QueryData& rows) {
   for (auto const& target : scrapeResults) {
-    std::stringstream ss(target.second.content);
-    std::string dest;
-
-    while (std::getline(ss, dest)) {
-      if (!dest.empty() && dest[0] != '#') {
-        auto metric(osquery::split(dest, " "));
-
-        if (metric.size() > 1) {
-          Row r;
-          r[kColTargetName] = target.first;
-          r[kColTimeStamp] = BIGINT(target.second.timestampMS.count());
-          r[kColMetric] = metric[0];
-          r[kColValue] = metric[1];
-
-          rows.push_back(r);
-        }
-      }
-    }
+    parseScrapeResult(target.first, target.second, rows);
   }
 }
 
 void scrapeTargets(std::map<std::string, PrometheusResponseData>& scrapeResults,
                    size_t timeoutS) {
-  http::Client client(
-      http::Client::Options().follow_redirects(true).timeout(timeoutS));
-
+  std::vector<std::pair<const std::string, PrometheusResponseData>*> targets;
   for (auto& target : scrapeResults) {
-    try {
-      http::Request request(target.first);
-      http::Response response(client.get(request));
-
-      target.second.timestampMS =
-          std::chrono::duration_cast<std::chrono::milliseconds>(
-              std::chrono::system_clock::now().time_since_epoch());
-      target.second.content = response.body();
-
-    } catch (std::exception& e) {
-      LOG(ERROR) << "Failed on scrape of target " << target.first << ": "
-                 << e.what();
+    targets.push_back(&target);
+  }
+
+  std::atomic<size_t> next{0};
+  auto worker = [&]() {
+    for (auto i = next++; i < targets.size(); i = next++) {
+      auto& target = *targets[i];
+      auto client = takeClient(target.first, timeoutS);
+      try {
+        http::Request request(target.first);
+        http::Response response(client->get(request));
+
+        target.second.timestampMS =
+            std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch());
+        target.second.content = response.body();
+        returnClient(target.first, std::move(client), timeoutS);
+      } catch (std::exception& e) {
+        LOG(ERROR) << "Failed on scrape of target " << target.first << ": "
+                   << e.what();
+      }
     }
+  };
+
+  auto workers = std::min(
+      static_cast<size_t>(std::max(FLAGS_prometheus_scrape_workers, 1U)),
+      targets.size());
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < workers; ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
   }
+
+  pruneClients(scrapeResults);
 }
 
 QueryData genPrometheusMetrics(QueryContext& context) {
@@ -109,9 +218,13 @@ QueryData genPrometheusMetrics(QueryContext& context) {
   size_t timeout =
       (!config.HasMember("timeout")) ? 1 : config["timeout"].GetUint64();
   scrapeTargets(sr, timeout);
-  parseScrapeResults(sr, result);
+  for (auto& target : sr) {
+    // Each response is released once its rows are emitted.
+    parseScrapeResult(target.first, target.second, result);
+    std::string().swap(target.second.content);
+  }
 
   return result;
 }
-}
-}
+} // namespace tables
+} // namespace osquery
@@ -29,6 +29,11 @@ struct PrometheusResponseData {
   std::chrono::milliseconds timestampMS;
 };
 
+/// Parse the payload of one scraped target into rows.
+void parseScrapeResult(const std::string& target,
+                       const PrometheusResponseData& result,
+                       QueryData& rows);
+
 /**
  * @brief parse raw payload returned by scraped targets into QueryData.
  *
@@ -44,6 +49,9 @@ void parseScrapeResults(
  * @brief Scrapes the Prometheus targets and returns response payload and
  * timestamp.
  *
+ * Up to prometheus_scrape_workers targets are scraped concurrently, and the
+ * connection to each target is kept alive for the next scrape.
+ *
  * @param scrapeResults map where the key is the target url to be scraped and
  * value is the struct PrometheusResponseData where payload and timestamp are to
  * be written to.
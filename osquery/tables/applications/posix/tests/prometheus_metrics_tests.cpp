@@ -103,6 +103,31 @@ TEST_F(PrometheusMetricsTest, happy_path_extra_spaces_lines) {
   validate(sr, expected);
 }
 
+TEST_F(PrometheusMetricsTest, happy_path_crlf_tabs_labels) {
+  std::chrono::milliseconds now(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::system_clock::now().time_since_epoch()));
+  PrometheusResponseData r0 = PrometheusResponseData{
+      "# TYPE http_requests_total counter\r\n"
+      "http_requests_total{code=\"200\"}\t1027 1395066363000\r\n"
+      "up 1",
+      now};
+  std::map<std::string, PrometheusResponseData> sr = {{"example1.com", r0}};
+
+  QueryData expected = {
+      {{kColTargetName, "example1.com"},
+       {kColMetric, "http_requests_total{code=\"200\"}"},
+       {kColValue, "1027"},
+       {kColTimeStamp, std::to_string(now.count())}},
+      {{kColTargetName, "example1.com"},
+       {kColMetric, "up"},
+       {kColValue, "1"},
+       {kColTimeStamp, std::to_string(now.count())}},
+  };
+
+  validate(sr, expected);
+}
+
 TEST_F(PrometheusMetricsTest, happy_path_10_metrics_1_target) {
   // Initialize stubbed scrape results.
   std::chrono::milliseconds now(
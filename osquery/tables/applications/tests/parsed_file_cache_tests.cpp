@@ -0,0 +1,106 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <gtest/gtest.h>
+
+#include <boost/filesystem.hpp>
+
+#include <osquery/filesystem/filesystem.h>
+#include <osquery/tables/applications/parsed_file_cache.h>
+
+namespace fs = boost::filesystem;
+
+namespace osquery {
+
+namespace tables {
+
+class ParsedFileCacheTests : public testing::Test {
+ protected:
+  void SetUp() override {
+    directory_ =
+        fs::temp_directory_path() / fs::unique_path("osquery.pfc.%%%%.%%%%");
+    fs::create_directories(directory_);
+  }
+
+  void TearDown() override {
+    fs::remove_all(directory_);
+  }
+
+  std::string createFile(const std::string& name,
+                         const std::string& content) {
+    auto path = (directory_ / name).string();
+    EXPECT_TRUE(writeTextFile(path, content).ok());
+    return path;
+  }
+
+  fs::path directory_;
+};
+
+TEST_F(ParsedFileCacheTests, test_get_unchanged) {
+  ParsedFileCache<std::string> cache(16);
+  size_t parses = 0;
+  auto parse = [&parses](const std::string& content, std::string& value) {
+    ++parses;
+    value = content;
+    return Status::success();
+  };
+
+  auto path = createFile("manifest.json", "first");
+  ParsedFileCache<std::string>::Value value;
+  ASSERT_TRUE(cache.get(path, parse, value).ok());
+  EXPECT_EQ(*value, "first");
+  ASSERT_TRUE(cache.get(path, parse, value).ok());
+  EXPECT_EQ(*value, "first");
+  EXPECT_EQ(parses, 1U);
+
+  // A change of size is parsed again.
+  ASSERT_TRUE(writeTextFile(path, "changed").ok());
+  ASSERT_TRUE(cache.get(path, parse, value).ok());
+  EXPECT_EQ(*value, "changed");
+  EXPECT_EQ(parses, 2U);
+}
+
+TEST_F(ParsedFileCacheTests, test_get_failures) {
+  ParsedFileCache<std::string> cache(16);
+  size_t parses = 0;
+  auto parse = [&parses](const std::string& content, std::string& value) {
+    ++parses;
+    return Status::failure("invalid");
+  };
+
+  ParsedFileCache<std::string>::Value value;
+  EXPECT_FALSE(cache.get((directory_ / "missing").string(), parse, value).ok());
+  EXPECT_EQ(parses, 0U);
+
+  // Files that cannot be parsed are not kept.
+  auto path = createFile("invalid.json", "{");
+  EXPECT_FALSE(cache.get(path, parse, value).ok());
+  EXPECT_FALSE(cache.get(path, parse, value).ok());
+  EXPECT_EQ(value, nullptr);
+  EXPECT_EQ(parses, 2U);
+  EXPECT_EQ(cache.size(), 0U);
+}
+
+TEST_F(ParsedFileCacheTests, test_get_evicts) {
+  ParsedFileCache<std::string> cache(2);
+  auto parse = [](const std::string& content, std::string& value) {
+    value = content;
+    return Status::success();
+  };
+
+  ParsedFileCache<std::string>::Value value;
+  for (const auto& name : {"a", "b", "c"}) {
+    ASSERT_TRUE(cache.get(createFile(name, name), parse, value).ok());
+  }
+  EXPECT_EQ(cache.size(), 2U);
+}
+
+} // namespace tables
+
+} // namespace osquery
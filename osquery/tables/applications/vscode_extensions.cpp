@@ -15,6 +15,7 @@
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
+#include <osquery/tables/applications/parsed_file_cache.h>
 #include <osquery/tables/system/system_utils.h>
 #include <osquery/utils/json/json.h>
 
@@ -23,23 +24,19 @@ namespace fs = boost::filesystem;
 namespace osquery {
 namespace tables {
 
-void genReadJSONAndAddExtensionRows(const std::string& uid,
-                                    const std::string& path,
-                                    QueryData& results) {
-  if (!pathExists(path).ok()) {
-    return;
-  }
+namespace {
 
-  std::string json;
-  if (!readFile(path, json).ok()) {
-    LOG(INFO) << "Could not read vscode extensions.json from " << path;
-    return;
-  }
+/// Extensions files kept parsed, two for each user.
+const size_t kMaxCachedExtensionFiles = 1024;
 
+/// Parse the extensions of an extensions.json file, the rows have no uid.
+Status parseVSCodeExtensions(const std::string& path,
+                             const std::string& json,
+                             QueryData& extension_rows) {
   auto doc = JSON::newArray();
   if (!doc.fromString(json) || !doc.doc().IsArray()) {
-    LOG(WARNING) << "Could not parse vscode extensions.json from " << path;
-    return;
+    return Status::failure("Could not parse vscode extensions.json from " +
+                           path);
   }
 
   for (const rapidjson::Value& extension : doc.doc().GetArray()) {
@@ -58,7 +55,6 @@ void genReadJSONAndAddExtensionRows(const std::string& uid,
     }
 
     Row r;
-    r["uid"] = uid;
 
     rapidjson::Value::ConstMemberIterator it = identifier.FindMember("id");
     if (it != identifier.MemberEnd() && it->value.IsString()) {
@@ -100,7 +96,44 @@ void genReadJSONAndAddExtensionRows(const std::string& uid,
       r["prerelease"] = INTEGER(it->value.GetBool() ? "1" : "0");
     }
 
-    results.push_back(r);
+    extension_rows.push_back(std::move(r));
+  }
+
+  return Status::success();
+}
+
+/// Extensions of the extensions.json files, unchanged files are parsed once.
+ParsedFileCache<QueryData>& getVSCodeExtensionsCache() {
+  static ParsedFileCache<QueryData> cache(kMaxCachedExtensionFiles);
+  return cache;
+}
+} // namespace
+
+void genReadJSONAndAddExtensionRows(const std::string& uid,
+                                    const std::string& path,
+                                    QueryData& results) {
+  if (!pathExists(path).ok()) {
+    return;
+  }
+
+  ParsedFileCache<QueryData>::Value extension_rows;
+  auto status = getVSCodeExtensionsCache().get(
+      path,
+      [&path](const std::string& json, QueryData& rows) {
+        return parseVSCodeExtensions(path, json, rows);
+      },
+      extension_rows);
+
+  if (!status.ok()) {
+    LOG(INFO) << "Could not load vscode extensions.json from " << path << ": "
+              << status.getMessage();
+    return;
+  }
+
+  for (const auto& extension_row : *extension_rows) {
+    Row r = extension_row;
+    r["uid"] = uid;
+    results.push_back(std::move(r));
   }
 }
 
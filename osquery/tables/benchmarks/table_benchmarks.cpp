@@ -0,0 +1,304 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <osquery/core/tables.h>
+#include <osquery/filesystem/filesystem.h>
+#include <osquery/profiler/resource_usage.h>
+#include <osquery/registry/registry_factory.h>
+
+#ifdef OSQUERY_LINUX
+#include <osquery/tables/system/linux/apt_sources.h>
+#include <osquery/tables/system/linux/md_tables.h>
+#endif
+
+namespace fs = boost::filesystem;
+
+namespace {
+
+/// Allocations of the benchmark binary, counted by the operators below.
+std::atomic<std::uint64_t> gAllocations{0};
+std::atomic<std::uint64_t> gAllocatedBytes{0};
+
+} // namespace
+
+void* operator new(std::size_t size) {
+  gAllocations.fetch_add(1, std::memory_order_relaxed);
+  gAllocatedBytes.fetch_add(size, std::memory_order_relaxed);
+  if (auto p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+  std::free(p);
+}
+
+namespace osquery {
+
+namespace {
+
+/// The files of each directory of a fixture tree.
+const size_t kFixtureFilesPerDirectory{100};
+
+/**
+ * @brief Fixture trees of a given number of files, created once per size.
+ *
+ * No captured filesystems ship with the tree, the fixtures are generated
+ * deterministically: directories of kFixtureFilesPerDirectory files of a
+ * few KiB each, like a configuration or package directory.
+ */
+class FixtureTrees {
+ public:
+  ~FixtureTrees() {
+    boost::system::error_code ec;
+    for (const auto& tree : trees_) {
+      fs::remove_all(tree.second, ec);
+    }
+  }
+
+  const fs::path& get(size_t files) {
+    auto it = trees_.find(files);
+    if (it != trees_.end()) {
+      return it->second;
+    }
+
+    auto root = fs::temp_directory_path() /
+                fs::unique_path("osquery.benchmarks.%%%%.%%%%");
+    for (size_t i = 0; i < files; ++i) {
+      auto directory =
+          root / ("d" + std::to_string(i / kFixtureFilesPerDirectory));
+      if (i % kFixtureFilesPerDirectory == 0) {
+        fs::create_directories(directory);
+      }
+      std::string content(1024 + (i * 131) % 4096, 'a' + (i % 26));
+      writeTextFile(directory / ("f" + std::to_string(i) + ".conf"), content);
+    }
+    return trees_.emplace(files, root).first->second;
+  }
+
+  /// The directories of a tree.
+  std::vector<std::string> directories(size_t files) {
+    std::vector<std::string> directories;
+    const auto& root = get(files);
+    for (size_t i = 0; i * kFixtureFilesPerDirectory < files; ++i) {
+      directories.push_back((root / ("d" + std::to_string(i))).string());
+    }
+    return directories;
+  }
+
+ private:
+  std::map<size_t, fs::path> trees_;
+};
+
+FixtureTrees& fixtures() {
+  static FixtureTrees trees;
+  return trees;
+}
+
+/**
+ * @brief Report the cost of generating a table, besides its time.
+ *
+ * The allocations and allocated bytes per iteration, the rows per
+ * iteration and the resident memory high-water mark are reported as
+ * counters.
+ */
+class TableCost {
+ public:
+  TableCost()
+      : allocations_(gAllocations.load()), bytes_(gAllocatedBytes.load()) {
+    sample();
+  }
+
+  void sample() {
+    ResourceUsage usage;
+    if (getResourceUsage(usage, false).ok()) {
+      rss_max_ = std::max(rss_max_, usage.resident_size);
+    }
+  }
+
+  void report(benchmark::State& state, size_t rows) {
+    sample();
+    auto iterations =
+        static_cast<double>(std::max<size_t>(state.iterations(), 1));
+    state.counters["allocs"] =
+        static_cast<double>(gAllocations.load() - allocations_) / iterations;
+    state.counters["alloc_kb"] =
+        static_cast<double>(gAllocatedBytes.load() - bytes_) / 1024 /
+        iterations;
+    state.counters["rows"] = static_cast<double>(rows) / iterations;
+    state.counters["rss_max_mb"] =
+        static_cast<double>(rss_max_) / (1024 * 1024);
+  }
+
+ private:
+  std::uint64_t allocations_{0};
+  std::uint64_t bytes_{0};
+  std::uint64_t rss_max_{0};
+};
+
+/// Generate the rows of a registered table, returning how many it produced.
+size_t generateTable(TablePlugin& table, QueryContext& context) {
+  if (!table.usesGenerator()) {
+    return table.generate(context).size();
+  }
+
+  size_t rows = 0;
+  RowGenerator::pull_type generator(
+      [&table, &context](RowYield& yield) { table.generator(yield, context); });
+  for (auto& row : generator) {
+    (void)row;
+    ++rows;
+  }
+  return rows;
+}
+
+/// Run a table's generate for each iteration, reporting its cost.
+void benchmarkTable(benchmark::State& state,
+                    const std::string& name,
+                    QueryContext& context) {
+  auto table = std::dynamic_pointer_cast<TablePlugin>(
+      RegistryFactory::get().plugin("table", name));
+  if (table == nullptr) {
+    state.SkipWithError(("The table is not registered: " + name).c_str());
+    return;
+  }
+
+  // The first generation warms the page cache, as a scheduled query would.
+  generateTable(*table, context);
+
+  TableCost cost;
+  size_t rows = 0;
+  while (state.KeepRunning()) {
+    rows += generateTable(*table, context);
+    cost.sample();
+  }
+  cost.report(state, rows);
+}
+
+void applyFixtureSizes(benchmark::internal::Benchmark* b) {
+  b->Arg(100)->Arg(1000)->Arg(10000)->Unit(benchmark::kMillisecond);
+}
+
+} // namespace
+
+/// Stat every file of a tree selected with a LIKE pattern.
+static void TABLE_file_like(benchmark::State& state) {
+  auto files = static_cast<size_t>(state.range(0));
+  QueryContext context;
+  context.constraints["path"].add(
+      Constraint(LIKE, (fixtures().get(files) / "%" / "%.conf").string()));
+  benchmarkTable(state, "file", context);
+}
+
+BENCHMARK(TABLE_file_like)->Apply(applyFixtureSizes);
+
+/// Stat every file of the directories of a tree.
+static void TABLE_file_directory(benchmark::State& state) {
+  auto files = static_cast<size_t>(state.range(0));
+  QueryContext context;
+  for (const auto& directory : fixtures().directories(files)) {
+    context.constraints["directory"].add(Constraint(EQUALS, directory));
+  }
+  benchmarkTable(state, "file", context);
+}
+
+BENCHMARK(TABLE_file_directory)->Apply(applyFixtureSizes);
+
+/// Hash every file of the directories of a tree.
+static void TABLE_hash_directory(benchmark::State& state) {
+  auto files = static_cast<size_t>(state.range(0));
+  QueryContext context;
+  for (const auto& directory : fixtures().directories(files)) {
+    context.constraints["directory"].add(Constraint(EQUALS, directory));
+  }
+  benchmarkTable(state, "hash", context);
+}
+
+BENCHMARK(TABLE_hash_directory)->Apply(applyFixtureSizes);
+
+#ifdef OSQUERY_LINUX
+/// Generate the processes of the running system, /proc is not redirected.
+static void TABLE_processes(benchmark::State& state) {
+  QueryContext context;
+  benchmarkTable(state, "processes", context);
+}
+
+BENCHMARK(TABLE_processes)->Unit(benchmark::kMillisecond);
+
+/// Parse an mdstat capture of a host with the given number of arrays.
+static void TABLE_md_devices_parse_mdstat(benchmark::State& state) {
+  std::vector<std::string> lines = {
+      "Personalities : [raid1] [raid10] [linear] [multipath] [raid0] [raid6] "
+      "[raid5] [raid4]",
+  };
+  for (int64_t i = 0; i < state.range(0); ++i) {
+    lines.push_back("md" + std::to_string(i) +
+                    " : active raid10 sde2[4] sdd2[3] sdc2[6] sdb2[7] sda2[0]");
+    lines.push_back(
+        "4687296000 blocks super 1.2 512K chunks 2 near-copies [6/5] "
+        "[UUUUU_]");
+    lines.push_back("");
+  }
+  lines.push_back("unused devices: <none>");
+
+  tables::MD md;
+  TableCost cost;
+  size_t devices = 0;
+  while (state.KeepRunning()) {
+    tables::MDStat result;
+    md.parseMDStat(lines, result);
+    devices += result.devices.size();
+  }
+  cost.report(state, devices);
+}
+
+BENCHMARK(TABLE_md_devices_parse_mdstat)->Arg(4)->Arg(64)->Arg(1024);
+
+/// Parse an apt sources capture with the given number of entries.
+static void TABLE_apt_sources_parse(benchmark::State& state) {
+  std::vector<std::string> lines;
+  for (int64_t i = 0; i < state.range(0); ++i) {
+    lines.push_back("deb [arch=amd64] http://mirror" + std::to_string(i) +
+                    ".example.com/ubuntu focal main restricted universe");
+  }
+
+  TableCost cost;
+  size_t sources = 0;
+  while (state.KeepRunning()) {
+    for (const auto& line : lines) {
+      tables::AptSource source;
+      if (tables::parseAptSourceLine(line, source).ok()) {
+        ++sources;
+      }
+    }
+  }
+  cost.report(state, sources);
+}
+
+BENCHMARK(TABLE_apt_sources_parse)->Arg(10)->Arg(1000);
+#endif
+
+} // namespace osquery
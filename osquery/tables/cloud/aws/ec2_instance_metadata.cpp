@@ -17,6 +17,7 @@
 
 #include <osquery/core/tables.h>
 #include <osquery/logger/logger.h>
+#include <osquery/remote/metadata_cache.h>
 #include <osquery/utils/aws/aws_util.h>
 
 namespace pt = boost::property_tree;
@@ -136,48 +137,64 @@ class JSONEc2MetaData : public Ec2MetaData {
 boost::optional<std::string> Ec2MetaData::doGet() const {
   const static std::string ec2_metadata_url{kEc2MetadataUrl};
 
-  auto opt_token = getIMDSToken();
-  http::Request req(ec2_metadata_url + url_suffix_);
-
-  if (opt_token.has_value()) {
-    req << http::Request::Header(kImdsTokenHeader, *opt_token);
-  } else if (FLAGS_aws_disable_imdsv1_fallback) {
-    /* If the IMDSv2 token cannot be retrieved and we disabled IMDSv1,
-       we cannot attempt to do a request, so return with empty results. */
-    VLOG(1) << "Could not retrieve an IMDSv2 token to request the instance id "
-               "and region. The IMDSv1 fallback is disabled";
-    return {};
-  }
-
-  http::Client::Options options;
-  options.timeout(3);
-  http::Client client(options);
-
-  try {
-    http::Response res = client.get(req);
-    boost::uint16_t http_status_code = res.status();
-
-    // Don't consider 404 an error, but log it
-    if (http_status_code == 404) {
-      VLOG(1) << "The metadata service " << url_suffix_
-              << " could not be found";
-      return std::string();
+  auto fetch = [this](std::string& body) {
+    auto opt_token = getIMDSToken();
+    http::Request req(ec2_metadata_url + url_suffix_);
+
+    if (opt_token.has_value()) {
+      req << http::Request::Header(kImdsTokenHeader, *opt_token);
+    } else if (FLAGS_aws_disable_imdsv1_fallback) {
+      /* If the IMDSv2 token cannot be retrieved and we disabled IMDSv1,
+         we cannot attempt to do a request, so return with empty results. */
+      VLOG(1) << "Could not retrieve an IMDSv2 token to request the instance "
+                 "id and region. The IMDSv1 fallback is disabled";
+      return Status::failure("No IMDSv2 token");
     }
 
-    // Log "hard" errors
-    if (http_status_code != 200) {
-      VLOG(1) << "Unexpected HTTP response for: " << url_suffix_
-              << " Status: " << http_status_code;
-      return boost::none;
+    http::Client::Options options;
+    options.timeout(3);
+    http::Client client(options);
+
+    try {
+      http::Response res = client.get(req);
+      boost::uint16_t http_status_code = res.status();
+
+      // Don't consider 404 an error, but log it
+      if (http_status_code == 404) {
+        VLOG(1) << "The metadata service " << url_suffix_
+                << " could not be found";
+        body.clear();
+        return Status::success();
+      }
+
+      // An expired or revoked token is requested again by the next query.
+      if (http_status_code == 401 && opt_token.has_value()) {
+        invalidateIMDSToken();
+      }
+
+      // Log "hard" errors
+      if (http_status_code != 200) {
+        VLOG(1) << "Unexpected HTTP response for: " << url_suffix_
+                << " Status: " << http_status_code;
+        return Status::failure("Unexpected HTTP response");
+      }
+
+      body = res.body();
+      return Status::success();
+    } catch (std::system_error& e) {
+      VLOG(1) << "Request for " << url_suffix_ << " failed: " << e.what();
+      return Status::failure(e.what());
     }
+  };
 
-    return res.body();
-  } catch (std::system_error& e) {
-    VLOG(1) << "Request for " << url_suffix_ << " failed: " << e.what();
+  // The metadata columns of concurrent queries share their requests.
+  std::string body;
+  auto status = MetadataCache::get().lookup(
+      "aws:" + url_suffix_, getMetadataCacheTTL(), fetch, body);
+  if (!status.ok()) {
     return boost::none;
   }
-
-  return std::string();
+  return body;
 }
 
 void setRowField(const ColumnType sql_type,
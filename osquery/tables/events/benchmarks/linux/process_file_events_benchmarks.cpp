@@ -0,0 +1,115 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <osquery/tables/events/linux/process_file_events.h>
+
+namespace osquery {
+
+namespace {
+
+/// A syscall of the audit stream, as it reaches the FIM state
+struct FimStreamEntry final {
+  enum class Type { Open, Read, Close, Clone };
+
+  Type type;
+  pid_t process_id;
+  std::uint64_t fd;
+  ino_t inode;
+};
+
+/**
+ * @brief Builds an audit stream shaped like a busy build host.
+ *
+ * Short-lived processes are cloned from a few long-lived ones, open a set
+ * of files, read them and close them again.
+ */
+std::vector<FimStreamEntry> generateFimStream(std::size_t process_count) {
+  std::vector<FimStreamEntry> stream;
+
+  std::uint64_t state = 1U;
+  auto next = [&state]() {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return state >> 33U;
+  };
+
+  for (std::size_t i = 0U; i < process_count; ++i) {
+    auto parent = static_cast<pid_t>(100 + (i % 8U));
+    auto child = static_cast<pid_t>(1000 + (i % 30000U));
+    stream.push_back({FimStreamEntry::Type::Clone, parent, 0U, child});
+
+    auto file_count = 4U + next() % 28U;
+    for (std::uint64_t fd = 3U; fd < 3U + file_count; ++fd) {
+      auto inode = static_cast<ino_t>(next() % 50000U);
+      stream.push_back({FimStreamEntry::Type::Open, child, fd, inode});
+      stream.push_back({FimStreamEntry::Type::Read, child, fd, inode});
+    }
+
+    for (std::uint64_t fd = 3U; fd < 3U + file_count; ++fd) {
+      stream.push_back({FimStreamEntry::Type::Close, child, fd, 0U});
+    }
+  }
+
+  return stream;
+}
+
+void replayFimStream(AuditdFimContext& context,
+                     const std::vector<FimStreamEntry>& stream) {
+  for (const auto& entry : stream) {
+    switch (entry.type) {
+    case FimStreamEntry::Type::Clone:
+      if (!context.process_map.clone(entry.process_id,
+                                     static_cast<pid_t>(entry.inode))) {
+        context.process_map.create(static_cast<pid_t>(entry.inode));
+      }
+      break;
+
+    case FimStreamEntry::Type::Open:
+      context.process_map.save(entry.fd, entry.process_id, entry.inode);
+      context.inode_map.save(
+          entry.inode, AuditdFimInodeDescriptor::Type::File, "/usr/include");
+      break;
+
+    case FimStreamEntry::Type::Read: {
+      AuditdFimFdDescriptor* fd_desc = nullptr;
+      AuditdFimInodeDescriptor* ino_desc = nullptr;
+      if (context.process_map.getReference(
+              fd_desc, entry.process_id, entry.fd)) {
+        context.inode_map.getReference(ino_desc, fd_desc->inode);
+      }
+      break;
+    }
+
+    case FimStreamEntry::Type::Close: {
+      AuditdFimFdDescriptor fd_desc;
+      context.process_map.takeAndRemove(fd_desc, entry.process_id, entry.fd);
+      break;
+    }
+    }
+  }
+}
+
+} // namespace
+
+static void PROCESS_FILE_EVENTS_replay(benchmark::State& state) {
+  auto stream = generateFimStream(static_cast<std::size_t>(state.range(0)));
+
+  while (state.KeepRunning()) {
+    AuditdFimContext context;
+    replayFimStream(context, stream);
+  }
+
+  state.SetItemsProcessed(state.iterations() *
+                          static_cast<std::int64_t>(stream.size()));
+}
+
+BENCHMARK(PROCESS_FILE_EVENTS_replay)->Arg(1000)->Arg(10000);
+
+} // namespace osquery
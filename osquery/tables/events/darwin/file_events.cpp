@@ -18,9 +18,13 @@
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry_factory.h>
 #include <osquery/tables/events/event_utils.h>
+#include <osquery/utils/system/time.h>
 
 namespace osquery {
 
+DECLARE_uint32(file_events_hash_workers);
+DECLARE_uint32(file_events_hash_queue);
+
 extern const std::set<std::string> kCommonFileColumns;
 
 /**
@@ -31,12 +35,28 @@ extern const std::set<std::string> kCommonFileColumns;
 class FileEventSubscriber : public EventSubscriber<FSEventsEventPublisher> {
  public:
   Status init() override {
+    if (FLAGS_file_events_hash_workers > 0 && hash_queue_ == nullptr) {
+      hash_queue_ = FileHashQueue::create(
+          [this](std::vector<Row>& rows, EventTime time) {
+            addBatch(rows, time);
+          },
+          FLAGS_file_events_hash_workers,
+          FLAGS_file_events_hash_queue);
+    }
     return Status(0);
   }
 
   /// Walk the configuration's file paths, create subscriptions.
   void configure() override;
 
+  /// Rows waiting for their hashes are stored before a query reads events.
+  void genTable(RowYield& yield, QueryContext& ctx) override {
+    if (hash_queue_ != nullptr) {
+      hash_queue_->flush();
+    }
+    EventSubscriber::genTable(yield, ctx);
+  }
+
   /**
    * @brief This exports a single Callback for INotifyEventPublisher events.
    *
@@ -47,6 +67,10 @@ class FileEventSubscriber : public EventSubscriber<FSEventsEventPublisher> {
    */
   Status Callback(const FSEventsEventContextRef& ec,
                   const FSEventsSubscriptionContextRef& sc);
+
+ private:
+  /// Hashes event targets off the publisher thread, if workers are enabled.
+  std::shared_ptr<FileHashQueue> hash_queue_;
 };
 
 /**
@@ -102,8 +126,15 @@ Status FileEventSubscriber::Callback(const FSEventsEventContextRef& ec,
   r["transaction_id"] = INTEGER(ec->transaction_id);
 
   // Add hashing and 'join' against the file table for stat-information.
-  decorateFileEvent(
-      ec->path, (ec->action == "CREATED" || ec->action == "UPDATED"), r);
+  bool hash = (ec->action == "CREATED" || ec->action == "UPDATED");
+  decorateFileEvent(ec->path, hash && hash_queue_ == nullptr, r);
+  if (hash && hash_queue_ != nullptr) {
+    if (hash_queue_->push(ec->path, r, getUnixTime())) {
+      return Status::success();
+    }
+    // The queue is full, hash within the callback.
+    hashFileEvent(ec->path, r);
+  }
 
   add(r);
   return Status::success();
@@ -7,17 +7,59 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <chrono>
+
 #include <osquery/sql/sql.h>
 
-#include <osquery/hashing/hashing.h>
+#include <osquery/core/flags.h>
+#include <osquery/dispatcher/dispatcher.h>
 #include <osquery/tables/events/event_utils.h>
 
 namespace osquery {
 
+FLAG(uint32,
+     file_events_hash_workers,
+     0,
+     "Threads hashing file_events targets (0 hashes in the event callback)");
+
+FLAG(uint32,
+     file_events_hash_queue,
+     4096,
+     "Most file_events target paths waiting for a hash worker");
+
 const std::set<std::string> kCommonFileColumns = {
     "inode", "uid", "gid", "mode", "size", "atime", "mtime", "ctime",
 };
 
+namespace {
+
+/// Time a hash worker waits before checking an empty queue again.
+const std::chrono::milliseconds kFileHashQueueInterval{100};
+
+/// Hashes the paths of a FileHashQueue.
+class FileHashWorker : public InternalRunnable {
+ public:
+  explicit FileHashWorker(std::shared_ptr<FileHashQueue> queue)
+      : InternalRunnable("FileHashWorker", ThreadClass::Worker),
+        queue_(std::move(queue)) {}
+
+  void start() override {
+    while (!interrupted()) {
+      if (!queue_->process()) {
+        pause(kFileHashQueueInterval);
+      }
+    }
+
+    // Rows queued before the interruption are not lost.
+    queue_->flush();
+  }
+
+ private:
+  std::shared_ptr<FileHashQueue> queue_;
+};
+
+} // namespace
+
 void decorateFileEvent(const std::string& path, bool hash, Row& r) {
   auto results = SQL::selectAllFrom("file", "path", EQUALS, path);
   if (results.size() == 1) {
@@ -30,16 +72,96 @@ void decorateFileEvent(const std::string& path, bool hash, Row& r) {
   }
 
   if (hash) {
-    auto hashes = hashMultiFromFile(
-        HASH_TYPE_MD5 | HASH_TYPE_SHA1 | HASH_TYPE_SHA256, path);
-    r["md5"] = std::move(hashes.md5);
-    r["sha1"] = std::move(hashes.sha1);
-    r["sha256"] = std::move(hashes.sha256);
-    // Hashed determines the success/status of hashing, -1 failed, 1 success.
-    r["hashed"] = (r.at("md5").empty()) ? "-1" : "1";
+    hashFileEvent(path, r);
   } else {
     // Alternatively if hashing wasn't needed hashed is a 0.
     r["hashed"] = "0";
   }
 }
+
+void hashFileEvent(const std::string& path, Row& r) {
+  auto results =
+      SQL::selectFrom({"md5", "sha1", "sha256"}, "hash", "path", EQUALS, path);
+  if (results.size() == 1) {
+    auto& row = results.at(0);
+    r["md5"] = std::move(row["md5"]);
+    r["sha1"] = std::move(row["sha1"]);
+    r["sha256"] = std::move(row["sha256"]);
+  } else {
+    r["md5"] = "";
+    r["sha1"] = "";
+    r["sha256"] = "";
+  }
+
+  // Hashed determines the success/status of hashing, -1 failed, 1 success.
+  r["hashed"] = (r.at("md5").empty()) ? "-1" : "1";
+}
+
+std::shared_ptr<FileHashQueue> FileHashQueue::create(Sink sink,
+                                                     size_t workers,
+                                                     size_t capacity) {
+  auto queue = std::make_shared<FileHashQueue>(std::move(sink), capacity);
+  for (size_t i = 0; i < workers; i++) {
+    Dispatcher::addService(std::make_shared<FileHashWorker>(queue));
+  }
+  return queue;
+}
+
+bool FileHashQueue::push(const std::string& path, Row& r, EventTime time) {
+  WriteLock lock(mutex_);
+  auto rows = pending_.find(path);
+  if (rows == pending_.end()) {
+    if (order_.size() >= capacity_) {
+      return false;
+    }
+    order_.push_back(path);
+    rows = pending_.emplace(path, PendingRows()).first;
+  }
+  rows->second.emplace_back(time, std::move(r));
+  return true;
+}
+
+bool FileHashQueue::process() {
+  std::string path;
+  PendingRows rows;
+  {
+    WriteLock lock(mutex_);
+    if (order_.empty()) {
+      return false;
+    }
+    path = std::move(order_.front());
+    order_.pop_front();
+    auto pending = pending_.find(path);
+    rows = std::move(pending->second);
+    pending_.erase(pending);
+  }
+
+  // Events queued while the path is hashed will hash it again.
+  Row hashes;
+  hashFileEvent(path, hashes);
+
+  // Rows sharing an event time are stored together, in the order queued.
+  std::map<EventTime, std::vector<Row>> batches;
+  for (auto& row : rows) {
+    for (const auto& column : hashes) {
+      row.second[column.first] = column.second;
+    }
+    batches[row.first].push_back(std::move(row.second));
+  }
+
+  for (auto& batch : batches) {
+    sink_(batch.second, batch.first);
+  }
+  return true;
+}
+
+void FileHashQueue::flush() {
+  while (process()) {
+  }
+}
+
+size_t FileHashQueue::size() const {
+  ReadLock lock(mutex_);
+  return order_.size();
 }
+} // namespace osquery
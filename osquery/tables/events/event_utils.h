@@ -9,10 +9,20 @@
 
 #pragma once
 
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
 #include <set>
 #include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
 
 #include <osquery/core/tables.h>
+#include <osquery/events/types.h>
+#include <osquery/utils/mutex.h>
 
 namespace osquery {
 
@@ -30,4 +40,74 @@ extern const std::set<std::string> kCommonFileColumns;
  * @param r The output parameter row structure.
  */
 void decorateFileEvent(const std::string& path, bool hash, Row& r);
-}
+
+/**
+ * @brief Add the hash columns of a file event's target path.
+ *
+ * Hashes are read from the `hash` table, which uses its in-memory and
+ * persisted hash caches.
+ */
+void hashFileEvent(const std::string& path, Row& r);
+
+/**
+ * @brief Hashes the targets of file events on worker threads.
+ *
+ * Rows waiting for a hash are queued by path. Rows of a path that is already
+ * queued join it, and the path is hashed once when a worker takes it, so a
+ * burst of writes to a file only hashes its latest contents. Once hashed the
+ * rows are passed to the sink with their event times.
+ */
+class FileHashQueue : private boost::noncopyable {
+ public:
+  /// Stores rows of file events that happened at the same time.
+  using Sink = std::function<void(std::vector<Row>& rows, EventTime time)>;
+
+  /**
+   * @brief Create a queue, rows are hashed when process or flush are called.
+   *
+   * @param sink receives the hashed rows.
+   * @param capacity the most paths waiting to be hashed.
+   */
+  FileHashQueue(Sink sink, size_t capacity)
+      : sink_(std::move(sink)), capacity_(capacity) {}
+
+  /// Create a queue and start worker services processing it.
+  static std::shared_ptr<FileHashQueue> create(Sink sink,
+                                               size_t workers,
+                                               size_t capacity);
+
+  /**
+   * @brief Queue the row of a file event to be hashed, the row is moved.
+   *
+   * @return false if the queue is full, the caller should hash the row.
+   */
+  bool push(const std::string& path, Row& r, EventTime time);
+
+  /// Hash and store the oldest queued path, returns false if none is queued.
+  bool process();
+
+  /// Hash and store every queued path on the calling thread.
+  void flush();
+
+  /// The number of paths waiting to be hashed.
+  size_t size() const;
+
+ private:
+  /// Rows, and their event times, waiting for the hash of a path.
+  using PendingRows = std::vector<std::pair<EventTime, Row>>;
+
+  /// Receives the hashed rows.
+  Sink sink_;
+
+  /// The most paths waiting to be hashed.
+  size_t capacity_{0};
+
+  /// Queued paths, oldest first.
+  std::deque<std::string> order_;
+
+  /// The rows of each queued path.
+  std::map<std::string, PendingRows> pending_;
+
+  mutable Mutex mutex_;
+};
+} // namespace osquery
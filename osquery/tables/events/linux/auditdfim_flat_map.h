@@ -0,0 +1,206 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace osquery {
+
+/**
+ * @brief An open addressing hash table for the audit FIM state.
+ *
+ * The entries are stored inline in a single slot array with linear probing,
+ * so the open/close records do not allocate a node each. Erased entries are
+ * filled by shifting the following entries back, no tombstones are left.
+ * The slot array is owned by the table and released with it.
+ *
+ * Pointers returned by find() are invalidated by any insertion or erase.
+ */
+template <typename Key, typename Value>
+class AuditdFimFlatMap final {
+ public:
+  /// Returns the value for the key, or nullptr
+  Value* find(Key key) {
+    auto index = lookup(key);
+    return index != kNotFound ? &slots_[index]->second : nullptr;
+  }
+
+  /// Inserts a new entry, an existing value is kept
+  bool insert(Key key, Value value) {
+    if (lookup(key) != kNotFound) {
+      return false;
+    }
+
+    reserveOne();
+    place(key, std::move(value));
+    return true;
+  }
+
+  /// Inserts a new entry or replaces the existing value
+  void assign(Key key, Value value) {
+    auto index = lookup(key);
+    if (index != kNotFound) {
+      slots_[index]->second = std::move(value);
+      return;
+    }
+
+    reserveOne();
+    place(key, std::move(value));
+  }
+
+  /// Removes the entry and moves its value out
+  bool take(Key key, Value& value) {
+    auto index = lookup(key);
+    if (index == kNotFound) {
+      return false;
+    }
+
+    value = std::move(slots_[index]->second);
+    eraseSlot(index);
+    return true;
+  }
+
+  /// Removes the entry
+  bool erase(Key key) {
+    auto index = lookup(key);
+    if (index == kNotFound) {
+      return false;
+    }
+
+    eraseSlot(index);
+    return true;
+  }
+
+  /// Removes one entry, picked by a cursor walking the slots
+  void evictOne() {
+    if (size_ == 0U) {
+      return;
+    }
+
+    auto mask = slots_.size() - 1U;
+    while (!slots_[cursor_ & mask].has_value()) {
+      ++cursor_;
+    }
+
+    eraseSlot(cursor_ & mask);
+    ++cursor_;
+  }
+
+  /// Removes all the entries and releases the slots
+  void clear() {
+    std::vector<Slot>().swap(slots_);
+    size_ = 0U;
+    cursor_ = 0U;
+  }
+
+  std::size_t size() const {
+    return size_;
+  }
+
+  bool empty() const {
+    return size_ == 0U;
+  }
+
+ private:
+  using Slot = std::optional<std::pair<Key, Value>>;
+
+  static constexpr std::size_t kNotFound = static_cast<std::size_t>(-1);
+  static constexpr std::size_t kInitialSlotCount = 16U;
+
+  static std::size_t hash(Key key) {
+    // The keys are fds, pids and inodes: finalize them to spread the
+    // sequential values over the table.
+    auto value = static_cast<std::uint64_t>(key);
+    value ^= value >> 33U;
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33U;
+    return static_cast<std::size_t>(value);
+  }
+
+  std::size_t home(Key key) const {
+    return hash(key) & (slots_.size() - 1U);
+  }
+
+  std::size_t lookup(Key key) const {
+    if (slots_.empty()) {
+      return kNotFound;
+    }
+
+    auto mask = slots_.size() - 1U;
+    for (auto index = home(key);; index = (index + 1U) & mask) {
+      const auto& slot = slots_[index];
+      if (!slot.has_value()) {
+        return kNotFound;
+      }
+
+      if (slot->first == key) {
+        return index;
+      }
+    }
+  }
+
+  /// Grows the table so that one more entry keeps the load under 70%
+  void reserveOne() {
+    if (!slots_.empty() && (size_ + 1U) * 10U <= slots_.size() * 7U) {
+      return;
+    }
+
+    auto slot_count =
+        slots_.empty() ? kInitialSlotCount : slots_.size() * 2U;
+
+    std::vector<Slot> old_slots(slot_count);
+    old_slots.swap(slots_);
+    size_ = 0U;
+
+    for (auto& slot : old_slots) {
+      if (slot.has_value()) {
+        place(slot->first, std::move(slot->second));
+      }
+    }
+  }
+
+  void place(Key key, Value value) {
+    auto mask = slots_.size() - 1U;
+    auto index = home(key);
+    while (slots_[index].has_value()) {
+      index = (index + 1U) & mask;
+    }
+
+    slots_[index].emplace(key, std::move(value));
+    ++size_;
+  }
+
+  void eraseSlot(std::size_t hole) {
+    auto mask = slots_.size() - 1U;
+    for (auto index = (hole + 1U) & mask; slots_[index].has_value();
+         index = (index + 1U) & mask) {
+      // An entry can fill the hole unless its home slot lies after the hole
+      auto distance_from_home = (index - home(slots_[index]->first)) & mask;
+      auto distance_from_hole = (index - hole) & mask;
+      if (distance_from_home >= distance_from_hole) {
+        slots_[hole] = std::move(slots_[index]);
+        hole = index;
+      }
+    }
+
+    slots_[hole].reset();
+    --size_;
+  }
+
+  std::vector<Slot> slots_;
+  std::size_t size_{0U};
+  std::size_t cursor_{0U};
+};
+
+} // namespace osquery
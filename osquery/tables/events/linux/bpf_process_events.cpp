@@ -57,8 +57,8 @@ bool BPFProcessEventSubscriber::generateRow(
   row["probe_error"] = INTEGER(event.bpf_header.probe_error);
   row["syscall"] = SQL_TEXT("exec");
   row["parent"] = INTEGER(event.parent_process_id);
-  row["path"] = SQL_TEXT(event.binary_path);
-  row["cwd"] = SQL_TEXT(event.cwd);
+  row["path"] = SQL_TEXT(event.binary_path.str());
+  row["cwd"] = SQL_TEXT(event.cwd.str());
   row["duration"] = INTEGER(event.bpf_header.duration);
 
   if (!std::holds_alternative<ISystemStateTracker::Event::ExecData>(
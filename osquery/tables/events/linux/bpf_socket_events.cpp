@@ -65,7 +65,7 @@ bool BPFSocketEventSubscriber::generateRow(
   row["exit_code"] = SQL_TEXT(std::to_string(event.bpf_header.exit_code));
   row["probe_error"] = INTEGER(event.bpf_header.probe_error);
   row["parent"] = INTEGER(event.parent_process_id);
-  row["path"] = SQL_TEXT(event.binary_path);
+  row["path"] = SQL_TEXT(event.binary_path.str());
   row["duration"] = INTEGER(event.bpf_header.duration);
 
   if (!std::holds_alternative<ISystemStateTracker::Event::SocketData>(
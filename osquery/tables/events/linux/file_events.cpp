@@ -17,9 +17,13 @@
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry_factory.h>
 #include <osquery/tables/events/event_utils.h>
+#include <osquery/utils/system/time.h>
 
 namespace osquery {
 
+DECLARE_uint32(file_events_hash_workers);
+DECLARE_uint32(file_events_hash_queue);
+
 /**
  * @brief Track time, action changes to /etc/passwd
  *
@@ -28,21 +32,42 @@ namespace osquery {
 class FileEventSubscriber : public EventSubscriber<INotifyEventPublisher> {
  public:
   Status init() override {
+    if (FLAGS_file_events_hash_workers > 0 && hash_queue_ == nullptr) {
+      hash_queue_ = FileHashQueue::create(
+          [this](std::vector<Row>& rows, EventTime time) {
+            addBatch(rows, time);
+          },
+          FLAGS_file_events_hash_workers,
+          FLAGS_file_events_hash_queue);
+    }
     return Status(0);
   }
 
   /// Walk the configuration's file paths, create subscriptions.
   void configure() override;
 
+  /// Rows waiting for their hashes are stored before a query reads events.
+  void genTable(RowYield& yield, QueryContext& ctx) override {
+    if (hash_queue_ != nullptr) {
+      hash_queue_->flush();
+    }
+    EventSubscriber::genTable(yield, ctx);
+  }
+
   /**
    * @brief This exports a single Callback for INotifyEventPublisher events.
    *
-   * @param ec The EventCallback type receives an EventContextRef substruct
-   * for the INotifyEventPublisher declared in this EventSubscriber subclass.
+   * @param ecs The events of a batch matching the subscription, each an
+   * EventContextRef substruct for the INotifyEventPublisher declared in this
+   * EventSubscriber subclass.
    *
    * @return Was the callback successful.
    */
-  Status Callback(const ECRef& ec, const SCRef& sc);
+  Status Callback(const std::vector<ECRef>& ecs, const SCRef& sc);
+
+ private:
+  /// Hashes event targets off the publisher thread, if workers are enabled.
+  std::shared_ptr<FileHashQueue> hash_queue_;
 };
 
 /**
@@ -98,34 +123,49 @@ void FileEventSubscriber::configure() {
         }
       }
       sc->category = category;
-      subscribe(&FileEventSubscriber::Callback, sc);
+      subscribeBatch(&FileEventSubscriber::Callback, sc);
     }
   });
 }
 
-Status FileEventSubscriber::Callback(const ECRef& ec, const SCRef& sc) {
-  if (ec->action.empty()) {
-    return Status(0);
-  }
+Status FileEventSubscriber::Callback(const std::vector<ECRef>& ecs,
+                                     const SCRef& sc) {
+  std::vector<Row> row_list;
+  row_list.reserve(ecs.size());
+  auto time = getUnixTime();
 
-  Row r;
-  r["action"] = ec->action;
-  r["target_path"] = ec->path;
-  r["category"] = sc->category;
-  r["transaction_id"] = INTEGER(ec->event->cookie);
+  for (const auto& ec : ecs) {
+    if (ec->action.empty()) {
+      continue;
+    }
+
+    Row r;
+    r["action"] = ec->action;
+    r["target_path"] = ec->path;
+    r["category"] = sc->category;
+    r["transaction_id"] = INTEGER(ec->event->cookie);
 
-  if ((sc->mask & kFileAccessMasks) != kFileAccessMasks) {
-    // Add hashing and 'join' against the file table for stat-information.
-    decorateFileEvent(
-        ec->path, (ec->action == "CREATED" || ec->action == "UPDATED"), r);
-  } else {
     // The access event on Linux would generate additional events if hashed.
-    decorateFileEvent(ec->path, false, r);
+    bool hash = (sc->mask & kFileAccessMasks) != kFileAccessMasks &&
+                (ec->action == "CREATED" || ec->action == "UPDATED");
+
+    // Add hashing and 'join' against the file table for stat-information.
+    decorateFileEvent(ec->path, hash && hash_queue_ == nullptr, r);
+    if (hash && hash_queue_ != nullptr) {
+      if (hash_queue_->push(ec->path, r, time)) {
+        continue;
+      }
+      // The queue is full, hash within the callback.
+      hashFileEvent(ec->path, r);
+    }
+    row_list.push_back(std::move(r));
   }
 
   // A callback is somewhat useless unless it changes the EventSubscriber
-  // state or calls `add` to store a marked up event.
-  add(r);
+  // state or calls `addBatch` to store the marked up events.
+  if (!row_list.empty()) {
+    addBatch(row_list, time);
+  }
   return Status::success();
 }
 } // namespace osquery
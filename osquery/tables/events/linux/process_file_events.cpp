@@ -1346,26 +1346,18 @@ AuditdFimInodeMap::AuditdFimInodeMap() {
 
 bool AuditdFimInodeMap::getReference(AuditdFimInodeDescriptor*& ino_desc,
                                      ino_t inode) {
-  auto it = data_.find(inode);
-  if (it == data_.end()) {
+  auto desc = data_.find(inode);
+  if (desc == nullptr) {
     return false;
   }
 
-  ino_desc = &it->second;
+  ino_desc = desc;
   return true;
 }
 
 bool AuditdFimInodeMap::takeAndRemove(AuditdFimInodeDescriptor& ino_desc,
                                       ino_t inode) {
-  auto it = data_.find(inode);
-  if (it == data_.end()) {
-    return false;
-  }
-
-  ino_desc = it->second;
-  data_.erase(it);
-
-  return true;
+  return data_.take(inode, ino_desc);
 }
 
 void AuditdFimInodeMap::save(ino_t inode,
@@ -1375,11 +1367,12 @@ void AuditdFimInodeMap::save(ino_t inode,
   ino_desc.type = type;
   ino_desc.path = path;
 
-  data_[inode] = ino_desc;
-
-  if (data_.size() > 20000) {
-    data_.erase(data_.begin());
+  // Limit the amount of inodes we are tracking
+  if (data_.size() >= 20000 && data_.find(inode) == nullptr) {
+    data_.evictOne();
   }
+
+  data_.assign(inode, std::move(ino_desc));
 }
 
 void AuditdFimInodeMap::remove(ino_t inode) {
@@ -1400,38 +1393,34 @@ void AuditdFimFdMap::setProcessId(pid_t process_id) {
 
 bool AuditdFimFdMap::getReference(AuditdFimFdDescriptor*& fd_desc,
                                   std::uint64_t fd) {
-  auto it = data_.find(fd);
-  if (it == data_.end()) {
+  auto desc = data_.find(fd);
+  if (desc == nullptr) {
     printUntrackedFdWarning(fd);
     return false;
   }
 
-  fd_desc = &it->second;
+  fd_desc = desc;
   return true;
 }
 
 bool AuditdFimFdMap::duplicate(std::uint64_t fd, std::uint64_t new_fd) {
-  auto it = data_.find(fd);
-  if (it == data_.end()) {
+  auto desc = data_.find(fd);
+  if (desc == nullptr) {
     printUntrackedFdWarning(fd);
     return false;
   }
 
-  data_.insert({new_fd, it->second});
+  data_.insert(new_fd, *desc);
   return true;
 }
 
 bool AuditdFimFdMap::takeAndRemove(AuditdFimFdDescriptor& fd_desc,
                                    std::uint64_t fd) {
-  auto it = data_.find(fd);
-  if (it == data_.end()) {
+  if (!data_.take(fd, fd_desc)) {
     printUntrackedFdWarning(fd);
     return false;
   }
 
-  fd_desc = it->second;
-  data_.erase(it);
-
   return true;
 }
 
@@ -1442,7 +1431,7 @@ void AuditdFimFdMap::save(std::uint64_t fd,
   fd_desc.inode = inode;
   fd_desc.last_operation = last_operation;
 
-  data_.insert({fd, fd_desc});
+  data_.insert(fd, fd_desc);
 }
 
 void AuditdFimFdMap::clear() {
@@ -1470,63 +1459,62 @@ void AuditdFimFdMap::printUntrackedFdWarning(std::uint64_t fd) {
 bool AuditdFimProcessMap::getReference(AuditdFimFdDescriptor*& fd_desc,
                                        pid_t process_id,
                                        std::uint64_t fd) {
-  auto process_it = data_.find(process_id);
-  if (process_it == data_.end()) {
+  auto fd_map = data_.find(process_id);
+  if (fd_map == nullptr) {
     printUntrackedPidWarning(process_id);
     return false;
   }
 
-  AuditdFimFdMap& fd_map = process_it->second;
-  return fd_map.getReference(fd_desc, fd);
+  return fd_map->getReference(fd_desc, fd);
 }
 
 void AuditdFimProcessMap::create(pid_t process_id) {
-  auto process_it = data_.find(process_id);
-  if (process_it != data_.end()) {
-    process_it->second.clear();
+  auto fd_map = data_.find(process_id);
+  if (fd_map != nullptr) {
+    fd_map->clear();
   } else {
-    data_.insert({process_id, AuditdFimFdMap(process_id)});
+    data_.insert(process_id, AuditdFimFdMap(process_id));
   }
 }
 
 bool AuditdFimProcessMap::duplicate(pid_t process_id,
                                     std::uint64_t fd,
                                     std::uint64_t new_fd) {
-  auto process_it = data_.find(process_id);
-  if (process_it == data_.end()) {
+  auto fd_map = data_.find(process_id);
+  if (fd_map == nullptr) {
     printUntrackedPidWarning(process_id);
     return false;
   }
 
-  AuditdFimFdMap& fd_map = process_it->second;
-  return fd_map.duplicate(fd, new_fd);
+  return fd_map->duplicate(fd, new_fd);
 }
 
 bool AuditdFimProcessMap::clone(pid_t old_pid, pid_t new_pid) {
-  auto process_it = data_.find(old_pid);
-  if (process_it == data_.end()) {
+  auto old_fd_map = data_.find(old_pid);
+  if (old_fd_map == nullptr) {
     printUntrackedPidWarning(old_pid);
     return false;
   }
 
-  AuditdFimFdMap fd_map = process_it->second;
+  AuditdFimFdMap fd_map = *old_fd_map;
   fd_map.setProcessId(new_pid);
 
-  data_.insert({new_pid, fd_map});
+  // A tracked new_pid belonged to a process that has exited since, its
+  // fd map is released
+  data_.assign(new_pid, std::move(fd_map));
   return true;
 }
 
 bool AuditdFimProcessMap::takeAndRemove(AuditdFimFdDescriptor& fd_desc,
                                         pid_t process_id,
                                         std::uint64_t fd) {
-  auto process_it = data_.find(process_id);
-  if (process_it == data_.end()) {
+  auto fd_map = data_.find(process_id);
+  if (fd_map == nullptr) {
     printUntrackedPidWarning(process_id);
     return false;
   }
 
-  AuditdFimFdMap& fd_map = process_it->second;
-  return fd_map.takeAndRemove(fd_desc, fd);
+  return fd_map->takeAndRemove(fd_desc, fd);
 }
 
 void AuditdFimProcessMap::save(
@@ -1534,19 +1522,18 @@ void AuditdFimProcessMap::save(
     pid_t process_id,
     ino_t inode,
     AuditdFimFdDescriptor::OperationType last_operation) {
-  auto process_it = data_.find(process_id);
-  if (process_it == data_.end()) {
-    process_it = data_.insert({process_id, AuditdFimFdMap(process_id)}).first;
-
-    // Try to limit the amount of processes we are tracking. When
-    // removing, start from the oldest ones
-    if (data_.size() > 4096) {
-      data_.erase(data_.begin());
+  auto fd_map = data_.find(process_id);
+  if (fd_map == nullptr) {
+    // Try to limit the amount of processes we are tracking
+    if (data_.size() >= 4096) {
+      data_.evictOne();
     }
+
+    data_.insert(process_id, AuditdFimFdMap(process_id));
+    fd_map = data_.find(process_id);
   }
 
-  AuditdFimFdMap& fd_map = process_it->second;
-  return fd_map.save(fd, inode, last_operation);
+  return fd_map->save(fd, inode, last_operation);
 }
 
 void AuditdFimProcessMap::clear() {
@@ -20,6 +20,7 @@
 
 #include <osquery/events/eventsubscriber.h>
 #include <osquery/events/linux/auditeventpublisher.h>
+#include <osquery/tables/events/linux/auditdfim_flat_map.h>
 
 namespace osquery {
 /// An inode descriptor, containing the file (or folder) path
@@ -62,7 +63,7 @@ class AuditdFimInodeMap final {
 
  private:
   /// The global inode map
-  std::map<ino_t, AuditdFimInodeDescriptor> data_;
+  AuditdFimFlatMap<ino_t, AuditdFimInodeDescriptor> data_;
 };
 
 /// Contains
@@ -102,8 +103,9 @@ class AuditdFimFdMap final {
   /// A time-based filter to avoid spamming the warning log
   std::time_t warning_suppression_timer_{0};
 
-  /// A map of all the known file descriptors for this process
-  std::unordered_map<std::uint64_t, AuditdFimFdDescriptor> data_;
+  /// A map of all the known file descriptors for this process, its slots
+  /// are released with the process
+  AuditdFimFlatMap<std::uint64_t, AuditdFimFdDescriptor> data_;
 };
 
 /// A utility class to track processes and their fd maps
@@ -147,7 +149,7 @@ class AuditdFimProcessMap final {
   std::map<pid_t, std::time_t> warning_suppression_filter_;
 
   /// An fd map for each process
-  std::map<pid_t, AuditdFimFdMap> data_;
+  AuditdFimFlatMap<pid_t, AuditdFimFdMap> data_;
 };
 
 /// A simple vector of strings
@@ -40,7 +40,8 @@ FLAG(bool,
      "Allow non-blocking accept() syscalls that returned EAGAIN/EWOULDBLOCK");
 
 std::string ip4FromSaddr(const std::string& saddr, ushort offset) {
-  long const result = tryTo<long>(saddr.substr(offset, 8), 16).takeOr(0l);
+  long const result =
+      tryTo<long>(std::string_view(saddr).substr(offset, 8), 16).takeOr(0l);
   return std::to_string((result & 0xff000000) >> 24) + '.' +
          std::to_string((result & 0x00ff0000) >> 16) + '.' +
          std::to_string((result & 0x0000ff00) >> 8) + '.' +
@@ -72,13 +73,15 @@ bool SocketEventSubscriber::parseSockAddr(const std::string& saddr,
   if (saddr[0] == '0' && saddr[1] == '2') {
     // IPv4
     row["family"] = '2';
-    long const result = tryTo<long>(saddr.substr(4, 4), 16).takeOr(0l);
+    long const result =
+        tryTo<long>(std::string_view(saddr).substr(4, 4), 16).takeOr(0l);
     row[port_column] = INTEGER(result);
     row[address_column] = ip4FromSaddr(saddr, 8);
   } else if (saddr[0] == '0' && saddr[1] == 'A') {
     // IPv6
     row["family"] = "10";
-    long const result = tryTo<long>(saddr.substr(4, 4), 16).takeOr(0l);
+    long const result =
+        tryTo<long>(std::string_view(saddr).substr(4, 4), 16).takeOr(0l);
     row[port_column] = INTEGER(result);
     std::string address;
     for (size_t i = 0; i < 8; ++i) {
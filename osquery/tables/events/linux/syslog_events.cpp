@@ -33,7 +33,7 @@ class SyslogEventSubscriber : public EventSubscriber<SyslogEventPublisher> {
   // Implement the pure virtual init interface.
   Status init() override {
     SyslogSubscriptionContextRef sc = createSubscriptionContext();
-    subscribe(&SyslogEventSubscriber::Callback, sc);
+    subscribeBatch(&SyslogEventSubscriber::Callback, sc);
     return Status::success();
   }
 
@@ -45,14 +45,20 @@ class SyslogEventSubscriber : public EventSubscriber<SyslogEventPublisher> {
     return FLAGS_syslog_events_max;
   }
 
-  Status Callback(const ECRef& ec, const SCRef& sc);
+  Status Callback(const std::vector<ECRef>& ecs, const SCRef& sc);
 };
 
 REGISTER(SyslogEventSubscriber, "event_subscriber", "syslog_events");
 
-Status SyslogEventSubscriber::Callback(const ECRef& ec, const SCRef& sc) {
-  Row r(ec->fields);
-  add(r);
+Status SyslogEventSubscriber::Callback(const std::vector<ECRef>& ecs,
+                                       const SCRef& sc) {
+  std::vector<Row> row_list;
+  row_list.reserve(ecs.size());
+  for (const auto& ec : ecs) {
+    row_list.emplace_back(ec->fields);
+  }
+
+  addBatch(row_list);
   return Status::success();
 }
 }
@@ -120,4 +120,43 @@ TEST_F(FileEventsTableTests, test_configure_subscriptions) {
   }
 }
 #endif /* WIN32 */
+
+TEST_F(FileEventsTableTests, test_file_hash_queue) {
+  std::vector<std::pair<EventTime, std::vector<Row>>> stored;
+  FileHashQueue queue(
+      [&stored](std::vector<Row>& rows, EventTime time) {
+        stored.emplace_back(time, rows);
+      },
+      2);
+
+  Row created = {{"action", "CREATED"}};
+  Row updated = {{"action", "UPDATED"}};
+  Row other = {{"action", "UPDATED"}};
+  Row full = {{"action", "CREATED"}};
+  EXPECT_TRUE(queue.push("/osquery/does/not/exist/a", created, 1));
+  EXPECT_TRUE(queue.push("/osquery/does/not/exist/a", updated, 2));
+  EXPECT_TRUE(queue.push("/osquery/does/not/exist/b", other, 2));
+  EXPECT_EQ(queue.size(), 2U);
+
+  // Only paths count towards the capacity, a new path is not queued.
+  EXPECT_FALSE(queue.push("/osquery/does/not/exist/c", full, 3));
+  EXPECT_EQ(full.at("action"), "CREATED");
+
+  // Both events of the first path are stored after a single hash.
+  EXPECT_TRUE(queue.process());
+  ASSERT_EQ(stored.size(), 2U);
+  EXPECT_EQ(stored[0].first, 1U);
+  ASSERT_EQ(stored[0].second.size(), 1U);
+  EXPECT_EQ(stored[0].second[0].at("action"), "CREATED");
+  EXPECT_EQ(stored[0].second[0].at("hashed"), "-1");
+  EXPECT_EQ(stored[1].first, 2U);
+  ASSERT_EQ(stored[1].second.size(), 1U);
+  EXPECT_EQ(stored[1].second[0].at("action"), "UPDATED");
+  EXPECT_EQ(stored[1].second[0].at("hashed"), "-1");
+
+  queue.flush();
+  EXPECT_EQ(queue.size(), 0U);
+  EXPECT_EQ(stored.size(), 3U);
+  EXPECT_FALSE(queue.process());
+}
 } // namespace osquery
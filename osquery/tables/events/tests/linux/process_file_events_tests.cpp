@@ -0,0 +1,103 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <map>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <osquery/tables/events/linux/auditdfim_flat_map.h>
+#include <osquery/tables/events/linux/process_file_events.h>
+
+namespace osquery {
+namespace {
+
+class ProcessFileEventsTests : public testing::Test {};
+
+TEST_F(ProcessFileEventsTests, flat_map_matches_std_map) {
+  AuditdFimFlatMap<std::uint64_t, std::string> flat_map;
+  std::map<std::uint64_t, std::string> expected_map;
+
+  // Insert and erase enough keys to grow the table and to wrap colliding
+  // entries around the end of the slot array
+  std::uint64_t state = 1U;
+  for (std::size_t i = 0U; i < 20000U; ++i) {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    auto key = (state >> 33U) % 512U;
+    auto value = std::to_string(i);
+
+    switch ((state >> 20U) % 3U) {
+    case 0U:
+      EXPECT_EQ(flat_map.insert(key, value),
+                expected_map.insert({key, value}).second);
+      break;
+
+    case 1U:
+      EXPECT_EQ(flat_map.erase(key), expected_map.erase(key) == 1U);
+      break;
+
+    default:
+      flat_map.assign(key, value);
+      expected_map[key] = value;
+      break;
+    }
+
+    ASSERT_EQ(flat_map.size(), expected_map.size());
+  }
+
+  for (std::uint64_t key = 0U; key < 512U; ++key) {
+    auto expected_it = expected_map.find(key);
+    auto value = flat_map.find(key);
+    if (expected_it == expected_map.end()) {
+      EXPECT_EQ(value, nullptr);
+    } else {
+      ASSERT_NE(value, nullptr);
+      EXPECT_EQ(*value, expected_it->second);
+    }
+  }
+
+  std::string taken;
+  auto first = expected_map.begin()->first;
+  EXPECT_TRUE(flat_map.take(first, taken));
+  EXPECT_EQ(taken, expected_map.begin()->second);
+  EXPECT_FALSE(flat_map.take(first, taken));
+
+  auto size = flat_map.size();
+  flat_map.evictOne();
+  EXPECT_EQ(flat_map.size(), size - 1U);
+
+  flat_map.clear();
+  EXPECT_TRUE(flat_map.empty());
+  EXPECT_EQ(flat_map.find(first), nullptr);
+}
+
+TEST_F(ProcessFileEventsTests, process_map_clone_replaces_reused_pid) {
+  AuditdFimProcessMap process_map;
+  process_map.save(3U, 100, 1000U);
+  process_map.save(4U, 200, 2000U);
+
+  // pid 200 is reused by a child of pid 100
+  EXPECT_TRUE(process_map.clone(100, 200));
+
+  AuditdFimFdDescriptor* fd_desc = nullptr;
+  ASSERT_TRUE(process_map.getReference(fd_desc, 200, 3U));
+  EXPECT_EQ(fd_desc->inode, 1000U);
+  EXPECT_FALSE(process_map.getReference(fd_desc, 200, 4U));
+
+  AuditdFimFdDescriptor taken_desc;
+  EXPECT_TRUE(process_map.takeAndRemove(taken_desc, 200, 3U));
+  EXPECT_EQ(taken_desc.inode, 1000U);
+
+  // The parent keeps its own descriptors
+  ASSERT_TRUE(process_map.getReference(fd_desc, 100, 3U));
+  EXPECT_EQ(fd_desc->inode, 1000U);
+}
+
+} // namespace
+} // namespace osquery
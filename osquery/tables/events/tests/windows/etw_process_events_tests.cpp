@@ -196,4 +196,73 @@ TEST_F(ETWProcessEventsTests, test_concurrent_queue_timeout) {
       << "Events produced: " << totalEventsProduced
       << " - Events consumed: " << totalEventsConsumed;
 }
+
+TEST_F(ETWProcessEventsTests, test_bounded_concurrent_queue) {
+  BoundedConcurrentQueue<unsigned int> testQueue(1000);
+  EXPECT_EQ(testQueue.capacity(), 1024U);
+
+  const unsigned int producerThreadCount = 8;
+  const unsigned int eventsPerThread = 100000;
+
+  std::atomic<unsigned long long> totalEventsProduced = 0;
+  std::atomic<unsigned long long> totalEventsConsumed = 0;
+  std::atomic<unsigned int> nrOfThreadsProducing = producerThreadCount;
+
+  std::vector<std::thread> producerThreads;
+  for (unsigned int i = 0; i < producerThreadCount; ++i) {
+    producerThreads.push_back(std::thread([&]() {
+      for (unsigned int it = 0; it < eventsPerThread; ++it) {
+        if (testQueue.push(it)) {
+          totalEventsProduced++;
+        }
+      }
+
+      nrOfThreadsProducing--;
+    }));
+  }
+
+  // Starting several consumer threads
+  std::vector<std::thread> consumerThreads;
+  for (unsigned int i = 0; i < 4; ++i) {
+    consumerThreads.push_back(std::thread([&]() {
+      while (!testQueue.empty() || nrOfThreadsProducing != 0) {
+        unsigned int value = 0;
+        if (testQueue.popWait(value, 10)) {
+          totalEventsConsumed++;
+        }
+      }
+    }));
+  }
+
+  // Waiting for threads to join
+  for (auto& producerThread : producerThreads) {
+    producerThread.join();
+  }
+  for (auto& consumerThread : consumerThreads) {
+    consumerThread.join();
+  }
+
+  // Every event is either consumed or accounted as dropped
+  auto totalEventsDropped = testQueue.takeDropped();
+  EXPECT_EQ(totalEventsProduced, totalEventsConsumed);
+  EXPECT_EQ(totalEventsProduced + totalEventsDropped,
+            producerThreadCount * eventsPerThread);
+  EXPECT_EQ(testQueue.takeDropped(), 0U);
+}
+
+TEST_F(ETWProcessEventsTests, test_bounded_concurrent_queue_full) {
+  BoundedConcurrentQueue<unsigned int> testQueue(2);
+  EXPECT_TRUE(testQueue.push(1));
+  EXPECT_TRUE(testQueue.push(2));
+  EXPECT_FALSE(testQueue.push(3));
+  EXPECT_EQ(testQueue.size(), 2U);
+
+  unsigned int value = 0;
+  EXPECT_TRUE(testQueue.tryPop(value));
+  EXPECT_EQ(value, 1U);
+  EXPECT_TRUE(testQueue.popWait(value, 10));
+  EXPECT_EQ(value, 2U);
+  EXPECT_FALSE(testQueue.popWait(value, 10));
+  EXPECT_EQ(testQueue.takeDropped(), 1U);
+}
 } // namespace osquery
@@ -11,18 +11,23 @@
 
 #include <gtest/gtest.h>
 
+#include <osquery/core/flags.h>
 #include <osquery/events/windows/windowseventlogparser.h>
 #include <osquery/tables/events/windows/powershell_events.h>
 #include <osquery/utils/conversions/windows/strings.h>
 
 namespace osquery {
+
+DECLARE_uint32(powershell_events_max_pending_mb);
+DECLARE_uint32(powershell_events_max_script_size);
+
 namespace {
 extern const std::string kSingleScriptBlock;
 extern const std::string kMultiChunkScript01;
 extern const std::string kMultiChunkScript02;
 extern const std::string kMultiChunkScript03;
 
-const std::size_t kExpectedColumnCount{8U};
+const std::size_t kExpectedColumnCount{9U};
 
 Status initializePowershellEventsContext(
     PowershellEventSubscriber::Context& context,
@@ -42,6 +47,30 @@ Status initializePowershellEventsContext(
 
   return Status::success();
 }
+
+boost::property_tree::ptree generateScriptEvent(
+    std::size_t message_number,
+    std::size_t message_total,
+    const std::string& script_block_text,
+    const std::string& script_block_id) {
+  boost::property_tree::ptree event_object;
+  event_object.put("Event.System.TimeCreated.<xmlattr>.SystemTime",
+                   "2020-03-03T03:07:32.478787500Z");
+
+  auto add_field = [&event_object](const std::string& name,
+                                   const std::string& value) {
+    boost::property_tree::ptree field(value);
+    field.put("<xmlattr>.Name", name);
+    event_object.add_child("Event.EventData.Data", field);
+  };
+
+  add_field("MessageNumber", std::to_string(message_number));
+  add_field("MessageTotal", std::to_string(message_total));
+  add_field("ScriptBlockText", script_block_text);
+  add_field("ScriptBlockId", script_block_id);
+  add_field("Path", "");
+  return event_object;
+}
 } // namespace
 
 class PowershellEventsTests : public testing::Test {};
@@ -106,35 +135,23 @@ TEST_F(PowershellEventsTests, event_expiration) {
   context.last_event_expiration_time = osquery_time;
 
   for (auto i = 0U; i < 10U; ++i) {
-    auto script_block_id = "expiring_script_id_" + std::to_string(i);
-
-    PowershellEventSubscriber::Context::ScriptMessage script_message = {};
-    script_message.script_block_id = script_block_id;
-
-    PowershellEventSubscriber::Context::ScriptMessageList script_message_list =
-        {};
-
-    script_message_list.push_back(std::move(script_message));
+    PowershellEventSubscriber::Context::ScriptBlock script_block;
+    script_block.size = 10U;
 
     context.script_state_map.insert(
-        {script_block_id, std::move(script_message_list)});
+        {"expiring_script_id_" + std::to_string(i), std::move(script_block)});
   }
 
   for (auto i = 0U; i < 10U; ++i) {
-    auto script_block_id = "non-expiring_script_id_" + std::to_string(i);
-
-    PowershellEventSubscriber::Context::ScriptMessage script_message = {};
-    script_message.osquery_time = osquery_time;
-    script_message.script_block_id = script_block_id;
-
-    PowershellEventSubscriber::Context::ScriptMessageList script_message_list =
-        {};
+    PowershellEventSubscriber::Context::ScriptBlock script_block;
+    script_block.last_message_time = osquery_time;
+    script_block.size = 10U;
 
-    script_message_list.push_back(std::move(script_message));
-
-    context.script_state_map.insert(
-        {script_block_id, std::move(script_message_list)});
+    context.script_state_map.insert({"non-expiring_script_id_" +
+                                         std::to_string(i),
+                                     std::move(script_block)});
   }
+  context.script_state_size = 200U;
 
   auto status = PowershellEventSubscriber::processEventExpiration(context);
   EXPECT_TRUE(status.ok());
@@ -149,6 +166,7 @@ TEST_F(PowershellEventsTests, event_expiration) {
 
   EXPECT_EQ(context.script_state_map.size(), 10U);
   EXPECT_EQ(context.expired_event_count, 10U);
+  EXPECT_EQ(context.script_state_size, 100U);
 }
 
 TEST_F(PowershellEventsTests, simple_event_row_emission) {
@@ -217,8 +235,11 @@ TEST_F(PowershellEventsTests, trace_unordered_complete_split_event) {
 
   ASSERT_EQ(context.row_list.size(), 1U);
   EXPECT_EQ(context.row_list.at(0U).size(), kExpectedColumnCount);
+  EXPECT_EQ(context.row_list.at(0U).at("script_text"),
+            "write-host \"1\"write-host \"2\"write-host \"3\"");
 
   EXPECT_TRUE(context.script_state_map.empty());
+  EXPECT_EQ(context.script_state_size, 0U);
   EXPECT_EQ(context.last_event_expiration_time, 0U);
   EXPECT_EQ(context.invalid_event_count, 0U);
   EXPECT_EQ(context.expired_event_count, 0U);
@@ -254,6 +275,68 @@ TEST_F(PowershellEventsTests, trace_unordered_incomplete_split_event) {
   EXPECT_EQ(context.expired_event_count, 0U);
 }
 
+TEST_F(PowershellEventsTests, trace_duplicate_split_event) {
+  PowershellEventSubscriber::Context context;
+  auto status = initializePowershellEventsContext(
+      context, {std::ref(kMultiChunkScript01), std::ref(kMultiChunkScript01)});
+  ASSERT_TRUE(status.ok());
+
+  EXPECT_TRUE(context.row_list.empty());
+  EXPECT_EQ(context.script_state_map.size(), 1U);
+  EXPECT_EQ(context.invalid_event_count, 1U);
+}
+
+TEST_F(PowershellEventsTests, truncated_split_event) {
+  PowershellEventSubscriber::Context context;
+  auto status =
+      initializePowershellEventsContext(context,
+                                        {std::ref(kMultiChunkScript01),
+                                         std::ref(kMultiChunkScript02),
+                                         std::ref(kMultiChunkScript03)});
+  ASSERT_TRUE(status.ok());
+  ASSERT_EQ(context.row_list.size(), 1U);
+  auto full_row = context.row_list.at(0U);
+  EXPECT_EQ(full_row.at("script_sha256").size(), 64U);
+
+  FLAGS_powershell_events_max_script_size = 20U;
+  context = {};
+  status = initializePowershellEventsContext(context,
+                                             {std::ref(kMultiChunkScript02),
+                                              std::ref(kMultiChunkScript01),
+                                              std::ref(kMultiChunkScript03)});
+  FLAGS_powershell_events_max_script_size = 0U;
+  ASSERT_TRUE(status.ok());
+
+  ASSERT_EQ(context.row_list.size(), 1U);
+  const auto& row = context.row_list.at(0U);
+  EXPECT_EQ(row.at("script_text"), full_row.at("script_text").substr(0, 20));
+  EXPECT_EQ(row.at("script_sha256"), full_row.at("script_sha256"));
+  EXPECT_EQ(context.truncated_event_count, 1U);
+}
+
+TEST_F(PowershellEventsTests, pending_budget_eviction) {
+  FLAGS_powershell_events_max_pending_mb = 1U;
+  const std::string script_block_text(700U * 1024U, 'a');
+
+  PowershellEventSubscriber::Context context;
+  auto status = PowershellEventSubscriber::processEventObject(
+      context, generateScriptEvent(1U, 2U, script_block_text, "first"));
+  ASSERT_TRUE(status.ok());
+  context.script_state_map.at("first").last_message_time = 1U;
+  EXPECT_EQ(context.script_state_size, script_block_text.size());
+
+  status = PowershellEventSubscriber::processEventObject(
+      context, generateScriptEvent(2U, 2U, script_block_text, "second"));
+  FLAGS_powershell_events_max_pending_mb = 64U;
+  ASSERT_TRUE(status.ok());
+
+  // The least recently updated block is evicted.
+  EXPECT_EQ(context.script_state_map.size(), 1U);
+  EXPECT_EQ(context.script_state_map.count("second"), 1U);
+  EXPECT_EQ(context.script_state_size, script_block_text.size());
+  EXPECT_EQ(context.evicted_event_count, 1U);
+}
+
 TEST_F(PowershellEventsTests, trace_invalid_event) {
   const std::string empty_string;
   const std::string invalid_tag{"<dummy_tag></dummy_tag>"};
@@ -156,6 +156,69 @@ TEST_F(WindowsEventsTests, invalid_event_parsing) {
   ASSERT_FALSE(status.ok());
 }
 
+TEST_F(WindowsEventsTests, rendered_values_parsing) {
+  std::vector<EVT_VARIANT> system_values(EvtSystemPropertyIdEND);
+  for (auto& value : system_values) {
+    value.Type = EvtVarTypeNull;
+  }
+
+  GUID provider_guid = {0x54849625,
+                        0x5478,
+                        0x4994,
+                        {0xa5, 0xba, 0x3e, 0x3b, 0x03, 0x28, 0xc3, 0x0d}};
+
+  system_values[EvtSystemProviderName].Type = EvtVarTypeString;
+  system_values[EvtSystemProviderName].StringVal =
+      L"Microsoft-Windows-Security-Auditing";
+  system_values[EvtSystemProviderGuid].Type = EvtVarTypeGuid;
+  system_values[EvtSystemProviderGuid].GuidVal = &provider_guid;
+  system_values[EvtSystemEventID].Type = EvtVarTypeUInt16;
+  system_values[EvtSystemEventID].UInt16Val = 4624;
+  system_values[EvtSystemLevel].Type = EvtVarTypeByte;
+  system_values[EvtSystemLevel].ByteVal = 0;
+  system_values[EvtSystemTask].Type = EvtVarTypeUInt16;
+  system_values[EvtSystemTask].UInt16Val = 12544;
+  system_values[EvtSystemKeywords].Type = EvtVarTypeHexInt64;
+  system_values[EvtSystemKeywords].UInt64Val = 0x8020000000000000ULL;
+  system_values[EvtSystemTimeCreated].Type = EvtVarTypeFileTime;
+  system_values[EvtSystemTimeCreated].FileTimeVal = 132368803724865915ULL;
+  system_values[EvtSystemChannel].Type = EvtVarTypeString;
+  system_values[EvtSystemChannel].StringVal = L"Security";
+  system_values[EvtSystemComputer].Type = EvtVarTypeString;
+  system_values[EvtSystemComputer].StringVal = L"computer";
+
+  std::vector<EVT_VARIANT> user_values(2U);
+  user_values[0].Type = EvtVarTypeString;
+  user_values[0].StringVal = L"user";
+  user_values[1].Type = EvtVarTypeHexInt32;
+  user_values[1].UInt32Val = 0x3e7;
+
+  boost::property_tree::ptree event_object;
+  parseWindowsEventLogSystemValues(event_object,
+                                   system_values.data(),
+                                   static_cast<DWORD>(system_values.size()));
+  parseWindowsEventLogUserValues(
+      event_object, user_values.data(), static_cast<DWORD>(user_values.size()));
+
+  WELEvent windows_event;
+  auto status = parseWindowsEventLogPTree(windows_event, event_object);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+
+  EXPECT_EQ(windows_event.datetime, "2020-06-17T15:12:52.4865915Z");
+  EXPECT_EQ(windows_event.source, "Security");
+  EXPECT_EQ(windows_event.provider_name,
+            "Microsoft-Windows-Security-Auditing");
+  EXPECT_EQ(windows_event.provider_guid,
+            "{54849625-5478-4994-a5ba-3e3b0328c30d}");
+  EXPECT_EQ(windows_event.computer_name, "computer");
+  EXPECT_EQ(windows_event.event_id, 4624);
+  EXPECT_EQ(windows_event.task_id, 12544);
+  EXPECT_EQ(windows_event.level, 0);
+  EXPECT_EQ(windows_event.pid, -1);
+  EXPECT_EQ(windows_event.keywords, "0x8020000000000000");
+  EXPECT_EQ(windows_event.data, "{\"EventData\":[\"user\",\"0x3e7\"]}");
+}
+
 TEST_F(WindowsEventsTests, row_generation) {
   // clang-format off
   WELEvent test_event = {
@@ -7,6 +7,8 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+
 #include <boost/filesystem/path.hpp>
 
 #include <osquery/core/flags.h>
@@ -49,6 +51,17 @@ FLAG(bool,
      enable_powershell_events_subscriber,
      false,
      "Enables Powershell events");
+
+FLAG(uint32,
+     powershell_events_max_pending_mb,
+     64,
+     "Memory budget of the incomplete Powershell script blocks (0 = none)");
+
+FLAG(uint32,
+     powershell_events_max_script_size,
+     0,
+     "Bytes of Powershell script text stored per script block (0 = all)");
+
 DECLARE_bool(enable_windows_events_publisher);
 
 REGISTER(PowershellEventSubscriber, "event_subscriber", "powershell_events");
@@ -81,31 +94,25 @@ Status PowershellEventSubscriber::init() {
 
 Status PowershellEventSubscriber::generateRow(
     Row& row,
-    std::vector<Context::ScriptMessage> script_message_list,
+    Context::ScriptBlock script_block,
     const std::vector<double>& character_frequency_map) {
   row = {};
 
-  if (script_message_list.empty()) {
+  const auto& first_script_message = script_block.first_message;
+  if (first_script_message.expected_message_count == 0U) {
     return Status::failure("Empty message list received in Powershell event");
   }
 
-  const auto& first_script_message = script_message_list.front();
-
-  if (first_script_message.expected_message_count !=
-      script_message_list.size()) {
+  if (script_block.next_message_number <=
+      first_script_message.expected_message_count) {
     return Status::failure(
         "One or more messages missing from the Powershell event");
   }
 
-  std::string full_script;
-  for (const auto& script_message : script_message_list) {
-    full_script += script_message.message;
-  }
-
   double cosine_similarity{0.0};
   if (!character_frequency_map.empty()) {
     cosine_similarity = WindowsEventLogPublisher::cosineSimilarity(
-        full_script, character_frequency_map);
+        script_block.script_text, character_frequency_map);
   }
 
   row["time"] = INTEGER(first_script_message.osquery_time);
@@ -115,14 +122,93 @@ Status PowershellEventSubscriber::generateRow(
   row["script_block_count"] =
       INTEGER(first_script_message.expected_message_count);
 
-  row["script_text"] = SQL_TEXT(std::move(full_script));
+  row["script_text"] = SQL_TEXT(std::move(script_block.script_text));
   row["script_name"] = SQL_TEXT(first_script_message.script_name);
   row["script_path"] = SQL_TEXT(first_script_message.script_path);
+  row["script_sha256"] = SQL_TEXT(script_block.script_hash->digest());
   row["cosine_similarity"] = DOUBLE(cosine_similarity);
 
   return Status::success();
 }
 
+namespace {
+void appendScriptText(PowershellEventSubscriber::Context::ScriptBlock& block,
+                      std::string&& text) {
+  // The hash covers the whole script, also when its text is truncated.
+  if (block.script_hash == nullptr) {
+    block.script_hash = std::make_unique<Hash>(HASH_TYPE_SHA256);
+  }
+  block.script_hash->update(text.data(), text.size());
+
+  auto length = text.size();
+  auto limit =
+      static_cast<std::size_t>(FLAGS_powershell_events_max_script_size);
+  if (limit > 0U && block.script_text.size() + length > limit) {
+    length = limit - block.script_text.size();
+    block.truncated = true;
+  }
+
+  if (block.script_text.empty() && length == text.size()) {
+    block.script_text = std::move(text);
+  } else {
+    block.script_text.append(text, 0U, length);
+  }
+
+  block.size += length;
+  ++block.next_message_number;
+}
+} // namespace
+
+Status PowershellEventSubscriber::appendScriptMessage(
+    Context::ScriptBlock& script_block, Context::ScriptMessage script_message) {
+  auto& first_message = script_block.first_message;
+  auto message_number = script_message.message_number;
+  if (message_number == 0U ||
+      message_number > script_message.expected_message_count) {
+    return Status::failure("Invalid message number in a Powershell event");
+  }
+
+  // The text is moved, it is copied once into the script text.
+  auto message_text = std::move(script_message.message);
+  script_message.message.clear();
+
+  if (first_message.expected_message_count == 0U) {
+    first_message = script_message;
+
+  } else if (first_message.expected_message_count !=
+             script_message.expected_message_count) {
+    return Status::failure(
+        "Mismatched message count in the messages of a Powershell event");
+  }
+
+  if (message_number < script_block.next_message_number ||
+      script_block.pending_messages.count(message_number) != 0U) {
+    return Status::failure("Duplicate message received in Powershell event");
+  }
+
+  script_block.last_message_time = script_message.osquery_time;
+  if (message_number != script_block.next_message_number) {
+    // Hold the message until the messages before it are appended.
+    script_block.size += message_text.size();
+    script_block.pending_messages.emplace(message_number,
+                                          std::move(message_text));
+    return Status::success();
+  }
+
+  appendScriptText(script_block, std::move(message_text));
+
+  auto& pending_messages = script_block.pending_messages;
+  while (!pending_messages.empty() &&
+         pending_messages.begin()->first == script_block.next_message_number) {
+    auto pending_it = pending_messages.begin();
+    script_block.size -= pending_it->second.size();
+    appendScriptText(script_block, std::move(pending_it->second));
+    pending_messages.erase(pending_it);
+  }
+
+  return Status::success();
+}
+
 Status PowershellEventSubscriber::parseScriptMessageEvent(
     boost::optional<Context::ScriptMessage>& script_message_opt,
     const boost::property_tree::ptree& event) {
@@ -245,14 +331,25 @@ Status PowershellEventSubscriber::processEventObject(
     return Status::success();
   }
 
-  const auto& script_message = script_message_opt.value();
+  auto& script_message = script_message_opt.value();
 
   // If this is a single-message event, then bypass state tracking and directly
   // emit a new row
   if (script_message.expected_message_count == 1U) {
+    Context::ScriptBlock script_block;
+    status = appendScriptMessage(script_block, std::move(script_message));
+    if (!status.ok()) {
+      ++context.invalid_event_count;
+      return status;
+    }
+
+    if (script_block.truncated) {
+      ++context.truncated_event_count;
+    }
+
     Row row;
     status = generateRow(
-        row, {std::move(script_message)}, context.character_frequency_map);
+        row, std::move(script_block), context.character_frequency_map);
 
     if (!status.ok()) {
       ++context.invalid_event_count;
@@ -263,30 +360,48 @@ Status PowershellEventSubscriber::processEventObject(
     return Status::success();
   }
 
-  // Get or create a new script message list object
+  // Get or create a new script block object
   auto script_block_id = script_message.script_block_id;
-  auto expected_message_count = script_message.expected_message_count;
-
-  auto script_message_list_it = context.script_state_map.find(script_block_id);
-  if (script_message_list_it == context.script_state_map.end()) {
-    auto insert_status = context.script_state_map.insert({script_block_id, {}});
-    script_message_list_it = insert_status.first;
+  auto script_block_it = context.script_state_map.find(script_block_id);
+  if (script_block_it == context.script_state_map.end()) {
+    auto insert_status = context.script_state_map.emplace(
+        script_block_id, Context::ScriptBlock{});
+    script_block_it = insert_status.first;
   }
 
-  auto& script_message_list_ref = script_message_list_it->second;
-  script_message_list_ref.push_back(std::move(script_message));
+  auto& script_block_ref = script_block_it->second;
+  auto previous_size = script_block_ref.size;
+  status = appendScriptMessage(script_block_ref, std::move(script_message));
+  context.script_state_size =
+      context.script_state_size - previous_size + script_block_ref.size;
+
+  if (!status.ok()) {
+    if (script_block_ref.first_message.expected_message_count == 0U) {
+      context.script_state_map.erase(script_block_it);
+    }
+
+    ++context.invalid_event_count;
+    return status;
+  }
 
   // If we have finished assembling this event, then emit a new row
-  if (expected_message_count != script_message_list_ref.size()) {
+  if (script_block_ref.next_message_number <=
+      script_block_ref.first_message.expected_message_count) {
+    processEventEviction(context);
     return Status::success();
   }
 
-  auto script_message_list = std::move(script_message_list_ref);
-  context.script_state_map.erase(script_block_id);
+  auto script_block = std::move(script_block_ref);
+  context.script_state_size -= script_block.size;
+  context.script_state_map.erase(script_block_it);
+
+  if (script_block.truncated) {
+    ++context.truncated_event_count;
+  }
 
   Row row;
   status = generateRow(
-      row, std::move(script_message_list), context.character_frequency_map);
+      row, std::move(script_block), context.character_frequency_map);
 
   if (!status.ok()) {
     ++context.invalid_event_count;
@@ -309,11 +424,11 @@ Status PowershellEventSubscriber::processEventExpiration(Context& context) {
 
   for (auto it = context.script_state_map.begin();
        it != context.script_state_map.end();) {
-    const auto& script_message_list = it->second;
-    const auto& last_script_message = script_message_list.back();
+    const auto& script_block = it->second;
 
-    if (last_script_message.osquery_time + kScriptEventExpiration <
+    if (script_block.last_message_time + kScriptEventExpiration <
         current_timestamp) {
+      context.script_state_size -= script_block.size;
       it = context.script_state_map.erase(it);
       ++context.expired_event_count;
 
@@ -325,6 +440,29 @@ Status PowershellEventSubscriber::processEventExpiration(Context& context) {
   return Status::success();
 }
 
+void PowershellEventSubscriber::processEventEviction(Context& context) {
+  auto max_size =
+      static_cast<std::size_t>(FLAGS_powershell_events_max_pending_mb) *
+      1024U * 1024U;
+  if (max_size == 0U) {
+    return;
+  }
+
+  while (context.script_state_size > max_size &&
+         !context.script_state_map.empty()) {
+    auto oldest_it = std::min_element(
+        context.script_state_map.begin(),
+        context.script_state_map.end(),
+        [](const auto& lhs, const auto& rhs) {
+          return lhs.second.last_message_time < rhs.second.last_message_time;
+        });
+
+    context.script_state_size -= oldest_it->second.size;
+    context.script_state_map.erase(oldest_it);
+    ++context.evicted_event_count;
+  }
+}
+
 Status PowershellEventSubscriber::Callback(const ECRef& event,
                                            const SCRef& subscription) {
   d_->context.character_frequency_map = subscription->character_frequency_map;
@@ -363,6 +501,21 @@ Status PowershellEventSubscriber::Callback(const ECRef& event,
     d_->context.expired_event_count = 0;
   }
 
+  if (d_->context.evicted_event_count > 0U) {
+    LOG(ERROR) << d_->context.evicted_event_count
+               << " incomplete script events have been evicted in "
+                  "powershell_events, over the memory budget";
+
+    d_->context.evicted_event_count = 0;
+  }
+
+  if (d_->context.truncated_event_count > 0U) {
+    VLOG(1) << d_->context.truncated_event_count
+            << " script events have been truncated in powershell_events";
+
+    d_->context.truncated_event_count = 0;
+  }
+
   return Status::success();
 }
 } // namespace osquery
@@ -8,11 +8,14 @@
  */
 
 #include <ctime>
+#include <map>
+#include <memory>
 
 #include <boost/optional.hpp>
 
 #include <osquery/events/eventsubscriber.h>
 #include <osquery/events/windows/windowseventlogpublisher.h>
+#include <osquery/hashing/hashing.h>
 
 namespace osquery {
 class PowershellEventSubscriber
@@ -41,23 +44,67 @@ class PowershellEventSubscriber
       std::string script_name;
     };
 
-    using ScriptMessageList = std::vector<ScriptMessage>;
+    /**
+     * @brief A script block reassembled from its messages.
+     *
+     * The text of each message is appended and hashed once the messages
+     * before it arrived, messages received out of order are held until then.
+     */
+    struct ScriptBlock final {
+      /// The first message received, without its text, describes the row.
+      ScriptMessage first_message;
+
+      /// The text of the appended messages, up to the script size limit.
+      std::string script_text;
+
+      /// The hash of the text of every appended message.
+      std::unique_ptr<Hash> script_hash;
+
+      /// The messages received ahead of the next message to append.
+      std::map<std::size_t, std::string> pending_messages;
+
+      /// The number of the next message to append.
+      std::size_t next_message_number{1U};
+
+      /// The bytes of the script text and pending messages.
+      std::size_t size{0U};
+
+      /// The script text was truncated.
+      bool truncated{false};
+
+      /// When the last message of the block was received.
+      std::time_t last_message_time{0U};
+    };
 
     std::vector<double> character_frequency_map;
-    std::unordered_map<ScriptBlockID, ScriptMessageList> script_state_map;
+    std::unordered_map<ScriptBlockID, ScriptBlock> script_state_map;
+
+    /// The bytes held by the incomplete blocks of script_state_map.
+    std::size_t script_state_size{0U};
 
     std::vector<Row> row_list;
 
     std::time_t last_event_expiration_time{0U};
     std::size_t invalid_event_count{0U};
     std::size_t expired_event_count{0U};
+    std::size_t evicted_event_count{0U};
+    std::size_t truncated_event_count{0U};
   };
 
   static Status generateRow(
       Row& row,
-      std::vector<Context::ScriptMessage> script_message_list,
+      Context::ScriptBlock script_block,
       const std::vector<double>& character_frequency_map);
 
+  /**
+   * @brief Add a message to the script block it belongs to.
+   *
+   * @return A failure for a message of another script block size, or a
+   * message that was already received.
+   */
+  static Status appendScriptMessage(Context::ScriptBlock& script_block,
+                                    Context::ScriptMessage script_message);
+
   static Status parseScriptMessageEvent(
       boost::optional<Context::ScriptMessage>& script_message_opt,
       const boost::property_tree::ptree& event);
@@ -67,6 +114,9 @@ class PowershellEventSubscriber
 
   static Status processEventExpiration(Context& context);
 
+  /// Evict the least recently updated incomplete blocks over the budget.
+  static void processEventEviction(Context& context);
+
  private:
   struct PrivateData;
   std::unique_ptr<PrivateData> d_;
@@ -77,14 +77,16 @@ QueryData genCurl(QueryContext& context) {
     r["method"] = "GET";
     r["user_agent"] =
         user_agents.empty() ? kOsqueryUserAgent : *(user_agents.begin());
+    results.push_back(std::move(r));
+  }
 
-    auto status = processRequest(r);
+  // Each request only fills its own row.
+  runTableRequests(results.size(), [&results](size_t i) {
+    auto status = processRequest(results[i]);
     if (!status.ok()) {
       LOG(WARNING) << "Error making request: " << status.getMessage();
     }
-
-    results.push_back(r);
-  }
+  });
 
   return results;
 }
@@ -36,7 +36,9 @@
 
 #include <algorithm>
 #include <iomanip>
+#include <iterator>
 #include <string>
+#include <vector>
 
 namespace osquery {
 namespace tables {
@@ -447,12 +449,22 @@ QueryData genTLSCertificate(QueryContext& context) {
     }
   }
 
-  for (const auto& hostname : hostnames) {
-    auto s = getTLSCertificate(hostname, results, dump_certificate, timeout);
+  // Each request fills its own results, appended in the hostname order.
+  std::vector<std::string> requests(hostnames.begin(), hostnames.end());
+  std::vector<QueryData> certificates(requests.size());
+  runTableRequests(requests.size(), [&](size_t i) {
+    auto s = getTLSCertificate(
+        requests[i], certificates[i], dump_certificate, timeout);
     if (!s.ok()) {
-      LOG(INFO) << "Cannot get certificate for " << hostname << ": "
+      LOG(INFO) << "Cannot get certificate for " << requests[i] << ": "
                 << s.getMessage();
     }
+  });
+
+  for (auto& certificate : certificates) {
+    std::move(certificate.begin(),
+              certificate.end(),
+              std::back_inserter(results));
   }
 
   return results;
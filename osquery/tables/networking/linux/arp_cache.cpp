@@ -9,25 +9,26 @@
 
 #include <fstream>
 
+#include <linux/rtnetlink.h>
+
 #include <boost/algorithm/string/split.hpp>
 #include <boost/algorithm/string/trim.hpp>
 
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
+#include <osquery/tables/networking/linux/netlink_cache.h>
 
 namespace osquery {
 namespace tables {
 
 const std::string kLinuxArpTable = "/proc/net/arp";
 
-QueryData genArpCache(QueryContext& context) {
-  QueryData results;
-
+Status genArpEntries(QueryData& results) {
   boost::filesystem::path arp_path = kLinuxArpTable;
   if (!osquery::isReadable(arp_path).ok()) {
     VLOG(1) << "Cannot read arp table";
-    return results;
+    return Status::failure("Cannot read arp table");
   }
 
   std::ifstream fd(arp_path.string(), std::ios::in | std::ios::binary);
@@ -35,7 +36,7 @@ QueryData genArpCache(QueryContext& context) {
 
   if (fd.fail() || fd.eof()) {
     VLOG(1) << "Empty or failed arp table";
-    return results;
+    return Status::failure("Empty or failed arp table");
   }
 
   // Read the header line.
@@ -72,7 +73,13 @@ QueryData genArpCache(QueryContext& context) {
     results.push_back(r);
   }
 
-  return results;
+  return Status::success();
+}
+
+QueryData genArpCache(QueryContext& context) {
+  // The table is read again only after a neighbour or interface change.
+  static NetlinkCachedRows entries(RTMGRP_NEIGH | RTMGRP_LINK);
+  return entries.get(genArpEntries);
 }
 }
 }
@@ -7,6 +7,7 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <set>
 #include <sstream>
 
 #include <arpa/inet.h>
@@ -19,6 +20,7 @@
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
+#include <osquery/sql/dynamic_table_row.h>
 #include <osquery/tables/networking/posix/utils.h>
 #include <osquery/utils/conversions/split.h>
 
@@ -107,7 +109,9 @@ void parseIptcpRule(const iptcproxy_rule& rule, Row& r) {
   r["outiface_mask"] = SQL_TEXT(outiface_mask);
 }
 
-void genIPTablesRules(const std::string& filter, QueryData& results) {
+void genIPTablesRules(const std::string& filter,
+                      const std::set<std::string>& chains,
+                      RowYield& yield) {
   Row r;
   r["filter_name"] = filter;
 
@@ -120,6 +124,9 @@ void genIPTablesRules(const std::string& filter, QueryData& results) {
   // Iterate through chains
   for (auto chain = iptcproxy_first_chain(handle); chain != nullptr;
        chain = iptcproxy_next_chain(handle)) {
+    if (!chains.empty() && chains.count(chain->chain) == 0) {
+      continue;
+    }
     r["chain"] = SQL_TEXT(chain->chain);
 
     if (chain->policy != nullptr) {
@@ -132,39 +139,41 @@ void genIPTablesRules(const std::string& filter, QueryData& results) {
       r["bytes"] = "0";
     }
 
-    // Iterating through all the rules per chain
+    // Rules are yielded as they are parsed, large rulesets are not held.
     for (auto rule = iptcproxy_first_rule(chain->chain, handle);
          rule != nullptr;
          rule = iptcproxy_next_rule(handle)) {
       Row ruleRow{r};
       parseIptcpRule(*rule, ruleRow);
-      results.push_back(std::move(ruleRow));
+      yield(TableRowHolder(new DynamicTableRow(std::move(ruleRow))));
     } // Rule iteration
-    results.push_back(r);
+    yield(TableRowHolder(new DynamicTableRow(Row(r))));
   } // Chain iteration
 
   iptcproxy_free(handle);
 }
 
-QueryData genIptables(QueryContext& context) {
-  QueryData results;
-
+void genIptables(RowYield& yield, QueryContext& context) {
   // Read in table names
   std::string content;
   auto s = osquery::readFile(kLinuxIpTablesNames, content);
-  if (s.ok()) {
-    for (auto& line : split(content, "\n")) {
-      boost::trim(line);
-      if (line.size() > 0) {
-        genIPTablesRules(line, results);
-      }
-    }
-  } else {
+  if (!s.ok()) {
     // Permissions issue or iptables modules are not loaded.
     TLOG << "Error reading " << kLinuxIpTablesNames << " : " << s.toString();
+    return;
   }
 
-  return results;
+  // Only the requested tables are loaded, and only the loaded ones: the
+  // kernel would load the module of an unknown table name.
+  auto filters = context.constraints["filter_name"].getAll(EQUALS);
+  auto chains = context.constraints["chain"].getAll(EQUALS);
+  for (auto& line : split(content, "\n")) {
+    boost::trim(line);
+    if (line.empty() || (!filters.empty() && filters.count(line) == 0)) {
+      continue;
+    }
+    genIPTablesRules(line, chains, yield);
+  }
 }
 } // namespace tables
 } // namespace osquery
@@ -0,0 +1,89 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <cerrno>
+#include <cstring>
+
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <osquery/logger/logger.h>
+#include <osquery/tables/networking/linux/netlink_cache.h>
+
+namespace osquery {
+namespace tables {
+
+NetlinkChangeMonitor::NetlinkChangeMonitor(std::uint32_t groups) {
+  fd_ = ::socket(
+      AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE);
+  if (fd_ < 0) {
+    VLOG(1) << "Cannot open a NETLINK socket: " << std::strerror(errno);
+    return;
+  }
+
+  struct sockaddr_nl address;
+  std::memset(&address, 0, sizeof(address));
+  address.nl_family = AF_NETLINK;
+  address.nl_groups = groups;
+  if (::bind(fd_, reinterpret_cast<struct sockaddr*>(&address),
+             sizeof(address)) != 0) {
+    VLOG(1) << "Cannot subscribe to NETLINK groups: " << std::strerror(errno);
+    ::close(fd_);
+    fd_ = -1;
+  }
+}
+
+NetlinkChangeMonitor::~NetlinkChangeMonitor() {
+  if (fd_ >= 0) {
+    ::close(fd_);
+  }
+}
+
+bool NetlinkChangeMonitor::changed() {
+  if (fd_ < 0) {
+    return true;
+  }
+
+  // The notifications are not parsed, their arrival is the change.
+  bool changed = false;
+  char buffer[8192];
+  while (true) {
+    auto bytes = ::recv(fd_, buffer, sizeof(buffer), MSG_DONTWAIT);
+    if (bytes > 0) {
+      changed = true;
+      continue;
+    }
+    if (bytes < 0 && errno == EINTR) {
+      continue;
+    }
+    if (bytes < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+      // ENOBUFS, notifications were dropped.
+      changed = true;
+      if (errno == ENOBUFS) {
+        continue;
+      }
+    }
+    break;
+  }
+  return changed;
+}
+
+QueryData NetlinkCachedRows::get(const Generate& generate) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (monitor_.changed() || !valid_) {
+    rows_.clear();
+    valid_ = generate(rows_).ok();
+  }
+  return rows_;
+}
+
+} // namespace tables
+} // namespace osquery
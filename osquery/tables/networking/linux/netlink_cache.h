@@ -0,0 +1,74 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/core/tables.h>
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+namespace tables {
+
+/**
+ * @brief Notice kernel network state changes through rtnetlink multicast.
+ *
+ * A socket is subscribed to the RTMGRP_* groups announcing a change of the
+ * state. The notifications queue up in the socket between two calls and are
+ * only drained, a lost notification overflows the queue and is reported as a
+ * change as well.
+ */
+class NetlinkChangeMonitor : private boost::noncopyable {
+ public:
+  /// Subscribe to a mask of RTMGRP_* groups.
+  explicit NetlinkChangeMonitor(std::uint32_t groups);
+
+  ~NetlinkChangeMonitor();
+
+  /// The state may have changed since the previous call, or cannot be known.
+  bool changed();
+
+ private:
+  int fd_{-1};
+};
+
+/**
+ * @brief The rows of a table, generated again only when the state changed.
+ *
+ * The subscription starts before the first generation and the notifications
+ * are drained before each one, a change during a generation is seen by the
+ * next query.
+ */
+class NetlinkCachedRows : private boost::noncopyable {
+ public:
+  explicit NetlinkCachedRows(std::uint32_t groups) : monitor_(groups) {}
+
+  using Generate = std::function<Status(QueryData& rows)>;
+
+  /**
+   * @brief The cached rows, generated again after a change notification.
+   *
+   * The rows of a failed generation are returned but not kept.
+   */
+  QueryData get(const Generate& generate);
+
+ private:
+  std::mutex mutex_;
+  NetlinkChangeMonitor monitor_;
+  bool valid_{false};
+  QueryData rows_;
+};
+
+} // namespace tables
+} // namespace osquery
@@ -11,10 +11,60 @@
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/filesystem/linux/proc.h>
+#include <osquery/tables/networking/linux/sock_diag.h>
 
 namespace osquery {
 namespace tables {
 
+namespace {
+
+/// The protocols enumerated with sock_diag within our network namespace.
+const std::set<int> kSockDiagProtocols = {
+    IPPROTO_TCP, IPPROTO_UDP, IPPROTO_UDPLITE};
+
+/// The TCP states selected by the state constraints, used by sock_diag.
+std::uint32_t getTcpStates(QueryContext& context) {
+  if (!context.constraints["state"].exists(EQUALS)) {
+    return kSockDiagAllStates;
+  }
+
+  std::uint32_t states = 0;
+  for (const auto& state : context.constraints["state"].getAll(EQUALS)) {
+    for (size_t i = 1; i < tcp_states.size(); i++) {
+      if (tcp_states[i] == state) {
+        states |= (1U << i);
+      }
+    }
+  }
+  return states;
+}
+
+/// Collect the AF_INET and AF_INET6 sockets of a protocol.
+void genInetSockets(int protocol,
+                    ino_t ns,
+                    bool own_ns,
+                    std::uint32_t tcp_states,
+                    const std::string& pid,
+                    SocketInfoList& socket_list) {
+  for (auto family : {AF_INET, AF_INET6}) {
+    // The netlink socket only reports the namespace of this process.
+    if (own_ns && kSockDiagProtocols.count(protocol) > 0 &&
+        sockDiagGetSocketList(family, protocol, ns, tcp_states, socket_list)
+            .ok()) {
+      continue;
+    }
+
+    auto status = procGetSocketList(family, protocol, ns, pid, socket_list);
+    if (!status.ok()) {
+      VLOG(1) << "Results for process_open_sockets might be incomplete. Failed "
+                 "to acquire basic socket information for "
+              << (family == AF_INET ? "AF_INET " : "AF_INET6 ")
+              << kLinuxProtocolNames.at(protocol) << ": " << status.what();
+    }
+  }
+}
+} // namespace
+
 QueryData genOpenSockets(QueryContext& context) {
   Status status;
   QueryData results;
@@ -65,17 +115,33 @@ QueryData genOpenSockets(QueryContext& context) {
    * 1 and 2.
    */
 
+  /* The sockets of our own namespace are enumerated using sock_diag. */
+  ino_t own_ns = 0;
+  ProcessNamespaceList own_namespaces;
+  if (procGetProcessNamespaces(
+          std::to_string(getpid()), own_namespaces, {"net"})
+          .ok()) {
+    own_ns = own_namespaces["net"];
+  }
+  auto tcp_states = getTcpStates(context);
+
+  /* Reading every descriptor is only needed for the pid and fd columns. */
+  bool map_inodes = pid_filter || context.isAnyColumnUsed({"pid", "fd"});
+
   /* Use a set to record the namespaces already processed */
   std::set<ino_t> netns_list;
   SocketInodeToProcessInfoMap inode_proc_map;
   SocketInfoList socket_list;
   for (const auto& pid : pids) {
     /* Step 1 */
-    status = procGetSocketInodeToProcessInfoMap(pid, inode_proc_map);
-    if (!status.ok()) {
-      VLOG(1) << "Results for process_open_sockets might be incomplete. Failed "
-                 "to acquire socket inode to process map for pid "
-              << pid << ": " << status.what();
+    if (map_inodes) {
+      status = procGetSocketInodeToProcessInfoMap(pid, inode_proc_map);
+      if (!status.ok()) {
+        VLOG(1)
+            << "Results for process_open_sockets might be incomplete. Failed "
+               "to acquire socket inode to process map for pid "
+            << pid << ": " << status.what();
+      }
     }
 
     /* Step 2 */
@@ -100,21 +166,12 @@ QueryData genOpenSockets(QueryContext& context) {
 
       /* Step 3 */
       for (const auto& pair : kLinuxProtocolNames) {
-        status = procGetSocketList(AF_INET, pair.first, ns, pid, socket_list);
-        if (!status.ok()) {
-          VLOG(1)
-              << "Results for process_open_sockets might be incomplete. Failed "
-                 "to acquire basic socket information for AF_INET "
-              << pair.second << ": " << status.what();
-        }
-
-        status = procGetSocketList(AF_INET6, pair.first, ns, pid, socket_list);
-        if (!status.ok()) {
-          VLOG(1)
-              << "Results for process_open_sockets might be incomplete. Failed "
-                 "to acquire basic socket information for AF_INET6 "
-              << pair.second << ": " << status.what();
-        }
+        genInetSockets(pair.first,
+                       ns,
+                       own_ns != 0 && ns == own_ns,
+                       tcp_states,
+                       pid,
+                       socket_list);
       }
       status = procGetSocketList(AF_UNIX, IPPROTO_IP, ns, pid, socket_list);
       if (!status.ok()) {
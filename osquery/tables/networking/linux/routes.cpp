@@ -13,12 +13,17 @@
 #include <poll.h>
 #include <sys/socket.h>
 
+#include <chrono>
+#include <unordered_map>
+#include <vector>
+
 #include <boost/algorithm/string/trim.hpp>
 
 #include <osquery/core/core.h>
 #include <osquery/core/tables.h>
 #include <osquery/logger/logger.h>
 
+#include <osquery/tables/networking/linux/netlink_cache.h>
 #include <osquery/tables/networking/posix/utils.h>
 
 namespace osquery {
@@ -29,6 +34,7 @@ namespace tables {
 constexpr auto kDefaultIpv6Route = "::";
 constexpr auto kDefaultIpv4Route = "0.0.0.0";
 constexpr unsigned kMaxPollWaitInMS{5000}; // MAX poll wait in milliseconds
+constexpr std::uint32_t kRouteDumpSequence{1};
 
 std::string getNetlinkIP(int family, const char* buffer) {
   char dst[INET6_ADDRSTRLEN] = {0};
@@ -55,86 +61,24 @@ std::string getDefaultRouteIP(int family) {
   }
 }
 
-Status readNetlink(int socket_fd, int seq, char* output, size_t* size) {
-  struct nlmsghdr* nl_hdr = nullptr;
-  pollfd fds[] = {{socket_fd, POLLIN, 0}};
-  auto start_time_pt = std::chrono::steady_clock::now();
-  do {
-    ssize_t bytes = 0;
-    while (bytes == 0) {
-      auto cur_time_pt = std::chrono::steady_clock::now();
-      auto time_elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
-                              cur_time_pt - start_time_pt)
-                              .count();
-      if (time_elapsed >= kMaxPollWaitInMS) {
-        LOG(WARNING) << "Netlink timeout";
-        return Status(1, "Netlink timeout");
-      }
-
-      int poll_status = ::poll(fds, 1, kMaxPollWaitInMS - time_elapsed);
-      if (poll_status == 0) {
-        LOG(WARNING) << "Netlink timeout";
-        return Status(1, "Netlink timeout");
-      } else if (poll_status < 0) {
-        if (errno != EINTR) {
-          LOG(WARNING) << "poll() failed with error " << errno;
-          return Status(1, "poll() failed");
-        }
-        continue;
-      }
-
-      if ((fds[0].revents & POLLIN) == 0) {
-        continue;
-      }
-
-      if (MAX_NETLINK_SIZE - *size >= sizeof(struct nlmsghdr)) {
-        bytes = recv(socket_fd, output, MAX_NETLINK_SIZE - *size, 0);
-        if (bytes < 0) {
-          // Unrecoverable NETLINK error, bail.
-          return Status(1, "Could not read from NETLINK");
-        }
-      } else {
-        break;
-      }
-    }
-
-    if (bytes == 0 && *size == 0) {
-      return Status(1, "No data returned from NETLINK");
-    }
-
-    // Assure valid header response, and not an error type.
-    nl_hdr = (struct nlmsghdr*)output;
-    if (NLMSG_OK(nl_hdr, bytes) == 0 || nl_hdr->nlmsg_type == NLMSG_ERROR) {
-      if (*size) {
-        return Status(0, "Process whatever we received");
-      }
-      return Status(1, "Read invalid NETLINK message");
-    }
-
-    if (static_cast<pid_t>(nl_hdr->nlmsg_seq) != seq ||
-        static_cast<pid_t>(nl_hdr->nlmsg_pid) != getpid()) {
-      continue;
-    }
-
-    if (nl_hdr->nlmsg_type == NLMSG_DONE) {
-      break;
-    }
-
-    *size += bytes;
-    output += bytes;
-
-    if ((nl_hdr->nlmsg_flags & NLM_F_MULTI)) {
-      continue;
-    }
-  } while (true);
+/// Interface names by index, resolved once for each dump.
+using InterfaceNames = std::unordered_map<int, std::string>;
 
-  return Status::success();
+const std::string& getInterfaceName(int index, InterfaceNames& interfaces) {
+  auto it = interfaces.find(index);
+  if (it == interfaces.end()) {
+    char interface[IF_NAMESIZE] = {0};
+    if_indextoname(index, interface);
+    it = interfaces.emplace(index, interface).first;
+  }
+  return it->second;
 }
 
-void genNetlinkRoutes(const struct nlmsghdr* netlink_msg, QueryData& results) {
+void genNetlinkRoutes(const struct nlmsghdr* netlink_msg,
+                      InterfaceNames& interfaces,
+                      QueryData& results) {
   std::string address;
   int mask = 0;
-  char interface[IF_NAMESIZE] = {0};
 
   struct rtmsg* message = static_cast<struct rtmsg*>(NLMSG_DATA(netlink_msg));
   struct rtattr* attr = static_cast<struct rtattr*>(RTM_RTA(message));
@@ -150,8 +94,7 @@ void genNetlinkRoutes(const struct nlmsghdr* netlink_msg, QueryData& results) {
   while (RTA_OK(attr, attr_size)) {
     switch (attr->rta_type) {
     case RTA_OIF:
-      if_indextoname(*(int*)RTA_DATA(attr), interface);
-      r["interface"] = std::string(interface);
+      r["interface"] = getInterfaceName(*(int*)RTA_DATA(attr), interfaces);
       break;
     case RTA_GATEWAY:
       address = getNetlinkIP(message->rtm_family, (char*)RTA_DATA(attr));
@@ -216,59 +159,112 @@ void genNetlinkRoutes(const struct nlmsghdr* netlink_msg, QueryData& results) {
   // This is the cidr-formatted mask
   r["netmask"] = INTEGER(mask);
 
-  results.push_back(r);
+  results.push_back(std::move(r));
 }
 
-QueryData genRoutes(QueryContext& context) {
-  QueryData results;
+/// Wait for the next part of the dump, until the dump deadline.
+Status pollNetlink(int socket_fd,
+                   std::chrono::steady_clock::time_point deadline) {
+  pollfd fds[] = {{socket_fd, POLLIN, 0}};
+  while (true) {
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                         deadline - std::chrono::steady_clock::now())
+                         .count();
+    if (remaining <= 0) {
+      return Status::failure("Netlink timeout");
+    }
 
-  int socket_fd = socket(PF_NETLINK, SOCK_DGRAM, NETLINK_ROUTE);
-  if (socket_fd < 0) {
-    VLOG(1) << "Cannot open NETLINK socket";
-    return {};
+    int poll_status = ::poll(fds, 1, static_cast<int>(remaining));
+    if (poll_status < 0 && errno == EINTR) {
+      continue;
+    } else if (poll_status < 0) {
+      return Status::failure("poll() failed with error " +
+                             std::to_string(errno));
+    } else if (poll_status == 0) {
+      return Status::failure("Netlink timeout");
+    } else if ((fds[0].revents & POLLIN) != 0) {
+      return Status::success();
+    }
   }
+}
 
-  // Create netlink message header
-  auto netlink_buffer = (void*)malloc(MAX_NETLINK_SIZE);
-  if (netlink_buffer == nullptr) {
-    close(socket_fd);
-    return {};
+Status dumpRoutes(QueryData& results) {
+  int socket_fd = socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_ROUTE);
+  if (socket_fd < 0) {
+    return Status::failure("Cannot open NETLINK socket");
   }
 
-  memset(netlink_buffer, 0, MAX_NETLINK_SIZE);
-  auto netlink_msg = (struct nlmsghdr*)netlink_buffer;
+  std::vector<char> buffer(MAX_NETLINK_SIZE);
+  auto netlink_msg = reinterpret_cast<struct nlmsghdr*>(buffer.data());
   netlink_msg->nlmsg_len = NLMSG_LENGTH(sizeof(struct rtmsg));
   netlink_msg->nlmsg_type = RTM_GETROUTE; // routes from kernel routing table
   netlink_msg->nlmsg_flags = NLM_F_DUMP | NLM_F_REQUEST | NLM_F_ATOMIC;
-  netlink_msg->nlmsg_seq = 0;
-  netlink_msg->nlmsg_pid = getpid();
+  netlink_msg->nlmsg_seq = kRouteDumpSequence;
+  netlink_msg->nlmsg_pid = 0;
 
   // Send the netlink request to the kernel
   if (send(socket_fd, netlink_msg, netlink_msg->nlmsg_len, 0) < 0) {
-    TLOG << "Cannot write NETLINK request header to socket";
     close(socket_fd);
-    free(netlink_buffer);
-    return {};
+    return Status::failure("Cannot write NETLINK request header to socket");
   }
 
-  // Wrap the read socket to support multi-netlink messages
-  size_t size = 0;
-  if (!readNetlink(socket_fd, 0, (char*)netlink_msg, &size).ok()) {
-    TLOG << "Cannot read NETLINK response from socket";
-    close(socket_fd);
-    free(netlink_buffer);
-    return {};
-  }
+  // Each part of the dump is parsed as it is received, the size of a routing
+  // table is not bounded by the buffer.
+  InterfaceNames interfaces;
+  auto deadline = std::chrono::steady_clock::now() +
+                  std::chrono::milliseconds(kMaxPollWaitInMS);
+  Status status;
+  bool done = false;
+  while (!done) {
+    status = pollNetlink(socket_fd, deadline);
+    if (!status.ok()) {
+      break;
+    }
 
-  // Treat the netlink response as route information
-  while (NLMSG_OK(netlink_msg, size)) {
-    genNetlinkRoutes(netlink_msg, results);
-    netlink_msg = NLMSG_NEXT(netlink_msg, size);
+    auto bytes = recv(socket_fd, buffer.data(), buffer.size(), 0);
+    if (bytes < 0 && errno == EINTR) {
+      continue;
+    } else if (bytes <= 0) {
+      status = Status::failure("Could not read from NETLINK");
+      break;
+    }
+
+    auto size = static_cast<size_t>(bytes);
+    netlink_msg = reinterpret_cast<struct nlmsghdr*>(buffer.data());
+    for (; NLMSG_OK(netlink_msg, size);
+         netlink_msg = NLMSG_NEXT(netlink_msg, size)) {
+      if (netlink_msg->nlmsg_seq != kRouteDumpSequence) {
+        continue;
+      }
+
+      if (netlink_msg->nlmsg_type == NLMSG_DONE) {
+        done = true;
+        break;
+      } else if (netlink_msg->nlmsg_type == NLMSG_ERROR) {
+        status = Status::failure("Read invalid NETLINK message");
+        done = true;
+        break;
+      }
+      genNetlinkRoutes(netlink_msg, interfaces, results);
+    }
   }
 
   close(socket_fd);
-  free(netlink_buffer);
-  return results;
+  return status;
+}
+
+QueryData genRoutes(QueryContext& context) {
+  // Routes are dumped again only after a route or interface change.
+  static NetlinkCachedRows routes(RTMGRP_IPV4_ROUTE | RTMGRP_IPV6_ROUTE |
+                                  RTMGRP_LINK);
+  return routes.get([](QueryData& results) {
+    auto status = dumpRoutes(results);
+    if (!status.ok()) {
+      TLOG << "Cannot read the routes through NETLINK: "
+           << status.getMessage();
+    }
+    return status;
+  });
 }
 }
 }
@@ -0,0 +1,149 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <linux/netlink.h>
+#include <linux/sock_diag.h>
+
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#include <osquery/tables/networking/linux/inet_diag.h>
+#include <osquery/tables/networking/linux/sock_diag.h>
+
+namespace osquery {
+
+namespace {
+
+/// The receive buffer, the kernel fills it with as many records as fit.
+const size_t kSockDiagBufferSize{32768};
+
+/// Closes the netlink socket when the enumeration returns.
+class SockDiagSocket {
+ public:
+  SockDiagSocket() {
+    fd_ = ::socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_SOCK_DIAG);
+  }
+
+  ~SockDiagSocket() {
+    if (fd_ >= 0) {
+      ::close(fd_);
+    }
+  }
+
+  int fd() const {
+    return fd_;
+  }
+
+ private:
+  int fd_{-1};
+};
+
+std::string decodeAddress(int family, const __be32* address) {
+  char buffer[INET6_ADDRSTRLEN] = {0};
+  inet_ntop(family, address, buffer, sizeof(buffer));
+  return buffer;
+}
+} // namespace
+
+Status sockDiagGetSocketList(int family,
+                             int protocol,
+                             ino_t net_ns,
+                             std::uint32_t states,
+                             SocketInfoList& result) {
+  if (family != AF_INET && family != AF_INET6) {
+    return Status::failure("Invalid family " + std::to_string(family));
+  }
+
+  SockDiagSocket sock;
+  if (sock.fd() < 0) {
+    return Status::failure("Cannot open a sock_diag socket: " +
+                           std::string(strerror(errno)));
+  }
+
+  struct {
+    struct nlmsghdr header;
+    struct inet_diag_req_v2 request;
+  } message;
+  memset(&message, 0, sizeof(message));
+  message.header.nlmsg_len = sizeof(message);
+  message.header.nlmsg_type = SOCK_DIAG_BY_FAMILY;
+  message.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+  message.request.sdiag_family = static_cast<__u8>(family);
+  message.request.sdiag_protocol = static_cast<__u8>(protocol);
+  // UDP sockets are reported with the TCP state names of the kernel.
+  message.request.idiag_states =
+      (protocol == IPPROTO_TCP) ? states : kSockDiagAllStates;
+
+  struct sockaddr_nl address;
+  memset(&address, 0, sizeof(address));
+  address.nl_family = AF_NETLINK;
+  if (::sendto(sock.fd(),
+               &message,
+               sizeof(message),
+               0,
+               reinterpret_cast<struct sockaddr*>(&address),
+               sizeof(address)) < 0) {
+    return Status::failure("Cannot send the sock_diag request: " +
+                           std::string(strerror(errno)));
+  }
+
+  // Records are collected first, a failed dump must not add partial results.
+  SocketInfoList sockets;
+  std::vector<char> buffer(kSockDiagBufferSize);
+  while (true) {
+    auto size = ::recv(sock.fd(), buffer.data(), buffer.size(), 0);
+    if (size < 0 && errno == EINTR) {
+      continue;
+    } else if (size <= 0) {
+      return Status::failure("Cannot read the sock_diag response");
+    }
+
+    auto remaining = static_cast<unsigned int>(size);
+    for (auto header = reinterpret_cast<struct nlmsghdr*>(buffer.data());
+         NLMSG_OK(header, remaining);
+         header = NLMSG_NEXT(header, remaining)) {
+      if (header->nlmsg_type == NLMSG_DONE) {
+        for (auto& socket_info : sockets) {
+          result.push_back(std::move(socket_info));
+        }
+        return Status::success();
+      } else if (header->nlmsg_type == NLMSG_ERROR) {
+        // The protocol may be unsupported, the diag module is not loaded.
+        return Status::failure("The sock_diag request failed");
+      } else if (header->nlmsg_len < NLMSG_LENGTH(sizeof(inet_diag_msg))) {
+        continue;
+      }
+
+      auto record = static_cast<struct inet_diag_msg*>(NLMSG_DATA(header));
+      SocketInfo socket_info = {};
+      socket_info.socket = std::to_string(record->idiag_inode);
+      socket_info.net_ns = net_ns;
+      socket_info.family = family;
+      socket_info.protocol = protocol;
+      socket_info.local_address = decodeAddress(family, record->id.idiag_src);
+      socket_info.local_port = ntohs(record->id.idiag_sport);
+      socket_info.remote_address = decodeAddress(family, record->id.idiag_dst);
+      socket_info.remote_port = ntohs(record->id.idiag_dport);
+
+      if (protocol == IPPROTO_TCP) {
+        auto state = record->idiag_state;
+        socket_info.state = (state == 0 || state >= tcp_states.size())
+                                ? "UNKNOWN"
+                                : tcp_states[state];
+      }
+      sockets.push_back(std::move(socket_info));
+    }
+  }
+}
+
+} // namespace osquery
@@ -0,0 +1,43 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include <osquery/filesystem/linux/proc.h>
+
+namespace osquery {
+
+/// Every TCP state, the states argument of sockDiagGetSocketList.
+const std::uint32_t kSockDiagAllStates{~0U};
+
+/**
+ * @brief Enumerate the sockets of the caller's network namespace.
+ *
+ * The kernel answers a NETLINK_SOCK_DIAG dump with binary socket records,
+ * unlike /proc/<pid>/net it formats no text, and only sockets in the
+ * requested states are returned. The results match procGetSocketList.
+ *
+ * The output parameter result is used as-is, i.e. it IS NOT cleared
+ * beforehand. On failure nothing has been added.
+ *
+ * @param family AF_INET or AF_INET6.
+ * @param protocol IPPROTO_TCP, IPPROTO_UDP or IPPROTO_UDPLITE.
+ * @param net_ns The network namespace to set in the SocketInfo entries.
+ * @param states A bitmask of TCP states, by index of tcp_states.
+ * @param result The output parameter.
+ */
+Status sockDiagGetSocketList(int family,
+                             int protocol,
+                             ino_t net_ns,
+                             std::uint32_t states,
+                             SocketInfoList& result);
+
+} // namespace osquery
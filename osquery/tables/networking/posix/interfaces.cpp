@@ -20,6 +20,7 @@
 #include <limits>
 #include <linux/ethtool.h>
 #include <linux/if_link.h>
+#include <linux/rtnetlink.h>
 #include <linux/sockios.h>
 #else //  Apple || FreeBSD
 #include <net/if_media.h>
@@ -30,6 +31,9 @@
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
+#ifdef __linux__
+#include <osquery/tables/networking/linux/netlink_cache.h>
+#endif
 #include <osquery/tables/networking/posix/interfaces.h>
 #include <osquery/tables/networking/posix/utils.h>
 #include <osquery/utils/conversions/split.h>
@@ -266,13 +270,11 @@ void genDetailsFromAddr(const struct ifaddrs* addr,
   results.push_back(r);
 }
 
-QueryData genInterfaceAddresses(QueryContext& context) {
-  QueryData results;
-
+Status genAddresses(QueryData& results) {
   struct ifaddrs* if_addrs = nullptr;
   struct ifaddrs* if_addr = nullptr;
   if (getifaddrs(&if_addrs) != 0 || if_addrs == nullptr) {
-    return {};
+    return Status::failure("Cannot read the interface addresses");
   }
 
   for (if_addr = if_addrs; if_addr != nullptr; if_addr = if_addr->ifa_next) {
@@ -286,7 +288,20 @@ QueryData genInterfaceAddresses(QueryContext& context) {
   }
 
   freeifaddrs(if_addrs);
+  return Status::success();
+}
+
+QueryData genInterfaceAddresses(QueryContext& context) {
+#ifdef __linux__
+  // The addresses are read again only after an address or interface change.
+  static NetlinkCachedRows addresses(RTMGRP_LINK | RTMGRP_IPV4_IFADDR |
+                                     RTMGRP_IPV6_IFADDR);
+  return addresses.get(genAddresses);
+#else
+  QueryData results;
+  genAddresses(results);
   return results;
+#endif
 }
 
 QueryData genInterfaceDetails(QueryContext& context) {
@@ -0,0 +1,86 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <gtest/gtest.h>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <osquery/tables/networking/linux/sock_diag.h>
+
+namespace osquery {
+namespace tables {
+
+class SockDiagTests : public testing::Test {};
+
+TEST_F(SockDiagTests, test_matches_proc) {
+  // Listen on an ephemeral loopback port.
+  auto fd = socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_GE(fd, 0);
+
+  struct sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t length = sizeof(address);
+  ASSERT_EQ(bind(fd, reinterpret_cast<struct sockaddr*>(&address), length), 0);
+  ASSERT_EQ(listen(fd, 1), 0);
+  ASSERT_EQ(
+      getsockname(fd, reinterpret_cast<struct sockaddr*>(&address), &length),
+      0);
+
+  struct stat sb;
+  ASSERT_EQ(fstat(fd, &sb), 0);
+  auto inode = std::to_string(sb.st_ino);
+
+  auto find = [&inode](const SocketInfoList& sockets) -> const SocketInfo* {
+    for (const auto& socket_info : sockets) {
+      if (socket_info.socket == inode) {
+        return &socket_info;
+      }
+    }
+    return nullptr;
+  };
+
+  SocketInfoList diag_list;
+  auto status = sockDiagGetSocketList(
+      AF_INET, IPPROTO_TCP, 0, kSockDiagAllStates, diag_list);
+  if (!status.ok()) {
+    close(fd);
+    GTEST_SKIP() << "sock_diag is not available: " << status.what();
+  }
+
+  SocketInfoList proc_list;
+  auto pid = std::to_string(getpid());
+  ASSERT_TRUE(procGetSocketList(AF_INET, IPPROTO_TCP, 0, pid, proc_list).ok());
+
+  auto diag = find(diag_list);
+  auto proc = find(proc_list);
+  ASSERT_NE(diag, nullptr);
+  ASSERT_NE(proc, nullptr);
+  EXPECT_EQ(diag->local_address, "127.0.0.1");
+  EXPECT_EQ(diag->local_address, proc->local_address);
+  EXPECT_EQ(diag->local_port, ntohs(address.sin_port));
+  EXPECT_EQ(diag->local_port, proc->local_port);
+  EXPECT_EQ(diag->remote_port, proc->remote_port);
+  EXPECT_EQ(diag->state, "LISTEN");
+  EXPECT_EQ(diag->state, proc->state);
+
+  // Sockets in other states are filtered by the kernel.
+  diag_list.clear();
+  ASSERT_TRUE(
+      sockDiagGetSocketList(AF_INET, IPPROTO_TCP, 0, 1U << 1, diag_list).ok());
+  EXPECT_EQ(find(diag_list), nullptr);
+
+  close(fd);
+}
+
+} // namespace tables
+} // namespace osquery
@@ -7,7 +7,11 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+#include <functional>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 // clang-format off
 #include <osquery/utils/system/system.h>
@@ -58,104 +62,199 @@ void genInterfaceDetail(const IP_ADAPTER_ADDRESSES* adapter, Row& r) {
   // TODO: These values will need an equivalent on Windows systems
   r["last_change"] = BIGINT("-1");
   r["collisions"] = BIGINT("-1");
+}
 
-  // Grab the remaining table values from WMI
-  auto query =
-      "SELECT * FROM Win32_PerfRawData_Tcpip_NetworkInterface WHERE "
-      "Name = \"" +
-      r["description"] + "\"";
-
-  const auto req1 = WmiRequest::CreateWmiRequest(query);
-  if (req1 && req1->getStatus().ok()) {
-    const auto& results = req1->results();
-    if (!results.empty()) {
-      std::string sPlaceHolder;
-
-      results[0].GetString("PacketsReceivedPerSec", sPlaceHolder);
-      r["ipackets"] =
-          BIGINT(tryTo<unsigned long long>(sPlaceHolder).takeOr(0ull));
-      results[0].GetString("PacketsSentPerSec", sPlaceHolder);
-      r["opackets"] =
-          BIGINT(tryTo<unsigned long long>(sPlaceHolder).takeOr(0ull));
-
-      results[0].GetString("BytesReceivedPerSec", sPlaceHolder);
-      r["ibytes"] =
-          BIGINT(tryTo<unsigned long long>(sPlaceHolder).takeOr(0ull));
-      results[0].GetString("BytesSentPerSec", sPlaceHolder);
-      r["obytes"] =
-          BIGINT(tryTo<unsigned long long>(sPlaceHolder).takeOr(0ull));
-
-      results[0].GetString("PacketsReceivedErrors", sPlaceHolder);
-      r["ierrors"] =
-          BIGINT(tryTo<unsigned long long>(sPlaceHolder).takeOr(0ull));
-      results[0].GetString("PacketsOutboundErrors", sPlaceHolder);
-      r["oerrors"] =
-          BIGINT(tryTo<unsigned long long>(sPlaceHolder).takeOr(0ull));
-
-      results[0].GetString("PacketsReceivedDiscarded", sPlaceHolder);
-      r["idrops"] =
-          BIGINT(tryTo<unsigned long long>(sPlaceHolder).takeOr(0ull));
-      results[0].GetString("PacketsOutboundDiscarded", sPlaceHolder);
-      r["odrops"] =
-          BIGINT(tryTo<unsigned long long>(sPlaceHolder).takeOr(0ull));
-    } else {
-      LOG(INFO) << "Failed to retrieve network statistics for interface "
-                << r["interface"];
+/// Rows looked up by a single WMI query, the keys are joined with OR.
+const size_t kWmiLookupBatchSize = 32;
+
+std::string quoteWqlString(const std::string& value) {
+  std::string quoted = "\"";
+  for (const auto c : value) {
+    if (c == '"' || c == '\\') {
+      quoted += '\\';
     }
+    quoted += c;
   }
+  return quoted + "\"";
+}
 
-  query =
-      "SELECT * FROM Win32_NetworkAdapter WHERE "
-      "InterfaceIndex = " +
-      r["interface"];
-  const auto req2 = WmiRequest::CreateWmiRequest(query);
-  if (req2 && req2->getStatus().ok()) {
-    const auto& results = req2->results();
-    if (!results.empty()) {
-      bool bPlaceHolder;
-      long lPlaceHolder = 0;
-      unsigned __int64 ullPlaceHolder = 0;
-      results[0].GetString("Manufacturer", r["manufacturer"]);
-      results[0].GetString("NetConnectionID", r["connection_id"]);
-      results[0].GetLong("NetConnectionStatus", lPlaceHolder);
-      r["connection_status"] = INTEGER(lPlaceHolder);
-      results[0].GetBool("NetEnabled", bPlaceHolder);
-      r["enabled"] = INTEGER(bPlaceHolder);
-      results[0].GetBool("PhysicalAdapter", bPlaceHolder);
-      r["physical_adapter"] = INTEGER(bPlaceHolder);
-      results[0].GetString("ServiceName", r["service"]);
-      results[0].GetUnsignedLongLong("Speed", ullPlaceHolder);
-      r["speed"] = INTEGER(ullPlaceHolder);
-    } else {
-      LOG(INFO) << "Failed to retrieve physical state for interface "
-                << r["interface"];
+/**
+ * @brief Look up the WMI objects of many rows with few queries.
+ *
+ * The query selects the columns from the class where the key column is one
+ * of the given WQL literals, in batches of kWmiLookupBatchSize keys.
+ */
+void queryWmiByKey(const std::string& columns,
+                   const std::string& wmi_class,
+                   const std::string& key_column,
+                   const std::vector<std::string>& keys,
+                   const std::function<void(const WmiResultItem&)>& handle) {
+  for (size_t first = 0; first < keys.size(); first += kWmiLookupBatchSize) {
+    auto last = std::min(keys.size(), first + kWmiLookupBatchSize);
+
+    std::vector<std::string> conditions;
+    for (auto i = first; i < last; ++i) {
+      conditions.push_back(key_column + " = " + keys[i]);
+    }
+
+    auto query = "SELECT " + key_column + ", " + columns + " FROM " +
+                 wmi_class + " WHERE " + osquery::join(conditions, " OR ");
+    const auto request = WmiRequest::CreateWmiRequest(query);
+    if (!request || !request->getStatus().ok()) {
+      continue;
+    }
+
+    for (const auto& result : request->results()) {
+      handle(result);
+    }
+  }
+}
+
+/// Grab the remaining table values from WMI
+void genInterfaceWmiDetails(QueryData& rows) {
+  std::unordered_map<std::string, size_t> by_description;
+  std::unordered_map<long, size_t> by_index;
+  std::vector<std::string> descriptions;
+  std::vector<std::string> indexes;
+  for (size_t i = 0; i < rows.size(); ++i) {
+    const auto& description = rows[i]["description"];
+    if (by_description.emplace(description, i).second) {
+      descriptions.push_back(quoteWqlString(description));
+    }
+
+    auto index = tryTo<long>(rows[i]["interface"]);
+    if (index.isValue() && by_index.emplace(*index, i).second) {
+      indexes.push_back(rows[i]["interface"]);
     }
   }
 
-  query =
-      "SELECT * FROM win32_networkadapterconfiguration WHERE "
-      "InterfaceIndex = " +
-      r["interface"];
-  const auto req3 = WmiRequest::CreateWmiRequest(query);
-  if (req3 && req3->getStatus().ok()) {
-    const auto& results = req3->results();
-    if (!results.empty()) {
-      bool bPlaceHolder = false;
-      std::vector<std::string> vPlaceHolder;
-      results[0].GetBool("DHCPEnabled", bPlaceHolder);
-      r["dhcp_enabled"] = INTEGER(bPlaceHolder);
-      results[0].GetString("DHCPLeaseExpires", r["dhcp_lease_expires"]);
-      results[0].GetString("DHCPLeaseObtained", r["dhcp_lease_obtained"]);
-      results[0].GetString("DHCPServer", r["dhcp_server"]);
-      results[0].GetString("DNSDomain", r["dns_domain"]);
-      results[0].GetVectorOfStrings("DNSDomainSuffixSearchOrder", vPlaceHolder);
-      r["dns_domain_suffix_search_order"] = osquery::join(vPlaceHolder, ", ");
-      results[0].GetString("DNSHostName", r["dns_host_name"]);
-      results[0].GetVectorOfStrings("DNSServerSearchOrder", vPlaceHolder);
-      r["dns_server_search_order"] = osquery::join(vPlaceHolder, ", ");
-    } else {
+  std::vector<bool> found_stats(rows.size());
+  queryWmiByKey(
+      "PacketsReceivedPerSec, PacketsSentPerSec, BytesReceivedPerSec, "
+      "BytesSentPerSec, PacketsReceivedErrors, PacketsOutboundErrors, "
+      "PacketsReceivedDiscarded, PacketsOutboundDiscarded",
+      "Win32_PerfRawData_Tcpip_NetworkInterface",
+      "Name",
+      descriptions,
+      [&](const WmiResultItem& result) {
+        std::string name;
+        result.GetString("Name", name);
+        auto it = by_description.find(name);
+        if (it == by_description.end()) {
+          return;
+        }
+
+        auto& r = rows[it->second];
+        found_stats[it->second] = true;
+        std::string sPlaceHolder;
+
+        result.GetString("PacketsReceivedPerSec", sPlaceHolder);
+        r["ipackets"] =
+            BIGINT(tryTo<unsigned long long>(sPlaceHolder).takeOr(0ull));
+        result.GetString("PacketsSentPerSec", sPlaceHolder);
+        r["opackets"] =
+            BIGINT(tryTo<unsigned long long>(sPlaceHolder).takeOr(0ull));
+
+        result.GetString("BytesReceivedPerSec", sPlaceHolder);
+        r["ibytes"] =
+            BIGINT(tryTo<unsigned long long>(sPlaceHolder).takeOr(0ull));
+        result.GetString("BytesSentPerSec", sPlaceHolder);
+        r["obytes"] =
+            BIGINT(tryTo<unsigned long long>(sPlaceHolder).takeOr(0ull));
+
+        result.GetString("PacketsReceivedErrors", sPlaceHolder);
+        r["ierrors"] =
+            BIGINT(tryTo<unsigned long long>(sPlaceHolder).takeOr(0ull));
+        result.GetString("PacketsOutboundErrors", sPlaceHolder);
+        r["oerrors"] =
+            BIGINT(tryTo<unsigned long long>(sPlaceHolder).takeOr(0ull));
+
+        result.GetString("PacketsReceivedDiscarded", sPlaceHolder);
+        r["idrops"] =
+            BIGINT(tryTo<unsigned long long>(sPlaceHolder).takeOr(0ull));
+        result.GetString("PacketsOutboundDiscarded", sPlaceHolder);
+        r["odrops"] =
+            BIGINT(tryTo<unsigned long long>(sPlaceHolder).takeOr(0ull));
+      });
+
+  std::vector<bool> found_adapter(rows.size());
+  queryWmiByKey(
+      "Manufacturer, NetConnectionID, NetConnectionStatus, NetEnabled, "
+      "PhysicalAdapter, ServiceName, Speed",
+      "Win32_NetworkAdapter",
+      "InterfaceIndex",
+      indexes,
+      [&](const WmiResultItem& result) {
+        long index = 0;
+        result.GetLong("InterfaceIndex", index);
+        auto it = by_index.find(index);
+        if (it == by_index.end()) {
+          return;
+        }
+
+        auto& r = rows[it->second];
+        found_adapter[it->second] = true;
+        bool bPlaceHolder;
+        long lPlaceHolder = 0;
+        unsigned __int64 ullPlaceHolder = 0;
+        result.GetString("Manufacturer", r["manufacturer"]);
+        result.GetString("NetConnectionID", r["connection_id"]);
+        result.GetLong("NetConnectionStatus", lPlaceHolder);
+        r["connection_status"] = INTEGER(lPlaceHolder);
+        result.GetBool("NetEnabled", bPlaceHolder);
+        r["enabled"] = INTEGER(bPlaceHolder);
+        result.GetBool("PhysicalAdapter", bPlaceHolder);
+        r["physical_adapter"] = INTEGER(bPlaceHolder);
+        result.GetString("ServiceName", r["service"]);
+        result.GetUnsignedLongLong("Speed", ullPlaceHolder);
+        r["speed"] = INTEGER(ullPlaceHolder);
+      });
+
+  std::vector<bool> found_config(rows.size());
+  queryWmiByKey(
+      "DHCPEnabled, DHCPLeaseExpires, DHCPLeaseObtained, DHCPServer, "
+      "DNSDomain, DNSDomainSuffixSearchOrder, DNSHostName, "
+      "DNSServerSearchOrder",
+      "win32_networkadapterconfiguration",
+      "InterfaceIndex",
+      indexes,
+      [&](const WmiResultItem& result) {
+        long index = 0;
+        result.GetLong("InterfaceIndex", index);
+        auto it = by_index.find(index);
+        if (it == by_index.end()) {
+          return;
+        }
+
+        auto& r = rows[it->second];
+        found_config[it->second] = true;
+        bool bPlaceHolder = false;
+        std::vector<std::string> vPlaceHolder;
+        result.GetBool("DHCPEnabled", bPlaceHolder);
+        r["dhcp_enabled"] = INTEGER(bPlaceHolder);
+        result.GetString("DHCPLeaseExpires", r["dhcp_lease_expires"]);
+        result.GetString("DHCPLeaseObtained", r["dhcp_lease_obtained"]);
+        result.GetString("DHCPServer", r["dhcp_server"]);
+        result.GetString("DNSDomain", r["dns_domain"]);
+        result.GetVectorOfStrings("DNSDomainSuffixSearchOrder", vPlaceHolder);
+        r["dns_domain_suffix_search_order"] = osquery::join(vPlaceHolder, ", ");
+        result.GetString("DNSHostName", r["dns_host_name"]);
+        result.GetVectorOfStrings("DNSServerSearchOrder", vPlaceHolder);
+        r["dns_server_search_order"] = osquery::join(vPlaceHolder, ", ");
+      });
+
+  for (size_t i = 0; i < rows.size(); ++i) {
+    if (!found_stats[i]) {
+      LOG(INFO) << "Failed to retrieve network statistics for interface "
+                << rows[i]["interface"];
+    }
+    if (!found_adapter[i]) {
+      LOG(INFO) << "Failed to retrieve physical state for interface "
+                << rows[i]["interface"];
+    }
+    if (!found_config[i]) {
       LOG(INFO) << "Failed to retrieve DHCP and DNS information for interface "
-                << r["interface"];
+                << rows[i]["interface"];
     }
   }
 }
@@ -194,6 +293,8 @@ QueryData genInterfaceDetails(QueryContext& context) {
     currAdapter = currAdapter->Next;
     results.push_back(r);
   }
+
+  genInterfaceWmiDetails(results);
   return results;
 }
 
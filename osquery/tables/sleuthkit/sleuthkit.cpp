@@ -7,23 +7,41 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <ctime>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <set>
+#include <thread>
+#include <unordered_map>
 
 #include <boost/filesystem.hpp>
 #include <boost/noncopyable.hpp>
 
 #include <tsk/libtsk.h>
 
+#include <osquery/core/flags.h>
+#include <osquery/core/sql/scan_slice.h>
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/hashing/hashing.h>
 #include <osquery/logger/logger.h>
 #include <osquery/utils/conversions/tryto.h>
+#include <osquery/utils/mutex.h>
 
 namespace fs = boost::filesystem;
 
 namespace osquery {
+
+FLAG(uint32,
+     sleuthkit_cache_ttl,
+     60,
+     "Seconds the sleuthkit tables reuse an opened device and the inode "
+     "metadata read from it (default 60, 0 disables)");
+
 namespace tables {
 
 const std::map<TSK_FS_META_TYPE_ENUM, std::string> kTSKTypeNames{
@@ -36,19 +54,140 @@ const std::map<TSK_FS_META_TYPE_ENUM, std::string> kTSKTypeNames{
     {TSK_FS_META_TYPE_SOCK, "socket"},
 };
 
+/// Inodes of a partition whose metadata and hashes are kept.
+const size_t kMaxCachedInodes = 16384;
+
+/// Partitions of a query walked at the same time.
+const size_t kMaxPartitionWorkers = 4;
+
+/// The metadata columns of an inode, found by its address.
+struct InodeEntry {
+  std::string path;
+  Row metadata;
+
+  bool hashed{false};
+  MultiHashes hashes;
+};
+
+/// A partition filesystem, used by one thread at a time.
+struct PartitionHandle : private boost::noncopyable {
+  std::mutex mutex;
+
+  /// Has the filesystem open been attempted.
+  bool opened{false};
+
+  /// The filesystem, if the partition contains one.
+  std::unique_ptr<TskFsInfo> fs;
+
+  /// Inodes opened by address, valid while the device handle is.
+  std::unordered_map<TSK_INUM_T, InodeEntry> inodes;
+};
+
+/**
+ * @brief An opened device image and volume, shared by queries.
+ *
+ * Handles are reused for the sleuthkit_cache_ttl seconds after the device is
+ * opened, and while the modification time and size of the device path are
+ * unchanged. The cached inode metadata is dropped with its handle.
+ */
+struct DeviceHandle : private boost::noncopyable {
+  std::shared_ptr<TskImgInfo> image{std::make_shared<TskImgInfo>()};
+  std::shared_ptr<TskVsInfo> volume{std::make_shared<TskVsInfo>()};
+
+  /// The result of the open request.
+  bool opened{false};
+
+  std::chrono::steady_clock::time_point expires;
+  std::time_t mtime{0};
+  std::uintmax_t size{0};
+
+  /// Partition filesystems by address, closed before the volume.
+  std::mutex mutex;
+  std::map<TSK_PNUM_T, std::shared_ptr<PartitionHandle>> partitions;
+};
+
+void getDeviceStamp(const std::string& device_path,
+                    std::time_t& mtime,
+                    std::uintmax_t& size) {
+  boost::system::error_code ec;
+  mtime = fs::last_write_time(device_path, ec);
+  if (ec) {
+    mtime = 0;
+  }
+
+  // Device nodes have no size, image files do.
+  size = fs::file_size(device_path, ec);
+  if (ec) {
+    size = 0;
+  }
+}
+
+/// Return the cached handle of a device, opening it if needed.
+std::shared_ptr<DeviceHandle> getDeviceHandle(const std::string& device_path) {
+  static Mutex mutex;
+  static std::map<std::string, std::shared_ptr<DeviceHandle>> handles;
+
+  std::time_t mtime{0};
+  std::uintmax_t size{0};
+  getDeviceStamp(device_path, mtime, size);
+
+  auto now = std::chrono::steady_clock::now();
+  WriteLock lock(mutex);
+  auto it = handles.find(device_path);
+  if (it != handles.end()) {
+    const auto& handle = it->second;
+    if (now < handle->expires && handle->mtime == mtime &&
+        handle->size == size) {
+      return handle;
+    }
+    handles.erase(it);
+  }
+
+  // Drop the handles of devices no longer queried.
+  for (auto handle = handles.begin(); handle != handles.end();) {
+    if (now >= handle->second->expires) {
+      handle = handles.erase(handle);
+    } else {
+      ++handle;
+    }
+  }
+
+  auto handle = std::make_shared<DeviceHandle>();
+  handle->mtime = mtime;
+  handle->size = size;
+  handle->expires = now + std::chrono::seconds(FLAGS_sleuthkit_cache_ttl);
+
+  // Attempt to open the device image, then the device image volume.
+  if (handle->image->open(device_path.c_str(), TSK_IMG_TYPE_DETECT, 0) == 0) {
+    handle->opened =
+        (handle->volume->open(&*handle->image, 0, TSK_VS_TYPE_DETECT) == 0);
+  }
+
+  if (FLAGS_sleuthkit_cache_ttl > 0) {
+    handles[device_path] = handle;
+  }
+  return handle;
+}
+
+/// The state of one directory walk.
+struct WalkState {
+  size_t stack{0};
+  size_t count{0};
+  std::set<std::string> loops;
+};
+
 class DeviceHelper : private boost::noncopyable {
  public:
   explicit DeviceHelper(const std::string& device_path)
-      : image_(std::make_shared<TskImgInfo>()),
-        volume_(std::make_shared<TskVsInfo>()),
-        device_path_(device_path) {}
+      : device_path_(device_path) {}
 
   /// Volume partition iterator.
   void partitions(
       std::function<void(const TskVsPartInfo* partition)> predicate) {
     if (open()) {
-      for (TSK_PNUM_T i = 0; i < volume_->getPartCount(); ++i) {
-        auto* part = volume_->getPart(i);
+      const auto& volume = handle_->volume;
+      for (TSK_PNUM_T i = 0; i < volume->getPartCount(); ++i) {
+        auto* part = volume->getPart(i);
         if (part == nullptr) {
           continue;
         }
@@ -58,10 +197,18 @@ class DeviceHelper : private boost::noncopyable {
     }
   }
 
+  /**
+   * @brief Return the filesystem handle of a partition.
+   *
+   * The filesystem is opened once for each device handle, the caller locks
+   * the partition mutex before using it.
+   */
+  std::shared_ptr<PartitionHandle> partition(const TskVsPartInfo* part);
+
   void inodes(
       const std::set<std::string>& inodes,
-      TskFsInfo* fs,
-      std::function<void(const std::string&, TskFsFile*, const std::string&)>
+      PartitionHandle& partition,
+      std::function<void(const std::string&, TskFsFile*, InodeEntry&)>
           predicate);
 
   /// Provide a partition description for context and iterate from path.
@@ -69,6 +216,7 @@ class DeviceHelper : private boost::noncopyable {
                      TskFsInfo* fs,
                      const std::string& path,
                      QueryData& results,
+                     WalkState& state,
                      TSK_INUM_T inode = 0);
 
   /// Similar to generateFiles but only yield a row to results.
@@ -80,78 +228,92 @@ class DeviceHelper : private boost::noncopyable {
 
   /// Volume accessor, used for computing offsets using block/sector size.
   const std::shared_ptr<TskVsInfo>& getVolume() {
-    return volume_;
+    return handle_->volume;
   }
 
-  /// Reset stack counting for directory iteration.
-  void resetStack() {
-    stack_ = 0;
-    count_ = 0;
-    std::set<std::string>().swap(loops_);
+  const std::string& getDevicePath() const {
+    return device_path_;
   }
 
  private:
   /// Attempt to open the provided device image and volume.
   bool open();
 
- private:
-  /// Has the device open been attempted.
-  bool opened_{false};
-
-  /// The result of the opened request.
-  bool opened_result_{false};
+  /// The metadata columns of a file.
+  void getMetadata(TskFsFile* file, Row& r);
 
-  /// Image structure.
-  std::shared_ptr<TskImgInfo> image_{nullptr};
-
-  /// Volume structure.
-  std::shared_ptr<TskVsInfo> volume_{nullptr};
+ private:
+  /// The opened device, shared with other queries.
+  std::shared_ptr<DeviceHandle> handle_;
 
   /// Filesystem path to the device node.
   std::string device_path_;
-
-  size_t stack_{0};
-  size_t count_{0};
-  std::set<std::string> loops_;
 };
 
 bool DeviceHelper::open() {
-  if (opened_) {
-    return opened_result_;
+  if (handle_ == nullptr) {
+    handle_ = getDeviceHandle(device_path_);
   }
+  return handle_->opened;
+}
 
-  // Attempt to open the device image.
-  opened_ = true;
-  auto status = image_->open(device_path_.c_str(), TSK_IMG_TYPE_DETECT, 0);
-  if (status) {
-    opened_result_ = false;
-    return opened_result_;
+std::shared_ptr<PartitionHandle> DeviceHelper::partition(
+    const TskVsPartInfo* part) {
+  std::shared_ptr<PartitionHandle> partition;
+  {
+    std::lock_guard<std::mutex> lock(handle_->mutex);
+    auto& entry = handle_->partitions[part->getAddr()];
+    if (entry == nullptr) {
+      entry = std::make_shared<PartitionHandle>();
+    }
+    partition = entry;
   }
 
-  // Attempt to open the device image volumn.
-  status = volume_->open(&*image_, 0, TSK_VS_TYPE_DETECT);
-  opened_result_ = (status == 0);
-  return opened_result_;
+  std::lock_guard<std::mutex> lock(partition->mutex);
+  if (!partition->opened) {
+    partition->opened = true;
+    auto fs = std::make_unique<TskFsInfo>();
+    // Cannot retrieve file information without accessing the filesystem.
+    if (fs->open(part, TSK_FS_TYPE_DETECT) == 0) {
+      partition->fs = std::move(fs);
+    }
+  }
+  return partition;
 }
 
 void DeviceHelper::inodes(
     const std::set<std::string>& inodes,
-    TskFsInfo* fs,
-    std::function<void(const std::string&, TskFsFile*, const std::string&)>
+    PartitionHandle& partition,
+    std::function<void(const std::string&, TskFsFile*, InodeEntry&)>
         predicate) {
   // Given a set of constraint inodes, convert each to an INUM.
   for (const auto& inode : inodes) {
     long int inode_meta = tryTo<long int>(inode, 10).takeOr(0l);
+    auto address = static_cast<TSK_INUM_T>(inode_meta);
+
+    // Inodes seen before only need their file for reading content.
+    auto cached = partition.inodes.find(address);
+    if (cached != partition.inodes.end()) {
+      predicate(inode, nullptr, cached->second);
+      continue;
+    }
+
     auto* file = new TskFsFile();
-    if (file->open(fs, file, static_cast<TSK_INUM_T>(inode_meta)) == 0) {
+    if (file->open(partition.fs.get(), file, address) == 0) {
       // Attempt to get the meta and filesystem name for the inode.
       // If this inode is a file a valid meta/name structures are parsed.
       auto* meta = file->getMeta();
       if (meta != nullptr) {
         const auto* name = meta->getName2(0);
         if (name != nullptr) {
-          auto path = std::string(name->getName());
-          predicate(inode, file, path);
+          if (partition.inodes.size() >= kMaxCachedInodes) {
+            partition.inodes.clear();
+          }
+
+          auto& entry = partition.inodes[address];
+          entry.path = std::string(name->getName());
+          getMetadata(file, entry.metadata);
+          predicate(inode, file, entry);
           delete name;
         }
         delete meta;
@@ -161,21 +323,7 @@ void DeviceHelper::inodes(
   }
 }
 
-void DeviceHelper::generateFile(const std::string& partition,
-                                TskFsFile* file,
-                                TskFsInfo* fs,
-                                const std::string& path,
-                                QueryData& results) {
-  Row r;
-  r["device"] = device_path_;
-  r["partition"] = partition;
-  r["path"] = path;
-  r["filename"] = fs::path(path).leaf().string();
-
-  if (fs != nullptr) {
-    r["block_size"] = BIGINT(fs->getBlockSize());
-  }
-
+void DeviceHelper::getMetadata(TskFsFile* file, Row& r) {
   const auto* meta = file->getMeta();
   if (meta != nullptr) {
     r["inode"] = BIGINT(meta->getAddr());
@@ -194,6 +342,24 @@ void DeviceHelper::generateFile(const std::string& partition,
     }
     delete meta;
   }
+}
+
+void DeviceHelper::generateFile(const std::string& partition,
+                                TskFsFile* file,
+                                TskFsInfo* fs,
+                                const std::string& path,
+                                QueryData& results) {
+  Row r;
+  r["device"] = device_path_;
+  r["partition"] = partition;
+  r["path"] = path;
+  r["filename"] = fs::path(path).leaf().string();
+
+  if (fs != nullptr) {
+    r["block_size"] = BIGINT(fs->getBlockSize());
+  }
+
+  getMetadata(file, r);
   results.push_back(r);
 }
 
@@ -201,8 +367,9 @@ void DeviceHelper::generateFiles(const std::string& partition,
                                  TskFsInfo* fs,
                                  const std::string& path,
                                  QueryData& results,
+                                 WalkState& state,
                                  TSK_INUM_T inode) {
-  if (stack_++ > 1024) {
+  if (state.stack++ > 1024) {
     return;
   }
 
@@ -215,7 +382,7 @@ void DeviceHelper::generateFiles(const std::string& partition,
   // Iterate through the directory.
   std::map<TSK_INUM_T, std::string> additional;
   for (size_t i = 0; i < dir->getSize(); i++) {
-    if (count_++ > 1024 * 10) {
+    if (state.count++ > 1024 * 10) {
       break;
     }
 
@@ -255,9 +422,9 @@ void DeviceHelper::generateFiles(const std::string& partition,
 
   // If we are recursing.
   for (const auto& d : additional) {
-    if (std::find(loops_.begin(), loops_.end(), d.second) == loops_.end()) {
-      generateFiles(partition, fs, d.second, results, d.first);
-      loops_.insert(d.second);
+    if (state.loops.count(d.second) == 0) {
+      generateFiles(partition, fs, d.second, results, state, d.first);
+      state.loops.insert(d.second);
     }
   }
 }
@@ -313,54 +480,129 @@ MultiHashes hashInode(TskFsFile* file) {
   return dhs;
 }
 
-QueryData genDeviceHash(QueryContext& context) {
-  QueryData results;
-
-  auto devices = context.constraints["device"].getAll(EQUALS);
-  // This table requires three columns to determine an action.
-  auto parts = context.constraints["partition"].getAll(EQUALS);
-  auto inodes = context.constraints["inode"].getAll(EQUALS);
+/// A partition of a device searched by a query.
+struct PartitionTask {
+  DeviceHelper* helper{nullptr};
+  std::string address;
+  std::shared_ptr<PartitionHandle> partition;
+};
 
+/// Open the requested partitions of each device.
+void getPartitionTasks(
+    const std::set<std::string>& devices,
+    const std::set<std::string>& parts,
+    std::vector<std::unique_ptr<DeviceHelper>>& helpers,
+    std::vector<PartitionTask>& tasks) {
   for (const auto& dev : devices) {
     // For each require device path, open a device helper that checks the
     // image, checks the volume, and allows partition iteration.
-    DeviceHelper dh(dev);
-    dh.partitions(([&results, &dev, &dh, &parts, &inodes](
-        const TskVsPartInfo* part) {
+    helpers.push_back(std::make_unique<DeviceHelper>(dev));
+    auto* dh = helpers.back().get();
+    dh->partitions(([dh, &parts, &tasks](const TskVsPartInfo* part) {
       // The table also requires a partition for searching.
       auto address = std::to_string(part->getAddr());
-      if (address != *parts.begin()) {
+      if (parts.count(address) == 0) {
         // If this partition does not match the requested, continue.
         return;
       }
 
-      auto* fs = new TskFsInfo();
-      auto status = fs->open(part, TSK_FS_TYPE_DETECT);
+      auto partition = dh->partition(part);
       // Cannot retrieve file information without accessing the filesystem.
-      if (status) {
-        delete fs;
+      if (partition->fs == nullptr) {
         return;
       }
-
-      dh.inodes(inodes,
-                fs,
-                ([&results, &address, &dev](const std::string& inode,
-                                            TskFsFile* file,
-                                            const std::string& path) {
-                  Row r;
-                  r["device"] = dev;
-                  r["partition"] = address;
-                  r["inode"] = inode;
-
-                  auto hashes = hashInode(file);
-                  r["md5"] = std::move(hashes.md5);
-                  r["sha1"] = std::move(hashes.sha1);
-                  r["sha256"] = std::move(hashes.sha256);
-                  results.push_back(r);
-                }));
-      delete fs;
+      tasks.push_back({dh, address, std::move(partition)});
     }));
   }
+}
+
+/**
+ * @brief Search the partitions in parallel, each by a single thread.
+ *
+ * A partition filesystem is used by one thread at a time, the rows of each
+ * partition are returned in the order of the tasks.
+ */
+void runPartitionTasks(
+    const std::vector<PartitionTask>& tasks,
+    const std::function<void(const PartitionTask&, QueryData&)>& function,
+    QueryData& results) {
+  std::vector<QueryData> task_results(tasks.size());
+  std::atomic<size_t> next{0};
+  auto worker = [&tasks, &function, &task_results, &next]() {
+    for (size_t i = next++; i < tasks.size(); i = next++) {
+      std::lock_guard<std::mutex> lock(tasks[i].partition->mutex);
+      function(tasks[i], task_results[i]);
+    }
+  };
+
+  // The calling thread is a worker too.
+  std::vector<std::thread> threads;
+  auto thread_count = std::min(kMaxPartitionWorkers, tasks.size());
+  for (size_t i = 1; i < thread_count; ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  for (auto& rows : task_results) {
+    results.insert(results.end(),
+                   std::make_move_iterator(rows.begin()),
+                   std::make_move_iterator(rows.end()));
+  }
+}
+
+QueryData genDeviceHash(QueryContext& context) {
+  QueryData results;
+
+  auto devices = context.constraints["device"].getAll(EQUALS);
+  // This table requires three columns to determine an action.
+  auto parts = context.constraints["partition"].getAll(EQUALS);
+  auto inodes = context.constraints["inode"].getAll(EQUALS);
+
+  std::vector<std::unique_ptr<DeviceHelper>> helpers;
+  std::vector<PartitionTask> tasks;
+  getPartitionTasks(devices, parts, helpers, tasks);
+
+  runPartitionTasks(
+      tasks,
+      ([&inodes](const PartitionTask& task, QueryData& task_results) {
+        auto* fs = task.partition->fs.get();
+        task.helper->inodes(
+            inodes,
+            *task.partition,
+            ([&task_results, &task, fs](const std::string& inode,
+                                        TskFsFile* file,
+                                        InodeEntry& entry) {
+              if (!entry.hashed) {
+                // A cached inode is opened again to read its content.
+                std::unique_ptr<TskFsFile> opened;
+                if (file == nullptr) {
+                  opened = std::make_unique<TskFsFile>();
+                  auto address = static_cast<TSK_INUM_T>(
+                      tryTo<long int>(inode, 10).takeOr(0l));
+                  if (opened->open(fs, opened.get(), address) != 0) {
+                    return;
+                  }
+                  file = opened.get();
+                }
+
+                entry.hashes = hashInode(file);
+                entry.hashed = !entry.hashes.md5.empty();
+              }
+
+              Row r;
+              r["device"] = task.helper->getDevicePath();
+              r["partition"] = task.address;
+              r["inode"] = inode;
+              r["md5"] = entry.hashes.md5;
+              r["sha1"] = entry.hashes.sha1;
+              r["sha256"] = entry.hashes.sha256;
+              task_results.push_back(r);
+            }));
+      }),
+      results);
 
   return results;
 }
@@ -372,61 +614,65 @@ QueryData genDeviceFile(QueryContext& context) {
   // This table requires two or more columns to determine an action.
   auto parts = context.constraints["partition"].getAll(EQUALS);
   // Additionally, paths or inodes can be used to search.
-  auto paths = context.constraints["path"].getAll(EQUALS);
+  auto path_set = context.constraints["path"].getAll(EQUALS);
   auto inodes = context.constraints["inode"].getAll(EQUALS);
 
-  if (devices.empty() || parts.size() != 1) {
-    TLOG << "Device files require at least one device and a single partition";
+  if (devices.empty() || parts.empty()) {
+    TLOG << "Device files require at least one device and a partition";
     return {};
   }
 
-  for (const auto& dev : devices) {
-    // For each require device path, open a device helper that checks the
-    // image, checks the volume, and allows partition iteration.
-    DeviceHelper dh(dev);
-    dh.partitions(([&results, &dh, &parts, &inodes, &paths](
-                       const TskVsPartInfo* part) {
-      // The table also requires a partition for searching.
-      auto address = std::to_string(part->getAddr());
-      if (address != *parts.begin()) {
-        // If this partition does not match the requested, continue.
-        return;
-      }
-
-      auto* fs = new TskFsInfo();
-      auto status = fs->open(part, TSK_FS_TYPE_DETECT);
-      // Cannot retrieve file information without accessing the filesystem.
-      if (status) {
-        delete fs;
-        return;
-      }
-
-      // If no inodes or paths were provided as constraints assume a walk of
-      // the partition was requested.
-      if (inodes.empty() && paths.empty()) {
-        dh.generateFiles(address, fs, "/", results);
-        dh.resetStack();
-      }
+  // A sliced scan only opens the paths following the previous slice, in
+  // every partition. A walk of the partitions is not sliced.
+  std::vector<std::string> paths(path_set.begin(), path_set.end());
+  ScanSlice::select(paths, [](const std::string& path) -> const auto& {
+    return path;
+  });
+
+  std::vector<std::unique_ptr<DeviceHelper>> helpers;
+  std::vector<PartitionTask> tasks;
+  getPartitionTasks(devices, parts, helpers, tasks);
+
+  runPartitionTasks(
+      tasks,
+      ([&inodes, &paths, &path_set](const PartitionTask& task,
+                                    QueryData& task_results) {
+        auto& dh = *task.helper;
+        const auto& address = task.address;
+        auto* fs = task.partition->fs.get();
+
+        // If no inodes or paths were provided as constraints assume a walk of
+        // the partition was requested.
+        if (inodes.empty() && path_set.empty()) {
+          WalkState state;
+          dh.generateFiles(address, fs, "/", task_results, state);
+        }
 
-      // For each path the canonical name must be mapped to an inode address.
-      for (const auto& path : paths) {
-        auto* file = new TskFsFile();
-        if (file->open(fs, file, path.c_str()) == 0) {
-          dh.generateFile(address, file, fs, path, results);
+        // For each path the canonical name must be mapped to an inode
+        // address.
+        for (const auto& path : paths) {
+          auto* file = new TskFsFile();
+          if (file->open(fs, file, path.c_str()) == 0) {
+            dh.generateFile(address, file, fs, path, task_results);
+          }
+          delete file;
         }
-        delete file;
-      }
 
-      dh.inodes(inodes,
-                fs,
-                ([&results, &address, &dh, &fs](const std::string& inode,
-                                                TskFsFile* file,
-                                                const std::string& path) {
-                  dh.generateFile(address, file, fs, path, results);
-                }));
-      delete fs;
-    }));
-  }
+        dh.inodes(inodes,
+                  *task.partition,
+                  ([&task_results, &address, &dh, fs](const std::string& inode,
+                                                      TskFsFile* file,
+                                                      InodeEntry& entry) {
+                    Row r = entry.metadata;
+                    r["device"] = dh.getDevicePath();
+                    r["partition"] = address;
+                    r["path"] = entry.path;
+                    r["filename"] = fs::path(entry.path).leaf().string();
+                    r["block_size"] = BIGINT(fs->getBlockSize());
+                    task_results.push_back(std::move(r));
+                  }));
+      }),
+      results);
 
   return results;
 }
@@ -456,9 +702,10 @@ QueryData genDevicePartitions(QueryContext& context) {
         r["type"] = "normal";
       }
 
-      auto* fs = new TskFsInfo();
-      auto status = fs->open(part, TSK_FS_TYPE_DETECT);
-      if (status) {
+      auto partition = dh.partition(part);
+      std::lock_guard<std::mutex> lock(partition->mutex);
+      auto* fs = partition->fs.get();
+      if (fs == nullptr) {
         r["offset"] = BIGINT(part->getStart() * dh.getVolume()->getBlockSize());
         r["blocks_size"] = BIGINT(dh.getVolume()->getBlockSize());
         r["blocks"] = BIGINT(part->getLen());
@@ -474,7 +721,6 @@ QueryData genDevicePartitions(QueryContext& context) {
         r["blocks"] = BIGINT(fs->getBlockCount());
         r["inodes"] = BIGINT(fs->getINumCount());
       }
-      delete fs;
       results.push_back(r);
     }));
   }
@@ -217,6 +217,15 @@ void genApplication(const pt::ptree& tree,
   results.push_back(std::move(r));
 }
 
+void projectInfoPlist(const pt::ptree& tree, pt::ptree& projected) {
+  for (const auto& item : kAppsInfoPlistTopLevelStringKeys) {
+    auto value = tree.get_optional<std::string>(item.first);
+    if (value) {
+      projected.put(item.first, *value);
+    }
+  }
+}
+
 Status genAppsFromLaunchServices(std::set<std::string>& apps) {
   // Resolve the protected/private symbol safely.
   CFBundleRef ls_bundle =
@@ -281,24 +290,19 @@ QueryData genApps(QueryContext& context) {
       }
     }
 
-    // The osquery::parsePlist method will reset/clear a property tree.
-    // Keeping the data structure in a larger scope preserves allocations
-    // between similar-sized trees.
-    pt::ptree tree;
-
-    // For each found application (path with an Info.plist) parse the plist.
-    for (const auto& path : apps) {
-      if (!osquery::pathExists(path)) {
-        continue;
-      }
+    // For each found application (path with an Info.plist) parse the plist,
+    // keeping only the keys of the columns.
+    std::vector<std::string> paths(apps.begin(), apps.end());
+    std::vector<PlistTreeRef> trees;
+    parsePlistsCached("apps", paths, projectInfoPlist, trees);
 
-      if (!osquery::parsePlist(path, tree).ok()) {
-        TLOG << "Error parsing application plist: " << path;
+    for (size_t i = 0; i < paths.size(); ++i) {
+      if (trees[i] == nullptr) {
         continue;
       }
 
       // Using the parsed plist, pull out each interesting key.
-      genApplication(tree, path, results);
+      genApplication(*trees[i], paths[i], results);
     }
   }
   return results;
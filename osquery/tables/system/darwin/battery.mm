@@ -16,6 +16,7 @@
 #import <IOKit/pwr_mgt/IOPMLib.h>
 
 #include <osquery/core/tables.h>
+#include <osquery/tables/system/darwin/iokit_session.h>
 
 namespace osquery {
 namespace tables {
@@ -58,10 +59,12 @@ NSDictionary* getIopmBatteryInfo() {
 }
 
 NSDictionary* getIopmpsBatteryInfo() {
-  CFMutableDictionaryRef matching = IOServiceNameMatching("AppleSmartBattery");
-  io_service_t entry =
-      IOServiceGetMatchingService(kIOMasterPortDefault, matching);
-  matching = nullptr; // Dictionary consumed by IOServiceGetMatchingService
+  auto entries = getIOKitNamedServices("AppleSmartBattery");
+  if (entries->services.empty()) {
+    return nil;
+  }
+
+  io_service_t entry = entries->services.front();
   // From Apple docs:
   // IOService is a subclass of IORegistryEntry, which means any of the
   // IORegistryEntryXXX functions in IOKitLib may be used
@@ -69,7 +72,6 @@ NSDictionary* getIopmpsBatteryInfo() {
   CFMutableDictionaryRef properties = nullptr;
   kern_return_t error =
       IORegistryEntryCreateCFProperties(entry, &properties, nullptr, 0);
-  IOObjectRelease(entry);
 
   // dictionary is NULL on kIOReturnInternalError
   if (error != kIOReturnSuccess) {
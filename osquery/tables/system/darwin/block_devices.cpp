@@ -16,6 +16,7 @@
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
+#include <osquery/tables/system/darwin/iokit_session.h>
 #include <osquery/utils/conversions/darwin/iokit.h>
 
 namespace osquery {
@@ -30,8 +31,12 @@ void genIOMediaDevice(const io_service_t& device,
 
   // Get the device properties
   CFMutableDictionaryRef properties;
-  IORegistryEntryCreateCFProperties(
+  auto ret = IORegistryEntryCreateCFProperties(
       device, &properties, kCFAllocatorDefault, kNilOptions);
+  if (ret != KERN_SUCCESS) {
+    // The media was removed since it was matched.
+    return;
+  }
 
   r["uuid"] = getIOKitProperty(properties, "UUID");
   r["name"] = "/dev/" + getIOKitProperty(properties, "BSD Name");
@@ -87,27 +92,13 @@ void genIOMediaDevice(const io_service_t& device,
 QueryData genBlockDevs(QueryContext& context) {
   QueryData results;
 
-  auto matching = IOServiceMatching(kIOMediaClassName_);
-  if (matching == nullptr) {
-    // No devices matched IOMedia.
-    return {};
-  }
-
-  io_iterator_t it;
-  auto kr = IOServiceGetMatchingServices(kIOMasterPortDefault, matching, &it);
-  if (kr != KERN_SUCCESS) {
-    return {};
-  }
-
+  // The IOMedia class is not watched by the iokit publisher, the media are
+  // matched again after the snapshot window.
+  auto devices = getIOKitServices(kIOMediaClassName_);
   std::vector<std::string> whole_devices;
-
-  io_service_t device;
-  while ((device = IOIteratorNext(it))) {
+  for (const auto& device : devices->services) {
     genIOMediaDevice(device, whole_devices, results);
-    IOObjectRelease(device);
   }
-
-  IOObjectRelease(it);
   return results;
 }
 }
@@ -9,6 +9,7 @@
 
 #include <osquery/core/tables.h>
 #include <osquery/logger/logger.h>
+#include <osquery/tables/system/darwin/iokit_session.h>
 #include <osquery/utils/conversions/darwin/cfstring.h>
 #include <osquery/utils/conversions/darwin/iokit.h>
 #include <osquery/utils/conversions/split.h>
@@ -159,39 +160,32 @@ void genIOKitDeviceChildren(IOKitEnumerator enumerator,
   IOObjectRelease(it);
 }
 
-QueryData genDeviceFirmware(QueryContext& context) {
-  QueryData qd;
+QueryData genIOKitPlane(const std::string& key,
+                        IOKitEnumerator enumerator,
+                        const io_name_t plane) {
+  return getIOKitSnapshot(key, [&enumerator, plane]() {
+    QueryData qd;
 
-  // Start with the services root node.
-  auto service = IORegistryGetRootEntry(kIOMasterPortDefault);
-  genIOKitDeviceChildren(&genIOKitFirmware, service, kIOServicePlane, 0, qd);
-  IOObjectRelease(service);
+    // Start with the IO registry root node.
+    auto service = IORegistryGetRootEntry(kIOMasterPortDefault);
+    genIOKitDeviceChildren(enumerator, service, plane, 0, qd);
+    IOObjectRelease(service);
 
-  return qd;
+    return qd;
+  });
 }
 
-QueryData genIOKitDeviceTree(QueryContext& context) {
-  QueryData qd;
+QueryData genDeviceFirmware(QueryContext& context) {
+  return genIOKitPlane("firmware", &genIOKitFirmware, kIOServicePlane);
+}
 
-  // Get the IO registry root node.
-  auto service = IORegistryGetRootEntry(kIOMasterPortDefault);
+QueryData genIOKitDeviceTree(QueryContext& context) {
   // Begin recursing along the IODeviceTree "plane".
-  genIOKitDeviceChildren(&genIOKitDevice, service, kIODeviceTreePlane, 0, qd);
-  IOObjectRelease(service);
-
-  return qd;
+  return genIOKitPlane("devicetree", &genIOKitDevice, kIODeviceTreePlane);
 }
 
 QueryData genIOKitRegistry(QueryContext& context) {
-  QueryData qd;
-
-  // Get the IO registry root node.
-  auto service = IORegistryGetRootEntry(kIOMasterPortDefault);
-  // Begin recursing along the IODeviceTree "plane".
-  genIOKitDeviceChildren(&genIOKitDevice, service, kIOServicePlane, 0, qd);
-  IOObjectRelease(service);
-
-  return qd;
+  return genIOKitPlane("registry", &genIOKitDevice, kIOServicePlane);
 }
 }
 }
@@ -0,0 +1,211 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <chrono>
+#include <map>
+
+#include <osquery/core/flags.h>
+#include <osquery/events/darwin/iokit.h>
+#include <osquery/tables/system/darwin/iokit_session.h>
+#include <osquery/utils/mutex.h>
+
+namespace osquery {
+
+FLAG(uint32,
+     iokit_snapshot_window,
+     1000,
+     "Milliseconds the tables of a query share IOKit registry matches");
+
+namespace tables {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct CachedServices {
+  IOKitServicesRef services;
+
+  /// The device generation before the services were matched.
+  uint64_t generation{0};
+
+  /// The iokit publisher watches the class of the services.
+  bool watched{false};
+
+  Clock::time_point time;
+};
+
+struct CachedSnapshot {
+  std::shared_ptr<const QueryData> rows;
+  Clock::time_point time;
+};
+
+struct IOKitSession {
+  Mutex mutex;
+  std::map<std::string, CachedServices> services;
+  std::map<std::string, io_connect_t> connections;
+  std::map<std::string, CachedSnapshot> snapshots;
+};
+
+IOKitSession& getIOKitSession() {
+  static IOKitSession session;
+  return session;
+}
+
+bool withinSnapshotWindow(Clock::time_point time) {
+  return Clock::now() - time <
+         std::chrono::milliseconds(FLAGS_iokit_snapshot_window);
+}
+
+IOKitServicesRef matchServices(CFMutableDictionaryRef matching) {
+  auto services = std::make_shared<IOKitServices>();
+  if (matching == nullptr) {
+    return services;
+  }
+
+  // The matching dictionary is consumed.
+  io_iterator_t it;
+  auto kr = IOServiceGetMatchingServices(kIOMasterPortDefault, matching, &it);
+  if (kr != KERN_SUCCESS) {
+    return services;
+  }
+
+  io_service_t device;
+  while ((device = IOIteratorNext(it))) {
+    services->services.push_back(device);
+  }
+
+  IOObjectRelease(it);
+  return services;
+}
+
+IOKitServicesRef getCachedServices(
+    const std::string& key,
+    const std::string& class_name,
+    const std::function<CFMutableDictionaryRef()>& matching) {
+  if (FLAGS_iokit_snapshot_window == 0) {
+    return matchServices(matching());
+  }
+
+  auto& session = getIOKitSession();
+  auto generation = IOKitEventPublisher::getDeviceGeneration();
+  {
+    WriteLock lock(session.mutex);
+    auto cached = session.services.find(key);
+    if (cached != session.services.end()) {
+      const auto& entry = cached->second;
+      if (withinSnapshotWindow(entry.time) ||
+          (entry.watched && entry.generation == generation &&
+           IOKitEventPublisher::isWatchingClass(class_name))) {
+        return entry.services;
+      }
+    }
+  }
+
+  CachedServices entry;
+  entry.generation = generation;
+  entry.watched = !class_name.empty() &&
+                  IOKitEventPublisher::isWatchingClass(class_name);
+  entry.time = Clock::now();
+  entry.services = matchServices(matching());
+
+  WriteLock lock(session.mutex);
+  session.services[key] = entry;
+  return entry.services;
+}
+
+} // namespace
+
+IOKitServices::~IOKitServices() {
+  for (auto service : services) {
+    IOObjectRelease(service);
+  }
+}
+
+IOKitServicesRef getIOKitServices(const std::string& class_name) {
+  return getCachedServices("class:" + class_name, class_name, [&class_name]() {
+    return IOServiceMatching(class_name.c_str());
+  });
+}
+
+IOKitServicesRef getIOKitNamedServices(const std::string& name) {
+  return getCachedServices("name:" + name, "", [&name]() {
+    return IOServiceNameMatching(name.c_str());
+  });
+}
+
+io_connect_t getIOKitConnection(const std::string& class_name) {
+  auto& session = getIOKitSession();
+  WriteLock lock(session.mutex);
+  auto cached = session.connections.find(class_name);
+  if (cached != session.connections.end()) {
+    return cached->second;
+  }
+
+  auto matching = IOServiceMatching(class_name.c_str());
+  if (matching == nullptr) {
+    return 0;
+  }
+
+  auto device = IOServiceGetMatchingService(kIOMasterPortDefault, matching);
+  if (device == 0) {
+    return 0;
+  }
+
+  io_connect_t connection = 0;
+  auto result = IOServiceOpen(device, mach_task_self(), 0, &connection);
+  IOObjectRelease(device);
+  if (result != kIOReturnSuccess) {
+    return 0;
+  }
+
+  session.connections[class_name] = connection;
+  return connection;
+}
+
+void closeIOKitConnection(const std::string& class_name,
+                          io_connect_t connection) {
+  auto& session = getIOKitSession();
+  WriteLock lock(session.mutex);
+  auto cached = session.connections.find(class_name);
+  if (cached == session.connections.end() || cached->second != connection) {
+    // Another caller closed the connection already.
+    return;
+  }
+
+  session.connections.erase(cached);
+  IOServiceClose(connection);
+}
+
+QueryData getIOKitSnapshot(const std::string& key,
+                           const std::function<QueryData()>& generate) {
+  if (FLAGS_iokit_snapshot_window == 0) {
+    return generate();
+  }
+
+  auto& session = getIOKitSession();
+  {
+    WriteLock lock(session.mutex);
+    auto cached = session.snapshots.find(key);
+    if (cached != session.snapshots.end() &&
+        withinSnapshotWindow(cached->second.time)) {
+      return *cached->second.rows;
+    }
+  }
+
+  CachedSnapshot snapshot;
+  snapshot.time = Clock::now();
+  snapshot.rows = std::make_shared<const QueryData>(generate());
+
+  WriteLock lock(session.mutex);
+  session.snapshots[key] = snapshot;
+  return *snapshot.rows;
+}
+
+} // namespace tables
+} // namespace osquery
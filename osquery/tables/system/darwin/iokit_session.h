@@ -0,0 +1,71 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <IOKit/IOKitLib.h>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/core/tables.h>
+
+namespace osquery {
+namespace tables {
+
+/// IOKit services matched together, released with the last reference.
+class IOKitServices : private boost::noncopyable {
+ public:
+  ~IOKitServices();
+
+  /// The matched services, a service may since have been terminated.
+  std::vector<io_service_t> services;
+};
+
+using IOKitServicesRef = std::shared_ptr<const IOKitServices>;
+
+/**
+ * @brief The IOKit services of a class, as IOServiceMatching matches them.
+ *
+ * The tables of a query, such as the tables of a JOIN, share the services
+ * matched within iokit_snapshot_window. The services of the classes the
+ * iokit event publisher watches are kept longer, until it is notified of an
+ * attached or detached device.
+ */
+IOKitServicesRef getIOKitServices(const std::string& class_name);
+
+/// The IOKit services of a name, as IOServiceNameMatching matches them.
+IOKitServicesRef getIOKitNamedServices(const std::string& name);
+
+/**
+ * @brief A connection to the first IOKit service of a class, kept open.
+ *
+ * @return 0 if no service of the class can be opened.
+ */
+io_connect_t getIOKitConnection(const std::string& class_name);
+
+/// Close a connection that failed, the next connection is opened again.
+void closeIOKitConnection(const std::string& class_name,
+                          io_connect_t connection);
+
+/**
+ * @brief The rows of an IOKit registry walk, shared by the tables of a query.
+ *
+ * The rows generated for a key within iokit_snapshot_window are reused, the
+ * registry is walked once for the tables of a JOIN.
+ */
+QueryData getIOKitSnapshot(const std::string& key,
+                           const std::function<QueryData()>& generate);
+
+} // namespace tables
+} // namespace osquery
@@ -110,29 +110,25 @@ QueryData genLaunchd(QueryContext& context) {
     }
   }
 
-  // The osquery::parsePlist method will reset/clear a property tree.
-  // Keeping the data structure in a larger scope preserves allocations
-  // between similar-sized trees.
-  pt::ptree tree;
-
-  // For each found launcher (plist in known paths) parse the plist.
+  // Optimize by not searching when a path is a constraint.
+  std::vector<std::string> paths;
   for (const auto& path : launchers) {
-    if (!context.constraints["path"].matches(path)) {
-      // Optimize by not searching when a path is a constraint.
-      continue;
+    if (context.constraints["path"].matches(path)) {
+      paths.push_back(path);
     }
+  }
 
-    if (!osquery::pathExists(path)) {
-      continue;
-    }
+  // For each found launcher (plist in known paths) parse the plist.
+  std::vector<PlistTreeRef> trees;
+  parsePlistsCached("launchd", paths, nullptr, trees);
 
-    if (!osquery::parsePlist(path, tree).ok()) {
-      TLOG << "Error parsing launch daemon/agent plist: " << path;
+  for (size_t i = 0; i < paths.size(); ++i) {
+    if (trees[i] == nullptr) {
       continue;
     }
 
     // Using the parsed plist, pull out each set of interesting keys.
-    genLaunchdItem(tree, path, results);
+    genLaunchdItem(*trees[i], paths[i], results);
   }
 
   return results;
@@ -145,14 +141,15 @@ void genLaunchdOverride(const fs::path& path, QueryData& results) {
   auto group = osquery::split(path.parent_path().filename().string(), ".");
   r["uid"] = (group.size() == 5) ? BIGINT(group.at(4)) : "0";
 
-  pt::ptree tree;
-  if (!osquery::parsePlist(path, tree).ok()) {
+  PlistTreeRef tree;
+  if (!osquery::parsePlistCached("launchd_overrides", path, nullptr, tree)
+           .ok()) {
     return;
   }
 
   // Include a row for each label : key since we do not know the set of keys
   // that may be overridden.
-  for (const auto& daemon : tree) {
+  for (const auto& daemon : *tree) {
     r["label"] = daemon.first.data();
     for (const auto& item : daemon.second) {
       r["key"] = item.first.data();
@@ -9,6 +9,7 @@
 
 #include <osquery/core/tables.h>
 #include <osquery/registry/registry_factory.h>
+#include <osquery/tables/system/darwin/iokit_session.h>
 #include <osquery/utils/conversions/darwin/iokit.h>
 
 namespace osquery {
@@ -42,25 +43,10 @@ void genPCIDevice(const io_service_t& device, QueryData& results) {
 QueryData genPCIDevices(QueryContext& context) {
   QueryData results;
 
-  auto matching = IOServiceMatching(kIOPCIDeviceClassName_.c_str());
-  if (matching == nullptr) {
-    // No devices matched PCI, very odd.
-    return results;
-  }
-
-  io_iterator_t it;
-  auto kr = IOServiceGetMatchingServices(kIOMasterPortDefault, matching, &it);
-  if (kr != KERN_SUCCESS) {
-    return results;
-  }
-
-  io_service_t device;
-  while ((device = IOIteratorNext(it))) {
+  auto devices = getIOKitServices(kIOPCIDeviceClassName_);
+  for (const auto& device : devices->services) {
     genPCIDevice(device, results);
-    IOObjectRelease(device);
   }
-
-  IOObjectRelease(it);
   return results;
 }
 } // namespace tables
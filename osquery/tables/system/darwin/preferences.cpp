@@ -319,13 +319,13 @@ QueryData genOSXPlist(QueryContext& context) {
       continue;
     }
 
-    pt::ptree tree;
-    if (!osquery::parsePlist(path, tree).ok()) {
+    PlistTreeRef tree;
+    if (!osquery::parsePlistCached("plist", path, nullptr, tree).ok()) {
       VLOG(1) << "Could not parse plist: " + path;
       continue;
     }
 
-    for (const auto& item : tree) {
+    for (const auto& item : *tree) {
       Row r;
 
       r["path"] = path;
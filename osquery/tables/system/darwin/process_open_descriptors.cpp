@@ -17,6 +17,7 @@
 #include <osquery/core/core.h>
 #include <osquery/core/tables.h>
 #include <osquery/logger/logger.h>
+#include <osquery/sql/dynamic_table_row.h>
 
 namespace osquery {
 namespace tables {
@@ -237,9 +238,9 @@ QueryData genOpenSockets(QueryContext& context) {
   return results;
 }
 
-QueryData genOpenFiles(QueryContext& context) {
+void genOpenFiles(RowYield& yield, QueryContext& context) {
+  // Rows are yielded per process, only one process's descriptors are held.
   QueryData results;
-
   auto pidlist = getProcList(context);
   for (auto& pid : pidlist) {
     if (!context.constraints["pid"].matches(pid)) {
@@ -248,9 +249,11 @@ QueryData genOpenFiles(QueryContext& context) {
     }
 
     genOpenDescriptors(pid, DESCRIPTORS_TYPE_VNODE, results);
+    for (auto& r : results) {
+      yield(TableRowHolder(new DynamicTableRow(std::move(r))));
+    }
+    results.clear();
   }
-
-  return results;
 }
 } // namespace tables
 } // namespace osquery
@@ -13,23 +13,38 @@
 #include <mach/mach_time.h>
 #include <sys/sysctl.h>
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <functional>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <set>
+#include <thread>
+#include <vector>
 
 #include <boost/algorithm/string.hpp>
 
 #include <osquery/core/core.h>
+#include <osquery/core/flags.h>
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
 #include <osquery/rows/processes.h>
+#include <osquery/sql/dynamic_table_row.h>
 
 #include <chrono>
 
 namespace fs = boost::filesystem;
 
 namespace osquery {
+
+FLAG(uint32,
+     processes_query_workers,
+     4,
+     "Threads reading the processes for the processes table");
+
 namespace tables {
 
 // The maximum number of expected memory regions per process.
@@ -46,6 +61,9 @@ namespace tables {
 // SZOMB  (5) Awaiting collection by parent
 const char kProcessStateMapping[] = {' ', 'I', 'R', 'S', 'T', 'Z'};
 
+/// The pid list is shared by the process tables queried within this time.
+const std::chrono::milliseconds kProcessListTTL{1000};
+
 /**
  * @brief Use process APIs for quick process path access.
  *
@@ -57,22 +75,11 @@ const char kProcessStateMapping[] = {' ', 'I', 'R', 'S', 'T', 'Z'};
  */
 static std::string getProcPath(int pid);
 
-std::set<int> getProcList(const QueryContext& context) {
-  std::set<int> pidlist;
-  if (context.constraints.count("pid") > 0 &&
-      context.constraints.at("pid").exists(EQUALS)) {
-    for (const auto& pid : context.constraints.at("pid").getAll<int>(EQUALS)) {
-      if (pid >= 0) {
-        pidlist.insert(pid);
-      }
-    }
-    return pidlist;
-  }
-
+static bool listAllPids(std::set<int>& pidlist) {
   int bufsize = proc_listpids(PROC_ALL_PIDS, 0, nullptr, 0);
   if (bufsize <= 0) {
     VLOG(1) << "An error occurred retrieving the process list";
-    return pidlist;
+    return false;
   }
 
   // Use twice the number of PIDs returned to handle races.
@@ -81,7 +88,7 @@ std::set<int> getProcList(const QueryContext& context) {
   bufsize = proc_listpids(PROC_ALL_PIDS, 0, pids.data(), 2 * bufsize);
   if (bufsize <= 0) {
     VLOG(1) << "An error occurred retrieving the process list";
-    return pidlist;
+    return false;
   }
 
   size_t num_pids = bufsize / sizeof(pid_t);
@@ -93,9 +100,49 @@ std::set<int> getProcList(const QueryContext& context) {
     }
     pidlist.insert(pids[i]);
   }
+  return true;
+}
+
+/**
+ * @brief The pids of all processes, listed again once kProcessListTTL passed.
+ *
+ * The tables joined in one query, and the queries scheduled together, share
+ * the list. A process exited since the listing fails its proc_pidinfo calls
+ * and is skipped.
+ */
+static std::set<int> getCachedProcList() {
+  static std::mutex mutex;
+  static std::set<int> pidlist;
+  static std::chrono::steady_clock::time_point expiration;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  auto now = std::chrono::steady_clock::now();
+  if (now >= expiration) {
+    std::set<int> pids;
+    if (!listAllPids(pids)) {
+      return pids;
+    }
+    pidlist = std::move(pids);
+    expiration = now + kProcessListTTL;
+  }
   return pidlist;
 }
 
+std::set<int> getProcList(const QueryContext& context) {
+  std::set<int> pidlist;
+  if (context.constraints.count("pid") > 0 &&
+      context.constraints.at("pid").exists(EQUALS)) {
+    for (const auto& pid : context.constraints.at("pid").getAll<int>(EQUALS)) {
+      if (pid >= 0) {
+        pidlist.insert(pid);
+      }
+    }
+    return pidlist;
+  }
+
+  return getCachedProcList();
+}
+
 struct proc_cred {
   uint32_t parent{0};
   uint32_t group{0};
@@ -464,10 +511,11 @@ void genProcResourceUsage(const QueryContext& context,
   // proc_pid_rusage returns -1 if it was unable to gather information
   if (status == 0) {
     // Initialize time conversions.
-    static mach_timebase_info_data_t time_base;
-    if (time_base.denom == 0) {
-      mach_timebase_info(&time_base);
-    }
+    static const auto time_base = []() {
+      mach_timebase_info_data_t info{};
+      mach_timebase_info(&info);
+      return info;
+    }();
 
     // size/memory information
     r.wired_size_col = rusage_info_data.ri_wired_size;
@@ -495,39 +543,85 @@ void genProcResourceUsage(const QueryContext& context,
   }
 }
 
-TableRows genProcesses(QueryContext& context) {
-  TableRows results;
+/**
+ * @brief Run the tasks on a bounded set of threads.
+ *
+ * The calling thread takes part, the tasks run on it alone when no thread
+ * can be started.
+ */
+static void runProcessTasks(size_t count,
+                            const std::function<void(size_t)>& task) {
+  std::atomic<size_t> next{0};
+  auto worker = [&next, &task, count]() {
+    for (auto i = next++; i < count; i = next++) {
+      task(i);
+    }
+  };
 
-  auto pidlist = getProcList(context);
-  for (const auto& pid : pidlist) {
-    ProcessesRow* r = new ProcessesRow();
-    r->pid_col = pid;
+  auto thread_count = std::min<size_t>(
+      std::max<std::uint32_t>(FLAGS_processes_query_workers, 1), count);
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < thread_count; ++i) {
+    try {
+      threads.emplace_back(worker);
+    } catch (const std::system_error& e) {
+      LOG(ERROR) << "Cannot start a processes worker: " << e.what();
+      break;
+    }
+  }
 
-    genProcCmdline(context, pid, *r);
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
 
-    // The process relative root and current working directory.
-    genProcRootAndCWD(context, pid, *r);
+/// Populate the row of one process, false if the process is gone.
+static bool genProcess(QueryContext& context, int pid, ProcessesRow& r) {
+  r.pid_col = pid;
 
-    proc_cred cred;
-    if (!genProcCredAndStartTime(context, pid, cred, *r)) {
-      continue;
-    }
+  genProcCmdline(context, pid, r);
 
-    genProcNamePathAndOnDisk(context, pid, cred, *r);
+  // The process relative root and current working directory.
+  genProcRootAndCWD(context, pid, r);
 
-    // systems usage and time information
-    genProcResourceUsage(context, pid, *r);
+  proc_cred cred;
+  if (!genProcCredAndStartTime(context, pid, cred, r)) {
+    return false;
+  }
 
-    genProcNumThreads(context, pid, *r);
+  genProcNamePathAndOnDisk(context, pid, cred, r);
 
-    genProcUniquePid(context, pid, *r);
+  // systems usage and time information
+  genProcResourceUsage(context, pid, r);
 
-    genProcArch(context, pid, *r);
+  genProcNumThreads(context, pid, r);
 
-    std::unique_ptr<TableRow> tr(r);
-    results.push_back(std::move(tr));
-  }
+  genProcUniquePid(context, pid, r);
+
+  genProcArch(context, pid, r);
+  return true;
+}
+
+TableRows genProcesses(QueryContext& context) {
+  auto pidlist = getProcList(context);
+  std::vector<int> pids(pidlist.begin(), pidlist.end());
+
+  // The processes are read on the workers, the rows keep the pid order.
+  std::vector<std::unique_ptr<ProcessesRow>> rows(pids.size());
+  runProcessTasks(pids.size(), [&](size_t i) {
+    auto r = std::make_unique<ProcessesRow>();
+    if (genProcess(context, pids[i], *r)) {
+      rows[i] = std::move(r);
+    }
+  });
 
+  TableRows results;
+  for (auto& r : rows) {
+    if (r != nullptr) {
+      results.push_back(std::move(r));
+    }
+  }
   return results;
 }
 
@@ -796,15 +890,17 @@ static std::string getProcPath(int pid) {
   return std::string(path);
 }
 
-QueryData genProcessMemoryMap(QueryContext& context) {
+void genProcessMemoryMap(RowYield& yield, QueryContext& context) {
+  // Rows are yielded per process, only one process's map is held.
   QueryData results;
-
   auto pidlist = getProcList(context);
   for (const auto& pid : pidlist) {
     genProcessMemoryMap(pid, results);
+    for (auto& r : results) {
+      yield(TableRowHolder(new DynamicTableRow(std::move(r))));
+    }
+    results.clear();
   }
-
-  return results;
 }
 } // namespace tables
 } // namespace osquery
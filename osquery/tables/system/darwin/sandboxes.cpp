@@ -25,19 +25,33 @@ const std::vector<std::string> kSandboxContainerPaths = {
     "/Library/Containers/",
 };
 
+/// Keep the validation details of a container, not its sandbox profile.
+void projectContainerPlist(const pt::ptree& tree, pt::ptree& projected) {
+  for (const auto& key : {"SandboxProfileDataValidationInfo",
+                          "SandboxProfileDataValidationEntitlementsKey"}) {
+    auto child = tree.get_child_optional(key);
+    if (child) {
+      projected.add_child(key, *child);
+    }
+  }
+}
+
 void genSandboxContainer(const fs::path& container, QueryData& results) {
-  pt::ptree tree;
   fs::path path = container / "Container.plist";
   if (!pathExists(path.string()).ok() || !isReadable(path.string()).ok()) {
     // Container directory does not contain container details.
     return;
   }
 
-  if (!osquery::parsePlist(path.string(), tree).ok()) {
+  PlistTreeRef plist;
+  if (!osquery::parsePlistCached(
+           "sandboxes", path, projectContainerPlist, plist)
+           .ok()) {
     // Could not parse the container plist.
     return;
   }
 
+  const auto& tree = *plist;
   if (tree.count("SandboxProfileDataValidationInfo") == 0) {
     return;
   }
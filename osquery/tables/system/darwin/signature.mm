@@ -22,6 +22,7 @@
 #include <osquery/sql/sql.h>
 #include <osquery/tables/system/darwin/keychain.h>
 #include <osquery/tables/system/posix/openssl_utils.h>
+#include <osquery/tables/system/signature_cache.h>
 #include <osquery/utils/conversions/darwin/cfstring.h>
 #include <osquery/utils/conversions/tryto.h>
 #include <osquery/utils/expected/expected.h>
@@ -206,11 +207,19 @@ Status genSignatureForFileAndArch(const std::string& path,
 void genSignatureForFile(const std::string& path,
                          bool hashResources,
                          QueryData& results) {
-  for (const auto& arch : kCheckedArches) {
-    // This returns a status but there is nothing we need to handle
-    // here so we can safely ignore it
-    genSignatureForFileAndArch(path, arch, hashResources, results);
-  }
+  auto kind = std::string("signature.") + (hashResources ? "1" : "0");
+  auto rows = genCachedSignature(kind, path, [&]() {
+    QueryData verified;
+    for (const auto& arch : kCheckedArches) {
+      // This returns a status but there is nothing we need to handle
+      // here so we can safely ignore it
+      genSignatureForFileAndArch(path, arch, hashResources, verified);
+    }
+    return verified;
+  });
+  results.insert(results.end(),
+                 std::make_move_iterator(rows.begin()),
+                 std::make_move_iterator(rows.end()));
 }
 
 QueryData genSignature(QueryContext& context) {
@@ -17,12 +17,16 @@
 #include <boost/noncopyable.hpp>
 
 #include <osquery/core/tables.h>
+#include <osquery/tables/system/darwin/iokit_session.h>
 
 namespace osquery {
 namespace tables {
 
 #define KERNEL_INDEX_SMC 2
 
+/// The IOKit class of the SMC service.
+const std::string kSMCClassName{"AppleSMC"};
+
 typedef struct { char bytes[32]; } SMCBytes_t;
 typedef struct { char bytes[5]; } UInt32Char_t;
 
@@ -289,23 +293,15 @@ const std::map<std::string, std::string> kSMCKeyDescriptions = {
 
 class SMCHelper : private boost::noncopyable {
  public:
-  virtual ~SMCHelper() {
-    if (connection_ != 0) {
-      close();
-    }
-  }
-
   /**
-   * @brief Open the IOKit master port, device driver, and service.
+   * @brief Open the IOKit device driver and service.
    *
    * This will find the userland SMC interface driver and open the service.
-   * It will remain open until the helper is deleted.
+   * The connection is shared by the SMC tables and remains open until a call
+   * fails, such as after the driver restarted.
    */
   bool open();
 
-  /// Shutdown the IOKit connection.
-  void close() { IOServiceClose(connection_); }
-
   /// Read a given SMC key into an output parameter value.
   bool read(const std::string &key, SMCValue_t *val) const;
 
@@ -322,43 +318,14 @@ class SMCHelper : private boost::noncopyable {
   size_t getKeysCount() const;
 
  private:
-  /// IOKit master port.
-  mach_port_t master_port_{0};
   /// IOKit service connection.
   io_connect_t connection_{0};
 };
 
 bool SMCHelper::open() {
-  auto result = IOMasterPort(MACH_PORT_NULL, &master_port_);
-  if (result != kIOReturnSuccess) {
-    return false;
-  }
-
   // The IOKit-based kernel extension will provide the IOKit service: AppleSMC.
-  auto matches = IOServiceMatching("AppleSMC");
-  if (matches == nullptr) {
-    return false;
-  }
-
-  io_iterator_t iterator;
-  result = IOServiceGetMatchingServices(master_port_, matches, &iterator);
-  if (result != kIOReturnSuccess) {
-    return false;
-  }
-
-  auto device = IOIteratorNext(iterator);
-  IOObjectRelease((io_object_t)iterator);
-  if (device == 0) {
-    return false;
-  }
-
-  result = IOServiceOpen(device, mach_task_self(), 0, &connection_);
-  IOObjectRelease(device);
-  if (result != kIOReturnSuccess) {
-    return false;
-  }
-
-  return true;
+  connection_ = getIOKitConnection(kSMCClassName);
+  return connection_ != 0;
 }
 
 kern_return_t SMCHelper::call(uint32_t selector,
@@ -367,8 +334,13 @@ kern_return_t SMCHelper::call(uint32_t selector,
   size_t in_size = sizeof(SMCKeyData_t);
   size_t out_size = sizeof(SMCKeyData_t);
 
-  return IOConnectCallStructMethod(
+  auto result = IOConnectCallStructMethod(
       connection_, selector, in, in_size, out, &out_size);
+  if (result == MACH_SEND_INVALID_DEST || result == kIOReturnNotOpen) {
+    // The shared connection is no longer valid, the next query reopens it.
+    closeIOKitConnection(kSMCClassName, connection_);
+  }
+  return result;
 }
 
 inline uint32_t strtoul(const char *str, size_t size, size_t base) {
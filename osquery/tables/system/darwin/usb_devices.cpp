@@ -10,6 +10,7 @@
 #include <IOKit/usb/IOUSBLib.h>
 
 #include <osquery/core/tables.h>
+#include <osquery/tables/system/darwin/iokit_session.h>
 #include <osquery/utils/conversions/darwin/iokit.h>
 
 namespace osquery {
@@ -29,8 +30,12 @@ void genUSBDevice(const io_service_t& device, QueryData& results) {
 
   // Get the device details
   CFMutableDictionaryRef details;
-  IORegistryEntryCreateCFProperties(
+  auto ret = IORegistryEntryCreateCFProperties(
       device, &details, kCFAllocatorDefault, kNilOptions);
+  if (ret != KERN_SUCCESS) {
+    // The device was detached since it was matched.
+    return;
+  }
 
   r["usb_address"] = getIOKitProperty(details, "USB Address");
   r["usb_port"] = getIOKitProperty(details, "PortNum");
@@ -76,25 +81,10 @@ void genUSBDevice(const io_service_t& device, QueryData& results) {
 QueryData genUSBDevices(QueryContext& context) {
   QueryData results;
 
-  auto matching = IOServiceMatching(kIOUSBDeviceClassName);
-  if (matching == nullptr) {
-    // No devices matched USB, very odd.
-    return results;
-  }
-
-  io_iterator_t it;
-  auto kr = IOServiceGetMatchingServices(kIOMasterPortDefault, matching, &it);
-  if (kr != KERN_SUCCESS) {
-    return results;
-  }
-
-  io_service_t device;
-  while ((device = IOIteratorNext(it))) {
+  auto devices = getIOKitServices(kIOUSBDeviceClassName);
+  for (const auto& device : devices->services) {
     genUSBDevice(device, results);
-    IOObjectRelease(device);
   }
-
-  IOObjectRelease(it);
   return results;
 }
 }
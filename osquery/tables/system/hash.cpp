@@ -16,17 +16,25 @@
 #include <unistd.h>
 #endif
 
+#include <condition_variable>
+#include <functional>
+#include <mutex>
 #include <set>
 #include <thread>
 
 #include <boost/filesystem.hpp>
 
 #include <osquery/core/flags.h>
+#include <osquery/core/sql/scan_slice.h>
+#include <osquery/database/database.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/hashing/hashing.h>
 #include <osquery/logger/logger.h>
 #include <osquery/core/tables.h>
 #include <osquery/sql/dynamic_table_row.h>
+#include <osquery/utils/conversions/split.h>
+#include <osquery/utils/conversions/tryto.h>
+#include <osquery/utils/system/time.h>
 #include <osquery/utils/mutex.h>
 #include <osquery/utils/info/platform_type.h>
 #include <osquery/worker/ipc/platform_table_container_ipc.h>
@@ -42,18 +50,85 @@ FLAG(bool,
 
 FLAG(uint32, hash_cache_max, 500, "Size of LRU file hash cache");
 
+FLAG(bool,
+     hash_cache_persist,
+     false,
+     "Persist calculated file hashes in the database across restarts");
+
+FLAG(uint64,
+     hash_cache_persist_expiry,
+     604800,
+     "Seconds a persisted file hash is kept without being used");
+
 HIDDEN_FLAG(uint32,
             hash_delay,
             20,
             "Number of milliseconds to delay after hashing");
 
+FLAG(uint32,
+     hash_workers,
+     0,
+     "Number of threads hashing the files of a hash query (0 or 1 hashes "
+     "them serially)");
+
 DECLARE_uint64(read_max);
 
 namespace tables {
 
+/// Receives each generated row, so rows may be streamed or collected.
+using HashRowCallback = std::function<void(Row& r)>;
+
 /// Clear this amount of rows every time cache eviction is triggered.
 const size_t kHashCacheEvictSize{5};
 
+/// Files each worker may hash ahead of the rows yielded so far.
+const size_t kHashWorkerWindow{4};
+
+/// A persisted hash used within this many seconds is not written again.
+const uint64_t kFileHashRefresh{86400};
+
+/// A file to hash and the directory reported with its row.
+struct HashTarget {
+  std::string path;
+  std::string dir;
+};
+
+/// How the rows of a hash query are generated.
+struct HashRowOptions {
+  /// Threads hashing the files, 0 or 1 hashes them on the query's thread.
+  size_t workers{0};
+
+  /// Use and store the hashes persisted in the database.
+  bool persist{false};
+
+  /// The digests computed, those of the columns used by the query.
+  int mask{HASH_TYPE_MD5 | HASH_TYPE_SHA1 | HASH_TYPE_SHA256};
+};
+
+/// Add the digests of the source missing from the hashes.
+void mergeHashes(MultiHashes& hashes, MultiHashes& source) {
+  auto missing = source.mask & ~hashes.mask;
+  if (missing & HASH_TYPE_MD5) {
+    hashes.md5 = std::move(source.md5);
+  }
+  if (missing & HASH_TYPE_SHA1) {
+    hashes.sha1 = std::move(source.sha1);
+  }
+  if (missing & HASH_TYPE_SHA256) {
+    hashes.sha256 = std::move(source.sha256);
+  }
+  hashes.mask |= missing;
+}
+
+/// Compute the digests of the mask missing from the hashes.
+void addHashes(const std::string& path, int mask, MultiHashes& hashes) {
+  auto missing = mask & ~hashes.mask;
+  if (missing != 0) {
+    auto computed = hashMultiFromFile(missing, path);
+    mergeHashes(hashes, computed);
+  }
+}
+
 /**
  * @brief Implements persistent in-memory caching of files' hashes.
  *
@@ -90,12 +165,20 @@ struct FileHashCache {
    * Maintains the cache of hash sums, stats file at path, if it has changed or
    * it is not present in cache calculates the hashes and caches the result.
    *
+   * The cached digests are reused, only those of the mask missing from the
+   * cache are calculated.
+   *
    * @param path the path of file to hash.
+   * @param mask the digests to calculate.
    * @param out stores the calculated hashes.
    *
    * @return true if succeeded, false if something went wrong.
    */
-  static bool load(const std::string& path, MultiHashes& out, Logger& logger);
+  static bool load(const std::string& path,
+                   bool persist,
+                   int mask,
+                   MultiHashes& out,
+                   Logger& logger);
 };
 
 #if defined(WIN32)
@@ -105,6 +188,118 @@ struct FileHashCache {
 
 #endif
 
+/**
+ * @brief The hashes of files persisted in the database.
+ *
+ * Values are keyed by device and inode, so a file's hashes are found under
+ * any of its paths. They are valid while the file's mtime, ctime and size are
+ * unchanged, and are removed once unused for hash_cache_persist_expiry.
+ */
+class PersistedFileHashes {
+ public:
+  /// Find the valid hashes of a file.
+  static bool get(const struct stat& st, MultiHashes& hashes);
+
+  /// Store the hashes of a file, missing digests are stored empty.
+  static void put(const struct stat& st, const MultiHashes& hashes);
+
+ private:
+  static std::string key(const struct stat& st) {
+    return std::to_string(st.st_dev) + "." + std::to_string(st.st_ino);
+  }
+
+  /// The identity of the file's content, compared before using the hashes.
+  static std::string version(const struct stat& st) {
+    return std::to_string(st.st_mtime) + ":" + std::to_string(st.st_ctime) +
+           ":" + std::to_string(st.st_size);
+  }
+
+  static void put(const struct stat& st,
+                  const MultiHashes& hashes,
+                  uint64_t time);
+
+  /// Remove the expired hashes, once per process.
+  static void expire();
+};
+
+bool PersistedFileHashes::get(const struct stat& st, MultiHashes& hashes) {
+  expire();
+
+  std::string value;
+  if (!getDatabaseValue(kFileHashes, key(st), value).ok()) {
+    return false;
+  }
+
+  // The value is: mtime:ctime:size:used:md5:sha1:sha256.
+  auto fields = osquery::split(value, ":");
+  if (fields.size() != 7 ||
+      fields[0] + ":" + fields[1] + ":" + fields[2] != version(st)) {
+    return false;
+  }
+
+  // Empty digests were not computed when the value was stored.
+  hashes.mask = (fields[4].empty() ? 0 : HASH_TYPE_MD5) |
+                (fields[5].empty() ? 0 : HASH_TYPE_SHA1) |
+                (fields[6].empty() ? 0 : HASH_TYPE_SHA256);
+  if (hashes.mask == 0) {
+    return false;
+  }
+  hashes.md5 = fields[4];
+  hashes.sha1 = fields[5];
+  hashes.sha256 = fields[6];
+
+  auto now = getUnixTime();
+  auto used = tryTo<uint64_t>(fields[3]).takeOr(uint64_t{0});
+  if (used + kFileHashRefresh < now) {
+    put(st, hashes, now);
+  }
+  return true;
+}
+
+void PersistedFileHashes::put(const struct stat& st,
+                              const MultiHashes& hashes) {
+  if (hashes.mask == 0) {
+    return;
+  }
+  put(st, hashes, getUnixTime());
+}
+
+void PersistedFileHashes::put(const struct stat& st,
+                              const MultiHashes& hashes,
+                              uint64_t time) {
+  setDatabaseValue(kFileHashes,
+                   key(st),
+                   version(st) + ":" + std::to_string(time) + ":" +
+                       hashes.md5 + ":" + hashes.sha1 + ":" + hashes.sha256);
+}
+
+void PersistedFileHashes::expire() {
+  static std::once_flag expired;
+  std::call_once(expired, []() {
+    auto now = getUnixTime();
+    auto oldest = (now > FLAGS_hash_cache_persist_expiry)
+                      ? now - FLAGS_hash_cache_persist_expiry
+                      : 0;
+    std::vector<std::string> keys;
+    scanDatabaseValues(
+        kFileHashes,
+        "",
+        0,
+        [&keys, oldest](const std::string& key, std::string& value) {
+          auto fields = osquery::split(value, ":");
+          if (fields.size() != 7 ||
+              tryTo<uint64_t>(fields[3]).takeOr(uint64_t{0}) < oldest) {
+            keys.push_back(key);
+          }
+          return true;
+        });
+
+    for (const auto& key : keys) {
+      deleteDatabaseValue(kFileHashes, key);
+    }
+  });
+}
+
 /**
  * @brief Checks the current stat output against the cached view.
  *
@@ -125,6 +320,8 @@ static inline bool statInvalid(const struct stat& st, const FileHashCache& fh) {
 }
 
 bool FileHashCache::load(const std::string& path,
+                         bool persist,
+                         int mask,
                          MultiHashes& out,
                          Logger& logger) {
   // synchronize the access to cache
@@ -134,8 +331,6 @@ bool FileHashCache::load(const std::string& path,
   // minheap on cache_access_time
   static std::vector<FileHashCache*> lru;
 
-  WriteLock guard(mx);
-
   struct stat st;
   if (stat(path.c_str(), &st) != 0) {
     char buf[0x200] = {0};
@@ -144,6 +339,35 @@ bool FileHashCache::load(const std::string& path,
     return false;
   }
 
+  MultiHashes hashes = {};
+  {
+    WriteLock guard(mx);
+    auto entry = cache.find(path);
+    if (entry != cache.end() && !statInvalid(st, entry->second)) {
+      hashes = entry->second.hashes;
+      if ((hashes.mask & mask) == mask) {
+        // ok, got it
+        out = std::move(hashes);
+        entry->second.cache_access_time = time(nullptr);
+        std::make_heap(lru.begin(), lru.end(), FileHashCache::greater);
+        return true;
+      }
+    }
+  }
+
+  // The lock is not held while hashing, files may be hashed concurrently.
+  MultiHashes persisted = {};
+  if (persist && PersistedFileHashes::get(st, persisted)) {
+    mergeHashes(hashes, persisted);
+  }
+
+  auto known = hashes.mask;
+  addHashes(path, mask, hashes);
+  if (persist && hashes.mask != known) {
+    PersistedFileHashes::put(st, hashes);
+  }
+
+  WriteLock guard(mx);
   auto entry = cache.find(path);
   if (entry == cache.end()) { // none, load
     if (cache.size() >= FLAGS_hash_cache_max) {
@@ -161,124 +385,207 @@ bool FileHashCache::load(const std::string& path,
       }
     }
 
-    auto hashes = hashMultiFromFile(
-        HASH_TYPE_MD5 | HASH_TYPE_SHA1 | HASH_TYPE_SHA256, path);
     FileHashCache rec = {st.st_mtime, // .file_mtime
                          st.st_ino, // .file_inode
                          st.st_size, // .file_size
                          time(nullptr), // .cache_access_time
-                         std::move(hashes), // .hashes
+                         hashes, // .hashes
                          path}; // .path
     cache[path] = std::move(rec);
     lru.push_back(&cache[path]);
     std::push_heap(lru.begin(), lru.end(), FileHashCache::greater);
-    out = cache[path].hashes;
-  } else if (statInvalid(st, entry->second)) { // changed, update
-    auto hashes = hashMultiFromFile(
-        HASH_TYPE_MD5 | HASH_TYPE_SHA1 | HASH_TYPE_SHA256, path);
+  } else { // changed, update
     entry->second.cache_access_time = time(nullptr);
     entry->second.file_inode = st.st_ino;
     entry->second.file_mtime = st.st_mtime;
     entry->second.file_size = st.st_size;
-    entry->second.hashes = std::move(hashes);
-    std::make_heap(lru.begin(), lru.end(), FileHashCache::greater);
-    out = entry->second.hashes;
-  } else { // ok, got it
-    out = entry->second.hashes;
-    entry->second.cache_access_time = time(nullptr);
+    entry->second.hashes = hashes;
     std::make_heap(lru.begin(), lru.end(), FileHashCache::greater);
   }
+  out = std::move(hashes);
   return true;
 }
 
-void genHashForFile(const std::string& path,
-                    const std::string& dir,
+/// Calculate the hashes of a file, the context is not used.
+void hashFile(const std::string& path,
+              const HashRowOptions& options,
+              MultiHashes& hashes,
+              Logger& logger) {
+  if (!FLAGS_disable_hash_cache) {
+    FileHashCache::load(path, options.persist, options.mask, hashes, logger);
+  } else {
+    hashes = hashMultiFromFile(options.mask, path);
+    std::this_thread::sleep_for(std::chrono::milliseconds(FLAGS_hash_delay));
+  }
+}
+
+/// Use the inner-query cache if the global hash cache is disabled.
+inline bool isContextCached(QueryContext& context, const std::string& path) {
+  return FLAGS_disable_hash_cache && context.isCached(path);
+}
+
+void genHashForFile(const HashTarget& target,
+                    MultiHashes& hashes,
                     QueryContext& context,
-                    QueryData& results,
-                    Logger& logger) {
+                    const HashRowCallback& callback) {
   // Must provide the path, filename, directory separate from boost path->string
   // helpers to match any explicit (query-parsed) predicate constraints.
   auto tr = TableRowHolder(new DynamicTableRow());
-  MultiHashes hashes;
-  if (!FLAGS_disable_hash_cache) {
-    FileHashCache::load(path, hashes, logger);
-  } else {
-    if (context.isCached(path)) {
-      // Use the inner-query cache if the global hash cache is disabled.
-      // This protects against hashing the same content twice in the same query.
-      tr = context.getCache(path);
-    } else {
-      hashes = hashMultiFromFile(
-          HASH_TYPE_MD5 | HASH_TYPE_SHA1 | HASH_TYPE_SHA256, path);
-      std::this_thread::sleep_for(std::chrono::milliseconds(FLAGS_hash_delay));
-    }
+  auto cached = isContextCached(context, target.path);
+  if (cached) {
+    // This protects against hashing the same content twice in the same query.
+    tr = context.getCache(target.path);
   }
 
   DynamicTableRow& r = *dynamic_cast<DynamicTableRow*>(tr.get());
-  r["path"] = path;
-  r["directory"] = dir;
-  r["md5"] = std::move(hashes.md5);
-  r["sha1"] = std::move(hashes.sha1);
-  r["sha256"] = std::move(hashes.sha256);
+  r["path"] = target.path;
+  r["directory"] = target.dir;
+  if (!cached) {
+    r["md5"] = std::move(hashes.md5);
+    r["sha1"] = std::move(hashes.sha1);
+    r["sha256"] = std::move(hashes.sha256);
+  }
 
   if (FLAGS_disable_hash_cache) {
-    context.setCache(path, tr);
+    context.setCache(target.path, tr);
   }
 
   r["pid_with_namespace"] = "0";
 
-  results.push_back(static_cast<Row>(r));
+  auto row = static_cast<Row>(r);
+  callback(row);
 }
 
-void expandFSPathConstraints(QueryContext& context,
-                             const std::string& path_column_name,
-                             std::set<std::string>& paths) {
-  context.expandConstraints(
-      path_column_name,
-      LIKE,
-      paths,
-      ([&](const std::string& pattern, std::set<std::string>& out) {
-        std::vector<std::string> patterns;
-        auto status =
-            resolveFilePattern(pattern, patterns, GLOB_ALL | GLOB_NO_CANON);
-        if (status.ok()) {
-          for (const auto& resolved : patterns) {
-            out.insert(resolved);
-          }
-        }
-        return status;
-      }));
+/**
+ * @brief Hash the targets using worker threads, rows are generated in order.
+ *
+ * Workers hash at most kHashWorkerWindow files each ahead of the last row
+ * generated, the hashes of a large expansion are not all held at once.
+ */
+void genHashTargetsParallel(const std::vector<HashTarget>& targets,
+                            size_t workers,
+                            const HashRowOptions& options,
+                            QueryContext& context,
+                            const HashRowCallback& callback,
+                            Logger& logger) {
+  // The context is not thread safe, cached files are found before hashing.
+  std::vector<char> cached(targets.size(), 0);
+  for (size_t i = 0; i < targets.size(); i++) {
+    cached[i] = isContextCached(context, targets[i].path) ? 1 : 0;
+  }
+
+  std::vector<MultiHashes> hashes(targets.size());
+  std::vector<char> done(targets.size(), 0);
+  std::mutex mutex;
+  std::condition_variable cv;
+  size_t next = 0;
+  size_t generated = 0;
+  auto window = workers * kHashWorkerWindow;
+
+  auto worker = [&]() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      cv.wait(lock, [&] {
+        return next >= targets.size() || next < generated + window;
+      });
+      if (next >= targets.size()) {
+        break;
+      }
+
+      auto i = next++;
+      lock.unlock();
+      if (cached[i] == 0) {
+        hashFile(targets[i].path, options, hashes[i], logger);
+      }
+      lock.lock();
+      done[i] = 1;
+      cv.notify_all();
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < workers; i++) {
+    threads.emplace_back(worker);
+  }
+
+  for (size_t i = 0; i < targets.size(); i++) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      cv.wait(lock, [&] { return done[i] != 0; });
+    }
+
+    genHashForFile(targets[i], hashes[i], context, callback);
+    hashes[i] = MultiHashes();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    generated = i + 1;
+    cv.notify_all();
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
 }
 
-QueryData genHashImpl(QueryContext& context, Logger& logger) {
-  QueryData results;
+void genHashTargets(const std::vector<HashTarget>& targets,
+                    const HashRowOptions& options,
+                    QueryContext& context,
+                    const HashRowCallback& callback,
+                    Logger& logger) {
+  auto workers = std::min(options.workers, targets.size());
+  if (workers > 1) {
+    genHashTargetsParallel(
+        targets, workers, options, context, callback, logger);
+    return;
+  }
+
+  for (const auto& target : targets) {
+    MultiHashes hashes;
+    if (!isContextCached(context, target.path)) {
+      hashFile(target.path, options, hashes, logger);
+    }
+    genHashForFile(target, hashes, context, callback);
+  }
+}
+
+void genHashRows(QueryContext& context,
+                 Logger& logger,
+                 const HashRowOptions& options,
+                 const HashRowCallback& callback) {
   boost::system::error_code ec;
+  std::vector<HashTarget> targets;
+
+  // Files SQLite would discard for their path or directory are not hashed.
+  auto path_matcher = ConstraintMatcher(context.constraints["path"]);
+  auto directory_matcher = ConstraintMatcher(context.constraints["directory"]);
 
   // The query must provide a predicate with constraints including path or
-  // directory. We search for the parsed predicate constraints with the equals
-  // operator.
-  auto paths = context.constraints["path"].getAll(EQUALS);
-  expandFSPathConstraints(context, "path", paths);
+  // directory. The paths are the EQUALS values, or resolved LIKE patterns.
+  auto paths =
+      resolveConstraintPaths(context, "path", GLOB_ALL | GLOB_NO_CANON);
 
   // Iterate through the file paths, adding the hash results
   for (const auto& path_string : paths) {
     boost::filesystem::path path = path_string;
-    if (!boost::filesystem::is_regular_file(path, ec)) {
+    auto directory_string = path.parent_path().string();
+    if (!directory_matcher.matches(directory_string) ||
+        !boost::filesystem::is_regular_file(path, ec)) {
       continue;
     }
 
-    genHashForFile(
-        path_string, path.parent_path().string(), context, results, logger);
+    targets.push_back({path_string, directory_string});
   }
 
   // Now loop through constraints using the directory column constraint.
-  auto directories = context.constraints["directory"].getAll(EQUALS);
-  expandFSPathConstraints(context, "directory", directories);
+  auto directories =
+      resolveConstraintPaths(context, "directory", GLOB_ALL | GLOB_NO_CANON);
 
   // Iterate over the directory paths
   for (const auto& directory_string : directories) {
+    // The paths of a directory's files start with it, none may match.
     boost::filesystem::path directory = directory_string;
-    if (!boost::filesystem::is_directory(directory, ec)) {
+    if (!path_matcher.mayMatchPrefix(directory_string) ||
+        !boost::filesystem::is_directory(directory, ec)) {
       continue;
     }
 
@@ -286,22 +593,49 @@ QueryData genHashImpl(QueryContext& context, Logger& logger) {
     // file.
     boost::filesystem::directory_iterator begin(directory), end;
     for (; begin != end; ++begin) {
-      if (boost::filesystem::is_regular_file(begin->path(), ec)) {
-        genHashForFile(
-            begin->path().string(), directory_string, context, results, logger);
+      auto path_string = begin->path().string();
+      if (path_matcher.matches(path_string) &&
+          boost::filesystem::is_regular_file(begin->path(), ec)) {
+        targets.push_back({path_string, directory_string});
       }
     }
   }
 
+  // A sliced scan only hashes the files following the previous slice.
+  ScanSlice::select(targets, [](const HashTarget& target) -> const auto& {
+    return target.path;
+  });
+  genHashTargets(targets, options, context, callback, logger);
+}
+
+QueryData genHashImpl(QueryContext& context, Logger& logger) {
+  QueryData results;
+  // Rows generated within a container namespace do not use the database.
+  genHashRows(context, logger, HashRowOptions(), [&results](Row& r) {
+    results.push_back(std::move(r));
+  });
   return results;
 }
 
-QueryData genHash(QueryContext& context) {
+void genHash(RowYield& yield, QueryContext& context) {
   if (hasNamespaceConstraint(context)) {
-    return generateInNamespace(context, "hash", genHashImpl);
+    // Rows generated within a container namespace are received at once.
+    auto results = generateInNamespace(context, "hash", genHashImpl);
+    for (auto& r : results) {
+      yield(TableRowHolder(new DynamicTableRow(std::move(r))));
+    }
   } else {
+    // Each file's hashes are yielded to SQLite once calculated.
     GLOGLogger logger;
-    return genHashImpl(context, logger);
+    HashRowOptions options;
+    options.workers = FLAGS_hash_workers;
+    options.persist = FLAGS_hash_cache_persist;
+    options.mask = (context.isColumnUsed("md5") ? HASH_TYPE_MD5 : 0) |
+                   (context.isColumnUsed("sha1") ? HASH_TYPE_SHA1 : 0) |
+                   (context.isColumnUsed("sha256") ? HASH_TYPE_SHA256 : 0);
+    genHashRows(context, logger, options, [&yield](Row& r) {
+      yield(TableRowHolder(new DynamicTableRow(std::move(r))));
+    });
   }
 }
 } // namespace tables
@@ -17,6 +17,7 @@
 #include <osquery/core/core.h>
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
+#include <osquery/filesystem/linux/sysfs.h>
 #include <osquery/logger/logger.h>
 
 extern "C" {
@@ -83,28 +84,22 @@ static void getBlockDevice(struct udev_device* dev,
     r["parent"] = lvm_lv2pv[name];
   }
 
-  const char *size = udev_device_get_sysattr_value(dev, "size");
-  if (size != nullptr) {
-    r["size"] = size;
+  // The attributes are read relative to the device directories.
+  SysfsDirectory device(udev_device_get_syspath(dev));
+  std::string value;
+  if (device.read("size", value).ok()) {
+    r["size"] = value;
   }
 
-  const char* block_size =
-      udev_device_get_sysattr_value(dev, "queue/logical_block_size");
-  if (block_size != nullptr) {
-    r["block_size"] = block_size;
+  if (device.read("queue/logical_block_size", value).ok()) {
+    r["block_size"] = value;
   }
 
   subdev = udev_device_get_parent_with_subsystem_devtype(dev, "scsi", nullptr);
   if (subdev != nullptr) {
-    const char *model = udev_device_get_sysattr_value(subdev, "model");
-    std::string model_string = std::string(model);
-    boost::algorithm::trim(model_string);
-    r["model"] = model_string;
-
-    model = udev_device_get_sysattr_value(subdev, "vendor");
-    model_string = std::string(model);
-    boost::algorithm::trim(model_string);
-    r["vendor"] = model_string;
+    SysfsDirectory scsi(udev_device_get_syspath(subdev));
+    r["model"] = boost::algorithm::trim_copy(scsi.get("model"));
+    r["vendor"] = boost::algorithm::trim_copy(scsi.get("vendor"));
   }
 
   blkid_probe pr = blkid_new_probe_from_filename(name);
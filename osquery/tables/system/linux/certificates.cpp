@@ -16,8 +16,15 @@
 #include <openssl/x509.h>
 #include <openssl/x509v3.h>
 
+#include <sys/stat.h>
+
+#include <boost/algorithm/string/case_conv.hpp>
+
 #include <ctime>
 #include <filesystem>
+#include <mutex>
+#include <set>
+#include <unordered_map>
 
 namespace osquery::tables {
 
@@ -61,6 +68,33 @@ struct CertificateInformation final {
 
 using CertificateInformationList = std::vector<CertificateInformation>;
 
+/// The identity of a bundle file, its certificates are parsed again once it
+/// changes.
+struct BundleIdentity final {
+  dev_t device{0};
+  ino_t inode{0};
+  off_t size{0};
+  std::time_t mtime{0};
+  long mtime_nsec{0};
+
+  bool operator==(const BundleIdentity& other) const {
+    return device == other.device && inode == other.inode &&
+           size == other.size && mtime == other.mtime &&
+           mtime_nsec == other.mtime_nsec;
+  }
+};
+
+struct CachedBundle final {
+  BundleIdentity identity;
+  CertificateInformationList cert_info_list;
+};
+
+/// The most bundles whose parsed certificates are kept.
+const size_t kMaxCachedBundles{64};
+
+std::mutex bundle_cache_mutex;
+std::unordered_map<std::string, CachedBundle> bundle_cache;
+
 enum class OpenSSLError {
   OpenFailed,
   ReadFailed,
@@ -241,6 +275,57 @@ Expected<CertificateInformationList, OpenSSLError> enumerateBundleCertificates(
   return parseX509InfoStack(std::move(x509_info_list));
 }
 
+bool getBundleIdentity(const std::filesystem::path& path,
+                       BundleIdentity& identity) {
+  struct stat file_stat {};
+  if (::stat(path.c_str(), &file_stat) != 0) {
+    return false;
+  }
+
+  identity.device = file_stat.st_dev;
+  identity.inode = file_stat.st_ino;
+  identity.size = file_stat.st_size;
+  identity.mtime = file_stat.st_mtim.tv_sec;
+  identity.mtime_nsec = file_stat.st_mtim.tv_nsec;
+  return true;
+}
+
+/**
+ * @brief The certificates of a bundle, parsed again only if it changed.
+ *
+ * The bundles are identified by their path, device, inode, size and
+ * modification time, an unchanged bundle is not read.
+ */
+Expected<CertificateInformationList, OpenSSLError> getBundleCertificates(
+    const std::filesystem::path& path) {
+  BundleIdentity identity;
+  auto cacheable = getBundleIdentity(path, identity);
+
+  if (cacheable) {
+    std::lock_guard<std::mutex> lock(bundle_cache_mutex);
+    auto it = bundle_cache.find(path.string());
+    if (it != bundle_cache.end() && it->second.identity == identity) {
+      return it->second.cert_info_list;
+    }
+  }
+
+  auto exp_cert_info_list = enumerateBundleCertificates(path);
+  if (exp_cert_info_list.isError() || !cacheable) {
+    return exp_cert_info_list;
+  }
+
+  auto cert_info_list = exp_cert_info_list.take();
+
+  std::lock_guard<std::mutex> lock(bundle_cache_mutex);
+  if (bundle_cache.size() >= kMaxCachedBundles &&
+      bundle_cache.count(path.string()) == 0) {
+    bundle_cache.clear();
+  }
+
+  bundle_cache[path.string()] = {identity, cert_info_list};
+  return cert_info_list;
+}
+
 } // namespace
 
 QueryData genCerts(QueryContext& context) {
@@ -258,8 +343,14 @@ QueryData genCerts(QueryContext& context) {
     }
   }
 
+  // The digests are compared regardless of their case
+  std::set<std::string> sha1_list;
+  for (const auto& sha1 : context.constraints["sha1"].getAll(EQUALS)) {
+    sha1_list.insert(boost::algorithm::to_lower_copy(sha1));
+  }
+
   for (const auto& bundle_path : bundle_path_list) {
-    auto exp_cert_info_list = enumerateBundleCertificates(bundle_path);
+    auto exp_cert_info_list = getBundleCertificates(bundle_path);
     if (exp_cert_info_list.isError()) {
       auto error = exp_cert_info_list.takeError();
       LOG(ERROR) << error.getMessage();
@@ -270,6 +361,12 @@ QueryData genCerts(QueryContext& context) {
     auto cert_info_list = exp_cert_info_list.take();
 
     for (const auto& cert_info : cert_info_list) {
+      if (!sha1_list.empty() &&
+          sha1_list.count(boost::algorithm::to_lower_copy(cert_info.sha1)) ==
+              0) {
+        continue;
+      }
+
       Row row;
       row["path"] = SQL_TEXT(bundle_path.string());
       row["common_name"] = SQL_TEXT(cert_info.common_name);
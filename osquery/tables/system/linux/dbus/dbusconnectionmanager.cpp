@@ -0,0 +1,75 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <sstream>
+
+#include <osquery/tables/system/linux/dbus/dbusconnectionmanager.h>
+
+namespace osquery {
+
+DbusConnectionManager& DbusConnectionManager::get() {
+  static DbusConnectionManager manager;
+  return manager;
+}
+
+DbusConnectionManager::~DbusConnectionManager() {
+  disconnect();
+}
+
+Status DbusConnectionManager::run(const Function& function) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if (connection_ && !dbus_connection_get_is_connected(connection_.get())) {
+    disconnect();
+  }
+
+  if (!connection_) {
+    auto status = connect();
+    if (!status.ok()) {
+      return status;
+    }
+  }
+
+  return function(connection_);
+}
+
+Status DbusConnectionManager::connect() {
+  static const auto kThreadsInitialized = dbus_threads_init_default();
+  static_cast<void>(kThreadsInitialized);
+
+  DBusError error DBUS_ERROR_INIT;
+  auto connection = dbus_bus_get_private(DBUS_BUS_SYSTEM, &error);
+  if (dbus_error_is_set(&error)) {
+    std::stringstream message;
+    message << "Failed to connect to the system dbus: " << error.message
+            << " (" << error.name << ")";
+
+    dbus_error_free(&error);
+    return Status::failure(message.str());
+  }
+
+  if (connection == nullptr) {
+    return Status::failure("Failed to connect to the system dbus");
+  }
+
+  dbus_connection_set_exit_on_disconnect(connection, false);
+  connection_.reset(connection);
+  return Status::success();
+}
+
+void DbusConnectionManager::disconnect() {
+  // Private connections are closed before their last reference is dropped
+  if (connection_) {
+    dbus_connection_close(connection_.get());
+  }
+
+  connection_.release();
+}
+
+} // namespace osquery
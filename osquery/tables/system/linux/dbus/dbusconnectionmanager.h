@@ -0,0 +1,50 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <functional>
+#include <mutex>
+
+#include <osquery/tables/system/linux/dbus/uniquedbusconnection.h>
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/**
+ * @brief A system bus connection kept across the queries of the dbus tables
+ *
+ * The connection is private to osquery, so a bus restart closes it instead
+ * of terminating the process, and it is opened again by the next query.
+ */
+class DbusConnectionManager final {
+ public:
+  using Function = std::function<Status(const UniqueDbusConnection&)>;
+
+  static DbusConnectionManager& get();
+
+  /// Runs the function with the connection, one function at a time
+  Status run(const Function& function);
+
+  ~DbusConnectionManager();
+
+  DbusConnectionManager(const DbusConnectionManager&) = delete;
+  DbusConnectionManager& operator=(const DbusConnectionManager&) = delete;
+
+ private:
+  DbusConnectionManager() = default;
+
+  Status connect();
+  void disconnect();
+
+  std::mutex mutex_;
+  UniqueDbusConnection connection_;
+};
+
+} // namespace osquery
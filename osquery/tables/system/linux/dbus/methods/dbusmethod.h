@@ -9,6 +9,12 @@
 
 #pragma once
 
+#include <memory>
+#include <sstream>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
 #include <osquery/logger/logger.h>
 #include <osquery/tables/system/linux/dbus/uniquedbusconnection.h>
 #include <osquery/tables/system/linux/dbus/uniquedbusmessage.h>
@@ -23,6 +29,12 @@ class DbusMethod final : public MethodHandler {
   using Output = typename MethodHandler::Output;
   using MethodHandler::parseReply;
 
+  /// The object path and the arguments of one call of a pipelined batch
+  using Call = std::tuple<std::string, std::decay_t<ArgumentList>...>;
+
+  /// Calls sent before waiting for the oldest reply, see callPipelined
+  static constexpr std::size_t kPipelineDepth{64U};
+
   Status call(Output& output,
               const UniqueDbusConnection& connection,
               const std::string& object_path,
@@ -50,6 +62,58 @@ class DbusMethod final : public MethodHandler {
     return parseReply(output, reply);
   }
 
+  /**
+   * @brief Perform a batch of calls without a round trip for each.
+   *
+   * Up to kPipelineDepth calls are sent before the reply of the oldest one
+   * is awaited, so the bus and the service process the batch back to back.
+   *
+   * @param output_list receives the output of each call, in order.
+   * @param connection the connection used for every call.
+   * @param call_list the object path and arguments of each call.
+   * @return the status of each call, in order.
+   */
+  std::vector<Status> callPipelined(std::vector<Output>& output_list,
+                                    const UniqueDbusConnection& connection,
+                                    const std::vector<Call>& call_list) const {
+    output_list.assign(call_list.size(), Output{});
+    std::vector<Status> status_list(call_list.size());
+
+    std::vector<PendingCall> pending_list;
+    pending_list.reserve(call_list.size());
+    for (std::size_t i{0U}; i < call_list.size(); ++i) {
+      pending_list.emplace_back(nullptr, &dbus_pending_call_unref);
+    }
+
+    std::size_t next_call{0U};
+
+    for (std::size_t i{0U}; i < call_list.size(); ++i) {
+      for (; next_call < call_list.size() && next_call < i + kPipelineDepth;
+           ++next_call) {
+        status_list[next_call] = std::apply(
+            [&](const std::string& object_path, const auto&... args) {
+              return sendCall(
+                  pending_list[next_call], connection, object_path, args...);
+            },
+            call_list[next_call]);
+      }
+
+      if (!status_list[i].ok()) {
+        continue;
+      }
+
+      UniqueDbusMessage reply;
+      status_list[i] = waitForReply(reply, pending_list[i]);
+      pending_list[i].reset();
+
+      if (status_list[i].ok()) {
+        status_list[i] = parseReply(output_list[i], reply);
+      }
+    }
+
+    return status_list;
+  }
+
   DbusMethod() = default;
   virtual ~DbusMethod() override = default;
 
@@ -57,6 +121,65 @@ class DbusMethod final : public MethodHandler {
   DbusMethod& operator=(const DbusMethod&) = delete;
 
  private:
+  using PendingCall =
+      std::unique_ptr<DBusPendingCall, decltype(&dbus_pending_call_unref)>;
+
+  template <class... ParameterList>
+  Status sendCall(PendingCall& pending_call,
+                  const UniqueDbusConnection& connection,
+                  const std::string& object_path,
+                  ParameterList const&... parameter_list) const {
+    UniqueDbusMessage message;
+    auto status = UniqueDbusMessage::create(message,
+                                            MethodHandler::kDestination,
+                                            object_path,
+                                            MethodHandler::kInterface,
+                                            MethodHandler::kMethod);
+    if (!status.ok()) {
+      return status;
+    }
+
+    status = processParameterList(message, parameter_list...);
+    if (!status.ok()) {
+      return status;
+    }
+
+    DBusPendingCall* pending_call_ptr{nullptr};
+    if (!dbus_connection_send_with_reply(
+            connection.get(), message.get(), &pending_call_ptr, -1) ||
+        pending_call_ptr == nullptr) {
+      return Status::failure("Failed to send the dbus request");
+    }
+
+    pending_call = PendingCall(pending_call_ptr, &dbus_pending_call_unref);
+    return Status::success();
+  }
+
+  Status waitForReply(UniqueDbusMessage& reply,
+                      PendingCall& pending_call) const {
+    reply.release();
+
+    dbus_pending_call_block(pending_call.get());
+    auto reply_ptr = dbus_pending_call_steal_reply(pending_call.get());
+    if (reply_ptr == nullptr) {
+      return Status::failure("Failed to receive the dbus reply");
+    }
+
+    reply.reset(reply_ptr);
+
+    DBusError error DBUS_ERROR_INIT;
+    if (dbus_set_error_from_message(&error, reply_ptr)) {
+      std::stringstream message;
+      message << "Failed to call the dbus method: " << error.message << " ("
+              << error.name << ")";
+
+      dbus_error_free(&error);
+      return Status::failure(message.str());
+    }
+
+    return Status::success();
+  }
+
   Status sendMessage(const UniqueDbusConnection& connection,
                      UniqueDbusMessage& reply,
                      const UniqueDbusMessage& message) const {
@@ -101,6 +224,37 @@ class DbusMethod final : public MethodHandler {
     return true;
   }
 
+  bool processParameter(Status& status,
+                        DBusMessageIter& message_it,
+                        const std::vector<std::string>& param) const {
+    DBusMessageIter array_it{};
+    if (!dbus_message_iter_open_container(&message_it,
+                                          DBUS_TYPE_ARRAY,
+                                          DBUS_TYPE_STRING_AS_STRING,
+                                          &array_it)) {
+      status = Status::failure("Failed to append the string array parameter");
+      return false;
+    }
+
+    for (const auto& value : param) {
+      auto string_ptr = value.c_str();
+      if (!dbus_message_iter_append_basic(
+              &array_it, DBUS_TYPE_STRING, &string_ptr)) {
+        dbus_message_iter_abandon_container(&message_it, &array_it);
+        status = Status::failure("Failed to append the string array parameter");
+        return false;
+      }
+    }
+
+    if (!dbus_message_iter_close_container(&message_it, &array_it)) {
+      status = Status::failure("Failed to append the string array parameter");
+      return false;
+    }
+
+    status = Status::success();
+    return true;
+  }
+
   template <class... ParameterList>
   Status processParameterList(UniqueDbusMessage& message,
                               ParameterList const&... parameter_list) const {
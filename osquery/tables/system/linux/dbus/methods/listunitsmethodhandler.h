@@ -10,6 +10,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 #include <osquery/tables/system/linux/dbus/methods/dbusmethod.h>
 #include <osquery/utils/status/status.h>
@@ -49,4 +50,19 @@ class ListUnitsMethodHandler {
 
 using ListUnitsMethod = DbusMethod<ListUnitsMethodHandler>;
 
+/// Lists the units matching states and patterns, since systemd 230
+class ListUnitsByPatternsMethodHandler : public ListUnitsMethodHandler {
+ public:
+  constexpr static auto kMethod{"ListUnitsByPatterns"};
+
+ protected:
+  ListUnitsByPatternsMethodHandler() = default;
+  virtual ~ListUnitsByPatternsMethodHandler() override = default;
+};
+
+using ListUnitsByPatternsMethod =
+    DbusMethod<ListUnitsByPatternsMethodHandler,
+               const std::vector<std::string>&,
+               const std::vector<std::string>&>;
+
 } // namespace osquery
@@ -11,6 +11,7 @@
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
+#include <osquery/tables/system/package_cache.h>
 #include <osquery/utils/linux/idpkgquery.h>
 #include <osquery/worker/ipc/platform_table_container_ipc.h>
 #include <osquery/worker/logging/glog/glog_logger.h>
@@ -38,9 +39,7 @@ void logError(Logger& logger,
                  " (admindir='" + admindir + "')");
 }
 
-} // namespace
-
-QueryData genDebPackagesImpl(QueryContext& context, Logger& logger) {
+std::vector<std::string> getAdminDirs(QueryContext& context) {
   std::vector<std::string> admindir_list{};
 
   if (context.hasConstraint("admindir", EQUALS)) {
@@ -52,6 +51,13 @@ QueryData genDebPackagesImpl(QueryContext& context, Logger& logger) {
   } else {
     admindir_list.push_back(kAdminDir);
   }
+  return admindir_list;
+}
+
+} // namespace
+
+QueryData genDebPackagesImpl(QueryContext& context, Logger& logger) {
+  auto admindir_list = getAdminDirs(context);
 
   // Drop to 'nobody' to ensure that the libdpkg library
   // can't change the package database. Privileges will be
@@ -118,8 +124,19 @@ QueryData genDebPackages(QueryContext& context) {
   if (hasNamespaceConstraint(context)) {
     return generateInNamespace(context, "deb_packages", genDebPackagesImpl);
   } else {
+    // The package database is the status file and the pending updates.
+    std::string key = "deb_packages";
+    std::vector<std::string> sources;
+    for (const auto& admindir : getAdminDirs(context)) {
+      key += ":" + admindir;
+      sources.push_back(admindir + "/status");
+      sources.push_back(admindir + "/updates");
+    }
+
     GLOGLogger logger;
-    return genDebPackagesImpl(context, logger);
+    return genCachedPackages(key, sources, [&]() {
+      return genDebPackagesImpl(context, logger);
+    });
   }
 }
 } // namespace tables
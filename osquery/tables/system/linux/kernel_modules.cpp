@@ -7,13 +7,11 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
-#include <fstream>
-
 #include <boost/algorithm/string/trim.hpp>
 
 #include <osquery/core/core.h>
 #include <osquery/core/tables.h>
-#include <osquery/filesystem/filesystem.h>
+#include <osquery/filesystem/linux/sysfs.h>
 #include <osquery/logger/logger.h>
 #include <osquery/utils/conversions/split.h>
 
@@ -25,21 +23,14 @@ static const std::string kKernelModulePath = "/proc/modules";
 QueryData genKernelModules(QueryContext& context) {
   QueryData results;
 
-  if (!pathExists(kKernelModulePath).ok()) {
-    VLOG(1) << "Cannot find kernel modules proc file: " << kKernelModulePath;
-    return {};
-  }
-
   // Cannot seek to the end of procfs.
-  std::ifstream fd(kKernelModulePath, std::ios::in);
-  if (!fd) {
-    VLOG(1) << "Cannot read kernel modules from: " << kKernelModulePath;
+  std::string module_info;
+  auto status = readPseudoFile(kKernelModulePath, module_info);
+  if (!status.ok()) {
+    VLOG(1) << "Cannot read kernel modules: " << status.getMessage();
     return {};
   }
 
-  auto module_info = std::string(std::istreambuf_iterator<char>(fd),
-                                 std::istreambuf_iterator<char>());
-
   for (const auto& module : osquery::split(module_info, "\n")) {
     Row r;
     auto details = osquery::split(module, " ");
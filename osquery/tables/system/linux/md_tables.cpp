@@ -26,6 +26,7 @@
 
 #include <osquery/events/linux/udev.h>
 #include <osquery/filesystem/filesystem.h>
+#include <osquery/filesystem/linux/sysfs.h>
 #include <osquery/logger/logger.h>
 #include <osquery/tables/system/linux/md_tables.h>
 #include <osquery/utils/conversions/split.h>
@@ -57,12 +58,8 @@ static inline void trimStrs(std::vector<std::string>& strs) {
  * tabs, etc.)
  */
 static inline void getLines(std::vector<std::string>& lines) {
-  if (!pathExists(kMDStatPath).ok()) {
-    return;
-  }
-
   std::string content;
-  if (!readFile(kMDStatPath, content).ok()) {
+  if (!readPseudoFile(kMDStatPath, content).ok()) {
     return;
   }
 
@@ -140,6 +137,18 @@ std::string MD::getPathByDevName(const std::string& name) {
 }
 
 std::string MD::getDevName(int major, int minor) {
+  // The device of a number is found without walking every block device.
+  std::string uevent;
+  auto path = "/sys/dev/block/" + std::to_string(major) + ":" +
+              std::to_string(minor) + "/uevent";
+  if (readSysfsAttribute(path, uevent).ok()) {
+    for (const auto& line : split(uevent, "\n")) {
+      if (boost::starts_with(line, "DEVNAME=")) {
+        return "/dev/" + line.substr(8);
+      }
+    }
+  }
+
   std::string devName = "unknown";
 
   walkUdevDevices("block", [&](udev_device* const& device) {
@@ -13,7 +13,7 @@
 
 #include <osquery/core/core.h>
 #include <osquery/core/tables.h>
-#include <osquery/filesystem/filesystem.h>
+#include <osquery/filesystem/linux/sysfs.h>
 #include <osquery/utils/conversions/split.h>
 #include <osquery/utils/conversions/tryto.h>
 
@@ -40,7 +40,7 @@ QueryData getMemoryInfo(QueryContext& context) {
   Row r;
 
   std::string meminfo_content;
-  if (readFile(kMemInfoPath, meminfo_content).ok()) {
+  if (readPseudoFile(kMemInfoPath, meminfo_content).ok()) {
     // Able to read meminfo file, now grab info we want
     for (const auto& line : split(meminfo_content, "\n")) {
       std::vector<std::string> tokens;
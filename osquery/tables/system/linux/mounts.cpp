@@ -14,8 +14,16 @@
 namespace osquery {
 namespace tables {
 QueryData genMounts(QueryContext& context) {
+  // statfs may block on remote filesystems, it is only called when used.
+  auto with_statfs = context.isAnyColumnUsed({"blocks_size",
+                                              "blocks",
+                                              "blocks_free",
+                                              "blocks_available",
+                                              "inodes",
+                                              "inodes_free"});
+
   MountedFilesystems mounted_fs{};
-  auto status = getMountedFilesystems(mounted_fs);
+  auto status = getMountedFilesystems(mounted_fs, with_statfs);
   if (!status.ok()) {
     LOG(ERROR) << "Failed to list the system mounts: " << status.getMessage();
     return {};
@@ -11,13 +11,16 @@
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
+#include <osquery/sql/columnar_table_row.h>
+#include <osquery/utils/conversions/tryto.h>
 
 namespace osquery {
 namespace tables {
 
 void genDescriptors(const std::string& process,
                     const std::map<std::string, std::string>& descriptors,
-                    QueryData& results) {
+                    TableRowBatch& batch) {
+  auto pid = tryTo<long long>(process, 10);
   for (const auto& fd : descriptors) {
     if (fd.second.find("socket:") != std::string::npos ||
         fd.second.find("anon_inode:") != std::string::npos ||
@@ -26,19 +29,21 @@ void genDescriptors(const std::string& process,
       continue;
     }
 
-    Row r;
-    r["pid"] = process;
-    r["fd"] = fd.first;
-    r["path"] = fd.second;
-    results.push_back(r);
+    auto row = batch.addRow();
+    if (pid.isValue()) {
+      batch.set(row, 0, *pid);
+    }
+    auto number = tryTo<long long>(fd.first, 10);
+    if (number.isValue()) {
+      batch.set(row, 1, *number);
+    }
+    batch.set(row, 2, fd.second);
   }
 
   return;
 }
 
-QueryData genOpenFiles(QueryContext& context) {
-  QueryData results;
-
+void genOpenFiles(RowYield& yield, QueryContext& context) {
   std::set<std::string> pids;
   if (context.constraints["pid"].exists(EQUALS)) {
     pids = context.constraints["pid"].getAll(EQUALS);
@@ -46,14 +51,19 @@ QueryData genOpenFiles(QueryContext& context) {
     osquery::procProcesses(pids);
   }
 
+  // Rows are yielded per process, only one process's descriptors are held.
   for (const auto& process : pids) {
     std::map<std::string, std::string> descriptors;
-    if (osquery::procDescriptors(process, descriptors).ok()) {
-      genDescriptors(process, descriptors, results);
+    if (!osquery::procDescriptors(process, descriptors).ok()) {
+      continue;
     }
-  }
 
-  return results;
+    auto batch = TableRowBatch::create({"pid", "fd", "path"});
+    genDescriptors(process, descriptors, *batch);
+    for (size_t row = 0; row < batch->rows(); ++row) {
+      yield(batch->row(row));
+    }
+  }
 }
 }
 }
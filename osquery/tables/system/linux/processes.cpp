@@ -7,6 +7,7 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <array>
 #include <map>
 #include <regex>
 #include <string>
@@ -29,7 +30,9 @@
 #include <osquery/sql/dynamic_table_row.h>
 #include <osquery/tables/system/linux/processes.h>
 #include <osquery/utils/conversions/split.h>
+#include <osquery/utils/conversions/trim.h>
 #include <osquery/utils/system/boottime.h>
+#include <osquery/utils/system/linux/proc/proc.h>
 
 #include <ctime>
 
@@ -43,11 +46,13 @@ inline std::string getProcAttr(const std::string& attr,
   return "/proc/" + pid + "/" + attr;
 }
 
-inline std::string readProcCMDLine(const std::string& pid) {
-  auto attr = getProcAttr("cmdline", pid);
+inline std::string readProcCMDLine(const std::string& pid,
+                                   std::string& buffer) {
+  if (!proc::readAttr(pid, "cmdline", buffer)) {
+    return {};
+  }
 
-  std::string content;
-  readFile(attr, content);
+  std::string content(buffer);
   // Remove \0 delimiters.
   std::replace_if(
       content.begin(),
@@ -192,46 +197,94 @@ void genProcessEnvironment(const std::string& pid, QueryData& results) {
   }
 }
 
-void genProcessMap(const std::string& pid, QueryData& results) {
-  auto map = getProcAttr("maps", pid);
+bool parseProcMapLine(std::string_view line, ProcMapEntry& entry) {
+  // The address, permissions, offset, device and inode precede the path.
+  std::array<std::string_view, 5> fields;
+  Tokenizer tokenizer(line, " ");
+  if (tokenizer.next(fields) < fields.size()) {
+    return false;
+  }
 
-  std::string content;
-  readFile(map, content);
-  for (auto& line : osquery::split(content, "\n")) {
-    auto fields = osquery::split(line, " ");
-    // If can't read address, not sure.
-    if (fields.size() < 5) {
-      continue;
-    }
+  Tokenizer addresses(fields[0], "-");
+  if (!addresses.next(entry.start) || !addresses.next(entry.end)) {
+    // Problem with the address format.
+    return false;
+  }
 
-    Row r;
-    r["pid"] = pid;
-    if (!fields[0].empty()) {
-      auto addresses = osquery::split(fields[0], "-");
-      if (addresses.size() >= 2) {
-        r["start"] = "0x" + addresses[0];
-        r["end"] = "0x" + addresses[1];
-      } else {
-        // Problem with the address format.
-        continue;
-      }
-    }
+  entry.permissions = fields[1];
+  entry.offset = fields[2];
+  entry.device = fields[3];
+  entry.inode = fields[4];
+  entry.path = trim(tokenizer.rest());
+  return true;
+}
 
-    r["permissions"] = fields[1];
-    auto offset = tryTo<long long>(fields[2], 16);
-    r["offset"] = BIGINT((offset) ? offset.take() : -1);
-    r["device"] = fields[3];
-    r["inode"] = fields[4];
+namespace {
 
-    // Path name must be trimmed.
-    if (fields.size() > 5) {
-      boost::trim(fields[5]);
-      r["path"] = fields[5];
-    }
+/// Split a "Key: Value" line of /proc/<pid>/status or io, both are trimmed.
+bool splitProcDetail(std::string_view line,
+                     std::string_view& key,
+                     std::string_view& value) {
+  auto colon = line.find(':');
+  if (colon == std::string_view::npos) {
+    return false;
+  }
+  key = trim(line.substr(0, colon));
+  value = trim(line.substr(colon + 1));
+  return !key.empty() && !value.empty();
+}
 
-    // BSS with name in pathname.
-    r["pseudo"] = (fields[4] == "0" && !r["path"].empty()) ? "1" : "0";
-    results.push_back(std::move(r));
+/// Remove the " kB" unit of a /proc/<pid>/status memory size.
+std::string_view withoutUnit(std::string_view value) {
+  if (value.size() >= 3) {
+    value.remove_suffix(3);
+  }
+  return trim(value);
+}
+
+/// Split the tab separated real, effective, saved and filesystem ids.
+bool splitProcIds(std::string_view value,
+                  std::array<std::string_view, 4>& ids) {
+  Tokenizer tokenizer(value, "\t");
+  std::string_view extra;
+  return tokenizer.next(ids) == ids.size() && !tokenizer.next(extra);
+}
+
+/// The process_memory_summary column of each smaps size.
+const std::map<std::string_view, std::string> kProcSmapsColumns = {
+    {"Rss", "rss"},
+    {"Pss", "pss"},
+    {"Pss_Anon", "pss_anon"},
+    {"Pss_File", "pss_file"},
+    {"Pss_Shmem", "pss_shmem"},
+    {"Shared_Clean", "shared_clean"},
+    {"Shared_Dirty", "shared_dirty"},
+    {"Private_Clean", "private_clean"},
+    {"Private_Dirty", "private_dirty"},
+    {"Referenced", "referenced"},
+    {"Anonymous", "anonymous"},
+    {"Swap", "swap"},
+    {"SwapPss", "swap_pss"},
+    {"Locked", "locked"},
+};
+} // namespace
+
+void addProcSmapsLine(std::string_view line,
+                      std::map<std::string, uint64_t>& totals) {
+  std::string_view key;
+  std::string_view value;
+  if (!splitProcDetail(line, key, value)) {
+    return;
+  }
+
+  auto column = kProcSmapsColumns.find(key);
+  if (column == kProcSmapsColumns.end()) {
+    return;
+  }
+
+  auto kb = tryTo<std::uint64_t>(withoutUnit(value));
+  if (kb) {
+    totals[column->second] += kb.take() * 1024;
   }
 }
 
@@ -261,12 +314,21 @@ struct SimpleProcStat : private boost::noncopyable {
   /// For errors processing proc data.
   Status status;
 
-  explicit SimpleProcStat(const std::string& pid);
+  /**
+   * @brief Parse the stat and status of a process.
+   *
+   * @param content The buffer holding the content of each attribute.
+   * @param read_status Parse the status, for the name, ids and memory sizes.
+   */
+  SimpleProcStat(const std::string& pid,
+                 std::string& content,
+                 bool read_status);
 };
 
-SimpleProcStat::SimpleProcStat(const std::string& pid) {
-  std::string content;
-  if (readFile(getProcAttr("stat", pid), content).ok()) {
+SimpleProcStat::SimpleProcStat(const std::string& pid,
+                               std::string& content,
+                               bool read_status) {
+  if (proc::readAttr(pid, "stat", content)) {
     auto start = content.find_last_of(")");
     // Start parsing stats from ") <MODE>..."
     if (start == std::string::npos || content.size() <= start + 2) {
@@ -274,42 +336,53 @@ SimpleProcStat::SimpleProcStat(const std::string& pid) {
       return;
     }
 
-    auto details = osquery::split(content.substr(start + 2), " ");
-    if (details.size() <= 19) {
+    std::array<std::string_view, 20> details;
+    Tokenizer tokenizer(std::string_view(content).substr(start + 2), " ");
+    if (tokenizer.next(details) < details.size()) {
       status = Status(1, "Invalid /proc/stat content");
       return;
     }
 
-    this->state = details.at(0);
-    this->parent = details.at(1);
-    this->group = details.at(2);
-    this->user_time = details.at(11);
-    this->system_time = details.at(12);
-    this->nice = details.at(16);
-    this->threads = details.at(17);
-    this->start_time = details.at(19);
+    this->state = details[0];
+    this->parent = details[1];
+    this->group = details[2];
+    this->user_time = details[11];
+    this->system_time = details[12];
+    this->nice = details[16];
+    this->threads = details[17];
+    this->start_time = trim(details[19]);
+  } else if (!read_status) {
+    status = Status(1, "Cannot read /proc/stat");
+    return;
+  }
+
+  if (!read_status) {
+    return;
   }
 
   // /proc/N/status may be not available, or readable by this user.
-  if (!readFile(getProcAttr("status", pid), content).ok()) {
+  if (!proc::readAttr(pid, "status", content)) {
     status = Status(1, "Cannot read /proc/status");
     return;
   }
 
-  for (const auto& line : osquery::split(content, "\n")) {
+  Tokenizer lines(content, "\n");
+  std::string_view line;
+  std::string_view key;
+  std::string_view value;
+  while (lines.next(line)) {
     // Status lines are formatted: Key: Value....\n.
-    auto detail = osquery::split(line, ':', 1);
-    if (detail.size() != 2) {
+    if (!splitProcDetail(line, key, value)) {
       continue;
     }
 
     // There are specific fields from each detail.
-    if (detail.at(0) == "Name") {
-      this->name = detail.at(1);
-    } else if (detail.at(0) == "VmRSS") {
-      detail[1].erase(detail.at(1).end() - 3, detail.at(1).end());
+    if (key == "Name") {
+      this->name = value;
+    } else if (key == "VmRSS") {
       // Memory is reported in kB (1024 bytes).
-      auto resident_size_result = osquery::tryTo<std::uint64_t>(detail.at(1));
+      auto resident_size_result =
+          osquery::tryTo<std::uint64_t>(withoutUnit(value));
 
       if (resident_size_result.isError()) {
         status =
@@ -320,10 +393,10 @@ SimpleProcStat::SimpleProcStat(const std::string& pid) {
       const auto resident_size = resident_size_result.get() * 1024;
 
       this->resident_size = std::to_string(resident_size);
-    } else if (detail.at(0) == "VmSize") {
-      detail[1].erase(detail.at(1).end() - 3, detail.at(1).end());
+    } else if (key == "VmSize") {
       // Memory is reported in kB (1024 bytes).
-      auto virtual_size_result = osquery::tryTo<std::uint64_t>(detail.at(1));
+      auto virtual_size_result =
+          osquery::tryTo<std::uint64_t>(withoutUnit(value));
 
       if (virtual_size_result.isError()) {
         status =
@@ -334,20 +407,20 @@ SimpleProcStat::SimpleProcStat(const std::string& pid) {
       const auto virtual_size = virtual_size_result.get() * 1024;
 
       this->total_size = std::to_string(virtual_size);
-    } else if (detail.at(0) == "Gid") {
+    } else if (key == "Gid") {
       // Format is: R E - -
-      auto gid_detail = osquery::split(detail.at(1), "\t");
-      if (gid_detail.size() == 4) {
-        this->real_gid = gid_detail.at(0);
-        this->effective_gid = gid_detail.at(1);
-        this->saved_gid = gid_detail.at(2);
+      std::array<std::string_view, 4> ids;
+      if (splitProcIds(value, ids)) {
+        this->real_gid = ids[0];
+        this->effective_gid = ids[1];
+        this->saved_gid = ids[2];
       }
-    } else if (detail.at(0) == "Uid") {
-      auto uid_detail = osquery::split(detail.at(1), "\t");
-      if (uid_detail.size() == 4) {
-        this->real_uid = uid_detail.at(0);
-        this->effective_uid = uid_detail.at(1);
-        this->saved_uid = uid_detail.at(2);
+    } else if (key == "Uid") {
+      std::array<std::string_view, 4> ids;
+      if (splitProcIds(value, ids)) {
+        this->real_uid = ids[0];
+        this->effective_uid = ids[1];
+        this->saved_uid = ids[2];
       }
     }
   }
@@ -365,31 +438,34 @@ struct SimpleProcIo : private boost::noncopyable {
   /// For errors processing proc data.
   Status status;
 
-  explicit SimpleProcIo(const std::string& pid);
+  /// Parse the io of a process, the buffer holds the content.
+  SimpleProcIo(const std::string& pid, std::string& content);
 };
 
-SimpleProcIo::SimpleProcIo(const std::string& pid) {
-  std::string content;
-  if (!readFile(getProcAttr("io", pid), content).ok()) {
+SimpleProcIo::SimpleProcIo(const std::string& pid, std::string& content) {
+  if (!proc::readAttr(pid, "io", content)) {
     status = Status(
         1, "Cannot read /proc/" + pid + "/io (is osquery running as root?)");
     return;
   }
 
-  for (const auto& line : osquery::split(content, "\n")) {
+  Tokenizer lines(content, "\n");
+  std::string_view line;
+  std::string_view key;
+  std::string_view value;
+  while (lines.next(line)) {
     // IO lines are formatted: Key: Value....\n.
-    auto detail = osquery::split(line, ':', 1);
-    if (detail.size() != 2) {
+    if (!splitProcDetail(line, key, value)) {
       continue;
     }
 
     // There are specific fields from each detail
-    if (detail.at(0) == "read_bytes") {
-      this->read_bytes = detail.at(1);
-    } else if (detail.at(0) == "write_bytes") {
-      this->write_bytes = detail.at(1);
-    } else if (detail.at(0) == "cancelled_write_bytes") {
-      this->cancelled_write_bytes = detail.at(1);
+    if (key == "read_bytes") {
+      this->read_bytes = value;
+    } else if (key == "write_bytes") {
+      this->write_bytes = value;
+    } else if (key == "cancelled_write_bytes") {
+      this->cancelled_write_bytes = value;
     }
   }
 }
@@ -449,46 +525,58 @@ int getOnDisk(const std::string& pid, std::string& path) {
 void genProcess(const std::string& pid,
                 std::uint64_t system_boot_time,
                 QueryContext& context,
+                bool read_status,
+                std::string& buffer,
                 TableRows& results) {
   // Parse the process stat and status.
-  SimpleProcStat proc_stat(pid);
-  // Parse the process io
-  SimpleProcIo proc_io(pid);
-
+  SimpleProcStat proc_stat(pid, buffer, read_status);
   if (!proc_stat.status.ok()) {
     VLOG(1) << proc_stat.status.getMessage() << " for pid " << pid;
     return;
   }
 
+  // The other attributes are only read for the columns the query uses.
   auto r = make_table_row();
   r["pid"] = pid;
   r["parent"] = proc_stat.parent;
-  r["path"] = readProcLink("exe", pid);
-  r["name"] = proc_stat.name;
+  if (context.isAnyColumnUsed({"path", "on_disk"})) {
+    r["path"] = readProcLink("exe", pid);
+    // A " (deleted)" suffix is removed from the path of a deleted binary.
+    r["on_disk"] = INTEGER(getOnDisk(pid, r["path"]));
+  }
+  if (read_status) {
+    r["name"] = proc_stat.name;
+  }
   r["pgroup"] = proc_stat.group;
   r["state"] = proc_stat.state;
   r["nice"] = proc_stat.nice;
   r["threads"] = proc_stat.threads;
   // Read/parse cmdline arguments.
-  r["cmdline"] = readProcCMDLine(pid);
+  if (context.isColumnUsed("cmdline")) {
+    r["cmdline"] = readProcCMDLine(pid, buffer);
+  }
   if (context.isColumnUsed("cgroup_path")) {
     r["cgroup_path"] = readProcCgroup(pid);
   }
-  r["cwd"] = readProcLink("cwd", pid);
-  r["root"] = readProcLink("root", pid);
-  r["uid"] = proc_stat.real_uid;
-  r["euid"] = proc_stat.effective_uid;
-  r["suid"] = proc_stat.saved_uid;
-  r["gid"] = proc_stat.real_gid;
-  r["egid"] = proc_stat.effective_gid;
-  r["sgid"] = proc_stat.saved_gid;
-
-  r["on_disk"] = INTEGER(getOnDisk(pid, r["path"]));
-
-  // size/memory information
+  if (context.isColumnUsed("cwd")) {
+    r["cwd"] = readProcLink("cwd", pid);
+  }
+  if (context.isColumnUsed("root")) {
+    r["root"] = readProcLink("root", pid);
+  }
+  if (read_status) {
+    r["uid"] = proc_stat.real_uid;
+    r["euid"] = proc_stat.effective_uid;
+    r["suid"] = proc_stat.saved_uid;
+    r["gid"] = proc_stat.real_gid;
+    r["egid"] = proc_stat.effective_gid;
+    r["sgid"] = proc_stat.saved_gid;
+
+    // size/memory information
+    r["resident_size"] = proc_stat.resident_size;
+    r["total_size"] = proc_stat.total_size;
+  }
   r["wired_size"] = "0"; // No support for unpagable counters in linux.
-  r["resident_size"] = proc_stat.resident_size;
-  r["total_size"] = proc_stat.total_size;
 
   // time information
   auto usr_time = std::strtoull(proc_stat.user_time.data(), nullptr, 10);
@@ -505,6 +593,13 @@ void genProcess(const std::string& pid,
     r["start_time"] = "-1";
   }
 
+  if (!context.isAnyColumnUsed({"disk_bytes_read", "disk_bytes_written"})) {
+    results.push_back(r);
+    return;
+  }
+
+  // Parse the process io
+  SimpleProcIo proc_io(pid, buffer);
   if (!proc_io.status.ok()) {
     // /proc/<pid>/io can require root to access, so don't fail if we can't
     VLOG(1) << proc_io.status.getMessage();
@@ -543,9 +638,26 @@ TableRows genProcesses(QueryContext& context) {
   TableRows results;
   static const std::uint64_t system_boot_time = getBootTime();
 
+  // The status of each process is only read for the columns it reports.
+  auto read_status = context.isAnyColumnUsed({"name",
+                                              "uid",
+                                              "euid",
+                                              "suid",
+                                              "gid",
+                                              "egid",
+                                              "sgid",
+                                              "resident_size",
+                                              "total_size"});
+
+  // One buffer holds the attributes of each process in turn.
+  std::string buffer;
   auto pidlist = getProcList(context);
   for (const auto& pid : pidlist) {
-    genProcess(pid, system_boot_time, context, results);
+    if (context.limit && results.size() >= *context.limit) {
+      // The query does not read more rows.
+      break;
+    }
+    genProcess(pid, system_boot_time, context, read_status, buffer, results);
   }
 
   return results;
@@ -562,12 +674,123 @@ QueryData genProcessEnvs(QueryContext& context) {
   return results;
 }
 
-QueryData genProcessMemoryMap(QueryContext& context) {
+namespace {
+
+/// The process_memory_map columns a query uses.
+struct ProcMapColumns {
+  explicit ProcMapColumns(const QueryContext& context)
+      : start(context.isColumnUsed("start")),
+        end(context.isColumnUsed("end")),
+        permissions(context.isColumnUsed("permissions")),
+        offset(context.isColumnUsed("offset")),
+        device(context.isColumnUsed("device")),
+        inode(context.isColumnUsed("inode")),
+        path(context.isColumnUsed("path")),
+        pseudo(context.isColumnUsed("pseudo")) {}
+
+  bool start;
+  bool end;
+  bool permissions;
+  bool offset;
+  bool device;
+  bool inode;
+  bool path;
+  bool pseudo;
+};
+
+void genProcessMap(const std::string& pid,
+                   const ProcMapColumns& columns,
+                   std::string& buffer,
+                   RowYield& yield) {
+  // Each mapping is yielded as it is read, a map is never held whole.
+  proc::readAttrLines(pid, "maps", buffer, [&](std::string_view line) {
+    ProcMapEntry entry;
+    if (!parseProcMapLine(line, entry)) {
+      return true;
+    }
+
+    Row r;
+    r["pid"] = pid;
+    if (columns.start) {
+      r["start"] = "0x" + std::string(entry.start);
+    }
+    if (columns.end) {
+      r["end"] = "0x" + std::string(entry.end);
+    }
+    if (columns.permissions) {
+      r["permissions"] = std::string(entry.permissions);
+    }
+    if (columns.offset) {
+      auto offset = tryTo<long long>(entry.offset, 16);
+      r["offset"] = BIGINT((offset) ? offset.take() : -1);
+    }
+    if (columns.device) {
+      r["device"] = std::string(entry.device);
+    }
+    if (columns.inode) {
+      r["inode"] = std::string(entry.inode);
+    }
+    if (columns.path) {
+      r["path"] = std::string(entry.path);
+    }
+    if (columns.pseudo) {
+      // BSS with name in pathname.
+      r["pseudo"] = (entry.inode == "0" && !entry.path.empty()) ? "1" : "0";
+    }
+    yield(TableRowHolder(new DynamicTableRow(std::move(r))));
+    return true;
+  });
+}
+
+} // namespace
+
+void genProcessMemoryMap(RowYield& yield, QueryContext& context) {
+  ProcMapColumns columns(context);
+  std::string buffer;
+  auto pidlist = getProcList(context);
+  for (const auto& pid : pidlist) {
+    genProcessMap(pid, columns, buffer, yield);
+  }
+}
+
+QueryData genProcessMemorySummary(QueryContext& context) {
   QueryData results;
 
+  auto count_mappings = context.isColumnUsed("mappings");
+  std::string buffer;
   auto pidlist = getProcList(context);
   for (const auto& pid : pidlist) {
-    genProcessMap(pid, results);
+    std::map<std::string, uint64_t> totals;
+    auto add = [&totals](std::string_view line) {
+      addProcSmapsLine(line, totals);
+      return true;
+    };
+
+    // The kernel sums the mappings into smaps_rollup since Linux 4.14.
+    auto rollup = proc::readAttrLines(pid, "smaps_rollup", buffer, add);
+    if (!rollup) {
+      totals.clear();
+      if (!proc::readAttrLines(pid, "smaps", buffer, add)) {
+        continue;
+      }
+    }
+
+    Row r;
+    r["pid"] = pid;
+    for (const auto& column : kProcSmapsColumns) {
+      r[column.second] = BIGINT(totals[column.second]);
+    }
+    r["source"] = rollup ? "smaps_rollup" : "smaps";
+
+    if (count_mappings) {
+      uint64_t mappings = 0;
+      proc::readAttrLines(pid, "maps", buffer, [&mappings](std::string_view) {
+        ++mappings;
+        return true;
+      });
+      r["mappings"] = BIGINT(mappings);
+    }
+    results.push_back(std::move(r));
   }
 
   return results;
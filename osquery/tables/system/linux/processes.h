@@ -7,8 +7,40 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+
 namespace osquery {
 namespace tables {
 std::string parseProcCGroup(const std::string& content);
+
+/// The fields of a /proc/<pid>/maps line, viewing the line.
+struct ProcMapEntry {
+  std::string_view start;
+  std::string_view end;
+  std::string_view permissions;
+  std::string_view offset;
+  std::string_view device;
+  std::string_view inode;
+
+  /// The trimmed path, it may contain spaces or be empty.
+  std::string_view path;
+};
+
+/// Split a /proc/<pid>/maps line, returns false for a malformed line.
+bool parseProcMapLine(std::string_view line, ProcMapEntry& entry);
+
+/**
+ * @brief Add the sizes of a /proc/<pid>/smaps or smaps_rollup line.
+ *
+ * The sizes are added in bytes to the total of their process_memory_summary
+ * column, other lines are ignored.
+ */
+void addProcSmapsLine(std::string_view line,
+                      std::map<std::string, uint64_t>& totals);
 } // namespace tables
 } // namespace osquery
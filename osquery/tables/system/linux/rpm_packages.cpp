@@ -22,6 +22,7 @@
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
 #include <osquery/sql/dynamic_table_row.h>
+#include <osquery/tables/system/package_cache.h>
 #include <osquery/worker/ipc/platform_table_container_ipc.h>
 #include <osquery/worker/logging/glog/glog_logger.h>
 
@@ -39,6 +40,9 @@ namespace tables {
 // Maximum number of files per RPM.
 #define MAX_RPM_FILES (64 * 1024)
 
+/// The RPM database, its files change with every transaction.
+const std::string kRpmDatabasePath{"/var/lib/rpm"};
+
 /**
  * @brief Return a string representation of the RPM tag type.
  *
@@ -146,8 +150,10 @@ QueryData genRpmPackagesImpl(QueryContext& context, Logger& logger) {
 
   rpmts ts = rpmtsCreate();
   rpmdbMatchIterator matches;
-  if (context.constraints["name"].exists(EQUALS)) {
-    auto name = (*context.constraints["name"].getAll(EQUALS).begin());
+  auto names = context.constraints["name"].getAll(EQUALS);
+  if (names.size() == 1) {
+    // The database is only indexed for a single name, an IN list is scanned.
+    const auto& name = *names.begin();
     matches = rpmtsInitIterator(ts, RPMTAG_NAME, name.c_str(), name.size());
   } else {
     matches = rpmtsInitIterator(ts, RPMTAG_NAME, nullptr, 0);
@@ -188,7 +194,13 @@ QueryData genRpmPackages(QueryContext& context) {
     return generateInNamespace(context, "rpm_packages", genRpmPackagesImpl);
   } else {
     GLOGLogger logger;
-    return genRpmPackagesImpl(context, logger);
+    if (context.constraints["name"].exists(EQUALS)) {
+      return genRpmPackagesImpl(context, logger);
+    }
+
+    return genCachedPackages("rpm_packages", {kRpmDatabasePath}, [&]() {
+      return genRpmPackagesImpl(context, logger);
+    });
   }
 }
 
@@ -211,8 +223,10 @@ void genRpmPackageFiles(RowYield& yield, QueryContext& context) {
 
   rpmts ts = rpmtsCreate();
   rpmdbMatchIterator matches;
-  if (context.constraints["package"].exists(EQUALS)) {
-    auto name = (*context.constraints["package"].getAll(EQUALS).begin());
+  auto names = context.constraints["package"].getAll(EQUALS);
+  if (names.size() == 1) {
+    // The database is only indexed for a single name, an IN list is scanned.
+    const auto& name = *names.begin();
     matches = rpmtsInitIterator(ts, RPMTAG_NAME, name.c_str(), name.size());
   } else {
     matches = rpmtsInitIterator(ts, RPMTAG_NAME, nullptr, 0);
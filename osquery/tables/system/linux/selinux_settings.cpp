@@ -29,7 +29,7 @@ Status getSelinuxfsMountPath(std::string& path) {
   path = {};
 
   MountedFilesystems mounted_fs{};
-  auto status = getMountedFilesystems(mounted_fs);
+  auto status = getMountedFilesystems(mounted_fs, false);
   if (!status.ok()) {
     return status;
   }
@@ -62,19 +62,17 @@ const std::vector<std::string> kRootKeyList = {"checkreqprot",
 const std::vector<std::string> kScopeList = {
     "booleans", "policy_capabilities", "initial_contexts"};
 
-Status generateScopeKey(Row& row,
+Status generateScopeRow(Row& row,
                         const std::string& scope,
-                        const std::string& selinuxfs_path,
-                        const std::string& key) {
+                        const std::string& key,
+                        const std::string& path,
+                        Status status,
+                        std::string raw_value) {
   row = {};
 
   row["scope"] = scope;
   row["key"] = key;
 
-  auto path = selinuxfs_path + "/" + scope + "/" + key;
-
-  std::string raw_value;
-  auto status = readFile(path, raw_value);
   if (!status.ok()) {
     return Status::failure("Failed to retrieve SELinux key value: " + path +
                            ". Error: " + status.getMessage());
@@ -96,6 +94,18 @@ Status generateScopeKey(Row& row,
   return Status::success();
 }
 
+Status generateScopeKey(Row& row,
+                        const std::string& scope,
+                        const std::string& selinuxfs_path,
+                        const std::string& key) {
+  auto path = selinuxfs_path + "/" + scope + "/" + key;
+
+  std::string raw_value;
+  auto status = readFile(path, raw_value);
+  return generateScopeRow(
+      row, scope, key, path, status, std::move(raw_value));
+}
+
 Status generateScope(QueryData& row_list,
                      const std::string& selinuxfs_path,
                      const std::string& scope) {
@@ -108,6 +118,9 @@ Status generateScope(QueryData& row_list,
                            scope_directory_path + "': " + status.getMessage());
   }
 
+  // A scope may have hundreds of keys, their values are read together.
+  std::vector<std::string> key_list;
+  std::vector<BatchFileRead> files;
   for (const auto& path : path_list) {
     if (isDirectory(path).ok()) {
       continue;
@@ -121,8 +134,22 @@ Status generateScope(QueryData& row_list,
       continue;
     }
 
+    BatchFileRead file;
+    file.path = scope_directory_path + "/" + key_name;
+    files.push_back(std::move(file));
+    key_list.push_back(std::move(key_name));
+  }
+
+  readFileBatch(files);
+
+  for (size_t i = 0; i < files.size(); i++) {
     Row row;
-    status = generateScopeKey(row, scope, selinuxfs_path, key_name);
+    status = generateScopeRow(row,
+                              scope,
+                              key_list[i],
+                              files[i].path,
+                              files[i].status,
+                              std::move(files[i].content));
     if (!status.ok()) {
       LOG(ERROR) << status.getMessage();
       continue;
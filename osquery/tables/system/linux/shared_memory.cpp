@@ -8,12 +8,12 @@
  */
 
 #include <sys/shm.h>
-#include <pwd.h>
 
 #include <osquery/core/core.h>
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
+#include <osquery/system/usersgroups/posix/names_cache.h>
 
 namespace osquery {
 namespace tables {
@@ -52,14 +52,14 @@ QueryData genSharedMemory(QueryContext &context) {
     Row r;
     r["shmid"] = INTEGER(shmid);
 
-    struct passwd *pw = getpwuid(shmseg.shm_perm.uid);
-    if (pw != nullptr) {
-      r["owner_uid"] = BIGINT(pw->pw_uid);
+    // Only uids of known users are reported.
+    std::string username;
+    if (getCachedUsername(shmseg.shm_perm.uid, username)) {
+      r["owner_uid"] = BIGINT(shmseg.shm_perm.uid);
     }
 
-    pw = getpwuid(shmseg.shm_perm.cuid);
-    if (pw != nullptr) {
-      r["creator_uid"] = BIGINT(pw->pw_uid);
+    if (getCachedUsername(shmseg.shm_perm.cuid, username)) {
+      r["creator_uid"] = BIGINT(shmseg.shm_perm.cuid);
     }
 
     // Accessor, creator pids.
@@ -24,46 +24,65 @@ namespace tables {
 
 const std::string kSystemControlPath = "/proc/sys/";
 
-void genControlInfo(const std::string& mib_path,
-                    QueryData& results,
-                    const std::map<std::string, std::string>& config) {
+/// Find the controls at a path, the files within its directories.
+void findControls(const std::string& mib_path,
+                  std::vector<BatchFileRead>& controls) {
   if (isDirectory(mib_path).ok()) {
     // Iterate through the subitems and items.
     std::vector<std::string> items;
     if (listDirectoriesInDirectory(mib_path, items).ok()) {
       for (const auto& item : items) {
-        genControlInfo(item, results, config);
+        findControls(item, controls);
       }
     }
 
     if (listFilesInDirectory(mib_path, items).ok()) {
       for (const auto& item : items) {
-        genControlInfo(item, results, config);
+        findControls(item, controls);
       }
     }
     return;
   }
 
   // This is a file (leaf-control).
-  Row r;
-  r["name"] = mib_path.substr(kSystemControlPath.size());
+  BatchFileRead control;
+  control.path = mib_path;
+  controls.push_back(std::move(control));
+}
 
-  std::replace(r["name"].begin(), r["name"].end(), '/', '.');
-  // No known way to convert name MIB to int array.
-  r["subsystem"] = osquery::split(r.at("name"), ".")[0];
+void genControlRows(std::vector<BatchFileRead>& controls,
+                    QueryData& results,
+                    const std::map<std::string, std::string>& config) {
+  // The controls are thousands of small values, they are read together.
+  readFileBatch(controls);
 
-  if (isReadable(mib_path).ok()) {
-    std::string content;
-    readFile(mib_path, content);
-    boost::trim(content);
-    r["current_value"] = content;
-  }
+  for (auto& control : controls) {
+    Row r;
+    r["name"] = control.path.substr(kSystemControlPath.size());
 
-  if (config.count(r.at("name")) > 0) {
-    r["config_value"] = config.at(r.at("name"));
+    std::replace(r["name"].begin(), r["name"].end(), '/', '.');
+    // No known way to convert name MIB to int array.
+    r["subsystem"] = osquery::split(r.at("name"), ".")[0];
+
+    if (control.status.ok()) {
+      boost::trim(control.content);
+      r["current_value"] = std::move(control.content);
+    }
+
+    if (config.count(r.at("name")) > 0) {
+      r["config_value"] = config.at(r.at("name"));
+    }
+    r["type"] = "string";
+    results.push_back(r);
   }
-  r["type"] = "string";
-  results.push_back(r);
+}
+
+void genControlInfo(const std::string& mib_path,
+                    QueryData& results,
+                    const std::map<std::string, std::string>& config) {
+  std::vector<BatchFileRead> controls;
+  findControls(mib_path, controls);
+  genControlRows(controls, results, config);
 }
 
 void genControlInfo(int* oid,
@@ -95,14 +114,16 @@ void genAllControls(QueryData& results,
     return;
   }
 
+  std::vector<BatchFileRead> controls;
   for (const auto& sub : subsystems) {
     if (subsystem.size() != 0 &&
         fs::path(sub).filename().string() != subsystem) {
       // Request is limiting subsystem.
       continue;
     }
-    genControlInfo(sub, results, config);
+    findControls(sub, controls);
   }
+  genControlRows(controls, results, config);
 }
 
 void genControlInfoFromName(const std::string& name,
@@ -7,8 +7,11 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <boost/algorithm/string/predicate.hpp>
+
 #include <osquery/core/tables.h>
 #include <osquery/sql/dynamic_table_row.h>
+#include <osquery/tables/system/linux/dbus/dbusconnectionmanager.h>
 #include <osquery/tables/system/linux/dbus/methods/getstringproperty.h>
 #include <osquery/tables/system/linux/dbus/methods/listunitsmethodhandler.h>
 
@@ -17,6 +20,8 @@ namespace osquery {
 namespace tables {
 
 namespace {
+const std::string kSystemdObjectPath{"/org/freedesktop/systemd1"};
+
 struct PropertyQueryDesc final {
   std::string property_name;
   std::string column_name;
@@ -29,33 +34,52 @@ const std::vector<PropertyQueryDesc> kStringPropertyQueryList = {
     {"User", "user", "org.freedesktop.systemd1.Service"},
     {"UnitFileState", "unit_file_state", "org.freedesktop.systemd1.Unit"},
 };
-} // namespace
 
-TableRows genSystemdUnits(QueryContext& context) {
-  UniqueDbusConnection connection;
-  auto status = UniqueDbusConnection::create(connection, true);
-  if (!status.ok()) {
-    LOG(ERROR) << "Failed to generate the systemd unit list: "
-               << status.getMessage();
-    return {};
+const std::string kServiceInterface{"org.freedesktop.systemd1.Service"};
+
+Status listSystemdUnits(ListUnitsMethod::Output& unit_list,
+                        QueryContext& context,
+                        const UniqueDbusConnection& connection) {
+  // Units requested by id are listed by systemd directly
+  if (context.hasConstraint("id", EQUALS)) {
+    auto id_list = context.constraints["id"].getAll(EQUALS);
+    std::vector<std::string> pattern_list(id_list.begin(), id_list.end());
+
+    ListUnitsByPatternsMethod list_units_by_patterns_method;
+    auto status = list_units_by_patterns_method.call(
+        unit_list, connection, kSystemdObjectPath, {}, pattern_list);
+
+    if (status.ok()) {
+      return status;
+    }
+
+    VLOG(1) << "Listing every systemd unit, the units could not be listed by "
+               "id: "
+            << status.getMessage();
   }
 
-  ListUnitsMethod::Output unit_list;
   ListUnitsMethod list_units_method;
-  status = list_units_method.call(
-      unit_list, connection, "/org/freedesktop/systemd1");
+  return list_units_method.call(unit_list, connection, kSystemdObjectPath);
+}
 
+Status generateSystemdUnits(TableRows& results,
+                            QueryContext& context,
+                            const UniqueDbusConnection& connection) {
+  ListUnitsMethod::Output unit_list;
+  auto status = listSystemdUnits(unit_list, context, connection);
   if (!status.ok()) {
-    LOG(ERROR) << "Failed to generate the systemd unit list: "
-               << status.getMessage();
-    return {};
+    return status;
   }
 
-  TableRows results;
+  // The properties of every unit are requested as one pipelined batch
+  std::vector<GetStringPropertyMethod::Call> call_list;
+  std::vector<std::pair<std::size_t, const PropertyQueryDesc*>> call_targets;
+  std::vector<DynamicTableRowHolder> row_list;
 
-  for (const auto& unit : unit_list) {
-    auto row = make_table_row();
+  for (std::size_t i{0U}; i < unit_list.size(); ++i) {
+    const auto& unit = unit_list[i];
 
+    auto row = make_table_row();
     row["id"] = SQL_TEXT(unit.id);
     row["description"] = SQL_TEXT(unit.description);
     row["load_state"] = SQL_TEXT(unit.load_state);
@@ -68,25 +92,64 @@ TableRows genSystemdUnits(QueryContext& context) {
     row["job_path"] = SQL_TEXT(unit.job_path);
 
     for (const auto& query : kStringPropertyQueryList) {
-      std::string property_value;
-      GetStringPropertyMethod get_string_property_method;
-      status = get_string_property_method.call(property_value,
-                                               connection,
-                                               unit.path,
-                                               query.interface,
-                                               query.property_name);
-
-      if (!status.ok() && query.property_name != "User") {
+      row[query.column_name] = SQL_TEXT("");
+
+      // Only services implement the service interface
+      if (query.interface == kServiceInterface &&
+          !boost::algorithm::ends_with(unit.id, ".service")) {
+        continue;
+      }
+
+      call_list.emplace_back(unit.path, query.interface, query.property_name);
+      call_targets.emplace_back(i, &query);
+    }
+
+    row_list.push_back(std::move(row));
+  }
+
+  std::vector<std::string> property_list;
+  GetStringPropertyMethod get_string_property_method;
+  auto status_list = get_string_property_method.callPipelined(
+      property_list, connection, call_list);
+
+  for (std::size_t i{0U}; i < call_targets.size(); ++i) {
+    const auto& unit = unit_list[call_targets[i].first];
+    const auto& query = *call_targets[i].second;
+
+    if (!status_list[i].ok()) {
+      if (query.property_name != "User") {
         LOG(ERROR) << "Failed to query the property " << query.property_name
                    << " on the following systemd unit: " << unit.path;
       }
 
-      row[query.column_name] = SQL_TEXT(property_value);
+      continue;
     }
 
+    auto& row = row_list[call_targets[i].first];
+    row[query.column_name] = SQL_TEXT(property_list[i]);
+  }
+
+  for (auto& row : row_list) {
     results.push_back(std::move(row));
   }
 
+  return Status::success();
+}
+} // namespace
+
+TableRows genSystemdUnits(QueryContext& context) {
+  TableRows results;
+  auto status = DbusConnectionManager::get().run(
+      [&results, &context](const UniqueDbusConnection& connection) {
+        return generateSystemdUnits(results, context, connection);
+      });
+
+  if (!status.ok()) {
+    LOG(ERROR) << "Failed to generate the systemd unit list: "
+               << status.getMessage();
+    return {};
+  }
+
   return results;
 }
 
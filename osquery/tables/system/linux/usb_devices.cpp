@@ -12,6 +12,7 @@
 #include <osquery/logger/logger.h>
 
 #include <osquery/events/linux/udev.h>
+#include <osquery/filesystem/linux/sysfs.h>
 #include <osquery/utils/conversions/split.h>
 
 namespace osquery {
@@ -85,7 +86,10 @@ QueryData genUSBDevices(QueryContext &context) {
     r["usb_port"] = UdevEventPublisher::getValue(device, kUSBKeyPort);
 
     // Removable detection.
-    auto removable = UdevEventPublisher::getAttr(device, "removable");
+    std::string removable;
+    readSysfsAttribute(std::string(udev_device_get_syspath(device)) +
+                           "/removable",
+                       removable);
     if (removable == "unknown") {
       r["removable"] = "-1";
     } else {
@@ -15,6 +15,7 @@
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
+#include <osquery/tables/system/package_cache.h>
 #include <osquery/utils/info/platform_type.h>
 #include <osquery/utils/json/json.h>
 #include <osquery/worker/ipc/platform_table_container_ipc.h>
@@ -139,20 +140,31 @@ void genWinNodePackages(const std::string& keyGlob,
 #endif
 }
 
+/// The site directories of the default search paths.
+std::set<std::string> getDefaultNodeSites() {
+  std::set<std::string> paths;
+  for (const auto& path : kNodeModulesPath) {
+    std::vector<std::string> sites;
+    resolveFilePattern(path, sites);
+    for (const auto& site : sites) {
+      paths.insert(site);
+    }
+  }
+  return paths;
+}
+
+inline bool hasDirectoryConstraint(QueryContext& context) {
+  return context.constraints.count("directory") > 0 &&
+         context.constraints.at("directory").exists(EQUALS);
+}
+
 QueryData genNodePackagesImpl(QueryContext& context, Logger& logger) {
   QueryData results;
   std::set<std::string> paths;
-  if (context.constraints.count("directory") > 0 &&
-      context.constraints.at("directory").exists(EQUALS)) {
+  if (hasDirectoryConstraint(context)) {
     paths = context.constraints["directory"].getAll(EQUALS);
   } else {
-    for (const auto& path : kNodeModulesPath) {
-      std::vector<std::string> sites;
-      resolveFilePattern(path, sites);
-      for (const auto& site : sites) {
-        paths.insert(site);
-      }
-    }
+    paths = getDefaultNodeSites();
     if (isPlatform(PlatformType::TYPE_WINDOWS)) {
       // Enumerate any system installed npm packages
       auto installPathKey = "HKEY_LOCAL_MACHINE\\" + kWinNodeInstallKey;
@@ -175,7 +187,21 @@ QueryData genNodePackages(QueryContext& context) {
     return generateInNamespace(context, "npm_packages", genNodePackagesImpl);
   } else {
     GLOGLogger logger;
-    return genNodePackagesImpl(context, logger);
+    // Windows installations are found in the registry, they are not cached.
+    if (hasDirectoryConstraint(context) ||
+        isPlatform(PlatformType::TYPE_WINDOWS)) {
+      return genNodePackagesImpl(context, logger);
+    }
+
+    // Packages are directories within each site's node_modules.
+    std::vector<std::string> sources;
+    for (const auto& site : getDefaultNodeSites()) {
+      sources.push_back(site + "/node_modules");
+    }
+
+    return genCachedPackages("npm_packages", sources, [&]() {
+      return genNodePackagesImpl(context, logger);
+    });
   }
 }
 } // namespace tables
@@ -0,0 +1,135 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <map>
+
+#ifndef WIN32
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+#include <osquery/core/flags.h>
+#include <osquery/tables/system/package_cache.h>
+#include <osquery/utils/mutex.h>
+
+namespace osquery {
+
+FLAG(bool,
+     package_inventory_cache,
+     true,
+     "Reuse package inventories while their databases are unchanged");
+
+namespace tables {
+
+namespace {
+
+/// The rows of a package inventory and the fingerprint of their sources.
+struct CachedPackages {
+  std::string fingerprint;
+  QueryData rows;
+};
+
+/// The last inventory of each key.
+struct PackageCache {
+  Mutex mutex;
+  std::map<std::string, CachedPackages> entries;
+};
+
+PackageCache& getPackageCache() {
+  static PackageCache cache;
+  return cache;
+}
+
+#ifndef WIN32
+void addFingerprint(const std::string& name,
+                    const struct stat& st,
+                    std::string& fingerprint) {
+  fingerprint += name + ":" + std::to_string(st.st_ino) + ":" +
+                 std::to_string(st.st_size) + ":" +
+                 std::to_string(st.st_mtime) + "\n";
+}
+#endif
+} // namespace
+
+std::string fingerprintPackageSources(const std::vector<std::string>& sources) {
+#ifdef WIN32
+  return "";
+#else
+  std::string fingerprint;
+  for (const auto& source : sources) {
+    struct stat st;
+    if (stat(source.c_str(), &st) != 0) {
+      // A missing source may be created, it is part of the fingerprint.
+      fingerprint += source + ":missing\n";
+      continue;
+    }
+
+    addFingerprint(source, st, fingerprint);
+    if (!S_ISDIR(st.st_mode)) {
+      continue;
+    }
+
+    auto dir = opendir(source.c_str());
+    if (dir == nullptr) {
+      continue;
+    }
+
+    // Entries are listed in directory order, stable while it is unchanged.
+    struct dirent* entry = nullptr;
+    while ((entry = readdir(dir)) != nullptr) {
+      std::string name = entry->d_name;
+      if (name == "." || name == "..") {
+        continue;
+      }
+
+      if (fstatat(dirfd(dir), entry->d_name, &st, 0) == 0) {
+        addFingerprint(name, st, fingerprint);
+      }
+    }
+    closedir(dir);
+  }
+  return fingerprint;
+#endif
+}
+
+QueryData genCachedPackages(const std::string& key,
+                            const std::vector<std::string>& sources,
+                            const std::function<QueryData()>& generate) {
+  if (!FLAGS_package_inventory_cache) {
+    return generate();
+  }
+
+  auto fingerprint = fingerprintPackageSources(sources);
+  if (fingerprint.empty()) {
+    return generate();
+  }
+
+  auto& cache = getPackageCache();
+  {
+    ReadLock lock(cache.mutex);
+    auto it = cache.entries.find(key);
+    if (it != cache.entries.end() && it->second.fingerprint == fingerprint) {
+      return it->second.rows;
+    }
+  }
+
+  auto rows = generate();
+
+  // The sources may have changed while generating, the rows are then newer
+  // than the fingerprint and are generated again by the next query.
+  if (fingerprintPackageSources(sources) == fingerprint) {
+    WriteLock lock(cache.mutex);
+    cache.entries[key] = {std::move(fingerprint), rows};
+  }
+  return rows;
+}
+
+} // namespace tables
+} // namespace osquery
@@ -0,0 +1,50 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <osquery/core/tables.h>
+
+namespace osquery {
+namespace tables {
+
+/**
+ * @brief The fingerprint of the files a package inventory is read from.
+ *
+ * Each source contributes its path, inode, size and mtime, the entries of a
+ * directory source contribute theirs too, one level deep. Installing,
+ * removing or upgrading a package changes the database files or the entries
+ * of the package directories.
+ *
+ * @return An empty string where files cannot be fingerprinted.
+ */
+std::string fingerprintPackageSources(const std::vector<std::string>& sources);
+
+/**
+ * @brief Generate a package inventory, reused while its sources are unchanged.
+ *
+ * The rows generated last are kept by key with the fingerprint of the
+ * sources, the key must identify everything the rows depend on. Package sets
+ * rarely change, so most scheduled queries return the same rows in the same
+ * order, and the differential finds them unchanged without sorting.
+ *
+ * @param key the table and any constraint the rows depend on.
+ * @param sources the package databases and directories.
+ * @param generate generates the inventory when the sources changed.
+ */
+QueryData genCachedPackages(const std::string& key,
+                            const std::vector<std::string>& sources,
+                            const std::function<QueryData()>& generate);
+
+} // namespace tables
+} // namespace osquery
@@ -15,6 +15,7 @@
 
 #include <osquery/tables/system/posix/authorized_keys.h>
 #include <osquery/tables/system/system_utils.h>
+#include <osquery/tables/system/user_scan.h>
 #include <osquery/utils/conversions/join.h>
 #include <osquery/utils/conversions/split.h>
 #include <osquery/utils/system/system.h>
@@ -88,6 +89,55 @@ void GenerateKeyRow(const std::string& line,
   results.push_back(r);
 }
 
+/// Parse the keys of an authorized keys file.
+void genSSHkeysFromContent(const std::string& uid,
+                           const std::string& keys_file,
+                           const std::string& keys_content,
+                           QueryData& results) {
+  // Protocol 1 public key consist of: options, bits, exponent, modulus,
+  // comment; Protocol 2 public key consist of: options, keytype,
+  // base64-encoded key, comment.
+  for (const auto& line : split(keys_content, "\n")) {
+    if (!line.empty() && line[0] != '#') {
+      bool key_type_found = false;
+      // Iterate over known key types.
+      for (const auto& key_type : kSSHKeyTypes) {
+        auto key_type_start_pos = line.find(key_type);
+        if (key_type_start_pos == std::string::npos) {
+          continue;
+        }
+
+        auto key_type_end_pos = key_type_start_pos + key_type.length();
+        // Make sure key type is fully matched.
+        if (line[key_type_end_pos] != ' ' && line[key_type_end_pos] != '\t') {
+          continue;
+        }
+
+        GenerateKeyRow(line,
+                       key_type,
+                       uid,
+                       keys_file,
+                       key_type_start_pos,
+                       results);
+
+        key_type_found = true;
+        break;
+      }
+
+      // If key type can't be found and options are supplied,
+      // Check the existence of the 'zos-key-ring-label' parameter in the
+      // options section. If so, only options should be set in current row.
+      if (!key_type_found && KeyRingLabelOptExists(line)) {
+        Row r = {{"uid", uid},
+                 {"options", line},
+                 {"key_file", keys_file},
+                 {"pid_with_namespace", "0"}};
+        results.push_back(r);
+      }
+    }
+  }
+}
+
 void genSSHkeysForUser(const std::string& uid,
                        const std::string& gid,
                        const std::string& directory,
@@ -97,79 +147,46 @@ void genSSHkeysForUser(const std::string& uid,
     boost::filesystem::path keys_file = directory;
     keys_file /= kfile;
 
-    std::string keys_content;
-
     if (!pathExists(keys_file).ok()) {
       // no authorized key file present, keep going
       continue;
     }
 
-    auto s = readFile(keys_file, keys_content, false, false, false);
+    auto s = genCachedUserFile(
+        "authorized_keys:" + uid,
+        keys_file.string(),
+        [&uid, &keys_file](QueryData& rows) {
+          std::string keys_content;
+          auto s = readFile(keys_file, keys_content, false, false, false);
+          if (s.ok()) {
+            genSSHkeysFromContent(uid, keys_file.string(), keys_content, rows);
+          }
+          return s;
+        },
+        results);
     if (!s.ok()) {
       // Cannot read a specific keys file.
       logger.log(google::GLOG_ERROR, s.getMessage());
       return;
     }
-
-    // Protocol 1 public key consist of: options, bits, exponent, modulus,
-    // comment; Protocol 2 public key consist of: options, keytype,
-    // base64-encoded key, comment.
-    for (const auto& line : split(keys_content, "\n")) {
-      if (!line.empty() && line[0] != '#') {
-        bool key_type_found = false;
-        // Iterate over known key types.
-        for (const auto& key_type : kSSHKeyTypes) {
-          auto key_type_start_pos = line.find(key_type);
-          if (key_type_start_pos == std::string::npos) {
-            continue;
-          }
-
-          auto key_type_end_pos = key_type_start_pos + key_type.length();
-          // Make sure key type is fully matched.
-          if (line[key_type_end_pos] != ' ' && line[key_type_end_pos] != '\t') {
-            continue;
-          }
-
-          GenerateKeyRow(line,
-                         key_type,
-                         uid,
-                         keys_file.string(),
-                         key_type_start_pos,
-                         results);
-
-          key_type_found = true;
-          break;
-        }
-
-        // If key type can't be found and options are supplied,
-        // Check the existence of the 'zos-key-ring-label' parameter in the
-        // options section. If so, only options should be set in current row.
-        if (!key_type_found && KeyRingLabelOptExists(line)) {
-          Row r = {{"uid", uid},
-                   {"options", line},
-                   {"key_file", keys_file.string()},
-                   {"pid_with_namespace", "0"}};
-          results.push_back(r);
-        }
-      }
-    }
   }
 }
 
 QueryData getAuthorizedKeysImpl(QueryContext& context, Logger& logger) {
   QueryData results;
+  UserScanLogger user_logger(logger);
 
-  // Iterate over each user
-  QueryData users = usersFromContext(context);
-  for (const auto& row : users) {
+  // Scan each user
+  auto scan = [&user_logger](const Row& row, QueryData& rows) {
     auto uid = row.find("uid");
     auto gid = row.find("gid");
     auto directory = row.find("directory");
     if (uid != row.end() && gid != row.end() && directory != row.end()) {
       genSSHkeysForUser(
-          uid->second, gid->second, directory->second, results, logger);
+          uid->second, gid->second, directory->second, rows, user_logger);
     }
-  }
+  };
+  scanUsers(usersFromContext(context), scan, results);
 
   return results;
 }
@@ -16,6 +16,7 @@
 #include <osquery/logger/logger.h>
 #include <osquery/tables/system/posix/known_hosts.h>
 #include <osquery/tables/system/system_utils.h>
+#include <osquery/tables/system/user_scan.h>
 #include <osquery/utils/conversions/split.h>
 #include <osquery/utils/system/system.h>
 
@@ -34,18 +35,27 @@ void genSSHkeysForHosts(const std::string& uid,
     boost::filesystem::path keys_file = directory;
     keys_file /= kfile;
 
-    std::string keys_content;
-    if (!readFile(keys_file, keys_content).ok()) {
-      // Cannot read a specific keys file.
-      continue;
-    }
+    // A file that cannot be read has no keys.
+    genCachedUserFile(
+        "known_hosts:" + uid,
+        keys_file.string(),
+        [&uid, &keys_file](QueryData& rows) {
+          std::string keys_content;
+          auto s = readFile(keys_file, keys_content);
+          if (!s.ok()) {
+            return s;
+          }
 
-    for (const auto& line : split(keys_content, "\n")) {
-      if (!line.empty() && line[0] != '#') {
-        Row r = {{"uid", uid}, {"key", line}, {"key_file", keys_file.string()}};
-        results.push_back(r);
-      }
-    }
+          for (const auto& line : split(keys_content, "\n")) {
+            if (!line.empty() && line[0] != '#') {
+              rows.push_back({{"uid", uid},
+                              {"key", line},
+                              {"key_file", keys_file.string()}});
+            }
+          }
+          return Status::success();
+        },
+        results);
   }
 }
 
@@ -54,17 +64,17 @@ void genSSHkeysForHosts(const std::string& uid,
 QueryData getKnownHostsKeys(QueryContext& context) {
   QueryData results;
 
-  // Iterate over each user
-  auto users = usersFromContext(context);
-  for (const auto& row : users) {
+  // Scan each user
+  auto scan = [](const Row& row, QueryData& rows) {
     auto uid = row.find("uid");
     auto gid = row.find("gid");
     auto directory = row.find("directory");
     if (uid != row.end() && gid != row.end() && directory != row.end()) {
       impl::genSSHkeysForHosts(
-          uid->second, gid->second, directory->second, results);
+          uid->second, gid->second, directory->second, rows);
     }
-  }
+  };
+  scanUsers(usersFromContext(context), scan, results);
 
   return results;
 }
@@ -7,8 +7,6 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
-#include <pwd.h>
-#include <grp.h>
 #include <sys/stat.h>
 
 #include <sstream>
@@ -18,6 +16,7 @@
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
+#include <osquery/system/usersgroups/posix/names_cache.h>
 #include <osquery/worker/ipc/platform_table_container_ipc.h>
 #include <osquery/worker/logging/glog/glog_logger.h>
 
@@ -41,21 +40,15 @@ Status genBin(const fs::path& path, int perms, QueryData& results) {
   // store path
   Row r;
   r["path"] = path.string();
-  struct passwd* pw = getpwuid(info.st_uid);
-  struct group* gr = getgrgid(info.st_gid);
 
-  // get user name + group
+  // get user name + group, most binaries share a few owners
   std::string user;
-  if (pw != nullptr) {
-    user = std::string(pw->pw_name);
-  } else {
+  if (!getCachedUsername(info.st_uid, user)) {
     user = std::to_string(info.st_uid);
   }
 
   std::string group;
-  if (gr != nullptr) {
-    group = std::string(gr->gr_name);
-  } else {
+  if (!getCachedGroupname(info.st_gid, group)) {
     group = std::to_string(info.st_gid);
   }
 
@@ -15,6 +15,7 @@
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
+#include <osquery/tables/system/package_cache.h>
 #include <osquery/utils/conversions/split.h>
 #include <osquery/utils/info/platform_type.h>
 #include <osquery/worker/ipc/platform_table_container_ipc.h>
@@ -136,43 +137,62 @@ void genWinPythonPackages(const std::string& keyGlob,
 #endif
 }
 
+/// The site directories of the default search paths.
+std::set<std::string> getDefaultSites() {
+  std::set<std::string> paths;
+  for (const auto& path : kPythonPath) {
+    std::vector<std::string> sites;
+    resolveFilePattern(path, sites);
+    for (const auto& site : sites) {
+      paths.insert(site);
+    }
+  }
+  return paths;
+}
+
+/// The site directories of the macOS framework versions.
+std::vector<std::string> getDarwinSites() {
+  std::vector<std::string> paths;
+  for (const auto& dir : kDarwinPythonPath) {
+    std::vector<std::string> versions;
+    if (!listDirectoriesInDirectory(dir, versions, false).ok()) {
+      continue;
+    }
+
+    for (const auto& version : versions) {
+      // macOS will link older versions to 2.6.
+      auto version_path = fs::path(version).parent_path();
+      if (fs::is_symlink(symlink_status(version_path))) {
+        continue;
+      }
+
+      paths.push_back(version + "lib/python" +
+                      version_path.filename().string() + "/site-packages");
+    }
+  }
+  return paths;
+}
+
+inline bool hasDirectoryConstraint(QueryContext& context) {
+  return context.constraints.count("directory") > 0 &&
+         context.constraints.at("directory").exists(EQUALS);
+}
+
 QueryData genPythonPackagesImpl(QueryContext& context, Logger& logger) {
   QueryData results;
   std::set<std::string> paths;
-  if (context.constraints.count("directory") > 0 &&
-      context.constraints.at("directory").exists(EQUALS)) {
+  if (hasDirectoryConstraint(context)) {
     paths = context.constraints["directory"].getAll(EQUALS);
   } else {
-    for (const auto& path : kPythonPath) {
-      std::vector<std::string> sites;
-      resolveFilePattern(path, sites);
-      for (const auto& site : sites) {
-        paths.insert(site);
-      }
-    }
+    paths = getDefaultSites();
   }
   for (const auto& key : paths) {
     genSiteDirectories(key, results, logger);
   }
 
   if (isPlatform(PlatformType::TYPE_OSX)) {
-    for (const auto& dir : kDarwinPythonPath) {
-      std::vector<std::string> versions;
-      if (!listDirectoriesInDirectory(dir, versions, false).ok()) {
-        continue;
-      }
-
-      for (const auto& version : versions) {
-        // macOS will link older versions to 2.6.
-        auto version_path = fs::path(version).parent_path();
-        if (fs::is_symlink(symlink_status(version_path))) {
-          continue;
-        }
-
-        auto complete = version + "lib/python" +
-                        version_path.filename().string() + "/site-packages";
-        genSiteDirectories(complete, results, logger);
-      }
+    for (const auto& site : getDarwinSites()) {
+      genSiteDirectories(site, results, logger);
     }
   } else if (isPlatform(PlatformType::TYPE_WINDOWS)) {
     // Enumerate any system installed python packages
@@ -193,7 +213,26 @@ QueryData genPythonPackages(QueryContext& context) {
         context, "python_packages", genPythonPackagesImpl);
   } else {
     GLOGLogger logger;
-    return genPythonPackagesImpl(context, logger);
+    // Windows installations are found in the registry, they are not cached.
+    if (hasDirectoryConstraint(context) ||
+        isPlatform(PlatformType::TYPE_WINDOWS)) {
+      return genPythonPackagesImpl(context, logger);
+    }
+
+    // Packages are directories within the sites, a new framework version
+    // is a new directory of the framework paths.
+    auto sites = getDefaultSites();
+    std::vector<std::string> sources(sites.begin(), sites.end());
+    if (isPlatform(PlatformType::TYPE_OSX)) {
+      auto darwin_sites = getDarwinSites();
+      sources.insert(sources.end(), darwin_sites.begin(), darwin_sites.end());
+      sources.insert(
+          sources.end(), kDarwinPythonPath.begin(), kDarwinPythonPath.end());
+    }
+
+    return genCachedPackages("python_packages", sources, [&]() {
+      return genPythonPackagesImpl(context, logger);
+    });
   }
 }
 } // namespace tables
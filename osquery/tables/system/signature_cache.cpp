@@ -0,0 +1,189 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <cstdint>
+#include <mutex>
+
+#ifdef WIN32
+#include <osquery/utils/system/system.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include <osquery/core/flags.h>
+#include <osquery/core/sql/query_data.h>
+#include <osquery/database/database.h>
+#include <osquery/tables/system/signature_cache.h>
+#include <osquery/utils/conversions/tryto.h>
+#include <osquery/utils/system/time.h>
+#ifdef WIN32
+#include <osquery/utils/conversions/windows/strings.h>
+#endif
+
+namespace osquery {
+
+FLAG(uint64,
+     signature_cache_expiry,
+     0,
+     "Seconds a code signature result is reused while the file is unchanged "
+     "(0 = disabled)");
+
+namespace tables {
+
+namespace {
+
+/// The identity of a file, its content is unchanged while the version is.
+struct FileIdentity {
+  std::string key;
+  std::string version;
+};
+
+/// Identify a regular file, false if it cannot be or is not a regular file.
+bool getFileIdentity(const std::string& path, FileIdentity& identity) {
+#ifdef WIN32
+  auto handle = CreateFileW(stringToWstring(path).c_str(),
+                            FILE_READ_ATTRIBUTES,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE |
+                                FILE_SHARE_DELETE,
+                            nullptr,
+                            OPEN_EXISTING,
+                            FILE_FLAG_BACKUP_SEMANTICS,
+                            nullptr);
+  if (handle == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+
+  BY_HANDLE_FILE_INFORMATION info{};
+  auto found = GetFileInformationByHandle(handle, &info);
+  CloseHandle(handle);
+  if (!found || (info.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
+    return false;
+  }
+
+  auto join = [](DWORD high, DWORD low) {
+    return std::to_string((static_cast<std::uint64_t>(high) << 32) | low);
+  };
+  identity.key = std::to_string(info.dwVolumeSerialNumber) + "." +
+                 join(info.nFileIndexHigh, info.nFileIndexLow);
+  identity.version = join(info.ftLastWriteTime.dwHighDateTime,
+                          info.ftLastWriteTime.dwLowDateTime) +
+                     ":" +
+                     join(info.ftCreationTime.dwHighDateTime,
+                          info.ftCreationTime.dwLowDateTime) +
+                     ":" + join(info.nFileSizeHigh, info.nFileSizeLow);
+#else
+  struct stat st {};
+  if (::stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+    return false;
+  }
+
+  identity.key = std::to_string(st.st_dev) + "." + std::to_string(st.st_ino);
+  identity.version = std::to_string(st.st_mtime) + ":" +
+                     std::to_string(st.st_ctime) + ":" +
+                     std::to_string(st.st_size);
+#endif
+  return true;
+}
+
+/// Remove the results verified before the expiry, once per process.
+void expireSignatures() {
+  static std::once_flag expired;
+  std::call_once(expired, []() {
+    auto now = getUnixTime();
+    auto oldest = (now > FLAGS_signature_cache_expiry)
+                      ? now - FLAGS_signature_cache_expiry
+                      : 0;
+    std::vector<std::string> keys;
+    scanDatabaseValues(
+        kCodeSignatures,
+        "",
+        0,
+        [&keys, oldest](const std::string& key, std::string& value) {
+          auto time = value.substr(0, value.find('\n'));
+          if (tryTo<uint64_t>(time).takeOr(uint64_t{0}) < oldest) {
+            keys.push_back(key);
+          }
+          return true;
+        });
+
+    for (const auto& key : keys) {
+      deleteDatabaseValue(kCodeSignatures, key);
+    }
+  });
+}
+
+/// The cached rows of a file, false if they are missing or expired.
+bool getSignature(const std::string& key,
+                  const FileIdentity& identity,
+                  uint64_t oldest,
+                  QueryData& rows) {
+  std::string value;
+  if (!getDatabaseValue(kCodeSignatures, key, value).ok()) {
+    return false;
+  }
+
+  // The value is: verified time, version and the rows, on separate lines.
+  auto time_end = value.find('\n');
+  auto version_end = value.find('\n', time_end + 1);
+  if (time_end == std::string::npos || version_end == std::string::npos) {
+    return false;
+  }
+
+  auto time = tryTo<uint64_t>(value.substr(0, time_end)).takeOr(uint64_t{0});
+  if (time < oldest ||
+      value.compare(time_end + 1,
+                    version_end - time_end - 1,
+                    identity.version) != 0) {
+    return false;
+  }
+
+  return deserializeQueryDataJSON(value.substr(version_end + 1), rows).ok() &&
+         !rows.empty();
+}
+
+} // namespace
+
+QueryData genCachedSignature(const std::string& kind,
+                             const std::string& path,
+                             const std::function<QueryData()>& verify) {
+  FileIdentity identity;
+  if (FLAGS_signature_cache_expiry == 0 ||
+      !getFileIdentity(path, identity)) {
+    return verify();
+  }
+
+  expireSignatures();
+
+  auto now = getUnixTime();
+  auto oldest = (now > FLAGS_signature_cache_expiry)
+                    ? now - FLAGS_signature_cache_expiry
+                    : 0;
+  auto key = kind + "." + identity.key;
+
+  QueryData rows;
+  if (getSignature(key, identity, oldest, rows)) {
+    for (auto& row : rows) {
+      row["path"] = path;
+    }
+    return rows;
+  }
+
+  rows = verify();
+  std::string serialized;
+  if (!rows.empty() && serializeQueryDataJSON(rows, serialized).ok()) {
+    setDatabaseValue(kCodeSignatures,
+                     key,
+                     std::to_string(now) + "\n" + identity.version + "\n" +
+                         serialized);
+  }
+  return rows;
+}
+
+} // namespace tables
+} // namespace osquery
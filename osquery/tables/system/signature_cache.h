@@ -0,0 +1,44 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <functional>
+#include <string>
+
+#include <osquery/core/tables.h>
+
+namespace osquery {
+namespace tables {
+
+/**
+ * @brief Verify the code signature of a file, reused while it is unchanged.
+ *
+ * Verifying a signature may take tens to hundreds of milliseconds per binary.
+ * When signature_cache_expiry is set the rows are persisted in the database,
+ * keyed by the file's volume and file ID or inode, and used while its size
+ * and modification times are unchanged. They are verified again once they
+ * are signature_cache_expiry seconds old, so changes to the trusted roots or
+ * revocations are eventually seen.
+ *
+ * Only regular files are cached, the signature of a bundle covers others.
+ * The rows of a file are found under any of its paths, the path column is
+ * set to the path requested. Event subscribers may use the cache to enrich
+ * the binaries of their events.
+ *
+ * @param kind the verification and any option the rows depend on.
+ * @param path the file to verify.
+ * @param verify verifies the file, an empty result is not cached.
+ */
+QueryData genCachedSignature(const std::string& kind,
+                             const std::string& path,
+                             const std::function<QueryData()>& verify);
+
+} // namespace tables
+} // namespace osquery
@@ -15,6 +15,7 @@
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
 #include <osquery/tables/system/system_utils.h>
+#include <osquery/tables/system/user_scan.h>
 #include <osquery/utils/scope_guard.h>
 #include <osquery/utils/system/system.h>
 #include <osquery/worker/ipc/platform_table_container_ipc.h>
@@ -145,42 +146,52 @@ void genSSHkeyForHosts(const std::string& uid,
 
   // Go through each file
   for (const auto& kfile : files_list) {
-    std::string keys_content;
-    auto s = readFile(kfile, keys_content, false, false, false);
+    auto parseKeyFile = [&uid, &kfile](QueryData& rows) {
+      std::string keys_content;
+      auto s = readFile(kfile, keys_content, false, false, false);
+      if (!s.ok()) {
+        return s;
+      }
+
+      int key_type;
+      bool encrypted;
+      bool parsed = parsePrivateKey(keys_content, key_type, encrypted);
+      if (parsed) {
+        Row r;
+        r["pid_with_namespace"] = "0";
+        r["uid"] = uid;
+        r["path"] = kfile;
+        r["encrypted"] = encrypted ? "1" : "0";
+        r["key_type"] = keyTypeAsString(key_type);
+        rows.push_back(r);
+      }
+      return Status::success();
+    };
+
+    auto s = genCachedUserFile(
+        "user_ssh_keys:" + uid, kfile, parseKeyFile, results);
     if (!s.ok()) {
       // Cannot read a specific keys file.
       logger.log(google::GLOG_WARNING, s.getMessage());
-      continue;
-    }
-    int key_type;
-    bool encrypted;
-    bool parsed = parsePrivateKey(keys_content, key_type, encrypted);
-    if (parsed) {
-      Row r;
-      r["pid_with_namespace"] = "0";
-      r["uid"] = uid;
-      r["path"] = kfile;
-      r["encrypted"] = encrypted ? "1" : "0";
-      r["key_type"] = keyTypeAsString(key_type);
-      results.push_back(r);
     }
   }
 }
 
 QueryData getUserSshKeysImpl(QueryContext& context, Logger& logger) {
   QueryData results;
+  UserScanLogger user_logger(logger);
 
-  // Iterate over each user
-  auto users = usersFromContext(context);
-  for (const auto& row : users) {
+  // Scan each user
+  auto scan = [&user_logger](const Row& row, QueryData& rows) {
     auto uid = row.find("uid");
     auto gid = row.find("gid");
     auto directory = row.find("directory");
     if (uid != row.end() && gid != row.end() && directory != row.end()) {
       genSSHkeyForHosts(
-          uid->second, gid->second, directory->second, results, logger);
+          uid->second, gid->second, directory->second, rows, user_logger);
     }
-  }
+  };
+  scanUsers(usersFromContext(context), scan, results);
 
   return results;
 }
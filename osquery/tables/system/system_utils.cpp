@@ -22,6 +22,12 @@ QueryData usersFromContext(const QueryContext& context, bool all) {
                             SQL::selectAllFrom("users", "uid", EQUALS, expr);
                         users.insert(users.end(), user.begin(), user.end());
                       }));
+  } else if (context.hasConstraint("username", EQUALS)) {
+    context.iteritems(
+        "username", EQUALS, ([&users](const std::string& expr) {
+          auto user = SQL::selectAllFrom("users", "username", EQUALS, expr);
+          users.insert(users.end(), user.begin(), user.end());
+        }));
   } else if (!all) {
     users = SQL::selectAllFrom(
         "users", "uid", EQUALS, std::to_string(platformGetUid()));
@@ -17,7 +17,8 @@ namespace tables {
 /**
  * @brief Get a list of users given a context.
  *
- * If no user is provided the current user is returned.
+ * Users are selected by the uid, else the username, constraints of the
+ * context. If no user is provided the current user is returned.
  *
  * @param context The context given to a table implementation.
  * @param optional all Return all users regardless of context.
@@ -37,5 +37,56 @@ TEST_F(CGroupTest, invalid) {
   EXPECT_EQ("", got);
 }
 
+class ProcMapTest : public ::testing::Test {};
+
+TEST_F(ProcMapTest, file_mapping) {
+  ProcMapEntry entry;
+  ASSERT_TRUE(parseProcMapLine(
+      "7f2b0c21e000-7f2b0c244000 r--p 00001000 fe:00 501346"
+      "                     /opt/My App/lib.so",
+      entry));
+  EXPECT_EQ(entry.start, "7f2b0c21e000");
+  EXPECT_EQ(entry.end, "7f2b0c244000");
+  EXPECT_EQ(entry.permissions, "r--p");
+  EXPECT_EQ(entry.offset, "00001000");
+  EXPECT_EQ(entry.device, "fe:00");
+  EXPECT_EQ(entry.inode, "501346");
+  EXPECT_EQ(entry.path, "/opt/My App/lib.so");
+}
+
+TEST_F(ProcMapTest, anonymous_mapping) {
+  ProcMapEntry entry;
+  ASSERT_TRUE(parseProcMapLine(
+      "7f2b0c000000-7f2b0c021000 rw-p 00000000 00:00 0 ", entry));
+  EXPECT_EQ(entry.inode, "0");
+  EXPECT_TRUE(entry.path.empty());
+}
+
+TEST_F(ProcMapTest, invalid) {
+  ProcMapEntry entry;
+  EXPECT_FALSE(parseProcMapLine("7f2b0c000000 rw-p 00000000 00:00 0", entry));
+  EXPECT_FALSE(parseProcMapLine("7f2b0c000000-7f2b0c021000 rw-p", entry));
+}
+
+TEST_F(ProcMapTest, smaps_totals) {
+  std::map<std::string, uint64_t> totals;
+  for (const auto& line : {
+           "55d0c2a1c000-7ffd4a5f1000 ---p 00000000 00:00 0 [rollup]",
+           "Rss:                1024 kB",
+           "Pss:                 512 kB",
+           "Private_Dirty:        16 kB",
+           "THPeligible:            0",
+           "VmFlags: rd ex mr mw me",
+           "Rss:                   4 kB",
+       }) {
+    addProcSmapsLine(line, totals);
+  }
+
+  ASSERT_EQ(totals.size(), 3U);
+  EXPECT_EQ(totals["rss"], 1028U * 1024);
+  EXPECT_EQ(totals["pss"], 512U * 1024);
+  EXPECT_EQ(totals["private_dirty"], 16U * 1024);
+}
+
 } // namespace tables
 } // namespace osquery
\ No newline at end of file
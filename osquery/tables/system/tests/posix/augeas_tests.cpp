@@ -116,6 +116,24 @@ TEST_F(AugeasTests, select_augeas_load_wildcards) {
             1000U);
 }
 
+TEST_F(AugeasTests, select_file_then_all_files) {
+  // A query by the path of a file loads the file, and the handle keeps it.
+  for (size_t i = 0; i < 2; i++) {
+    auto results = SQL("select * from augeas where path = '/etc/hosts'");
+    ASSERT_GE(results.rows().size(), 1U);
+    EXPECT_EQ(results.rows()[0].at("path"), "/etc/hosts");
+  }
+
+  // Other queries see every transform and file.
+  ASSERT_GT(SQL("select * from augeas where node LIKE '/augeas/load/%'")
+                .rows()
+                .size(),
+            100U);
+
+  auto results = SQL("select * from augeas where path = '/etc/hosts'");
+  ASSERT_GE(results.rows().size(), 1U);
+}
+
 TEST_F(AugeasTests, select_file_wildcards) {
   // These are a bit funny. Augeas doesn't do partial matches,
   // and because file is a real file, you have to be careful
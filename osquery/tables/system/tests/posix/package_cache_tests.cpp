@@ -0,0 +1,91 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <boost/filesystem.hpp>
+
+#include <gtest/gtest.h>
+
+#include <osquery/core/flags.h>
+#include <osquery/filesystem/filesystem.h>
+#include <osquery/tables/system/package_cache.h>
+
+namespace fs = boost::filesystem;
+
+namespace osquery {
+
+DECLARE_bool(package_inventory_cache);
+
+namespace tables {
+
+class PackageCacheTests : public testing::Test {
+ protected:
+  void SetUp() override {
+    directory_ = fs::temp_directory_path() /
+                 fs::unique_path("osquery.tests.packages.%%%%.%%%%");
+    fs::create_directories(directory_ / "site");
+    writeTextFile(directory_ / "status", "Package: first\n");
+  }
+
+  void TearDown() override {
+    fs::remove_all(directory_);
+  }
+
+  /// Generate an inventory counting the generations.
+  QueryData generate(size_t& generations) {
+    std::vector<std::string> sources = {(directory_ / "status").string(),
+                                        (directory_ / "site").string()};
+    return genCachedPackages(directory_.string(), sources, [&generations]() {
+      generations++;
+      return QueryData{{{"name", std::to_string(generations)}}};
+    });
+  }
+
+ protected:
+  fs::path directory_;
+};
+
+TEST_F(PackageCacheTests, test_unchanged_sources_are_cached) {
+  size_t generations = 0;
+  auto rows = generate(generations);
+  ASSERT_EQ(rows.size(), 1U);
+  EXPECT_EQ(rows[0]["name"], "1");
+
+  rows = generate(generations);
+  EXPECT_EQ(generations, 1U);
+  EXPECT_EQ(rows[0]["name"], "1");
+
+  // A new package directory changes the site's entries.
+  fs::create_directories(directory_ / "site" / "second.dist-info");
+  rows = generate(generations);
+  EXPECT_EQ(generations, 2U);
+  EXPECT_EQ(rows[0]["name"], "2");
+
+  // A database rewritten through a rename has a new inode.
+  writeTextFile(directory_ / "status.new", "Package: second\n");
+  fs::rename(directory_ / "status.new", directory_ / "status");
+  generate(generations);
+  EXPECT_EQ(generations, 3U);
+
+  FLAGS_package_inventory_cache = false;
+  generate(generations);
+  EXPECT_EQ(generations, 4U);
+  FLAGS_package_inventory_cache = true;
+}
+
+TEST_F(PackageCacheTests, test_fingerprint_missing_sources) {
+  auto missing = (directory_ / "missing").string();
+  auto fingerprint = fingerprintPackageSources({missing});
+  EXPECT_FALSE(fingerprint.empty());
+
+  writeTextFile(missing, "");
+  EXPECT_NE(fingerprintPackageSources({missing}), fingerprint);
+}
+
+} // namespace tables
+} // namespace osquery
@@ -0,0 +1,134 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <atomic>
+
+#include <boost/filesystem.hpp>
+
+#include <gtest/gtest.h>
+
+#include <osquery/core/flags.h>
+#include <osquery/filesystem/filesystem.h>
+#include <osquery/tables/system/user_scan.h>
+
+namespace fs = boost::filesystem;
+
+namespace osquery {
+
+DECLARE_uint32(user_scan_concurrency);
+DECLARE_uint32(user_file_cache_size_mb);
+
+namespace tables {
+
+class UserScanTests : public testing::Test {
+ protected:
+  void SetUp() override {
+    directory_ = fs::temp_directory_path() /
+                 fs::unique_path("osquery.tests.user_scan.%%%%.%%%%");
+    fs::create_directories(directory_);
+  }
+
+  void TearDown() override {
+    fs::remove_all(directory_);
+    FLAGS_user_scan_concurrency = 1;
+  }
+
+ protected:
+  fs::path directory_;
+};
+
+TEST_F(UserScanTests, test_scan_users_keeps_user_order) {
+  QueryData users;
+  for (size_t i = 0; i < 64; ++i) {
+    users.push_back({{"uid", std::to_string(i)}});
+  }
+
+  FLAGS_user_scan_concurrency = 8;
+  std::atomic<size_t> scans{0};
+  QueryData results;
+  scanUsers(
+      users,
+      [&scans](const Row& user, QueryData& rows) {
+        ++scans;
+        rows.push_back({{"uid", user.at("uid")}, {"file", "first"}});
+        rows.push_back({{"uid", user.at("uid")}, {"file", "second"}});
+      },
+      results);
+
+  EXPECT_EQ(scans, users.size());
+  ASSERT_EQ(results.size(), users.size() * 2);
+  for (size_t i = 0; i < results.size(); ++i) {
+    EXPECT_EQ(results[i]["uid"], std::to_string(i / 2));
+    EXPECT_EQ(results[i]["file"], i % 2 == 0 ? "first" : "second");
+  }
+}
+
+TEST_F(UserScanTests, test_unchanged_files_are_cached) {
+  auto path = (directory_ / "known_hosts").string();
+  writeTextFile(path, "first\n");
+
+  size_t generations = 0;
+  auto generate = [&generations, &path](const std::string& uid) {
+    QueryData results;
+    auto status = genCachedUserFile(
+        "test:" + uid,
+        path,
+        [&generations](QueryData& rows) {
+          generations++;
+          rows.push_back({{"generation", std::to_string(generations)}});
+          return Status::success();
+        },
+        results);
+    EXPECT_TRUE(status.ok());
+    return results;
+  };
+
+  auto rows = generate("0");
+  ASSERT_EQ(rows.size(), 1U);
+  EXPECT_EQ(rows[0]["generation"], "1");
+  rows = generate("0");
+  EXPECT_EQ(generations, 1U);
+  EXPECT_EQ(rows[0]["generation"], "1");
+
+  // The rows of another user are generated for that user.
+  generate("1");
+  EXPECT_EQ(generations, 2U);
+
+  // A file rewritten through a rename has a new inode.
+  writeTextFile(path + ".new", "second\n");
+  fs::rename(path + ".new", path);
+  rows = generate("0");
+  EXPECT_EQ(generations, 3U);
+  EXPECT_EQ(rows[0]["generation"], "3");
+
+  FLAGS_user_file_cache_size_mb = 0;
+  generate("0");
+  EXPECT_EQ(generations, 4U);
+  FLAGS_user_file_cache_size_mb = 32;
+}
+
+TEST_F(UserScanTests, test_failures_and_missing_files_are_not_cached) {
+  auto path = (directory_ / "authorized_keys").string();
+  size_t generations = 0;
+  auto fail = [&generations](QueryData&) {
+    generations++;
+    return Status::failure("Cannot read");
+  };
+
+  QueryData results;
+  EXPECT_FALSE(genCachedUserFile("test", path, fail, results).ok());
+  writeTextFile(path, "");
+  EXPECT_FALSE(genCachedUserFile("test", path, fail, results).ok());
+  EXPECT_FALSE(genCachedUserFile("test", path, fail, results).ok());
+  EXPECT_EQ(generations, 3U);
+  EXPECT_TRUE(results.empty());
+}
+
+} // namespace tables
+} // namespace osquery
@@ -0,0 +1,95 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <boost/filesystem.hpp>
+
+#include <gtest/gtest.h>
+
+#include <osquery/core/flags.h>
+#include <osquery/core/system.h>
+#include <osquery/database/database.h>
+#include <osquery/filesystem/filesystem.h>
+#include <osquery/registry/registry_factory.h>
+#include <osquery/tables/system/signature_cache.h>
+
+namespace fs = boost::filesystem;
+
+namespace osquery {
+
+DECLARE_uint64(signature_cache_expiry);
+
+namespace tables {
+
+class SignatureCacheTests : public testing::Test {
+ protected:
+  void SetUp() override {
+    platformSetup();
+    registryAndPluginInit();
+    initDatabasePluginForTesting();
+
+    directory_ = fs::temp_directory_path() /
+                 fs::unique_path("osquery.tests.signatures.%%%%.%%%%");
+    fs::create_directories(directory_);
+    writeTextFile(directory_ / "binary", "content");
+    FLAGS_signature_cache_expiry = 3600;
+  }
+
+  void TearDown() override {
+    FLAGS_signature_cache_expiry = 0;
+    fs::remove_all(directory_);
+  }
+
+  /// Verify a file counting the verifications.
+  QueryData verify(const fs::path& path, size_t& verifications) {
+    return genCachedSignature("test", path.string(), [&verifications]() {
+      verifications++;
+      return QueryData{{{"path", "verified"},
+                        {"result", std::to_string(verifications)}}};
+    });
+  }
+
+ protected:
+  fs::path directory_;
+};
+
+TEST_F(SignatureCacheTests, test_unchanged_files_are_cached) {
+  size_t verifications = 0;
+  auto rows = verify(directory_ / "binary", verifications);
+  ASSERT_EQ(rows.size(), 1U);
+  EXPECT_EQ(rows[0]["result"], "1");
+
+  rows = verify(directory_ / "binary", verifications);
+  EXPECT_EQ(verifications, 1U);
+  ASSERT_EQ(rows.size(), 1U);
+  EXPECT_EQ(rows[0]["result"], "1");
+  EXPECT_EQ(rows[0]["path"], (directory_ / "binary").string());
+
+  // A changed size changes the identity of the file's content.
+  writeTextFile(directory_ / "binary", "changed content");
+  rows = verify(directory_ / "binary", verifications);
+  EXPECT_EQ(verifications, 2U);
+  ASSERT_EQ(rows.size(), 1U);
+  EXPECT_EQ(rows[0]["result"], "2");
+}
+
+TEST_F(SignatureCacheTests, test_directories_and_disabled_cache) {
+  size_t verifications = 0;
+  verify(directory_, verifications);
+  verify(directory_, verifications);
+  EXPECT_EQ(verifications, 2U);
+
+  FLAGS_signature_cache_expiry = 0;
+  writeTextFile(directory_ / "other", "content");
+  verify(directory_ / "other", verifications);
+  verify(directory_ / "other", verifications);
+  EXPECT_EQ(verifications, 4U);
+}
+
+} // namespace tables
+} // namespace osquery
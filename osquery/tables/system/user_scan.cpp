@@ -0,0 +1,182 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <atomic>
+#include <chrono>
+#include <iterator>
+#include <memory>
+
+#ifndef WIN32
+#include <sys/stat.h>
+#endif
+
+#include <osquery/core/flags.h>
+#include <osquery/logger/logger.h>
+#include <osquery/tables/system/user_scan.h>
+#include <osquery/utils/caches/sharded.h>
+
+namespace osquery {
+
+FLAG(uint32,
+     user_scan_concurrency,
+     1,
+     "Number of users whose home directories a table scans at once");
+
+FLAG(uint32,
+     user_scan_timeout,
+     0,
+     "Seconds after which a table skips the users it has not scanned yet");
+
+FLAG(uint32,
+     user_file_cache_size_mb,
+     32,
+     "Memory budget for the rows of unchanged home directory files");
+
+namespace tables {
+
+namespace {
+
+/// The rows of a file and the identity of the file they were read from.
+struct CachedUserFile {
+  std::string identity;
+  QueryData rows;
+};
+
+using CachedUserFilePtr = std::shared_ptr<const CachedUserFile>;
+
+/// Estimate the bytes of a file's rows, the strings dominate.
+struct CachedUserFileSize {
+  std::size_t operator()(const std::string& key,
+                         const CachedUserFilePtr& file) const {
+    auto bytes = sizeof(CachedUserFile) + key.size() + file->identity.size();
+    for (const auto& row : file->rows) {
+      for (const auto& column : row) {
+        bytes += column.first.size() + column.second.size() + 64;
+      }
+    }
+    return bytes;
+  }
+};
+
+using UserFileCache = caches::
+    ShardedCache<std::string, CachedUserFilePtr, CachedUserFileSize>;
+
+UserFileCache& getUserFileCache() {
+  static UserFileCache cache([]() {
+    caches::ShardedCacheOptions options;
+    options.max_bytes =
+        static_cast<std::size_t>(FLAGS_user_file_cache_size_mb) * 1024 * 1024;
+    return options;
+  }());
+  return cache;
+}
+
+/// The identity of a file, empty if it cannot be stat'd.
+std::string identifyFile(const std::string& path) {
+#ifdef WIN32
+  return "";
+#else
+  struct stat st;
+  if (::stat(path.c_str(), &st) != 0) {
+    return "";
+  }
+
+#ifdef __APPLE__
+  const auto& mtime = st.st_mtimespec;
+  const auto& ctime = st.st_ctimespec;
+#else
+  const auto& mtime = st.st_mtim;
+  const auto& ctime = st.st_ctim;
+#endif
+  return std::to_string(st.st_dev) + ":" + std::to_string(st.st_ino) + ":" +
+         std::to_string(st.st_size) + ":" + std::to_string(mtime.tv_sec) +
+         "." + std::to_string(mtime.tv_nsec) + ":" +
+         std::to_string(ctime.tv_sec) + "." + std::to_string(ctime.tv_nsec);
+#endif
+}
+
+} // namespace
+
+void UserScanLogger::log(int severity, const std::string& message) {
+  WriteLock lock(mutex_);
+  logger_.log(severity, message);
+}
+
+void UserScanLogger::vlog(int priority, const std::string& message) {
+  WriteLock lock(mutex_);
+  logger_.vlog(priority, message);
+}
+
+void scanUsers(const QueryData& users,
+               const UserScan& scan,
+               QueryData& results) {
+  auto deadline = std::chrono::steady_clock::now() +
+                  std::chrono::seconds(FLAGS_user_scan_timeout);
+  std::atomic<size_t> skipped{0};
+
+  std::vector<QueryData> user_results(users.size());
+  runTableRequests(users.size(), FLAGS_user_scan_concurrency, [&](size_t i) {
+    if (FLAGS_user_scan_timeout > 0 &&
+        std::chrono::steady_clock::now() > deadline) {
+      ++skipped;
+      return;
+    }
+    scan(users[i], user_results[i]);
+  });
+
+  if (skipped > 0) {
+    LOG(WARNING) << "Skipped the home directories of " << skipped
+                 << " users after " << FLAGS_user_scan_timeout << " seconds";
+  }
+
+  for (auto& rows : user_results) {
+    results.insert(results.end(),
+                   std::make_move_iterator(rows.begin()),
+                   std::make_move_iterator(rows.end()));
+  }
+}
+
+Status genCachedUserFile(const std::string& key,
+                         const std::string& path,
+                         const std::function<Status(QueryData& rows)>& generate,
+                         QueryData& results) {
+  std::string identity;
+  if (FLAGS_user_file_cache_size_mb > 0) {
+    identity = identifyFile(path);
+  }
+  if (identity.empty()) {
+    return generate(results);
+  }
+
+  auto& cache = getUserFileCache();
+  auto cached = cache.get(key + ":" + path);
+  if (cached && (*cached)->identity == identity) {
+    const auto& rows = (*cached)->rows;
+    results.insert(results.end(), rows.begin(), rows.end());
+    return Status::success();
+  }
+
+  QueryData rows;
+  auto status = generate(rows);
+
+  // The file may have changed while it was read, the rows are then read
+  // again by the next query.
+  if (status.ok() && identifyFile(path) == identity) {
+    cache.insert(key + ":" + path,
+                 std::make_shared<const CachedUserFile>(
+                     CachedUserFile{std::move(identity), rows}));
+  }
+  results.insert(results.end(),
+                 std::make_move_iterator(rows.begin()),
+                 std::make_move_iterator(rows.end()));
+  return status;
+}
+
+} // namespace tables
+} // namespace osquery
@@ -0,0 +1,75 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <functional>
+#include <string>
+
+#include <osquery/core/tables.h>
+#include <osquery/utils/mutex.h>
+#include <osquery/worker/logging/logger.h>
+
+namespace osquery {
+namespace tables {
+
+/// The work of a home directory table for one user, appending its rows.
+using UserScan = std::function<void(const Row& user, QueryData& results)>;
+
+/**
+ * @brief Run the work of a home directory table for each user.
+ *
+ * Users are scanned on up to user_scan_concurrency threads and their rows
+ * are appended to results in the order of the users. A home directory on a
+ * stalled network filesystem blocks the thread reading it, so the users not
+ * started within user_scan_timeout seconds of the scan are skipped, and one
+ * warning counts them.
+ *
+ * @param users the rows of the users table, as usersFromContext returns.
+ * @param scan called once for each user, possibly concurrently.
+ * @param results the rows of every user scanned.
+ */
+void scanUsers(const QueryData& users,
+               const UserScan& scan,
+               QueryData& results);
+
+/// Serializes the messages of a logger shared by concurrently scanned users.
+class UserScanLogger final : public Logger {
+ public:
+  explicit UserScanLogger(Logger& logger) : logger_(logger) {}
+
+  void log(int severity, const std::string& message) override;
+  void vlog(int priority, const std::string& message) override;
+
+ private:
+  Logger& logger_;
+  Mutex mutex_;
+};
+
+/**
+ * @brief Generate the rows of a file, reused while the file is unchanged.
+ *
+ * The rows are kept by key and path with the device, inode, size, mtime
+ * and ctime of the file, within user_file_cache_size_mb. Files that cannot
+ * be stat'd, such as missing ones, are generated on each call, and so are
+ * files whose generation failed.
+ *
+ * @param key the table and the user the rows are generated for.
+ * @param path the only file the rows depend on.
+ * @param generate generates the rows when the file is not cached or changed.
+ * @param results the rows of the file are appended.
+ * @return the status of the generation, success for cached rows.
+ */
+Status genCachedUserFile(const std::string& key,
+                         const std::string& path,
+                         const std::function<Status(QueryData& rows)>& generate,
+                         QueryData& results);
+
+} // namespace tables
+} // namespace osquery
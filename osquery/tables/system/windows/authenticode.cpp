@@ -26,6 +26,7 @@
 #include <osquery/logger/logger.h>
 #include <osquery/sql/sql.h>
 #include <osquery/core/tables.h>
+#include <osquery/tables/system/signature_cache.h>
 #include <osquery/utils/conversions/tryto.h>
 #include <osquery/utils/conversions/windows/strings.h>
 
@@ -525,13 +526,20 @@ QueryData genAuthenticode(QueryContext& context) {
       continue;
     }
 
-    Row r;
-    auto status = generateRow(r, path_string);
-    if (status.ok()) {
-      results.push_back(r);
-    } else {
-      LOG(WARNING) << status.getMessage();
-    }
+    auto rows = genCachedSignature("authenticode", path_string, [&]() {
+      QueryData verified;
+      Row r;
+      auto status = generateRow(r, path_string);
+      if (status.ok()) {
+        verified.push_back(std::move(r));
+      } else {
+        LOG(WARNING) << status.getMessage();
+      }
+      return verified;
+    });
+    results.insert(results.end(),
+                   std::make_move_iterator(rows.begin()),
+                   std::make_move_iterator(rows.end()));
   }
 
   return results;
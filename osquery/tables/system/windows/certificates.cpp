@@ -9,6 +9,12 @@
 
 #include <osquery/utils/system/system.h>
 
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <thread>
+
 #include <Wintrust.h>
 #include <wincrypt.h>
 
@@ -47,6 +53,30 @@ const std::map<unsigned long, std::string> kKeyUsages = {
     {CERT_NON_REPUDIATION_KEY_USAGE, "CERT_NON_REPUDIATION_KEY_USAGE"},
     {CERT_OFFLINE_CRL_SIGN_KEY_USAGE, "CERT_OFFLINE_CRL_SIGN_KEY_USAGE"}};
 
+/// The most certificates whose decoded columns are kept.
+const size_t kMaxCachedCertificates{4096};
+
+/// The most threads reading the Personal certificates of the users.
+const size_t kMaxPersonalCertWorkers{4};
+
+/// The columns only depending on the encoded certificates, by SHA1.
+std::mutex certificateCacheMutex;
+std::unordered_map<std::string, Row> certificateCache;
+
+/// The sha1 and path constraints, empty if the column is not constrained.
+struct CertificateFilter final {
+  std::set<std::string> sha1;
+  std::set<std::string> paths;
+
+  bool matchesSha1(const std::string& fingerprint) const {
+    return sha1.empty() || sha1.count(fingerprint) > 0;
+  }
+
+  bool matchesPath(const std::string& path) const {
+    return paths.empty() || paths.count(boost::to_lower_copy(path)) > 0;
+  }
+};
+
 /// A struct holding the arguments we pass to the WinAPI callback function
 typedef struct _ENUM_ARG {
   DWORD dwFlags;
@@ -54,6 +84,7 @@ typedef struct _ENUM_ARG {
   QueryData* results;
   std::string storeLocation;
   ServiceNameMap service2sidCache;
+  const CertificateFilter* filter;
 } ENUM_ARG, *PENUM_ARG;
 
 template <typename Iterator>
@@ -397,23 +428,10 @@ Status getEncodedCert(std::basic_istream<BYTE>& blob,
   return Status::success();
 }
 
-void addCertRow(PCCERT_CONTEXT certContext,
-                const std::string& storeId,
-                const std::string& sid,
-                const std::string& storeName,
-                const std::string& username,
-                const std::string& storeLocation,
-                QueryData& results) {
-  std::vector<BYTE> fingerprintBuff;
-  getCertCtxProp(certContext, CERT_HASH_PROP_ID, fingerprintBuff);
-  std::string fingerprint;
-  toHexStr(fingerprintBuff.begin(), fingerprintBuff.end(), fingerprint);
-
-  Row r;
-  r["sid"] = sid;
-  r["username"] = username;
-  r["store_id"] = storeId;
-  r["sha1"] = fingerprint;
+/**
+ * Decode the columns of a certificate which do not depend on its store.
+ */
+void genCertColumns(PCCERT_CONTEXT certContext, Row& r) {
   std::vector<WCHAR> certBuff;
   certBuff.resize(256, 0);
   std::fill(certBuff.begin(), certBuff.end(), 0);
@@ -484,11 +502,6 @@ void addCertRow(PCCERT_CONTEXT certContext,
   toHexStr(keypropBuff.begin(), keypropBuff.end(), subjectKeyId);
   r["subject_key_id"] = subjectKeyId;
 
-  r["path"] =
-      storeLocation + "\\" + constructDisplayStoreName(storeId, storeName);
-  r["store_location"] = storeLocation;
-  r["store"] = storeName;
-
   std::string serial;
   toHexStr(certContext->pCertInfo->SerialNumber.pbData,
            certContext->pCertInfo->SerialNumber.pbData +
@@ -537,8 +550,60 @@ void addCertRow(PCCERT_CONTEXT certContext,
     }
   }
   r["authority_key_id"] = authKeyId;
+}
+
+void addCertRow(PCCERT_CONTEXT certContext,
+                const std::string& storeId,
+                const std::string& sid,
+                const std::string& storeName,
+                const std::string& username,
+                const std::string& storeLocation,
+                const CertificateFilter& filter,
+                QueryData& results) {
+  // The SHA1 of the encoded certificate is a property of its context, the
+  // certificate is only decoded if it is not cached
+  std::vector<BYTE> fingerprintBuff;
+  getCertCtxProp(certContext, CERT_HASH_PROP_ID, fingerprintBuff);
+  std::string fingerprint;
+  toHexStr(fingerprintBuff.begin(), fingerprintBuff.end(), fingerprint);
+
+  if (!filter.matchesSha1(fingerprint)) {
+    return;
+  }
+
+  Row r;
+  bool cached{false};
+  if (!fingerprint.empty()) {
+    std::lock_guard<std::mutex> lock(certificateCacheMutex);
+    auto it = certificateCache.find(fingerprint);
+    if (it != certificateCache.end()) {
+      r = it->second;
+      cached = true;
+    }
+  }
+
+  if (!cached) {
+    genCertColumns(certContext, r);
+
+    if (!fingerprint.empty()) {
+      std::lock_guard<std::mutex> lock(certificateCacheMutex);
+      if (certificateCache.size() >= kMaxCachedCertificates) {
+        certificateCache.clear();
+      }
+      certificateCache[fingerprint] = r;
+    }
+  }
+
+  r["sid"] = sid;
+  r["username"] = username;
+  r["store_id"] = storeId;
+  r["sha1"] = fingerprint;
+  r["path"] =
+      storeLocation + "\\" + constructDisplayStoreName(storeId, storeName);
+  r["store_location"] = storeLocation;
+  r["store"] = storeName;
 
-  results.push_back(r);
+  results.push_back(std::move(r));
 }
 
 Status expandEnvironmentVariables(const std::string& src, std::string& dest) {
@@ -566,7 +631,13 @@ void findUserPersonalCertsOnDisk(const std::string& username,
                                  const std::string& sid,
                                  const std::string& storeName,
                                  const std::string& storeLocation,
+                                 const CertificateFilter& filter,
                                  QueryData& results) {
+  if (!filter.matchesPath(storeLocation + "\\" +
+                          constructDisplayStoreName(storeId, storeName))) {
+    return;
+  }
+
   VLOG(1) << "Checking disk for Personal certificates for user: " << username;
 
   std::string homeDir;
@@ -602,9 +673,19 @@ void findUserPersonalCertsOnDisk(const std::string& username,
           X509_ASN_ENCODING,
           encodedCert.data(),
           static_cast<unsigned long>(encodedCert.size()));
+      if (ctx == nullptr) {
+        continue;
+      }
 
-      addCertRow(
-          ctx, storeId, sid, storeName, username, storeLocation, results);
+      addCertRow(ctx,
+                 storeId,
+                 sid,
+                 storeName,
+                 username,
+                 storeLocation,
+                 filter,
+                 results);
+      CertFreeCertificateContext(ctx);
     }
   } catch (const fs::filesystem_error& e) {
     VLOG(1) << "Error traversing " << certsPath.str() << ": " << e.what();
@@ -618,11 +699,18 @@ void enumerateCertStore(const HCERTSTORE& certStore,
                         LPCWSTR sysStoreW,
                         const std::string& storeLocation,
                         ServiceNameMap& service2sidCache,
+                        const CertificateFilter& filter,
                         QueryData& results) {
   std::string storeId, sid, storeName;
   parseSystemStoreString(
       sysStoreW, storeLocation, service2sidCache, storeId, sid, storeName);
 
+  // Stores not matching a path constraint are not enumerated
+  if (!filter.matchesPath(storeLocation + "\\" +
+                          constructDisplayStoreName(storeId, storeName))) {
+    return;
+  }
+
   std::string username = getUsernameFromSid(sid);
 
   auto certContext = CertEnumCertificatesInStore(certStore, nullptr);
@@ -637,7 +725,7 @@ void enumerateCertStore(const HCERTSTORE& certStore,
     if (is_personal_store && not_already_added) {
       // TODO(#5654) 2: Potential future optimization
       findUserPersonalCertsOnDisk(
-          username, storeId, sid, storeName, storeLocation, results);
+          username, storeId, sid, storeName, storeLocation, filter, results);
     }
 
     return;
@@ -651,8 +739,14 @@ void enumerateCertStore(const HCERTSTORE& certStore,
   }
 
   while (certContext != nullptr) {
-    addCertRow(
-        certContext, storeId, sid, storeName, username, storeLocation, results);
+    addCertRow(certContext,
+               storeId,
+               sid,
+               storeName,
+               username,
+               storeLocation,
+               filter,
+               results);
 
     certContext = CertEnumCertificatesInStore(certStore, certContext);
   }
@@ -690,6 +784,7 @@ BOOL WINAPI certEnumSystemStoreCallback(const void* systemStore,
                      sysStoreW,
                      storeArg->storeLocation,
                      storeArg->service2sidCache,
+                     *storeArg->filter,
                      *storeArg->results);
 
   auto ret = CertCloseStore(certHandle, 0);
@@ -735,27 +830,53 @@ BOOL WINAPI certEnumSystemStoreLocationsCallback(LPCWSTR storeLocation,
  * disk so that the table is guaranteed to, at the very least, list any
  * existing Personal certs for all local users, regardless of whether those
  * users' registry hives are currently mounted.
+ *
+ * The users are read in parallel, their rows are returned in the order of
+ * the users.
  */
-void genPersonalCertsFromDisk(QueryData& results) {
+void genPersonalCertsFromDisk(const CertificateFilter& filter,
+                              QueryData& results) {
   SQL sql("SELECT uuid, username FROM users");
   if (!sql.ok()) {
     VLOG(1) << sql.getStatus().getMessage();
     return;
   }
 
-  for (const auto& row : sql.rows()) {
-    auto sid = row.at("uuid");
-    auto username = row.at("username");
+  const auto& users = sql.rows();
+  std::vector<QueryData> user_results(users.size());
+  std::atomic<size_t> next{0};
+  auto worker = [&users, &filter, &user_results, &next]() {
+    for (size_t i = next++; i < users.size(); i = next++) {
+      const auto& sid = users[i].at("uuid");
+      const auto& username = users[i].at("username");
 
-    findUserPersonalCertsOnDisk(
-        username, sid, sid, "Personal", "Users", results);
+      findUserPersonalCertsOnDisk(
+          username, sid, sid, "Personal", "Users", filter, user_results[i]);
+    }
+  };
+
+  // The calling thread is a worker too.
+  std::vector<std::thread> threads;
+  auto thread_count = std::min(kMaxPersonalCertWorkers, users.size());
+  for (size_t i = 1; i < thread_count; ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  for (auto& rows : user_results) {
+    results.insert(results.end(),
+                   std::make_move_iterator(rows.begin()),
+                   std::make_move_iterator(rows.end()));
   }
 }
 
 /**
  * Use the standard enumeration APIs to retrieve certificates.
  */
-void genNonPersonalCerts(QueryData& results) {
+void genNonPersonalCerts(const CertificateFilter& filter, QueryData& results) {
   ENUM_ARG enumArg;
 
   unsigned long flags = 0;
@@ -764,6 +885,7 @@ void genNonPersonalCerts(QueryData& results) {
   enumArg.dwFlags = flags;
   enumArg.pvStoreLocationPara = nullptr;
   enumArg.results = &results;
+  enumArg.filter = &filter;
 
   flags &= ~CERT_SYSTEM_STORE_LOCATION_MASK;
   flags |= (locationId << CERT_SYSTEM_STORE_LOCATION_SHIFT) &
@@ -781,8 +903,28 @@ void genNonPersonalCerts(QueryData& results) {
 QueryData genCerts(QueryContext& context) {
   QueryData results;
 
-  genPersonalCertsFromDisk(results);
-  genNonPersonalCerts(results);
+  // The fingerprints are uppercase and the paths are compared regardless of
+  // their case, as the store names are
+  CertificateFilter filter;
+  for (const auto& sha1 : context.constraints["sha1"].getAll(EQUALS)) {
+    filter.sha1.insert(boost::to_upper_copy(sha1));
+  }
+  for (const auto& path : context.constraints["path"].getAll(EQUALS)) {
+    filter.paths.insert(boost::to_lower_copy(path));
+  }
+
+  // The stores are enumerated while the Personal certificates are read
+  QueryData non_personal_results;
+  std::thread non_personal([&filter, &non_personal_results]() {
+    genNonPersonalCerts(filter, non_personal_results);
+  });
+
+  genPersonalCertsFromDisk(filter, results);
+  non_personal.join();
+
+  results.insert(results.end(),
+                 std::make_move_iterator(non_personal_results.begin()),
+                 std::make_move_iterator(non_personal_results.end()));
 
   return results;
 }
@@ -7,12 +7,16 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+
 #include <osquery/core/core.h>
+#include <osquery/core/flags.h>
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/fileops.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
 #include <osquery/sql/dynamic_table_row.h>
+#include <osquery/utils/caches/sharded.h>
 #include <osquery/utils/conversions/join.h>
 #include <osquery/utils/conversions/windows/strings.h>
 #include <osquery/utils/conversions/windows/windows_time.h>
@@ -25,6 +29,17 @@
 #define PREFETCH_SIGNATURE 'ACCS' // SCCA
 
 namespace osquery {
+
+FLAG(uint32,
+     prefetch_query_workers,
+     4,
+     "Threads decompressing and parsing prefetch files for a query");
+
+FLAG(uint32,
+     prefetch_cache_size_mb,
+     16,
+     "Memory budget for the rows of unchanged prefetch files");
+
 namespace tables {
 namespace {
 
@@ -35,6 +50,9 @@ const unsigned int kPrefetchVersionWindows7 = 23;
 const unsigned int kPrefetchVolumeSizeWindows10 = 96;
 const unsigned int kPrefetchVolumeSizeWindows8 = 104;
 
+/// Prefetch file names hold at most 29 characters of the executable name.
+const size_t kPrefetchFilenameLength = 29;
+
 struct PrefetchHeader {
   std::uint32_t file_size;
   std::string filename;
@@ -125,6 +143,74 @@ typedef struct _DIRECTORY_STRING {
 } DIRECTORY_STRING, *PDIRECTORY_STRING;
 #pragma pack(pop)
 
+/// The row of a prefetch file and the identity of the file it was parsed from.
+struct CachedPrefetchFile {
+  std::string identity;
+  Row row;
+};
+
+using CachedPrefetchFilePtr = std::shared_ptr<const CachedPrefetchFile>;
+
+struct CachedPrefetchFileSize {
+  std::size_t operator()(const std::string& path,
+                         const CachedPrefetchFilePtr& file) const {
+    auto bytes =
+        sizeof(CachedPrefetchFile) + path.size() + file->identity.size();
+    for (const auto& column : file->row) {
+      bytes += column.first.size() + column.second.size() + 64;
+    }
+    return bytes;
+  }
+};
+
+using PrefetchFileCache = caches::
+    ShardedCache<std::string, CachedPrefetchFilePtr, CachedPrefetchFileSize>;
+
+PrefetchFileCache& getPrefetchFileCache() {
+  static PrefetchFileCache cache([]() {
+    caches::ShardedCacheOptions options;
+    options.max_bytes =
+        static_cast<std::size_t>(FLAGS_prefetch_cache_size_mb) * 1024 * 1024;
+    return options;
+  }());
+  return cache;
+}
+
+/**
+ * @brief The identity of a prefetch file, empty if it cannot be opened.
+ *
+ * The file is identified by its volume and file index, its size and its
+ * last write time, Windows rewrites a prefetch file each time the
+ * application runs.
+ */
+std::string identifyPrefetchFile(const std::string& file_path) {
+  auto handle = CreateFileW(stringToWstring(file_path).c_str(),
+                            FILE_READ_ATTRIBUTES,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE |
+                                FILE_SHARE_DELETE,
+                            nullptr,
+                            OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL,
+                            nullptr);
+  if (handle == INVALID_HANDLE_VALUE) {
+    return "";
+  }
+
+  BY_HANDLE_FILE_INFORMATION info;
+  auto result = GetFileInformationByHandle(handle, &info);
+  CloseHandle(handle);
+  if (!result) {
+    return "";
+  }
+
+  return (boost::format("%x:%x%08x:%x%08x:%x%08x") %
+          info.dwVolumeSerialNumber % info.nFileIndexHigh %
+          info.nFileIndexLow % info.nFileSizeHigh % info.nFileSizeLow %
+          info.ftLastWriteTime.dwHighDateTime %
+          info.ftLastWriteTime.dwLowDateTime)
+      .str();
+}
+
 } // namespace
 
 PrefetchHeader parseHeader(const PREFETCH_FILE_HEADER* header) {
@@ -287,13 +373,13 @@ PrefetchVolumeInfo parseVolumeInfo(
   return result;
 }
 
-void parsePrefetchData(RowYield& yield,
+bool parsePrefetchData(Row& r,
                        const std::vector<UCHAR>& data,
                        const std::string& file_path) {
   const auto prefetch_header = (PPREFETCH_FILE_HEADER)&data[0];
   if (prefetch_header->Signature != PREFETCH_SIGNATURE) {
     LOG(INFO) << "Unsupported prefetch file header: " << file_path;
-    return;
+    return false;
   }
 
   const auto version = prefetch_header->Version;
@@ -301,7 +387,7 @@ void parsePrefetchData(RowYield& yield,
       version != kPrefetchVersionWindows7 &&
       version != kPrefetchVersionWindows8) {
     LOG(INFO) << "Unsupported prefetch file version: " << file_path;
-    return;
+    return false;
   }
 
   auto header = parseHeader(prefetch_header);
@@ -311,7 +397,6 @@ void parsePrefetchData(RowYield& yield,
   auto file_info = parseFileInfo(data, prefetch_file_info, version);
   auto volume_info = parseVolumeInfo(data, prefetch_file_info, version);
 
-  auto r = make_table_row();
   r["path"] = file_path;
   r["filename"] = SQL_TEXT(header.filename);
   r["hash"] = header.prefetch_hash;
@@ -329,10 +414,10 @@ void parsePrefetchData(RowYield& yield,
   }
 
   r["run_count"] = INTEGER(file_info.run_count);
-  yield(std::move(r));
+  return true;
 }
 
-void parsePrefetch(const std::string& file_path, RowYield& yield) {
+bool parsePrefetch(const std::string& file_path, Row& row) {
   std::ifstream input_file(file_path, std::ios::in | std::ios::binary);
   std::vector<UCHAR> compressed_data(
       (std::istreambuf_iterator<char>(input_file)),
@@ -341,7 +426,7 @@ void parsePrefetch(const std::string& file_path, RowYield& yield) {
 
   if (compressed_data.size() < sizeof(PPREFETCH_COMPRESSED_HEADER)) {
     // Not enough data to determine header size.
-    return;
+    return false;
   }
 
   std::vector<UCHAR> data;
@@ -352,7 +437,7 @@ void parsePrefetch(const std::string& file_path, RowYield& yield) {
         compressed_data, compressed_header->TotalUncompressedSize);
     if (expected.isError()) {
       LOG(INFO) << "Cannot decompress prefetch file: " << expected.getError();
-      return;
+      return false;
     }
     data = expected.take();
   } else {
@@ -361,10 +446,39 @@ void parsePrefetch(const std::string& file_path, RowYield& yield) {
 
   if (data.size() < sizeof(PPREFETCH_FILE_HEADER)) {
     // Not enough data to determine signature.
-    return;
+    return false;
+  }
+
+  return parsePrefetchData(row, data, file_path);
+}
+
+/// The row of a prefetch file, parsed again only if the file changed.
+CachedPrefetchFilePtr getPrefetchRow(const std::string& file_path) {
+  std::string identity;
+  if (FLAGS_prefetch_cache_size_mb > 0) {
+    identity = identifyPrefetchFile(file_path);
   }
 
-  parsePrefetchData(yield, data, file_path);
+  auto& cache = getPrefetchFileCache();
+  if (!identity.empty()) {
+    auto cached = cache.get(file_path);
+    if (cached && (*cached)->identity == identity) {
+      return *cached;
+    }
+  }
+
+  Row row;
+  if (!parsePrefetch(file_path, row)) {
+    return nullptr;
+  }
+
+  // A file rewritten while it was read is parsed again by the next query.
+  auto file = std::make_shared<const CachedPrefetchFile>(
+      CachedPrefetchFile{identity, std::move(row)});
+  if (!identity.empty() && identifyPrefetchFile(file_path) == identity) {
+    cache.insert(file_path, file);
+  }
+  return file;
 }
 
 void genPrefetch(RowYield& yield, QueryContext& context) {
@@ -394,14 +508,49 @@ void genPrefetch(RowYield& yield, QueryContext& context) {
     listFilesInDirectory(kPrefetchLocation, prefetch_files);
   }
 
+  // Prefetch files are named after the executable, such as NOTEPAD.EXE-XXX.pf
+  // so a filename constraint selects the files to parse.
+  std::vector<std::string> filenames;
+  if (paths.empty() && context.hasConstraint("filename", EQUALS)) {
+    auto constraints = context.constraints["filename"].getAll(EQUALS);
+    for (const auto& filename : constraints) {
+      filenames.push_back(filename.substr(0, kPrefetchFilenameLength));
+    }
+  }
+
+  std::vector<std::string> parsed_files;
   for (const auto& file_path : prefetch_files) {
     if (!boost::algorithm::iends_with(file_path, ".pf")) {
       continue;
     }
 
+    if (!filenames.empty()) {
+      auto name = boost::filesystem::path(file_path).filename().string();
+      auto selected = std::any_of(
+          filenames.begin(), filenames.end(), [&name](const auto& filename) {
+            return boost::algorithm::istarts_with(name, filename);
+          });
+      if (!selected) {
+        continue;
+      }
+    }
+
     boost::system::error_code ec;
     if (boost::filesystem::is_regular_file(file_path, ec) && !ec) {
-      parsePrefetch(file_path, yield);
+      parsed_files.push_back(file_path);
+    }
+  }
+
+  // Files are decompressed and parsed concurrently, rows keep the file order.
+  std::vector<CachedPrefetchFilePtr> files(parsed_files.size());
+  runTableRequests(
+      parsed_files.size(), FLAGS_prefetch_query_workers, [&](size_t i) {
+        files[i] = getPrefetchRow(parsed_files[i]);
+      });
+
+  for (const auto& file : files) {
+    if (file != nullptr) {
+      yield(TableRowHolder(new DynamicTableRow(Row(file->row))));
     }
   }
 }
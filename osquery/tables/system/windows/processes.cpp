@@ -7,8 +7,13 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <algorithm>
+#include <atomic>
+#include <functional>
 #include <map>
 #include <string>
+#include <thread>
+#include <vector>
 
 #define _WIN32_DCOM
 
@@ -29,6 +34,7 @@
 #include <boost/filesystem/path.hpp>
 
 #include <osquery/core/core.h>
+#include <osquery/core/flags.h>
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
@@ -43,6 +49,12 @@
 #include <osquery/utils/system/windows/users_groups_helpers.h>
 
 namespace osquery {
+
+FLAG(uint32,
+     processes_query_workers,
+     4,
+     "Threads opening processes for the processes table columns needing it");
+
 namespace tables {
 
 const std::map<unsigned long, std::string> kMemoryConstants = {
@@ -180,6 +192,151 @@ typedef struct _PS_PROTECTION {
   };
 } PS_PROTECTION, *PPS_PROTECTION;
 
+// The full layout of the SystemProcessInformation entries, see the Process
+// Hacker definition in phnt/include/ntexapi.h
+typedef struct _SYSTEM_PROCESS_INFORMATION {
+  ULONG NextEntryOffset;
+  ULONG NumberOfThreads;
+  LARGE_INTEGER WorkingSetPrivateSize;
+  ULONG HardFaultCount;
+  ULONG NumberOfThreadsHighWatermark;
+  ULONGLONG CycleTime;
+  LARGE_INTEGER CreateTime;
+  LARGE_INTEGER UserTime;
+  LARGE_INTEGER KernelTime;
+  UNICODE_STRING ImageName;
+  LONG BasePriority;
+  HANDLE UniqueProcessId;
+  HANDLE InheritedFromUniqueProcessId;
+  ULONG HandleCount;
+  ULONG SessionId;
+  ULONG_PTR UniqueProcessKey;
+  SIZE_T PeakVirtualSize;
+  SIZE_T VirtualSize;
+  ULONG PageFaultCount;
+  SIZE_T PeakWorkingSetSize;
+  SIZE_T WorkingSetSize;
+  SIZE_T QuotaPeakPagedPoolUsage;
+  SIZE_T QuotaPagedPoolUsage;
+  SIZE_T QuotaPeakNonPagedPoolUsage;
+  SIZE_T QuotaNonPagedPoolUsage;
+  SIZE_T PagefileUsage;
+  SIZE_T PeakPagefileUsage;
+  SIZE_T PrivatePageCount;
+  LARGE_INTEGER ReadOperationCount;
+  LARGE_INTEGER WriteOperationCount;
+  LARGE_INTEGER OtherOperationCount;
+  LARGE_INTEGER ReadTransferCount;
+  LARGE_INTEGER WriteTransferCount;
+  LARGE_INTEGER OtherTransferCount;
+} SYSTEM_PROCESS_INFORMATION, *PSYSTEM_PROCESS_INFORMATION;
+
+/// Initial size of the buffer for the process list snapshot.
+const ULONG kProcessSnapshotSize = 0x40000;
+
+/// Attempts to snapshot a process list still growing between the calls.
+const size_t kProcessSnapshotAttempts = 8;
+
+/// Columns read from an opened process, the others are from the snapshot.
+const std::initializer_list<std::string> kProcessHandleColumns = {
+    "nice",
+    "protection_type",
+    "secure_process",
+    "virtual_process",
+    "path",
+    "on_disk",
+    "cwd",
+    "root",
+    "cmdline",
+    "uid",
+    "gid",
+    "elevated_token",
+    "state",
+};
+
+/**
+ * @brief Read the list of processes with a single system call.
+ *
+ * The buffer holds SYSTEM_PROCESS_INFORMATION entries chained by their
+ * NextEntryOffset. Unlike a toolhelp snapshot, the entries also carry the
+ * times, memory and I/O counters of each process.
+ */
+Status getProcessSnapshot(std::vector<BYTE>& buffer) {
+  ULONG size = std::max<ULONG>(static_cast<ULONG>(buffer.size()),
+                               kProcessSnapshotSize);
+  for (size_t attempt = 0; attempt < kProcessSnapshotAttempts; ++attempt) {
+    buffer.resize(size);
+    ULONG needed = 0;
+    auto status = NtQuerySystemInformation(SystemProcessInformation,
+                                           buffer.data(),
+                                           static_cast<ULONG>(buffer.size()),
+                                           &needed);
+    if (NT_SUCCESS(status)) {
+      return Status::success();
+    }
+    if (status != STATUS_INFO_LENGTH_MISMATCH) {
+      return Status::failure("Failed to snapshot the processes with " +
+                             std::to_string(status));
+    }
+
+    // Leave room for the processes started before the next attempt.
+    size = std::max(size, needed) + needed / 8;
+  }
+  return Status::failure("Failed to snapshot the growing process list");
+}
+
+/// Call the function on each entry of a process snapshot.
+void forEachSnapshotProcess(
+    const std::vector<BYTE>& buffer,
+    const std::function<void(const SYSTEM_PROCESS_INFORMATION&)>& callback) {
+  for (size_t offset = 0; offset < buffer.size();) {
+    const auto& info =
+        *reinterpret_cast<const SYSTEM_PROCESS_INFORMATION*>(&buffer[offset]);
+    callback(info);
+    if (info.NextEntryOffset == 0) {
+      break;
+    }
+    offset += info.NextEntryOffset;
+  }
+}
+
+unsigned long getSnapshotProcessId(const SYSTEM_PROCESS_INFORMATION& info) {
+  return static_cast<unsigned long>(
+      reinterpret_cast<ULONG_PTR>(info.UniqueProcessId));
+}
+
+/**
+ * @brief Run the tasks on a bounded set of threads.
+ *
+ * The calling thread takes part, the tasks run on it alone when no thread
+ * can be started.
+ */
+void runProcessTasks(size_t count, const std::function<void(size_t)>& task) {
+  std::atomic<size_t> next{0};
+  auto worker = [&next, &task, count]() {
+    for (auto i = next++; i < count; i = next++) {
+      task(i);
+    }
+  };
+
+  auto thread_count = std::min<size_t>(
+      std::max<std::uint32_t>(FLAGS_processes_query_workers, 1), count);
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < thread_count; ++i) {
+    try {
+      threads.emplace_back(worker);
+    } catch (const std::system_error& e) {
+      LOG(ERROR) << "Cannot start a processes worker: " << e.what();
+      break;
+    }
+  }
+
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
 /// Given a pid, enumerates all loaded modules and memory pages for that process
 Status genMemoryMap(unsigned long pid, QueryData& results) {
   auto proc = OpenProcess(PROCESS_QUERY_INFORMATION, FALSE, pid);
@@ -253,26 +410,16 @@ Status genMemoryMap(unsigned long pid, QueryData& results) {
 
 /// Helper function for enumerating all active processes on the system
 Status getProcList(std::set<long>& pids) {
-  auto procSnap = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
-  if (procSnap == INVALID_HANDLE_VALUE) {
-    return Status::failure("Failed to open process snapshot");
-  }
-
-  PROCESSENTRY32W procEntry;
-  procEntry.dwSize = sizeof(PROCESSENTRY32W);
-  auto ret = Process32FirstW(procSnap, &procEntry);
-
-  if (ret == FALSE) {
-    CloseHandle(procSnap);
-    return Status::failure("Failed to open first process");
+  std::vector<BYTE> snapshot;
+  auto status = getProcessSnapshot(snapshot);
+  if (!status.ok()) {
+    return status;
   }
 
-  while (ret != FALSE) {
-    pids.insert(procEntry.th32ProcessID);
-    ret = Process32NextW(procSnap, &procEntry);
-  }
-
-  CloseHandle(procSnap);
+  forEachSnapshotProcess(
+      snapshot, [&pids](const SYSTEM_PROCESS_INFORMATION& info) {
+        pids.insert(getSnapshotProcessId(info));
+      });
   return Status::success();
 }
 
@@ -471,58 +618,6 @@ void genProcessUserTokenInfo(HANDLE& proc, DynamicTableRowHolder& r) {
   }
 }
 
-void genProcessTimeInfo(HANDLE& proc, DynamicTableRowHolder& r) {
-  FILETIME create_time;
-  FILETIME exit_time;
-  FILETIME kernel_time;
-  FILETIME user_time;
-  auto ret =
-      GetProcessTimes(proc, &create_time, &exit_time, &kernel_time, &user_time);
-  if (ret == FALSE) {
-    LOG(ERROR) << "Failed to lookup time data for process "
-               << GetProcessId(proc);
-  } else {
-    // Windows stores proc times in 100 nanosecond ticks
-    ULARGE_INTEGER utime;
-    utime.HighPart = user_time.dwHighDateTime;
-    utime.LowPart = user_time.dwLowDateTime;
-    auto user_time_total = utime.QuadPart;
-    r["user_time"] = BIGINT(user_time_total / 10000);
-    utime.HighPart = kernel_time.dwHighDateTime;
-    utime.LowPart = kernel_time.dwLowDateTime;
-    r["system_time"] = BIGINT(utime.QuadPart / 10000);
-    r["percent_processor_time"] = BIGINT(user_time_total + utime.QuadPart);
-
-    auto proc_create_time = osquery::filetimeToUnixtime(create_time);
-    r["start_time"] = BIGINT(proc_create_time);
-
-    FILETIME curr_ft_time;
-    SYSTEMTIME curr_sys_time;
-    GetSystemTime(&curr_sys_time);
-    SystemTimeToFileTime(&curr_sys_time, &curr_ft_time);
-    r["elapsed_time"] =
-        BIGINT(osquery::filetimeToUnixtime(curr_ft_time) - proc_create_time);
-  }
-}
-
-void genProcRssInfo(HANDLE& proc, DynamicTableRowHolder& r) {
-  PROCESS_MEMORY_COUNTERS_EX mem_ctr;
-  auto ret =
-      GetProcessMemoryInfo(proc,
-                           reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&mem_ctr),
-                           sizeof(PROCESS_MEMORY_COUNTERS_EX));
-
-  if (ret != TRUE) {
-    LOG(ERROR) << "Failed to lookup RSS stats for process "
-               << GetProcessId(proc);
-  }
-  r["wired_size"] =
-      ret == TRUE ? BIGINT(mem_ctr.QuotaNonPagedPoolUsage) : BIGINT(-1);
-  r["resident_size"] =
-      ret == TRUE ? BIGINT(mem_ctr.WorkingSetSize) : BIGINT(-1);
-  r["total_size"] = ret == TRUE ? BIGINT(mem_ctr.PrivateUsage) : BIGINT(-1);
-}
-
 PS_PROTECTED_TYPE getProcessProtectedType(HANDLE& proc,
                                           const unsigned long pid) {
   PS_PROTECTION psp{0};
@@ -540,9 +635,147 @@ PS_PROTECTED_TYPE getProcessProtectedType(HANDLE& proc,
   return PS_PROTECTED_TYPE::PsProtectedTypeNone;
 }
 
-TableRows genProcesses(QueryContext& context) {
-  TableRows results;
+void genProcessSnapshotInfo(const SYSTEM_PROCESS_INFORMATION& info,
+                            DynamicTableRowHolder& r) {
+  // Windows stores proc times in 100 nanosecond ticks
+  r["user_time"] = BIGINT(info.UserTime.QuadPart / 10000);
+  r["system_time"] = BIGINT(info.KernelTime.QuadPart / 10000);
+  r["percent_processor_time"] =
+      BIGINT(info.UserTime.QuadPart + info.KernelTime.QuadPart);
+
+  FILETIME create_time;
+  create_time.dwLowDateTime = info.CreateTime.LowPart;
+  create_time.dwHighDateTime = info.CreateTime.HighPart;
+  auto proc_create_time = osquery::filetimeToUnixtime(create_time);
+  r["start_time"] = BIGINT(proc_create_time);
+
+  FILETIME curr_ft_time;
+  SYSTEMTIME curr_sys_time;
+  GetSystemTime(&curr_sys_time);
+  SystemTimeToFileTime(&curr_sys_time, &curr_ft_time);
+  r["elapsed_time"] =
+      BIGINT(osquery::filetimeToUnixtime(curr_ft_time) - proc_create_time);
+
+  r["wired_size"] = BIGINT(info.QuotaNonPagedPoolUsage);
+  r["resident_size"] = BIGINT(info.WorkingSetSize);
+  r["total_size"] = BIGINT(info.PagefileUsage);
+  r["disk_bytes_read"] = BIGINT(info.ReadTransferCount.QuadPart);
+  r["disk_bytes_written"] = BIGINT(info.WriteTransferCount.QuadPart);
+  r["handle_count"] = INTEGER(info.HandleCount);
+}
+
+/**
+ * @brief Populate the columns read from an opened process.
+ *
+ * The process is skipped when it exited since the snapshot, or when its pid
+ * was reused by a process started later.
+ */
+void genProcessHandleInfo(QueryContext& context,
+                          const unsigned long pid,
+                          const LONGLONG snapshot_create_time,
+                          DynamicTableRowHolder& r) {
+  auto proc_handle =
+      OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, pid);
+
+  // If we fail to get all privs, open with less permissions
+  if (proc_handle == NULL) {
+    proc_handle = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+  }
+
+  if (proc_handle == NULL) {
+    VLOG(1) << "Failed to open handle to process " << pid << " with "
+            << GetLastError();
+    return;
+  }
+  auto const proc_handle_manager =
+      scope_guard::create([&proc_handle]() { CloseHandle(proc_handle); });
+
+  FILETIME create_time;
+  FILETIME exit_time;
+  FILETIME kernel_time;
+  FILETIME user_time;
+  if (GetProcessTimes(
+          proc_handle, &create_time, &exit_time, &kernel_time, &user_time)) {
+    ULARGE_INTEGER created;
+    created.LowPart = create_time.dwLowDateTime;
+    created.HighPart = create_time.dwHighDateTime;
+    if (static_cast<LONGLONG>(created.QuadPart) != snapshot_create_time) {
+      VLOG(1) << "Process " << pid << " was replaced since the snapshot";
+      return;
+    }
+  }
+
+  auto nice = GetPriorityClass(proc_handle);
+  r["nice"] = nice != FALSE ? INTEGER(nice) : "-1";
+
+  auto protection = getProcessProtectedType(proc_handle, pid);
+  r["protection_type"] = SQL_TEXT(kProtectedTypes.at(protection));
+
+  bool isProtectedProcess =
+      protection != PS_PROTECTED_TYPE::PsProtectedTypeNone;
+  bool isSecureProcess = false;
+  bool isVirtualProcess = false;
+  {
+    PROCESS_EXTENDED_BASIC_INFORMATION pebi{0};
+    unsigned long len{0};
+    NTSTATUS status = NtQueryInformationProcess(
+        proc_handle, ProcessBasicInformation, &pebi, sizeof(pebi), &len);
+    // Handle return on pre Windows 8.1 and just populate the non extended
+    // ProcessBasicInformation variant
+    if (status == STATUS_INFO_LENGTH_MISMATCH) {
+      status = NtQueryInformationProcess(proc_handle,
+                                         ProcessBasicInformation,
+                                         &pebi.BasicInfo,
+                                         sizeof(pebi.BasicInfo),
+                                         &len);
+    }
+    if (NT_SUCCESS(status)) {
+      isSecureProcess = pebi.s.IsSecureProcess;
+      r["secure_process"] = BIGINT(isSecureProcess);
+      isVirtualProcess = pebi.BasicInfo.PebBaseAddress == NULL;
+      r["virtual_process"] = BIGINT(isVirtualProcess);
+    } else {
+      VLOG(1) << "Failed to query ProcessBasicInformation for pid " << pid
+              << " with " << status;
+    }
+  }
 
+  if (context.isAnyColumnUsed({"path", "on_disk"})) {
+    getProcessPathInfo(proc_handle, pid, r);
+  }
+
+  if (context.isAnyColumnUsed({"cwd", "root"}) && !isProtectedProcess &&
+      !isSecureProcess && !isVirtualProcess) {
+    getProcessCurrentDirectoryInfo(proc_handle, pid, r);
+  }
+
+  if (context.isColumnUsed("cmdline") && !isSecureProcess &&
+      !isVirtualProcess) {
+    std::string cmd{""};
+    auto s = getProcessCommandLine(proc_handle, cmd, pid);
+    if (!s.ok()) {
+      s = getProcessCommandLineLegacy(proc_handle, cmd, pid);
+    }
+    r["cmdline"] = cmd;
+  }
+
+  if (context.isAnyColumnUsed({"uid", "gid", "elevated_token"})) {
+    genProcessUserTokenInfo(proc_handle, r);
+  }
+
+  /*
+   * Note: On windows the concept of the process state isn't as clear as on
+   * posix. The state value from WMI isn't currently returning anything, and
+   * the most common way to get the state is as follows.
+   */
+  if (context.isColumnUsed("state")) {
+    unsigned long exit_code = 0;
+    GetExitCodeProcess(proc_handle, &exit_code);
+    r["state"] = exit_code == STILL_ACTIVE ? "STILL_ACTIVE" : "EXITED";
+  }
+}
+
+TableRows genProcesses(QueryContext& context) {
   // Check for pid filtering in constraints.
   // We use a list here, but sqlite3 will usually call this with
   // a single pid for each item in JOIN or IN() list.
@@ -555,39 +788,40 @@ TableRows genProcesses(QueryContext& context) {
     }
   }
 
-  auto proc_snap = CreateToolhelp32Snapshot(TH32CS_SNAPALL, NULL);
-  auto const proc_snap_manager =
-      scope_guard::create([&proc_snap]() { CloseHandle(proc_snap); });
-  if (proc_snap == INVALID_HANDLE_VALUE) {
-    LOG(ERROR) << "Failed to create snapshot of processes with "
-               << std::to_string(GetLastError());
+  std::vector<BYTE> snapshot;
+  auto status = getProcessSnapshot(snapshot);
+  if (!status.ok()) {
+    LOG(ERROR) << status.getMessage();
     return {};
   }
 
-  PROCESSENTRY32W proc;
-  proc.dwSize = sizeof(PROCESSENTRY32W);
-
-  auto ret = Process32FirstW(proc_snap, &proc);
-  if (ret == FALSE) {
-    LOG(ERROR) << "Failed to acquire first process information with "
-               << std::to_string(GetLastError());
-    return {};
-  }
+  struct OpenedProcess {
+    size_t row;
+    unsigned long pid;
+    LONGLONG create_time;
+  };
 
-  while (ret != FALSE) {
-    auto pid = proc.th32ProcessID;
+  std::vector<DynamicTableRowHolder> rows;
+  std::vector<OpenedProcess> opened;
+  forEachSnapshotProcess(snapshot, [&](const SYSTEM_PROCESS_INFORMATION& info) {
+    auto pid = getSnapshotProcessId(info);
 
     bool wanted_pid = (pidlist.empty() || pidlist.count(pid) > 0);
     if (!wanted_pid) {
-      ret = Process32NextW(proc_snap, &proc);
-      continue;
+      return;
     }
 
     auto r = make_table_row();
     r["pid"] = BIGINT(pid);
-    r["parent"] = BIGINT(proc.th32ParentProcessID);
-    r["name"] = SQL_TEXT(wstringToString(proc.szExeFile));
-    r["threads"] = INTEGER(proc.cntThreads);
+    r["parent"] = BIGINT(reinterpret_cast<ULONG_PTR>(
+        info.InheritedFromUniqueProcessId));
+    if (info.ImageName.Buffer != nullptr) {
+      r["name"] = SQL_TEXT(wstringToString(std::wstring(
+          info.ImageName.Buffer, info.ImageName.Length / sizeof(WCHAR))));
+    } else {
+      r["name"] = SQL_TEXT(pid == 0 ? "[System Process]" : "");
+    }
+    r["threads"] = INTEGER(info.NumberOfThreads);
 
     // Set default values for columns, in the event opening the process fails
     r["pgroup"] = BIGINT(-1);
@@ -618,138 +852,31 @@ TableRows genProcesses(QueryContext& context) {
     r["protection_type"] = SQL_TEXT("");
     r["virtual_process"] = BIGINT(-1);
 
-    if (pid == 0) {
-      results.push_back(r);
-      ret = Process32NextW(proc_snap, &proc);
-      continue;
-    }
-
-    auto proc_handle = OpenProcess(PROCESS_ALL_ACCESS, FALSE, pid);
-    auto const proc_handle_manager =
-        scope_guard::create([&proc_handle]() { CloseHandle(proc_handle); });
-
-    // If we fail to get all privs, open with less permissions
-    if (proc_handle == NULL) {
-      proc_handle = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+    if (pid != 0) {
+      genProcessSnapshotInfo(info, r);
+      opened.push_back({rows.size(), pid, info.CreateTime.QuadPart});
     }
+    rows.push_back(std::move(r));
+  });
 
-    if (proc_handle == NULL) {
-      VLOG(1) << "Failed to open handle to process " << pid << " with "
-              << GetLastError();
-      results.push_back(r);
-      ret = Process32NextW(proc_snap, &proc);
-      continue;
-    }
-
-    auto nice = GetPriorityClass(proc_handle);
-    r["nice"] = nice != FALSE ? INTEGER(nice) : "-1";
-
-    auto protection = getProcessProtectedType(proc_handle, pid);
-    r["protection_type"] = SQL_TEXT(kProtectedTypes.at(protection));
-
-    bool isProtectedProcess =
-        protection != PS_PROTECTED_TYPE::PsProtectedTypeNone;
-    bool isSecureProcess = false;
-    bool isVirtualProcess = false;
-    {
-      PROCESS_EXTENDED_BASIC_INFORMATION pebi{0};
-      unsigned long len{0};
-      NTSTATUS status = NtQueryInformationProcess(
-          proc_handle, ProcessBasicInformation, &pebi, sizeof(pebi), &len);
-      // Handle return on pre Windows 8.1 and just populate the non extended
-      // ProcessBasicInformation variant
-      if (status == STATUS_INFO_LENGTH_MISMATCH) {
-        status = NtQueryInformationProcess(proc_handle,
-                                           ProcessBasicInformation,
-                                           &pebi.BasicInfo,
-                                           sizeof(pebi.BasicInfo),
-                                           &len);
-      }
-      if (NT_SUCCESS(status)) {
-        isSecureProcess = pebi.s.IsSecureProcess;
-        r["secure_process"] = BIGINT(isSecureProcess);
-        isVirtualProcess = pebi.BasicInfo.PebBaseAddress == NULL;
-        r["virtual_process"] = BIGINT(isVirtualProcess);
-      } else {
-        VLOG(1) << "Failed to query ProcessBasicInformation for pid "
-                << proc.th32ProcessID << " with " << status;
-      }
-    }
-
-    if (context.isAnyColumnUsed({"path", "on_disk"})) {
-      getProcessPathInfo(proc_handle, pid, r);
-    }
-
-    if (context.isAnyColumnUsed({"cwd", "root"}) && !isProtectedProcess &&
-        !isSecureProcess && !isVirtualProcess) {
-      getProcessCurrentDirectoryInfo(proc_handle, pid, r);
-    }
-
-    if (context.isColumnUsed("cmdline") && !isSecureProcess &&
-        !isVirtualProcess) {
-      std::string cmd{""};
-      auto s = getProcessCommandLine(
-          proc_handle, cmd, static_cast<unsigned long>(proc.th32ProcessID));
-      if (!s.ok()) {
-        s = getProcessCommandLineLegacy(
-            proc_handle, cmd, static_cast<unsigned long>(proc.th32ProcessID));
-      }
-      r["cmdline"] = cmd;
-    }
-
-    if (context.isAnyColumnUsed({"uid", "gid", "elevated_token"})) {
-      genProcessUserTokenInfo(proc_handle, r);
-    }
-
-    if (context.isAnyColumnUsed({"user_time",
-                                 "system_time",
-                                 "start_time",
-                                 "elapsed_time",
-                                 "percent_processor_time"})) {
-      genProcessTimeInfo(proc_handle, r);
-    }
-
-    if (context.isAnyColumnUsed(
-            {"wired_size", "resident_size", "total_size"})) {
-      genProcRssInfo(proc_handle, r);
-    }
-
-    if (context.isAnyColumnUsed({"disk_bytes_read", "disk_bytes_written"})) {
-      IO_COUNTERS io_ctrs;
-      ret = GetProcessIoCounters(proc_handle, &io_ctrs);
-      r["disk_bytes_read"] =
-          ret == TRUE ? BIGINT(io_ctrs.ReadTransferCount) : BIGINT(-1);
-      r["disk_bytes_written"] =
-          ret == TRUE ? BIGINT(io_ctrs.WriteTransferCount) : BIGINT(-1);
-    }
-
-    if (context.isColumnUsed("handle_count")) {
-      unsigned long handle_count;
-      ret = GetProcessHandleCount(proc_handle, &handle_count);
-      r["handle_count"] = ret == TRUE ? INTEGER(handle_count) : "-1";
-    }
-
-    /*
-     * Note: On windows the concept of the process state isn't as clear as on
-     * posix. The state value from WMI isn't currently returning anything, and
-     * the most common way to get the state is as follows.
-     */
-    if (context.isColumnUsed("state")) {
-      unsigned long exit_code = 0;
-      GetExitCodeProcess(proc_handle, &exit_code);
-      r["state"] = exit_code == STILL_ACTIVE ? "STILL_ACTIVE" : "EXITED";
-    }
+  // Only the columns of an opened process need a call per process, they
+  // are read on the workers.
+  if (context.isAnyColumnUsed(kProcessHandleColumns)) {
+    runProcessTasks(opened.size(), [&](size_t i) {
+      const auto& process = opened[i];
+      genProcessHandleInfo(
+          context, process.pid, process.create_time, rows[process.row]);
+    });
+  }
 
+  TableRows results;
+  for (auto& r : rows) {
     results.push_back(r);
-    ret = Process32NextW(proc_snap, &proc);
   }
-
   return results;
 }
 
-QueryData genProcessMemoryMap(QueryContext& context) {
-  QueryData results;
-
+void genProcessMemoryMap(RowYield& yield, QueryContext& context) {
   std::set<long> pidlist;
   if (context.constraints.count("pid") > 0 &&
       context.constraints.at("pid").exists(EQUALS)) {
@@ -763,14 +890,18 @@ QueryData genProcessMemoryMap(QueryContext& context) {
     getProcList(pidlist);
   }
 
+  // Rows are yielded per process, only one process's map is held.
+  QueryData results;
   for (const auto& pid : pidlist) {
     auto s = genMemoryMap(pid, results);
     if (!s.ok()) {
       VLOG(1) << s.getMessage();
     }
+    for (auto& r : results) {
+      yield(TableRowHolder(new DynamicTableRow(std::move(r))));
+    }
+    results.clear();
   }
-
-  return results;
 }
 
 } // namespace tables
@@ -13,22 +13,29 @@
 #include <sddl.h>
 // clang-format on
 
+#include <atomic>
+#include <condition_variable>
+#include <functional>
 #include <iterator>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include <boost/algorithm/hex.hpp>
 #include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
-#include <boost/range/adaptor/map.hpp>
-#include <boost/range/algorithm.hpp>
 
 #include <sqlite3.h>
 
 #include <osquery/core/core.h>
+#include <osquery/core/flags.h>
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
+#include <osquery/sql/dynamic_table_row.h>
 #include <osquery/sql/sql.h>
 
 #include <osquery/utils/conversions/join.h>
@@ -36,6 +43,7 @@
 #include <osquery/utils/conversions/tryto.h>
 #include <osquery/utils/conversions/windows/strings.h>
 #include <osquery/utils/conversions/windows/windows_time.h>
+#include <osquery/utils/scope_guard.h>
 
 #include <osquery/sql/sqlite_util.h>
 #include <osquery/tables/system/windows/registry.h>
@@ -43,6 +51,12 @@
 namespace fs = boost::filesystem;
 
 namespace osquery {
+
+FLAG(uint32,
+     registry_query_workers,
+     4,
+     "Threads enumerating registry keys for a registry table query");
+
 namespace tables {
 
 auto closeRegHandle = [](HKEY handle) { RegCloseKey(handle); };
@@ -84,7 +98,8 @@ const std::vector<std::string> kClassKeys = {
 const std::vector<std::string> kClassExecSubKeys = {
     "InProcServer%", "InProcHandler%", "LocalServer%"};
 
-QueryData genRegistry(QueryContext& context);
+static void genRegistryRows(QueryContext& context,
+                            const std::function<void(Row&)>& emit);
 
 Status queryMultipleRegistryKeys(const std::vector<std::string>& keys,
                                  QueryData& results) {
@@ -94,7 +109,8 @@ Status queryMultipleRegistryKeys(const std::vector<std::string>& keys,
     qc.constraints["key"].add(c);
   }
 
-  results = genRegistry(qc);
+  results.clear();
+  genRegistryRows(qc, [&results](Row& r) { results.push_back(std::move(r)); });
   return Status::success();
 }
 
@@ -106,7 +122,8 @@ Status queryMultipleRegistryPaths(const std::vector<std::string>& paths,
     qc.constraints["path"].add(c);
   }
 
-  results = genRegistry(qc);
+  results.clear();
+  genRegistryRows(qc, [&results](Row& r) { results.push_back(std::move(r)); });
   return Status::success();
 }
 
@@ -214,29 +231,278 @@ inline void explodeRegistryPath(const std::string& path,
   }
 }
 
-/// Microsoft helper function for getting the contents of a registry key
-Status queryKey(const std::string& keyPath, QueryData& results) {
+namespace {
+
+/// Registry keys opened with a parent, the predefined keys are never closed.
+using RegistryHandle = std::shared_ptr<HKEY__>;
+
+/// Accepts the names of the rows returned for a key, no filter accepts all.
+using RegistryNameFilter = std::function<bool(const std::string& name)>;
+
+/// A key found by a glob expansion, open while its handle is kept.
+struct RegistryKey {
+  std::string path;
+  RegistryHandle handle;
+};
+
+using RegistryKeys = std::vector<RegistryKey>;
+
+/// Expanded keys held open, the others are opened again from their hive.
+const size_t kRegMaxOpenKeys = 4096;
+
+/// Subkey names are at most 255 characters.
+const DWORD kRegMaxKeyLength = 256;
+
+/// Keys of the pending enumerations, per worker, yielded in order.
+const size_t kRegQueuedKeysPerWorker = 16;
+
+RegistryHandle openRegistryHive(const std::string& hive) {
+  auto it = kRegistryHives.find(hive);
+  if (it == kRegistryHives.end()) {
+    return nullptr;
+  }
+  return RegistryHandle(it->second, [](HKEY) {});
+}
+
+LONG openRegistrySubkey(const RegistryHandle& parent,
+                        const std::string& subkey,
+                        RegistryHandle& handle) {
+  HKEY hkey;
+  auto ret = RegOpenKeyExW(
+      parent.get(), stringToWstring(subkey).c_str(), 0, KEY_READ, &hkey);
+  if (ret != ERROR_SUCCESS) {
+    return ret;
+  }
+
+  handle.reset(hkey, closeRegHandle);
+  return ERROR_SUCCESS;
+}
+
+/// Open a key from the predefined key of its hive.
+LONG openRegistryKey(const std::string& path, RegistryHandle& handle) {
   std::string hive;
   std::string key;
-  explodeRegistryPath(keyPath, hive, key);
+  explodeRegistryPath(path, hive, key);
 
-  if (kRegistryHives.count(hive) != 1) {
+  auto root = openRegistryHive(hive);
+  if (root == nullptr) {
+    return ERROR_FILE_NOT_FOUND;
+  }
+  return openRegistrySubkey(root, key, handle);
+}
+
+/// Only the subkey names, without the values of the key.
+LONG enumerateRegistrySubkeys(HKEY handle, std::vector<std::string>& names) {
+  DWORD subkey_count = 0;
+  auto ret = RegQueryInfoKeyW(handle,
+                              nullptr,
+                              nullptr,
+                              nullptr,
+                              &subkey_count,
+                              nullptr,
+                              nullptr,
+                              nullptr,
+                              nullptr,
+                              nullptr,
+                              nullptr,
+                              nullptr);
+  if (ret != ERROR_SUCCESS) {
+    return ret;
+  }
+
+  WCHAR name[kRegMaxKeyLength];
+  for (DWORD i = 0; i < subkey_count; i++) {
+    DWORD name_length = kRegMaxKeyLength;
+    ret = RegEnumKeyExW(
+        handle, i, name, &name_length, nullptr, nullptr, nullptr, nullptr);
+    if (ret == ERROR_NO_MORE_ITEMS) {
+      // Subkeys were deleted since the count.
+      break;
+    }
+    if (ret != ERROR_SUCCESS) {
+      return ret;
+    }
+    names.push_back(wstringToString(name));
+  }
+  return ERROR_SUCCESS;
+}
+
+/**
+ * @brief Run a task for each index on a bounded set of threads.
+ *
+ * The calling thread takes part, the tasks run on it alone when no thread
+ * can be started.
+ */
+void runRegistryTasks(size_t count, const std::function<void(size_t)>& task) {
+  std::atomic<size_t> next{0};
+  auto worker = [&next, &task, count]() {
+    for (auto i = next++; i < count; i = next++) {
+      task(i);
+    }
+  };
+
+  auto thread_count = std::min<size_t>(
+      std::max<std::uint32_t>(FLAGS_registry_query_workers, 1), count);
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < thread_count; ++i) {
+    try {
+      threads.emplace_back(worker);
+    } catch (const std::system_error& e) {
+      LOG(ERROR) << "Cannot start a registry worker: " << e.what();
+      break;
+    }
+  }
+
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+/**
+ * @brief Replace the keys with their subkeys matching one pattern element.
+ *
+ * An element without a wildcard is opened directly. Otherwise the subkey
+ * names are matched with LIKE before they are opened, the subtrees that
+ * cannot match the pattern are not visited.
+ */
+Status expandRegistryLevel(RegistryKeys& keys, const std::string& elem) {
+  auto glob = elem.find(kSQLGlobWildcard) != std::string::npos;
+  std::vector<RegistryKeys> children(keys.size());
+  std::vector<LONG> errors(keys.size(), ERROR_SUCCESS);
+
+  runRegistryTasks(keys.size(), [&](size_t i) {
+    auto& key = keys[i];
+    if (key.handle == nullptr) {
+      errors[i] = openRegistryKey(key.path, key.handle);
+      if (errors[i] != ERROR_SUCCESS) {
+        return;
+      }
+    }
+
+    if (!glob) {
+      RegistryHandle handle;
+      if (openRegistrySubkey(key.handle, elem, handle) == ERROR_SUCCESS) {
+        children[i].push_back({key.path + kRegSep + elem, std::move(handle)});
+      }
+      return;
+    }
+
+    std::vector<std::string> names;
+    errors[i] = enumerateRegistrySubkeys(key.handle.get(), names);
+    for (const auto& name : names) {
+      if (sqlite3_strlike(elem.c_str(), name.c_str(), 0) != 0) {
+        continue;
+      }
+
+      RegistryHandle handle;
+      if (openRegistrySubkey(key.handle, name, handle) == ERROR_SUCCESS) {
+        children[i].push_back({key.path + kRegSep + name, std::move(handle)});
+      }
+    }
+  });
+
+  RegistryKeys expanded;
+  Status status;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    if (errors[i] != ERROR_SUCCESS && errors[i] != ERROR_FILE_NOT_FOUND &&
+        status.ok()) {
+      status = Status(errors[i], "Failed to enumerate registry key");
+    }
+    std::move(children[i].begin(),
+              children[i].end(),
+              std::back_inserter(expanded));
+  }
+  keys = std::move(expanded);
+  return status;
+}
+
+/// Add every subkey of the keys, keeping a bounded number of them open.
+Status expandRegistryRecursive(RegistryKeys& keys) {
+  auto open_keys = keys.size();
+  auto level = keys;
+  Status status;
+  for (size_t depth = 1; !level.empty(); ++depth) {
+    if (depth > kRegMaxRecursiveDepth) {
+      return Status(1, "Max recursive depth reached");
+    }
+
+    auto level_status = expandRegistryLevel(level, kSQLGlobWildcard);
+    if (status.ok()) {
+      status = level_status;
+    }
+
+    for (const auto& key : level) {
+      if (open_keys < kRegMaxOpenKeys) {
+        keys.push_back(key);
+        ++open_keys;
+      } else {
+        keys.push_back({key.path, nullptr});
+      }
+    }
+  }
+  return status;
+}
+
+/**
+ * @brief Expand a pattern, the keys cannot be reached are skipped.
+ *
+ * The first failure is returned once all the other keys are expanded.
+ */
+Status expandRegistryKeys(const std::string& pattern, RegistryKeys& keys) {
+  keys.clear();
+  auto pathElems = osquery::split(pattern, kRegSep);
+  if (pathElems.size() == 0) {
     return Status::success();
   }
 
-  HKEY hkey;
-  auto ret = RegOpenKeyExW(kRegistryHives.at(hive),
-                           stringToWstring(key).c_str(),
-                           0,
-                           KEY_READ,
-                           &hkey);
+  // The hives are matched as the first element of the pattern.
+  const auto& first = pathElems.front();
+  if (first.find(kSQLGlobWildcard) != std::string::npos) {
+    for (const auto& hive : kRegistryHives) {
+      if (sqlite3_strlike(first.c_str(), hive.first.c_str(), 0) == 0) {
+        keys.push_back({hive.first, openRegistryHive(hive.first)});
+      }
+    }
+  } else if (kRegistryHives.count(first) > 0) {
+    keys.push_back({first, openRegistryHive(first)});
+  }
 
-  if (ret != ERROR_SUCCESS) {
-    return Status(ret, "Failed to open registry handle");
+  /*
+   * Pattern is '%%', grab everything.
+   * Note that if '%%' is present but not at the end of the pattern,
+   * then it is treated like a single glob.
+   */
+  if (boost::ends_with(first, kSQLGlobRecursive) && pathElems.size() == 1) {
+    return expandRegistryRecursive(keys);
   }
 
-  reg_handle_t hRegistryHandle(hkey, closeRegHandle);
+  Status status;
+  for (size_t i = 1; i < pathElems.size() && !keys.empty(); ++i) {
+    const auto& elem = pathElems[i];
+    // We only care about  a recursive glob if it comes at the end of the
+    // pattern i.e. 'HKEY_LOCAL_MACHINE\SOFTWARE\%%'
+    if (boost::ends_with(elem, kSQLGlobRecursive) &&
+        i + 1 == pathElems.size()) {
+      auto recursive_status = expandRegistryRecursive(keys);
+      return status.ok() ? recursive_status : status;
+    }
+
+    auto level_status = expandRegistryLevel(keys, elem);
+    if (status.ok()) {
+      status = level_status;
+    }
+  }
+  return status;
+}
+
+} // namespace
 
+/// Microsoft helper function for getting the contents of a registry key
+static Status queryKeyHandle(HKEY handle,
+                             const std::string& keyPath,
+                             const RegistryNameFilter& filter,
+                             QueryData& results) {
   const DWORD maxKeyLength = 255;
   const DWORD maxValueName = 16383;
   DWORD cSubKeys;
@@ -245,7 +511,7 @@ Status queryKey(const std::string& keyPath, QueryData& results) {
   DWORD cbMaxValueData;
   DWORD retCode;
   FILETIME ftLastWriteTime;
-  retCode = RegQueryInfoKeyW(hRegistryHandle.get(),
+  retCode = RegQueryInfoKeyW(handle,
                              nullptr,
                              nullptr,
                              nullptr,
@@ -267,7 +533,7 @@ Status queryKey(const std::string& keyPath, QueryData& results) {
   if (cSubKeys > 0) {
     for (DWORD i = 0; i < cSubKeys; i++) {
       cbName = maxKeyLength;
-      retCode = RegEnumKeyExW(hRegistryHandle.get(),
+      retCode = RegEnumKeyExW(handle,
                               i,
                               achKey.get(),
                               &cbName,
@@ -279,10 +545,15 @@ Status queryKey(const std::string& keyPath, QueryData& results) {
         return Status(retCode, "Failed to enumerate registry key");
       }
 
+      auto name = wstringToString(achKey.get());
+      if (filter && !filter(name)) {
+        continue;
+      }
+
       Row r;
       r["key"] = keyPath;
       r["type"] = "subkey";
-      r["name"] = wstringToString(achKey.get());
+      r["name"] = name;
       r["path"] = keyPath + kRegSep + wstringToString(achKey.get());
       r["mtime"] = std::to_string(osquery::filetimeToUnixtime(ftLastWriteTime));
       r["data"] = "";
@@ -303,7 +574,7 @@ Status queryKey(const std::string& keyPath, QueryData& results) {
     cchValue = maxValueName;
     achValue[0] = L'\0';
 
-    retCode = RegEnumValueW(hRegistryHandle.get(),
+    retCode = RegEnumValueW(handle,
                             static_cast<DWORD>(i),
                             achValue.get(),
                             &cchValue,
@@ -315,10 +586,16 @@ Status queryKey(const std::string& keyPath, QueryData& results) {
       return Status(retCode, "Failed to enumerate registry values");
     }
 
+    auto name = (achValue[0] == L'\0') ? kDefaultRegName
+                                        : wstringToString(achValue.get());
+    if (filter && !filter(name)) {
+      continue;
+    }
+
     DWORD lpData = cbMaxValueData;
     DWORD lpType;
 
-    retCode = RegQueryValueExW(hRegistryHandle.get(),
+    retCode = RegQueryValueExW(handle,
                                achValue.get(),
                                nullptr,
                                &lpType,
@@ -337,8 +614,7 @@ Status queryKey(const std::string& keyPath, QueryData& results) {
 
     Row r;
     r["key"] = keyPath;
-    r["name"] = ((achValue[0] == L'\0') ? "(Default)"
-                                        : wstringToString(achValue.get()));
+    r["name"] = name;
     r["path"] = keyPath + kRegSep + wstringToString(achValue.get());
     if (kRegistryTypes.count(lpType) > 0) {
       r["type"] = kRegistryTypes.at(lpType);
@@ -413,170 +689,241 @@ Status queryKey(const std::string& keyPath, QueryData& results) {
   return Status::success();
 }
 
-static inline void populateDefaultKeys(std::set<std::string>& rKeys) {
-  boost::copy(kRegistryHives | boost::adaptors::map_keys,
-              std::inserter(rKeys, rKeys.end()));
-}
+Status queryKey(const std::string& keyPath, QueryData& results) {
+  std::string hive;
+  std::string key;
+  explodeRegistryPath(keyPath, hive, key);
 
-inline Status populateSubkeys(std::set<std::string>& rKeys, bool replaceKeys) {
-  std::set<std::string> newKeys;
-  if (!replaceKeys) {
-    newKeys = rKeys;
+  if (kRegistryHives.count(hive) != 1) {
+    return Status::success();
   }
 
-  for (const auto& key : rKeys) {
-    QueryData regResults;
-    auto ret = queryKey(key, regResults);
-    if (!ret.ok()) {
-      if (ret.getCode() == ERROR_FILE_NOT_FOUND) {
-        continue;
-      }
-
-      return ret;
-    }
-    for (const auto& r : regResults) {
-      if (r.at("type") == "subkey") {
-        newKeys.insert(r.at("path"));
-      }
-    }
+  RegistryHandle handle;
+  auto ret = openRegistryKey(keyPath, handle);
+  if (ret != ERROR_SUCCESS) {
+    return Status(ret, "Failed to open registry handle");
   }
-  rKeys = std::move(newKeys);
-  return Status::success();
+
+  return queryKeyHandle(handle.get(), keyPath, nullptr, results);
 }
 
-static inline void appendSubkeyToKeys(const std::string& subkey,
-                                      std::set<std::string>& rKeys) {
-  std::set<std::string> newKeys{};
-  for (auto& key : rKeys) {
-    newKeys.insert(std::move(key) + kRegSep + subkey);
+inline Status populateSubkeys(std::set<std::string>& rKeys, bool replaceKeys) {
+  RegistryKeys keys;
+  for (const auto& key : rKeys) {
+    keys.push_back({key, nullptr});
   }
-  rKeys = std::move(newKeys);
-}
 
-static inline Status populateAllKeysRecursive(
-    std::set<std::string>& rKeys,
-    size_t currDepth = 1,
-    size_t maxDepth = kRegMaxRecursiveDepth) {
-  if (currDepth > maxDepth) {
-    return Status(1, "Max recursive depth reached");
+  auto status = expandRegistryLevel(keys, kSQLGlobWildcard);
+  if (!status.ok()) {
+    return status;
   }
 
-  auto size_pre = rKeys.size();
-  auto ret = populateSubkeys(rKeys);
-  if (!ret.ok()) {
-    return ret;
+  if (replaceKeys) {
+    rKeys.clear();
   }
-  if (size_pre < rKeys.size()) {
-    auto status = populateAllKeysRecursive(rKeys, ++currDepth);
-    if (!status.ok()) {
-      return status;
-    }
+  for (auto& key : keys) {
+    rKeys.insert(std::move(key.path));
   }
-
   return Status::success();
 }
 
 Status expandRegistryGlobs(const std::string& pattern,
                            std::set<std::string>& results) {
   results.clear();
-  auto pathElems = osquery::split(pattern, kRegSep);
-  if (pathElems.size() == 0) {
-    return Status::success();
+
+  RegistryKeys keys;
+  auto status = expandRegistryKeys(pattern, keys);
+  for (auto& key : keys) {
+    results.insert(std::move(key.path));
   }
+  return status;
+}
 
-  /*
-   * Pattern is '%%', grab everything.
-   * Note that if '%%' is present but not at the end of the pattern,
-   * then it is treated like a single glob.
-   */
-  if (boost::ends_with(pathElems[0], kSQLGlobRecursive) &&
-      pathElems.size() == 1) {
-    populateDefaultKeys(results);
-    return populateAllKeysRecursive(results);
+static inline void maybeWarnLocalUsers(
+    const std::map<std::string, RegistryHandle>& rKeys) {
+  std::string hive, _;
+  for (const auto& key : rKeys) {
+    explodeRegistryPath(key.first, hive, _);
+    if (hive == "HKEY_CURRENT_USER" ||
+        hive == "HKEY_CURRENT_USER_LOCAL_SETTINGS") {
+      LOG(WARNING) << "CURRENT_USER hives are not queryable by osqueryd; "
+                      "query HKEY_USERS with the desired users SID instead";
+      break;
+    }
   }
+}
 
-  // Special handling to insert default keys when glob present in first elem
-  if (pathElems[0].find(kSQLGlobWildcard) != std::string::npos) {
-    populateDefaultKeys(results);
-    pathElems.erase(pathElems.begin());
-  } else {
-    results.insert(pathElems[0]);
-    pathElems.erase(pathElems.begin());
+/**
+ * @brief The names accepted by the `name` equality and LIKE constraints.
+ *
+ * A name is kept when any of the constraints accepts it, SQLite filters the
+ * rows again. There is no filter when another operator constrains the name.
+ */
+static RegistryNameFilter getRegistryNameFilter(QueryContext& context) {
+  auto it = context.constraints.find("name");
+  if (it == context.constraints.end() || it->second.getAll().empty()) {
+    return nullptr;
   }
 
-  for (auto&& elem = pathElems.begin(); elem != pathElems.end(); ++elem) {
-    // We only care about  a recursive glob if it comes at the end of the
-    // pattern i.e. 'HKEY_LOCAL_MACHINE\SOFTWARE\%%'
-    if (boost::ends_with(*elem, kSQLGlobRecursive) &&
-        *elem == pathElems.back()) {
-      return populateAllKeysRecursive(results);
-    } else if ((*elem).find(kSQLGlobWildcard) != std::string::npos) {
-      auto ret = populateSubkeys(results, true);
-      if (!ret.ok()) {
-        return ret;
+  auto constraints = it->second.getAll();
+  for (const auto& constraint : constraints) {
+    if (constraint.op != EQUALS && constraint.op != LIKE) {
+      return nullptr;
+    }
+  }
+
+  return [constraints](const std::string& name) {
+    for (const auto& constraint : constraints) {
+      if (constraint.op == EQUALS
+              ? constraint.expr == name
+              : sqlite3_strlike(constraint.expr.c_str(), name.c_str(), 0) ==
+                    0) {
+        return true;
       }
-    } else {
-      appendSubkeyToKeys(*elem, results);
     }
+    return false;
+  };
+}
+
+static void addRegistryKeys(const std::string& pattern,
+                            std::map<std::string, RegistryHandle>& keys) {
+  RegistryKeys expanded;
+  auto status = expandRegistryKeys(pattern, expanded);
+  for (auto& key : expanded) {
+    keys.emplace(std::move(key.path), std::move(key.handle));
+  }
+  if (!status.ok()) {
+    LOG(INFO) << "Failed to expand globs: " + status.getMessage();
   }
-  return Status::success();
 }
 
-static inline void maybeWarnLocalUsers(const std::set<std::string>& rKeys) {
-  std::string hive, _;
-  for (const auto& key : rKeys) {
-    explodeRegistryPath(key, hive, _);
-    if (hive == "HKEY_CURRENT_USER" ||
-        hive == "HKEY_CURRENT_USER_LOCAL_SETTINGS") {
-      LOG(WARNING) << "CURRENT_USER hives are not queryable by osqueryd; "
-                      "query HKEY_USERS with the desired users SID instead";
+/**
+ * @brief Enumerate the keys on the registry workers, emitting rows in order.
+ *
+ * The rows of a key are emitted once the keys before it are done. Workers
+ * stay at most kRegQueuedKeysPerWorker keys each ahead of the caller, and
+ * finish their current key if the caller stops early.
+ */
+static void queryRegistryKeys(RegistryKeys& keys,
+                              const RegistryNameFilter& filter,
+                              const std::function<void(Row&)>& emit) {
+  auto queryOne = [&keys, &filter](size_t i, QueryData& rows) {
+    auto handle = std::move(keys[i].handle);
+    if (handle != nullptr ||
+        openRegistryKey(keys[i].path, handle) == ERROR_SUCCESS) {
+      queryKeyHandle(handle.get(), keys[i].path, filter, rows);
+    }
+  };
+
+  struct PendingKey {
+    bool done{false};
+    QueryData rows;
+  };
+
+  std::vector<PendingKey> pending(keys.size());
+  std::mutex mutex;
+  std::condition_variable cv;
+  size_t next = 0;
+  size_t consumed = 0;
+  bool stop = false;
+
+  auto thread_count = std::min<size_t>(
+      std::max<std::uint32_t>(FLAGS_registry_query_workers, 1), keys.size());
+  auto window = thread_count * kRegQueuedKeysPerWorker;
+
+  auto worker = [&]() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      cv.wait(lock, [&]() {
+        return stop || next >= keys.size() || next < consumed + window;
+      });
+      if (stop || next >= keys.size()) {
+        return;
+      }
+
+      auto i = next++;
+      lock.unlock();
+      QueryData rows;
+      queryOne(i, rows);
+      lock.lock();
+
+      pending[i].rows = std::move(rows);
+      pending[i].done = true;
+      cv.notify_all();
+    }
+  };
+
+  std::vector<std::thread> threads;
+  auto const threads_guard = scope_guard::create([&]() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stop = true;
+    }
+    cv.notify_all();
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  });
+
+  for (size_t i = 0; i < thread_count; ++i) {
+    try {
+      threads.emplace_back(worker);
+    } catch (const std::system_error& e) {
+      LOG(ERROR) << "Cannot start a registry worker: " << e.what();
       break;
     }
   }
+
+  for (size_t i = 0; i < keys.size(); ++i) {
+    QueryData rows;
+    if (threads.empty()) {
+      queryOne(i, rows);
+    } else {
+      std::unique_lock<std::mutex> lock(mutex);
+      cv.wait(lock, [&]() { return pending[i].done; });
+      rows = std::move(pending[i].rows);
+      consumed = i + 1;
+      cv.notify_all();
+    }
+
+    for (auto& r : rows) {
+      emit(r);
+    }
+  }
 }
 
-QueryData genRegistry(QueryContext& context) {
-  QueryData results;
-  std::set<std::string> keys;
+static void genRegistryRows(QueryContext& context,
+                            const std::function<void(Row&)>& emit) {
+  std::map<std::string, RegistryHandle> keys;
 
   if (!(context.hasConstraint("key", EQUALS) ||
         context.hasConstraint("key", LIKE) ||
         context.hasConstraint("path", EQUALS) ||
         context.hasConstraint("path", LIKE))) {
     // We default to display all HIVEs
-    expandRegistryGlobs(kSQLGlobWildcard, keys);
+    addRegistryKeys(kSQLGlobWildcard, keys);
   } else {
     if (context.hasConstraint("key", EQUALS)) {
-      keys = context.constraints["key"].getAll(EQUALS);
+      for (const auto& key : context.constraints["key"].getAll(EQUALS)) {
+        keys.emplace(key, nullptr);
+      }
     }
     if (context.hasConstraint("key", LIKE)) {
       for (const auto& key : context.constraints["key"].getAll(LIKE)) {
-        std::set<std::string> keys_like;
-        auto status = expandRegistryGlobs(key, keys_like);
-        keys.insert(keys_like.begin(), keys_like.end());
-        if (!status.ok()) {
-          LOG(INFO) << "Failed to expand globs: " + status.getMessage();
-        }
+        addRegistryKeys(key, keys);
       }
     }
     if (context.hasConstraint("path", EQUALS)) {
       for (const auto& path : context.constraints["path"].getAll(EQUALS)) {
-        keys.insert(path.substr(0, path.find_last_of(kRegSep)));
+        keys.emplace(path.substr(0, path.find_last_of(kRegSep)), nullptr);
       }
     }
     if (context.hasConstraint("path", LIKE)) {
       for (const auto& path : context.constraints["path"].getAll(LIKE)) {
-        Status status;
-        std::set<std::string> path_like;
         if (boost::ends_with(path, kSQLGlobRecursive)) {
-          status = expandRegistryGlobs(path, path_like);
+          addRegistryKeys(path, keys);
         } else {
-          status = expandRegistryGlobs(
-              path.substr(0, path.find_last_of(kRegSep)), path_like);
-        }
-        keys.insert(path_like.begin(), path_like.end());
-        if (!status.ok()) {
-          LOG(INFO) << "Failed to expand globs: " + status.getMessage();
+          addRegistryKeys(path.substr(0, path.find_last_of(kRegSep)), keys);
         }
       }
     }
@@ -584,10 +931,20 @@ QueryData genRegistry(QueryContext& context) {
 
   maybeWarnLocalUsers(keys);
 
-  for (const auto& key : keys) {
-    queryKey(key, results);
+  RegistryKeys ordered;
+  ordered.reserve(keys.size());
+  for (auto& key : keys) {
+    ordered.push_back({key.first, std::move(key.second)});
   }
-  return results;
+  keys.clear();
+
+  queryRegistryKeys(ordered, getRegistryNameFilter(context), emit);
+}
+
+void genRegistry(RowYield& yield, QueryContext& context) {
+  genRegistryRows(context, [&yield](Row& r) {
+    yield(TableRowHolder(new DynamicTableRow(std::move(r))));
+  });
 }
 } // namespace tables
 } // namespace osquery
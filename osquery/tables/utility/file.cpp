@@ -18,11 +18,16 @@
 #include <osquery/utils/conversions/windows/strings.h>
 #endif
 
+#include <functional>
+#include <vector>
+
+#include <osquery/core/sql/scan_slice.h>
 #include <osquery/core/system.h>
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/fileops.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
+#include <osquery/sql/dynamic_table_row.h>
 #include <osquery/utils/scope_guard.h>
 #include <osquery/worker/ipc/platform_table_container_ipc.h>
 #include <osquery/worker/logging/glog/glog_logger.h>
@@ -34,6 +39,10 @@ namespace osquery {
 namespace tables {
 
 namespace {
+
+/// Receives each generated row, so rows may be streamed or collected.
+using FileRowCallback = std::function<void(Row& r)>;
+
 #ifdef WIN32
 
 /* These are the number of bytes to read from the ShellLinkHeader structure
@@ -201,68 +210,84 @@ const std::map<fs::file_type, std::string> kTypeNames{
 };
 #endif
 
-std::set<std::string> getPathsFromConstraints(const QueryContext& context) {
-  auto constraint_it = context.constraints.find("path");
+} // namespace
 
-  if (constraint_it == context.constraints.end()) {
-    return {};
-  }
+/// A file to generate a row for, and the directory reported with it.
+struct FileTarget {
+  fs::path path;
+  fs::path parent;
 
-  auto paths = constraint_it->second.getAll(EQUALS);
-  context.expandConstraints(
-      "path",
-      LIKE,
-      paths,
-      ([&](const std::string& pattern, std::set<std::string>& out) {
-        std::vector<std::string> patterns;
-        auto status =
-            resolveFilePattern(pattern, patterns, GLOB_ALL | GLOB_NO_CANON);
-        if (status.ok()) {
-          for (const auto& resolved : patterns) {
-            out.insert(resolved);
-          }
-        }
-        return status;
-      }));
+  /// Shortcut data is only read for the files requested by path.
+  bool shortcut{false};
+};
 
-  return paths;
-}
+/// The files of the path and directory constraints, within a sliced scan.
+std::vector<FileTarget> getFileTargets(QueryContext& context) {
+  std::vector<FileTarget> targets;
+
+  // Rows SQLite would discard for their path or directory are not generated.
+  ConstraintMatcher path_matcher;
+  auto path_constraint = context.constraints.find("path");
+  if (path_constraint != context.constraints.end()) {
+    path_matcher = ConstraintMatcher(path_constraint->second);
+  }
+  ConstraintMatcher directory_matcher;
+  auto directory_constraint = context.constraints.find("directory");
+  if (directory_constraint != context.constraints.end()) {
+    directory_matcher = ConstraintMatcher(directory_constraint->second);
+  }
 
-std::set<std::string> getDirsFromConstraints(const QueryContext& context) {
-  auto constraint_it = context.constraints.find("directory");
+  // Resolve file paths for EQUALS and LIKE operations.
+  auto paths =
+      resolveConstraintPaths(context, "path", GLOB_ALL | GLOB_NO_CANON);
 
-  if (constraint_it == context.constraints.end()) {
-    return {};
+  // Iterate through each of the resolved/supplied paths.
+  for (const auto& path_string : paths) {
+    fs::path path = path_string;
+    if (directory_matcher.matches(path.parent_path().string())) {
+      targets.push_back({path, path.parent_path(), true});
+    }
   }
 
-  auto directories = constraint_it->second.getAll(EQUALS);
-  context.expandConstraints(
-      "directory",
-      LIKE,
-      directories,
-      ([&](const std::string& pattern, std::set<std::string>& out) {
-        std::vector<std::string> patterns;
-        auto status =
-            resolveFilePattern(pattern, patterns, GLOB_FOLDERS | GLOB_NO_CANON);
-        if (status.ok()) {
-          for (const auto& resolved : patterns) {
-            out.insert(resolved);
-          }
+  // Resolve directories for EQUALS and LIKE operations.
+  auto directories = resolveConstraintPaths(
+      context, "directory", GLOB_FOLDERS | GLOB_NO_CANON);
+
+  // Now loop through constraints using the directory column constraint.
+  for (const auto& directory_string : directories) {
+    // The paths of a directory's files start with it, none may match.
+    if (!path_matcher.mayMatchPrefix(directory_string)) {
+      continue;
+    }
+
+    if (!isReadable(directory_string) || !isDirectory(directory_string)) {
+      continue;
+    }
+
+    try {
+      // Iterate over the directory and generate info for each regular file.
+      fs::directory_iterator begin(directory_string), end;
+      for (; begin != end; ++begin) {
+        if (path_matcher.matches(begin->path().string())) {
+          targets.push_back({begin->path(), directory_string, false});
         }
-        return status;
-      }));
+      }
+    } catch (const fs::filesystem_error& /* e */) {
+      continue;
+    }
+  }
 
-  return directories;
+  ScanSlice::select(
+      targets, [](const FileTarget& target) { return target.path.string(); });
+  return targets;
 }
 
-} // namespace
-
 #ifdef WIN32
 void genFileInfoWindows(const fs::path& path,
                         const fs::path& parent,
                         const std::string& pattern,
                         bool get_shortcut_data,
-                        QueryData& results) {
+                        const FileRowCallback& callback) {
   // Must provide the path, filename, directory separate from boost path->string
   // helpers to match any explicit (query-parsed) predicate constraints.
   Row r;
@@ -314,15 +339,12 @@ void genFileInfoWindows(const fs::path& path,
     }
   }
 
-  results.push_back(r);
+  callback(r);
 }
 
-QueryData genFileWindows(QueryContext& context, Logger& logger) {
-  QueryData results;
-
-  // Resolve file paths for EQUALS and LIKE operations.
-  auto paths = getPathsFromConstraints(context);
-
+void genFileWindows(QueryContext& context,
+                    Logger& logger,
+                    const FileRowCallback& callback) {
   // Only get shortcut data if actually requested
   bool get_shortcut_data = context.isAnyColumnUsed({"shortcut_target_path",
                                                     "shortcut_target_type",
@@ -331,34 +353,13 @@ QueryData genFileWindows(QueryContext& context, Logger& logger) {
                                                     "shortcut_run",
                                                     "shortcut_comment"});
 
-  // Iterate through each of the resolved/supplied paths.
-  for (const auto& path_string : paths) {
-    fs::path path = path_string;
-    genFileInfoWindows(
-        path, path.parent_path(), "", get_shortcut_data, results);
+  for (const auto& target : getFileTargets(context)) {
+    genFileInfoWindows(target.path,
+                       target.parent,
+                       "",
+                       get_shortcut_data && target.shortcut,
+                       callback);
   }
-
-  // Resolve directories for EQUALS and LIKE operations.
-  auto directories = getDirsFromConstraints(context);
-
-  // Now loop through constraints using the directory column constraint.
-  for (const auto& directory_string : directories) {
-    if (!isReadable(directory_string) || !isDirectory(directory_string)) {
-      continue;
-    }
-
-    try {
-      // Iterate over the directory and generate info for each regular file.
-      fs::directory_iterator begin(directory_string), end;
-      for (; begin != end; ++begin) {
-        genFileInfoWindows(begin->path(), directory_string, "", false, results);
-      }
-    } catch (const fs::filesystem_error& /* e */) {
-      continue;
-    }
-  }
-
-  return results;
 }
 
 #else
@@ -366,7 +367,7 @@ QueryData genFileWindows(QueryContext& context, Logger& logger) {
 void genFileInfoPosix(const fs::path& path,
                       const fs::path& parent,
                       const std::string& pattern,
-                      QueryData& results) {
+                      const FileRowCallback& callback) {
   // Must provide the path, filename, directory separate from boost path->string
   // helpers to match any explicit (query-parsed) predicate constraints.
   Row r;
@@ -432,59 +433,48 @@ void genFileInfoPosix(const fs::path& path,
   r["bsd_flags"] = bsd_file_flags_description;
 #endif
 
-  results.push_back(r);
+  callback(r);
 }
 
-QueryData genFilePosix(QueryContext& context, Logger& logger) {
-  QueryData results;
-
-  // Resolve file paths for EQUALS and LIKE operations.
-  auto paths = getPathsFromConstraints(context);
-
-  // Iterate through each of the resolved/supplied paths.
-  for (const auto& path_string : paths) {
-    fs::path path = path_string;
-    genFileInfoPosix(path, path.parent_path(), "", results);
+void genFilePosix(QueryContext& context,
+                  Logger& logger,
+                  const FileRowCallback& callback) {
+  for (const auto& target : getFileTargets(context)) {
+    genFileInfoPosix(target.path, target.parent, "", callback);
   }
-
-  // Resolve directories for EQUALS and LIKE operations.
-  auto directories = getDirsFromConstraints(context);
-
-  // Now loop through constraints using the directory column constraint.
-  for (const auto& directory_string : directories) {
-    if (!isReadable(directory_string) || !isDirectory(directory_string)) {
-      continue;
-    }
-
-    try {
-      // Iterate over the directory and generate info for each regular file.
-      fs::directory_iterator begin(directory_string), end;
-      for (; begin != end; ++begin) {
-        genFileInfoPosix(begin->path(), directory_string, "", results);
-      }
-    } catch (const fs::filesystem_error& /* e */) {
-      continue;
-    }
-  }
-
-  return results;
 }
 #endif
 
-QueryData genFileImpl(QueryContext& context, Logger& logger) {
+void genFileRows(QueryContext& context,
+                 Logger& logger,
+                 const FileRowCallback& callback) {
 #ifdef WIN32
-  return genFileWindows(context, logger);
+  genFileWindows(context, logger, callback);
 #else
-  return genFilePosix(context, logger);
+  genFilePosix(context, logger, callback);
 #endif
 }
 
-QueryData genFile(QueryContext& context) {
+QueryData genFileImpl(QueryContext& context, Logger& logger) {
+  QueryData results;
+  genFileRows(
+      context, logger, [&results](Row& r) { results.push_back(std::move(r)); });
+  return results;
+}
+
+void genFile(RowYield& yield, QueryContext& context) {
   if (hasNamespaceConstraint(context)) {
-    return generateInNamespace(context, "file", genFileImpl);
+    // Rows generated within a container namespace are received at once.
+    auto results = generateInNamespace(context, "file", genFileImpl);
+    for (auto& r : results) {
+      yield(TableRowHolder(new DynamicTableRow(std::move(r))));
+    }
   } else {
+    // Each row is yielded to SQLite as soon as it is generated.
     GLOGLogger logger;
-    return genFileImpl(context, logger);
+    genFileRows(context, logger, [&yield](Row& r) {
+      yield(TableRowHolder(new DynamicTableRow(std::move(r))));
+    });
   }
 }
 } // namespace tables
@@ -11,8 +11,10 @@
 #include <osquery/config/packs.h>
 #include <osquery/core/core.h>
 #include <osquery/core/flags.h>
+#include <osquery/core/query.h>
 #include <osquery/core/system.h>
 #include <osquery/core/tables.h>
+#include <osquery/dispatcher/thread_placement.h>
 #include <osquery/events/eventfactory.h>
 #include <osquery/events/eventpublisher.h>
 #include <osquery/events/eventsubscriber.h>
@@ -20,8 +22,10 @@
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
 #include <osquery/process/process.h>
+#include <osquery/profiler/sampling_profiler.h>
 #include <osquery/registry/registry.h>
 #include <osquery/sql/sql.h>
+#include <osquery/sql/table_execution.h>
 #include <osquery/utils/info/platform_type.h>
 #include <osquery/utils/info/version.h>
 #include <osquery/utils/macros/macros.h>
@@ -30,6 +34,8 @@ namespace osquery {
 
 DECLARE_bool(disable_logging);
 DECLARE_bool(disable_events);
+DECLARE_string(thread_cpus);
+DECLARE_string(thread_priorities);
 
 namespace tables {
 
@@ -49,12 +55,15 @@ QueryData genOsqueryEvents(QueryContext& context) {
       r["events"] = INTEGER(pubref->numEvents());
       r["refreshes"] = INTEGER(pubref->restartCount());
       r["active"] = (pubref->hasStarted() && !pubref->isEnding()) ? "1" : "0";
+      r["dropped"] = BIGINT(pubref->numDroppedEvents());
     } else {
       r["subscriptions"] = "0";
       r["events"] = "0";
       r["refreshes"] = "0";
       r["active"] = "-1";
+      r["dropped"] = "0";
     }
+    r["lag"] = "0";
     results.push_back(r);
   }
 
@@ -74,10 +83,14 @@ QueryData genOsqueryEvents(QueryContext& context) {
 
       // Subscribers are always active, even if their publisher is not.
       r["active"] = (subref->state() == EventState::EVENT_RUNNING) ? "1" : "0";
+      r["dropped"] = BIGINT(subref->numDroppedEvents());
+      r["lag"] = BIGINT(subref->eventLag());
     } else {
       r["subscriptions"] = "0";
       r["events"] = "0";
       r["active"] = "-1";
+      r["dropped"] = "0";
+      r["lag"] = "0";
     }
     results.push_back(r);
   }
@@ -231,6 +244,35 @@ QueryData genOsqueryInfo(QueryContext& context) {
   return results;
 }
 
+QueryData genOsqueryThreadClasses(QueryContext& context) {
+  QueryData results;
+  for (const auto& usage : getThreadClassUsage()) {
+    Row r;
+    r["name"] = threadClassName(usage.thread_class);
+    r["cpus"] = getThreadClassSetting(FLAGS_thread_cpus, usage.thread_class);
+    r["priority"] =
+        getThreadClassSetting(FLAGS_thread_priorities, usage.thread_class);
+    r["threads"] = INTEGER(usage.threads);
+    r["started"] = BIGINT(usage.started);
+    r["cpu_time"] = BIGINT(usage.cpu_time);
+    results.push_back(std::move(r));
+  }
+  return results;
+}
+
+QueryData genOsqueryProfile(QueryContext& context) {
+  QueryData results;
+  for (const auto& sample : getProfileSamples()) {
+    Row r;
+    r["query"] = sample.query;
+    r["stage"] = getProfileStageName(sample.stage);
+    r["stack"] = sample.stack;
+    r["samples"] = BIGINT(sample.samples);
+    results.push_back(std::move(r));
+  }
+  return results;
+}
+
 QueryData genOsquerySchedule(QueryContext& context) {
   QueryData results;
 
@@ -253,6 +295,13 @@ QueryData genOsquerySchedule(QueryContext& context) {
         r["last_system_time"] = "0";
         r["average_memory"] = "0";
         r["last_memory"] = "0";
+        r["rows"] = "0";
+        r["last_rows"] = "0";
+        r["last_rows_per_second"] = "0";
+        r["average_result_bytes"] = "0";
+        r["last_result_bytes"] = "0";
+        r["last_table_filters"] = "0";
+        r["last_rows_generated"] = "0";
         r["last_executed"] = "0";
 
         // Report optional performance information.
@@ -270,12 +319,138 @@ QueryData genOsquerySchedule(QueryContext& context) {
               r["last_system_time"] = BIGINT(perf.last_system_time);
               r["average_memory"] = BIGINT(perf.average_memory);
               r["last_memory"] = BIGINT(perf.last_memory);
+              r["rows"] = BIGINT(perf.rows);
+              r["last_rows"] = BIGINT(perf.last_rows);
+              if (perf.last_wall_time_ms > 0) {
+                r["last_rows_per_second"] =
+                    DOUBLE(perf.last_rows * 1000.0 / perf.last_wall_time_ms);
+              }
+              r["average_result_bytes"] = BIGINT(perf.average_result_bytes);
+              r["last_result_bytes"] = BIGINT(perf.last_result_bytes);
             });
 
+        QueryTableExecution execution;
+        if (TableExecution::get().getQuery(name, execution)) {
+          uint64_t filters = 0;
+          uint64_t rows_generated = 0;
+          for (const auto& table : execution.last) {
+            filters += table.second.filters;
+            rows_generated += table.second.rows_generated;
+          }
+          r["last_table_filters"] = BIGINT(filters);
+          r["last_rows_generated"] = BIGINT(rows_generated);
+        }
+
         results.push_back(r);
       },
       true);
   return results;
 }
+
+QueryData genOsqueryLastResults(QueryContext& context) {
+  QueryData results;
+
+  // The queries are copied, the results are not read while holding the
+  // config lock. Snapshot queries store no results.
+  std::vector<std::pair<std::string, std::string>> queries;
+  auto names = context.constraints["name"].getAll(EQUALS);
+  Config::get().scheduledQueries(
+      [&queries, &names](const std::string& name, const ScheduledQuery& query) {
+        if (!query.isSnapshotQuery() &&
+            (names.empty() || names.count(name) > 0)) {
+          queries.emplace_back(name, query.query);
+        }
+      });
+
+  for (const auto& query : queries) {
+    ScheduledQuery scheduled("", query.first, query.second);
+    QueryDataTyped rows;
+    QueryState state;
+    if (!Query(query.first, scheduled).getStoredResults(rows, state).ok()) {
+      continue;
+    }
+
+    // The rows are the latest results if the last run returned as many, the
+    // differential of some queries does not store them.
+    uint64_t last_executed = 0;
+    auto stored = true;
+    Config::get().getPerformanceStats(
+        query.first, [&](const QueryPerformance& perf) {
+          last_executed = perf.last_executed;
+          stored = perf.executions == 0 || perf.last_rows == rows.size();
+        });
+    if (!stored) {
+      continue;
+    }
+
+    for (size_t i = 0; i < rows.size(); ++i) {
+      Row r;
+      r["name"] = query.first;
+      r["query"] = query.second;
+      r["last_executed"] = BIGINT(last_executed);
+      r["epoch"] = BIGINT(state.epoch);
+      r["counter"] = BIGINT(state.counter);
+      r["row_index"] = BIGINT(i);
+      serializeRowJSON(rows[i], r["result"], true);
+      results.push_back(std::move(r));
+    }
+  }
+  return results;
+}
+
+QueryData genOsqueryTableStats(QueryContext& context) {
+  QueryData results;
+
+  std::vector<std::string> queries;
+  auto names = context.constraints["name"].getAll(EQUALS);
+  Config::get().scheduledQueries(
+      [&queries, &names](const std::string& name, const ScheduledQuery&) {
+        if (names.empty() || names.count(name) > 0) {
+          queries.push_back(name);
+        }
+      },
+      true);
+
+  for (const auto& name : queries) {
+    QueryTableExecution execution;
+    if (!TableExecution::get().getQuery(name, execution)) {
+      continue;
+    }
+
+    for (const auto& table : execution.total) {
+      const auto& total = table.second;
+      Row r;
+      r["name"] = name;
+      r["table_name"] = table.first;
+      r["executions"] = BIGINT(execution.executions);
+      r["filters"] = BIGINT(total.filters);
+      r["rows_generated"] = BIGINT(total.rows_generated);
+      r["rows_returned"] = BIGINT(total.rows_returned);
+      r["generate_time_ms"] = BIGINT(total.generate_time_us / 1000);
+
+      // A table may not be scanned by every execution.
+      TableExecutionStats last;
+      auto it = execution.last.find(table.first);
+      if (it != execution.last.end()) {
+        last = it->second;
+      }
+      r["last_filters"] = BIGINT(last.filters);
+      r["last_rows_generated"] = BIGINT(last.rows_generated);
+      r["last_rows_returned"] = BIGINT(last.rows_returned);
+      r["last_generate_time_ms"] = BIGINT(last.generate_time_us / 1000);
+
+      std::string shapes;
+      for (const auto& shape : total.shapes) {
+        if (!shapes.empty()) {
+          shapes += ';';
+        }
+        shapes += shape;
+      }
+      r["shapes"] = std::move(shapes);
+      results.push_back(std::move(r));
+    }
+  }
+  return results;
+}
 } // namespace tables
 } // namespace osquery
@@ -164,6 +164,34 @@ TEST_F(YARATest, test_match_string_false) {
   EXPECT_TRUE(r["count"] == "0");
 }
 
+TEST_F(YARATest, test_shared_rules) {
+  int result = yr_initialize();
+  EXPECT_TRUE(result == ERROR_SUCCESS);
+
+  auto first = compileFromString(alwaysTrue);
+  auto second = compileFromString(alwaysTrue);
+  ASSERT_TRUE(first.isValue());
+  ASSERT_TRUE(second.isValue());
+
+  // Each compilation has its own identity, it moves with the rules.
+  auto first_rules = std::make_shared<YaraRulesHandle>(first.take());
+  auto second_rules = std::make_shared<YaraRulesHandle>(second.take());
+  EXPECT_NE(first_rules->id(), second_rules->id());
+
+  // A reference keeps the rules after they are replaced.
+  YARAConfigParserPlugin parser;
+  parser.setRules("group", first_rules);
+  auto used = parser.getRules("group");
+  parser.setRules("group", second_rules);
+  first_rules.reset();
+  ASSERT_NE(used, nullptr);
+  EXPECT_NE(used->get(), nullptr);
+  EXPECT_EQ(parser.getRules("group")->id(), second_rules->id());
+
+  parser.removeRules("group");
+  EXPECT_EQ(parser.getRules("group"), nullptr);
+}
+
 TEST_F(YARATest, test_rule_compilation_failures) {
   int result = yr_initialize();
   EXPECT_TRUE(result == ERROR_SUCCESS);
@@ -12,14 +12,18 @@
 
 #include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
+#include <atomic>
+#include <list>
 #include <regex>
 #include <thread>
+#include <unordered_map>
 
 #ifdef LINUX
 #include <malloc.h>
 #endif
 
 #include <osquery/core/flags.h>
+#include <osquery/core/sql/scan_slice.h>
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/hashing/hashing.h>
@@ -52,6 +56,17 @@ FLAG(uint32,
      "Time in ms to sleep after scan of each file (default 50) to reduce "
      "memory spikes");
 
+FLAG(uint32,
+     yara_scan_workers,
+     0,
+     "Threads scanning the files of a yara query, 0 or 1 scans on the "
+     "query's thread");
+
+FLAG(uint32,
+     yara_scan_cache_max,
+     500,
+     "Size of the LRU cache of yara scan results, 0 disables the cache");
+
 HIDDEN_FLAG(bool,
             enable_yara_string,
             false,
@@ -68,6 +83,88 @@ using YARAConfigParser = std::shared_ptr<YARAConfigParserPlugin>;
 
 using YaraScanContext = std::set<std::pair<YaraRuleType, std::string>>;
 
+/// The compiled rules of a scan context entry.
+struct YaraScanTarget {
+  YaraRuleType type;
+  std::string sign;
+
+  /// The reference keeps the rules while a config update replaces them.
+  YaraRulesRef rules;
+
+  /// Identifies the results of these rules in the scan cache.
+  std::string identity;
+};
+
+/**
+ * @brief The rows of recent scans, by rules identity and path.
+ *
+ * A row is used while the file's device, inode, mtime, ctime and size are
+ * unchanged. The least recently used rows are evicted past
+ * yara_scan_cache_max.
+ */
+class YaraScanCache {
+ public:
+  bool get(const std::string& key, const std::string& version, Row& row);
+
+  void put(const std::string& key, const std::string& version, const Row& row);
+
+ private:
+  struct Entry {
+    std::string version;
+    Row row;
+
+    /// The position of the key in the use order.
+    std::list<std::string>::iterator use;
+  };
+
+ private:
+  Mutex mutex_;
+
+  /// The keys by use, the most recently used first.
+  std::list<std::string> uses_;
+
+  std::unordered_map<std::string, Entry> entries_;
+};
+
+bool YaraScanCache::get(const std::string& key,
+                        const std::string& version,
+                        Row& row) {
+  WriteLock lock(mutex_);
+  auto it = entries_.find(key);
+  if (it == entries_.end() || it->second.version != version) {
+    return false;
+  }
+
+  uses_.splice(uses_.begin(), uses_, it->second.use);
+  row = it->second.row;
+  return true;
+}
+
+void YaraScanCache::put(const std::string& key,
+                        const std::string& version,
+                        const Row& row) {
+  WriteLock lock(mutex_);
+  auto it = entries_.find(key);
+  if (it != entries_.end()) {
+    uses_.splice(uses_.begin(), uses_, it->second.use);
+    it->second.version = version;
+    it->second.row = row;
+    return;
+  }
+
+  uses_.push_front(key);
+  entries_[key] = {version, row, uses_.begin()};
+  while (entries_.size() > FLAGS_yara_scan_cache_max && !uses_.empty()) {
+    entries_.erase(uses_.back());
+    uses_.pop_back();
+  }
+}
+
+static YaraScanCache& getYaraScanCache() {
+  static YaraScanCache cache;
+  return cache;
+}
+
 // Check if the YARAConfigParser is nullptr
 static inline bool isNull(std::shared_ptr<ConfigParserPlugin> parser) {
   return (parser == nullptr) || (parser.get() == nullptr);
@@ -153,13 +250,11 @@ Status getRuleFromURL(const std::string& url, std::string& rule) {
   return Status::success();
 }
 
-void doYARAScan(YR_RULES* rules,
+bool doYARAScan(YR_RULES* rules,
                 const std::string& path,
-                QueryData& results,
+                Row& row,
                 YaraRuleType yr_type,
                 const std::string& sigfile) {
-  Row row;
-
   // These are default values, to be updated in YARACallback.
   row["count"] = INTEGER(0);
   row["matches"] = SQL_TEXT("");
@@ -194,9 +289,38 @@ void doYARAScan(YR_RULES* rules,
   // Perform the scan, using the static YARA subscriber callback.
   int result = yr_rules_scan_file(
       rules, path.c_str(), SCAN_FLAGS_FAST_MODE, YARACallback, (void*)&row, 0);
-  if (result == ERROR_SUCCESS) {
-    results.push_back(std::move(row));
+  return result == ERROR_SUCCESS;
+}
+
+/// Scan a file unless its row is cached, returns false if the scan failed.
+bool scanFile(const YaraScanTarget& target,
+              const std::string& path,
+              Row& row) {
+  auto& cache = getYaraScanCache();
+  auto key = target.identity + "|" + path;
+  std::string version;
+
+  struct stat st;
+  auto cacheable =
+      FLAGS_yara_scan_cache_max > 0 && stat(path.c_str(), &st) == 0;
+  if (cacheable) {
+    version = std::to_string(st.st_dev) + ":" + std::to_string(st.st_ino) +
+              ":" + std::to_string(st.st_mtime) + ":" +
+              std::to_string(st.st_ctime) + ":" + std::to_string(st.st_size);
+    if (cache.get(key, version, row)) {
+      return true;
+    }
+  }
+
+  auto scanned =
+      doYARAScan(target.rules->get(), path, row, target.type, target.sign);
+  if (scanned && cacheable) {
+    cache.put(key, version, row);
   }
+
+  // sleep between each file to help smooth out malloc spikes
+  std::this_thread::sleep_for(std::chrono::milliseconds(FLAGS_yara_delay));
+  return scanned;
 }
 
 Status getYaraRules(YARAConfigParser parser,
@@ -207,13 +331,11 @@ Status getYaraRules(YARAConfigParser parser,
     return Status::failure("YARA config parser plugin is null");
   }
 
-  auto& rules_map = parser->rules();
-
   // Compile signature string and add them to the scan context
   for (const auto& sign : signature_set) {
     // Check if the signature string has been used/compiled
     const auto signature_hash = hashStr(sign, sign_type);
-    if (rules_map.count(signature_hash) > 0) {
+    if (parser->getRules(signature_hash) != nullptr) {
       context.insert(std::make_pair(sign_type, sign));
       continue;
     }
@@ -275,7 +397,8 @@ Status getYaraRules(YARAConfigParser parser,
     // Cache the compiled rules by setting the unique hashed signature
     // string as the lookup name. Additional signature file uses will
     // skip the compile step and be added to the scan context
-    rules_map.insert_or_assign(signature_hash, std::move(handle));
+    parser->setRules(signature_hash,
+                     std::make_shared<YaraRulesHandle>(std::move(handle)));
     context.insert(std::make_pair(sign_type, sign));
   }
 
@@ -373,24 +496,58 @@ QueryData genYaraImpl(QueryContext& context, Logger& logger) {
         return status;
       }));
 
-  // Scan every path pair with the yara rules
-  auto& rules = yaraParser->rules();
-  for (const auto& path : paths) {
-    for (const auto& sign : scanContext) {
-      auto hash = hashStr(sign.second, sign.first);
-      auto rules_it = rules.find(hash);
-      if (rules_it != rules.end()) {
-        doYARAScan(rules_it->second.get(),
-                   path.c_str(),
-                   results,
-                   sign.first,
-                   sign.second);
-
-        // sleep between each file to help smooth out malloc spikes
-        std::this_thread::sleep_for(
-            std::chrono::milliseconds(FLAGS_yara_delay));
+  // Hold the rules of the scan context for the duration of the scans.
+  std::vector<YaraScanTarget> targets;
+  for (const auto& sign : scanContext) {
+    auto hash = hashStr(sign.second, sign.first);
+    auto rules = yaraParser->getRules(hash);
+    if (rules == nullptr) {
+      continue;
+    }
+
+    // A rule string is identified by its content, other rules by their
+    // compilation, a config update or a new download invalidates results.
+    auto identity = std::to_string(sign.first) + ":" + hash;
+    if (sign.first != YC_RULE) {
+      identity += ":" + std::to_string(rules->id());
+    }
+    targets.push_back({sign.first, sign.second, std::move(rules), identity});
+  }
+
+  // Scan every path pair with the yara rules, rows keep the path order.
+  std::vector<std::string> path_list(paths.begin(), paths.end());
+  ScanSlice::select(path_list, [](const std::string& path) -> const auto& {
+    return path;
+  });
+  auto scans = path_list.size() * targets.size();
+  std::vector<Row> rows(scans);
+  std::vector<char> scanned(scans, 0);
+
+  std::atomic<size_t> next{0};
+  auto worker = [&]() {
+    for (auto i = next++; i < scans; i = next++) {
+      const auto& path = path_list[i / targets.size()];
+      if (scanFile(targets[i % targets.size()], path, rows[i])) {
+        scanned[i] = 1;
       }
     }
+  };
+
+  auto workers = std::min(static_cast<size_t>(FLAGS_yara_scan_workers), scans);
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < workers; i++) {
+    threads.emplace_back(worker);
+  }
+  worker();
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  for (size_t i = 0; i < scans; i++) {
+    if (scanned[i] != 0) {
+      results.push_back(std::move(rows[i]));
+    }
   }
 
   // Rule string is hashed before adding to the cache. There are
@@ -399,11 +556,7 @@ QueryData genYaraImpl(QueryContext& context, Logger& logger) {
   // Also cleanup the cache block if rules are downloaded from url
   for (const auto& sign : scanContext) {
     if (sign.first == YC_RULE || sign.first == YC_URL) {
-      auto hash = hashStr(sign.second, sign.first);
-      auto it = rules.find(hash);
-      if (it != rules.end()) {
-        rules.erase(hash);
-      }
+      yaraParser->removeRules(hashStr(sign.second, sign.first));
     }
   }
 
@@ -163,8 +163,6 @@ Status YARAEventSubscriber::Callback(const FileEventContextRef& ec,
     return Status(1, "Yara parser unknown.");
   }
 
-  const auto& rules = yaraParser->rules();
-
   // Use the category as a lookup into the yara file_paths. The value will be
   // a list of signature groups to scan with.
   auto category = r.at("category");
@@ -175,15 +173,15 @@ Status YARAEventSubscriber::Callback(const FileEventContextRef& ec,
     for (const auto& rule : group_iter->value.GetArray()) {
       std::string group = rule.GetString();
 
-      auto rule_it = rules.find(group);
-
-      if (rule_it == rules.end()) {
+      // The reference keeps the rules while a config update replaces them.
+      auto rules = yaraParser->getRules(group);
+      if (rules == nullptr) {
         VLOG(1) << "Yara rules group " + group + " not found, skipping it";
 
         continue;
       }
 
-      int result = yr_rules_scan_file(rule_it->second.get(),
+      int result = yr_rules_scan_file(rules->get(),
                                       ec->path.c_str(),
                                       SCAN_FLAGS_FAST_MODE,
                                       YARACallback,
@@ -245,7 +245,7 @@ YaraCompilerResult compileFromString(const std::string& rule_defs) {
  */
 Status handleRuleFiles(const std::string& category,
                        const rapidjson::Value& rule_files,
-                       std::map<std::string, YaraRulesHandle>& rules) {
+                       YaraRulesMap& rules) {
   auto compiler_result = createCompiler();
 
   if (compiler_result.isError()) {
@@ -287,7 +287,8 @@ Status handleRuleFiles(const std::string& category,
     if (result != ERROR_SUCCESS && result != ERROR_INVALID_FILE) {
       return Status(1, "YARA load error " + std::to_string(result));
     } else if (result == ERROR_SUCCESS) {
-      rules.insert_or_assign(category, tmp_rules);
+      rules.insert_or_assign(category,
+                             std::make_shared<YaraRulesHandle>(tmp_rules));
     } else {
       compiled = true;
       // Try to compile the rules.
@@ -328,7 +329,8 @@ Status handleRuleFiles(const std::string& category,
     }
 
     // All the rules for this category have been compiled, save them in the map.
-    rules.insert_or_assign(category, new_rules);
+    rules.insert_or_assign(category,
+                           std::make_shared<YaraRulesHandle>(new_rules));
   }
 
   return Status::success();
@@ -383,6 +385,23 @@ int YARACallback(YR_SCAN_CONTEXT* context,
   return CALLBACK_CONTINUE;
 }
 
+YaraRulesRef YARAConfigParserPlugin::getRules(const std::string& name) const {
+  ReadLock lock(rules_mutex_);
+  auto it = rules_.find(name);
+  return (it != rules_.end()) ? it->second : nullptr;
+}
+
+void YARAConfigParserPlugin::setRules(const std::string& name,
+                                      YaraRulesRef rules) {
+  WriteLock lock(rules_mutex_);
+  rules_.insert_or_assign(name, std::move(rules));
+}
+
+void YARAConfigParserPlugin::removeRules(const std::string& name) {
+  WriteLock lock(rules_mutex_);
+  rules_.erase(name);
+}
+
 Status YARAConfigParserPlugin::setUp() {
   auto obj = data_.getObject();
   data_.add("yara", obj);
@@ -424,11 +443,17 @@ Status YARAConfigParserPlugin::update(const std::string& source,
           VLOG(1) << "YARA signature group " << category << " must be an array";
         } else {
           VLOG(1) << "Compiling YARA signature group: " << category;
-          auto status = handleRuleFiles(category, element.value, rules_);
+          // Rules are compiled without the lock, scans continue meanwhile.
+          YaraRulesMap rules;
+          auto status = handleRuleFiles(category, element.value, rules);
           if (!status.ok()) {
             VLOG(1) << "YARA rule compile error: " << status.getMessage();
             return status;
           }
+
+          for (auto& group : rules) {
+            setRules(group.first, std::move(group.second));
+          }
         }
       }
     }
@@ -9,12 +9,16 @@
 
 #pragma once
 
+#include <atomic>
+#include <memory>
+
 #include <boost/property_tree/ptree.hpp>
 
 #include <osquery/config/config.h>
 #include <osquery/core/tables.h>
 #include <osquery/filesystem/fileops.h>
 #include <osquery/utils/config/default_paths.h>
+#include <osquery/utils/mutex.h>
 
 #ifdef CONCAT
 #undef CONCAT
@@ -31,7 +35,7 @@ const std::string kYARAHome{OSQUERY_HOME "yara/"};
 class YaraRulesHandle {
  public:
   YaraRulesHandle() = delete;
-  YaraRulesHandle(YR_RULES* rules) : rules_(rules) {}
+  YaraRulesHandle(YR_RULES* rules) : rules_(rules), id_(nextId()) {}
   ~YaraRulesHandle() {
     if (rules_) {
       yr_rules_destroy(rules_);
@@ -44,11 +48,13 @@ class YaraRulesHandle {
 
   YaraRulesHandle(YaraRulesHandle&& other) noexcept {
     rules_ = other.rules_;
+    id_ = other.id_;
     other.rules_ = nullptr;
   }
 
   YaraRulesHandle& operator=(YaraRulesHandle&& other) noexcept {
     rules_ = other.rules_;
+    id_ = other.id_;
     other.rules_ = nullptr;
     return *this;
   }
@@ -57,10 +63,29 @@ class YaraRulesHandle {
     return rules_;
   }
 
+  /// A process-unique identity of the compiled rules, never reused.
+  uint64_t id() const {
+    return id_;
+  }
+
+ private:
+  static uint64_t nextId() {
+    static std::atomic<uint64_t> next{0};
+    return ++next;
+  }
+
  private:
   YR_RULES* rules_;
+
+  uint64_t id_;
 };
 
+/// Compiled rules shared by the scans using them, freed after the last use.
+using YaraRulesRef = std::shared_ptr<YaraRulesHandle>;
+
+/// Compiled rules by signature group or signature name.
+using YaraRulesMap = std::map<std::string, YaraRulesRef>;
+
 enum class YaraCompilerError {
   GenericError,
 };
@@ -83,7 +108,7 @@ YaraCompilerResult compileFromString(const std::string& buffer);
 
 Status handleRuleFiles(const std::string& category,
                        const pt::ptree& rule_files,
-                       std::map<std::string, YaraRulesHandle>& rules);
+                       YaraRulesMap& rules);
 
 /**
  * Avoid scanning files that could cause hangs or issues.
@@ -113,10 +138,19 @@ class YARAConfigParserPlugin : public ConfigParserPlugin {
     return {"yara"};
   }
 
-  // Retrieve compiled rules.
-  std::map<std::string, YaraRulesHandle>& rules() {
-    return rules_;
-  }
+  /**
+   * @brief Find compiled rules by group or signature name.
+   *
+   * The rules are shared, they remain valid while the reference is held even
+   * if a config update replaces them. Returns nullptr if there are none.
+   */
+  YaraRulesRef getRules(const std::string& name) const;
+
+  /// Add or replace compiled rules.
+  void setRules(const std::string& name, YaraRulesRef rules);
+
+  /// Remove compiled rules, scans holding a reference may still use them.
+  void removeRules(const std::string& name);
 
   std::set<std::string>& url_allow_set() {
     return url_allow_set_;
@@ -126,7 +160,10 @@ class YARAConfigParserPlugin : public ConfigParserPlugin {
 
  private:
   // Store compiled rules in a map (group => rules).
-  std::map<std::string, YaraRulesHandle> rules_;
+  YaraRulesMap rules_;
+
+  /// Protects the rules, used by the config, queries and event callbacks.
+  mutable Mutex rules_mutex_;
 
   std::set<std::string> url_allow_set_;
 
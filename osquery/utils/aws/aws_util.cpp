@@ -37,6 +37,7 @@
 #include <osquery/core/shutdown.h>
 #include <osquery/logger/data_logger.h>
 #include <osquery/logger/logger.h>
+#include <osquery/remote/metadata_cache.h>
 #include <osquery/utils/aws/aws_util.h>
 #include <osquery/utils/expected/expected.h>
 #include <osquery/utils/json/json.h>
@@ -130,6 +131,12 @@ const std::string kImdsTokenTtlHeader = "x-aws-ec2-metadata-token-ttl-seconds";
 /// Default TTL value for IMDSv2 API token, set as per the AWS SDK
 const std::string kImdsTokenTtlDefaultValue = "21600";
 
+/// The IMDSv2 token is reused, and requested again before it expires.
+const std::chrono::seconds kImdsTokenReuse{21600 - 300};
+
+/// Metadata cache key of the IMDSv2 token
+const std::string kImdsTokenCacheKey = "aws:imds:token";
+
 /// Map of AWS region name to AWS::Region enum.
 static const std::set<std::string> kAwsRegions = {
     "af-south-1",     "ap-south-2",     "ap-east-1",     "ap-northeast-1",
@@ -625,8 +632,7 @@ boost::optional<std::pair<std::string, std::string>> getInstanceIDAndRegion() {
   return {{cached_id, cached_region}};
 }
 
-boost::optional<std::string> getIMDSToken() {
-  std::string token;
+static Status requestIMDSToken(std::string& token) {
   http::Request req(kEc2MetadataUrl + kImdsTokenResource);
   http::Client::Options options;
   options.timeout(3);
@@ -652,7 +658,7 @@ boost::optional<std::string> getIMDSToken() {
         auto should_shutdown =
             osquery::waitTimeoutOrShutdown(std::chrono::seconds(interval));
         if (should_shutdown) {
-          return boost::none;
+          return Status::failure("Shutdown requested");
         }
 
         interval *= FLAGS_aws_imdsv2_request_interval;
@@ -667,12 +673,27 @@ boost::optional<std::string> getIMDSToken() {
   if (attempts == FLAGS_aws_imdsv2_request_attempts) {
     LOG(ERROR) << "Failed " << FLAGS_aws_imdsv2_request_attempts
                << " attempts at retrieving an IMDSv2 token";
-    return boost::none;
+    return Status::failure("Cannot retrieve an IMDSv2 token");
   }
 
+  return Status::success();
+}
+
+boost::optional<std::string> getIMDSToken() {
+  // Concurrent metadata requests share one token request.
+  std::string token;
+  auto status = MetadataCache::get().lookup(
+      kImdsTokenCacheKey, kImdsTokenReuse, requestIMDSToken, token);
+  if (!status.ok()) {
+    return boost::none;
+  }
   return token;
 }
 
+void invalidateIMDSToken() {
+  MetadataCache::get().invalidate(kImdsTokenCacheKey);
+}
+
 Status setAwsClientConfig(const AWSRegion& region,
                           const AWSServiceType service_type,
                           const std::string& endpoint_override,
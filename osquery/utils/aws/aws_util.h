@@ -216,10 +216,16 @@ void initAwsSdk();
  * attempts, with an interval of FLAGS_aws_imdsv2_request_interval, which scales
  * quadratically.
  *
+ * The token is kept in the MetadataCache and requested again shortly before
+ * it expires.
+ *
  * @return token as a string if successful, boost::none if not
  */
 boost::optional<std::string> getIMDSToken();
 
+/// Request a new IMDSv2 token on the next call, after the token was rejected.
+void invalidateIMDSToken();
+
 /**
  * @brief Returns EC2 instance ID and region of this machine.
  *
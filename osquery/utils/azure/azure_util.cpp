@@ -13,6 +13,7 @@
 #include <osquery/core/core.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
+#include <osquery/remote/metadata_cache.h>
 #include <osquery/utils/azure/azure_util.h>
 #include <osquery/utils/info/platform_type.h>
 #include <osquery/utils/json/json.h>
@@ -79,30 +80,43 @@ Status fetchAzureMetadata(JSON& doc) {
     return Status(1, "Not an Azure instance");
   }
 
-  http::Request request(kAzureMetadataEndpoint);
-  http::Client::Options opts;
-  http::Response response;
+  // The Azure tables of a query share one response.
+  std::string body;
+  auto fetch = [](std::string& response_body) {
+    http::Request request(kAzureMetadataEndpoint);
+    http::Client::Options opts;
+    http::Response response;
 
-  opts.timeout(kAzureMetadataTimeout);
-  http::Client client(opts);
+    opts.timeout(kAzureMetadataTimeout);
+    http::Client client(opts);
 
-  request << http::Request::Header("Metadata", "true");
+    request << http::Request::Header("Metadata", "true");
 
-  try {
-    response = client.get(request);
-  } catch (const std::system_error& e) {
-    return Status(
-        1, "Couldn't request " + kAzureMetadataEndpoint + ": " + e.what());
-  }
+    try {
+      response = client.get(request);
+    } catch (const std::system_error& e) {
+      return Status(
+          1, "Couldn't request " + kAzureMetadataEndpoint + ": " + e.what());
+    }
+
+    // Non-200s can indicate a variety of conditions, so report them.
+    if (response.result_int() != 200) {
+      return Status(1,
+                    std::string("Azure metadata service responded with ") +
+                        std::to_string(response.result_int()));
+    }
+
+    response_body = response.body();
+    return Status::success();
+  };
 
-  // Non-200s can indicate a variety of conditions, so report them.
-  if (response.result_int() != 200) {
-    return Status(1,
-                  std::string("Azure metadata service responded with ") +
-                      std::to_string(response.result_int()));
+  auto status = MetadataCache::get().lookup(
+      kAzureMetadataEndpoint, getMetadataCacheTTL(), fetch, body);
+  if (!status.ok()) {
+    return status;
   }
 
-  auto s = doc.fromString(response.body());
+  auto s = doc.fromString(body);
   if (!s.ok()) {
     return s;
   }
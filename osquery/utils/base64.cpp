@@ -9,61 +9,110 @@
 
 #include "base64.h"
 
-#include <boost/algorithm/string.hpp>
-#include <boost/archive/iterators/base64_from_binary.hpp>
-#include <boost/archive/iterators/binary_from_base64.hpp>
-#include <boost/archive/iterators/transform_width.hpp>
+#include <array>
+#include <cstdint>
 
 #include <osquery/logger/logger.h>
 
-namespace bai = boost::archive::iterators;
-
 namespace osquery {
 
 namespace base64 {
 
 namespace {
 
-typedef bai::binary_from_base64<const char*> base64_str;
-typedef bai::transform_width<base64_str, 8, 6> base64_dec;
-typedef bai::transform_width<std::string_view::iterator, 6, 8> base64_enc;
-typedef bai::base64_from_binary<base64_enc> it_base64;
+const char kEncodeTable[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/// Sextet of each character, -1 if the character is not base64.
+const std::array<int8_t, 256> kDecodeTable = []() {
+  std::array<int8_t, 256> table{};
+  table.fill(-1);
+  for (int8_t i = 0; i < 64; ++i) {
+    table[static_cast<unsigned char>(kEncodeTable[i])] = i;
+  }
+  return table;
+}();
 
 } // namespace
 
-std::string decode(std::string encoded) {
-  boost::erase_all(encoded, "\r\n");
-  boost::erase_all(encoded, "\n");
-  boost::trim_right_if(encoded, boost::is_any_of("="));
+std::string decode(const std::string_view encoded) {
+  std::string decoded;
+  decoded.reserve(encoded.size() / 4U * 3U + 3U);
 
-  if (encoded.empty()) {
-    return encoded;
-  }
+  // Newlines are skipped and trailing padding is ignored, padding within the
+  // input decodes as zero bits.
+  uint32_t bits = 0;
+  uint32_t bit_count = 0;
+  size_t padding = 0;
+  auto append = [&](uint32_t sextet) {
+    bits = (bits << 6) | sextet;
+    bit_count += 6;
+    if (bit_count >= 8) {
+      bit_count -= 8;
+      decoded.push_back(static_cast<char>((bits >> bit_count) & 0xFF));
+      bits &= (1U << bit_count) - 1U;
+    }
+  };
+
+  for (size_t i = 0; i < encoded.size(); ++i) {
+    auto c = static_cast<unsigned char>(encoded[i]);
+    if (c == '\n' ||
+        (c == '\r' && i + 1 < encoded.size() && encoded[i + 1] == '\n')) {
+      continue;
+    }
 
-  try {
-    return std::string(base64_dec(encoded.data()),
-                       base64_dec(encoded.data() + encoded.size()));
-  } catch (const boost::archive::iterators::dataflow_exception& e) {
-    LOG(INFO) << "Could not base64 decode string: " << e.what();
-    return "";
+    if (c == '=') {
+      padding++;
+      continue;
+    }
+
+    auto sextet = kDecodeTable[c];
+    if (sextet < 0) {
+      LOG(INFO) << "Could not base64 decode string: invalid character";
+      return "";
+    }
+
+    for (; padding > 0; --padding) {
+      append(0);
+    }
+    append(static_cast<uint32_t>(sextet));
   }
+
+  return decoded;
 }
 
 std::string encode(const std::string_view unencoded) {
-  if (unencoded.empty()) {
-    return {};
+  std::string encoded;
+  encoded.reserve((unencoded.size() + 2U) / 3U * 4U);
+
+  const auto* input = reinterpret_cast<const unsigned char*>(unencoded.data());
+  size_t i = 0;
+  for (; i + 3 <= unencoded.size(); i += 3) {
+    uint32_t group = (static_cast<uint32_t>(input[i]) << 16) |
+                     (static_cast<uint32_t>(input[i + 1]) << 8) | input[i + 2];
+    encoded.push_back(kEncodeTable[(group >> 18) & 0x3F]);
+    encoded.push_back(kEncodeTable[(group >> 12) & 0x3F]);
+    encoded.push_back(kEncodeTable[(group >> 6) & 0x3F]);
+    encoded.push_back(kEncodeTable[group & 0x3F]);
   }
 
-  size_t writePaddChars = (3U - unencoded.length() % 3U) % 3U;
-  try {
-    auto encoded =
-        std::string(it_base64(unencoded.begin()), it_base64(unencoded.end()));
-    encoded.append(writePaddChars, '=');
-    return encoded;
-  } catch (const boost::archive::iterators::dataflow_exception& e) {
-    LOG(INFO) << "Could not base64 encode string: " << e.what();
-    return {};
+  auto remaining = unencoded.size() - i;
+  if (remaining > 0) {
+    uint32_t group = static_cast<uint32_t>(input[i]) << 16;
+    if (remaining == 2) {
+      group |= static_cast<uint32_t>(input[i + 1]) << 8;
+    }
+    encoded.push_back(kEncodeTable[(group >> 18) & 0x3F]);
+    encoded.push_back(kEncodeTable[(group >> 12) & 0x3F]);
+    if (remaining == 2) {
+      encoded.push_back(kEncodeTable[(group >> 6) & 0x3F]);
+    } else {
+      encoded.push_back('=');
+    }
+    encoded.push_back('=');
   }
+
+  return encoded;
 }
 
 } // namespace base64
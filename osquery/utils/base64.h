@@ -10,6 +10,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 
 namespace osquery {
 
@@ -18,10 +19,12 @@ namespace base64 {
 /**
  * @brief Decode a base64 encoded string.
  *
+ * Newlines are skipped, an invalid character decodes as an empty string.
+ *
  * @param encoded The encode base64 string.
  * @return Decoded string.
  */
-std::string decode(std::string encoded);
+std::string decode(const std::string_view encoded);
 
 /**
  * @brief Encode a  string.
@@ -94,6 +94,23 @@ class LRU {
     return map_.find(key) != map_.end();
   }
 
+  /**
+   * @brief Remove an element from the cache.
+   *
+   * @param KeyType key of the element to remove.
+   *
+   * @returns true if the element was in the cache.
+   */
+  bool erase(const KeyType& key);
+
+  /**
+   * @returns the key of the least recently used element, nullptr if the cache
+   * is empty. Method doesn't change the place in the queue.
+   */
+  KeyType const* oldest() const noexcept {
+    return queue_.empty() ? nullptr : &queue_.back();
+  }
+
  private:
   void evict() {
     map_.erase(queue_.back());
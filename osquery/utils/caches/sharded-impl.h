@@ -0,0 +1,256 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <algorithm>
+#include <limits>
+
+namespace osquery {
+namespace caches {
+
+template <typename KeyType, typename ValueType, typename Size, typename Clock>
+ShardedCache<KeyType, ValueType, Size, Clock>::ShardedCache(
+    const ShardedCacheOptions& options, Size entry_size)
+    : ttl_(options.ttl), entry_size_(std::move(entry_size)) {
+  auto shards = std::max<std::size_t>(options.shards, 1);
+  auto unlimited = std::numeric_limits<std::size_t>::max();
+
+  // Limits are divided rounding up, so a small limit still caches entries.
+  shard_capacity_ = options.capacity == 0
+                        ? unlimited
+                        : (options.capacity + shards - 1) / shards;
+  shard_bytes_ = options.max_bytes == 0
+                     ? unlimited
+                     : (options.max_bytes + shards - 1) / shards;
+
+  shards_.reserve(shards);
+  for (std::size_t i = 0; i < shards; ++i) {
+    shards_.push_back(std::make_unique<Shard>(shard_capacity_));
+  }
+}
+
+template <typename KeyType, typename ValueType, typename Size, typename Clock>
+typename ShardedCache<KeyType, ValueType, Size, Clock>::Shard&
+ShardedCache<KeyType, ValueType, Size, Clock>::shardOf(const KeyType& key) {
+  // The shard maps hash the keys again, mix the bits used to select shards.
+  auto hash = std::hash<KeyType>{}(key);
+  hash ^= hash >> 17;
+  hash *= 0x9e3779b97f4a7c15ULL;
+  hash ^= hash >> 29;
+  return *shards_[hash % shards_.size()];
+}
+
+template <typename KeyType, typename ValueType, typename Size, typename Clock>
+void ShardedCache<KeyType, ValueType, Size, Clock>::insert(const KeyType& key,
+                                                           ValueType value,
+                                                           TimeToLive ttl) {
+  auto bytes = entry_size_(key, value);
+  auto& shard = shardOf(key);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  store(shard, key, std::move(value), bytes, ttl);
+}
+
+template <typename KeyType, typename ValueType, typename Size, typename Clock>
+std::optional<ValueType> ShardedCache<KeyType, ValueType, Size, Clock>::get(
+    const KeyType& key) {
+  auto& shard = shardOf(key);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  return lookup(shard, key);
+}
+
+template <typename KeyType, typename ValueType, typename Size, typename Clock>
+std::optional<ValueType>
+ShardedCache<KeyType, ValueType, Size, Clock>::getOrLoad(const KeyType& key,
+                                                         const Loader& load,
+                                                         TimeToLive ttl) {
+  auto& shard = shardOf(key);
+  std::unique_lock<std::mutex> lock(shard.mutex);
+  auto value = lookup(shard, key);
+  if (value) {
+    return value;
+  }
+
+  auto loading = shard.loading.find(key);
+  if (loading != shard.loading.end()) {
+    // Another caller loads the key, its result is shared.
+    auto flight = loading->second;
+    shard.loaded.wait(lock, [&flight]() { return flight->done; });
+    return flight->value;
+  }
+
+  auto flight = std::make_shared<Flight>();
+  shard.loading.emplace(key, flight);
+  lock.unlock();
+
+  std::optional<ValueType> loaded;
+  try {
+    loaded = load(key);
+  } catch (...) {
+    finishLoad(shard, key, flight, std::nullopt);
+    throw;
+  }
+
+  if (loaded) {
+    auto bytes = entry_size_(key, *loaded);
+    lock.lock();
+    store(shard, key, *loaded, bytes, ttl);
+    lock.unlock();
+  }
+  finishLoad(shard, key, flight, loaded);
+  return loaded;
+}
+
+template <typename KeyType, typename ValueType, typename Size, typename Clock>
+void ShardedCache<KeyType, ValueType, Size, Clock>::finishLoad(
+    Shard& shard,
+    const KeyType& key,
+    const std::shared_ptr<Flight>& flight,
+    std::optional<ValueType> value) {
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    ++shard.stats.loads;
+    if (!value) {
+      ++shard.stats.load_failures;
+    }
+    flight->value = std::move(value);
+    flight->done = true;
+    shard.loading.erase(key);
+  }
+  shard.loaded.notify_all();
+}
+
+template <typename KeyType, typename ValueType, typename Size, typename Clock>
+std::optional<ValueType> ShardedCache<KeyType, ValueType, Size, Clock>::lookup(
+    Shard& shard, const KeyType& key) {
+  auto entry = shard.entries.get(key);
+  if (entry == nullptr) {
+    ++shard.stats.misses;
+    return std::nullopt;
+  }
+
+  if (entry->expires <= Clock::now()) {
+    ++shard.stats.misses;
+    ++shard.stats.expirations;
+    remove(shard, key, *entry);
+    return std::nullopt;
+  }
+
+  ++shard.stats.hits;
+  return entry->value;
+}
+
+template <typename KeyType, typename ValueType, typename Size, typename Clock>
+void ShardedCache<KeyType, ValueType, Size, Clock>::store(
+    Shard& shard,
+    const KeyType& key,
+    ValueType value,
+    std::size_t bytes,
+    const TimeToLive& ttl) {
+  auto previous = shard.entries.get(key);
+  if (previous != nullptr) {
+    remove(shard, key, *previous);
+  }
+
+  if (bytes > shard_bytes_) {
+    // The entry alone exceeds the budget, caching it would empty the shard.
+    ++shard.stats.evictions;
+    return;
+  }
+
+  // Room is made before inserting, the LRU itself never evicts.
+  auto now = Clock::now();
+  while (shard.entries.size() >= shard_capacity_ ||
+         (shard.entries.size() > 0 && shard.bytes + bytes > shard_bytes_)) {
+    auto oldest = *shard.entries.oldest();
+    auto entry = shard.entries.get(oldest);
+    if (entry->expires <= now) {
+      ++shard.stats.expirations;
+    } else {
+      ++shard.stats.evictions;
+    }
+    remove(shard, oldest, *entry);
+  }
+
+  auto time_to_live = ttl ? *ttl : ttl_;
+  auto expires = time_to_live.count() > 0 ? now + time_to_live
+                                          : Clock::time_point::max();
+  shard.entries.insert(key, Entry{std::move(value), expires, bytes});
+  shard.bytes += bytes;
+}
+
+template <typename KeyType, typename ValueType, typename Size, typename Clock>
+void ShardedCache<KeyType, ValueType, Size, Clock>::remove(Shard& shard,
+                                                           const KeyType& key,
+                                                           const Entry& entry) {
+  shard.bytes -= entry.bytes;
+  shard.entries.erase(key);
+}
+
+template <typename KeyType, typename ValueType, typename Size, typename Clock>
+bool ShardedCache<KeyType, ValueType, Size, Clock>::erase(const KeyType& key) {
+  auto& shard = shardOf(key);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto entry = shard.entries.get(key);
+  if (entry == nullptr) {
+    return false;
+  }
+  remove(shard, key, *entry);
+  return true;
+}
+
+template <typename KeyType, typename ValueType, typename Size, typename Clock>
+void ShardedCache<KeyType, ValueType, Size, Clock>::clear() {
+  for (auto& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    while (auto oldest = shard->entries.oldest()) {
+      shard->entries.erase(KeyType(*oldest));
+    }
+    shard->bytes = 0;
+  }
+}
+
+template <typename KeyType, typename ValueType, typename Size, typename Clock>
+std::size_t ShardedCache<KeyType, ValueType, Size, Clock>::size() const {
+  std::size_t size = 0;
+  for (const auto& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    size += shard->entries.size();
+  }
+  return size;
+}
+
+template <typename KeyType, typename ValueType, typename Size, typename Clock>
+std::size_t ShardedCache<KeyType, ValueType, Size, Clock>::bytes() const {
+  std::size_t bytes = 0;
+  for (const auto& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    bytes += shard->bytes;
+  }
+  return bytes;
+}
+
+template <typename KeyType, typename ValueType, typename Size, typename Clock>
+CacheStats ShardedCache<KeyType, ValueType, Size, Clock>::takeStats() {
+  CacheStats stats;
+  for (auto& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    stats.hits += shard->stats.hits;
+    stats.misses += shard->stats.misses;
+    stats.loads += shard->stats.loads;
+    stats.load_failures += shard->stats.load_failures;
+    stats.evictions += shard->stats.evictions;
+    stats.expirations += shard->stats.expirations;
+    stats.entries += shard->entries.size();
+    stats.bytes += shard->bytes;
+    shard->stats = CacheStats();
+  }
+  return stats;
+}
+
+} // namespace caches
+} // namespace osquery
@@ -0,0 +1,223 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include <osquery/utils/caches/lru.h>
+
+namespace osquery {
+namespace caches {
+
+/// The activity of a cache since its statistics were last taken.
+struct CacheStats {
+  /// Lookups that found a live entry.
+  std::uint64_t hits{0};
+
+  /// Lookups that found no entry, or an expired one.
+  std::uint64_t misses{0};
+
+  /// Values loaded by getOrLoad, once per key for concurrent callers.
+  std::uint64_t loads{0};
+
+  /// Loads that did not produce a value.
+  std::uint64_t load_failures{0};
+
+  /// Entries removed to respect the capacity or the byte budget.
+  std::uint64_t evictions{0};
+
+  /// Entries removed because their time to live passed.
+  std::uint64_t expirations{0};
+
+  /// The entries currently cached.
+  std::size_t entries{0};
+
+  /// The estimated bytes of the entries currently cached.
+  std::size_t bytes{0};
+};
+
+struct ShardedCacheOptions {
+  /// The number of independently locked shards, at least 1 is used.
+  std::size_t shards{16};
+
+  /// The maximum number of entries, 0 for no limit.
+  std::size_t capacity{0};
+
+  /// The maximum estimated bytes of the entries, 0 for no limit.
+  std::size_t max_bytes{0};
+
+  /// The time to live of entries inserted without one, 0 to never expire.
+  std::chrono::milliseconds ttl{0};
+};
+
+/// The default size estimate of an entry, the size of its key and value.
+template <typename KeyType, typename ValueType>
+struct CacheEntrySize {
+  std::size_t operator()(const KeyType&, const ValueType&) const {
+    return sizeof(KeyType) + sizeof(ValueType);
+  }
+};
+
+/**
+ * @brief A thread-safe LRU cache split into independently locked shards.
+ *
+ * Each shard is an LRU of its keys, callers using different shards do not
+ * contend. The capacity and byte budget are divided between the shards,
+ * the least recently used entries of a shard are evicted first. Entries may
+ * have a time to live, expired entries are removed when they are looked up
+ * or evicted.
+ *
+ * Values are returned as copies, store a shared pointer to share large
+ * values. getOrLoad runs the loader of a missing key once, concurrent
+ * callers of the same key wait for its value.
+ */
+template <typename KeyType_,
+          typename ValueType_,
+          typename EntrySize = CacheEntrySize<KeyType_, ValueType_>,
+          typename Clock = std::chrono::steady_clock>
+class ShardedCache {
+ public:
+  using KeyType = KeyType_;
+  using ValueType = ValueType_;
+  using Loader = std::function<std::optional<ValueType>(const KeyType&)>;
+  using TimeToLive = std::optional<std::chrono::milliseconds>;
+
+  /**
+   * @brief Create a cache.
+   *
+   * @param options the shards, limits and default time to live.
+   * @param entry_size estimates the bytes of an entry for the byte budget.
+   */
+  explicit ShardedCache(const ShardedCacheOptions& options,
+                        EntrySize entry_size = EntrySize());
+
+  ShardedCache(const ShardedCache&) = delete;
+  ShardedCache& operator=(const ShardedCache&) = delete;
+
+  /**
+   * @brief Insert new key and value, replacing the value of an existing key.
+   *
+   * @param ttl the time to live of the entry, the default if not set.
+   */
+  void insert(const KeyType& key, ValueType value, TimeToLive ttl = {});
+
+  /**
+   * @brief Get a copy of the value of a key if it is cached and live.
+   *
+   * @details The successful access makes the entry the most recently used.
+   */
+  std::optional<ValueType> get(const KeyType& key);
+
+  /**
+   * @brief Get the value of a key, loading and caching it if it is missing.
+   *
+   * @details The loader is called without holding a lock, concurrent callers
+   * of the key wait for its result instead of loading it again. A loader
+   * returning no value caches nothing, an exception is thrown to the caller
+   * that loaded the key and the waiting callers receive no value.
+   *
+   * @param ttl the time to live of a loaded entry, the default if not set.
+   */
+  std::optional<ValueType> getOrLoad(const KeyType& key,
+                                     const Loader& load,
+                                     TimeToLive ttl = {});
+
+  /// Remove a key, returns true if it was cached.
+  bool erase(const KeyType& key);
+
+  /// Remove every entry.
+  void clear();
+
+  /// The number of cached entries, including expired ones not yet removed.
+  std::size_t size() const;
+
+  /// The estimated bytes of the cached entries.
+  std::size_t bytes() const;
+
+  /// The activity since the statistics were last taken, and the current size.
+  CacheStats takeStats();
+
+ private:
+  struct Entry {
+    ValueType value;
+    typename Clock::time_point expires;
+    std::size_t bytes{0};
+  };
+
+  /// The load of a key, shared with the callers waiting for it.
+  struct Flight {
+    bool done{false};
+    std::optional<ValueType> value;
+  };
+
+  struct Shard {
+    explicit Shard(std::size_t capacity) : entries(capacity) {}
+
+    std::mutex mutex;
+
+    /// Notified when a load of the shard completes.
+    std::condition_variable loaded;
+
+    LRU<KeyType, Entry> entries;
+
+    /// The keys being loaded.
+    std::unordered_map<KeyType, std::shared_ptr<Flight>> loading;
+
+    std::size_t bytes{0};
+
+    /// The counters since the statistics were last taken.
+    CacheStats stats;
+  };
+
+ private:
+  Shard& shardOf(const KeyType& key);
+
+  /// Look up a live entry, the shard is locked.
+  std::optional<ValueType> lookup(Shard& shard, const KeyType& key);
+
+  /// Insert an entry, evicting as needed, the shard is locked.
+  void store(Shard& shard,
+             const KeyType& key,
+             ValueType value,
+             std::size_t bytes,
+             const TimeToLive& ttl);
+
+  /// Remove an entry, the shard is locked.
+  void remove(Shard& shard, const KeyType& key, const Entry& entry);
+
+  /// Complete the load of a key and wake its waiting callers.
+  void finishLoad(Shard& shard,
+                  const KeyType& key,
+                  const std::shared_ptr<Flight>& flight,
+                  std::optional<ValueType> value);
+
+ private:
+  std::vector<std::unique_ptr<Shard>> shards_;
+
+  /// The limits of each shard.
+  std::size_t shard_capacity_{0};
+  std::size_t shard_bytes_{0};
+
+  std::chrono::milliseconds ttl_;
+  EntrySize entry_size_;
+};
+
+} // namespace caches
+} // namespace osquery
+
+#include <osquery/utils/caches/sharded-impl.h>
@@ -132,5 +132,19 @@ TEST_F(LruCacheTests, pointer_validity_after_insertions) {
   EXPECT_EQ(*ptr_2, "Atlantic");
 }
 
+TEST_F(LruCacheTests, erase) {
+  auto cache = caches::LRU<int, int>(3);
+  cache.insert(1, 20);
+  cache.insert(2, 21);
+  EXPECT_EQ(*cache.oldest(), 1);
+  EXPECT_TRUE(cache.erase(1));
+  EXPECT_FALSE(cache.erase(1));
+  EXPECT_FALSE(cache.has(1));
+  EXPECT_EQ(cache.size(), 1u);
+  EXPECT_EQ(*cache.oldest(), 2);
+  EXPECT_TRUE(cache.erase(2));
+  EXPECT_EQ(cache.oldest(), nullptr);
+}
+
 } // namespace
 } // namespace osquery
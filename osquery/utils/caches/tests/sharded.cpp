@@ -0,0 +1,232 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <osquery/utils/caches/sharded.h>
+
+namespace osquery {
+namespace {
+
+/// A clock the tests advance.
+struct TestClock {
+  using duration = std::chrono::steady_clock::duration;
+  using time_point = std::chrono::steady_clock::time_point;
+
+  static time_point now() {
+    return current;
+  }
+
+  static time_point current;
+};
+
+TestClock::time_point TestClock::current{};
+
+/// Each value is as large as its string.
+struct StringSize {
+  std::size_t operator()(int, const std::string& value) const {
+    return value.size();
+  }
+};
+
+using TimedCache =
+    caches::ShardedCache<int, int, caches::CacheEntrySize<int, int>, TestClock>;
+
+caches::ShardedCacheOptions options(std::size_t shards,
+                                    std::size_t capacity = 0,
+                                    std::size_t max_bytes = 0) {
+  caches::ShardedCacheOptions options;
+  options.shards = shards;
+  options.capacity = capacity;
+  options.max_bytes = max_bytes;
+  return options;
+}
+
+class ShardedCacheTests : public testing::Test {};
+
+TEST_F(ShardedCacheTests, insert_and_get) {
+  caches::ShardedCache<int, std::string> cache(options(4));
+  EXPECT_FALSE(cache.get(1));
+  cache.insert(1, "Arctic");
+  cache.insert(2, "Atlantic");
+  cache.insert(1, "Indian");
+  EXPECT_EQ(cache.size(), 2u);
+  EXPECT_EQ(*cache.get(1), "Indian");
+  EXPECT_EQ(*cache.get(2), "Atlantic");
+
+  EXPECT_TRUE(cache.erase(1));
+  EXPECT_FALSE(cache.erase(1));
+  EXPECT_FALSE(cache.get(1));
+
+  cache.clear();
+  EXPECT_EQ(cache.size(), 0u);
+  EXPECT_EQ(cache.bytes(), 0u);
+}
+
+TEST_F(ShardedCacheTests, capacity_evicts_least_recently_used) {
+  caches::ShardedCache<int, int> cache(options(1, 2));
+  cache.insert(1, 10);
+  cache.insert(2, 20);
+  EXPECT_TRUE(cache.get(1));
+  cache.insert(3, 30);
+  EXPECT_EQ(cache.size(), 2u);
+  EXPECT_TRUE(cache.get(1));
+  EXPECT_FALSE(cache.get(2));
+  EXPECT_TRUE(cache.get(3));
+  EXPECT_EQ(cache.takeStats().evictions, 1u);
+}
+
+TEST_F(ShardedCacheTests, byte_budget) {
+  caches::ShardedCache<int, std::string, StringSize> cache(options(1, 0, 10));
+  cache.insert(1, "aaaa");
+  cache.insert(2, "bbbb");
+  EXPECT_EQ(cache.bytes(), 8u);
+
+  // The oldest entries are evicted until the new one fits.
+  cache.insert(3, "cccccc");
+  EXPECT_FALSE(cache.get(1));
+  EXPECT_TRUE(cache.get(2));
+  EXPECT_EQ(cache.bytes(), 10u);
+
+  // Replacing a value accounts for its new size.
+  cache.insert(2, "b");
+  EXPECT_EQ(cache.bytes(), 7u);
+
+  // An entry larger than the budget is not cached.
+  cache.insert(4, std::string(11, 'd'));
+  EXPECT_FALSE(cache.get(4));
+  EXPECT_EQ(cache.size(), 2u);
+}
+
+TEST_F(ShardedCacheTests, time_to_live) {
+  auto cache_options = options(2);
+  cache_options.ttl = std::chrono::seconds(10);
+  TimedCache cache(cache_options);
+
+  cache.insert(1, 10);
+  cache.insert(2, 20, std::chrono::seconds(30));
+  cache.insert(3, 30, std::chrono::milliseconds::zero());
+
+  TestClock::current += std::chrono::seconds(20);
+  EXPECT_FALSE(cache.get(1));
+  EXPECT_EQ(*cache.get(2), 20);
+  EXPECT_EQ(*cache.get(3), 30);
+
+  TestClock::current += std::chrono::seconds(20);
+  EXPECT_FALSE(cache.get(2));
+  EXPECT_EQ(*cache.get(3), 30);
+
+  auto stats = cache.takeStats();
+  EXPECT_EQ(stats.expirations, 2u);
+  EXPECT_EQ(stats.hits, 3u);
+  EXPECT_EQ(stats.misses, 2u);
+  EXPECT_EQ(stats.entries, 1u);
+
+  // Taking the statistics resets the counters.
+  stats = cache.takeStats();
+  EXPECT_EQ(stats.hits, 0u);
+  EXPECT_EQ(stats.entries, 1u);
+}
+
+TEST_F(ShardedCacheTests, get_or_load) {
+  caches::ShardedCache<int, int> cache(options(4));
+  auto loads = 0;
+  auto load = [&loads](int key) -> std::optional<int> {
+    ++loads;
+    if (key < 0) {
+      return std::nullopt;
+    }
+    return key * 10;
+  };
+
+  EXPECT_EQ(*cache.getOrLoad(1, load), 10);
+  EXPECT_EQ(*cache.getOrLoad(1, load), 10);
+  EXPECT_EQ(loads, 1);
+
+  // A failed load caches nothing.
+  EXPECT_FALSE(cache.getOrLoad(-1, load));
+  EXPECT_FALSE(cache.getOrLoad(-1, load));
+  EXPECT_EQ(loads, 3);
+
+  EXPECT_THROW(cache.getOrLoad(
+                   2,
+                   [](int) -> std::optional<int> {
+                     throw std::runtime_error("load");
+                   }),
+               std::runtime_error);
+  EXPECT_EQ(*cache.getOrLoad(2, load), 20);
+
+  auto stats = cache.takeStats();
+  EXPECT_EQ(stats.loads, 5u);
+  EXPECT_EQ(stats.load_failures, 3u);
+  EXPECT_EQ(stats.hits, 1u);
+}
+
+TEST_F(ShardedCacheTests, get_or_load_single_flight) {
+  caches::ShardedCache<int, int> cache(options(4));
+  std::atomic<int> loads{0};
+  std::atomic<bool> release{false};
+  auto load = [&loads, &release](int key) -> std::optional<int> {
+    ++loads;
+    while (!release) {
+      std::this_thread::yield();
+    }
+    return key;
+  };
+
+  std::vector<std::thread> threads;
+  std::atomic<int> loaded{0};
+  for (size_t i = 0; i < 8; ++i) {
+    threads.emplace_back([&cache, &load, &loaded]() {
+      if (cache.getOrLoad(7, load) == 7) {
+        ++loaded;
+      }
+    });
+  }
+
+  while (loads == 0) {
+    std::this_thread::yield();
+  }
+  release = true;
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(loads, 1);
+  EXPECT_EQ(loaded, 8);
+}
+
+TEST_F(ShardedCacheTests, concurrent_inserts) {
+  caches::ShardedCache<int, int> cache(options(8, 1000));
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&cache, t]() {
+      for (int i = 0; i < 1000; ++i) {
+        cache.insert(t * 1000 + i, i);
+        cache.get(t * 1000 + i / 2);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  // Each shard holds at most its part of the capacity.
+  EXPECT_LE(cache.size(), 1000u);
+  EXPECT_GT(cache.size(), 0u);
+}
+
+} // namespace
+} // namespace osquery
@@ -80,4 +80,30 @@ std::vector<std::string_view> vsplit(const std::string_view source,
 
   return elements;
 }
+
+bool Tokenizer::next(std::string_view& token) {
+  auto start = source_.find_first_not_of(delims_, position_);
+  if (start == std::string_view::npos) {
+    position_ = source_.size();
+    return false;
+  }
+
+  auto end = source_.find_first_of(delims_, start);
+  if (end == std::string_view::npos) {
+    end = source_.size();
+  }
+  token = source_.substr(start, end - start);
+  position_ = end;
+  return true;
+}
+
+bool Tokenizer::skip(size_t count) {
+  std::string_view token;
+  for (size_t i = 0; i < count; ++i) {
+    if (!next(token)) {
+      return false;
+    }
+  }
+  return true;
+}
 } // namespace osquery
@@ -9,6 +9,7 @@
 
 #pragma once
 
+#include <array>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -54,4 +55,43 @@ std::vector<std::string> split(const std::string& s,
 std::vector<std::string_view> vsplit(const std::string_view source,
                                      char delimiter);
 
+/**
+ * @brief Iterate over the fields of a string_view without allocating.
+ *
+ * Fields are separated by any of the delimiters and empty fields are
+ * skipped, like osquery::split, but fields are not trimmed. The fields
+ * reference the source, it must outlive them.
+ */
+class Tokenizer {
+ public:
+  explicit Tokenizer(std::string_view source, std::string_view delims = "\t ")
+      : source_(source), delims_(delims) {}
+
+  /// Get the next field, returns false when there are no fields left.
+  bool next(std::string_view& token);
+
+  /// Get up to N next fields, returns the number of fields read.
+  template <size_t N>
+  size_t next(std::array<std::string_view, N>& tokens) {
+    size_t count = 0;
+    while (count < N && next(tokens[count])) {
+      ++count;
+    }
+    return count;
+  }
+
+  /// Skip count fields, returns false when there were not enough fields.
+  bool skip(size_t count);
+
+  /// The source following the last field returned.
+  std::string_view rest() const {
+    return source_.substr(position_);
+  }
+
+ private:
+  std::string_view source_;
+  std::string_view delims_;
+  size_t position_{0};
+};
+
 } // namespace osquery
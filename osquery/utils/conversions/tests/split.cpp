@@ -123,4 +123,27 @@ TEST_F(SplitConversionsTests, test_split_occurrences) {
   EXPECT_EQ(split(content, ':', 1), expected);
 }
 
+TEST_F(SplitConversionsTests, test_tokenizer) {
+  // The fields equal those of split, before trimming.
+  for (const auto& i : generateSplitStringTestData()) {
+    std::vector<std::string> fields;
+    Tokenizer tokenizer(i.test_string);
+    std::string_view field;
+    while (tokenizer.next(field)) {
+      fields.emplace_back(field);
+    }
+    EXPECT_EQ(fields, i.test_vector);
+  }
+
+  Tokenizer tokenizer("a::b;c d", ":;");
+  std::array<std::string_view, 2> fields;
+  EXPECT_EQ(tokenizer.next(fields), 2U);
+  EXPECT_EQ(fields[0], "a");
+  EXPECT_EQ(fields[1], "b");
+  EXPECT_EQ(tokenizer.rest(), ";c d");
+  EXPECT_TRUE(tokenizer.skip(2));
+  EXPECT_EQ(tokenizer.next(fields), 0U);
+  EXPECT_FALSE(tokenizer.skip(1));
+}
+
 } // namespace osquery
@@ -286,6 +286,28 @@ TEST_F(ConversionsTests, try_size_t_to_string_and_back) {
   testTryToForUnsignedInt<std::size_t>();
 }
 
+TEST_F(ConversionsTests, tryTo_string_view_to_integer) {
+  const std::string_view source = "12 -7 ff 18446744073709551615";
+  EXPECT_EQ(tryTo<int>(source.substr(0, 2)).takeOr(0), 12);
+  EXPECT_EQ(tryTo<long long>(source.substr(3, 2)).takeOr(0LL), -7LL);
+  auto hex = tryTo<unsigned short>(source.substr(6, 2), 16);
+  EXPECT_EQ(hex.takeOr(static_cast<unsigned short>(0)), 255U);
+  auto max = tryTo<std::uint64_t>(source.substr(9));
+  EXPECT_EQ(max.takeOr(std::uint64_t{0}), UINT64_MAX);
+
+  auto out_of_range = tryTo<std::int64_t>(source.substr(9));
+  ASSERT_TRUE(out_of_range.isError());
+  EXPECT_EQ(ConversionError::OutOfRange, out_of_range.getErrorCode());
+
+  // The whole view must be a number.
+  for (const auto& wrong :
+       {"", " 1", "1 ", "+1", "1a", "0x1", "a", "-", "-1"}) {
+    auto exp = tryTo<unsigned int>(std::string_view(wrong));
+    ASSERT_TRUE(exp.isError()) << wrong;
+    EXPECT_EQ(ConversionError::InvalidArgument, exp.getErrorCode());
+  }
+}
+
 TEST_F(ConversionsTests, tryTo_string_to_boolean_valid_args) {
   const auto test_table = std::unordered_map<std::string, bool>{
       {"1", true},        {"0", false},       {"y", true},
@@ -9,6 +9,9 @@
 
 #pragma once
 
+#include <charconv>
+#include <string_view>
+#include <system_error>
 #include <type_traits>
 
 #include <osquery/utils/expected/expected.h>
@@ -140,6 +143,32 @@ tryTo(const FromType& from, const int base = 10) noexcept {
   }
 }
 
+/**
+ * Template tryTo for string_view to integer conversion, without allocating.
+ *
+ * Unlike the [w]string conversion the whole view must be the number: there is
+ * no leading whitespace, '+' sign or "0x" prefix, and no trailing characters.
+ * Only signed types accept a '-' sign.
+ */
+template <typename ToType>
+inline typename std::enable_if<impl::IsInteger<ToType>::value,
+                               Expected<ToType, ConversionError>>::type
+tryTo(const std::string_view from, const int base = 10) noexcept {
+  auto value = ToType{};
+  auto end = from.data() + from.size();
+  auto result = std::from_chars(from.data(), end, value, base);
+  if (result.ec == std::errc::result_out_of_range) {
+    return createError(ConversionError::OutOfRange)
+           << "Value read is out of the range of representable values by an "
+              "int. ";
+  }
+  if (result.ec != std::errc() || result.ptr != end) {
+    return createError(ConversionError::InvalidArgument)
+           << "If no conversion could be performed. ";
+  }
+  return value;
+}
+
 /**
  * Parsing general representation of boolean value in string.
  *     "1" : true
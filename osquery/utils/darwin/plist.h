@@ -9,6 +9,11 @@
 
 #pragma once
 
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
 #include <boost/filesystem/path.hpp>
 #include <boost/property_tree/ptree.hpp>
 
@@ -27,6 +32,44 @@ namespace osquery {
 Status parsePlist(const boost::filesystem::path& path,
                   boost::property_tree::ptree& tree);
 
+/// Copy the values of a parsed property list that a caller keeps.
+using PlistProjection =
+    std::function<void(const boost::property_tree::ptree& tree,
+                       boost::property_tree::ptree& projected)>;
+
+using PlistTreeRef = std::shared_ptr<const boost::property_tree::ptree>;
+
+/**
+ * @brief Parse a property list on disk, reused while the file is unchanged.
+ *
+ * The projected tree is kept by key and path with the device, inode, size
+ * and mtime of the file, within plist_cache_size_mb, and is shared by the
+ * callers of the key. Files that cannot be stat'd or parsed are read on
+ * each call.
+ *
+ * @param key names the projection, such as the table of the caller.
+ * @param path the input path to a property list.
+ * @param projection copies the values kept, the whole tree is kept if empty.
+ * @param tree the output projected property tree.
+ *
+ * @return an instance of Status, indicating success or failure if malformed.
+ */
+Status parsePlistCached(const std::string& key,
+                        const boost::filesystem::path& path,
+                        const PlistProjection& projection,
+                        PlistTreeRef& tree);
+
+/**
+ * @brief Parse property lists with parsePlistCached on plist_parse_workers.
+ *
+ * @param trees the output trees in the order of the paths, a tree is null
+ * when its path does not exist or cannot be parsed.
+ */
+void parsePlistsCached(const std::string& key,
+                       const std::vector<std::string>& paths,
+                       const PlistProjection& projection,
+                       std::vector<PlistTreeRef>& trees);
+
 /**
  * @brief Parse property list content into a property tree.
  *
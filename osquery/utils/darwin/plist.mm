@@ -11,12 +11,17 @@
 
 #import <Foundation/Foundation.h>
 
+#include <sys/stat.h>
+
 #include <boost/filesystem/path.hpp>
 #include <boost/property_tree/json_parser.hpp>
 
+#include <osquery/core/flags.h>
+#include <osquery/core/tables.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/logger.h>
 #include <osquery/utils/base64.h>
+#include <osquery/utils/caches/sharded.h>
 #include <osquery/utils/conversions/darwin/cfstring.h>
 
 namespace fs = boost::filesystem;
@@ -24,6 +29,71 @@ namespace pt = boost::property_tree;
 
 namespace osquery {
 
+FLAG(uint32,
+     plist_cache_size_mb,
+     16,
+     "Memory budget for the parsed trees of unchanged property lists");
+
+FLAG(uint32,
+     plist_parse_workers,
+     4,
+     "Number of property lists a table parses at once");
+
+namespace {
+
+/// The projected tree of a property list and the identity of its file.
+struct CachedPlist {
+  std::string identity;
+  PlistTreeRef tree;
+};
+
+using CachedPlistPtr = std::shared_ptr<const CachedPlist>;
+
+std::size_t getTreeSize(const pt::ptree& tree) {
+  auto bytes = sizeof(pt::ptree) + tree.data().size();
+  for (const auto& child : tree) {
+    bytes += child.first.size() + getTreeSize(child.second) + 32;
+  }
+  return bytes;
+}
+
+/// Estimate the bytes of a parsed tree, the strings dominate.
+struct CachedPlistSize {
+  std::size_t operator()(const std::string& key,
+                         const CachedPlistPtr& plist) const {
+    return sizeof(CachedPlist) + key.size() + plist->identity.size() +
+           getTreeSize(*plist->tree);
+  }
+};
+
+using PlistCache =
+    caches::ShardedCache<std::string, CachedPlistPtr, CachedPlistSize>;
+
+PlistCache& getPlistCache() {
+  static PlistCache cache([]() {
+    caches::ShardedCacheOptions options;
+    options.max_bytes =
+        static_cast<std::size_t>(FLAGS_plist_cache_size_mb) * 1024 * 1024;
+    return options;
+  }());
+  return cache;
+}
+
+/// The identity of a property list, empty if it cannot be stat'd.
+std::string identifyPlist(const fs::path& path) {
+  struct stat st;
+  if (::stat(path.c_str(), &st) != 0) {
+    return "";
+  }
+
+  return std::to_string(st.st_dev) + ":" + std::to_string(st.st_ino) + ":" +
+         std::to_string(st.st_size) + ":" +
+         std::to_string(st.st_mtimespec.tv_sec) + "." +
+         std::to_string(st.st_mtimespec.tv_nsec);
+}
+
+} // namespace
+
 /**
  * @brief Filter selected data types from deserialized property list.
  *
@@ -212,6 +282,68 @@ Status parsePlist(const fs::path& path, pt::ptree& tree) {
   return status;
 }
 
+Status parsePlistCached(const std::string& key,
+                        const fs::path& path,
+                        const PlistProjection& projection,
+                        PlistTreeRef& tree) {
+  tree = nullptr;
+  std::string identity;
+  if (FLAGS_plist_cache_size_mb > 0) {
+    identity = identifyPlist(path);
+  }
+
+  auto& cache = getPlistCache();
+  auto cache_key = key + ":" + path.string();
+  if (!identity.empty()) {
+    auto cached = cache.get(cache_key);
+    if (cached && (*cached)->identity == identity) {
+      tree = (*cached)->tree;
+      return Status::success();
+    }
+  }
+
+  pt::ptree parsed;
+  auto status = parsePlist(path, parsed);
+  if (!status.ok()) {
+    return status;
+  }
+
+  if (projection) {
+    auto projected = std::make_shared<pt::ptree>();
+    projection(parsed, *projected);
+    tree = std::move(projected);
+  } else {
+    tree = std::make_shared<const pt::ptree>(std::move(parsed));
+  }
+
+  // The file may have changed while it was read, it is then parsed again by
+  // the next caller.
+  if (!identity.empty() && identifyPlist(path) == identity) {
+    cache.insert(cache_key,
+                 std::make_shared<const CachedPlist>(
+                     CachedPlist{std::move(identity), tree}));
+  }
+  return Status::success();
+}
+
+void parsePlistsCached(const std::string& key,
+                       const std::vector<std::string>& paths,
+                       const PlistProjection& projection,
+                       std::vector<PlistTreeRef>& trees) {
+  trees.assign(paths.size(), nullptr);
+  runTableRequests(paths.size(), FLAGS_plist_parse_workers, [&](size_t i) {
+    @autoreleasepool {
+      if (!pathExists(paths[i]).ok()) {
+        return;
+      }
+
+      if (!parsePlistCached(key, paths[i], projection, trees[i]).ok()) {
+        VLOG(1) << "Error parsing plist: " << paths[i];
+      }
+    }
+  });
+}
+
 static Status pathFromUnknownAlias(const CFDataRef& data, std::string& result) {
   auto bytes = (const char*)CFDataGetBytePtr(data);
   auto blen = static_cast<size_t>(CFDataGetLength(data));
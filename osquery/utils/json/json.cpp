@@ -282,19 +282,21 @@ void JSON::add(const std::string& key, bool value) {
 }
 
 Status JSON::toString(std::string& str) const {
-  rj::StringBuffer sb;
-  rj::Writer<rj::StringBuffer> writer(sb);
+  // Serialized documents can be large request bodies, they are written to the
+  // output directly so only one copy is held.
+  str.clear();
+  JSONStringStream stream(str);
+  rj::Writer<JSONStringStream> writer(stream);
   doc_.Accept(writer);
-  str = sb.GetString();
   return Status::success();
 }
 
 Status JSON::toPrettyString(std::string& str, size_t indentCharCount) const {
-  rj::StringBuffer sb;
-  rj::PrettyWriter<rj::StringBuffer> writer(sb);
+  str.clear();
+  JSONStringStream stream(str);
+  rj::PrettyWriter<JSONStringStream> writer(stream);
   writer.SetIndent(' ', indentCharCount);
   doc_.Accept(writer);
-  str = sb.GetString();
   return Status::success();
 }
 
@@ -311,11 +313,15 @@ Status JSON::fromString(const std::string& str, ParseMode mode) {
   }
   }
 
-  if (!pr) {
+  return getParseStatus(pr);
+}
+
+Status getParseStatus(const rj::ParseResult& result) {
+  if (!result) {
     std::string message{"Cannot parse JSON: "};
-    message += GetParseError_En(pr.Code());
+    message += GetParseError_En(result.Code());
     message += " Offset: ";
-    message += std::to_string(pr.Offset());
+    message += std::to_string(result.Offset());
     return Status(1, message);
   }
   return Status::success();
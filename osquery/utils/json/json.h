@@ -10,6 +10,7 @@
 #pragma once
 
 #include <cstddef>
+#include <string>
 
 #include <boost/optional.hpp>
 
@@ -41,6 +42,32 @@
 #endif
 
 namespace osquery {
+
+/// A rapidjson output stream appending to a string, without a buffer to copy.
+class JSONStringStream final {
+ public:
+  using Ch = char;
+
+  explicit JSONStringStream(std::string& str) : str_(str) {}
+
+  void Put(Ch c) {
+    str_.push_back(c);
+  }
+
+  void Flush() {}
+
+ private:
+  std::string& str_;
+};
+
+/**
+ * @brief A writer streaming JSON events into a string.
+ *
+ * Results are serialized with the write* helpers, such as writeRow, without
+ * building a document first. The string keeps its capacity when reused.
+ */
+using JSONWriter = rapidjson::Writer<JSONStringStream>;
+
 /**
  * @brief This provides a small wrapper around constructing JSON objects.
  *
@@ -389,4 +416,21 @@ class JSON : private only_movable {
   rapidjson::Document doc_;
   decltype(rapidjson::kObjectType) type_;
 };
+
+/// Convert the result of parsing into a Status, see JSON::fromString.
+Status getParseStatus(const rapidjson::ParseResult& result);
+
+/**
+ * @brief Parse a JSON string with a SAX handler, no document is built.
+ *
+ * The handler receives the events of a rapidjson::Reader, returning false
+ * from any of them stops parsing with an error. Parsing is iterative.
+ */
+template <typename Handler>
+Status parseJSON(const std::string& str, Handler& handler) {
+  rapidjson::Reader reader;
+  rapidjson::StringStream stream(str.c_str());
+  return getParseStatus(
+      reader.Parse<rapidjson::kParseIterativeFlag>(stream, handler));
+}
 } // namespace osquery
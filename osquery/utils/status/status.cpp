@@ -14,6 +14,7 @@
 namespace osquery {
 
 constexpr int Status::kSuccessCode;
+constexpr const char* Status::kDefaultMessage;
 
 Status Status::failure(int code, std::string message) {
   assert(code != Status::kSuccessCode &&
@@ -21,6 +22,14 @@ Status Status::failure(int code, std::string message) {
   return Status(code, std::move(message));
 }
 
+Status Status::staticFailure(int code, const char* message) {
+  assert(code != Status::kSuccessCode &&
+         "Using 'staticFailure' to create Status object with a kSuccessCode");
+  Status status(code);
+  status.static_message_ = message;
+  return status;
+}
+
 ::std::ostream& operator<<(::std::ostream& os, const Status& s) {
   return os << "Status(" << s.getCode() << R"(, ")" << s.getMessage()
             << R"("))";
@@ -11,6 +11,7 @@
 
 #include <osquery/utils/error/error.h>
 #include <osquery/utils/expected/expected.h>
+#include <memory>
 #include <sstream>
 #include <string>
 
@@ -40,7 +41,7 @@ class Status {
    * Note that the default constructor initialized an osquery::Status instance
    * to a state such that a successful operation is indicated.
    */
-  explicit Status(int c = Status::kSuccessCode) : code_(c), message_("OK") {}
+  explicit Status(int c = Status::kSuccessCode) : code_(c) {}
 
   /**
    * @brief A constructor which can be used to concisely express the status of
@@ -54,9 +55,14 @@ class Status {
    * Otherwise, it doesn't matter what the string is, as long as both the
    * setter and caller agree.
    */
-  Status(int c, std::string m) : code_(c), message_(std::move(m)) {}
+  Status(int c, std::string m) : code_(c) {
+    // The default message is not stored, a success does not allocate.
+    if (m != kDefaultMessage) {
+      message_ = std::make_shared<const std::string>(std::move(m));
+    }
+  }
 
-  Status(const ErrorBase& error) : code_(1), message_(error.getMessage()) {}
+  Status(const ErrorBase& error) : Status(1, error.getMessage()) {}
 
  public:
   /**
@@ -76,7 +82,10 @@ class Status {
    * is for the message to be "OK"
    */
   std::string getMessage() const {
-    return message_;
+    if (message_ != nullptr) {
+      return *message_;
+    }
+    return static_message_ != nullptr ? static_message_ : kDefaultMessage;
   }
 
   /**
@@ -136,11 +145,24 @@ class Status {
 
   static Status failure(int code, std::string message);
 
+  /**
+   * @brief A failure with a message of static storage duration.
+   *
+   * The message, such as a string literal, is neither copied nor formatted.
+   * Use it for failures expected on common paths, like a missing optional
+   * value, so that returning them does not allocate.
+   */
+  static Status staticFailure(const char* message) {
+    return staticFailure(1, message);
+  }
+
+  static Status staticFailure(int code, const char* message);
+
   // Below operator implementations useful for testing with gtest
 
   // Enables use of gtest (ASSERT|EXPECT)_EQ
   bool operator==(const Status& rhs) const {
-    return (code_ == rhs.getCode()) && (message_ == rhs.getMessage());
+    return (code_ == rhs.getCode()) && (getMessage() == rhs.getMessage());
   }
 
   // Enables use of gtest (ASSERT|EXPECT)_NE
@@ -152,11 +174,17 @@ class Status {
   friend ::std::ostream& operator<<(::std::ostream& os, const Status& s);
 
  private:
+  /// The message of a status created without one.
+  static constexpr const char* kDefaultMessage = "OK";
+
   /// the internal storage of the status code
   int code_;
 
-  /// the internal storage of the status message
-  std::string message_;
+  /// A message of static storage duration, see staticFailure.
+  const char* static_message_{nullptr};
+
+  /// The formatted message, shared by the copies of the status.
+  std::shared_ptr<const std::string> message_;
 };
 
 ::std::ostream& operator<<(::std::ostream& os, const Status& s);
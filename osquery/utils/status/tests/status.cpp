@@ -68,6 +68,27 @@ TEST_F(StatusTests, test_failure_double_arg) {
   EXPECT_FALSE(s.ok());
 }
 
+TEST_F(StatusTests, test_static_failure) {
+  static const char* kMessage = "A missing optional value";
+  auto s = Status::staticFailure(kMessage);
+  EXPECT_FALSE(s.ok());
+  EXPECT_EQ(s.getCode(), 1);
+  EXPECT_EQ(s.getMessage(), kMessage);
+  EXPECT_EQ(s, Status::failure(kMessage));
+
+  auto copy = s;
+  EXPECT_EQ(copy.getMessage(), kMessage);
+  EXPECT_EQ(Status::staticFailure(3, kMessage).getCode(), 3);
+}
+
+TEST_F(StatusTests, test_copies_share_message) {
+  auto s = Status::failure(std::string(64, 'a'));
+  auto copy = s;
+  EXPECT_EQ(copy, s);
+  EXPECT_EQ(copy.getMessage(), std::string(64, 'a'));
+  EXPECT_EQ(Status(0, "OK"), Status::success());
+}
+
 TEST_F(StatusTests, test_failure_with_success_code) {
 #ifndef NDEBUG
   ASSERT_DEATH(Status::failure(Status::kSuccessCode, "message"),
@@ -0,0 +1,75 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <osquery/utils/string_pool.h>
+
+namespace osquery {
+
+const std::string InternedString::empty_;
+
+const std::size_t StringPool::kSweepInterval{16384U};
+
+InternedString::InternedString(const std::string& value)
+    : InternedString(StringPool::instance().intern(value)) {}
+
+InternedString::InternedString(const char* value)
+    : InternedString(std::string(value != nullptr ? value : "")) {}
+
+StringPool& StringPool::instance() {
+  static StringPool pool;
+  return pool;
+}
+
+InternedString StringPool::intern(const std::string& value) {
+  if (value.empty()) {
+    return InternedString();
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (++interned_since_sweep_ >= kSweepInterval) {
+    sweepLocked();
+  }
+
+  auto& entry = strings_[value];
+  auto shared = entry.lock();
+  if (shared == nullptr) {
+    shared = std::make_shared<const std::string>(value);
+    entry = shared;
+  }
+
+  return InternedString(std::move(shared));
+}
+
+std::size_t StringPool::sweep() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return sweepLocked();
+}
+
+std::size_t StringPool::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return strings_.size();
+}
+
+std::size_t StringPool::sweepLocked() {
+  interned_since_sweep_ = 0;
+
+  std::size_t dropped = 0;
+  for (auto it = strings_.begin(); it != strings_.end();) {
+    if (it->second.expired()) {
+      it = strings_.erase(it);
+      ++dropped;
+    } else {
+      ++it;
+    }
+  }
+
+  return dropped;
+}
+
+} // namespace osquery
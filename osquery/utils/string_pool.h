@@ -0,0 +1,131 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+
+namespace osquery {
+
+/**
+ * @brief A string shared by every equal string interned in the StringPool.
+ *
+ * Event contexts carry the same executable paths and working directories
+ * for millions of events. Copying an interned string copies a reference,
+ * the value is released with the last copy.
+ */
+class InternedString final {
+ public:
+  InternedString() = default;
+
+  /// Intern the value in the process-wide pool.
+  InternedString(const std::string& value);
+
+  /// Intern the value in the process-wide pool.
+  InternedString(const char* value);
+
+  const std::string& str() const {
+    return value_ != nullptr ? *value_ : empty_;
+  }
+
+  operator const std::string&() const {
+    return str();
+  }
+
+  bool empty() const {
+    return str().empty();
+  }
+
+  std::size_t size() const {
+    return str().size();
+  }
+
+  const char* c_str() const {
+    return str().c_str();
+  }
+
+ private:
+  explicit InternedString(std::shared_ptr<const std::string> value)
+      : value_(std::move(value)) {}
+
+  std::shared_ptr<const std::string> value_;
+
+  static const std::string empty_;
+
+  friend class StringPool;
+  friend bool operator==(const InternedString& lhs, const InternedString& rhs);
+};
+
+inline bool operator==(const InternedString& lhs, const InternedString& rhs) {
+  // Equal values interned in the same pool share the same string.
+  return lhs.value_ == rhs.value_ || lhs.str() == rhs.str();
+}
+
+inline bool operator!=(const InternedString& lhs, const InternedString& rhs) {
+  return !(lhs == rhs);
+}
+
+inline bool operator==(const InternedString& lhs, const std::string& rhs) {
+  return lhs.str() == rhs;
+}
+
+inline bool operator==(const std::string& lhs, const InternedString& rhs) {
+  return lhs == rhs.str();
+}
+
+inline bool operator!=(const InternedString& lhs, const std::string& rhs) {
+  return lhs.str() != rhs;
+}
+
+inline bool operator!=(const std::string& lhs, const InternedString& rhs) {
+  return lhs != rhs.str();
+}
+
+inline std::ostream& operator<<(std::ostream& stream,
+                                const InternedString& value) {
+  return stream << value.str();
+}
+
+/**
+ * @brief A pool of reference counted strings.
+ *
+ * The pool only keeps weak references, a string without users is released
+ * and its entry is dropped by the next sweep. A sweep runs every
+ * kSweepInterval interned strings.
+ */
+class StringPool final {
+ public:
+  /// Interned strings between two sweeps of the released entries.
+  static const std::size_t kSweepInterval;
+
+  /// The process-wide pool used by InternedString.
+  static StringPool& instance();
+
+  InternedString intern(const std::string& value);
+
+  /// Drop the entries of released strings, returns the count dropped.
+  std::size_t sweep();
+
+  /// Entries in the pool, including released strings not swept yet.
+  std::size_t size() const;
+
+ private:
+  std::size_t sweepLocked();
+
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string, std::weak_ptr<const std::string>> strings_;
+  std::size_t interned_since_sweep_{0};
+};
+
+} // namespace osquery
@@ -13,9 +13,13 @@
 #include <boost/filesystem.hpp>
 
 #include <algorithm>
+#include <cerrno>
 #include <fstream>
 #include <iostream>
 
+#include <fcntl.h>
+#include <unistd.h>
+
 namespace osquery {
 namespace proc {
 
@@ -51,5 +55,83 @@ std::string cmdline(pid_t const pid) {
   return content;
 }
 
+bool readAttr(const std::string& pid, char const* attr, std::string& content) {
+  auto attr_path = "/proc/" + pid + "/" + attr;
+  auto fd = ::open(attr_path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+
+  // Attributes report a size of 0, read until the end.
+  content.resize(std::max<size_t>(content.capacity(), 4096));
+  size_t size = 0;
+  while (true) {
+    if (size == content.size()) {
+      content.resize(content.size() * 2);
+    }
+
+    auto n = ::read(fd, &content[size], content.size() - size);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    } else if (n <= 0) {
+      ::close(fd);
+      content.resize(size);
+      return n == 0;
+    }
+    size += static_cast<size_t>(n);
+  }
+}
+
+bool readAttrLines(const std::string& pid,
+                   char const* attr,
+                   std::string& buffer,
+                   const std::function<bool(std::string_view line)>& line) {
+  auto attr_path = "/proc/" + pid + "/" + attr;
+  auto fd = ::open(attr_path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+
+  buffer.resize(std::max<size_t>(buffer.capacity(), 65536));
+  size_t size = 0;
+  while (true) {
+    if (size == buffer.size()) {
+      // A line longer than the buffer.
+      buffer.resize(buffer.size() * 2);
+    }
+
+    auto n = ::read(fd, &buffer[size], buffer.size() - size);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    } else if (n < 0) {
+      ::close(fd);
+      return false;
+    } else if (n == 0) {
+      ::close(fd);
+      if (size > 0) {
+        line(std::string_view(buffer.data(), size));
+      }
+      return true;
+    }
+
+    // Pass the complete lines, keep the start of the last one.
+    std::string_view chunk(buffer.data(), size + static_cast<size_t>(n));
+    size_t start = 0;
+    for (auto end = chunk.find('\n', size); end != std::string_view::npos;
+         end = chunk.find('\n', start)) {
+      if (!line(chunk.substr(start, end - start))) {
+        ::close(fd);
+        return true;
+      }
+      start = end + 1;
+    }
+
+    size = chunk.size() - start;
+    std::copy(buffer.begin() + start,
+              buffer.begin() + start + size,
+              buffer.begin());
+  }
+}
+
 } // namespace proc
 } // namespace osquery
@@ -11,12 +11,40 @@
 
 #include <boost/filesystem/path.hpp>
 
+#include <functional>
 #include <string>
+#include <string_view>
 
 namespace osquery {
 namespace proc {
 
 std::string cmdline(pid_t pid);
 
+/**
+ * @brief Read an attribute of /proc/<pid> into a buffer.
+ *
+ * Unlike readFile there are no size or ownership checks, the attributes are
+ * generated by the kernel. The content is replaced and its capacity reused,
+ * callers reading many processes should keep one buffer.
+ *
+ * @return false if the attribute cannot be read.
+ */
+bool readAttr(const std::string& pid, char const* attr, std::string& content);
+
+/**
+ * @brief Read an attribute of /proc/<pid> line by line.
+ *
+ * The attribute is read in chunks of the buffer's capacity, at least 64KB,
+ * so large attributes such as maps are never held whole. The lines view the
+ * buffer without their newline and are only valid during the call.
+ *
+ * @param line called for each line, returns false to stop reading.
+ * @return false if the attribute cannot be read.
+ */
+bool readAttrLines(const std::string& pid,
+                   char const* attr,
+                   std::string& buffer,
+                   const std::function<bool(std::string_view line)>& line);
+
 } // namespace proc
 } // namespace osquery
@@ -11,6 +11,9 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <vector>
+
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -36,5 +39,49 @@ TEST_F(LinuxProcTests, cmdline_not_existing_pid) {
   ASSERT_TRUE(proc::cmdline(-12).empty());
 }
 
+TEST_F(LinuxProcTests, read_attr_self) {
+  std::string content;
+  auto pid = std::to_string(getpid());
+  ASSERT_TRUE(proc::readAttr(pid, "status", content));
+  EXPECT_NE(content.find("Pid:\t" + pid + "\n"), std::string::npos);
+
+  // The content is replaced, not appended to.
+  ASSERT_TRUE(proc::readAttr(pid, "stat", content));
+  EXPECT_EQ(content.find(pid + " ("), 0U);
+
+  EXPECT_FALSE(proc::readAttr("-1", "stat", content));
+}
+
+TEST_F(LinuxProcTests, read_attr_lines_self) {
+  std::string content;
+  auto pid = std::to_string(getpid());
+  ASSERT_TRUE(proc::readAttr(pid, "maps", content));
+
+  // The mappings of the heap may change between the reads.
+  std::string buffer;
+  std::vector<std::string> lines;
+  ASSERT_TRUE(proc::readAttrLines(
+      pid, "maps", buffer, [&lines](std::string_view line) {
+        lines.emplace_back(line);
+        return true;
+      }));
+  ASSERT_FALSE(lines.empty());
+  EXPECT_EQ(lines.size(),
+            static_cast<size_t>(
+                std::count(content.begin(), content.end(), '\n')));
+  EXPECT_EQ(content.find(lines[0] + "\n"), 0U);
+
+  // Reading stops when a line returns false.
+  size_t count = 0;
+  ASSERT_TRUE(
+      proc::readAttrLines(pid, "status", buffer, [&count](std::string_view) {
+        return ++count < 2;
+      }));
+  EXPECT_EQ(count, 2U);
+
+  EXPECT_FALSE(proc::readAttrLines(
+      "-1", "maps", buffer, [](std::string_view) { return true; }));
+}
+
 } // namespace
 } // namespace osquery
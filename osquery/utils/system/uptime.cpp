@@ -14,8 +14,12 @@
 #include <sys/sysctl.h>
 #include <time.h>
 #elif defined(__linux__)
+#include <fstream>
+
 #include <sys/sysinfo.h>
 #elif defined(WIN32)
+#include <ctime>
+
 #include <osquery/utils/system/system.h>
 #endif
 
@@ -50,4 +54,28 @@ long getUptime() {
   return -1;
 }
 
+std::string getBootIdentifier() {
+#if defined(DARWIN)
+  char uuid[64] = {0};
+  size_t len = sizeof(uuid) - 1;
+  if (sysctlbyname("kern.bootsessionuuid", uuid, &len, nullptr, 0) != 0) {
+    return "";
+  }
+  return std::string(uuid);
+#elif defined(__linux__)
+  std::ifstream boot_id("/proc/sys/kernel/random/boot_id");
+  std::string identifier;
+  if (!std::getline(boot_id, identifier)) {
+    return "";
+  }
+  return identifier;
+#elif defined(WIN32)
+  // Windows has no boot identifier, use the boot time rounded to minutes.
+  auto boot_time = std::time(nullptr) - GetTickCount64() / 1000;
+  return std::to_string(boot_time / 60);
+#endif
+
+  return "";
+}
+
 } // namespace osquery
@@ -9,8 +9,19 @@
 
 #pragma once
 
+#include <string>
+
 namespace osquery {
 
 long getUptime();
 
+/**
+ * @brief An identifier of the current boot of the system.
+ *
+ * The identifier changes on every boot and is stable until the next one.
+ *
+ * @return The identifier, empty if it cannot be determined.
+ */
+std::string getBootIdentifier();
+
 } // namespace osquery
@@ -24,4 +24,23 @@ TEST_F(Base64Tests, test_base64) {
   EXPECT_EQ(unencoded, unencoded2);
 }
 
+TEST_F(Base64Tests, test_base64_vectors) {
+  EXPECT_EQ(base64::encode(""), "");
+  EXPECT_EQ(base64::encode("f"), "Zg==");
+  EXPECT_EQ(base64::encode("fo"), "Zm8=");
+  EXPECT_EQ(base64::encode("foo"), "Zm9v");
+  EXPECT_EQ(base64::encode("foob"), "Zm9vYg==");
+  EXPECT_EQ(base64::encode(std::string("\xff\x00\xfe", 3)), "/wD+");
+
+  EXPECT_EQ(base64::decode("Zg=="), "f");
+  EXPECT_EQ(base64::decode("Zm8="), "fo");
+  EXPECT_EQ(base64::decode("Zm9vYg"), "foob");
+  EXPECT_EQ(base64::decode("/wD+"), std::string("\xff\x00\xfe", 3));
+
+  // Newlines are skipped, invalid characters fail the decoding.
+  EXPECT_EQ(base64::decode("Zm9v\r\nYg==\n"), "foob");
+  EXPECT_EQ(base64::decode("Zm9v!Yg=="), "");
+  EXPECT_EQ(base64::decode("Zm9v\rYg=="), "");
+}
+
 } // namespace osquery
@@ -0,0 +1,70 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include <gtest/gtest.h>
+
+#include <osquery/utils/string_pool.h>
+
+namespace osquery {
+
+class StringPoolTests : public testing::Test {};
+
+TEST_F(StringPoolTests, test_intern_shares_value) {
+  StringPool pool;
+  auto first = pool.intern("/usr/bin/zsh");
+  auto second = pool.intern(std::string("/usr/bin/zsh"));
+  auto other = pool.intern("/usr/bin/bash");
+
+  EXPECT_EQ(&first.str(), &second.str());
+  EXPECT_NE(&first.str(), &other.str());
+  EXPECT_EQ(first, second);
+  EXPECT_NE(first, other);
+  EXPECT_EQ(first, std::string("/usr/bin/zsh"));
+  EXPECT_EQ(pool.size(), 2U);
+
+  // The empty string is not stored.
+  auto empty = pool.intern("");
+  EXPECT_TRUE(empty.empty());
+  EXPECT_EQ(empty, InternedString());
+  EXPECT_EQ(pool.size(), 2U);
+}
+
+TEST_F(StringPoolTests, test_sweep_released) {
+  StringPool pool;
+  auto kept = pool.intern("/home/user");
+  {
+    auto released = pool.intern("/tmp");
+    EXPECT_EQ(pool.size(), 2U);
+  }
+
+  EXPECT_EQ(pool.sweep(), 1U);
+  EXPECT_EQ(pool.size(), 1U);
+  EXPECT_EQ(kept.str(), "/home/user");
+
+  // Interning a released value again stores a new string.
+  auto again = pool.intern("/tmp");
+  EXPECT_EQ(again.str(), "/tmp");
+  EXPECT_EQ(pool.size(), 2U);
+}
+
+TEST_F(StringPoolTests, test_copy_and_assign) {
+  InternedString value = "/usr/bin/sudo";
+  InternedString copy = value;
+  EXPECT_EQ(&value.str(), &copy.str());
+
+  std::string plain = value;
+  EXPECT_EQ(plain, "/usr/bin/sudo");
+
+  plain = "/home/user";
+  copy = plain;
+  EXPECT_EQ(copy, plain);
+  EXPECT_NE(copy, value);
+}
+
+} // namespace osquery
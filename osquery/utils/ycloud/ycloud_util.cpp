@@ -13,6 +13,7 @@
 #include <boost/algorithm/string.hpp>
 #include <osquery/core/core.h>
 #include <osquery/logger/logger.h>
+#include <osquery/remote/metadata_cache.h>
 #include <osquery/utils/conversions/split.h>
 #include <osquery/utils/json/json.h>
 #include <osquery/utils/ycloud/ycloud_util.h>
@@ -115,28 +116,41 @@ std::string getYCloudKey(JSON& doc, const std::string& key) {
 }
 
 Status fetchYCloudMetadata(JSON& doc, const std::string& endpoint) {
-  http::Request request(endpoint + kYCloudMetadataPathAndQuery);
-  http::Client::Options opts;
-  http::Response response;
+  auto url = endpoint + kYCloudMetadataPathAndQuery;
+  auto fetch = [&url, &endpoint](std::string& body) {
+    http::Request request(url);
+    http::Client::Options opts;
+    http::Response response;
 
-  opts.timeout(kYCloudMetadataTimeout);
-  http::Client client(opts);
+    opts.timeout(kYCloudMetadataTimeout);
+    http::Client client(opts);
 
-  request << http::Request::Header("Metadata-Flavor", "Google");
+    request << http::Request::Header("Metadata-Flavor", "Google");
 
-  try {
-    response = client.get(request);
-  } catch (const std::system_error& e) {
-    return Status(1, "Couldn't request " + endpoint + ": " + e.what());
-  }
+    try {
+      response = client.get(request);
+    } catch (const std::system_error& e) {
+      return Status(1, "Couldn't request " + endpoint + ": " + e.what());
+    }
+
+    if (response.result_int() != 200) {
+      return Status(1,
+                    "YCloud metadata service responded with " +
+                        std::to_string(response.result_int()));
+    }
+
+    body = response.body();
+    return Status::success();
+  };
 
-  if (response.result_int() != 200) {
-    return Status(1,
-                  "YCloud metadata service responded with " +
-                      std::to_string(response.result_int()));
+  std::string body;
+  auto status =
+      MetadataCache::get().lookup(url, getMetadataCacheTTL(), fetch, body);
+  if (!status.ok()) {
+    return status;
   }
 
-  auto s = doc.fromString(response.body());
+  auto s = doc.fromString(body);
   if (!s.ok()) {
     return s;
   }
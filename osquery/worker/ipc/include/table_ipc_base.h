@@ -9,11 +9,13 @@
 
 #pragma once
 
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <unordered_map>
 
 #include <osquery/core/sql/query_data.h>
+#include <osquery/worker/ipc/table_ipc_binary_converter.h>
 #include <osquery/worker/ipc/table_ipc_json_converter.h>
 
 #include <osquery/worker/logging/glog_logger_types.h>
@@ -42,6 +44,13 @@ class TableIPCBase {
     return static_cast<Derived&>(*this).sendJSONString(json_string);
   }
 
+  /// Send rows using the binary encoding, see TableIPCBinaryConverter.
+  Status sendQueryDataBinary(const QueryData& query_data) {
+    std::string message;
+    TableIPCBinaryConverter::queryDataToBinary(query_data, message);
+    return static_cast<Derived&>(*this).sendJSONString(message);
+  }
+
   Status sendLogMessage(int severity,
                         GLOGLogType log_type,
                         const std::string& message) {
@@ -65,10 +74,23 @@ class TableIPCBase {
     return static_cast<Derived&>(*this).sendJSONString(json_string);
   }
 
-  Status sendJob(const QueryContext& context) {
+  /**
+   * @brief Send a query job.
+   *
+   * Workers serving several tables also receive the table name and the
+   * address of its generate function, valid in a worker forked from this
+   * process.
+   */
+  Status sendJob(const QueryContext& context,
+                 const std::string& table_name = "",
+                 std::uint64_t generate_address = 0) {
     JSON json_helper;
     serializeQueryContextJSON(context, json_helper);
     json_helper.add("Type", "Job");
+    if (generate_address != 0) {
+      json_helper.add("Table", table_name);
+      json_helper.add("Generate", std::to_string(generate_address));
+    }
 
     std::string json_string;
     auto status = json_helper.toString(json_string);
@@ -88,7 +110,13 @@ class TableIPCBase {
       return status;
     }
 
-    status = json_message.fromString(json_string);
+    return parseJSONMessage(json_string, json_message, message_type);
+  }
+
+  Status parseJSONMessage(const std::string& json_string,
+                          JSON& json_message,
+                          JSONMessageType& message_type) {
+    auto status = json_message.fromString(json_string);
 
     if (!status.ok()) {
       return status;
@@ -108,8 +136,26 @@ class TableIPCBase {
 
   Status processOneMessage(QueryData* query_results,
                            JSONMessageType& message_type) {
+    std::string message;
+    auto status = static_cast<Derived&>(*this).recvJSONString(message);
+
+    if (!status.ok()) {
+      return status;
+    }
+
+    // Rows may be sent using the binary encoding, other messages are JSON.
+    if (TableIPCBinaryConverter::isBinaryQueryData(message)) {
+      message_type = JSONMessageType::QueryData;
+      if (!query_results) {
+        return Status::failure(1, "Received unexpected QueryData message");
+      }
+
+      return TableIPCBinaryConverter::binaryToQueryData(message,
+                                                        *query_results);
+    }
+
     JSON json_message;
-    Status status = recvJSONMessage(json_message, message_type);
+    status = parseJSONMessage(message, json_message, message_type);
 
     if (!status.ok()) {
       return status;
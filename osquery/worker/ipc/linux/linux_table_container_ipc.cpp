@@ -18,6 +18,7 @@
 #include <unistd.h>
 
 #include <chrono>
+#include <cstdint>
 #include <cstdlib>
 #include <iostream>
 
@@ -39,6 +40,17 @@ CLI_FLAG(bool,
          "Keep the container worker running to be reused instead of closing it "
          "after each query");
 
+CLI_FLAG(bool,
+         container_worker_pool,
+         false,
+         "Query containers through one long-lived worker per mount namespace "
+         "shared by all tables");
+
+CLI_FLAG(uint64,
+         container_worker_pool_max,
+         32,
+         "Maximum number of container workers kept by container_worker_pool");
+
 namespace {
 
 const std::string kProc = "/proc";
@@ -128,6 +140,28 @@ ProcessState checkProcessStateAndLog(const PlatformProcess& process,
 
   return process_state;
 }
+
+Status forwardWorkerLog(GLOGLogType log_type,
+                        int priority,
+                        const std::string& message) {
+  auto logger = GLOGLogger::instance();
+  switch (log_type) {
+  case GLOGLogType::LOG: {
+    logger.log(priority, message);
+    break;
+  }
+  case GLOGLogType::VLOG: {
+    logger.vlog(priority, message);
+    break;
+  }
+  default: {
+    return Status::failure("Unknown log message type " +
+                           std::to_string(static_cast<int>(log_type)));
+  }
+  }
+
+  return Status::success();
+}
 } // namespace
 
 extern template std::set<int> ConstraintList::getAll<int>(
@@ -260,23 +294,7 @@ void LinuxTableContainerIPC::stopContainerWorker() {
 Status LinuxTableContainerIPC::handleLog(GLOGLogType log_type,
                                          int priority,
                                          const std::string& message) {
-  auto logger = GLOGLogger::instance();
-  switch (log_type) {
-  case GLOGLogType::LOG: {
-    logger.log(priority, message);
-    break;
-  }
-  case GLOGLogType::VLOG: {
-    logger.vlog(priority, message);
-    break;
-  }
-  default: {
-    return Status::failure("Unknown log message type " +
-                           std::to_string(static_cast<int>(log_type)));
-  }
-  }
-
-  return Status::success();
+  return forwardWorkerLog(log_type, priority, message);
 }
 
 Status LinuxTableContainerIPC::handleJob(QueryContext& context) {
@@ -417,12 +435,333 @@ Status LinuxTableContainerIPC::retrieveQueryDataFromContainer(
   return status;
 }
 
+LinuxContainerNamespaceWorker::LinuxContainerNamespaceWorker(
+    PipeChannelFactory& factory, const std::string& namespace_id)
+    : ipc_(factory, *this), namespace_id_(namespace_id) {}
+
+LinuxContainerNamespaceWorker::~LinuxContainerNamespaceWorker() {
+  stop();
+}
+
+Status LinuxContainerNamespaceWorker::start(
+    pid_t namespace_pid, const std::function<void()>& in_child) {
+  std::string path =
+      kProc + "/" + std::to_string(namespace_pid) + kMountNamespace;
+  auto fd = open(path.c_str(), O_RDONLY);
+
+  if (fd < 0) {
+    return Status::failure("Could not open mount namespace of pid " +
+                           std::to_string(namespace_pid) +
+                           ", error: " + std::to_string(errno));
+  }
+
+  std::string channel_name = "mnt:" + namespace_id_;
+  PipeChannelTicket channel_ticket = ipc_.createChannelTicket();
+  auto process_group = getpgrp();
+
+  pid_t pid = fork();
+
+  if (pid == 0) {
+    if (setpgid(0, process_group) < 0) {
+      std::_Exit(1);
+    }
+
+    in_child();
+
+    // The worker never leaves the namespace, so it only switches once.
+    if (syscall(SYS_setns, fd, 0) < 0) {
+      syslog(LOG_NOTICE,
+             "Failed to switch to mount namespace %s: %d",
+             namespace_id_.c_str(),
+             errno);
+      std::_Exit(1);
+    }
+    close(fd);
+
+    try {
+      ipc_.connectToParent(channel_name, std::move(channel_ticket));
+    } catch (const std::exception& e) {
+      syslog(LOG_NOTICE, "Failed to connect to parent: %s", e.what());
+      std::_Exit(1);
+    }
+
+    executeQueryJobs();
+  }
+
+  close(fd);
+
+  if (pid == -1) {
+    return Status::failure("Failed to start container worker to namespace " +
+                           namespace_id_);
+  }
+
+  process_ = PlatformProcess(pid);
+  ipc_.connectToChild(channel_name, std::move(channel_ticket), pid);
+
+  return Status::success();
+}
+
+bool LinuxContainerNamespaceWorker::isRunning() {
+  if (process_.pid() == kInvalidPid || !ipc_.isChannelOpen()) {
+    return false;
+  }
+
+  return checkProcessStateAndLog(process_, "mnt:" + namespace_id_) ==
+         ProcessState::PROCESS_STILL_ALIVE;
+}
+
+Status LinuxContainerNamespaceWorker::sendJob(const QueryContext& context,
+                                              const std::string& table_name,
+                                              TableGeneratePtr generate_ptr) {
+  auto generate_address = static_cast<std::uint64_t>(
+      reinterpret_cast<std::uintptr_t>(generate_ptr));
+  return ipc_.sendJob(context, table_name, generate_address);
+}
+
+Status LinuxContainerNamespaceWorker::receiveQueryData(QueryData& results) {
+  while (true) {
+    JSONMessageType message_type;
+    auto status = ipc_.processOneMessage(&results, message_type);
+
+    if (!status.ok() || message_type == JSONMessageType::QueryData) {
+      return status;
+    }
+  }
+}
+
+void LinuxContainerNamespaceWorker::closeChannel() {
+  ipc_.closeActiveChannel();
+}
+
+void LinuxContainerNamespaceWorker::stop() {
+  closeChannel();
+
+  if (process_.pid() == kInvalidPid) {
+    return;
+  }
+
+  // The worker is idle between jobs, there are no results to wait for.
+  PlatformProcess process(std::move(process_));
+  if (checkProcessStateAndLog(process, "mnt:" + namespace_id_) ==
+      ProcessState::PROCESS_STILL_ALIVE) {
+    process.kill();
+    process.cleanup(std::chrono::milliseconds(2000));
+  }
+}
+
+Status LinuxContainerNamespaceWorker::handleLog(GLOGLogType log_type,
+                                                int priority,
+                                                const std::string& message) {
+  return forwardWorkerLog(log_type, priority, message);
+}
+
+Status LinuxContainerNamespaceWorker::handleJob(QueryContext& context) {
+  QueryData query_data;
+  auto generate_ptr = reinterpret_cast<TableGeneratePtr>(
+      static_cast<std::uintptr_t>(ipc_.getJobGenerateAddress()));
+
+  auto pids_with_namespace =
+      context.constraints.at("pid_with_namespace").getAll<int>(EQUALS);
+
+  // A reply is always sent, the parent would otherwise wait forever.
+  if (generate_ptr == nullptr || pids_with_namespace.empty()) {
+    logger_.vlog(1,
+                 "Container worker received a job without a table or pids");
+    return ipc_.sendQueryDataBinary(query_data);
+  }
+
+  // All the processes share the namespace, so the table is generated once.
+  QueryData namespace_query_data = generate_ptr(context, logger_);
+  query_data.reserve(namespace_query_data.size() * pids_with_namespace.size());
+
+  for (const auto pid : pids_with_namespace) {
+    for (const auto& row : namespace_query_data) {
+      query_data.push_back(row);
+      query_data.back()["pid_with_namespace"] = INTEGER(pid);
+      query_data.back()["mount_namespace_id"] = namespace_id_;
+    }
+  }
+
+  return ipc_.sendQueryDataBinary(query_data);
+}
+
+void LinuxContainerNamespaceWorker::executeQueryJobs() {
+  int exit_status_code = 0;
+  while (true) {
+    JSONMessageType message_type;
+    auto status = ipc_.processOneMessage(nullptr, message_type);
+
+    if (!status.ok()) {
+      exit_status_code = status.getCode();
+
+      if (exit_status_code != 2 || FLAGS_verbose) {
+        syslog(LOG_NOTICE, "%s", status.getMessage().c_str());
+      }
+      break;
+    }
+  }
+
+  std::_Exit(exit_status_code);
+}
+
+LinuxContainerWorkerPool& LinuxContainerWorkerPool::instance() {
+  static LinuxContainerWorkerPool pool;
+  return pool;
+}
+
+LinuxContainerWorkerPool::~LinuxContainerWorkerPool() {
+  WriteLock lock(mutex_);
+  workers_.clear();
+}
+
+LinuxContainerNamespaceWorker* LinuxContainerWorkerPool::getWorker(
+    const std::string& namespace_id, pid_t namespace_pid) {
+  auto it = workers_.find(namespace_id);
+  if (it != workers_.end()) {
+    if (it->second.worker->isRunning()) {
+      it->second.last_used = ++use_counter_;
+      return it->second.worker.get();
+    }
+    workers_.erase(it);
+  }
+
+  auto worker =
+      std::make_unique<LinuxContainerNamespaceWorker>(factory_, namespace_id);
+
+  // The new worker must not hold the pipes of the other workers, otherwise
+  // a worker that dies would not be noticed by the parent.
+  auto status = worker->start(namespace_pid, [this]() {
+    for (auto& pooled : workers_) {
+      pooled.second.worker->closeChannel();
+    }
+  });
+
+  if (!status.ok()) {
+    LOG(ERROR) << status.getMessage();
+    return nullptr;
+  }
+
+  auto& pooled = workers_[namespace_id];
+  pooled.worker = std::move(worker);
+  pooled.last_used = ++use_counter_;
+  return pooled.worker.get();
+}
+
+void LinuxContainerWorkerPool::stopWorker(const std::string& namespace_id) {
+  workers_.erase(namespace_id);
+}
+
+void LinuxContainerWorkerPool::evictWorkers() {
+  while (workers_.size() > FLAGS_container_worker_pool_max) {
+    auto oldest = workers_.begin();
+    for (auto it = workers_.begin(); it != workers_.end(); ++it) {
+      if (it->second.last_used < oldest->second.last_used) {
+        oldest = it;
+      }
+    }
+    workers_.erase(oldest);
+  }
+}
+
+QueryData LinuxContainerWorkerPool::generate(const QueryContext& context,
+                                             const std::string& table_name,
+                                             TableGeneratePtr generate_ptr) {
+  QueryData results;
+
+  auto pids_with_namespace =
+      context.constraints.at("pid_with_namespace").getAll<int>(EQUALS);
+
+  std::map<std::string, std::vector<int>> namespace_pids;
+  for (const auto pid : pids_with_namespace) {
+    std::string path = kProc + "/" + std::to_string(pid) + kMountNamespace;
+    std::string mount_namespace_id;
+    auto status = extractMountNamespaceId(path, mount_namespace_id);
+
+    if (!status.ok()) {
+      VLOG(1) << status.getMessage();
+      continue;
+    }
+
+    namespace_pids[mount_namespace_id].push_back(pid);
+  }
+
+  WriteLock lock(mutex_);
+
+  // Send every job first so that the workers generate concurrently.
+  std::vector<std::string> pending;
+  for (const auto& namespace_entry : namespace_pids) {
+    const auto& namespace_id = namespace_entry.first;
+
+    auto* worker = getWorker(namespace_id, namespace_entry.second.front());
+    if (worker == nullptr) {
+      continue;
+    }
+
+    // The job keeps the query constraints but only the namespace's pids.
+    QueryContext job_context;
+    job_context.colsUsed = context.colsUsed;
+    job_context.colsUsedBitset = context.colsUsedBitset;
+    for (const auto& column : context.constraints) {
+      auto& job_constraints = job_context.constraints[column.first];
+      job_constraints.affinity = column.second.affinity;
+      if (column.first != "pid_with_namespace") {
+        for (const auto& constraint : column.second.getAll()) {
+          job_constraints.add(constraint);
+        }
+      }
+    }
+
+    auto& job_pids = job_context.constraints["pid_with_namespace"];
+    for (const auto pid : namespace_entry.second) {
+      job_pids.add(Constraint(EQUALS, std::to_string(pid)));
+    }
+
+    auto status = worker->sendJob(job_context, table_name, generate_ptr);
+    if (!status.ok()) {
+      LOG(ERROR) << "Table " << table_name
+                 << " failed to send a job to the container worker of "
+                    "namespace "
+                 << namespace_id << ": " << status.getMessage();
+      stopWorker(namespace_id);
+      continue;
+    }
+
+    pending.push_back(namespace_id);
+  }
+
+  for (const auto& namespace_id : pending) {
+    auto status = workers_.at(namespace_id).worker->receiveQueryData(results);
+
+    if (!status.ok()) {
+      LOG(ERROR) << "Table " << table_name
+                 << " failed to retrieve QueryData from the container worker "
+                    "of namespace "
+                 << namespace_id << ": " << status.getMessage();
+      stopWorker(namespace_id);
+    }
+  }
+
+  evictWorkers();
+  return results;
+}
+
 QueryData generateInNamespace(const QueryContext& context,
                               const std::string& table_name,
                               TableGeneratePtr generate_ptr) {
   bool keep_container_worker_open = FLAGS_keep_container_worker_open;
   QueryData results;
 
+  if (FLAGS_container_worker_pool) {
+    try {
+      return LinuxContainerWorkerPool::instance().generate(
+          context, table_name, generate_ptr);
+    } catch (const std::exception& e) {
+      LOG(ERROR) << "Table " << table_name
+                 << " failed to run query in the container: " << e.what();
+      return results;
+    }
+  }
+
   static PipeChannelFactory factory;
 
   try {
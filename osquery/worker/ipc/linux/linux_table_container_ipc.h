@@ -11,10 +11,17 @@
 
 #include "osquery/worker/ipc/linux/linux_table_ipc.h"
 
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include <osquery/core/tables.h>
 #include <osquery/logger/logger.h>
+#include <osquery/process/process.h>
+#include <osquery/utils/mutex.h>
 #include <osquery/utils/status/status.h>
 
 #include "osquery/worker/ipc/posix/pipe_channel.h"
@@ -80,6 +87,102 @@ class LinuxTableContainerIPC : TableIPCMessageHandler {
   FRIEND_TEST(WorkerTableContainerTests, test_ipc_container_connect);
 };
 
+/**
+ * @brief A long-lived worker inside one mount namespace, serving every table.
+ *
+ * The worker enters the namespace once when it is forked. Each job names the
+ * table and the address of its generate function, valid in the worker since
+ * it is a fork of this process. Rows are sent back using the binary encoding.
+ */
+class LinuxContainerNamespaceWorker : TableIPCMessageHandler {
+ public:
+  LinuxContainerNamespaceWorker() = delete;
+  LinuxContainerNamespaceWorker(PipeChannelFactory& factory,
+                                const std::string& namespace_id);
+  ~LinuxContainerNamespaceWorker();
+
+  /**
+   * @brief Fork the worker into the mount namespace of a process.
+   *
+   * @param namespace_pid a process in the namespace.
+   * @param in_child called in the worker right after the fork.
+   */
+  Status start(pid_t namespace_pid, const std::function<void()>& in_child);
+
+  /// Check if the worker process is still running.
+  bool isRunning();
+
+  /// Send a job generating a table for the processes of the context.
+  Status sendJob(const QueryContext& context,
+                 const std::string& table_name,
+                 TableGeneratePtr generate_ptr);
+
+  /// Wait for the rows of the last job and append them.
+  Status receiveQueryData(QueryData& results);
+
+  /// Close the channel to the worker, in the worker this only drops the fds.
+  void closeChannel();
+
+  /// Close the channel and stop the worker process.
+  void stop();
+
+  Status handleLog(GLOGLogType log_type,
+                   int priority,
+                   const std::string& message) override;
+  Status handleJob(QueryContext& context) override;
+
+ private:
+  [[noreturn]] void executeQueryJobs();
+
+  LinuxTableIPC ipc_;
+  LinuxTableIPCLogger logger_{ipc_};
+  const std::string namespace_id_;
+  PlatformProcess process_;
+};
+
+/**
+ * @brief The container workers used when container_worker_pool is set.
+ *
+ * Workers are keyed by mount namespace and serve every container-aware
+ * table. A query sends a job to the worker of each namespace it constrains
+ * before collecting any rows, so the namespaces are generated concurrently.
+ * The least recently used workers are stopped beyond container_worker_pool_max.
+ */
+class LinuxContainerWorkerPool {
+ public:
+  static LinuxContainerWorkerPool& instance();
+
+  QueryData generate(const QueryContext& context,
+                     const std::string& table_name,
+                     TableGeneratePtr generate_ptr);
+
+  ~LinuxContainerWorkerPool();
+
+ private:
+  LinuxContainerWorkerPool() = default;
+
+  /// Return the running worker of a namespace, starting it when needed.
+  LinuxContainerNamespaceWorker* getWorker(const std::string& namespace_id,
+                                           pid_t namespace_pid);
+
+  void stopWorker(const std::string& namespace_id);
+
+  /// Stop the least recently used workers beyond the maximum.
+  void evictWorkers();
+
+  struct PooledWorker {
+    std::unique_ptr<LinuxContainerNamespaceWorker> worker;
+    std::uint64_t last_used{0};
+  };
+
+  /// Held while jobs are sent and collected.
+  Mutex mutex_;
+
+  PipeChannelFactory factory_;
+  std::map<std::string, PooledWorker> workers_;
+  std::uint64_t use_counter_{0};
+};
+
 inline bool hasNamespaceConstraint(const QueryContext& context) {
   return context.hasConstraint("pid_with_namespace");
 }
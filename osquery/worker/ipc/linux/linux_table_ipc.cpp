@@ -9,6 +9,8 @@
 
 #include "linux_table_ipc.h"
 
+#include <osquery/utils/conversions/tryto.h>
+
 namespace osquery {
 Status LinuxTableIPC::sendJSONString(const std::string& json_string) {
   if (active_channel_ == nullptr) {
@@ -58,6 +60,21 @@ Status LinuxTableIPC::processJobMessage(const JSON& json_message) {
     return Status::failure(error_message);
   }
 
+  // Workers serving several tables are told which one to generate.
+  job_table_name_.clear();
+  job_generate_address_ = 0;
+  const auto& doc = json_message.doc();
+  if (doc.HasMember("Generate") && doc["Generate"].IsString() &&
+      doc.HasMember("Table") && doc["Table"].IsString()) {
+    auto address =
+        tryTo<std::uint64_t>(std::string(doc["Generate"].GetString()));
+    if (address.isError()) {
+      return Status::failure("Invalid generate function in the job");
+    }
+    job_table_name_ = doc["Table"].GetString();
+    job_generate_address_ = address.take();
+  }
+
   return message_handler_->handleJob(context);
 }
 
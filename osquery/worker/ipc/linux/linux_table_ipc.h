@@ -63,8 +63,20 @@ class LinuxTableIPC : public TableIPCBase<LinuxTableIPC> {
     return active_channel_ ? active_channel_->table_name_ : "Not Connected";
   }
 
+  /// The table of the job being handled, when the job names one.
+  const std::string& getJobTableName() const {
+    return job_table_name_;
+  }
+
+  /// The generate function address of the job being handled, or 0.
+  std::uint64_t getJobGenerateAddress() const {
+    return job_generate_address_;
+  }
+
  private:
   PipeChannel* active_channel_{nullptr};
+  std::string job_table_name_;
+  std::uint64_t job_generate_address_{0};
   PipeChannelFactory* factory_;
   TableIPCMessageHandler* message_handler_;
 };
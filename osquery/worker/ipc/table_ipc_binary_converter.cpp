@@ -0,0 +1,127 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#include "table_ipc_binary_converter.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace osquery {
+
+namespace {
+
+const std::string kBinaryQueryDataMagic{"\0OQD", 4};
+
+void appendLength(std::string& message, std::size_t length) {
+  auto value = static_cast<std::uint32_t>(length);
+  message.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void appendString(std::string& message, const std::string& value) {
+  appendLength(message, value.size());
+  message.append(value);
+}
+
+bool readLength(const std::string& message,
+                std::size_t& offset,
+                std::uint32_t& length) {
+  if (message.size() - offset < sizeof(length)) {
+    return false;
+  }
+
+  std::memcpy(&length, message.data() + offset, sizeof(length));
+  offset += sizeof(length);
+  return true;
+}
+
+bool readString(const std::string& message,
+                std::size_t& offset,
+                std::string& value) {
+  std::uint32_t length{0};
+  if (!readLength(message, offset, length) ||
+      message.size() - offset < length) {
+    return false;
+  }
+
+  value.assign(message, offset, length);
+  offset += length;
+  return true;
+}
+
+} // namespace
+
+bool TableIPCBinaryConverter::isBinaryQueryData(const std::string& message) {
+  return message.compare(0, kBinaryQueryDataMagic.size(),
+                         kBinaryQueryDataMagic) == 0;
+}
+
+void TableIPCBinaryConverter::queryDataToBinary(const QueryData& query_data,
+                                                std::string& message) {
+  std::size_t size = kBinaryQueryDataMagic.size() + sizeof(std::uint32_t);
+  for (const auto& row : query_data) {
+    size += sizeof(std::uint32_t);
+    for (const auto& column : row) {
+      size += 2 * sizeof(std::uint32_t) + column.first.size() +
+              column.second.size();
+    }
+  }
+
+  message.clear();
+  message.reserve(size);
+  message.append(kBinaryQueryDataMagic);
+  appendLength(message, query_data.size());
+  for (const auto& row : query_data) {
+    appendLength(message, row.size());
+    for (const auto& column : row) {
+      appendString(message, column.first);
+      appendString(message, column.second);
+    }
+  }
+}
+
+Status TableIPCBinaryConverter::binaryToQueryData(const std::string& message,
+                                                  QueryData& query_data) {
+  if (!isBinaryQueryData(message)) {
+    return Status::failure("Not a binary QueryData message");
+  }
+
+  std::size_t offset = kBinaryQueryDataMagic.size();
+  std::uint32_t row_count{0};
+  if (!readLength(message, offset, row_count)) {
+    return Status::failure("Truncated binary QueryData message");
+  }
+
+  query_data.reserve(query_data.size() + row_count);
+  for (std::uint32_t i = 0; i < row_count; ++i) {
+    std::uint32_t column_count{0};
+    if (!readLength(message, offset, column_count)) {
+      return Status::failure("Truncated binary QueryData message");
+    }
+
+    Row row;
+    for (std::uint32_t j = 0; j < column_count; ++j) {
+      std::string name;
+      std::string value;
+      if (!readString(message, offset, name) ||
+          !readString(message, offset, value)) {
+        return Status::failure("Truncated binary QueryData message");
+      }
+      row[std::move(name)] = std::move(value);
+    }
+    query_data.push_back(std::move(row));
+  }
+
+  if (offset != message.size()) {
+    return Status::failure("Trailing bytes in binary QueryData message");
+  }
+
+  return Status::success();
+}
+
+} // namespace osquery
@@ -0,0 +1,41 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+#pragma once
+
+#include <string>
+
+#include <osquery/core/sql/query_data.h>
+#include <osquery/utils/status/status.h>
+
+namespace osquery {
+
+/**
+ * @brief A length-prefixed binary encoding of QueryData for table workers.
+ *
+ * Both ends of a pipe run the same binary on the same host, so lengths are
+ * written in the native byte order. Messages start with a NUL byte, which a
+ * JSON message never does, so both encodings can share a channel.
+ *
+ * Layout: magic, row count, then for each row its column count followed by
+ * the length and bytes of each column name and value. Counts and lengths are
+ * 32-bit.
+ */
+class TableIPCBinaryConverter {
+ public:
+  /// Check if a message uses the binary QueryData encoding.
+  static bool isBinaryQueryData(const std::string& message);
+
+  static void queryDataToBinary(const QueryData& query_data,
+                                std::string& message);
+
+  static Status binaryToQueryData(const std::string& message,
+                                  QueryData& query_data);
+};
+} // namespace osquery
@@ -37,6 +37,35 @@ class TestTableIPC : public TableIPCBase<TestTableIPC> {
   JSON json_helper;
 };
 
+/// Keeps the last message as sent, binary messages are not JSON.
+class TestRawTableIPC : public TableIPCBase<TestRawTableIPC> {
+ public:
+  Status sendJSONString(const std::string message) {
+    last_message = message;
+    return Status::success();
+  }
+
+  Status recvJSONString(std::string& message) {
+    message = last_message;
+    return Status::success();
+  }
+
+  Status processLogMessage(const JSON& json_message) {
+    return Status::success();
+  }
+
+  Status processJobMessage(const JSON& json_message) {
+    return Status::success();
+  }
+
+  Status processQueryDataMessage(const JSON& json_message,
+                                 QueryData& query_data) {
+    return TableIPCJSONConverter::JSONToQueryData(json_message, query_data);
+  }
+
+  std::string last_message;
+};
+
 class WorkerJSONConversionsTests : public testing::Test {
  public:
   void verifyMessageType(const rapidjson::Document& rapidjson_doc,
@@ -250,4 +279,45 @@ TEST_F(WorkerJSONConversionsTests, test_job_and_json_conversions) {
   ASSERT_TRUE(read_query_context.constraints["job_test_2"].exists(
       ConstraintOperator::MATCH));
 }
+
+TEST_F(WorkerJSONConversionsTests, test_querydata_and_binary_conversions) {
+  QueryData data;
+  Row r1;
+  r1["column1"] = "test";
+  r1["column2"] = std::string("with\0nul", 8);
+  data.push_back(r1);
+  data.push_back(Row());
+
+  Row r3;
+  r3["column1"] = "";
+  data.push_back(r3);
+
+  TestRawTableIPC ipc;
+  auto status = ipc.sendQueryDataBinary(data);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  EXPECT_TRUE(TableIPCBinaryConverter::isBinaryQueryData(ipc.last_message));
+
+  QueryData results;
+  JSONMessageType message_type;
+  status = ipc.processOneMessage(&results, message_type);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  EXPECT_TRUE(message_type == JSONMessageType::QueryData);
+  EXPECT_EQ(results, data);
+
+  // Truncated messages are refused.
+  ipc.last_message.resize(ipc.last_message.size() - 1);
+  QueryData truncated;
+  status = ipc.processOneMessage(&truncated, message_type);
+  EXPECT_FALSE(status.ok());
+
+  // JSON rows still share the channel.
+  status = ipc.sendQueryData(data);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  EXPECT_FALSE(TableIPCBinaryConverter::isBinaryQueryData(ipc.last_message));
+
+  QueryData json_results;
+  status = ipc.processOneMessage(&json_results, message_type);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+  EXPECT_EQ(json_results.size(), data.size());
+}
 } // namespace osquery
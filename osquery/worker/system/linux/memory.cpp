@@ -9,6 +9,8 @@
 
 #include "memory.h"
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <malloc.h>
 
@@ -21,6 +23,37 @@ namespace osquery {
 DECLARE_bool(disable_watchdog);
 
 #ifdef OSQUERY_LINUX
+DECLARE_uint64(malloc_trim_interval);
+
+namespace {
+
+/// Steady clock milliseconds of the last memory check, 0 before the first.
+std::atomic<std::int64_t> last_memory_check{0};
+
+/**
+ * @brief Claim the next memory check, once per malloc_trim_interval.
+ *
+ * The scheduler, distributed and yara callers release memory after each of
+ * their queries; reading the RSS and trimming every malloc arena that often
+ * costs more than the memory it gives back. A single caller wins the check
+ * when several threads finish a query at the same time.
+ */
+bool claimMemoryCheck() {
+  auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+                 std::chrono::steady_clock::now().time_since_epoch())
+                 .count();
+  // Never 0, so the first call always checks.
+  now = std::max<std::int64_t>(now, 1);
+
+  auto last = last_memory_check.load();
+  auto interval = static_cast<std::int64_t>(FLAGS_malloc_trim_interval) * 1000;
+  if (last != 0 && now - last < interval) {
+    return false;
+  }
+  return last_memory_check.compare_exchange_strong(last, now);
+}
+
+} // namespace
 
 void releaseRetainedMemory() {
   /* The logic used for choosing the limit at which malloc_trim is called is as
@@ -67,6 +100,10 @@ void releaseRetainedMemory() {
     }
   }
 
+  if (!claimMemoryCheck()) {
+    return;
+  }
+
   auto used_memory_res = getProcRSS("self");
 
   if (used_memory_res.isError()) {
@@ -12,7 +12,8 @@
 namespace osquery {
 #ifdef OSQUERY_LINUX
 /* Attempts to release retained memory if the memory usage
-   of the current process goes above a certain threshold. */
+   of the current process goes above a certain threshold.
+   The usage is checked at most once per malloc_trim_interval seconds. */
 void releaseRetainedMemory();
 #endif
 } // namespace osquery
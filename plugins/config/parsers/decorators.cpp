@@ -7,12 +7,15 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <mutex>
+
 #include <osquery/config/config.h>
 #include <osquery/core/flags.h>
 #include <osquery/logger/logger.h>
 #include <osquery/registry/registry_factory.h>
 #include <osquery/sql/sql.h>
 #include <osquery/utils/json/json.h>
+#include <osquery/utils/system/time.h>
 #include <plugins/config/parsers/decorators.h>
 
 namespace osquery {
@@ -38,6 +41,20 @@ using DecorationStore = std::map<std::string, KeyValueMap>;
 
 namespace {
 
+/// An always decorator query and when its decorations were last added.
+struct AlwaysDecorator {
+  std::string query;
+
+  /// Seconds the decorations are reused for, 0 to run once per schedule step.
+  uint64_t ttl{0};
+
+  /// The schedule step of the last run, 0 before the first.
+  uint64_t step{0};
+
+  /// The time of the last run.
+  uint64_t time{0};
+};
+
 /**
  * @brief A simple ConfigParserPlugin for a "decorators" dictionary key.
  *
@@ -50,6 +67,10 @@ namespace {
  * always: run these decorators for every query immediate before
  * interval: run these decorators on an interval.
  *
+ * The queries of a schedule step share the always decorations, they run once
+ * per step. An always decorator may also be an object with a "query" and a
+ * "ttl" in seconds, its decorations are then reused until the ttl expires.
+ *
  * When 'interval' is used, the value is a dictionary of intervals, each of the
  * subkeys are treated as the requested interval in sections. The internals
  * are emulated by the query schedule.
@@ -82,7 +103,7 @@ class DecoratorsConfigParserPlugin : public ConfigParserPlugin {
 
  public:
   /// Set of configuration sources to the set of decorator queries.
-  std::map<std::string, std::vector<std::string>> always_;
+  std::map<std::string, std::vector<AlwaysDecorator>> always_;
 
   /// Set of configuration sources to the set of on-load decorator queries.
   std::map<std::string, std::vector<std::string>> load_;
@@ -100,12 +121,16 @@ class DecoratorsConfigParserPlugin : public ConfigParserPlugin {
 
   /// Protect the configuration controlled content.
   static Mutex kDecorationsConfigMutex;
+
+  /// Serialize the always decorators, concurrent queries run them once.
+  static std::mutex kAlwaysMutex;
 };
 } // namespace
 
 DecorationStore DecoratorsConfigParserPlugin::kDecorations;
 Mutex DecoratorsConfigParserPlugin::kDecorationsMutex;
 Mutex DecoratorsConfigParserPlugin::kDecorationsConfigMutex;
+std::mutex DecoratorsConfigParserPlugin::kAlwaysMutex;
 
 Status DecoratorsConfigParserPlugin::setUp() {
   // Decorators are kept within customized data structures.
@@ -189,9 +214,24 @@ void DecoratorsConfigParserPlugin::updateDecorations(const std::string& source,
     auto& always = doc.doc()[always_key];
     if (always.IsArray()) {
       for (const auto& item : always.GetArray()) {
+        AlwaysDecorator decorator;
         if (item.IsString()) {
-          always_[source].push_back(item.GetString());
+          decorator.query = item.GetString();
+        } else if (item.IsObject() && item.HasMember("query") &&
+                   item["query"].IsString()) {
+          decorator.query = item["query"].GetString();
+          if (item.HasMember("ttl")) {
+            if (!item["ttl"].IsUint64()) {
+              LOG(WARNING) << "Invalid always decorator ttl in config source: "
+                           << source;
+              continue;
+            }
+            decorator.ttl = item["ttl"].GetUint64();
+          }
+        } else {
+          continue;
         }
+        always_[source].push_back(std::move(decorator));
       }
     }
   }
@@ -268,6 +308,18 @@ inline void runDecorators(const std::string& source,
 #endif
 }
 
+/// Check if an always decorator must run again for a schedule step.
+inline bool isDecoratorDue(const AlwaysDecorator& decorator,
+                           uint64_t step,
+                           uint64_t now) {
+  if (decorator.ttl > 0) {
+    return decorator.time == 0 || now >= decorator.time + decorator.ttl;
+  }
+
+  // Callers outside of the schedule do not provide a step.
+  return step == 0 || decorator.step != step;
+}
+
 void clearDecorations(const std::string& source) {
   WriteLock lock(DecoratorsConfigParserPlugin::kDecorationsMutex);
   DecoratorsConfigParserPlugin::kDecorations[source].clear();
@@ -296,10 +348,23 @@ void runDecorators(DecorationPoint point,
       }
     }
   } else if (point == DECORATE_ALWAYS) {
-    for (const auto& target_source : dp->always_) {
-      if (source.empty() || target_source.first == source) {
-        runDecorators(target_source.first, target_source.second);
+    std::lock_guard<std::mutex> always_lock(
+        DecoratorsConfigParserPlugin::kAlwaysMutex);
+    auto now = getUnixTime();
+    for (auto& target_source : dp->always_) {
+      if (!source.empty() && target_source.first != source) {
+        continue;
+      }
+
+      std::vector<std::string> queries;
+      for (auto& decorator : target_source.second) {
+        if (isDecoratorDue(decorator, time, now)) {
+          decorator.step = time;
+          decorator.time = now;
+          queries.push_back(decorator.query);
+        }
       }
+      runDecorators(target_source.first, queries);
     }
   } else if (point == DECORATE_INTERVAL) {
     for (const auto& target_source : dp->intervals_) {
@@ -34,7 +34,8 @@ extern const std::map<DecorationPoint, std::string> kDecorationPointKeys;
  * decorators. The source tracking is abstracted for the decorator iterator.
  *
  * @param point request execution of decorators for this given point.
- * @param time an optional time for points using intervals.
+ * @param time an optional time for points using intervals, or the schedule
+ * step for always decorators, which run once per step.
  * @param source restrict run to a specific config source.
  */
 void runDecorators(DecorationPoint point,
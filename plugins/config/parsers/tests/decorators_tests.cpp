@@ -162,4 +162,35 @@ TEST_F(DecoratorsConfigParserPluginTests, test_invalid_decorators) {
   status = Config::get().update(decorators_as_number);
   ASSERT_FALSE(status.ok());
 }
+
+TEST_F(DecoratorsConfigParserPluginTests, test_decorators_run_always) {
+  std::map<std::string, std::string> config_data = {
+      {"awesome",
+       "{\"decorators\": {\"always\": [\"select 'test' as always_test\", "
+       "{\"query\": \"select 'ttl' as ttl_test\", \"ttl\": 3600}]}}"}};
+  auto status = Config::get().update(config_data);
+  ASSERT_TRUE(status.ok()) << status.getMessage();
+
+  FLAGS_disable_decorators = false;
+  runDecorators(DECORATE_ALWAYS, 100);
+
+  QueryLogItem item;
+  getDecorations(item.decorations);
+  EXPECT_EQ(item.decorations["always_test"], "test");
+  EXPECT_EQ(item.decorations["ttl_test"], "ttl");
+
+  // The queries of the same step share the decorations.
+  clearDecorations("awesome");
+  runDecorators(DECORATE_ALWAYS, 100);
+  QueryLogItem same_step;
+  getDecorations(same_step.decorations);
+  EXPECT_EQ(same_step.decorations.count("always_test"), 0U);
+
+  // The next step runs the decorators again, except during their ttl.
+  runDecorators(DECORATE_ALWAYS, 101);
+  QueryLogItem next_step;
+  getDecorations(next_step.decorations);
+  EXPECT_EQ(next_step.decorations["always_test"], "test");
+  EXPECT_EQ(next_step.decorations.count("ttl_test"), 0U);
+}
 } // namespace osquery
@@ -104,6 +104,43 @@ TEST_F(TLSConfigTests, test_retrieve_config) {
   EXPECT_EQ("baz", response[0]["tls_plugin"]);
 }
 
+TEST_F(TLSConfigTests, test_retrieve_config_etag) {
+  Flag::updateValue("config_tls_endpoint", "/config_etag");
+  Registry::get().setActive("config", "tls");
+
+  // The complete config is retrieved first, without its ETag.
+  PluginResponse response;
+  auto status = Registry::call("config", {{"action", "genConfig"}}, response);
+  ASSERT_TRUE(status.ok()) << status.what();
+  ASSERT_EQ(1U, response.size());
+
+  JSON config;
+  ASSERT_TRUE(config.fromString(response[0]["tls_plugin"]).ok());
+  EXPECT_FALSE(config.doc().HasMember("config_etag"));
+  ASSERT_TRUE(config.doc()["packs"].IsObject());
+  EXPECT_TRUE(config.doc()["packs"].HasMember("old_pack"));
+
+  // The server replies with a delta to the config of the ETag sent.
+  response.clear();
+  status = Registry::call("config", {{"action", "genConfig"}}, response);
+  ASSERT_TRUE(status.ok()) << status.what();
+  ASSERT_EQ(1U, response.size());
+
+  auto patched = response[0]["tls_plugin"];
+  config = JSON();
+  ASSERT_TRUE(config.fromString(patched).ok());
+  EXPECT_TRUE(config.doc().HasMember("schedule"));
+  EXPECT_FALSE(config.doc()["packs"].HasMember("old_pack"));
+  EXPECT_TRUE(config.doc()["packs"].HasMember("new_pack"));
+
+  // The config is unchanged, the last config is returned as-is.
+  response.clear();
+  status = Registry::call("config", {{"action", "genConfig"}}, response);
+  ASSERT_TRUE(status.ok()) << status.what();
+  ASSERT_EQ(1U, response.size());
+  EXPECT_EQ(patched, response[0]["tls_plugin"]);
+}
+
 TEST_F(TLSConfigTests, test_runner_and_scheduler) {
   Flag::updateValue("config_tls_endpoint", "/config");
   // Will cause another enroll.
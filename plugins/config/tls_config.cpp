@@ -45,6 +45,52 @@ DECLARE_bool(enroll_always);
 
 REGISTER(TLSConfigPlugin, "config", "tls");
 
+namespace {
+
+/**
+ * @brief Apply a config delta to a config.
+ *
+ * Each member of the delta replaces the member of the config, a null member
+ * removes it. The packs are replaced or removed one at a time.
+ */
+Status applyConfigDelta(const std::string& base,
+                        const rapidjson::Value& delta,
+                        std::string& content) {
+  if (!delta.IsObject()) {
+    return Status::failure("The config delta is not an object");
+  }
+
+  auto config = JSON::newObject();
+  auto status = config.fromString(base);
+  if (!status.ok() || !config.doc().IsObject()) {
+    return Status::failure("Cannot parse the config the delta applies to");
+  }
+
+  auto& doc = config.doc();
+  for (const auto& member : delta.GetObject()) {
+    std::string name = member.name.GetString();
+    auto packs = doc.FindMember("packs");
+    if (name == "packs" && member.value.IsObject() &&
+        packs != doc.MemberEnd() && packs->value.IsObject()) {
+      for (const auto& pack : member.value.GetObject()) {
+        std::string pack_name = pack.name.GetString();
+        if (pack.value.IsNull()) {
+          packs->value.RemoveMember(pack_name);
+        } else {
+          config.add(pack_name, pack.value, packs->value);
+        }
+      }
+    } else if (member.value.IsNull()) {
+      doc.RemoveMember(name);
+    } else {
+      config.add(name, member.value);
+    }
+  }
+  return config.toString(content);
+}
+
+} // namespace
+
 Status TLSConfigPlugin::setUp() {
   if (FLAGS_enroll_always && !FLAGS_disable_enrollment) {
     // clear any cached node key
@@ -57,46 +103,99 @@ Status TLSConfigPlugin::setUp() {
   }
 
   uri_ = TLSRequestHelper::makeURI(FLAGS_config_tls_endpoint);
+  etag_.clear();
+  config_.clear();
   return Status(0, "OK");
 }
 
 Status TLSConfigPlugin::genConfig(std::map<std::string, std::string>& config) {
-  std::string json;
   JSON params;
   if (FLAGS_tls_node_api) {
     // The TLS node API morphs some verbs and variables.
     params.add("_get", true);
+  } else if (!etag_.empty()) {
+    // The server may reply the config is unchanged, or with a delta.
+    params.add("config_etag", etag_);
   }
 
+  JSON response;
   auto s = TLSRequestHelper::go<JSONSerializer>(
-      uri_, params, json, FLAGS_config_tls_max_attempts);
+      uri_, params, response, FLAGS_config_tls_max_attempts);
+  if (!s.ok()) {
+    return s;
+  }
+
+  if (FLAGS_tls_node_api) {
+    // The node API embeds configuration data (JSON escaped).
+    if (!response.doc().IsObject()) {
+      return Status::failure(
+          "Root of the JSON from TLS config node API is not an object");
+    }
+
+    // Re-encode the config key into JSON.
+    auto it = response.doc().FindMember("config");
+    config["tls_plugin"] =
+        unescapeUnicode(it != response.doc().MemberEnd() && it->value.IsString()
+                            ? it->value.GetString()
+                            : "");
+    return s;
+  }
+
+  std::string content;
+  s = readConfig(response, content);
   if (s.ok()) {
-    if (FLAGS_tls_node_api) {
-      // The node API embeds configuration data (JSON escaped).
-
-      JSON tree;
-      Status parse_status = tree.fromString(json);
-      if (!parse_status.ok()) {
-        VLOG(1) << "Could not parse JSON from TLS config node API";
-        return Status::failure("Could not parse JSON from TLS config node API");
-      }
+    config["tls_plugin"] = std::move(content);
+  }
+  return s;
+}
 
-      if (!tree.doc().IsObject()) {
-        return Status::failure(
-            "Root of the JSON from TLS config node API is not an object");
-      }
+Status TLSConfigPlugin::readConfig(JSON& response, std::string& content) {
+  auto& doc = response.doc();
+  if (!doc.IsObject()) {
+    return JSONSerializer().serialize(response, content);
+  }
 
-      // Re-encode the config key into JSON.
-      auto it = tree.doc().FindMember("config");
-      config["tls_plugin"] =
-          unescapeUnicode(it != tree.doc().MemberEnd() && it->value.IsString()
-                              ? it->value.GetString()
-                              : "");
-    } else {
-      config["tls_plugin"] = json;
+  std::string etag;
+  auto it = doc.FindMember("config_etag");
+  if (it != doc.MemberEnd()) {
+    if (it->value.IsString()) {
+      etag = it->value.GetString();
+    }
+    doc.RemoveMember(it);
+  }
+
+  Status s;
+  it = doc.FindMember("config_unchanged");
+  auto unchanged = it != doc.MemberEnd() && it->value.IsBool() &&
+                   it->value.GetBool();
+  auto delta = doc.FindMember("config_delta");
+  if (unchanged && !config_.empty()) {
+    // The config was not sent, the last config is reused and not parsed.
+    content = config_;
+    if (etag.empty()) {
+      etag = etag_;
     }
+  } else if (delta != doc.MemberEnd() && !config_.empty()) {
+    s = applyConfigDelta(config_, delta->value, content);
+  } else if (unchanged || delta != doc.MemberEnd()) {
+    s = Status::failure("No config to apply the response to");
+  } else {
+    s = JSONSerializer().serialize(response, content);
+  }
+
+  if (!s.ok()) {
+    // Request the complete config next time.
+    etag_.clear();
+    config_.clear();
+    return s;
   }
 
+  etag_ = std::move(etag);
+  if (etag_.empty()) {
+    config_.clear();
+  } else {
+    config_ = content;
+  }
   return s;
 }
 } // namespace osquery
@@ -26,6 +26,22 @@ class TLSConfigPlugin : public ConfigPlugin,
   /// Calculate the URL once and cache the result.
   std::string uri_;
 
+ private:
+  /**
+   * @brief Read the config from a config endpoint response.
+   *
+   * The config may be unchanged or a delta to the last config retrieved, if
+   * the server assigned the last config an ETag.
+   */
+  Status readConfig(JSON& response, std::string& content);
+
+ private:
+  /// The ETag the server assigned to the last config, empty if none.
+  std::string etag_;
+
+  /// The last config retrieved, kept while the server assigns ETags.
+  std::string config_;
+
  private:
   friend class TLSConfigTests;
 };
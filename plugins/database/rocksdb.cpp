@@ -9,9 +9,14 @@
 
 #include <sys/stat.h>
 
+#include <rocksdb/cache.h>
 #include <rocksdb/db.h>
 #include <rocksdb/env.h>
+#include <rocksdb/experimental.h>
+#include <rocksdb/filter_policy.h>
 #include <rocksdb/options.h>
+#include <rocksdb/table.h>
+#include <rocksdb/write_buffer_manager.h>
 
 #include <osquery/core/flags.h>
 #include <osquery/filesystem/fileops.h>
@@ -31,8 +36,91 @@ HIDDEN_FLAG(int32, rocksdb_merge_number, 4, "Min write buffer number to merge");
 HIDDEN_FLAG(int32, rocksdb_background_flushes, 4, "Max background flushes");
 HIDDEN_FLAG(int32, rocksdb_buffer_blocks, 256, "Write buffer blocks (4k)");
 
+FLAG(uint64,
+     rocksdb_memory_budget,
+     0,
+     "Max MB of RocksDB memtables, 0 uses the sum of the domain budgets");
+
 DECLARE_string(database_path);
 
+namespace {
+
+/// Settings are small and rarely written.
+const size_t kSettingsWriteBufferSize = 64 * 1024;
+
+/// The block cache of the queries domain, holding the previous results.
+const size_t kQueriesBlockCacheSize = 4 * 1024 * 1024;
+
+/// Compact event files daily, expired events are removed with range deletes.
+const uint64_t kEventsCompactionTTL = 24 * 60 * 60;
+
+/// Compact log files hourly, sent logs are removed with range deletes.
+const uint64_t kLogsCompactionTTL = 60 * 60;
+
+/// The memory and compaction settings of a column family.
+struct ColumnFamilyProfile {
+  size_t write_buffer_size{0};
+  int max_write_buffer_number{0};
+  int min_write_buffer_number_to_merge{0};
+
+  /// A private block cache with bloom filters, 0 uses the shared defaults.
+  size_t block_cache_size{0};
+
+  /// Files older than this many seconds are compacted, 0 disables it.
+  uint64_t ttl{0};
+
+  /// The memtable bytes this column family may use.
+  size_t budget() const {
+    return write_buffer_size * static_cast<size_t>(max_write_buffer_number);
+  }
+};
+
+ColumnFamilyProfile getColumnFamilyProfile(const std::string& domain) {
+  ColumnFamilyProfile profile;
+  profile.write_buffer_size = (4 * 1024) * FLAGS_rocksdb_buffer_blocks;
+  profile.max_write_buffer_number =
+      static_cast<int>(FLAGS_rocksdb_write_buffer);
+  profile.min_write_buffer_number_to_merge =
+      static_cast<int>(FLAGS_rocksdb_merge_number);
+
+  if (domain == kPersistentSettings) {
+    profile.write_buffer_size = kSettingsWriteBufferSize;
+    profile.max_write_buffer_number = 2;
+    profile.min_write_buffer_number_to_merge = 1;
+  } else if (domain == kQueries) {
+    // Differential results are read, then overwritten, for each execution.
+    profile.block_cache_size = kQueriesBlockCacheSize;
+  } else if (domain == kEvents) {
+    profile.ttl = kEventsCompactionTTL;
+  } else if (domain == kLogs) {
+    profile.ttl = kLogsCompactionTTL;
+  }
+  return profile;
+}
+
+rocksdb::ColumnFamilyOptions getColumnFamilyOptions(
+    const rocksdb::Options& options,
+    const ColumnFamilyProfile& profile,
+    std::vector<std::shared_ptr<rocksdb::Cache>>& caches) {
+  rocksdb::ColumnFamilyOptions cf_options(options);
+  cf_options.write_buffer_size = profile.write_buffer_size;
+  cf_options.max_write_buffer_number = profile.max_write_buffer_number;
+  cf_options.min_write_buffer_number_to_merge =
+      profile.min_write_buffer_number_to_merge;
+  cf_options.ttl = profile.ttl;
+
+  if (profile.block_cache_size > 0) {
+    rocksdb::BlockBasedTableOptions table_options;
+    table_options.block_cache = rocksdb::NewLRUCache(profile.block_cache_size);
+    caches.push_back(table_options.block_cache);
+    table_options.filter_policy.reset(rocksdb::NewBloomFilterPolicy(10));
+    cf_options.table_factory.reset(
+        rocksdb::NewBlockBasedTableFactory(table_options));
+  }
+  return cf_options;
+}
+} // namespace
+
 /**
  * @brief Track external systems marking the RocksDB database as corrupted.
  *
@@ -123,17 +211,32 @@ Status RocksDBDatabasePlugin::setUp() {
     }
     options_.info_log = logger_;
 
+    // Each domain has a profile matching its access pattern.
+    auto default_profile = getColumnFamilyProfile("");
+    size_t budget = default_profile.budget();
+
     std::set<std::string> domain_set;
     column_families_.push_back(rocksdb::ColumnFamilyDescriptor(
-        rocksdb::kDefaultColumnFamilyName, options_));
+        rocksdb::kDefaultColumnFamilyName,
+        getColumnFamilyOptions(options_, default_profile, block_caches_)));
     domain_set.insert(rocksdb::kDefaultColumnFamilyName);
 
     for (const auto& cf_name : kDomains) {
-      column_families_.push_back(
-          rocksdb::ColumnFamilyDescriptor(cf_name, options_));
+      auto profile = getColumnFamilyProfile(cf_name);
+      budget += profile.budget();
+      column_families_.push_back(rocksdb::ColumnFamilyDescriptor(
+          cf_name, getColumnFamilyOptions(options_, profile, block_caches_)));
       domain_set.insert(cf_name);
     }
 
+    // The memtables of every column family share one bound, memtables are
+    // flushed when it is reached.
+    if (FLAGS_rocksdb_memory_budget > 0) {
+      budget = static_cast<size_t>(FLAGS_rocksdb_memory_budget) * 1024 * 1024;
+    }
+    options_.write_buffer_manager =
+        std::make_shared<rocksdb::WriteBufferManager>(budget);
+
     // To support osquery rollbacks, meaning running with a database
     // written/used by a newer version of osquery that introduced a new column
     // family, we need to open with all column families known by the database.
@@ -157,8 +260,10 @@ Status RocksDBDatabasePlugin::setUp() {
         if (domain_set.find(column_family_in_db) == domain_set.end()) {
           VLOG(1) << "Adding unknown column family from DB: "
                   << column_family_in_db;
-          column_families_.push_back(
-              rocksdb::ColumnFamilyDescriptor(column_family_in_db, options_));
+          column_families_.push_back(rocksdb::ColumnFamilyDescriptor(
+              column_family_in_db,
+              getColumnFamilyOptions(
+                  options_, default_profile, block_caches_)));
         }
       }
     }
@@ -206,7 +311,7 @@ Status RocksDBDatabasePlugin::setUp() {
 Status RocksDBDatabasePlugin::compactFiles(const std::string& domain) {
   auto handle = getHandleForColumnFamily(domain);
   if (handle == nullptr) {
-    return Status::failure(1, "Handle does not exist");
+    return Status::staticFailure(1, "Handle does not exist");
   }
 
   rocksdb::ColumnFamilyMetaData cf_meta;
@@ -235,6 +340,37 @@ Status RocksDBDatabasePlugin::compactFiles(const std::string& domain) {
   return Status::success();
 }
 
+Status RocksDBDatabasePlugin::reclaim() {
+  if (db_ == nullptr) {
+    return Status::staticFailure("Database is not open");
+  }
+
+  // Memtables are flushed by the background threads, the call returns.
+  rocksdb::FlushOptions flush_options;
+  flush_options.wait = false;
+  for (auto handle : handles_) {
+    auto s = db_->Flush(flush_options, handle);
+    if (!s.ok()) {
+      VLOG(1) << "Cannot flush RocksDB memtable: " << s.ToString();
+    }
+  }
+
+  // Overwritten results and sent logs leave the most obsolete data.
+  for (const auto& domain : {kQueries, kLogs}) {
+    auto s = rocksdb::experimental::SuggestCompactRange(
+        db_, getHandleForColumnFamily(domain), nullptr, nullptr);
+    if (!s.ok()) {
+      VLOG(1) << "Cannot compact RocksDB domain " << domain << ": "
+              << s.ToString();
+    }
+  }
+
+  for (const auto& cache : block_caches_) {
+    cache->EraseUnRefEntries();
+  }
+  return Status::success();
+}
+
 void RocksDBDatabasePlugin::tearDown() {
   close();
 }
@@ -302,18 +438,29 @@ rocksdb::ColumnFamilyHandle* RocksDBDatabasePlugin::getHandleForColumnFamily(
   }
 }
 
+/// Convert a RocksDB status, without formatting a success or a missing key.
+inline Status getStatus(const rocksdb::Status& s) {
+  if (s.ok()) {
+    return Status::success();
+  }
+  if (s.IsNotFound() && s.getState() == nullptr) {
+    return Status::staticFailure(s.code(), "NotFound: ");
+  }
+  return Status(s.code(), s.ToString());
+}
+
 Status RocksDBDatabasePlugin::get(const std::string& domain,
                                   const std::string& key,
                                   std::string& value) const {
   if (getDB() == nullptr) {
-    return Status(1, "Database not opened");
+    return Status::staticFailure("Database not opened");
   }
   auto cfh = getHandleForColumnFamily(domain);
   if (cfh == nullptr) {
     return Status(1, "Could not get column family for " + domain);
   }
   auto s = getDB()->Get(rocksdb::ReadOptions(), cfh, key, &value);
-  return Status(s.code(), s.ToString());
+  return getStatus(s);
 }
 
 Status RocksDBDatabasePlugin::get(const std::string& domain,
@@ -324,47 +471,30 @@ Status RocksDBDatabasePlugin::get(const std::string& domain,
   if (s.ok()) {
     auto expectedValue = tryTo<int>(result);
     if (expectedValue.isError()) {
-      return Status::failure("Could not deserialize str to int");
+      return Status::staticFailure("Could not deserialize str to int");
     } else {
       value = expectedValue.take();
     }
   }
   return s;
 }
-Status RocksDBDatabasePlugin::put(const std::string& domain,
-                                  const std::string& key,
-                                  const std::string& value) {
-  return putBatch(domain, {std::make_pair(key, value)});
-}
 
 inline bool skipWal(const std::string& domain) {
   return (kEvents == domain);
 }
 
-Status RocksDBDatabasePlugin::putBatch(const std::string& domain,
-                                       const DatabaseStringValueList& data) {
-  auto cfh = getHandleForColumnFamily(domain);
-  if (cfh == nullptr) {
-    return Status(1, "Could not get column family for " + domain);
-  }
-
-  // Events should be fast, and do not need to force syncs.
+/// Events should be fast, and do not need to force syncs.
+inline rocksdb::WriteOptions getWriteOptions(const std::string& domain) {
   auto options = rocksdb::WriteOptions();
   if (skipWal(domain)) {
     options.disableWAL = true;
   } else {
     options.sync = false;
   }
+  return options;
+}
 
-  rocksdb::WriteBatch batch;
-  for (const auto& p : data) {
-    const auto& key = p.first;
-    const auto& value = p.second;
-
-    batch.Put(cfh, key, value);
-  }
-
-  auto s = getDB()->Write(options, &batch);
+inline Status getWriteStatus(const rocksdb::Status& s) {
   if (s.code() != 0 && s.IsIOError()) {
     // An error occurred, check if it is an IO error and remove the offending
     // specific filename or log name.
@@ -375,13 +505,45 @@ Status RocksDBDatabasePlugin::putBatch(const std::string& domain,
     }
   }
 
-  return Status(s.code(), s.ToString());
+  return getStatus(s);
+}
+
+Status RocksDBDatabasePlugin::put(const std::string& domain,
+                                  const std::string& key,
+                                  const std::string& value) {
+  auto cfh = getHandleForColumnFamily(domain);
+  if (cfh == nullptr) {
+    return Status(1, "Could not get column family for " + domain);
+  }
+
+  // A single value does not need a batch copy.
+  auto s = getDB()->Put(getWriteOptions(domain), cfh, key, value);
+  return getWriteStatus(s);
+}
+
+Status RocksDBDatabasePlugin::putBatch(const std::string& domain,
+                                       const DatabaseStringValueList& data) {
+  auto cfh = getHandleForColumnFamily(domain);
+  if (cfh == nullptr) {
+    return Status(1, "Could not get column family for " + domain);
+  }
+
+  rocksdb::WriteBatch batch;
+  for (const auto& p : data) {
+    const auto& key = p.first;
+    const auto& value = p.second;
+
+    batch.Put(cfh, key, value);
+  }
+
+  auto s = getDB()->Write(getWriteOptions(domain), &batch);
+  return getWriteStatus(s);
 }
 
 Status RocksDBDatabasePlugin::put(const std::string& domain,
                                   const std::string& key,
                                   int value) {
-  return putBatch(domain, {std::make_pair(key, std::to_string(value))});
+  return put(domain, key, std::to_string(value));
 }
 
 Status RocksDBDatabasePlugin::remove(const std::string& domain,
@@ -400,7 +562,7 @@ Status RocksDBDatabasePlugin::remove(const std::string& domain,
     options.sync = false;
   }
   auto s = getDB()->Delete(options, cfh, key);
-  return Status(s.code(), s.ToString());
+  return getStatus(s);
 }
 
 Status RocksDBDatabasePlugin::removeRange(const std::string& domain,
@@ -409,7 +571,7 @@ Status RocksDBDatabasePlugin::removeRange(const std::string& domain,
   // The new RocksDB version will return an error if our range
   // is not correct
   if (low > high) {
-    return Status::failure("Invalid range: low > high");
+    return Status::staticFailure("Invalid range: low > high");
   }
 
   auto cfh = getHandleForColumnFamily(domain);
@@ -429,7 +591,7 @@ Status RocksDBDatabasePlugin::removeRange(const std::string& domain,
   if (low <= high) {
     s = getDB()->Delete(options, cfh, high);
   }
-  return Status(s.code(), s.ToString());
+  return getStatus(s);
 }
 
 Status RocksDBDatabasePlugin::scan(const std::string& domain,
@@ -437,9 +599,35 @@ Status RocksDBDatabasePlugin::scan(const std::string& domain,
                                    const std::string& prefix,
                                    uint64_t max) const {
   if (getDB() == nullptr) {
-    return Status(1, "Database not opened");
+    return Status::staticFailure("Database not opened");
   }
 
+  return scanPrefix(domain, prefix, max, [&results](rocksdb::Iterator& it) {
+    results.push_back(it.key().ToString());
+    return true;
+  });
+}
+
+Status RocksDBDatabasePlugin::scanValues(
+    const std::string& domain,
+    const std::string& prefix,
+    uint64_t max,
+    const DatabaseScanCallback& callback) const {
+  if (getDB() == nullptr) {
+    return Status::staticFailure("Database not opened");
+  }
+
+  return scanPrefix(domain, prefix, max, [&callback](rocksdb::Iterator& it) {
+    auto value = it.value().ToString();
+    return callback(it.key().ToString(), value);
+  });
+}
+
+Status RocksDBDatabasePlugin::scanPrefix(
+    const std::string& domain,
+    const std::string& prefix,
+    uint64_t max,
+    const std::function<bool(rocksdb::Iterator&)>& callback) const {
   auto cfh = getHandleForColumnFamily(domain);
   if (cfh == nullptr) {
     return Status(1, "Could not get column family for " + domain);
@@ -447,22 +635,35 @@ Status RocksDBDatabasePlugin::scan(const std::string& domain,
   auto options = rocksdb::ReadOptions();
   options.verify_checksums = false;
   options.fill_cache = false;
-  auto it = getDB()->NewIterator(options, cfh);
+
+  // Keys are sorted, the iteration stops before the first key greater than
+  // every key starting with the prefix.
+  std::string upper_bound = prefix;
+  while (!upper_bound.empty() &&
+         static_cast<unsigned char>(upper_bound.back()) == 0xFF) {
+    upper_bound.pop_back();
+  }
+  rocksdb::Slice upper_bound_slice;
+  if (!upper_bound.empty()) {
+    upper_bound.back() = static_cast<char>(upper_bound.back() + 1);
+    upper_bound_slice = upper_bound;
+    options.iterate_upper_bound = &upper_bound_slice;
+  }
+
+  std::unique_ptr<rocksdb::Iterator> it(getDB()->NewIterator(options, cfh));
   if (it == nullptr) {
     return Status(1, "Could not get iterator for " + domain);
   }
 
-  size_t count = 0;
-  for (it->SeekToFirst(); it->Valid(); it->Next()) {
-    auto key = it->key().ToString();
-    if (key.find(prefix) == 0) {
-      results.push_back(std::move(key));
-      if (max > 0 && ++count >= max) {
-        break;
-      }
+  uint64_t count = 0;
+  for (it->Seek(prefix); it->Valid(); it->Next()) {
+    if (!it->key().starts_with(prefix)) {
+      break;
+    }
+    if (!callback(*it) || (max > 0 && ++count >= max)) {
+      break;
     }
   }
-  delete it;
   return Status::success();
 }
 } // namespace osquery
@@ -8,6 +8,7 @@
  */
 
 #include <atomic>
+#include <functional>
 
 #include <rocksdb/db.h>
 
@@ -71,6 +72,12 @@ class RocksDBDatabasePlugin : public DatabasePlugin {
               const std::string& prefix,
               uint64_t max) const override;
 
+  /// Key and value lookup method, a single iteration.
+  Status scanValues(const std::string& domain,
+                    const std::string& prefix,
+                    uint64_t max,
+                    const DatabaseScanCallback& callback) const override;
+
  public:
   /// Database workflow: open and setup.
   Status setUp() override;
@@ -78,6 +85,9 @@ class RocksDBDatabasePlugin : public DatabasePlugin {
   /// Database workflow: close and cleanup.
   void tearDown() override;
 
+  /// Flush memtables, suggest compactions and empty the block caches.
+  Status reclaim() override;
+
   /// Need to tear down open resources.
   virtual ~RocksDBDatabasePlugin() {
     close();
@@ -102,6 +112,13 @@ class RocksDBDatabasePlugin : public DatabasePlugin {
    */
   rocksdb::DB* getDB() const;
 
+  /// Iterate the keys starting with a prefix, stop when the callback fails.
+  Status scanPrefix(
+      const std::string& domain,
+      const std::string& prefix,
+      uint64_t max,
+      const std::function<bool(rocksdb::Iterator&)>& callback) const;
+
   /// Request RocksDB compact each domain and level to that same level.
   Status compactFiles(const std::string& domain);
 
@@ -145,6 +162,9 @@ class RocksDBDatabasePlugin : public DatabasePlugin {
   /// The RocksDB connection options that are used to connect to RocksDB
   rocksdb::Options options_;
 
+  /// The block caches created for the column family profiles.
+  std::vector<std::shared_ptr<rocksdb::Cache>> block_caches_;
+
   /// Deconstruction mutex.
   Mutex close_mutex_;
 
@@ -152,5 +172,6 @@ class RocksDBDatabasePlugin : public DatabasePlugin {
   friend class GlogRocksDBLogger;
   FRIEND_TEST(RocksDBDatabasePluginTests, test_corruption);
   FRIEND_TEST(RocksDBDatabasePluginTests, test_column_families_rollback);
+  FRIEND_TEST(RocksDBDatabasePluginTests, test_column_family_profiles);
 };
 } // namespace osquery
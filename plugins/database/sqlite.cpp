@@ -21,6 +21,11 @@
 
 namespace osquery {
 
+FLAG(bool,
+     database_sqlite_performance,
+     false,
+     "Use a WAL journal and incremental vacuum in the SQLite database");
+
 const std::map<std::string, std::string> kDBSettings = {
     {"synchronous", "OFF"},
     {"count_changes", "OFF"},
@@ -31,6 +36,66 @@ const std::map<std::string, std::string> kDBSettings = {
     {"page_count", "1000"},
 };
 
+/// The settings replaced by the performance mode.
+const std::map<std::string, std::string> kDBPerformanceSettings = {
+    {"auto_vacuum", "INCREMENTAL"},
+    {"journal_mode", "WAL"},
+};
+
+/// Writes between incremental vacuums, and the pages each one reclaims.
+const size_t kIncrementalVacuumWrites{1000};
+const size_t kIncrementalVacuumPages{256};
+
+namespace {
+
+/// Return a cached statement to its initial state once it was used.
+class StatementReset {
+ public:
+  explicit StatementReset(sqlite3_stmt* stmt) : stmt_(stmt) {}
+
+  ~StatementReset() {
+    if (stmt_ != nullptr) {
+      sqlite3_reset(stmt_);
+      sqlite3_clear_bindings(stmt_);
+    }
+  }
+
+ private:
+  sqlite3_stmt* stmt_;
+};
+
+void bindText(sqlite3_stmt* stmt, int index, const std::string& text) {
+  sqlite3_bind_text(
+      stmt, index, text.data(), static_cast<int>(text.size()), SQLITE_STATIC);
+}
+
+std::string columnText(sqlite3_stmt* stmt, int index) {
+  auto text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, index));
+  if (text == nullptr) {
+    return "";
+  }
+  return std::string(text, sqlite3_column_bytes(stmt, index));
+}
+
+/**
+ * @brief The smallest key greater than every key starting with a prefix.
+ *
+ * Keys compare as bytes, the last byte below 0xFF is incremented. An empty
+ * result means there is no upper bound.
+ */
+std::string prefixUpperBound(std::string prefix) {
+  while (!prefix.empty() && static_cast<unsigned char>(prefix.back()) == 0xFF) {
+    prefix.pop_back();
+  }
+  if (!prefix.empty()) {
+    prefix.back() =
+        static_cast<char>(static_cast<unsigned char>(prefix.back()) + 1);
+  }
+  return prefix;
+}
+
+} // namespace
+
 Status SQLiteDatabasePlugin::setUp() {
   if (!allowOpen()) {
     LOG(WARNING) << RLOG(1629) << "Not allowed to set up database plugin";
@@ -64,6 +129,21 @@ Status SQLiteDatabasePlugin::setUp() {
     return Status(1, "Cannot open database: " + std::to_string(result));
   }
 
+  // The vacuum mode of a new database is set before its tables are created.
+  performance_ = FLAGS_database_sqlite_performance;
+  auto db_settings = kDBSettings;
+  if (performance_) {
+    for (const auto& setting : kDBPerformanceSettings) {
+      db_settings[setting.first] = setting.second;
+    }
+  }
+
+  std::string settings;
+  for (const auto& setting : db_settings) {
+    settings += "PRAGMA " + setting.first + "=" + setting.second + "; ";
+  }
+  sqlite3_exec(db_, settings.c_str(), nullptr, nullptr, nullptr);
+
   for (const auto& domain : kDomains) {
     std::string q = "create table if not exists " + domain +
                     " (key TEXT PRIMARY KEY, value TEXT);";
@@ -74,11 +154,17 @@ Status SQLiteDatabasePlugin::setUp() {
     }
   }
 
-  std::string settings;
-  for (const auto& setting : kDBSettings) {
-    settings += "PRAGMA " + setting.first + "=" + setting.second + "; ";
+  if (performance_) {
+    // An existing database only changes its vacuum mode when rebuilt.
+    sqlite3_stmt* stmt = nullptr;
+    sqlite3_prepare_v2(db_, "PRAGMA auto_vacuum;", -1, &stmt, nullptr);
+    if (stmt != nullptr && sqlite3_step(stmt) == SQLITE_ROW &&
+        sqlite3_column_int(stmt, 0) != 2) {
+      VLOG(1) << "Rebuilding the database for incremental vacuum";
+      sqlite3_exec(db_, "VACUUM;", nullptr, nullptr, nullptr);
+    }
+    sqlite3_finalize(stmt);
   }
-  sqlite3_exec(db_, settings.c_str(), nullptr, nullptr, nullptr);
 
   // RocksDB may not create/append a directory with acceptable permissions.
   if (platformSetSafeDbPerms(path_) == false) {
@@ -88,14 +174,55 @@ Status SQLiteDatabasePlugin::setUp() {
   return Status(0);
 }
 
+Status SQLiteDatabasePlugin::reclaim() {
+  if (db_ == nullptr) {
+    return Status::staticFailure("Database is not open");
+  }
+
+  sqlite3_db_release_memory(db_);
+  return Status::success();
+}
+
 void SQLiteDatabasePlugin::close() {
   WriteLock lock(close_mutex_);
+  {
+    WriteLock statements_lock(statements_mutex_);
+    for (auto& statement : statements_) {
+      sqlite3_finalize(statement.second);
+    }
+    statements_.clear();
+  }
+
   if (db_ != nullptr) {
     sqlite3_close(db_);
     db_ = nullptr;
   }
 }
 
+
+sqlite3_stmt* SQLiteDatabasePlugin::prepare(const std::string& sql) const {
+  auto it = statements_.find(sql);
+  if (it != statements_.end()) {
+    return it->second;
+  }
+
+  sqlite3_stmt* stmt = nullptr;
+  if (db_ == nullptr ||
+      sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    return nullptr;
+  }
+  statements_.emplace(sql, stmt);
+  return stmt;
+}
+
+Status SQLiteDatabasePlugin::stepStatus(int rc) const {
+  if (rc == SQLITE_DONE || rc == SQLITE_ROW) {
+    return Status::success();
+  }
+  return Status::failure(sqlite3_errmsg(db_));
+}
+
 static int getData(void* argument, int argc, char* argv[], char* column[]) {
   if (argument == nullptr) {
     return SQLITE_MISUSE;
@@ -115,17 +242,18 @@ static int getData(void* argument, int argc, char* argv[], char* column[]) {
 Status SQLiteDatabasePlugin::get(const std::string& domain,
                                  const std::string& key,
                                  std::string& value) const {
-  QueryData results;
-  char* err = nullptr;
-  std::string q = "select value from " + domain + " where key = '" + key + "';";
-  sqlite3_exec(db_, q.c_str(), getData, &results, &err);
-  if (err != nullptr) {
-    sqlite3_free(err);
+  WriteLock lock(statements_mutex_);
+  auto stmt = prepare("select value from " + domain + " where key = ?1;");
+  if (stmt == nullptr) {
+    return Status::staticFailure("Cannot prepare the database read");
   }
 
+  StatementReset reset(stmt);
+  bindText(stmt, 1, key);
+
   // Only assign value if the query found a result.
-  if (results.size() > 0) {
-    value = std::move(results[0]["value"]);
+  if (sqlite3_step(stmt) == SQLITE_ROW) {
+    value = columnText(stmt, 0);
     return Status(0);
   }
   return Status(1);
@@ -139,7 +267,7 @@ Status SQLiteDatabasePlugin::get(const std::string& domain,
   if (s.ok()) {
     auto expectedValue = tryTo<int>(result);
     if (expectedValue.isError()) {
-      return Status::failure("Could not deserialize str to int");
+      return Status::staticFailure("Could not deserialize str to int");
     } else {
       value = expectedValue.take();
     }
@@ -162,6 +290,23 @@ static void tryVacuum(sqlite3* db) {
   }
 }
 
+void SQLiteDatabasePlugin::maintain() {
+  if (!performance_) {
+    if (rand() % 10 == 0) {
+      tryVacuum(db_);
+    }
+    return;
+  }
+
+  // Free pages are returned to the filesystem a few at a time.
+  if (++writes_ >= kIncrementalVacuumWrites) {
+    writes_ = 0;
+    auto q = "PRAGMA incremental_vacuum(" +
+             std::to_string(kIncrementalVacuumPages) + ");";
+    sqlite3_exec(db_, q.c_str(), nullptr, nullptr, nullptr);
+  }
+}
+
 Status SQLiteDatabasePlugin::put(const std::string& domain,
                                  const std::string& key,
                                  const std::string& value) {
@@ -176,120 +321,141 @@ Status SQLiteDatabasePlugin::put(const std::string& domain,
 
 Status SQLiteDatabasePlugin::putBatch(const std::string& domain,
                                       const DatabaseStringValueList& data) {
-  // Prepare the query, adding placeholders for all the rows we have in `data`
-  std::stringstream buffer;
-  buffer << "insert or replace into " + domain + " values ";
-
-  for (auto i = 1U; i <= data.size(); i++) {
-    auto index = i * 2;
-    buffer << "(?" << index - 1 << ", ?" << index << ")";
-
-    if (i + 1 > data.size()) {
-      buffer << ";";
-    } else {
-      buffer << ", ";
-    }
+  WriteLock lock(statements_mutex_);
+  auto stmt = prepare("insert or replace into " + domain + " values (?1, ?2);");
+  if (stmt == nullptr) {
+    return Status::staticFailure("Cannot prepare the database write");
   }
 
-  const auto& q = buffer.str();
-
-  // Bind each value from the rows we got
-  sqlite3_stmt* stmt = nullptr;
-  sqlite3_prepare_v2(db_, q.c_str(), -1, &stmt, nullptr);
-
-  {
-    int i = 1;
-
-    for (const auto& p : data) {
-      const auto& key = p.first;
-      const auto& value = p.second;
-
-      sqlite3_bind_text(stmt, i, key.c_str(), -1, SQLITE_STATIC);
-      sqlite3_bind_text(stmt, i + 1, value.c_str(), -1, SQLITE_STATIC);
+  // The rows of a batch are written in one transaction.
+  auto transaction = data.size() > 1;
+  if (transaction) {
+    sqlite3_exec(db_, "BEGIN;", nullptr, nullptr, nullptr);
+  }
 
-      i += 2;
+  auto status = Status::success();
+  for (const auto& p : data) {
+    StatementReset reset(stmt);
+    bindText(stmt, 1, p.first);
+    bindText(stmt, 2, p.second);
+    status = stepStatus(sqlite3_step(stmt));
+    if (!status.ok()) {
+      break;
     }
   }
 
-  auto rc = sqlite3_step(stmt);
-  if (rc != SQLITE_DONE) {
-    return Status(1);
+  if (transaction) {
+    auto end = status.ok() ? "COMMIT;" : "ROLLBACK;";
+    sqlite3_exec(db_, end, nullptr, nullptr, nullptr);
   }
 
-  sqlite3_finalize(stmt);
-  if (rand() % 10 == 0) {
-    tryVacuum(db_);
+  if (status.ok()) {
+    maintain();
   }
-
-  return Status::success();
+  return status;
 }
 
 Status SQLiteDatabasePlugin::remove(const std::string& domain,
                                     const std::string& key) {
-  sqlite3_stmt* stmt = nullptr;
-  std::string q = "delete from " + domain + " where key IN (?1);";
-  sqlite3_prepare_v2(db_, q.c_str(), -1, &stmt, nullptr);
-
-  sqlite3_bind_text(stmt, 1, key.c_str(), -1, SQLITE_STATIC);
-  auto rc = sqlite3_step(stmt);
-  if (rc != SQLITE_DONE) {
-    return Status(1);
+  WriteLock lock(statements_mutex_);
+  auto stmt = prepare("delete from " + domain + " where key = ?1;");
+  if (stmt == nullptr) {
+    return Status::staticFailure("Cannot prepare the database removal");
   }
 
-  sqlite3_finalize(stmt);
-  if (rand() % 10 == 0) {
-    tryVacuum(db_);
+  StatementReset reset(stmt);
+  bindText(stmt, 1, key);
+  auto status = stepStatus(sqlite3_step(stmt));
+  if (status.ok()) {
+    maintain();
   }
-  return Status(0);
+  return status;
 }
 
 Status SQLiteDatabasePlugin::removeRange(const std::string& domain,
                                          const std::string& low,
                                          const std::string& high) {
   if (low > high) {
-    return Status::failure("Invalid range: low > high");
+    return Status::staticFailure("Invalid range: low > high");
   }
 
-  sqlite3_stmt* stmt = nullptr;
-  std::string q = "delete from " + domain + " where key >= ?1 and key <= ?2;";
-  sqlite3_prepare_v2(db_, q.c_str(), -1, &stmt, nullptr);
+  WriteLock lock(statements_mutex_);
+  auto stmt =
+      prepare("delete from " + domain + " where key >= ?1 and key <= ?2;");
+  if (stmt == nullptr) {
+    return Status::staticFailure("Cannot prepare the database removal");
+  }
+
+  StatementReset reset(stmt);
+  bindText(stmt, 1, low);
+  bindText(stmt, 2, high);
+  auto status = stepStatus(sqlite3_step(stmt));
+  if (status.ok()) {
+    maintain();
+  }
+  return status;
+}
 
-  sqlite3_bind_text(stmt, 1, low.c_str(), -1, SQLITE_STATIC);
-  sqlite3_bind_text(stmt, 2, high.c_str(), -1, SQLITE_STATIC);
-  auto rc = sqlite3_step(stmt);
-  if (rc != SQLITE_DONE) {
-    return Status(1);
+Status SQLiteDatabasePlugin::scanRows(const std::string& domain,
+                                      const std::string& prefix,
+                                      uint64_t max,
+                                      bool values,
+                                      DatabaseStringValueList& rows) const {
+  // The keys of a prefix are a range of the primary key index.
+  auto upper_bound = prefixUpperBound(prefix);
+  std::string q = std::string("select key") + (values ? ", value" : "") +
+                  " from " + domain + " where key >= ?1";
+  if (!upper_bound.empty()) {
+    q += " and key < ?2";
   }
+  q += " order by key limit ?3;";
 
-  sqlite3_finalize(stmt);
-  if (rand() % 10 == 0) {
-    tryVacuum(db_);
+  WriteLock lock(statements_mutex_);
+  auto stmt = prepare(q);
+  if (stmt == nullptr) {
+    return Status::staticFailure("Cannot prepare the database scan");
   }
-  return Status(0);
+
+  StatementReset reset(stmt);
+  bindText(stmt, 1, prefix);
+  if (!upper_bound.empty()) {
+    bindText(stmt, 2, upper_bound);
+  }
+  sqlite3_bind_int64(stmt, 3, max > 0 ? static_cast<sqlite3_int64>(max) : -1);
+
+  int rc;
+  while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+    rows.emplace_back(columnText(stmt, 0),
+                      values ? columnText(stmt, 1) : std::string());
+  }
+  return stepStatus(rc);
 }
 
 Status SQLiteDatabasePlugin::scan(const std::string& domain,
                                   std::vector<std::string>& results,
                                   const std::string& prefix,
                                   uint64_t max) const {
-  QueryData _results;
-  char* err = nullptr;
-
-  std::string q =
-      "select key from " + domain + " where key LIKE '" + prefix + "%'";
-  if (max > 0) {
-    q += " limit " + std::to_string(max);
-  }
-  sqlite3_exec(db_, q.c_str(), getData, &_results, &err);
-  if (err != nullptr) {
-    sqlite3_free(err);
+  DatabaseStringValueList rows;
+  auto status = scanRows(domain, prefix, max, false, rows);
+  for (auto& row : rows) {
+    results.push_back(std::move(row.first));
   }
+  return status;
+}
 
-  // Only assign value if the query found a result.
-  for (auto& r : _results) {
-    results.push_back(std::move(r["key"]));
+Status SQLiteDatabasePlugin::scanValues(
+    const std::string& domain,
+    const std::string& prefix,
+    uint64_t max,
+    const DatabaseScanCallback& callback) const {
+  // Rows are read before the callbacks run, they may use the database.
+  DatabaseStringValueList rows;
+  auto status = scanRows(domain, prefix, max, true, rows);
+  for (auto& row : rows) {
+    if (!callback(row.first, row.second)) {
+      break;
+    }
   }
-
-  return Status::success();
+  return status;
 }
 } // namespace osquery
@@ -7,7 +7,9 @@
  * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
  */
 
+#include <map>
 #include <mutex>
+#include <string>
 
 #include <sqlite3.h>
 
@@ -19,6 +21,7 @@
 namespace osquery {
 
 DECLARE_string(database_path);
+DECLARE_bool(database_sqlite_performance);
 
 class SQLiteDatabasePlugin : public DatabasePlugin {
  public:
@@ -55,10 +58,19 @@ class SQLiteDatabasePlugin : public DatabasePlugin {
               const std::string& prefix,
               uint64_t max) const override;
 
+  /// Key and value lookup method, a single query.
+  Status scanValues(const std::string& domain,
+                    const std::string& prefix,
+                    uint64_t max,
+                    const DatabaseScanCallback& callback) const override;
+
  public:
   /// Database workflow: open and setup.
   Status setUp() override;
 
+  /// Release the page cache of the connection.
+  Status reclaim() override;
+
   /// Database workflow: close and cleanup.
   void tearDown() override {
     close();
@@ -72,12 +84,44 @@ class SQLiteDatabasePlugin : public DatabasePlugin {
  private:
   void close();
 
+  /**
+   * @brief Get the cached statement of a SQL text, preparing it once.
+   *
+   * The statements mutex must be held while the statement is used.
+   */
+  sqlite3_stmt* prepare(const std::string& sql) const;
+
+  /// Reclaim the free pages after writes, the statements mutex is held.
+  void maintain();
+
+  /// Read the keys starting with a prefix in order, and their values.
+  Status scanRows(const std::string& domain,
+                  const std::string& prefix,
+                  uint64_t max,
+                  bool values,
+                  DatabaseStringValueList& rows) const;
+
+  /// Convert the outcome of a statement to a Status.
+  Status stepStatus(int rc) const;
+
  private:
   /// The long-lived sqlite3 database.
   sqlite3* db_{nullptr};
 
   /// Deconstruction mutex.
   Mutex close_mutex_;
+
+  /// Guards the cached statements, a statement is used by one caller.
+  mutable Mutex statements_mutex_;
+
+  /// The prepared statements, by SQL text.
+  mutable std::map<std::string, sqlite3_stmt*> statements_;
+
+  /// The writes since the free pages were last reclaimed.
+  size_t writes_{0};
+
+  /// The database uses WAL and incremental vacuum.
+  bool performance_{false};
 };
 
 /// Backing-storage provider for osquery internal/core.
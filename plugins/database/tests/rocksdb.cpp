@@ -94,4 +94,42 @@ TEST_F(RocksDBDatabasePluginTests, test_column_families_rollback) {
   ASSERT_TRUE(s.ok()) << s.getMessage();
   db2.tearDown();
 }
+
+TEST_F(RocksDBDatabasePluginTests, test_column_family_profiles) {
+  auto db = RocksDBDatabasePlugin();
+  const auto test_db_path =
+      (boost::filesystem::temp_directory_path() /
+       boost::filesystem::unique_path(
+           "osquery.test_column_family_profiles.%%%%.%%%%.%%%%.%%%%.db"))
+          .string();
+  FLAGS_database_path = test_db_path;
+
+  auto s = db.setUp();
+  ASSERT_TRUE(s.ok()) << s.getMessage();
+  db_dirs_.push_back(test_db_path);
+
+  std::map<std::string, rocksdb::ColumnFamilyOptions> options;
+  for (const auto& cf : db.column_families_) {
+    options[cf.name] = cf.options;
+  }
+
+  // Settings use a small memtable, events and logs are compacted by age.
+  auto& defaults = options[rocksdb::kDefaultColumnFamilyName];
+  EXPECT_LT(options[kPersistentSettings].write_buffer_size,
+            defaults.write_buffer_size);
+  EXPECT_GT(options[kEvents].ttl, 0U);
+  EXPECT_GT(options[kLogs].ttl, 0U);
+  EXPECT_EQ(defaults.ttl, 0U);
+  EXPECT_NE(options[kQueries].table_factory, defaults.table_factory);
+
+  // Every column family shares the memtable budget.
+  ASSERT_NE(db.options_.write_buffer_manager, nullptr);
+  size_t budget = 0;
+  for (const auto& cf : db.column_families_) {
+    budget += cf.options.write_buffer_size *
+              static_cast<size_t>(cf.options.max_write_buffer_number);
+  }
+  EXPECT_EQ(db.options_.write_buffer_manager->buffer_size(), budget);
+  db.tearDown();
+}
 } // namespace osquery
@@ -8,6 +8,9 @@
  */
 
 #include <osquery/database/tests/test_utils.h>
+#include <plugins/database/sqlite.h>
+
+#include <boost/filesystem.hpp>
 
 namespace osquery {
 
@@ -20,4 +23,57 @@ class SQLiteDatabasePluginTests : public DatabasePluginTests {
 
 // Define the default set of database plugin operation tests.
 CREATE_DATABASE_TESTS(SQLiteDatabasePluginTests);
+
+TEST_F(SQLiteDatabasePluginTests, test_performance_mode) {
+  auto performance = FLAGS_database_sqlite_performance;
+  FLAGS_database_sqlite_performance = true;
+
+  auto db = SQLiteDatabasePlugin();
+  const auto test_db_path =
+      (boost::filesystem::temp_directory_path() /
+       boost::filesystem::unique_path(
+           "osquery.test_sqlite_performance.%%%%.%%%%.%%%%.%%%%.db"))
+          .string();
+  auto previous_path = FLAGS_database_path;
+  FLAGS_database_path = test_db_path;
+  ASSERT_TRUE(db.setUp().ok());
+
+  // Values are stored as they are, including NUL bytes.
+  std::string binary("a\0b", 3);
+  DatabaseStringValueList batch = {{"prefix_1", binary},
+                                   {"prefix_2", "2"},
+                                   {"PREFIX_3", "3"},
+                                   {"prefiy", ""}};
+  ASSERT_TRUE(db.putBatch(kQueries, batch).ok());
+
+  std::string value;
+  ASSERT_TRUE(db.get(kQueries, "prefix_1", value).ok());
+  EXPECT_EQ(value, binary);
+
+  // Prefix scans are exact and ordered, not case-insensitive.
+  std::vector<std::string> keys;
+  ASSERT_TRUE(db.scan(kQueries, keys, "prefix_", 0).ok());
+  EXPECT_EQ(keys, std::vector<std::string>({"prefix_1", "prefix_2"}));
+
+  keys.clear();
+  ASSERT_TRUE(db.scan(kQueries, keys, "prefix_", 1).ok());
+  EXPECT_EQ(keys, std::vector<std::string>({"prefix_1"}));
+
+  ASSERT_TRUE(db.remove(kQueries, "prefix_1").ok());
+  EXPECT_FALSE(db.get(kQueries, "prefix_1", value).ok());
+
+  // The database is reopened in its vacuum mode.
+  db.tearDown();
+  ASSERT_TRUE(db.setUp().ok());
+  ASSERT_TRUE(db.get(kQueries, "prefix_2", value).ok());
+  EXPECT_EQ(value, "2");
+  db.tearDown();
+
+  boost::system::error_code ec;
+  for (const auto& suffix : {"", "-wal", "-shm"}) {
+    boost::filesystem::remove(test_db_path + suffix, ec);
+  }
+  FLAGS_database_path = previous_path;
+  FLAGS_database_sqlite_performance = performance;
+}
 }
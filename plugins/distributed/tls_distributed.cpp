@@ -27,6 +27,7 @@
 namespace osquery {
 
 DECLARE_bool(tls_node_api);
+DECLARE_uint64(distributed_long_poll);
 
 FLAG(string,
      distributed_tls_read_endpoint,
@@ -67,21 +68,45 @@ Status TLSDistributedPlugin::setUp() {
 Status TLSDistributedPlugin::getQueries(std::string& json) {
   JSON params;
   params.add("_verb", "POST");
+
+  // The server may hold the read until queries exist, for up to long_poll
+  // seconds. The request timeout covers the wait.
+  if (FLAGS_distributed_long_poll > 0) {
+    params.add("long_poll", FLAGS_distributed_long_poll);
+    params.add("_timeout", static_cast<int>(FLAGS_distributed_long_poll + 16));
+  }
   return TLSRequestHelper::go<JSONSerializer>(
       read_uri_, params, json, FLAGS_distributed_tls_max_attempts);
 }
 
 Status TLSDistributedPlugin::writeResults(const std::string& json) {
-  JSON params;
-  Status s = params.fromString(json);
+  if (json.size() < 2 || json.front() != '{' || json.back() != '}') {
+    return Status::failure("Distributed results are not a JSON object");
+  }
 
-  if (!s.ok()) {
-    return s;
+  // The results are sent as they were serialized, only the node_key member is
+  // added in front of them.
+  std::string body;
+  if (!FLAGS_tls_node_api) {
+    JSON params;
+    params.add("node_key", getNodeKey("tls"));
+    auto s = params.toString(body);
+    if (!s.ok()) {
+      return s;
+    }
+
+    body.pop_back();
+    if (json.size() > 2) {
+      body += ',';
+    }
+  } else {
+    body = "{";
   }
+  body.append(json, 1, std::string::npos);
 
   // The response is ignored.
-  std::string response;
+  JSON response;
   return TLSRequestHelper::go<JSONSerializer>(
-      write_uri_, params, response, FLAGS_distributed_tls_max_attempts);
+      write_uri_, body, false, response, FLAGS_distributed_tls_max_attempts);
 }
 }
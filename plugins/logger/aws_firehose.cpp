@@ -34,6 +34,11 @@ FLAG(string, aws_firehose_stream, "", "Name of Firehose stream for logging")
 
 FLAG(string, aws_firehose_endpoint, "", "Custom Firehose endpoint");
 
+FLAG(uint64,
+     aws_firehose_inflight_requests,
+     4,
+     "Maximum number of concurrent PutRecordBatch requests (default 4)");
+
 FLAG(string,
      aws_firehose_region,
      "",
@@ -70,6 +75,10 @@ Status FirehoseLoggerPlugin::logString(const std::string& s) {
   return forwarder_->logString(s);
 }
 
+Status FirehoseLoggerPlugin::logEvent(const std::string& s) {
+  return forwarder_->logString(s);
+}
+
 Status FirehoseLoggerPlugin::logStatus(const std::vector<StatusLogLine>& log) {
   return forwarder_->logStatus(log);
 }
@@ -128,6 +137,10 @@ bool FirehoseLogForwarder::appendNewlineSeparators() const {
   return true;
 }
 
+size_t FirehoseLogForwarder::getMaxInflightRequests() const {
+  return static_cast<size_t>(FLAGS_aws_firehose_inflight_requests);
+}
+
 size_t FirehoseLogForwarder::getFailedRecordCount(Outcome& outcome) const {
   return static_cast<size_t>(outcome.GetResult().GetFailedPutCount());
 }
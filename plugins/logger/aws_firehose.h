@@ -56,6 +56,7 @@ class FirehoseLogForwarder final : public IFirehoseLogForwarder {
   size_t getMaxRetryCount() const override;
   size_t getInitialRetryDelay() const override;
   bool appendNewlineSeparators() const override;
+  size_t getMaxInflightRequests() const override;
 
   size_t getFailedRecordCount(Outcome& outcome) const override;
   Result getResult(Outcome& outcome) const override;
@@ -80,6 +81,9 @@ class FirehoseLoggerPlugin : public LoggerPlugin {
 
   Status logString(const std::string& s) override;
 
+  /// Forwarded event rows are buffered like results.
+  Status logEvent(const std::string& s) override;
+
   /// Log a status (ERROR/WARNING/INFO) message.
   Status logStatus(const std::vector<StatusLogLine>& log) override;
 
@@ -44,6 +44,17 @@ FLAG(bool,
      false,
      "Enable random kinesis partition keys");
 
+FLAG(uint64,
+     aws_kinesis_partition_keys,
+     1,
+     "Spread records over this many host identifier partition keys; set to "
+     "the number of shards");
+
+FLAG(uint64,
+     aws_kinesis_inflight_requests,
+     4,
+     "Maximum number of concurrent PutRecords requests (default 4)");
+
 FLAG(bool,
      aws_kinesis_disable_log_status,
      false,
@@ -85,6 +96,10 @@ Status KinesisLoggerPlugin::logString(const std::string& s) {
   return forwarder_->logString(s);
 }
 
+Status KinesisLoggerPlugin::logEvent(const std::string& s) {
+  return forwarder_->logString(s);
+}
+
 Status KinesisLoggerPlugin::logStatus(const std::vector<StatusLogLine>& log) {
   return forwarder_->logStatus(log);
 }
@@ -126,6 +141,10 @@ void KinesisLogForwarder::initializeRecord(
     // records are spread evenly across shards.
     boost::uuids::uuid uuid = boost::uuids::random_generator()();
     record_partition_key = boost::uuids::to_string(uuid);
+  } else if (FLAGS_aws_kinesis_partition_keys > 1) {
+    // Rotate over a fixed set of keys, which hash to different shards.
+    auto index = next_partition_key_++ % FLAGS_aws_kinesis_partition_keys;
+    record_partition_key = partition_key_ + "-" + std::to_string(index);
   } else {
     record_partition_key = partition_key_;
   }
@@ -158,6 +177,10 @@ bool KinesisLogForwarder::appendNewlineSeparators() const {
   return false;
 }
 
+size_t KinesisLogForwarder::getMaxInflightRequests() const {
+  return static_cast<size_t>(FLAGS_aws_kinesis_inflight_requests);
+}
+
 size_t KinesisLogForwarder::getFailedRecordCount(Outcome& outcome) const {
   return static_cast<size_t>(outcome.GetResult().GetFailedRecordCount());
 }
@@ -11,6 +11,7 @@
 
 #include "aws_log_forwarder.h"
 
+#include <atomic>
 #include <chrono>
 #include <gflags/gflags.h>
 #include <memory>
@@ -54,6 +55,7 @@ class KinesisLogForwarder final : public IKinesisLogForwarder {
   size_t getMaxRetryCount() const override;
   size_t getInitialRetryDelay() const override;
   bool appendNewlineSeparators() const override;
+  size_t getMaxInflightRequests() const override;
 
   size_t getFailedRecordCount(Outcome& outcome) const override;
   Result getResult(Outcome& outcome) const override;
@@ -62,6 +64,9 @@ class KinesisLogForwarder final : public IKinesisLogForwarder {
   /// The partition key; ignored if aws_kinesis_random_partition_key is set
   std::string partition_key_;
 
+  /// The next suffix used when aws_kinesis_partition_keys is set
+  mutable std::atomic<uint64_t> next_partition_key_{0};
+
   FRIEND_TEST(KinesisTests, test_send);
 };
 
@@ -79,6 +84,9 @@ class KinesisLoggerPlugin : public LoggerPlugin {
 
   Status logString(const std::string& s) override;
 
+  /// Forwarded event rows are buffered like results.
+  Status logEvent(const std::string& s) override;
+
   /// Log a status (ERROR/WARNING/INFO) message.
   Status logStatus(const std::vector<StatusLogLine>& log) override;
 
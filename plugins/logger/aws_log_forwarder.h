@@ -11,7 +11,9 @@
 
 #include "plugins/logger/buffered.h"
 
+#include <algorithm>
 #include <chrono>
+#include <future>
 #include <memory>
 #include <vector>
 
@@ -157,9 +159,9 @@ class AwsLogForwarder : public BufferedLogForwarder {
       // Complete the current batch if it's full
       if (current_batch_byte_size + record_size >= getMaxBytesPerBatch() ||
           (current_batch.size() >= getMaxRecordsPerBatch())) {
-        batch_list.push_back(current_batch);
+        batch_list.push_back(std::move(current_batch));
 
-        current_batch.clear();
+        current_batch = Batch();
         current_batch_byte_size = 0U;
       }
 
@@ -179,7 +181,7 @@ class AwsLogForwarder : public BufferedLogForwarder {
     }
 
     if (!current_batch.empty()) {
-      batch_list.push_back(current_batch);
+      batch_list.push_back(std::move(current_batch));
     }
 
     log_data.clear();
@@ -187,16 +189,96 @@ class AwsLogForwarder : public BufferedLogForwarder {
   }
 
  protected:
-  /// Sends a single batch
-  bool sendBatch(Batch& batch, std::stringstream& status_output) {
-    bool success = false;
+  /**
+   * @brief Keeps the records of a batch that failed to be sent.
+   *
+   * Returns false if the whole request failed, the batch is then unchanged.
+   */
+  bool removeSentRecords(Batch& batch, Outcome& outcome) {
+    if (!outcome.IsSuccess()) {
+      // By default, we have a high maximum retry count value! The user will
+      // not notice right away that his configuration is broken without this
+      // message!
+      LOG(ERROR) << name_ << ": Complete request failure: "
+                 << outcome.GetError().GetMessage();
+      return false;
+    }
+
+    size_t failed_record_count = getFailedRecordCount(outcome);
+    if (batch.size() > failed_record_count) {
+      VLOG(1) << name_ << ": Successfully sent "
+              << batch.size() - failed_record_count << " out of "
+              << batch.size() << " log records";
+    }
+
+    if (failed_record_count == 0) {
+      batch.clear();
+      return true;
+    }
+
+    // Only the failed records are sent again, so that none are duplicated
+    const auto& result_record_list = getResult(outcome);
+
+    Batch failed_records;
+    failed_records.reserve(failed_record_count);
+    for (size_t i = 0; i < batch.size() && i < result_record_list.size();
+         ++i) {
+      if (!result_record_list[i].GetErrorCode().empty()) {
+        failed_records.push_back(std::move(batch[i]));
+      }
+    }
+
+    batch = std::move(failed_records);
+    return true;
+  }
 
+  /**
+   * @brief Sends each batch once, keeping several requests in flight.
+   *
+   * The records that were sent are removed from their batch; the error of
+   * the batches that still have records is stored in errors.
+   */
+  void sendBatchesOnce(BatchList& batch_list,
+                       std::vector<std::string>& errors) {
+    errors.resize(batch_list.size());
+
+    auto complete = [this, &batch_list, &errors](size_t index,
+                                                 Outcome outcome) {
+      auto& batch = batch_list[index];
+      removeSentRecords(batch, outcome);
+      errors[index] = batch.empty() ? "" : outcome.GetError().GetMessage();
+    };
+
+    auto max_inflight = std::max<size_t>(1U, getMaxInflightRequests());
+    for (size_t first = 0; first < batch_list.size(); first += max_inflight) {
+      auto count = std::min(max_inflight, batch_list.size() - first);
+      if (count == 1) {
+        complete(first, internalSend(batch_list[first]));
+        continue;
+      }
+
+      std::vector<std::future<Outcome>> outcomes;
+      for (size_t i = first; i < first + count; ++i) {
+        const auto& batch = batch_list[i];
+        outcomes.push_back(std::async(std::launch::async, [this, &batch]() {
+          return internalSend(batch);
+        }));
+      }
+
+      for (size_t i = 0; i < count; ++i) {
+        complete(first + i, outcomes[i].get());
+      }
+    }
+  }
+
+  /// Sends the specified batches, retrying the records that failed
+  bool sendBatches(BatchList& batch_list, std::stringstream& status_output) {
     auto max_retry_count = getMaxRetryCount();
     auto base_retry_delay = getInitialRetryDelay();
 
-    for (size_t retry = 0; retry < max_retry_count; retry++) {
-      bool is_last_retry = (retry + 1 >= max_retry_count);
-
+    std::vector<std::string> errors;
+    for (size_t retry = 0; retry < max_retry_count && !batch_list.empty();
+         retry++) {
       // Increase the resend delay at each retry
       size_t retry_delay =
           (retry == 0 ? 0 : base_retry_delay) + (retry * 1000U);
@@ -210,65 +292,35 @@ class AwsLogForwarder : public BufferedLogForwarder {
         }
       }
 
-      // Attempt to send the batch
-      auto outcome = internalSend(batch);
-
-      size_t failed_record_count;
-      bool request_failure;
-      if (!outcome.IsSuccess()) {
-        failed_record_count = batch.size();
-        request_failure = true;
-      } else {
-        failed_record_count = getFailedRecordCount(outcome);
-        request_failure = false;
-      }
-
-      size_t sent_record_count = batch.size() - failed_record_count;
-
-      if (sent_record_count > 0) {
-        VLOG(1) << name_ << ": Successfully sent "
-                << batch.size() - failed_record_count << " out of "
-                << batch.size() << " log records";
-      }
+      sendBatchesOnce(batch_list, errors);
 
-      if (failed_record_count == 0) {
-        success = true;
-        break;
-      }
+      bool is_last_retry = (retry + 1 >= max_retry_count);
 
-      // Only log final errors
-      if (is_last_retry) {
-        if (!status_output.str().empty()) {
-          status_output << "\n";
+      // Keep the batches that still have records
+      size_t pending = 0;
+      for (size_t i = 0; i < batch_list.size(); ++i) {
+        if (batch_list[i].empty()) {
+          continue;
         }
 
-        status_output << outcome.GetError().GetMessage();
-      }
-
-      // We didn't manage to send all records; remove the ones that succeeded
-      // (so that we do not duplicate them) and try again
-      if (request_failure) {
-        // By default, we have a high maximum retry count value! The user will
-        // not notice right away that his configuration is broken without this
-        // message!
-        LOG(ERROR) << name_ << ": Complete request failure: "
-                   << outcome.GetError().GetMessage();
-        continue;
-      }
-
-      const auto& result_record_list = getResult(outcome);
+        // Only log final errors
+        if (is_last_retry) {
+          if (!status_output.str().empty()) {
+            status_output << "\n";
+          }
 
-      for (size_t i = batch.size(); i-- > 0;) {
-        if (!result_record_list[i].GetErrorCode().empty()) {
-          continue;
+          status_output << errors[i];
         }
 
-        auto it = std::next(batch.begin(), i);
-        batch.erase(it);
+        if (pending != i) {
+          batch_list[pending] = std::move(batch_list[i]);
+        }
+        pending++;
       }
+      batch_list.resize(pending);
     }
 
-    return success;
+    return batch_list.empty();
   }
 
   /// Sends the specified data in one or more batches, depending on the log size
@@ -282,36 +334,27 @@ class AwsLogForwarder : public BufferedLogForwarder {
     dumpDiscardedRecordsToErrorLog(discarded_records);
     discarded_records.clear();
 
-    // Send each batch
-    size_t error_count = 0;
     std::stringstream status_output;
+    if (sendBatches(batch_list, status_output)) {
+      return Status(0, "OK");
+    }
 
-    for (auto batch_it = batch_list.begin(); batch_it != batch_list.end();) {
-      auto& batch = *batch_it;
-      if (!sendBatch(batch, status_output)) {
-        /* Since we are shutting down, we don't want to count this send failure
-           as a real error; returning with failure here will make
-           the BufferedLogForwarder try to send this batch again
-           when osquery starts again */
-        if (interrupted()) {
-          return Status::failure(
-              "Interrupted sending log batch due to osquery shutdown");
-        }
-
-        // We couldn't write some of the records; log them locally so that the
-        // administrator will at least be able to inspect them
-        dumpBatchToErrorLog(batch);
-        error_count++;
-      }
-
-      batch_it = batch_list.erase(batch_it);
+    /* Since we are shutting down, we don't want to count this send failure
+       as a real error; returning with failure here will make
+       the BufferedLogForwarder try to send this batch again
+       when osquery starts again */
+    if (interrupted()) {
+      return Status::failure(
+          "Interrupted sending log batch due to osquery shutdown");
     }
 
-    if (error_count != 0) {
-      return Status(1, status_output.str());
+    // We couldn't write some of the records; log them locally so that the
+    // administrator will at least be able to inspect them
+    for (const auto& batch : batch_list) {
+      dumpBatchToErrorLog(batch);
     }
 
-    return Status(0, "OK");
+    return Status(1, status_output.str());
   }
 
   /// Plugin-specific initialization is performed here
@@ -342,6 +385,11 @@ class AwsLogForwarder : public BufferedLogForwarder {
   /// Must return true if records should be terminated with newlines
   virtual bool appendNewlineSeparators() const = 0;
 
+  /// The amount of requests that may be in flight at the same time
+  virtual size_t getMaxInflightRequests() const {
+    return 1U;
+  }
+
   /// Must return the amount of records that could not be sent
   virtual size_t getFailedRecordCount(Outcome& outcome) const = 0;
 
@@ -17,7 +17,9 @@
 #include <osquery/core/system.h>
 #include <osquery/database/database.h>
 #include <osquery/logger/logger.h>
+#include <osquery/numeric_monitoring/numeric_monitoring.h>
 #include <osquery/registry/registry.h>
+#include <osquery/utils/conversions/tryto.h>
 #include <osquery/utils/info/version.h>
 #include <osquery/utils/json/json.h>
 #include <osquery/utils/system/time.h>
@@ -36,8 +38,32 @@ const std::chrono::seconds BufferedLogForwarder::kLogPeriod{
     std::chrono::seconds(4)};
 const uint64_t BufferedLogForwarder::kMaxLogLines{1024};
 
+namespace {
+
+/// Width of the zero-padded sequence starting each segment index.
+const size_t kSequenceWidth{20};
+
+/// Lines of a segment are separated by a newline, JSON lines have none.
+void splitSegment(std::string& value,
+                  size_t lines,
+                  std::vector<std::string>& target) {
+  if (lines <= 1) {
+    target.emplace_back(std::move(value));
+    return;
+  }
+
+  size_t start = 0;
+  for (auto end = value.find('\n'); end != std::string::npos;
+       end = value.find('\n', start)) {
+    target.emplace_back(value.substr(start, end - start));
+    start = end + 1;
+  }
+  target.emplace_back(value.substr(start));
+}
+} // namespace
+
 Status BufferedLogForwarder::setUp() {
-  // initialize buffer_count_ by scanning the DB
+  // initialize buffer_count_ and the sequence by scanning the DB
   std::vector<std::string> indexes;
   auto status = scanDatabaseKeys(kLogs, indexes, index_name_, (uint64_t)0);
 
@@ -45,31 +71,64 @@ Status BufferedLogForwarder::setUp() {
     return Status(1, "Error scanning for buffered log count");
   }
 
+  unsigned long long int count = 0;
+  size_t sequence = 0;
+  for (const auto& index : indexes) {
+    count += segmentLines(index);
+    if (isSegmentIndex(index)) {
+      auto value = tryTo<size_t>(
+          index.substr(index_name_.size() + 3, kSequenceWidth), 10);
+      sequence = std::max(sequence, value.takeOr(size_t{0}));
+    }
+  }
+
   RecursiveLock lock(count_mutex_);
-  buffer_count_ = indexes.size();
+  buffer_count_ = count;
+  if (log_index_ < sequence) {
+    log_index_ = sequence;
+  }
   return Status(0);
 }
 
 void BufferedLogForwarder::check(bool send_results, bool send_statuses) {
-  // Get a list of all the buffered log items, with a max of 1024 lines.
-  std::vector<std::string> indexes;
-  auto status = scanDatabaseKeys(kLogs, indexes, index_name_, max_log_lines_);
+  static const monitoring::LatencyMetric latency("logger.buffered.check");
+  monitoring::LatencyTimer timer(latency);
+
+  monitoring::record("logger.buffered." + index_name_ + ".backlog",
+                     static_cast<monitoring::ValueType>(bufferedLines()),
+                     monitoring::PreAggregationType::Max);
 
-  // For each index, accumulate the log line into the result or status set.
+  // Read the oldest buffered segments, with a max of 1024 lines.
+  // Accumulate the lines of each segment into the result or status set.
+  auto max_lines = std::max(max_log_lines_, batch_log_lines_);
   std::vector<std::string> results, statuses;
-  iterate(indexes, ([&results, &statuses, this](std::string& index) {
-            std::string value;
-            auto& target = isResultIndex(index) ? results : statuses;
-            if (getDatabaseValue(kLogs, index, value)) {
-              target.emplace_back(std::move(value));
-            }
-          }));
+  std::vector<std::string> result_indexes, status_indexes;
+  size_t lines = 0;
+  bool sent = true;
+  auto status = scanDatabaseValues(
+      kLogs,
+      index_name_,
+      max_lines,
+      [&, this](const std::string& index, std::string& value) {
+        if (max_lines > 0 && lines >= max_lines) {
+          return false;
+        }
+
+        auto is_result = isResultIndex(index);
+        auto count = segmentLines(index);
+        splitSegment(value, count, is_result ? results : statuses);
+        (is_result ? result_indexes : status_indexes).push_back(index);
+        lines += count;
+        return true;
+      });
 
   // If any results/statuses were found in the flushed buffer, send.
   if (send_results && !results.empty()) {
+    retry_after_ = std::chrono::seconds::zero();
     status = send(results, "result");
     if (!status.ok()) {
       VLOG(1) << "Error sending results to logger: " << status.getMessage();
+      sent = false;
 
       if (interrupted()) {
         return;
@@ -83,26 +142,24 @@ void BufferedLogForwarder::check(bool send_results, bool send_statuses) {
           results_backoff_period_ = max_backoff_period_;
           results_backoff_--;
         }
+        applyRetryAfter(results_backoff_period_);
         VLOG(1) << "Will attempt to send results again in "
                 << results_backoff_period_.count() << " seconds";
       }
     } else {
       // Clear the results logs once they were sent.
-      iterate(indexes, ([this](std::string& index) {
-                if (!isResultIndex(index)) {
-                  return;
-                }
-                deleteValueWithCount(kLogs, index);
-              }));
+      deleteSegments(result_indexes);
       results_backoff_ = 0;
       results_backoff_period_ = std::chrono::seconds::zero();
     }
   }
 
   if (send_statuses && !statuses.empty()) {
+    retry_after_ = std::chrono::seconds::zero();
     status = send(statuses, "status");
     if (!status.ok()) {
       VLOG(1) << "Error sending status to logger: " << status.getMessage();
+      sent = false;
 
       if (interrupted()) {
         return;
@@ -116,28 +173,45 @@ void BufferedLogForwarder::check(bool send_results, bool send_statuses) {
           statuses_backoff_period_ = max_backoff_period_;
           statuses_backoff_--;
         }
+        applyRetryAfter(statuses_backoff_period_);
         VLOG(1) << "Will attempt to send status again in "
                 << statuses_backoff_period_.count() << " seconds";
       }
     } else {
       // Clear the status logs once they were sent.
-      iterate(indexes, ([this](std::string& index) {
-                if (!isStatusIndex(index)) {
-                  return;
-                }
-                deleteValueWithCount(kLogs, index);
-              }));
+      deleteSegments(status_indexes);
       statuses_backoff_ = 0;
       statuses_backoff_period_ = std::chrono::seconds::zero();
     }
   }
 
+  // Grow the next batch while full batches are sent and logs remain.
+  if (sent && max_log_lines_ > 0 && backlog_max_log_lines_ > max_log_lines_ &&
+      lines >= max_lines && send_results && send_statuses &&
+      bufferedLines() > 0) {
+    batch_log_lines_ = std::min(max_lines * 2, backlog_max_log_lines_);
+  } else {
+    batch_log_lines_ = 0;
+  }
+
   // Purge any logs exceeding the max after our send attempt
   if (FLAGS_buffered_log_max > 0) {
     purge();
   }
 }
 
+void BufferedLogForwarder::applyRetryAfter(
+    std::chrono::seconds& backoff_period) {
+  if (retry_after_ > backoff_period) {
+    backoff_period = std::min(retry_after_, max_backoff_period_);
+  }
+}
+
+unsigned long long int BufferedLogForwarder::bufferedLines() {
+  RecursiveLock lock(count_mutex_);
+  return buffer_count_;
+}
+
 void BufferedLogForwarder::purge() {
   RecursiveLock lock(count_mutex_);
   if (buffer_count_ <= FLAGS_buffered_log_max) {
@@ -146,9 +220,10 @@ void BufferedLogForwarder::purge() {
 
   unsigned long long int purge_count = buffer_count_ - FLAGS_buffered_log_max;
 
-  // Collect purge_count indexes of each type (result/status) before
-  // partitioning to find the oldest. Note this assumes that the indexes are
-  // returned in ascending lexicographic order (true for RocksDB).
+  // Collect purge_count indexes of each type (result/status) before sorting
+  // to find the oldest, every segment holds at least one line. Note this
+  // assumes that the indexes are returned in ascending lexicographic order
+  // (true for RocksDB).
   std::vector<std::string> indexes;
   auto status =
       scanDatabaseKeys(kLogs, indexes, genIndexPrefix(true), purge_count);
@@ -170,27 +245,38 @@ void BufferedLogForwarder::purge() {
 
   indexes.insert(indexes.end(), status_indexes.begin(), status_indexes.end());
 
-  if (indexes.size() < purge_count) {
+  size_t prefix_size = genIndexPrefix(true).size();
+  // Sort the indexes so that the oldest come first, the logs of older
+  // versions are indexed by time and precede every segment.
+  std::sort(indexes.begin(),
+            indexes.end(),
+            [&](const std::string& a, const std::string& b) {
+              auto a_segment = isSegmentIndex(a);
+              auto b_segment = isSegmentIndex(b);
+              if (a_segment != b_segment) {
+                return b_segment;
+              }
+              // Skip the prefix when doing comparisons
+              return a.compare(prefix_size,
+                               std::string::npos,
+                               b,
+                               prefix_size,
+                               std::string::npos) < 0;
+            });
+
+  // Keep the oldest segments holding at least purge_count lines.
+  unsigned long long int lines = 0;
+  auto it = indexes.begin();
+  while (it != indexes.end() && lines < purge_count) {
+    lines += segmentLines(*it++);
+  }
+
+  if (lines < purge_count) {
     LOG(ERROR) << "Trying to purge " << purge_count << " logs but only found "
-               << indexes.size();
+               << lines;
     return;
   }
-
-  size_t prefix_size = genIndexPrefix(true).size();
-  // Partition the indexes so that the first purge_count elements are the
-  // oldest indexes (the ones to be purged)
-  std::nth_element(indexes.begin(),
-                   indexes.begin() + (unsigned int)purge_count - 1,
-                   indexes.end(),
-                   [&](const std::string& a, const std::string& b) {
-                     // Skip the prefix when doing comparisons
-                     return a.compare(prefix_size,
-                                      std::string::npos,
-                                      b,
-                                      prefix_size,
-                                      std::string::npos) < 0;
-                   });
-  indexes.erase(indexes.begin() + (unsigned int)purge_count, indexes.end());
+  indexes.erase(it, indexes.end());
 
   // Now only indexes of logs to be deleted remain
   iterate(indexes, [this](const std::string& index) {
@@ -200,25 +286,24 @@ void BufferedLogForwarder::purge() {
   });
 }
 
-void BufferedLogForwarder::start() {
-  while (!interrupted()) {
-    bool send_results = results_backoff_period_ <= std::chrono::seconds::zero();
-    bool send_statuses =
-        statuses_backoff_period_ <= std::chrono::seconds::zero();
-    check(send_results, send_statuses);
+std::chrono::milliseconds BufferedLogForwarder::tick() {
+  if (ticked_) {
+    // Apply any updates to configuration options, such as disabling of
+    // backoff, after each period.
+    applyNewConfiguration();
+    // Update backoff timers.
+    backoffTick();
+  }
+  ticked_ = true;
 
-    do {
-      // Cool off and time wait the configured period.
-      pause(std::chrono::milliseconds(log_period_));
-      // Apply any updates to configuration options, such as disabling of
-      // backoff.
-      applyNewConfiguration();
-      // Update backoff timers.
-      backoffTick();
-    } while (!interrupted() &&
-             results_backoff_period_ > std::chrono::seconds::zero() &&
-             statuses_backoff_period_ > std::chrono::seconds::zero());
+  bool send_results = results_backoff_period_ <= std::chrono::seconds::zero();
+  bool send_statuses = statuses_backoff_period_ <= std::chrono::seconds::zero();
+  if (send_results || send_statuses) {
+    check(send_results, send_statuses);
   }
+
+  // Cool off and time wait the configured period.
+  return std::chrono::milliseconds(log_period_);
 }
 
 void BufferedLogForwarder::backoffTick() {
@@ -240,8 +325,7 @@ void BufferedLogForwarder::backoffTick() {
 }
 
 Status BufferedLogForwarder::logString(const std::string& s, uint64_t time) {
-  std::string index = genResultIndex(time);
-  return addValueWithCount(kLogs, index, s);
+  return addSegment(true, s, 1, time);
 }
 
 Status BufferedLogForwarder::logStatus(const std::vector<StatusLogLine>& log,
@@ -250,6 +334,8 @@ Status BufferedLogForwarder::logStatus(const std::vector<StatusLogLine>& log,
   std::map<std::string, std::string> decorations;
   getDecorations(decorations);
 
+  // The status lines of one call are stored as a single segment.
+  std::string segment;
   for (const auto& item : log) {
     // Convert the StatusLogLine into JSON.
     JSON status_json;
@@ -285,16 +371,18 @@ Status BufferedLogForwarder::logStatus(const std::vector<StatusLogLine>& log,
       return status;
     }
 
-    // Store the status line in a backing store.
-    std::string index = genStatusIndex(time);
-    status = addValueWithCount(kLogs, index, json);
-    if (!status.ok()) {
-      // Do not continue if any line fails.
-      return status;
+    if (!segment.empty()) {
+      segment += '\n';
     }
+    segment += json;
   }
 
-  return Status(0);
+  if (log.empty()) {
+    return Status(0);
+  }
+
+  // Store the status lines in a backing store.
+  return addSegment(false, segment, log.size(), time);
 }
 
 bool BufferedLogForwarder::isIndex(const std::string& index, bool results) {
@@ -302,6 +390,25 @@ bool BufferedLogForwarder::isIndex(const std::string& index, bool results) {
   return target < index.size() && index.at(target) == (results ? 'r' : 's');
 }
 
+bool BufferedLogForwarder::isSegmentIndex(const std::string& index) {
+  size_t start = index_name_.size() + 3;
+  if (index.size() <= start + kSequenceWidth ||
+      index[start + kSequenceWidth] != '_') {
+    return false;
+  }
+  return std::all_of(index.begin() + start,
+                     index.begin() + start + kSequenceWidth,
+                     [](char c) { return c >= '0' && c <= '9'; });
+}
+
+size_t BufferedLogForwarder::segmentLines(const std::string& index) {
+  if (!isSegmentIndex(index)) {
+    return 1;
+  }
+  auto lines = tryTo<size_t>(index.substr(index.rfind('_') + 1), 10);
+  return std::max(lines.takeOr(size_t{1}), size_t{1});
+}
+
 bool BufferedLogForwarder::isResultIndex(const std::string& index) {
   return isIndex(index, true);
 }
@@ -322,21 +429,30 @@ std::string BufferedLogForwarder::genIndexPrefix(bool results) {
   return index_name_ + '_' + ((results) ? 'r' : 's') + '_';
 }
 
-std::string BufferedLogForwarder::genIndex(bool results, uint64_t time) {
+std::string BufferedLogForwarder::genIndex(bool results,
+                                           uint64_t time,
+                                           size_t lines) {
   if (time == 0) {
     time = getUnixTime();
   }
-  return genIndexPrefix(results) + std::to_string(time) + '_' +
-         std::to_string(++log_index_);
+  auto sequence = std::to_string(++log_index_);
+  if (sequence.size() < kSequenceWidth) {
+    sequence.insert(0, kSequenceWidth - sequence.size(), '0');
+  }
+  return genIndexPrefix(results) + sequence + '_' + std::to_string(time) +
+         '_' + std::to_string(lines);
 }
 
-Status BufferedLogForwarder::addValueWithCount(const std::string& domain,
-                                               const std::string& key,
-                                               const std::string& value) {
-  Status status = setDatabaseValue(domain, key, value);
+Status BufferedLogForwarder::addSegment(bool results,
+                                        const std::string& value,
+                                        size_t lines,
+                                        uint64_t time) {
+  // A scan must not miss a segment older than the last one it returns.
+  RecursiveLock lock(count_mutex_);
+  auto index = genIndex(results, time, lines);
+  Status status = setDatabaseValue(kLogs, index, value);
   if (status.ok()) {
-    RecursiveLock lock(count_mutex_);
-    buffer_count_++;
+    buffer_count_ += lines;
   }
   return status;
 }
@@ -346,9 +462,41 @@ Status BufferedLogForwarder::deleteValueWithCount(const std::string& domain,
   Status status = deleteDatabaseValue(domain, key);
   if (status.ok()) {
     RecursiveLock lock(count_mutex_);
-    if (buffer_count_ > 0) {
-      buffer_count_--;
+    auto lines = segmentLines(key);
+    buffer_count_ = (buffer_count_ > lines) ? buffer_count_ - lines : 0;
+  }
+  return status;
+}
+
+Status BufferedLogForwarder::deleteSegments(
+    const std::vector<std::string>& indexes) {
+  // Segments written later sort after the last one, the range holds only
+  // the segments that were sent.
+  const std::string* first = nullptr;
+  const std::string* last = nullptr;
+  unsigned long long int lines = 0;
+  for (const auto& index : indexes) {
+    if (!isSegmentIndex(index)) {
+      deleteValueWithCount(kLogs, index);
+      continue;
+    }
+    if (first == nullptr) {
+      first = &index;
     }
+    last = &index;
+    lines += segmentLines(index);
+  }
+
+  if (first == nullptr) {
+    return Status(0);
+  }
+
+  auto status = deleteDatabaseRange(kLogs, *first, *last);
+  if (status.ok()) {
+    RecursiveLock lock(count_mutex_);
+    buffer_count_ = (buffer_count_ > lines) ? buffer_count_ - lines : 0;
+  } else {
+    LOG(ERROR) << "Error deleting sent buffered logs: " << status.getMessage();
   }
   return status;
 }
@@ -44,10 +44,15 @@ inline void iterate(std::vector<std::string>& input,
  * status and result logs. Subclasses take advantage of this reliable sending
  * logic, and implement their own methods for actually sending logs.
  *
+ * Logs are buffered as segments, each logString or logStatus call appends one
+ * value holding its lines. Segment indexes start with a sequence, so they are
+ * scanned in the order they were written, and the sent segments are removed
+ * with one range delete.
+ *
  * Subclasses must define the send() method, and if a subclass overrides
  * setUp(), it **MUST** call this base class setUp() from that method.
  */
-class BufferedLogForwarder : public InternalRunnable {
+class BufferedLogForwarder : public PeriodicRunnable {
  protected:
   static const std::chrono::seconds kLogPeriod;
   static const uint64_t kMaxLogLines;
@@ -57,7 +62,7 @@ class BufferedLogForwarder : public InternalRunnable {
   // subclasses should expose appropriate constructors to their users.
   explicit BufferedLogForwarder(const std::string& service_name,
                                 const std::string& name)
-      : InternalRunnable(service_name),
+      : PeriodicRunnable(service_name, ThreadClass::Logger),
         log_period_(kLogPeriod),
         max_log_lines_(kMaxLogLines),
         index_name_(name) {}
@@ -67,7 +72,7 @@ class BufferedLogForwarder : public InternalRunnable {
       const std::string& service_name,
       const std::string& name,
       const std::chrono::duration<Rep, Period>& log_period)
-      : InternalRunnable(service_name),
+      : PeriodicRunnable(service_name, ThreadClass::Logger),
         log_period_(
             std::chrono::duration_cast<std::chrono::seconds>(log_period)),
         max_log_lines_(kMaxLogLines),
@@ -81,7 +86,7 @@ class BufferedLogForwarder : public InternalRunnable {
       uint64_t max_log_lines,
       const std::chrono::duration<Rep, Period>& max_backoff_period =
           std::chrono::seconds::zero())
-      : InternalRunnable(service_name),
+      : PeriodicRunnable(service_name, ThreadClass::Logger),
         log_period_(
             std::chrono::duration_cast<std::chrono::seconds>(log_period)),
         max_backoff_period_(std::chrono::duration_cast<std::chrono::seconds>(
@@ -89,10 +94,11 @@ class BufferedLogForwarder : public InternalRunnable {
         max_log_lines_(max_log_lines),
         index_name_(name) {}
 
- public:
-  /// A simple wait lock, and flush based on settings.
-  void start() override;
+ protected:
+  /// Flush based on settings, returns the delay before the next flush.
+  std::chrono::milliseconds tick() override;
 
+ public:
   /**
    * @brief Set up the forwarder. May be used to init remote clients, etc.
    *
@@ -137,9 +143,15 @@ class BufferedLogForwarder : public InternalRunnable {
   /**
    * @brief Check for new logs and send.
    *
-   * Scan the logs domain for up to max_log_lines_ log lines.
-   * Sort those lines into status and request types then forward (send) each
-   * set. On success, clear the data and indexes. Calls purge upon completion.
+   * Scan the logs domain for the oldest segments, up to max_log_lines_ log
+   * lines. A segment is never split, the first one is read even when it holds
+   * more lines. Sort those lines into status and request types then forward
+   * (send) each set. On success, clear the data and indexes. Calls purge upon
+   * completion.
+   *
+   * While full batches are sent and more logs are buffered, the batch size
+   * doubles up to backlog_max_log_lines_. It is reset once the backlog is
+   * sent or a send fails.
    */
   void check(bool send_results = true, bool send_statuses = true);
 
@@ -147,8 +159,8 @@ class BufferedLogForwarder : public InternalRunnable {
    * @brief Purge the oldest logs, if the max is exceeded
    *
    * Uses the buffered_log_max flag to determine the maximum number of buffered
-   * logs. If this number is exceeded, the logs with the oldest timestamp are
-   * purged. Order of purging for logs with the same timestamp is undefined.
+   * logs. If this number is exceeded, the oldest segments are purged until
+   * the limit is respected.
    */
   void purge();
 
@@ -158,6 +170,9 @@ class BufferedLogForwarder : public InternalRunnable {
   /// Reduce backoff time, if needed.
   void backoffTick();
 
+  /// The number of buffered log lines.
+  unsigned long long int bufferedLines();
+
  protected:
   /// Return whether the string is a result index
   bool isResultIndex(const std::string& index);
@@ -165,6 +180,12 @@ class BufferedLogForwarder : public InternalRunnable {
   /// Return whether the string is a status index
   bool isStatusIndex(const std::string& index);
 
+  /// Return whether the index starts with a sequence, older versions did not
+  bool isSegmentIndex(const std::string& index);
+
+  /// The number of log lines in the segment of an index
+  size_t segmentLines(const std::string& index);
+
  private:
   /// Helper for isResultIndex/isStatusIndex
   bool isIndex(const std::string& index, bool results);
@@ -179,15 +200,18 @@ class BufferedLogForwarder : public InternalRunnable {
  private:
   std::string genIndexPrefix(bool results);
 
-  std::string genIndex(bool results, uint64_t time = 0);
+  std::string genIndex(bool results, uint64_t time = 0, size_t lines = 1);
 
   /**
-   * @brief Add a database value while maintaining count
+   * @brief Append a segment of log lines while maintaining count
    *
+   * The index is generated while holding the count lock, a segment is always
+   * written before any segment with a greater sequence.
    */
-  Status addValueWithCount(const std::string& domain,
-                           const std::string& key,
-                           const std::string& value);
+  Status addSegment(bool results,
+                    const std::string& value,
+                    size_t lines,
+                    uint64_t time);
 
   /**
    * @brief Delete a database value while maintaining count
@@ -196,6 +220,14 @@ class BufferedLogForwarder : public InternalRunnable {
   Status deleteValueWithCount(const std::string& domain,
                               const std::string& key);
 
+  /**
+   * @brief Delete sent segments while maintaining count
+   *
+   * The indexes must be the oldest segments of their type, in scan order.
+   * Segments with a sequence are removed with one range delete.
+   */
+  Status deleteSegments(const std::vector<std::string>& indexes);
+
  protected:
   /// Seconds between flushing logs
   std::chrono::seconds log_period_;
@@ -207,6 +239,17 @@ class BufferedLogForwarder : public InternalRunnable {
   /// Max number of logs to flush per check
   uint64_t max_log_lines_;
 
+  /// Max number of logs to flush per check while backlogged, 0 disables it.
+  uint64_t backlog_max_log_lines_{0};
+
+  /**
+   * @brief The time the remote asked to wait before sending again.
+   *
+   * A send() implementation may set it when failing. The backoff period is
+   * extended to it, up to max_backoff_period_.
+   */
+  std::chrono::seconds retry_after_{std::chrono::seconds::zero()};
+
   /**
    * @brief Name to use in index
    *
@@ -223,7 +266,17 @@ class BufferedLogForwarder : public InternalRunnable {
   std::chrono::seconds statuses_backoff_period_ = std::chrono::seconds::zero();
 
  private:
-  /// Hold an incrementing index for buffering logs
+  /// Extend a backoff period to the time the remote asked to wait.
+  void applyRetryAfter(std::chrono::seconds& backoff_period);
+
+ private:
+  /// The number of lines of the next check, 0 when not backlogged.
+  uint64_t batch_log_lines_{0};
+
+  /// The first tick flushes without waiting for the log period.
+  bool ticked_{false};
+
+  /// Hold an incrementing sequence for buffering logs, restored by setUp
   std::atomic<size_t> log_index_{0};
 
   /// Stores the count of buffered logs
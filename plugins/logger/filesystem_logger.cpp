@@ -11,14 +11,26 @@
 #include "logrotate.h"
 
 #include <osquery/core/flags.h>
+#include <osquery/dispatcher/dispatcher.h>
+#include <osquery/filesystem/fileops.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/logger/data_logger.h>
 #include <osquery/logger/logger.h>
 #include <osquery/utils/config/default_paths.h>
 #include <osquery/utils/conversions/tryto.h>
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
 #include <exception>
 #include <iostream>
+#include <mutex>
+
+#ifndef WIN32
+#include <climits>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
 
 namespace fs = boost::filesystem;
 namespace osquery {
@@ -83,6 +95,15 @@ CLI_FLAG(string,
 
 DEFINE_validator(logger_mode, &validateLoggerMode);
 
+FLAG(uint64,
+     logger_flush_interval,
+     0,
+     "Milliseconds a background thread buffers filesystem logs (0 disables)");
+FLAG(uint64,
+     logger_fsync_interval,
+     0,
+     "Seconds between fsyncs of the buffered filesystem logs (0 disables)");
+
 const std::string kFilesystemLoggerFilename = "osqueryd.results.log";
 const std::string kFilesystemLoggerSnapshots = "osqueryd.snapshots.log";
 
@@ -172,6 +193,254 @@ Status LogRotate::moveFiles(const std::vector<std::string>& moves,
   return Status::success();
 }
 
+namespace {
+
+/// Wake the writer early once this many bytes are buffered for a log.
+const size_t kFlushBufferedBytes = 4 * 1024 * 1024;
+
+/// Drop lines rather than buffering more bytes for a log.
+const size_t kMaxBufferedBytes = 64 * 1024 * 1024;
+
+/// The lines buffered for one of the results or snapshot logs.
+struct LogBuffer {
+  /// Full path to the log file.
+  std::string path;
+
+  /// Rotator for the log file, used by the writer thread.
+  std::unique_ptr<LogRotate> rotate{nullptr};
+
+  /// Protects the lines and bytes, swapped with an empty batch on flush.
+  std::mutex mutex;
+  std::vector<std::string> lines;
+  size_t bytes{0};
+
+  /// The writer wrote lines that were not fsynced yet.
+  bool unsynced{false};
+  std::chrono::steady_clock::time_point last_sync;
+};
+
+/**
+ * @brief Writes the results and snapshot logs from a background thread.
+ *
+ * The logging threads only append lines to a buffer. Every
+ * logger_flush_interval the writer swaps the buffer with an empty one and
+ * writes the batch with a single writev, then checks the rotation, so the
+ * rotation and compression of the rotated files happen on the writer too.
+ * With logger_fsync_interval the writer fsyncs a log at most once per
+ * interval, covering every batch written since the last fsync.
+ */
+class FilesystemLogWriter : public InternalRunnable {
+ public:
+  explicit FilesystemLogWriter(std::int32_t mode)
+      : InternalRunnable("FilesystemLogWriter", ThreadClass::Logger),
+        mode_(mode) {}
+
+  /// Write the buffered lines, then log to the files under a new path.
+  void setPath(const fs::path& log_path);
+
+  /// Buffer a line, it is dropped if the writer fell too far behind.
+  Status append(LogBuffer& buffer, const std::string& s);
+
+  /// Write the buffered lines of both logs from the calling thread.
+  void flush();
+
+ public:
+  LogBuffer results;
+  LogBuffer snapshots;
+
+ protected:
+  void start() override;
+  void stop() override;
+
+ private:
+  /// Write the buffered lines of both logs, the write_mutex_ is held.
+  void flushLocked();
+
+  /// Write, fsync and rotate a log, the write_mutex_ is held.
+  Status writeBuffer(LogBuffer& buffer);
+
+  /// Write a batch of lines to an open log file.
+  Status writeLines(PlatformFile& file, std::vector<std::string>& lines);
+
+ private:
+  /// The FLAGS_logger_mode of the plugin.
+  std::int32_t mode_;
+
+  /// Serializes the batches written by the writer thread and flush.
+  std::mutex write_mutex_;
+
+  /// Wakes the writer before the flush interval expires.
+  std::mutex wake_mutex_;
+  std::condition_variable wake_;
+  bool wake_requested_{false};
+};
+
+void FilesystemLogWriter::setPath(const fs::path& log_path) {
+  std::lock_guard<std::mutex> lock(write_mutex_);
+  flushLocked();
+
+  results.path = (log_path / kFilesystemLoggerFilename).string();
+  results.rotate = std::make_unique<LogRotate>(results.path);
+  snapshots.path = (log_path / kFilesystemLoggerSnapshots).string();
+  snapshots.rotate = std::make_unique<LogRotate>(snapshots.path);
+}
+
+Status FilesystemLogWriter::append(LogBuffer& buffer, const std::string& s) {
+  bool wake = false;
+  {
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    if (buffer.bytes + s.size() + 1 > kMaxBufferedBytes) {
+      return Status::failure("The filesystem log writer is behind");
+    }
+
+    std::string line;
+    line.reserve(s.size() + 1);
+    line.append(s).push_back('\n');
+    buffer.bytes += line.size();
+    buffer.lines.push_back(std::move(line));
+    wake = buffer.bytes >= kFlushBufferedBytes;
+  }
+
+  if (wake) {
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+    wake_requested_ = true;
+    wake_.notify_one();
+  }
+  return Status::success();
+}
+
+void FilesystemLogWriter::flush() {
+  std::lock_guard<std::mutex> lock(write_mutex_);
+  flushLocked();
+}
+
+void FilesystemLogWriter::flushLocked() {
+  for (auto* buffer : {&results, &snapshots}) {
+    auto s = writeBuffer(*buffer);
+    if (!s.ok()) {
+      LOG(WARNING) << "Cannot write " << buffer->path << ": " << s.toString();
+    }
+  }
+}
+
+void FilesystemLogWriter::start() {
+  while (!interrupted()) {
+    auto interval = std::max<std::uint64_t>(FLAGS_logger_flush_interval, 1);
+    {
+      std::unique_lock<std::mutex> lock(wake_mutex_);
+      wake_.wait_for(lock,
+                     std::chrono::milliseconds(interval),
+                     [this]() { return wake_requested_ || interrupted(); });
+      wake_requested_ = false;
+    }
+    flush();
+  }
+
+  // Write the lines buffered while the service was stopping.
+  flush();
+}
+
+void FilesystemLogWriter::stop() {
+  std::lock_guard<std::mutex> lock(wake_mutex_);
+  wake_.notify_one();
+}
+
+Status FilesystemLogWriter::writeBuffer(LogBuffer& buffer) {
+  std::vector<std::string> lines;
+  {
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    lines.swap(buffer.lines);
+    buffer.bytes = 0;
+  }
+
+  auto now = std::chrono::steady_clock::now();
+  bool sync = FLAGS_logger_fsync_interval > 0 &&
+              now - buffer.last_sync >=
+                  std::chrono::seconds(FLAGS_logger_fsync_interval);
+  if (lines.empty() && !(sync && buffer.unsynced)) {
+    return Status::success();
+  }
+
+  PlatformFile file(buffer.path, PF_OPEN_ALWAYS | PF_WRITE | PF_APPEND, mode_);
+  if (!file.isValid()) {
+    return Status::failure("Could not open the log file");
+  }
+  if (!platformChmod(buffer.path, mode_)) {
+    return Status::failure("Failed to change the log file permissions");
+  }
+
+  auto s = writeLines(file, lines);
+  if (!s.ok()) {
+    return s;
+  }
+  buffer.unsynced = buffer.unsynced || !lines.empty();
+
+  // A rotated log is fsynced before it is renamed.
+  bool rotate = FLAGS_logger_rotate && buffer.rotate->shouldRotate();
+  sync = sync || (rotate && FLAGS_logger_fsync_interval > 0);
+  if (buffer.unsynced && sync) {
+#ifdef WIN32
+    FlushFileBuffers(file.nativeHandle());
+#else
+    ::fsync(file.nativeHandle());
+#endif
+    buffer.unsynced = false;
+    buffer.last_sync = now;
+  }
+
+  if (rotate) {
+    return buffer.rotate->rotate(FLAGS_logger_rotate_max_files);
+  }
+  return Status::success();
+}
+
+Status FilesystemLogWriter::writeLines(PlatformFile& file,
+                                       std::vector<std::string>& lines) {
+#ifdef WIN32
+  std::string content;
+  for (const auto& line : lines) {
+    content += line;
+  }
+
+  auto bytes = file.write(content.c_str(), content.size());
+  if (bytes < 0 || static_cast<size_t>(bytes) != content.size()) {
+    return Status::failure("Failed to write to the log file");
+  }
+#else
+  std::vector<struct iovec> vectors;
+  size_t next = 0;
+  while (next < lines.size()) {
+    auto count = std::min(lines.size() - next, static_cast<size_t>(IOV_MAX));
+    vectors.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+      vectors[i].iov_base = &lines[next + i][0];
+      vectors[i].iov_len = lines[next + i].size();
+    }
+
+    auto bytes = ::writev(file.nativeHandle(), vectors.data(), count);
+    if (bytes < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return Status::failure("Failed to write to the log file");
+    }
+
+    // Skip the written lines, a partially written line is resumed.
+    auto written = static_cast<size_t>(bytes);
+    while (next < lines.size() && written >= lines[next].size()) {
+      written -= lines[next].size();
+      ++next;
+    }
+    if (written > 0) {
+      lines[next].erase(0, written);
+    }
+  }
+#endif
+  return Status::success();
+}
+
+} // namespace
+
 struct FilesystemLoggerPlugin::impl {
   impl() {
     const auto logger_mode_octal_exp =
@@ -202,6 +471,9 @@ struct FilesystemLoggerPlugin::impl {
   /// The FLAGS_logger_mode interpreted as a number in octal form, converted to
   /// integer
   std::int32_t logger_mode_octal;
+
+  /// The background writer, if logger_flush_interval is set.
+  std::shared_ptr<FilesystemLogWriter> writer{nullptr};
 };
 
 FilesystemLoggerPlugin::FilesystemLoggerPlugin()
@@ -216,12 +488,32 @@ Status FilesystemLoggerPlugin::setUp() {
   pimpl_->snapshot_rotate = std::make_unique<LogRotate>(
       (pimpl_->log_path / kFilesystemLoggerSnapshots).string());
 
+  if (FLAGS_logger_flush_interval > 0) {
+    if (pimpl_->writer == nullptr) {
+      pimpl_->writer =
+          std::make_shared<FilesystemLogWriter>(pimpl_->logger_mode_octal);
+      pimpl_->writer->setPath(pimpl_->log_path);
+      Dispatcher::addService(pimpl_->writer);
+    } else {
+      pimpl_->writer->setPath(pimpl_->log_path);
+    }
+  } else if (pimpl_->writer != nullptr) {
+    // Write the buffered lines before logging synchronously again.
+    pimpl_->writer->flush();
+    pimpl_->writer->interrupt();
+    pimpl_->writer = nullptr;
+  }
+
   // Ensure that we create the results log here.
   WriteLock lock(pimpl_->results_mutex);
   return logStringToFile("", kFilesystemLoggerFilename, true);
 }
 
 Status FilesystemLoggerPlugin::logString(const std::string& s) {
+  if (pimpl_->writer != nullptr) {
+    return pimpl_->writer->append(pimpl_->writer->results, s);
+  }
+
   WriteLock lock(pimpl_->results_mutex);
   if (FLAGS_logger_rotate && pimpl_->results_rotate->shouldRotate()) {
     auto s = pimpl_->results_rotate->rotate(FLAGS_logger_rotate_max_files);
@@ -234,6 +526,10 @@ Status FilesystemLoggerPlugin::logString(const std::string& s) {
 }
 
 Status FilesystemLoggerPlugin::logSnapshot(const std::string& s) {
+  if (pimpl_->writer != nullptr) {
+    return pimpl_->writer->append(pimpl_->writer->snapshots, s);
+  }
+
   // Send the snapshot data to a separate filename.
   WriteLock lock(pimpl_->snapshot_mutex);
   if (FLAGS_logger_rotate && pimpl_->snapshot_rotate->shouldRotate()) {
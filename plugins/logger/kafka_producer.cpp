@@ -27,6 +27,7 @@
 #include <osquery/core/flags.h>
 #include <osquery/core/system.h>
 #include <osquery/dispatcher/dispatcher.h>
+#include <osquery/numeric_monitoring/numeric_monitoring.h>
 #include <osquery/registry/registry_factory.h>
 #include <osquery/utils/json/json.h>
 
@@ -59,12 +60,52 @@ FLAG(
     "none",
     "Compression codec to use for compressing message sets ('none' or 'gzip')");
 
+FLAG(uint64,
+     logger_kafka_linger_ms,
+     0,
+     "Milliseconds the producer waits to batch messages (0 = librdkafka "
+     "default)");
+
+FLAG(uint64,
+     logger_kafka_batch_size,
+     0,
+     "Maximum number of messages in a produced message set (0 = librdkafka "
+     "default)");
+
+FLAG(bool,
+     logger_kafka_key_host_identifier,
+     false,
+     "Key messages by the host identifier instead of the hostname and binary");
+
 /// How often to poll Kafka broker for publish results.
 const std::chrono::seconds kKafkaPollDuration = std::chrono::seconds(5);
 
 /// Default Kafka topic to publish to if payload name is not found.
 const std::string kKafkaBaseTopic("base_topic");
 
+namespace {
+
+/**
+ * @brief A batch of payloads shared by the messages referencing it.
+ *
+ * The batch is parsed in place, each message payload points into the buffer.
+ * It is freed once every message was delivered or failed to be queued.
+ */
+struct KafkaBatchBuffer {
+  std::vector<char> data;
+
+  /// Messages still referencing the buffer, plus one for the producer.
+  std::atomic<size_t> references{1};
+};
+
+void releaseBatchBuffer(KafkaBatchBuffer* buffer) {
+  if (buffer != nullptr && --buffer->references == 0) {
+    delete buffer;
+  }
+}
+
+} // namespace
+
 /// Deleter for rd_kafka_t unique_ptr.
 static inline void delKafkaHandle(rd_kafka_t* k) {
   if (k != nullptr) {
@@ -142,20 +183,57 @@ inline std::string getMsgName(const std::string& payload) {
 void onMsgDelivery(rd_kafka_t* rk,
                    const rd_kafka_message_t* rkmessage,
                    void* opaque) {
-  if (rkmessage->err != RD_KAFKA_RESP_ERR_NO_ERROR) {
-    LOG(ERROR) << "Kafka message delivery failed: "
-               << rd_kafka_err2str(rkmessage->err);
+  if (opaque != nullptr) {
+    static_cast<KafkaProducerPlugin*>(opaque)->countDelivery(*rkmessage);
+  }
+  KafkaProducerPlugin::releaseMessage(*rkmessage);
+}
+
+void KafkaProducerPlugin::countDelivery(const rd_kafka_message_t& message) {
+  if (message.err == RD_KAFKA_RESP_ERR_NO_ERROR) {
+    delivered_++;
+  } else {
+    deliveryErrors_[message.err]++;
+  }
+}
+
+void KafkaProducerPlugin::releaseMessage(const rd_kafka_message_t& message) {
+  releaseBatchBuffer(static_cast<KafkaBatchBuffer*>(message._private));
+}
+
+void KafkaProducerPlugin::reportDeliveries() {
+  size_t failed = 0;
+  for (const auto& error : deliveryErrors_) {
+    LOG(ERROR) << "Kafka message delivery failed " << error.second
+               << " times: " << rd_kafka_err2str(error.first);
+    failed += error.second;
+  }
+
+  if (delivered_ > 0) {
+    monitoring::record("logger.kafka.delivered",
+                       static_cast<monitoring::ValueType>(delivered_),
+                       monitoring::PreAggregationType::Sum);
+  }
+  if (failed > 0) {
+    monitoring::record("logger.kafka.failed",
+                       static_cast<monitoring::ValueType>(failed),
+                       monitoring::PreAggregationType::Sum);
   }
+
+  delivered_ = 0;
+  deliveryErrors_.clear();
 }
 
 void KafkaProducerPlugin::flushMessages() {
   WriteLock lock(producerMutex_);
   rd_kafka_flush(producer_.get(), 3 * 1000);
+  reportDeliveries();
 }
 
 void KafkaProducerPlugin::pollKafka() {
   WriteLock lock(producerMutex_);
   rd_kafka_poll(producer_.get(), 0 /*non-blocking*/);
+  reportDeliveries();
 }
 
 void KafkaProducerPlugin::start() {
@@ -182,7 +260,9 @@ void KafkaProducerPlugin::init(const std::string& name,
   // Get local hostname to use as client id and Kafka msg key.
   std::string hostname(getHostname());
 
-  msgKey_ = hostname + "_" + name;
+  // The key decides the partition, keying by host keeps its logs in order.
+  msgKey_ = FLAGS_logger_kafka_key_host_identifier ? getHostIdentifier()
+                                                   : hostname + "_" + name;
 
   /* Per rd_kafka.h in describing `rd_kafka_new`: "The \p conf object is freed
    * by this function on success and must not be used". Therefore we only
@@ -211,8 +291,20 @@ void KafkaProducerPlugin::init(const std::string& name,
     return;
   }
 
-  // Register send callback.
+  if ((FLAGS_logger_kafka_linger_ms > 0 &&
+       !setConf(conf,
+                "linger.ms",
+                std::to_string(FLAGS_logger_kafka_linger_ms))) ||
+      (FLAGS_logger_kafka_batch_size > 0 &&
+       !setConf(conf,
+                "batch.num.messages",
+                std::to_string(FLAGS_logger_kafka_batch_size)))) {
+    return;
+  }
+
+  // Register send callback, delivery reports are counted by this plugin.
   rd_kafka_conf_set_dr_msg_cb(conf, onMsgDelivery);
+  rd_kafka_conf_set_opaque(conf, this);
 
   // Create producer handle.
   char errstr[512] = {0};
@@ -276,6 +368,119 @@ Status KafkaProducerPlugin::logString(const std::string& payload) {
   return status;
 }
 
+Status KafkaProducerPlugin::logEvent(const std::string& payload) {
+  if (!running_.load()) {
+    return Status(
+        1, "Cannot log because Kafka producer did not initiate properly.");
+  }
+
+  auto topic = queryToTopics_[kKafkaBaseTopic];
+  if (topic == nullptr) {
+    return Status(2, "Could not publish event: base topic not configured");
+  }
+
+  auto status = publishMsg(topic, payload);
+  pollKafka();
+  return status;
+}
+
+Status KafkaProducerPlugin::logEventBatch(const std::string& event_batch) {
+  return produceBatch(event_batch, true);
+}
+
+Status KafkaProducerPlugin::logStringBatch(const std::string& batch) {
+  return produceBatch(batch, false);
+}
+
+Status KafkaProducerPlugin::produceBatch(const std::string& batch,
+                                         bool events) {
+  if (!running_.load()) {
+    return Status(
+        1, "Cannot log because Kafka producer did not initiate properly.");
+  }
+
+  // A single copy of the batch is parsed in place and shared by the messages.
+  auto buffer = new KafkaBatchBuffer();
+  buffer->data.assign(batch.begin(), batch.end());
+  buffer->data.push_back('\0');
+
+  rapidjson::Document doc;
+  if (doc.ParseInsitu(buffer->data.data()).HasParseError() || !doc.IsArray()) {
+    releaseBatchBuffer(buffer);
+    return Status::failure("Invalid batch passed to the Kafka logger");
+  }
+
+  std::map<rd_kafka_topic_t*, std::vector<rd_kafka_message_t>> topic_messages;
+  size_t error_count = 0;
+  for (auto& payload : doc.GetArray()) {
+    if (!payload.IsString()) {
+      ++error_count;
+      continue;
+    }
+
+    rd_kafka_topic_t* topic = nullptr;
+    auto name = events ? std::string() : getMsgName(payload.GetString());
+    auto it = queryToTopics_.find(name);
+    if (it != queryToTopics_.end()) {
+      topic = it->second;
+    } else {
+      topic = queryToTopics_[kKafkaBaseTopic];
+    }
+
+    if (topic == nullptr) {
+      ++error_count;
+      continue;
+    }
+
+    rd_kafka_message_t message{};
+    message.payload = const_cast<char*>(payload.GetString());
+    message.len = payload.GetStringLength();
+    message.key = const_cast<char*>(msgKey_.data());
+    message.key_len = msgKey_.size();
+    message._private = buffer;
+    topic_messages[topic].push_back(message);
+  }
+
+  for (auto& topic : topic_messages) {
+    buffer->references += topic.second.size();
+    error_count += publishBatch(topic.first, topic.second);
+  }
+  releaseBatchBuffer(buffer);
+
+  // Poll once for the whole batch.
+  pollKafka();
+
+  if (error_count != 0) {
+    return Status::failure("Could not publish " + std::to_string(error_count) +
+                           " messages");
+  }
+  return Status::success();
+}
+
+size_t KafkaProducerPlugin::publishBatch(
+    rd_kafka_topic_t* topic, std::vector<rd_kafka_message_t>& messages) {
+  rd_kafka_produce_batch(topic,
+                         RD_KAFKA_PARTITION_UA,
+                         0 /* The payloads are referenced, not copied */,
+                         messages.data(),
+                         static_cast<int>(messages.size()));
+
+  // Messages that could not be queued will not be reported.
+  size_t failed = 0;
+  for (const auto& message : messages) {
+    if (message.err != RD_KAFKA_RESP_ERR_NO_ERROR) {
+      releaseMessage(message);
+      ++failed;
+    }
+  }
+
+  if (failed > 0) {
+    LOG(ERROR) << "Could not queue " << failed << " Kafka messages: "
+               << rd_kafka_err2str(rd_kafka_last_error());
+  }
+  return failed;
+}
+
 Status KafkaProducerPlugin::publishMsg(rd_kafka_topic_t* topic,
                                        const std::string& payload) {
   if (rd_kafka_produce(topic,
@@ -10,7 +10,9 @@
 #pragma once
 
 #include <atomic>
+#include <map>
 #include <mutex>
+#include <vector>
 
 #include <librdkafka/rdkafka.h>
 
@@ -37,6 +39,26 @@ class KafkaProducerPlugin : public LoggerPlugin, public InternalRunnable {
    */
   Status logString(const std::string& s) override;
 
+  /// Forwarded event rows are published to the base topic.
+  Status logEvent(const std::string& s) override;
+
+  /// Publish a batch of forwarded event rows to the base topic.
+  Status logEventBatch(const std::string& event_batch) override;
+
+  /**
+   * @brief Publish a JSON array of log lines, grouped by their topic.
+   *
+   * The lines are not copied for each message: every message references the
+   * one copy of the batch until librdkafka reports its delivery.
+   */
+  Status logStringBatch(const std::string& batch) override;
+
+  /// Count a delivery report, they are aggregated after each poll.
+  void countDelivery(const rd_kafka_message_t& message);
+
+  /// Release the batch referenced by a delivered or failed message.
+  static void releaseMessage(const rd_kafka_message_t& message);
+
   /**
    * @brief Initializes the Kafka producer.
    *
@@ -79,6 +101,16 @@ class KafkaProducerPlugin : public LoggerPlugin, public InternalRunnable {
   virtual Status publishMsg(rd_kafka_topic_t* topic,
                             const std::string& payload);
 
+  /**
+   * @brief Publishes messages to a Kafka topic at once.
+   *
+   * The payloads are not copied, see releaseMessage.
+   *
+   * @return the number of messages that could not be queued.
+   */
+  virtual size_t publishBatch(rd_kafka_topic_t* topic,
+                              std::vector<rd_kafka_message_t>& messages);
+
   /**
    * @brief Flushes all buffered messages to Kafka, waiting for a maximum of 3
    * seconds.  Wrapper with mutex locking around rd_kafka_flush.
@@ -104,6 +136,12 @@ class KafkaProducerPlugin : public LoggerPlugin, public InternalRunnable {
   /// Initiates Kafka topic.  Caller needs to handle rd_kafka_topic_t* cleanup.
   rd_kafka_topic_t* initTopic(const std::string& topicName);
 
+  /// Parse a JSON array of payloads and publish them grouped by topic.
+  Status produceBatch(const std::string& batch, bool events);
+
+  /// Record and log the delivery reports counted since the last report.
+  void reportDeliveries();
+
   /// Smart pointer to the Kafka producer.
   std::unique_ptr<rd_kafka_t, std::function<void(rd_kafka_t*)>> producer_;
 
@@ -118,6 +156,12 @@ class KafkaProducerPlugin : public LoggerPlugin, public InternalRunnable {
   /// Mutex for managing access to the producer_ pointer.
   Mutex producerMutex_;
 
+  /// Messages delivered since the last report, counted while polling.
+  size_t delivered_{0};
+
+  /// Failed deliveries since the last report, by error.
+  std::map<rd_kafka_resp_err_t, size_t> deliveryErrors_;
+
   /// Flag to ensure shutdown method is called only once
   static std::once_flag shutdownFlag_;
 };
@@ -9,11 +9,14 @@
 
 #include <chrono>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <vector>
 
 #include <aws/kinesis/KinesisClient.h>
 #include <aws/kinesis/model/PutRecordsRequestEntry.h>
+#include <aws/kinesis/model/PutRecordsResult.h>
 #include <gtest/gtest.h>
 
 #include <osquery/core/core.h>
@@ -41,6 +44,8 @@ class AwsLoggerTests : public testing::Test {
 
 class DummyOutcome final : public Aws::Kinesis::Model::PutRecordsOutcome {
  public:
+  using Aws::Kinesis::Model::PutRecordsOutcome::PutRecordsOutcome;
+
   bool IsSuccess() {
     return true;
   }
@@ -187,4 +192,108 @@ TEST_F(AwsLoggerTests, test_send) {
             "test\":\"2\",\"log_type\":\"result\"}\n");
   EXPECT_EQ(third_batch[1], "{\"batch3\":\"3\",\"log_type\":\"result\"}\n");
 }
+
+class RetryLogForwarder final : public IDummyLogForwarder {
+ public:
+  RetryLogForwarder()
+      : IDummyLogForwarder(
+            "retry", 10, 50, "http://example.com", AWSRegion{""}) {}
+
+ protected:
+  Status internalSetup() override {
+    return Status(0, "OK");
+  }
+
+  Outcome internalSend(const Batch& batch) override {
+    Aws::Kinesis::Model::PutRecordsResult result;
+    int failed_record_count = 0;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& record : batch) {
+      std::string buffer(
+          reinterpret_cast<const char*>(record.GetData().GetUnderlyingData()),
+          record.GetData().GetLength());
+
+      // The first record of a batch fails on its first attempt
+      auto attempt = attempts_[buffer]++;
+      Aws::Kinesis::Model::PutRecordsResultEntry entry;
+      if (&record == &batch.front() && attempt == 0) {
+        entry.SetErrorCode("ProvisionedThroughputExceededException");
+        failed_record_count++;
+      }
+      result.AddRecords(entry);
+    }
+
+    result.SetFailedRecordCount(failed_record_count);
+    return Outcome(std::move(result));
+  }
+
+  void initializeRecord(Record& record,
+                        Aws::Utils::ByteBuffer& buffer) const override {
+    record.SetData(buffer);
+  }
+
+  std::size_t getMaxBytesPerRecord() const override {
+    return 80U;
+  }
+
+  std::size_t getMaxRecordsPerBatch() const override {
+    return 2U;
+  }
+
+  std::size_t getMaxBytesPerBatch() const override {
+    return 128U;
+  }
+
+  std::size_t getMaxRetryCount() const override {
+    return 2U;
+  }
+
+  std::size_t getInitialRetryDelay() const override {
+    return 0U;
+  }
+
+  bool appendNewlineSeparators() const override {
+    return false;
+  }
+
+  std::size_t getMaxInflightRequests() const override {
+    return 2U;
+  }
+
+  std::size_t getFailedRecordCount(Outcome& outcome) const override {
+    return static_cast<std::size_t>(outcome.GetResult().GetFailedRecordCount());
+  }
+
+  Result getResult(Outcome& outcome) const override {
+    return outcome.GetResult().GetRecords();
+  }
+
+ public:
+  std::mutex mutex_;
+  std::map<std::string, std::size_t> attempts_;
+};
+
+TEST_F(AwsLoggerTests, test_send_retries_failed_records) {
+  RetryLogForwarder log_forwarder;
+
+  // Two batches of two records are sent concurrently
+  log_forwarder.logString("{ \"record\": \"1\" }");
+  log_forwarder.logString("{ \"record\": \"2\" }");
+  log_forwarder.logString("{ \"record\": \"3\" }");
+  log_forwarder.logString("{ \"record\": \"4\" }");
+  log_forwarder.check();
+
+  // Only the first record of each batch failed and was sent again
+  auto attempts = [&log_forwarder](const std::string& record) {
+    return log_forwarder
+        .attempts_["{\"record\":\"" + record + "\",\"log_type\":\"result\"}"];
+  };
+
+  ASSERT_EQ(log_forwarder.attempts_.size(), 4U);
+  EXPECT_EQ(attempts("1"), 2U);
+  EXPECT_EQ(attempts("2"), 1U);
+  EXPECT_EQ(attempts("3"), 2U);
+  EXPECT_EQ(attempts("4"), 1U);
+}
 } // namespace osquery
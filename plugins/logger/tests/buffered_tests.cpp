@@ -108,6 +108,9 @@ class MockBufferedLogForwarder : public BufferedLogForwarder {
   FRIEND_TEST(BufferedLogForwarderTests, test_purge);
   FRIEND_TEST(BufferedLogForwarderTests, test_purge_max);
   FRIEND_TEST(BufferedLogForwarderTests, test_backoff);
+  FRIEND_TEST(BufferedLogForwarderTests, test_segments);
+  FRIEND_TEST(BufferedLogForwarderTests, test_backlog);
+  FRIEND_TEST(BufferedLogForwarderTests, test_retry_after);
 
  private:
   bool checked_{false};
@@ -144,12 +147,22 @@ class FakeLogForwarder : public BufferedLogForwarder {
 TEST_F(BufferedLogForwarderTests, test_index) {
   MockBufferedLogForwarder runner;
   if (!isPlatform(PlatformType::TYPE_WINDOWS)) {
-    EXPECT_THAT(runner.genResultIndex(), ContainsRegex("mock_r_[0-9]+_1"));
-    EXPECT_THAT(runner.genStatusIndex(), ContainsRegex("mock_s_[0-9]+_2"));
-    EXPECT_THAT(runner.genResultIndex(), ContainsRegex("mock_r_[0-9]+_3"));
-    EXPECT_THAT(runner.genStatusIndex(), ContainsRegex("mock_s_[0-9]+_4"));
+    EXPECT_THAT(runner.genResultIndex(), ContainsRegex("mock_r_0+1_[0-9]+_1"));
+    EXPECT_THAT(runner.genStatusIndex(), ContainsRegex("mock_s_0+2_[0-9]+_1"));
+    EXPECT_THAT(runner.genResultIndex(), ContainsRegex("mock_r_0+3_[0-9]+_1"));
+    EXPECT_THAT(runner.genStatusIndex(), ContainsRegex("mock_s_0+4_[0-9]+_1"));
   }
 
+  auto index = runner.genStatusIndex(1);
+  EXPECT_EQ(index, "mock_s_00000000000000000005_1_1");
+  EXPECT_TRUE(runner.isSegmentIndex(index));
+  EXPECT_EQ(runner.segmentLines(index), 1U);
+  EXPECT_EQ(runner.segmentLines("mock_s_00000000000000000009_1_3"), 3U);
+
+  // Logs buffered by older versions are indexed by time.
+  EXPECT_FALSE(runner.isSegmentIndex("mock_r_1600000000_1"));
+  EXPECT_EQ(runner.segmentLines("mock_r_1600000000_1"), 1U);
+
   EXPECT_TRUE(runner.isResultIndex(runner.genResultIndex()));
   EXPECT_FALSE(runner.isResultIndex(runner.genStatusIndex()));
   EXPECT_FALSE(runner.isResultIndex("foo"));
@@ -404,6 +417,122 @@ TEST_F(BufferedLogForwarderTests, test_purge_max) {
   runner.check();
 }
 
+TEST_F(BufferedLogForwarderTests, test_segments) {
+  FLAGS_buffered_log_max = 10;
+  StrictMock<MockBufferedLogForwarder> runner("mock", kLogPeriod, 2);
+  StatusLogLine log1 = makeStatusLogLine(O_INFO, "foo", 1, "foo status");
+  StatusLogLine log2 = makeStatusLogLine(O_ERROR, "bar", 30, "bar error");
+  StatusLogLine log3 = makeStatusLogLine(O_WARNING, "baz", 2, "baz warning");
+
+  // The lines of one call are a single segment, it is sent whole.
+  runner.logStatus({log1, log2, log3});
+  runner.logStatus({log1});
+  std::vector<std::string> indexes;
+  scanDatabaseKeys(kLogs, indexes, "mock_");
+  ASSERT_EQ(indexes.size(), 2U);
+  EXPECT_EQ(runner.segmentLines(indexes[0]), 3U);
+
+  EXPECT_CALL(runner,
+              send(ElementsAre(MatchesStatus(log1),
+                               MatchesStatus(log2),
+                               MatchesStatus(log3)),
+                   "status"))
+      .WillOnce(Return(Status(0)));
+  runner.check();
+
+  // A restarted forwarder counts the lines and continues the sequence.
+  StrictMock<MockBufferedLogForwarder> restarted("mock", kLogPeriod, 2);
+  ASSERT_TRUE(restarted.setUp().ok());
+  restarted.logString("foo");
+  EXPECT_THAT(restarted.genResultIndex(), ContainsRegex("mock_r_0+4_"));
+
+  // Both buffered lines are counted, the oldest is purged.
+  FLAGS_buffered_log_max = 1;
+  restarted.purge();
+  EXPECT_CALL(restarted, send(ElementsAre("foo"), "result"))
+      .WillOnce(Return(Status(0)));
+  restarted.check();
+
+  indexes.clear();
+  scanDatabaseKeys(kLogs, indexes, "mock_");
+  EXPECT_TRUE(indexes.empty());
+}
+
+TEST_F(BufferedLogForwarderTests, test_backlog) {
+  StrictMock<MockBufferedLogForwarder> runner("mock", kLogPeriod, 1);
+  runner.backlog_max_log_lines_ = 4;
+  for (const auto& line : {"a", "b", "c", "d", "e"}) {
+    runner.logString(line);
+  }
+
+  // Each full batch sent while logs remain doubles the next one.
+  EXPECT_CALL(runner, send(ElementsAre("a"), "result"))
+      .WillOnce(Return(Status(0)));
+  runner.check();
+
+  EXPECT_CALL(runner, send(ElementsAre("b", "c"), "result"))
+      .WillOnce(Return(Status(0)));
+  runner.check();
+
+  runner.logString("f");
+  runner.logString("g");
+  EXPECT_CALL(runner, send(ElementsAre("d", "e", "f", "g"), "result"))
+      .WillOnce(Return(Status(0)));
+  runner.check();
+  EXPECT_EQ(runner.bufferedLines(), 0U);
+
+  // The backlog was sent, the batch is back to the max lines.
+  runner.logString("h");
+  runner.logString("i");
+  EXPECT_CALL(runner, send(ElementsAre("h"), "result"))
+      .WillOnce(Return(Status(0)));
+  runner.check();
+
+  // A failure resets the batch as well.
+  runner.logString("j");
+  runner.logString("k");
+  EXPECT_CALL(runner, send(ElementsAre("i", "j"), "result"))
+      .WillOnce(Return(Status(1, "fail")));
+  runner.check();
+
+  EXPECT_CALL(runner, send(ElementsAre("i"), "result"))
+      .WillOnce(Return(Status(0)));
+  runner.check();
+}
+
+TEST_F(BufferedLogForwarderTests, test_retry_after) {
+  StrictMock<MockBufferedLogForwarder> runner;
+  runner.max_backoff_period_ = runner.log_period_ * 20;
+  runner.logString("foo");
+
+  // The remote asks to wait longer than the exponential backoff.
+  EXPECT_CALL(runner, send(ElementsAre("foo"), "result"))
+      .WillOnce(Invoke([&runner](std::vector<std::string>&,
+                                 const std::string&) {
+        runner.retry_after_ = runner.log_period_ * 10;
+        return Status(1, "busy");
+      }));
+  runner.check();
+  EXPECT_EQ(runner.results_backoff_, 1U);
+  EXPECT_EQ(runner.results_backoff_period_, runner.log_period_ * 10);
+
+  // The wait is bounded by the max backoff.
+  EXPECT_CALL(runner, send(ElementsAre("foo"), "result"))
+      .WillOnce(Invoke([&runner](std::vector<std::string>&,
+                                 const std::string&) {
+        runner.retry_after_ = runner.log_period_ * 100;
+        return Status(1, "busy");
+      }));
+  runner.check();
+  EXPECT_EQ(runner.results_backoff_period_, runner.max_backoff_period_);
+
+  // Failures without a wait use the exponential backoff.
+  EXPECT_CALL(runner, send(ElementsAre("foo"), "result"))
+      .WillOnce(Return(Status(1, "fail")));
+  runner.check();
+  EXPECT_EQ(runner.results_backoff_period_, runner.log_period_ * 9);
+}
+
 TEST_F(BufferedLogForwarderTests, test_status_log_standard_decorations) {
   FakeLogForwarder forwarder;
 
@@ -22,8 +22,10 @@
 
 #include <gtest/gtest.h>
 
+#include <chrono>
 #include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 
 namespace fs = boost::filesystem;
@@ -33,6 +35,7 @@ namespace osquery {
 DECLARE_string(logger_path);
 DECLARE_bool(disable_logging);
 DECLARE_bool(logger_numerics);
+DECLARE_uint64(logger_flush_interval);
 
 class FilesystemLoggerTests : public testing::Test {
  public:
@@ -85,6 +88,34 @@ TEST_F(FilesystemLoggerTests, test_log_string) {
   EXPECT_EQ(content, "{\"json\": true}\n");
 }
 
+TEST_F(FilesystemLoggerTests, test_log_string_async) {
+  FLAGS_logger_flush_interval = 10;
+  auto plugin = Registry::get().plugin("logger", "filesystem");
+  ASSERT_TRUE(plugin->setUp());
+
+  EXPECT_TRUE(logString("{\"line\": 1}", "event"));
+  EXPECT_TRUE(logString("{\"line\": 2}", "event"));
+
+  // The background writer appends both lines in a batch.
+  std::string expected = "{\"line\": 1}\n{\"line\": 2}\n";
+  std::string content;
+  for (size_t i = 0; i < 100 && content != expected; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    content.clear();
+    EXPECT_TRUE(readFile(results_path_, content));
+  }
+  EXPECT_EQ(content, expected);
+
+  // Disabling the writer flushes the lines it buffered.
+  EXPECT_TRUE(logString("{\"line\": 3}", "event"));
+  FLAGS_logger_flush_interval = 0;
+  ASSERT_TRUE(plugin->setUp());
+
+  content.clear();
+  EXPECT_TRUE(readFile(results_path_, content));
+  EXPECT_EQ(content, expected + "{\"line\": 3}\n");
+}
+
 class FilesystemTestLoggerPlugin : public LoggerPlugin {
  public:
   Status logString(const std::string& s) override {
@@ -56,6 +56,17 @@ class MockKafkaProducerPlugin : public KafkaProducerPlugin {
     return Status(0, "OK");
   }
 
+  size_t publishBatch(rd_kafka_topic_t* topic,
+                      std::vector<rd_kafka_message_t>& messages) override {
+    // Each message is delivered right away.
+    for (const auto& message : messages) {
+      publishedMsgs_[topic].push_back(
+          std::string(static_cast<const char*>(message.payload), message.len));
+      releaseMessage(message);
+    }
+    return 0;
+  }
+
   void flushMessages() override {
     timesFlushed_++;
   }
@@ -355,6 +366,42 @@ TEST_F(KafkaProducerPluginTest, logString_multi_topic_happy_path) {
   EXPECT_TRUE(mkpp.timesPolled_.load() == 8);
 }
 
+TEST_F(KafkaProducerPluginTest, logStringBatch_multi_topic) {
+  MockKafkaProducerPlugin mkpp;
+
+  std::map<std::string, rd_kafka_topic_t*> qToT;
+  rd_kafka_topic_t* topicBase = reinterpret_cast<rd_kafka_topic_t*>(0x692870);
+  qToT[kKafkaBaseTopic] = topicBase;
+  rd_kafka_topic_t* topic1 = reinterpret_cast<rd_kafka_topic_t*>(0x692871);
+  qToT["topic1"] = topic1;
+  mkpp.setQueryToTopics(qToT);
+
+  auto s = mkpp.logStringBatch(
+      "[\"{\\\"name\\\": \\\"topic1\\\", \\\"snapshot\\\": \\\"1\\\"}\","
+      "\"{\\\"name\\\": \\\"topic10\\\"}\","
+      "\"{\\\"name\\\": \\\"topic1\\\", \\\"snapshot\\\": \\\"2\\\"}\"]");
+  EXPECT_TRUE(s.ok());
+
+  std::vector<std::string> expected = {
+      "{\"name\": \"topic1\", \"snapshot\": \"1\"}",
+      "{\"name\": \"topic1\", \"snapshot\": \"2\"}",
+  };
+  EXPECT_EQ(expected, mkpp.publishedMsgs_[topic1]);
+
+  expected = {"{\"name\": \"topic10\"}"};
+  EXPECT_EQ(expected, mkpp.publishedMsgs_[topicBase]);
+
+  // The batch is polled once.
+  EXPECT_EQ(mkpp.timesPolled_.load(), 1);
+
+  // Forwarded events are always published to the base topic.
+  s = mkpp.logEventBatch("[\"{\\\"name\\\": \\\"topic1\\\"}\"]");
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(mkpp.publishedMsgs_[topicBase].size(), 2U);
+
+  EXPECT_FALSE(mkpp.logStringBatch("not json").ok());
+}
+
 TEST_F(KafkaProducerPluginTest, flush_on_stop) {
   MockKafkaProducerPlugin mkpp;
 
@@ -66,6 +66,37 @@ TEST_F(TLSLoggerTests, test_database) {
   EXPECT_TRUE(found_string);
 }
 
+TEST_F(TLSLoggerTests, test_build_request_body) {
+  std::vector<std::string> log_data = {
+      "{\"a\": 1}", "not json", "[1, 2]", "{\"b\": \"c\"} trailing"};
+
+  std::string body;
+  auto status =
+      TLSLogForwarder::buildRequestBody(log_data, "key", "result", body);
+  ASSERT_TRUE(status.ok());
+
+  JSON doc;
+  ASSERT_TRUE(doc.fromString(body).ok());
+  const auto& params = doc.doc();
+  EXPECT_EQ(std::string(params["node_key"].GetString()), "key");
+  EXPECT_EQ(std::string(params["log_type"].GetString()), "result");
+
+  // Only the valid lines are sent, and only those are released.
+  ASSERT_TRUE(params["data"].IsArray());
+  ASSERT_EQ(params["data"].Size(), 2U);
+  EXPECT_EQ(params["data"][0]["a"].GetInt(), 1);
+  EXPECT_EQ(params["data"][1].Size(), 2U);
+  EXPECT_TRUE(log_data[0].empty());
+  EXPECT_EQ(log_data[1], "not json");
+  EXPECT_TRUE(log_data[2].empty());
+
+  // An empty batch is still a valid body.
+  log_data.clear();
+  ASSERT_TRUE(
+      TLSLogForwarder::buildRequestBody(log_data, "key", "status", body).ok());
+  EXPECT_EQ(body, "{\"node_key\":\"key\",\"log_type\":\"status\",\"data\":[]}");
+}
+
 TEST_F(TLSLoggerTests, test_send) {
   // Start a server.
   ASSERT_TRUE(TLSServerRunner::start());
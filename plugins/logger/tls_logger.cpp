@@ -48,6 +48,12 @@ FLAG(uint64,
      "kicks in when regular flush fails. Should be a multiple of "
      "logger_tls_period. 0 disables backoff");
 
+FLAG(uint64,
+     logger_tls_backlog_max_lines,
+     0,
+     "Max number of logs to send per period while logs are backlogged, "
+     "batches grow up to it (0 = logger_tls_max_lines)");
+
 FLAG(uint64,
      logger_tls_max_linesize,
      1 * 1024 * 1024,
@@ -62,13 +68,50 @@ FLAG(bool, logger_tls_compress, false, "GZip compress TLS/HTTPS request body");
 
 REGISTER(TLSLoggerPlugin, "logger", "tls");
 
+namespace {
+
+/// A server may ask for batches up to this many times logger_tls_max_lines.
+const uint64_t kMaxLinesHintFactor{16};
+
+/// The longest period between flushes a server may ask for.
+const std::chrono::seconds kMaxPeriodHint{60 * 60};
+
+/// Read an unsigned integer member of a response, 0 if missing.
+uint64_t getResponseHint(const JSON& response, const char* name) {
+  const auto& doc = response.doc();
+  if (!doc.IsObject()) {
+    return 0;
+  }
+
+  auto it = doc.FindMember(name);
+  if (it == doc.MemberEnd() || !it->value.IsUint64()) {
+    return 0;
+  }
+  return it->value.GetUint64();
+}
+
+/// Check the syntax of a JSON line, no document is built.
+bool isValidJSON(const std::string& line) {
+  // The line is parsed as a C string, it cannot contain a NUL.
+  if (line.find('\0') != std::string::npos) {
+    return false;
+  }
+
+  rapidjson::BaseReaderHandler<> handler;
+  return parseJSON(line, handler).ok();
+}
+} // namespace
+
 TLSLogForwarder::TLSLogForwarder()
     : BufferedLogForwarder("TLSLogForwarder",
                            "tls",
                            std::chrono::seconds(FLAGS_logger_tls_period),
                            FLAGS_logger_tls_max_lines,
-                           std::chrono::seconds(FLAGS_logger_tls_backoff_max)) {
+                           std::chrono::seconds(FLAGS_logger_tls_backoff_max)),
+      configured_log_period_(log_period_),
+      configured_max_log_lines_(max_log_lines_) {
   uri_ = TLSRequestHelper::makeURI(FLAGS_logger_tls_endpoint);
+  backlog_max_log_lines_ = FLAGS_logger_tls_backlog_max_lines;
 }
 
 Status TLSLoggerPlugin::logString(const std::string& s) {
@@ -114,6 +157,8 @@ void TLSLoggerPlugin::configure() {
     forwarder_->updated_log_period =
         std::chrono::seconds(FLAGS_logger_tls_period);
     forwarder_->updated_max_log_lines = FLAGS_logger_tls_max_lines;
+    forwarder_->updated_backlog_max_log_lines =
+        FLAGS_logger_tls_backlog_max_lines;
     forwarder_->updated_max_backoff_period =
         std::chrono::seconds(FLAGS_logger_tls_backoff_max);
   }
@@ -126,49 +171,93 @@ Status TLSLogForwarder::send(std::vector<std::string>& log_data,
     return Status::success();
   }
 
-  JSON params;
-  params.add("node_key", getNodeKey("tls"));
-  params.add("log_type", log_type);
-
-  {
-    // Read each logged line into JSON and populate a list of lines.
-    // The result list will use the 'data' key.
-    auto children = params.newArray();
-    iterate(log_data, ([&params, &children](std::string& item) {
-              // Enforce a max log line size for TLS logging.
-              if (item.size() > FLAGS_logger_tls_max_linesize) {
-                LOG(WARNING)
-                    << "Linesize exceeds TLS logger maximum: " << item.size();
-                return;
-              }
-
-              JSON child;
-              Status s = child.fromString(item);
-              if (!s.ok()) {
-                // The log line entered was not valid JSON, skip it.
-                return;
-              }
-              std::string().swap(item);
-              params.push(child.doc(), children.doc());
-            }));
-    params.add("data", children.doc());
+  std::string body;
+  auto status = buildRequestBody(log_data, getNodeKey("tls"), log_type, body);
+  if (!status.ok()) {
+    return status;
   }
 
-  // The response body is ignored (status is set appropriately by
-  // TLSRequestHelper::go())
-  std::string response;
-  if (FLAGS_logger_tls_compress) {
-    params.add("_compress", true);
+  // The status is set appropriately by TLSRequestHelper::go(), a server
+  // rejecting the request may ask to wait with Retry-After.
+  JSON response;
+  status = TLSRequestHelper::go<JSONSerializer>(
+      uri_, body, FLAGS_logger_tls_compress, response, retry_after_);
+  if (status.ok()) {
+    applyResponseHints(response);
+  }
+  return status;
+}
+
+void TLSLogForwarder::applyResponseHints(const JSON& response) {
+  // Hints apply to the next batches, without a hint the flags are used.
+  auto lines = getResponseHint(response, "logger_tls_max_lines");
+  if (lines > 0 && configured_max_log_lines_ > 0) {
+    max_log_lines_ =
+        std::min(lines, configured_max_log_lines_ * kMaxLinesHintFactor);
+  } else {
+    max_log_lines_ = configured_max_log_lines_;
+  }
+
+  auto period = std::chrono::seconds(
+      getResponseHint(response, "logger_tls_period"));
+  if (period > std::chrono::seconds::zero()) {
+    log_period_ = std::min(period, kMaxPeriodHint);
+  } else {
+    log_period_ = configured_log_period_;
+  }
+}
+
+Status TLSLogForwarder::buildRequestBody(std::vector<std::string>& log_data,
+                                         const std::string& node_key,
+                                         const std::string& log_type,
+                                         std::string& body) {
+  size_t size = node_key.size() + log_type.size() + 48;
+  for (const auto& item : log_data) {
+    size += item.size() + 1;
   }
-  return TLSRequestHelper::go<JSONSerializer>(uri_, params, response);
+  body.clear();
+  body.reserve(size);
+
+  // The lines are already JSON, they are copied into the 'data' list as-is.
+  JSONStringStream stream(body);
+  JSONWriter writer(stream);
+  writer.StartObject();
+  writer.Key("node_key");
+  writer.String(node_key.data(),
+                static_cast<rapidjson::SizeType>(node_key.size()));
+  writer.Key("log_type");
+  writer.String(log_type.data(),
+                static_cast<rapidjson::SizeType>(log_type.size()));
+  writer.Key("data");
+  writer.StartArray();
+  iterate(log_data, ([&writer](std::string& item) {
+            // Enforce a max log line size for TLS logging.
+            if (item.size() > FLAGS_logger_tls_max_linesize) {
+              LOG(WARNING) << "Linesize exceeds TLS logger maximum: "
+                           << item.size();
+              return;
+            }
+
+            if (!isValidJSON(item)) {
+              // The log line entered was not valid JSON, skip it.
+              return;
+            }
+
+            writer.RawValue(item.data(), item.size(), rapidjson::kObjectType);
+            std::string().swap(item);
+          }));
+  writer.EndArray();
+  writer.EndObject();
+  return Status::success();
 }
 
 void TLSLogForwarder::applyNewConfiguration() {
   std::unique_lock<decltype(configuration_mutex)> lock(configuration_mutex);
   if (configuration_updated) {
     uri_ = updated_uri;
-    log_period_ = updated_log_period;
-    max_log_lines_ = updated_max_log_lines;
+    log_period_ = configured_log_period_ = updated_log_period;
+    max_log_lines_ = configured_max_log_lines_ = updated_max_log_lines;
+    backlog_max_log_lines_ = updated_backlog_max_log_lines;
     max_backoff_period_ = updated_max_backoff_period;
   }
   configuration_updated = false;
@@ -36,6 +36,19 @@ class TLSLogForwarder : public BufferedLogForwarder {
   std::chrono::seconds updated_log_period;
   std::chrono::seconds updated_max_backoff_period;
   uint64_t updated_max_log_lines;
+  uint64_t updated_backlog_max_log_lines;
+
+  /**
+   * @brief Build a request body from log lines that are already JSON.
+   *
+   * Lines are checked for JSON syntax without building a document and are
+   * spliced into the 'data' list as they are. Lines that are invalid or
+   * exceed logger_tls_max_linesize are skipped, the used lines are released.
+   */
+  static Status buildRequestBody(std::vector<std::string>& log_data,
+                                 const std::string& node_key,
+                                 const std::string& log_type,
+                                 std::string& body);
 
  protected:
   Status send(std::vector<std::string>& log_data,
@@ -43,9 +56,22 @@ class TLSLogForwarder : public BufferedLogForwarder {
 
   void applyNewConfiguration() override;
 
+  /**
+   * @brief Apply the batch hints of a log endpoint response.
+   *
+   * A response may include "logger_tls_max_lines" and "logger_tls_period"
+   * for the next batches, bounded to 16 times the configured lines and to an
+   * hour. Without them the configured values are used again.
+   */
+  void applyResponseHints(const JSON& response);
+
   /// Endpoint URI
   std::string uri_;
 
+  /// The period and lines set by the flags, hints may replace them.
+  std::chrono::seconds configured_log_period_;
+  uint64_t configured_max_log_lines_;
+
  private:
   friend class TLSLoggerTests;
 };
@@ -10,6 +10,8 @@
 // Sanity check integration test for hash
 // Spec file: specs/hash.table
 
+#include <osquery/core/flags.h>
+#include <osquery/database/database.h>
 #include <osquery/filesystem/filesystem.h>
 #include <osquery/tests/integration/tables/helper.h>
 #include <osquery/utils/info/platform_type.h>
@@ -69,5 +71,31 @@ TEST_F(Hash, test_sanity) {
   }
 }
 
+TEST_F(Hash, test_workers_and_persisted_hashes) {
+  auto second = path.string() + ".second";
+  ASSERT_TRUE(writeTextFile(second, "second").ok());
+
+  Flag::updateValue("hash_workers", "2");
+  Flag::updateValue("hash_cache_persist", "true");
+  QueryData data = execute_query("select path, md5 from hash where path in ('" +
+                                 path.string() + "', '" + second + "')");
+  Flag::updateValue("hash_workers", "0");
+  Flag::updateValue("hash_cache_persist", "false");
+  fs::remove(second);
+
+  ASSERT_EQ(data.size(), 2ul);
+  for (const auto& row : data) {
+    if (row.at("path") == path.string()) {
+      EXPECT_EQ(row.at("md5"), "35899082e51edf667f14477ac000cbba");
+    } else {
+      EXPECT_EQ(row.at("md5"), "a9f0e61a137d86aa9db53465e0801612");
+    }
+  }
+
+  std::vector<std::string> keys;
+  EXPECT_TRUE(scanDatabaseKeys(kFileHashes, keys).ok());
+  EXPECT_GE(keys.size(), 2ul);
+}
+
 } // namespace table_tests
 } // namespace osquery
@@ -40,6 +40,8 @@ TEST_F(osqueryEvents, test_sanity) {
   //      {"events", IntType}
   //      {"refreshes", IntType}
   //      {"active", IntType}
+  //      {"dropped", IntType}
+  //      {"lag", IntType}
   //}
   // 4. Perform validation
   // validate_rows(data, row_map);
@@ -0,0 +1,41 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+// Sanity check integration test for osquery_last_results
+// Spec file: specs/utility/osquery_last_results.table
+
+#include <osquery/tests/integration/tables/helper.h>
+
+namespace osquery {
+namespace table_tests {
+
+class osqueryLastResults : public testing::Test {
+ protected:
+  void SetUp() override {
+    setUpEnvironment();
+  }
+};
+
+TEST_F(osqueryLastResults, test_sanity) {
+  auto const data = execute_query("select * from osquery_last_results");
+
+  ValidationMap row_map = {
+      {"name", NonEmptyString},
+      {"query", NonEmptyString},
+      {"last_executed", NonNegativeInt},
+      {"epoch", NonNegativeInt},
+      {"counter", NonNegativeInt},
+      {"row_index", NonNegativeInt},
+      {"result", NonEmptyString},
+  };
+  validate_rows(data, row_map);
+}
+
+} // namespace table_tests
+} // namespace osquery
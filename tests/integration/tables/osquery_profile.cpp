@@ -0,0 +1,66 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+// Sanity check integration test for osquery_profile
+// Spec file: specs/utility/osquery_profile.table
+
+#include <chrono>
+
+#include <osquery/profiler/sampling_profiler.h>
+#include <osquery/tests/integration/tables/helper.h>
+
+namespace osquery {
+namespace table_tests {
+
+class osqueryProfile : public testing::Test {
+ protected:
+  void SetUp() override {
+    setUpEnvironment();
+  }
+};
+
+TEST_F(osqueryProfile, test_sanity) {
+  auto status = updateSamplingProfiler(1000);
+  if (!status.ok()) {
+    // The profiler is not supported on every platform.
+    return;
+  }
+
+  {
+    // Consume enough CPU time for the timer to fire.
+    ProfileScope scope("profile_test", ProfileStage::Query);
+    volatile std::uint64_t sink = 0;
+    auto end =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(200);
+    while (std::chrono::steady_clock::now() < end) {
+      sink = sink + 1;
+    }
+  }
+
+  auto const data = execute_query("select * from osquery_profile");
+  ASSERT_TRUE(updateSamplingProfiler(0).ok());
+  ASSERT_GT(data.size(), 0ul);
+
+  ValidationMap row_map = {
+      {"query", NormalType},
+      {"stage", SpecificValuesCheck{"", "query", "generate", "diff", "log"}},
+      {"stack", NonEmptyString},
+      {"samples", NonNegativeInt},
+  };
+  validate_rows(data, row_map);
+
+  bool attributed = false;
+  for (const auto& row : data) {
+    attributed |= row.at("query") == "profile_test";
+  }
+  EXPECT_TRUE(attributed);
+}
+
+} // namespace table_tests
+} // namespace osquery
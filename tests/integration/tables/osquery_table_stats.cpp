@@ -0,0 +1,46 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+// Sanity check integration test for osquery_table_stats
+// Spec file: specs/utility/osquery_table_stats.table
+
+#include <osquery/tests/integration/tables/helper.h>
+
+namespace osquery {
+namespace table_tests {
+
+class osqueryTableStats : public testing::Test {
+ protected:
+  void SetUp() override {
+    setUpEnvironment();
+  }
+};
+
+TEST_F(osqueryTableStats, test_sanity) {
+  auto const data = execute_query("select * from osquery_table_stats");
+
+  ValidationMap row_map = {
+      {"name", NonEmptyString},
+      {"table_name", NonEmptyString},
+      {"executions", NonNegativeInt},
+      {"filters", NonNegativeInt},
+      {"rows_generated", NonNegativeInt},
+      {"rows_returned", NonNegativeInt},
+      {"generate_time_ms", NonNegativeInt},
+      {"last_filters", NonNegativeInt},
+      {"last_rows_generated", NonNegativeInt},
+      {"last_rows_returned", NonNegativeInt},
+      {"last_generate_time_ms", NonNegativeInt},
+      {"shapes", NormalType},
+  };
+  validate_rows(data, row_map);
+}
+
+} // namespace table_tests
+} // namespace osquery
@@ -0,0 +1,43 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+// Sanity check integration test for osquery_thread_classes
+// Spec file: specs/utility/osquery_thread_classes.table
+
+#include <osquery/tests/integration/tables/helper.h>
+
+namespace osquery {
+namespace table_tests {
+
+class osqueryThreadClasses : public testing::Test {
+ protected:
+  void SetUp() override {
+    setUpEnvironment();
+  }
+};
+
+TEST_F(osqueryThreadClasses, test_sanity) {
+  auto const data = execute_query("select * from osquery_thread_classes");
+  ASSERT_EQ(data.size(), 5ul);
+
+  ValidationMap row_map = {
+      {"name",
+       SpecificValuesCheck{
+           "default", "event_reader", "scheduler", "logger", "worker"}},
+      {"cpus", NormalType},
+      {"priority", NormalType},
+      {"threads", NonNegativeInt},
+      {"started", NonNegativeInt},
+      {"cpu_time", NonNegativeInt},
+  };
+  validate_rows(data, row_map);
+}
+
+} // namespace table_tests
+} // namespace osquery
@@ -0,0 +1,58 @@
+/**
+ * Copyright (c) 2014-present, The osquery authors
+ *
+ * This source code is licensed as defined by the LICENSE file found in the
+ * root directory of this source tree.
+ *
+ * SPDX-License-Identifier: (Apache-2.0 OR GPL-2.0-only)
+ */
+
+// Sanity check integration test for process_memory_summary
+// Spec file: specs/linux/process_memory_summary.table
+
+#include <osquery/tests/integration/tables/helper.h>
+
+#include <unistd.h>
+
+namespace osquery {
+namespace table_tests {
+
+class processMemorySummary : public testing::Test {
+ protected:
+  void SetUp() override {
+    setUpEnvironment();
+  }
+};
+
+TEST_F(processMemorySummary, test_sanity) {
+  auto const data =
+      execute_query("select * from process_memory_summary where pid = " +
+                    std::to_string(getpid()));
+  ASSERT_EQ(data.size(), 1ul);
+
+  ValidationMap row_map = {
+      {"pid", NonNegativeInt},
+      {"rss", NonNegativeInt},
+      {"pss", NonNegativeInt},
+      {"pss_anon", NonNegativeInt},
+      {"pss_file", NonNegativeInt},
+      {"pss_shmem", NonNegativeInt},
+      {"shared_clean", NonNegativeInt},
+      {"shared_dirty", NonNegativeInt},
+      {"private_clean", NonNegativeInt},
+      {"private_dirty", NonNegativeInt},
+      {"referenced", NonNegativeInt},
+      {"anonymous", NonNegativeInt},
+      {"swap", NonNegativeInt},
+      {"swap_pss", NonNegativeInt},
+      {"locked", NonNegativeInt},
+      {"mappings", NonNegativeInt},
+      {"source", SpecificValuesCheck{"smaps_rollup", "smaps"}},
+  };
+  validate_rows(data, row_map);
+  EXPECT_GT(std::stoull(data[0].at("rss")), 0ull);
+  EXPECT_GT(std::stoull(data[0].at("mappings")), 0ull);
+}
+
+} // namespace table_tests
+} // namespace osquery
@@ -101,6 +101,8 @@ TABLE_ATTRIBUTES = {
     "cacheable": "CACHEABLE",
     "utility": "UTILITY",
     "kernel_required": "KERNEL_REQUIRED", # Deprecated
+    "no_shared_cache": "NO_SHARED_CACHE",
+    "boot_constant": "BOOT_CONSTANT",
 }
 
 WINDOWS = ['windows', 'win32', 'cygwin']
@@ -257,6 +259,11 @@ class TableState(Singleton):
                 print(lightred(
                     "Table cannot use a generator and be marked cacheable: %s" % (path)))
                 exit(1)
+        if "boot_constant" in self.attributes:
+            if self.generator:
+                print(lightred(
+                    "Table cannot use a generator and be marked boot_constant: %s" % (path)))
+                exit(1)
         if self.table_name == "" or self.function == "":
             print(lightred("Invalid table spec: %s" % (path)))
             exit(1)
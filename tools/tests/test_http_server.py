@@ -67,6 +67,29 @@ EXAMPLE_EMPTY_CONFIG = {
     "node_invalid": False,
 }
 
+# The config served with ETags, and the delta between its two versions.
+EXAMPLE_ETAG_CONFIG = {
+    "schedule": {
+        "tls_proc": {"query": "select * from processes", "interval": 1},
+    },
+    "packs": {
+        "old_pack": {"queries": {"time": {"query": "select * from time"}}},
+    },
+    "config_etag": "1",
+}
+
+EXAMPLE_ETAG_DELTA = {
+    "config_delta": {
+        "packs": {
+            "old_pack": None,
+            "new_pack": {
+                "queries": {"info": {"query": "select * from osquery_info"}},
+            },
+        },
+    },
+    "config_etag": "2",
+}
+
 # A 'node' variation of the TLS API uses a GET for config.
 EXAMPLE_NODE_CONFIG = EXAMPLE_CONFIG
 EXAMPLE_NODE_CONFIG["node"] = True
@@ -180,6 +203,8 @@ class RealSimpleHandler(BaseHTTPRequestHandler):
             self.enroll(request)
         elif self.path == "/config":
             self.config(request)
+        elif self.path == "/config_etag":
+            self.config_etag(request)
         elif self.path == "/log":
             self.log(request)
         elif self.path == "/distributed_read":
@@ -245,6 +270,24 @@ class RealSimpleHandler(BaseHTTPRequestHandler):
             return
         self._reply(EXAMPLE_CONFIG)
 
+    def config_etag(self, request):
+        """A config endpoint assigning ETags to the configs"""
+
+        # The first request receives the complete config, the next a delta to
+        # the second version of the config, then the config is unchanged.
+        self._push_request("config_etag", request)
+        if "node_key" not in request or request["node_key"] not in NODE_KEYS:
+            self._reply(FAILED_ENROLL_RESPONSE)
+            return
+
+        etag = request.get("config_etag")
+        if etag == "1":
+            self._reply(EXAMPLE_ETAG_DELTA)
+        elif etag == "2":
+            self._reply({"config_unchanged": True})
+        else:
+            self._reply(EXAMPLE_ETAG_CONFIG)
+
     def distributed_read(self, request):
         """A basic distributed read endpoint"""
         if "node_key" not in request or request["node_key"] not in NODE_KEYS: